@@ -0,0 +1,49 @@
+dnl ---------------------------------------------------------------------------
+dnl Macro: AC_CHECK_SQLITE
+dnl First check for custom SQLite paths in --with-sqlite-* options.
+dnl Then check that the header and the library can be used.
+dnl ---------------------------------------------------------------------------
+
+AC_DEFUN([AC_CHECK_SQLITE],[
+
+# Check for custom includes path
+if test [ -z "$ac_cv_sqlite_includes" ]
+then
+    AC_ARG_WITH([sqlite-includes],
+                AC_HELP_STRING([--with-sqlite-includes], [path to SQLite header files]),
+                [ac_cv_sqlite_includes=$withval])
+fi
+if test [ -n "$ac_cv_sqlite_includes" ]
+then
+    AC_CACHE_CHECK([SQLite includes], [ac_cv_sqlite_includes], [ac_cv_sqlite_includes=""])
+    SQLITE_CFLAGS="-I$ac_cv_sqlite_includes"
+fi
+
+# Check for custom library path
+if test [ -z "$ac_cv_sqlite_libs" ]
+then
+    AC_ARG_WITH([sqlite-libs],
+                AC_HELP_STRING([--with-sqlite-libs], [path to SQLite libraries]),
+                [ac_cv_sqlite_libs=$withval])
+fi
+if test [ -n "$ac_cv_sqlite_libs" ]
+then
+    AC_CACHE_CHECK([SQLite libraries], [ac_cv_sqlite_libs], [ac_cv_sqlite_libs=""])
+    SQLITE_LIBS="-L$ac_cv_sqlite_libs -lsqlite3"
+else
+    SQLITE_LIBS="-lsqlite3"
+fi
+
+ac_save_CPPFLAGS="$CPPFLAGS"
+ac_save_LIBS="$LIBS"
+CPPFLAGS="$CPPFLAGS $SQLITE_CFLAGS"
+LIBS="$SQLITE_LIBS $LIBS"
+
+AC_CHECK_HEADER([sqlite3.h], [],
+                [AC_MSG_ERROR([cannot find SQLite headers. Use --with-sqlite-includes to specify their location, or --without-sqlite to disable SQLite support])])
+AC_CHECK_FUNC([sqlite3_prepare_v2], [],
+              [AC_MSG_ERROR([cannot link with the SQLite library. Use --with-sqlite-libs to specify its location, or --without-sqlite to disable SQLite support])])
+
+CPPFLAGS="$ac_save_CPPFLAGS"
+LIBS="$ac_save_LIBS"
+])
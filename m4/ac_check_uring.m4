@@ -0,0 +1,15 @@
+dnl ---------------------------------------------------------------------------
+dnl Macro: AC_CHECK_URING
+dnl Check for io_uring availability (via liburing) on the target system
+dnl ---------------------------------------------------------------------------
+
+AC_DEFUN([AC_CHECK_URING],[
+if test x$enable_uring = xyes; then
+    AC_CHECK_HEADER([liburing.h],
+                    [AC_DEFINE(HAVE_LIBURING_H,1,[Define to 1 if your system has <liburing.h> header file])],
+                    [enable_uring=no])
+fi
+if test x$enable_uring = xyes; then
+    AC_CHECK_LIB([uring], [io_uring_queue_init_params], , [enable_uring=no])
+fi
+])
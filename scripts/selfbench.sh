@@ -0,0 +1,143 @@
+#!/usr/bin/env bash
+#
+# Copyright (C) 2017-2018 Alexey Kopytov <akopytov@gmail.com>
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+# Measure the overhead of sysbench itself: run workloads that do (almost)
+# nothing per event with an increasing number of threads and report the
+# event rate, so that regressions in the event loop, statistics or rate
+# limiting show up as lower numbers or worse scaling. Cases:
+#
+#   cpu        - the built-in cpu test with the smallest --cpu-max-prime
+#   lua        - an empty Lua event() function
+#   lua_hist   - same with --histogram and --percentile=99
+#   lua_hdr    - same with --histogram-type=hdr, --percentile=99 and
+#                --report-interval=1, so that the cost of merging per-thread
+#                histograms shows up with high thread counts
+#   lua_rate   - same with --rate at SELFBENCH_RATE events/s per thread, so
+#                eps below the target shows the cost of rate limiting
+#   sql_dryrun - oltp_point_select.lua with --db-dry-run
+#
+# One line is printed per case and thread count, as CSV with a header or as
+# JSON objects, one per line. The following environment variables are
+# recognized:
+#
+#   SYSBENCH           - sysbench binary ['sysbench']
+#   SELFBENCH_LUADIR   - directory with the bundled Lua scripts, added to
+#                        LUA_PATH [empty, use the installed scripts]
+#   SELFBENCH_CASES    - space-separated list of cases to run [all cases]
+#   SELFBENCH_THREADS  - space-separated list of thread counts
+#                        ['1 2 4 8 16 32 64 128 256']
+#   SELFBENCH_TIME     - duration of each run in seconds [5]
+#   SELFBENCH_RATE     - per-thread event rate of the lua_rate case [1000]
+#   SELFBENCH_DRIVER   - --db-driver of the sql_dryrun case [the first
+#                        compiled-in driver]
+#   SELFBENCH_FORMAT   - output format {csv, json} [csv]
+
+set -eu
+
+SYSBENCH=${SYSBENCH:-sysbench}
+SELFBENCH_CASES=${SELFBENCH_CASES:-"cpu lua lua_hist lua_hdr lua_rate sql_dryrun"}
+SELFBENCH_THREADS=${SELFBENCH_THREADS:-"1 2 4 8 16 32 64 128 256"}
+SELFBENCH_TIME=${SELFBENCH_TIME:-5}
+SELFBENCH_RATE=${SELFBENCH_RATE:-1000}
+SELFBENCH_FORMAT=${SELFBENCH_FORMAT:-csv}
+
+if [ -n "${SELFBENCH_LUADIR:-}" ]; then
+  export LUA_PATH="${SELFBENCH_LUADIR}/?.lua;${LUA_PATH:-;}"
+  point_select="${SELFBENCH_LUADIR}/oltp_point_select.lua"
+else
+  point_select=oltp_point_select
+fi
+
+case "$SELFBENCH_FORMAT" in
+  csv|json) ;;
+  *) echo "Invalid value for SELFBENCH_FORMAT: $SELFBENCH_FORMAT" >&2; exit 1;;
+esac
+
+tmpdir=$(mktemp -d)
+trap 'rm -rf "$tmpdir"' EXIT
+
+empty_lua="$tmpdir/empty.lua"
+echo "function event() end" > "$empty_lua"
+
+# Arguments of sysbench for a case and a number of threads, without the
+# common ones. They are passed after the common ones, so they can override them
+case_args()
+{
+  case "$1" in
+    cpu)
+      echo "cpu --cpu-max-prime=3";;
+    lua)
+      echo "$empty_lua";;
+    lua_hist)
+      echo "$empty_lua --histogram --percentile=99";;
+    lua_hdr)
+      echo "$empty_lua --histogram-type=hdr --percentile=99 --report-interval=1";;
+    lua_rate)
+      echo "$empty_lua --rate=$((SELFBENCH_RATE * $2))";;
+    sql_dryrun)
+      if [ -z "${SELFBENCH_DRIVER:-}" ]; then
+        SELFBENCH_DRIVER=$("$SYSBENCH" --help |
+          sed -n '/^Compiled-in database drivers:/{n;s/^ *\([^ ]*\).*/\1/p;}')
+      fi
+      if [ -z "$SELFBENCH_DRIVER" ]; then
+        echo "No database drivers compiled in, cannot run sql_dryrun" >&2
+        return 1
+      fi
+      echo "$point_select --db-driver=$SELFBENCH_DRIVER --db-dry-run" \
+           "--skip_trx";;
+    *)
+      echo "Unknown case: $1" >&2
+      return 1;;
+  esac
+}
+
+if [ "$SELFBENCH_FORMAT" = csv ]; then
+  echo "case,threads,events,time,eps,eps_per_thread"
+fi
+
+for c in $SELFBENCH_CASES; do
+  for t in $SELFBENCH_THREADS; do
+    args=$(case_args "$c" "$t")
+
+    # word splitting of $args is intended
+    # shellcheck disable=SC2086
+    "$SYSBENCH" --threads="$t" --time="$SELFBENCH_TIME" --report-interval=0 \
+                $args run > "$tmpdir/out" 2>&1 || {
+      cat "$tmpdir/out" >&2
+      echo "sysbench failed for case '$c' with $t threads" >&2
+      exit 1
+    }
+
+    awk -v c="$c" -v t="$t" -v fmt="$SELFBENCH_FORMAT" '
+      /^ *events\/s \(eps\):/     { eps = $3 }
+      /^ *time elapsed:/          { sub(/s$/, "", $3); time = $3 }
+      /^ *total number of events:/ { events = $5 }
+      END {
+        if (eps == "") {
+          print "Cannot parse sysbench output for case " c > "/dev/stderr"
+          exit 1
+        }
+        if (fmt == "csv")
+          printf("%s,%d,%d,%s,%.2f,%.2f\n", c, t, events, time, eps, eps / t)
+        else
+          printf("{\"case\": \"%s\", \"threads\": %d, \"events\": %d, " \
+                 "\"time\": %s, \"eps\": %.2f, \"eps_per_thread\": %.2f}\n",
+                 c, t, events, time, eps, eps / t)
+      }' "$tmpdir/out"
+  done
+done
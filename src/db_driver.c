@@ -34,13 +34,39 @@
 
 #include <pthread.h>
 
+#ifdef HAVE_POLL_H
+# include <poll.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_SYS_SOCKET_H
+# include <sys/socket.h>
+#endif
+#ifdef HAVE_NETINET_IN_H
+# include <netinet/in.h>
+#endif
+#ifdef HAVE_NETINET_TCP_H
+# include <netinet/tcp.h>
+#endif
+
 #include "db_driver.h"
 #include "sb_list.h"
 #include "sb_histogram.h"
 #include "sb_ck_pr.h"
+#include "sb_usage.h"
+#include "sb_rand.h"
+#include "sb_trace.h"
+#include "sb_tracectx.h"
+#include "sb_slow_log.h"
+#include "db_waits.h"
+#include "db_outage.h"
 
-/* Query length limit for bulk insert queries */
-#define BULK_PACKET_SIZE (512*1024)
+/* Query length limit for bulk insert queries, see --db-bulk-packet-size */
+#define BULK_PACKET_SIZE db_globals.bulk_packet_size
+
+/* Maximum value of --db-socket-rcvbuf and --db-socket-sndbuf */
+#define SOCKET_BUFFER_MAX (512ULL * 1024 * 1024)
 
 /* How many rows to insert before COMMITs (used in bulk insert) */
 #define ROWS_BEFORE_COMMIT 1000
@@ -59,6 +85,177 @@ static pthread_once_t db_global_once = PTHREAD_ONCE_INIT;
 static sb_timer_t *exec_timers;
 static sb_timer_t *fetch_timers;
 
+/* Values of db_conn_t::pooled */
+#define POOL_CONN_BUSY 1                /* checked out from the pool */
+#define POOL_CONN_IDLE 2                /* waiting in the pool */
+
+/* Connection pool shared by all threads, see db_pool_checkout() */
+static struct
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+  db_driver_t     *driver;        /* Driver of pooled connections */
+  db_conn_t       **conns;        /* All pooled connections */
+  db_conn_t       **idle;         /* Stack of idle connections */
+  unsigned int    nconns;         /* Number of pooled connections */
+  unsigned int    ncreating;      /* Number of connections being created */
+  unsigned int    nidle;          /* Number of idle connections */
+  unsigned int    nwaiting;       /* Number of threads waiting for checkout */
+  uint64_t        checkouts;      /* Total number of checkouts */
+  uint64_t        waits;          /* Number of checkouts that had to wait */
+  bool            latency;        /* Are checkout times tracked? */
+  sb_histogram_t  histogram;      /* Checkout times, including waits */
+} db_pool;
+
+/*
+  Maximum number of distinct statement labels tracked with --db-stmt-stats, or
+  transaction labels passed to db_txn_stat_get(). Each one has its own latency
+  histogram.
+*/
+#define DB_STMT_STATS_MAX 64
+
+/*
+  Statistics of statements with the same label, see --db-stmt-stats. Also used
+  for transactions of the same type, in which case errors are rollbacks.
+*/
+struct db_stmt_stat
+{
+  char            *label;
+  uint64_t        queries;        /* Number of executions */
+  uint64_t        errors;         /* Number of failed executions */
+  uint64_t        time_ns;        /* Total execution time */
+  sb_histogram_t  histogram;      /* Execution times, if percentiles are on */
+};
+
+/* A set of statistics grouped by label, see db_stat_get() */
+typedef struct
+{
+  pthread_mutex_t mutex;
+  db_stmt_stat_t  *stats[DB_STMT_STATS_MAX]; /* In order of creation */
+  unsigned int    nstats;
+  bool            latency;        /* Are histograms used? */
+  bool            overflow;       /* Has DB_STMT_STATS_MAX been exceeded? */
+} db_stat_set_t;
+
+/* Per-statement statistics, see --db-stmt-stats */
+static db_stat_set_t db_stmt_stats;
+
+/* Per-transaction statistics recorded by scripts, see db_txn_stat_get() */
+static db_stat_set_t db_txn_stats;
+
+/* Connection statistics, see --db-connect-stats */
+static struct
+{
+  uint64_t        connects;       /* New connections */
+  uint64_t        resets;         /* Session resets */
+  uint64_t        failures;       /* Failed connects, reconnects and resets */
+  bool            latency;        /* Is the histogram used? */
+  sb_histogram_t  histogram;      /* Times of all successful attempts */
+} db_connect_stats;
+
+/*
+  Connects done before the benchmark starts, i.e. during prepare() and
+  thread_init(), see db_report_rampup()
+*/
+static struct
+{
+  bool            active;         /* Is the ramp-up still in progress? */
+  uint64_t        connects;       /* Successful connects */
+  uint64_t        failures;       /* Failed connects */
+  uint64_t        first_ns;       /* Start of the first connect */
+  uint64_t        last_ns;        /* End of the last connect */
+  bool            latency;        /* Is the histogram used? */
+  sb_histogram_t  histogram;      /* Times of successful connects */
+} db_rampup;
+
+/* Connect pacing, see --db-connect-rate and --db-connect-concurrency */
+static struct
+{
+  uint64_t        interval_ns;    /* Minimum time between connect starts */
+  uint64_t        next_ns;        /* Earliest start time of the next connect */
+  unsigned int    active;         /* Connects in progress */
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+} db_connect_pace;
+
+/* Per-thread start time of the current event, see --db-retry-stats */
+typedef struct
+{
+  uint64_t        start_ns;
+  char            pad[SB_CACHELINE_PAD(sizeof(uint64_t))];
+} db_retry_thread_t;
+
+/* Event retry statistics, see --db-retry-stats */
+static struct
+{
+  uint64_t          events;       /* Completed events */
+  uint64_t          retried;      /* Completed events with more than 1 attempt */
+  uint64_t          retries;      /* Total retries of completed events */
+  db_retry_thread_t *threads;
+  bool              latency;      /* Are histograms used? */
+  /*
+    Times of events done on the first attempt and of retried events, including
+    backoff delays
+  */
+  sb_histogram_t    histograms[2];
+} db_retry_stats;
+
+static const char *db_retry_histogram_names[2] =
+{
+  "first attempt latency (ms):", "retried latency (ms):"
+};
+
+/*
+  Query latency split at the arrival of the first result packet, by statement
+  type, see --db-latency-split
+*/
+static struct
+{
+  uint64_t          queries[3];
+  uint64_t          first_ns[3];    /* Total time to the first result */
+  uint64_t          transfer_ns[3]; /* Total time from the first result */
+  bool              latency;        /* Are histograms used? */
+  sb_histogram_t    histograms[3][2];
+} db_latency_split;
+
+static const char *db_latency_split_names[3] = {"read", "write", "other"};
+
+/* Cursor statistics, see --db-fetch-size */
+static struct
+{
+  uint64_t          queries;      /* Statements executed through cursors */
+  uint64_t          rows;         /* Rows fetched */
+  uint64_t          fetch_ns;     /* Total time from execution to the last row */
+  bool              latency;      /* Is the histogram used? */
+  sb_histogram_t    histogram;    /* Times from execution to the first row */
+} db_cursor_stats;
+
+/*
+  Maximum number of distinct variables tracked with --db-status-query, further
+  ones are ignored
+*/
+#define DB_STATUS_VARS_MAX 64
+
+/* Server status variable sampled with --db-status-query */
+typedef struct
+{
+  char            *name;
+  double          value;          /* Value in the last sample */
+} db_status_var_t;
+
+/*
+  Server status sampling, see db_report_status_intermediate(). Only accessed
+  from the thread printing intermediate reports, except for 'driver'.
+*/
+static struct
+{
+  db_driver_t     *driver;        /* First driver created by the script */
+  db_conn_t       *con;           /* Dedicated connection */
+  db_status_var_t vars[DB_STATUS_VARS_MAX];
+  unsigned int    nvars;
+  bool            disabled;       /* Stop sampling after an error */
+} db_status;
+
 /* Static functions */
 
 static int db_parse_arguments(void);
@@ -68,6 +265,60 @@ static void db_free_row(db_row_t *);
 static int db_bulk_do_insert(db_conn_t *, int);
 static void db_reset_stats(void);
 static int db_free_results_int(db_conn_t *con);
+static db_stmt_stat_t *db_stat_get(db_stat_set_t *set, const char *label,
+                                   const char *what);
+static void db_stat_update(db_stat_set_t *set, db_stmt_stat_t *stat,
+                           uint64_t ns, bool error);
+static void db_stat_set_done(db_stat_set_t *set);
+static void db_report_status_intermediate(sb_stat_t *stat);
+static void db_report_waits_intermediate(sb_stat_t *stat);
+static void db_report_waits_cumulative(sb_stat_t *stat);
+static db_error_t db_traced_execute(db_stmt_t *stmt, db_result_t *rs);
+static void db_slow_log_execute(db_stmt_t *stmt, uint64_t start);
+static db_error_t db_traced_query(db_conn_t *con, const char *query,
+                                  size_t len, db_result_t *rs);
+
+/* Dry run operations, see db_dry_run_driver() */
+
+static int dry_run_init(void);
+static int dry_run_describe(drv_caps_t *);
+static int dry_run_connect(db_conn_t *);
+static int dry_run_disconnect(db_conn_t *);
+static int dry_run_reconnect(db_conn_t *);
+static int dry_run_reset(db_conn_t *);
+static int dry_run_prepare(db_stmt_t *, const char *, size_t);
+static int dry_run_bind(db_stmt_t *, db_bind_t *, size_t);
+static db_error_t dry_run_execute(db_stmt_t *, db_result_t *);
+static int dry_run_fetch(db_result_t *);
+static int dry_run_fetch_row(db_result_t *, db_row_t *);
+static db_error_t dry_run_query(db_conn_t *, const char *, size_t,
+                                db_result_t *);
+static int dry_run_free_results(db_result_t *);
+static int dry_run_close(db_stmt_t *);
+static int dry_run_done(void);
+
+static const drv_ops_t dry_run_ops =
+{
+  .init = dry_run_init,
+  .describe = dry_run_describe,
+  .connect = dry_run_connect,
+  .disconnect = dry_run_disconnect,
+  .reconnect = dry_run_reconnect,
+  .reset = dry_run_reset,
+  .prepare = dry_run_prepare,
+  .bind_param = dry_run_bind,
+  .bind_result = dry_run_bind,
+  .execute = dry_run_execute,
+  .fetch = dry_run_fetch,
+  .fetch_row = dry_run_fetch_row,
+  .free_results = dry_run_free_results,
+  .close = dry_run_close,
+  .query = dry_run_query,
+  .done = dry_run_done
+};
+
+/* Value of every column in fake result sets */
+static const char dry_run_value[] = "1";
 
 /* DB layer arguments */
 
@@ -83,7 +334,89 @@ static sb_arg_t db_args[] =
          STRING),
   SB_OPT("db-ps-mode", "prepared statements usage mode {auto, disable}", "auto",
          STRING),
+  SB_OPT("db-result-mode", "result set retrieval mode {store, stream, "
+         "discard}", "store", STRING),
   SB_OPT("db-debug", "print database-specific debug information", "off", BOOL),
+  SB_OPT("db-pool-size", "maximum number of connections in the connection "
+         "pool shared by all threads, 0 disables pooling", "0", INT),
+  SB_OPT("db-stmt-stats", "report query counts and latency percentiles for "
+         "each prepared statement, grouped by query text or label", "off",
+         BOOL),
+  SB_OPT("db-connect-stats", "report the number of connects and session "
+         "resets along with latency percentiles of connects, reconnects and "
+         "resets, and a summary of connects done before threads start", "off",
+         BOOL),
+  SB_OPT("db-connect-rate", "maximum rate of connects and reconnects per "
+         "second across all threads, 0 for unlimited. Paces the connection "
+         "ramp-up in thread_init() instead of connecting all threads at "
+         "once", "0", INT),
+  SB_OPT("db-connect-concurrency", "maximum number of connects and "
+         "reconnects in progress at the same time, 0 for unlimited", "0",
+         INT),
+  SB_OPT("db-bulk-packet-size", "query length limit for bulk inserts. Must "
+         "not exceed the server limit, e.g. max_allowed_packet for MySQL",
+         "512K", SIZE),
+  SB_OPT("db-status-query", "query returning (name, value) rows of server "
+         "status counters, e.g. 'SHOW GLOBAL STATUS WHERE Variable_name IN "
+         "(...)'. Executed on a dedicated connection with each intermediate "
+         "report to print per-second rates of the counters", "", STRING),
+  SB_OPT("db-wait-sample-rate", "sample wait events of active server "
+         "sessions this many times per second on a dedicated connection and "
+         "report the average number of active sessions and the share of each "
+         "wait class with intermediate and cumulative reports", "0", INT),
+  SB_OPT("db-wait-query", "query returning the wait class of each active "
+         "session, or NULL if it is not waiting, for --db-wait-sample-rate. "
+         "Defaults to a performance_schema query with MySQL and a "
+         "pg_stat_activity query with PostgreSQL", "", STRING),
+  SB_OPT("db-retry-max", "maximum number of attempts to execute an event "
+         "that fails with an ignorable error such as a deadlock, 0 for "
+         "unlimited", "0", INT),
+  SB_OPT("db-retry-backoff", "delay in milliseconds before the first retry "
+         "of a failed event. Doubled with each further attempt up to "
+         "--db-retry-backoff-max, the actual delay is picked at random "
+         "between 0 and that value. 0 retries immediately", "0", INT),
+  SB_OPT("db-retry-backoff-max", "maximum delay in milliseconds between "
+         "retries of a failed event", "1000", INT),
+  SB_OPT("db-retry-stats", "report the number of attempts per transaction "
+         "along with latency percentiles of transactions done on the first "
+         "attempt and of retried ones", "off", BOOL),
+  SB_OPT("db-outage-stats", "report the window in which events failed or "
+         "stalled around the first failed event of the run, e.g. during an "
+         "induced failover, and the time until throughput recovered to "
+         "--db-outage-recovery-pct percent of its level before the outage",
+         "off", BOOL),
+  SB_OPT("db-outage-recovery-pct", "share of the throughput before an "
+         "outage in percent at which --db-outage-stats considers it "
+         "recovered", "90", DOUBLE),
+  SB_OPT("db-outage-resolution", "interval in milliseconds between "
+         "throughput samples of --db-outage-stats", "100", INT),
+  SB_OPT("db-latency-split", "report the time to the first result packet and "
+         "the result transfer time of queries separately for reads, writes "
+         "and other statements. Rows read by fetch calls in "
+         "--db-result-mode=stream are not included", "off", BOOL),
+  SB_OPT("db-fetch-size", "execute prepared statements returning result "
+         "sets through server-side cursors fetching this many rows at a time, "
+         "and report time to first row and row rates. Rows are read and "
+         "dropped. 0 disables cursors", "0", INT),
+  SB_OPT("db-dry-run", "dry run, pretend that all database calls are "
+         "successful without calling the driver", "off", BOOL),
+  SB_OPT("db-dry-run-rows", "number of rows in fake result sets of SELECT "
+         "queries in dry run mode", "1", INT),
+  SB_OPT("db-dry-run-columns", "number of columns in fake result sets of "
+         "SELECT queries in dry run mode", "1", INT),
+  SB_OPT("db-tcp-nodelay", "disable Nagle's algorithm on TCP connections "
+         "(TCP_NODELAY)", "on", BOOL),
+  SB_OPT("db-tcp-quickack", "disable delayed ACKs on TCP connections when "
+         "they are established (TCP_QUICKACK)", "off", BOOL),
+  SB_OPT("db-socket-rcvbuf", "receive buffer size of connection sockets "
+         "(SO_RCVBUF), 0 for the kernel default. Capped by "
+         "net.core.rmem_max", "0", SIZE),
+  SB_OPT("db-socket-sndbuf", "send buffer size of connection sockets "
+         "(SO_SNDBUF), 0 for the kernel default. Capped by "
+         "net.core.wmem_max", "0", SIZE),
+  SB_OPT("db-busy-poll", "time in microseconds to busy poll the device "
+         "queue on blocking reads from connection sockets (SO_BUSY_POLL), "
+         "0 to disable", "0", INT),
 
   SB_OPT_END
 };
@@ -103,6 +436,10 @@ int db_register(void)
 #ifdef USE_PGSQL
   register_driver_pgsql(&drivers);
 #endif
+#ifdef USE_SQLITE
+  register_driver_sqlite(&drivers);
+#endif
+  register_driver_mock(&drivers);
 
   /* Register command line options for each driver */
   SB_LIST_FOR_EACH(pos, &drivers)
@@ -187,6 +524,98 @@ static void db_init(void)
     fetch_timers = sb_alloc_per_thread_array(sizeof(sb_timer_t));
   }
 
+  if (db_globals.pool_size > 0)
+  {
+    db_pool.conns = calloc(db_globals.pool_size, sizeof(db_conn_t *));
+    db_pool.idle = calloc(db_globals.pool_size, sizeof(db_conn_t *));
+    if (db_pool.conns == NULL || db_pool.idle == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return;
+    }
+
+    pthread_mutex_init(&db_pool.mutex, NULL);
+    pthread_cond_init(&db_pool.cond, NULL);
+
+    if (sb_globals.npercentiles > 0)
+    {
+      if (oper_histogram_init(&db_pool.histogram))
+        return;
+      db_pool.latency = true;
+    }
+  }
+
+  if (db_globals.stmt_stats)
+  {
+    pthread_mutex_init(&db_stmt_stats.mutex, NULL);
+    db_stmt_stats.latency = sb_globals.npercentiles > 0;
+  }
+
+  pthread_mutex_init(&db_txn_stats.mutex, NULL);
+  db_txn_stats.latency = sb_globals.npercentiles > 0;
+
+  if (db_globals.connect_stats && sb_globals.npercentiles > 0)
+  {
+    if (oper_histogram_init(&db_connect_stats.histogram))
+      return;
+    db_connect_stats.latency = true;
+  }
+
+  if (db_globals.connect_stats)
+  {
+    if (sb_globals.npercentiles > 0)
+    {
+      if (oper_histogram_init(&db_rampup.histogram))
+        return;
+      db_rampup.latency = true;
+    }
+    db_rampup.active = true;
+  }
+
+  if (db_globals.connect_rate > 0)
+    db_connect_pace.interval_ns = NS_PER_SEC / db_globals.connect_rate;
+
+  if (db_globals.connect_concurrency > 0)
+  {
+    pthread_mutex_init(&db_connect_pace.mutex, NULL);
+    pthread_cond_init(&db_connect_pace.cond, NULL);
+  }
+
+  if (db_globals.retry_stats)
+  {
+    db_retry_stats.threads =
+      sb_alloc_per_thread_array(sizeof(db_retry_thread_t));
+    if (db_retry_stats.threads == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return;
+    }
+
+    if (sb_globals.npercentiles > 0)
+    {
+      if (oper_histogram_init(&db_retry_stats.histograms[0]) ||
+          oper_histogram_init(&db_retry_stats.histograms[1]))
+        return;
+      db_retry_stats.latency = true;
+    }
+  }
+
+  if (db_globals.latency_split && sb_globals.npercentiles > 0)
+  {
+    for (unsigned int i = 0; i < 3; i++)
+      if (oper_histogram_init(&db_latency_split.histograms[i][0]) ||
+          oper_histogram_init(&db_latency_split.histograms[i][1]))
+        return;
+    db_latency_split.latency = true;
+  }
+
+  if (db_globals.fetch_size > 0 && sb_globals.npercentiles > 0)
+  {
+    if (oper_histogram_init(&db_cursor_stats.histogram))
+      return;
+    db_cursor_stats.latency = true;
+  }
+
   db_reset_stats();
 
   enable_print_stats();
@@ -213,11 +642,30 @@ db_driver_t *db_create(const char *name)
 
   if (name == NULL && db_globals.driver == NULL)
   {
-    drv = SB_LIST_ENTRY(SB_LIST_ITEM_NEXT(&drivers), db_driver_t, listitem);
-    /* Is it the only driver available? */
-    if (SB_LIST_ITEM_NEXT(&(drv->listitem)) ==
-        SB_LIST_ITEM_PREV(&(drv->listitem)))
+    unsigned int ndrivers = 0;
+
+    /*
+      Is it the only driver available? The mock driver is always compiled in,
+      so it is only used when requested explicitly
+    */
+    SB_LIST_FOR_EACH(pos, &drivers)
+    {
+      tmp = SB_LIST_ENTRY(pos, db_driver_t, listitem);
+      if (strcmp(tmp->sname, "mock"))
+      {
+        drv = tmp;
+        ndrivers++;
+      }
+    }
+
+    if (ndrivers == 1)
       log_text(LOG_INFO, "No DB drivers specified, using %s", drv->sname);
+    else if (ndrivers == 0)
+    {
+      log_text(LOG_FATAL, "No DB drivers available. "
+               "Use --db-driver=mock to simulate one");
+      goto err;
+    }
     else
     {
       log_text(LOG_FATAL, "Multiple DB drivers are available. "
@@ -251,6 +699,10 @@ db_driver_t *db_create(const char *name)
   pthread_mutex_lock(&drv->mutex);
   if (!drv->initialized)
   {
+    /* The driver itself is never initialized in dry run mode */
+    if (db_globals.dry_run)
+      db_dry_run_driver(drv);
+
     if (drv->ops.init())
     {
       pthread_mutex_unlock(&drv->mutex);
@@ -260,6 +712,10 @@ db_driver_t *db_create(const char *name)
   }
   pthread_mutex_unlock(&drv->mutex);
 
+  /* Server status and waits are sampled with the first used driver */
+  if (ck_pr_cas_ptr(&db_status.driver, NULL, drv) && db_waits_start(drv))
+    goto err;
+
   if (drv->ops.thread_init != NULL && drv->ops.thread_init(sb_tls_thread_id))
   {
     log_text(LOG_FATAL, "thread-local driver initialization failed.");
@@ -293,6 +749,255 @@ int db_describe(db_driver_t *drv, drv_caps_t *caps)
 }
 
 
+/*
+  Account a connect, reconnect or session reset started at 'start' (see
+  sb_usage_clock()) in the --db-connect-stats statistics
+*/
+
+static void db_connect_stat_add(uint64_t *counter, uint64_t start, bool failed)
+{
+  if (!db_globals.connect_stats)
+    return;
+
+  if (failed)
+  {
+    ck_pr_inc_64(&db_connect_stats.failures);
+    return;
+  }
+
+  if (counter != NULL)
+    ck_pr_inc_64(counter);
+
+  if (db_connect_stats.latency)
+    sb_histogram_update(&db_connect_stats.histogram,
+                        NS2MS(sb_usage_clock() - start));
+}
+
+
+/* Account a connect in the ramp-up statistics, see db_report_rampup() */
+
+static void db_rampup_add(uint64_t start, bool failed)
+{
+  const uint64_t end = sb_usage_clock();
+  uint64_t       cur;
+
+  /* db_report_rampup() runs while worker threads wait on a barrier */
+  if (!db_rampup.active)
+    return;
+
+  cur = ck_pr_load_64(&db_rampup.first_ns);
+  while ((cur == 0 || start < cur) &&
+         !ck_pr_cas_64_value(&db_rampup.first_ns, cur, start, &cur))
+    ;
+
+  cur = ck_pr_load_64(&db_rampup.last_ns);
+  while (end > cur && !ck_pr_cas_64_value(&db_rampup.last_ns, cur, end, &cur))
+    ;
+
+  if (failed)
+  {
+    ck_pr_inc_64(&db_rampup.failures);
+    return;
+  }
+
+  ck_pr_inc_64(&db_rampup.connects);
+
+  if (db_rampup.latency)
+    sb_histogram_update(&db_rampup.histogram, NS2MS(end - start));
+}
+
+
+/*
+  Wait until a connect or reconnect may start according to --db-connect-rate
+  and --db-connect-concurrency. Must be paired with db_connect_release().
+*/
+
+static void db_connect_acquire(void)
+{
+  if (db_connect_pace.interval_ns > 0)
+  {
+    /* Reserve the next free slot, starting from now if the schedule lags */
+    const uint64_t now = sb_usage_clock();
+    uint64_t       next = ck_pr_load_64(&db_connect_pace.next_ns);
+    uint64_t       slot;
+
+    do
+    {
+      slot = next > now ? next : now;
+    } while (!ck_pr_cas_64_value(&db_connect_pace.next_ns, next,
+                                 slot + db_connect_pace.interval_ns, &next));
+
+    if (slot > now)
+      sb_nanosleep(slot - now);
+  }
+
+  if (db_globals.connect_concurrency > 0)
+  {
+    pthread_mutex_lock(&db_connect_pace.mutex);
+    while (db_connect_pace.active >= db_globals.connect_concurrency)
+      pthread_cond_wait(&db_connect_pace.cond, &db_connect_pace.mutex);
+    db_connect_pace.active++;
+    pthread_mutex_unlock(&db_connect_pace.mutex);
+  }
+}
+
+
+static void db_connect_release(void)
+{
+  if (db_globals.connect_concurrency > 0)
+  {
+    pthread_mutex_lock(&db_connect_pace.mutex);
+    db_connect_pace.active--;
+    pthread_cond_signal(&db_connect_pace.cond);
+    pthread_mutex_unlock(&db_connect_pace.mutex);
+  }
+}
+
+
+/*
+  Called by thread_run() after a failed attempt number 'attempt' of the current
+  event. Returns false if the event must not be retried because of
+  --db-retry-max, otherwise waits for the --db-retry-backoff delay and returns
+  true. Retries are immediate and unlimited if database support has not been
+  initialized, i.e. the restart was requested by a script without SQL calls.
+*/
+
+bool db_retry_wait(int thread_id, unsigned int attempt)
+{
+  uint64_t delay;
+
+  if (!db_global_initialized)
+    return true;
+
+  if (db_globals.outage_stats)
+    db_outage_error();
+
+  if (db_globals.retry_max > 0 && attempt >= db_globals.retry_max)
+    return false;
+
+  if (sb_slow_log_enabled())
+    sb_slow_log_retry(thread_id, attempt);
+
+  if (db_globals.retry_backoff_ns == 0)
+    return true;
+
+  /* Exponential backoff with full jitter, avoiding shift overflows */
+  delay = db_globals.retry_backoff_max_ns;
+  if (attempt <= 32 && (db_globals.retry_backoff_ns << (attempt - 1)) <
+      db_globals.retry_backoff_max_ns)
+    delay = db_globals.retry_backoff_ns << (attempt - 1);
+
+  sb_nanosleep((uint64_t) (sb_rand_uniform_double() * delay));
+
+  return true;
+}
+
+
+bool db_retry_stats_enabled(void)
+{
+  return db_global_initialized && db_globals.retry_stats;
+}
+
+
+/* Mark the start of an event for --db-retry-stats */
+
+void db_retry_event_start(int thread_id)
+{
+  db_retry_stats.threads[thread_id].start_ns = sb_usage_clock();
+}
+
+
+/* Account an event completed after 'attempts' attempts in --db-retry-stats */
+
+void db_retry_event_stop(int thread_id, unsigned int attempts)
+{
+  const uint64_t ns = sb_usage_clock() -
+    db_retry_stats.threads[thread_id].start_ns;
+
+  /* Events of background threads are excluded like other statistics */
+  if (thread_id >= (int) sb_globals.threads)
+    return;
+
+  ck_pr_inc_64(&db_retry_stats.events);
+
+  if (attempts > 1)
+  {
+    ck_pr_inc_64(&db_retry_stats.retried);
+    ck_pr_add_64(&db_retry_stats.retries, attempts - 1);
+  }
+
+  if (db_retry_stats.latency)
+    sb_histogram_update(&db_retry_stats.histograms[attempts > 1], NS2MS(ns));
+}
+
+
+void db_first_result(db_conn_t *con)
+{
+  if (db_globals.latency_split && con->first_result_ns == 0)
+    con->first_result_ns = sb_usage_clock();
+}
+
+
+/* Account a query started at 'start' in --db-latency-split */
+
+static void db_latency_split_update(db_conn_t *con, uint64_t start)
+{
+  const uint64_t end = sb_usage_clock();
+  unsigned int   i;
+
+  switch (con->rs.counter) {
+  case SB_CNT_READ:
+    i = 0;
+    break;
+  case SB_CNT_WRITE:
+    i = 1;
+    break;
+  case SB_CNT_OTHER:
+    i = 2;
+    break;
+  default:
+    /* Failed queries are not accounted */
+    return;
+  }
+
+  /* Drivers not marking the first result transfer nothing after it */
+  const uint64_t first = (con->first_result_ns != 0) ?
+    con->first_result_ns : end;
+
+  /* Queries of background threads are excluded like other statistics */
+  if (con->thread_id >= (int) sb_globals.threads)
+    return;
+
+  ck_pr_inc_64(&db_latency_split.queries[i]);
+  ck_pr_add_64(&db_latency_split.first_ns[i], first - start);
+  ck_pr_add_64(&db_latency_split.transfer_ns[i], end - first);
+
+  if (db_latency_split.latency)
+  {
+    sb_histogram_update(&db_latency_split.histograms[i][0],
+                        NS2MS(first - start));
+    sb_histogram_update(&db_latency_split.histograms[i][1],
+                        NS2MS(end - first));
+  }
+}
+
+
+void db_cursor_stats_add(db_conn_t *con, uint64_t first_row_ns,
+                         uint64_t total_ns, uint64_t rows)
+{
+  /* Queries of background threads are excluded like other statistics */
+  if (con->thread_id >= (int) sb_globals.threads)
+    return;
+
+  ck_pr_inc_64(&db_cursor_stats.queries);
+  ck_pr_add_64(&db_cursor_stats.rows, rows);
+  ck_pr_add_64(&db_cursor_stats.fetch_ns, total_ns);
+
+  if (db_cursor_stats.latency)
+    sb_histogram_update(&db_cursor_stats.histogram, NS2MS(first_row_ns));
+}
+
+
 /* Connect to database */
 
 
@@ -311,7 +1016,22 @@ db_conn_t *db_connection_create(db_driver_t *drv)
 
   con->thread_id =  sb_tls_thread_id;
 
-  if (drv->ops.connect(con))
+  /* Pacing delays are not included in connect times */
+  db_connect_acquire();
+
+  SB_PROBE1(connect__start, con->thread_id);
+
+  const uint64_t start = sb_usage_clock();
+  const int      rc = drv->ops.connect(con);
+
+  SB_PROBE2(connect__done, con->thread_id, rc);
+
+  db_connect_release();
+
+  db_connect_stat_add(&db_connect_stats.connects, start, rc != 0);
+  db_rampup_add(start, rc != 0);
+
+  if (rc)
   {
     free(con);
     return NULL;
@@ -369,8 +1089,21 @@ int db_connection_reconnect(db_conn_t *con)
     db_free_results_int(con);
   }
 
+  db_connect_acquire();
+
+  SB_PROBE1(reconnect__start, con->thread_id);
+
+  const uint64_t start = sb_usage_clock();
+
   rc = drv->ops.reconnect(con);
 
+  SB_PROBE2(reconnect__done, con->thread_id, rc);
+
+  db_connect_release();
+
+  /* Reconnects are counted in SB_CNT_RECONNECT */
+  db_connect_stat_add(NULL, start, rc == DB_ERROR_FATAL);
+
   if (rc == DB_ERROR_FATAL)
   {
     con->state = DB_CONN_INVALID;
@@ -388,581 +1121,3445 @@ int db_connection_reconnect(db_conn_t *con)
   return rc;
 }
 
-/* Disconnect and release memory allocated by a connection object */
+/*
+  Reset session state of a connection without reconnecting, e.g. the way
+  connection pools do before reusing a connection. Server-side prepared
+  statements may be lost and must be prepared again.
+*/
 
-void db_connection_free(db_conn_t *con)
+int db_connection_reset(db_conn_t *con)
 {
-  if (con->state != DB_CONN_INVALID)
-    db_connection_close(con);
-
-  free(con);
-}
-
-
-/* Prepare statement */
-
+  int         rc;
+  db_driver_t *drv = con->driver;
 
-db_stmt_t *db_prepare(db_conn_t *con, const char *query, size_t len)
-{
-  db_stmt_t *stmt;
+  if (drv->ops.reset == NULL)
+  {
+    log_text(LOG_ALERT, "session reset is not supported by the current driver");
+    return 1;
+  }
 
   if (con->state == DB_CONN_INVALID)
   {
     log_text(LOG_ALERT, "attempt to use an already closed connection");
-    return NULL;
+    return 1;
   }
-
-  stmt = (db_stmt_t *)calloc(1, sizeof(db_stmt_t));
-  if (stmt == NULL)
-    return NULL;
-
-  stmt->connection = con;
-
-  if (con->driver->ops.prepare(stmt, query, len))
+  else if (con->state == DB_CONN_ASYNC || con->state == DB_CONN_PIPELINE)
   {
-    con->error = DB_ERROR_FATAL;
-    free(stmt);
-    return NULL;
+    log_text(LOG_ALERT, "attempt to reset a connection with queries in "
+             "progress");
+    return 1;
+  }
+  else if (con->state == DB_CONN_RESULT_SET)
+  {
+    db_free_results_int(con);
   }
 
-  return stmt;
-}
-
-
-/* Bind parameters for prepared statement */
+  const uint64_t start = sb_usage_clock();
 
+  rc = drv->ops.reset(con);
 
-int db_bind_param(db_stmt_t *stmt, db_bind_t *params, size_t len)
-{
-  db_conn_t *con = stmt->connection;
+  db_connect_stat_add(&db_connect_stats.resets, start, rc != 0);
 
-  if (con->state == DB_CONN_INVALID)
+  if (rc)
   {
-    log_text(LOG_ALERT, "attempt to use an already closed connection");
-    return 1;
+    con->state = DB_CONN_INVALID;
+    sb_counter_inc(con->thread_id, SB_CNT_ERROR);
   }
+  else
+    con->state = DB_CONN_READY;
 
-  return con->driver->ops.bind_param(stmt, params, len);
+  return rc;
 }
 
+/* Disconnect and release memory allocated by a connection object */
 
-/* Bind results for prepared statement */
+void db_connection_free(db_conn_t *con)
+{
+  if (con->state != DB_CONN_INVALID)
+    db_connection_close(con);
 
+  free(con->rs.row.values);
+  free(con->query_buf);
+  free(con);
+}
 
-int db_bind_result(db_stmt_t *stmt, db_bind_t *results, size_t len)
+
+db_conn_t *db_pool_checkout(db_driver_t *drv)
 {
-  db_conn_t *con = stmt->connection;
+  struct timespec start, end;
+  db_conn_t       *con;
+  bool            waited = false;
 
-  if (con->state == DB_CONN_INVALID)
+  if (db_globals.pool_size == 0)
   {
-    log_text(LOG_ALERT, "attempt to use an already closed connection");
-    return 1;
+    log_text(LOG_FATAL, "connection pooling is disabled, use --db-pool-size "
+             "to enable it");
+    return NULL;
   }
 
-  return con->driver->ops.bind_result(stmt, results, len);
-}
-
-
-/* Execute prepared statement */
-
+  SB_GETTIME(&start);
 
-db_result_t *db_execute(db_stmt_t *stmt)
-{
-  db_conn_t       *con = stmt->connection;
-  db_result_t     *rs = &con->rs;
-  int             rc;
+  pthread_mutex_lock(&db_pool.mutex);
 
-  if (con->state == DB_CONN_INVALID)
+  if (db_pool.driver == NULL)
+    db_pool.driver = drv;
+  else if (db_pool.driver != drv)
   {
-    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    pthread_mutex_unlock(&db_pool.mutex);
+    log_text(LOG_FATAL, "all pooled connections must use the same driver");
     return NULL;
   }
-  else if (con->state == DB_CONN_RESULT_SET &&
-           (rc = db_free_results_int(con)) != 0)
+
+  while (db_pool.nidle == 0 &&
+         db_pool.nconns + db_pool.ncreating >= db_globals.pool_size)
   {
-    return NULL;
+    waited = true;
+    db_pool.nwaiting++;
+    pthread_cond_wait(&db_pool.cond, &db_pool.mutex);
+    db_pool.nwaiting--;
   }
 
-  rs->statement = stmt;
+  if (db_pool.nidle > 0)
+    con = db_pool.idle[--db_pool.nidle];
+  else
+  {
+    /* Do not block other checkouts while connecting */
+    db_pool.ncreating++;
+    pthread_mutex_unlock(&db_pool.mutex);
 
-  con->error = con->driver->ops.execute(stmt, rs);
+    con = db_connection_create(drv);
 
-  sb_counter_inc(con->thread_id, rs->counter);
+    pthread_mutex_lock(&db_pool.mutex);
+    db_pool.ncreating--;
 
-  if (SB_LIKELY(con->error == DB_ERROR_NONE))
-  {
-    if (rs->counter == SB_CNT_READ)
+    if (con == NULL)
     {
-      con->state = DB_CONN_RESULT_SET;
-      return rs;
+      /* Let another thread try */
+      pthread_cond_signal(&db_pool.cond);
+      pthread_mutex_unlock(&db_pool.mutex);
+      return NULL;
     }
-    con->state = DB_CONN_READY;
 
-    return NULL;
+    db_pool.conns[db_pool.nconns++] = con;
   }
 
-  return NULL;
-}
-
+  con->pooled = POOL_CONN_BUSY;
 
-/* Fetch row from result set of a query */
+  db_pool.checkouts++;
+  db_pool.waits += waited;
 
+  pthread_mutex_unlock(&db_pool.mutex);
 
-db_row_t *db_fetch_row(db_result_t *rs)
-{
-  db_conn_t *con = SB_CONTAINER_OF(rs, db_conn_t, rs);
+  /* Account queries to the thread using the connection */
+  con->thread_id = sb_tls_thread_id;
 
-  if (con->state == DB_CONN_INVALID)
-  {
-    log_text(LOG_ALERT, "attempt to use an already closed connection");
-    return NULL;
-  }
-  else if (con->state != DB_CONN_RESULT_SET)
+  if (db_pool.latency)
   {
-    log_text(LOG_ALERT, "attempt to fetch row from an invalid result set");
-    return NULL;
+    SB_GETTIME(&end);
+    sb_histogram_update(&db_pool.histogram, NS2MS(TIMESPEC_DIFF(end, start)));
   }
 
-  if (con->driver->ops.fetch_row == NULL)
+  return con;
+}
+
+
+int db_pool_return(db_conn_t *con)
+{
+  if (con->pooled != POOL_CONN_BUSY)
   {
-    log_text(LOG_ALERT, "fetching rows is not supported by the driver");
+    log_text(LOG_ALERT, "attempt to return a connection which is not checked "
+             "out from the pool");
+    return 1;
   }
 
-  if (rs->nrows == 0 || rs->nfields == 0)
+  if (con->state == DB_CONN_ASYNC || con->state == DB_CONN_PIPELINE)
   {
-    log_text(LOG_ALERT, "attempt to fetch row from an empty result set");
-    return NULL;
+    log_text(LOG_ALERT, "attempt to return a connection with queries in "
+             "progress to the pool");
+    return 1;
   }
+  else if (con->state == DB_CONN_RESULT_SET)
+    db_free_results_int(con);
+
+  pthread_mutex_lock(&db_pool.mutex);
 
-  if (rs->row.values == NULL)
+  if (con->state == DB_CONN_INVALID)
   {
-    rs->row.values = malloc(rs->nfields * sizeof(db_value_t));
+    /* Closed connections are dropped, so a new one can be created */
+    for (unsigned int i = 0; i < db_pool.nconns; i++)
+    {
+      if (db_pool.conns[i] == con)
+      {
+        db_pool.conns[i] = db_pool.conns[--db_pool.nconns];
+        break;
+      }
+    }
   }
-
-  if (con->driver->ops.fetch_row(rs, &rs->row))
+  else
   {
-    return NULL;
+    con->pooled = POOL_CONN_IDLE;
+    db_pool.idle[db_pool.nidle++] = con;
   }
 
-  return &rs->row;
+  pthread_cond_signal(&db_pool.cond);
+  pthread_mutex_unlock(&db_pool.mutex);
+
+  if (con->state == DB_CONN_INVALID)
+    db_connection_free(con);
+
+  return 0;
 }
 
 
-/* Execute non-prepared statement */
+/* Prepare statement */
 
 
-db_result_t *db_query(db_conn_t *con, const char *query, size_t len)
+db_stmt_t *db_prepare(db_conn_t *con, const char *query, size_t len)
 {
-  db_result_t *rs = &con->rs;
-  int         rc;
+  db_stmt_t *stmt;
 
   if (con->state == DB_CONN_INVALID)
   {
     log_text(LOG_ALERT, "attempt to use an already closed connection");
-    con->error = DB_ERROR_FATAL;
     return NULL;
   }
-  else if (con->state == DB_CONN_RESULT_SET &&
-           (rc = db_free_results_int(con)) != 0)
+
+  stmt = (db_stmt_t *)calloc(1, sizeof(db_stmt_t));
+  if (stmt == NULL)
+    return NULL;
+
+  stmt->connection = con;
+
+  if (con->driver->ops.prepare(stmt, query, len))
   {
     con->error = DB_ERROR_FATAL;
+    free(stmt);
     return NULL;
   }
 
-  con->error = con->driver->ops.query(con, query, len, rs);
-
-  sb_counter_inc(con->thread_id, rs->counter);
+  /*
+    Statements of traced events are sent as queries, see db_execute(), and
+    statements of slow events are logged with their parameters
+  */
+  if (sb_tracectx_enabled() || sb_slow_log_enabled())
+  {
+    stmt->trace_query = strndup(query, len);
+    if (stmt->trace_query == NULL)
+      log_text(LOG_FATAL, "Memory allocation failure");
+  }
 
-  if (SB_LIKELY(con->error == DB_ERROR_NONE))
+  /* Statements are grouped by query text until a label is assigned */
+  if (db_globals.stmt_stats)
   {
-    if (rs->counter == SB_CNT_READ)
+    char *label = strndup(query, len);
+
+    if (label == NULL)
     {
-      con->state = DB_CONN_RESULT_SET;
-      return rs;
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return stmt;
     }
-    con->state = DB_CONN_READY;
 
-    return NULL;
+    stmt->stat = db_stat_get(&db_stmt_stats, label, "statements");
+    free(label);
   }
 
-  return NULL;
+  return stmt;
 }
 
 
-/* Free result set */
+/*
+  Find statistics for a given label in a set, creating them if necessary.
+  Returns NULL if there are too many distinct labels. 'what' names the labeled
+  objects in the warning.
+*/
 
 
-static int db_free_results_int(db_conn_t *con)
+static db_stmt_stat_t *db_stat_get(db_stat_set_t *set, const char *label,
+                                   const char *what)
 {
-  int       rc;
+  db_stmt_stat_t *stat = NULL;
+  unsigned int   i;
 
-  rc = con->driver->ops.free_results(&con->rs);
+  pthread_mutex_lock(&set->mutex);
 
-  if (con->rs.row.values != NULL)
+  for (i = 0; i < set->nstats; i++)
   {
-    free(con->rs.row.values);
-    con->rs.row.values = NULL;
+    if (!strcmp(set->stats[i]->label, label))
+    {
+      stat = set->stats[i];
+      goto end;
+    }
   }
 
-  con->rs.nrows = 0;
-  con->rs.nfields = 0;
+  if (set->nstats == DB_STMT_STATS_MAX)
+  {
+    if (!set->overflow)
+      log_text(LOG_WARNING, "more than %d distinct %s, statistics are "
+               "not collected for the rest. Use labels to group %s",
+               DB_STMT_STATS_MAX, what, what);
+    set->overflow = true;
+    goto end;
+  }
 
-  con->rs.statement = NULL;
+  stat = calloc(1, sizeof(db_stmt_stat_t));
+  if (stat == NULL || (stat->label = strdup(label)) == NULL ||
+      (set->latency && oper_histogram_init(&stat->histogram)))
+  {
+    log_text(LOG_FATAL, "Failed to allocate %s statistics", what);
+    if (stat != NULL)
+      free(stat->label);
+    free(stat);
+    stat = NULL;
+    goto end;
+  }
 
-  con->state = DB_CONN_READY;
+  set->stats[set->nstats++] = stat;
 
-  return rc;
+end:
+  pthread_mutex_unlock(&set->mutex);
+
+  return stat;
 }
 
-int db_free_results(db_result_t *rs)
+
+/* Account a single execution taking 'ns' nanoseconds */
+
+
+static void db_stat_update(db_stat_set_t *set, db_stmt_stat_t *stat,
+                           uint64_t ns, bool error)
 {
-  db_conn_t * const con = SB_CONTAINER_OF(rs, db_conn_t, rs);
+  ck_pr_inc_64(&stat->queries);
+  ck_pr_add_64(&stat->time_ns, ns);
+  if (error)
+    ck_pr_inc_64(&stat->errors);
+  if (set->latency)
+    sb_histogram_update(&stat->histogram, NS2MS(ns));
+}
 
-  if (con->state == DB_CONN_INVALID)
+
+/* Free all statistics in a set */
+
+
+static void db_stat_set_done(db_stat_set_t *set)
+{
+  for (unsigned int i = 0; i < set->nstats; i++)
   {
-    log_text(LOG_ALERT, "attempt to use an already closed connection");
-    return 1;
+    db_stmt_stat_t * const stat = set->stats[i];
+
+    if (set->latency)
+      sb_histogram_done(&stat->histogram);
+    free(stat->label);
+    free(stat);
   }
-  else if (con->state != DB_CONN_RESULT_SET)
+
+  pthread_mutex_destroy(&set->mutex);
+
+  memset(set, 0, sizeof(*set));
+}
+
+
+/*
+  Get statistics for a given transaction type, e.g. "NewOrder" in a TPC-C-like
+  workload, creating them if necessary. Scripts time transactions themselves
+  with db_txn_stat_start() / db_txn_stat_stop(), and the results are reported
+  separately for each type. Must be called after a driver has been created.
+  Returns NULL on errors.
+*/
+
+
+db_stmt_stat_t *db_txn_stat_get(const char *label)
+{
+  if (!db_global_initialized)
   {
-    log_text(LOG_ALERT, "attempt to free an invalid result set");
-    return 1;
+    log_text(LOG_FATAL, "transaction statistics require a database driver");
+    return NULL;
   }
 
-  return db_free_results_int(con);
+  return db_stat_get(&db_txn_stats, label, "transactions");
 }
 
-/* Close prepared statement */
 
+/* Get the start time of a transaction to pass to db_txn_stat_stop() */
 
-int db_close(db_stmt_t *stmt)
+
+uint64_t db_txn_stat_start(void)
 {
-  int       rc;
-  db_conn_t *con = stmt->connection;
+  return sb_usage_clock();
+}
 
-  if (con->state == DB_CONN_INVALID)
-  {
-    log_text(LOG_ALERT, "attempt to use an already closed connection");
-    return 0;
-  }
-  else if (con->state == DB_CONN_RESULT_SET &&
-           (rc = db_free_results_int(con)) != 0)
-  {
-    return DB_ERROR_FATAL;
-  }
 
-  if (con->state == DB_CONN_INVALID)
-  {
-    log_text(LOG_ALERT, "attempt to use an already closed connection");
-    return 0;
-  }
-  else if (con->state == DB_CONN_RESULT_SET && con->rs.statement == stmt &&
-           (rc = db_free_results_int(con)) != 0)
-  {
-    return 0;
-  }
+/*
+  Account a transaction started at 'start', as returned by db_txn_stat_start().
+  'rolled_back' is true for transactions that did not commit.
+*/
 
-  rc = con->driver->ops.close(stmt);
 
-  if (stmt->query != NULL)
-  {
-    free(stmt->query);
-    stmt->query = NULL;
-  }
-  if (stmt->bound_param != NULL)
-  {
-    free(stmt->bound_param);
-    stmt->bound_param = NULL;
-  }
-  free(stmt);
+void db_txn_stat_stop(db_stmt_stat_t *stat, uint64_t start, bool rolled_back)
+{
+  if (stat == NULL)
+    return;
 
-  return rc;
+  db_stat_update(&db_txn_stats, stat, sb_usage_clock() - start, rolled_back);
 }
 
-/* Uninitialize DB API */
 
-void db_done(void)
+/*
+  Get --db-stmt-stats statistics for a given label of queries that scripts time
+  themselves, e.g. queries executed with db_query() and grouped by their
+  fingerprints. Returns NULL if --db-stmt-stats is off or on errors.
+*/
+
+
+db_stmt_stat_t *db_query_stat_get(const char *label)
 {
-  sb_list_item_t *pos;
-  db_driver_t    *drv;
+  if (!db_global_initialized || !db_globals.stmt_stats)
+    return NULL;
+
+  return db_stat_get(&db_stmt_stats, label, "statements");
+}
+
+
+/* Account a query started at 'start', as returned by db_txn_stat_start() */
+
+
+void db_query_stat_stop(db_stmt_stat_t *stat, uint64_t start, bool error)
+{
+  if (stat == NULL)
+    return;
+
+  db_stat_update(&db_stmt_stats, stat, sb_usage_clock() - start, error);
+}
+
+
+/*
+  Set the label used to group prepared statements in --db-stmt-stats reports,
+  e.g. to report the same query against different tables together
+*/
+
+
+int db_stmt_set_label(db_stmt_t *stmt, const char *label)
+{
+  if (!db_globals.stmt_stats)
+    return 0;
+
+  stmt->stat = db_stat_get(&db_stmt_stats, label, "statements");
+
+  return 0;
+}
+
+
+/* Bind parameters for prepared statement */
+
+
+int db_bind_param(db_stmt_t *stmt, db_bind_t *params, size_t len)
+{
+  db_conn_t *con = stmt->connection;
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    return 1;
+  }
+
+  db_bind_t * const copy = realloc(stmt->param, len * sizeof(db_bind_t));
+
+  if (copy == NULL && len > 0)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  memcpy(copy, params, len * sizeof(db_bind_t));
+  stmt->param = copy;
+  stmt->param_len = (unsigned int) len;
+
+  /* Rows added for previous parameters do not match the new ones */
+  stmt->batch.nrows = 0;
+  stmt->batch.data_len = 0;
+  stmt->batch.nparams = (unsigned int) len;
+  stmt->batch.values_rows = 0;
+
+  return con->driver->ops.bind_param(stmt, params, len);
+}
+
+
+/* Size of a parameter value stored in a batch */
+
+static unsigned long batch_value_size(const db_bind_t *param)
+{
+  switch (param->type) {
+  case DB_TYPE_TINYINT:
+    return 1;
+  case DB_TYPE_SMALLINT:
+    return 2;
+  case DB_TYPE_INT:
+  case DB_TYPE_FLOAT:
+    return 4;
+  case DB_TYPE_BIGINT:
+  case DB_TYPE_DOUBLE:
+    return 8;
+  case DB_TYPE_TIME:
+  case DB_TYPE_DATE:
+  case DB_TYPE_DATETIME:
+  case DB_TYPE_TIMESTAMP:
+    return sizeof(db_time_t);
+  case DB_TYPE_CHAR:
+  case DB_TYPE_VARCHAR:
+    return SB_MIN(*param->data_len, param->max_len);
+  default:
+    return 0;
+  }
+}
+
+
+/* Add the current values of bound parameters to the statement batch */
+
+
+int db_batch_add(db_stmt_t *stmt)
+{
+  db_batch_t * const b = &stmt->batch;
+
+  if (stmt->param == NULL)
+  {
+    log_text(LOG_ALERT, "attempt to add a batch row to a statement without "
+             "bound parameters");
+    return 1;
+  }
+
+  if (b->nrows == b->values_rows)
+  {
+    const unsigned int     rows = b->values_rows > 0 ? b->values_rows * 2 : 16;
+    db_batch_value_t * const values =
+      realloc(b->values, (size_t) rows * b->nparams * sizeof(*values));
+
+    if (values == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+
+    b->values = values;
+    b->values_rows = rows;
+  }
+
+  db_batch_value_t * const row = b->values + (size_t) b->nrows * b->nparams;
+
+  for (unsigned int i = 0; i < b->nparams; i++)
+  {
+    const db_bind_t * const param = &stmt->param[i];
+    db_batch_value_t * const v = &row[i];
+
+    v->is_null = param->is_null != NULL && *param->is_null;
+    v->offset = b->data_len;
+    v->len = 0;
+
+    if (v->is_null)
+      continue;
+
+    /* BLOB values are generated when they are sent */
+    if (param->type == DB_TYPE_BLOB)
+    {
+      v->len = *param->data_len;
+      continue;
+    }
+
+    v->len = batch_value_size(param);
+
+    if (b->data_len + v->len > b->data_size)
+    {
+      size_t size = b->data_size > 0 ? b->data_size : 1024;
+
+      while (size < b->data_len + v->len)
+        size *= 2;
+
+      char * const data = realloc(b->data, size);
+
+      if (data == NULL)
+      {
+        log_text(LOG_FATAL, "Memory allocation failure");
+        return 1;
+      }
+
+      b->data = data;
+      b->data_size = size;
+    }
+
+    memcpy(b->data + b->data_len, param->buffer, v->len);
+    b->data_len += v->len;
+  }
+
+  b->nrows++;
+
+  return 0;
+}
+
+
+/* Copy values of a batch row to the bound parameters */
+
+
+void db_batch_row(db_stmt_t *stmt, unsigned int n)
+{
+  const db_batch_t       * const b = &stmt->batch;
+  const db_batch_value_t * const row = b->values + (size_t) n * b->nparams;
+
+  for (unsigned int i = 0; i < b->nparams; i++)
+  {
+    const db_bind_t        * const param = &stmt->param[i];
+    const db_batch_value_t * const v = &row[i];
+
+    if (param->is_null != NULL)
+      *param->is_null = v->is_null;
+
+    if (v->is_null)
+      continue;
+
+    if (param->type == DB_TYPE_BLOB || param->type == DB_TYPE_CHAR ||
+        param->type == DB_TYPE_VARCHAR)
+      *param->data_len = v->len;
+
+    if (param->type != DB_TYPE_BLOB)
+      memcpy(param->buffer, b->data + v->offset, v->len);
+  }
+}
+
+
+/* Execute batch rows one by one */
+
+
+db_error_t db_batch_execute_rows(db_stmt_t *stmt, db_result_t *rs)
+{
+  db_conn_t  * const con = stmt->connection;
+  db_error_t rc = DB_ERROR_NONE;
+
+  for (unsigned int i = 0; i < stmt->batch.nrows && rc == DB_ERROR_NONE; i++)
+  {
+    db_batch_row(stmt, i);
+
+    rc = con->driver->ops.execute(stmt, rs);
+
+    /* Result sets of batches are discarded */
+    if (rc == DB_ERROR_NONE && rs->counter == SB_CNT_READ &&
+        con->state != DB_CONN_PIPELINE)
+    {
+      con->driver->ops.free_results(rs);
+      rs->nrows = 0;
+      rs->nfields = 0;
+    }
+  }
+
+  return rc;
+}
+
+
+/* Bind results for prepared statement */
+
+
+int db_bind_result(db_stmt_t *stmt, db_bind_t *results, size_t len)
+{
+  db_conn_t *con = stmt->connection;
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    return 1;
+  }
+
+  return con->driver->ops.bind_result(stmt, results, len);
+}
+
+
+/* Execute prepared statement */
+
+
+db_result_t *db_execute(db_stmt_t *stmt)
+{
+  db_conn_t       *con = stmt->connection;
+  db_result_t     *rs = &con->rs;
+  int             rc;
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    return NULL;
+  }
+  else if (con->state == DB_CONN_ASYNC)
+  {
+    log_text(LOG_ALERT, "attempt to use a connection with an asynchronous "
+             "query in progress");
+    con->error = DB_ERROR_FATAL;
+    return NULL;
+  }
+  else if (con->state == DB_CONN_RESULT_SET &&
+           (rc = db_free_results_int(con)) != 0)
+  {
+    return NULL;
+  }
+
+  rs->statement = stmt;
+
+  SB_PROBE3(execute__start, con->thread_id, stmt, stmt->query);
+
+  con->first_result_ns = 0;
+
+  const uint64_t start = sb_usage_clock();
+  if (stmt->trace_query != NULL && con->state != DB_CONN_PIPELINE &&
+      sb_tracectx_sampled(con->thread_id))
+    con->error = db_traced_execute(stmt, rs);
+  else
+    con->error = con->driver->ops.execute(stmt, rs);
+  sb_usage_add_driver_time(con->thread_id, start);
+
+  SB_PROBE3(execute__done, con->thread_id, stmt, con->error);
+
+  if (sb_slow_log_enabled())
+    db_slow_log_execute(stmt, start);
+
+  /* Results are collected and accounted by db_pipeline_end() */
+  if (con->state == DB_CONN_PIPELINE)
+    return NULL;
+
+  sb_counter_inc(con->thread_id, rs->counter);
+
+  if (db_globals.latency_split)
+    db_latency_split_update(con, start);
+
+  db_stmt_stat_t * const stat = stmt->stat;
+
+  if (stat != NULL)
+    db_stat_update(&db_stmt_stats, stat, sb_usage_clock() - start,
+                   con->error != DB_ERROR_NONE);
+
+  if (SB_LIKELY(con->error == DB_ERROR_NONE))
+  {
+    if (rs->counter == SB_CNT_READ)
+    {
+      con->state = DB_CONN_RESULT_SET;
+      return rs;
+    }
+    con->state = DB_CONN_READY;
+
+    return NULL;
+  }
+
+  return NULL;
+}
+
+
+/* Execute prepared statement for all rows of its batch */
+
+
+db_result_t *db_execute_batch(db_stmt_t *stmt)
+{
+  db_conn_t       *con = stmt->connection;
+  db_result_t     *rs = &con->rs;
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    return NULL;
+  }
+  else if (con->state == DB_CONN_ASYNC)
+  {
+    log_text(LOG_ALERT, "attempt to use a connection with an asynchronous "
+             "query in progress");
+    con->error = DB_ERROR_FATAL;
+    return NULL;
+  }
+  else if (con->state == DB_CONN_RESULT_SET && db_free_results_int(con) != 0)
+  {
+    return NULL;
+  }
+
+  con->error = DB_ERROR_NONE;
+
+  if (stmt->batch.nrows == 0)
+    return NULL;
+
+  rs->statement = stmt;
+
+  SB_PROBE3(execute__start, con->thread_id, stmt, stmt->query);
+
+  con->first_result_ns = 0;
+
+  const uint64_t start = sb_usage_clock();
+  if (con->driver->ops.execute_batch != NULL)
+    con->error = con->driver->ops.execute_batch(stmt, rs);
+  else
+    con->error = db_batch_execute_rows(stmt, rs);
+  sb_usage_add_driver_time(con->thread_id, start);
+
+  SB_PROBE3(execute__done, con->thread_id, stmt, con->error);
+
+  stmt->batch.nrows = 0;
+  stmt->batch.data_len = 0;
+
+  /* Results are collected and accounted by db_pipeline_end() */
+  if (con->state == DB_CONN_PIPELINE)
+    return NULL;
+
+  /* A batch is accounted as a single query */
+  sb_counter_inc(con->thread_id, rs->counter);
+
+  db_stmt_stat_t * const stat = stmt->stat;
+
+  if (stat != NULL)
+    db_stat_update(&db_stmt_stats, stat, sb_usage_clock() - start,
+                   con->error != DB_ERROR_NONE);
+
+  if (con->error == DB_ERROR_NONE)
+    con->state = DB_CONN_READY;
+
+  return NULL;
+}
+
+
+/* Fetch row from result set of a query */
+
+
+db_row_t *db_fetch_row(db_result_t *rs)
+{
+  db_conn_t *con = SB_CONTAINER_OF(rs, db_conn_t, rs);
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    return NULL;
+  }
+  else if (con->state != DB_CONN_RESULT_SET)
+  {
+    log_text(LOG_ALERT, "attempt to fetch row from an invalid result set");
+    return NULL;
+  }
+
+  if (con->driver->ops.fetch_row == NULL)
+  {
+    log_text(LOG_ALERT, "fetching rows is not supported by the driver");
+  }
+
+  if (rs->nrows == 0 || rs->nfields == 0)
+  {
+    log_text(LOG_ALERT, "attempt to fetch row from an empty result set");
+    return NULL;
+  }
+
+  /* The values array is reused by subsequent result sets */
+  if (rs->nvalues < rs->nfields)
+  {
+    db_value_t *values = realloc(rs->row.values,
+                                 rs->nfields * sizeof(db_value_t));
+    if (values == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return NULL;
+    }
+    rs->row.values = values;
+    rs->nvalues = rs->nfields;
+  }
+
+  const uint64_t start = sb_usage_clock();
+  const int      rc = con->driver->ops.fetch_row(rs, &rs->row);
+  sb_usage_add_driver_time(con->thread_id, start);
+
+  if (rc)
+  {
+    return NULL;
+  }
+
+  return &rs->row;
+}
+
+
+/* Check if rows can be fetched from a result set, see db_fetch_row() */
+
+static bool db_check_fetch(db_result_t *rs)
+{
+  db_conn_t * const con = SB_CONTAINER_OF(rs, db_conn_t, rs);
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    return false;
+  }
+  else if (con->state != DB_CONN_RESULT_SET)
+  {
+    log_text(LOG_ALERT, "attempt to fetch row from an invalid result set");
+    return false;
+  }
+
+  return true;
+}
+
+
+int64_t db_count_rows(db_result_t *rs)
+{
+  int64_t n = 0;
+
+  if (!db_check_fetch(rs))
+    return -1;
+
+  if (rs->nrows == 0 || rs->nfields == 0)
+    return 0;
+
+  while (db_fetch_row(rs) != NULL)
+    n++;
+
+  return n;
+}
+
+
+/* Convert a column value to a number without copying it, if possible */
+
+static double db_value_to_double(const db_value_t *val)
+{
+  const char *p = val->ptr;
+  const char *end = p + val->len;
+  bool       neg = false;
+  int64_t    n = 0;
+  char       buf[64];
+
+  /* Fast path for integers that fit into int64_t */
+  if (val->len > 0 && val->len <= 18)
+  {
+    if (*p == '-' || *p == '+')
+      neg = *p++ == '-';
+
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+      n = n * 10 + (*p - '0');
+
+    if (p == end)
+      return neg ? (double) -n : (double) n;
+  }
+
+  /* Values are not necessarily NUL-terminated */
+  const size_t len = SB_MIN(val->len, sizeof(buf) - 1);
+  memcpy(buf, val->ptr, len);
+  buf[len] = '\0';
+
+  return strtod(buf, NULL);
+}
+
+
+int64_t db_sum_column(db_result_t *rs, uint32_t col, double *sum)
+{
+  db_row_t *row;
+  int64_t  n = 0;
+
+  *sum = 0;
+
+  if (!db_check_fetch(rs))
+    return -1;
+
+  if (rs->nrows == 0 || rs->nfields == 0)
+    return 0;
+
+  if (col >= rs->nfields)
+  {
+    log_text(LOG_ALERT, "invalid column number %u, the result set has %u "
+             "column(s)", col + 1, rs->nfields);
+    return -1;
+  }
+
+  while ((row = db_fetch_row(rs)) != NULL)
+  {
+    if (row->values[col].ptr != NULL)
+      *sum += db_value_to_double(&row->values[col]);
+    n++;
+  }
+
+  return n;
+}
+
+
+/* Compare column values in byte order, NULL values first */
+
+static int db_value_cmp(const char *a, size_t alen, bool anull,
+                        const db_value_t *b)
+{
+  if (anull || b->ptr == NULL)
+    return !anull - (b->ptr != NULL);
+
+  const size_t len = SB_MIN(alen, b->len);
+  const int    rc = len > 0 ? memcmp(a, b->ptr, len) : 0;
+
+  if (rc != 0)
+    return rc;
+
+  return (alen > b->len) - (alen < b->len);
+}
+
+
+int64_t db_check_sorted(db_result_t *rs, uint32_t col, bool strict,
+                        bool *sorted)
+{
+  db_row_t *row;
+  int64_t  n = 0;
+  /* Rows may be reused by the driver, so the previous value is copied */
+  char     *prev = NULL;
+  size_t   prev_len = 0;
+  size_t   prev_size = 0;
+  bool     prev_null = true;
+
+  *sorted = true;
+
+  if (!db_check_fetch(rs))
+    return -1;
+
+  if (rs->nrows == 0 || rs->nfields == 0)
+    return 0;
+
+  if (col >= rs->nfields)
+  {
+    log_text(LOG_ALERT, "invalid column number %u, the result set has %u "
+             "column(s)", col + 1, rs->nfields);
+    return -1;
+  }
+
+  while ((row = db_fetch_row(rs)) != NULL)
+  {
+    const db_value_t *val = &row->values[col];
+
+    if (n++ > 0 && *sorted)
+    {
+      const int rc = db_value_cmp(prev, prev_len, prev_null, val);
+
+      if (rc > 0 || (strict && rc == 0))
+        *sorted = false;
+    }
+
+    if (!*sorted)
+      continue;
+
+    prev_null = val->ptr == NULL;
+    prev_len = val->len;
+
+    if (!prev_null && prev_len > prev_size)
+    {
+      char *tmp = realloc(prev, prev_len);
+
+      if (tmp == NULL)
+      {
+        log_text(LOG_FATAL, "Memory allocation failure");
+        free(prev);
+        return -1;
+      }
+
+      prev = tmp;
+      prev_size = prev_len;
+    }
+
+    if (!prev_null && prev_len > 0)
+      memcpy(prev, val->ptr, prev_len);
+  }
+
+  free(prev);
+
+  return n;
+}
+
+
+/* Execute non-prepared statement */
+
+
+db_result_t *db_query(db_conn_t *con, const char *query, size_t len)
+{
+  db_result_t *rs = &con->rs;
+  int         rc;
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    con->error = DB_ERROR_FATAL;
+    return NULL;
+  }
+  else if (con->state == DB_CONN_ASYNC)
+  {
+    log_text(LOG_ALERT, "attempt to use a connection with an asynchronous "
+             "query in progress");
+    con->error = DB_ERROR_FATAL;
+    return NULL;
+  }
+  else if (con->state == DB_CONN_RESULT_SET &&
+           (rc = db_free_results_int(con)) != 0)
+  {
+    con->error = DB_ERROR_FATAL;
+    return NULL;
+  }
+
+  SB_PROBE3(query__start, con->thread_id, query, len);
+
+  con->first_result_ns = 0;
+
+  const uint64_t start = sb_usage_clock();
+  if (con->state != DB_CONN_PIPELINE && sb_tracectx_sampled(con->thread_id))
+    con->error = db_traced_query(con, query, len, rs);
+  else
+    con->error = con->driver->ops.query(con, query, len, rs);
+  sb_usage_add_driver_time(con->thread_id, start);
+
+  SB_PROBE2(query__done, con->thread_id, con->error);
+
+  if (sb_slow_log_enabled())
+    sb_slow_log_statement(con->thread_id, start, sb_usage_clock(),
+                          con->server, con->error != DB_ERROR_NONE,
+                          con->sql_errno, query, len);
+
+  /* Results are collected and accounted by db_pipeline_end() */
+  if (con->state == DB_CONN_PIPELINE)
+    return NULL;
+
+  sb_counter_inc(con->thread_id, rs->counter);
+
+  if (db_globals.latency_split)
+    db_latency_split_update(con, start);
+
+  if (SB_LIKELY(con->error == DB_ERROR_NONE))
+  {
+    if (rs->counter == SB_CNT_READ)
+    {
+      con->state = DB_CONN_RESULT_SET;
+      return rs;
+    }
+    con->state = DB_CONN_READY;
+
+    return NULL;
+  }
+
+  return NULL;
+}
+
+
+bool db_async_available(db_conn_t *con)
+{
+  return con->driver->ops.query_async != NULL &&
+    con->state != DB_CONN_PIPELINE && con->state != DB_CONN_INVALID;
+}
+
+
+/* Start executing a query asynchronously */
+
+
+int db_query_async(db_conn_t *con, const char *query, size_t len)
+{
+  const drv_ops_t *ops = &con->driver->ops;
+  int             rc;
+
+  if (ops->query_async == NULL)
+  {
+    log_text(LOG_FATAL, "asynchronous queries are not supported by the '%s' "
+             "driver", con->driver->sname);
+    con->error = DB_ERROR_FATAL;
+    return 1;
+  }
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    con->error = DB_ERROR_FATAL;
+    return 1;
+  }
+  else if (con->state == DB_CONN_ASYNC)
+  {
+    log_text(LOG_ALERT, "attempt to use a connection with an asynchronous "
+             "query in progress");
+    con->error = DB_ERROR_FATAL;
+    return 1;
+  }
+  else if (con->state == DB_CONN_PIPELINE)
+  {
+    log_text(LOG_ALERT, "attempt to start an asynchronous query in pipeline "
+             "mode");
+    con->error = DB_ERROR_FATAL;
+    return 1;
+  }
+  else if (con->state == DB_CONN_RESULT_SET &&
+           (rc = db_free_results_int(con)) != 0)
+  {
+    con->error = DB_ERROR_FATAL;
+    return 1;
+  }
+
+  rc = ops->query_async(con, query, len);
+  if (rc < 0)
+  {
+    con->error = DB_ERROR_FATAL;
+    return 1;
+  }
+
+  con->error = DB_ERROR_NONE;
+  con->async_wait = rc;
+  con->state = DB_CONN_ASYNC;
+
+  return 0;
+}
+
+/* Collect the result of a completed asynchronous query */
+
+static void db_async_complete(db_conn_t *con)
+{
+  db_result_t *rs = &con->rs;
+
+  con->error = con->driver->ops.query_async_result(con, rs);
+
+  sb_counter_inc(con->thread_id, rs->counter);
+
+  if (SB_LIKELY(con->error == DB_ERROR_NONE) && rs->counter == SB_CNT_READ)
+    con->state = DB_CONN_RESULT_SET;
+  else
+    con->state = DB_CONN_READY;
+}
+
+
+/* Per-thread arrays for db_async_poll() */
+static TLS struct {
+  struct pollfd *pfds;
+  size_t        *idx;
+  size_t        size;
+} tls_poll;
+
+
+int db_async_poll(db_conn_t **cons, size_t n, int timeout_ms, int *done)
+{
+  struct pollfd  *pfds;
+  size_t         *idx;
+  int            ndone = 0;
+  const uint64_t start = sb_usage_clock();
+
+  /* The arrays are kept for subsequent calls by the same thread */
+  if (n > tls_poll.size)
+  {
+    pfds = realloc(tls_poll.pfds, n * sizeof(struct pollfd));
+    if (pfds != NULL)
+      tls_poll.pfds = pfds;
+
+    idx = realloc(tls_poll.idx, n * sizeof(size_t));
+    if (idx != NULL)
+      tls_poll.idx = idx;
+
+    if (pfds == NULL || idx == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      ndone = -1;
+      goto end;
+    }
+
+    tls_poll.size = n;
+  }
+
+  pfds = tls_poll.pfds;
+  idx = tls_poll.idx;
+
+  while (ndone == 0)
+  {
+    nfds_t nwait = 0;
+    int    rc;
+
+    for (size_t i = 0; i < n; i++)
+    {
+      db_conn_t * const con = cons[i];
+
+      if (con->state != DB_CONN_ASYNC)
+        continue;
+
+      /* The query may have completed without waiting */
+      if (con->async_wait == 0)
+      {
+        db_async_complete(con);
+        done[ndone++] = (int) i;
+        continue;
+      }
+
+      pfds[nwait].fd = con->driver->ops.socket(con);
+      pfds[nwait].events =
+        ((con->async_wait & DB_ASYNC_WAIT_READ) ? POLLIN : 0) |
+        ((con->async_wait & DB_ASYNC_WAIT_WRITE) ? POLLOUT : 0) |
+        ((con->async_wait & DB_ASYNC_WAIT_EXCEPT) ? POLLPRI : 0);
+      pfds[nwait].revents = 0;
+      idx[nwait++] = i;
+    }
+
+    if (ndone > 0 || nwait == 0)
+      break;
+
+    rc = poll(pfds, nwait, timeout_ms);
+
+    if (rc < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      log_errno(LOG_FATAL, "poll() failed");
+      ndone = -1;
+      break;
+    }
+
+    for (nfds_t j = 0; j < nwait; j++)
+    {
+      db_conn_t * const con = cons[idx[j]];
+      const short       ev = pfds[j].revents;
+      int               ready;
+
+      ready = ((ev & (POLLIN | POLLHUP | POLLERR)) ? DB_ASYNC_WAIT_READ : 0) |
+        ((ev & POLLOUT) ? DB_ASYNC_WAIT_WRITE : 0) |
+        ((ev & POLLPRI) ? DB_ASYNC_WAIT_EXCEPT : 0);
+
+      /* Let the driver handle timeouts when poll() has timed out */
+      if (rc == 0 && (con->async_wait & DB_ASYNC_WAIT_TIMEOUT))
+        ready |= DB_ASYNC_WAIT_TIMEOUT;
+
+      if (ready == 0)
+        continue;
+
+      con->async_wait = con->driver->ops.query_async_cont(con, ready);
+
+      if (con->async_wait == 0)
+      {
+        db_async_complete(con);
+        done[ndone++] = (int) idx[j];
+      }
+    }
+
+    if (rc == 0)
+      break;
+  }
+
+end:
+  sb_usage_add_driver_time(sb_tls_thread_id, start);
+
+  return ndone;
+}
+
+
+db_result_t *db_async_result(db_conn_t *con)
+{
+  return con->state == DB_CONN_RESULT_SET ? &con->rs : NULL;
+}
+
+
+/* Start a group of pipelined statements */
+
+
+int db_pipeline_begin(db_conn_t *con)
+{
+  int rc;
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    con->error = DB_ERROR_FATAL;
+    return 1;
+  }
+  else if (con->state == DB_CONN_ASYNC)
+  {
+    log_text(LOG_ALERT, "attempt to use a connection with an asynchronous "
+             "query in progress");
+    con->error = DB_ERROR_FATAL;
+    return 1;
+  }
+  /* A previous group may have been interrupted by an error */
+  else if (con->state == DB_CONN_PIPELINE && db_pipeline_end(con) != 0 &&
+           con->error == DB_ERROR_FATAL)
+  {
+    return 1;
+  }
+  else if (con->state == DB_CONN_RESULT_SET &&
+           (rc = db_free_results_int(con)) != 0)
+  {
+    con->error = DB_ERROR_FATAL;
+    return 1;
+  }
+
+  con->error = DB_ERROR_NONE;
+
+  if (con->driver->ops.pipeline_begin == NULL)
+    return 0;
+
+  rc = con->driver->ops.pipeline_begin(con);
+  if (rc < 0)
+  {
+    con->error = DB_ERROR_FATAL;
+    return 1;
+  }
+
+  /* A positive value means pipelining is disabled for this connection */
+  if (rc == 0)
+    con->state = DB_CONN_PIPELINE;
+
+  return 0;
+}
+
+
+/* Collect results of pipelined statements */
+
+
+int db_pipeline_end(db_conn_t *con)
+{
+  if (con->state != DB_CONN_PIPELINE)
+    return 0;
+
+  const uint64_t start = sb_usage_clock();
+  con->error = con->driver->ops.pipeline_end(con);
+  sb_usage_add_driver_time(con->thread_id, start);
+  con->state = DB_CONN_READY;
+
+  return con->error != DB_ERROR_NONE;
+}
+
+
+/* Free result set */
+
+
+static int db_free_results_int(db_conn_t *con)
+{
+  int       rc;
+
+  rc = con->driver->ops.free_results(&con->rs);
+
+  con->rs.nrows = 0;
+  con->rs.nfields = 0;
+
+  con->rs.statement = NULL;
+
+  con->state = DB_CONN_READY;
+
+  return rc;
+}
+
+int db_free_results(db_result_t *rs)
+{
+  db_conn_t * const con = SB_CONTAINER_OF(rs, db_conn_t, rs);
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    return 1;
+  }
+  else if (con->state != DB_CONN_RESULT_SET)
+  {
+    log_text(LOG_ALERT, "attempt to free an invalid result set");
+    return 1;
+  }
+
+  return db_free_results_int(con);
+}
+
+/* Close prepared statement */
+
+
+int db_close(db_stmt_t *stmt)
+{
+  int       rc;
+  db_conn_t *con = stmt->connection;
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    return 0;
+  }
+  else if (con->state == DB_CONN_RESULT_SET &&
+           (rc = db_free_results_int(con)) != 0)
+  {
+    return DB_ERROR_FATAL;
+  }
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    return 0;
+  }
+  else if (con->state == DB_CONN_RESULT_SET && con->rs.statement == stmt &&
+           (rc = db_free_results_int(con)) != 0)
+  {
+    return 0;
+  }
+
+  rc = con->driver->ops.close(stmt);
+
+  if (stmt->query != NULL)
+  {
+    free(stmt->query);
+    stmt->query = NULL;
+  }
+  if (stmt->bound_param != NULL)
+  {
+    free(stmt->bound_param);
+    stmt->bound_param = NULL;
+  }
+  free(stmt->trace_query);
+  free(stmt->param);
+  free(stmt->batch.values);
+  free(stmt->batch.data);
+  free(stmt);
+
+  return rc;
+}
+
+/* Uninitialize DB API */
+
+void db_done(void)
+{
+  sb_list_item_t *pos;
+  db_driver_t    *drv;
 
   if (!db_global_initialized)
     return;
 
-  disable_print_stats();
+  disable_print_stats();
+
+  db_waits_stop();
+  db_outage_stop();
+
+  if (db_globals.debug)
+  {
+    free(exec_timers);
+    free(fetch_timers);
+
+    exec_timers = fetch_timers = NULL;
+  }
+
+  if (db_globals.pool_size > 0)
+  {
+    /* Connections still checked out are closed as well */
+    for (unsigned int i = 0; i < db_pool.nconns; i++)
+      db_connection_free(db_pool.conns[i]);
+
+    free(db_pool.conns);
+    free(db_pool.idle);
+
+    if (db_pool.latency)
+      sb_histogram_done(&db_pool.histogram);
+
+    pthread_mutex_destroy(&db_pool.mutex);
+    pthread_cond_destroy(&db_pool.cond);
+
+    memset(&db_pool, 0, sizeof(db_pool));
+  }
+
+  if (db_globals.stmt_stats)
+    db_stat_set_done(&db_stmt_stats);
+
+  db_stat_set_done(&db_txn_stats);
+
+  if (db_connect_stats.latency)
+    sb_histogram_done(&db_connect_stats.histogram);
+  memset(&db_connect_stats, 0, sizeof(db_connect_stats));
+
+  if (db_rampup.latency)
+    sb_histogram_done(&db_rampup.histogram);
+  memset(&db_rampup, 0, sizeof(db_rampup));
+
+  if (db_globals.connect_concurrency > 0)
+  {
+    pthread_mutex_destroy(&db_connect_pace.mutex);
+    pthread_cond_destroy(&db_connect_pace.cond);
+  }
+  memset(&db_connect_pace, 0, sizeof(db_connect_pace));
+
+  if (db_retry_stats.latency)
+  {
+    sb_histogram_done(&db_retry_stats.histograms[0]);
+    sb_histogram_done(&db_retry_stats.histograms[1]);
+  }
+  free(db_retry_stats.threads);
+  memset(&db_retry_stats, 0, sizeof(db_retry_stats));
+
+  if (db_cursor_stats.latency)
+    sb_histogram_done(&db_cursor_stats.histogram);
+  memset(&db_cursor_stats, 0, sizeof(db_cursor_stats));
+
+  for (unsigned int i = 0; db_latency_split.latency && i < 3; i++)
+  {
+    sb_histogram_done(&db_latency_split.histograms[i][0]);
+    sb_histogram_done(&db_latency_split.histograms[i][1]);
+  }
+  memset(&db_latency_split, 0, sizeof(db_latency_split));
+
+  if (db_status.con != NULL)
+    db_connection_free(db_status.con);
+  for (unsigned int i = 0; i < db_status.nvars; i++)
+    free(db_status.vars[i].name);
+  memset(&db_status, 0, sizeof(db_status));
+
+  SB_LIST_FOR_EACH(pos, &drivers)
+  {
+    drv = SB_LIST_ENTRY(pos, db_driver_t, listitem);
+    if (drv->initialized)
+    {
+      drv->ops.done();
+      pthread_mutex_destroy(&drv->mutex);
+    }
+  }
+
+  return;
+}
+
+
+/* Parse command line arguments */
+
+
+int db_parse_arguments(void)
+{
+  char *s;
+
+  s = sb_get_value_string("db-ps-mode");
+
+  if (!strcmp(s, "auto"))
+    db_globals.ps_mode = DB_PS_MODE_AUTO;
+  else if (!strcmp(s, "disable"))
+    db_globals.ps_mode = DB_PS_MODE_DISABLE;
+  else
+  {
+    log_text(LOG_FATAL, "Invalid value for db-ps-mode: %s", s);
+    return 1;
+  }
+
+  s = sb_get_value_string("db-result-mode");
+
+  if (!strcmp(s, "store"))
+    db_globals.result_mode = DB_RESULT_MODE_STORE;
+  else if (!strcmp(s, "stream"))
+    db_globals.result_mode = DB_RESULT_MODE_STREAM;
+  else if (!strcmp(s, "discard"))
+    db_globals.result_mode = DB_RESULT_MODE_DISCARD;
+  else
+  {
+    log_text(LOG_FATAL, "Invalid value for db-result-mode: %s", s);
+    return 1;
+  }
+
+  db_globals.driver = sb_get_value_string("db-driver");
+
+  db_globals.debug = sb_get_value_flag("db-debug");
+
+  const int pool_size = sb_get_value_int("db-pool-size");
+  if (pool_size < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-pool-size: %d", pool_size);
+    return 1;
+  }
+  db_globals.pool_size = (unsigned int) pool_size;
+
+  db_globals.stmt_stats = sb_get_value_flag("db-stmt-stats");
+
+  db_globals.connect_stats = sb_get_value_flag("db-connect-stats");
+
+  const int connect_rate = sb_get_value_int("db-connect-rate");
+  if (connect_rate < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-connect-rate: %d",
+             connect_rate);
+    return 1;
+  }
+  db_globals.connect_rate = (unsigned int) connect_rate;
+
+  const int connect_concurrency = sb_get_value_int("db-connect-concurrency");
+  if (connect_concurrency < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-connect-concurrency: %d",
+             connect_concurrency);
+    return 1;
+  }
+  db_globals.connect_concurrency = (unsigned int) connect_concurrency;
+
+  const unsigned long long packet_size = sb_get_value_size("db-bulk-packet-size");
+  /* 1 GiB is the largest max_allowed_packet value in MySQL */
+  if (packet_size < 1024 || packet_size > 1024 * 1024 * 1024)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-bulk-packet-size: %llu, must be "
+             "between 1KiB and 1GiB", packet_size);
+    return 1;
+  }
+  db_globals.bulk_packet_size = (unsigned int) packet_size;
+
+  s = sb_get_value_string("db-status-query");
+  db_globals.status_query = (s != NULL && *s != '\0') ? s : NULL;
+
+  if (db_globals.status_query != NULL &&
+      db_globals.result_mode == DB_RESULT_MODE_DISCARD)
+  {
+    log_text(LOG_FATAL, "--db-status-query cannot be used with "
+             "--db-result-mode=discard");
+    return 1;
+  }
+
+  const int wait_rate = sb_get_value_int("db-wait-sample-rate");
+  if (wait_rate < 0 || wait_rate > 1000)
+  {
+    log_text(LOG_FATAL, "Invalid value for --db-wait-sample-rate: %d. "
+             "Must be between 0 and 1000", wait_rate);
+    return 1;
+  }
+  db_globals.wait_sample_rate = (unsigned int) wait_rate;
+
+  s = sb_get_value_string("db-wait-query");
+  db_globals.wait_query = (s != NULL && *s != '\0') ? s : NULL;
+
+  if (db_globals.wait_sample_rate > 0 &&
+      db_globals.result_mode == DB_RESULT_MODE_DISCARD)
+  {
+    log_text(LOG_FATAL, "--db-wait-sample-rate cannot be used with "
+             "--db-result-mode=discard");
+    return 1;
+  }
+
+  const int retry_max = sb_get_value_int("db-retry-max");
+  if (retry_max < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-retry-max: %d", retry_max);
+    return 1;
+  }
+  db_globals.retry_max = (unsigned int) retry_max;
+
+  const int retry_backoff = sb_get_value_int("db-retry-backoff");
+  if (retry_backoff < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-retry-backoff: %d",
+             retry_backoff);
+    return 1;
+  }
+  db_globals.retry_backoff_ns = MS2NS(retry_backoff);
+
+  const int retry_backoff_max = sb_get_value_int("db-retry-backoff-max");
+  if (retry_backoff_max < retry_backoff)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-retry-backoff-max: %d, must "
+             "not be less than --db-retry-backoff", retry_backoff_max);
+    return 1;
+  }
+  db_globals.retry_backoff_max_ns = MS2NS(retry_backoff_max);
+
+  db_globals.retry_stats = sb_get_value_flag("db-retry-stats");
+
+  db_globals.outage_stats = sb_get_value_flag("db-outage-stats");
+
+  db_globals.outage_recovery_pct =
+    sb_get_value_double("db-outage-recovery-pct");
+  if (db_globals.outage_recovery_pct <= 0 ||
+      db_globals.outage_recovery_pct > 100)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-outage-recovery-pct: %g, "
+             "must be greater than 0 and not greater than 100",
+             db_globals.outage_recovery_pct);
+    return 1;
+  }
+
+  const int outage_resolution = sb_get_value_int("db-outage-resolution");
+  if (outage_resolution <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-outage-resolution: %d",
+             outage_resolution);
+    return 1;
+  }
+  db_globals.outage_resolution_ns = MS2NS(outage_resolution);
+
+  db_globals.latency_split = sb_get_value_flag("db-latency-split");
+
+  const int fetch_size = sb_get_value_int("db-fetch-size");
+  if (fetch_size < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-fetch-size: %d", fetch_size);
+    return 1;
+  }
+  db_globals.fetch_size = (unsigned int) fetch_size;
+
+  db_globals.dry_run = sb_get_value_flag("db-dry-run");
+
+  const int dry_run_rows = sb_get_value_int("db-dry-run-rows");
+  if (dry_run_rows < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-dry-run-rows: %d", dry_run_rows);
+    return 1;
+  }
+  db_globals.dry_run_rows = (unsigned int) dry_run_rows;
+
+  const int dry_run_columns = sb_get_value_int("db-dry-run-columns");
+  if (dry_run_columns < 1)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-dry-run-columns: %d",
+             dry_run_columns);
+    return 1;
+  }
+  db_globals.dry_run_columns = (unsigned int) dry_run_columns;
+
+  db_globals.tcp_nodelay = sb_get_value_flag("db-tcp-nodelay");
+  db_globals.tcp_quickack = sb_get_value_flag("db-tcp-quickack");
+
+  const unsigned long long rcvbuf = sb_get_value_size("db-socket-rcvbuf");
+  const unsigned long long sndbuf = sb_get_value_size("db-socket-sndbuf");
+
+  /* The kernel doubles the requested size, which must still fit an int */
+  if (rcvbuf > SOCKET_BUFFER_MAX)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-socket-rcvbuf: %llu, must not "
+             "exceed 512MiB", rcvbuf);
+    return 1;
+  }
+  if (sndbuf > SOCKET_BUFFER_MAX)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-socket-sndbuf: %llu, must not "
+             "exceed 512MiB", sndbuf);
+    return 1;
+  }
+  db_globals.socket_rcvbuf = (unsigned int) rcvbuf;
+  db_globals.socket_sndbuf = (unsigned int) sndbuf;
+
+  const int busy_poll = sb_get_value_int("db-busy-poll");
+  if (busy_poll < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for db-busy-poll: %d", busy_poll);
+    return 1;
+  }
+  db_globals.busy_poll = (unsigned int) busy_poll;
+
+#ifndef TCP_QUICKACK
+  if (db_globals.tcp_quickack)
+  {
+    log_text(LOG_FATAL, "--db-tcp-quickack is not supported on this "
+             "platform");
+    return 1;
+  }
+#endif
+#ifndef SO_BUSY_POLL
+  if (db_globals.busy_poll > 0)
+  {
+    log_text(LOG_FATAL, "--db-busy-poll is not supported on this platform");
+    return 1;
+  }
+#endif
+
+  return 0;
+}
+
+
+/*
+  Set a socket option. Failures are reported once per option and do not fail
+  the connection, e.g. raising SO_BUSY_POLL above net.core.busy_read requires
+  CAP_NET_ADMIN.
+*/
+
+static void set_socket_option(int fd, int level, int name, const char *str,
+                              int val, int *warned)
+{
+  if (setsockopt(fd, level, name, &val, sizeof(val)) != 0 &&
+      !ck_pr_fas_int(warned, 1))
+    log_errno(LOG_WARNING, "setsockopt(%s) failed", str);
+}
+
+
+/* Set a socket buffer size and warn once if the kernel limit caps it */
+
+static void set_socket_buffer(int fd, int name, const char *str,
+                              unsigned int size, const char *sysctl,
+                              int *warned)
+{
+  int       val;
+  socklen_t len = sizeof(val);
+
+  set_socket_option(fd, SOL_SOCKET, name, str, (int) size, warned);
+
+  /* The reported size is doubled to account for bookkeeping overhead */
+  if (getsockopt(fd, SOL_SOCKET, name, &val, &len) == 0 &&
+      (unsigned int) val < size * 2 && !ck_pr_fas_int(warned, 1))
+    log_text(LOG_WARNING, "%s is capped to %d bytes by %s", str, val / 2,
+             sysctl);
+}
+
+
+void db_socket_tune(int fd)
+{
+  static int              warned[5];
+  struct sockaddr_storage addr;
+  socklen_t               len = sizeof(addr);
+
+  if (db_globals.socket_rcvbuf > 0)
+    set_socket_buffer(fd, SO_RCVBUF, "SO_RCVBUF", db_globals.socket_rcvbuf,
+                      "net.core.rmem_max", &warned[0]);
+
+  if (db_globals.socket_sndbuf > 0)
+    set_socket_buffer(fd, SO_SNDBUF, "SO_SNDBUF", db_globals.socket_sndbuf,
+                      "net.core.wmem_max", &warned[1]);
+
+#ifdef SO_BUSY_POLL
+  if (db_globals.busy_poll > 0)
+    set_socket_option(fd, SOL_SOCKET, SO_BUSY_POLL, "SO_BUSY_POLL",
+                      (int) db_globals.busy_poll, &warned[2]);
+#endif
+
+  /* TCP options do not apply to Unix sockets */
+  if (getsockname(fd, (struct sockaddr *) &addr, &len) != 0 ||
+      (addr.ss_family != AF_INET && addr.ss_family != AF_INET6))
+    return;
+
+  set_socket_option(fd, IPPROTO_TCP, TCP_NODELAY, "TCP_NODELAY",
+                    db_globals.tcp_nodelay, &warned[3]);
+
+#ifdef TCP_QUICKACK
+  if (db_globals.tcp_quickack)
+    set_socket_option(fd, IPPROTO_TCP, TCP_QUICKACK, "TCP_QUICKACK", 1,
+                      &warned[4]);
+#endif
+}
+
+
+/*
+  Replace all operations of a driver with ones that succeed without doing
+  anything. Queries starting with SELECT return --db-dry-run-rows x
+  --db-dry-run-columns fake rows, other ones report one affected row. This
+  measures the overhead of sysbench and Lua scripts with no server involved.
+  Must be called before the driver is initialized, or from its init
+  operation.
+*/
+
+void db_dry_run_driver(db_driver_t *drv)
+{
+  drv->ops = dry_run_ops;
+}
+
+
+/* Determine the counter type of a query from its first keyword */
+
+sb_counter_type_t db_query_counter(const char *query, size_t len)
+{
+  const char * const end = query + len;
+
+  while (query < end)
+  {
+    if (isspace((unsigned char) *query) || *query == '(')
+      query++;
+    else if (end - query >= 2 && query[0] == '/' && query[1] == '*')
+    {
+      /* Skip comments, e.g. the trace context of traced events */
+      const char *p = query + 2;
+
+      while (end - p >= 2 && !(p[0] == '*' && p[1] == '/'))
+        p++;
+      query = end - p >= 2 ? p + 2 : end;
+    }
+    else
+      break;
+  }
+
+  if (end - query >= 6 && !strncasecmp(query, "SELECT", 6))
+    return SB_CNT_READ;
+
+  if ((end - query >= 6 && (!strncasecmp(query, "INSERT", 6) ||
+                            !strncasecmp(query, "UPDATE", 6) ||
+                            !strncasecmp(query, "DELETE", 6))) ||
+      (end - query >= 7 && !strncasecmp(query, "REPLACE", 7)))
+    return SB_CNT_WRITE;
+
+  return SB_CNT_OTHER;
+}
+
+
+/* Fill in a fake result of a query in dry run mode */
+
+static db_error_t dry_run_result(db_conn_t *con, sb_counter_type_t counter,
+                                 db_result_t *rs)
+{
+  rs->counter = counter;
+
+  if (counter == SB_CNT_READ)
+  {
+    rs->nrows = db_globals.dry_run_rows;
+    rs->nfields = db_globals.dry_run_columns;
+  }
+  else
+  {
+    rs->nrows = (counter == SB_CNT_WRITE);
+    rs->nfields = 0;
+  }
+
+  /* Number of rows left to fetch */
+  *(uint32_t *) con->ptr = rs->nrows;
+
+  return DB_ERROR_NONE;
+}
+
+
+static int dry_run_init(void)
+{
+  return 0;
+}
+
+
+static int dry_run_describe(drv_caps_t *caps)
+{
+  caps->multi_rows_insert = 1;
+  caps->prepared_statements = 1;
+  caps->auto_increment = 1;
+  caps->needs_commit = 0;
+  caps->serial = 0;
+  caps->unsigned_int = 1;
+
+  return 0;
+}
+
+
+static int dry_run_connect(db_conn_t *con)
+{
+  con->ptr = calloc(1, sizeof(uint32_t));
+
+  return con->ptr == NULL;
+}
+
+
+static int dry_run_disconnect(db_conn_t *con)
+{
+  free(con->ptr);
+  con->ptr = NULL;
+
+  return 0;
+}
+
+
+static int dry_run_reconnect(db_conn_t *con)
+{
+  (void) con; /* unused */
+
+  return DB_ERROR_IGNORABLE;
+}
+
+
+static int dry_run_reset(db_conn_t *con)
+{
+  (void) con; /* unused */
+
+  return 0;
+}
+
+
+static int dry_run_prepare(db_stmt_t *stmt, const char *query, size_t len)
+{
+  stmt->counter = db_query_counter(query, len);
+
+  return 0;
+}
+
+
+static int dry_run_bind(db_stmt_t *stmt, db_bind_t *params, size_t len)
+{
+  (void) stmt; /* unused */
+  (void) params; /* unused */
+  (void) len; /* unused */
+
+  return 0;
+}
+
+
+static db_error_t dry_run_execute(db_stmt_t *stmt, db_result_t *rs)
+{
+  return dry_run_result(stmt->connection, stmt->counter, rs);
+}
+
+
+static int dry_run_fetch(db_result_t *rs)
+{
+  (void) rs; /* unused */
+
+  return 0;
+}
+
+
+static int dry_run_fetch_row(db_result_t *rs, db_row_t *row)
+{
+  db_conn_t * const con = SB_CONTAINER_OF(rs, db_conn_t, rs);
+  uint32_t  * const left = con->ptr;
+
+  if (*left == 0)
+    return 1;
+  (*left)--;
+
+  for (uint32_t i = 0; i < rs->nfields; i++)
+  {
+    row->values[i].ptr = dry_run_value;
+    row->values[i].len = sizeof(dry_run_value) - 1;
+  }
+
+  return 0;
+}
+
+
+static db_error_t dry_run_query(db_conn_t *con, const char *query, size_t len,
+                                db_result_t *rs)
+{
+  return dry_run_result(con, db_query_counter(query, len), rs);
+}
+
+
+static int dry_run_free_results(db_result_t *rs)
+{
+  (void) rs; /* unused */
+
+  return 0;
+}
+
+
+static int dry_run_close(db_stmt_t *stmt)
+{
+  (void) stmt; /* unused */
+
+  return 0;
+}
+
+
+static int dry_run_done(void)
+{
+  return 0;
+}
+
+
+/* Double the size of the query buffer of a connection */
+
+static int grow_query_buf(db_conn_t *con)
+{
+  const unsigned int buflen =
+    (con->query_buflen > 0) ? con->query_buflen * 2 : 256;
+  char * const buf = realloc(con->query_buf, buflen);
+
+  if (buf == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  con->query_buf = buf;
+  con->query_buflen = buflen;
+
+  return 0;
+}
+
+
+/* Grow the query buffer of a connection to at least a given size */
+
+static int reserve_query_buf(db_conn_t *con, size_t size)
+{
+  while (con->query_buflen < size)
+  {
+    if (grow_query_buf(con))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+  Build the query text of a prepared statement by substituting bound
+  parameters for placeholders. The text is written to the query buffer after
+  its first 'j' bytes.
+*/
+
+static const char *print_stmt_query(db_conn_t *con, unsigned int j,
+                                    const char *query, db_bind_t *params,
+                                    unsigned int nparams, unsigned int *len)
+{
+  unsigned int vcnt = 0;
+  int          n;
+
+  if (con->query_buflen == 0 && grow_query_buf(con))
+    return NULL;
+
+  for (unsigned int i = 0; query[i] != '\0'; i++)
+  {
+    if (j + 1 >= con->query_buflen && grow_query_buf(con))
+      return NULL;
+
+    if (query[i] != '?')
+    {
+      con->query_buf[j++] = query[i];
+      continue;
+    }
+
+    if (vcnt >= nparams)
+    {
+      log_text(LOG_ALERT, "wrong number of parameters in prepared statement");
+      return NULL;
+    }
+
+    while ((n = db_print_value(params + vcnt, con->query_buf + j,
+                               (int) (con->query_buflen - j))) < 0)
+    {
+      if (grow_query_buf(con))
+        return NULL;
+    }
+
+    j += (unsigned int) n;
+    vcnt++;
+  }
+
+  con->query_buf[j] = '\0';
+  *len = j;
+
+  return con->query_buf;
+}
+
+
+/* Build the query text of an emulated prepared statement */
+
+
+const char *db_print_query(db_stmt_t *stmt, unsigned int *len)
+{
+  return print_stmt_query(stmt->connection, 0, stmt->query, stmt->bound_param,
+                          stmt->bound_param_len, len);
+}
+
+
+/*
+  Execute a statement of a traced event as a query prefixed with its trace
+  context. Comments cannot be attached to executions of server-side prepared
+  statements, so the parameters are substituted as for emulated ones.
+*/
+
+static db_error_t db_traced_execute(db_stmt_t *stmt, db_result_t *rs)
+{
+  db_conn_t * const con = stmt->connection;
+  char              comment[SB_TRACECTX_COMMENT_MAX];
+  const size_t      clen = sb_tracectx_query_start(con->thread_id, comment);
+  unsigned int      len;
+  const char        *query;
+  db_error_t        rc;
+
+  if (reserve_query_buf(con, clen + 1))
+    query = NULL;
+  else
+  {
+    memcpy(con->query_buf, comment, clen);
+    query = print_stmt_query(con, (unsigned int) clen, stmt->trace_query,
+                             stmt->param, stmt->param_len, &len);
+  }
+
+  if (query != NULL)
+  {
+    /* The result set does not belong to a driver statement */
+    rs->statement = NULL;
+    rc = con->driver->ops.query(con, query, len, rs);
+  }
+  else
+    rc = DB_ERROR_FATAL;
+
+  sb_tracectx_query_stop(con->thread_id, rc != DB_ERROR_NONE);
+
+  return rc;
+}
+
+
+/*
+  Capture a statement started at 'start' for --slow-event-threshold, with its
+  parameters substituted as for emulated ones
+*/
+
+static void db_slow_log_execute(db_stmt_t *stmt, uint64_t start)
+{
+  db_conn_t * const con = stmt->connection;
+  const uint64_t    end = sb_usage_clock();
+  unsigned int      len;
+  const char        *query;
+
+  if (stmt->trace_query == NULL)
+    return;
+
+  query = print_stmt_query(con, 0, stmt->trace_query, stmt->param,
+                           stmt->param_len, &len);
+  if (query != NULL)
+    sb_slow_log_statement(con->thread_id, start, end, con->server,
+                          con->error != DB_ERROR_NONE, con->sql_errno, query,
+                          len);
+}
+
+
+/* Execute a query of a traced event prefixed with its trace context */
+
+static db_error_t db_traced_query(db_conn_t *con, const char *query,
+                                  size_t len, db_result_t *rs)
+{
+  char         comment[SB_TRACECTX_COMMENT_MAX];
+  const size_t clen = sb_tracectx_query_start(con->thread_id, comment);
+  db_error_t   rc;
+
+  if (reserve_query_buf(con, clen + len + 1))
+    rc = DB_ERROR_FATAL;
+  else
+  {
+    memcpy(con->query_buf, comment, clen);
+    memcpy(con->query_buf + clen, query, len);
+    con->query_buf[clen + len] = '\0';
+
+    rc = con->driver->ops.query(con, con->query_buf, clen + len, rs);
+  }
+
+  sb_tracectx_query_stop(con->thread_id, rc != DB_ERROR_NONE);
+
+  return rc;
+}
+
+
+/* Produce character representation of a 'bind' variable */
+
+
+int db_print_value(db_bind_t *var, char *buf, int buflen)
+{
+  int       n;
+  db_time_t *tm;
+
+  if (var->is_null != NULL && *var->is_null)
+  {
+    n = snprintf(buf, buflen, "NULL");
+    return (n < buflen) ? n : -1;
+  }
+  
+  switch (var->type) {
+    case DB_TYPE_TINYINT:
+      n = snprintf(buf, buflen, "%hhd", *(char *)var->buffer);
+      break;
+    case DB_TYPE_SMALLINT:
+      n = snprintf(buf, buflen, "%hd", *(short *)var->buffer);
+      break;
+    case DB_TYPE_INT:
+      n = snprintf(buf, buflen, "%d", *(int *)var->buffer);
+      break;
+    case DB_TYPE_BIGINT:
+      n = snprintf(buf, buflen, "%lld", *(long long *)var->buffer);
+      break;
+    case DB_TYPE_FLOAT:
+      n = snprintf(buf, buflen, "%f", *(float *)var->buffer);
+      break;
+    case DB_TYPE_DOUBLE:
+      n = snprintf(buf, buflen, "%f", *(double *)var->buffer);
+      break;
+    case DB_TYPE_CHAR:
+    case DB_TYPE_VARCHAR:
+      n = snprintf(buf, buflen, "'%s'", (char *)var->buffer);
+      break;
+    case DB_TYPE_BLOB:
+      /* Generated values only have characters that need no escaping */
+      n = (int) var->data_len[0] + 2;
+      if (n >= buflen)
+        return -1;
+      buf[0] = '\'';
+      db_blob_fill(buf + 1, var->data_len[0]);
+      buf[n - 1] = '\'';
+      buf[n] = '\0';
+      break;
+    case DB_TYPE_DATE:
+      tm = (db_time_t *)var->buffer;
+      n = snprintf(buf, buflen, "'%d-%d-%d'", tm->year, tm->month, tm->day);
+      break;
+    case DB_TYPE_TIME:
+      tm = (db_time_t *)var->buffer;
+      n = snprintf(buf, buflen, "'%d:%d:%d'", tm->hour, tm->minute,
+                   tm->second);
+      break;
+    case DB_TYPE_DATETIME:
+    case DB_TYPE_TIMESTAMP:
+      tm = (db_time_t *)var->buffer;
+      n = snprintf(buf, buflen, "'%d-%d-%d %d:%d:%d'", tm->year, tm->month,
+                   tm->day, tm->hour, tm->minute, tm->second);
+      break;
+    default:
+      n = 0;
+      break;
+  }
+
+  return (n < buflen) ? n : -1;
+}
+
+
+/*
+  Letters, digits, '-' and '_', so that each character takes 6 random bits and
+  values can be used as TEXT or BLOB and in SQL literals without escaping. Such
+  values are poorly compressible, like most large values in practice.
+*/
+static const char blob_chars[64] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+/* Buffer of db_blob_send(), allocated on first use by each thread */
+static TLS char *blob_chunk;
+
+
+void db_blob_fill(char *buf, size_t len)
+{
+  size_t i = 0;
+
+  while (i < len)
+  {
+    uint64_t x = sb_rand_uniform_uint64();
+
+    for (unsigned int j = 0; j < 10 && i < len; j++, x >>= 6)
+      buf[i++] = blob_chars[x & 63];
+  }
+}
+
+
+int db_blob_send(size_t len, int (*send)(void *arg, const char *buf,
+                                         size_t len), void *arg)
+{
+  if (blob_chunk == NULL &&
+      (blob_chunk = malloc(DB_BLOB_CHUNK_SIZE)) == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  while (len > 0)
+  {
+    const size_t n = SB_MIN(len, DB_BLOB_CHUNK_SIZE);
+
+    db_blob_fill(blob_chunk, n);
+
+    if (send(arg, blob_chunk, n))
+      return 1;
+
+    len -= n;
+  }
+
+  return 0;
+}
+
+
+#if 0
+/* Free row fetched by db_fetch_row() */
+
+
+void db_free_row(db_row_t *row)
+{
+  free(row);
+}
+#endif
+
+/* Initialize multi-row insert operation */
+
+
+int db_bulk_insert_init(db_conn_t *con, const char *query, size_t query_len)
+{
+  drv_caps_t driver_caps;
+  int        rc;
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    return 0;
+  }
+  else if (con->state == DB_CONN_RESULT_SET &&
+           (rc = db_free_results_int(con)) != 0)
+  {
+    return 0;
+  }
+
+  /* Get database capabilites */
+  if (db_describe(con->driver, &driver_caps))
+  {
+    log_text(LOG_FATAL, "failed to get database capabilities!");
+    return 1;
+  }
+
+  /* Allocate query buffer */
+  if (query_len + 1 > BULK_PACKET_SIZE)
+  {
+    log_text(LOG_FATAL,
+             "Query length exceeds the maximum value (%u), aborting",
+             BULK_PACKET_SIZE);
+    return 1;
+  }
+  con->bulk_buflen = BULK_PACKET_SIZE;
+  con->bulk_buffer = (char *)malloc(con->bulk_buflen);
+  if (con->bulk_buffer == NULL)
+    return 1;
+
+  /*
+    With asynchronous queries, the next batch of rows is accumulated in one
+    buffer while the previous one is being executed from the other
+  */
+  if (con->driver->ops.query_async != NULL)
+  {
+    con->bulk_inflight = (char *)malloc(con->bulk_buflen);
+    if (con->bulk_inflight == NULL)
+    {
+      free(con->bulk_buffer);
+      con->bulk_buffer = NULL;
+      return 1;
+    }
+    memcpy(con->bulk_inflight, query, query_len);
+  }
+
+  con->bulk_commit_max = driver_caps.needs_commit ? ROWS_BEFORE_COMMIT : 0;
+  con->bulk_commit_cnt = 0;
+  memcpy(con->bulk_buffer, query, query_len);
+  con->bulk_ptr = query_len;
+  con->bulk_values = query_len;
+  con->bulk_cnt = 0;
+
+  return 0;
+}
+
+/* Add row to multi-row insert operation */
+
+int db_bulk_insert_next(db_conn_t *con, const char *query, size_t query_len)
+{
+  int rc;
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    return 0;
+  }
+  else if (con->state == DB_CONN_RESULT_SET &&
+           (rc = db_free_results_int(con)) != 0)
+  {
+    return 0;
+  }
+
+  if (con->bulk_buffer == NULL)
+  {
+    log_text(LOG_ALERT, "attempt to call bulk_insert_next() before bulk_insert_init()");
+    return 1;
+  }
+
+  /*
+    Reserve space for '\0' and ',' (if not the first chunk in
+    a bulk insert
+  */
+  if (con->bulk_ptr + query_len + 1 + (con->bulk_cnt>0) > con->bulk_buflen)
+  {
+    /* Is this a first row? */
+    if (!con->bulk_cnt)
+    {
+      log_text(LOG_FATAL,
+               "Query length exceeds the maximum value (%u), aborting",
+               con->bulk_buflen);
+      return 1;
+    }
+    if (db_bulk_do_insert(con, 0))
+      return 1;
+  }
+
+  if (con->bulk_cnt > 0)
+    con->bulk_buffer[con->bulk_ptr++] = ',';
+  memcpy(con->bulk_buffer + con->bulk_ptr, query, query_len);
+  con->bulk_ptr += query_len;
+  con->bulk_buffer[con->bulk_ptr] = '\0';
+
+  con->bulk_cnt++;
+
+  return 0;
+}
+
+/* Wait for an asynchronous bulk INSERT started by db_bulk_do_insert() */
+
+static int db_bulk_wait(db_conn_t *con)
+{
+  int done;
+
+  while (con->state == DB_CONN_ASYNC)
+  {
+    if (db_async_poll(&con, 1, -1, &done) < 0)
+      return 1;
+  }
+
+  return con->error != DB_ERROR_NONE;
+}
+
+/* Do the actual INSERT (and COMMIT, if necessary) */
+
+static int db_bulk_do_insert(db_conn_t *con, int is_last)
+{
+  if (!con->bulk_cnt)
+    return is_last ? db_bulk_wait(con) : 0;
+
+  if (con->bulk_inflight != NULL)
+  {
+    char * const tmp = con->bulk_inflight;
+
+    /* Both buffers start with the INSERT ... VALUES part of the query */
+    if (db_bulk_wait(con))
+      return 1;
+
+    con->bulk_inflight = con->bulk_buffer;
+    con->bulk_buffer = tmp;
+
+    if (db_query_async(con, con->bulk_inflight, con->bulk_ptr))
+      return 1;
+  }
+  else if (db_query(con, con->bulk_buffer, con->bulk_ptr) == NULL &&
+           con->error != DB_ERROR_NONE)
+    return 1;
+
+  if (con->bulk_commit_max != 0)
+  {
+    con->bulk_commit_cnt += con->bulk_cnt;
+
+    if (is_last || con->bulk_commit_cnt >= con->bulk_commit_max)
+    {
+      if (db_bulk_wait(con))
+        return 1;
+      if (db_query(con, "COMMIT", 6) == NULL &&
+          con->error != DB_ERROR_NONE)
+        return 1;
+      con->bulk_commit_cnt = 0;
+    }
+  }
+
+  con->bulk_ptr = con->bulk_values;
+  con->bulk_cnt = 0;
+
+  return is_last ? db_bulk_wait(con) : 0;
+}
+
+/* Finish multi-row insert operation */
+
+int db_bulk_insert_done(db_conn_t *con)
+{
+  int rc;
+
+  /* Flush remaining data in buffer, if any */
+  rc = db_bulk_do_insert(con, 1);
+
+  /* Do not leave an asynchronous query behind on errors */
+  if (rc)
+    db_bulk_wait(con);
+
+  if (con->bulk_buffer != NULL)
+  {
+    free(con->bulk_buffer);
+    con->bulk_buffer = NULL;
+  }
+  if (con->bulk_inflight != NULL)
+  {
+    free(con->bulk_inflight);
+    con->bulk_inflight = NULL;
+  }
+
+  return rc;
+}
+
+bool db_copy_supported(db_conn_t *con)
+{
+  return con->driver->ops.copy_begin != NULL;
+}
+
+/* Start a bulk load, rows are buffered in bulk_buffer */
+
+int db_copy_init(db_conn_t *con, const char *query, size_t query_len)
+{
+  int rc;
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    return 1;
+  }
+  else if (con->state == DB_CONN_RESULT_SET &&
+           (rc = db_free_results_int(con)) != 0)
+  {
+    return 1;
+  }
+
+  if (!db_copy_supported(con))
+  {
+    log_text(LOG_FATAL, "bulk loading is not supported by the '%s' driver",
+             con->driver->sname);
+    return 1;
+  }
+
+  con->bulk_buflen = BULK_PACKET_SIZE;
+  con->bulk_buffer = (char *)malloc(con->bulk_buflen);
+  if (con->bulk_buffer == NULL)
+    return 1;
+
+  con->bulk_ptr = 0;
+  con->bulk_cnt = 0;
+
+  if (con->driver->ops.copy_begin(con, query, query_len))
+  {
+    free(con->bulk_buffer);
+    con->bulk_buffer = NULL;
+    con->error = DB_ERROR_FATAL;
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Send buffered rows to the server */
+
+static int db_copy_flush(db_conn_t *con)
+{
+  if (con->bulk_ptr == 0)
+    return 0;
+
+  if (con->driver->ops.copy_data(con, con->bulk_buffer, con->bulk_ptr))
+  {
+    con->error = DB_ERROR_FATAL;
+    return 1;
+  }
+
+  con->bulk_ptr = 0;
+  con->bulk_cnt = 0;
+
+  return 0;
+}
+
+/* Add row to a bulk load */
+
+int db_copy_next(db_conn_t *con, const char *row, size_t row_len)
+{
+  if (con->bulk_buffer == NULL)
+  {
+    log_text(LOG_ALERT, "attempt to call copy_next() before copy_init()");
+    return 1;
+  }
+
+  /* Reserve space for the row terminator */
+  if (con->bulk_ptr + row_len + 1 > con->bulk_buflen)
+  {
+    if (db_copy_flush(con))
+      return 1;
+
+    /* Send rows that do not fit into the buffer directly */
+    if (row_len + 1 > con->bulk_buflen)
+    {
+      if (con->driver->ops.copy_data(con, row, row_len) ||
+          con->driver->ops.copy_data(con, "\n", 1))
+      {
+        con->error = DB_ERROR_FATAL;
+        return 1;
+      }
+      return 0;
+    }
+  }
+
+  memcpy(con->bulk_buffer + con->bulk_ptr, row, row_len);
+  con->bulk_ptr += row_len;
+  con->bulk_buffer[con->bulk_ptr++] = '\n';
+  con->bulk_cnt++;
+
+  return 0;
+}
+
+/* Flush remaining rows and finish a bulk load */
+
+int db_copy_done(db_conn_t *con)
+{
+  int rc;
+
+  if (con->bulk_buffer == NULL)
+    return 0;
+
+  rc = db_copy_flush(con);
+
+  free(con->bulk_buffer);
+  con->bulk_buffer = NULL;
+
+  /* Always finish the load to leave the connection usable */
+  if (con->driver->ops.copy_end(con))
+  {
+    con->error = DB_ERROR_FATAL;
+    rc = 1;
+  }
+
+  return rc;
+}
+
+/* Row generator state for db_copy_rows() */
+
+typedef struct
+{
+  const char *fmt;              /* row template */
+  uint64_t   first;             /* number of the first row */
+  uint64_t   nrows;             /* number of rows to generate */
+  uint64_t   row;               /* number of rows generated so far */
+  uint64_t   max;               /* upper bound for %r values */
+  char       *buf;              /* current row */
+  size_t     len;               /* length of the current row */
+  size_t     pos;               /* part of the current row already consumed */
+} db_copy_gen_t;
+
+/*
+  Generate a row from the template in gen->fmt, terminated with a newline:
+
+  %n - row number, starting from the first row number
+  %r - random number between 1 and max with the default distribution
+  %% - '%' character
+  #  - random digit
+  @  - random lowercase letter
+
+  Other characters are copied as is.
+*/
+
+static size_t db_copy_gen_row(db_copy_gen_t *gen)
+{
+  const char      *f;
+  char            *p = gen->buf;
+  sb_rand_chars_t chars = { .n = 0 };
+
+  for (f = gen->fmt; *f != '\0'; f++)
+  {
+    switch (*f) {
+    case '%':
+      if (f[1] == 'n')
+        p += sprintf(p, "%" PRIu64, gen->first + gen->row - 1);
+      else if (f[1] == 'r')
+        p += sprintf(p, "%" PRIu64, sb_rand_default64(1, gen->max));
+      else if (f[1] == '%')
+        *p++ = '%';
+      else
+      {
+        *p++ = '%';
+        continue;
+      }
+      f++;
+      break;
+    case '#':
+      *p++ = sb_rand_char(&chars, '0', '9');
+      break;
+    case '@':
+      *p++ = sb_rand_char(&chars, 'a', 'z');
+      break;
+    default:
+      *p++ = *f;
+    }
+  }
+  *p++ = '\n';
+
+  return p - gen->buf;
+}
+
+/* db_copy_read_t callback returning generated rows */
+
+static size_t db_copy_gen_read(void *arg, char *buf, size_t len)
+{
+  db_copy_gen_t * const gen = arg;
+  size_t        n = 0;
+
+  while (n < len)
+  {
+    /* Rows may be split between calls */
+    if (gen->pos == gen->len)
+    {
+      if (gen->row == gen->nrows)
+        break;
+      gen->row++;
+      gen->len = db_copy_gen_row(gen);
+      gen->pos = 0;
+    }
+
+    const size_t chunk = SB_MIN(len - n, gen->len - gen->pos);
+
+    memcpy(buf + n, gen->buf + gen->pos, chunk);
+    gen->pos += chunk;
+    n += chunk;
+  }
+
+  return n;
+}
+
+
+int db_copy_rows(db_conn_t *con, const char *query, size_t query_len,
+                 const char *fmt, uint64_t first, uint64_t nrows, uint64_t max)
+{
+  drv_ops_t * const ops = &con->driver->ops;
+  db_copy_gen_t     gen;
+  int               rc;
+
+  if (ops->copy_stream == NULL && ops->copy_begin == NULL)
+    return 1;
+
+  if (con->state == DB_CONN_INVALID)
+  {
+    log_text(LOG_ALERT, "attempt to use an already closed connection");
+    return -1;
+  }
+  else if (con->state == DB_CONN_RESULT_SET &&
+           (rc = db_free_results_int(con)) != 0)
+  {
+    return -1;
+  }
+
+  con->error = DB_ERROR_NONE;
+
+  memset(&gen, 0, sizeof(gen));
+  gen.fmt = fmt;
+  gen.first = first;
+  gen.nrows = nrows;
+  gen.max = max;
+  /* Every template character expands to at most 20 characters */
+  gen.buf = malloc(strlen(fmt) * 20 + 2);
+  if (gen.buf == NULL)
+    return -1;
+
+  if (ops->copy_stream != NULL)
+  {
+    rc = ops->copy_stream(con, query, query_len, db_copy_gen_read, &gen);
+  }
+  else if ((rc = ops->copy_begin(con, query, query_len)) == 0)
+  {
+    char   *buf = malloc(BULK_PACKET_SIZE);
+    size_t len;
+
+    if (buf == NULL)
+      rc = -1;
+    while (rc == 0 && (len = db_copy_gen_read(&gen, buf, BULK_PACKET_SIZE)) > 0)
+      if (ops->copy_data(con, buf, len))
+        rc = -1;
+    free(buf);
+
+    /* Always finish the load to leave the connection usable */
+    if (ops->copy_end(con))
+      rc = -1;
+  }
+  else
+    rc = -1;
+
+  free(gen.buf);
+
+  if (rc < 0)
+    con->error = DB_ERROR_FATAL;
+
+  return rc;
+}
+
+/* Print connection pool stats for the last report interval */
+
+static void db_report_pool_intermediate(sb_stat_t *stat)
+{
+  unsigned int nconns, nidle, nwaiting;
+
+  pthread_mutex_lock(&db_pool.mutex);
+  nconns = db_pool.nconns;
+  nidle = db_pool.nidle;
+  nwaiting = db_pool.nwaiting;
+  pthread_mutex_unlock(&db_pool.mutex);
+
+  if (db_pool.latency)
+  {
+    double *pcts = sb_histogram_get_pct_intermediate(&db_pool.histogram,
+                                                     sb_globals.percentiles,
+                                                     sb_globals.npercentiles);
+    char   *str = create_pct_string_intermediate(sb_globals.percentiles, pcts,
+                                                 sb_globals.npercentiles);
+
+    log_timestamp(LOG_NOTICE, stat->time_total,
+                  "pool: conns: %u/%u busy: %u waiting: %u checkout %s",
+                  nconns, db_globals.pool_size, nconns - nidle, nwaiting, str);
+
+    free(str);
+    free(pcts);
+  }
+  else
+    log_timestamp(LOG_NOTICE, stat->time_total,
+                  "pool: conns: %u/%u busy: %u waiting: %u",
+                  nconns, db_globals.pool_size, nconns - nidle, nwaiting);
+}
+
+
+/*
+  Find or add a server status variable, NULL if there are too many. 'added'
+  is set for new variables.
+*/
+
+static db_status_var_t *db_status_var_get(const db_value_t *name, bool *added)
+{
+  db_status_var_t *var;
+
+  for (unsigned int i = 0; i < db_status.nvars; i++)
+  {
+    var = &db_status.vars[i];
+    if (strlen(var->name) == name->len &&
+        !memcmp(var->name, name->ptr, name->len))
+    {
+      *added = false;
+      return var;
+    }
+  }
+
+  if (db_status.nvars >= DB_STATUS_VARS_MAX)
+    return NULL;
+
+  var = &db_status.vars[db_status.nvars];
+  var->name = strndup(name->ptr, name->len);
+  if (var->name == NULL)
+    return NULL;
+
+  db_status.nvars++;
+  *added = true;
+
+  return var;
+}
+
+
+/*
+  Execute --db-status-query and print per-second rates of the returned
+  counters since the previous report. The dedicated connection is created on
+  the first call, which only takes the initial sample.
+*/
+
+static void db_report_status_intermediate(sb_stat_t *stat)
+{
+  db_driver_t *drv;
+  db_result_t *rs;
+  db_row_t    *row;
+
+  if (db_status.disabled)
+    return;
+
+  if (db_status.con == NULL)
+  {
+    /* Nothing to sample until the script has created a driver */
+    if ((drv = ck_pr_load_ptr(&db_status.driver)) == NULL)
+      return;
+
+    if ((drv->ops.thread_init != NULL &&
+         drv->ops.thread_init(sb_tls_thread_id)) ||
+        (db_status.con = db_connection_create(drv)) == NULL)
+    {
+      log_text(LOG_ALERT, "cannot connect to sample server status, "
+               "--db-status-query is disabled");
+      db_status.disabled = true;
+      return;
+    }
+  }
+
+  rs = db_query(db_status.con, db_globals.status_query,
+                strlen(db_globals.status_query));
+  if (rs == NULL)
+  {
+    log_text(LOG_ALERT, "--db-status-query failed, disabling it");
+    db_status.disabled = true;
+    return;
+  }
+
+  if (rs->nfields < 2)
+  {
+    log_text(LOG_ALERT, "--db-status-query must return (name, value) rows, "
+             "disabling it");
+    db_free_results(rs);
+    db_status.disabled = true;
+    return;
+  }
+
+  /* Longer lines would be truncated by the logger anyway */
+  char   buf[4096];
+  size_t buflen = 0;
+
+  while ((row = db_fetch_row(rs)) != NULL)
+  {
+    if (row->values[0].ptr == NULL || row->values[1].ptr == NULL)
+      continue;
+
+    bool                  added;
+    db_status_var_t * const var = db_status_var_get(&row->values[0], &added);
+    if (var == NULL)
+      continue;
+
+    const double value = db_value_to_double(&row->values[1]);
+
+    /* Variables that have just appeared have no previous value */
+    if (!added && buflen < sizeof(buf))
+    {
+      const int n = snprintf(buf + buflen, sizeof(buf) - buflen,
+                             " %s/s: %4.2f", var->name,
+                             (value - var->value) / stat->time_interval);
+      if (n > 0)
+        buflen += (size_t) n;
+    }
+
+    var->value = value;
+  }
+
+  db_free_results(rs);
+
+  if (buflen > 0)
+    log_timestamp(LOG_NOTICE, stat->time_total, "status:%s", buf);
+}
+
+
+/*
+  Print the average number of active server sessions and the share of each
+  wait class since the previous report
+*/
+
+static void db_report_waits_intermediate(sb_stat_t *stat)
+{
+  const db_waits_t * const waits = stat->waits;
+  unsigned int             order[DB_WAIT_CLASSES_MAX];
+  uint64_t                 total = 0;
+
+  if (waits->nsamples == 0)
+    return;
+
+  for (unsigned int i = 0; i < waits->nclasses; i++)
+    total += waits->sessions[i];
+
+  db_waits_sort(waits, order);
+
+  /* Longer lines would be truncated by the logger anyway */
+  char   buf[4096];
+  size_t buflen = 0;
+
+  for (unsigned int i = 0; i < waits->nclasses && buflen < sizeof(buf); i++)
+  {
+    const uint64_t n = waits->sessions[order[i]];
+
+    if (n == 0)
+      break;
+
+    const int len = snprintf(buf + buflen, sizeof(buf) - buflen,
+                             " %s: %.1f%%", waits->names[order[i]],
+                             n * 100.0 / total);
+    if (len > 0)
+      buflen += (size_t) len;
+  }
+
+  log_timestamp(LOG_NOTICE, stat->time_total, "waits: sessions: %4.2f%s",
+                (double) total / waits->nsamples, buf);
+}
+
+
+/* Print cumulative server wait classes */
+
+static void db_report_waits_cumulative(sb_stat_t *stat)
+{
+  const db_waits_t * const waits = stat->waits;
+  unsigned int             order[DB_WAIT_CLASSES_MAX];
+  uint64_t                 total = 0;
+
+  if (waits->nsamples == 0)
+    return;
+
+  for (unsigned int i = 0; i < waits->nclasses; i++)
+    total += waits->sessions[i];
+
+  db_waits_sort(waits, order);
 
-  if (db_globals.debug)
+  log_text(LOG_NOTICE, "    server waits:");
+  log_text(LOG_NOTICE, "        samples:                         %" PRIu64,
+           waits->nsamples);
+  log_text(LOG_NOTICE, "        avg active sessions:             %.2f",
+           (double) total / waits->nsamples);
+
+  for (unsigned int i = 0; i < waits->nclasses; i++)
   {
-    free(exec_timers);
-    free(fetch_timers);
+    const uint64_t n = waits->sessions[order[i]];
+    char           name[64];
 
-    exec_timers = fetch_timers = NULL;
-  }
+    if (n == 0)
+      break;
 
-  SB_LIST_FOR_EACH(pos, &drivers)
-  {
-    drv = SB_LIST_ENTRY(pos, db_driver_t, listitem);
-    if (drv->initialized)
-    {
-      drv->ops.done();
-      pthread_mutex_destroy(&drv->mutex);
-    }
+    snprintf(name, sizeof(name), "%s:", waits->names[order[i]]);
+    log_text(LOG_NOTICE, "        %-32s %.2f%%", name, n * 100.0 / total);
   }
-
-  return;
 }
 
 
-/* Parse command line arguments */
-
+/* Print cumulative connection pool stats */
 
-int db_parse_arguments(void)
+static void db_report_pool_cumulative(sb_stat_t *stat)
 {
-  char *s;
+  uint64_t checkouts, waits;
 
-  s = sb_get_value_string("db-ps-mode");
+  pthread_mutex_lock(&db_pool.mutex);
+  checkouts = db_pool.checkouts;
+  waits = db_pool.waits;
+  pthread_mutex_unlock(&db_pool.mutex);
 
-  if (!strcmp(s, "auto"))
-    db_globals.ps_mode = DB_PS_MODE_AUTO;
-  else if (!strcmp(s, "disable"))
-    db_globals.ps_mode = DB_PS_MODE_DISABLE;
-  else
+  log_text(LOG_NOTICE, "    connection pool:");
+  log_text(LOG_NOTICE, "        checkouts:                       %-6" PRIu64
+           " (%.2f per sec.)", checkouts, checkouts / stat->time_interval);
+  log_text(LOG_NOTICE, "        waited:                          %-6" PRIu64
+           " (%.2f%%)", waits, checkouts > 0 ? waits * 100.0 / checkouts : 0);
+
+  if (db_pool.latency)
   {
-    log_text(LOG_FATAL, "Invalid value for db-ps-mode: %s", s);
-    return 1;
-  }
+    double *pcts = sb_histogram_get_pct_checkpoint(&db_pool.histogram,
+                                                   sb_globals.percentiles,
+                                                   sb_globals.npercentiles);
+    char   *str = create_pct_string_cumulative(sb_globals.percentiles, pcts,
+                                               sb_globals.npercentiles);
 
-  db_globals.driver = sb_get_value_string("db-driver");
+    /* Drop the trailing newline, log_text() adds its own */
+    if (*str != '\0')
+      str[strlen(str) - 1] = '\0';
 
-  db_globals.debug = sb_get_value_flag("db-debug");
-  
-  return 0;
-}
+    log_text(LOG_NOTICE, "        checkout time (ms):");
+    log_text(LOG_NOTICE, "%s", str);
 
+    free(str);
+    free(pcts);
+  }
+}
 
-/* Produce character representation of a 'bind' variable */
 
+/* Print cumulative connection stats, see --db-connect-stats */
 
-int db_print_value(db_bind_t *var, char *buf, int buflen)
+static void db_report_connect_cumulative(sb_stat_t *stat)
 {
-  int       n;
-  db_time_t *tm;
-
-  if (var->is_null != NULL && *var->is_null)
+  /* Reset counters like the checkpoint reset of the histogram below */
+  const uint64_t connects = ck_pr_fas_64(&db_connect_stats.connects, 0);
+  const uint64_t resets = ck_pr_fas_64(&db_connect_stats.resets, 0);
+  const uint64_t failures = ck_pr_fas_64(&db_connect_stats.failures, 0);
+
+  log_text(LOG_NOTICE, "    connections:");
+  log_text(LOG_NOTICE, "        connects:                        %-6" PRIu64
+           " (%.2f per sec.)", connects, connects / stat->time_interval);
+  log_text(LOG_NOTICE, "        session resets:                  %-6" PRIu64
+           " (%.2f per sec.)", resets, resets / stat->time_interval);
+  log_text(LOG_NOTICE, "        failed:                          %-6" PRIu64
+           " (%.2f per sec.)", failures, failures / stat->time_interval);
+
+  if (db_connect_stats.latency)
   {
-    n = snprintf(buf, buflen, "NULL");
-    return (n < buflen) ? n : -1;
-  }
-  
-  switch (var->type) {
-    case DB_TYPE_TINYINT:
-      n = snprintf(buf, buflen, "%hhd", *(char *)var->buffer);
-      break;
-    case DB_TYPE_SMALLINT:
-      n = snprintf(buf, buflen, "%hd", *(short *)var->buffer);
-      break;
-    case DB_TYPE_INT:
-      n = snprintf(buf, buflen, "%d", *(int *)var->buffer);
-      break;
-    case DB_TYPE_BIGINT:
-      n = snprintf(buf, buflen, "%lld", *(long long *)var->buffer);
-      break;
-    case DB_TYPE_FLOAT:
-      n = snprintf(buf, buflen, "%f", *(float *)var->buffer);
-      break;
-    case DB_TYPE_DOUBLE:
-      n = snprintf(buf, buflen, "%f", *(double *)var->buffer);
-      break;
-    case DB_TYPE_CHAR:
-    case DB_TYPE_VARCHAR:
-      n = snprintf(buf, buflen, "'%s'", (char *)var->buffer);
-      break;
-    case DB_TYPE_DATE:
-      tm = (db_time_t *)var->buffer;
-      n = snprintf(buf, buflen, "'%d-%d-%d'", tm->year, tm->month, tm->day);
-      break;
-    case DB_TYPE_TIME:
-      tm = (db_time_t *)var->buffer;
-      n = snprintf(buf, buflen, "'%d:%d:%d'", tm->hour, tm->minute,
-                   tm->second);
-      break;
-    case DB_TYPE_DATETIME:
-    case DB_TYPE_TIMESTAMP:
-      tm = (db_time_t *)var->buffer;
-      n = snprintf(buf, buflen, "'%d-%d-%d %d:%d:%d'", tm->year, tm->month,
-                   tm->day, tm->hour, tm->minute, tm->second);
-      break;
-    default:
-      n = 0;
-      break;
-  }
+    double *pcts = sb_histogram_get_pct_checkpoint(&db_connect_stats.histogram,
+                                                   sb_globals.percentiles,
+                                                   sb_globals.npercentiles);
+    char   *str = create_pct_string_cumulative(sb_globals.percentiles, pcts,
+                                               sb_globals.npercentiles);
 
-  return (n < buflen) ? n : -1;
-}
+    /* Drop the trailing newline, log_text() adds its own */
+    if (*str != '\0')
+      str[strlen(str) - 1] = '\0';
 
+    log_text(LOG_NOTICE, "        connect time (ms):");
+    log_text(LOG_NOTICE, "%s", str);
 
-#if 0
-/* Free row fetched by db_fetch_row() */
+    free(str);
+    free(pcts);
+  }
+}
 
 
-void db_free_row(db_row_t *row)
+/*
+  Print statistics of connects done before the benchmark start, i.e. in
+  prepare() and thread_init(), with --db-connect-stats. Called once when all
+  worker threads have been initialized. Later connects are only reported in
+  the regular connection statistics.
+*/
+
+void db_report_rampup(void)
 {
-  free(row);
-}
-#endif
+  if (!db_global_initialized || !db_globals.connect_stats)
+    return;
 
-/* Initialize multi-row insert operation */
+  db_rampup.active = false;
 
+  const uint64_t connects = db_rampup.connects;
+  const uint64_t failures = db_rampup.failures;
 
-int db_bulk_insert_init(db_conn_t *con, const char *query, size_t query_len)
-{
-  drv_caps_t driver_caps;
-  int        rc;
+  if (connects + failures == 0)
+    return;
 
-  if (con->state == DB_CONN_INVALID)
-  {
-    log_text(LOG_ALERT, "attempt to use an already closed connection");
-    return 0;
-  }
-  else if (con->state == DB_CONN_RESULT_SET &&
-           (rc = db_free_results_int(con)) != 0)
-  {
-    return 0;
-  }
+  const double seconds = NS2SEC((double) (db_rampup.last_ns -
+                                          db_rampup.first_ns));
 
-  /* Get database capabilites */
-  if (db_describe(con->driver, &driver_caps))
-  {
-    log_text(LOG_FATAL, "failed to get database capabilities!");
-    return 1;
-  }
+  log_text(LOG_NOTICE, "Connection ramp-up:");
+  log_text(LOG_NOTICE, "    established connections:             %-6" PRIu64
+           " (%.2f per sec.)", connects, seconds > 0 ? connects / seconds : 0);
+  log_text(LOG_NOTICE, "    failed attempts:                     %" PRIu64,
+           failures);
+  log_text(LOG_NOTICE, "    ramp-up time:                        %.4fs",
+           seconds);
 
-  /* Allocate query buffer */
-  if (query_len + 1 > BULK_PACKET_SIZE)
+  if (db_rampup.latency && connects > 0)
   {
-    log_text(LOG_FATAL,
-             "Query length exceeds the maximum value (%u), aborting",
-             BULK_PACKET_SIZE);
-    return 1;
+    double *pcts = sb_histogram_get_pct_cumulative(&db_rampup.histogram,
+                                                   sb_globals.percentiles,
+                                                   sb_globals.npercentiles);
+    char   *str = create_pct_string_cumulative(sb_globals.percentiles, pcts,
+                                               sb_globals.npercentiles);
+
+    /* Drop the trailing newline, log_text() adds its own */
+    if (*str != '\0')
+      str[strlen(str) - 1] = '\0';
+
+    log_text(LOG_NOTICE, "    connect time (ms):");
+    log_text(LOG_NOTICE, "%s", str);
+
+    free(str);
+    free(pcts);
   }
-  con->bulk_buflen = BULK_PACKET_SIZE;
-  con->bulk_buffer = (char *)malloc(con->bulk_buflen);
-  if (con->bulk_buffer == NULL)
-    return 1;
-  
-  con->bulk_commit_max = driver_caps.needs_commit ? ROWS_BEFORE_COMMIT : 0;
-  con->bulk_commit_cnt = 0;
-  strcpy(con->bulk_buffer, query);
-  con->bulk_ptr = query_len;
-  con->bulk_values = query_len;
-  con->bulk_cnt = 0;
 
-  return 0;
+  log_text(LOG_NOTICE, "");
 }
 
-/* Add row to multi-row insert operation */
 
-int db_bulk_insert_next(db_conn_t *con, const char *query, size_t query_len)
-{
-  int rc;
+/* Print cumulative event retry stats, see --db-retry-stats */
 
-  if (con->state == DB_CONN_INVALID)
-  {
-    log_text(LOG_ALERT, "attempt to use an already closed connection");
-    return 0;
-  }
-  else if (con->state == DB_CONN_RESULT_SET &&
-           (rc = db_free_results_int(con)) != 0)
+static void db_report_retry_cumulative(sb_stat_t *stat)
+{
+  /* Reset counters like the checkpoint reset of the histograms below */
+  const uint64_t events = ck_pr_fas_64(&db_retry_stats.events, 0);
+  const uint64_t retried = ck_pr_fas_64(&db_retry_stats.retried, 0);
+  const uint64_t retries = ck_pr_fas_64(&db_retry_stats.retries, 0);
+
+  log_text(LOG_NOTICE, "    retries:");
+  log_text(LOG_NOTICE, "        retried transactions:            %-6" PRIu64
+           " (%.2f per sec.)", retried, retried / stat->time_interval);
+  log_text(LOG_NOTICE, "        retries:                         %-6" PRIu64
+           " (%.2f per sec.)", retries, retries / stat->time_interval);
+  log_text(LOG_NOTICE, "        attempts per transaction:        %.2f",
+           events > 0 ? (double) (events + retries) / events : 0);
+
+  for (unsigned int i = 0; db_retry_stats.latency && i < 2; i++)
   {
-    return 0;
+    double *pcts =
+      sb_histogram_get_pct_checkpoint(&db_retry_stats.histograms[i],
+                                      sb_globals.percentiles,
+                                      sb_globals.npercentiles);
+    char   *str = create_pct_string_cumulative(sb_globals.percentiles, pcts,
+                                               sb_globals.npercentiles);
+
+    /* Drop the trailing newline, log_text() adds its own */
+    if (*str != '\0')
+      str[strlen(str) - 1] = '\0';
+
+    log_text(LOG_NOTICE, "        %s", db_retry_histogram_names[i]);
+    log_text(LOG_NOTICE, "%s", str);
+
+    free(str);
+    free(pcts);
   }
+}
 
-  if (con->bulk_buffer == NULL)
+
+/* Print cumulative latency split stats, see --db-latency-split */
+
+static void db_report_latency_split_cumulative(sb_stat_t *stat)
+{
+  static const char *titles[2] =
   {
-    log_text(LOG_ALERT, "attempt to call bulk_insert_next() before bulk_insert_init()");
-    return 1;
-  }
+    "time to first result (ms):", "transfer time (ms):"
+  };
 
-  /*
-    Reserve space for '\0' and ',' (if not the first chunk in
-    a bulk insert
-  */
-  if (con->bulk_ptr + query_len + 1 + (con->bulk_cnt>0) > con->bulk_buflen)
+  log_text(LOG_NOTICE, "    latency split:");
+
+  for (unsigned int i = 0; i < 3; i++)
   {
-    /* Is this a first row? */
-    if (!con->bulk_cnt)
+    /* Reset counters like the checkpoint reset of the histograms below */
+    const uint64_t queries = ck_pr_fas_64(&db_latency_split.queries[i], 0);
+    const uint64_t first_ns = ck_pr_fas_64(&db_latency_split.first_ns[i], 0);
+    const uint64_t transfer_ns =
+      ck_pr_fas_64(&db_latency_split.transfer_ns[i], 0);
+
+    log_text(LOG_NOTICE, "        %s:", db_latency_split_names[i]);
+    log_text(LOG_NOTICE, "            queries:                     %-6" PRIu64
+             " (%.2f per sec.)", queries, queries / stat->time_interval);
+    log_text(LOG_NOTICE, "            avg to first result (ms):    %.2f",
+             queries > 0 ? NS2MS((double) first_ns) / queries : 0.0);
+    log_text(LOG_NOTICE, "            avg transfer (ms):           %.2f",
+             queries > 0 ? NS2MS((double) transfer_ns) / queries : 0.0);
+
+    for (unsigned int j = 0; db_latency_split.latency && j < 2; j++)
     {
-      log_text(LOG_FATAL,
-               "Query length exceeds the maximum value (%u), aborting",
-               con->bulk_buflen);
-      return 1;
+      double *pcts =
+        sb_histogram_get_pct_checkpoint(&db_latency_split.histograms[i][j],
+                                        sb_globals.percentiles,
+                                        sb_globals.npercentiles);
+      char   *str = create_pct_string_cumulative(sb_globals.percentiles, pcts,
+                                                 sb_globals.npercentiles);
+
+      /* Drop the trailing newline, log_text() adds its own */
+      if (*str != '\0')
+        str[strlen(str) - 1] = '\0';
+
+      log_text(LOG_NOTICE, "            %s", titles[j]);
+      log_text(LOG_NOTICE, "%s", str);
+
+      free(str);
+      free(pcts);
     }
-    if (db_bulk_do_insert(con, 0))
-      return 1;
   }
+}
 
-  if (con->bulk_cnt > 0)
+
+/* Print cumulative cursor stats, see --db-fetch-size */
+
+static void db_report_cursor_cumulative(sb_stat_t *stat)
+{
+  /* Reset counters like the checkpoint reset of the histogram below */
+  const uint64_t queries = ck_pr_fas_64(&db_cursor_stats.queries, 0);
+  const uint64_t rows = ck_pr_fas_64(&db_cursor_stats.rows, 0);
+  const uint64_t fetch_ns = ck_pr_fas_64(&db_cursor_stats.fetch_ns, 0);
+
+  log_text(LOG_NOTICE, "    cursors:");
+  log_text(LOG_NOTICE, "        queries:                         %-6" PRIu64
+           " (%.2f per sec.)", queries, queries / stat->time_interval);
+  log_text(LOG_NOTICE, "        rows:                            %-6" PRIu64
+           " (%.2f per sec.)", rows, rows / stat->time_interval);
+  log_text(LOG_NOTICE, "        rows per sec. while fetching:    %.2f",
+           fetch_ns > 0 ? rows / NS2SEC((double) fetch_ns) : 0);
+
+  if (db_cursor_stats.latency)
   {
-    con->bulk_buffer[con->bulk_ptr] = ',';
-    strcpy(con->bulk_buffer + con->bulk_ptr + 1, query);
-  }
-  else
-    strcpy(con->bulk_buffer + con->bulk_ptr, query);
-  con->bulk_ptr += query_len + (con->bulk_cnt > 0);
+    double *pcts = sb_histogram_get_pct_checkpoint(&db_cursor_stats.histogram,
+                                                   sb_globals.percentiles,
+                                                   sb_globals.npercentiles);
+    char   *str = create_pct_string_cumulative(sb_globals.percentiles, pcts,
+                                               sb_globals.npercentiles);
 
-  con->bulk_cnt++;
+    /* Drop the trailing newline, log_text() adds its own */
+    if (*str != '\0')
+      str[strlen(str) - 1] = '\0';
 
-  return 0;
+    log_text(LOG_NOTICE, "        time to first row (ms):");
+    log_text(LOG_NOTICE, "%s", str);
+
+    free(str);
+    free(pcts);
+  }
 }
 
-/* Do the actual INSERT (and COMMIT, if necessary) */
 
-static int db_bulk_do_insert(db_conn_t *con, int is_last)
-{
-  if (!con->bulk_cnt)
-    return 0;
+/*
+  Print statistics of a set under a given title. 'count' and 'errors' name the
+  execution and error counters.
+*/
 
-  if (db_query(con, con->bulk_buffer, con->bulk_ptr) == NULL &&
-      con->error != DB_ERROR_NONE)
-    return 1;
+static void db_report_stat_set(db_stat_set_t *set, sb_stat_t *stat,
+                               const char *title, const char *count,
+                               const char *errors_name)
+{
+  pthread_mutex_lock(&set->mutex);
 
+  log_text(LOG_NOTICE, "    %s:", title);
 
-  if (con->bulk_commit_max != 0)
+  for (unsigned int i = 0; i < set->nstats; i++)
   {
-    con->bulk_commit_cnt += con->bulk_cnt;
+    db_stmt_stat_t * const s = set->stats[i];
 
-    if (is_last || con->bulk_commit_cnt >= con->bulk_commit_max)
-    {
-      if (db_query(con, "COMMIT", 6) == NULL &&
-          con->error != DB_ERROR_NONE)
-        return 1;
-      con->bulk_commit_cnt = 0;
-    }
-  }
+    /* Reset counters like the checkpoint reset of the histogram below */
+    const uint64_t queries = ck_pr_fas_64(&s->queries, 0);
+    const uint64_t errors = ck_pr_fas_64(&s->errors, 0);
+    const uint64_t time_ns = ck_pr_fas_64(&s->time_ns, 0);
 
-  con->bulk_ptr = con->bulk_values;
-  con->bulk_cnt = 0;
+    log_text(LOG_NOTICE, "        %s:", s->label);
+    log_text(LOG_NOTICE, "            %-29s%-6" PRIu64 " (%.2f per sec.)",
+             count, queries, queries / stat->time_interval);
+    log_text(LOG_NOTICE, "            %-29s%" PRIu64, errors_name, errors);
+    log_text(LOG_NOTICE, "            avg latency (ms):            %.2f",
+             queries > 0 ? NS2MS((double) time_ns) / queries : 0.0);
 
-  return 0;
-}
+    if (set->latency)
+    {
+      double *pcts = sb_histogram_get_pct_checkpoint(&s->histogram,
+                                                     sb_globals.percentiles,
+                                                     sb_globals.npercentiles);
+      char   *str = create_pct_string_cumulative(sb_globals.percentiles, pcts,
+                                                 sb_globals.npercentiles);
 
-/* Finish multi-row insert operation */
+      /* Drop the trailing newline, log_text() adds its own */
+      if (*str != '\0')
+        str[strlen(str) - 1] = '\0';
 
-int db_bulk_insert_done(db_conn_t *con)
-{
-  /* Flush remaining data in buffer, if any */
-  if (db_bulk_do_insert(con, 1))
-    return 1;
+      log_text(LOG_NOTICE, "            latency (ms):");
+      log_text(LOG_NOTICE, "%s", str);
 
-  if (con->bulk_buffer != NULL)
-  {
-    free(con->bulk_buffer);
-    con->bulk_buffer = NULL;
+      free(str);
+      free(pcts);
+    }
   }
 
-  return 0;
+  pthread_mutex_unlock(&set->mutex);
 }
 
+
 void db_report_intermediate(sb_stat_t *stat)
 {
   /* Use default stats handler if no drivers are used */
@@ -995,6 +4592,26 @@ void db_report_intermediate(sb_stat_t *stat)
     log_timestamp(LOG_NOTICE, stat->time_total,
                   "queue length: %" PRIu64", concurrency: %" PRIu64,
                   stat->queue_length, stat->concurrency);
+    sb_report_queue_intermediate(stat);
+  }
+
+  if (db_globals.pool_size > 0)
+    db_report_pool_intermediate(stat);
+
+  if (db_globals.status_query != NULL)
+    db_report_status_intermediate(stat);
+
+  if (stat->waits != NULL)
+    db_report_waits_intermediate(stat);
+
+  sb_list_item_t *pos;
+
+  SB_LIST_FOR_EACH(pos, &drivers)
+  {
+    db_driver_t * const drv = SB_LIST_ENTRY(pos, db_driver_t, listitem);
+
+    if (drv->initialized && drv->ops.report_intermediate != NULL)
+      drv->ops.report_intermediate(stat);
   }
 }
 
@@ -1034,6 +4651,45 @@ void db_report_cumulative(sb_stat_t *stat)
   log_text(LOG_NOTICE, "    reconnects:                          %-6" PRIu64
            " (%.2f per sec.)", stat->reconnects, stat->reconnects / seconds);
 
+  if (db_globals.pool_size > 0)
+    db_report_pool_cumulative(stat);
+
+  if (db_globals.connect_stats)
+    db_report_connect_cumulative(stat);
+
+  if (db_globals.retry_stats)
+    db_report_retry_cumulative(stat);
+
+  if (db_globals.outage_stats)
+    db_outage_report_cumulative();
+
+  if (db_globals.latency_split)
+    db_report_latency_split_cumulative(stat);
+
+  if (db_globals.fetch_size > 0)
+    db_report_cursor_cumulative(stat);
+
+  if (db_globals.stmt_stats)
+    db_report_stat_set(&db_stmt_stats, stat, "per-statement statistics",
+                       "queries:", "errors:");
+
+  if (db_txn_stats.nstats > 0)
+    db_report_stat_set(&db_txn_stats, stat, "per-transaction statistics",
+                       "transactions:", "rollbacks:");
+
+  if (stat->waits != NULL)
+    db_report_waits_cumulative(stat);
+
+  sb_list_item_t *pos;
+
+  SB_LIST_FOR_EACH(pos, &drivers)
+  {
+    db_driver_t * const drv = SB_LIST_ENTRY(pos, db_driver_t, listitem);
+
+    if (drv->initialized && drv->ops.report_cumulative != NULL)
+      drv->ops.report_cumulative(stat);
+  }
+
   if (db_globals.debug)
   {
     sb_timer_init(&exec_timer);
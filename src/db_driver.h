@@ -36,13 +36,49 @@ typedef enum
   DB_PS_MODE_DISABLE,
 } db_ps_mode_t;
 
+/* How result sets are read from the server */
+
+typedef enum
+{
+  DB_RESULT_MODE_STORE,     /* read the whole result set before returning */
+  DB_RESULT_MODE_STREAM,    /* read rows one by one as they are fetched */
+  DB_RESULT_MODE_DISCARD    /* read and drop rows without returning them */
+} db_result_mode_t;
+
 /* Global DB API options */
 
 typedef struct
 {
   db_ps_mode_t  ps_mode;   /* Requested prepared statements usage mode */
+  db_result_mode_t result_mode; /* Requested result set retrieval mode */
   char          *driver;   /* Requested database driver */
   unsigned char debug;     /* debug flag */
+  unsigned int  bulk_packet_size; /* Query length limit for bulk inserts */
+  unsigned int  pool_size; /* Maximum number of pooled connections */
+  bool          stmt_stats; /* Collect per-statement statistics */
+  bool          connect_stats; /* Collect connection statistics */
+  unsigned int  connect_rate; /* Maximum connects per second, 0 if unlimited */
+  unsigned int  connect_concurrency; /* Maximum concurrent connects */
+  const char    *status_query; /* Server status query, NULL if not used */
+  unsigned int  wait_sample_rate; /* Wait samples per second, 0 if unused */
+  const char    *wait_query; /* Wait class query, NULL for the default */
+  bool          dry_run;   /* Do not call the driver, see db_dry_run_driver() */
+  unsigned int  dry_run_rows;    /* Number of rows in fake result sets */
+  unsigned int  dry_run_columns; /* Number of columns in fake result sets */
+  unsigned int  retry_max; /* Maximum attempts of an event, 0 for unlimited */
+  uint64_t      retry_backoff_ns;     /* Delay before the first retry */
+  uint64_t      retry_backoff_max_ns; /* Maximum delay between retries */
+  bool          retry_stats; /* Report retries and first/retried latency */
+  bool          outage_stats; /* Measure outage downtime */
+  double        outage_recovery_pct; /* Recovered share of throughput */
+  uint64_t      outage_resolution_ns; /* Throughput sample interval */
+  bool          tcp_nodelay;   /* TCP_NODELAY, see db_socket_tune() */
+  bool          tcp_quickack;  /* TCP_QUICKACK */
+  unsigned int  socket_rcvbuf; /* SO_RCVBUF, 0 for the kernel default */
+  unsigned int  socket_sndbuf; /* SO_SNDBUF, 0 for the kernel default */
+  unsigned int  busy_poll;     /* SO_BUSY_POLL in microseconds, 0 if unused */
+  unsigned int  fetch_size;    /* Rows per cursor fetch, 0 if not used */
+  bool          latency_split; /* Split query latency at the first result */
 } db_globals_t;
 
 /* Driver capabilities definition */
@@ -84,9 +120,18 @@ typedef enum
   DB_TYPE_DATETIME,
   DB_TYPE_TIMESTAMP,
   DB_TYPE_CHAR,
-  DB_TYPE_VARCHAR
+  DB_TYPE_VARCHAR,
+  DB_TYPE_BLOB          /* generated value of *data_len bytes, see below */
 } db_bind_type_t;
 
+/*
+  DB_TYPE_BLOB parameters have no buffer. Their values are generated with
+  db_blob_fill() when a statement is executed, in chunks of
+  DB_BLOB_CHUNK_SIZE bytes where the driver can send values in parts, so
+  large values are never materialized in Lua.
+*/
+#define DB_BLOB_CHUNK_SIZE ((size_t) 64 * 1024)
+
 
 /* Structure used to represent DATE, TIME, DATETIME and TIMESTAMP values */
 
@@ -126,6 +171,7 @@ typedef int drv_op_thread_init(int);
 typedef int drv_op_describe(drv_caps_t *);
 typedef int drv_op_connect(struct db_conn *);
 typedef int drv_op_reconnect(struct db_conn *);
+typedef int drv_op_reset(struct db_conn *);
 typedef int drv_op_disconnect(struct db_conn *);
 typedef int drv_op_prepare(struct db_stmt *, const char *, size_t);
 typedef int drv_op_bind_param(struct db_stmt *, db_bind_t *, size_t);
@@ -139,6 +185,38 @@ typedef int drv_op_free_results(struct db_result *);
 typedef int drv_op_close(struct db_stmt *);
 typedef int drv_op_thread_done(int);
 typedef int drv_op_done(void);
+typedef int drv_op_query_async(struct db_conn *, const char *, size_t);
+typedef int drv_op_query_async_cont(struct db_conn *, int);
+typedef db_error_t drv_op_query_async_result(struct db_conn *,
+                                             struct db_result *);
+typedef int drv_op_socket(struct db_conn *);
+typedef int drv_op_pipeline_begin(struct db_conn *);
+typedef db_error_t drv_op_pipeline_end(struct db_conn *);
+typedef int drv_op_copy_begin(struct db_conn *, const char *, size_t);
+typedef int drv_op_copy_data(struct db_conn *, const char *, size_t);
+typedef int drv_op_copy_end(struct db_conn *);
+
+/*
+  Source of bulk load data for drivers pulling it from the client library:
+  fills up to len bytes of buf and returns the number of bytes written, 0 at
+  the end of data
+*/
+typedef size_t db_copy_read_t(void *, char *, size_t);
+typedef int drv_op_copy_stream(struct db_conn *, const char *, size_t,
+                               db_copy_read_t *, void *);
+typedef db_error_t drv_op_execute_batch(struct db_stmt *, struct db_result *);
+typedef void drv_op_report_intermediate(sb_stat_t *);
+typedef void drv_op_report_cumulative(sb_stat_t *);
+
+/*
+  Events to wait for on the connection socket before continuing an
+  asynchronous query. Returned by the query_async and query_async_cont driver
+  operations, 0 means the query is complete.
+*/
+#define DB_ASYNC_WAIT_READ    1
+#define DB_ASYNC_WAIT_WRITE   2
+#define DB_ASYNC_WAIT_EXCEPT  4
+#define DB_ASYNC_WAIT_TIMEOUT 8
 
 typedef struct
 {
@@ -148,6 +226,7 @@ typedef struct
   drv_op_connect         *connect;        /* connect to database */
   drv_op_disconnect      *disconnect;     /* disconnect from database */
   drv_op_reconnect       *reconnect;      /* reconnect with the same parameters */
+  drv_op_reset           *reset;          /* reset session state, optional */
   drv_op_prepare         *prepare;        /* prepare statement */
   drv_op_bind_param      *bind_param;     /* bind params for prepared statement */
   drv_op_bind_result     *bind_result;    /* bind results for prepared statement */
@@ -159,6 +238,33 @@ typedef struct
   drv_op_query           *query;          /* execute non-prepared statement */
   drv_op_thread_done     *thread_done;    /* thread-local driver deinitialization */
   drv_op_done            *done;           /* uninitialize driver */
+
+  /* Optional non-blocking query execution */
+  drv_op_query_async     *query_async;    /* start executing a query */
+  drv_op_query_async_cont *query_async_cont; /* continue a started query */
+  drv_op_query_async_result *query_async_result; /* get a completed query result */
+  drv_op_socket          *socket;         /* socket to wait on for a connection */
+
+  /* Optional statement pipelining */
+  drv_op_pipeline_begin  *pipeline_begin; /* enter pipeline mode */
+  drv_op_pipeline_end    *pipeline_end;   /* collect results, leave pipeline mode */
+
+  /* Optional bulk loading in the server's native format (e.g. COPY) */
+  drv_op_copy_begin      *copy_begin;     /* start loading with a query */
+  drv_op_copy_data       *copy_data;      /* send a chunk of rows */
+  drv_op_copy_end        *copy_end;       /* finish loading, get the result */
+  drv_op_copy_stream     *copy_stream;    /* load data read from a callback */
+
+  /*
+    Optional execution of all parameter sets added with db_batch_add() at
+    once, e.g. with array binding. Drivers may call db_batch_execute_rows()
+    for statements they cannot execute that way.
+  */
+  drv_op_execute_batch   *execute_batch;
+
+  /* Optional driver-specific statistics */
+  drv_op_report_intermediate *report_intermediate; /* print interval stats */
+  drv_op_report_cumulative *report_cumulative; /* print cumulative stats */
 } drv_ops_t;
 
 /* Database driver definition */
@@ -200,11 +306,14 @@ typedef struct db_result
   struct db_stmt *statement;    /* Pointer to prepared statement (if used) */
   void           *ptr;          /* Pointer to driver-specific data */
   db_row_t       row;           /* Last fetched row */
+  uint32_t       nvalues;       /* Allocated length of row.values */
 } db_result_t;
 
 typedef enum {
   DB_CONN_READY,
   DB_CONN_RESULT_SET,
+  DB_CONN_ASYNC,               /* asynchronous query in progress */
+  DB_CONN_PIPELINE,            /* statements are queued, see db_pipeline_begin() */
   DB_CONN_INVALID
 } db_conn_state_t;
 
@@ -225,10 +334,18 @@ typedef struct db_conn
   unsigned int    bulk_cnt;          /* Current number of rows in bulk insert buffer */
   unsigned int    bulk_buflen;       /* Current length of bulk_buffer */
   char            *bulk_buffer;      /* Bulk insert query buffer */
+  char            *bulk_inflight;    /* Buffer of an asynchronous bulk insert */
   unsigned int    bulk_ptr;          /* Current position in bulk_buffer */
   unsigned int    bulk_values;       /* Save value of bulk_ptr */
   unsigned int    bulk_commit_cnt;   /* Current value of uncommitted rows */
   unsigned int    bulk_commit_max;   /* Maximum value of uncommitted rows */
+  int             async_wait;        /* DB_ASYNC_WAIT_* events for DB_CONN_ASYNC */
+  int             pooled;            /* Connection belongs to the pool */
+  uint64_t        first_result_ns;   /* See db_first_result() */
+  const char      *server;           /* Server of the last query, if set by
+                                        the driver */
+  char            *query_buf;        /* Query text of emulated statements */
+  unsigned int    query_buflen;      /* Allocated length of query_buf */
 
   char            pad[SB_CACHELINE_PAD(sizeof(db_error_t) +
                                        sizeof(int) +
@@ -240,13 +357,42 @@ typedef struct db_conn
                                        sizeof(db_conn_state_t) +
                                        sizeof(int) +
                                        sizeof(int) * 2 +
+                                       sizeof(void *) * 2 +
+                                       sizeof(int) * 4 +
+                                       sizeof(int) +
+                                       sizeof(int) +
+                                       sizeof(uint64_t) +
+                                       sizeof(void *) +
                                        sizeof(void *) +
-                                       sizeof(int) * 4
+                                       sizeof(int)
                                        )];
 } db_conn_t;
 
 /* Prepared statement definition */
 
+/* Per-statement statistics, opaque outside of db_driver.c */
+typedef struct db_stmt_stat db_stmt_stat_t;
+
+/* Parameter value in a row added with db_batch_add() */
+typedef struct
+{
+  char            is_null;
+  unsigned long   len;             /* Length of strings, BLOBs and values */
+  size_t          offset;          /* Value offset in db_batch_t.data */
+} db_batch_value_t;
+
+/* Parameter sets of a statement to be executed with db_execute_batch() */
+typedef struct
+{
+  unsigned int     nrows;          /* Number of added rows */
+  unsigned int     nparams;        /* Number of values in each row */
+  db_batch_value_t *values;        /* nrows x nparams values */
+  unsigned int     values_rows;    /* Allocated rows of values */
+  char             *data;          /* Values of all rows */
+  size_t           data_len;
+  size_t           data_size;      /* Allocated size of data */
+} db_batch_t;
+
 typedef struct db_stmt
 {
   db_conn_t       *connection;     /* Connection which this statement belongs to */
@@ -258,6 +404,13 @@ typedef struct db_stmt
   char            emulated;        /* Should this statement be emulated? */
   sb_counter_type_t  counter;       /* Query type */
   void            *ptr;            /* Pointer to driver-specific data structure */
+  db_stmt_stat_t  *stat;           /* Statistics, if --db-stmt-stats is on */
+  char            *trace_query;    /* Query text, if --trace-sample-pct or
+                                      --slow-event-threshold is on */
+  db_bind_t       *param;          /* Bound parameters for trace_query and
+                                      batches */
+  unsigned int    param_len;       /* Length of the param array */
+  db_batch_t      batch;           /* Rows added with db_batch_add() */
 } db_stmt_t;
 
 extern db_globals_t db_globals;
@@ -272,6 +425,14 @@ db_driver_t *db_create(const char *);
 
 int db_destroy(db_driver_t *);
 
+void db_dry_run_driver(db_driver_t *);
+
+/*
+  Apply the --db-tcp-* and --db-socket-* options to a connected socket.
+  Called by drivers after each connect.
+*/
+void db_socket_tune(int fd);
+
 int db_describe(db_driver_t *, drv_caps_t *);
 
 db_conn_t *db_connection_create(db_driver_t *);
@@ -280,8 +441,21 @@ int db_connection_close(db_conn_t *);
 
 int db_connection_reconnect(db_conn_t *con);
 
+int db_connection_reset(db_conn_t *con);
+
 void db_connection_free(db_conn_t *con);
 
+/*
+  Check out a connection from the connection pool shared by all threads. A new
+  connection is created if all pooled connections are in use and there are
+  less than --db-pool-size of them, otherwise the caller waits for a connection
+  to be returned with db_pool_return().
+*/
+db_conn_t *db_pool_checkout(db_driver_t *drv);
+
+/* Return a connection to the pool it was checked out from */
+int db_pool_return(db_conn_t *con);
+
 db_stmt_t *db_prepare(db_conn_t *, const char *, size_t);
 
 int db_bind_param(db_stmt_t *, db_bind_t *, size_t);
@@ -290,8 +464,52 @@ int db_bind_result(db_stmt_t *, db_bind_t *, size_t);
 
 db_result_t *db_execute(db_stmt_t *);
 
+/*
+  Add the current values of the bound parameters as a row of the statement
+  batch. Returns 0 on success.
+*/
+int db_batch_add(db_stmt_t *);
+
+/*
+  Execute the statement once for all rows in its batch and empty the batch.
+  Drivers with array binding or pipelining send all rows at once, others
+  execute them one by one. Result sets are discarded, the return value is
+  always NULL, check con->error for errors.
+*/
+db_result_t *db_execute_batch(db_stmt_t *);
+
+/*
+  Copy the values of a batch row to the buffers of the bound parameters. Used
+  by drivers executing rows one by one.
+*/
+void db_batch_row(db_stmt_t *, unsigned int);
+
+/* Execute batch rows one by one with the execute driver operation */
+db_error_t db_batch_execute_rows(db_stmt_t *, db_result_t *);
+
 db_row_t *db_fetch_row(db_result_t *);
 
+/*
+  Fetch the remaining rows of a result set and return their number, or -1 on
+  errors
+*/
+int64_t db_count_rows(db_result_t *);
+
+/*
+  Fetch the remaining rows of a result set and store the sum of numeric values
+  in the specified column (0-based) into 'sum'. NULL values are skipped. Returns
+  the number of fetched rows, or -1 on errors.
+*/
+int64_t db_sum_column(db_result_t *, uint32_t, double *sum);
+
+/*
+  Fetch the remaining rows of a result set and check that values in the
+  specified column (0-based) are in ascending byte order, or strictly ascending
+  with 'strict', with NULL values first. Stores the result into 'sorted' and
+  returns the number of fetched rows, or -1 on errors.
+*/
+int64_t db_check_sorted(db_result_t *, uint32_t, bool strict, bool *sorted);
+
 db_result_t *db_query(db_conn_t *, const char *, size_t len);
 
 int db_free_results(db_result_t *);
@@ -300,10 +518,88 @@ int db_store_results(db_result_t *);
 
 int db_close(db_stmt_t *);
 
+int db_stmt_set_label(db_stmt_t *, const char *);
+
+/* Per-transaction-type statistics reported at the end of a run */
+db_stmt_stat_t *db_txn_stat_get(const char *label);
+uint64_t db_txn_stat_start(void);
+void db_txn_stat_stop(db_stmt_stat_t *, uint64_t start, bool rolled_back);
+
+/*
+  Statistics of queries timed by scripts, reported with --db-stmt-stats, e.g.
+  for queries grouped by fingerprint. Start times come from
+  db_txn_stat_start().
+*/
+db_stmt_stat_t *db_query_stat_get(const char *label);
+void db_query_stat_stop(db_stmt_stat_t *, uint64_t start, bool error);
+
+/*
+  Return true if an asynchronous query can be started on the connection, i.e.
+  the driver supports them and the connection is not in pipeline mode
+*/
+bool db_async_available(db_conn_t *);
+
+/*
+  Start executing a query asynchronously, i.e. without waiting for the
+  result. Returns 0 on success. The query buffer must be valid until the query
+  completes.
+*/
+int db_query_async(db_conn_t *, const char *, size_t len);
+
+/*
+  Drive asynchronous queries pending on an array of connections until at least
+  one of them completes or the timeout in milliseconds expires (-1 means no
+  timeout). Array indexes of completed connections are stored into 'done' which
+  must have room for 'n' elements. Returns the number of completed connections
+  (0 on timeout or when no queries are pending), or -1 on error.
+*/
+int db_async_poll(db_conn_t **cons, size_t n, int timeout_ms, int *done);
+
+/*
+  Return the result set of a completed asynchronous query, or NULL if the
+  query has not returned a result set or failed (check con->error).
+*/
+db_result_t *db_async_result(db_conn_t *);
+
+/*
+  Start a group of statements to be sent to the server without waiting for
+  results of individual statements, if supported and enabled by the driver.
+  Statements executed until db_pipeline_end() return no result sets, errors
+  may be deferred until db_pipeline_end(). When pipelining is not available
+  statements are executed as usual. Returns 0 on success.
+*/
+int db_pipeline_begin(db_conn_t *);
+
+/*
+  Wait for results of all statements executed since db_pipeline_begin() and
+  account them in statistic counters. Returns 0 on success, otherwise the error
+  is available in con->error.
+*/
+int db_pipeline_end(db_conn_t *);
+
 void db_done(void);
 
 int db_print_value(db_bind_t *, char *, int);
 
+/* Fill a buffer with the contents of a DB_TYPE_BLOB value */
+void db_blob_fill(char *buf, size_t len);
+
+/*
+  Generate a DB_TYPE_BLOB value of a given length in chunks of at most
+  DB_BLOB_CHUNK_SIZE bytes and pass each of them to 'send', which returns
+  non-zero on errors. Returns 0 on success.
+*/
+int db_blob_send(size_t len, int (*send)(void *arg, const char *buf,
+                                         size_t len), void *arg);
+
+/*
+  Build the query text of an emulated prepared statement with its bound
+  parameter values. The text is stored in a buffer owned by the connection and
+  reused by subsequent calls, so it is only valid until the next call. Returns
+  NULL on memory allocation failure.
+*/
+const char *db_print_query(db_stmt_t *, unsigned int *);
+
 /* Initialize multi-row insert operation */
 int db_bulk_insert_init(db_conn_t *, const char *, size_t);
 
@@ -313,9 +609,66 @@ int db_bulk_insert_next(db_conn_t *, const char *, size_t);
 /* Finish multi-row insert operation */
 int db_bulk_insert_done(db_conn_t *);
 
+/* Return true if the driver supports bulk loading with db_copy_init() */
+bool db_copy_supported(db_conn_t *);
+
+/*
+  Start bulk loading with a driver-specific query, e.g. COPY ... FROM STDIN for
+  pgsql. Rows are then passed to db_copy_next() in the format expected by the
+  server, without a trailing newline.
+*/
+int db_copy_init(db_conn_t *, const char *, size_t);
+
+/* Add a row to a bulk load */
+int db_copy_next(db_conn_t *, const char *, size_t);
+
+/* Finish a bulk load */
+int db_copy_done(db_conn_t *);
+
+/*
+  Bulk load nrows rows numbered from first, generated from a template, see
+  db_copy_gen_row(). Works
+  with both push (copy_begin) and pull (copy_stream) drivers. Returns 0 on
+  success, a positive value if bulk loading is not supported by the driver or
+  disabled on the server, and a negative value on errors.
+*/
+int db_copy_rows(db_conn_t *, const char *, size_t, const char *, uint64_t,
+                 uint64_t, uint64_t);
+
 /* Print database-specific test stats */
 void db_report_intermediate(sb_stat_t *);
 void db_report_cumulative(sb_stat_t *);
+void db_report_rampup(void);
+
+/*
+  Event retries after ignorable errors, called from thread_run() in
+  sysbench.lua
+*/
+bool db_retry_wait(int thread_id, unsigned int attempt);
+bool db_retry_stats_enabled(void);
+void db_retry_event_start(int thread_id);
+void db_retry_event_stop(int thread_id, unsigned int attempts);
+
+/*
+  Called by drivers when the first packet of a query result arrives. With
+  --db-latency-split the query latency is split into the time before and after
+  the first call during a query.
+*/
+void db_first_result(db_conn_t *con);
+
+/*
+  Account a statement executed through a server-side cursor with
+  --db-fetch-size. Called by drivers with the time from execution to the first
+  row and to the last one.
+*/
+void db_cursor_stats_add(db_conn_t *con, uint64_t first_row_ns,
+                         uint64_t total_ns, uint64_t rows);
+
+/*
+  Determine the counter type (read, write, other) of a query from its first
+  keyword. Used by drivers that do not execute queries.
+*/
+sb_counter_type_t db_query_counter(const char *query, size_t len);
 
 /* DB drivers registrars */
 
@@ -327,4 +680,10 @@ int register_driver_mysql(sb_list_t *);
 int register_driver_pgsql(sb_list_t *);
 #endif
 
+#ifdef USE_SQLITE
+int register_driver_sqlite(sb_list_t *);
+#endif
+
+int register_driver_mock(sb_list_t *);
+
 #endif /* DB_DRIVER_H */
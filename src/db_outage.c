@@ -0,0 +1,303 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Downtime of outages such as failovers. A sampler thread records the total
+  number of events every --db-outage-resolution milliseconds, and failed
+  attempts of events are timestamped exactly. Reports look at the first
+  failure: the outage starts where throughput before it dropped below
+  --db-outage-recovery-pct percent of the throughput before the outage, or at
+  the failure itself, and ends at the first sample after the failure in which
+  throughput is back at that level.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STDIO_H
+# include <stdio.h>
+#endif
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+#include "db_outage.h"
+#include "db_driver.h"
+#include "sb_counter.h"
+#include "sb_logger.h"
+#include "sb_thread.h"
+#include "sb_timer.h"
+#include "sb_ck_pr.h"
+
+/* Total number of events at a point of the run */
+typedef struct
+{
+  uint64_t time_ns;             /* sb_exec_timer value */
+  uint64_t events;
+} outage_sample_t;
+
+static pthread_mutex_t   mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t    cond = PTHREAD_COND_INITIALIZER;
+
+static pthread_t         sampler_thread;
+static bool              sampler_created;
+static bool              sampler_stopping;
+
+/* Protected by mutex */
+static outage_sample_t *samples;
+static size_t            nsamples;
+static size_t            samples_size;
+
+/* Failed attempts of events, updated atomically */
+static uint64_t          errors;
+static uint64_t          first_error_ns;
+static uint64_t          last_error_ns;
+
+
+static void add_sample(uint64_t time_ns, uint64_t events)
+{
+  if (nsamples == samples_size)
+  {
+    const size_t      size = (samples_size > 0) ? samples_size * 2 : 1024;
+    outage_sample_t *tmp = realloc(samples, size * sizeof(*samples));
+
+    if (tmp == NULL)
+      return;
+
+    samples = tmp;
+    samples_size = size;
+  }
+
+  samples[nsamples].time_ns = time_ns;
+  samples[nsamples].events = events;
+  nsamples++;
+}
+
+
+static void *sampler_proc(void *arg)
+{
+  const uint64_t interval_ns = db_globals.outage_resolution_ns;
+
+  (void) arg; /* unused */
+
+  pthread_mutex_lock(&mutex);
+
+  while (!sampler_stopping)
+  {
+    struct timespec ts;
+    sb_counters_t   cnt;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += (long) (interval_ns % NS_PER_SEC);
+    ts.tv_sec += (time_t) (interval_ns / NS_PER_SEC) + ts.tv_nsec / NS_PER_SEC;
+    ts.tv_nsec %= NS_PER_SEC;
+
+    pthread_cond_timedwait(&cond, &mutex, &ts);
+
+    if (sampler_stopping)
+      break;
+
+    /* The timer starts shortly after worker threads are released */
+    const int64_t now = (int64_t) sb_timer_value(&sb_exec_timer);
+    if (now <= 0)
+      continue;
+
+    sb_counters_agg_total(cnt);
+    add_sample((uint64_t) now, cnt[SB_CNT_EVENT]);
+  }
+
+  pthread_mutex_unlock(&mutex);
+
+  return NULL;
+}
+
+
+int db_outage_start(void)
+{
+  if (!db_globals.outage_stats || sampler_created)
+    return 0;
+
+  nsamples = 0;
+  errors = 0;
+  first_error_ns = 0;
+  last_error_ns = 0;
+  sampler_stopping = false;
+
+  if (sb_thread_create(&sampler_thread, &sb_thread_attr, &sampler_proc,
+                       NULL) != 0)
+  {
+    log_errno(LOG_FATAL, "sb_thread_create() for the outage sampler failed.");
+    return 1;
+  }
+
+  sampler_created = true;
+
+  return 0;
+}
+
+
+void db_outage_stop(void)
+{
+  if (!sampler_created)
+    return;
+
+  pthread_mutex_lock(&mutex);
+  sampler_stopping = true;
+  pthread_cond_signal(&cond);
+  pthread_mutex_unlock(&mutex);
+
+  if (sb_thread_join(sampler_thread, NULL))
+    log_errno(LOG_FATAL, "Terminating the outage sampler failed.");
+
+  sampler_created = false;
+
+  free(samples);
+  samples = NULL;
+  nsamples = 0;
+  samples_size = 0;
+}
+
+
+void db_outage_error(void)
+{
+  if (!sampler_created)
+    return;
+
+  const uint64_t now = SB_MAX(sb_timer_value(&sb_exec_timer), (uint64_t) 1);
+  uint64_t       last;
+
+  ck_pr_inc_64(&errors);
+  ck_pr_cas_64(&first_error_ns, 0, now);
+
+  while ((last = ck_pr_load_64(&last_error_ns)) < now &&
+         !ck_pr_cas_64(&last_error_ns, last, now))
+    ;
+}
+
+
+/* Start time of sample i */
+
+static uint64_t sample_start(size_t i)
+{
+  return (i > 0) ? samples[i - 1].time_ns : 0;
+}
+
+
+/* Events per second in sample i */
+
+static double sample_rate(size_t i)
+{
+  const uint64_t ns = samples[i].time_ns - sample_start(i);
+  const uint64_t events = samples[i].events -
+    ((i > 0) ? samples[i - 1].events : 0);
+
+  return (ns > 0) ? events / NS2SEC(ns) : 0;
+}
+
+
+/* Print a point of the run relative to the start like intermediate reports */
+
+static void print_time(const char *name, uint64_t ns)
+{
+  log_text(LOG_NOTICE, "        %-32s %.3fs", name,
+           NS2SEC(ns) - sb_globals.warmup_elapsed);
+}
+
+
+void db_outage_report_cumulative(void)
+{
+  const double   pct = db_globals.outage_recovery_pct;
+  const uint64_t first = ck_pr_load_64(&first_error_ns);
+  const uint64_t last = ck_pr_load_64(&last_error_ns);
+  char           name[64];
+  size_t         f, s, r;
+
+  if (!sampler_created)
+    return;
+
+  log_text(LOG_NOTICE, "    outage:");
+
+  if (first == 0)
+  {
+    log_text(LOG_NOTICE, "        failed attempts:                 0");
+    return;
+  }
+
+  log_text(LOG_NOTICE, "        failed attempts:                 %" PRIu64,
+           ck_pr_load_64(&errors));
+  print_time("first failure:", first);
+  print_time("last failure:", last);
+
+  pthread_mutex_lock(&mutex);
+
+  /* Sample containing the first failure */
+  for (f = 0; f < nsamples && samples[f].time_ns < first; f++)
+    ;
+
+  /*
+    Walk back over the samples preceding the failure with throughput below
+    the recovery level of the average before it to find where the outage
+    started, then take the average before the outage as the baseline
+  */
+  uint64_t start = first;
+  double   baseline = 0;
+
+  if (f > 0)
+    baseline = samples[f - 1].events / NS2SEC(samples[f - 1].time_ns);
+
+  for (s = f; s > 0 && sample_rate(s - 1) < baseline * pct / 100; s--)
+    start = sample_start(s - 1);
+
+  baseline = (s > 0) ?
+    samples[s - 1].events / NS2SEC(samples[s - 1].time_ns) : 0;
+
+  if (baseline <= 0)
+  {
+    pthread_mutex_unlock(&mutex);
+    log_text(LOG_NOTICE, "        pre-outage throughput:           unknown");
+    return;
+  }
+
+  /* First full sample after the failure with recovered throughput */
+  for (r = f + 1; r < nsamples && sample_rate(r) < baseline * pct / 100; r++)
+    ;
+
+  const uint64_t recovered = (r < nsamples) ? sample_start(r) : 0;
+
+  pthread_mutex_unlock(&mutex);
+
+  log_text(LOG_NOTICE, "        pre-outage throughput:           %.2f per "
+           "sec.", baseline);
+  print_time("outage start:", start);
+
+  snprintf(name, sizeof(name), "recovered to %g%%:", pct);
+
+  if (recovered == 0)
+  {
+    log_text(LOG_NOTICE, "        %-32s no", name);
+    return;
+  }
+
+  print_time(name, recovered);
+  log_text(LOG_NOTICE, "        downtime:                        %.3fs",
+           NS2SEC(recovered - start));
+}
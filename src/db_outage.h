@@ -0,0 +1,44 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Downtime of outages such as failovers, see --db-outage-stats */
+
+#ifndef DB_OUTAGE_H
+#define DB_OUTAGE_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/*
+  Start recording the throughput timeline. Called when worker threads have
+  started and sb_exec_timer is set. Does nothing unless --db-outage-stats is
+  enabled. Returns 0 on success.
+*/
+int db_outage_start(void);
+
+/* Stop recording and free the timeline */
+void db_outage_stop(void);
+
+/* Account a failed attempt of an event, called by db_retry_wait() */
+void db_outage_error(void);
+
+/* Print the outage window and recovery time with a cumulative report */
+void db_outage_report_cumulative(void);
+
+#endif /* DB_OUTAGE_H */
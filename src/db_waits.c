@@ -0,0 +1,342 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Server wait event sampling. A sampler thread executes --db-wait-query
+  --db-wait-sample-rate times per second on a dedicated connection. The query
+  returns a row with the wait class of each active session, or NULL for
+  sessions that are not waiting, which are counted as 'CPU'. Reports show the
+  average number of active sessions and the share of each class, i.e. whether
+  the server is mostly busy executing, waiting on locks, the log or I/O.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+#include "db_waits.h"
+#include "sb_logger.h"
+#include "sb_thread.h"
+#include "sb_timer.h"
+
+/* Class of sessions that are not waiting */
+#define CPU_CLASS "CPU"
+
+/* Default queries by driver name */
+static const struct
+{
+  const char *driver;
+  const char *query;
+} default_queries[] =
+{
+  {
+    "mysql",
+    "SELECT IF(w.EVENT_NAME IS NOT NULL AND w.END_EVENT_ID IS NULL, "
+    "w.EVENT_NAME, CONCAT('state/', t.PROCESSLIST_STATE)) "
+    "FROM performance_schema.threads t "
+    "LEFT JOIN performance_schema.events_waits_current w "
+    "ON w.THREAD_ID = t.THREAD_ID "
+    "WHERE t.TYPE = 'FOREGROUND' AND t.PROCESSLIST_COMMAND <> 'Sleep' "
+    "AND t.PROCESSLIST_ID <> CONNECTION_ID()"
+  },
+  {
+    "pgsql",
+    "SELECT wait_event_type || '/' || wait_event FROM pg_stat_activity "
+    "WHERE state = 'active' AND backend_type = 'client backend' "
+    "AND pid <> pg_backend_pid()"
+  },
+  { NULL, NULL }
+};
+
+/* Samples since the last intermediate report and checkpoint */
+typedef struct
+{
+  uint64_t nsamples;
+  uint64_t sessions[DB_WAIT_CLASSES_MAX];
+} waits_acc_t;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  cond = PTHREAD_COND_INITIALIZER;
+
+static const char      *query;
+static uint64_t        interval_ns;
+
+static pthread_t       sampler_thread;
+static bool            sampler_created;
+static bool            sampler_stopping;
+static bool            overflow;
+
+/* Protected by mutex */
+static char            *names[DB_WAIT_CLASSES_MAX];
+static unsigned int    nclasses;
+static waits_acc_t     intermediate;
+static waits_acc_t     cumulative;
+
+/* Returned by db_waits_intermediate() and db_waits_checkpoint() */
+static db_waits_t      report;
+
+
+const char *db_waits_default_query(const char *driver)
+{
+  for (unsigned int i = 0; default_queries[i].driver != NULL; i++)
+    if (!strcmp(default_queries[i].driver, driver))
+      return default_queries[i].query;
+
+  return NULL;
+}
+
+
+/* Find or add a wait class, -1 if there are too many. Called with mutex. */
+
+static int class_get_locked(const char *name, size_t len)
+{
+  for (unsigned int i = 0; i < nclasses; i++)
+    if (strlen(names[i]) == len && !memcmp(names[i], name, len))
+      return (int) i;
+
+  if (nclasses >= DB_WAIT_CLASSES_MAX)
+  {
+    if (!overflow)
+      log_text(LOG_WARNING, "more than %d distinct wait classes, sessions "
+               "in the rest are not counted", DB_WAIT_CLASSES_MAX);
+    overflow = true;
+    return -1;
+  }
+
+  if ((names[nclasses] = strndup(name, len)) == NULL)
+    return -1;
+
+  return (int) nclasses++;
+}
+
+
+/* Take a sample. Returns 0 on success. */
+
+static int sample(db_conn_t *con)
+{
+  db_result_t *rs;
+  db_row_t    *row;
+
+  rs = db_query(con, query, strlen(query));
+  if (rs == NULL)
+  {
+    /* Statements without results are not an error */
+    if (con->error == DB_ERROR_NONE)
+      return 0;
+
+    log_text(LOG_ALERT, "--db-wait-query failed, disabling it");
+    return 1;
+  }
+
+  pthread_mutex_lock(&mutex);
+
+  while ((row = db_fetch_row(rs)) != NULL)
+  {
+    const db_value_t * const v = &row->values[0];
+    const int                id = (v->ptr != NULL) ?
+      class_get_locked(v->ptr, v->len) :
+      class_get_locked(CPU_CLASS, strlen(CPU_CLASS));
+
+    if (id < 0)
+      continue;
+
+    intermediate.sessions[id]++;
+    cumulative.sessions[id]++;
+  }
+
+  intermediate.nsamples++;
+  cumulative.nsamples++;
+
+  pthread_mutex_unlock(&mutex);
+
+  db_free_results(rs);
+
+  return 0;
+}
+
+
+static void *sampler_proc(void *arg)
+{
+  db_driver_t * const drv = arg;
+  db_conn_t           *con = NULL;
+
+  sb_tls_thread_id = sb_globals.threads;
+
+  if ((drv->ops.thread_init != NULL &&
+       drv->ops.thread_init(sb_tls_thread_id)) ||
+      (con = db_connection_create(drv)) == NULL)
+  {
+    log_text(LOG_ALERT, "cannot connect to sample server waits, "
+             "--db-wait-sample-rate is disabled");
+    return NULL;
+  }
+
+  pthread_mutex_lock(&mutex);
+
+  while (!sampler_stopping)
+  {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += (long) interval_ns;
+    ts.tv_sec += ts.tv_nsec / NS_PER_SEC;
+    ts.tv_nsec %= NS_PER_SEC;
+
+    pthread_cond_timedwait(&cond, &mutex, &ts);
+
+    if (sampler_stopping)
+      break;
+
+    pthread_mutex_unlock(&mutex);
+    const int rc = sample(con);
+    pthread_mutex_lock(&mutex);
+
+    if (rc)
+      break;
+  }
+
+  pthread_mutex_unlock(&mutex);
+
+  db_connection_close(con);
+  db_connection_free(con);
+
+  if (drv->ops.thread_done != NULL)
+    drv->ops.thread_done(sb_tls_thread_id);
+
+  return NULL;
+}
+
+
+int db_waits_start(db_driver_t *drv)
+{
+  const unsigned int rate = db_globals.wait_sample_rate;
+
+  /* Samples are only reported by the 'run' command */
+  if (rate == 0 || sampler_created || sb_globals.cmdname == NULL ||
+      strcmp(sb_globals.cmdname, "run"))
+    return 0;
+
+  query = db_globals.wait_query;
+  if (query == NULL && (query = db_waits_default_query(drv->sname)) == NULL)
+  {
+    log_text(LOG_FATAL, "--db-wait-sample-rate requires --db-wait-query with "
+             "the '%s' driver", drv->sname);
+    return 1;
+  }
+
+  interval_ns = NS_PER_SEC / rate;
+  sampler_stopping = false;
+
+  if (sb_thread_create(&sampler_thread, &sb_thread_attr, &sampler_proc,
+                       drv) != 0)
+  {
+    log_errno(LOG_FATAL, "sb_thread_create() for the wait sampler failed.");
+    return 1;
+  }
+
+  sampler_created = true;
+
+  return 0;
+}
+
+
+void db_waits_stop(void)
+{
+  if (!sampler_created)
+    return;
+
+  pthread_mutex_lock(&mutex);
+  sampler_stopping = true;
+  pthread_cond_signal(&cond);
+  pthread_mutex_unlock(&mutex);
+
+  if (sb_thread_join(sampler_thread, NULL))
+    log_errno(LOG_FATAL, "Terminating the wait sampler failed.");
+
+  sampler_created = false;
+
+  for (unsigned int i = 0; i < nclasses; i++)
+    free(names[i]);
+  nclasses = 0;
+
+  memset(&intermediate, 0, sizeof(intermediate));
+  memset(&cumulative, 0, sizeof(cumulative));
+}
+
+
+/* Copy and reset accumulated samples */
+
+static const db_waits_t *snapshot(waits_acc_t *acc)
+{
+  if (!sampler_created)
+    return NULL;
+
+  pthread_mutex_lock(&mutex);
+
+  report.nsamples = acc->nsamples;
+  report.nclasses = nclasses;
+  for (unsigned int i = 0; i < nclasses; i++)
+  {
+    report.names[i] = names[i];
+    report.sessions[i] = acc->sessions[i];
+  }
+
+  memset(acc, 0, sizeof(*acc));
+
+  pthread_mutex_unlock(&mutex);
+
+  return &report;
+}
+
+
+const db_waits_t *db_waits_intermediate(void)
+{
+  return snapshot(&intermediate);
+}
+
+
+const db_waits_t *db_waits_checkpoint(void)
+{
+  return snapshot(&cumulative);
+}
+
+
+void db_waits_sort(const db_waits_t *waits, unsigned int *order)
+{
+  for (unsigned int i = 0; i < waits->nclasses; i++)
+  {
+    unsigned int j = i;
+
+    while (j > 0 && waits->sessions[order[j - 1]] < waits->sessions[i])
+    {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+}
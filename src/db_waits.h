@@ -0,0 +1,79 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Server wait event sampling, see --db-wait-sample-rate */
+
+#ifndef DB_WAITS_H
+#define DB_WAITS_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <inttypes.h>
+#endif
+
+#include <stdbool.h>
+
+#include "db_driver.h"
+
+/*
+  Maximum number of distinct wait classes, sessions in further ones are
+  ignored
+*/
+#define DB_WAIT_CLASSES_MAX 32
+
+/* Wait class samples for a report */
+typedef struct db_waits
+{
+  uint64_t     nsamples;        /* Number of samples taken */
+  unsigned int nclasses;
+  const char   *names[DB_WAIT_CLASSES_MAX];
+  /* Sum of active sessions in each class over all samples */
+  uint64_t     sessions[DB_WAIT_CLASSES_MAX];
+} db_waits_t;
+
+/* Return the default --db-wait-query for a driver, or NULL if it has none */
+const char *db_waits_default_query(const char *driver);
+
+/*
+  Start sampling with a given driver on a dedicated connection. Only the
+  first call in the 'run' command starts the sampler. Returns 0 on success.
+*/
+int db_waits_start(db_driver_t *drv);
+
+/* Stop the sampler and close its connection */
+void db_waits_stop(void);
+
+/*
+  Return samples since the last intermediate report or checkpoint, or NULL if
+  sampling is not enabled. Must be called from a single thread, the returned
+  values are valid until the next call.
+*/
+const db_waits_t *db_waits_intermediate(void);
+const db_waits_t *db_waits_checkpoint(void);
+
+/*
+  Sort the classes of a sample set by the number of sessions, descending, and
+  return their indexes in 'order', which must have DB_WAIT_CLASSES_MAX
+  elements
+*/
+void db_waits_sort(const db_waits_t *waits, unsigned int *order);
+
+#endif /* DB_WAITS_H */
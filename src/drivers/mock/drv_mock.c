@@ -0,0 +1,763 @@
+/* Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Mock driver simulating a server with a known latency distribution. Every
+  query or statement takes a latency drawn from --mock-latency-dist and returns
+  a synthetic result: SELECT queries return --mock-rows x --mock-columns rows,
+  other ones report one affected row for INSERT, UPDATE, DELETE and REPLACE
+  and none otherwise. No server is involved, so the results of sysbench
+  itself, e.g. its scalability, --rate queueing or asynchronous queries, can be
+  checked against the configured distribution.
+
+  Synchronous queries wait by sleeping, which blocks the worker thread like a
+  network wait, or by spinning to simulate an embedded database using the
+  client CPU. Asynchronous queries arm a timerfd which becomes readable when
+  the latency has passed, so any number of them can be in flight on a thread.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdio.h>
+# include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_MATH_H
+# include <math.h>
+#endif
+#ifdef HAVE_SYS_TIMERFD_H
+# include <sys/timerfd.h>
+#endif
+
+#include "sb_options.h"
+#include "sb_rand.h"
+#include "sb_timer.h"
+#include "sb_usage.h"
+#include "db_driver.h"
+
+/* Maximum length of synthetic column values */
+#define MOCK_VALUE_MAX 65536
+
+/* Mock driver arguments */
+
+static sb_arg_t mock_drv_args[] =
+{
+  SB_OPT("mock-latency-dist", "distribution of query latencies {fixed, "
+         "lognormal, histogram}", "fixed", STRING),
+  SB_OPT("mock-latency", "latency in milliseconds with 'fixed', median "
+         "latency with 'lognormal'", "1", DOUBLE),
+  SB_OPT("mock-latency-sigma", "shape (standard deviation of the logarithm) "
+         "of 'lognormal' latencies", "0.5", DOUBLE),
+  SB_OPT("mock-latency-file", "file with the 'histogram' latency "
+         "distribution, one '<latency in ms> <count>' pair per line. The "
+         "first and last numbers of each line are used, so the --histogram "
+         "table can be used as is", NULL, STRING),
+  SB_OPT("mock-wait", "how synchronous queries wait {sleep, spin}. "
+         "Asynchronous queries always wait on a timerfd", "sleep", STRING),
+  SB_OPT("mock-rows", "number of rows returned by SELECT queries", "1", INT),
+  SB_OPT("mock-columns", "number of columns returned by SELECT queries", "1",
+         INT),
+  SB_OPT("mock-value-size", "length of synthetic column values", "1", INT),
+
+  SB_OPT_END
+};
+
+typedef enum
+{
+  MOCK_DIST_FIXED,
+  MOCK_DIST_LOGNORMAL,
+  MOCK_DIST_HISTOGRAM
+} mock_dist_t;
+
+static const char *mock_dist_names[] =
+{
+  "fixed", "lognormal", "histogram", NULL
+};
+
+typedef struct
+{
+  mock_dist_t        dist;
+  uint64_t           latency_ns;
+  double             sigma;
+  bool               spin;
+  unsigned int       rows;
+  unsigned int       columns;
+  unsigned int       value_size;
+} mock_drv_args_t;
+
+/* Latencies of the 'histogram' distribution with cumulative counts */
+
+typedef struct
+{
+  uint64_t           *latency_ns;
+  double             *cumulative;
+  unsigned int       n;
+} mock_histogram_t;
+
+/* Per-connection driver data */
+
+typedef struct
+{
+  uint32_t           left;      /* Rows left to fetch */
+  sb_counter_type_t  counter;   /* Counter of the asynchronous query */
+  int                timerfd;   /* For asynchronous queries, or -1 */
+} mock_conn_t;
+
+/* Mock driver capabilities */
+
+static drv_caps_t mock_drv_caps =
+{
+  1,    /* multi_rows_insert */
+  1,    /* prepared_statements */
+  1,    /* auto_increment */
+  0,    /* needs_commit */
+  0,    /* serial */
+  1,    /* unsigned int */
+};
+
+static mock_drv_args_t  args;          /* driver args */
+static mock_histogram_t histogram;
+static char             *value;        /* synthetic column value */
+
+/* Mock driver operations */
+
+static int mock_drv_init(void);
+static int mock_drv_describe(drv_caps_t *);
+static int mock_drv_connect(db_conn_t *);
+static int mock_drv_disconnect(db_conn_t *);
+static int mock_drv_reconnect(db_conn_t *);
+static int mock_drv_prepare(db_stmt_t *, const char *, size_t);
+static int mock_drv_bind(db_stmt_t *, db_bind_t *, size_t);
+static db_error_t mock_drv_execute(db_stmt_t *, db_result_t *);
+static int mock_drv_fetch(db_result_t *);
+static int mock_drv_fetch_row(db_result_t *, db_row_t *);
+static db_error_t mock_drv_query(db_conn_t *, const char *, size_t,
+                                 db_result_t *);
+static int mock_drv_free_results(db_result_t *);
+static int mock_drv_close(db_stmt_t *);
+static int mock_drv_done(void);
+#ifdef HAVE_SYS_TIMERFD_H
+static int mock_drv_query_async(db_conn_t *, const char *, size_t);
+static int mock_drv_query_async_cont(db_conn_t *, int);
+static db_error_t mock_drv_query_async_result(db_conn_t *, db_result_t *);
+static int mock_drv_socket(db_conn_t *);
+#endif
+
+/* Mock driver definition */
+
+static db_driver_t mock_driver =
+{
+  .sname = "mock",
+  .lname = "Mock driver with simulated latencies",
+  .args = mock_drv_args,
+  .ops =
+  {
+    .init = mock_drv_init,
+    .describe = mock_drv_describe,
+    .connect = mock_drv_connect,
+    .disconnect = mock_drv_disconnect,
+    .reconnect = mock_drv_reconnect,
+    .prepare = mock_drv_prepare,
+    .bind_param = mock_drv_bind,
+    .bind_result = mock_drv_bind,
+    .execute = mock_drv_execute,
+    .fetch = mock_drv_fetch,
+    .fetch_row = mock_drv_fetch_row,
+    .free_results = mock_drv_free_results,
+    .close = mock_drv_close,
+    .query = mock_drv_query,
+    .done = mock_drv_done,
+#ifdef HAVE_SYS_TIMERFD_H
+    .query_async = mock_drv_query_async,
+    .query_async_cont = mock_drv_query_async_cont,
+    .query_async_result = mock_drv_query_async_result,
+    .socket = mock_drv_socket,
+#endif
+  }
+};
+
+
+/* Local functions */
+
+static int load_histogram(const char *path);
+static uint64_t next_latency(void);
+static void mock_wait(uint64_t ns);
+static db_error_t mock_result(db_conn_t *con, sb_counter_type_t counter,
+                              db_result_t *rs);
+
+
+/* Register Mock driver */
+
+
+int register_driver_mock(sb_list_t *drivers)
+{
+  SB_LIST_ADD_TAIL(&mock_driver.listitem, drivers);
+
+  return 0;
+}
+
+
+/* Mock driver initialization */
+
+
+int mock_drv_init(void)
+{
+  const char *s;
+  int        i;
+
+  s = sb_get_value_string("mock-latency-dist");
+  for (i = 0; mock_dist_names[i] != NULL; i++)
+    if (!strcmp(s, mock_dist_names[i]))
+      break;
+
+  if (mock_dist_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for --mock-latency-dist: '%s'", s);
+    return 1;
+  }
+  args.dist = (mock_dist_t) i;
+
+  const double latency = sb_get_value_double("mock-latency");
+  if (latency < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --mock-latency: %g", latency);
+    return 1;
+  }
+  args.latency_ns = (uint64_t) (latency * NS_PER_MS);
+
+  args.sigma = sb_get_value_double("mock-latency-sigma");
+  if (args.sigma < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --mock-latency-sigma: %g",
+             args.sigma);
+    return 1;
+  }
+
+  s = sb_get_value_string("mock-latency-file");
+  if (args.dist == MOCK_DIST_HISTOGRAM)
+  {
+    if (s == NULL)
+    {
+      log_text(LOG_FATAL, "--mock-latency-dist=histogram requires "
+               "--mock-latency-file");
+      return 1;
+    }
+
+    if (load_histogram(s))
+      return 1;
+  }
+
+  s = sb_get_value_string("mock-wait");
+  if (!strcmp(s, "spin"))
+  {
+    args.spin = true;
+    /* Spinning uses the client CPU like an embedded database */
+    sb_usage_disable_client_warning();
+  }
+  else if (strcmp(s, "sleep"))
+  {
+    log_text(LOG_FATAL, "Invalid value for --mock-wait: '%s'", s);
+    return 1;
+  }
+
+  const int rows = sb_get_value_int("mock-rows");
+  const int columns = sb_get_value_int("mock-columns");
+  const int value_size = sb_get_value_int("mock-value-size");
+
+  if (rows < 0 || columns < 0 || value_size < 0 ||
+      value_size > MOCK_VALUE_MAX)
+  {
+    log_text(LOG_FATAL, "Invalid value for --mock-rows, --mock-columns or "
+             "--mock-value-size");
+    return 1;
+  }
+
+  args.rows = (unsigned int) rows;
+  args.columns = (unsigned int) columns;
+  args.value_size = (unsigned int) value_size;
+
+  value = malloc(args.value_size + 1);
+  if (value == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+  memset(value, '1', args.value_size);
+  value[args.value_size] = '\0';
+
+  return 0;
+}
+
+
+/*
+  Load the 'histogram' distribution. Each line with at least one number gives
+  a latency as its first number and a count as its last one, or 1 if there is
+  a single number. Lines without numbers are ignored.
+*/
+
+static int load_histogram(const char *path)
+{
+  FILE         *f;
+  char         line[1024];
+  unsigned int size = 0;
+  double       total = 0;
+
+  f = fopen(path, "r");
+  if (f == NULL)
+  {
+    log_errno(LOG_FATAL, "Cannot open --mock-latency-file '%s'", path);
+    return 1;
+  }
+
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    char   *p = line, *end;
+    double latency, count = 1;
+
+    while (*p != '\0' && strchr("0123456789.", *p) == NULL)
+      p++;
+
+    latency = strtod(p, &end);
+    if (end == p)
+      continue;
+
+    /* The last number on the line, if any, is the count */
+    for (p = end; *p != '\0'; p++)
+    {
+      double v;
+
+      if (strchr("0123456789", *p) == NULL)
+        continue;
+
+      v = strtod(p, &end);
+      count = v;
+      p = end - 1;
+    }
+
+    if (latency < 0 || count < 0)
+    {
+      log_text(LOG_FATAL, "Invalid line in --mock-latency-file: %s", line);
+      fclose(f);
+      return 1;
+    }
+
+    if (count == 0)
+      continue;
+
+    if (histogram.n == size)
+    {
+      size = size > 0 ? size * 2 : 64;
+
+      uint64_t * const lat = realloc(histogram.latency_ns,
+                                     size * sizeof(uint64_t));
+      if (lat != NULL)
+        histogram.latency_ns = lat;
+
+      double * const cum = realloc(histogram.cumulative,
+                                   size * sizeof(double));
+      if (cum != NULL)
+        histogram.cumulative = cum;
+
+      if (lat == NULL || cum == NULL)
+      {
+        log_text(LOG_FATAL, "Memory allocation failure");
+        fclose(f);
+        return 1;
+      }
+    }
+
+    total += count;
+    histogram.latency_ns[histogram.n] = (uint64_t) (latency * NS_PER_MS);
+    histogram.cumulative[histogram.n] = total;
+    histogram.n++;
+  }
+
+  fclose(f);
+
+  if (histogram.n == 0)
+  {
+    log_text(LOG_FATAL, "No latencies found in --mock-latency-file '%s'",
+             path);
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/* Draw the latency of the next query */
+
+static uint64_t next_latency(void)
+{
+  switch (args.dist)
+  {
+  case MOCK_DIST_FIXED:
+    return args.latency_ns;
+
+  case MOCK_DIST_LOGNORMAL:
+    {
+      /* Box-Muller transform, 1 - u is in (0, 1] */
+      const double u1 = 1 - sb_rand_uniform_double();
+      const double u2 = sb_rand_uniform_double();
+      const double z = sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+
+      return (uint64_t) (args.latency_ns * exp(args.sigma * z));
+    }
+
+  case MOCK_DIST_HISTOGRAM:
+    {
+      const double x = sb_rand_uniform_double() *
+        histogram.cumulative[histogram.n - 1];
+      unsigned int lo = 0, hi = histogram.n - 1;
+
+      /* Find the first entry with a cumulative count above x */
+      while (lo < hi)
+      {
+        const unsigned int mid = (lo + hi) / 2;
+
+        if (histogram.cumulative[mid] > x)
+          hi = mid;
+        else
+          lo = mid + 1;
+      }
+
+      return histogram.latency_ns[lo];
+    }
+  }
+
+  return 0;
+}
+
+
+/* Wait for a given time in a synchronous query */
+
+static void mock_wait(uint64_t ns)
+{
+  if (ns == 0)
+    return;
+
+  if (!args.spin)
+  {
+    sb_nanosleep(ns);
+    return;
+  }
+
+  const uint64_t deadline = sb_usage_clock() + ns;
+
+  while (sb_usage_clock() < deadline)
+    ;
+}
+
+
+/* Fill in the synthetic result of a query */
+
+static db_error_t mock_result(db_conn_t *con, sb_counter_type_t counter,
+                              db_result_t *rs)
+{
+  mock_conn_t * const mc = con->ptr;
+
+  rs->counter = counter;
+
+  if (counter == SB_CNT_READ)
+  {
+    rs->nrows = args.rows;
+    rs->nfields = args.columns;
+  }
+  else
+  {
+    rs->nrows = (counter == SB_CNT_WRITE);
+    rs->nfields = 0;
+  }
+
+  mc->left = rs->nrows;
+
+  return DB_ERROR_NONE;
+}
+
+
+/* Describe database capabilities */
+
+
+int mock_drv_describe(drv_caps_t *caps)
+{
+  *caps = mock_drv_caps;
+
+  return 0;
+}
+
+
+/* Connect to database */
+
+
+int mock_drv_connect(db_conn_t *sb_conn)
+{
+  mock_conn_t *mc = calloc(1, sizeof(mock_conn_t));
+
+  if (mc == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  mc->timerfd = -1;
+
+#ifdef HAVE_SYS_TIMERFD_H
+  mc->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (mc->timerfd < 0)
+  {
+    log_errno(LOG_FATAL, "timerfd_create() failed");
+    free(mc);
+    return 1;
+  }
+#endif
+
+  sb_conn->ptr = mc;
+
+  return 0;
+}
+
+
+/* Disconnect from database */
+
+
+int mock_drv_disconnect(db_conn_t *sb_conn)
+{
+  mock_conn_t * const mc = sb_conn->ptr;
+
+  if (mc != NULL && mc->timerfd >= 0)
+    close(mc->timerfd);
+
+  free(mc);
+  sb_conn->ptr = NULL;
+
+  return 0;
+}
+
+
+/* Reconnect with the same connection parameters */
+
+
+int mock_drv_reconnect(db_conn_t *sb_conn)
+{
+  (void) sb_conn; /* unused */
+
+  return DB_ERROR_IGNORABLE;
+}
+
+
+/* Prepare statement */
+
+
+int mock_drv_prepare(db_stmt_t *stmt, const char *query, size_t len)
+{
+  stmt->counter = db_query_counter(query, len);
+
+  return 0;
+}
+
+
+/* Bind parameters or results for prepared statement */
+
+
+int mock_drv_bind(db_stmt_t *stmt, db_bind_t *params, size_t len)
+{
+  (void) stmt; /* unused */
+  (void) params; /* unused */
+  (void) len; /* unused */
+
+  return 0;
+}
+
+
+/* Execute prepared statement */
+
+
+db_error_t mock_drv_execute(db_stmt_t *stmt, db_result_t *rs)
+{
+  mock_wait(next_latency());
+
+  return mock_result(stmt->connection, stmt->counter, rs);
+}
+
+
+/* Fetch row from result set of a prepared statement */
+
+
+int mock_drv_fetch(db_result_t *rs)
+{
+  (void) rs; /* unused */
+
+  return 0;
+}
+
+
+/* Fetch row from result set of a query */
+
+
+int mock_drv_fetch_row(db_result_t *rs, db_row_t *row)
+{
+  db_conn_t   * const con = SB_CONTAINER_OF(rs, db_conn_t, rs);
+  mock_conn_t * const mc = con->ptr;
+
+  if (mc->left == 0)
+    return 1;
+  mc->left--;
+
+  for (uint32_t i = 0; i < rs->nfields; i++)
+  {
+    row->values[i].ptr = value;
+    row->values[i].len = args.value_size;
+  }
+
+  return 0;
+}
+
+
+/* Execute SQL query */
+
+
+db_error_t mock_drv_query(db_conn_t *sb_conn, const char *query, size_t len,
+                          db_result_t *rs)
+{
+  mock_wait(next_latency());
+
+  return mock_result(sb_conn, db_query_counter(query, len), rs);
+}
+
+
+#ifdef HAVE_SYS_TIMERFD_H
+
+/* Start an asynchronous query completing after its latency */
+
+
+int mock_drv_query_async(db_conn_t *sb_conn, const char *query, size_t len)
+{
+  mock_conn_t * const mc = sb_conn->ptr;
+  const uint64_t      ns = next_latency();
+  struct itimerspec   its;
+
+  mc->counter = db_query_counter(query, len);
+
+  if (ns == 0)
+    return 0;
+
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = (time_t) (ns / NS_PER_SEC);
+  its.it_value.tv_nsec = (long) (ns % NS_PER_SEC);
+
+  if (timerfd_settime(mc->timerfd, 0, &its, NULL))
+  {
+    log_errno(LOG_FATAL, "timerfd_settime() failed");
+    return -1;
+  }
+
+  return DB_ASYNC_WAIT_READ;
+}
+
+
+/* Check if the latency of an asynchronous query has passed */
+
+
+int mock_drv_query_async_cont(db_conn_t *sb_conn, int events)
+{
+  mock_conn_t * const mc = sb_conn->ptr;
+  uint64_t            expirations;
+
+  (void) events; /* unused */
+
+  if (read(mc->timerfd, &expirations, sizeof(expirations)) < 0)
+  {
+    if (errno == EAGAIN)
+      return DB_ASYNC_WAIT_READ;
+
+    log_errno(LOG_FATAL, "read() from timerfd failed");
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* Get the result of a completed asynchronous query */
+
+
+db_error_t mock_drv_query_async_result(db_conn_t *sb_conn, db_result_t *rs)
+{
+  mock_conn_t * const mc = sb_conn->ptr;
+
+  return mock_result(sb_conn, mc->counter, rs);
+}
+
+
+/* Return the descriptor to wait on for an asynchronous query */
+
+
+int mock_drv_socket(db_conn_t *sb_conn)
+{
+  return ((mock_conn_t *) sb_conn->ptr)->timerfd;
+}
+
+#endif /* HAVE_SYS_TIMERFD_H */
+
+
+/* Free result set */
+
+
+int mock_drv_free_results(db_result_t *rs)
+{
+  (void) rs; /* unused */
+
+  return 0;
+}
+
+
+/* Close prepared statement */
+
+
+int mock_drv_close(db_stmt_t *stmt)
+{
+  (void) stmt; /* unused */
+
+  return 0;
+}
+
+
+/* Uninitialize driver */
+
+
+int mock_drv_done(void)
+{
+  free(histogram.latency_ns);
+  free(histogram.cumulative);
+  memset(&histogram, 0, sizeof(histogram));
+
+  free(value);
+  value = NULL;
+
+  return 0;
+}
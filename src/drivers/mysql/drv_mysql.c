@@ -30,12 +30,20 @@
 # include <strings.h>
 #endif
 #include <stdio.h>
+#include <ctype.h>
+#ifdef HAVE_STRUCT_TCP_INFO_TCPI_BYTES_RECEIVED
+# include <stddef.h>
+# include <sys/socket.h>
+# include <netinet/in.h>
+# include <linux/tcp.h>
+#endif
 
 #include <mysql.h>
 #include <mysqld_error.h>
 #include <errmsg.h>
 
 #include "sb_options.h"
+#include "sb_timer.h"
 #include "db_driver.h"
 
 #define DEBUG(format, ...)                      \
@@ -54,6 +62,58 @@ static inline const char *SAFESTR(const char *s)
 typedef bool my_bool;
 #endif
 
+/*
+  MariaDB Connector/C provides a non-blocking API used to implement
+  asynchronous queries
+*/
+#ifdef MYSQL_WAIT_READ
+# define HAVE_MYSQL_NONBLOCK 1
+#endif
+
+/* COM_RESET_CONNECTION is available since MySQL 5.7.3 */
+#if MYSQL_VERSION_ID >= 50703
+# define HAVE_MYSQL_RESET_CONNECTION 1
+#endif
+
+/* MYSQL_OPT_BIND is available since MySQL 5.6.1 */
+#if MYSQL_VERSION_ID >= 50601
+# define HAVE_MYSQL_OPT_BIND 1
+#endif
+
+/* MySQL 8.0.18 and later can choose protocol compression algorithms */
+#if !defined(MARIADB_BASE_VERSION) && !defined(MARIADB_VERSION_ID) && \
+  MYSQL_VERSION_ID >= 80018
+# define HAVE_MYSQL_COMPRESSION_ALGORITHMS 1
+#endif
+
+/* MySQL 8.0.29 and later can resume TLS sessions of previous connections */
+#if !defined(MARIADB_BASE_VERSION) && !defined(MARIADB_VERSION_ID) && \
+  MYSQL_VERSION_ID >= 80029
+# define HAVE_MYSQL_SSL_SESSION 1
+#endif
+
+/*
+  MYSQL_OPT_NET_BUFFER_LENGTH is available since MySQL 5.7 and in MariaDB
+  Connector/C
+*/
+#if MYSQL_VERSION_ID >= 50700
+# define HAVE_MYSQL_OPT_NET_BUFFER_LENGTH 1
+#endif
+
+/*
+  MariaDB Connector/C 3.0 and later can send all parameter sets of a batch with
+  a single COM_STMT_BULK_EXECUTE to MariaDB 10.2 and later servers
+*/
+#ifdef MARIADB_CLIENT_STMT_BULK_OPERATIONS
+# define HAVE_MYSQL_BULK_EXECUTE 1
+#endif
+
+/*
+  Initial size of the network buffer of each connection with --lean-workers.
+  It still grows as needed for larger packets.
+*/
+#define MYSQL_LEAN_NET_BUFFER_LENGTH 1024
+
 /* MySQL driver arguments */
 
 static sb_arg_t mysql_drv_args[] =
@@ -61,6 +121,26 @@ static sb_arg_t mysql_drv_args[] =
   SB_OPT("mysql-host", "MySQL server host", "localhost", LIST),
   SB_OPT("mysql-port", "MySQL server port", "3306", LIST),
   SB_OPT("mysql-socket", "MySQL socket", NULL, LIST),
+  SB_OPT("mysql-host-policy", "how to choose a host/port (or socket) for new "
+         "connections {round-robin, weighted, least-connections, latency, "
+         "sticky}", "round-robin", STRING),
+  SB_OPT("mysql-host-weights", "relative weights of hosts (or sockets) for "
+         "--mysql-host-policy=weighted, in the same order", NULL, LIST),
+  SB_OPT("mysql-replica-host", "read replica hosts. If specified, queries "
+         "returning result sets, except locking reads, are sent to a replica "
+         "chosen with --mysql-host-policy, all other queries go to "
+         "--mysql-host", NULL, LIST),
+  SB_OPT("mysql-replica-weights", "relative weights of replica hosts for "
+         "--mysql-host-policy=weighted", NULL, LIST),
+  SB_OPT("mysql-reconnect-policy", "server to reconnect to after a lost "
+         "connection {same, next}. 'next' tries the other hosts/ports (or "
+         "sockets) of the same list in turn, starting after the lost one, "
+         "with a 1 second connect timeout, to follow a failover quickly",
+         "same", STRING),
+  SB_OPT("mysql-bind-address", "local IP addresses to bind client sockets "
+         "to, used by new connections in turn. Multiple addresses raise the "
+         "limit of ephemeral ports for large numbers of connections", NULL,
+         LIST),
   SB_OPT("mysql-user", "MySQL user", "sbtest", STRING),
   SB_OPT("mysql-password", "MySQL password", "", STRING),
   SB_OPT("mysql-db", "MySQL database name", "sbtest", STRING),
@@ -79,22 +159,115 @@ static sb_arg_t mysql_drv_args[] =
          "path name of the client public key certificate file", NULL, STRING),
   SB_OPT("mysql-ssl-cipher", "use specific cipher for SSL connections", "",
          STRING),
+  SB_OPT("mysql-ssl-session-reuse", "resume the TLS session of the previous "
+         "connection made by the same thread instead of a full TLS handshake",
+         "off", BOOL),
   SB_OPT("mysql-compression", "use compression, if available in the "
          "client library", "off", BOOL),
+  SB_OPT("mysql-compression-algorithms", "list of protocol compression "
+         "algorithms to offer the server in order of preference "
+         "{zlib, zstd, uncompressed}. Requires MySQL client library 8.0.18 "
+         "or later", "", LIST),
+  SB_OPT("mysql-zstd-compression-level", "compression level of the zstd "
+         "algorithm, from 1 to 22", "3", INT),
+  SB_OPT("mysql-net-stats", "report bytes sent to and received from servers "
+         "over TCP connections, i.e. after compression, in intermediate and "
+         "cumulative reports (Linux only)", "off", BOOL),
   SB_OPT("mysql-debug", "trace all client library calls", "off", BOOL),
   SB_OPT("mysql-ignore-errors", "list of errors to ignore, or \"all\"",
          "1213,1020,1205", LIST),
   SB_OPT("mysql-dry-run", "Dry run, pretend that all MySQL client API "
          "calls are successful without executing them", "off", BOOL),
+  SB_OPT("mysql-pipeline", "Send statement groups as a single "
+         "multi-statement query in one round trip", "off", BOOL),
+  SB_OPT("mysql-session-reset", "command used to reset session state on an "
+         "existing connection {reset-connection, change-user}",
+         "reset-connection", STRING),
 
   SB_OPT_END
 };
 
+/* Policies of choosing a server for a new connection */
+
+typedef enum
+{
+  HOST_POLICY_ROUND_ROBIN,      /* each server in turn */
+  HOST_POLICY_WEIGHTED,         /* smooth weighted round-robin */
+  HOST_POLICY_LEAST_CONN,       /* server with the least open connections */
+  HOST_POLICY_LATENCY,          /* server with the lowest query time */
+  HOST_POLICY_STICKY            /* the same server for each thread */
+} host_policy_t;
+
+static const char *host_policy_names[] =
+{
+  "round-robin", "weighted", "least-connections", "latency", "sticky", NULL
+};
+
+/* Servers to reconnect to, see mysql_drv_reconnect() */
+
+typedef enum
+{
+  RECONNECT_POLICY_SAME,        /* the server of the lost connection */
+  RECONNECT_POLICY_NEXT         /* the other servers of the set in turn */
+} reconnect_policy_t;
+
+static const char *reconnect_policy_names[] =
+{
+  "same", "next", NULL
+};
+
+/* Connect timeout in seconds of reconnects with RECONNECT_POLICY_NEXT */
+#define MYSQL_FAST_RECONNECT_TIMEOUT 1
+
+/* How session state is reset, see mysql_drv_reset() */
+
+typedef enum
+{
+  SESSION_RESET_CONNECTION,     /* mysql_reset_connection() */
+  SESSION_RESET_CHANGE_USER     /* mysql_change_user() with the same user */
+} session_reset_t;
+
+static const char *session_reset_names[] =
+{
+  "reset-connection", "change-user", NULL
+};
+
+/* A server to connect to, i.e. a host/port pair or a socket */
+
+typedef struct
+{
+  const char   *host;
+  unsigned int port;
+  const char   *socket;
+  unsigned int weight;          /* for HOST_POLICY_WEIGHTED */
+  int64_t      current_weight;  /* HOST_POLICY_WEIGHTED state */
+  char         name[128];       /* host:port or socket, used in logs */
+
+  /* Statistics, updated atomically */
+  uint64_t     connections;     /* currently open connections */
+  uint64_t     connects;        /* number of connections ever opened */
+  uint64_t     queries;         /* number of executed queries */
+  uint64_t     time_ns;         /* total query execution time */
+  uint64_t     avg_ns;          /* moving average of query execution time */
+} mysql_server_t;
+
+typedef struct
+{
+  const char     *name;         /* used in reports */
+  mysql_server_t *servers;
+  unsigned int   nservers;
+  unsigned int   next;          /* next server to check, see select_server() */
+} mysql_server_set_t;
+
 typedef struct
 {
   sb_list_t          *hosts;
   sb_list_t          *ports;
   sb_list_t          *sockets;
+  host_policy_t      host_policy;
+  reconnect_policy_t reconnect_policy;
+  const char         **bind_addresses; /* --mysql-bind-address */
+  unsigned int       nbind_addresses;
   const char         *user;
   const char         *password;
   const char         *db;
@@ -102,25 +275,46 @@ typedef struct
   int                ssl_mode;
 #endif
   bool               use_ssl;
+  bool               ssl_session_reuse;
   const char         *ssl_key;
   const char         *ssl_cert;
   const char         *ssl_ca;
   const char         *ssl_cipher;
   unsigned char      use_compression;
+  char               *compression_algorithms; /* comma-separated, or NULL */
+  unsigned int       zstd_level;
+  bool               net_stats;
   unsigned char      debug;
   sb_list_t          *ignored_errors;
   unsigned int       dry_run;
+  bool               pipeline;
+  session_reset_t    session_reset;
 } mysql_drv_args_t;
 
 typedef struct
 {
   MYSQL        *mysql;
-  const char   *host;
+  mysql_server_t *server;     /* server of the 'mysql' connection */
+  MYSQL        *replica;      /* connection to a replica, if any */
+  mysql_server_t *replica_server; /* server of the 'replica' connection */
+  MYSQL        *cur;          /* connection used by the last query */
   const char   *user;
   const char   *password;
   const char   *db;
-  unsigned int port;
-  char         *socket;
+#ifdef HAVE_MYSQL_NONBLOCK
+  bool         nonblock;      /* MYSQL_OPT_NONBLOCK has been set */
+  bool         async_store;   /* storing results of an asynchronous query */
+  int          async_err;     /* mysql_real_query_start() result */
+  MYSQL_RES    *async_res;    /* mysql_store_result_start() result */
+#endif
+  db_copy_read_t *copy_read;  /* LOAD DATA LOCAL data source during loads */
+  void         *copy_arg;     /* argument for copy_read */
+  char         *pipeline_buf; /* queued statements, see mysql_drv_pipeline_end() */
+  size_t       pipeline_len;  /* length of queued statements */
+  size_t       pipeline_size; /* allocated size of pipeline_buf */
+  /* TCP byte counters at the last net_stats_update() */
+  uint64_t     net_sent[2];   /* of 'mysql' and 'replica' */
+  uint64_t     net_received[2];
 } db_mysql_conn_t;
 
 /* Structure used for DB-to-MySQL bind types map */
@@ -144,6 +338,7 @@ db_mysql_bind_map_t db_mysql_bind_map[] =
   {DB_TYPE_TIMESTAMP, MYSQL_TYPE_TIMESTAMP},
   {DB_TYPE_CHAR,      MYSQL_TYPE_STRING},
   {DB_TYPE_VARCHAR,   MYSQL_TYPE_VAR_STRING},
+  {DB_TYPE_BLOB,      MYSQL_TYPE_LONG_BLOB},
   {DB_TYPE_NONE,      0}
 };
 
@@ -165,13 +360,30 @@ static mysql_drv_args_t args;          /* driver args */
 
 static char use_ps; /* whether server-side prepared statemens should be used */
 
-/* Positions in the list of hosts/ports/sockets. Protected by pos_mutex */
-static sb_list_item_t *hosts_pos;
-static sb_list_item_t *ports_pos;
-static sb_list_item_t *sockets_pos;
+/* Primary and replica servers. Selection state is protected by pos_mutex */
+static mysql_server_set_t primaries = { .name = "primary" };
+static mysql_server_set_t replicas = { .name = "replica" };
+
+/* Whether per-server statistics are collected, i.e. there is a choice */
+static bool track_servers;
 
 static pthread_mutex_t pos_mutex;
 
+/* Bind address for the next connection, see mysql_drv_real_connect() */
+static uint32_t next_bind_address;
+
+/* Set when a connection without TCP byte counters is found */
+static int net_stats_missing;
+
+#ifdef HAVE_MYSQL_SSL_SESSION
+/* TLS session of the last connection made by this thread */
+static TLS void *ssl_session;
+
+/* Number of TLS connections made with a full and an abbreviated handshake */
+static uint64_t ssl_sessions_new;
+static uint64_t ssl_sessions_reused;
+#endif
+
 /* MySQL driver operations */
 
 static int mysql_drv_init(void);
@@ -179,6 +391,7 @@ static int mysql_drv_thread_init(int);
 static int mysql_drv_describe(drv_caps_t *);
 static int mysql_drv_connect(db_conn_t *);
 static int mysql_drv_reconnect(db_conn_t *);
+static int mysql_drv_reset(db_conn_t *);
 static int mysql_drv_disconnect(db_conn_t *);
 static int mysql_drv_prepare(db_stmt_t *, const char *, size_t);
 static int mysql_drv_bind_param(db_stmt_t *, db_bind_t *, size_t);
@@ -192,6 +405,21 @@ static int mysql_drv_free_results(db_result_t *);
 static int mysql_drv_close(db_stmt_t *);
 static int mysql_drv_thread_done(int);
 static int mysql_drv_done(void);
+#ifdef HAVE_MYSQL_NONBLOCK
+static int mysql_drv_query_async(db_conn_t *, const char *, size_t);
+static int mysql_drv_query_async_cont(db_conn_t *, int);
+static db_error_t mysql_drv_query_async_result(db_conn_t *, db_result_t *);
+static int mysql_drv_socket(db_conn_t *);
+#endif
+static int mysql_drv_copy_stream(db_conn_t *, const char *, size_t,
+                                 db_copy_read_t *, void *);
+static void mysql_drv_report_intermediate(sb_stat_t *);
+static void mysql_drv_report_cumulative(sb_stat_t *);
+static int mysql_drv_pipeline_begin(db_conn_t *);
+static db_error_t mysql_drv_pipeline_end(db_conn_t *);
+#ifdef HAVE_MYSQL_BULK_EXECUTE
+static db_error_t mysql_drv_execute_batch(db_stmt_t *, db_result_t *);
+#endif
 
 /* MySQL driver definition */
 
@@ -207,6 +435,7 @@ static db_driver_t mysql_driver =
     .connect = mysql_drv_connect,
     .disconnect = mysql_drv_disconnect,
     .reconnect = mysql_drv_reconnect,
+    .reset = mysql_drv_reset,
     .prepare = mysql_drv_prepare,
     .bind_param = mysql_drv_bind_param,
     .bind_result = mysql_drv_bind_result,
@@ -217,7 +446,21 @@ static db_driver_t mysql_driver =
     .close = mysql_drv_close,
     .query = mysql_drv_query,
     .thread_done = mysql_drv_thread_done,
-    .done = mysql_drv_done
+    .done = mysql_drv_done,
+    .copy_stream = mysql_drv_copy_stream,
+    .report_intermediate = mysql_drv_report_intermediate,
+    .report_cumulative = mysql_drv_report_cumulative,
+    .pipeline_begin = mysql_drv_pipeline_begin,
+    .pipeline_end = mysql_drv_pipeline_end,
+#ifdef HAVE_MYSQL_BULK_EXECUTE
+    .execute_batch = mysql_drv_execute_batch,
+#endif
+#ifdef HAVE_MYSQL_NONBLOCK
+    .query_async = mysql_drv_query_async,
+    .query_async_cont = mysql_drv_query_async_cont,
+    .query_async_result = mysql_drv_query_async_result,
+    .socket = mysql_drv_socket
+#endif
   }
 };
 
@@ -225,6 +468,8 @@ static db_driver_t mysql_driver =
 /* Local functions */
 
 static int get_mysql_bind_type(db_bind_type_t);
+static db_error_t store_results(db_conn_t *, MYSQL_RES *, db_result_t *);
+static int pipeline_add(db_mysql_conn_t *, const char *, size_t);
 
 /* Register MySQL driver */
 
@@ -237,6 +482,294 @@ int register_driver_mysql(sb_list_t *drivers)
 }
 
 
+/*
+  Create the list of servers from a list of hosts and a list of ports, or from
+  a list of sockets if 'ports' is NULL. Each host is combined with each port in
+  the same order as connections were distributed before host policies were
+  introduced.
+*/
+
+static int init_server_set(mysql_server_set_t *set, sb_list_t *hosts,
+                           sb_list_t *ports, sb_list_t *weights,
+                           const char *opt)
+{
+  sb_list_item_t *hpos, *ppos;
+  sb_list_item_t *wpos = weights;
+  unsigned int   nhosts = 0, nports = 1, nweights = 0;
+  mysql_server_t *server;
+
+  SB_LIST_FOR_EACH(hpos, hosts)
+    nhosts++;
+  if (ports != NULL)
+  {
+    nports = 0;
+    SB_LIST_FOR_EACH(ppos, ports)
+      nports++;
+  }
+  SB_LIST_FOR_EACH(hpos, weights)
+    nweights++;
+
+  if (nweights > 0 && nweights != nhosts)
+  {
+    log_text(LOG_FATAL, "The number of weights (%u) does not match the number "
+             "of values in --%s (%u)", nweights, opt, nhosts);
+    return 1;
+  }
+
+  set->nservers = nhosts * nports;
+  set->servers = calloc(set->nservers, sizeof(mysql_server_t));
+  if (set->servers == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  server = set->servers;
+
+  SB_LIST_FOR_EACH(hpos, hosts)
+  {
+    const char * const host = SB_LIST_ENTRY(hpos, value_t, listitem)->data;
+    int                weight = 1;
+
+    if (nweights > 0)
+    {
+      wpos = SB_LIST_ITEM_NEXT(wpos);
+      weight = atoi(SB_LIST_ENTRY(wpos, value_t, listitem)->data);
+      if (weight <= 0)
+      {
+        log_text(LOG_FATAL, "Invalid weight for '%s': %s", host,
+                 SB_LIST_ENTRY(wpos, value_t, listitem)->data);
+        return 1;
+      }
+    }
+
+    if (ports == NULL)
+    {
+      server->host = "localhost";
+      server->socket = host;
+      server->weight = (unsigned int) weight;
+      snprintf(server->name, sizeof(server->name), "%s", host);
+      server++;
+      continue;
+    }
+
+    SB_LIST_FOR_EACH(ppos, ports)
+    {
+      server->host = host;
+      server->port = atoi(SB_LIST_ENTRY(ppos, value_t, listitem)->data);
+      server->weight = (unsigned int) weight;
+      snprintf(server->name, sizeof(server->name), "%s:%u", host,
+               server->port);
+      server++;
+    }
+  }
+
+  return 0;
+}
+
+
+/* Choose a server for a new connection according to --mysql-host-policy */
+
+static mysql_server_t *select_server(mysql_server_set_t *set, int thread_id)
+{
+  mysql_server_t *server = NULL;
+  unsigned int   i;
+  int64_t        total = 0;
+
+  pthread_mutex_lock(&pos_mutex);
+
+  switch (args.host_policy) {
+  case HOST_POLICY_ROUND_ROBIN:
+    server = &set->servers[set->next];
+    set->next = (set->next + 1) % set->nservers;
+    break;
+
+  case HOST_POLICY_WEIGHTED:
+    /*
+      Smooth weighted round-robin: servers are chosen in proportion to their
+      weights, with those of the same weight interleaved
+    */
+    for (i = 0; i < set->nservers; i++)
+    {
+      mysql_server_t * const s = &set->servers[i];
+
+      s->current_weight += s->weight;
+      total += s->weight;
+
+      if (server == NULL || s->current_weight > server->current_weight)
+        server = s;
+    }
+    server->current_weight -= total;
+    break;
+
+  case HOST_POLICY_LEAST_CONN:
+  case HOST_POLICY_LATENCY:
+    /* Start from a different server every time to break ties evenly */
+    for (i = 0; i < set->nservers; i++)
+    {
+      mysql_server_t * const s = &set->servers[(set->next + i) % set->nservers];
+      const uint64_t load = (args.host_policy == HOST_POLICY_LEAST_CONN) ?
+        ck_pr_load_64(&s->connections) : ck_pr_load_64(&s->avg_ns);
+
+      if (server == NULL || (uint64_t) total > load)
+      {
+        server = s;
+        total = (int64_t) load;
+      }
+    }
+    set->next = (set->next + 1) % set->nservers;
+    break;
+
+  case HOST_POLICY_STICKY:
+    server = &set->servers[(unsigned int) thread_id % set->nservers];
+    break;
+  }
+
+  ck_pr_inc_64(&server->connections);
+  ck_pr_inc_64(&server->connects);
+
+  pthread_mutex_unlock(&pos_mutex);
+
+  return server;
+}
+
+
+/*
+  Return the server following 'server' in its set, moving its open connection
+  there. Used by --mysql-reconnect-policy=next.
+*/
+
+static mysql_server_t *next_server(mysql_server_set_t *set,
+                                   mysql_server_t *server)
+{
+  mysql_server_t * const next =
+    &set->servers[(unsigned int) (server - set->servers + 1) % set->nservers];
+
+  ck_pr_dec_64(&server->connections);
+  ck_pr_inc_64(&next->connections);
+  ck_pr_inc_64(&next->connects);
+
+  return next;
+}
+
+
+/* Account a query executed on a given server and started at 'start' */
+
+static void server_add_query(mysql_server_t *server,
+                             const struct timespec *start)
+{
+  struct timespec now;
+
+  SB_GETTIME(&now);
+
+  const uint64_t ns = TIMESPEC_DIFF(now, (*start));
+
+  ck_pr_inc_64(&server->queries);
+  ck_pr_add_64(&server->time_ns, ns);
+
+  /*
+    Exponentially weighted moving average used by HOST_POLICY_LATENCY.
+    Concurrent updates may be lost, which is fine for this purpose.
+  */
+  const uint64_t avg = ck_pr_load_64(&server->avg_ns);
+  ck_pr_store_64(&server->avg_ns, avg == 0 ? ns : avg - avg / 16 + ns / 16);
+}
+
+
+/*
+  Validate --mysql-compression-algorithms and join its values into the
+  comma-separated list expected by MYSQL_OPT_COMPRESSION_ALGORITHMS
+*/
+
+static int init_compression_algorithms(sb_list_t *list)
+{
+  static const char *names[] = { "zlib", "zstd", "uncompressed", NULL };
+  sb_list_item_t    *pos;
+  size_t            len = 0;
+
+  free(args.compression_algorithms);
+  args.compression_algorithms = NULL;
+
+  if (SB_LIST_IS_EMPTY(list))
+    return 0;
+
+  if (args.use_compression)
+  {
+    log_text(LOG_FATAL, "--mysql-compression cannot be used with "
+             "--mysql-compression-algorithms");
+    return 1;
+  }
+
+#ifndef HAVE_MYSQL_COMPRESSION_ALGORITHMS
+  log_text(LOG_FATAL, "--mysql-compression-algorithms requires MySQL client "
+           "library 8.0.18 or later");
+  return 1;
+#endif
+
+  SB_LIST_FOR_EACH(pos, list)
+  {
+    const char * const name = SB_LIST_ENTRY(pos, value_t, listitem)->data;
+    unsigned int       i;
+
+    for (i = 0; names[i] != NULL; i++)
+      if (!strcmp(name, names[i]))
+        break;
+    if (names[i] == NULL)
+    {
+      log_text(LOG_FATAL, "Invalid value for --mysql-compression-algorithms: "
+               "'%s'", name);
+      return 1;
+    }
+
+    len += strlen(name) + 1;
+  }
+
+  if ((args.compression_algorithms = malloc(len)) == NULL)
+    return 1;
+
+  args.compression_algorithms[0] = '\0';
+  SB_LIST_FOR_EACH(pos, list)
+  {
+    if (args.compression_algorithms[0] != '\0')
+      strcat(args.compression_algorithms, ",");
+    strcat(args.compression_algorithms,
+           SB_LIST_ENTRY(pos, value_t, listitem)->data);
+  }
+
+  return 0;
+}
+
+
+/* Parse --mysql-bind-address */
+
+static int init_bind_addresses(sb_list_t *list)
+{
+  sb_list_item_t *pos;
+  unsigned int   n = 0;
+
+  SB_LIST_FOR_EACH(pos, list)
+    n++;
+
+  if (n == 0)
+    return 0;
+
+#ifndef HAVE_MYSQL_OPT_BIND
+  log_text(LOG_FATAL, "--mysql-bind-address requires MySQL client library "
+           "5.6.1 or later");
+  return 1;
+#endif
+
+  if ((args.bind_addresses = malloc(n * sizeof(char *))) == NULL)
+    return 1;
+
+  SB_LIST_FOR_EACH(pos, list)
+    args.bind_addresses[args.nbind_addresses++] =
+      SB_LIST_ENTRY(pos, value_t, listitem)->data;
+
+  return 0;
+}
+
+
 /* MySQL driver initialization */
 
 
@@ -250,7 +783,6 @@ int mysql_drv_init(void)
     log_text(LOG_FATAL, "No MySQL hosts specified, aborting");
     return 1;
   }
-  hosts_pos = SB_LIST_ITEM_NEXT(args.hosts);
 
   args.ports = sb_get_value_list("mysql-port");
   if (SB_LIST_IS_EMPTY(args.ports))
@@ -258,10 +790,55 @@ int mysql_drv_init(void)
     log_text(LOG_FATAL, "No MySQL ports specified, aborting");
     return 1;
   }
-  ports_pos = SB_LIST_ITEM_NEXT(args.ports);
 
   args.sockets = sb_get_value_list("mysql-socket");
-  sockets_pos = args.sockets;
+
+  const char *s = sb_get_value_string("mysql-host-policy");
+  int        i;
+
+  for (i = 0; host_policy_names[i] != NULL; i++)
+    if (!strcmp(host_policy_names[i], s))
+      break;
+  if (host_policy_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for mysql-host-policy: %s", s);
+    return 1;
+  }
+  args.host_policy = (host_policy_t) i;
+
+  s = sb_get_value_string("mysql-reconnect-policy");
+  for (i = 0; reconnect_policy_names[i] != NULL; i++)
+    if (!strcmp(reconnect_policy_names[i], s))
+      break;
+  if (reconnect_policy_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for mysql-reconnect-policy: %s", s);
+    return 1;
+  }
+  args.reconnect_policy = (reconnect_policy_t) i;
+
+  if (SB_LIST_IS_EMPTY(args.sockets))
+  {
+    if (init_server_set(&primaries, args.hosts, args.ports,
+                        sb_get_value_list("mysql-host-weights"),
+                        "mysql-host"))
+      return 1;
+  }
+  else if (init_server_set(&primaries, args.sockets, NULL,
+                           sb_get_value_list("mysql-host-weights"),
+                           "mysql-socket"))
+    return 1;
+
+  if (!SB_LIST_IS_EMPTY(sb_get_value_list("mysql-replica-host")) &&
+      init_server_set(&replicas, sb_get_value_list("mysql-replica-host"),
+                      args.ports, sb_get_value_list("mysql-replica-weights"),
+                      "mysql-replica-host"))
+    return 1;
+
+  track_servers = primaries.nservers + replicas.nservers > 1;
+
+  if (init_bind_addresses(sb_get_value_list("mysql-bind-address")))
+    return 1;
 
   args.user = sb_get_value_string("mysql-user");
   args.password = sb_get_value_string("mysql-password");
@@ -287,6 +864,28 @@ int mysql_drv_init(void)
 #endif
 
   args.use_compression = sb_get_value_flag("mysql-compression");
+  if (init_compression_algorithms(sb_get_value_list(
+                                    "mysql-compression-algorithms")))
+    return 1;
+
+  if (sb_get_value_int("mysql-zstd-compression-level") < 1 ||
+      sb_get_value_int("mysql-zstd-compression-level") > 22)
+  {
+    log_text(LOG_FATAL, "--mysql-zstd-compression-level must be between 1 "
+             "and 22");
+    return 1;
+  }
+  args.zstd_level = sb_get_value_int("mysql-zstd-compression-level");
+
+  args.net_stats = sb_get_value_flag("mysql-net-stats");
+#ifndef HAVE_STRUCT_TCP_INFO_TCPI_BYTES_RECEIVED
+  if (args.net_stats)
+  {
+    log_text(LOG_FATAL, "--mysql-net-stats is not supported on this "
+             "platform");
+    return 1;
+  }
+#endif
   args.debug = sb_get_value_flag("mysql-debug");
   if (args.debug)
     sb_globals.verbosity = LOG_DEBUG;
@@ -294,6 +893,29 @@ int mysql_drv_init(void)
   args.ignored_errors = sb_get_value_list("mysql-ignore-errors");
 
   args.dry_run = sb_get_value_flag("mysql-dry-run");
+  args.pipeline = sb_get_value_flag("mysql-pipeline");
+
+  args.ssl_session_reuse = sb_get_value_flag("mysql-ssl-session-reuse");
+
+#ifndef HAVE_MYSQL_SSL_SESSION
+  if (args.ssl_session_reuse)
+  {
+    log_text(LOG_FATAL, "--mysql-ssl-session-reuse requires MySQL client "
+             "library 8.0.29 or later");
+    return 1;
+  }
+#endif
+
+  s = sb_get_value_string("mysql-session-reset");
+  for (i = 0; session_reset_names[i] != NULL; i++)
+    if (!strcmp(session_reset_names[i], s))
+      break;
+  if (session_reset_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for mysql-session-reset: %s", s);
+    return 1;
+  }
+  args.session_reset = (session_reset_t) i;
 
   use_ps = 0;
   mysql_drv_caps.prepared_statements = 1;
@@ -324,6 +946,15 @@ int mysql_drv_thread_done(int thread_id)
 {
   (void) thread_id; /* unused */
 
+#ifdef HAVE_MYSQL_SSL_SESSION
+  if (ssl_session != NULL)
+  {
+    /* Session data does not belong to any connection */
+    mysql_free_ssl_session_data(NULL, ssl_session);
+    ssl_session = NULL;
+  }
+#endif
+
   DEBUG("mysql_thread_end(%s)", "");
   mysql_thread_end();
 
@@ -340,56 +971,272 @@ int mysql_drv_describe(drv_caps_t *caps)
 }
 
 
-static int mysql_drv_real_connect(db_mysql_conn_t *db_mysql_con)
+/*
+  LOAD DATA LOCAL INFILE handler. Data comes from mysql_drv_copy_stream(),
+  files requested by the server are never read.
+*/
+
+static int mysql_infile_init(void **ptr, const char *filename, void *userdata)
 {
-  MYSQL          *con = db_mysql_con->mysql;
+  db_mysql_conn_t *db_mysql_con = userdata;
 
-#ifdef MYSQL_OPT_SSL_MODE
-  DEBUG("mysql_options(%p,%s,%d)", con, "MYSQL_OPT_SSL_MODE", args.ssl_mode);
-  mysql_options(con, MYSQL_OPT_SSL_MODE, args.ssl_mode);
-#endif
+  (void) filename; /* unused */
 
-  if (args.use_ssl)
-  {
-    DEBUG("mysql_ssl_set(%p, \"%s\", \"%s\", \"%s\", NULL, \"%s\")", con,
-          SAFESTR(args.ssl_key), SAFESTR(args.ssl_cert), SAFESTR(args.ssl_ca),
-          SAFESTR(args.ssl_cipher));
+  *ptr = db_mysql_con;
+
+  return db_mysql_con->copy_read == NULL;
+}
+
+
+static int mysql_infile_read(void *ptr, char *buf, unsigned int len)
+{
+  db_mysql_conn_t *db_mysql_con = ptr;
+
+  return (int) db_mysql_con->copy_read(db_mysql_con->copy_arg, buf, len);
+}
+
+
+static void mysql_infile_end(void *ptr)
+{
+  (void) ptr; /* unused */
+}
+
+
+static int mysql_infile_error(void *ptr, char *msg, unsigned int len)
+{
+  (void) ptr; /* unused */
+
+  snprintf(msg, len, "LOAD DATA LOCAL INFILE is only allowed for bulk loads");
+
+  return CR_UNKNOWN_ERROR;
+}
+
+
+#ifdef HAVE_MYSQL_SSL_SESSION
+
+/* Keep the TLS session of a new connection for the next one to resume */
+
+static void save_ssl_session(MYSQL *con)
+{
+  void *data;
+
+  DEBUG("mysql_get_ssl_session_data(%p, 0, NULL)", con);
+  data = mysql_get_ssl_session_data(con, 0, NULL);
+  if (data == NULL)
+    return;                             /* not a TLS connection */
+
+  if (mysql_get_ssl_session_reused(con))
+    ck_pr_inc_64(&ssl_sessions_reused);
+  else
+    ck_pr_inc_64(&ssl_sessions_new);
+
+  if (ssl_session != NULL)
+    mysql_free_ssl_session_data(con, ssl_session);
+  ssl_session = data;
+}
+
+#endif
+
+
+/* Return the socket of a connection */
+
+static int connection_socket(MYSQL *con)
+{
+#ifdef HAVE_MYSQL_NONBLOCK
+  return (int) mysql_get_socket(con);
+#else
+  return (int) con->net.fd;
+#endif
+}
+
+
+static int mysql_drv_real_connect(db_mysql_conn_t *db_mysql_con, MYSQL *con,
+                                  const mysql_server_t *server)
+{
+  unsigned int   local_infile = 1;
+
+#ifdef MYSQL_OPT_SSL_MODE
+  DEBUG("mysql_options(%p,%s,%d)", con, "MYSQL_OPT_SSL_MODE", args.ssl_mode);
+  mysql_options(con, MYSQL_OPT_SSL_MODE, args.ssl_mode);
+#endif
+
+  if (args.use_ssl)
+  {
+    DEBUG("mysql_ssl_set(%p, \"%s\", \"%s\", \"%s\", NULL, \"%s\")", con,
+          SAFESTR(args.ssl_key), SAFESTR(args.ssl_cert), SAFESTR(args.ssl_ca),
+          SAFESTR(args.ssl_cipher));
 
     mysql_ssl_set(con, args.ssl_key, args.ssl_cert, args.ssl_ca, NULL,
                   args.ssl_cipher);
 
   }
 
+#ifdef HAVE_MYSQL_SSL_SESSION
+  if (args.ssl_session_reuse && ssl_session != NULL)
+  {
+    DEBUG("mysql_options(%p, %s, %p)", con, "MYSQL_OPT_SSL_SESSION_DATA",
+          ssl_session);
+    mysql_options(con, MYSQL_OPT_SSL_SESSION_DATA, ssl_session);
+  }
+#endif
+
   if (args.use_compression)
   {
     DEBUG("mysql_options(%p, %s, %s)",con, "MYSQL_OPT_COMPRESS", "NULL");
     mysql_options(con, MYSQL_OPT_COMPRESS, NULL);
   }
 
+#ifdef HAVE_MYSQL_COMPRESSION_ALGORITHMS
+  if (args.compression_algorithms != NULL)
+  {
+    DEBUG("mysql_options(%p, %s, \"%s\")", con,
+          "MYSQL_OPT_COMPRESSION_ALGORITHMS", args.compression_algorithms);
+    mysql_options(con, MYSQL_OPT_COMPRESSION_ALGORITHMS,
+                  args.compression_algorithms);
+    DEBUG("mysql_options(%p, %s, %u)", con, "MYSQL_OPT_ZSTD_COMPRESSION_LEVEL",
+          args.zstd_level);
+    mysql_options(con, MYSQL_OPT_ZSTD_COMPRESSION_LEVEL, &args.zstd_level);
+  }
+#endif
+
+#ifdef HAVE_MYSQL_OPT_BIND
+  if (args.nbind_addresses > 0 && server->socket == NULL)
+  {
+    const char * const addr = args.bind_addresses[
+      ck_pr_faa_32(&next_bind_address, 1) % args.nbind_addresses];
+
+    DEBUG("mysql_options(%p, %s, \"%s\")", con, "MYSQL_OPT_BIND", addr);
+    mysql_options(con, MYSQL_OPT_BIND, addr);
+  }
+#endif
+
+#ifdef HAVE_MYSQL_OPT_NET_BUFFER_LENGTH
+  if (sb_globals.lean_workers)
+  {
+    const unsigned long net_buffer_length = MYSQL_LEAN_NET_BUFFER_LENGTH;
+
+    DEBUG("mysql_options(%p, %s, %lu)", con, "MYSQL_OPT_NET_BUFFER_LENGTH",
+          net_buffer_length);
+    mysql_options(con, MYSQL_OPT_NET_BUFFER_LENGTH, &net_buffer_length);
+  }
+#endif
+
+  /* Used by bulk loads, see mysql_infile_init() */
+  DEBUG("mysql_options(%p, %s, %u)", con, "MYSQL_OPT_LOCAL_INFILE",
+        local_infile);
+  mysql_options(con, MYSQL_OPT_LOCAL_INFILE, &local_infile);
+  mysql_set_local_infile_handler(con, mysql_infile_init, mysql_infile_read,
+                                 mysql_infile_end, mysql_infile_error,
+                                 db_mysql_con);
+
   DEBUG("mysql_real_connect(%p, \"%s\", \"%s\", \"%s\", \"%s\", %u, \"%s\", %s)",
         con,
-        SAFESTR(db_mysql_con->host),
+        SAFESTR(server->host),
         SAFESTR(db_mysql_con->user),
         SAFESTR(db_mysql_con->password),
         SAFESTR(db_mysql_con->db),
-        db_mysql_con->port,
-        SAFESTR(db_mysql_con->socket),
+        server->port,
+        SAFESTR(server->socket),
         (MYSQL_VERSION_ID >= 50000) ? "CLIENT_MULTI_STATEMENTS" : "0"
         );
 
-  return mysql_real_connect(con,
-                            db_mysql_con->host,
-                            db_mysql_con->user,
-                            db_mysql_con->password,
-                            db_mysql_con->db,
-                            db_mysql_con->port,
-                            db_mysql_con->socket,
+  if (mysql_real_connect(con,
+                         server->host,
+                         db_mysql_con->user,
+                         db_mysql_con->password,
+                         db_mysql_con->db,
+                         server->port,
+                         server->socket,
 #if MYSQL_VERSION_ID >= 50000
-                            CLIENT_MULTI_STATEMENTS
+                         CLIENT_MULTI_STATEMENTS
+#else
+                         0
+#endif
+                         ) == NULL)
+    return 1;
+
+  db_socket_tune(connection_socket(con));
+
+#ifdef HAVE_MYSQL_SSL_SESSION
+  if (args.ssl_session_reuse)
+    save_ssl_session(con);
+#endif
+
+  return 0;
+}
+
+
+/* Report a connection failure */
+
+static void report_connect_error(MYSQL *con, const mysql_server_t *server)
+{
+  if (server->socket != NULL)
+    log_text(LOG_FATAL, "unable to connect to MySQL server on socket '%s', "
+             "aborting...", server->socket);
+  else
+    log_text(LOG_FATAL, "unable to connect to MySQL server on host '%s', "
+             "port %u, aborting...", server->host, server->port);
+  log_text(LOG_FATAL, "error %d: %s", mysql_errno(con), mysql_error(con));
+}
+
+
+/*
+  Add bytes transferred over the connections of 'sb_conn' since the previous
+  call to the SB_CNT_NET_* counters. Called before each query, so rows of
+  unbuffered results are accounted after they are read.
+*/
+
+static void net_stats_update(db_conn_t *sb_conn)
+{
+#ifdef HAVE_STRUCT_TCP_INFO_TCPI_BYTES_RECEIVED
+  db_mysql_conn_t * const db_mysql_con = sb_conn->ptr;
+  MYSQL * const           cons[2] = { db_mysql_con->mysql,
+                                      db_mysql_con->replica };
+
+  for (unsigned int i = 0; i < 2 && cons[i] != NULL; i++)
+  {
+    struct tcp_info ti;
+    socklen_t       len = sizeof(ti);
+    const int       fd = connection_socket(cons[i]);
+
+    /* Connections over Unix sockets have no TCP counters */
+    if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &len) != 0 ||
+        len < offsetof(struct tcp_info, tcpi_bytes_received) +
+        sizeof(ti.tcpi_bytes_received))
+    {
+      if (!ck_pr_fas_int(&net_stats_missing, 1))
+        log_text(LOG_WARNING, "--mysql-net-stats only counts TCP "
+                 "connections, use --mysql-host=127.0.0.1 instead of "
+                 "localhost");
+      continue;
+    }
+
+    sb_counter_add(sb_conn->thread_id, SB_CNT_NET_SENT,
+                   ti.tcpi_bytes_acked - db_mysql_con->net_sent[i]);
+    sb_counter_add(sb_conn->thread_id, SB_CNT_NET_RECEIVED,
+                   ti.tcpi_bytes_received - db_mysql_con->net_received[i]);
+
+    db_mysql_con->net_sent[i] = ti.tcpi_bytes_acked;
+    db_mysql_con->net_received[i] = ti.tcpi_bytes_received;
+  }
 #else
-                            0
+  (void) sb_conn; /* unused */
 #endif
-                            ) == NULL;
+}
+
+
+/* Close a connection and release its server */
+
+static void close_connection(MYSQL *con, mysql_server_t *server)
+{
+  if (con == NULL)
+    return;
+
+  DEBUG("mysql_close(%p)", con);
+  mysql_close(con);
+  free(con);
+
+  ck_pr_dec_64(&server->connections);
 }
 
 
@@ -411,67 +1258,27 @@ int mysql_drv_connect(db_conn_t *sb_conn)
 
   con = (MYSQL *) malloc(sizeof(MYSQL));
   if (con == NULL)
+  {
+    free(db_mysql_con);
     return 1;
+  }
 
   db_mysql_con->mysql = con;
+  db_mysql_con->cur = con;
 
   DEBUG("mysql_init(%p)", con);
   mysql_init(con);
 
-  pthread_mutex_lock(&pos_mutex);
-
-  if (SB_LIST_IS_EMPTY(args.sockets))
-  {
-    db_mysql_con->socket = NULL;
-    db_mysql_con->host = SB_LIST_ENTRY(hosts_pos, value_t, listitem)->data;
-    db_mysql_con->port =
-      atoi(SB_LIST_ENTRY(ports_pos, value_t, listitem)->data);
-
-    /*
-       Pick the next port in args.ports. If there are no more ports in the list,
-       move to the next available host and get the first port again.
-    */
-    ports_pos = SB_LIST_ITEM_NEXT(ports_pos);
-    if (ports_pos == args.ports) {
-      hosts_pos = SB_LIST_ITEM_NEXT(hosts_pos);
-      if (hosts_pos == args.hosts)
-        hosts_pos = SB_LIST_ITEM_NEXT(hosts_pos);
-
-      ports_pos = SB_LIST_ITEM_NEXT(ports_pos);
-    }
-  }
-  else
-  {
-    db_mysql_con->host = "localhost";
-
-    /*
-       The sockets list may be empty. So unlike hosts/ports the loop invariant
-       here is that sockets_pos points to the previous one and should be
-       advanced before using it, not after.
-     */
-    sockets_pos = SB_LIST_ITEM_NEXT(sockets_pos);
-    if (sockets_pos == args.sockets)
-      sockets_pos = SB_LIST_ITEM_NEXT(sockets_pos);
-
-    db_mysql_con->socket = SB_LIST_ENTRY(sockets_pos, value_t, listitem)->data;
-  }
-  pthread_mutex_unlock(&pos_mutex);
+  db_mysql_con->server = select_server(&primaries, sb_conn->thread_id);
 
   db_mysql_con->user = args.user;
   db_mysql_con->password = args.password;
   db_mysql_con->db = args.db;
 
-  if (mysql_drv_real_connect(db_mysql_con))
+  if (mysql_drv_real_connect(db_mysql_con, con, db_mysql_con->server))
   {
-    if (!SB_LIST_IS_EMPTY(args.sockets))
-      log_text(LOG_FATAL, "unable to connect to MySQL server on socket '%s', "
-               "aborting...", db_mysql_con->socket);
-    else
-      log_text(LOG_FATAL, "unable to connect to MySQL server on host '%s', "
-               "port %u, aborting...",
-               db_mysql_con->host, db_mysql_con->port);
-    log_text(LOG_FATAL, "error %d: %s", mysql_errno(con),
-             mysql_error(con));
+    report_connect_error(con, db_mysql_con->server);
+    ck_pr_dec_64(&db_mysql_con->server->connections);
     free(db_mysql_con);
     free(con);
     return 1;
@@ -483,6 +1290,37 @@ int mysql_drv_connect(db_conn_t *sb_conn)
           SAFESTR(mysql_get_ssl_cipher(con)));
   }
 
+  if (replicas.nservers > 0)
+  {
+    MYSQL * const rcon = (MYSQL *) malloc(sizeof(MYSQL));
+
+    if (rcon == NULL)
+    {
+      close_connection(con, db_mysql_con->server);
+      free(db_mysql_con);
+      return 1;
+    }
+
+    DEBUG("mysql_init(%p)", rcon);
+    mysql_init(rcon);
+
+    db_mysql_con->replica_server = select_server(&replicas,
+                                                 sb_conn->thread_id);
+
+    if (mysql_drv_real_connect(db_mysql_con, rcon,
+                               db_mysql_con->replica_server))
+    {
+      report_connect_error(rcon, db_mysql_con->replica_server);
+      ck_pr_dec_64(&db_mysql_con->replica_server->connections);
+      free(rcon);
+      close_connection(con, db_mysql_con->server);
+      free(db_mysql_con);
+      return 1;
+    }
+
+    db_mysql_con->replica = rcon;
+  }
+
   sb_conn->ptr = db_mysql_con;
 
   return 0;
@@ -500,9 +1338,12 @@ int mysql_drv_disconnect(db_conn_t *sb_conn)
     return 0;
   if (db_mysql_con != NULL && db_mysql_con->mysql != NULL)
   {
-    DEBUG("mysql_close(%p)", db_mysql_con->mysql);
-    mysql_close(db_mysql_con->mysql);
-    free(db_mysql_con->mysql);
+    if (args.net_stats)
+      net_stats_update(sb_conn);
+
+    close_connection(db_mysql_con->mysql, db_mysql_con->server);
+    close_connection(db_mysql_con->replica, db_mysql_con->replica_server);
+    free(db_mysql_con->pipeline_buf);
     free(db_mysql_con);
   }
 
@@ -510,6 +1351,36 @@ int mysql_drv_disconnect(db_conn_t *sb_conn)
 }
 
 
+/*
+  Check if a query can be sent to a replica, i.e. whether it is a SELECT that
+  does not lock rows
+*/
+
+static bool query_is_read(const char *query, size_t len)
+{
+  const char * const end = query + len;
+  const char         *p;
+
+  while (query < end && (isspace((unsigned char) *query) || *query == '('))
+    query++;
+
+  if (end - query < 6 || strncasecmp(query, "SELECT", 6))
+    return false;
+
+  for (p = query + 6; p + 10 <= end; p++)
+  {
+    if ((*p == 'F' || *p == 'f') &&
+        (!strncasecmp(p, "FOR UPDATE", 10) || !strncasecmp(p, "FOR SHARE", 9)))
+      return false;
+    if ((*p == 'L' || *p == 'l') &&
+        p + 18 <= end && !strncasecmp(p, "LOCK IN SHARE MODE", 18))
+      return false;
+  }
+
+  return true;
+}
+
+
 /* Prepare statement */
 
 
@@ -527,6 +1398,10 @@ int mysql_drv_prepare(db_stmt_t *stmt, const char *query, size_t len)
   if (con == NULL)
     return 1;
 
+  /* Statements are bound to a connection, so reads are prepared on replica */
+  if (db_mysql_con->replica != NULL && query_is_read(query, len))
+    con = db_mysql_con->replica;
+
   if (use_ps)
   {
     mystmt = mysql_stmt_init(con);
@@ -562,10 +1437,31 @@ int mysql_drv_prepare(db_stmt_t *stmt, const char *query, size_t len)
       }
     }
 
-    stmt->query = strdup(query);
     stmt->counter = (mysql_stmt_field_count(mystmt) > 0) ?
       SB_CNT_READ : SB_CNT_WRITE;
 
+    if (db_globals.fetch_size > 0 && stmt->counter == SB_CNT_READ)
+    {
+      const unsigned long type = CURSOR_TYPE_READ_ONLY;
+      const unsigned long rows = db_globals.fetch_size;
+
+      DEBUG("mysql_stmt_attr_set(%p, %s, %lu)", mystmt,
+            "STMT_ATTR_CURSOR_TYPE", type);
+      DEBUG("mysql_stmt_attr_set(%p, %s, %lu)", mystmt,
+            "STMT_ATTR_PREFETCH_ROWS", rows);
+      if (mysql_stmt_attr_set(mystmt, STMT_ATTR_CURSOR_TYPE, &type) ||
+          mysql_stmt_attr_set(mystmt, STMT_ATTR_PREFETCH_ROWS, &rows))
+      {
+        log_text(LOG_FATAL, "mysql_stmt_attr_set() failed: %s",
+                 mysql_stmt_error(mystmt));
+        DEBUG("mysql_stmt_close(%p)", mystmt);
+        mysql_stmt_close(mystmt);
+        return 1;
+      }
+    }
+
+    stmt->query = strdup(query);
+
     return 0;
   }
 
@@ -579,6 +1475,22 @@ int mysql_drv_prepare(db_stmt_t *stmt, const char *query, size_t len)
 }
 
 
+/*
+  Get the connection a prepared statement was created on. The library resets it
+  when the connection is closed, in which case the primary one is returned.
+*/
+
+static inline MYSQL *stmt_mysql(db_stmt_t *stmt)
+{
+  MYSQL_STMT * const mystmt = stmt->ptr;
+
+  if (mystmt != NULL && mystmt->mysql != NULL)
+    return mystmt->mysql;
+
+  return ((db_mysql_conn_t *) stmt->connection->ptr)->mysql;
+}
+
+
 static void convert_to_mysql_bind(MYSQL_BIND *mybind, db_bind_t *bind)
 {
   mybind->buffer_type = get_mysql_bind_type(bind->type);
@@ -609,6 +1521,7 @@ int mysql_drv_bind_param(db_stmt_t *stmt, db_bind_t *params, size_t len)
   unsigned int i;
   my_bool rc;
   unsigned long param_count;
+  bool         has_blobs = false;
 
   if (args.dry_run)
     return 0;
@@ -623,6 +1536,9 @@ int mysql_drv_bind_param(db_stmt_t *stmt, db_bind_t *params, size_t len)
   {
     if (stmt->ptr == NULL)
       return 1;
+
+    con = stmt_mysql(stmt);
+
     /* Validate parameters count */
     param_count = mysql_stmt_param_count(stmt->ptr);
     DEBUG("mysql_stmt_param_count(%p) = %lu", stmt->ptr, param_count);
@@ -636,7 +1552,10 @@ int mysql_drv_bind_param(db_stmt_t *stmt, db_bind_t *params, size_t len)
     if (bind == NULL)
       return 1;
     for (i = 0; i < len; i++)
+    {
       convert_to_mysql_bind(&bind[i], &params[i]);
+      has_blobs |= params[i].type == DB_TYPE_BLOB;
+    }
 
     rc = mysql_stmt_bind_param(stmt->ptr, bind);
     DEBUG("mysql_stmt_bind_param(%p, %p) = %d", stmt->ptr, bind, rc);
@@ -650,7 +1569,12 @@ int mysql_drv_bind_param(db_stmt_t *stmt, db_bind_t *params, size_t len)
     }
     free(bind);
 
-    return 0;
+    /*
+      Parameters are also needed to build queries in pipeline mode and to send
+      BLOB values, see mysql_send_blobs()
+    */
+    if (!args.pipeline && !has_blobs)
+      return 0;
   }
 
   /* Use emulation */
@@ -709,27 +1633,127 @@ int mysql_drv_bind_result(db_stmt_t *stmt, db_bind_t *params, size_t len)
 static int mysql_drv_reconnect(db_conn_t *sb_con)
 {
   db_mysql_conn_t *db_mysql_con = (db_mysql_conn_t *) sb_con->ptr;
-  MYSQL *con = db_mysql_con->mysql;
+  MYSQL *con = db_mysql_con->cur;
+  const bool replica = (con == db_mysql_con->replica);
+  mysql_server_set_t * const set = replica ? &replicas : &primaries;
+  mysql_server_t **server = replica ? &db_mysql_con->replica_server :
+    &db_mysql_con->server;
+  const bool next = args.reconnect_policy == RECONNECT_POLICY_NEXT &&
+    set->nservers > 1;
+  unsigned int tries = 0;
 
   log_text(LOG_DEBUG, "Reconnecting");
 
+  /* Only the failed connection is reestablished */
   DEBUG("mysql_close(%p)", con);
   mysql_close(con);
 
-  while (mysql_drv_real_connect(db_mysql_con))
+#ifdef HAVE_MYSQL_NONBLOCK
+  /* Options are reset by mysql_close() */
+  if (con == db_mysql_con->mysql)
+    db_mysql_con->nonblock = false;
+#endif
+
+  do
   {
-    if (sb_globals.error)
-      return DB_ERROR_FATAL;
+    if (tries > 0)
+    {
+      if (sb_globals.error)
+        return DB_ERROR_FATAL;
 
-    usleep(1000);
-  }
+      /* With the 'next' policy, pause after each round over all servers */
+      if (!next || tries % set->nservers == 0)
+        usleep(1000);
+    }
+
+    if (next)
+    {
+      const unsigned int timeout = MYSQL_FAST_RECONNECT_TIMEOUT;
+
+      *server = next_server(set, *server);
+
+      DEBUG("mysql_options(%p, %s, %u)", con, "MYSQL_OPT_CONNECT_TIMEOUT",
+            timeout);
+      mysql_options(con, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+    }
+
+    tries++;
+  } while (mysql_drv_real_connect(db_mysql_con, con, *server));
 
   log_text(LOG_DEBUG, "Reconnected");
 
+  /* Byte counters of the new socket start from 0 */
+  const unsigned int i = replica ? 1 : 0;
+
+  db_mysql_con->net_sent[i] = 0;
+  db_mysql_con->net_received[i] = 0;
+
   return DB_ERROR_IGNORABLE;
 }
 
 
+/* Reset session state of a single connection, see mysql_drv_reset() */
+
+static int reset_session(db_mysql_conn_t *db_mysql_con, MYSQL *con)
+{
+  const char *func;
+  int        rc;
+
+  if (args.session_reset == SESSION_RESET_CHANGE_USER)
+  {
+    func = "mysql_change_user";
+    DEBUG("mysql_change_user(%p, \"%s\", \"%s\", \"%s\")", con,
+          SAFESTR(db_mysql_con->user), SAFESTR(db_mysql_con->password),
+          SAFESTR(db_mysql_con->db));
+    rc = mysql_change_user(con, db_mysql_con->user, db_mysql_con->password,
+                           db_mysql_con->db);
+  }
+  else
+  {
+#ifdef HAVE_MYSQL_RESET_CONNECTION
+    func = "mysql_reset_connection";
+    DEBUG("mysql_reset_connection(%p)", con);
+    rc = mysql_reset_connection(con);
+#else
+    log_text(LOG_FATAL, "--mysql-session-reset=reset-connection requires "
+             "MySQL client library 5.7.3 or later");
+    return 1;
+#endif
+  }
+
+  if (rc)
+  {
+    log_text(LOG_FATAL, "%s() failed: error %u: %s", func, mysql_errno(con),
+             mysql_error(con));
+    return 1;
+  }
+
+  return 0;
+}
+
+/*
+  Reset session state without reconnecting. Server-side prepared statements
+  are deallocated by the server, their client-side handles are only closed.
+*/
+
+static int mysql_drv_reset(db_conn_t *sb_con)
+{
+  db_mysql_conn_t *db_mysql_con = (db_mysql_conn_t *) sb_con->ptr;
+
+  if (args.dry_run)
+    return 0;
+
+  if (reset_session(db_mysql_con, db_mysql_con->mysql))
+    return 1;
+
+  if (db_mysql_con->replica != NULL &&
+      reset_session(db_mysql_con, db_mysql_con->replica))
+    return 1;
+
+  return 0;
+}
+
+
 /*
   Check if the error in a given connection should be fatal or ignored according
   to the list of errors in --mysql-ignore-errors.
@@ -742,7 +1766,7 @@ static db_error_t check_error(db_conn_t *sb_con, const char *func,
   sb_list_item_t *pos;
   unsigned int   tmp;
   db_mysql_conn_t *db_mysql_con = (db_mysql_conn_t *) sb_con->ptr;
-  MYSQL          *con = db_mysql_con->mysql;
+  MYSQL          *con = db_mysql_con->cur;
 
   const unsigned int error = mysql_errno(con);
   DEBUG("mysql_errno(%p) = %u", con, sb_con->sql_errno);
@@ -804,34 +1828,140 @@ static db_error_t check_error(db_conn_t *sb_con, const char *func,
   return DB_ERROR_FATAL;
 }
 
-/* Execute prepared statement */
-
+/*
+  Read and drop rows of a statement executed with a cursor, see
+  --db-fetch-size. The client library fetches them from the server in batches
+  of STMT_ATTR_PREFETCH_ROWS rows.
+*/
 
-db_error_t mysql_drv_execute(db_stmt_t *stmt, db_result_t *rs)
+static db_error_t fetch_cursor(db_conn_t *con, db_stmt_t *stmt,
+                               db_result_t *rs, mysql_server_t *server,
+                               const struct timespec *start)
 {
-  db_conn_t       *con = stmt->connection;
-  char            *buf = NULL;
-  unsigned int    buflen = 0;
-  unsigned int    i, j, vcnt;
-  char            need_realloc;
-  int             n;
+  struct timespec first;
+  struct timespec end;
+  uint64_t        rows = 0;
+  int             err;
+
+  /* Without bound result buffers fetched rows are not copied anywhere */
+  while ((err = mysql_stmt_fetch(stmt->ptr)) == 0 ||
+         err == MYSQL_DATA_TRUNCATED)
+  {
+    if (rows++ == 0)
+      SB_GETTIME(&first);
+  }
 
-  if (args.dry_run)
-    return DB_ERROR_NONE;
+  DEBUG("mysql_stmt_fetch(%p) = %d after %" PRIu64 " rows", stmt->ptr, err,
+        rows);
 
-  con->sql_errno = 0;
-  con->sql_state = NULL;
-  con->sql_errmsg = NULL;
+  if (err != MYSQL_NO_DATA)
+    return check_error(con, "mysql_stmt_fetch()", stmt->query, &rs->counter);
 
-  if (!stmt->emulated)
-  {
-    if (stmt->ptr == NULL)
+  SB_GETTIME(&end);
+
+  if (rows == 0)
+    first = end;
+
+  if (track_servers)
+    server_add_query(server, start);
+
+  db_cursor_stats_add(con, TIMESPEC_DIFF(first, (*start)),
+                      TIMESPEC_DIFF(end, (*start)), rows);
+
+  rs->nrows = 0;
+
+  return DB_ERROR_NONE;
+}
+
+
+/* Execute prepared statement */
+
+
+typedef struct
+{
+  MYSQL_STMT   *stmt;
+  unsigned int param;
+} blob_dest_t;
+
+static int send_blob_chunk(void *arg, const char *buf, size_t len)
+{
+  const blob_dest_t *dest = arg;
+  my_bool           rc;
+
+  rc = mysql_stmt_send_long_data(dest->stmt, dest->param, buf, len);
+  DEBUG("mysql_stmt_send_long_data(%p, %u, %p, %zu) = %d", dest->stmt,
+        dest->param, buf, len, rc);
+
+  return rc;
+}
+
+
+/*
+  Send values of DB_TYPE_BLOB parameters in chunks with
+  mysql_stmt_send_long_data() before executing a statement. The server
+  accumulates them until the statement is executed.
+*/
+
+static int mysql_send_blobs(db_stmt_t *stmt)
+{
+  for (unsigned int i = 0; i < stmt->bound_param_len; i++)
+  {
+    const db_bind_t * const param = stmt->bound_param + i;
+    blob_dest_t             dest = { stmt->ptr, i };
+
+    if (param->type != DB_TYPE_BLOB ||
+        (param->is_null != NULL && *param->is_null))
+      continue;
+
+    if (db_blob_send(param->data_len[0], send_blob_chunk, &dest))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+db_error_t mysql_drv_execute(db_stmt_t *stmt, db_result_t *rs)
+{
+  db_conn_t       *con = stmt->connection;
+  db_mysql_conn_t *db_mysql_con = (db_mysql_conn_t *) con->ptr;
+
+  if (args.dry_run)
+    return DB_ERROR_NONE;
+
+  con->sql_errno = 0;
+  con->sql_state = NULL;
+  con->sql_errmsg = NULL;
+
+  /* Queued statements are sent as text, see mysql_drv_pipeline_end() */
+  if (!stmt->emulated && con->state != DB_CONN_PIPELINE)
+  {
+    if (stmt->ptr == NULL)
     {
       log_text(LOG_DEBUG,
                "ERROR: exiting mysql_drv_execute(), uninitialized statement");
       return DB_ERROR_FATAL;
     }
 
+    if (args.net_stats)
+      net_stats_update(con);
+
+    db_mysql_con->cur = stmt_mysql(stmt);
+
+    mysql_server_t * const server =
+      (db_mysql_con->cur == db_mysql_con->replica) ?
+      db_mysql_con->replica_server : db_mysql_con->server;
+    struct timespec start;
+
+    con->server = server->name;
+
+    if (track_servers || db_globals.fetch_size > 0)
+      SB_GETTIME(&start);
+
+    if (stmt->bound_param != NULL && mysql_send_blobs(stmt))
+      return check_error(con, "mysql_stmt_send_long_data()", stmt->query,
+                         &rs->counter);
+
     int err = mysql_stmt_execute(stmt->ptr);
     DEBUG("mysql_stmt_execute(%p) = %d", stmt->ptr, err);
 
@@ -839,8 +1969,13 @@ db_error_t mysql_drv_execute(db_stmt_t *stmt, db_result_t *rs)
       return check_error(con, "mysql_stmt_execute()", stmt->query,
                          &rs->counter);
 
+    db_first_result(con);
+
     if (stmt->counter != SB_CNT_READ)
     {
+      if (track_servers)
+        server_add_query(server, &start);
+
       rs->nrows = (uint32_t) mysql_stmt_affected_rows(stmt->ptr);
       DEBUG("mysql_stmt_affected_rows(%p) = %u", stmt->ptr,
             (unsigned) rs->nrows);
@@ -850,6 +1985,34 @@ db_error_t mysql_drv_execute(db_stmt_t *stmt, db_result_t *rs)
       return DB_ERROR_NONE;
     }
 
+    rs->counter = stmt->counter;
+
+    /* Statements returning result sets are executed with cursors */
+    if (db_globals.fetch_size > 0)
+      return fetch_cursor(con, stmt, rs, server, &start);
+
+    /*
+      Rows of an unbuffered result are read by mysql_stmt_free_result(), either
+      right away or when the result set is freed
+    */
+    if (db_globals.result_mode != DB_RESULT_MODE_STORE)
+    {
+      if (db_globals.result_mode == DB_RESULT_MODE_DISCARD)
+      {
+        DEBUG("mysql_stmt_free_result(%p)", stmt->ptr);
+        if (mysql_stmt_free_result(stmt->ptr))
+          return check_error(con, "mysql_stmt_free_result()", NULL,
+                             &rs->counter);
+      }
+
+      if (track_servers)
+        server_add_query(server, &start);
+
+      rs->nrows = 0;
+
+      return DB_ERROR_NONE;
+    }
+
     err = mysql_stmt_store_result(stmt->ptr);
     DEBUG("mysql_stmt_store_result(%p) = %d", stmt->ptr, err);
     if (err)
@@ -858,7 +2021,9 @@ db_error_t mysql_drv_execute(db_stmt_t *stmt, db_result_t *rs)
                          &rs->counter);
     }
 
-    rs->counter = stmt->counter;
+    if (track_servers)
+      server_add_query(server, &start);
+
     rs->nrows = (uint32_t) mysql_stmt_num_rows(stmt->ptr);
     DEBUG("mysql_stmt_num_rows(%p) = %u", rs->statement->ptr,
           (unsigned) (rs->nrows));
@@ -867,49 +2032,181 @@ db_error_t mysql_drv_execute(db_stmt_t *stmt, db_result_t *rs)
   }
 
   /* Use emulation */
-  /* Build the actual query string from parameters list */
-  need_realloc = 1;
-  vcnt = 0;
-  for (i = 0, j = 0; stmt->query[i] != '\0'; i++)
+  unsigned int query_len;
+  const char   *query = db_print_query(stmt, &query_len);
+
+  if (query == NULL)
+    return DB_ERROR_FATAL;
+
+  return mysql_drv_query(con, query, query_len, rs);
+}
+
+
+#ifdef HAVE_MYSQL_BULK_EXECUTE
+
+/* Check if the server supports bulk execution */
+
+static bool bulk_supported(MYSQL *con)
+{
+  unsigned long caps = 0;
+
+  if (mariadb_get_infov(con, MARIADB_CONNECTION_EXTENDED_SERVER_CAPABILITIES,
+                        &caps))
+    return false;
+
+  return (caps & (MARIADB_CLIENT_STMT_BULK_OPERATIONS >> 32)) != 0;
+}
+
+
+/*
+  Bind the parameter values of all batch rows column-wise, and send them with a
+  single COM_STMT_BULK_EXECUTE. Returns -1 if the statement cannot be executed
+  that way, otherwise the result of mysql_stmt_execute().
+*/
+
+static int bulk_execute(db_stmt_t *stmt)
+{
+  const db_batch_t * const b = &stmt->batch;
+  const unsigned int       nrows = b->nrows;
+  const unsigned int       nparams = b->nparams;
+  MYSQL_BIND               *bind;
+  char                     *indicators;
+  unsigned long            *lengths;
+  char                     **values;
+  int                      rc = -1;
+
+  for (unsigned int i = 0; i < nparams; i++)
+    if (stmt->param[i].type != DB_TYPE_TINYINT &&
+        stmt->param[i].type != DB_TYPE_SMALLINT &&
+        stmt->param[i].type != DB_TYPE_INT &&
+        stmt->param[i].type != DB_TYPE_BIGINT &&
+        stmt->param[i].type != DB_TYPE_FLOAT &&
+        stmt->param[i].type != DB_TYPE_DOUBLE &&
+        stmt->param[i].type != DB_TYPE_CHAR &&
+        stmt->param[i].type != DB_TYPE_VARCHAR)
+      return -1;
+
+  bind = calloc(nparams, sizeof(MYSQL_BIND));
+  indicators = malloc((size_t) nparams * nrows);
+  lengths = malloc((size_t) nparams * nrows * sizeof(unsigned long));
+  values = malloc((size_t) nparams * nrows * sizeof(char *));
+
+  if (bind == NULL || indicators == NULL || lengths == NULL || values == NULL)
+    goto end;
+
+  /*
+    Each parameter gets an array of pointers to its values in the batch, which
+    is how variable length values are bound column-wise. Fixed length values
+    are copied to an array of values, which reuses the same memory.
+  */
+  for (unsigned int i = 0; i < nparams; i++)
   {
-  again:
-    if (j+1 >= buflen || need_realloc)
+    const db_bind_t * const param = &stmt->param[i];
+    char            * const ind = indicators + (size_t) i * nrows;
+    unsigned long   * const len = lengths + (size_t) i * nrows;
+    char            ** const val = values + (size_t) i * nrows;
+    const bool      is_str = param->type == DB_TYPE_CHAR ||
+      param->type == DB_TYPE_VARCHAR;
+    const size_t    vsize =
+      param->type == DB_TYPE_TINYINT ? 1 :
+      param->type == DB_TYPE_SMALLINT ? 2 :
+      param->type == DB_TYPE_INT || param->type == DB_TYPE_FLOAT ? 4 : 8;
+
+    for (unsigned int r = 0; r < nrows; r++)
     {
-      buflen = (buflen > 0) ? buflen * 2 : 256;
-      buf = realloc(buf, buflen);
-      if (buf == NULL)
-      {
-        log_text(LOG_DEBUG, "ERROR: exiting mysql_drv_execute(), memory allocation failure");
-        return DB_ERROR_FATAL;
-      }
-      need_realloc = 0;
-    }
+      const db_batch_value_t * const v = &b->values[(size_t) r * nparams + i];
 
-    if (stmt->query[i] != '?')
-    {
-      buf[j++] = stmt->query[i];
-      continue;
-    }
+      ind[r] = v->is_null ? STMT_INDICATOR_NULL : STMT_INDICATOR_NONE;
+      len[r] = v->len;
 
-    n = db_print_value(stmt->bound_param + vcnt, buf + j, (int)(buflen - j));
-    if (n < 0)
-    {
-      need_realloc = 1;
-      goto again;
+      if (is_str)
+        val[r] = b->data + v->offset;
+      else if (!v->is_null)
+        memcpy((char *) val + r * vsize, b->data + v->offset, vsize);
     }
-    j += (unsigned int)n;
-    vcnt++;
+
+    bind[i].buffer_type = get_mysql_bind_type(param->type);
+    bind[i].buffer = val;
+    bind[i].length = is_str ? len : NULL;
+    bind[i].u.indicator = ind;
   }
-  buf[j] = '\0';
 
-  db_error_t rc = mysql_drv_query(con, buf, j, rs);
+  unsigned int size = nrows;
+
+  if (mysql_stmt_attr_set(stmt->ptr, STMT_ATTR_ARRAY_SIZE, &size) ||
+      mysql_stmt_bind_param(stmt->ptr, bind))
+    goto end;
 
-  free(buf);
+  rc = mysql_stmt_execute(stmt->ptr);
+  DEBUG("mysql_stmt_execute(%p) = %d, %u rows", stmt->ptr, rc, nrows);
+
+end:
+  /* Restore the parameters bound by the script */
+  size = 0;
+  mysql_stmt_attr_set(stmt->ptr, STMT_ATTR_ARRAY_SIZE, &size);
+
+  if (bind != NULL)
+  {
+    memset(bind, 0, nparams * sizeof(MYSQL_BIND));
+    for (unsigned int i = 0; i < nparams; i++)
+      convert_to_mysql_bind(&bind[i], &stmt->param[i]);
+    mysql_stmt_bind_param(stmt->ptr, bind);
+  }
+
+  free(bind);
+  free(indicators);
+  free(lengths);
+  free(values);
 
   return rc;
 }
 
 
+/* Execute a prepared statement for all rows of its batch */
+
+
+db_error_t mysql_drv_execute_batch(db_stmt_t *stmt, db_result_t *rs)
+{
+  db_conn_t       *con = stmt->connection;
+  db_mysql_conn_t *db_mysql_con = (db_mysql_conn_t *) con->ptr;
+
+  if (args.dry_run)
+    return DB_ERROR_NONE;
+
+  /*
+    Statements returning result sets, emulated or queued in a pipeline are
+    executed one by one
+  */
+  if (stmt->emulated || stmt->ptr == NULL || con->state == DB_CONN_PIPELINE ||
+      stmt->counter == SB_CNT_READ || !bulk_supported(stmt_mysql(stmt)))
+    return db_batch_execute_rows(stmt, rs);
+
+  con->sql_errno = 0;
+  con->sql_state = NULL;
+  con->sql_errmsg = NULL;
+
+  db_mysql_con->cur = stmt_mysql(stmt);
+
+  const int err = bulk_execute(stmt);
+
+  if (err < 0)
+    return db_batch_execute_rows(stmt, rs);
+
+  if (err)
+    return check_error(con, "mysql_stmt_execute()", stmt->query,
+                       &rs->counter);
+
+  db_first_result(con);
+
+  rs->nrows = (uint32_t) mysql_stmt_affected_rows(stmt->ptr);
+  rs->counter = (rs->nrows > 0) ? SB_CNT_WRITE : SB_CNT_OTHER;
+
+  return DB_ERROR_NONE;
+}
+
+#endif /* HAVE_MYSQL_BULK_EXECUTE */
+
+
 /* Execute SQL query */
 
 
@@ -927,7 +2224,28 @@ db_error_t mysql_drv_query(db_conn_t *sb_conn, const char *query, size_t len,
   sb_conn->sql_errmsg = NULL;
 
   db_mysql_con = (db_mysql_conn_t *)sb_conn->ptr;
+
+  if (sb_conn->state == DB_CONN_PIPELINE)
+    return pipeline_add(db_mysql_con, query, len) ? DB_ERROR_FATAL :
+      DB_ERROR_NONE;
+
+  mysql_server_t *server = db_mysql_con->server;
+  struct timespec start;
+
+  if (args.net_stats)
+    net_stats_update(sb_conn);
+
   con = db_mysql_con->mysql;
+  if (db_mysql_con->replica != NULL && query_is_read(query, len))
+  {
+    con = db_mysql_con->replica;
+    server = db_mysql_con->replica_server;
+  }
+  db_mysql_con->cur = con;
+  sb_conn->server = server->name;
+
+  if (track_servers)
+    SB_GETTIME(&start);
 
   int err = mysql_real_query(con, query, len);
   DEBUG("mysql_real_query(%p, \"%s\", %zd) = %d", con, query, len, err);
@@ -935,9 +2253,43 @@ db_error_t mysql_drv_query(db_conn_t *sb_conn, const char *query, size_t len,
   if (SB_UNLIKELY(err != 0))
     return check_error(sb_conn, "mysql_drv_query()", query, &rs->counter);
 
-  /* Store results and get query type */
-  MYSQL_RES *res = mysql_store_result(con);
-  DEBUG("mysql_store_result(%p) = %p", con, res);
+  /* Rows of a result set follow its metadata read by mysql_real_query() */
+  db_first_result(sb_conn);
+
+  /* Store (or start reading) results and get query type */
+  MYSQL_RES *res;
+
+  if (db_globals.result_mode == DB_RESULT_MODE_STORE)
+  {
+    res = mysql_store_result(con);
+    DEBUG("mysql_store_result(%p) = %p", con, res);
+  }
+  else
+  {
+    res = mysql_use_result(con);
+    DEBUG("mysql_use_result(%p) = %p", con, res);
+  }
+
+  const db_error_t rc = store_results(sb_conn, res, rs);
+
+  if (track_servers && rc == DB_ERROR_NONE)
+    server_add_query(server, &start);
+
+  return rc;
+}
+
+
+/*
+  Get query type and the number of affected or returned rows for a result set
+  returned by mysql_store_result() or mysql_use_result(). For the latter, the
+  number of rows is the number of rows read so far.
+*/
+
+
+static db_error_t store_results(db_conn_t *sb_conn, MYSQL_RES *res,
+                                db_result_t *rs)
+{
+  MYSQL *con = ((db_mysql_conn_t *) sb_conn->ptr)->cur;
 
   if (res == NULL)
   {
@@ -960,8 +2312,42 @@ db_error_t mysql_drv_query(db_conn_t *sb_conn, const char *query, size_t len,
   }
 
   rs->counter = SB_CNT_READ;
+
+  if (db_globals.result_mode == DB_RESULT_MODE_DISCARD)
+  {
+    /* Remaining rows are read and dropped without being unpacked */
+    DEBUG("mysql_free_result(%p)", res);
+    mysql_free_result(res);
+
+    rs->ptr = NULL;
+    rs->nrows = 0;
+    rs->nfields = 0;
+
+    if (SB_UNLIKELY(mysql_errno(con) != 0))
+      return check_error(sb_conn, "mysql_free_result()", NULL, &rs->counter);
+
+    return DB_ERROR_NONE;
+  }
+
   rs->ptr = (void *)res;
 
+  if (db_globals.result_mode == DB_RESULT_MODE_STREAM)
+  {
+    /* Read the first row, so that empty result sets have zero rows */
+    rs->row.ptr = mysql_fetch_row(res);
+    DEBUG("mysql_fetch_row(%p) = %p", res, rs->row.ptr);
+
+    if (rs->row.ptr == NULL && SB_UNLIKELY(mysql_errno(con) != 0))
+    {
+      db_error_t rc = check_error(sb_conn, "mysql_fetch_row()", NULL,
+                                  &rs->counter);
+      mysql_free_result(res);
+      rs->ptr = NULL;
+
+      return rc;
+    }
+  }
+
   rs->nrows = mysql_num_rows(res);
   DEBUG("mysql_num_rows(%p) = %u", res, (unsigned int) rs->nrows);
 
@@ -972,6 +2358,274 @@ db_error_t mysql_drv_query(db_conn_t *sb_conn, const char *query, size_t len,
 }
 
 
+#ifdef HAVE_MYSQL_NONBLOCK
+
+/* Convert MYSQL_WAIT_* flags to DB_ASYNC_WAIT_* and vice versa */
+
+static int mysql_wait_to_db(int status)
+{
+  return ((status & MYSQL_WAIT_READ) ? DB_ASYNC_WAIT_READ : 0) |
+    ((status & MYSQL_WAIT_WRITE) ? DB_ASYNC_WAIT_WRITE : 0) |
+    ((status & MYSQL_WAIT_EXCEPT) ? DB_ASYNC_WAIT_EXCEPT : 0) |
+    ((status & MYSQL_WAIT_TIMEOUT) ? DB_ASYNC_WAIT_TIMEOUT : 0);
+}
+
+
+static int db_wait_to_mysql(int ready)
+{
+  return ((ready & DB_ASYNC_WAIT_READ) ? MYSQL_WAIT_READ : 0) |
+    ((ready & DB_ASYNC_WAIT_WRITE) ? MYSQL_WAIT_WRITE : 0) |
+    ((ready & DB_ASYNC_WAIT_EXCEPT) ? MYSQL_WAIT_EXCEPT : 0) |
+    ((ready & DB_ASYNC_WAIT_TIMEOUT) ? MYSQL_WAIT_TIMEOUT : 0);
+}
+
+
+/*
+  Start storing results once the query itself is complete. Returns events to
+  wait for, or 0 when both stages are complete.
+*/
+
+
+static int async_next(db_mysql_conn_t *db_mysql_con, int status)
+{
+  MYSQL *con = db_mysql_con->mysql;
+
+  if (status == 0 && !db_mysql_con->async_store &&
+      db_mysql_con->async_err == 0)
+  {
+    db_mysql_con->async_store = true;
+
+    status = mysql_store_result_start(&db_mysql_con->async_res, con);
+    DEBUG("mysql_store_result_start(%p) = %d", con, status);
+  }
+
+  return mysql_wait_to_db(status);
+}
+
+
+/* Start executing SQL query asynchronously */
+
+
+int mysql_drv_query_async(db_conn_t *sb_conn, const char *query, size_t len)
+{
+  db_mysql_conn_t *db_mysql_con;
+  MYSQL           *con;
+  int             status;
+
+  if (args.dry_run)
+    return 0;
+
+  sb_conn->sql_errno = 0;
+  sb_conn->sql_state = NULL;
+  sb_conn->sql_errmsg = NULL;
+
+  db_mysql_con = (db_mysql_conn_t *) sb_conn->ptr;
+
+  if (args.net_stats)
+    net_stats_update(sb_conn);
+
+  con = db_mysql_con->mysql;
+  /* Asynchronous queries always go to the primary */
+  db_mysql_con->cur = con;
+
+  if (!db_mysql_con->nonblock)
+  {
+    /* This can be set on an established connection */
+    DEBUG("mysql_options(%p, %s, %d)", con, "MYSQL_OPT_NONBLOCK", 0);
+    if (mysql_options(con, MYSQL_OPT_NONBLOCK, 0))
+    {
+      log_text(LOG_FATAL, "mysql_options(MYSQL_OPT_NONBLOCK) failed");
+      return -1;
+    }
+    db_mysql_con->nonblock = true;
+  }
+
+  db_mysql_con->async_store = false;
+  db_mysql_con->async_err = 0;
+  db_mysql_con->async_res = NULL;
+
+  status = mysql_real_query_start(&db_mysql_con->async_err, con, query, len);
+  DEBUG("mysql_real_query_start(%p, \"%s\", %zd) = %d", con, query, len,
+        status);
+
+  return async_next(db_mysql_con, status);
+}
+
+
+/* Continue an asynchronous query when the socket is ready */
+
+
+int mysql_drv_query_async_cont(db_conn_t *sb_conn, int ready)
+{
+  db_mysql_conn_t *db_mysql_con = (db_mysql_conn_t *) sb_conn->ptr;
+  MYSQL           *con = db_mysql_con->mysql;
+  int             status;
+
+  if (!db_mysql_con->async_store)
+  {
+    status = mysql_real_query_cont(&db_mysql_con->async_err, con,
+                                   db_wait_to_mysql(ready));
+    DEBUG("mysql_real_query_cont(%p, %d) = %d", con, ready, status);
+  }
+  else
+  {
+    status = mysql_store_result_cont(&db_mysql_con->async_res, con,
+                                     db_wait_to_mysql(ready));
+    DEBUG("mysql_store_result_cont(%p, %d) = %d", con, ready, status);
+  }
+
+  return async_next(db_mysql_con, status);
+}
+
+
+/* Get the result of a completed asynchronous query */
+
+
+db_error_t mysql_drv_query_async_result(db_conn_t *sb_conn, db_result_t *rs)
+{
+  db_mysql_conn_t *db_mysql_con;
+
+  if (args.dry_run)
+    return DB_ERROR_NONE;
+
+  db_mysql_con = (db_mysql_conn_t *) sb_conn->ptr;
+
+  if (SB_UNLIKELY(db_mysql_con->async_err != 0))
+    return check_error(sb_conn, "mysql_real_query_start()", NULL,
+                       &rs->counter);
+
+  return store_results(sb_conn, db_mysql_con->async_res, rs);
+}
+
+
+int mysql_drv_socket(db_conn_t *sb_conn)
+{
+  return (int) mysql_get_socket(((db_mysql_conn_t *) sb_conn->ptr)->mysql);
+}
+
+#endif /* HAVE_MYSQL_NONBLOCK */
+
+
+/* Enter pipeline mode, if enabled with --mysql-pipeline */
+
+
+int mysql_drv_pipeline_begin(db_conn_t *sb_conn)
+{
+  if (!args.pipeline || args.dry_run)
+    return 1;
+
+  ((db_mysql_conn_t *) sb_conn->ptr)->pipeline_len = 0;
+
+  return 0;
+}
+
+
+/* Append a query to the current multi-statement query */
+
+
+static int pipeline_add(db_mysql_conn_t *db_mysql_con, const char *query,
+                        size_t len)
+{
+  const size_t need = db_mysql_con->pipeline_len + len + 1;
+
+  if (need > db_mysql_con->pipeline_size)
+  {
+    const size_t size = SB_MAX(need, db_mysql_con->pipeline_size * 2);
+    char * const buf = realloc(db_mysql_con->pipeline_buf, size);
+
+    if (buf == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+
+    db_mysql_con->pipeline_buf = buf;
+    db_mysql_con->pipeline_size = size;
+  }
+
+  memcpy(db_mysql_con->pipeline_buf + db_mysql_con->pipeline_len, query, len);
+  db_mysql_con->pipeline_len += len;
+  db_mysql_con->pipeline_buf[db_mysql_con->pipeline_len++] = ';';
+
+  return 0;
+}
+
+
+/*
+  Send queued statements as a single multi-statement query and read all
+  results. The server stops at the first failed statement, so in case of an
+  ignorable error the rest of the group is not executed and the transaction is
+  rolled back, like in the PostgreSQL driver.
+*/
+
+
+db_error_t mysql_drv_pipeline_end(db_conn_t *sb_conn)
+{
+  db_mysql_conn_t   *db_mysql_con = (db_mysql_conn_t *) sb_conn->ptr;
+  MYSQL             *con = db_mysql_con->mysql;
+  db_error_t        rc = DB_ERROR_NONE;
+  sb_counter_type_t counter;
+  int               err;
+
+  if (db_mysql_con->pipeline_len == 0)
+    return DB_ERROR_NONE;
+
+  if (args.net_stats)
+    net_stats_update(sb_conn);
+
+  /* Multi-statement queries always go to the primary */
+  db_mysql_con->cur = con;
+
+  /* Drop the trailing separator */
+  err = mysql_real_query(con, db_mysql_con->pipeline_buf,
+                         db_mysql_con->pipeline_len - 1);
+  DEBUG("mysql_real_query(%p, \"%.*s\", %zd) = %d", con,
+        (int) db_mysql_con->pipeline_len - 1, db_mysql_con->pipeline_buf,
+        db_mysql_con->pipeline_len - 1, err);
+
+  db_mysql_con->pipeline_len = 0;
+
+  for (;;)
+  {
+    if (err != 0)
+    {
+      rc = check_error(sb_conn, "mysql_real_query()", NULL, &counter);
+      sb_counter_inc(sb_conn->thread_id, counter);
+      break;
+    }
+
+    /* Result sets are not returned to the caller in pipeline mode */
+    MYSQL_RES * const res = mysql_use_result(con);
+    DEBUG("mysql_use_result(%p) = %p", con, res);
+
+    if (res != NULL)
+    {
+      mysql_free_result(res);
+      counter = SB_CNT_READ;
+    }
+    else if (mysql_field_count(con) == 0)
+      counter = mysql_affected_rows(con) > 0 ? SB_CNT_WRITE : SB_CNT_OTHER;
+    else
+    {
+      err = 1;
+      continue;
+    }
+
+    sb_counter_inc(sb_conn->thread_id, counter);
+
+    err = mysql_next_result(con);
+    DEBUG("mysql_next_result(%p) = %d", con, err);
+    if (err < 0)
+      break;
+  }
+
+  if (rc == DB_ERROR_IGNORABLE && mysql_real_query(con, "ROLLBACK", 8) == 0)
+    mysql_free_result(mysql_store_result(con));
+
+  return rc;
+}
+
+
 /* Fetch row from result set of a prepared statement */
 
 
@@ -995,12 +2649,26 @@ int mysql_drv_fetch_row(db_result_t *rs, db_row_t *row)
   if (args.dry_run)
     return DB_ERROR_NONE;
 
-  my_row = mysql_fetch_row(rs->ptr);
-  DEBUG("mysql_fetch_row(%p) = %p", rs->ptr, my_row);
+  /* The first row of a streamed result set is read by store_results() */
+  if (row->ptr != NULL)
+  {
+    my_row = row->ptr;
+    row->ptr = NULL;
+  }
+  else
+  {
+    my_row = mysql_fetch_row(rs->ptr);
+    DEBUG("mysql_fetch_row(%p) = %p", rs->ptr, my_row);
+
+    if (my_row == NULL)
+      return 1;
+
+    rs->nrows = mysql_num_rows(rs->ptr);
+  }
 
   unsigned long *lengths = mysql_fetch_lengths(rs->ptr);
   if (lengths == NULL)
-    return DB_ERROR_NONE;
+    return 1;
 
   for (size_t i = 0; i < rs->nfields; i++)
   {
@@ -1033,6 +2701,8 @@ int mysql_drv_free_results(db_result_t *rs)
     rs->ptr = NULL;
   }
 
+  rs->row.ptr = NULL;
+
   return 0;
 }
 
@@ -1063,6 +2733,157 @@ int mysql_drv_close(db_stmt_t *stmt)
 }
 
 
+/*
+  Bulk load with LOAD DATA LOCAL INFILE, streaming data from a callback rather
+  than a file
+*/
+
+
+int mysql_drv_copy_stream(db_conn_t *sb_conn, const char *query, size_t len,
+                          db_copy_read_t *read_cb, void *arg)
+{
+  db_mysql_conn_t *db_mysql_con;
+  MYSQL           *con;
+  unsigned int    error;
+  int             err;
+
+  if (args.dry_run)
+    return 0;
+
+  db_mysql_con = (db_mysql_conn_t *) sb_conn->ptr;
+  con = db_mysql_con->mysql;
+
+  if (args.net_stats)
+    net_stats_update(sb_conn);
+
+  db_mysql_con->copy_read = read_cb;
+  db_mysql_con->copy_arg = arg;
+
+  err = mysql_real_query(con, query, len);
+  DEBUG("mysql_real_query(%p, \"%s\", %zd) = %d", con, query, len, err);
+
+  db_mysql_con->copy_read = NULL;
+  db_mysql_con->copy_arg = NULL;
+
+  if (err == 0)
+    return 0;
+
+  error = mysql_errno(con);
+  switch (error) {
+  case ER_NOT_ALLOWED_COMMAND:
+  case 3948:                    /* ER_CLIENT_LOCAL_FILES_DISABLED */
+  case 2068:                    /* CR_LOAD_DATA_LOCAL_INFILE_REJECTED */
+    log_text(LOG_WARNING, "LOAD DATA LOCAL INFILE is disabled (error %u: %s), "
+             "consider enabling local_infile on the server", error,
+             mysql_error(con));
+    return 1;
+
+  default:
+    log_text(LOG_FATAL, "mysql_real_query() returned error %u (%s) for query "
+             "'%s'", error, mysql_error(con), query);
+    return -1;
+  }
+}
+
+
+/* Print per-server statistics, if there is more than one server */
+
+static void report_server_set(const mysql_server_set_t *set, double seconds)
+{
+  for (unsigned int i = 0; i < set->nservers; i++)
+  {
+    const mysql_server_t * const server = &set->servers[i];
+    const uint64_t queries = ck_pr_load_64(&server->queries);
+    const uint64_t time_ns = ck_pr_load_64(&server->time_ns);
+
+    if (server->socket != NULL)
+      log_text(LOG_NOTICE, "        %s %s:", set->name, server->socket);
+    else
+      log_text(LOG_NOTICE, "        %s %s:%u:", set->name, server->host,
+               server->port);
+
+    log_text(LOG_NOTICE, "            queries:                     %-6"
+             PRIu64 " (%.2f per sec.)", queries, queries / seconds);
+    log_text(LOG_NOTICE, "            avg time (ms):               %.2f",
+             queries > 0 ? NS2MS((double) time_ns) / queries : 0.0);
+    log_text(LOG_NOTICE, "            connections:                 %" PRIu64,
+             ck_pr_load_64(&server->connects));
+  }
+}
+
+
+/* Return a description of protocol compression settings for reports */
+
+static const char *compression_str(void)
+{
+  if (args.compression_algorithms != NULL)
+    return args.compression_algorithms;
+
+  return args.use_compression ? "on" : "off";
+}
+
+
+void mysql_drv_report_intermediate(sb_stat_t *stat)
+{
+  if (!args.net_stats)
+    return;
+
+  const double   seconds = stat->time_interval;
+  const uint64_t queries = stat->reads + stat->writes + stat->other;
+
+  log_timestamp(LOG_NOTICE, stat->time_total,
+                "net sent: %4.2f KiB/s (%.0f B/query) "
+                "received: %4.2f KiB/s (%.0f B/query)",
+                stat->net_sent / 1024.0 / seconds,
+                queries > 0 ? (double) stat->net_sent / queries : 0.0,
+                stat->net_received / 1024.0 / seconds,
+                queries > 0 ? (double) stat->net_received / queries : 0.0);
+}
+
+
+void mysql_drv_report_cumulative(sb_stat_t *stat)
+{
+  if (args.net_stats)
+  {
+    const double   seconds = stat->time_interval;
+    const uint64_t queries = stat->reads + stat->writes + stat->other;
+
+    log_text(LOG_NOTICE, "    network traffic (compression: %s):",
+             compression_str());
+    log_text(LOG_NOTICE, "        bytes sent:                      %-6" PRIu64
+             " (%.2f KiB/s, %.0f per query)", stat->net_sent,
+             stat->net_sent / 1024.0 / seconds,
+             queries > 0 ? (double) stat->net_sent / queries : 0.0);
+    log_text(LOG_NOTICE, "        bytes received:                  %-6" PRIu64
+             " (%.2f KiB/s, %.0f per query)", stat->net_received,
+             stat->net_received / 1024.0 / seconds,
+             queries > 0 ? (double) stat->net_received / queries : 0.0);
+  }
+
+#ifdef HAVE_MYSQL_SSL_SESSION
+  if (args.ssl_session_reuse)
+  {
+    const uint64_t full = ck_pr_load_64(&ssl_sessions_new);
+    const uint64_t reused = ck_pr_load_64(&ssl_sessions_reused);
+
+    log_text(LOG_NOTICE, "    TLS sessions:");
+    log_text(LOG_NOTICE, "        full handshakes:                 %-6" PRIu64
+             " (%.2f per sec.)", full, full / stat->time_interval);
+    log_text(LOG_NOTICE, "        resumed:                         %-6" PRIu64
+             " (%.2f per sec.)", reused, reused / stat->time_interval);
+  }
+#endif
+
+  if (!track_servers)
+    return;
+
+  log_text(LOG_NOTICE, "    per-server statistics:");
+
+  report_server_set(&primaries, stat->time_interval);
+  report_server_set(&replicas, stat->time_interval);
+}
+
+
 /* Uninitialize driver */
 int mysql_drv_done(void)
 {
@@ -1071,6 +2892,15 @@ int mysql_drv_done(void)
 
   mysql_library_end();
 
+  free(primaries.servers);
+  primaries.servers = NULL;
+  primaries.nservers = 0;
+  free(replicas.servers);
+  replicas.servers = NULL;
+  replicas.nservers = 0;
+  free(args.compression_algorithms);
+  args.compression_algorithms = NULL;
+
   return 0;
 }
 
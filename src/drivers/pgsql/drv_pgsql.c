@@ -26,8 +26,16 @@
 #ifdef HAVE_STRINGS_H
 # include <strings.h>
 #endif
+#include <ctype.h>
+#ifdef HAVE_POLL_H
+# include <poll.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
 
 #include <libpq-fe.h>
+#include <libpq-events.h>
 
 #include "sb_options.h"
 #include "db_driver.h"
@@ -38,26 +46,78 @@
 /* Maximum length of text representation of bind parameters */
 #define MAX_PARAM_LENGTH 256UL
 
+/* Cursor used with --db-fetch-size, only one is open on a connection */
+#define CURSOR_NAME "sbtest_cursor"
+#define CURSOR_DECLARE "DECLARE " CURSOR_NAME " NO SCROLL CURSOR FOR "
+
 /* PostgreSQL driver arguments */
 
 static sb_arg_t pgsql_drv_args[] =
 {
-  SB_OPT("pgsql-host", "PostgreSQL server host", "localhost", STRING),
-  SB_OPT("pgsql-port", "PostgreSQL server port", "5432", INT),
+  SB_OPT("pgsql-host", "PostgreSQL server host", "localhost", LIST),
+  SB_OPT("pgsql-port", "PostgreSQL server port", "5432", LIST),
   SB_OPT("pgsql-user", "PostgreSQL user", "sbtest", STRING),
   SB_OPT("pgsql-password", "PostgreSQL password", "", STRING),
   SB_OPT("pgsql-db", "PostgreSQL database name", "sbtest", STRING),
+  SB_OPT("pgsql-pipeline", "Use libpq pipeline mode to send statement groups "
+         "in a single round trip", "off", BOOL),
+  SB_OPT("pgsql-target-session-attrs", "libpq target_session_attrs, e.g. "
+         "read-write or standby. If specified, a connection falls back to the "
+         "remaining hosts when its own host does not match", NULL, STRING),
+  SB_OPT("pgsql-dry-run", "Dry run, pretend that all libpq calls are "
+         "successful without executing them, same as --db-dry-run", "off",
+         BOOL),
+  SB_OPT("pgsql-binary-params", "Send numeric and timestamp parameters of "
+         "prepared statements in binary format rather than as text", "off",
+         BOOL),
+  SB_OPT("pgsql-ps-mode", "How prepared statements are executed unless "
+         "--db-ps-mode=disable {named, unnamed, cache}. named prepares each "
+         "statement under its own name, unnamed sends the query with "
+         "parameters on each execution without preparing it (PQexecParams), "
+         "cache shares named statements with the same query on a connection "
+         "and keeps them after they are closed", "named", STRING),
+  SB_OPT("pgsql-stmt-cache-size", "Maximum number of statements per "
+         "connection with --pgsql-ps-mode=cache. The least recently used "
+         "closed statements are deallocated above it", "256", INT),
 
   SB_OPT_END
 };
 
+/* How server-side prepared statements are used, see --pgsql-ps-mode */
+
+typedef enum
+{
+  PS_MODE_NAMED,                /* PQprepare() once per statement */
+  PS_MODE_UNNAMED,              /* PQexecParams() on each execution */
+  PS_MODE_CACHE                 /* named statements shared via stmt_cache_t */
+} pgsql_ps_mode_t;
+
+static const char *ps_mode_names[] =
+{
+  "named", "unnamed", "cache", NULL
+};
+
+/* A host/port pair to connect to */
+
+typedef struct
+{
+  const char         *host;
+  const char         *port;
+  char               name[128]; /* host:port, used in logs */
+} pgsql_server_t;
+
 typedef struct
 {
-  char               *host;
-  char               *port;
+  pgsql_server_t     *servers;  /* all --pgsql-host x --pgsql-port pairs */
+  unsigned int       nservers;
+  char               *target_session_attrs;
   char               *user;
   char               *password;
   char               *db;
+  bool               pipeline;
+  bool               binary_params;
+  pgsql_ps_mode_t    ps_mode;
+  unsigned int       stmt_cache_size;
 } pgsql_drv_args_t;
 
 /* Structure used for DB-to-PgSQL bind types map */
@@ -81,6 +141,7 @@ db_pgsql_bind_map_t db_pgsql_bind_map[] =
   {DB_TYPE_TIMESTAMP, 1114},
   {DB_TYPE_CHAR,      18},
   {DB_TYPE_VARCHAR,   1043},
+  {DB_TYPE_BLOB,      0},       /* inferred by the server, e.g. bytea */
   {DB_TYPE_NONE,      0}
 };
 
@@ -96,6 +157,30 @@ static drv_caps_t pgsql_drv_caps =
   0,    /* unsigned int */
 };
 
+/*
+  A named statement in the cache of a connection with --pgsql-ps-mode=cache,
+  shared by all statements with the same query and parameter types
+*/
+typedef struct cached_stmt
+{
+  struct stmt_cache  *cache;    /* NULL once the connection is reset */
+  struct cached_stmt *next;
+  char               *query;
+  Oid                *ptypes;
+  int                nparams;
+  char               name[32];
+  unsigned int       refs;      /* statements using it */
+  uint64_t           last_used; /* cache clock at the last use */
+} cached_stmt_t;
+
+/* Statement cache attached to a PGconn as libpq event instance data */
+typedef struct stmt_cache
+{
+  cached_stmt_t      *head;
+  unsigned int       size;
+  uint64_t           clock;
+} stmt_cache_t;
+
 /* Describes the PostgreSQL prepared statement */
 typedef struct pg_stmt
 {
@@ -104,18 +189,31 @@ typedef struct pg_stmt
   int      nparams;
   Oid      *ptypes;
   char     **pvalues;
+  int      *plengths;   /* lengths of binary parameters */
+  int      *pformats;   /* 1 for binary parameters, see --pgsql-binary-params */
+  size_t   *psizes;     /* allocated sizes of pvalues of BLOB parameters */
+  char     *declare;    /* DECLARE CURSOR query, see --db-fetch-size */
+  cached_stmt_t *cached; /* shared statement with --pgsql-ps-mode=cache */
 } pg_stmt_t;
 
 static pgsql_drv_args_t args;          /* driver args */
 
 static char use_ps; /* whether server-side prepared statemens should be used */
 
+/* Server for the next connection, see pgsql_connect_next() */
+static uint32_t next_server;
+
+/* FETCH query of --db-fetch-size rows from the cursor */
+static char cursor_fetch_query[64];
+
 /* PgSQL driver operations */
 
 static int pgsql_drv_init(void);
 static int pgsql_drv_describe(drv_caps_t *);
 static int pgsql_drv_connect(db_conn_t *);
 static int pgsql_drv_disconnect(db_conn_t *);
+static int pgsql_drv_reconnect(db_conn_t *);
+static int pgsql_drv_reset(db_conn_t *);
 static int pgsql_drv_prepare(db_stmt_t *, const char *, size_t);
 static int pgsql_drv_bind_param(db_stmt_t *, db_bind_t *, size_t);
 static int pgsql_drv_bind_result(db_stmt_t *, db_bind_t *, size_t);
@@ -127,6 +225,16 @@ static db_error_t pgsql_drv_query(db_conn_t *, const char *, size_t,
 static int pgsql_drv_free_results(db_result_t *);
 static int pgsql_drv_close(db_stmt_t *);
 static int pgsql_drv_done(void);
+static db_error_t pgsql_single_row_result(db_conn_t *, const char *,
+                                          const char *, db_result_t *);
+static int pgsql_drv_copy_begin(db_conn_t *, const char *, size_t);
+static int pgsql_drv_copy_data(db_conn_t *, const char *, size_t);
+static int pgsql_drv_copy_end(db_conn_t *);
+#ifdef LIBPQ_HAS_PIPELINING
+static int pgsql_drv_pipeline_begin(db_conn_t *);
+static db_error_t pgsql_drv_pipeline_end(db_conn_t *);
+static db_error_t pgsql_drv_execute_batch(db_stmt_t *, db_result_t *);
+#endif
 
 /* PgSQL driver definition */
 
@@ -141,6 +249,8 @@ static db_driver_t pgsql_driver =
     .describe = pgsql_drv_describe,
     .connect = pgsql_drv_connect,
     .disconnect = pgsql_drv_disconnect,
+    .reconnect = pgsql_drv_reconnect,
+    .reset = pgsql_drv_reset,
     .prepare = pgsql_drv_prepare,
     .bind_param = pgsql_drv_bind_param,
     .bind_result = pgsql_drv_bind_result,
@@ -150,7 +260,15 @@ static db_driver_t pgsql_driver =
     .free_results = pgsql_drv_free_results,
     .close = pgsql_drv_close,
     .query = pgsql_drv_query,
-    .done = pgsql_drv_done
+    .done = pgsql_drv_done,
+    .copy_begin = pgsql_drv_copy_begin,
+    .copy_data = pgsql_drv_copy_data,
+    .copy_end = pgsql_drv_copy_end,
+#ifdef LIBPQ_HAS_PIPELINING
+    .pipeline_begin = pgsql_drv_pipeline_begin,
+    .pipeline_end = pgsql_drv_pipeline_end,
+    .execute_batch = pgsql_drv_execute_batch
+#endif
   }
 };
 
@@ -174,11 +292,83 @@ int register_driver_pgsql(sb_list_t *drivers)
 
 int pgsql_drv_init(void)
 {
-  args.host = sb_get_value_string("pgsql-host");
-  args.port = sb_get_value_string("pgsql-port");
+  sb_list_t      *hosts = sb_get_value_list("pgsql-host");
+  sb_list_t      *ports = sb_get_value_list("pgsql-port");
+  sb_list_item_t *hpos, *ppos;
+  unsigned int   nhosts = 0, nports = 0;
+
+  if (sb_get_value_flag("pgsql-dry-run"))
+  {
+    db_dry_run_driver(&pgsql_driver);
+    return 0;
+  }
+
+  snprintf(cursor_fetch_query, sizeof(cursor_fetch_query),
+           "FETCH FORWARD %u FROM " CURSOR_NAME, db_globals.fetch_size);
+
+  SB_LIST_FOR_EACH(hpos, hosts)
+    nhosts++;
+  SB_LIST_FOR_EACH(ppos, ports)
+    nports++;
+
+  if (nhosts == 0 || nports == 0)
+  {
+    log_text(LOG_FATAL, "No PostgreSQL hosts or ports specified, aborting");
+    return 1;
+  }
+
+  /* Distribute connections over each host with each port, like MySQL does */
+  args.nservers = nhosts * nports;
+  args.servers = calloc(args.nservers, sizeof(pgsql_server_t));
+  if (args.servers == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  pgsql_server_t *server = args.servers;
+
+  SB_LIST_FOR_EACH(hpos, hosts)
+  {
+    SB_LIST_FOR_EACH(ppos, ports)
+    {
+      server->host = SB_LIST_ENTRY(hpos, value_t, listitem)->data;
+      server->port = SB_LIST_ENTRY(ppos, value_t, listitem)->data;
+      snprintf(server->name, sizeof(server->name), "%s:%s", server->host,
+               server->port);
+      server++;
+    }
+  }
+
+  args.target_session_attrs =
+    sb_get_value_string("pgsql-target-session-attrs");
   args.user = sb_get_value_string("pgsql-user");
   args.password = sb_get_value_string("pgsql-password");
   args.db = sb_get_value_string("pgsql-db");
+  args.pipeline = sb_get_value_flag("pgsql-pipeline");
+  args.binary_params = sb_get_value_flag("pgsql-binary-params");
+  args.stmt_cache_size = sb_get_value_int("pgsql-stmt-cache-size");
+
+  const char  *s = sb_get_value_string("pgsql-ps-mode");
+  unsigned int i;
+
+  for (i = 0; ps_mode_names[i] != NULL; i++)
+    if (!strcmp(ps_mode_names[i], s))
+      break;
+  if (ps_mode_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for pgsql-ps-mode: %s", s);
+    return 1;
+  }
+  args.ps_mode = (pgsql_ps_mode_t) i;
+
+#ifndef LIBPQ_HAS_PIPELINING
+  if (args.pipeline)
+  {
+    log_text(LOG_FATAL, "--pgsql-pipeline requires libpq 14 or later");
+    return 1;
+  }
+#endif
 
   use_ps = 0;
   pgsql_drv_caps.prepared_statements = 1;
@@ -189,6 +379,137 @@ int pgsql_drv_init(void)
 }
 
 
+/*
+  Join the hosts or ports of all servers into a comma-separated list for libpq,
+  starting from a given one
+*/
+
+static char *join_servers(unsigned int first, bool ports)
+{
+  size_t       len = 0;
+  unsigned int i;
+  char         *buf, *p;
+
+  for (i = 0; i < args.nservers; i++)
+    len += strlen(ports ? args.servers[i].port : args.servers[i].host) + 1;
+
+  if ((buf = malloc(len)) == NULL)
+    return NULL;
+
+  for (i = 0, p = buf; i < args.nservers; i++)
+  {
+    const pgsql_server_t * const server =
+      &args.servers[(first + i) % args.nservers];
+    const char * const s = ports ? server->port : server->host;
+    const size_t       n = strlen(s);
+
+    memcpy(p, s, n);
+    p += n;
+    *p++ = ',';
+  }
+  p[-1] = '\0';
+
+  return buf;
+}
+
+
+/*
+  Connect to a given server. With --pgsql-target-session-attrs the other
+  servers are passed to libpq as well, so that it can move on to them if the
+  server is not in the requested state (e.g. is a standby after a failover).
+*/
+
+static PGconn *pgsql_connect_server(unsigned int n)
+{
+  const char *keywords[7];
+  const char *values[7];
+  char       *hosts = NULL;
+  char       *ports = NULL;
+  int        i = 0;
+  PGconn     *con;
+
+  keywords[i] = "host";
+  values[i++] = args.servers[n].host;
+  keywords[i] = "port";
+  values[i++] = args.servers[n].port;
+
+  if (args.target_session_attrs != NULL)
+  {
+    if (args.nservers > 1)
+    {
+      hosts = join_servers(n, false);
+      ports = join_servers(n, true);
+      if (hosts == NULL || ports == NULL)
+      {
+        log_text(LOG_FATAL, "Memory allocation failure");
+        free(hosts);
+        free(ports);
+        return NULL;
+      }
+      values[0] = hosts;
+      values[1] = ports;
+    }
+
+    keywords[i] = "target_session_attrs";
+    values[i++] = args.target_session_attrs;
+  }
+
+  keywords[i] = "dbname";
+  values[i++] = args.db;
+  keywords[i] = "user";
+  values[i++] = args.user;
+  keywords[i] = "password";
+  values[i++] = args.password;
+  keywords[i] = NULL;
+  values[i] = NULL;
+
+  /* Allow a connection string in --pgsql-db, as PQsetdbLogin() did */
+  con = PQconnectdbParams(keywords, values, 1);
+
+  free(hosts);
+  free(ports);
+
+  if (PQstatus(con) != CONNECTION_OK)
+  {
+    log_text(LOG_FATAL, "Connection to database failed: %s",
+             PQerrorMessage(con));
+    PQfinish(con);
+    return NULL;
+  }
+
+  db_socket_tune(PQsocket(con));
+
+  return con;
+}
+
+
+/*
+  Return the name of the server a connection is established to, which may
+  differ from the requested one with --pgsql-target-session-attrs
+*/
+
+static const char *pgsql_server_name(PGconn *con)
+{
+  const char * const host = PQhost(con);
+  const char * const port = PQport(con);
+
+  for (unsigned int i = 0; i < args.nservers; i++)
+    if (host != NULL && port != NULL && !strcmp(args.servers[i].host, host) &&
+        !strcmp(args.servers[i].port, port))
+      return args.servers[i].name;
+
+  return host;
+}
+
+
+/* Connect to the next server in turn */
+
+static PGconn *pgsql_connect_next(void)
+{
+  return pgsql_connect_server(ck_pr_faa_32(&next_server, 1) % args.nservers);
+}
+
+
 /* Describe database capabilities */
 
 
@@ -199,20 +520,9 @@ int pgsql_drv_describe(drv_caps_t *caps)
   *caps = pgsql_drv_caps;
 
   /* Determine the server version */
-  con = PQsetdbLogin(args.host,
-                     args.port,
-                     NULL,
-                     NULL,
-                     args.db,
-                     args.user,
-                     args.password);
-  if (PQstatus(con) != CONNECTION_OK)
-  {
-    log_text(LOG_FATAL, "Connection to database failed: %s",
-             PQerrorMessage(con));
-    PQfinish(con);
+  con = pgsql_connect_server(0);
+  if (con == NULL)
     return 1;
-  }
 
   /* Support for multi-row INSERTs is not available before 8.2 */
   if (PQserverVersion(con) < 80200)
@@ -229,172 +539,553 @@ static void empty_notice_processor(void *arg, const char *msg)
   (void) msg; /* unused */
 }
 
-/* Connect to database */
 
-int pgsql_drv_connect(db_conn_t *sb_conn)
+static void cached_stmt_free(cached_stmt_t *entry)
 {
-  PGconn *con;
+  free(entry->query);
+  free(entry->ptypes);
+  free(entry);
+}
 
-  con = PQsetdbLogin(args.host,
-                     args.port,
-                     NULL,
-                     NULL,
-                     args.db,
-                     args.user,
-                     args.password);
-  if (PQstatus(con) != CONNECTION_OK)
+
+/*
+  Forget all cached statements when they are deallocated on the server, i.e.
+  on session reset, reconnect or disconnect. Statements still in use keep
+  their entries until they are closed, but new ones are prepared again.
+*/
+
+static void stmt_cache_clear(stmt_cache_t *cache)
+{
+  cached_stmt_t *entry, *next;
+
+  if (cache == NULL)
+    return;
+
+  for (entry = cache->head; entry != NULL; entry = next)
   {
-    log_text(LOG_FATAL, "Connection to database failed: %s",
-             PQerrorMessage(con));
-    PQfinish(con);
-    return 1;
+    next = entry->next;
+
+    if (entry->refs == 0)
+      cached_stmt_free(entry);
+    else
+    {
+      entry->cache = NULL;
+      entry->next = NULL;
+    }
   }
 
-  /* Silence the default notice receiver spitting NOTICE message to stderr */
-  PQsetNoticeProcessor(con, empty_notice_processor, NULL);
-  sb_conn->ptr = con;
-  
-  return 0;
+  cache->head = NULL;
+  cache->size = 0;
 }
 
-/* Disconnect from database */
 
-int pgsql_drv_disconnect(db_conn_t *sb_conn)
+/* libpq event procedure managing the statement cache of a connection */
+
+static int stmt_cache_event(PGEventId id, void *info, void *pass_through)
 {
-  PGconn *con = (PGconn *)sb_conn->ptr;
+  stmt_cache_t *cache;
 
-  /* These might be allocated in pgsql_check_status() */
-  xfree(sb_conn->sql_state);
-  xfree(sb_conn->sql_errmsg);
+  (void) pass_through; /* unused */
 
-  if (con != NULL)
-    PQfinish(con);
+  switch (id) {
+  case PGEVT_REGISTER:
+    cache = calloc(1, sizeof(stmt_cache_t));
+    if (cache == NULL)
+      return 0;
+    return PQsetInstanceData(((PGEventRegister *) info)->conn,
+                             stmt_cache_event, cache);
 
-  return 0;
-}
+  case PGEVT_CONNRESET:
+    stmt_cache_clear(PQinstanceData(((PGEventConnReset *) info)->conn,
+                                    stmt_cache_event));
+    break;
 
+  case PGEVT_CONNDESTROY:
+    cache = PQinstanceData(((PGEventConnDestroy *) info)->conn,
+                           stmt_cache_event);
+    stmt_cache_clear(cache);
+    free(cache);
+    break;
 
-/* Prepare statement */
+  default:
+    break;
+  }
 
+  return 1;
+}
 
-int pgsql_drv_prepare(db_stmt_t *stmt, const char *query, size_t len)
-{
-  PGconn       *con = (PGconn *)stmt->connection->ptr;
-  PGresult     *pgres;
-  pg_stmt_t    *pgstmt;
-  char         *buf = NULL;
-  unsigned int vcnt;
-  unsigned int need_realloc;
-  unsigned int i,j;
-  unsigned int buflen;
-  int          n;
-  char         name[32];
 
-  (void) len; /* unused */
+/*
+  Deallocate the least recently used cached statement that is not used by any
+  statement. The cache grows over --pgsql-stmt-cache-size if there is none.
+*/
 
-  if (con == NULL)
-    return 1;
+static int stmt_cache_evict(PGconn *con, stmt_cache_t *cache)
+{
+  cached_stmt_t *entry, **pos, **lru = NULL;
+  PGresult      *pgres;
+  char          query[64];
+  int           rc = 0;
 
-  if (!use_ps)
-  {
-    /* Use client-side PS */
-    stmt->emulated = 1;
-    stmt->query = strdup(query);
+  for (pos = &cache->head; *pos != NULL; pos = &(*pos)->next)
+    if ((*pos)->refs == 0 && (lru == NULL || (*pos)->last_used <
+                              (*lru)->last_used))
+      lru = pos;
 
+  if (lru == NULL)
     return 0;
+
+  entry = *lru;
+  *lru = entry->next;
+  cache->size--;
+
+  snprintf(query, sizeof(query), "DEALLOCATE %s", entry->name);
+
+  pgres = PQexec(con, query);
+  if (PQresultStatus(pgres) != PGRES_COMMAND_OK)
+  {
+    log_text(LOG_FATAL, "DEALLOCATE failed: %s", PQerrorMessage(con));
+    rc = 1;
   }
+  PQclear(pgres);
 
-  /* Convert query to PgSQL-style named placeholders */
-  need_realloc = 1;
-  vcnt = 1;
-  buflen = 0;
-  for (i = 0, j = 0; query[i] != '\0'; i++)
+  cached_stmt_free(entry);
+
+  return rc;
+}
+
+
+/*
+  Find a cached statement with the same query and parameter types as a given
+  one or prepare a new one, and make the statement use it
+*/
+
+static int stmt_cache_acquire(PGconn *con, const char *query,
+                              pg_stmt_t *pgstmt)
+{
+  stmt_cache_t  *cache = PQinstanceData(con, stmt_cache_event);
+  cached_stmt_t *entry;
+  PGresult      *pgres;
+  const size_t  types_size = pgstmt->nparams * sizeof(Oid);
+
+  if (cache == NULL)
+    return 1;
+
+  for (entry = cache->head; entry != NULL; entry = entry->next)
+    if (entry->nparams == pgstmt->nparams && !strcmp(entry->query, query) &&
+        (types_size == 0 || !memcmp(entry->ptypes, pgstmt->ptypes,
+                                    types_size)))
+      break;
+
+  if (entry == NULL)
   {
-  again:
-    if (j+1 >= buflen || need_realloc)
-    {
-      buflen = (buflen > 0) ? buflen * 2 : 256;
-      buf = realloc(buf, buflen);
-      if (buf == NULL)
-        goto error;
-      need_realloc = 0;
-    }
+    if (cache->size >= args.stmt_cache_size && stmt_cache_evict(con, cache))
+      return 1;
 
-    if (query[i] != '?')
-    {
-      buf[j++] = query[i];
-      continue;
-    }
+    entry = calloc(1, sizeof(cached_stmt_t));
+    if (entry == NULL)
+      return 1;
 
-    n = snprintf(buf + j, buflen - j, "$%d", vcnt);
-    if (n < 0 || n >= (int)(buflen - j))
+    entry->query = strdup(query);
+    entry->nparams = pgstmt->nparams;
+    if (types_size > 0 && (entry->ptypes = malloc(types_size)) != NULL)
+      memcpy(entry->ptypes, pgstmt->ptypes, types_size);
+    if (entry->query == NULL || (types_size > 0 && entry->ptypes == NULL))
     {
-      need_realloc = 1;
-      goto again;
+      cached_stmt_free(entry);
+      return 1;
     }
 
-    j += n;
-    vcnt++;
-  }
-  buf[j] = '\0';
-
-  /* Store the query to be prepared later on the first bind_param call */
-  stmt->query = strdup(buf);
-  free(buf);
-  
-  pgstmt = (pg_stmt_t *)calloc(1, sizeof(pg_stmt_t));
-  if (pgstmt == NULL)
-    goto error;
-  /* Generate random statement name */
-  get_unique_stmt_name(name, sizeof(name));
-  pgstmt->name = strdup(name);
-  pgstmt->nparams = vcnt - 1;
+    get_unique_stmt_name(entry->name, sizeof(entry->name));
 
-  /*
-    Special keys for statements without parameters, since we don't need
-    to know the types of arguments, and no calls to bind_param() will be made
-  */
-  if (pgstmt->nparams == 0)
-  {
-    /* Do prepare */
-    pgres = PQprepare(con, pgstmt->name, stmt->query, pgstmt->nparams,
-                      NULL);
-    
+    pgres = PQprepare(con, entry->name, query, entry->nparams,
+                      entry->ptypes);
     if (PQresultStatus(pgres) != PGRES_COMMAND_OK)
     {
       log_text(LOG_FATAL, "PQprepare() failed: %s", PQerrorMessage(con));
-
       PQclear(pgres);
-
-      free(stmt->query);
-      free(pgstmt->name);
-      free(pgstmt);
-
+      cached_stmt_free(entry);
       return 1;
     }
     PQclear(pgres);
-    pgstmt->prepared = 1;
+
+    entry->cache = cache;
+    entry->next = cache->head;
+    cache->head = entry;
+    cache->size++;
   }
 
-  stmt->ptr = pgstmt;
-  
-  return 0;
+  free(pgstmt->name);
+  pgstmt->name = strdup(entry->name);
+  if (pgstmt->name == NULL)
+    return 1;
 
- error:
+  entry->refs++;
+  entry->last_used = ++cache->clock;
+  pgstmt->cached = entry;
 
-  return 1;
+  return 0;
 }
 
 
-/* Bind parameters for prepared statement */
+/* Stop using a cached statement when a statement is closed */
+
+static void stmt_cache_release(cached_stmt_t *entry)
+{
+  entry->refs--;
+
+  if (entry->cache != NULL)
+    entry->last_used = ++entry->cache->clock;
+  else if (entry->refs == 0)
+    cached_stmt_free(entry);
+}
+
+
+/* Connect to database */
+
+int pgsql_drv_connect(db_conn_t *sb_conn)
+{
+  PGconn *con;
+
+  con = pgsql_connect_next();
+  if (con == NULL)
+    return 1;
+
+  /* Silence the default notice receiver spitting NOTICE message to stderr */
+  PQsetNoticeProcessor(con, empty_notice_processor, NULL);
+
+  if (args.ps_mode == PS_MODE_CACHE &&
+      !PQregisterEventProc(con, stmt_cache_event, "sysbench", NULL))
+  {
+    log_text(LOG_FATAL, "PQregisterEventProc() failed");
+    PQfinish(con);
+    return 1;
+  }
+
+  sb_conn->ptr = con;
+  sb_conn->server = pgsql_server_name(con);
+
+  return 0;
+}
+
+/* Disconnect from database */
+
+int pgsql_drv_disconnect(db_conn_t *sb_conn)
+{
+  PGconn *con = (PGconn *)sb_conn->ptr;
+
+  /* These might be allocated in pgsql_check_status() */
+  xfree(sb_conn->sql_state);
+  xfree(sb_conn->sql_errmsg);
+
+  if (con != NULL)
+    PQfinish(con);
+
+  return 0;
+}
+
+/* Reestablish the connection to the same server */
+
+int pgsql_drv_reconnect(db_conn_t *sb_conn)
+{
+  PGconn *con = (PGconn *)sb_conn->ptr;
+
+  PQreset(con);
+
+  if (PQstatus(con) != CONNECTION_OK)
+  {
+    log_text(LOG_FATAL, "Connection to database failed: %s",
+             PQerrorMessage(con));
+    return DB_ERROR_FATAL;
+  }
+
+  db_socket_tune(PQsocket(con));
+
+  sb_conn->server = pgsql_server_name(con);
+
+  return DB_ERROR_IGNORABLE;
+}
+
+/*
+  Reset session state with DISCARD ALL, which also deallocates server-side
+  prepared statements, so the statement cache starts over
+*/
+
+int pgsql_drv_reset(db_conn_t *sb_conn)
+{
+  PGconn   *con = (PGconn *)sb_conn->ptr;
+  PGresult *pgres;
+  int      rc = 0;
+
+  pgres = PQexec(con, "DISCARD ALL");
+  if (PQresultStatus(pgres) != PGRES_COMMAND_OK)
+  {
+    log_text(LOG_FATAL, "DISCARD ALL failed: %s", PQerrorMessage(con));
+    rc = 1;
+  }
+  PQclear(pgres);
+
+  if (args.ps_mode == PS_MODE_CACHE)
+    stmt_cache_clear(PQinstanceData(con, stmt_cache_event));
+
+  return rc;
+}
+
+
+/* Check if a query is a SELECT, i.e. can be executed with a cursor */
+
+static bool query_is_select(const char *query)
+{
+  while (isspace((unsigned char) *query) || *query == '(')
+    query++;
+
+  return !strncasecmp(query, "SELECT", 6);
+}
+
+
+/*
+  Create a server-side statement for a query with known parameter types
+  according to --pgsql-ps-mode. Unnamed statements are parsed on each
+  execution instead.
+*/
+
+static int pgsql_prepare_stmt(PGconn *con, const char *query,
+                              pg_stmt_t *pgstmt)
+{
+  PGresult *pgres;
+
+  if (args.ps_mode == PS_MODE_UNNAMED)
+    return 0;
+
+  if (args.ps_mode == PS_MODE_CACHE)
+    return stmt_cache_acquire(con, query, pgstmt);
+
+  pgres = PQprepare(con, pgstmt->name, query, pgstmt->nparams,
+                    pgstmt->ptypes);
+  if (PQresultStatus(pgres) != PGRES_COMMAND_OK)
+  {
+    log_text(LOG_FATAL, "PQprepare() failed: %s", PQerrorMessage(con));
+    PQclear(pgres);
+    return 1;
+  }
+  PQclear(pgres);
+
+  return 0;
+}
+
+
+/* Prepare statement */
+
+
+int pgsql_drv_prepare(db_stmt_t *stmt, const char *query, size_t len)
+{
+  PGconn       *con = (PGconn *)stmt->connection->ptr;
+  pg_stmt_t    *pgstmt;
+  char         *buf = NULL;
+  unsigned int vcnt;
+  unsigned int need_realloc;
+  unsigned int i,j;
+  unsigned int buflen;
+  int          n;
+  char         name[32];
+
+  (void) len; /* unused */
+
+  if (con == NULL)
+    return 1;
+
+  if (!use_ps)
+  {
+    /* Use client-side PS */
+    stmt->emulated = 1;
+    stmt->query = strdup(query);
+
+    return 0;
+  }
+
+  /* Convert query to PgSQL-style named placeholders */
+  need_realloc = 1;
+  vcnt = 1;
+  buflen = 0;
+  for (i = 0, j = 0; query[i] != '\0'; i++)
+  {
+  again:
+    if (j+1 >= buflen || need_realloc)
+    {
+      buflen = (buflen > 0) ? buflen * 2 : 256;
+      buf = realloc(buf, buflen);
+      if (buf == NULL)
+        goto error;
+      need_realloc = 0;
+    }
+
+    if (query[i] != '?')
+    {
+      buf[j++] = query[i];
+      continue;
+    }
+
+    n = snprintf(buf + j, buflen - j, "$%d", vcnt);
+    if (n < 0 || n >= (int)(buflen - j))
+    {
+      need_realloc = 1;
+      goto again;
+    }
+
+    j += n;
+    vcnt++;
+  }
+  buf[j] = '\0';
+
+  /* Store the query to be prepared later on the first bind_param call */
+  stmt->query = strdup(buf);
+  free(buf);
+  
+  pgstmt = (pg_stmt_t *)calloc(1, sizeof(pg_stmt_t));
+  if (pgstmt == NULL)
+    goto error;
+
+  if (db_globals.fetch_size > 0 && query_is_select(stmt->query))
+  {
+    pgstmt->declare = malloc(strlen(stmt->query) + sizeof(CURSOR_DECLARE));
+    if (pgstmt->declare == NULL)
+      goto error;
+    strcpy(pgstmt->declare, CURSOR_DECLARE);
+    strcat(pgstmt->declare, stmt->query);
+  }
+  /* Generate random statement name */
+  get_unique_stmt_name(name, sizeof(name));
+  pgstmt->name = strdup(name);
+  pgstmt->nparams = vcnt - 1;
+
+  /*
+    Special keys for statements without parameters, since we don't need
+    to know the types of arguments, and no calls to bind_param() will be made
+  */
+  if (pgstmt->nparams == 0)
+  {
+    if (pgsql_prepare_stmt(con, stmt->query, pgstmt))
+    {
+      free(stmt->query);
+      free(pgstmt->name);
+      free(pgstmt);
+
+      return 1;
+    }
+    pgstmt->prepared = 1;
+  }
+
+  stmt->ptr = pgstmt;
+  
+  return 0;
+
+ error:
+
+  return 1;
+}
+
+
+/* Check if parameters of a given type are sent in binary format */
+
+static bool pgsql_binary_type(db_bind_type_t type)
+{
+  switch (type) {
+  case DB_TYPE_SMALLINT:
+  case DB_TYPE_INT:
+  case DB_TYPE_BIGINT:
+  case DB_TYPE_FLOAT:
+  case DB_TYPE_DOUBLE:
+  case DB_TYPE_TIMESTAMP:
+    return true;
+  default:
+    return false;
+  }
+}
+
+
+/* Store the lowest 'len' bytes of a value in network byte order */
+
+static void store_be(char *buf, uint64_t value, int len)
+{
+  for (int i = len - 1; i >= 0; i--)
+  {
+    buf[i] = (char) (value & 0xff);
+    value >>= 8;
+  }
+}
+
+
+/* Number of days from 1970-01-01 to a given date in the Gregorian calendar */
+
+static int64_t days_from_civil(int64_t y, int m, int d)
+{
+  y -= m <= 2;
+
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const int64_t yoe = y - era * 400;
+  const int64_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+  return era * 146097 + doe - 719468;
+}
+
+
+/*
+  Convert a parameter to the binary format of its PostgreSQL type, see
+  pgsql_binary_type(). Returns the length of the value.
+*/
+
+static int pgsql_binary_value(const db_bind_t *param, char *buf)
+{
+  const db_time_t *tm;
+  uint32_t        u32;
+  uint64_t        u64;
+  float           f;
+  double          d;
+
+  switch (param->type) {
+  case DB_TYPE_SMALLINT:
+    store_be(buf, (uint16_t) *(short *) param->buffer, 2);
+    return 2;
+  case DB_TYPE_INT:
+    store_be(buf, (uint32_t) *(int *) param->buffer, 4);
+    return 4;
+  case DB_TYPE_BIGINT:
+    store_be(buf, (uint64_t) *(long long *) param->buffer, 8);
+    return 8;
+  case DB_TYPE_FLOAT:
+    f = *(float *) param->buffer;
+    memcpy(&u32, &f, sizeof(u32));
+    store_be(buf, u32, 4);
+    return 4;
+  case DB_TYPE_DOUBLE:
+    d = *(double *) param->buffer;
+    memcpy(&u64, &d, sizeof(u64));
+    store_be(buf, u64, 8);
+    return 8;
+  case DB_TYPE_TIMESTAMP:
+    /* Microseconds since 2000-01-01 00:00:00 */
+    tm = (const db_time_t *) param->buffer;
+    u64 = (uint64_t)
+      (((days_from_civil(tm->year, tm->month, tm->day) - 10957) * 86400 +
+        tm->hour * 3600 + tm->minute * 60 + tm->second) * 1000000);
+    store_be(buf, u64, 8);
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+
+/* Bind parameters for prepared statement */
 
 
 int pgsql_drv_bind_param(db_stmt_t *stmt, db_bind_t *params, size_t len)
 {
   PGconn       *con = (PGconn *)stmt->connection->ptr;
-  PGresult     *pgres;
   pg_stmt_t    *pgstmt;
   unsigned int i;
+  bool         has_blobs = false;
   
   if (con == NULL)
     return 1;
@@ -432,21 +1123,31 @@ int pgsql_drv_bind_param(db_stmt_t *stmt, db_bind_t *params, size_t len)
   for (i = 0; i < len; i++)
     pgstmt->ptypes[i] = get_pgsql_bind_type(params[i].type);
 
-  /* Do prepare */
-  pgres = PQprepare(con, pgstmt->name, stmt->query, pgstmt->nparams,
-                    pgstmt->ptypes);
-
-  if (PQresultStatus(pgres) != PGRES_COMMAND_OK)
-  {
-    log_text(LOG_FATAL, "PQprepare() failed: %s", PQerrorMessage(con));
+  if (pgsql_prepare_stmt(con, stmt->query, pgstmt))
     return 1;
-  }
-
-  PQclear(pgres);
 
   pgstmt->pvalues = (char **)calloc(len, sizeof(char *));
   if (pgstmt->pvalues == NULL)
     return 1;
+
+  for (i = 0; i < len; i++)
+    has_blobs |= params[i].type == DB_TYPE_BLOB;
+
+  /* BLOB values are always sent in binary format, i.e. as is */
+  if (args.binary_params || has_blobs)
+  {
+    pgstmt->plengths = (int *)calloc(len, sizeof(int));
+    pgstmt->pformats = (int *)calloc(len, sizeof(int));
+    if (pgstmt->plengths == NULL || pgstmt->pformats == NULL)
+      return 1;
+
+    for (i = 0; i < len; i++)
+      pgstmt->pformats[i] = params[i].type == DB_TYPE_BLOB ||
+        (args.binary_params && pgsql_binary_type(params[i].type));
+  }
+
+  if (has_blobs && (pgstmt->psizes = calloc(len, sizeof(size_t))) == NULL)
+    return 1;
       
   /* Allocate buffers for bind parameters */
   for (i = 0; i < len; i++)
@@ -456,6 +1157,10 @@ int pgsql_drv_bind_param(db_stmt_t *stmt, db_bind_t *params, size_t len)
       free(pgstmt->pvalues[i]);
     }
 
+    /* Buffers of BLOB values are allocated by pgsql_blob_value() */
+    if (params[i].type == DB_TYPE_BLOB)
+      continue;
+
     pgstmt->pvalues[i] = (char *)malloc(MAX_PARAM_LENGTH);
     if (pgstmt->pvalues[i] == NULL)
       return 1;
@@ -466,6 +1171,42 @@ int pgsql_drv_bind_param(db_stmt_t *stmt, db_bind_t *params, size_t len)
 }
 
 
+/*
+  Generate the value of a BLOB parameter of a given length. libpq needs
+  complete parameter values, so the value is generated into a buffer kept
+  with the statement rather than sent in parts.
+*/
+
+static int pgsql_blob_value(pg_stmt_t *pgstmt, unsigned int i, size_t len)
+{
+  if (len > INT_MAX)
+  {
+    log_text(LOG_FATAL, "BLOB parameter is too long: %zu", len);
+    return 1;
+  }
+
+  if (pgstmt->psizes[i] < len || pgstmt->pvalues[i] == NULL)
+  {
+    const size_t size = len > 0 ? len : 1;
+    char * const buf = realloc(pgstmt->pvalues[i], size);
+
+    if (buf == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+
+    pgstmt->pvalues[i] = buf;
+    pgstmt->psizes[i] = size;
+  }
+
+  db_blob_fill(pgstmt->pvalues[i], len);
+  pgstmt->plengths[i] = (int) len;
+
+  return 0;
+}
+
+
 /* Bind results for prepared statement */
 
 
@@ -534,9 +1275,16 @@ static db_error_t pgsql_check_status(db_conn_t *con, PGresult *pgres,
         !strcmp(con->sql_state, "23505") /* unique violation */ ||
         !strcmp(con->sql_state, "40001"))/* serialization_failure */
     {
-      PGresult *tmp;
-      tmp = PQexec(pgcon, "ROLLBACK");
-      PQclear(tmp);
+      /*
+        Synchronous queries are not allowed in pipeline mode,
+        pgsql_drv_pipeline_end() rolls back after leaving it
+      */
+      if (con->state != DB_CONN_PIPELINE)
+      {
+        PGresult *tmp;
+        tmp = PQexec(pgcon, "ROLLBACK");
+        PQclear(tmp);
+      }
       rc = DB_ERROR_IGNORABLE;
     }
     else
@@ -564,134 +1312,480 @@ static db_error_t pgsql_check_status(db_conn_t *con, PGresult *pgres,
 }
 
 
-/* Execute prepared statement */
-
+/*
+  Wait for the results of a query sent with PQsend*() and return the last one,
+  like PQexec() does. Used with --db-latency-split to mark the arrival of the
+  first result packet, which PQexec() does not expose.
+*/
+
+static PGresult *pgsql_exec_result(db_conn_t *con)
+{
+  PGconn * const pgcon = con->ptr;
+  PGresult       *pgres;
+  PGresult       *last = NULL;
+  struct pollfd  pfd = { .fd = PQsocket(pgcon), .events = POLLIN };
+
+  while (PQisBusy(pgcon))
+  {
+    if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+      break;
+
+    db_first_result(con);
+
+    if (!PQconsumeInput(pgcon))
+      break;
+  }
+
+  db_first_result(con);
+
+  while ((pgres = PQgetResult(pgcon)) != NULL)
+  {
+    PQclear(last);
+    last = pgres;
+
+    /* PQgetResult() keeps returning the same COPY state */
+    if (PQresultStatus(pgres) == PGRES_COPY_IN ||
+        PQresultStatus(pgres) == PGRES_COPY_OUT ||
+        PQresultStatus(pgres) == PGRES_COPY_BOTH)
+      break;
+  }
+
+  return last;
+}
+
+
+/*
+  Execute a SELECT statement with a cursor and drop its rows, see
+  --db-fetch-size. Cursors only exist in transaction blocks, so a statement
+  executed outside of one gets its own transaction.
+*/
+
+static db_error_t pgsql_cursor_execute(db_conn_t *con, db_stmt_t *stmt,
+                                       db_result_t *rs)
+{
+  PGconn * const    pgcon = con->ptr;
+  pg_stmt_t * const pgstmt = stmt->ptr;
+  const bool        own_txn = PQtransactionStatus(pgcon) == PQTRANS_IDLE;
+  struct timespec   start;
+  struct timespec   first;
+  struct timespec   end;
+  uint64_t          rows = 0;
+  PGresult          *pgres;
+  db_error_t        rc;
+
+  SB_GETTIME(&start);
+
+  if (own_txn &&
+      (rc = pgsql_check_status(con, PQexec(pgcon, "BEGIN"), "PQexec",
+                               "BEGIN", rs)) != DB_ERROR_NONE)
+    return rc;
+
+  pgres = PQexecParams(pgcon, pgstmt->declare, pgstmt->nparams,
+                       pgstmt->ptypes, (const char **) pgstmt->pvalues,
+                       pgstmt->plengths, pgstmt->pformats, 0);
+  rc = pgsql_check_status(con, pgres, "PQexecParams", pgstmt->declare, rs);
+  if (rc != DB_ERROR_NONE)
+    goto error;
+
+  for (;;)
+  {
+    pgres = PQexec(pgcon, cursor_fetch_query);
+    if (PQresultStatus(pgres) != PGRES_TUPLES_OK)
+    {
+      rc = pgsql_check_status(con, pgres, "PQexec", cursor_fetch_query, rs);
+      goto error;
+    }
+
+    const unsigned int n = (unsigned int) PQntuples(pgres);
+    PQclear(pgres);
+    db_first_result(con);
+
+    if (rows == 0 && n > 0)
+      SB_GETTIME(&first);
+    rows += n;
+
+    if (n < db_globals.fetch_size)
+      break;
+  }
+
+  SB_GETTIME(&end);
+
+  if (rows == 0)
+    first = end;
+
+  /* Committing closes the cursor as well */
+  rc = pgsql_check_status(con, PQexec(pgcon, own_txn ? "COMMIT" :
+                                      "CLOSE " CURSOR_NAME), "PQexec",
+                          own_txn ? "COMMIT" : "CLOSE " CURSOR_NAME, rs);
+  if (rc != DB_ERROR_NONE)
+    return rc;
+
+  db_cursor_stats_add(con, TIMESPEC_DIFF(first, start),
+                      TIMESPEC_DIFF(end, start), rows);
+
+  rs->counter = SB_CNT_READ;
+  rs->nrows = 0;
+  rs->nfields = 0;
+  rs->ptr = NULL;
+
+  return DB_ERROR_NONE;
+
+ error:
+  /* Ignorable errors are rolled back by pgsql_check_status() */
+  if (own_txn && rc == DB_ERROR_FATAL)
+    PQclear(PQexec(pgcon, "ROLLBACK"));
+
+  return rc;
+}
+
+
+/* Execute prepared statement */
+
+
+/* libpq functions used to execute prepared statements, for error messages */
+
+static const char *send_func_name(void)
+{
+  return args.ps_mode == PS_MODE_UNNAMED ?
+    "PQsendQueryParams" : "PQsendQueryPrepared";
+}
+
+static const char *exec_func_name(void)
+{
+  return args.ps_mode == PS_MODE_UNNAMED ? "PQexecParams" : "PQexecPrepared";
+}
+
+
+/* Send a prepared statement with its current parameter values */
+
+static int pgsql_send_stmt(PGconn *pgcon, db_stmt_t *stmt)
+{
+  const pg_stmt_t *pgstmt = stmt->ptr;
+
+  if (args.ps_mode == PS_MODE_UNNAMED)
+    return PQsendQueryParams(pgcon, stmt->query, pgstmt->nparams,
+                             pgstmt->ptypes, (const char **)pgstmt->pvalues,
+                             pgstmt->plengths, pgstmt->pformats, 1);
+
+  return PQsendQueryPrepared(pgcon, pgstmt->name, pgstmt->nparams,
+                             (const char **)pgstmt->pvalues,
+                             pgstmt->plengths, pgstmt->pformats, 1);
+}
+
+
+/* Execute a prepared statement with its current parameter values */
+
+static PGresult *pgsql_exec_stmt(PGconn *pgcon, db_stmt_t *stmt)
+{
+  const pg_stmt_t *pgstmt = stmt->ptr;
+
+  if (args.ps_mode == PS_MODE_UNNAMED)
+    return PQexecParams(pgcon, stmt->query, pgstmt->nparams, pgstmt->ptypes,
+                        (const char **)pgstmt->pvalues, pgstmt->plengths,
+                        pgstmt->pformats, 1);
+
+  return PQexecPrepared(pgcon, pgstmt->name, pgstmt->nparams,
+                        (const char **)pgstmt->pvalues, pgstmt->plengths,
+                        pgstmt->pformats, 1);
+}
+
+
+db_error_t pgsql_drv_execute(db_stmt_t *stmt, db_result_t *rs)
+{
+  db_conn_t       *con = stmt->connection;
+  PGconn          *pgcon = (PGconn *)con->ptr;
+  PGresult        *pgres;
+  pg_stmt_t       *pgstmt;
+  unsigned int    i;
+  db_error_t      rc;
+  unsigned long   len;
+
+  con->sql_errno = 0;
+  xfree(con->sql_state);
+  xfree(con->sql_errmsg);
+
+  if (!stmt->emulated)
+  {
+    pgstmt = stmt->ptr;
+    if (pgstmt == NULL)
+    {
+      log_text(LOG_DEBUG,
+               "ERROR: exiting mysql_drv_execute(), uninitialized statement");
+      return DB_ERROR_FATAL;
+    }
+
+    /* Convert sysbench bind structures to PgSQL data */
+    for (i = 0; i < (unsigned)pgstmt->nparams; i++)
+    {
+      if (stmt->bound_param[i].is_null && *(stmt->bound_param[i].is_null))
+        continue;
+
+      if (stmt->bound_param[i].type == DB_TYPE_BLOB)
+      {
+        if (pgsql_blob_value(pgstmt, i, stmt->bound_param[i].data_len[0]))
+          return DB_ERROR_FATAL;
+        continue;
+      }
+
+      if (pgstmt->pformats != NULL && pgstmt->pformats[i])
+      {
+        pgstmt->plengths[i] = pgsql_binary_value(stmt->bound_param + i,
+                                                 pgstmt->pvalues[i]);
+        continue;
+      }
+
+      switch (stmt->bound_param[i].type) {
+        case DB_TYPE_CHAR:
+        case DB_TYPE_VARCHAR:
+
+          len = stmt->bound_param[i].data_len[0];
+
+          memcpy(pgstmt->pvalues[i], stmt->bound_param[i].buffer,
+                 SB_MIN(MAX_PARAM_LENGTH, len));
+          /* PostgreSQL requires a zero-terminated string */
+          pgstmt->pvalues[i][len] = '\0';
+
+          break;
+        default:
+          db_print_value(stmt->bound_param + i, pgstmt->pvalues[i],
+                         MAX_PARAM_LENGTH);
+      }
+    }
+
+    if (pgstmt->declare != NULL && con->state != DB_CONN_PIPELINE)
+      return pgsql_cursor_execute(con, stmt, rs);
+
+#ifdef LIBPQ_HAS_PIPELINING
+    if (con->state == DB_CONN_PIPELINE)
+    {
+      /* Parameter values are copied to the output buffer right away */
+      if (!pgsql_send_stmt(pgcon, stmt))
+      {
+        log_text(LOG_FATAL, "%s() failed: %s", send_func_name(),
+                 PQerrorMessage(pgcon));
+        return DB_ERROR_FATAL;
+      }
+
+      return DB_ERROR_NONE;
+    }
+#endif
+
+    if (db_globals.result_mode != DB_RESULT_MODE_STORE)
+    {
+      if (!pgsql_send_stmt(pgcon, stmt))
+      {
+        log_text(LOG_FATAL, "%s() failed: %s", send_func_name(),
+                 PQerrorMessage(pgcon));
+        return DB_ERROR_FATAL;
+      }
+
+      return pgsql_single_row_result(con, send_func_name(), NULL, rs);
+    }
+
+    if (db_globals.latency_split)
+    {
+      if (!pgsql_send_stmt(pgcon, stmt))
+      {
+        log_text(LOG_FATAL, "%s() failed: %s", send_func_name(),
+                 PQerrorMessage(pgcon));
+        return DB_ERROR_FATAL;
+      }
+
+      pgres = pgsql_exec_result(con);
+    }
+    else
+      pgres = pgsql_exec_stmt(pgcon, stmt);
+
+    rc = pgsql_check_status(con, pgres, exec_func_name(), NULL, rs);
+
+    rs->ptr = (rs->counter == SB_CNT_READ) ? (void *) pgres : NULL;
+
+    return rc;
+  }
+
+  /* Use emulation */
+  unsigned int query_len;
+  const char   *query = db_print_query(stmt, &query_len);
+
+  if (query == NULL)
+    return DB_ERROR_FATAL;
+
+  return pgsql_drv_query(con, query, query_len, rs);
+}
+
+
+/* Execute SQL query */
+
+
+db_error_t pgsql_drv_query(db_conn_t *sb_conn, const char *query, size_t len,
+                           db_result_t *rs)
+{
+  PGconn         *pgcon = sb_conn->ptr;
+  PGresult       *pgres;
+  db_error_t     rc;
+
+  (void)len; /* unused */
+
+  sb_conn->sql_errno = 0;
+  xfree(sb_conn->sql_state);
+  xfree(sb_conn->sql_errmsg);
+
+#ifdef LIBPQ_HAS_PIPELINING
+  /* PQsendQuery() cannot be used in pipeline mode */
+  if (sb_conn->state == DB_CONN_PIPELINE)
+  {
+    if (!PQsendQueryParams(pgcon, query, 0, NULL, NULL, NULL, NULL, 0))
+    {
+      log_text(LOG_FATAL, "PQsendQueryParams() failed: %s",
+               PQerrorMessage(pgcon));
+      log_text(LOG_FATAL, "failed query was: %s", query);
+      return DB_ERROR_FATAL;
+    }
+
+    return DB_ERROR_NONE;
+  }
+#endif
+
+  if (db_globals.result_mode != DB_RESULT_MODE_STORE)
+  {
+    if (!PQsendQuery(pgcon, query))
+    {
+      log_text(LOG_FATAL, "PQsendQuery() failed: %s", PQerrorMessage(pgcon));
+      log_text(LOG_FATAL, "failed query was: %s", query);
+      return DB_ERROR_FATAL;
+    }
+
+    return pgsql_single_row_result(sb_conn, "PQsendQuery", query, rs);
+  }
+
+  if (db_globals.latency_split)
+  {
+    if (!PQsendQuery(pgcon, query))
+    {
+      log_text(LOG_FATAL, "PQsendQuery() failed: %s", PQerrorMessage(pgcon));
+      log_text(LOG_FATAL, "failed query was: %s", query);
+      return DB_ERROR_FATAL;
+    }
+
+    pgres = pgsql_exec_result(sb_conn);
+  }
+  else
+    pgres = PQexec(pgcon, query);
+
+  rc = pgsql_check_status(sb_conn, pgres, "PQexec", query, rs);
+
+  rs->ptr = (rs->counter == SB_CNT_READ) ? (void *) pgres : NULL;
+
+  return rc;
+}
+
+
+/* Read and drop the remaining results of a query */
 
-db_error_t pgsql_drv_execute(db_stmt_t *stmt, db_result_t *rs)
+static void pgsql_drain_results(PGconn *pgcon)
 {
-  db_conn_t       *con = stmt->connection;
-  PGconn          *pgcon = (PGconn *)con->ptr;
-  PGresult        *pgres;
-  pg_stmt_t       *pgstmt;
-  char            *buf = NULL;
-  unsigned int    buflen = 0;
-  unsigned int    i, j, vcnt;
-  char            need_realloc;
-  int             n;
-  db_error_t      rc;
-  unsigned long   len;
+  PGresult *pgres;
 
-  con->sql_errno = 0;
-  xfree(con->sql_state);
-  xfree(con->sql_errmsg);
-
-  if (!stmt->emulated)
-  {
-    pgstmt = stmt->ptr;
-    if (pgstmt == NULL)
-    {
-      log_text(LOG_DEBUG,
-               "ERROR: exiting mysql_drv_execute(), uninitialized statement");
-      return DB_ERROR_FATAL;
-    }
+  while ((pgres = PQgetResult(pgcon)) != NULL)
+    PQclear(pgres);
+}
 
-    /* Convert sysbench bind structures to PgSQL data */
-    for (i = 0; i < (unsigned)pgstmt->nparams; i++)
-    {
-      if (stmt->bound_param[i].is_null && *(stmt->bound_param[i].is_null))
-        continue;
 
-      switch (stmt->bound_param[i].type) {
-        case DB_TYPE_CHAR:
-        case DB_TYPE_VARCHAR:
+/*
+  Get the result of a query sent with PQsendQuery*() in single-row mode, which
+  is used for --db-result-mode=stream and --db-result-mode=discard. Rows come
+  as separate PGresult objects, so a streamed result set only keeps the current
+  row, and rs->nrows is the number of rows read so far.
+*/
 
-          len = stmt->bound_param[i].data_len[0];
+static db_error_t pgsql_single_row_result(db_conn_t *con,
+                                          const char *funcname,
+                                          const char *query, db_result_t *rs)
+{
+  PGconn * const pgcon = con->ptr;
+  PGresult       *pgres;
 
-          memcpy(pgstmt->pvalues[i], stmt->bound_param[i].buffer,
-                 SB_MIN(MAX_PARAM_LENGTH, len));
-          /* PostgreSQL requires a zero-terminated string */
-          pgstmt->pvalues[i][len] = '\0';
+  if (!PQsetSingleRowMode(pgcon))
+    log_text(LOG_DEBUG, "PQsetSingleRowMode() failed");
 
-          break;
-        default:
-          db_print_value(stmt->bound_param + i, pgstmt->pvalues[i],
-                         MAX_PARAM_LENGTH);
-      }
-    }
+  pgres = PQgetResult(pgcon);
+  db_first_result(con);
 
-    pgres = PQexecPrepared(pgcon, pgstmt->name, pgstmt->nparams,
-                           (const char **)pgstmt->pvalues, NULL, NULL, 1);
+  if (PQresultStatus(pgres) != PGRES_SINGLE_TUPLE)
+  {
+    /* Not a result set, an empty result set or an error */
+    pgsql_drain_results(pgcon);
 
-    rc = pgsql_check_status(con, pgres, "PQexecPrepared", NULL, rs);
+    const db_error_t rc = pgsql_check_status(con, pgres, funcname, query, rs);
 
     rs->ptr = (rs->counter == SB_CNT_READ) ? (void *) pgres : NULL;
 
     return rc;
   }
 
-  /* Use emulation */
-  /* Build the actual query string from parameters list */
-  need_realloc = 1;
-  vcnt = 0;
-  for (i = 0, j = 0; stmt->query[i] != '\0'; i++)
+  rs->counter = SB_CNT_READ;
+  rs->nfields = PQnfields(pgres);
+  rs->nrows = 1;
+
+  if (db_globals.result_mode == DB_RESULT_MODE_STREAM)
   {
-  again:
-    if (j+1 >= buflen || need_realloc)
-    {
-      buflen = (buflen > 0) ? buflen * 2 : 256;
-      buf = realloc(buf, buflen);
-      if (buf == NULL)
-        return DB_ERROR_FATAL;
-      need_realloc = 0;
-    }
+    rs->ptr = pgres;
+    return DB_ERROR_NONE;
+  }
 
-    if (stmt->query[i] != '?')
-    {
-      buf[j++] = stmt->query[i];
-      continue;
-    }
+  do
+  {
+    PQclear(pgres);
+    pgres = PQgetResult(pgcon);
+  } while (PQresultStatus(pgres) == PGRES_SINGLE_TUPLE);
 
-    n = db_print_value(stmt->bound_param + vcnt, buf + j, buflen - j);
-    if (n < 0)
-    {
-      need_realloc = 1;
-      goto again;
-    }
-    j += n;
-    vcnt++;
-  }
-  buf[j] = '\0';
+  rs->ptr = NULL;
+  rs->nrows = 0;
+  rs->nfields = 0;
 
-  rc = pgsql_drv_query(con, buf, j, rs);
+  if (PQresultStatus(pgres) != PGRES_TUPLES_OK)
+  {
+    /* An error in the middle of a result set */
+    pgsql_drain_results(pgcon);
+    return pgsql_check_status(con, pgres, funcname, query, rs);
+  }
 
-  free(buf);
+  PQclear(pgres);
+  pgsql_drain_results(pgcon);
 
-  return rc;
+  return DB_ERROR_NONE;
 }
 
 
-/* Execute SQL query */
-
+/* Replace the current row of a streamed result set with the next one */
 
-db_error_t pgsql_drv_query(db_conn_t *sb_conn, const char *query, size_t len,
-                           db_result_t *rs)
+static int pgsql_next_row_result(db_result_t *rs)
 {
-  PGconn         *pgcon = sb_conn->ptr;
-  PGresult       *pgres;
-  db_error_t     rc;
+  db_conn_t * const con = SB_CONTAINER_OF(rs, db_conn_t, rs);
+  PGconn * const    pgcon = con->ptr;
 
-  (void)len; /* unused */
+  if (rs->ptr == NULL)
+    return 1;
 
-  sb_conn->sql_errno = 0;
-  xfree(sb_conn->sql_state);
-  xfree(sb_conn->sql_errmsg);
+  PQclear(rs->ptr);
+  rs->ptr = PQgetResult(pgcon);
 
-  pgres = PQexec(pgcon, query);
-  rc = pgsql_check_status(sb_conn, pgres, "PQexec", query, rs);
+  if (PQresultStatus(rs->ptr) != PGRES_SINGLE_TUPLE)
+  {
+    if (PQresultStatus(rs->ptr) != PGRES_TUPLES_OK)
+      log_text(LOG_FATAL, "PQgetResult() failed: %s",
+               PQresultErrorMessage(rs->ptr));
 
-  rs->ptr = (rs->counter == SB_CNT_READ) ? (void *) pgres : NULL;
+    PQclear(rs->ptr);
+    rs->ptr = NULL;
+    pgsql_drain_results(pgcon);
 
-  return rc;
+    return 1;
+  }
+
+  rs->nrows++;
+
+  return 0;
 }
 
 
@@ -720,8 +1814,15 @@ int pgsql_drv_fetch_row(db_result_t *rs, db_row_t *row)
     memory management.
   */
   rownum = (intptr_t) row->ptr;
-  if (rownum >= (int) rs->nrows)
-    return DB_ERROR_NONE;
+  if (db_globals.result_mode == DB_RESULT_MODE_STREAM)
+  {
+    /* Each row is a separate PGresult in single-row mode */
+    if (rownum > 0 && pgsql_next_row_result(rs))
+      return 1;
+    rownum = 0;
+  }
+  else if (rownum >= (int) rs->nrows)
+    return 1;
 
   for (i = 0; i < (int) rs->nfields; i++)
   {
@@ -749,6 +1850,22 @@ int pgsql_drv_fetch_row(db_result_t *rs, db_row_t *row)
 
 int pgsql_drv_free_results(db_result_t *rs)
 {
+  if (db_globals.result_mode == DB_RESULT_MODE_STREAM)
+  {
+    db_conn_t * const con = SB_CONTAINER_OF(rs, db_conn_t, rs);
+
+    /* Skip the rest of a partially fetched result set */
+    if (rs->ptr != NULL)
+    {
+      PQclear((PGresult *)rs->ptr);
+      rs->ptr = NULL;
+      pgsql_drain_results(con->ptr);
+    }
+
+    rs->row.ptr = 0;
+    return 0;
+  }
+
   if (rs->ptr != NULL)
   {
     PQclear((PGresult *)rs->ptr);
@@ -758,7 +1875,8 @@ int pgsql_drv_free_results(db_result_t *rs)
     return 0;
   }
 
-  return 1;
+  /* Result sets in discard mode have no rows to free */
+  return db_globals.result_mode != DB_RESULT_MODE_DISCARD;
 }
 
 
@@ -773,10 +1891,17 @@ int pgsql_drv_close(db_stmt_t *stmt)
   if (pgstmt == NULL)
     return 1;
 
+  if (pgstmt->cached != NULL)
+    stmt_cache_release(pgstmt->cached);
+
   if (pgstmt->name != NULL)
     free(pgstmt->name);
   if (pgstmt->ptypes != NULL)
     free(pgstmt->ptypes);
+  free(pgstmt->plengths);
+  free(pgstmt->pformats);
+  free(pgstmt->psizes);
+  free(pgstmt->declare);
   if (pgstmt->pvalues != NULL)
   {
     for (i = 0; i < pgstmt->nparams; i++)
@@ -791,9 +1916,252 @@ int pgsql_drv_close(db_stmt_t *stmt)
 }
 
 
+#ifdef LIBPQ_HAS_PIPELINING
+
+/* Enter pipeline mode, if enabled with --pgsql-pipeline */
+
+
+int pgsql_drv_pipeline_begin(db_conn_t *sb_conn)
+{
+  PGconn *pgcon = sb_conn->ptr;
+
+  if (!args.pipeline)
+    return 1;
+
+  if (!PQenterPipelineMode(pgcon))
+  {
+    log_text(LOG_FATAL, "PQenterPipelineMode() failed: %s",
+             PQerrorMessage(pgcon));
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*
+  Send a sync message, collect results of all queued queries and leave
+  pipeline mode. Each result is accounted with its query type, or only the type
+  of the last one is stored into 'counter' if it is not NULL.
+*/
+
+static db_error_t pipeline_sync(db_conn_t *sb_conn, sb_counter_type_t *counter)
+{
+  PGconn         *pgcon = sb_conn->ptr;
+  PGresult       *pgres;
+  db_result_t    rs;
+  db_error_t     rc = DB_ERROR_NONE;
+  db_error_t     err;
+  ExecStatusType status;
+  int            nnull = 0;
+
+  if (!PQpipelineSync(pgcon))
+  {
+    log_text(LOG_FATAL, "PQpipelineSync() failed: %s", PQerrorMessage(pgcon));
+    return DB_ERROR_FATAL;
+  }
+
+  for (;;)
+  {
+    pgres = PQgetResult(pgcon);
+
+    /*
+      A NULL result separates results of consecutive queries, two of them in a
+      row mean there is nothing more to read, e.g. the connection is broken
+    */
+    if (pgres == NULL)
+    {
+      if (++nnull > 1)
+      {
+        log_text(LOG_FATAL, "unexpected end of pipeline results: %s",
+                 PQerrorMessage(pgcon));
+        return DB_ERROR_FATAL;
+      }
+      continue;
+    }
+    nnull = 0;
+
+    status = PQresultStatus(pgres);
+    switch (status) {
+      case PGRES_PIPELINE_SYNC:
+        PQclear(pgres);
+        goto done;
+
+      case PGRES_PIPELINE_ABORTED:
+        /* Skipped because of an error in a previous query */
+        PQclear(pgres);
+        if (counter == NULL)
+          sb_counter_inc(sb_conn->thread_id, SB_CNT_ERROR);
+        continue;
+
+      default:
+        break;
+    }
+
+    err = pgsql_check_status(sb_conn, pgres, "PQgetResult", NULL, &rs);
+
+    /*
+      Result sets are not returned to the caller in pipeline mode. Other
+      results have been freed by pgsql_check_status()
+    */
+    if (status != PGRES_COMMAND_OK && status != PGRES_FATAL_ERROR)
+      PQclear(pgres);
+
+    if (counter == NULL)
+      sb_counter_inc(sb_conn->thread_id, rs.counter);
+    else
+      *counter = rs.counter;
+
+    if (err != DB_ERROR_NONE && rc == DB_ERROR_NONE)
+      rc = err;
+  }
+
+done:
+  if (!PQexitPipelineMode(pgcon))
+  {
+    log_text(LOG_FATAL, "PQexitPipelineMode() failed: %s",
+             PQerrorMessage(pgcon));
+    return DB_ERROR_FATAL;
+  }
+
+  /* Roll back the aborted transaction, see pgsql_check_status() */
+  if (rc == DB_ERROR_IGNORABLE)
+    PQclear(PQexec(pgcon, "ROLLBACK"));
+
+  return rc;
+}
+
+
+db_error_t pgsql_drv_pipeline_end(db_conn_t *sb_conn)
+{
+  return pipeline_sync(sb_conn, NULL);
+}
+
+
+/*
+  Send all rows of a batch in pipeline mode, regardless of --pgsql-pipeline,
+  and wait for their results once
+*/
+
+
+db_error_t pgsql_drv_execute_batch(db_stmt_t *stmt, db_result_t *rs)
+{
+  db_conn_t  *con = stmt->connection;
+  PGconn     *pgcon = con->ptr;
+  pg_stmt_t  *pgstmt = stmt->ptr;
+  db_error_t rc;
+
+  /*
+    Emulated statements and cursors are executed one by one, rows of a batch
+    in a pipeline group are queued as other statements
+  */
+  if (stmt->emulated || pgstmt == NULL || pgstmt->declare != NULL ||
+      con->state == DB_CONN_PIPELINE)
+    return db_batch_execute_rows(stmt, rs);
+
+  con->sql_errno = 0;
+  xfree(con->sql_state);
+  xfree(con->sql_errmsg);
+
+  if (!PQenterPipelineMode(pgcon))
+  {
+    log_text(LOG_FATAL, "PQenterPipelineMode() failed: %s",
+             PQerrorMessage(pgcon));
+    return DB_ERROR_FATAL;
+  }
+
+  /* pgsql_drv_execute() only sends statements in pipeline mode */
+  const db_conn_state_t state = con->state;
+
+  con->state = DB_CONN_PIPELINE;
+  rc = db_batch_execute_rows(stmt, rs);
+  con->state = state;
+
+  /* Results of the rows sent before a failure must still be collected */
+  const db_error_t sync_rc = pipeline_sync(con, &rs->counter);
+
+  return rc != DB_ERROR_NONE ? rc : sync_rc;
+}
+
+#endif /* LIBPQ_HAS_PIPELINING */
+
+
+/* Start COPY ... FROM STDIN */
+
+
+int pgsql_drv_copy_begin(db_conn_t *sb_conn, const char *query, size_t len)
+{
+  PGconn   *pgcon = sb_conn->ptr;
+  PGresult *pgres;
+
+  (void) len; /* unused */
+
+  pgres = PQexec(pgcon, query);
+  if (PQresultStatus(pgres) != PGRES_COPY_IN)
+  {
+    log_text(LOG_FATAL, "COPY failed: %s", PQresultErrorMessage(pgres));
+    log_text(LOG_FATAL, "failed query was: %s", query);
+    PQclear(pgres);
+    return 1;
+  }
+  PQclear(pgres);
+
+  return 0;
+}
+
+
+/* Send a chunk of COPY data, libpq buffers it further */
+
+
+int pgsql_drv_copy_data(db_conn_t *sb_conn, const char *buf, size_t len)
+{
+  PGconn *pgcon = sb_conn->ptr;
+
+  if (PQputCopyData(pgcon, buf, (int) len) != 1)
+  {
+    log_text(LOG_FATAL, "PQputCopyData() failed: %s", PQerrorMessage(pgcon));
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/* Finish COPY and check its result */
+
+
+int pgsql_drv_copy_end(db_conn_t *sb_conn)
+{
+  PGconn   *pgcon = sb_conn->ptr;
+  PGresult *pgres;
+  int      rc = 0;
+
+  if (PQputCopyEnd(pgcon, NULL) != 1)
+  {
+    log_text(LOG_FATAL, "PQputCopyEnd() failed: %s", PQerrorMessage(pgcon));
+    return 1;
+  }
+
+  while ((pgres = PQgetResult(pgcon)) != NULL)
+  {
+    if (PQresultStatus(pgres) != PGRES_COMMAND_OK)
+    {
+      log_text(LOG_FATAL, "COPY failed: %s", PQresultErrorMessage(pgres));
+      rc = 1;
+    }
+    PQclear(pgres);
+  }
+
+  return rc;
+}
+
+
 /* Uninitialize driver */
 int pgsql_drv_done(void)
 {
+  xfree(args.servers);
+  args.nservers = 0;
+
   return 0;
 }
 
@@ -0,0 +1,1085 @@
+/* Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Embedded SQLite driver. The database engine runs in the sysbench process, so
+  there is no network or IPC involved. Each connection opens the database file
+  given by --sqlite-db separately, so concurrent writers are serialized by
+  SQLite file locks.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+
+#include <sqlite3.h>
+
+#include "sb_options.h"
+#include "db_driver.h"
+#include "sb_usage.h"
+
+#define xfree(ptr) ({ if (ptr) free((void *)ptr); ptr = NULL; })
+
+/* SQLite has no SQLSTATE values, use the generic one for all errors */
+#define SQLITE_SQL_STATE "HY000"
+
+/* Page cache size of each connection with --lean-workers, 64 KiB */
+#define SQLITE_LEAN_CACHE_SIZE "-64"
+
+/* SQLite driver arguments */
+
+static sb_arg_t sqlite_drv_args[] =
+{
+  SB_OPT("sqlite-db", "SQLite database file name or URI", "sbtest.db",
+         STRING),
+  SB_OPT("sqlite-busy-timeout", "Time in milliseconds to wait for locks held "
+         "by other connections before failing with SQLITE_BUSY", "10000",
+         INT),
+  SB_OPT("sqlite-pragma", "PRAGMA statements to execute on each new "
+         "connection, e.g. journal_mode=WAL,synchronous=NORMAL", "", LIST),
+
+  SB_OPT_END
+};
+
+typedef struct
+{
+  char               *db;
+  int                busy_timeout;
+  sb_list_t          *pragmas;
+} sqlite_drv_args_t;
+
+/* Per-connection driver data */
+
+typedef struct
+{
+  sqlite3            *db;
+  sqlite3_stmt       *stmt;     /* Statement of a streamed result set */
+  bool               finalize;  /* Does stmt belong to a non-prepared query? */
+  db_value_t         *values;   /* Stored rows, nrows x nfields values */
+  size_t             nvalues;   /* Allocated length of values */
+  char               *data;     /* Buffer for stored column values */
+  size_t             data_len;
+  size_t             data_size;
+  sqlite3_stmt       *copy_stmt; /* INSERT used for bulk loading */
+  bool               copy_trx;  /* Was a transaction started for the load? */
+  char               *copy_buf; /* Incomplete row from the last chunk */
+  size_t             copy_len;
+  size_t             copy_size;
+  int                copy_error; /* Has any row failed to load? */
+} sqlite_conn_t;
+
+/* SQLite driver capabilities */
+
+static drv_caps_t sqlite_drv_caps =
+{
+  1,    /* multi_rows_insert */
+  1,    /* prepared_statements */
+  0,    /* auto_increment */
+  0,    /* needs_commit */
+  0,    /* serial */
+  0,    /* unsigned int */
+};
+
+static sqlite_drv_args_t args;          /* driver args */
+
+static char use_ps; /* whether prepared statemens should be used */
+
+/* SQLite driver operations */
+
+static int sqlite_drv_init(void);
+static int sqlite_drv_describe(drv_caps_t *);
+static int sqlite_drv_connect(db_conn_t *);
+static int sqlite_drv_disconnect(db_conn_t *);
+static int sqlite_drv_reconnect(db_conn_t *);
+static int sqlite_drv_prepare(db_stmt_t *, const char *, size_t);
+static int sqlite_drv_bind_param(db_stmt_t *, db_bind_t *, size_t);
+static int sqlite_drv_bind_result(db_stmt_t *, db_bind_t *, size_t);
+static db_error_t sqlite_drv_execute(db_stmt_t *, db_result_t *);
+static int sqlite_drv_fetch(db_result_t *);
+static int sqlite_drv_fetch_row(db_result_t *, db_row_t *);
+static db_error_t sqlite_drv_query(db_conn_t *, const char *, size_t,
+                                   db_result_t *);
+static int sqlite_drv_free_results(db_result_t *);
+static int sqlite_drv_close(db_stmt_t *);
+static int sqlite_drv_done(void);
+static int sqlite_drv_copy_begin(db_conn_t *, const char *, size_t);
+static int sqlite_drv_copy_data(db_conn_t *, const char *, size_t);
+static int sqlite_drv_copy_end(db_conn_t *);
+
+/* SQLite driver definition */
+
+static db_driver_t sqlite_driver =
+{
+  .sname = "sqlite",
+  .lname = "SQLite driver",
+  .args = sqlite_drv_args,
+  .ops =
+  {
+    .init = sqlite_drv_init,
+    .describe = sqlite_drv_describe,
+    .connect = sqlite_drv_connect,
+    .disconnect = sqlite_drv_disconnect,
+    .reconnect = sqlite_drv_reconnect,
+    .prepare = sqlite_drv_prepare,
+    .bind_param = sqlite_drv_bind_param,
+    .bind_result = sqlite_drv_bind_result,
+    .execute = sqlite_drv_execute,
+    .fetch = sqlite_drv_fetch,
+    .fetch_row = sqlite_drv_fetch_row,
+    .free_results = sqlite_drv_free_results,
+    .close = sqlite_drv_close,
+    .query = sqlite_drv_query,
+    .done = sqlite_drv_done,
+    .copy_begin = sqlite_drv_copy_begin,
+    .copy_data = sqlite_drv_copy_data,
+    .copy_end = sqlite_drv_copy_end
+  }
+};
+
+
+/* Register SQLite driver */
+
+
+int register_driver_sqlite(sb_list_t *drivers)
+{
+  SB_LIST_ADD_TAIL(&sqlite_driver.listitem, drivers);
+
+  return 0;
+}
+
+
+/* SQLite driver initialization */
+
+
+int sqlite_drv_init(void)
+{
+  /* Connections are used by one thread at a time, but by different ones */
+  if (!sqlite3_threadsafe())
+  {
+    log_text(LOG_FATAL, "SQLite library is compiled without thread support");
+    return 1;
+  }
+
+  /*
+    Without an initial bulk allocation of page cache memory for each
+    connection, pages are only allocated as they are used. This fails if the
+    library is already initialized, which is harmless.
+  */
+  if (sb_globals.lean_workers)
+    sqlite3_config(SQLITE_CONFIG_PAGECACHE, NULL, 0, 0);
+
+  args.db = sb_get_value_string("sqlite-db");
+  args.busy_timeout = sb_get_value_int("sqlite-busy-timeout");
+  args.pragmas = sb_get_value_list("sqlite-pragma");
+
+  if (args.busy_timeout < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for sqlite-busy-timeout: %d",
+             args.busy_timeout);
+    return 1;
+  }
+
+  use_ps = 0;
+  sqlite_drv_caps.prepared_statements = 1;
+  if (db_globals.ps_mode != DB_PS_MODE_DISABLE)
+    use_ps = 1;
+
+  /* The database is in-process, so the client is always busy */
+  sb_usage_disable_client_warning();
+
+  return 0;
+}
+
+
+/* Describe database capabilities */
+
+
+int sqlite_drv_describe(drv_caps_t *caps)
+{
+  *caps = sqlite_drv_caps;
+
+  return 0;
+}
+
+
+/* Open the database and execute --sqlite-pragma statements */
+
+
+static sqlite3 *sqlite_open(void)
+{
+  sqlite3        *db;
+  sb_list_item_t *pos;
+  char           *errmsg;
+  int            rc;
+
+  rc = sqlite3_open_v2(args.db, &db, SQLITE_OPEN_READWRITE |
+                       SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX |
+                       SQLITE_OPEN_URI, NULL);
+  if (rc != SQLITE_OK)
+  {
+    log_text(LOG_FATAL, "Cannot open SQLite database '%s': %s", args.db,
+             db != NULL ? sqlite3_errmsg(db) : sqlite3_errstr(rc));
+    sqlite3_close(db);
+    return NULL;
+  }
+
+  sqlite3_extended_result_codes(db, 1);
+  sqlite3_busy_timeout(db, args.busy_timeout);
+
+  /* The default is 2 MiB per connection. --sqlite-pragma may override it */
+  if (sb_globals.lean_workers &&
+      sqlite3_exec(db, "PRAGMA cache_size=" SQLITE_LEAN_CACHE_SIZE, NULL, NULL,
+                   NULL) != SQLITE_OK)
+    log_text(LOG_WARNING, "Cannot reduce the page cache size: %s",
+             sqlite3_errmsg(db));
+
+  SB_LIST_FOR_EACH(pos, args.pragmas)
+  {
+    const char * const pragma = SB_LIST_ENTRY(pos, value_t, listitem)->data;
+    char               query[256];
+
+    snprintf(query, sizeof(query), "PRAGMA %s", pragma);
+    if (sqlite3_exec(db, query, NULL, NULL, &errmsg) != SQLITE_OK)
+    {
+      log_text(LOG_FATAL, "%s failed: %s", query, errmsg);
+      sqlite3_free(errmsg);
+      sqlite3_close(db);
+      return NULL;
+    }
+  }
+
+  return db;
+}
+
+
+/* Connect to database */
+
+
+int sqlite_drv_connect(db_conn_t *sb_conn)
+{
+  sqlite_conn_t *con;
+
+  con = (sqlite_conn_t *) calloc(1, sizeof(sqlite_conn_t));
+  if (con == NULL)
+    return 1;
+
+  con->db = sqlite_open();
+  if (con->db == NULL)
+  {
+    free(con);
+    return 1;
+  }
+
+  sb_conn->ptr = con;
+
+  return 0;
+}
+
+
+/* Disconnect from database */
+
+
+int sqlite_drv_disconnect(db_conn_t *sb_conn)
+{
+  sqlite_conn_t *con = sb_conn->ptr;
+
+  /* This might be allocated in sqlite_check_error() */
+  xfree(sb_conn->sql_errmsg);
+
+  if (con == NULL)
+    return 0;
+
+  if (con->stmt != NULL && con->finalize)
+    sqlite3_finalize(con->stmt);
+  sqlite3_finalize(con->copy_stmt);
+
+  /* Statements not closed by the script are finalized as well */
+  sqlite3_close_v2(con->db);
+
+  free(con->values);
+  free(con->data);
+  free(con->copy_buf);
+  xfree(sb_conn->ptr);
+
+  return 0;
+}
+
+
+/* Reopen the database */
+
+
+int sqlite_drv_reconnect(db_conn_t *sb_conn)
+{
+  if (sqlite_drv_disconnect(sb_conn) || sqlite_drv_connect(sb_conn))
+    return DB_ERROR_FATAL;
+
+  return DB_ERROR_IGNORABLE;
+}
+
+
+/* Prepare statement */
+
+
+int sqlite_drv_prepare(db_stmt_t *stmt, const char *query, size_t len)
+{
+  sqlite_conn_t *con = stmt->connection->ptr;
+  sqlite3_stmt  *st;
+
+  if (con == NULL)
+    return 1;
+
+  if (!use_ps)
+  {
+    /* Use client-side PS */
+    stmt->emulated = 1;
+    stmt->query = strdup(query);
+
+    return 0;
+  }
+
+  if (sqlite3_prepare_v2(con->db, query, (int) len, &st, NULL) != SQLITE_OK)
+  {
+    log_text(LOG_FATAL, "sqlite3_prepare_v2() failed: %s",
+             sqlite3_errmsg(con->db));
+    log_text(LOG_FATAL, "failed query was: %s", query);
+    return 1;
+  }
+
+  stmt->ptr = st;
+
+  return 0;
+}
+
+
+/* Bind parameters for prepared statement */
+
+
+int sqlite_drv_bind_param(db_stmt_t *stmt, db_bind_t *params, size_t len)
+{
+  if (stmt->bound_param != NULL)
+    free(stmt->bound_param);
+  stmt->bound_param = (db_bind_t *)malloc(len * sizeof(db_bind_t));
+  if (stmt->bound_param == NULL)
+    return 1;
+  memcpy(stmt->bound_param, params, len * sizeof(db_bind_t));
+  stmt->bound_param_len = len;
+
+  if (stmt->emulated)
+    return 0;
+
+  if ((size_t) sqlite3_bind_parameter_count(stmt->ptr) != len)
+  {
+    log_text(LOG_ALERT, "wrong number of parameters in prepared statement");
+    log_text(LOG_DEBUG, "counted: %d, passed to bind_param(): %zd",
+             sqlite3_bind_parameter_count(stmt->ptr), len);
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/* Bind results for prepared statement */
+
+
+int sqlite_drv_bind_result(db_stmt_t *stmt, db_bind_t *params, size_t len)
+{
+  /* unused */
+  (void)stmt;
+  (void)params;
+  (void)len;
+
+  return 0;
+}
+
+
+/* Bind a sysbench parameter to a prepared statement */
+
+
+static int sqlite_bind_value(sqlite3_stmt *st, int i, const db_bind_t *param)
+{
+  const db_time_t *tm;
+  char            buf[32];
+  char            *blob;
+
+  if (param->is_null != NULL && *param->is_null)
+    return sqlite3_bind_null(st, i);
+
+  switch (param->type) {
+  case DB_TYPE_TINYINT:
+    return sqlite3_bind_int(st, i, *(char *) param->buffer);
+  case DB_TYPE_SMALLINT:
+    return sqlite3_bind_int(st, i, *(short *) param->buffer);
+  case DB_TYPE_INT:
+    return sqlite3_bind_int(st, i, *(int *) param->buffer);
+  case DB_TYPE_BIGINT:
+    return sqlite3_bind_int64(st, i, *(long long *) param->buffer);
+  case DB_TYPE_FLOAT:
+    return sqlite3_bind_double(st, i, *(float *) param->buffer);
+  case DB_TYPE_DOUBLE:
+    return sqlite3_bind_double(st, i, *(double *) param->buffer);
+  case DB_TYPE_CHAR:
+  case DB_TYPE_VARCHAR:
+    /* The buffer is owned by the caller and outlives the statement */
+    return sqlite3_bind_text(st, i, param->buffer, (int) param->data_len[0],
+                             SQLITE_STATIC);
+  case DB_TYPE_BLOB:
+    /*
+      Values cannot be bound in parts, so a generated one is passed to SQLite,
+      which frees it
+    */
+    if ((blob = malloc(param->data_len[0] > 0 ? param->data_len[0] : 1)) ==
+        NULL)
+      return SQLITE_NOMEM;
+    db_blob_fill(blob, param->data_len[0]);
+    return sqlite3_bind_blob64(st, i, blob, param->data_len[0], free);
+  case DB_TYPE_DATE:
+    tm = param->buffer;
+    snprintf(buf, sizeof(buf), "%04u-%02u-%02u", tm->year, tm->month,
+             tm->day);
+    break;
+  case DB_TYPE_TIME:
+    tm = param->buffer;
+    snprintf(buf, sizeof(buf), "%02u:%02u:%02u", tm->hour, tm->minute,
+             tm->second);
+    break;
+  case DB_TYPE_DATETIME:
+  case DB_TYPE_TIMESTAMP:
+    tm = param->buffer;
+    snprintf(buf, sizeof(buf), "%04u-%02u-%02u %02u:%02u:%02u", tm->year,
+             tm->month, tm->day, tm->hour, tm->minute, tm->second);
+    break;
+  default:
+    return sqlite3_bind_null(st, i);
+  }
+
+  return sqlite3_bind_text(st, i, buf, -1, SQLITE_TRANSIENT);
+}
+
+
+/*
+  Save the error of the last call on a connection. Lock conflicts and
+  duplicate keys are ignorable errors, the current transaction is rolled back
+  in this case.
+*/
+
+static db_error_t sqlite_check_error(db_conn_t *sb_conn, const char *funcname,
+                                     const char *query, db_result_t *rs)
+{
+  sqlite_conn_t * const con = sb_conn->ptr;
+  const int             rc = sqlite3_extended_errcode(con->db);
+
+  rs->nrows = 0;
+  rs->nfields = 0;
+  rs->counter = SB_CNT_ERROR;
+
+  /*
+    Duplicate the message, because it is overwritten by the next call. It is
+    deallocated either on subsequent calls or in sqlite_drv_disconnect().
+  */
+  xfree(sb_conn->sql_errmsg);
+  sb_conn->sql_errno = rc;
+  sb_conn->sql_state = SQLITE_SQL_STATE;
+  sb_conn->sql_errmsg = strdup(sqlite3_errmsg(con->db));
+
+  switch (rc) {
+  case SQLITE_BUSY:
+  case SQLITE_BUSY_SNAPSHOT:
+  case SQLITE_LOCKED:
+  case SQLITE_CONSTRAINT_PRIMARYKEY:
+  case SQLITE_CONSTRAINT_UNIQUE:
+    if (!sqlite3_get_autocommit(con->db))
+      sqlite3_exec(con->db, "ROLLBACK", NULL, NULL, NULL);
+    return DB_ERROR_IGNORABLE;
+
+  default:
+    log_text(LOG_FATAL, "%s() failed: %d %s", funcname, rc,
+             sb_conn->sql_errmsg);
+    if (query != NULL)
+      log_text(LOG_FATAL, "failed query was: %s", query);
+    return DB_ERROR_FATAL;
+  }
+}
+
+
+/* Reset or finalize a statement that is no longer used for the result set */
+
+
+static void sqlite_finish(sqlite3_stmt *st, bool finalize)
+{
+  if (finalize)
+    sqlite3_finalize(st);
+  else
+    sqlite3_reset(st);
+}
+
+
+/* Copy the current row of a statement to the stored result set */
+
+
+static int sqlite_store_row(sqlite_conn_t *con, sqlite3_stmt *st,
+                            uint32_t nrow, uint32_t nfields)
+{
+  const size_t need = (size_t) (nrow + 1) * nfields;
+
+  if (need > con->nvalues)
+  {
+    const size_t n = SB_MAX(need, con->nvalues * 2);
+    db_value_t   *values = realloc(con->values, n * sizeof(db_value_t));
+
+    if (values == NULL)
+      return 1;
+    con->values = values;
+    con->nvalues = n;
+  }
+
+  db_value_t * const values = con->values + (size_t) nrow * nfields;
+
+  for (uint32_t i = 0; i < nfields; i++)
+  {
+    const unsigned char *p = sqlite3_column_text(st, (int) i);
+
+    if (p == NULL)
+    {
+      values[i].ptr = NULL;
+      values[i].len = 0;
+      continue;
+    }
+
+    const size_t len = (size_t) sqlite3_column_bytes(st, (int) i);
+
+    if (con->data_len + len + 1 > con->data_size)
+    {
+      const size_t size = SB_MAX(con->data_len + len + 1, con->data_size * 2);
+      char         *data = realloc(con->data, size);
+
+      if (data == NULL)
+        return 1;
+      con->data = data;
+      con->data_size = size;
+    }
+
+    memcpy(con->data + con->data_len, p, len + 1);
+    /* Pointers are set when all rows are stored, the buffer may move */
+    values[i].ptr = (const char *) 1;
+    values[i].len = (uint32_t) len;
+    con->data_len += len + 1;
+  }
+
+  return 0;
+}
+
+
+/*
+  Step a statement whose first sqlite3_step() has returned SQLITE_ROW and
+  construct the result set according to --db-result-mode. Only streamed result
+  sets keep the statement, others are stored or discarded right away.
+*/
+
+static db_error_t sqlite_result_set(db_conn_t *sb_conn, sqlite3_stmt *st,
+                                    bool finalize, const char *query,
+                                    db_result_t *rs)
+{
+  sqlite_conn_t * const con = sb_conn->ptr;
+  const uint32_t        nfields = (uint32_t) sqlite3_column_count(st);
+  uint32_t              nrows = 0;
+  int                   rc;
+
+  rs->counter = SB_CNT_READ;
+  rs->nfields = nfields;
+  rs->nrows = 1;
+  rs->ptr = NULL;
+
+  if (db_globals.result_mode == DB_RESULT_MODE_STREAM)
+  {
+    con->stmt = st;
+    con->finalize = finalize;
+    return DB_ERROR_NONE;
+  }
+
+  con->data_len = 0;
+
+  do
+  {
+    if (db_globals.result_mode == DB_RESULT_MODE_STORE &&
+        sqlite_store_row(con, st, nrows, nfields))
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      sqlite_finish(st, finalize);
+      rs->counter = SB_CNT_ERROR;
+      return DB_ERROR_FATAL;
+    }
+    nrows++;
+  } while ((rc = sqlite3_step(st)) == SQLITE_ROW);
+
+  if (rc != SQLITE_DONE)
+  {
+    /* An error in the middle of a result set */
+    const db_error_t err = sqlite_check_error(sb_conn, "sqlite3_step",
+                                              query, rs);
+    sqlite_finish(st, finalize);
+    return err;
+  }
+
+  sqlite_finish(st, finalize);
+
+  if (db_globals.result_mode == DB_RESULT_MODE_DISCARD)
+  {
+    rs->nrows = 0;
+    rs->nfields = 0;
+    return DB_ERROR_NONE;
+  }
+
+  /* Point values into the data buffer now that it is complete */
+  const char *p = con->data;
+
+  for (size_t i = 0; i < (size_t) nrows * nfields; i++)
+  {
+    if (con->values[i].ptr == NULL)
+      continue;
+    con->values[i].ptr = p;
+    p += con->values[i].len + 1;
+  }
+
+  rs->nrows = nrows;
+  rs->ptr = con;
+
+  return DB_ERROR_NONE;
+}
+
+
+/* Execute a prepared or a one-off statement */
+
+
+static db_error_t sqlite_step(db_conn_t *sb_conn, sqlite3_stmt *st,
+                              bool finalize, const char *query,
+                              db_result_t *rs)
+{
+  sqlite_conn_t * const con = sb_conn->ptr;
+  const int             changes = sqlite3_total_changes(con->db);
+  const int             rc = sqlite3_step(st);
+  db_error_t            err;
+
+  if (rc == SQLITE_ROW)
+    return sqlite_result_set(sb_conn, st, finalize, query, rs);
+
+  if (rc != SQLITE_DONE)
+  {
+    err = sqlite_check_error(sb_conn, "sqlite3_step", query, rs);
+    sqlite_finish(st, finalize);
+    return err;
+  }
+
+  if (sqlite3_column_count(st) > 0)
+  {
+    /* Empty result set */
+    rs->counter = SB_CNT_READ;
+    rs->nrows = 0;
+    rs->nfields = (uint32_t) sqlite3_column_count(st);
+  }
+  else
+  {
+    /* sqlite3_changes() is not reset by statements other than DML */
+    rs->nrows = (uint32_t) (sqlite3_total_changes(con->db) - changes);
+    rs->counter = (rs->nrows > 0) ? SB_CNT_WRITE : SB_CNT_OTHER;
+  }
+  rs->ptr = NULL;
+
+  sqlite_finish(st, finalize);
+
+  return DB_ERROR_NONE;
+}
+
+
+/* Execute prepared statement */
+
+
+db_error_t sqlite_drv_execute(db_stmt_t *stmt, db_result_t *rs)
+{
+  db_conn_t       *con = stmt->connection;
+  unsigned int    i;
+
+  con->sql_errno = 0;
+  xfree(con->sql_errmsg);
+
+  if (!stmt->emulated)
+  {
+    sqlite3_stmt * const st = stmt->ptr;
+
+    if (st == NULL)
+    {
+      log_text(LOG_DEBUG,
+               "ERROR: exiting sqlite_drv_execute(), uninitialized statement");
+      return DB_ERROR_FATAL;
+    }
+
+    for (i = 0; i < stmt->bound_param_len; i++)
+      if (sqlite_bind_value(st, (int) i + 1, stmt->bound_param + i) !=
+          SQLITE_OK)
+        return sqlite_check_error(con, "sqlite3_bind", NULL, rs);
+
+    return sqlite_step(con, st, false, NULL, rs);
+  }
+
+  /* Use emulation */
+  unsigned int query_len;
+  const char   *query = db_print_query(stmt, &query_len);
+
+  if (query == NULL)
+    return DB_ERROR_FATAL;
+
+  return sqlite_drv_query(con, query, query_len, rs);
+}
+
+
+/*
+  Execute SQL query. Queries may consist of several statements, the result of
+  the last one is returned.
+*/
+
+
+db_error_t sqlite_drv_query(db_conn_t *sb_conn, const char *query, size_t len,
+                            db_result_t *rs)
+{
+  sqlite_conn_t * const con = sb_conn->ptr;
+  sqlite3_stmt          *st;
+  const char            *tail = query;
+  const char * const    end = query + len;
+  db_error_t            rc = DB_ERROR_NONE;
+
+  sb_conn->sql_errno = 0;
+  xfree(sb_conn->sql_errmsg);
+
+  rs->counter = SB_CNT_OTHER;
+  rs->nrows = 0;
+  rs->nfields = 0;
+  rs->ptr = NULL;
+
+  while (tail < end)
+  {
+    if (sqlite3_prepare_v2(con->db, tail, (int) (end - tail), &st, &tail) !=
+        SQLITE_OK)
+      return sqlite_check_error(sb_conn, "sqlite3_prepare_v2", query, rs);
+
+    /* Whitespace or a comment */
+    if (st == NULL)
+      continue;
+
+    /* Results of all statements but the last one are discarded */
+    if (rs->counter == SB_CNT_READ)
+      sqlite_drv_free_results(rs);
+
+    if ((rc = sqlite_step(sb_conn, st, true, query, rs)) != DB_ERROR_NONE)
+      break;
+  }
+
+  return rc;
+}
+
+
+/* Fetch row from result set of a prepared statement */
+
+
+int sqlite_drv_fetch(db_result_t *rs)
+{
+  /* NYI */
+  (void)rs;
+
+  return 1;
+}
+
+
+/* Fetch row from result set of a query */
+
+
+int sqlite_drv_fetch_row(db_result_t *rs, db_row_t *row)
+{
+  db_conn_t * const     sb_conn = SB_CONTAINER_OF(rs, db_conn_t, rs);
+  sqlite_conn_t * const con = sb_conn->ptr;
+  intptr_t              rownum;
+
+  /*
+    Use row->ptr as a row number, rather than a pointer to avoid dynamic
+    memory management.
+  */
+  rownum = (intptr_t) row->ptr;
+
+  if (db_globals.result_mode != DB_RESULT_MODE_STREAM)
+  {
+    if (rs->ptr == NULL || rownum >= (intptr_t) rs->nrows)
+      return 1;
+
+    memcpy(row->values, con->values + (size_t) rownum * rs->nfields,
+           rs->nfields * sizeof(db_value_t));
+    row->ptr = (void *) (rownum + 1);
+
+    return 0;
+  }
+
+  /* The statement is positioned on the first row by sqlite_result_set() */
+  if (con->stmt == NULL)
+    return 1;
+
+  if (rownum > 0)
+  {
+    const int rc = sqlite3_step(con->stmt);
+
+    if (rc != SQLITE_ROW)
+    {
+      if (rc != SQLITE_DONE)
+        log_text(LOG_FATAL, "sqlite3_step() failed: %s",
+                 sqlite3_errmsg(con->db));
+
+      sqlite_finish(con->stmt, con->finalize);
+      con->stmt = NULL;
+
+      return 1;
+    }
+
+    rs->nrows++;
+  }
+
+  for (uint32_t i = 0; i < rs->nfields; i++)
+  {
+    row->values[i].ptr = (const char *) sqlite3_column_text(con->stmt, (int) i);
+    row->values[i].len = (uint32_t) sqlite3_column_bytes(con->stmt, (int) i);
+  }
+
+  row->ptr = (void *) (rownum + 1);
+
+  return 0;
+}
+
+
+/* Free result set */
+
+
+int sqlite_drv_free_results(db_result_t *rs)
+{
+  db_conn_t * const     sb_conn = SB_CONTAINER_OF(rs, db_conn_t, rs);
+  sqlite_conn_t * const con = sb_conn->ptr;
+
+  /* Skip the rest of a partially fetched result set */
+  if (con != NULL && con->stmt != NULL)
+  {
+    sqlite_finish(con->stmt, con->finalize);
+    con->stmt = NULL;
+  }
+
+  rs->ptr = NULL;
+  rs->row.ptr = 0;
+
+  return 0;
+}
+
+
+/* Close prepared statement */
+
+
+int sqlite_drv_close(db_stmt_t *stmt)
+{
+  if (stmt->ptr != NULL)
+    sqlite3_finalize(stmt->ptr);
+  stmt->ptr = NULL;
+
+  return 0;
+}
+
+
+/*
+  Start bulk loading. The query is an INSERT with a parameter for each column,
+  e.g. INSERT INTO t(a, b) VALUES (?, ?). It is executed for each row of
+  tab-separated values passed to sqlite_drv_copy_data(), with \N for NULL
+  values, all in a single transaction unless one has been started already.
+*/
+
+
+int sqlite_drv_copy_begin(db_conn_t *sb_conn, const char *query, size_t len)
+{
+  sqlite_conn_t * const con = sb_conn->ptr;
+
+  if (sqlite3_prepare_v2(con->db, query, (int) len, &con->copy_stmt, NULL) !=
+      SQLITE_OK)
+  {
+    log_text(LOG_FATAL, "sqlite3_prepare_v2() failed: %s",
+             sqlite3_errmsg(con->db));
+    log_text(LOG_FATAL, "failed query was: %s", query);
+    return 1;
+  }
+
+  con->copy_trx = false;
+  con->copy_len = 0;
+  con->copy_error = 0;
+
+  if (sqlite3_get_autocommit(con->db))
+  {
+    if (sqlite3_exec(con->db, "BEGIN", NULL, NULL, NULL) != SQLITE_OK)
+    {
+      log_text(LOG_FATAL, "BEGIN failed: %s", sqlite3_errmsg(con->db));
+      sqlite3_finalize(con->copy_stmt);
+      con->copy_stmt = NULL;
+      return 1;
+    }
+    con->copy_trx = true;
+  }
+
+  return 0;
+}
+
+
+/* Insert a single row of tab-separated values */
+
+
+static int sqlite_copy_row(sqlite_conn_t *con, const char *row, size_t len)
+{
+  sqlite3_stmt * const st = con->copy_stmt;
+  const char * const   end = row + len;
+  const int            nparams = sqlite3_bind_parameter_count(st);
+  int                  i;
+
+  for (i = 1; i <= nparams && row <= end; i++)
+  {
+    const char *p = memchr(row, '\t', (size_t) (end - row));
+
+    if (p == NULL)
+      p = end;
+
+    if (p - row == 2 && row[0] == '\\' && row[1] == 'N')
+      sqlite3_bind_null(st, i);
+    else
+      sqlite3_bind_text(st, i, row, (int) (p - row), SQLITE_STATIC);
+
+    row = p + 1;
+  }
+
+  if (i <= nparams || row <= end)
+  {
+    log_text(LOG_FATAL, "wrong number of values in a bulk loaded row, "
+             "expected %d", nparams);
+    return 1;
+  }
+
+  const int rc = sqlite3_step(st);
+
+  sqlite3_reset(st);
+
+  if (rc != SQLITE_DONE)
+  {
+    log_text(LOG_FATAL, "bulk loading failed: %s", sqlite3_errmsg(con->db));
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/* Load a chunk of rows, the last one may be continued in the next chunk */
+
+
+int sqlite_drv_copy_data(db_conn_t *sb_conn, const char *buf, size_t len)
+{
+  sqlite_conn_t * const con = sb_conn->ptr;
+  const char * const    end = buf + len;
+
+  if (con->copy_error)
+    return 1;
+
+  while (buf < end)
+  {
+    const char *p = memchr(buf, '\n', (size_t) (end - buf));
+
+    if (p == NULL)
+    {
+      /* Save the incomplete row for the next call */
+      if (con->copy_len + (size_t) (end - buf) > con->copy_size)
+      {
+        const size_t size = SB_MAX(con->copy_len + (size_t) (end - buf),
+                                   con->copy_size * 2);
+        char         *tmp = realloc(con->copy_buf, size);
+
+        if (tmp == NULL)
+          return con->copy_error = 1;
+        con->copy_buf = tmp;
+        con->copy_size = size;
+      }
+      memcpy(con->copy_buf + con->copy_len, buf, (size_t) (end - buf));
+      con->copy_len += (size_t) (end - buf);
+
+      return 0;
+    }
+
+    if (con->copy_len > 0)
+    {
+      /* Complete the row saved by the previous call */
+      if (sqlite_drv_copy_data(sb_conn, buf, (size_t) (p - buf)))
+        return 1;
+      con->copy_error = sqlite_copy_row(con, con->copy_buf, con->copy_len);
+      con->copy_len = 0;
+    }
+    else
+      con->copy_error = sqlite_copy_row(con, buf, (size_t) (p - buf));
+
+    if (con->copy_error)
+      return 1;
+
+    buf = p + 1;
+  }
+
+  return 0;
+}
+
+
+/* Finish bulk loading and commit the loaded rows */
+
+
+int sqlite_drv_copy_end(db_conn_t *sb_conn)
+{
+  sqlite_conn_t * const con = sb_conn->ptr;
+  int                   rc = con->copy_error;
+
+  /* The last row may have no terminating newline */
+  if (rc == 0 && con->copy_len > 0)
+    rc = sqlite_copy_row(con, con->copy_buf, con->copy_len);
+  con->copy_len = 0;
+
+  sqlite3_finalize(con->copy_stmt);
+  con->copy_stmt = NULL;
+
+  if (con->copy_trx &&
+      sqlite3_exec(con->db, rc ? "ROLLBACK" : "COMMIT", NULL, NULL, NULL) !=
+      SQLITE_OK)
+  {
+    log_text(LOG_FATAL, "COMMIT failed: %s", sqlite3_errmsg(con->db));
+    rc = 1;
+  }
+  con->copy_trx = false;
+
+  return rc;
+}
+
+
+/* Uninitialize driver */
+
+
+int sqlite_drv_done(void)
+{
+  return 0;
+}
@@ -0,0 +1,66 @@
+#!/usr/bin/env sysbench
+-- -------------------------------------------------------------------------- --
+-- Connection establishment benchmark: each event establishes a new database
+-- session in one of the following ways, as set by --connect_mode:
+--
+--   connect   - open a new connection and close it at the end of the event
+--   reconnect - reconnect an existing connection
+--   reset     - reset session state of an existing connection, e.g. with
+--               COM_RESET_CONNECTION for MySQL or DISCARD ALL for PostgreSQL
+--
+-- and then executes --connect_query, if any. Use --db-connect-stats to report
+-- connect latency percentiles separately from the query.
+-- -------------------------------------------------------------------------- --
+
+sysbench.cmdline.options = {
+   connect_mode =
+      {"How each event establishes a session {connect, reconnect, reset}",
+       "connect"},
+   connect_query =
+      {"Query to execute in each new session, empty for none", "SELECT 1"}
+}
+
+local connect_modes = { connect = true, reconnect = true, reset = true }
+
+function thread_init()
+   mode = sysbench.opt.connect_mode
+
+   if not connect_modes[mode] then
+      error("Invalid value for --connect_mode: " .. mode)
+   end
+
+   drv = sysbench.sql.driver()
+
+   if mode ~= "connect" then
+      con = drv:connect()
+   end
+end
+
+function thread_done()
+   if con ~= nil then
+      con:disconnect()
+   end
+end
+
+function event()
+   local c
+
+   if mode == "connect" then
+      c = drv:connect()
+   else
+      c = con
+      if mode == "reconnect" then
+         c:reconnect()
+      else
+         c:reset()
+      end
+   end
+
+   if sysbench.opt.connect_query ~= "" then
+      c:query(sysbench.opt.connect_query)
+   end
+
+   if mode == "connect" then
+      c:disconnect()
+   end
+end
@@ -125,6 +125,9 @@ function sysbench.cmdline.read_cmdline_options()
    end
 
    local args = ffi.new('sb_arg_t[?]', i)
+   -- Strings created here must not be garbage collected before they are
+   -- copied by sb_lua_set_test_args()
+   local values = {}
    i = 0
 
    for name, def in orderedPairs(sysbench.cmdline.options) do
@@ -141,12 +144,14 @@ function sysbench.cmdline.read_cmdline_options()
          assert(type(def[3]) == "nil" or
                    type(def[3]) == sysbench.cmdline.ARG_LIST,
                 "wrong type for list option " .. name)
-         args[i].value = table.concat(def[2], ',')
+         values[i] = table.concat(def[2], ',')
+         args[i].value = values[i]
       else
          if type(def[2]) == "boolean" then
             args[i].value = def[2] and 'on' or 'off'
          elseif type(def[2]) == "number" then
-            args[i].value = tostring(def[2])
+            values[i] = tostring(def[2])
+            args[i].value = values[i]
          else
             args[i].value = def[2]
          end
@@ -0,0 +1,126 @@
+-- Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+-- ----------------------------------------------------------------------
+-- File I/O with the I/O modes of the fileio test
+-- ----------------------------------------------------------------------
+
+ffi = require("ffi")
+
+sysbench.file = {}
+
+ffi.cdef[[
+typedef struct sb_file sb_file_t;
+
+sb_file_t *sb_file_open(const char *path, const char *mode, bool direct,
+                        bool create, uint64_t size, unsigned int depth,
+                        size_t max_len);
+int64_t sb_file_pread(sb_file_t *f, size_t len, uint64_t offset);
+int64_t sb_file_pwrite(sb_file_t *f, size_t len, uint64_t offset);
+int sb_file_queue(sb_file_t *f, bool write, size_t len, uint64_t offset);
+int64_t sb_file_submit(sb_file_t *f);
+int sb_file_fsync(sb_file_t *f, bool data_only);
+int64_t sb_file_size(sb_file_t *f);
+int sb_file_close(sb_file_t *f);
+]]
+
+local file = {}
+
+local function check(rc, func)
+   if rc < 0 then
+      error(func .. "() failed", 3)
+   end
+   return tonumber(rc)
+end
+
+-- Read or write 'len' bytes at 'offset', wait for completion and return the
+-- number of transferred bytes. Data is read into and written from buffers
+-- internal to the file, i.e. no Lua strings are created. Written data is
+-- random.
+function file:pread(len, offset)
+   return check(ffi.C.sb_file_pread(self, len, offset), "pread")
+end
+
+function file:pwrite(len, offset)
+   return check(ffi.C.sb_file_pwrite(self, len, offset), "pwrite")
+end
+
+-- Queue a read or a write to be sent by file:submit()
+function file:queue_read(len, offset)
+   check(ffi.C.sb_file_queue(self, false, len, offset), "queue_read")
+end
+
+function file:queue_write(len, offset)
+   check(ffi.C.sb_file_queue(self, true, len, offset), "queue_write")
+end
+
+-- Send all queued requests, wait for their completion and return the total
+-- number of transferred bytes. With the 'async' and 'uring' modes all of them
+-- are in flight at the same time.
+function file:submit()
+   return check(ffi.C.sb_file_submit(self), "submit")
+end
+
+function file:fsync()
+   check(ffi.C.sb_file_fsync(self, false), "fsync")
+end
+
+function file:fdatasync()
+   check(ffi.C.sb_file_fsync(self, true), "fdatasync")
+end
+
+function file:size()
+   return check(ffi.C.sb_file_size(self), "size")
+end
+
+-- Close the file. It must not be used afterwards.
+function file:close()
+   ffi.gc(self, nil)
+   ffi.C.sb_file_close(self)
+end
+
+ffi.metatype('sb_file_t', {
+                __index = file,
+                __tostring = function () return '<sb_file>' end
+})
+
+-- Open a file for reading and writing. Options are:
+--   mode     I/O mode like --file-io-mode: 'sync' (default), 'async', 'uring'
+--            or 'mmap'
+--   direct   open with O_DIRECT, false by default
+--   create   create the file if it does not exist, false by default
+--   size     with 'create', extend the file to this size if it is shorter
+--   depth    maximum number of queued requests, 32 by default
+--   max_len  maximum request length in bytes, 65536 by default
+-- Reads and writes are accounted in the read/write queries and bytes
+-- read/written statistics, fsyncs as other queries. A file should only be used
+-- by the thread opening it.
+function sysbench.file.open(path, opts)
+   opts = opts or {}
+
+   if type(path) ~= "string" then
+      error("file path must be a string", 2)
+   end
+
+   local f = ffi.C.sb_file_open(path, opts.mode or "sync", opts.direct or false,
+                                opts.create or false, opts.size or 0,
+                                opts.depth or 32, opts.max_len or 65536)
+   if f == nil then
+      error("failed to open '" .. path .. "'", 2)
+   end
+
+   return ffi.gc(f, ffi.C.sb_file_close)
+end
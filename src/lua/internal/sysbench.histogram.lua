@@ -32,17 +32,32 @@ sb_histogram_t *sb_histogram_new(size_t size, double range_min,
                                  double range_max);
 
 /*
-  Deallocate a histogram allocated with sb_histogram_new().
+  Allocate a new histogram and initialize it with sb_histogram_init_hdr().
+*/
+sb_histogram_t *sb_histogram_new_hdr(double range_min, double range_max,
+                                     unsigned int digits);
+
+/*
+  Deallocate a histogram allocated with sb_histogram_new() or
+  sb_histogram_new_hdr().
 */
 void sb_histogram_delete(sb_histogram_t *h);
 
 /* Update histogram with a given value. */
 void sb_histogram_update(sb_histogram_t *h, double value);
 
+/*
+  Calculate a single percentile value from all values recorded in a given
+  histogram so far.
+*/
+double sb_histogram_get_pct_value(sb_histogram_t *h, double percentile);
+
 /*
   Print a given histogram to stdout
 */
 void sb_histogram_print(sb_histogram_t *h);
+
+sb_histogram_t *sb_user_histogram_register(const char *name);
 ]]
 
 local histogram = {}
@@ -55,6 +70,11 @@ function histogram:print()
    ffi.C.sb_histogram_print(self)
 end
 
+-- Return the value at a given percentile (0-100) of all values recorded so far
+function histogram:percentile(pct)
+   return ffi.C.sb_histogram_get_pct_value(self, pct)
+end
+
 local histogram_mt = {
    __index = histogram,
    __tostring = '<sb_histogram>'
@@ -66,3 +86,35 @@ function sysbench.histogram.new(size, range_min, range_max)
 
    return ffi.gc(h, ffi.C.sb_histogram_delete)
 end
+
+-- Create an HDR histogram tracking values between range_min and range_max with
+-- a given number of significant decimal digits (3 by default). HDR histograms
+-- are updated by each thread without atomic operations.
+function sysbench.histogram.new_hdr(range_min, range_max, digits)
+   local h = ffi.C.sb_histogram_new_hdr(range_min, range_max, digits or 3)
+
+   if h == nil then
+      error("failed to create an HDR histogram", 2)
+   end
+
+   return ffi.gc(h, ffi.C.sb_histogram_delete)
+end
+
+-- Return a histogram with a given name shared by all threads. Like counters,
+-- histograms are registered by name, so calling this with the same name in
+-- all threads returns the same histogram. Values are latencies in
+-- milliseconds, their percentiles since the previous report are passed in
+-- stat.histograms[name] to report hooks and printed in the cumulative report.
+function sysbench.histogram.named(name)
+   if type(name) ~= "string" or name == "" then
+      error("histogram name must be a non-empty string", 2)
+   end
+
+   local h = ffi.C.sb_user_histogram_register(name)
+
+   if h == nil then
+      error("too many histograms", 2)
+   end
+
+   return h
+end
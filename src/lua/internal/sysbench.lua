@@ -20,31 +20,489 @@ ffi.cdef[[
 void sb_event_start(int thread_id);
 void sb_event_stop(int thread_id);
 bool sb_more_events(int thread_id);
+int sb_lua_barrier_wait(void);
+bool db_retry_wait(int thread_id, unsigned int attempt);
+bool db_retry_stats_enabled(void);
+void db_retry_event_start(int thread_id);
+void db_retry_event_stop(int thread_id, unsigned int attempts);
+void sb_event_stop_since(int thread_id, uint64_t start_ns);
+uint64_t sb_test_clock(void);
+bool sb_test_sleep(uint64_t ns);
+void sb_event_think(int thread_id);
+bool sb_think_time_enabled(void);
+uint64_t sb_think_time_ns(void);
+void sb_cycle_stop(uint64_t start_ns, uint64_t stop_ns);
+int log_timestamp_precision(void);
+void sb_latency_log_set_type(int thread_id, unsigned int type);
+int sb_user_counter_register(const char *name);
+void sb_user_counter_add(int thread_id, int id, uint64_t val);
+void sb_lua_profile_add(int kind, const char *key, uint64_t count);
 ]]
 
 -- ----------------------------------------------------------------------
--- Main event loop. This is a Lua version of sysbench.c:thread_run()
+-- Spans. sysbench.span.begin(name) and sysbench.span.finish() time a section
+-- of an event and record its latency in the histogram returned by
+-- sysbench.histogram.named(name). Spans may be nested, finish() completes the
+-- innermost open one. Each thread, or each virtual user with --virtual-users,
+-- has its own stack of open spans. Spans left open by a failed attempt of a
+-- restarted event are discarded without recording their latency.
 -- ----------------------------------------------------------------------
-function thread_run(thread_id)
+
+sysbench.span = {}
+
+-- Span histograms by name, cached to avoid registration on each begin()
+local span_histograms = {}
+
+-- Open spans of the current thread, 3 slots (name, histogram, start time) per
+-- span
+local spans = { n = 0 }
+
+local function span_stack()
+   local vu = sysbench.vuser
+
+   if vu == nil then
+      return spans
+   end
+
+   local s = vu.spans
+   if s == nil then
+      s = { n = 0 }
+      vu.spans = s
+   end
+
+   return s
+end
+
+local function spans_reset()
+   span_stack().n = 0
+end
+
+function sysbench.span.begin(name)
+   local h = span_histograms[name]
+
+   if h == nil then
+      if type(name) ~= "string" or name == "" then
+         error("span name must be a non-empty string", 2)
+      end
+
+      h = ffi.C.sb_user_histogram_register(name)
+      if h == nil then
+         error("too many histograms", 2)
+      end
+
+      span_histograms[name] = h
+   end
+
+   local s = span_stack()
+   local i = s.n * 3
+
+   s[i + 1] = name
+   s[i + 2] = h
+   s[i + 3] = tonumber(ffi.C.sb_test_clock())
+   s.n = s.n + 1
+end
+
+-- Complete the innermost open span and return its latency in milliseconds.
+-- If a name is given, it must match the name passed to begin().
+function sysbench.span.finish(name)
+   local now = tonumber(ffi.C.sb_test_clock())
+   local s = span_stack()
+   local n = s.n
+
+   if n == 0 then
+      error("no open span to finish", 2)
+   end
+
+   local i = (n - 1) * 3
+
+   if name ~= nil and name ~= s[i + 1] then
+      error(string.format("span '%s' is finished while '%s' is open",
+                          tostring(name), s[i + 1]), 2)
+   end
+
+   local ms = (now - s[i + 3]) / 1e6
+
+   s[i + 2]:update(ms)
+   s[i + 2] = nil
+   s.n = n - 1
+
+   return ms
+end
+
+-- ----------------------------------------------------------------------
+-- Execute a single event, restarting it on ignorable errors. Returns the
+-- value returned by event() and the number of attempts
+-- ----------------------------------------------------------------------
+local function execute_event(thread_id, vu)
+   local success, ret
+   local attempt = 1
+   repeat
+      spans_reset()
+      success, ret = pcall(event, thread_id, vu)
+
+      if not success then
+         if type(ret) == "table" and
+            ret.errcode == sysbench.error.RESTART_EVENT
+         then
+            if sysbench.hooks.before_restart_event then
+               sysbench.hooks.before_restart_event(ret)
+            end
+            -- Wait for the --db-retry-backoff delay, if any
+            if not ffi.C.db_retry_wait(thread_id, attempt) then
+               error(string.format("event failed after %d attempt(s) " ..
+                                      "(--db-retry-max), last error: %s",
+                                   attempt, ret.sql_errmsg or "unknown"),
+                     3)
+            end
+            attempt = attempt + 1
+         else
+            error(ret, 3) -- propagate unknown errors
+         end
+      end
+   until success
+
+   return ret, attempt
+end
+
+-- ----------------------------------------------------------------------
+-- Virtual users (see --virtual-users). Each one runs the event loop in its own
+-- coroutine, which yields a connection to wait for an asynchronous query
+-- started by sql_connection:query(), or a time to sleep until. Events of
+-- virtual users overlap, so each one keeps its own start time.
+-- ----------------------------------------------------------------------
+
+-- Virtual users of the current thread
+local vusers
+
+-- Called by sb_lua.c after thread_init(). Creates n virtual users and calls
+-- vuser_init(thread_id, vu) from the script, if defined, for each of them.
+-- vu is a table keeping the state of a virtual user, e.g. its connection, and
+-- is passed as the second argument to event(). vu.id is the number of the
+-- virtual user within the thread, starting from 0.
+function vusers_init(thread_id, n)
+   vusers = {}
+
+   for i = 1, n do
+      local vu = { id = i - 1 }
+      vusers[i] = vu
+
+      if type(vuser_init) == "function" then
+         vuser_init(thread_id, vu)
+      end
+   end
+end
+
+-- Called by sb_lua.c before thread_done(). Calls vuser_done(thread_id, vu)
+-- from the script, if defined, for each virtual user.
+function vusers_done(thread_id)
+   if type(vuser_done) == "function" then
+      for _, vu in ipairs(vusers) do
+         vuser_done(thread_id, vu)
+      end
+   end
+   vusers = nil
+end
+
+local function vuser_loop(thread_id, vu)
+   local think = ffi.C.sb_think_time_enabled()
+
    while ffi.C.sb_more_events(thread_id) do
-      ffi.C.sb_event_start(thread_id)
+      local start_ns = ffi.C.sb_test_clock()
+
+      -- Stop this virtual user if event() returns a value other than nil or
+      -- false
+      if execute_event(thread_id, vu) then
+         break
+      end
+
+      ffi.C.sb_event_stop_since(thread_id, start_ns)
 
-      local success, ret
-      repeat
-         success, ret = pcall(event, thread_id)
+      if think then
+         local stop_ns = ffi.C.sb_test_clock()
+         sysbench.sleep(tonumber(ffi.C.sb_think_time_ns()) / 1e9)
+         ffi.C.sb_cycle_stop(start_ns, stop_ns)
+      end
+   end
+end
+
+-- Binary heap of sleeping virtual users ordered by their wakeup time
+local function heap_push(heap, vu)
+   local i = #heap + 1
+   heap[i] = vu
+   while i > 1 do
+      local parent = math.floor(i / 2)
+      if heap[parent].wakeup_ns <= vu.wakeup_ns then
+         break
+      end
+      heap[i], heap[parent] = heap[parent], vu
+      i = parent
+   end
+end
+
+local function heap_pop(heap)
+   local top = heap[1]
+   local last = table.remove(heap)
+   local n = #heap
+   if n > 0 then
+      local i = 1
+      heap[1] = last
+      while true do
+         local child = i * 2
+         if child > n then
+            break
+         end
+         if child < n and heap[child + 1].wakeup_ns < heap[child].wakeup_ns then
+            child = child + 1
+         end
+         if heap[child].wakeup_ns >= last.wakeup_ns then
+            break
+         end
+         heap[i], heap[child] = heap[child], last
+         i = child
+      end
+   end
+   return top
+end
+
+local function vusers_run(thread_id)
+   local ready = {}             -- virtual users to resume
+   local waiting = {}           -- connection -> virtual user waiting on it
+   local cons = {}              -- connections with pending queries
+   local sleeping = {}          -- heap of sleeping virtual users
+
+   for i, vu in ipairs(vusers) do
+      vu.co = coroutine.create(vuser_loop)
+      ready[i] = vu
+   end
+
+   while true do
+      for i = 1, #ready do
+         local vu = ready[i]
+
+         sysbench.vuser = vu
+         local success, ret = coroutine.resume(vu.co, thread_id, vu)
+         sysbench.vuser = nil
 
          if not success then
-            if type(ret) == "table" and
-               ret.errcode == sysbench.error.RESTART_EVENT
-            then
-               if sysbench.hooks.before_restart_event then
-                  sysbench.hooks.before_restart_event(ret)
-               end
-            else
-               error(ret, 2) -- propagate unknown errors
+            error(ret, 0)
+         elseif coroutine.status(vu.co) == "dead" then
+            vu.co = nil
+         elseif type(ret) == "number" then
+            vu.wakeup_ns = ret
+            heap_push(sleeping, vu)
+         else
+            waiting[ret] = vu
+            cons[#cons + 1] = ret
+         end
+
+         ready[i] = nil
+      end
+
+      if #cons == 0 and #sleeping == 0 then
+         break
+      end
+
+      local now = tonumber(ffi.C.sb_test_clock())
+
+      while #sleeping > 0 and sleeping[1].wakeup_ns <= now do
+         ready[#ready + 1] = heap_pop(sleeping)
+      end
+
+      if #ready == 0 and #cons == 0 then
+         -- Wake up everyone at the end of the test
+         if not ffi.C.sb_test_sleep(sleeping[1].wakeup_ns - now) then
+            while #sleeping > 0 do
+               ready[#ready + 1] = heap_pop(sleeping)
             end
          end
-      until success
+      elseif #cons > 0 then
+         local timeout_ms = -1
+         if #ready > 0 then
+            timeout_ms = 0
+         elseif #sleeping > 0 then
+            timeout_ms = math.ceil((sleeping[1].wakeup_ns - now) / 1e6)
+         end
+
+         for _, con in ipairs(sysbench.sql.poll(cons, timeout_ms)) do
+            ready[#ready + 1] = waiting[con]
+            waiting[con] = nil
+         end
+
+         local n = 0
+         for i = 1, #cons do
+            if waiting[cons[i]] ~= nil then
+               n = n + 1
+               cons[n] = cons[i]
+            end
+         end
+         for i = n + 1, #cons do
+            cons[i] = nil
+         end
+      end
+   end
+end
+
+-- ----------------------------------------------------------------------
+-- LuaJIT profiler and trace aborts (see --lua-profile and --lua-trace-aborts).
+-- Samples and aborts are counted per state and merged by sb_lua.c when the
+-- state is closed.
+-- ----------------------------------------------------------------------
+
+-- Kinds of entries passed to sb_lua_profile_add(), see sb_lua.c
+local PROFILE_FUNC = 0
+local PROFILE_VMSTATE = 1
+local PROFILE_ABORT = 2
+
+-- Trace error messages of the bundled LuaJIT, used if jit.vmdef is missing
+local traceerr = {
+   [0] = "error thrown or hook called during recording",
+   "trace too short",
+   "trace too long",
+   "trace too deep",
+   "too many snapshots",
+   "blacklisted",
+   "retry recording",
+   "NYI: bytecode %d",
+   "leaving loop in root trace",
+   "inner loop in root trace",
+   "loop unroll limit reached",
+   "bad argument type",
+   "JIT compilation disabled for function",
+   "call unroll limit reached",
+   "down-recursion, restarting",
+   "NYI: unsupported variant of FastFunc %s",
+   "NYI: return to lower frame",
+   "store with nil or NaN key",
+   "missing metamethod",
+   "looping index lookup",
+   "NYI: mixed sparse/dense table",
+   "symbol not in cache",
+   "NYI: unsupported C type conversion",
+   "NYI: unsupported C function type",
+   "guard would always fail",
+   "too many PHIs",
+   "persistent type instability",
+   "failed to allocate mcode memory",
+   "machine code too long",
+   "hit mcode limit (retrying)",
+   "too many spill slots",
+   "inconsistent register allocation",
+   "NYI: cannot assemble IR instruction %d",
+   "NYI: PHI shuffling too complex",
+   "NYI: register coalescing too complex",
+}
+
+-- Sample counts by function and by VM state, abort counts by location and
+-- reason
+local profile_funcs
+local profile_vmstates
+local trace_aborts
+
+local function func_location(func, pc)
+   local info = require("jit.util").funcinfo(func, pc)
+
+   if info.loc ~= nil then
+      return info.loc
+   elseif info.ffid ~= nil then
+      return "builtin#" .. info.ffid
+   end
+
+   return tostring(func)
+end
+
+local function trace_abort_reason(err, info)
+   if type(err) ~= "number" then
+      return tostring(err)
+   end
+
+   local ok, vmdef = pcall(require, "jit.vmdef")
+   local fmt = (ok and vmdef.traceerr[err]) or traceerr[err]
+
+   if fmt == nil then
+      return "trace error " .. err
+   end
+
+   if type(info) == "function" then
+      info = func_location(info)
+   end
+
+   return (string.format(fmt, info))
+end
+
+local function trace_event(what, tr, func, pc, err, info)
+   if what == "abort" then
+      local key = func_location(func, pc) .. ": " ..
+         trace_abort_reason(err, info)
+      trace_aborts[key] = (trace_aborts[key] or 0) + 1
+   end
+end
+
+-- Called by sb_lua.c after thread_init(). The sampling profiler of LuaJIT
+-- can only run in one state at a time, so only the first thread is sampled.
+function profile_start(thread_id, profile, aborts)
+   if profile and thread_id == 0 then
+      local jp = require("jit.profile")
+
+      profile_funcs = {}
+      profile_vmstates = {}
+
+      jp.start("fi1", function (thread, samples, vmstate)
+                  local key = jp.dumpstack(thread, "F", 1)
+                  profile_funcs[key] = (profile_funcs[key] or 0) + samples
+                  profile_vmstates[vmstate] =
+                     (profile_vmstates[vmstate] or 0) + samples
+      end)
+   end
+
+   if aborts then
+      trace_aborts = {}
+      jit.attach(trace_event, "trace")
+   end
+end
+
+-- Called by sb_lua.c before thread_done(). Stops collection and passes the
+-- counts to sb_lua.c.
+function profile_stop()
+   local function flush(kind, counts)
+      for key, count in pairs(counts) do
+         ffi.C.sb_lua_profile_add(kind, key, count)
+      end
+   end
+
+   if profile_funcs ~= nil then
+      require("jit.profile").stop()
+      flush(PROFILE_FUNC, profile_funcs)
+      flush(PROFILE_VMSTATE, profile_vmstates)
+      profile_funcs = nil
+      profile_vmstates = nil
+   end
+
+   if trace_aborts ~= nil then
+      jit.attach(trace_event)
+      flush(PROFILE_ABORT, trace_aborts)
+      trace_aborts = nil
+   end
+end
+
+-- ----------------------------------------------------------------------
+-- Main event loop. This is a Lua version of sysbench.c:thread_run()
+-- ----------------------------------------------------------------------
+function thread_run(thread_id)
+   if vusers ~= nil then
+      return vusers_run(thread_id)
+   end
+
+   local retry_stats = ffi.C.db_retry_stats_enabled()
+   local think = ffi.C.sb_think_time_enabled()
+
+   while ffi.C.sb_more_events(thread_id) do
+      ffi.C.sb_event_start(thread_id)
+
+      if retry_stats then
+         ffi.C.db_retry_event_start(thread_id)
+      end
+
+      local ret, attempts = execute_event(thread_id)
 
       -- Stop the benchmark if event() returns a value other than nil or false
       if ret then
@@ -52,9 +510,76 @@ function thread_run(thread_id)
       end
 
       ffi.C.sb_event_stop(thread_id)
+
+      if retry_stats then
+         ffi.C.db_retry_event_stop(thread_id, attempts)
+      end
+
+      if think then
+         ffi.C.sb_event_think(thread_id)
+      end
+   end
+end
+
+-- Sleep for the given number of seconds, but not past the end of the test.
+-- Only suspends the current virtual user with --virtual-users.
+function sysbench.sleep(seconds)
+   local ns = seconds * 1e9
+
+   if ns <= 0 then
+      return
+   elseif sysbench.vuser ~= nil then
+      coroutine.yield(tonumber(ffi.C.sb_test_clock()) + ns)
+   else
+      ffi.C.sb_test_sleep(ns)
    end
 end
 
+-- Wait until all threads executing a parallel command (see
+-- sysbench.cmdline.PARALLEL_COMMAND) reach this point. Threads that have
+-- finished the command are not waited for. Does nothing when the command is
+-- executed by a single thread.
+function sysbench.barrier()
+   assert(ffi.C.sb_lua_barrier_wait() == 0, "sb_lua_barrier_wait() failed")
+end
+
+-- ----------------------------------------------------------------------
+-- User counters
+-- ----------------------------------------------------------------------
+
+sysbench.counter = {}
+
+local counter = {}
+
+-- Add a given value (1 by default) to the counter of the current thread
+function counter:add(val)
+   ffi.C.sb_user_counter_add(sysbench.tid, self.id, val or 1)
+end
+
+local counter_mt = {
+   __index = counter,
+   __tostring = function (c) return "<sb_counter " .. c.name .. ">" end
+}
+
+-- Return a per-thread counter with a given name. Counters are registered by
+-- name, so calling this with the same name from the main chunk of a script,
+-- which is executed by each thread, returns the same counter in all threads.
+-- Values aggregated over all threads since the previous report are passed in
+-- stat.counters[name] to report hooks and printed in the cumulative report.
+function sysbench.counter.new(name)
+   if type(name) ~= "string" or name == "" then
+      error("counter name must be a non-empty string", 2)
+   end
+
+   local id = ffi.C.sb_user_counter_register(name)
+
+   if id < 0 then
+      error("too many counters", 2)
+   end
+
+   return setmetatable({ id = id, name = name }, counter_mt)
+end
+
 -- ----------------------------------------------------------------------
 -- Hooks
 -- ----------------------------------------------------------------------
@@ -71,7 +596,8 @@ sysbench.hooks = {
 -- sysbench.hooks.report_intermediate = sysbench.report_csv
 function sysbench.report_csv(stat)
    local seconds = stat.time_interval
-   print(string.format("%.0f,%u,%4.2f," ..
+   print(string.format("%." .. ffi.C.log_timestamp_precision() ..
+                          "f,%u,%4.2f," ..
                           "%4.2f,%4.2f,%4.2f,%4.2f," ..
                           "%4.2f,%4.2f," ..
                           "%4.2f",
@@ -106,7 +632,7 @@ function sysbench.report_json(stat)
    local seconds = stat.time_interval
    io.write(([[
   {
-    "time": %4.0f,
+    "time": %4.]] .. ffi.C.log_timestamp_precision() .. [[f,
     "threads": %u,
     "tps": %4.2f,
     "qps": {
@@ -117,8 +643,7 @@ function sysbench.report_json(stat)
     },
     "latency": %4.2f,
     "errors": %4.2f,
-    "reconnects": %4.2f
-  }]]):format(
+    "reconnects": %4.2f]]):format(
             stat.time_total,
             stat.threads_running,
             stat.events / seconds,
@@ -130,6 +655,22 @@ function sysbench.report_json(stat)
             stat.errors / seconds,
             stat.reconnects / seconds
    ))
+
+   if stat.waits then
+      local names = {}
+      for name in pairs(stat.waits) do
+         names[#names + 1] = name
+      end
+      table.sort(names)
+      io.write(',\n    "waits": {')
+      for i, name in ipairs(names) do
+         io.write(('%s\n      "%s": %4.2f'):format(i > 1 and "," or "",
+                     (name:gsub('[\\"]', '\\%0')), stat.waits[name]))
+      end
+      io.write('\n    }')
+   end
+
+   io.write('\n  }')
 end
 
 -- Report statistics in the default human-readable format. You can use it if you
@@ -142,8 +683,9 @@ end
 -- end
 function sysbench.report_default(stat)
    local seconds = stat.time_interval
-   print(string.format("[ %.0fs ] thds: %u tps: %4.2f qps: %4.2f " ..
-                          "(r/w/o: %4.2f/%4.2f/%4.2f) lat (ms,%u%%): %4.2f " ..
+   print(string.format("[ %." .. ffi.C.log_timestamp_precision() ..
+                          "fs ] thds: %u tps: %4.2f qps: %4.2f " ..
+                          "(r/w/o: %4.2f/%4.2f/%4.2f) lat (ms,%g%%): %4.2f " ..
                           "err/s %4.2f reconn/s: %4.2f",
                        stat.time_total,
                        stat.threads_running,
@@ -152,7 +694,7 @@ function sysbench.report_default(stat)
                        stat.reads / seconds,
                        stat.writes / seconds,
                        stat.other / seconds,
-                       sysbench.opt.percentile,
+                       tonumber(sysbench.opt.percentile[1]) or 0,
                        stat.latency_pct * 1000,
                        stat.errors / seconds,
                        stat.reconnects / seconds
@@ -30,7 +30,35 @@ uint32_t sb_rand_gaussian(uint32_t, uint32_t);
 uint32_t sb_rand_special(uint32_t, uint32_t);
 uint32_t sb_rand_pareto(uint32_t, uint32_t);
 uint32_t sb_rand_zipfian(uint32_t, uint32_t);
+uint32_t sb_rand_latest(uint32_t, uint32_t);
+uint32_t sb_rand_empirical(uint32_t, uint32_t);
 uint32_t sb_rand_unique(void);
+uint64_t sb_rand_default64(uint64_t, uint64_t);
+uint64_t sb_rand_uniform64(uint64_t, uint64_t);
+uint64_t sb_rand_gaussian64(uint64_t, uint64_t);
+uint64_t sb_rand_special64(uint64_t, uint64_t);
+uint64_t sb_rand_pareto64(uint64_t, uint64_t);
+uint64_t sb_rand_zipfian64(uint64_t, uint64_t);
+uint64_t sb_rand_latest64(uint64_t, uint64_t);
+uint64_t sb_rand_empirical64(uint64_t, uint64_t);
+uint64_t sb_rand_unique64(void);
+uint64_t sb_rand_latest_next(uint64_t);
+void sb_rand_latest_insert(uint64_t);
+uint64_t sb_rand_key_sequential(void);
+uint64_t sb_rand_key_hashed(void);
+uint64_t sb_rand_key_snowflake(void);
+void sb_rand_uuid4(char *);
+void sb_rand_uuid7(char *);
+void sb_rand_ulid(char *);
+void sb_rand_fill_uint64(uint64_t *, size_t);
+void sb_rand_fill_default(uint64_t *, size_t, uint64_t, uint64_t);
+void sb_rand_fill_uniform(uint64_t *, size_t, uint64_t, uint64_t);
+void sb_rand_fill_gaussian(uint64_t *, size_t, uint64_t, uint64_t);
+void sb_rand_fill_special(uint64_t *, size_t, uint64_t, uint64_t);
+void sb_rand_fill_pareto(uint64_t *, size_t, uint64_t, uint64_t);
+void sb_rand_fill_zipfian(uint64_t *, size_t, uint64_t, uint64_t);
+void sb_rand_fill_latest(uint64_t *, size_t, uint64_t, uint64_t);
+void sb_rand_fill_empirical(uint64_t *, size_t, uint64_t, uint64_t);
 void sb_rand_str(const char *, char *);
 void sb_rand_varstr(char *, uint32_t, uint32_t);
 double sb_rand_uniform_double(void);
@@ -64,15 +92,144 @@ function sysbench.rand.zipfian(a, b)
    return ffi.C.sb_rand_zipfian(a, b)
 end
 
+function sysbench.rand.latest(a, b)
+   return ffi.C.sb_rand_latest(a, b)
+end
+
+function sysbench.rand.empirical(a, b)
+   return ffi.C.sb_rand_empirical(a, b)
+end
+
 function sysbench.rand.unique()
    return ffi.C.sb_rand_unique()
 end
 
+-- 64-bit versions of the above for ranges beyond 32 bits, e.g. row ids of
+-- tables with more than 2^32 rows. Values are returned as Lua numbers, which
+-- are exact up to 2^53.
+
+function sysbench.rand.default64(a, b)
+   return tonumber(ffi.C.sb_rand_default64(a, b))
+end
+
+function sysbench.rand.uniform64(a, b)
+   return tonumber(ffi.C.sb_rand_uniform64(a, b))
+end
+
+function sysbench.rand.gaussian64(a, b)
+   return tonumber(ffi.C.sb_rand_gaussian64(a, b))
+end
+
+function sysbench.rand.special64(a, b)
+   return tonumber(ffi.C.sb_rand_special64(a, b))
+end
+
+function sysbench.rand.pareto64(a, b)
+   return tonumber(ffi.C.sb_rand_pareto64(a, b))
+end
+
+function sysbench.rand.zipfian64(a, b)
+   return tonumber(ffi.C.sb_rand_zipfian64(a, b))
+end
+
+function sysbench.rand.latest64(a, b)
+   return tonumber(ffi.C.sb_rand_latest64(a, b))
+end
+
+function sysbench.rand.empirical64(a, b)
+   return tonumber(ffi.C.sb_rand_empirical64(a, b))
+end
+
+-- Unlike the above, returns a uint64_t cdata value like uniform_uint64(), as
+-- values span the whole 64-bit range
+function sysbench.rand.unique64()
+   return ffi.C.sb_rand_unique64()
+end
+
+-- Keys shared by all threads for the 'latest' distribution. latest_next()
+-- allocates a new key for insertion, starting from 'first', and
+-- latest_insert() reports a key as inserted, so that latest() favors it.
+
+function sysbench.rand.latest_next(first)
+   return tonumber(ffi.C.sb_rand_latest_next(first))
+end
+
+function sysbench.rand.latest_insert(key)
+   ffi.C.sb_rand_latest_insert(key)
+end
+
+-- Primary key generators, unique across threads. The 64-bit ones return
+-- uint64_t cdata values like unique64():
+--   key_sequential() - consecutive keys within each thread, each thread
+--                      inserting at its own position in the key space
+--   key_hashed()     - sequential keys passed through a bijection, i.e.
+--                      scattered over the whole 64-bit range
+--   key_snowflake()  - time-ordered: milliseconds, thread id and a
+--                      per-thread sequence number
+-- The 128-bit ones return 32 hex digits, which is accepted as is by the
+-- PostgreSQL UUID type and can be used in X'...' literals of binary strings:
+--   uuid4()          - random UUID
+--   uuid7()          - time-ordered UUID
+--   ulid()           - time-ordered ULID in the same hex form
+
+function sysbench.rand.key_sequential()
+   return ffi.C.sb_rand_key_sequential()
+end
+
+function sysbench.rand.key_hashed()
+   return ffi.C.sb_rand_key_hashed()
+end
+
+function sysbench.rand.key_snowflake()
+   return ffi.C.sb_rand_key_snowflake()
+end
+
+local key_buf = ffi.new("char[32]")
+
+for _, name in ipairs({"uuid4", "uuid7", "ulid"}) do
+   local gen = ffi.C["sb_rand_" .. name]
+
+   sysbench.rand[name] = function()
+      gen(key_buf)
+      return ffi.string(key_buf, 32)
+   end
+end
+
+-- Bulk versions: sysbench.rand.fill_<distribution>(n, a, b [, buf]) fills a
+-- uint64_t array with n values in the [a, b] range with a single FFI call and
+-- returns it. The array is 0-based, use tonumber() to convert its elements
+-- to Lua numbers. A new array is allocated unless 'buf' with room for at least
+-- n values is passed. sysbench.rand.fill_uint64(n [, buf]) does the same for
+-- uniform_uint64().
+
+function sysbench.rand.fill_uint64(n, buf)
+   buf = buf or ffi.new("uint64_t[?]", n)
+   ffi.C.sb_rand_fill_uint64(buf, n)
+   return buf
+end
+
+for _, dist in ipairs({"default", "uniform", "gaussian", "special", "pareto",
+                       "zipfian", "latest", "empirical"}) do
+   local fill = ffi.C["sb_rand_fill_" .. dist]
+
+   sysbench.rand["fill_" .. dist] = function(n, a, b, buf)
+      buf = buf or ffi.new("uint64_t[?]", n)
+      fill(buf, n, a, b)
+      return buf
+   end
+end
+
+-- Buffer reused by sysbench.rand.string(), grown as needed
+local str_buf, str_buflen = nil, 0
+
 function sysbench.rand.string(fmt)
    local buflen = #fmt
-   local buf = ffi.new("uint8_t[?]", buflen)
-   ffi.C.sb_rand_str(fmt, buf)
-   return ffi.string(buf, buflen)
+   if buflen > str_buflen then
+      str_buf = ffi.new("uint8_t[?]", buflen)
+      str_buflen = buflen
+   end
+   ffi.C.sb_rand_str(fmt, str_buf)
+   return ffi.string(str_buf, buflen)
 end
 
 function sysbench.rand.varstring(min_len, max_len)
@@ -0,0 +1,208 @@
+-- Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+-- ----------------------------------------------------------------------
+-- State shared by all threads
+-- ----------------------------------------------------------------------
+
+ffi = require("ffi")
+
+sysbench.shared = {}
+
+ffi.cdef[[
+typedef struct sb_shared_counter sb_shared_counter_t;
+typedef struct sb_shared_map sb_shared_map_t;
+typedef struct sb_shared_queue sb_shared_queue_t;
+
+sb_shared_counter_t *sb_shared_counter_register(const char *name);
+sb_shared_map_t *sb_shared_map_register(const char *name, uint64_t capacity);
+sb_shared_queue_t *sb_shared_queue_register(const char *name,
+                                            uint64_t capacity);
+
+int64_t sb_shared_counter_add(sb_shared_counter_t *c, int64_t val);
+int64_t sb_shared_counter_get(sb_shared_counter_t *c);
+void sb_shared_counter_set(sb_shared_counter_t *c, int64_t val);
+bool sb_shared_counter_cas(sb_shared_counter_t *c, int64_t old, int64_t val);
+
+bool sb_shared_map_get(sb_shared_map_t *m, uint64_t key, int64_t *val);
+bool sb_shared_map_set(sb_shared_map_t *m, uint64_t key, int64_t val);
+bool sb_shared_map_add(sb_shared_map_t *m, uint64_t key, int64_t val,
+                       int64_t *res);
+bool sb_shared_map_remove(sb_shared_map_t *m, uint64_t key);
+uint64_t sb_shared_map_count(sb_shared_map_t *m);
+
+bool sb_shared_queue_push(sb_shared_queue_t *q, int64_t val);
+bool sb_shared_queue_pop(sb_shared_queue_t *q, int64_t *val);
+uint64_t sb_shared_queue_size(sb_shared_queue_t *q);
+]]
+
+-- Output buffer for map and queue values, so no cdata is created per call
+local val_buf = ffi.new("int64_t[1]")
+
+local function check_name(name)
+   if type(name) ~= "string" or name == "" then
+      error("shared object name must be a non-empty string", 3)
+   end
+end
+
+local function check_capacity(capacity)
+   if type(capacity) ~= "number" or capacity < 1 or
+      capacity ~= math.floor(capacity)
+   then
+      error("capacity must be a positive integer", 3)
+   end
+end
+
+-- Counters
+
+local counter = {}
+
+-- Add a value (1 by default) and return the new value
+function counter:add(val)
+   return tonumber(ffi.C.sb_shared_counter_add(self, val or 1))
+end
+
+function counter:get()
+   return tonumber(ffi.C.sb_shared_counter_get(self))
+end
+
+function counter:set(val)
+   ffi.C.sb_shared_counter_set(self, val)
+end
+
+-- Set the counter to 'val' if it is equal to 'old', return true on success
+function counter:cas(old, val)
+   return ffi.C.sb_shared_counter_cas(self, old, val)
+end
+
+ffi.metatype('sb_shared_counter_t', {
+                __index = counter,
+                __tostring = function () return '<sb_shared_counter>' end
+})
+
+-- Maps
+
+local map = {}
+
+-- Return the value of a key, or nil if it is not set
+function map:get(key)
+   if ffi.C.sb_shared_map_get(self, key, val_buf) then
+      return tonumber(val_buf[0])
+   end
+   return nil
+end
+
+function map:set(key, val)
+   if not ffi.C.sb_shared_map_set(self, key, val) then
+      error("shared map is full", 2)
+   end
+end
+
+-- Add a value (1 by default) to a key, which is 0 if not set, and return the
+-- new value
+function map:add(key, val)
+   if not ffi.C.sb_shared_map_add(self, key, val or 1, val_buf) then
+      error("shared map is full", 2)
+   end
+   return tonumber(val_buf[0])
+end
+
+-- Remove a key, return false if it was not set
+function map:remove(key)
+   return ffi.C.sb_shared_map_remove(self, key)
+end
+
+-- Return the number of keys set
+function map:count()
+   return tonumber(ffi.C.sb_shared_map_count(self))
+end
+
+ffi.metatype('sb_shared_map_t', {
+                __index = map,
+                __tostring = function () return '<sb_shared_map>' end
+})
+
+-- Queues
+
+local queue = {}
+
+-- Append a value, return false if the queue is full
+function queue:push(val)
+   return ffi.C.sb_shared_queue_push(self, val)
+end
+
+-- Remove and return the oldest value, or nil if the queue is empty
+function queue:pop()
+   if ffi.C.sb_shared_queue_pop(self, val_buf) then
+      return tonumber(val_buf[0])
+   end
+   return nil
+end
+
+function queue:size()
+   return tonumber(ffi.C.sb_shared_queue_size(self))
+end
+
+ffi.metatype('sb_shared_queue_t', {
+                __index = queue,
+                __tostring = function () return '<sb_shared_queue>' end
+})
+
+-- Shared objects are registered by name like counters and named histograms,
+-- i.e. calling a constructor with the same name in all threads returns the
+-- same object. All operations are lock-free. Values are 64-bit integers, map
+-- keys are non-negative integers.
+
+-- Return an atomic counter with a given name, initially 0
+function sysbench.shared.counter(name)
+   check_name(name)
+
+   local c = ffi.C.sb_shared_counter_register(name)
+   if c == nil then
+      error("failed to create shared counter '" .. name .. "'", 2)
+   end
+
+   return c
+end
+
+-- Return a map with a given name holding up to 'capacity' distinct keys.
+-- Removed keys still count towards the capacity.
+function sysbench.shared.map(name, capacity)
+   check_name(name)
+   check_capacity(capacity)
+
+   local m = ffi.C.sb_shared_map_register(name, capacity)
+   if m == nil then
+      error("failed to create shared map '" .. name .. "'", 2)
+   end
+
+   return m
+end
+
+-- Return a FIFO queue with a given name holding at least 'capacity' values,
+-- i.e. the capacity is rounded up to a power of 2 minus 1. Any number of
+-- threads can push and pop values.
+function sysbench.shared.queue(name, capacity)
+   check_name(name)
+   check_capacity(capacity)
+
+   local q = ffi.C.sb_shared_queue_register(name, capacity)
+   if q == nil then
+      error("failed to create shared queue '" .. name .. "'", 2)
+   end
+
+   return q
+end
@@ -68,6 +68,8 @@ typedef enum
   SB_CNT_RECONNECT,
   SB_CNT_BYTES_READ,
   SB_CNT_BYTES_WRITTEN,
+  SB_CNT_NET_SENT,
+  SB_CNT_NET_RECEIVED,
   SB_CNT_MAX
 } sb_counter_type;
 
@@ -99,6 +101,7 @@ typedef struct
   sql_statement  *statement;    /* Pointer to prepared statement (if used) */
   void           *ptr;          /* Pointer to driver-specific data */
   sql_row        row;           /* Last fetched row */
+  uint32_t       nvalues;       /* Allocated length of row.values */
 } sql_result;
 
 typedef enum
@@ -115,7 +118,8 @@ typedef enum
   SQL_TYPE_DATETIME,
   SQL_TYPE_TIMESTAMP,
   SQL_TYPE_CHAR,
-  SQL_TYPE_VARCHAR
+  SQL_TYPE_VARCHAR,
+  SQL_TYPE_BLOB
 } sql_bind_type_t;
 
 typedef struct
@@ -133,23 +137,56 @@ int db_destroy(sql_driver *drv);
 sql_connection *db_connection_create(sql_driver * drv);
 int db_connection_close(sql_connection *con);
 int db_connection_reconnect(sql_connection *con);
+int db_connection_reset(sql_connection *con);
 void db_connection_free(sql_connection *con);
 
+sql_connection *db_pool_checkout(sql_driver *drv);
+int db_pool_return(sql_connection *con);
+
 int db_bulk_insert_init(sql_connection *, const char *, size_t);
 int db_bulk_insert_next(sql_connection *, const char *, size_t);
 int db_bulk_insert_done(sql_connection *);
 
+bool db_copy_supported(sql_connection *);
+int db_copy_init(sql_connection *, const char *, size_t);
+int db_copy_next(sql_connection *, const char *, size_t);
+int db_copy_done(sql_connection *);
+int db_copy_rows(sql_connection *, const char *, size_t, const char *,
+                 uint64_t, uint64_t, uint64_t);
+
 sql_result *db_query(sql_connection *con, const char *query, size_t len);
 
 sql_row *db_fetch_row(sql_result *rs);
+int64_t db_count_rows(sql_result *rs);
+int64_t db_sum_column(sql_result *rs, uint32_t col, double *sum);
+int64_t db_check_sorted(sql_result *rs, uint32_t col, bool strict,
+                        bool *sorted);
 
 sql_statement *db_prepare(sql_connection *con, const char *query, size_t len);
 int db_bind_param(sql_statement *stmt, sql_bind *params, size_t len);
 int db_bind_result(sql_statement *stmt, sql_bind *results, size_t len);
 sql_result *db_execute(sql_statement *stmt);
+int db_batch_add(sql_statement *stmt);
+sql_result *db_execute_batch(sql_statement *stmt);
 int db_close(sql_statement *stmt);
+int db_stmt_set_label(sql_statement *stmt, const char *label);
+
+typedef struct db_stmt_stat sql_txn_stat;
+sql_txn_stat *db_txn_stat_get(const char *label);
+uint64_t db_txn_stat_start(void);
+void db_txn_stat_stop(sql_txn_stat *stat, uint64_t start, bool rolled_back);
+sql_txn_stat *db_query_stat_get(const char *label);
+void db_query_stat_stop(sql_txn_stat *stat, uint64_t start, bool error);
 
 int db_free_results(sql_result *);
+
+bool db_async_available(sql_connection *con);
+int db_query_async(sql_connection *con, const char *query, size_t len);
+int db_async_poll(sql_connection **cons, size_t n, int timeout_ms, int *done);
+sql_result *db_async_result(sql_connection *con);
+
+int db_pipeline_begin(sql_connection *con);
+int db_pipeline_end(sql_connection *con);
 ]]
 
 local sql_driver = ffi.typeof('sql_driver *')
@@ -174,7 +211,8 @@ sysbench.sql.type =
       DATETIME = ffi.C.SQL_TYPE_DATETIME,
       TIMESTAMP = ffi.C.SQL_TYPE_TIMESTAMP,
       CHAR = ffi.C.SQL_TYPE_CHAR,
-      VARCHAR = ffi.C.SQL_TYPE_VARCHAR
+      VARCHAR = ffi.C.SQL_TYPE_VARCHAR,
+      BLOB = ffi.C.SQL_TYPE_BLOB
    }
 
 -- Initialize a given SQL driver and return a handle to it to create
@@ -199,6 +237,18 @@ function driver_methods.connect(self)
    return ffi.gc(con, ffi.C.db_connection_free)
 end
 
+-- Check out a connection from the connection pool shared by all threads,
+-- waiting for one to be returned if all --db-pool-size connections are in use.
+-- Pooled connections are not closed when garbage-collected, return them with
+-- sql_connection:pool_return() instead.
+function driver_methods.pool_checkout(self)
+   local con = ffi.C.db_pool_checkout(self)
+   if con == nil then
+      error("connection pool checkout failed", 2)
+   end
+   return con
+end
+
 function driver_methods.name(self)
    return ffi.string(self.sname)
 end
@@ -222,6 +272,17 @@ function connection_methods.reconnect(self)
    return assert(ffi.C.db_connection_reconnect(self) == 0)
 end
 
+-- Reset session state without reconnecting. Prepared statements of the
+-- connection must be prepared again afterwards.
+function connection_methods.reset(self)
+   return assert(ffi.C.db_connection_reset(self) == 0)
+end
+
+-- Return a connection checked out with sql_driver:pool_checkout() to the pool
+function connection_methods.pool_return(self)
+   return assert(ffi.C.db_pool_return(self) == 0)
+end
+
 function connection_methods.check_error(self, rs, query)
    if rs ~= nil or self.error == sysbench.sql.error.NONE then
       return rs
@@ -268,10 +329,60 @@ function connection_methods.check_error(self, rs, query)
 end
 
 function connection_methods.query(self, query)
+   -- Let other virtual users run while waiting for the result (see
+   -- --virtual-users)
+   if sysbench.vuser ~= nil and ffi.C.db_async_available(self) then
+      self:query_async(query)
+      coroutine.yield(self)
+      return self:async_result()
+   end
+
    local rs = ffi.C.db_query(self, query, #query)
    return self:check_error(rs, query)
 end
 
+-- Queries being executed asynchronously, used to keep query strings from being
+-- garbage-collected until the corresponding query is complete
+local async_queries = {}
+
+-- Start executing a query asynchronously, i.e. without waiting for the
+-- result. Use sysbench.sql.poll() to drive pending queries to completion, and
+-- sql_connection:async_result() to get the result once complete.
+function connection_methods.query_async(self, query)
+   if ffi.C.db_query_async(self, query, #query) ~= 0 then
+      self:check_error(nil, query)
+      error("db_query_async() failed", 2)
+   end
+   async_queries[self] = query
+end
+
+-- Return the result of a completed asynchronous query in the same way
+-- sql_connection:query() does for synchronous ones
+function connection_methods.async_result(self)
+   local query = async_queries[self]
+   async_queries[self] = nil
+   return self:check_error(ffi.C.db_async_result(self), query)
+end
+
+-- Start a group of statements to be sent to the server without waiting for
+-- individual results, if supported and enabled by the driver (e.g. with
+-- --pgsql-pipeline or --mysql-pipeline). Statements executed until sql_connection:pipeline_end()
+-- return no results. Otherwise statements are executed as usual.
+function connection_methods.pipeline_begin(self)
+   if ffi.C.db_pipeline_begin(self) ~= 0 then
+      self:check_error(nil)
+      error("db_pipeline_begin() failed", 2)
+   end
+end
+
+-- Wait for results of all statements in the current group
+function connection_methods.pipeline_end(self)
+   if ffi.C.db_pipeline_end(self) ~= 0 then
+      self:check_error(nil)
+      error("db_pipeline_end() failed", 2)
+   end
+end
+
 function connection_methods.bulk_insert_init(self, query)
    return assert(ffi.C.db_bulk_insert_init(self, query, #query) == 0,
                  "db_bulk_insert_init() failed")
@@ -287,6 +398,44 @@ function connection_methods.bulk_insert_done(self)
                  "db_bulk_insert_done() failed")
 end
 
+-- Return true if the driver supports bulk loading in the server's native
+-- format with copy_init() / copy_next() / copy_done()
+function connection_methods.copy_supported(self)
+   return ffi.C.db_copy_supported(self)
+end
+
+-- Start a bulk load with a driver-specific query, e.g. 'COPY t FROM STDIN'
+-- for PostgreSQL. Rows passed to copy_next() must be in the format expected by
+-- the server (tab-separated text for COPY), without a trailing newline.
+function connection_methods.copy_init(self, query)
+   return assert(ffi.C.db_copy_init(self, query, #query) == 0,
+                 "db_copy_init() failed")
+end
+
+function connection_methods.copy_next(self, row)
+   return assert(ffi.C.db_copy_next(self, row, #row) == 0,
+                 "db_copy_next() failed")
+end
+
+function connection_methods.copy_done(self)
+   return assert(ffi.C.db_copy_done(self) == 0,
+                 "db_copy_done() failed")
+end
+
+-- Bulk load nrows rows generated in C from a template with a driver-specific
+-- query, e.g. 'COPY t FROM STDIN' for PostgreSQL or 'LOAD DATA LOCAL INFILE
+-- ...' for MySQL. In the template, '%n' is replaced with the row number
+-- (starting from first, 1 by default), '%r' with a random number between 1 and
+-- max, and '#' / '@' with random digits / letters as in sysbench.rand.string().
+-- Returns false if bulk loading is not supported by the driver or disabled on
+-- the server.
+function connection_methods.copy_rows(self, query, fmt, nrows, max, first)
+   local rc = ffi.C.db_copy_rows(self, query, #query, fmt, first or 1, nrows,
+                                 max or 1)
+   assert(rc >= 0, "db_copy_rows() failed")
+   return rc == 0
+end
+
 function connection_methods.prepare(self, query)
    local stmt = ffi.C.db_prepare(self, query, #query)
    if stmt == nil then
@@ -308,6 +457,40 @@ function connection_methods.query_row(self, query)
    return unpack(rs:fetch_row(), 1, rs.nfields)
 end
 
+-- Drive asynchronous queries started with sql_connection:query_async() on the
+-- given array of connections until at least one of them completes, or until
+-- the timeout in milliseconds expires (no timeout by default). This allows a
+-- single thread to keep many connections busy. Returns an array of connections
+-- with completed queries, which may be empty on timeout.
+local poll_arrays = {}
+function sysbench.sql.poll(cons, timeout_ms)
+   local n = #cons
+   local arrays = poll_arrays[n]
+
+   if arrays == nil then
+      arrays = { cons = ffi.new("sql_connection *[?]", n),
+                 done = ffi.new("int[?]", n) }
+      poll_arrays[n] = arrays
+   end
+
+   for i = 1, n do
+      arrays.cons[i - 1] = cons[i]
+   end
+
+   local ndone = ffi.C.db_async_poll(arrays.cons, n, timeout_ms or -1,
+                                     arrays.done)
+   if ndone < 0 then
+      error("db_async_poll() failed", 2)
+   end
+
+   local res = {}
+   for i = 0, ndone - 1 do
+      res[i + 1] = cons[arrays.done[i] + 1]
+   end
+
+   return res
+end
+
 -- sql_connection metatable
 local connection_mt = {
    __index = connection_methods,
@@ -316,61 +499,109 @@ local connection_mt = {
 }
 ffi.metatype("sql_connection", connection_mt)
 
--- sql_param
-local sql_param = {}
-function sql_param.set(self, value)
-   local sql_type = sysbench.sql.type
-   local btype = self.type
+-- sql_param. Parameters get typed methods at bind_create() time, so setters
+-- do not dispatch on the parameter type and do not create Lua objects on each
+-- call. set() accepts nil for all types to bind a NULL value.
+
+local function param_set_null(self)
+   self.is_null[0] = true
+end
 
-   if (value == nil) then
-      self.is_null[0] = true
-      return
+-- Integer parameters
+local int_param = {}
+
+function int_param.set(self, value)
+   if value == nil then
+      return param_set_null(self)
    end
 
    self.is_null[0] = false
+   self.buffer[0] = value
+end
 
-   if btype == sql_type.TINYINT or
-      btype == sql_type.SMALLINT or
-      btype == sql_type.INT or
-      btype == sql_type.BIGINT
-   then
-      self.buffer[0] = value
-   elseif btype == sql_type.FLOAT or
-      btype == sql_type.DOUBLE
-   then
-      self.buffer[1] = value
-   elseif btype == sql_type.CHAR or
-      btype == sql_type.VARCHAR
-   then
-      local len = #value
-      len = self.max_len < len and self.max_len or len
-      ffi.copy(self.buffer, value, len)
-      self.data_len[0] = len
-   else
-      error("Unsupported argument type: " .. btype, 2)
+function int_param.set_int(self, value)
+   self.is_null[0] = false
+   self.buffer[0] = value
+end
+
+-- Set a random number between a and b generated by 'dist', which is one of
+-- the sysbench.rand functions taking (a, b) and defaults to
+-- sysbench.rand.default
+function int_param.set_rand_int(self, a, b, dist)
+   self.is_null[0] = false
+   self.buffer[0] = (dist or sysbench.rand.default)(a, b)
+end
+
+-- Floating point parameters
+local double_param = {}
+
+double_param.set = int_param.set
+double_param.set_double = int_param.set_int
+
+-- String parameters
+local str_param = {}
+
+function str_param.set_str(self, value)
+   local len = #value
+   len = self.max_len < len and self.max_len or len
+   ffi.copy(self.buffer, value, len)
+   self.data_len[0] = len
+   self.is_null[0] = false
+end
+
+function str_param.set(self, value)
+   if value == nil then
+      return param_set_null(self)
    end
+
+   str_param.set_str(self, value)
 end
 
-function sql_param.set_rand_str(self, fmt)
-   local sql_type = sysbench.sql.type
-   local btype = self.type
+-- Fill the buffer from a template in the sysbench.rand.string() format
+-- directly in C, i.e. without creating a Lua string
+function str_param.set_str_from_template(self, fmt)
+   local len = #fmt
 
+   if len > self.max_len then
+      error(string.format("template is longer than the parameter (%d > %d)",
+                          len, self.max_len), 2)
+   end
+
+   ffi.C.sb_rand_str(fmt, self.buffer)
+   self.data_len[0] = len
    self.is_null[0] = false
+end
 
-   if btype == sql_type.CHAR or
-      btype == sql_type.VARCHAR
-   then
-      local len = #fmt
-      len = self.max_len < len and self.max_len or len
-      ffi.C.sb_rand_str(fmt, self.buffer)
-      self.data_len[0] = len
-   else
-      error("Unsupported argument type: " .. btype, 2)
+str_param.set_rand_str = str_param.set_str_from_template
+
+-- BLOB parameters only have a length. Their values are generated in C by the
+-- driver when the statement is executed, and sent in chunks where possible.
+local blob_param = {}
+
+function blob_param.set_len(self, len)
+   self.data_len[0] = len
+   self.is_null[0] = false
+end
+
+function blob_param.set(self, len)
+   if len == nil then
+      return param_set_null(self)
    end
+
+   blob_param.set_len(self, len)
 end
 
-sql_param.__index = sql_param
-sql_param.__tostring = function () return '<sql_param>' end
+-- Set a random length between a and b generated by 'dist' like
+-- int_param.set_rand_int()
+function blob_param.set_rand_len(self, a, b, dist)
+   self.data_len[0] = (dist or sysbench.rand.default)(a, b)
+   self.is_null[0] = false
+end
+
+for _, mt in ipairs({int_param, double_param, str_param, blob_param}) do
+   mt.__index = mt
+   mt.__tostring = function () return '<sql_param>' end
+end
 
 -- sql_statement methods
 local statement_methods = {}
@@ -378,28 +609,35 @@ local statement_methods = {}
 function statement_methods.bind_create(self, btype, max_len)
    local sql_type = sysbench.sql.type
 
-   local param = setmetatable({}, sql_param)
+   local param
 
    if btype == sql_type.TINYINT or
       btype == sql_type.SMALLINT or
       btype == sql_type.INT or
       btype == sql_type.BIGINT
    then
+      param = setmetatable({}, int_param)
       param.type = sql_type.BIGINT
       param.buffer = ffi.new('int64_t[1]')
       param.max_len = 8
    elseif btype == sql_type.FLOAT or
       btype == sql_type.DOUBLE
    then
+      param = setmetatable({}, double_param)
       param.type = sql_type.DOUBLE
       param.buffer = ffi.new('double[1]')
       param.max_len = 8
    elseif btype == sql_type.CHAR or
       btype == sql_type.VARCHAR
    then
+      param = setmetatable({}, str_param)
       param.type = sql_type.VARCHAR
       param.buffer = ffi.new('char[?]', max_len)
       param.max_len = max_len
+   elseif btype == sql_type.BLOB then
+      param = setmetatable({}, blob_param)
+      param.type = sql_type.BLOB
+      param.max_len = 0
    else
       error("Unsupported argument type: " .. btype, 2)
    end
@@ -433,10 +671,31 @@ function statement_methods.execute(self)
    return self.connection:check_error(rs, '<prepared statement>')
 end
 
+-- Add the current parameter values as a row of the statement batch. All rows
+-- are sent with a single statement_methods.execute_batch() call, using array
+-- binding (MariaDB) or pipelining (PostgreSQL) where the driver supports it.
+function statement_methods.add_batch(self)
+   if ffi.C.db_batch_add(self) ~= 0 then
+      error("db_batch_add() failed", 2)
+   end
+end
+
+-- Execute the statement for all rows added with add_batch() and empty the
+-- batch. The batch is accounted as a single query, result sets are discarded.
+function statement_methods.execute_batch(self)
+   local rs = ffi.C.db_execute_batch(self)
+   return self.connection:check_error(rs, '<prepared statement batch>')
+end
+
 function statement_methods.close(self)
    return ffi.C.db_close(self)
 end
 
+-- Group this statement under a given label in --db-stmt-stats reports
+function statement_methods.set_label(self, label)
+   return ffi.C.db_stmt_set_label(self, tostring(label))
+end
+
 -- sql_statement metatable
 local statement_mt = {
    __index = statement_methods,
@@ -475,6 +734,62 @@ function result_methods.fetch_row(self)
    return res
 end
 
+-- Same as fetch_row(), but returns an sql_row view of the row, so no Lua
+-- strings are created unless requested with row:get(). The view is reused by
+-- subsequent calls and is only valid until the next row is fetched or the
+-- result set is freed.
+function result_methods.fetch_row_view(self)
+   local row = ffi.C.db_fetch_row(self)
+
+   if row == nil then
+      return nil
+   end
+
+   return row
+end
+
+-- Fetches the remaining rows from a result set in C and returns their number
+function result_methods.count_rows(self)
+   local n = ffi.C.db_count_rows(self)
+
+   if n < 0 then
+      error("db_count_rows() failed", 2)
+   end
+
+   return tonumber(n)
+end
+
+local sum_buf = ffi.new("double[1]")
+
+-- Fetches the remaining rows from a result set in C and returns the sum of
+-- values in the column specified by a 1-based index, and the number of rows.
+-- NULL values are skipped.
+function result_methods.sum_column(self, col)
+   local n = ffi.C.db_sum_column(self, col - 1, sum_buf)
+
+   if n < 0 then
+      error("db_sum_column() failed", 2)
+   end
+
+   return sum_buf[0], tonumber(n)
+end
+
+local sorted_buf = ffi.new("bool[1]")
+
+-- Fetches the remaining rows from a result set in C and returns whether values
+-- in the column specified by a 1-based index are in ascending byte order, or
+-- strictly ascending if 'strict' is true, and the number of rows
+function result_methods.check_sorted(self, col, strict)
+   local n = ffi.C.db_check_sorted(self, col - 1, strict and true or false,
+                                   sorted_buf)
+
+   if n < 0 then
+      error("db_check_sorted() failed", 2)
+   end
+
+   return sorted_buf[0], tonumber(n)
+end
+
 function result_methods.free(self)
    return assert(ffi.C.db_free_results(self) == 0, "db_free_results() failed")
 end
@@ -487,6 +802,111 @@ local result_mt = {
 }
 ffi.metatype("sql_result", result_mt)
 
+-- sql_row methods. Column indexes are 1-based and must not exceed the number
+-- of fields in the result set.
+local row_methods = {}
+
+-- Returns true if a column value is NULL
+function row_methods.is_null(self, i)
+   return self.values[i-1].ptr == nil
+end
+
+-- Returns a pointer to a column value, or nil for NULL values. Values are not
+-- necessarily NUL-terminated, use row:len() to get the length.
+function row_methods.data(self, i)
+   local ptr = self.values[i-1].ptr
+   if ptr == nil then
+      return nil
+   end
+   return ptr
+end
+
+-- Returns the length of a column value
+function row_methods.len(self, i)
+   return tonumber(self.values[i-1].len)
+end
+
+-- Returns a column value as a Lua string, or nil for NULL values
+function row_methods.get(self, i)
+   local val = self.values[i-1]
+   if val.ptr == nil then
+      return nil
+   end
+   return ffi.string(val.ptr, val.len)
+end
+
+-- sql_row metatable
+local row_mt = {
+   __index = row_methods,
+   __tostring = function() return '<sql_row>' end,
+}
+ffi.metatype("sql_row", row_mt)
+
+-- sql_txn_stat methods
+local txn_stat_methods = {}
+
+-- Returns the start time of a transaction to pass to txn_stat:stop()
+function txn_stat_methods.start(self)
+   return ffi.C.db_txn_stat_start()
+end
+
+-- Accounts a transaction started at the time returned by txn_stat:start().
+-- Transactions with rolled_back set are counted as rollbacks.
+function txn_stat_methods.stop(self, start, rolled_back)
+   ffi.C.db_txn_stat_stop(self, start, rolled_back and true or false)
+end
+
+-- sql_txn_stat metatable
+local txn_stat_mt = {
+   __index = txn_stat_methods,
+   __tostring = function() return '<sql_txn_stat>' end,
+}
+ffi.metatype("sql_txn_stat", txn_stat_mt)
+
+-- Returns statistics for a given transaction type, which are reported in the
+-- "per-transaction statistics" section at the end of a run. Statistics with
+-- the same label are shared by all threads. Must be called after
+-- sysbench.sql.driver().
+function sysbench.sql.txn_stat(label)
+   local stat = ffi.C.db_txn_stat_get(tostring(label))
+
+   if stat == nil then
+      error("Failed to create statistics for transaction " .. tostring(label),
+            2)
+   end
+
+   return stat
+end
+
+-- Query statistics, i.e. sql_txn_stat wrappers accounting into the
+-- "per-statement statistics" section
+local query_stat_methods = {}
+
+function query_stat_methods.start(self)
+   return ffi.C.db_txn_stat_start()
+end
+
+-- Accounts a query started at the time returned by query_stat:start().
+-- Queries with failed set are counted as errors.
+function query_stat_methods.stop(self, start, failed)
+   ffi.C.db_query_stat_stop(self.stat, start, failed and true or false)
+end
+
+local query_stat_mt = {
+   __index = query_stat_methods,
+   __tostring = function() return '<sql_query_stat>' end,
+}
+
+-- Returns statistics for queries timed by the script, e.g. queries executed
+-- with sql_connection:query() grouped by fingerprint, which are reported in
+-- the "per-statement statistics" section with --db-stmt-stats. Statistics
+-- with the same label are shared by all threads, and are not collected when
+-- --db-stmt-stats is off. Must be called after sysbench.sql.driver().
+function sysbench.sql.query_stat(label)
+   return setmetatable({ stat = ffi.C.db_query_stat_get(tostring(label)) },
+                       query_stat_mt)
+end
+
 -- error codes
 sysbench.sql.error = {}
 sysbench.sql.error.NONE = ffi.C.DB_ERROR_NONE
@@ -0,0 +1,298 @@
+#!/usr/bin/env sysbench
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+-- -----------------------------------------------------------------------------
+-- Job queue benchmark. The first --jq_producers threads enqueue jobs by
+-- inserting rows into the sbtest_jobs table, the other threads consume them:
+-- each consumer event claims up to --jq_dequeue_batch of the oldest jobs and
+-- completes them in a single transaction. Jobs are claimed with one of:
+--
+--   skip_locked      - SELECT ... FOR UPDATE SKIP LOCKED, followed by a
+--                      DELETE or UPDATE of the claimed jobs
+--   delete_returning - a single DELETE or UPDATE ... RETURNING of the jobs
+--                      selected by a FOR UPDATE SKIP LOCKED subquery
+--                      (PostgreSQL and SQLite)
+--
+-- Completed jobs are deleted, or with --jq_complete=update marked as done and
+-- left in the table, so that claims have to skip an ever-growing number of
+-- completed jobs, as queues with deferred cleanup do. SQLite has no row locks,
+-- so FOR UPDATE SKIP LOCKED is omitted with it.
+--
+-- The following is reported, per interval and in total:
+--
+--   jq_enqueued      - enqueued jobs
+--   jq_completed     - completed jobs
+--   jq_empty_claims  - claims that found no jobs to complete
+--   job_latency      - milliseconds from the enqueue of a job to its
+--                      completion, at the --percentile values, for jobs
+--                      enqueued during the run
+--
+-- and the latency of enqueue and claim transactions in the "per-transaction
+-- statistics" section.
+-- -----------------------------------------------------------------------------
+
+if sysbench.cmdline.command == nil then
+   error("Command is required. Supported commands: prepare, run, cleanup, " ..
+            "help")
+end
+
+sysbench.cmdline.options = {
+   jq_producers =
+      {"Number of threads enqueuing jobs, other threads consume them", 1},
+   jq_producer_rate =
+      {"Jobs enqueued per second by each producer, 0 for no limit", 0},
+   jq_enqueue_batch =
+      {"Number of jobs inserted per enqueue transaction", 1},
+   jq_dequeue_batch =
+      {"Maximum number of jobs claimed per consumer transaction", 1},
+   jq_claim =
+      {"Claim method: 'skip_locked' or 'delete_returning' (PostgreSQL and " ..
+          "SQLite)", "skip_locked"},
+   jq_complete =
+      {"Completion of claimed jobs: 'delete' or 'update' to mark them as " ..
+          "done", "delete"},
+   jq_poll_interval =
+      {"Milliseconds a consumer sleeps after finding no jobs", 1},
+   jq_payload_size =
+      {"Length of job payloads", 100},
+   jq_backlog =
+      {"Number of jobs enqueued by prepare", 0},
+   mysql_storage_engine =
+      {"Storage engine, if MySQL is used", "innodb"}
+}
+
+local function check_options(drv)
+   for _, opt in ipairs({"jq_producers", "jq_producer_rate",
+                         "jq_poll_interval", "jq_payload_size",
+                         "jq_backlog"}) do
+      if sysbench.opt[opt] < 0 then
+         error("Invalid value for --" .. opt .. ": " .. sysbench.opt[opt])
+      end
+   end
+
+   for _, opt in ipairs({"jq_enqueue_batch", "jq_dequeue_batch"}) do
+      if sysbench.opt[opt] < 1 then
+         error("Invalid value for --" .. opt .. ": " .. sysbench.opt[opt])
+      end
+   end
+
+   if sysbench.opt.jq_claim ~= "skip_locked" and
+      sysbench.opt.jq_claim ~= "delete_returning"
+   then
+      error("Invalid value for --jq_claim: " .. sysbench.opt.jq_claim)
+   end
+
+   if sysbench.opt.jq_claim == "delete_returning" and drv:name() == "mysql"
+   then
+      error("--jq_claim=delete_returning is not supported by mysql")
+   end
+
+   if sysbench.opt.jq_complete ~= "delete" and
+      sysbench.opt.jq_complete ~= "update"
+   then
+      error("Invalid value for --jq_complete: " .. sysbench.opt.jq_complete)
+   end
+
+   -- Template of job payloads for sysbench.rand.string()
+   payload_fmt = string.rep("@", sysbench.opt.jq_payload_size)
+end
+
+function prepare()
+   local drv = sysbench.sql.driver()
+   local con = drv:connect()
+   local id_def, engine_def = "", ""
+
+   check_options(drv)
+
+   if drv:name() == "mysql" then
+      id_def = "BIGINT NOT NULL AUTO_INCREMENT"
+      engine_def = "/*! ENGINE = " .. sysbench.opt.mysql_storage_engine .. " */"
+   elseif drv:name() == "pgsql" then
+      id_def = "BIGSERIAL"
+   else
+      id_def = "INTEGER NOT NULL"
+   end
+
+   print("Creating table 'sbtest_jobs'...")
+   con:query(string.format([[
+CREATE TABLE sbtest_jobs (
+  id %s,
+  created BIGINT NOT NULL,
+  done INTEGER DEFAULT 0 NOT NULL,
+  payload VARCHAR(%d) NOT NULL,
+  PRIMARY KEY (id)
+) %s]], id_def, math.max(sysbench.opt.jq_payload_size, 1), engine_def))
+
+   -- Claims look for the oldest pending jobs
+   con:query("CREATE INDEX sbtest_jobs_done ON sbtest_jobs (done, id)")
+
+   if sysbench.opt.jq_backlog > 0 then
+      print(string.format("Inserting %d jobs into 'sbtest_jobs'",
+                          sysbench.opt.jq_backlog))
+
+      con:bulk_insert_init("INSERT INTO sbtest_jobs (created, payload) VALUES")
+      for i = 1, sysbench.opt.jq_backlog do
+         con:bulk_insert_next(string.format("(0, '%s')",
+                                            sysbench.rand.string(payload_fmt)))
+      end
+      con:bulk_insert_done()
+   end
+end
+
+function cleanup()
+   local drv = sysbench.sql.driver()
+   local con = drv:connect()
+
+   print("Dropping table 'sbtest_jobs'...")
+   con:query("DROP TABLE IF EXISTS sbtest_jobs")
+end
+
+-- -----------------------------------------------------------------------------
+-- Run
+-- -----------------------------------------------------------------------------
+
+function thread_init()
+   drv = sysbench.sql.driver()
+   con = drv:connect()
+
+   check_options(drv)
+
+   if sysbench.opt.jq_producers >= sysbench.opt.threads then
+      error("--jq_producers must be less than --threads")
+   end
+
+   -- Wall clock time of the run start in microseconds, set by the first
+   -- thread to initialize. Jobs enqueued before it are not accounted in
+   -- job_latency.
+   epoch = sysbench.shared.counter("jq_epoch")
+   epoch:cas(0, os.time() * 1e6)
+
+   enqueued = sysbench.counter.new("jq_enqueued")
+   completed = sysbench.counter.new("jq_completed")
+   empty_claims = sysbench.counter.new("jq_empty_claims")
+   latency = sysbench.histogram.named("job_latency")
+
+   -- SQLite has no row locks
+   local skip_locked = drv:name() == "sqlite" and "" or
+      " FOR UPDATE SKIP LOCKED"
+   local pending = "SELECT id FROM sbtest_jobs WHERE done = 0 ORDER BY id " ..
+      "LIMIT " .. sysbench.opt.jq_dequeue_batch .. skip_locked
+
+   if sysbench.opt.jq_complete == "delete" then
+      complete_query = "DELETE FROM sbtest_jobs WHERE id IN (%s)"
+   else
+      complete_query = "UPDATE sbtest_jobs SET done = 1 WHERE id IN (%s)"
+   end
+
+   if sysbench.opt.jq_claim == "skip_locked" then
+      claim_query = "SELECT id, created FROM sbtest_jobs WHERE done = 0 " ..
+         "ORDER BY id LIMIT " .. sysbench.opt.jq_dequeue_batch .. skip_locked
+   else
+      claim_query = string.format(complete_query, pending) ..
+         " RETURNING id, created"
+   end
+
+   producer = sysbench.tid % sysbench.opt.threads < sysbench.opt.jq_producers
+
+   if producer then
+      enqueue_stat = sysbench.sql.txn_stat("enqueue")
+      enqueue_query = "INSERT INTO sbtest_jobs (created, payload) VALUES"
+   else
+      claim_stat = sysbench.sql.txn_stat("claim")
+   end
+end
+
+function thread_done()
+   con:disconnect()
+end
+
+-- Current wall clock time in microseconds
+local function now_us()
+   return epoch:get() + math.floor(tonumber(ffi.C.sb_test_clock()) / 1e3)
+end
+
+local function clock_s()
+   return tonumber(ffi.C.sb_test_clock()) / 1e9
+end
+
+local function produce_event()
+   local begin_s = clock_s()
+   local start = enqueue_stat:start()
+   local batch = sysbench.opt.jq_enqueue_batch
+
+   con:bulk_insert_init(enqueue_query)
+   for i = 1, batch do
+      con:bulk_insert_next(string.format("(%d, '%s')", now_us(),
+                                         sysbench.rand.string(payload_fmt)))
+   end
+   con:bulk_insert_done()
+
+   enqueue_stat:stop(start)
+   enqueued:add(batch)
+
+   if sysbench.opt.jq_producer_rate > 0 then
+      sysbench.sleep(batch / sysbench.opt.jq_producer_rate -
+                        (clock_s() - begin_s))
+   end
+end
+
+local function consume_event()
+   local start = claim_stat:start()
+   local ids = {}
+   local created = {}
+
+   con:query("BEGIN")
+
+   local rs = con:query(claim_query)
+
+   for i = 1, rs.nrows do
+      local row = rs:fetch_row()
+      ids[i] = row[1]
+      created[i] = tonumber(row[2])
+   end
+
+   if #ids > 0 and sysbench.opt.jq_claim == "skip_locked" then
+      con:query(string.format(complete_query, table.concat(ids, ",")))
+   end
+
+   con:query("COMMIT")
+
+   claim_stat:stop(start)
+
+   if #ids == 0 then
+      empty_claims:add()
+      sysbench.sleep(sysbench.opt.jq_poll_interval / 1000)
+      return
+   end
+
+   local now = now_us()
+   local first = epoch:get()
+
+   for i = 1, #created do
+      if created[i] >= first then
+         latency:update((now - created[i]) / 1000)
+      end
+   end
+
+   completed:add(#ids)
+end
+
+function event()
+   if producer then
+      produce_event()
+   else
+      consume_event()
+   end
+end
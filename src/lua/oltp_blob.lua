@@ -0,0 +1,207 @@
+#!/usr/bin/env sysbench
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+-- ----------------------------------------------------------------------
+-- Large value OLTP benchmark. Rows of sbtest tables have a single value
+-- column, which is LONGBLOB/LONGTEXT with MySQL, BYTEA/TEXT with PostgreSQL
+-- and BLOB/TEXT with SQLite depending on --blob_column. Value lengths follow
+-- --blob_rand_type between --blob_min_size and --blob_max_size bytes, so
+-- values are stored off-page or TOASTed depending on the sizes.
+--
+-- Values are bound as BLOB parameters, which only carry the length. Their
+-- contents are generated by the driver when a statement is executed: MySQL
+-- gets them in chunks with mysql_stmt_send_long_data(), libpq and SQLite take
+-- complete values generated into a buffer in C. Values are neither created
+-- as Lua strings nor fetched into Lua by selects.
+--
+-- Each transaction reads --blob_selects values and replaces --blob_updates
+-- values with new ones of random lengths. With --db-ps-mode=disable, whole
+-- values are generated into the query text instead.
+-- ----------------------------------------------------------------------
+
+require("oltp_common")
+
+sysbench.cmdline.options.blob_selects =
+   {"Number of selects of whole values by id per transaction", 1}
+sysbench.cmdline.options.blob_updates =
+   {"Number of updates replacing a value with a new one per transaction", 1}
+sysbench.cmdline.options.blob_min_size =
+   {"Minimum length of values in bytes", 1024}
+sysbench.cmdline.options.blob_max_size =
+   {"Maximum length of values in bytes, e.g. 16777216 for values of up " ..
+       "to 16 MiB", 1048576}
+sysbench.cmdline.options.blob_rand_type =
+   {"Distribution of value lengths {uniform, gaussian, special, pareto, " ..
+       "zipfian}", "pareto"}
+sysbench.cmdline.options.blob_column =
+   {"Type of the value column: 'blob' for binary or 'text' for character " ..
+       "data", "blob"}
+
+local blob_rand_types = { uniform = true, gaussian = true, special = true,
+                          pareto = true, zipfian = true }
+
+-- Value column types by driver and --blob_column
+local column_types = {
+   mysql = { blob = "LONGBLOB", text = "LONGTEXT" },
+   pgsql = { blob = "BYTEA", text = "TEXT" },
+   sqlite = { blob = "BLOB", text = "TEXT" }
+}
+
+-- Rows inserted per transaction in prepare
+local LOAD_BATCH_ROWS = 100
+
+local function check_options()
+   if sysbench.opt.blob_min_size < 0 or
+      sysbench.opt.blob_max_size < sysbench.opt.blob_min_size
+   then
+      error("Invalid value length range: " ..
+               sysbench.opt.blob_min_size .. ".." ..
+               sysbench.opt.blob_max_size)
+   end
+
+   if not blob_rand_types[sysbench.opt.blob_rand_type] then
+      error("Invalid value for --blob_rand_type: " ..
+               sysbench.opt.blob_rand_type)
+   end
+
+   if sysbench.opt.blob_column ~= "blob" and
+      sysbench.opt.blob_column ~= "text"
+   then
+      error("Invalid value for --blob_column: " .. sysbench.opt.blob_column)
+   end
+end
+
+-- Set a BLOB parameter to a value of a random length
+local function set_rand_blob(param)
+   param:set_rand_len(sysbench.opt.blob_min_size, sysbench.opt.blob_max_size,
+                      sysbench.rand[sysbench.opt.blob_rand_type])
+end
+
+-- The following replace the sbtest schema and data of oltp_common.lua, which
+-- calls them from its prepare command
+
+function create_table_def(drv, con, table_num, exists)
+   local types = column_types[drv:name()]
+   local engine_def = ""
+
+   check_options()
+
+   if types == nil then
+      error("Unsupported database driver:" .. drv:name())
+   end
+
+   if drv:name() == "mysql" then
+      engine_def = "/*! ENGINE = " .. sysbench.opt.mysql_storage_engine .. " */"
+   end
+
+   if exists then
+      print(string.format("Using existing table 'sbtest%d'...", table_num))
+      return
+   end
+
+   print(string.format("Creating table 'sbtest%d'...", table_num))
+
+   con:query(string.format([[
+CREATE TABLE sbtest%d(
+  id %s NOT NULL,
+  val %s,
+  PRIMARY KEY (id)
+) %s %s]],
+      table_num, sysbench.opt.table_size > 2147483647 and "BIGINT" or "INTEGER",
+      types[sysbench.opt.blob_column], engine_def,
+      sysbench.opt.create_table_options))
+end
+
+-- Values are generated by drivers for prepared statements only
+function load_table_copy()
+   return false
+end
+
+function load_table_insert(con, table_num, first, count)
+   local t = sysbench.sql.type
+   local st = con:prepare("INSERT INTO sbtest" .. table_num ..
+                             "(id, val) VALUES (?, ?)")
+   local id = st:bind_create(t.BIGINT)
+   local val = st:bind_create(t.BLOB)
+
+   st:bind_param(id, val)
+
+   for i = first, first + count - 1 do
+      if (i - first) % LOAD_BATCH_ROWS == 0 then
+         con:query("BEGIN")
+      end
+
+      id:set_int(i)
+      set_rand_blob(val)
+      st:execute()
+
+      if (i - first) % LOAD_BATCH_ROWS == LOAD_BATCH_ROWS - 1 or
+         i == first + count - 1
+      then
+         con:query("COMMIT")
+      end
+   end
+
+   st:close()
+end
+
+-- Values are only looked up by the primary key
+function create_secondary_index()
+end
+
+function prepare_statements()
+   local t = sysbench.sql.type
+
+   check_options()
+
+   define_stmt("blob_selects", {"SELECT val FROM sbtest%u WHERE id=?", t.INT})
+   define_stmt("blob_updates", {"UPDATE sbtest%u SET val=? WHERE id=?",
+                                t.BLOB, t.INT})
+
+   if not sysbench.opt.skip_trx then
+      prepare_begin()
+      prepare_commit()
+   end
+
+   prepare_for_each_table("blob_selects")
+   prepare_for_each_table("blob_updates")
+end
+
+function event()
+   local tnum = get_table_num()
+
+   if not sysbench.opt.skip_trx then
+      begin()
+   end
+
+   local st, params = get_stmt(tnum, "blob_selects")
+
+   for i = 1, sysbench.opt.blob_selects do
+      params[1]:set_int(get_id())
+      st:execute()
+   end
+
+   st, params = get_stmt(tnum, "blob_updates")
+
+   for i = 1, sysbench.opt.blob_updates do
+      set_rand_blob(params[1])
+      params[2]:set_int(get_id())
+      st:execute()
+   end
+
+   if not sysbench.opt.skip_trx then
+      commit()
+   end
+end
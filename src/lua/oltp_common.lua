@@ -47,20 +47,61 @@ sysbench.cmdline.options = {
       {"Number of SELECT ORDER BY queries per transaction", 1},
    distinct_ranges =
       {"Number of SELECT DISTINCT queries per transaction", 1},
+   k_ranges =
+      {"Number of SELECT queries per transaction scanning --range_size " ..
+          "wide ranges of the secondary index on k", 0},
+   k_in_lists =
+      {"Number of SELECT queries per transaction looking up lists of " ..
+          "--k_in_list_size values in the secondary index on k", 0},
+   k_in_list_size =
+      {"Number of values in the IN lists of --k_in_lists queries", 10},
+   k_covering =
+      {"Select only k in --k_ranges and --k_in_lists queries, so they " ..
+          "are served from the secondary index alone. When disabled, c is " ..
+          "selected, which takes a lookup of each matching row", true},
+   k_order =
+      {"Order of rows returned by --k_ranges and --k_in_lists queries: " ..
+          "'none', 'asc' or 'desc', which scans the secondary index " ..
+          "backwards", "none"},
    index_updates =
       {"Number of UPDATE index queries per transaction", 1},
    non_index_updates =
       {"Number of UPDATE non-index queries per transaction", 1},
    delete_inserts =
       {"Number of DELETE/INSERT combinations per transaction", 1},
+   appends =
+      {"Number of INSERT queries of new rows per transaction. New rows " ..
+          "get consecutive ids above --table_size shared by all threads " ..
+          "and are favored by reads with --rand-type=latest", 0},
    range_selects =
       {"Enable/disable all range SELECT queries", true},
+   tx_mix =
+      {"Weighted mix of transaction types, e.g. " ..
+          "'point_select:70,index_update:20,delete_insert:10'. Each event " ..
+          "executes a single transaction of a type chosen by weight, with " ..
+          "the number of statements set by the corresponding option, " ..
+          "e.g. --point_selects. Types are point_select, simple_range, " ..
+          "sum_range, order_range, distinct_range, k_range, k_in_list, " ..
+          "index_update, non_index_update, delete_insert and append. " ..
+          "Empty to execute the script's own transaction", ""},
    auto_inc =
    {"Use AUTO_INCREMENT column as Primary Key (for MySQL), " ..
        "or its alternatives in other DBMS. When disabled, use " ..
        "client-generated IDs", true},
    create_table_options =
       {"Extra CREATE TABLE options", ""},
+   partitions =
+      {"Number of partitions of each table created by prepare with MySQL " ..
+          "or PostgreSQL, 0 for non-partitioned tables", 0},
+   partition_type =
+      {"Partitioning of tables by id with --partitions: 'hash', 'range' " ..
+          "with the same number of rows up to --table_size in each " ..
+          "partition, or 'list' by id modulo --partitions (MySQL only)",
+       "hash"},
+   align_ranges =
+      {"Keep range SELECT queries on ids within a single partition with " ..
+          "--partition_type=range, so that partition pruning limits them " ..
+          "to one partition", false},
    skip_trx =
       {"Don't start explicit transactions and execute all queries " ..
           "in the AUTOCOMMIT mode", false},
@@ -68,6 +109,40 @@ sysbench.cmdline.options = {
       {"Use a secondary index in place of the PRIMARY KEY", false},
    create_secondary =
       {"Create a secondary index in addition to the PRIMARY KEY", true},
+   defer_secondary =
+      {"Create secondary indexes in prepare after all tables are loaded " ..
+          "rather than after each table. Always the case for tables " ..
+          "loaded by several threads, i.e. with --threads > --tables", false},
+   resume =
+      {"Keep existing tables in prepare and only load rows missing up to " ..
+          "--table_size, e.g. to continue an interrupted prepare with the " ..
+          "same --threads or to grow tables to a larger --table_size", false},
+   batch =
+      {"Send all statements of a transaction in one group, i.e. in a " ..
+          "single round trip if pipelining is enabled in the driver with " ..
+          "--mysql-pipeline or --pgsql-pipeline. Statements are prepared " ..
+          "up front. Ignored with --skip_trx", false},
+   stmt_cache_size =
+      {"Maximum number of prepared statements per connection. Statements " ..
+          "are prepared on first use, the least recently used one is " ..
+          "closed to make room for a new one. 0 means no limit", 0},
+   reconnect_every =
+      {"Reestablish the database session after every N events as set by " ..
+          "--reconnect_mode, 0 to keep the same session", 0},
+   reconnect_mode =
+      {"How sessions are reestablished with --reconnect_every: " ..
+          "'reconnect' makes a new connection, 'reset' resets session " ..
+          "state of the existing one", "reconnect"},
+   key_partitioning =
+      {"Split rows between threads to access mostly disjoint data: " ..
+          "'none' for no partitioning, 'thread' to split the id range of " ..
+          "each table, 'table' to split the set of tables", "none"},
+   key_partitions =
+      {"Number of partitions with --key_partitioning, threads are " ..
+          "assigned to them round-robin. 0 for one partition per thread", 0},
+   cross_partition_pct =
+      {"Percentage of accesses to random rows or tables outside the " ..
+          "thread's partition with --key_partitioning", 0},
    mysql_storage_engine =
       {"Storage engine, if MySQL is used", "innodb"},
    pgsql_variant =
@@ -78,15 +153,128 @@ sysbench.cmdline.options = {
           "delete_inserts is set to 0"}
 }
 
+-- First id of range partition i of --partitions, or the last id of partition
+-- i - 1 plus one. Partitions hold the same number of ids up to --table_size,
+-- the last one also holds all ids above it.
+local function partition_first_id(i)
+   return math.floor(i * sysbench.opt.table_size / sysbench.opt.partitions) +
+      1
+end
+
+-- Check --partitions, --partition_type and --align_ranges
+function check_partitions(drv)
+   local n = sysbench.opt.partitions
+   local ptype = sysbench.opt.partition_type
+
+   if n < 0 then
+      error("Invalid value for --partitions: " .. n)
+   end
+
+   if ptype ~= "hash" and ptype ~= "range" and ptype ~= "list" then
+      error("Invalid value for --partition_type: " .. ptype)
+   end
+
+   if sysbench.opt.align_ranges and (n == 0 or ptype ~= "range") then
+      error("--align_ranges requires --partitions with " ..
+               "--partition_type=range")
+   end
+
+   if n == 0 then
+      return
+   end
+
+   if drv:name() ~= "mysql" and (drv:name() ~= "pgsql" or
+                                 sysbench.opt.pgsql_variant == "redshift")
+   then
+      error("--partitions is only supported with MySQL and PostgreSQL")
+   end
+
+   if ptype == "range" and n > sysbench.opt.table_size then
+      error("--partition_type=range requires at most --table_size " ..
+               "partitions")
+   end
+
+   -- The partition key must be a part of the primary key, which cannot
+   -- include expressions in PostgreSQL
+   if ptype == "list" and drv:name() == "pgsql" then
+      error("--partition_type=list is not supported with PostgreSQL")
+   end
+end
+
+-- Rows first .. last of part 'part' of 'nparts' parts of a table loaded by
+-- different threads. With range partitions, parts consist of whole
+-- partitions if possible, so that each thread loads its own partitions.
+local function load_part_rows(part, nparts)
+   local n = sysbench.opt.partitions
+
+   if sysbench.opt.partition_type == "range" and n >= nparts then
+      return partition_first_id(math.floor(part * n / nparts)),
+         partition_first_id(math.floor((part + 1) * n / nparts)) - 1
+   end
+
+   return math.floor(part * sysbench.opt.table_size / nparts) + 1,
+      math.floor((part + 1) * sysbench.opt.table_size / nparts)
+end
+
 -- Prepare the dataset. This command supports parallel execution, i.e. will
--- benefit from executing with --threads > 1 as long as --tables > 1
+-- benefit from executing with --threads > 1. Tables are distributed among
+-- threads. With more threads than tables, each table is loaded by several
+-- threads inserting disjoint ranges of rows.
 function cmd_prepare()
    local drv = sysbench.sql.driver()
    local con = drv:connect()
+   local threads = sysbench.opt.threads
+   local tables = sysbench.opt.tables
+   local tid = sysbench.tid % threads
 
-   for i = sysbench.tid % sysbench.opt.threads + 1, sysbench.opt.tables,
-   sysbench.opt.threads do
-     create_table(drv, con, i)
+   check_partitions(drv)
+
+   if threads <= tables and not sysbench.opt.defer_secondary then
+      for i = tid + 1, tables, threads do
+         create_table(drv, con, i)
+      end
+      return
+   end
+
+   -- Parts of tables loaded by this thread as {table, part, number of parts}
+   local parts = {}
+   if threads <= tables then
+      for i = tid + 1, tables, threads do
+         parts[#parts + 1] = {i, 0, 1}
+      end
+   else
+      local i = tid % tables + 1
+      parts[1] = {i, math.floor(tid / tables),
+                  math.floor((threads - i) / tables) + 1}
+   end
+
+   -- Rows to load as {table, first row, count}. Existing rows are checked
+   -- before any thread starts loading.
+   local loads = {}
+   for _, p in ipairs(parts) do
+      local first, last = load_part_rows(p[2], p[3])
+      local loaded = loaded_rows(drv, con, p[1], first, last - first + 1)
+
+      if p[2] == 0 then
+         create_table_def(drv, con, p[1], loaded ~= nil)
+      end
+
+      loaded = loaded or 0
+      loads[#loads + 1] = {p[1], first + loaded, last - first + 1 - loaded}
+   end
+
+   -- Wait for all tables to be created
+   sysbench.barrier()
+
+   for _, l in ipairs(loads) do
+      load_table(drv, con, l[1], l[2], l[3])
+   end
+
+   -- Wait for all rows to be loaded, then build indexes in parallel per table
+   sysbench.barrier()
+
+   for i = tid + 1, tables, threads do
+      create_secondary_index(con, i)
    end
 end
 
@@ -151,10 +339,233 @@ function get_pad_value()
    return sysbench.rand.string(pad_value_template)
 end
 
+-- Set by scripts inserting rows with 64-bit ids, so that the id column is
+-- created as BIGINT regardless of --table_size
+bigint_ids = false
+
+-- Set by scripts inserting rows with 128-bit ids, e.g. UUIDs, so that the id
+-- column is BINARY(16) with MySQL, UUID with PostgreSQL and BLOB with SQLite
+uuid_ids = false
+
+-- Whether ids and k values exceed the SQL INT range, so BIGINT columns and
+-- parameters are used
+local function big_keys()
+   return sysbench.opt.table_size > 2147483647
+end
+
+-- Random number between a and b with the default distribution, using the
+-- 64-bit generator when b does not fit into 32 bits
+local function rand_key(a, b)
+   if b > 4294967295 then
+      return sysbench.rand.default64(a, b)
+   end
+   return sysbench.rand.default(a, b)
+end
+
+-- Load rows first .. first + count - 1 with multi-row INSERTs
+function load_table_insert(con, table_num, first, count)
+   local query
+
+   if sysbench.opt.auto_inc then
+      query = "INSERT INTO sbtest" .. table_num .. "(k, c, pad) VALUES"
+   else
+      query = "INSERT INTO sbtest" .. table_num .. "(id, k, c, pad) VALUES"
+   end
+
+   con:bulk_insert_init(query)
+
+   local c_val
+   local pad_val
+
+   for i = first, first + count - 1 do
+
+      c_val = get_c_value()
+      pad_val = get_pad_value()
+
+      if (sysbench.opt.auto_inc) then
+         query = string.format("(%d, '%s', '%s')",
+                               rand_key(1, sysbench.opt.table_size),
+                               c_val, pad_val)
+      else
+         query = string.format("(%d, %d, '%s', '%s')",
+                               i,
+                               rand_key(1, sysbench.opt.table_size),
+                               c_val, pad_val)
+      end
+
+      con:bulk_insert_next(query)
+   end
+
+   con:bulk_insert_done()
+end
+
+-- Load rows with the native bulk loading of the driver (COPY for PostgreSQL,
+-- LOAD DATA LOCAL INFILE for MySQL, a prepared INSERT in a single transaction
+-- for SQLite), generating them in C. Uses the same value distributions as
+-- load_table_insert(). Returns false if bulk loading is not available.
+function load_table_copy(drv, con, table_num, first, count)
+   local cols = sysbench.opt.auto_inc and "(k, c, pad)" or "(id, k, c, pad)"
+   local query
+
+   if drv:name() == "pgsql" then
+      -- Redshift only supports COPY from external storage
+      if sysbench.opt.pgsql_variant == 'redshift' then
+         return false
+      end
+      query = "COPY sbtest" .. table_num .. cols .. " FROM STDIN"
+   elseif drv:name() == "sqlite" then
+      query = "INSERT INTO sbtest" .. table_num .. cols ..
+         (sysbench.opt.auto_inc and " VALUES (?, ?, ?)" or
+             " VALUES (?, ?, ?, ?)")
+   else
+      query = "LOAD DATA LOCAL INFILE 'sbtest' INTO TABLE sbtest" ..
+         table_num .. " " .. cols
+   end
+
+   -- Tab-separated fields, the generated values need no escaping
+   local fmt = "%r\t" .. c_value_template .. "\t" .. pad_value_template
+   if not sysbench.opt.auto_inc then
+      fmt = "%n\t" .. fmt
+   end
+
+   return con:copy_rows(query, fmt, count, sysbench.opt.table_size, first)
+end
+
+-- Create a table, load all rows and create the secondary index, if enabled.
+-- With --resume, only missing rows are loaded into an existing table.
 function create_table(drv, con, table_num)
+   local loaded = loaded_rows(drv, con, table_num, 1, sysbench.opt.table_size)
+
+   create_table_def(drv, con, table_num, loaded ~= nil)
+
+   loaded = loaded or 0
+   load_table(drv, con, table_num, loaded + 1,
+              sysbench.opt.table_size - loaded)
+   create_secondary_index(con, table_num)
+end
+
+-- Catalog queries returning a non-zero count if a table or an index exists
+local catalog_queries = {
+   mysql = {
+      table = "SELECT COUNT(*) FROM information_schema.tables " ..
+         "WHERE table_schema = DATABASE() AND table_name = '%s'",
+      index = "SELECT COUNT(*) FROM information_schema.statistics " ..
+         "WHERE table_schema = DATABASE() AND table_name = '%s' AND " ..
+         "index_name = '%s'"
+   },
+   pgsql = {
+      table = "SELECT COUNT(*) FROM pg_tables " ..
+         "WHERE schemaname = current_schema() AND tablename = '%s'",
+      index = "SELECT COUNT(*) FROM pg_indexes " ..
+         "WHERE schemaname = current_schema() AND tablename = '%s' AND " ..
+         "indexname = '%s'"
+   },
+   sqlite = {
+      table = "SELECT COUNT(*) FROM sqlite_master " ..
+         "WHERE type = 'table' AND name = '%s'",
+      index = "SELECT COUNT(*) FROM sqlite_master " ..
+         "WHERE type = 'index' AND tbl_name = '%s' AND name = '%s'"
+   }
+}
+
+local function catalog_has(drv, con, kind, ...)
+   local queries = catalog_queries[drv:name()]
+
+   if queries == nil then
+      error("Unsupported database driver:" .. drv:name())
+   end
+
+   return tonumber(con:query_row(string.format(queries[kind], ...))) > 0
+end
+
+-- With --resume, return the number of rows first .. first + count - 1
+-- already loaded into a table, or nil if the table does not exist. Rows of
+-- a range are loaded in id order, so this is given by the maximum id in the
+-- range. Ids generated by the database do not follow the ranges, so existing
+-- rows are then counted towards the first ranges of the table. Always nil
+-- without --resume.
+function loaded_rows(drv, con, table_num, first, count)
+   local tname = "sbtest" .. table_num
+   local n
+
+   if not sysbench.opt.resume or not catalog_has(drv, con, "table", tname) then
+      return nil
+   end
+
+   if sysbench.opt.auto_inc then
+      n = tonumber(con:query_row("SELECT COUNT(*) FROM " .. tname)) -
+         (first - 1)
+   else
+      n = tonumber(con:query_row(string.format(
+                                    "SELECT MAX(id) FROM %s " ..
+                                       "WHERE id BETWEEN %d AND %d",
+                                    tname, first, first + count - 1)) or
+                      first - 1) - (first - 1)
+   end
+
+   return math.max(0, math.min(n, count))
+end
+
+-- PARTITION BY clause of a table and queries creating its partitions, which
+-- are separate tables in PostgreSQL, see --partitions
+local function partition_defs(drv, table_num)
+   local n = sysbench.opt.partitions
+   local ptype = sysbench.opt.partition_type
+   local parts = {}
+
+   if n == 0 then
+      return "", parts
+   end
+
+   if drv:name() == "mysql" then
+      if ptype == "hash" then
+         return "PARTITION BY HASH (id) PARTITIONS " .. n, parts
+      end
+
+      for i = 0, n - 1 do
+         if ptype == "range" then
+            parts[#parts + 1] = string.format(
+               "PARTITION p%d VALUES LESS THAN (%s)", i,
+               i < n - 1 and partition_first_id(i + 1) or "MAXVALUE")
+         else
+            parts[#parts + 1] = string.format("PARTITION p%d VALUES IN (%d)",
+                                              i, i)
+         end
+      end
+
+      return string.format("PARTITION BY %s (\n  %s\n)",
+                           ptype == "range" and "RANGE (id)" or
+                              "LIST (MOD(id, " .. n .. "))",
+                           table.concat(parts, ",\n  ")), {}
+   end
+
+   for i = 0, n - 1 do
+      local bounds
+
+      if ptype == "hash" then
+         bounds = string.format("WITH (MODULUS %d, REMAINDER %d)", n, i)
+      else
+         bounds = string.format("FROM (%s) TO (%s)",
+                                i > 0 and partition_first_id(i) or "MINVALUE",
+                                i < n - 1 and partition_first_id(i + 1) or
+                                   "MAXVALUE")
+      end
+
+      parts[#parts + 1] = string.format(
+         "CREATE TABLE sbtest%d_p%d PARTITION OF sbtest%d FOR VALUES %s",
+         table_num, i, table_num, bounds)
+   end
+
+   return "PARTITION BY " .. string.upper(ptype) .. " (id)", parts
+end
+
+-- Create a table, or keep it if 'exists' is true, i.e. with --resume
+function create_table_def(drv, con, table_num, exists)
    local id_index_def, id_def
+   local int_def = big_keys() and "BIGINT" or "INTEGER"
+   local id_int_def = (big_keys() or bigint_ids) and "BIGINT" or "INTEGER"
    local engine_def = ""
-   local extra_table_options = ""
+   local table_options
    local query
 
    if sysbench.opt.secondary then
@@ -166,75 +577,102 @@ function create_table(drv, con, table_num)
    if drv:name() == "mysql"
    then
       if sysbench.opt.auto_inc then
-         id_def = "INTEGER NOT NULL AUTO_INCREMENT"
+         id_def = id_int_def .. " NOT NULL AUTO_INCREMENT"
       else
-         id_def = "INTEGER NOT NULL"
+         id_def = id_int_def .. " NOT NULL"
       end
       engine_def = "/*! ENGINE = " .. sysbench.opt.mysql_storage_engine .. " */"
    elseif drv:name() == "pgsql"
    then
       if not sysbench.opt.auto_inc then
-         id_def = "INTEGER NOT NULL"
+         id_def = id_int_def .. " NOT NULL"
       elseif pgsql_variant == 'redshift' then
-        id_def = "INTEGER IDENTITY(1,1)"
+        id_def = id_int_def .. " IDENTITY(1,1)"
       else
-        id_def = "SERIAL"
+        id_def = (big_keys() or bigint_ids) and "BIGSERIAL" or "SERIAL"
       end
+   elseif drv:name() == "sqlite"
+   then
+      -- An INTEGER PRIMARY KEY is an alias for ROWID, which is assigned
+      -- automatically if no value is given. It is always 64-bit.
+      id_def = "INTEGER NOT NULL"
    else
       error("Unsupported database driver:" .. drv:name())
    end
 
-   print(string.format("Creating table 'sbtest%d'...", table_num))
+   if uuid_ids then
+      id_def = ({ mysql = "BINARY(16)", pgsql = "UUID",
+                  sqlite = "BLOB" })[drv:name()] .. " NOT NULL"
+   end
+
+   if exists then
+      print(string.format("Using existing table 'sbtest%d'...", table_num))
+      return
+   end
+
+   local partition_def, partition_queries = partition_defs(drv, table_num)
+
+   if sysbench.opt.partitions > 0 then
+      print(string.format("Creating table 'sbtest%d' with %d %s partitions...",
+                          table_num, sysbench.opt.partitions,
+                          sysbench.opt.partition_type))
+   else
+      print(string.format("Creating table 'sbtest%d'...", table_num))
+   end
+
+   -- MySQL takes table options before the partitioning clause, PostgreSQL
+   -- after it
+   if drv:name() == "mysql" then
+      table_options = engine_def .. " " ..
+         sysbench.opt.create_table_options .. " " .. partition_def
+   else
+      table_options = partition_def .. " " .. sysbench.opt.create_table_options
+   end
 
    query = string.format([[
 CREATE TABLE sbtest%d(
   id %s,
-  k INTEGER DEFAULT '0' NOT NULL,
+  k %s DEFAULT '0' NOT NULL,
   c CHAR(120) DEFAULT '' NOT NULL,
   pad CHAR(60) DEFAULT '' NOT NULL,
   %s (id)
-) %s %s]],
-      table_num, id_def, id_index_def, engine_def,
-      sysbench.opt.create_table_options)
+) %s]],
+      table_num, id_def, int_def, id_index_def, table_options)
 
    con:query(query)
 
-   if (sysbench.opt.table_size > 0) then
-      print(string.format("Inserting %d records into 'sbtest%d'",
-                          sysbench.opt.table_size, table_num))
+   for _, q in ipairs(partition_queries) do
+      con:query(q)
    end
+end
 
-   if sysbench.opt.auto_inc then
-      query = "INSERT INTO sbtest" .. table_num .. "(k, c, pad) VALUES"
-   else
-      query = "INSERT INTO sbtest" .. table_num .. "(id, k, c, pad) VALUES"
+-- Load rows first .. first + count - 1 into a table
+function load_table(drv, con, table_num, first, count)
+   if count <= 0 then
+      return
    end
 
-   con:bulk_insert_init(query)
-
-   local c_val
-   local pad_val
-
-   for i = 1, sysbench.opt.table_size do
-
-      c_val = get_c_value()
-      pad_val = get_pad_value()
-
-      if (sysbench.opt.auto_inc) then
-         query = string.format("(%d, '%s', '%s')",
-                               sysbench.rand.default(1, sysbench.opt.table_size),
-                               c_val, pad_val)
-      else
-         query = string.format("(%d, %d, '%s', '%s')",
-                               i,
-                               sysbench.rand.default(1, sysbench.opt.table_size),
-                               c_val, pad_val)
-      end
+   if count == sysbench.opt.table_size then
+      print(string.format("Inserting %d records into 'sbtest%d'",
+                          count, table_num))
+   else
+      print(string.format("Inserting records %d to %d into 'sbtest%d'",
+                          first, first + count - 1, table_num))
+   end
 
-      con:bulk_insert_next(query)
+   -- Bulk loading is much faster than multi-row INSERTs, where available
+   if not load_table_copy(drv, con, table_num, first, count) then
+      load_table_insert(con, table_num, first, count)
    end
+end
 
-   con:bulk_insert_done()
+function create_secondary_index(con, table_num)
+   if sysbench.opt.resume and
+      catalog_has(con.driver, con, "index",
+                  "sbtest" .. table_num, "k_" .. table_num)
+   then
+      return
+   end
 
    if sysbench.opt.create_secondary then
       print(string.format("Creating a secondary index on 'sbtest%d'...",
@@ -275,42 +713,127 @@ local stmt_defs = {
       t.INT, t.INT, {t.CHAR, 120}, {t.CHAR, 60}},
 }
 
+-- Add a statement for get_stmt() and prepare_for_each_table(), used by scripts
+-- with their own queries. 'def' is {query format, parameter types...} like the
+-- definitions above.
+function define_stmt(key, def)
+   stmt_defs[key] = def
+end
+
 function prepare_begin()
    stmt.begin = con:prepare("BEGIN")
+   stmt.begin:set_label("begin")
 end
 
 function prepare_commit()
    stmt.commit = con:prepare("COMMIT")
+   stmt.commit:set_label("commit")
 end
 
-function prepare_for_each_table(key)
-   for t = 1, sysbench.opt.tables do
-      stmt[t][key] = con:prepare(string.format(stmt_defs[key][1], t))
+-- Prepare a statement for a table and bind its parameters
+local function prepare_stmt(t, key)
+   local st = con:prepare(string.format(stmt_defs[key][1], t))
+   -- Report the same statement for all tables together
+   st:set_label(key)
 
-      local nparam = #stmt_defs[key] - 1
+   local nparam = #stmt_defs[key] - 1
+   local params = {}
 
-      if nparam > 0 then
-         param[t][key] = {}
+   for p = 1, nparam do
+      local btype = stmt_defs[key][p+1]
+      local len
+
+      if type(btype) == "table" then
+         len = btype[2]
+         btype = btype[1]
+      end
+      if btype == sysbench.sql.type.INT and big_keys() then
+         btype = sysbench.sql.type.BIGINT
+      end
+      if btype == sysbench.sql.type.VARCHAR or
+         btype == sysbench.sql.type.CHAR then
+            params[p] = st:bind_create(btype, len)
+      else
+         params[p] = st:bind_create(btype)
       end
+   end
 
-      for p = 1, nparam do
-         local btype = stmt_defs[key][p+1]
-         local len
+   if nparam > 0 then
+      st:bind_param(unpack(params))
+   end
 
-         if type(btype) == "table" then
-            len = btype[2]
-            btype = btype[1]
-         end
-         if btype == sysbench.sql.type.VARCHAR or
-            btype == sysbench.sql.type.CHAR then
-               param[t][key][p] = stmt[t][key]:bind_create(btype, len)
-         else
-            param[t][key][p] = stmt[t][key]:bind_create(btype)
-         end
+   return st, params
+end
+
+-- Prepared statements of this connection, mapped to their tables, keys and
+-- last use "time" to find the least recently used statement
+local stmt_cached = {}
+local stmt_ncached = 0
+local stmt_tick = 0
+
+-- Close the least recently used statement to make room for a new one
+local function evict_stmt()
+   local lru, lru_e
+
+   for st, e in pairs(stmt_cached) do
+      if lru == nil or e.tick < lru_e.tick then
+         lru, lru_e = st, e
       end
+   end
+
+   lru:close()
+   rawset(stmt[lru_e.t], lru_e.key, nil)
+   rawset(param[lru_e.t], lru_e.key, nil)
+   stmt_cached[lru] = nil
+   stmt_ncached = stmt_ncached - 1
+end
+
+-- Get a prepared statement and its parameters for a table, preparing it on
+-- first use. Statements are prepared lazily, so that only (table, statement)
+-- pairs that are actually used take connection and server resources.
+function get_stmt(t, key)
+   local st = rawget(stmt[t], key)
+
+   stmt_tick = stmt_tick + 1
+
+   if st ~= nil then
+      stmt_cached[st].tick = stmt_tick
+      return st, rawget(param[t], key)
+   end
+
+   if stmt_defs[key] == nil then
+      return nil
+   end
+
+   if sysbench.opt.stmt_cache_size > 0 and
+      stmt_ncached >= sysbench.opt.stmt_cache_size then
+      evict_stmt()
+   end
+
+   local params
+   st, params = prepare_stmt(t, key)
+
+   stmt_cached[st] = {t = t, key = key, tick = stmt_tick}
+   stmt_ncached = stmt_ncached + 1
+
+   rawset(stmt[t], key, st)
+   rawset(param[t], key, params)
+
+   return st, params
+end
+
+-- Kept for compatibility with scripts calling it from prepare_statements().
+-- Statements are prepared on first use, statements listed here are only
+-- checked to exist.
+function prepare_for_each_table(key)
+   if stmt_defs[key] == nil then
+      error("Unknown statement: " .. key)
+   end
 
-      if nparam > 0 then
-         stmt[t][key]:bind_param(unpack(param[t][key]))
+   -- Statements cannot be prepared in the middle of a batch
+   if batch_trx then
+      for t = 1, sysbench.opt.tables do
+         get_stmt(t, key)
       end
    end
 end
@@ -348,6 +871,24 @@ function prepare_delete_inserts()
    prepare_for_each_table("inserts")
 end
 
+function prepare_k_ranges()
+   if sysbench.opt.k_ranges > 0 then
+      prepare_for_each_table("k_ranges")
+   end
+end
+
+function prepare_k_in_lists()
+   if sysbench.opt.k_in_lists > 0 then
+      prepare_for_each_table("k_in_lists")
+   end
+end
+
+function prepare_appends()
+   if sysbench.opt.appends > 0 then
+      prepare_for_each_table("inserts")
+   end
+end
+
 function thread_init()
    drv = sysbench.sql.driver()
    con = drv:connect()
@@ -355,24 +896,231 @@ function thread_init()
    -- Create global nested tables for prepared statements and their
    -- parameters. We need a statement and a parameter set for each combination
    -- of connection/table/query
+   if sysbench.opt.stmt_cache_size == 1 then
+      -- Some events use 2 statements at once
+      error("--stmt_cache_size must be 0 or greater than 1")
+   end
+
+   -- Whether transactions are sent as single statement groups
+   batch_trx = sysbench.opt.batch and not sysbench.opt.skip_trx
+
+   if batch_trx and sysbench.opt.stmt_cache_size > 0 then
+      error("--batch cannot be used with --stmt_cache_size")
+   end
+
+   if sysbench.opt.reconnect_mode ~= "reconnect" and
+      sysbench.opt.reconnect_mode ~= "reset"
+   then
+      error("Invalid value for --reconnect_mode: " ..
+               sysbench.opt.reconnect_mode)
+   end
+
+   check_partitions(drv)
+
+   init_partitioning()
+
+   init_validation()
+
+   init_tx_mix()
+
+   init_k_statements()
+
+   init_statements()
+
+   -- This function is a 'callback' defined by individual benchmark scripts
+   prepare_statements()
+
+   -- Wrap event() defined by the benchmark script to reestablish the session
+   -- before every --reconnect_every events after the first ones
+   if sysbench.opt.reconnect_every > 0 then
+      local script_event = event
+      local nevents = 0
+
+      event = function(...)
+         nevents = nevents + 1
+         if nevents > sysbench.opt.reconnect_every then
+            reestablish_session()
+            nevents = 1
+         end
+         return script_event(...)
+      end
+   end
+end
+
+-- Define the secondary index statements of --k_ranges and --k_in_lists, whose
+-- text depends on --k_covering, --k_order and --k_in_list_size
+function init_k_statements()
+   local order = {none = "", asc = " ORDER BY k", desc = " ORDER BY k DESC"}
+
+   if order[sysbench.opt.k_order] == nil then
+      error("Invalid value for --k_order: " .. sysbench.opt.k_order)
+   end
+
+   if sysbench.opt.k_in_list_size < 1 then
+      error("Invalid value for --k_in_list_size: " ..
+               sysbench.opt.k_in_list_size)
+   end
+
+   local columns = sysbench.opt.k_covering and "k" or "c"
+   local n = sysbench.opt.k_in_list_size
+
+   stmt_defs.k_ranges = {
+      string.format("SELECT %s FROM sbtest%%u WHERE k BETWEEN ? AND ?%s",
+                    columns, order[sysbench.opt.k_order]),
+      t.INT, t.INT}
+
+   stmt_defs.k_in_lists = {
+      string.format("SELECT %s FROM sbtest%%u WHERE k IN (%s)%s",
+                    columns, string.rep("?, ", n - 1) .. "?",
+                    order[sysbench.opt.k_order])}
+
+   for i = 1, n do
+      stmt_defs.k_in_lists[i + 1] = t.INT
+   end
+end
+
+-- Transaction types for --tx_mix: the functions executing their statements
+-- and the statements they use
+local tx_types = {
+   point_select = {"execute_point_selects", "point_selects"},
+   simple_range = {"execute_simple_ranges", "simple_ranges"},
+   sum_range = {"execute_sum_ranges", "sum_ranges"},
+   order_range = {"execute_order_ranges", "order_ranges"},
+   distinct_range = {"execute_distinct_ranges", "distinct_ranges"},
+   k_range = {"execute_k_ranges", "k_ranges"},
+   k_in_list = {"execute_k_in_lists", "k_in_lists"},
+   index_update = {"execute_index_updates", "index_updates"},
+   non_index_update = {"execute_non_index_updates", "non_index_updates"},
+   delete_insert = {"execute_delete_inserts", "deletes", "inserts"},
+   append = {"execute_appends", "inserts"}
+}
+
+-- Parse --tx_mix and replace event() defined by the benchmark script with one
+-- executing a transaction of a random type. Each type is reported separately
+-- in per-transaction statistics.
+function init_tx_mix()
+   local spec = sysbench.opt.tx_mix
+
+   if spec == "" then
+      return
+   end
+
+   local mix = {}
+   local total = 0
+
+   for name, weight in string.gmatch(spec, "([^,:]+):([^,]*)") do
+      local tx = tx_types[name]
+      weight = tonumber(weight)
+
+      if tx == nil or weight == nil or weight <= 0 then
+         error("Invalid value for --tx_mix: " .. spec)
+      end
+
+      if name == "append" and sysbench.opt.appends == 0 then
+         error("--tx_mix with appends requires --appends > 0")
+      end
+
+      total = total + weight
+      mix[#mix + 1] = {
+         execute = _G[tx[1]],
+         keys = {unpack(tx, 2)},
+         stat = sysbench.sql.txn_stat(name),
+         weight = total
+      }
+   end
+
+   if #mix == 0 or select(2, string.gsub(spec, ",", "")) ~= #mix - 1 then
+      error("Invalid value for --tx_mix: " .. spec)
+   end
+
+   -- Statements of the mix and BEGIN/COMMIT are prepared in addition to
+   -- those of the script
+   local script_prepare = prepare_statements
+
+   prepare_statements = function()
+      script_prepare()
+
+      if not sysbench.opt.skip_trx and stmt.begin == nil then
+         prepare_begin()
+         prepare_commit()
+      end
+
+      for _, tx in ipairs(mix) do
+         for _, key in ipairs(tx.keys) do
+            prepare_for_each_table(key)
+         end
+      end
+   end
+
+   event = function()
+      local r = sysbench.rand.uniform_double() * total
+      local i = 1
+
+      while i < #mix and r >= mix[i].weight do
+         i = i + 1
+      end
+
+      local tx = mix[i]
+      local start = tx.stat:start()
+
+      if not sysbench.opt.skip_trx then
+         begin()
+      end
+
+      tx.execute()
+
+      if not sysbench.opt.skip_trx then
+         commit()
+      end
+
+      tx.stat:stop(start)
+   end
+end
+
+-- Reconnect or reset the session as set by --reconnect_mode. Prepared
+-- statements do not survive either, so they are prepared again.
+function reestablish_session()
+   close_statements()
+
+   if sysbench.opt.reconnect_mode == "reset" then
+      con:reset()
+   else
+      con:reconnect()
+   end
+
+   init_statements()
+   prepare_statements()
+end
+
+-- Create empty per-table statement and parameter tables
+function init_statements()
    stmt = {}
    param = {}
 
+   -- Statements are prepared on first access, e.g. to stmt[t].point_selects
+   -- or param[t].point_selects
    for t = 1, sysbench.opt.tables do
-      stmt[t] = {}
-      param[t] = {}
+      stmt[t] = setmetatable({}, {
+         __index = function(_, key)
+            return (get_stmt(t, key))
+         end
+      })
+      param[t] = setmetatable({}, {
+         __index = function(_, key)
+            local _, params = get_stmt(t, key)
+            return params
+         end
+      })
    end
 
-   -- This function is a 'callback' defined by individual benchmark scripts
-   prepare_statements()
+   stmt_cached = {}
+   stmt_ncached = 0
 end
 
 -- Close prepared statements
 function close_statements()
-   for t = 1, sysbench.opt.tables do
-      for k, s in pairs(stmt[t]) do
-         stmt[t][k]:close()
-      end
+   for st in pairs(stmt_cached) do
+      st:close()
    end
    if (stmt.begin ~= nil) then
       stmt.begin:close()
@@ -397,44 +1145,369 @@ function cleanup()
    end
 end
 
-local function get_table_num()
+-- Id range and tables of this thread's partition, see --key_partitioning
+local part_first, part_last, part_tables
+local cross_fraction = 0
+
+-- Assign the current thread to a partition in thread_init()
+function init_partitioning()
+   local mode = sysbench.opt.key_partitioning
+   local nparts = sysbench.opt.key_partitions
+
+   part_first, part_last, part_tables = nil, nil, nil
+
+   if mode ~= "none" and mode ~= "thread" and mode ~= "table" then
+      error("Invalid value for --key_partitioning: " .. mode)
+   end
+
+   if nparts < 0 then
+      error("Invalid value for --key_partitions: " .. nparts)
+   end
+
+   if sysbench.opt.cross_partition_pct < 0 or
+      sysbench.opt.cross_partition_pct > 100
+   then
+      error("Invalid value for --cross_partition_pct: " ..
+               sysbench.opt.cross_partition_pct)
+   end
+   cross_fraction = sysbench.opt.cross_partition_pct / 100
+
+   if mode == "none" then
+      return
+   end
+
+   if nparts == 0 then
+      nparts = sysbench.opt.threads
+   end
+
+   local p = sysbench.tid % nparts
+
+   if mode == "thread" then
+      if nparts > sysbench.opt.table_size then
+         error("--key_partitioning=thread requires at most --table_size " ..
+                  "partitions")
+      end
+      part_first = math.floor(p * sysbench.opt.table_size / nparts) + 1
+      part_last = math.floor((p + 1) * sysbench.opt.table_size / nparts)
+   else
+      if nparts > sysbench.opt.tables then
+         error("--key_partitioning=table requires at most --tables " ..
+                  "partitions")
+      end
+      part_tables = {}
+      for t = p + 1, sysbench.opt.tables, nparts do
+         part_tables[#part_tables + 1] = t
+      end
+   end
+end
+
+-- Whether the current access should go outside of the thread's partition
+local function cross_partition()
+   return cross_fraction > 0 and
+      sysbench.rand.uniform_double() < cross_fraction
+end
+
+function get_table_num()
+   if part_tables ~= nil and not cross_partition() then
+      return part_tables[sysbench.rand.uniform(1, #part_tables)]
+   end
    return sysbench.rand.uniform(1, sysbench.opt.tables)
 end
 
-local function get_id()
-   return sysbench.rand.default(1, sysbench.opt.table_size)
+function get_id()
+   if part_first ~= nil and not cross_partition() then
+      return rand_key(part_first, part_last)
+   end
+   return rand_key(1, sysbench.opt.table_size)
+end
+
+-- --validate state: whether it is on, the number of failures printed so far,
+-- and k values of rows only written by this thread by table and id, loaded on
+-- first use
+local validating = false
+local validate_failures
+local validate_nprinted = 0
+local validate_model = {}
+
+-- Print at most this many failures per thread
+local VALIDATE_MAX_PRINTED = 10
+
+-- Whether rows may be missing for a while, i.e. between a DELETE and an INSERT
+-- of --delete_inserts committed separately
+local validate_rows_unstable = false
+
+-- With --validate, SELECT queries are sent as plain queries and their results
+-- are checked: row counts of point and range selects, order of ORDER BY and
+-- DISTINCT ranges, and SUM(k) of ranges of rows only written by the current
+-- thread, i.e. with --key_partitioning, one partition per thread and
+-- --cross_partition_pct=0, against the updates made by the thread. Failures
+-- are counted in validation_failures.
+function init_validation()
+   validating = sysbench.opt.validate
+
+   if not validating then
+      return
+   end
+
+   -- Results of a single group are only available at its end
+   if batch_trx then
+      error("--validate cannot be used with --batch")
+   end
+
+   validate_failures = sysbench.counter.new("validation_failures")
+   validate_model = {}
+   validate_rows_unstable = sysbench.opt.skip_trx and
+      sysbench.opt.delete_inserts > 0
+end
+
+-- Whether rows with ids between a and b are only written by this thread
+local function owns_rows(tnum, a, b)
+   if sysbench.opt.cross_partition_pct > 0 or
+      (sysbench.opt.key_partitions ~= 0 and
+          sysbench.opt.key_partitions ~= sysbench.opt.threads)
+   then
+      return false
+   end
+
+   if part_tables ~= nil then
+      for _, t in ipairs(part_tables) do
+         if t == tnum then
+            return true
+         end
+      end
+      return false
+   end
+
+   return part_first ~= nil and a >= part_first and b <= part_last
+end
+
+local function validate_fail(fmt, ...)
+   validate_failures:add()
+
+   if validate_nprinted < VALIDATE_MAX_PRINTED then
+      validate_nprinted = validate_nprinted + 1
+      print(string.format("Validation failure: " .. fmt, ...))
+   end
+end
+
+-- Load k values of the rows of a table only written by this thread
+local function validate_load(tnum)
+   local query = "SELECT id, k FROM sbtest" .. tnum
+
+   if part_first ~= nil then
+      query = string.format("%s WHERE id BETWEEN %d AND %d", query,
+                            part_first, part_last)
+   end
+
+   local rs = con:query(query)
+   local rows = {}
+
+   for i = 1, rs.nrows do
+      local row = rs:fetch_row()
+      rows[tonumber(row[1])] = tonumber(row[2])
+   end
+
+   validate_model[tnum] = rows
+
+   return rows
+end
+
+-- Record k of a row written by this thread, nil for a deleted row, or apply
+-- 'delta' to it
+local function validate_set_k(tnum, id, k, delta)
+   local rows = validate_model[tnum]
+
+   if not validating or rows == nil or not owns_rows(tnum, id, id) then
+      return
+   end
+
+   if delta ~= nil then
+      k = rows[id] and rows[id] + delta
+   end
+
+   rows[id] = k
+end
+
+-- Execute a SELECT statement as a plain query with the given parameters
+local function validate_query(tnum, key, ...)
+   local args = {...}
+   local i = 0
+   local query = string.format(stmt_defs[key][1], tnum):gsub("%?", function ()
+      i = i + 1
+      return args[i]
+   end)
+
+   return con:query(query)
+end
+
+-- Range of the number of rows with ids between a and b. Rows up to
+-- --table_size always exist, unless deleted for a while, rows above it may
+-- have been appended.
+local function expected_rows(a, b)
+   local table_size = sysbench.opt.table_size
+   local min = math.max(0, math.min(b, table_size) - math.max(a, 1) + 1)
+   local appended = math.max(0, b - math.max(a, table_size + 1) + 1)
+
+   if validate_rows_unstable then
+      return 0, min + appended
+   end
+
+   return min, min + appended
+end
+
+local function validate_point_select(tnum, id)
+   local n = validate_query(tnum, "point_selects", id):count_rows()
+   local min, max = expected_rows(id, id)
+
+   if n < min or n > max then
+      validate_fail("point select of id %d in sbtest%d returned %d rows",
+                    id, tnum, n)
+   end
+end
+
+local function validate_range(key, tnum, a, b)
+   local rs = validate_query(tnum, key, a, b)
+   local min, max = expected_rows(a, b)
+   local n, sorted
+
+   if key == "sum_ranges" then
+      local sum
+      sum, n = rs:sum_column(1)
+
+      if n ~= 1 then
+         validate_fail("%s of ids %d-%d in sbtest%d returned %d rows",
+                       key, a, b, tnum, n)
+      elseif owns_rows(tnum, a, b) then
+         local rows = validate_model[tnum] or validate_load(tnum)
+         local expected = 0
+
+         for id = a, b do
+            expected = expected + (rows[id] or 0)
+         end
+
+         if sum ~= expected then
+            validate_fail("%s of ids %d-%d in sbtest%d returned %.0f, " ..
+                             "expected %.0f", key, a, b, tnum, sum, expected)
+         end
+      end
+
+      return
+   elseif key == "order_ranges" then
+      sorted, n = rs:check_sorted(1, false)
+   elseif key == "distinct_ranges" then
+      sorted, n = rs:check_sorted(1, true)
+      -- Any number of distinct values
+      min = math.min(min, 1)
+   else
+      n = rs:count_rows()
+   end
+
+   if sorted == false then
+      validate_fail("%s of ids %d-%d in sbtest%d returned unordered rows",
+                    key, a, b, tnum)
+   end
+
+   if n < min or n > max then
+      validate_fail("%s of ids %d-%d in sbtest%d returned %d rows, " ..
+                       "expected %d-%d", key, a, b, tnum, n, min, max)
+   end
 end
 
 function begin()
+   if batch_trx then
+      con:pipeline_begin()
+   end
    stmt.begin:execute()
 end
 
 function commit()
    stmt.commit:execute()
+   if batch_trx then
+      con:pipeline_end()
+   end
+end
+
+-- Statement groups within a transaction are only used when it is not sent as
+-- a single group
+local function group_begin()
+   if not batch_trx and not validating then
+      con:pipeline_begin()
+   end
+end
+
+local function group_end()
+   if not batch_trx and not validating then
+      con:pipeline_end()
+   end
 end
 
 function execute_point_selects()
    local tnum = get_table_num()
    local i
 
+   -- Statements cannot be prepared in pipeline mode
+   local st, params = get_stmt(tnum, "point_selects")
+
+   group_begin()
+
    for i = 1, sysbench.opt.point_selects do
-      param[tnum].point_selects[1]:set(get_id())
+      local id = get_id()
+
+      if validating then
+         validate_point_select(tnum, id)
+      else
+         params[1]:set_int(id)
 
-      stmt[tnum].point_selects:execute()
+         st:execute()
+      end
    end
+
+   group_end()
+end
+
+-- Move a range of --range_size ids starting at 'id' into the partition of
+-- 'id', see --align_ranges
+local function align_range(id)
+   local n = sysbench.opt.partitions
+   local p = math.min(math.floor((id - 1) * n / sysbench.opt.table_size),
+                      n - 1)
+
+   -- The estimate may be one partition too low due to rounding
+   while p < n - 1 and partition_first_id(p + 1) <= id do
+      p = p + 1
+   end
+
+   return math.max(partition_first_id(p),
+                   math.min(id, partition_first_id(p + 1) -
+                               sysbench.opt.range_size))
 end
 
 local function execute_range(key)
    local tnum = get_table_num()
 
+   -- Statements cannot be prepared in pipeline mode
+   local st, params = get_stmt(tnum, key)
+
+   group_begin()
+
    for i = 1, sysbench.opt[key] do
       local id = get_id()
 
-      param[tnum][key][1]:set(id)
-      param[tnum][key][2]:set(id + sysbench.opt.range_size - 1)
+      if sysbench.opt.align_ranges then
+         id = align_range(id)
+      end
 
-      stmt[tnum][key]:execute()
+      if validating then
+         validate_range(key, tnum, id, id + sysbench.opt.range_size - 1)
+      else
+         params[1]:set_int(id)
+         params[2]:set_int(id + sysbench.opt.range_size - 1)
+
+         st:execute()
+      end
    end
+
+   group_end()
 end
 
 function execute_simple_ranges()
@@ -453,55 +1526,138 @@ function execute_distinct_ranges()
    execute_range("distinct_ranges")
 end
 
+-- Secondary index lookups of random k values, which have the same distribution
+-- as ids
+function execute_k_ranges()
+   if sysbench.opt.k_ranges == 0 then
+      return
+   end
+
+   local tnum = get_table_num()
+   local st, params = get_stmt(tnum, "k_ranges")
+
+   group_begin()
+
+   for i = 1, sysbench.opt.k_ranges do
+      local k = rand_key(1, sysbench.opt.table_size)
+
+      params[1]:set_int(k)
+      params[2]:set_int(k + sysbench.opt.range_size - 1)
+
+      st:execute()
+   end
+
+   group_end()
+end
+
+function execute_k_in_lists()
+   if sysbench.opt.k_in_lists == 0 then
+      return
+   end
+
+   local tnum = get_table_num()
+   local st, params = get_stmt(tnum, "k_in_lists")
+
+   group_begin()
+
+   for i = 1, sysbench.opt.k_in_lists do
+      for p = 1, sysbench.opt.k_in_list_size do
+         params[p]:set_int(rand_key(1, sysbench.opt.table_size))
+      end
+
+      st:execute()
+   end
+
+   group_end()
+end
+
 function execute_index_updates()
    local tnum = get_table_num()
+   local st, params = get_stmt(tnum, "index_updates")
 
    for i = 1, sysbench.opt.index_updates do
-      param[tnum].index_updates[1]:set(get_id())
+      local id = get_id()
 
-      stmt[tnum].index_updates:execute()
+      params[1]:set_int(id)
+
+      st:execute()
+      validate_set_k(tnum, id, nil, 1)
    end
 end
 
 function execute_non_index_updates()
    local tnum = get_table_num()
+   local st, params = get_stmt(tnum, "non_index_updates")
 
    for i = 1, sysbench.opt.non_index_updates do
-      param[tnum].non_index_updates[1]:set_rand_str(c_value_template)
-      param[tnum].non_index_updates[2]:set(get_id())
+      params[1]:set_str_from_template(c_value_template)
+      params[2]:set_int(get_id())
 
-      stmt[tnum].non_index_updates:execute()
+      st:execute()
    end
 end
 
 function execute_delete_inserts()
    local tnum = get_table_num()
+   local del, del_params = get_stmt(tnum, "deletes")
+   local ins, ins_params = get_stmt(tnum, "inserts")
 
    for i = 1, sysbench.opt.delete_inserts do
       local id = get_id()
       local k = get_id()
 
-      param[tnum].deletes[1]:set(id)
+      del_params[1]:set_int(id)
+
+      ins_params[1]:set_int(id)
+      ins_params[2]:set_int(k)
+      ins_params[3]:set_str_from_template(c_value_template)
+      ins_params[4]:set_str_from_template(pad_value_template)
+
+      del:execute()
+      validate_set_k(tnum, id, nil)
+      ins:execute()
+      validate_set_k(tnum, id, k)
+   end
+end
+
+-- Insert new rows. The ids are reported to the 'latest' distribution right
+-- away, so reads by other threads may miss rows not committed yet.
+function execute_appends()
+   if sysbench.opt.appends == 0 then
+      return
+   end
 
-      param[tnum].inserts[1]:set(id)
-      param[tnum].inserts[2]:set(k)
-      param[tnum].inserts[3]:set_rand_str(c_value_template)
-      param[tnum].inserts[4]:set_rand_str(pad_value_template)
+   local tnum = get_table_num()
+   local ins, ins_params = get_stmt(tnum, "inserts")
 
-      stmt[tnum].deletes:execute()
-      stmt[tnum].inserts:execute()
+   for i = 1, sysbench.opt.appends do
+      local id = sysbench.rand.latest_next(sysbench.opt.table_size + 1)
+      local k = get_id()
+
+      ins_params[1]:set_int(id)
+      ins_params[2]:set_int(k)
+      ins_params[3]:set_str_from_template(c_value_template)
+      ins_params[4]:set_str_from_template(pad_value_template)
+
+      ins:execute()
+      validate_set_k(tnum, id, k)
+      sysbench.rand.latest_insert(id)
    end
 end
 
 -- Re-prepare statements if we have reconnected, which is possible when some of
 -- the listed error codes are in the --mysql-ignore-errors list
 function sysbench.hooks.before_restart_event(errdesc)
+   -- The --validate model may have updates rolled back with the event
+   validate_model = {}
+
    if errdesc.sql_errno == 2013 or -- CR_SERVER_LOST
       errdesc.sql_errno == 2055 or -- CR_SERVER_LOST_EXTENDED
       errdesc.sql_errno == 2006 or -- CR_SERVER_GONE_ERROR
       errdesc.sql_errno == 2011    -- CR_TCP_CONNECTION
    then
       close_statements()
+      init_statements()
       prepare_statements()
    end
 end
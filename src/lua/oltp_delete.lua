@@ -22,13 +22,20 @@
 require("oltp_common")
 
 function prepare_statements()
+   -- Deleted rows are not inserted back
+   if sysbench.opt.validate then
+      error("--validate is not supported by oltp_delete.lua")
+   end
+
    prepare_for_each_table("deletes")
 end
 
 function event()
-   local tnum = sysbench.rand.uniform(1, sysbench.opt.tables)
-   local id = sysbench.rand.default(1, sysbench.opt.table_size)
+   local tnum = get_table_num()
+   local id = get_id()
+
+   local st, params = get_stmt(tnum, "deletes")
 
-   param[tnum].deletes[1]:set(id)
-   stmt[tnum].deletes:execute()
+   params[1]:set(id)
+   st:execute()
 end
@@ -0,0 +1,136 @@
+#!/usr/bin/env sysbench
+-- -------------------------------------------------------------------------- --
+-- Hot row contention benchmark: each transaction updates one of a few "hot"
+-- rows at the start of a table, as with flash sales or global counters. The
+-- workload is set by --hot_mode:
+--
+--   counter   - increment the counter in k
+--   inventory - decrement the stock in k unless it is sold out
+--
+-- --hot_rows rows with ids 1 to --hot_rows are used, picked with the
+-- --hot_rand_type distribution, so only hot row accesses are skewed. With
+-- --hot_lock=for_update the row is locked with SELECT ... FOR UPDATE before
+-- being updated. With --hot_lock=skip_locked the first hot row not locked by
+-- other transactions is taken with SELECT ... FOR UPDATE SKIP LOCKED, and
+-- nothing is updated if all of them are locked.
+--
+-- Use --db-stmt-stats to see lock wait ("hot_lock") and commit latencies
+-- separately, and --db-retry-stats to see how often transactions are retried
+-- after deadlocks and lock wait timeouts.
+-- -------------------------------------------------------------------------- --
+
+require("oltp_common")
+
+sysbench.cmdline.options.hot_mode =
+   {"Hot row workload {counter, inventory}", "counter"}
+sysbench.cmdline.options.hot_rows =
+   {"Number of hot rows at the start of each table", 1}
+sysbench.cmdline.options.hot_rand_type =
+   {"Distribution of accesses to hot rows {uniform, gaussian, special, " ..
+       "pareto, zipfian}, see also --rand-zipfian-exp", "uniform"}
+sysbench.cmdline.options.hot_lock =
+   {"How hot rows are locked before being updated {none, for_update, " ..
+       "skip_locked}", "none"}
+
+local t = sysbench.sql.type
+
+define_stmt("hot_counter_updates", {
+   "UPDATE sbtest%u SET k=k+1 WHERE id=?",
+   t.INT})
+define_stmt("hot_inventory_updates", {
+   "UPDATE sbtest%u SET k=k-1 WHERE id=? AND k>0",
+   t.INT})
+define_stmt("hot_lock", {
+   "SELECT k FROM sbtest%u WHERE id=? FOR UPDATE",
+   t.INT})
+
+local hot_modes = { counter = true, inventory = true }
+local hot_locks = { none = true, for_update = true, skip_locked = true }
+local hot_rand_types = { uniform = true, gaussian = true, special = true,
+                         pareto = true, zipfian = true }
+
+function prepare_statements()
+   if not hot_modes[sysbench.opt.hot_mode] then
+      error("Invalid value for --hot_mode: " .. sysbench.opt.hot_mode)
+   end
+
+   if not hot_locks[sysbench.opt.hot_lock] then
+      error("Invalid value for --hot_lock: " .. sysbench.opt.hot_lock)
+   end
+
+   if not hot_rand_types[sysbench.opt.hot_rand_type] then
+      error("Invalid value for --hot_rand_type: " ..
+               sysbench.opt.hot_rand_type)
+   end
+
+   if sysbench.opt.hot_rows < 1 or
+      sysbench.opt.hot_rows > sysbench.opt.table_size
+   then
+      error("--hot_rows must be between 1 and --table_size")
+   end
+
+   if sysbench.opt.hot_lock ~= "none" and sysbench.opt.skip_trx then
+      error("--hot_lock cannot be used with --skip_trx")
+   end
+
+   -- The row to update is only known from the result of the locking query
+   if sysbench.opt.hot_lock == "skip_locked" and sysbench.opt.batch then
+      error("--hot_lock=skip_locked cannot be used with --batch")
+   end
+
+   if not sysbench.opt.skip_trx then
+      prepare_begin()
+      prepare_commit()
+   end
+
+   update_key = "hot_" .. sysbench.opt.hot_mode .. "_updates"
+   prepare_for_each_table(update_key)
+
+   if sysbench.opt.hot_lock == "for_update" then
+      prepare_for_each_table("hot_lock")
+   end
+
+   hot_rand = sysbench.rand[sysbench.opt.hot_rand_type]
+end
+
+-- Lock the first unlocked hot row and return its id, nil if all are locked
+local function lock_skip_locked(tnum)
+   local id = con:query_row(string.format(
+                               "SELECT id FROM sbtest%u WHERE id BETWEEN 1 " ..
+                                  "AND %d ORDER BY id LIMIT 1 " ..
+                                  "FOR UPDATE SKIP LOCKED",
+                               tnum, sysbench.opt.hot_rows))
+
+   return id and tonumber(id)
+end
+
+function event()
+   local tnum = get_table_num()
+   local id
+
+   if not sysbench.opt.skip_trx then
+      begin()
+   end
+
+   if sysbench.opt.hot_lock == "skip_locked" then
+      id = lock_skip_locked(tnum)
+   else
+      id = hot_rand(1, sysbench.opt.hot_rows)
+
+      if sysbench.opt.hot_lock == "for_update" then
+         local st, params = get_stmt(tnum, "hot_lock")
+         params[1]:set(id)
+         st:execute()
+      end
+   end
+
+   if id ~= nil then
+      local st, params = get_stmt(tnum, update_key)
+      params[1]:set(id)
+      st:execute()
+   end
+
+   if not sysbench.opt.skip_trx then
+      commit()
+   end
+end
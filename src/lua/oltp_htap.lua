@@ -0,0 +1,174 @@
+#!/usr/bin/env sysbench
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+-- ----------------------------------------------------------------------
+-- HTAP benchmark: the first --analytic_threads threads run aggregate scans
+-- over whole tables, all other threads run oltp_read_write transactions.
+--
+-- Both are reported in the "per-transaction statistics" section:
+--
+--   analytic         - analytic query durations
+--   oltp_concurrent  - OLTP transactions that overlapped an analytic query
+--   oltp_alone       - OLTP transactions that did not
+--
+-- so the latency percentiles of the last two show how much the scans hurt
+-- OLTP. Use --analytic_pause to leave gaps between scans, otherwise
+-- oltp_alone only gets transactions between the end of a scan and the start
+-- of the next one.
+-- ----------------------------------------------------------------------
+
+require("oltp_common")
+
+sysbench.cmdline.options.analytic_threads =
+   {"Number of threads running analytic queries", 1}
+sysbench.cmdline.options.analytic_query =
+   {"Analytic query {sum, group_by}", "sum"}
+sysbench.cmdline.options.analytic_groups =
+   {"Number of groups of --analytic_query=group_by", 100}
+sysbench.cmdline.options.analytic_pause =
+   {"Seconds each analytic thread sleeps between queries", 0}
+
+local analytic_queries = {
+   sum = "SELECT SUM(k) FROM sbtest%u",
+   group_by = "SELECT k %% %d, COUNT(*), SUM(k) FROM sbtest%u GROUP BY 1"
+}
+
+function prepare_statements()
+   if analytic_queries[sysbench.opt.analytic_query] == nil then
+      error("Invalid value for --analytic_query: " ..
+               sysbench.opt.analytic_query)
+   end
+
+   if sysbench.opt.analytic_threads < 0 or
+      sysbench.opt.analytic_threads > sysbench.opt.threads
+   then
+      error("--analytic_threads must be between 0 and --threads")
+   end
+
+   if sysbench.opt.analytic_groups < 1 then
+      error("Invalid value for --analytic_groups: " ..
+               sysbench.opt.analytic_groups)
+   end
+
+   if sysbench.opt.analytic_pause < 0 then
+      error("Invalid value for --analytic_pause: " ..
+               sysbench.opt.analytic_pause)
+   end
+
+   -- Number of analytic queries started and running
+   scans_started = sysbench.shared.counter("htap_scans_started")
+   scans_running = sysbench.shared.counter("htap_scans_running")
+
+   analytic = sysbench.tid % sysbench.opt.threads <
+      sysbench.opt.analytic_threads
+
+   if analytic then
+      analytic_stat = sysbench.sql.txn_stat("analytic")
+      return
+   end
+
+   oltp_concurrent_stat = sysbench.sql.txn_stat("oltp_concurrent")
+   oltp_alone_stat = sysbench.sql.txn_stat("oltp_alone")
+
+   if not sysbench.opt.skip_trx then
+      prepare_begin()
+      prepare_commit()
+   end
+
+   prepare_point_selects()
+
+   if sysbench.opt.range_selects then
+      prepare_simple_ranges()
+      prepare_sum_ranges()
+      prepare_order_ranges()
+      prepare_distinct_ranges()
+   end
+
+   prepare_index_updates()
+   prepare_non_index_updates()
+   prepare_delete_inserts()
+   prepare_appends()
+end
+
+local function analytic_event()
+   local tnum = sysbench.rand.uniform(1, sysbench.opt.tables)
+   local query
+
+   if sysbench.opt.analytic_query == "group_by" then
+      query = string.format(analytic_queries.group_by,
+                            sysbench.opt.analytic_groups, tnum)
+   else
+      query = string.format(analytic_queries.sum, tnum)
+   end
+
+   scans_started:add()
+   scans_running:add()
+
+   local start = analytic_stat:start()
+   local ok, err = pcall(function () con:query(query):count_rows() end)
+
+   scans_running:add(-1)
+
+   if not ok then
+      error(err, 0)
+   end
+
+   analytic_stat:stop(start)
+
+   sysbench.sleep(sysbench.opt.analytic_pause)
+end
+
+local function oltp_event()
+   local started = scans_started:get()
+   local concurrent = scans_running:get() > 0
+   local start = oltp_alone_stat:start()
+
+   if not sysbench.opt.skip_trx then
+      begin()
+   end
+
+   execute_point_selects()
+
+   if sysbench.opt.range_selects then
+      execute_simple_ranges()
+      execute_sum_ranges()
+      execute_order_ranges()
+      execute_distinct_ranges()
+   end
+
+   execute_index_updates()
+   execute_non_index_updates()
+   execute_delete_inserts()
+   execute_appends()
+
+   if not sysbench.opt.skip_trx then
+      commit()
+   end
+
+   -- A scan ran at the start, or started before the end of the transaction
+   if concurrent or scans_started:get() ~= started then
+      oltp_concurrent_stat:stop(start)
+   else
+      oltp_alone_stat:stop(start)
+   end
+end
+
+function event()
+   if analytic then
+      analytic_event()
+   else
+      oltp_event()
+   end
+end
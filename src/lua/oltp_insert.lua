@@ -21,13 +21,66 @@
 
 require("oltp_common")
 
+sysbench.cmdline.options.key_type =
+   {"Primary key generation: 'auto' for auto-increment ids with " ..
+       "--auto_inc and 'random' otherwise, 'random' for unique 64-bit " ..
+       "values in random order, 'sequential' for consecutive ids within " ..
+       "each thread, 'hashed' for sequential ids scattered by a hash " ..
+       "function, 'snowflake' for time-ordered 64-bit ids, 'uuid4' for " ..
+       "random UUIDs, 'uuid7' or 'ulid' for time-ordered 128-bit ids. " ..
+       "Values other than 'auto' imply --auto_inc=off", "auto"}
+
+-- Generators of client-generated 64-bit and 128-bit ids by --key_type
+local int_keys = { random = "unique64", sequential = "key_sequential",
+                   hashed = "key_hashed", snowflake = "key_snowflake" }
+local uuid_keys = { uuid4 = "uuid4", uuid7 = "uuid7", ulid = "ulid" }
+
+-- Function returning the next client-generated id as an SQL literal
+local next_key
+
+local function check_key_type(drv)
+   local key_type = sysbench.opt.key_type
+
+   if key_type == "auto" then
+      key_type = not sysbench.opt.auto_inc and "random" or nil
+   elseif int_keys[key_type] == nil and uuid_keys[key_type] == nil then
+      error("Invalid value for --key_type: " .. key_type)
+   else
+      sysbench.opt.auto_inc = false
+   end
+
+   uuid_ids = uuid_keys[key_type] ~= nil
+
+   if uuid_ids then
+      if sysbench.opt.partitions > 0 then
+         error("--partitions is not supported with --key_type=" .. key_type)
+      end
+
+      local gen = sysbench.rand[uuid_keys[key_type]]
+      local fmt = drv:name() == "pgsql" and "'%s'" or "X'%s'"
+
+      next_key = function() return string.format(fmt, gen()) end
+   elseif key_type ~= nil then
+      local gen = sysbench.rand[int_keys[key_type]]
+
+      next_key = function()
+         -- Convert a uint64_t value to SQL BIGINT
+         return tostring(ffi.cast("int64_t", gen())):sub(1, -3) -- strip "LL"
+      end
+   end
+end
+
 sysbench.cmdline.commands.prepare = {
    function ()
+      check_key_type(sysbench.sql.driver())
+
       if (not sysbench.opt.auto_inc) then
          -- Create empty tables on prepare when --auto-inc is off, since IDs
-         -- generated on prepare may collide later with values generated by
-         -- sysbench.rand.unique()
+         -- generated on prepare may collide later with client-generated
+         -- ones. These are 64-bit or 128-bit, so the id column is BIGINT or
+         -- a 16-byte type.
          sysbench.opt.table_size=0
+         bigint_ids = true
       end
 
       cmd_prepare()
@@ -35,18 +88,35 @@ sysbench.cmdline.commands.prepare = {
    sysbench.cmdline.PARALLEL_COMMAND
 }
 
+local common_thread_init = thread_init
+
+function thread_init()
+   check_key_type(sysbench.sql.driver())
+   common_thread_init()
+end
+
 function prepare_statements()
    -- We do not use prepared statements here, but oltp_common.sh expects this
    -- function to be defined
 end
 
 function event()
-   local table_name = "sbtest" .. sysbench.rand.uniform(1, sysbench.opt.tables)
-   local k_val = sysbench.rand.default(1, sysbench.opt.table_size)
+   local table_name = "sbtest" .. get_table_num()
+   local k_val = get_id()
    local c_val = get_c_value()
    local pad_val = get_pad_value()
 
-   if (drv:name() == "pgsql" and sysbench.opt.auto_inc) then
+   if sysbench.opt.rand_type == "latest" then
+      -- Append rows with consecutive IDs shared by all threads and tables, so
+      -- that reads with the 'latest' distribution favor the newest rows
+      i = sysbench.rand.latest_next(sysbench.opt.table_size + 1)
+
+      con:query(string.format("INSERT INTO %s (id, k, c, pad) VALUES " ..
+                                 "(%d, %d, '%s', '%s')",
+                              table_name, i, k_val, c_val, pad_val))
+      sysbench.rand.latest_insert(i)
+   elseif ((drv:name() == "pgsql" or drv:name() == "sqlite") and
+       sysbench.opt.auto_inc) then
       con:query(string.format("INSERT INTO %s (k, c, pad) VALUES " ..
                                  "(%d, '%s', '%s')",
                               table_name, k_val, c_val, pad_val))
@@ -54,12 +124,11 @@ function event()
       if (sysbench.opt.auto_inc) then
          i = 0
       else
-         -- Convert a uint32_t value to SQL INT
-         i = sysbench.rand.unique() - 2147483648
+         i = next_key()
       end
 
       con:query(string.format("INSERT INTO %s (id, k, c, pad) VALUES " ..
-                                 "(%d, %d, '%s', '%s')",
+                                 "(%s, %d, '%s', '%s')",
                               table_name, i, k_val, c_val, pad_val))
    end
 end
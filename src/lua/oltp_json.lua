@@ -0,0 +1,287 @@
+#!/usr/bin/env sysbench
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+-- ----------------------------------------------------------------------
+-- JSON document OLTP benchmark. Rows of sbtest tables are stored as
+-- documents like
+--
+--   {"k": 123, "tag": "tag45", "v": 0, "payload": "..."}
+--
+-- in a JSON column with MySQL, a JSONB column with PostgreSQL and a TEXT
+-- column with SQLite. The payload length follows --json_payload_rand_type
+-- between --json_payload_min and --json_payload_max characters.
+--
+-- Documents are looked up by id, by "k" and by "tag", and updated in place
+-- with JSON_SET()/jsonb_set()/json_set(). "k" and "tag" are indexed unless
+-- --create_secondary is off:
+--
+--   MySQL       - indexed virtual columns extracted from the document
+--   PostgreSQL  - an expression index on "k" and a GIN index on the whole
+--                 document, used by tag lookups with @>
+--   SQLite      - expression indexes on json_extract()
+--
+-- Tables are prepared, loaded and reported like in the other oltp_*.lua
+-- scripts, with each statement type under its own label in
+-- --db-stmt-stats.
+-- ----------------------------------------------------------------------
+
+require("oltp_common")
+
+sysbench.cmdline.options.json_point_selects =
+   {"Number of document lookups by id per transaction", 10}
+sysbench.cmdline.options.json_k_lookups =
+   {"Number of lookups by the indexed \"k\" field per transaction", 1}
+sysbench.cmdline.options.json_tag_lookups =
+   {"Number of lookups of up to 10 documents by the indexed \"tag\" " ..
+       "field per transaction", 1}
+sysbench.cmdline.options.json_index_updates =
+   {"Number of partial updates of the indexed \"k\" field per transaction", 1}
+sysbench.cmdline.options.json_non_index_updates =
+   {"Number of partial updates of the non-indexed \"v\" field per " ..
+       "transaction", 1}
+sysbench.cmdline.options.json_tags =
+   {"Number of distinct \"tag\" values", 100}
+sysbench.cmdline.options.json_payload_min =
+   {"Minimum length of the document payload", 16}
+sysbench.cmdline.options.json_payload_max =
+   {"Maximum length of the document payload", 512}
+sysbench.cmdline.options.json_payload_rand_type =
+   {"Distribution of payload lengths {uniform, gaussian, special, pareto, " ..
+       "zipfian}", "uniform"}
+
+local payload_rand_types = { uniform = true, gaussian = true, special = true,
+                             pareto = true, zipfian = true }
+
+-- Per-driver SQL: column definitions, index definitions and statements
+local t = sysbench.sql.type
+local dialects = {
+   mysql = {
+      columns = [[
+  doc JSON NOT NULL,
+  k INTEGER AS (JSON_EXTRACT(doc, '$.k')) VIRTUAL,
+  tag VARCHAR(16) AS (JSON_UNQUOTE(JSON_EXTRACT(doc, '$.tag'))) VIRTUAL,]],
+      indexes = {
+         "CREATE INDEX k_%d ON sbtest%d(k)",
+         "CREATE INDEX tag_%d ON sbtest%d(tag)"
+      },
+      k_lookups = "SELECT id FROM sbtest%u WHERE k=?",
+      tag_lookups = "SELECT id FROM sbtest%u WHERE tag=? LIMIT 10",
+      index_updates = "UPDATE sbtest%u SET doc=JSON_SET(doc, '$.k', ?) " ..
+         "WHERE id=?",
+      non_index_updates = "UPDATE sbtest%u SET doc=JSON_SET(doc, '$.v', " ..
+         "JSON_EXTRACT(doc, '$.v') + 1) WHERE id=?"
+   },
+   pgsql = {
+      columns = [[
+  doc JSONB NOT NULL,]],
+      indexes = {
+         "CREATE INDEX k_%d ON sbtest%d(((doc->>'k')::integer))",
+         "CREATE INDEX tag_%d ON sbtest%d USING GIN (doc jsonb_path_ops)"
+      },
+      k_lookups = "SELECT id FROM sbtest%u WHERE (doc->>'k')::integer=?",
+      tag_lookups = "SELECT id FROM sbtest%u " ..
+         "WHERE doc @> jsonb_build_object('tag', ?::text) LIMIT 10",
+      index_updates = "UPDATE sbtest%u SET doc=jsonb_set(doc, '{k}', " ..
+         "to_jsonb(?::integer)) WHERE id=?",
+      non_index_updates = "UPDATE sbtest%u SET doc=jsonb_set(doc, '{v}', " ..
+         "to_jsonb((doc->>'v')::integer + 1)) WHERE id=?"
+   },
+   sqlite = {
+      columns = [[
+  doc TEXT NOT NULL,]],
+      indexes = {
+         "CREATE INDEX k_%d ON sbtest%d(json_extract(doc, '$.k'))",
+         "CREATE INDEX tag_%d ON sbtest%d(json_extract(doc, '$.tag'))"
+      },
+      k_lookups = "SELECT id FROM sbtest%u WHERE json_extract(doc, '$.k')=?",
+      tag_lookups = "SELECT id FROM sbtest%u " ..
+         "WHERE json_extract(doc, '$.tag')=? LIMIT 10",
+      index_updates = "UPDATE sbtest%u SET doc=json_set(doc, '$.k', ?) " ..
+         "WHERE id=?",
+      non_index_updates = "UPDATE sbtest%u SET doc=json_set(doc, '$.v', " ..
+         "json_extract(doc, '$.v') + 1) WHERE id=?"
+   }
+}
+
+local function dialect(drv)
+   local d = dialects[drv:name()]
+
+   if d == nil then
+      error("Unsupported database driver:" .. drv:name())
+   end
+
+   return d
+end
+
+local function check_options()
+   if sysbench.opt.json_tags < 1 then
+      error("Invalid value for --json_tags: " .. sysbench.opt.json_tags)
+   end
+
+   if sysbench.opt.json_payload_min < 0 or
+      sysbench.opt.json_payload_max < sysbench.opt.json_payload_min
+   then
+      error("Invalid payload length range: " ..
+               sysbench.opt.json_payload_min .. ".." ..
+               sysbench.opt.json_payload_max)
+   end
+
+   if not payload_rand_types[sysbench.opt.json_payload_rand_type] then
+      error("Invalid value for --json_payload_rand_type: " ..
+               sysbench.opt.json_payload_rand_type)
+   end
+end
+
+local function rand_tag()
+   return "tag" .. sysbench.rand.uniform(1, sysbench.opt.json_tags)
+end
+
+-- Random document with a payload length from --json_payload_rand_type. The
+-- payload only has letters, so it needs no escaping in JSON or SQL.
+local function get_doc()
+   local len = sysbench.rand[sysbench.opt.json_payload_rand_type](
+      sysbench.opt.json_payload_min, sysbench.opt.json_payload_max)
+   local payload = len > 0 and sysbench.rand.string(string.rep("@", len)) or ""
+
+   return string.format('{"k": %d, "tag": "%s", "v": 0, "payload": "%s"}',
+                        sysbench.rand.default(1, sysbench.opt.table_size),
+                        rand_tag(), payload)
+end
+
+-- The following replace the sbtest schema and data of oltp_common.lua, which
+-- calls them from its prepare command
+
+function create_table_def(drv, con, table_num, exists)
+   local engine_def = ""
+
+   check_options()
+
+   if drv:name() == "mysql" then
+      engine_def = "/*! ENGINE = " .. sysbench.opt.mysql_storage_engine .. " */"
+   end
+
+   if exists then
+      print(string.format("Using existing table 'sbtest%d'...", table_num))
+      return
+   end
+
+   print(string.format("Creating table 'sbtest%d'...", table_num))
+
+   con:query(string.format([[
+CREATE TABLE sbtest%d(
+  id %s NOT NULL,
+%s
+  PRIMARY KEY (id)
+) %s %s]],
+      table_num, sysbench.opt.table_size > 2147483647 and "BIGINT" or "INTEGER",
+      dialect(drv).columns, engine_def, sysbench.opt.create_table_options))
+end
+
+-- Documents are generated in Lua, so there is no native bulk loading
+function load_table_copy()
+   return false
+end
+
+function load_table_insert(con, table_num, first, count)
+   con:bulk_insert_init("INSERT INTO sbtest" .. table_num .. "(id, doc) VALUES")
+
+   for i = first, first + count - 1 do
+      con:bulk_insert_next(string.format("(%d, '%s')", i, get_doc()))
+   end
+
+   con:bulk_insert_done()
+end
+
+function create_secondary_index(con, table_num)
+   if not sysbench.opt.create_secondary then
+      return
+   end
+
+   if sysbench.opt.resume then
+      error("--resume is not supported by oltp_json.lua")
+   end
+
+   print(string.format("Creating secondary indexes on 'sbtest%d'...",
+                       table_num))
+
+   for _, idx in ipairs(dialect(con.driver).indexes) do
+      con:query(string.format(idx, table_num, table_num))
+   end
+end
+
+function prepare_statements()
+   local d = dialect(drv)
+
+   check_options()
+
+   define_stmt("json_point_selects", {
+      "SELECT doc FROM sbtest%u WHERE id=?",
+      t.INT})
+   define_stmt("json_k_lookups", {d.k_lookups, t.INT})
+   define_stmt("json_tag_lookups", {d.tag_lookups, {t.VARCHAR, 16}})
+   define_stmt("json_index_updates", {d.index_updates, t.INT, t.INT})
+   define_stmt("json_non_index_updates", {d.non_index_updates, t.INT})
+
+   if not sysbench.opt.skip_trx then
+      prepare_begin()
+      prepare_commit()
+   end
+
+   prepare_for_each_table("json_point_selects")
+   prepare_for_each_table("json_k_lookups")
+   prepare_for_each_table("json_tag_lookups")
+   prepare_for_each_table("json_index_updates")
+   prepare_for_each_table("json_non_index_updates")
+end
+
+-- Execute a statement of a random table --json_<key> times, setting its
+-- parameters with set_params(params)
+local function execute_json(key, set_params)
+   local st, params = get_stmt(get_table_num(), key)
+
+   for i = 1, sysbench.opt[key] do
+      set_params(params)
+      st:execute()
+   end
+end
+
+local function set_id(params)
+   params[1]:set_int(get_id())
+end
+
+local function set_tag(params)
+   params[1]:set(rand_tag())
+end
+
+local function set_k_and_id(params)
+   params[1]:set_int(get_id())
+   params[2]:set_int(get_id())
+end
+
+function event()
+   if not sysbench.opt.skip_trx then
+      begin()
+   end
+
+   execute_json("json_point_selects", set_id)
+   execute_json("json_k_lookups", set_id)
+   execute_json("json_tag_lookups", set_tag)
+   execute_json("json_index_updates", set_k_and_id)
+   execute_json("json_non_index_updates", set_id)
+
+   if not sysbench.opt.skip_trx then
+      commit()
+   end
+end
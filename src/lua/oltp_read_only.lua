@@ -34,6 +34,8 @@ function prepare_statements()
       prepare_sum_ranges()
       prepare_order_ranges()
       prepare_distinct_ranges()
+      prepare_k_ranges()
+      prepare_k_in_lists()
    end
 end
 
@@ -49,6 +51,8 @@ function event()
       execute_sum_ranges()
       execute_order_ranges()
       execute_distinct_ranges()
+      execute_k_ranges()
+      execute_k_in_lists()
    end
 
    if not sysbench.opt.skip_trx then
@@ -34,11 +34,14 @@ function prepare_statements()
       prepare_sum_ranges()
       prepare_order_ranges()
       prepare_distinct_ranges()
+      prepare_k_ranges()
+      prepare_k_in_lists()
    end
 
    prepare_index_updates()
    prepare_non_index_updates()
    prepare_delete_inserts()
+   prepare_appends()
 end
 
 function event()
@@ -53,11 +56,14 @@ function event()
       execute_sum_ranges()
       execute_order_ranges()
       execute_distinct_ranges()
+      execute_k_ranges()
+      execute_k_in_lists()
    end
 
    execute_index_updates()
    execute_non_index_updates()
    execute_delete_inserts()
+   execute_appends()
 
    if not sysbench.opt.skip_trx then
       commit()
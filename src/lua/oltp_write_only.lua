@@ -30,6 +30,7 @@ function prepare_statements()
    prepare_index_updates()
    prepare_non_index_updates()
    prepare_delete_inserts()
+   prepare_appends()
 end
 
 function event()
@@ -40,6 +41,7 @@ function event()
    execute_index_updates()
    execute_non_index_updates()
    execute_delete_inserts()
+   execute_appends()
 
    if not sysbench.opt.skip_trx then
       commit()
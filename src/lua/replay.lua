@@ -0,0 +1,535 @@
+#!/usr/bin/env sysbench
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+-- -----------------------------------------------------------------------------
+-- Query log replay. Reads a captured query log given by --replay_log in one
+-- of the following --replay_format formats:
+--
+--   mysql_general - MySQL general query log. Query and Execute commands are
+--                   replayed, Init DB and the database of Connect as USE.
+--   mysql_slow    - MySQL slow query log, e.g. with long_query_time=0
+--   pgsql_csv     - PostgreSQL CSV log (log_destination=csvlog) with
+--                   log_statement=all or log_min_duration_statement=0.
+--                   Parameters of extended protocol statements are
+--                   substituted into the query text.
+--   sysbench      - one query per line as TIMESTAMP<tab>SESSION<tab>QUERY,
+--                   where TIMESTAMP is in seconds, and newlines, tabs and
+--                   backslashes in QUERY are escaped as \n, \t and \\
+--
+-- Each session of the log gets its own connection and is replayed by one
+-- thread, so statements of a session are executed in their original order.
+-- Sessions are assigned to threads round-robin in order of appearance. Each
+-- thread stops at the end of the log.
+--
+-- With --replay_speed > 0, statements are started at their original offsets
+-- from the first statement of the log divided by the speed, or as soon as
+-- possible when the session is behind. 0 replays as fast as possible. Waits
+-- count towards event latency, so with --db-stmt-stats query latency is
+-- reported for each fingerprint, i.e. query text with literals replaced by
+-- '?' and lists of literals collapsed, in the "per-statement statistics"
+-- section.
+-- -----------------------------------------------------------------------------
+
+if sysbench.cmdline.command == nil then
+   error("Command is required. Supported commands: run, help")
+end
+
+sysbench.cmdline.options = {
+   replay_log =
+      {"Query log file to replay"},
+   replay_format =
+      {"Format of --replay_log {mysql_general, mysql_slow, pgsql_csv, " ..
+          "sysbench}", "mysql_general"},
+   replay_speed =
+      {"Speed-up factor of the original timing of the log, 0 to replay as " ..
+          "fast as possible", 1},
+   replay_ignore_errors =
+      {"Count failed queries as errors and go on with the replay", true}
+}
+
+-- -----------------------------------------------------------------------------
+-- Log parsers. Each one is an iterator over entries of the log as
+-- {ts = seconds, session = id, query = text}, with query set to nil for the
+-- end of a session.
+-- -----------------------------------------------------------------------------
+
+-- Convert a date and time to seconds. Only differences between timestamps
+-- matter, so time zones are ignored.
+local function to_seconds(year, month, day, hour, min, sec)
+   local int = math.floor(tonumber(sec))
+
+   return os.time({year = tonumber(year), month = tonumber(month),
+                   day = tonumber(day), hour = tonumber(hour),
+                   min = tonumber(min), sec = int}) + tonumber(sec) - int
+end
+
+-- Parse ISO 8601 "2024-01-31T10:00:00.123456Z" or "2024-01-31 10:00:00.123",
+-- as well as "240131 10:00:00" of MySQL 5.6 logs
+local function parse_time(s)
+   local y, mo, d, h, mi, sec =
+      s:match("^(%d%d%d%d)%-(%d%d)%-(%d%d)[T ](%d+):(%d+):([%d%.]+)")
+
+   if y == nil then
+      y, mo, d, h, mi, sec =
+         s:match("^(%d%d)(%d%d)(%d%d) +(%d+):(%d+):([%d%.]+)")
+      if y == nil then
+         return nil
+      end
+      y = 2000 + tonumber(y)
+   end
+
+   return to_seconds(y, mo, d, h, mi, sec)
+end
+
+-- Server startup lines repeated in MySQL logs after each restart
+local function mysql_header(line)
+   return line:find("^%S+, Version: ") or line:find("^Tcp port: ") or
+      line:find("^Time%s+Id%s+Command%s+Argument")
+end
+
+local function mysql_general_entries(file)
+   local ts
+   local pending
+
+   return coroutine.wrap(function ()
+      -- Commands are single lines unless a query spans several lines
+      local function flush()
+         if pending ~= nil then
+            coroutine.yield(pending)
+            pending = nil
+         end
+      end
+
+      for line in file:lines() do
+         local time, id, cmd, arg =
+            line:match("^([^\t]*)\t+%s*(%d+) ([%a ]-)\t(.*)$")
+
+         if id ~= nil then
+            flush()
+
+            ts = parse_time(time) or ts
+
+            if cmd == "Query" or cmd == "Execute" then
+               pending = {ts = ts, session = id, query = arg}
+            elseif cmd == "Init DB" then
+               pending = {ts = ts, session = id, query = "USE " .. arg}
+            elseif cmd == "Connect" then
+               local db = arg:match(" on (%S+)")
+               if db ~= nil then
+                  pending = {ts = ts, session = id, query = "USE " .. db}
+               end
+            elseif cmd == "Quit" then
+               pending = {ts = ts, session = id}
+            end
+         elseif mysql_header(line) then
+            flush()
+         elseif pending ~= nil and pending.query ~= nil then
+            pending.query = pending.query .. "\n" .. line
+         end
+      end
+
+      flush()
+   end)
+end
+
+local function mysql_slow_entries(file)
+   local ts, id = nil, "0"
+   local query
+
+   return coroutine.wrap(function ()
+      for line in file:lines() do
+         if line:find("^#") then
+            ts = parse_time(line:match("^# Time: (.*)") or "") or ts
+            id = line:match("^# User@Host:.*Id:%s*(%d+)") or id
+         elseif not mysql_header(line) then
+            local stamp = line:match("^SET timestamp=(%d+);$")
+
+            if stamp ~= nil and query == nil then
+               -- Only has a second resolution, use it if there is no # Time:
+               ts = ts or tonumber(stamp)
+            else
+               query = query and query .. "\n" .. line or line
+
+               -- Statements end with a semicolon at the end of a line
+               if query:find(";%s*$") then
+                  coroutine.yield({ts = ts, session = id,
+                                   query = query:gsub(";%s*$", "")})
+                  query = nil
+               end
+            end
+         end
+      end
+   end)
+end
+
+-- Split a CSV record into fields, reading more lines if a quoted field spans
+-- several lines. Returns nil at the end of the file.
+local function csv_record(lines)
+   local line = lines()
+   local fields = {}
+   local pos = 1
+
+   if line == nil then
+      return nil
+   end
+
+   while true do
+      if line:sub(pos, pos) == '"' then
+         local value = {}
+         pos = pos + 1
+
+         while true do
+            local q = line:find('"', pos, true)
+
+            if q == nil then
+               -- The field continues on the next line
+               value[#value + 1] = line:sub(pos) .. "\n"
+               line = lines()
+               if line == nil then
+                  return nil
+               end
+               pos = 1
+            elseif line:sub(q + 1, q + 1) == '"' then
+               value[#value + 1] = line:sub(pos, q)
+               pos = q + 2
+            else
+               value[#value + 1] = line:sub(pos, q - 1)
+               pos = q + 1
+               break
+            end
+         end
+
+         fields[#fields + 1] = table.concat(value)
+      else
+         local comma = line:find(",", pos, true) or #line + 1
+         fields[#fields + 1] = line:sub(pos, comma - 1)
+         pos = comma
+      end
+
+      if line:sub(pos, pos) ~= "," then
+         return fields
+      end
+
+      pos = pos + 1
+   end
+end
+
+-- Substitute "parameters: $1 = '...', $2 = NULL" from a log DETAIL field
+-- into a query
+local function pgsql_bind(query, detail)
+   local params = {}
+   local pos = detail:find("parameters: ", 1, true)
+
+   if pos == nil then
+      return query
+   end
+
+   pos = pos + #"parameters: "
+
+   while true do
+      local n, e = detail:match("^%$(%d+) = ()", pos)
+
+      if n == nil then
+         break
+      end
+
+      local value
+
+      if detail:sub(e, e) == "'" then
+         -- Quoted with '' for quotes inside
+         local q = e + 1
+
+         while true do
+            q = detail:find("'", q, true)
+            if q == nil or detail:sub(q + 1, q + 1) ~= "'" then
+               break
+            end
+            q = q + 2
+         end
+
+         q = q or #detail
+         value = detail:sub(e, q)
+         pos = q + 1
+      else
+         local comma = detail:find(",", e, true) or #detail + 1
+         value = detail:sub(e, comma - 1)
+         pos = comma
+      end
+
+      params[n] = value
+      pos = (detail:match("^, ()", pos)) or pos
+   end
+
+   return (query:gsub("%$(%d+)", function (n) return params[n] end))
+end
+
+local function pgsql_csv_entries(file)
+   local lines = file:lines()
+
+   return coroutine.wrap(function ()
+      while true do
+         local f = csv_record(lines)
+
+         if f == nil then
+            break
+         end
+
+         -- log_time, ..., session_id (6th), ..., message (14th), detail
+         local ts = parse_time(f[1] or "")
+         local session = f[6]
+         local msg = f[14] or ""
+         local query = msg:match("^statement: (.*)") or
+            msg:match("^duration: [%d%.]+ ms  statement: (.*)")
+
+         if query == nil then
+            query = msg:match("^execute [^:]*: (.*)") or
+               msg:match("^duration: [%d%.]+ ms  execute [^:]*: (.*)")
+            if query ~= nil then
+               query = pgsql_bind(query, f[15] or "")
+            end
+         end
+
+         if query ~= nil then
+            coroutine.yield({ts = ts, session = session, query = query})
+         elseif msg:find("^disconnection: ") then
+            coroutine.yield({ts = ts, session = session})
+         end
+      end
+   end)
+end
+
+local unescapes = { n = "\n", t = "\t", ["\\"] = "\\" }
+
+local function sysbench_entries(file)
+   return coroutine.wrap(function ()
+      for line in file:lines() do
+         local ts, session, query = line:match("^([^\t]*)\t([^\t]*)\t(.*)$")
+
+         if ts ~= nil then
+            coroutine.yield({ts = tonumber(ts), session = session,
+                             query = query:gsub("\\(.)", unescapes)})
+         end
+      end
+   end)
+end
+
+local parsers = {
+   mysql_general = mysql_general_entries,
+   mysql_slow = mysql_slow_entries,
+   pgsql_csv = pgsql_csv_entries,
+   sysbench = sysbench_entries
+}
+
+-- -----------------------------------------------------------------------------
+-- Fingerprints
+-- -----------------------------------------------------------------------------
+
+-- Replace quoted literals starting at quote characters in 'quotes' with '?'.
+-- Quotes inside literals are doubled or escaped with a backslash.
+local function strip_strings(query, quotes)
+   local out = {}
+   local pos = 1
+
+   while true do
+      local s = query:find(quotes, pos)
+
+      if s == nil then
+         out[#out + 1] = query:sub(pos)
+         break
+      end
+
+      local quote = query:sub(s, s)
+      local i = s + 1
+
+      while i <= #query do
+         local c = query:sub(i, i)
+
+         if c == "\\" then
+            i = i + 2
+         elseif c == quote and query:sub(i + 1, i + 1) == quote then
+            i = i + 2
+         elseif c == quote then
+            break
+         else
+            i = i + 1
+         end
+      end
+
+      out[#out + 1] = query:sub(pos, s - 1)
+      out[#out + 1] = "?"
+      pos = i + 1
+   end
+
+   return table.concat(out)
+end
+
+-- Fingerprint of a query: literals replaced by '?', lists of them collapsed
+-- to '(...)' and whitespace normalized. Double quotes delimit identifiers in
+-- PostgreSQL and strings in MySQL.
+local function fingerprint(query, quotes)
+   local fp = strip_strings(query, quotes)
+      :gsub("%f[%w_$]%d[%w.]*", "?")
+      :gsub("%s+", " ")
+      :gsub("^ ", "")
+      :gsub(" $", "")
+      :gsub("%(%?[%s,%?]*%)", "(...)")
+
+   local n
+   repeat
+      fp, n = fp:gsub("%(%.%.%.%)%s*,%s*%(%.%.%.%)", "(...)")
+   until n == 0
+
+   return fp
+end
+
+-- -----------------------------------------------------------------------------
+-- Replay
+-- -----------------------------------------------------------------------------
+
+function thread_init()
+   if sysbench.opt.replay_log == "" then
+      error("--replay_log is required")
+   end
+
+   local parser = parsers[sysbench.opt.replay_format]
+
+   if parser == nil then
+      error("Invalid value for --replay_format: " .. sysbench.opt.replay_format)
+   end
+
+   if sysbench.opt.replay_speed < 0 then
+      error("Invalid value for --replay_speed: " .. sysbench.opt.replay_speed)
+   end
+
+   local file, err = io.open(sysbench.opt.replay_log)
+
+   if file == nil then
+      error("Cannot open --replay_log: " .. err)
+   end
+
+   log_file = file
+   entries = parser(file)
+
+   drv = sysbench.sql.driver()
+   quotes = drv:name() == "pgsql" and "'" or "['\"]"
+
+   -- Connections of sessions of this thread
+   cons = {}
+   -- Threads of all sessions by id, in order of appearance
+   session_threads = {}
+   nsessions = 0
+   -- Query statistics by fingerprint
+   query_stats = {}
+
+   thread_id = sysbench.tid % sysbench.opt.threads
+end
+
+function thread_done()
+   for _, con in pairs(cons) do
+      con:disconnect()
+   end
+
+   log_file:close()
+end
+
+-- Count failed queries rather than abort the replay
+function sysbench.hooks.sql_error_ignorable(err)
+   return sysbench.opt.replay_ignore_errors
+end
+
+-- Return the next entry of a session replayed by this thread, or nil at the
+-- end of the log
+local function next_entry()
+   for e in entries do
+      local t = session_threads[e.session]
+
+      if t == nil then
+         t = nsessions % sysbench.opt.threads
+         nsessions = nsessions + 1
+         session_threads[e.session] = t
+      end
+
+      if e.ts ~= nil and first_ts == nil then
+         first_ts = e.ts
+      end
+
+      if t == thread_id then
+         return e
+      end
+   end
+
+   return nil
+end
+
+-- Wait until the time of an entry relative to the first one
+local function wait_for(e)
+   if sysbench.opt.replay_speed == 0 or e.ts == nil then
+      return
+   end
+
+   local delay = (e.ts - first_ts) / sysbench.opt.replay_speed -
+      tonumber(ffi.C.sb_test_clock()) / 1e9
+
+   sysbench.sleep(delay)
+end
+
+local function query_stat(query)
+   local fp = fingerprint(query, quotes)
+   local stat = query_stats[fp]
+
+   if stat == nil then
+      stat = sysbench.sql.query_stat(fp)
+      query_stats[fp] = stat
+   end
+
+   return stat
+end
+
+function event()
+   local e = next_entry()
+
+   if e == nil then
+      return true
+   end
+
+   wait_for(e)
+
+   local con = cons[e.session]
+
+   if e.query == nil then
+      if con ~= nil then
+         con:disconnect()
+         cons[e.session] = nil
+      end
+      return
+   end
+
+   if con == nil then
+      con = drv:connect()
+      cons[e.session] = con
+   end
+
+   local stat = query_stat(e.query)
+   local start = stat:start()
+   local ok, err = pcall(con.query, con, e.query)
+
+   stat:stop(start, not ok)
+
+   if not ok and (type(err) ~= "table" or
+                     err.errcode ~= sysbench.error.RESTART_EVENT)
+   then
+      error(err, 0)
+   end
+end
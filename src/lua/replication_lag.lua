@@ -0,0 +1,268 @@
+#!/usr/bin/env sysbench
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+-- -----------------------------------------------------------------------------
+-- Replication lag and read-your-writes benchmark. The first --lag_writers
+-- threads update rows of the sbtest_lag table, each bumping a sequence number
+-- of a key it owns, and then read the key back until the new value is
+-- visible. The remaining threads read random keys and compare them with the
+-- last committed sequence numbers.
+--
+-- Reads are plain SELECTs, so with --mysql-replica-host they go to replicas
+-- while updates go to the primary. Without replicas all queries go to the
+-- same server and the lag is only the time of a round trip.
+--
+-- The following is reported, per interval and in total:
+--
+--   lag_writes        - committed updates
+--   lag_reads         - reads by reader threads
+--   lag_stale_reads   - reads of either kind returning an older value than
+--                       the one committed before the read started
+--   lag_timeouts      - updates not visible after --lag_timeout ms
+--   replication_lag   - milliseconds from the commit of an update to the
+--                       start of the first read that returned it, at the
+--                       --percentile values
+-- -----------------------------------------------------------------------------
+
+if sysbench.cmdline.command == nil then
+   error("Command is required. Supported commands: prepare, run, cleanup, " ..
+            "help")
+end
+
+sysbench.cmdline.options = {
+   lag_keys =
+      {"Number of rows in the sbtest_lag table", 1000},
+   lag_writers =
+      {"Number of threads updating rows, other threads only read", 1},
+   lag_timeout =
+      {"Milliseconds to wait for an update to become visible before it is " ..
+          "counted as a timeout. 0 only checks the first read", 1000},
+   lag_poll_interval =
+      {"Milliseconds to sleep between reads while waiting for an update " ..
+          "to become visible", 1},
+   mysql_storage_engine =
+      {"Storage engine, if MySQL is used", "innodb"}
+}
+
+local function check_options()
+   if sysbench.opt.lag_keys < 1 then
+      error("Invalid value for --lag_keys: " .. sysbench.opt.lag_keys)
+   end
+
+   if sysbench.opt.lag_writers < 1 or
+      sysbench.opt.lag_writers > sysbench.opt.threads
+   then
+      error("--lag_writers must be between 1 and --threads")
+   end
+
+   -- Writers own distinct keys, so each one needs at least one
+   if sysbench.opt.lag_writers > sysbench.opt.lag_keys then
+      error("--lag_writers cannot be greater than --lag_keys")
+   end
+
+   if sysbench.opt.lag_timeout < 0 then
+      error("Invalid value for --lag_timeout: " .. sysbench.opt.lag_timeout)
+   end
+
+   if sysbench.opt.lag_poll_interval < 0 then
+      error("Invalid value for --lag_poll_interval: " ..
+               sysbench.opt.lag_poll_interval)
+   end
+end
+
+function prepare()
+   local drv = sysbench.sql.driver()
+   local con = drv:connect()
+   local engine_def = ""
+
+   check_options()
+
+   if drv:name() == "mysql" then
+      engine_def = "/*! ENGINE = " .. sysbench.opt.mysql_storage_engine .. " */"
+   end
+
+   print("Creating table 'sbtest_lag'...")
+   con:query(string.format([[
+CREATE TABLE sbtest_lag (
+  id INTEGER NOT NULL,
+  seq BIGINT NOT NULL,
+  PRIMARY KEY (id)
+) %s]], engine_def))
+
+   print(string.format("Inserting %d records into 'sbtest_lag'",
+                       sysbench.opt.lag_keys))
+
+   con:bulk_insert_init("INSERT INTO sbtest_lag (id, seq) VALUES")
+   for i = 1, sysbench.opt.lag_keys do
+      con:bulk_insert_next(string.format("(%d, 0)", i))
+   end
+   con:bulk_insert_done()
+end
+
+function cleanup()
+   local drv = sysbench.sql.driver()
+   local con = drv:connect()
+
+   print("Dropping table 'sbtest_lag'...")
+   con:query("DROP TABLE IF EXISTS sbtest_lag")
+end
+
+-- -----------------------------------------------------------------------------
+-- Run
+-- -----------------------------------------------------------------------------
+
+function thread_init()
+   check_options()
+
+   drv = sysbench.sql.driver()
+   con = drv:connect()
+
+   -- Last committed sequence number of each key
+   committed = sysbench.shared.map("replication_lag", sysbench.opt.lag_keys)
+
+   writes = sysbench.counter.new("lag_writes")
+   reads = sysbench.counter.new("lag_reads")
+   stale_reads = sysbench.counter.new("lag_stale_reads")
+   timeouts = sysbench.counter.new("lag_timeouts")
+   lag = sysbench.histogram.named("replication_lag")
+
+   -- SQLite has no FOR UPDATE, nor replicas
+   for_update = drv:name() == "sqlite" and "" or " FOR UPDATE"
+
+   writer = sysbench.tid % sysbench.opt.threads < sysbench.opt.lag_writers
+
+   if writer then
+      -- Sequence numbers of the keys owned by this thread, which are the keys
+      -- equal to its thread ID + 1 modulo the number of writers
+      seqs = {}
+      first_key = sysbench.tid % sysbench.opt.threads + 1
+      nkeys = math.floor((sysbench.opt.lag_keys - first_key) /
+                            sysbench.opt.lag_writers) + 1
+   end
+end
+
+function thread_done()
+   con:disconnect()
+end
+
+local function clock_ms()
+   return tonumber(ffi.C.sb_test_clock()) / 1e6
+end
+
+local function read_seq(id, suffix)
+   return tonumber(con:query_row("SELECT seq FROM sbtest_lag WHERE id = " ..
+                                    id .. (suffix or ""))) or 0
+end
+
+-- Update a key and read it back until the new value is visible
+local function write_event()
+   local id = first_key +
+      sysbench.rand.uniform(0, nkeys - 1) * sysbench.opt.lag_writers
+   -- Locking reads are not sent to replicas, so the first update of a key
+   -- starts from its current value on the primary
+   local seq = (seqs[id] or read_seq(id, for_update)) + 1
+
+   con:query(string.format("UPDATE sbtest_lag SET seq = %d WHERE id = %d",
+                           seq, id))
+   local commit_ms = clock_ms()
+
+   seqs[id] = seq
+   committed:set(id, seq)
+   writes:add()
+
+   local deadline = commit_ms + sysbench.opt.lag_timeout
+   local start_ms = clock_ms()
+
+   if read_seq(id) >= seq then
+      lag:update(start_ms - commit_ms)
+      return
+   end
+
+   stale_reads:add()
+
+   if sysbench.opt.lag_timeout == 0 then
+      return
+   end
+
+   while true do
+      if sysbench.opt.lag_poll_interval > 0 then
+         sysbench.sleep(sysbench.opt.lag_poll_interval / 1000)
+      end
+
+      start_ms = clock_ms()
+
+      if start_ms > deadline then
+         timeouts:add()
+         return
+      end
+
+      if read_seq(id) >= seq then
+         lag:update(start_ms - commit_ms)
+         return
+      end
+   end
+end
+
+-- Read a random key and check it against the last committed value
+local function read_event()
+   local id = sysbench.rand.uniform(1, sysbench.opt.lag_keys)
+   local expected = committed:get(id) or 0
+
+   if read_seq(id) < expected then
+      stale_reads:add()
+   end
+
+   reads:add()
+end
+
+function event()
+   if writer then
+      write_event()
+   else
+      read_event()
+   end
+end
+
+-- Replace the default intermediate report with one showing both sides of
+-- replication
+function sysbench.hooks.report_intermediate(stat)
+   local seconds = stat.time_interval
+   local c = stat.counters
+   local nreads = c.lag_writes + c.lag_reads
+   local pct = sysbench.opt.percentile[1]
+   local lag_str = ""
+
+   if pct ~= nil then
+      lag_str = string.format(
+         " lag (ms,%s%%): %4.2f", pct,
+         stat.histograms.replication_lag[
+            string.format("%4.2fth percentile", tonumber(pct))] * 1000)
+   end
+
+   print(string.format("[ %." .. ffi.C.log_timestamp_precision() ..
+                          "fs ] thds: %u writes/s: %4.2f reads/s: %4.2f " ..
+                          "stale: %4.2f%% timeouts/s: %4.2f%s " ..
+                          "err/s %4.2f reconn/s: %4.2f",
+                       stat.time_total,
+                       stat.threads_running,
+                       c.lag_writes / seconds,
+                       c.lag_reads / seconds,
+                       nreads > 0 and c.lag_stale_reads * 100 / nreads or 0,
+                       c.lag_timeouts / seconds,
+                       lag_str,
+                       stat.errors / seconds,
+                       stat.reconnects / seconds
+   ))
+end
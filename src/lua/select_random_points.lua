@@ -49,6 +49,7 @@ function thread_init()
    stmt:bind_param(unpack(params))
 
    rlen = sysbench.opt.table_size / sysbench.opt.threads
+   points_buf = ffi.new("uint64_t[?]", sysbench.opt.random_points)
 
    thread_id = sysbench.tid % sysbench.opt.threads
 end
@@ -62,10 +63,13 @@ function event()
    -- To prevent overlapping of our range queries we need to partition the whole
    -- table into 'threads' segments and then make each thread work with its
    -- own segment.
+   local rmin = rlen * thread_id
+   local rmax = rmin + rlen
+
+   sysbench.rand.fill_default(sysbench.opt.random_points, rmin, rmax,
+                              points_buf)
    for i = 1, sysbench.opt.random_points do
-      local rmin = rlen * thread_id
-      local rmax = rmin + rlen
-      params[i]:set(sysbench.rand.default(rmin, rmax))
+      params[i]:set(tonumber(points_buf[i - 1]))
    end
 
    stmt:execute()
@@ -0,0 +1,464 @@
+#!/usr/bin/env sysbench
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+-- -----------------------------------------------------------------------------
+-- Time-series ingest benchmark with rolling retention. Rows of the sbtest_ts
+-- table are points of --ts_series series, keyed by a timestamp in
+-- microseconds since the Epoch and a series number.
+--
+-- Threads have the following roles:
+--
+--   - with --ts_retention, the first thread purges data older than
+--     --ts_retention seconds every --ts_purge_interval seconds, either with a
+--     DELETE or by dropping whole partitions of the table
+--   - the next --ts_readers threads read windows of the last --ts_window
+--     seconds of data
+--   - all other threads ingest points at the current time, each inserting a
+--     point of every series it owns per event in a single multi-row INSERT
+--
+-- The following is reported, per interval and in total:
+--
+--   ts_rows          - ingested rows
+--   ts_purges        - completed purges
+--
+-- and in the "per-transaction statistics" section:
+--
+--   ingest_alone     - INSERTs that did not overlap a purge
+--   ingest_purging   - INSERTs that overlapped a purge
+--   read_alone       - window reads that did not overlap a purge
+--   read_purging     - window reads that overlapped a purge
+--   purge            - purge durations
+--
+-- so that the latency percentiles of ingest and reads during purges can be
+-- compared with the ones between purges.
+-- -----------------------------------------------------------------------------
+
+if sysbench.cmdline.command == nil then
+   error("Command is required. Supported commands: prepare, run, cleanup, " ..
+            "help")
+end
+
+sysbench.cmdline.options = {
+   ts_series =
+      {"Number of time series, i.e. rows ingested per timestamp by all " ..
+          "ingest threads", 100},
+   ts_history =
+      {"Seconds of data up to the current time inserted by prepare", 600},
+   ts_history_interval =
+      {"Seconds between points of a series inserted by prepare", 1},
+   ts_readers =
+      {"Number of threads reading recent windows, other threads ingest " ..
+          "data or purge it", 1},
+   ts_window =
+      {"Seconds of the most recent data read by window reads", 60},
+   ts_read_type =
+      {"Window reads: 'series' for points of a single random series, " ..
+          "'aggregate' for aggregates of all series", "series"},
+   ts_retention =
+      {"Seconds of data to keep. If not 0, the first thread purges older " ..
+          "data", 0},
+   ts_purge_interval =
+      {"Seconds between the starts of consecutive purges", 10},
+   ts_purge =
+      {"Purge method: 'delete' for DELETE of old rows, 'drop_partition' " ..
+          "for dropping partitions holding only old rows (MySQL and " ..
+          "PostgreSQL)", "delete"},
+   ts_partition_interval =
+      {"Seconds of data in each partition with --ts_purge=drop_partition",
+       60},
+   mysql_storage_engine =
+      {"Storage engine, if MySQL is used", "innodb"}
+}
+
+local read_queries = {
+   series = "SELECT COUNT(*), AVG(value), MAX(value) FROM sbtest_ts " ..
+      "WHERE series = %d AND ts >= %d",
+   aggregate = "SELECT series, COUNT(*), AVG(value), MAX(value) " ..
+      "FROM sbtest_ts WHERE ts >= %d GROUP BY series"
+}
+
+local function check_options(drv)
+   for _, opt in ipairs({"ts_series", "ts_history_interval", "ts_window",
+                         "ts_purge_interval", "ts_partition_interval"}) do
+      if sysbench.opt[opt] <= 0 then
+         error("Invalid value for --" .. opt .. ": " .. sysbench.opt[opt])
+      end
+   end
+
+   if sysbench.opt.ts_history < 0 then
+      error("Invalid value for --ts_history: " .. sysbench.opt.ts_history)
+   end
+
+   if sysbench.opt.ts_retention < 0 then
+      error("Invalid value for --ts_retention: " .. sysbench.opt.ts_retention)
+   end
+
+   if read_queries[sysbench.opt.ts_read_type] == nil then
+      error("Invalid value for --ts_read_type: " .. sysbench.opt.ts_read_type)
+   end
+
+   if sysbench.opt.ts_purge ~= "delete" and
+      sysbench.opt.ts_purge ~= "drop_partition"
+   then
+      error("Invalid value for --ts_purge: " .. sysbench.opt.ts_purge)
+   end
+
+   if sysbench.opt.ts_purge == "drop_partition" and
+      drv:name() ~= "mysql" and drv:name() ~= "pgsql"
+   then
+      error("--ts_purge=drop_partition is not supported by " .. drv:name())
+   end
+end
+
+-- Width of partitions in microseconds
+local function partition_width()
+   return sysbench.opt.ts_partition_interval * 1e6
+end
+
+-- Number of the partition holding a timestamp
+local function partition_num(ts)
+   return math.floor(ts / partition_width())
+end
+
+-- Number of partitions created ahead of the current time, so that ingest
+-- never runs past the last partition between purges
+local function partitions_ahead()
+   return math.ceil(sysbench.opt.ts_purge_interval /
+                       sysbench.opt.ts_partition_interval) + 1
+end
+
+local function partitioned()
+   return sysbench.opt.ts_purge == "drop_partition"
+end
+
+-- Query creating partition n of a table partitioned by RANGE (ts)
+local function add_partition_query(drv, n)
+   if drv:name() == "mysql" then
+      return string.format("ALTER TABLE sbtest_ts ADD PARTITION " ..
+                              "(PARTITION p%d VALUES LESS THAN (%d))",
+                           n, (n + 1) * partition_width())
+   end
+
+   return string.format("CREATE TABLE sbtest_ts_p%d PARTITION OF sbtest_ts " ..
+                           "FOR VALUES FROM (%d) TO (%d)",
+                        n, n * partition_width(), (n + 1) * partition_width())
+end
+
+local function drop_partition_query(drv, n)
+   if drv:name() == "mysql" then
+      return "ALTER TABLE sbtest_ts DROP PARTITION p" .. n
+   end
+
+   return "DROP TABLE sbtest_ts_p" .. n
+end
+
+-- Numbers of the existing partitions in ascending order
+local function existing_partitions(drv, con)
+   local query, pattern
+   local parts = {}
+
+   if drv:name() == "mysql" then
+      query = "SELECT partition_name FROM information_schema.partitions " ..
+         "WHERE table_schema = DATABASE() AND table_name = 'sbtest_ts'"
+      pattern = "^p(%d+)$"
+   else
+      query = "SELECT c.relname FROM pg_inherits i " ..
+         "JOIN pg_class c ON c.oid = i.inhrelid " ..
+         "WHERE i.inhparent = 'sbtest_ts'::regclass"
+      pattern = "^sbtest_ts_p(%d+)$"
+   end
+
+   local rs = con:query(query)
+
+   for i = 1, rs.nrows do
+      local n = rs:fetch_row()[1]:match(pattern)
+
+      if n ~= nil then
+         parts[#parts + 1] = tonumber(n)
+      end
+   end
+
+   table.sort(parts)
+
+   return parts
+end
+
+local function wall_clock_us()
+   return os.time() * 1e6
+end
+
+function prepare()
+   local drv = sysbench.sql.driver()
+   local con = drv:connect()
+   local engine_def = ""
+   local partition_def = ""
+   local value_type = drv:name() == "pgsql" and "DOUBLE PRECISION" or "DOUBLE"
+   local now = wall_clock_us()
+   local step = sysbench.opt.ts_history_interval * 1e6
+   local first = now - math.floor(sysbench.opt.ts_history /
+                                     sysbench.opt.ts_history_interval) * step
+   local first_part, last_part
+
+   check_options(drv)
+
+   if partitioned() then
+      first_part = partition_num(first)
+      last_part = partition_num(now) + partitions_ahead()
+   end
+
+   if drv:name() == "mysql" then
+      engine_def = "/*! ENGINE = " .. sysbench.opt.mysql_storage_engine .. " */"
+
+      if partitioned() then
+         local parts = {}
+
+         for n = first_part, last_part do
+            parts[#parts + 1] = string.format(
+               "PARTITION p%d VALUES LESS THAN (%d)", n,
+               (n + 1) * partition_width())
+         end
+
+         partition_def = "PARTITION BY RANGE (ts) (\n  " ..
+            table.concat(parts, ",\n  ") .. "\n)"
+      end
+   elseif partitioned() then
+      partition_def = "PARTITION BY RANGE (ts)"
+   end
+
+   print("Creating table 'sbtest_ts'...")
+   con:query(string.format([[
+CREATE TABLE sbtest_ts (
+  ts BIGINT NOT NULL,
+  series INTEGER NOT NULL,
+  value %s NOT NULL,
+  PRIMARY KEY (ts, series)
+) %s %s]], value_type, engine_def, partition_def))
+
+   if partitioned() and drv:name() == "pgsql" then
+      for n = first_part, last_part do
+         con:query(add_partition_query(drv, n))
+      end
+   end
+
+   print(string.format("Inserting %d seconds of %d series into 'sbtest_ts'",
+                       sysbench.opt.ts_history, sysbench.opt.ts_series))
+
+   con:bulk_insert_init("INSERT INTO sbtest_ts (ts, series, value) VALUES")
+   for ts = first, now - 1, step do
+      for s = 1, sysbench.opt.ts_series do
+         con:bulk_insert_next(string.format("(%d, %d, %.3f)", ts, s,
+                                            sysbench.rand.uniform_double() *
+                                               100))
+      end
+   end
+   con:bulk_insert_done()
+
+   print("Creating a secondary index on 'sbtest_ts'...")
+   con:query("CREATE INDEX sbtest_ts_series ON sbtest_ts (series, ts)")
+end
+
+function cleanup()
+   local drv = sysbench.sql.driver()
+   local con = drv:connect()
+
+   print("Dropping table 'sbtest_ts'...")
+   con:query("DROP TABLE IF EXISTS sbtest_ts")
+end
+
+-- -----------------------------------------------------------------------------
+-- Run
+-- -----------------------------------------------------------------------------
+
+function thread_init()
+   drv = sysbench.sql.driver()
+   con = drv:connect()
+
+   check_options(drv)
+
+   local tid = sysbench.tid % sysbench.opt.threads
+   local purgers = sysbench.opt.ts_retention > 0 and 1 or 0
+   local ingesters = sysbench.opt.threads - purgers - sysbench.opt.ts_readers
+
+   if sysbench.opt.ts_readers < 0 or ingesters < 1 then
+      error("--ts_readers must be between 0 and --threads - 1, or " ..
+               "--threads - 2 with --ts_retention")
+   end
+
+   -- Each ingest thread owns at least one series
+   if ingesters > sysbench.opt.ts_series then
+      error("Too many ingest threads for --ts_series=" ..
+               sysbench.opt.ts_series)
+   end
+
+   -- Wall clock time of the run start in microseconds, set by the first
+   -- thread to initialize
+   epoch = sysbench.shared.counter("ts_epoch")
+   epoch:cas(0, wall_clock_us())
+
+   -- Number of purges started and running
+   purges_started = sysbench.shared.counter("ts_purges_started")
+   purges_running = sysbench.shared.counter("ts_purges_running")
+
+   rows = sysbench.counter.new("ts_rows")
+   purges = sysbench.counter.new("ts_purges")
+
+   if tid < purgers then
+      role = "purge"
+      purge_stat = sysbench.sql.txn_stat("purge")
+
+      if partitioned() then
+         -- Partitions are created before ingest starts, events do not start
+         -- until all threads are initialized
+         parts = existing_partitions(drv, con)
+         add_partitions(wall_clock_us())
+      end
+   elseif tid < purgers + sysbench.opt.ts_readers then
+      role = "read"
+      alone_stat = sysbench.sql.txn_stat("read_alone")
+      purging_stat = sysbench.sql.txn_stat("read_purging")
+   else
+      role = "ingest"
+      alone_stat = sysbench.sql.txn_stat("ingest_alone")
+      purging_stat = sysbench.sql.txn_stat("ingest_purging")
+
+      -- Series owned by this thread and the last timestamp inserted by it
+      first_series = tid - purgers - sysbench.opt.ts_readers + 1
+      series_step = ingesters
+      last_ts = 0
+   end
+end
+
+function thread_done()
+   con:disconnect()
+end
+
+-- Current wall clock time in microseconds
+local function now_us()
+   return epoch:get() + math.floor(tonumber(ffi.C.sb_test_clock()) / 1e3)
+end
+
+-- Create partitions up to partitions_ahead() after the one holding 'now'
+function add_partitions(now)
+   local cur = partition_num(now)
+
+   for n = math.max((parts[#parts] or cur - 1) + 1, cur),
+      cur + partitions_ahead()
+   do
+      con:query(add_partition_query(drv, n))
+      parts[#parts + 1] = n
+   end
+end
+
+-- Drop partitions holding only rows older than the retention period
+local function drop_partitions(cutoff)
+   while #parts > 1 and (parts[1] + 1) * partition_width() <= cutoff do
+      con:query(drop_partition_query(drv, parts[1]))
+      table.remove(parts, 1)
+   end
+end
+
+local function purge_event()
+   local start_us = now_us()
+   local cutoff = start_us - sysbench.opt.ts_retention * 1e6
+
+   purges_started:add()
+   purges_running:add()
+
+   local start = purge_stat:start()
+   local ok, err = pcall(function ()
+         if partitioned() then
+            add_partitions(start_us)
+            drop_partitions(cutoff)
+         else
+            con:query("DELETE FROM sbtest_ts WHERE ts < " .. cutoff)
+         end
+   end)
+
+   purges_running:add(-1)
+
+   if not ok then
+      error(err, 0)
+   end
+
+   purge_stat:stop(start)
+   purges:add()
+
+   sysbench.sleep(sysbench.opt.ts_purge_interval -
+                     (now_us() - start_us) / 1e6)
+end
+
+-- Execute a function and account its duration depending on whether it
+-- overlapped a purge
+local function timed(func)
+   local started = purges_started:get()
+   local concurrent = purges_running:get() > 0
+   local start = alone_stat:start()
+
+   func()
+
+   if concurrent or purges_started:get() ~= started then
+      purging_stat:stop(start)
+   else
+      alone_stat:stop(start)
+   end
+end
+
+local function read_event()
+   local from = now_us() - sysbench.opt.ts_window * 1e6
+   local query
+
+   if sysbench.opt.ts_read_type == "series" then
+      query = string.format(read_queries.series,
+                            sysbench.rand.uniform(1, sysbench.opt.ts_series),
+                            from)
+   else
+      query = string.format(read_queries.aggregate, from)
+   end
+
+   timed(function () con:query(query):count_rows() end)
+end
+
+local function ingest_event()
+   -- Timestamps of a thread are unique even if it ingests faster than once
+   -- per microsecond
+   local ts = math.max(now_us(), last_ts + 1)
+   local n = 0
+
+   last_ts = ts
+
+   timed(function ()
+         con:bulk_insert_init("INSERT INTO sbtest_ts (ts, series, value) " ..
+                                 "VALUES")
+         for s = first_series, sysbench.opt.ts_series, series_step do
+            con:bulk_insert_next(string.format(
+                                    "(%d, %d, %.3f)", ts, s,
+                                    sysbench.rand.uniform_double() * 100))
+            n = n + 1
+         end
+         con:bulk_insert_done()
+   end)
+
+   rows:add(n)
+end
+
+function event()
+   if role == "ingest" then
+      ingest_event()
+   elseif role == "read" then
+      read_event()
+   else
+      purge_event()
+   end
+end
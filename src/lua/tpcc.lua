@@ -0,0 +1,869 @@
+#!/usr/bin/env sysbench
+-- This program is free software; you can redistribute it and/or modify
+-- it under the terms of the GNU General Public License as published by
+-- the Free Software Foundation; either version 2 of the License, or
+-- (at your option) any later version.
+
+-- This program is distributed in the hope that it will be useful,
+-- but WITHOUT ANY WARRANTY; without even the implied warranty of
+-- MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+-- GNU General Public License for more details.
+
+-- You should have received a copy of the GNU General Public License
+-- along with this program; if not, write to the Free Software
+-- Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+-- -----------------------------------------------------------------------------
+-- TPC-C-like benchmark: the warehouse, district, customer, history, orders,
+-- new_orders, order_line, item and stock tables with the NewOrder, Payment,
+-- OrderStatus, Delivery and StockLevel transactions in the standard mix.
+--
+-- This is not a compliant TPC-C implementation: there are no keying or think
+-- times, dates are stored as UNIX timestamps, each event is a transaction
+-- against a random home warehouse and the schema is slightly simplified.
+-- Throughput and latency of each transaction type are reported in the
+-- "per-transaction statistics" section.
+-- -----------------------------------------------------------------------------
+
+if sysbench.cmdline.command == nil then
+   error("Command is required. Supported commands: prepare, run, cleanup, " ..
+            "help")
+end
+
+sysbench.cmdline.options = {
+   warehouses =
+      {"Number of warehouses", 1},
+   items =
+      {"Number of items, as well as stock rows per warehouse", 100000},
+   customers =
+      {"Number of customers and initial orders per district", 3000},
+   mix =
+      {"Percentages of NewOrder, Payment, OrderStatus, Delivery and " ..
+          "StockLevel transactions", "45,43,4,4,4"},
+   mysql_storage_engine =
+      {"Storage engine, if MySQL is used", "innodb"}
+}
+
+-- Districts per warehouse
+local DISTRICTS = 10
+
+local tables = {"warehouse", "district", "customer", "history", "orders",
+                "new_orders", "order_line", "item", "stock"}
+
+-- Constants for NURand(), the same for all threads
+local C_LAST, C_ID, C_ITEM = 123, 259, 7911
+
+local syllables = {"BAR", "OUGHT", "ABLE", "PRI", "PRES", "ESE", "ANTI",
+                   "CALLY", "ATION", "EING"}
+
+-- Non-uniform random number between x and y as defined by TPC-C
+local function nurand(a, x, y, c)
+   return (bit.bor(sysbench.rand.uniform(0, a), sysbench.rand.uniform(x, y)) +
+              c) % (y - x + 1) + x
+end
+
+-- Customer last name made from the 3 digits of a number from 0 to 999
+local function last_name(num)
+   return syllables[math.floor(num / 100) + 1] ..
+      syllables[math.floor(num / 10) % 10 + 1] ..
+      syllables[num % 10 + 1]
+end
+
+-- Random last name of an existing customer
+local function rand_last_name()
+   return last_name(nurand(255, 0, math.min(999, sysbench.opt.customers - 1),
+                           C_LAST))
+end
+
+local function check_options()
+   for _, opt in ipairs({"warehouses", "items", "customers"}) do
+      if sysbench.opt[opt] < 1 then
+         error("Invalid value for --" .. opt .. ": " .. sysbench.opt[opt])
+      end
+   end
+end
+
+-- Cumulative percentages of transaction types, in the same order as --mix
+local function parse_mix()
+   local mix = {}
+   local total = 0
+
+   for pct in string.gmatch(sysbench.opt.mix, "[^,]+") do
+      pct = tonumber(pct)
+      if pct == nil or pct < 0 then
+         break
+      end
+      total = total + pct
+      mix[#mix + 1] = total
+   end
+
+   if #mix ~= 5 or total ~= 100 then
+      error("Invalid value for --mix: " .. sysbench.opt.mix)
+   end
+
+   return mix
+end
+
+-- -----------------------------------------------------------------------------
+-- Schema and data loading
+-- -----------------------------------------------------------------------------
+
+local function create_tables(drv, con)
+   local engine_def = ""
+
+   if drv:name() == "mysql" then
+      engine_def = "/*! ENGINE = " .. sysbench.opt.mysql_storage_engine .. " */"
+   end
+
+   local defs = {
+      warehouse = [[
+  w_id INTEGER NOT NULL,
+  w_name VARCHAR(10),
+  w_street_1 VARCHAR(20),
+  w_city VARCHAR(20),
+  w_state CHAR(2),
+  w_zip CHAR(9),
+  w_tax DECIMAL(4,4),
+  w_ytd DECIMAL(12,2),
+  PRIMARY KEY (w_id)]],
+      district = [[
+  d_id INTEGER NOT NULL,
+  d_w_id INTEGER NOT NULL,
+  d_name VARCHAR(10),
+  d_street_1 VARCHAR(20),
+  d_city VARCHAR(20),
+  d_state CHAR(2),
+  d_zip CHAR(9),
+  d_tax DECIMAL(4,4),
+  d_ytd DECIMAL(12,2),
+  d_next_o_id INTEGER,
+  PRIMARY KEY (d_w_id, d_id)]],
+      customer = [[
+  c_id INTEGER NOT NULL,
+  c_d_id INTEGER NOT NULL,
+  c_w_id INTEGER NOT NULL,
+  c_first VARCHAR(16),
+  c_middle CHAR(2),
+  c_last VARCHAR(16),
+  c_street_1 VARCHAR(20),
+  c_city VARCHAR(20),
+  c_state CHAR(2),
+  c_zip CHAR(9),
+  c_phone CHAR(16),
+  c_since INTEGER,
+  c_credit CHAR(2),
+  c_credit_lim DECIMAL(12,2),
+  c_discount DECIMAL(4,4),
+  c_balance DECIMAL(12,2),
+  c_ytd_payment DECIMAL(12,2),
+  c_payment_cnt INTEGER,
+  c_delivery_cnt INTEGER,
+  c_data VARCHAR(500),
+  PRIMARY KEY (c_w_id, c_d_id, c_id)]],
+      history = [[
+  h_c_id INTEGER,
+  h_c_d_id INTEGER,
+  h_c_w_id INTEGER,
+  h_d_id INTEGER,
+  h_w_id INTEGER,
+  h_date INTEGER,
+  h_amount DECIMAL(6,2),
+  h_data VARCHAR(24)]],
+      orders = [[
+  o_id INTEGER NOT NULL,
+  o_d_id INTEGER NOT NULL,
+  o_w_id INTEGER NOT NULL,
+  o_c_id INTEGER,
+  o_entry_d INTEGER,
+  o_carrier_id INTEGER,
+  o_ol_cnt INTEGER,
+  o_all_local INTEGER,
+  PRIMARY KEY (o_w_id, o_d_id, o_id)]],
+      new_orders = [[
+  no_o_id INTEGER NOT NULL,
+  no_d_id INTEGER NOT NULL,
+  no_w_id INTEGER NOT NULL,
+  PRIMARY KEY (no_w_id, no_d_id, no_o_id)]],
+      order_line = [[
+  ol_o_id INTEGER NOT NULL,
+  ol_d_id INTEGER NOT NULL,
+  ol_w_id INTEGER NOT NULL,
+  ol_number INTEGER NOT NULL,
+  ol_i_id INTEGER,
+  ol_supply_w_id INTEGER,
+  ol_delivery_d INTEGER,
+  ol_quantity INTEGER,
+  ol_amount DECIMAL(6,2),
+  ol_dist_info CHAR(24),
+  PRIMARY KEY (ol_w_id, ol_d_id, ol_o_id, ol_number)]],
+      item = [[
+  i_id INTEGER NOT NULL,
+  i_im_id INTEGER,
+  i_name VARCHAR(24),
+  i_price DECIMAL(5,2),
+  i_data VARCHAR(50),
+  PRIMARY KEY (i_id)]],
+      stock = [[
+  s_i_id INTEGER NOT NULL,
+  s_w_id INTEGER NOT NULL,
+  s_quantity INTEGER,
+  s_dist_info CHAR(24),
+  s_ytd INTEGER,
+  s_order_cnt INTEGER,
+  s_remote_cnt INTEGER,
+  s_data VARCHAR(50),
+  PRIMARY KEY (s_w_id, s_i_id)]]
+   }
+
+   for _, t in ipairs(tables) do
+      print(string.format("Creating table '%s'...", t))
+      con:query(string.format("CREATE TABLE %s (\n%s\n) %s", t, defs[t],
+                              engine_def))
+   end
+end
+
+-- Secondary indexes used by the by-last-name customer lookups and
+-- OrderStatus, built after loading
+local indexes = {
+   {"customer", "idx_customer", "c_w_id, c_d_id, c_last, c_first"},
+   {"orders", "idx_orders", "o_w_id, o_d_id, o_c_id, o_id"}
+}
+
+-- Start loading rows into a table with the native bulk loading of the driver
+-- (COPY for PostgreSQL, a prepared INSERT in a single transaction for SQLite),
+-- or with multi-row INSERTs otherwise
+local function load_begin(drv, con, tbl, cols)
+   local loader = {con = con, copy = con:copy_supported()}
+   local col_list = table.concat(cols, ", ")
+
+   if not loader.copy then
+      con:bulk_insert_init(string.format("INSERT INTO %s (%s) VALUES", tbl,
+                                         col_list))
+   elseif drv:name() == "sqlite" then
+      con:copy_init(string.format("INSERT INTO %s (%s) VALUES (%s)", tbl,
+                                  col_list,
+                                  string.rep("?, ", #cols - 1) .. "?"))
+   else
+      con:copy_init(string.format("COPY %s (%s) FROM STDIN", tbl, col_list))
+   end
+
+   return loader
+end
+
+-- Add a row given as an array of values with n fields, nil for NULL. The
+-- generated strings never need escaping.
+local function load_row(loader, row, n)
+   local fields = {}
+
+   for i = 1, n do
+      local v = row[i]
+
+      if v == nil then
+         fields[i] = loader.copy and "\\N" or "NULL"
+      elseif loader.copy or type(v) == "number" then
+         fields[i] = tostring(v)
+      else
+         fields[i] = "'" .. v .. "'"
+      end
+   end
+
+   if loader.copy then
+      loader.con:copy_next(table.concat(fields, "\t"))
+   else
+      loader.con:bulk_insert_next("(" .. table.concat(fields, ", ") .. ")")
+   end
+end
+
+local function load_end(loader)
+   if loader.copy then
+      loader.con:copy_done()
+   else
+      loader.con:bulk_insert_done()
+   end
+end
+
+-- Random string of letters with a length between min_len and max_len. Unlike
+-- sysbench.rand.varstring(), it never needs escaping in SQL or COPY data.
+local function rand_astring(min_len, max_len)
+   return sysbench.rand.string(string.rep("@",
+                                          sysbench.rand.uniform(min_len,
+                                                                max_len)))
+end
+
+-- Random fixed-point amount between a and b with 2 decimal digits
+local function rand_amount(a, b)
+   return sysbench.rand.uniform(a * 100, b * 100) / 100
+end
+
+local function rand_zip()
+   return sysbench.rand.string("####11111")
+end
+
+-- Random data with "ORIGINAL" in 10% of the rows, as for i_data and s_data
+local function rand_data()
+   local data = rand_astring(26, 50)
+
+   if sysbench.rand.uniform(1, 10) == 1 then
+      local pos = sysbench.rand.uniform(1, #data - 8)
+      data = data:sub(1, pos - 1) .. "ORIGINAL" .. data:sub(pos + 8)
+   end
+
+   return data
+end
+
+local function load_items(drv, con)
+   print(string.format("Inserting %d records into 'item'", sysbench.opt.items))
+
+   local l = load_begin(drv, con, "item",
+                        {"i_id", "i_im_id", "i_name", "i_price", "i_data"})
+
+   for i = 1, sysbench.opt.items do
+      load_row(l, {i, sysbench.rand.uniform(1, 10000),
+                   rand_astring(14, 24), rand_amount(1, 100),
+                   rand_data()}, 5)
+   end
+
+   load_end(l)
+end
+
+local function load_warehouse(drv, con, w)
+   local now = os.time()
+   local customers = sysbench.opt.customers
+   -- The last 30% of the initial orders of each district are undelivered
+   local first_new = customers - math.floor(customers * 0.3) + 1
+   local l
+
+   print(string.format("Loading warehouse %d", w))
+
+   l = load_begin(drv, con, "warehouse",
+                  {"w_id", "w_name", "w_street_1", "w_city", "w_state",
+                   "w_zip", "w_tax", "w_ytd"})
+   load_row(l, {w, rand_astring(6, 10),
+                rand_astring(10, 20),
+                rand_astring(10, 20), sysbench.rand.string("@@"),
+                rand_zip(), sysbench.rand.uniform(0, 2000) / 10000, 300000},
+            8)
+   load_end(l)
+
+   l = load_begin(drv, con, "stock",
+                  {"s_i_id", "s_w_id", "s_quantity", "s_dist_info", "s_ytd",
+                   "s_order_cnt", "s_remote_cnt", "s_data"})
+   for i = 1, sysbench.opt.items do
+      load_row(l, {i, w, sysbench.rand.uniform(10, 100),
+                   sysbench.rand.string(string.rep("@", 24)), 0, 0, 0,
+                   rand_data()}, 8)
+   end
+   load_end(l)
+
+   l = load_begin(drv, con, "district",
+                  {"d_id", "d_w_id", "d_name", "d_street_1", "d_city",
+                   "d_state", "d_zip", "d_tax", "d_ytd", "d_next_o_id"})
+   for d = 1, DISTRICTS do
+      load_row(l, {d, w, rand_astring(6, 10),
+                   rand_astring(10, 20),
+                   rand_astring(10, 20), sysbench.rand.string("@@"),
+                   rand_zip(), sysbench.rand.uniform(0, 2000) / 10000, 30000,
+                   customers + 1}, 10)
+   end
+   load_end(l)
+
+   l = load_begin(drv, con, "customer",
+                  {"c_id", "c_d_id", "c_w_id", "c_first", "c_middle",
+                   "c_last", "c_street_1", "c_city", "c_state", "c_zip",
+                   "c_phone", "c_since", "c_credit", "c_credit_lim",
+                   "c_discount", "c_balance", "c_ytd_payment",
+                   "c_payment_cnt", "c_delivery_cnt", "c_data"})
+   for d = 1, DISTRICTS do
+      for c = 1, customers do
+         local last = c <= 1000 and last_name(c - 1) or rand_last_name()
+
+         load_row(l, {c, d, w, rand_astring(8, 16), "OE", last,
+                      rand_astring(10, 20),
+                      rand_astring(10, 20),
+                      sysbench.rand.string("@@"), rand_zip(),
+                      sysbench.rand.string(string.rep("#", 16)), now,
+                      sysbench.rand.uniform(1, 10) == 1 and "BC" or "GC",
+                      50000, sysbench.rand.uniform(0, 5000) / 10000, -10, 10,
+                      1, 0, rand_astring(300, 500)}, 20)
+      end
+   end
+   load_end(l)
+
+   l = load_begin(drv, con, "history",
+                  {"h_c_id", "h_c_d_id", "h_c_w_id", "h_d_id", "h_w_id",
+                   "h_date", "h_amount", "h_data"})
+   for d = 1, DISTRICTS do
+      for c = 1, customers do
+         load_row(l, {c, d, w, d, w, now, 10,
+                      rand_astring(12, 24)}, 8)
+      end
+   end
+   load_end(l)
+
+   -- Orders are placed by customers in a random order, remember the number
+   -- of lines of each one for order_line
+   local ol_cnt = {}
+
+   l = load_begin(drv, con, "orders",
+                  {"o_id", "o_d_id", "o_w_id", "o_c_id", "o_entry_d",
+                   "o_carrier_id", "o_ol_cnt", "o_all_local"})
+   for d = 1, DISTRICTS do
+      local perm = {}
+
+      for c = 1, customers do
+         perm[c] = c
+      end
+      for c = customers, 2, -1 do
+         local j = sysbench.rand.uniform(1, c)
+         perm[c], perm[j] = perm[j], perm[c]
+      end
+
+      for o = 1, customers do
+         local cnt = sysbench.rand.uniform(5, 15)
+
+         ol_cnt[(d - 1) * customers + o] = cnt
+         load_row(l, {o, d, w, perm[o], now,
+                      o < first_new and sysbench.rand.uniform(1, 10) or nil,
+                      cnt, 1}, 8)
+      end
+   end
+   load_end(l)
+
+   l = load_begin(drv, con, "order_line",
+                  {"ol_o_id", "ol_d_id", "ol_w_id", "ol_number", "ol_i_id",
+                   "ol_supply_w_id", "ol_delivery_d", "ol_quantity",
+                   "ol_amount", "ol_dist_info"})
+   for d = 1, DISTRICTS do
+      for o = 1, customers do
+         local delivered = o < first_new
+
+         for n = 1, ol_cnt[(d - 1) * customers + o] do
+            load_row(l, {o, d, w, n, sysbench.rand.uniform(1,
+                                                           sysbench.opt.items),
+                         w, delivered and now or nil, 5,
+                         delivered and 0 or rand_amount(0.01, 9999.99),
+                         sysbench.rand.string(string.rep("@", 24))}, 10)
+         end
+      end
+   end
+   load_end(l)
+
+   l = load_begin(drv, con, "new_orders", {"no_o_id", "no_d_id", "no_w_id"})
+   for d = 1, DISTRICTS do
+      for o = first_new, customers do
+         load_row(l, {o, d, w}, 3)
+      end
+   end
+   load_end(l)
+end
+
+-- Prepare the dataset. This command supports parallel execution, i.e. will
+-- benefit from executing with --threads > 1. Warehouses are distributed among
+-- threads, and secondary indexes are built after all data is loaded.
+function cmd_prepare()
+   local drv = sysbench.sql.driver()
+   local con = drv:connect()
+   local threads = sysbench.opt.threads
+   local tid = sysbench.tid % threads
+
+   check_options()
+
+   if tid == 0 then
+      create_tables(drv, con)
+   end
+
+   -- Wait for all tables to be created
+   sysbench.barrier()
+
+   if tid == 0 then
+      load_items(drv, con)
+   end
+
+   for w = tid + 1, sysbench.opt.warehouses, threads do
+      load_warehouse(drv, con, w)
+   end
+
+   -- Wait for all rows to be loaded, then build indexes in parallel
+   sysbench.barrier()
+
+   for i = tid + 1, #indexes, threads do
+      local idx = indexes[i]
+
+      print(string.format("Creating a secondary index on '%s'...", idx[1]))
+      con:query(string.format("CREATE INDEX %s ON %s(%s)", idx[2], idx[1],
+                              idx[3]))
+   end
+end
+
+sysbench.cmdline.commands = {
+   prepare = {cmd_prepare, sysbench.cmdline.PARALLEL_COMMAND}
+}
+
+function cleanup()
+   local drv = sysbench.sql.driver()
+   local con = drv:connect()
+
+   for _, t in ipairs(tables) do
+      print(string.format("Dropping table '%s'...", t))
+      con:query("DROP TABLE IF EXISTS " .. t)
+   end
+end
+
+-- -----------------------------------------------------------------------------
+-- Transactions
+-- -----------------------------------------------------------------------------
+
+-- Transaction types in the order of --mix with their statistics labels
+local txn_names = {"NewOrder", "Payment", "OrderStatus", "Delivery",
+                   "StockLevel"}
+
+function thread_init()
+   check_options()
+
+   drv = sysbench.sql.driver()
+   con = drv:connect()
+
+   mix = parse_mix()
+
+   txn_stats = {}
+   for i, name in ipairs(txn_names) do
+      txn_stats[i] = sysbench.sql.txn_stat(name)
+   end
+
+   -- SQLite has no row locks, so writers take the database lock up front
+   -- rather than fail to upgrade it in the middle of a transaction
+   if drv:name() == "sqlite" then
+      begin_query, for_update = "BEGIN IMMEDIATE", ""
+   else
+      begin_query, for_update = "BEGIN", " FOR UPDATE"
+   end
+end
+
+function thread_done()
+   con:disconnect()
+end
+
+local function rand_warehouse()
+   return sysbench.rand.uniform(1, sysbench.opt.warehouses)
+end
+
+-- Another warehouse than w for remote accesses, or w if there is only one
+local function rand_remote_warehouse(w)
+   local warehouses = sysbench.opt.warehouses
+
+   if warehouses == 1 then
+      return w
+   end
+
+   local r = sysbench.rand.uniform(1, warehouses - 1)
+   return r >= w and r + 1 or r
+end
+
+-- Find a customer by last name, i.e. the one in the middle of those with the
+-- name ordered by first name, or by a random id. Returns nil if no customer
+-- has the chosen name.
+local function find_customer(w, d)
+   if sysbench.rand.uniform(1, 100) > 60 then
+      return nurand(1023, 1, sysbench.opt.customers, C_ID)
+   end
+
+   local rs = con:query(string.format(
+                           "SELECT c_id FROM customer WHERE c_w_id = %d " ..
+                              "AND c_d_id = %d AND c_last = '%s' " ..
+                              "ORDER BY c_first", w, d, rand_last_name()))
+   local ids = {}
+
+   while true do
+      local row = rs:fetch_row()
+      if row == nil then
+         break
+      end
+      ids[#ids + 1] = row[1]
+   end
+
+   if #ids == 0 then
+      return nil
+   end
+
+   return tonumber(ids[math.ceil(#ids / 2)])
+end
+
+-- Returns true if the transaction was rolled back
+local function new_order()
+   local w = rand_warehouse()
+   local d = sysbench.rand.uniform(1, DISTRICTS)
+   local c = nurand(1023, 1, sysbench.opt.customers, C_ID)
+   local ol_cnt = sysbench.rand.uniform(5, 15)
+   -- 1% of transactions order a nonexistent item and are rolled back
+   local rollback = sysbench.rand.uniform(1, 100) == 1
+   local items, supply, all_local = {}, {}, 1
+
+   for i = 1, ol_cnt do
+      items[i] = nurand(8191, 1, sysbench.opt.items, C_ITEM)
+      supply[i] = w
+      if sysbench.rand.uniform(1, 100) == 1 then
+         supply[i] = rand_remote_warehouse(w)
+         if supply[i] ~= w then
+            all_local = 0
+         end
+      end
+   end
+   if rollback then
+      items[ol_cnt] = sysbench.opt.items + 1
+   end
+
+   con:query(begin_query)
+
+   con:query_row(string.format(
+                    "SELECT c_discount, c_last, c_credit, w_tax " ..
+                       "FROM customer, warehouse WHERE w_id = %d " ..
+                       "AND c_w_id = w_id AND c_d_id = %d AND c_id = %d",
+                    w, d, c))
+
+   local o = tonumber((con:query_row(string.format(
+                         "SELECT d_next_o_id, d_tax FROM district " ..
+                            "WHERE d_w_id = %d AND d_id = %d%s",
+                         w, d, for_update))))
+
+   con:query(string.format("UPDATE district SET d_next_o_id = %d " ..
+                              "WHERE d_w_id = %d AND d_id = %d",
+                           o + 1, w, d))
+   con:query(string.format("INSERT INTO orders (o_id, o_d_id, o_w_id, " ..
+                              "o_c_id, o_entry_d, o_carrier_id, o_ol_cnt, " ..
+                              "o_all_local) VALUES " ..
+                              "(%d, %d, %d, %d, %d, NULL, %d, %d)",
+                           o, d, w, c, os.time(), ol_cnt, all_local))
+   con:query(string.format("INSERT INTO new_orders (no_o_id, no_d_id, " ..
+                              "no_w_id) VALUES (%d, %d, %d)", o, d, w))
+
+   for n = 1, ol_cnt do
+      local price = con:query_row(string.format(
+                                     "SELECT i_price, i_name, i_data " ..
+                                        "FROM item WHERE i_id = %d",
+                                     items[n]))
+
+      if price == nil then
+         con:query("ROLLBACK")
+         return true
+      end
+
+      local qty = sysbench.rand.uniform(1, 10)
+      local s_qty = tonumber((con:query_row(string.format(
+                                "SELECT s_quantity, s_data, s_dist_info " ..
+                                   "FROM stock WHERE s_w_id = %d " ..
+                                   "AND s_i_id = %d%s",
+                                supply[n], items[n], for_update))))
+
+      s_qty = s_qty >= qty + 10 and s_qty - qty or s_qty - qty + 91
+
+      con:query(string.format("UPDATE stock SET s_quantity = %d, " ..
+                                 "s_ytd = s_ytd + %d, " ..
+                                 "s_order_cnt = s_order_cnt + 1, " ..
+                                 "s_remote_cnt = s_remote_cnt + %d " ..
+                                 "WHERE s_w_id = %d AND s_i_id = %d",
+                              s_qty, qty, supply[n] ~= w and 1 or 0,
+                              supply[n], items[n]))
+      con:query(string.format("INSERT INTO order_line (ol_o_id, ol_d_id, " ..
+                                 "ol_w_id, ol_number, ol_i_id, " ..
+                                 "ol_supply_w_id, ol_delivery_d, " ..
+                                 "ol_quantity, ol_amount, ol_dist_info) " ..
+                                 "VALUES (%d, %d, %d, %d, %d, %d, NULL, " ..
+                                 "%d, %.2f, '%s')",
+                              o, d, w, n, items[n], supply[n], qty,
+                              qty * tonumber(price),
+                              sysbench.rand.string(string.rep("@", 24))))
+   end
+
+   con:query("COMMIT")
+
+   return false
+end
+
+local function payment()
+   local w = rand_warehouse()
+   local d = sysbench.rand.uniform(1, DISTRICTS)
+   local amount = rand_amount(1, 5000)
+   -- 15% of payments are made by customers of other warehouses
+   local c_w, c_d = w, d
+
+   if sysbench.rand.uniform(1, 100) <= 15 then
+      c_w = rand_remote_warehouse(w)
+      c_d = sysbench.rand.uniform(1, DISTRICTS)
+   end
+
+   con:query(begin_query)
+
+   con:query(string.format("UPDATE warehouse SET w_ytd = w_ytd + %.2f " ..
+                              "WHERE w_id = %d", amount, w))
+   con:query_row(string.format("SELECT w_name, w_street_1, w_city, " ..
+                                  "w_state, w_zip FROM warehouse " ..
+                                  "WHERE w_id = %d", w))
+   con:query(string.format("UPDATE district SET d_ytd = d_ytd + %.2f " ..
+                              "WHERE d_w_id = %d AND d_id = %d",
+                           amount, w, d))
+   con:query_row(string.format("SELECT d_name, d_street_1, d_city, " ..
+                                  "d_state, d_zip FROM district " ..
+                                  "WHERE d_w_id = %d AND d_id = %d", w, d))
+
+   local c = find_customer(c_w, c_d) or
+      nurand(1023, 1, sysbench.opt.customers, C_ID)
+
+   local credit = con:query_row(string.format(
+                                   "SELECT c_credit, c_first, c_last, " ..
+                                      "c_balance FROM customer " ..
+                                      "WHERE c_w_id = %d AND c_d_id = %d " ..
+                                      "AND c_id = %d%s",
+                                   c_w, c_d, c, for_update))
+
+   con:query(string.format("UPDATE customer SET " ..
+                              "c_balance = c_balance - %.2f, " ..
+                              "c_ytd_payment = c_ytd_payment + %.2f, " ..
+                              "c_payment_cnt = c_payment_cnt + 1 " ..
+                              "WHERE c_w_id = %d AND c_d_id = %d " ..
+                              "AND c_id = %d",
+                           amount, amount, c_w, c_d, c))
+
+   -- Customers with bad credit get the payment prepended to their data
+   if credit == "BC" then
+      con:query(string.format("UPDATE customer SET c_data = " ..
+                                 "SUBSTR('%d %d %d %d %d %.2f ' || c_data, " ..
+                                 "1, 500) WHERE c_w_id = %d " ..
+                                 "AND c_d_id = %d AND c_id = %d",
+                              c, c_d, c_w, d, w, amount, c_w, c_d, c))
+   end
+
+   con:query(string.format("INSERT INTO history (h_c_id, h_c_d_id, " ..
+                              "h_c_w_id, h_d_id, h_w_id, h_date, h_amount, " ..
+                              "h_data) VALUES (%d, %d, %d, %d, %d, %d, " ..
+                              "%.2f, '%s')",
+                           c, c_d, c_w, d, w, os.time(), amount,
+                           rand_astring(12, 24)))
+
+   con:query("COMMIT")
+
+   return false
+end
+
+local function order_status()
+   local w = rand_warehouse()
+   local d = sysbench.rand.uniform(1, DISTRICTS)
+
+   con:query("BEGIN")
+
+   local c = find_customer(w, d) or
+      nurand(1023, 1, sysbench.opt.customers, C_ID)
+
+   con:query_row(string.format("SELECT c_balance, c_first, c_middle, " ..
+                                  "c_last FROM customer WHERE c_w_id = %d " ..
+                                  "AND c_d_id = %d AND c_id = %d", w, d, c))
+
+   local o = con:query_row(string.format(
+                              "SELECT o_id, o_carrier_id, o_entry_d " ..
+                                 "FROM orders WHERE o_w_id = %d " ..
+                                 "AND o_d_id = %d AND o_c_id = %d " ..
+                                 "ORDER BY o_id DESC LIMIT 1", w, d, c))
+
+   if o ~= nil then
+      con:query(string.format("SELECT ol_i_id, ol_supply_w_id, " ..
+                                 "ol_quantity, ol_amount, ol_delivery_d " ..
+                                 "FROM order_line WHERE ol_w_id = %d " ..
+                                 "AND ol_d_id = %d AND ol_o_id = %d",
+                              w, d, o))
+   end
+
+   con:query("COMMIT")
+
+   return false
+end
+
+-- Deliver the oldest undelivered order of each district of a warehouse
+local function delivery()
+   local w = rand_warehouse()
+   local carrier = sysbench.rand.uniform(1, 10)
+   local now = os.time()
+
+   con:query(begin_query)
+
+   for d = 1, DISTRICTS do
+      local o = con:query_row(string.format(
+                                 "SELECT no_o_id FROM new_orders " ..
+                                    "WHERE no_w_id = %d AND no_d_id = %d " ..
+                                    "ORDER BY no_o_id LIMIT 1%s",
+                                 w, d, for_update))
+
+      if o ~= nil then
+         con:query(string.format("DELETE FROM new_orders WHERE " ..
+                                    "no_w_id = %d AND no_d_id = %d " ..
+                                    "AND no_o_id = %s", w, d, o))
+
+         local c = con:query_row(string.format(
+                                    "SELECT o_c_id FROM orders " ..
+                                       "WHERE o_w_id = %d AND o_d_id = %d " ..
+                                       "AND o_id = %s", w, d, o))
+
+         con:query(string.format("UPDATE orders SET o_carrier_id = %d " ..
+                                    "WHERE o_w_id = %d AND o_d_id = %d " ..
+                                    "AND o_id = %s", carrier, w, d, o))
+         con:query(string.format("UPDATE order_line SET ol_delivery_d = %d " ..
+                                    "WHERE ol_w_id = %d AND ol_d_id = %d " ..
+                                    "AND ol_o_id = %s", now, w, d, o))
+
+         local total = con:query_row(string.format(
+                                        "SELECT SUM(ol_amount) " ..
+                                           "FROM order_line " ..
+                                           "WHERE ol_w_id = %d " ..
+                                           "AND ol_d_id = %d " ..
+                                           "AND ol_o_id = %s", w, d, o))
+
+         con:query(string.format("UPDATE customer SET " ..
+                                    "c_balance = c_balance + %.2f, " ..
+                                    "c_delivery_cnt = c_delivery_cnt + 1 " ..
+                                    "WHERE c_w_id = %d AND c_d_id = %d " ..
+                                    "AND c_id = %s",
+                                 tonumber(total) or 0, w, d, c))
+      end
+   end
+
+   con:query("COMMIT")
+
+   return false
+end
+
+-- Count recently sold items with stock below a threshold
+local function stock_level()
+   local w = rand_warehouse()
+   local d = sysbench.rand.uniform(1, DISTRICTS)
+
+   con:query("BEGIN")
+
+   local o = tonumber((con:query_row(string.format(
+                         "SELECT d_next_o_id FROM district " ..
+                            "WHERE d_w_id = %d AND d_id = %d", w, d))))
+
+   con:query_row(string.format("SELECT COUNT(DISTINCT s_i_id) " ..
+                                  "FROM order_line, stock " ..
+                                  "WHERE ol_w_id = %d AND ol_d_id = %d " ..
+                                  "AND ol_o_id < %d AND ol_o_id >= %d " ..
+                                  "AND s_w_id = %d AND s_i_id = ol_i_id " ..
+                                  "AND s_quantity < %d",
+                               w, d, o, o - 20, w,
+                               sysbench.rand.uniform(10, 20)))
+
+   con:query("COMMIT")
+
+   return false
+end
+
+local txn_funcs = {new_order, payment, order_status, delivery, stock_level}
+
+function event()
+   local pct = sysbench.rand.uniform(1, 100)
+   local i = 1
+
+   while pct > mix[i] do
+      i = i + 1
+   end
+
+   local start = txn_stats[i]:start()
+   txn_stats[i]:stop(start, txn_funcs[i]())
+end
@@ -0,0 +1,778 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+   CPU/NUMA placement of worker threads.
+
+   The following --thread-affinity policies are supported:
+
+   compact   - fill CPUs of one NUMA node before moving to the next one
+   scatter   - distribute threads round-robin across NUMA nodes
+   numa:LIST - bind threads round-robin to all CPUs of the listed NUMA nodes
+   cpus:LIST - bind threads round-robin to the listed CPUs
+
+   LIST is a comma-separated list of numbers or ranges, e.g. "0-3,8". Only CPUs
+   the process is allowed to run on (e.g. as restricted by taskset or cgroups)
+   are used. NUMA topology is read from sysfs; if it is not available, all CPUs
+   are assumed to belong to a single node.
+
+   Threads are bound at creation time, i.e. before they execute any code, so
+   memory first touched by a worker thread is allocated on its local node with
+   the default NUMA policy.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdio.h>
+# include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_SCHED_H
+# include <sched.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+
+#include "sb_affinity.h"
+#include "sb_options.h"
+#include "sb_logger.h"
+#include "sysbench.h"
+
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+
+#define SYSFS_NODE_DIR "/sys/devices/system/node"
+
+/* CPU sets of worker threads, NULL if the policy is 'off' */
+static cpu_set_t *thread_cpus;
+
+/* Online NUMA nodes and their allowed CPUs */
+typedef struct {
+  unsigned int id;
+  unsigned int ncpus;
+  unsigned int *cpus;
+} node_t;
+
+static node_t       *nodes;
+static unsigned int nnodes;
+
+/* Memory policy constants from <numaif.h>, which requires libnuma headers */
+#ifndef MPOL_BIND
+# define MPOL_BIND 2
+#endif
+#ifndef MPOL_MF_STRICT
+# define MPOL_MF_STRICT (1 << 0)
+#endif
+#ifndef MPOL_MF_MOVE
+# define MPOL_MF_MOVE (1 << 1)
+#endif
+
+/* Maximum supported NUMA node ID + 1 */
+#define MAX_NODES 1024
+
+#endif /* HAVE_PTHREAD_ATTR_SETAFFINITY_NP */
+
+static const char *policy;
+
+
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+
+/*
+  Parse a list of numbers or ranges like "0-3,8" into a newly allocated
+  array. Returns 0 on success.
+*/
+
+static int parse_list(const char *str, unsigned int **list, unsigned int *n)
+{
+  const char   *s = str;
+  char         *end;
+  unsigned int size = 0;
+
+  *list = NULL;
+  *n = 0;
+
+  while (*s != '\0')
+  {
+    unsigned long first, last;
+
+    first = strtoul(s, &end, 10);
+    if (end == s)
+      goto error;
+    last = first;
+    s = end;
+
+    if (*s == '-')
+    {
+      s++;
+      last = strtoul(s, &end, 10);
+      if (end == s || last < first)
+        goto error;
+      s = end;
+    }
+
+    if (last >= CPU_SETSIZE)
+      goto error;
+
+    for (unsigned long i = first; i <= last; i++)
+    {
+      if (*n == size)
+      {
+        size = size > 0 ? size * 2 : 16;
+        *list = realloc(*list, size * sizeof(unsigned int));
+        if (*list == NULL)
+          return 1;
+      }
+      (*list)[(*n)++] = (unsigned int) i;
+    }
+
+    if (*s == ',')
+      s++;
+    else if (*s != '\n' && *s != '\0')
+      goto error;
+    else
+      break;
+  }
+
+  return 0;
+
+error:
+  free(*list);
+  *list = NULL;
+  *n = 0;
+
+  return 1;
+}
+
+
+/* Read and parse a sysfs file containing a list */
+
+static int read_list(const char *path, unsigned int **list, unsigned int *n)
+{
+  FILE *fp;
+  char buf[4096];
+  int  rc;
+
+  if ((fp = fopen(path, "r")) == NULL)
+    return 1;
+
+  rc = fgets(buf, sizeof(buf), fp) == NULL || parse_list(buf, list, n);
+
+  fclose(fp);
+
+  return rc;
+}
+
+
+/*
+  Discover NUMA nodes and CPUs the process is allowed to run on. Nodes without
+  allowed CPUs are kept to report meaningful errors for 'numa:LIST'.
+*/
+
+static int init_topology(void)
+{
+  cpu_set_t    allowed;
+  unsigned int *ids;
+  unsigned int nids;
+  char         path[256];
+
+  if (nodes != NULL)
+    return 0;
+
+  if (sched_getaffinity(0, sizeof(allowed), &allowed))
+  {
+    log_errno(LOG_FATAL, "sched_getaffinity() failed");
+    return 1;
+  }
+
+  if (read_list(SYSFS_NODE_DIR "/online", &ids, &nids) == 0 && nids > 0)
+  {
+    nodes = calloc(nids, sizeof(node_t));
+    if (nodes == NULL)
+      return 1;
+
+    for (unsigned int i = 0; i < nids; i++)
+    {
+      unsigned int *cpus;
+      unsigned int ncpus;
+      node_t       *node = &nodes[nnodes++];
+
+      node->id = ids[i];
+
+      if (node->id >= MAX_NODES)
+        return 1;
+
+      snprintf(path, sizeof(path), SYSFS_NODE_DIR "/node%u/cpulist", ids[i]);
+
+      /* Memory-only nodes have an empty CPU list */
+      if (read_list(path, &cpus, &ncpus))
+        continue;
+
+      node->cpus = malloc((ncpus + 1) * sizeof(unsigned int));
+      if (node->cpus == NULL)
+        return 1;
+
+      for (unsigned int j = 0; j < ncpus; j++)
+        if (CPU_ISSET(cpus[j], &allowed))
+          node->cpus[node->ncpus++] = cpus[j];
+
+      free(cpus);
+    }
+
+    free(ids);
+
+    return 0;
+  }
+
+  /* No NUMA information, assume a single node */
+  nodes = calloc(1, sizeof(node_t));
+  if (nodes == NULL)
+    return 1;
+  nnodes = 1;
+
+  nodes[0].cpus = malloc(CPU_SETSIZE * sizeof(unsigned int));
+  if (nodes[0].cpus == NULL)
+    return 1;
+
+  for (unsigned int i = 0; i < CPU_SETSIZE; i++)
+    if (CPU_ISSET(i, &allowed))
+      nodes[0].cpus[nodes[0].ncpus++] = i;
+
+  return 0;
+}
+
+
+static node_t *find_node(unsigned int id)
+{
+  for (unsigned int i = 0; i < nnodes; i++)
+    if (nodes[i].id == id)
+      return &nodes[i];
+
+  return NULL;
+}
+
+
+static int cpu_allowed(unsigned int cpu)
+{
+  for (unsigned int i = 0; i < nnodes; i++)
+    for (unsigned int j = 0; j < nodes[i].ncpus; j++)
+      if (nodes[i].cpus[j] == cpu)
+        return 1;
+
+  return 0;
+}
+
+
+/* Bind threads round-robin to all CPUs of the listed NUMA nodes */
+
+static int assign_numa(const char *list)
+{
+  unsigned int *ids;
+  unsigned int nids;
+
+  if (parse_list(list, &ids, &nids) || nids == 0)
+  {
+    log_text(LOG_FATAL, "Invalid NUMA node list in --thread-affinity: '%s'",
+             list);
+    return 1;
+  }
+
+  for (unsigned int i = 0; i < nids; i++)
+  {
+    const node_t *node = find_node(ids[i]);
+
+    if (node == NULL || node->ncpus == 0)
+    {
+      log_text(LOG_FATAL, "NUMA node %u does not exist or has no available "
+               "CPUs", ids[i]);
+      free(ids);
+      return 1;
+    }
+  }
+
+  for (unsigned int t = 0; t < sb_globals.threads; t++)
+  {
+    const node_t *node = find_node(ids[t % nids]);
+
+    for (unsigned int j = 0; j < node->ncpus; j++)
+      CPU_SET(node->cpus[j], &thread_cpus[t]);
+  }
+
+  free(ids);
+
+  return 0;
+}
+
+
+/* Bind threads round-robin to the listed CPUs */
+
+static int assign_cpus(const char *list)
+{
+  unsigned int *cpus;
+  unsigned int ncpus;
+
+  if (parse_list(list, &cpus, &ncpus) || ncpus == 0)
+  {
+    log_text(LOG_FATAL, "Invalid CPU list in --thread-affinity: '%s'", list);
+    return 1;
+  }
+
+  for (unsigned int i = 0; i < ncpus; i++)
+  {
+    if (!cpu_allowed(cpus[i]))
+    {
+      log_text(LOG_FATAL, "CPU %u does not exist or is not available", cpus[i]);
+      free(cpus);
+      return 1;
+    }
+  }
+
+  for (unsigned int t = 0; t < sb_globals.threads; t++)
+    CPU_SET(cpus[t % ncpus], &thread_cpus[t]);
+
+  free(cpus);
+
+  return 0;
+}
+
+
+/* Fill one NUMA node before moving to the next one */
+
+static void assign_compact(void)
+{
+  unsigned int total = 0;
+
+  for (unsigned int i = 0; i < nnodes; i++)
+    total += nodes[i].ncpus;
+
+  for (unsigned int t = 0; t < sb_globals.threads; t++)
+  {
+    unsigned int idx = t % total;
+
+    for (unsigned int i = 0; i < nnodes; i++)
+    {
+      if (idx < nodes[i].ncpus)
+      {
+        CPU_SET(nodes[i].cpus[idx], &thread_cpus[t]);
+        break;
+      }
+      idx -= nodes[i].ncpus;
+    }
+  }
+}
+
+
+/* Distribute threads round-robin across NUMA nodes */
+
+static void assign_scatter(void)
+{
+  node_t       **used;
+  unsigned int nused = 0;
+
+  used = malloc(nnodes * sizeof(node_t *));
+  for (unsigned int i = 0; i < nnodes; i++)
+    if (nodes[i].ncpus > 0)
+      used[nused++] = &nodes[i];
+
+  for (unsigned int t = 0; t < sb_globals.threads; t++)
+  {
+    const node_t *node = used[t % nused];
+
+    CPU_SET(node->cpus[(t / nused) % node->ncpus], &thread_cpus[t]);
+  }
+
+  free(used);
+}
+
+#endif /* HAVE_PTHREAD_ATTR_SETAFFINITY_NP */
+
+
+int sb_numa_init(void)
+{
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  if (init_topology())
+  {
+    log_text(LOG_FATAL, "Failed to determine CPU topology");
+    return 1;
+  }
+
+  return 0;
+#else
+  log_text(LOG_FATAL, "NUMA support is not available on this platform");
+  return 1;
+#endif
+}
+
+
+unsigned int sb_numa_nnodes(void)
+{
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  return nnodes;
+#else
+  return 0;
+#endif
+}
+
+
+unsigned int sb_numa_node_id(unsigned int idx)
+{
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  return nodes[idx].id;
+#else
+  return idx;
+#endif
+}
+
+
+unsigned int sb_numa_node_ncpus(unsigned int idx)
+{
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  return nodes[idx].ncpus;
+#else
+  (void) idx; /* unused */
+  return 0;
+#endif
+}
+
+
+int sb_numa_run_on_node(unsigned int idx)
+{
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  cpu_set_t set;
+  int       rc;
+
+  CPU_ZERO(&set);
+  for (unsigned int i = 0; i < nodes[idx].ncpus; i++)
+    CPU_SET(nodes[idx].cpus[i], &set);
+
+  rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (rc != 0)
+  {
+    log_text(LOG_FATAL, "pthread_setaffinity_np() failed: %s", strerror(rc));
+    return 1;
+  }
+
+  return 0;
+#else
+  (void) idx; /* unused */
+  return 1;
+#endif
+}
+
+
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+
+static int cmp_cpus(const void *a, const void *b)
+{
+  const unsigned int x = *(const unsigned int *) a;
+  const unsigned int y = *(const unsigned int *) b;
+
+  return (x > y) - (x < y);
+}
+
+#endif
+
+
+int sb_cpu_list(const char *list, unsigned int **cpus, unsigned int *ncpus)
+{
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  unsigned int n = 0;
+
+  if (sb_numa_init())
+    return 1;
+
+  if (list != NULL)
+  {
+    if (parse_list(list, cpus, ncpus) || *ncpus == 0)
+    {
+      log_text(LOG_FATAL, "Invalid CPU list: '%s'", list);
+      return 1;
+    }
+
+    for (unsigned int i = 0; i < *ncpus; i++)
+    {
+      if (!cpu_allowed((*cpus)[i]))
+      {
+        log_text(LOG_FATAL, "CPU %u does not exist or is not available",
+                 (*cpus)[i]);
+        free(*cpus);
+        return 1;
+      }
+    }
+
+    return 0;
+  }
+
+  for (unsigned int i = 0; i < nnodes; i++)
+    n += nodes[i].ncpus;
+
+  *cpus = malloc((n + 1) * sizeof(unsigned int));
+  if (*cpus == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  *ncpus = 0;
+  for (unsigned int i = 0; i < nnodes; i++)
+    for (unsigned int j = 0; j < nodes[i].ncpus; j++)
+      (*cpus)[(*ncpus)++] = nodes[i].cpus[j];
+
+  qsort(*cpus, *ncpus, sizeof(unsigned int), cmp_cpus);
+
+  return 0;
+#else
+  (void) list; /* unused */
+  (void) cpus; /* unused */
+  (void) ncpus; /* unused */
+
+  log_text(LOG_FATAL, "binding threads to CPUs is not supported on this "
+           "platform");
+  return 1;
+#endif
+}
+
+
+int sb_run_on_cpu(unsigned int cpu)
+{
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  cpu_set_t set;
+  int       rc;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+
+  rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (rc != 0)
+  {
+    log_text(LOG_FATAL, "pthread_setaffinity_np() failed: %s", strerror(rc));
+    return 1;
+  }
+
+  return 0;
+#else
+  (void) cpu; /* unused */
+  return 1;
+#endif
+}
+
+
+unsigned int sb_cpu_core(unsigned int cpu)
+{
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  unsigned int *siblings;
+  unsigned int nsiblings;
+  unsigned int core = cpu;
+  char         path[256];
+
+  snprintf(path, sizeof(path),
+           "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list", cpu);
+
+  if (read_list(path, &siblings, &nsiblings))
+    return cpu;
+
+  for (unsigned int i = 0; i < nsiblings; i++)
+    if (siblings[i] < core)
+      core = siblings[i];
+
+  free(siblings);
+
+  return core;
+#else
+  return cpu;
+#endif
+}
+
+
+int sb_numa_bind_memory(void *ptr, size_t len, unsigned int idx)
+{
+#if defined(HAVE_PTHREAD_ATTR_SETAFFINITY_NP) && defined(SYS_mbind)
+  unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))];
+  const unsigned int bits = 8 * sizeof(unsigned long);
+  const unsigned int id = nodes[idx].id;
+
+  memset(mask, 0, sizeof(mask));
+  mask[id / bits] |= 1UL << (id % bits);
+
+  /* The kernel ignores the last bit of 'maxnode' */
+  if (syscall(SYS_mbind, ptr, len, MPOL_BIND, mask, MAX_NODES + 1,
+              MPOL_MF_STRICT | MPOL_MF_MOVE))
+  {
+    log_errno(LOG_FATAL, "mbind() to NUMA node %u failed", id);
+    return 1;
+  }
+
+  return 0;
+#else
+  (void) ptr; /* unused */
+  (void) len; /* unused */
+  (void) idx; /* unused */
+
+  log_text(LOG_FATAL, "binding memory to NUMA nodes is not supported on this "
+           "platform");
+  return 1;
+#endif
+}
+
+
+int sb_affinity_init(void)
+{
+  const char *s = sb_get_value_string("thread-affinity");
+
+  if (s == NULL || !strcmp(s, "off"))
+    return 0;
+
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  unsigned int i;
+  int          rc = 0;
+
+  if (strcmp(s, "compact") && strcmp(s, "scatter") &&
+      strncmp(s, "numa:", 5) && strncmp(s, "cpus:", 5))
+  {
+    log_text(LOG_FATAL, "Invalid value for --thread-affinity: '%s'", s);
+    return 1;
+  }
+
+  if (sb_numa_init())
+    return 1;
+
+  for (i = 0; i < nnodes && nodes[i].ncpus == 0; i++) ;
+  if (i == nnodes)
+  {
+    log_text(LOG_FATAL, "No CPUs available for --thread-affinity");
+    return 1;
+  }
+
+  thread_cpus = calloc(sb_globals.threads, sizeof(cpu_set_t));
+  if (thread_cpus == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  if (!strcmp(s, "compact"))
+    assign_compact();
+  else if (!strcmp(s, "scatter"))
+    assign_scatter();
+  else if (!strncmp(s, "numa:", 5))
+    rc = assign_numa(s + 5);
+  else
+    rc = assign_cpus(s + 5);
+
+  if (rc)
+    return 1;
+
+  policy = s;
+
+  return 0;
+#else
+  log_text(LOG_FATAL, "--thread-affinity is not supported on this platform");
+  return 1;
+#endif
+}
+
+
+const char *sb_affinity_policy(void)
+{
+  return policy;
+}
+
+
+int sb_affinity_set_attr(pthread_attr_t *attr, unsigned int thread_id)
+{
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  int rc;
+
+  if (thread_cpus == NULL)
+    return 0;
+
+  rc = pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t),
+                                   &thread_cpus[thread_id]);
+  if (rc != 0)
+  {
+    log_text(LOG_FATAL, "pthread_attr_setaffinity_np() failed: %s",
+             strerror(rc));
+    return 1;
+  }
+#else
+  (void) attr; /* unused */
+  (void) thread_id; /* unused */
+#endif
+
+  return 0;
+}
+
+
+int sb_affinity_worker_cpus(unsigned int **cpus, unsigned int *ncpus)
+{
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  cpu_set_t used;
+
+  if (thread_cpus == NULL)
+    return sb_cpu_list(NULL, cpus, ncpus);
+
+  CPU_ZERO(&used);
+
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+    CPU_OR(&used, &used, &thread_cpus[i]);
+
+  *cpus = malloc((CPU_COUNT(&used) + 1) * sizeof(unsigned int));
+  if (*cpus == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  *ncpus = 0;
+  for (unsigned int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    if (CPU_ISSET(cpu, &used))
+      (*cpus)[(*ncpus)++] = cpu;
+
+  return 0;
+#else
+  return sb_cpu_list(NULL, cpus, ncpus);
+#endif
+}
+
+
+void sb_affinity_done(void)
+{
+#ifdef HAVE_PTHREAD_ATTR_SETAFFINITY_NP
+  for (unsigned int i = 0; i < nnodes; i++)
+    free(nodes[i].cpus);
+
+  free(nodes);
+  nodes = NULL;
+  nnodes = 0;
+
+  free(thread_cpus);
+  thread_cpus = NULL;
+#endif
+
+  policy = NULL;
+}
@@ -0,0 +1,96 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* CPU/NUMA placement of worker threads */
+
+#ifndef SB_AFFINITY_H
+#define SB_AFFINITY_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+/* Parse --thread-affinity and compute per-thread placement. Returns 0 on success */
+int sb_affinity_init(void);
+
+/*
+  Return the --thread-affinity value for informational messages, or NULL if
+  worker threads are not bound to CPUs
+*/
+const char *sb_affinity_policy(void);
+
+/*
+  Set CPU affinity of a worker thread with a given ID in thread creation
+  attributes. Does nothing if the thread affinity policy is 'off'. Returns 0 on
+  success.
+*/
+int sb_affinity_set_attr(pthread_attr_t *attr, unsigned int thread_id);
+
+/*
+  Return CPUs worker threads run on in ascending order in a newly allocated
+  array, i.e. CPUs they are bound to by --thread-affinity or all CPUs the
+  process is allowed to run on. Returns 0 on success.
+*/
+int sb_affinity_worker_cpus(unsigned int **cpus, unsigned int *ncpus);
+
+void sb_affinity_done(void);
+
+/*
+  NUMA topology. Nodes are indexed from 0 to sb_numa_nnodes() - 1 in the order
+  of their IDs. sb_numa_init() can be called multiple times, returns 0 on
+  success.
+*/
+int sb_numa_init(void);
+
+unsigned int sb_numa_nnodes(void);
+
+unsigned int sb_numa_node_id(unsigned int idx);
+
+/* Number of CPUs of a node the process is allowed to run on */
+unsigned int sb_numa_node_ncpus(unsigned int idx);
+
+/* Bind the calling thread to CPUs of a given node. Returns 0 on success. */
+int sb_numa_run_on_node(unsigned int idx);
+
+/*
+  Bind a page-aligned memory region to a given node. Must be called before the
+  memory is touched. Returns 0 on success.
+*/
+int sb_numa_bind_memory(void *ptr, size_t len, unsigned int idx);
+
+/*
+  Parse a list of CPUs like "0-3,8" into a newly allocated array, or return all
+  CPUs the process is allowed to run on in ascending order if 'list' is NULL.
+  Returns 0 on success.
+*/
+int sb_cpu_list(const char *list, unsigned int **cpus, unsigned int *ncpus);
+
+/* Bind the calling thread to a given CPU. Returns 0 on success. */
+int sb_run_on_cpu(unsigned int cpu);
+
+/*
+  Return the physical core of a CPU as the lowest ID of its SMT siblings, or
+  the CPU itself if the topology is unknown
+*/
+unsigned int sb_cpu_core(unsigned int cpu);
+
+#endif /* SB_AFFINITY_H */
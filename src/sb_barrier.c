@@ -26,6 +26,11 @@
      required number of threads reach the barrier. The callback can also signal
      an error to sb_barrier_wait() callers by returning a non-zero value. In
      which case sb_barrier_wait() returns a negative value to all callers.
+
+   Waiting threads spin for a while before blocking on the condition variable,
+   so threads arriving shortly before the last one are released at once rather
+   than by waking up and reacquiring the mutex one after another. They only
+   spin if there are enough CPUs for all participating threads.
 */
 
 #ifdef HAVE_CONFIG_H
@@ -33,6 +38,11 @@
 #endif
 
 #include "sb_barrier.h"
+#include "sb_ck_pr.h"
+#include "sb_util.h"
+
+/* Number of checks of the barrier serial before blocking */
+#define SB_BARRIER_SPIN 20000
 
 int sb_barrier_init(sb_barrier_t *barrier, unsigned int count,
                     sb_barrier_cb_t callback, void *arg)
@@ -50,6 +60,7 @@ int sb_barrier_init(sb_barrier_t *barrier, unsigned int count,
   barrier->arg = arg;
   barrier->serial = 0;
   barrier->error = 0;
+  barrier->spin = count <= sb_nprocs() ? SB_BARRIER_SPIN : 0;
 
   return 0;
 }
@@ -63,36 +74,76 @@ int sb_barrier_wait(sb_barrier_t *barrier)
 
   if (!--barrier->count)
   {
-    barrier->serial++;
     barrier->count = barrier->init_count;
 
     res = SB_BARRIER_SERIAL_THREAD;
 
-    pthread_cond_broadcast(&barrier->cond);
-
+    /*
+      Call the callback before releasing other threads, as spinning ones do not
+      wait for the mutex
+    */
     if (barrier->callback != NULL && barrier->callback(barrier->arg) != 0)
     {
       barrier->error = 1;
       res = -1;
     }
 
+    ck_pr_fence_store();
+    ck_pr_store_uint(&barrier->serial, barrier->serial + 1);
+
+    pthread_cond_broadcast(&barrier->cond);
+
     pthread_mutex_unlock(&barrier->mutex);
 
+    return res;
   }
-  else
+
+  const unsigned int serial = barrier->serial;
+
+  pthread_mutex_unlock(&barrier->mutex);
+
+  for (unsigned int i = 0;
+       i < barrier->spin && ck_pr_load_uint(&barrier->serial) == serial; i++)
+    ck_pr_stall();
+
+  if (ck_pr_load_uint(&barrier->serial) == serial)
   {
-    unsigned int serial = barrier->serial;
+    pthread_mutex_lock(&barrier->mutex);
 
-    do {
+    while (serial == barrier->serial)
       pthread_cond_wait(&barrier->cond, &barrier->mutex);
-    } while (serial == barrier->serial);
-
-    res = barrier->error ? -1 : 0;
 
     pthread_mutex_unlock(&barrier->mutex);
   }
 
-  return res;
+  ck_pr_fence_load();
+
+  return ck_pr_load_int(&barrier->error) ? -1 : 0;
+}
+
+
+/*
+  Remove the calling thread from the set of participating threads, e.g. when it
+  exits early. Threads waiting on the barrier are released if the calling
+  thread was the only one they were waiting for.
+*/
+
+void sb_barrier_leave(sb_barrier_t *barrier)
+{
+  pthread_mutex_lock(&barrier->mutex);
+
+  barrier->init_count--;
+
+  if (!--barrier->count)
+  {
+    barrier->count = barrier->init_count;
+
+    ck_pr_store_uint(&barrier->serial, barrier->serial + 1);
+
+    pthread_cond_broadcast(&barrier->cond);
+  }
+
+  pthread_mutex_unlock(&barrier->mutex);
 }
 
 
@@ -42,6 +42,7 @@ typedef struct {
   sb_barrier_cb_t  callback;
   void             *arg;
   int              error;
+  unsigned int     spin;            /* number of spins before blocking */
 } sb_barrier_t;
 
 int sb_barrier_init(sb_barrier_t *barrier, unsigned int count,
@@ -49,6 +50,8 @@ int sb_barrier_init(sb_barrier_t *barrier, unsigned int count,
 
 int sb_barrier_wait(sb_barrier_t *barrier);
 
+void sb_barrier_leave(sb_barrier_t *barrier);
+
 void sb_barrier_destroy(sb_barrier_t *barrier);
 
 #endif /* SB_BARRIER_H */
@@ -0,0 +1,1002 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+   Multi-node coordinated load generation.
+
+   One sysbench instance started with --cluster-listen acts as a controller. It
+   waits for --cluster-agents instances started with --cluster-connect to
+   connect, then all nodes start the benchmark at the same time once worker
+   threads on every node are initialized (i.e. a network version of the worker
+   start barrier).
+
+   Every node executes the workload. Agents stream event counters and raw
+   latency histogram buckets accumulated since the previous report to the
+   controller on every --report-interval tick, and send their remaining
+   statistics along with aggregate latency timers when done. The controller
+   adds received values to its own counters and histogram, so its intermediate
+   and cumulative reports (including percentiles) reflect the entire cluster
+   rather than an average of per-node values.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdio.h>
+# include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+#ifdef HAVE_SYS_SOCKET_H
+# include <sys/socket.h>
+#endif
+#ifdef HAVE_NETINET_IN_H
+# include <netinet/in.h>
+#endif
+#ifdef HAVE_NETINET_TCP_H
+# include <netinet/tcp.h>
+#endif
+#ifdef HAVE_NETDB_H
+# include <netdb.h>
+#endif
+#ifdef HAVE_POLL_H
+# include <poll.h>
+#endif
+
+#include "sb_cluster.h"
+#include "sysbench.h"
+#include "sb_options.h"
+#include "sb_logger.h"
+#include "sb_thread.h"
+#include "sb_util.h"
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+#define SB_CLUSTER_MAGIC 0x7362636cU /* "sbcl" */
+#define SB_CLUSTER_VERSION 3
+
+/* Number of attempts (1 second apart) to connect to the controller */
+#define SB_CLUSTER_CONNECT_ATTEMPTS 30
+
+/* Sanity limit on the message payload size in 64-bit words */
+#define SB_CLUSTER_MAX_WORDS (1U << 24)
+
+typedef enum {
+  MSG_HELLO = 1,  /* agent -> controller: handshake */
+  MSG_READY,      /* agent -> controller: local worker threads are ready */
+  MSG_START,      /* controller -> agent: start the benchmark */
+  MSG_REPORT,     /* agent -> controller: intermediate statistics */
+  MSG_FINAL       /* agent -> controller: final statistics */
+} msg_type_t;
+
+/*
+  A message is a header consisting of two 32-bit words (message type and the
+  number of payload words) followed by a payload of 64-bit words. Everything
+  is in network byte order.
+*/
+#define MSG_HEADER_SIZE 8
+
+/* HELLO payload layout */
+enum {
+  HELLO_MAGIC,
+  HELLO_VERSION,
+  HELLO_THREADS,
+  HELLO_REPORT_INTERVAL,
+  HELLO_HIST_TYPE,
+  HELLO_HIST_SIZE,
+  HELLO_HIST_MIN,               /* --histogram-range in nanoseconds */
+  HELLO_HIST_MAX,
+  HELLO_NWORDS
+};
+
+/* REPORT and FINAL payload layout */
+enum {
+  STAT_THREADS_RUNNING,
+  STAT_COUNTERS,
+  STAT_TIMER_EVENTS = STAT_COUNTERS + SB_CNT_MAX, /* timers are FINAL only */
+  STAT_TIMER_SAMPLES,
+  STAT_TIMER_SUM,
+  STAT_TIMER_MIN,
+  STAT_TIMER_MAX,
+  STAT_NBUCKETS,
+  STAT_BUCKETS     /* (index, count) pairs for non-zero histogram elements */
+};
+
+typedef struct {
+  int          fd;
+  uint64_t     nreports;        /* intermediate reports received */
+  unsigned int threads_running;
+  bool         finished;        /* final stats received or connection lost */
+} sb_cluster_agent_t;
+
+sb_cluster_mode_t sb_cluster_mode;
+
+static char *cluster_addr;
+
+/* Controller state */
+static int                listen_fd = -1;
+static sb_cluster_agent_t *agents;
+static unsigned int       nagents;
+static pthread_t          recv_thread;
+static bool               recv_thread_created;
+static uint64_t           nreports;  /* intermediate reports generated */
+static sb_timer_t         remote_timer;
+
+/* Agent state */
+static int controller_fd = -1;
+
+/*
+  Controller: protects agent states and remote_timer. Agent: serializes
+  messages sent by the reporting and main threads.
+*/
+static pthread_mutex_t cluster_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  cluster_cond = PTHREAD_COND_INITIALIZER;
+
+static void put_u32(unsigned char *p, uint32_t v)
+{
+  for (int i = 3; i >= 0; i--, v >>= 8)
+    p[i] = (unsigned char) (v & 0xff);
+}
+
+static uint32_t get_u32(const unsigned char *p)
+{
+  uint32_t v = 0;
+
+  for (int i = 0; i < 4; i++)
+    v = (v << 8) | p[i];
+
+  return v;
+}
+
+static void put_u64(unsigned char *p, uint64_t v)
+{
+  for (int i = 7; i >= 0; i--, v >>= 8)
+    p[i] = (unsigned char) (v & 0xff);
+}
+
+static uint64_t get_u64(const unsigned char *p)
+{
+  uint64_t v = 0;
+
+  for (int i = 0; i < 8; i++)
+    v = (v << 8) | p[i];
+
+  return v;
+}
+
+/* Encode a histogram bound in milliseconds as whole nanoseconds */
+
+static uint64_t ms_to_word(double ms)
+{
+  return (uint64_t) (ms * NS_PER_MS + 0.5);
+}
+
+
+static int write_full(int fd, const unsigned char *buf, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t rc = send(fd, buf, len, MSG_NOSIGNAL);
+
+    if (rc < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return 1;
+    }
+
+    buf += rc;
+    len -= (size_t) rc;
+  }
+
+  return 0;
+}
+
+static int read_full(int fd, unsigned char *buf, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t rc = recv(fd, buf, len, 0);
+
+    if (rc < 0 && errno == EINTR)
+      continue;
+
+    if (rc <= 0)
+      return 1;
+
+    buf += rc;
+    len -= (size_t) rc;
+  }
+
+  return 0;
+}
+
+static int send_msg(int fd, msg_type_t type, const uint64_t *words,
+                    uint32_t nwords)
+{
+  const size_t  len = MSG_HEADER_SIZE + (size_t) nwords * 8;
+  unsigned char *buf = malloc(len);
+  int           rc;
+
+  if (buf == NULL)
+    return 1;
+
+  put_u32(buf, (uint32_t) type);
+  put_u32(buf + 4, nwords);
+
+  for (uint32_t i = 0; i < nwords; i++)
+    put_u64(buf + MSG_HEADER_SIZE + i * 8, words[i]);
+
+  rc = write_full(fd, buf, len);
+
+  free(buf);
+
+  return rc;
+}
+
+/*
+  Receive a message. On success, the payload is returned in a newly allocated
+  array which must be freed by the caller.
+*/
+static int recv_msg(int fd, msg_type_t *type, uint64_t **words,
+                    uint32_t *nwords)
+{
+  unsigned char  hdr[MSG_HEADER_SIZE];
+  unsigned char  *buf;
+
+  if (read_full(fd, hdr, sizeof(hdr)))
+    return 1;
+
+  const uint32_t t = get_u32(hdr);
+
+  *type = (msg_type_t) t;
+  *nwords = get_u32(hdr + 4);
+
+  if (*nwords > SB_CLUSTER_MAX_WORDS)
+    return 1;
+
+  buf = malloc((size_t) *nwords * 8 + 1);
+  *words = malloc((size_t) *nwords * sizeof(uint64_t) + 1);
+
+  if (buf == NULL || *words == NULL ||
+      read_full(fd, buf, (size_t) *nwords * 8))
+  {
+    free(buf);
+    free(*words);
+    return 1;
+  }
+
+  for (uint32_t i = 0; i < *nwords; i++)
+    (*words)[i] = get_u64(buf + i * 8);
+
+  free(buf);
+
+  return 0;
+}
+
+/* Wait for a message of a given type, discarding its payload */
+static int expect_msg(int fd, msg_type_t expected)
+{
+  msg_type_t type;
+  uint64_t   *words;
+  uint32_t   nwords;
+
+  if (recv_msg(fd, &type, &words, &nwords))
+    return 1;
+
+  free(words);
+
+  return type != expected;
+}
+
+/* Resolve a cluster address, see sb_resolve_addr() */
+static int resolve_addr(const char *addr, bool passive, struct addrinfo **res)
+{
+  const int rc = sb_resolve_addr(addr, passive, res);
+
+  if (rc != 0)
+    log_text(LOG_FATAL, "Cannot resolve cluster address '%s': %s",
+             addr, gai_strerror(rc));
+
+  return rc != 0;
+}
+
+static void set_nodelay(int fd)
+{
+  int on = 1;
+
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+static int controller_init(void)
+{
+  struct addrinfo *ai;
+  struct addrinfo *p;
+  int             on = 1;
+
+  if (resolve_addr(cluster_addr, true, &ai))
+    return 1;
+
+  for (p = ai; p != NULL; p = p->ai_next)
+  {
+    listen_fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+    if (listen_fd < 0)
+      continue;
+
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    if (bind(listen_fd, p->ai_addr, p->ai_addrlen) == 0 &&
+        listen(listen_fd, (int) nagents) == 0)
+      break;
+
+    close(listen_fd);
+    listen_fd = -1;
+  }
+
+  freeaddrinfo(ai);
+
+  if (listen_fd < 0)
+  {
+    log_errno(LOG_FATAL, "Cannot listen on '%s'", cluster_addr);
+    return 1;
+  }
+
+  agents = calloc(nagents, sizeof(sb_cluster_agent_t));
+  if (agents == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  for (unsigned int i = 0; i < nagents; i++)
+    agents[i].fd = -1;
+
+  log_text(LOG_NOTICE, "Waiting for %u agent(s) to connect to %s...",
+           nagents, cluster_addr);
+
+  for (unsigned int i = 0; i < nagents; i++)
+  {
+    msg_type_t type;
+    uint64_t   *words;
+    uint32_t   nwords;
+    int        fd;
+
+    fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0)
+    {
+      if (errno == EINTR)
+      {
+        i--;
+        continue;
+      }
+      log_errno(LOG_FATAL, "accept() failed");
+      return 1;
+    }
+
+    set_nodelay(fd);
+    agents[i].fd = fd;
+
+    if (recv_msg(fd, &type, &words, &nwords))
+    {
+      log_text(LOG_FATAL, "Failed to receive handshake from agent #%u", i);
+      return 1;
+    }
+
+    if (type != MSG_HELLO || nwords < HELLO_NWORDS ||
+        words[HELLO_MAGIC] != SB_CLUSTER_MAGIC ||
+        words[HELLO_VERSION] != SB_CLUSTER_VERSION)
+    {
+      log_text(LOG_FATAL, "Invalid handshake from agent #%u", i);
+      free(words);
+      return 1;
+    }
+
+    if (words[HELLO_REPORT_INTERVAL] != sb_globals.report_interval)
+    {
+      log_text(LOG_FATAL, "Agent #%u uses --report-interval=%" PRIu64
+               "ms, but the controller uses --report-interval=%ums", i,
+               words[HELLO_REPORT_INTERVAL], sb_globals.report_interval);
+      free(words);
+      return 1;
+    }
+
+    if (words[HELLO_HIST_TYPE] != (uint64_t) sb_latency_histogram.type ||
+        words[HELLO_HIST_SIZE] != sb_latency_histogram.array_size ||
+        words[HELLO_HIST_MIN] != ms_to_word(sb_latency_histogram.range_min) ||
+        words[HELLO_HIST_MAX] != ms_to_word(sb_latency_histogram.range_max))
+    {
+      log_text(LOG_FATAL, "Agent #%u uses latency histogram settings "
+               "different from the controller", i);
+      free(words);
+      return 1;
+    }
+
+    log_text(LOG_NOTICE, "Agent #%u connected (%" PRIu64 " threads)", i,
+             words[HELLO_THREADS]);
+
+    free(words);
+  }
+
+  return 0;
+}
+
+static int agent_init(void)
+{
+  struct addrinfo *ai;
+  struct addrinfo *p;
+  uint64_t        hello[HELLO_NWORDS];
+
+  for (unsigned int attempt = 1; ; attempt++)
+  {
+    if (resolve_addr(cluster_addr, false, &ai))
+      return 1;
+
+    for (p = ai; p != NULL; p = p->ai_next)
+    {
+      controller_fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+      if (controller_fd < 0)
+        continue;
+
+      if (connect(controller_fd, p->ai_addr, p->ai_addrlen) == 0)
+        break;
+
+      close(controller_fd);
+      controller_fd = -1;
+    }
+
+    freeaddrinfo(ai);
+
+    if (controller_fd >= 0)
+      break;
+
+    if (attempt >= SB_CLUSTER_CONNECT_ATTEMPTS)
+    {
+      log_errno(LOG_FATAL, "Cannot connect to the cluster controller at '%s'",
+                cluster_addr);
+      return 1;
+    }
+
+    if (attempt == 1)
+      log_text(LOG_NOTICE, "Waiting for the cluster controller at %s...",
+               cluster_addr);
+
+    sleep(1);
+  }
+
+  set_nodelay(controller_fd);
+
+  hello[HELLO_MAGIC] = SB_CLUSTER_MAGIC;
+  hello[HELLO_VERSION] = SB_CLUSTER_VERSION;
+  hello[HELLO_THREADS] = sb_globals.threads;
+  hello[HELLO_REPORT_INTERVAL] = sb_globals.report_interval;
+  hello[HELLO_HIST_TYPE] = (uint64_t) sb_latency_histogram.type;
+  hello[HELLO_HIST_SIZE] = sb_latency_histogram.array_size;
+  hello[HELLO_HIST_MIN] = ms_to_word(sb_latency_histogram.range_min);
+  hello[HELLO_HIST_MAX] = ms_to_word(sb_latency_histogram.range_max);
+
+  if (send_msg(controller_fd, MSG_HELLO, hello, HELLO_NWORDS))
+  {
+    log_errno(LOG_FATAL, "Failed to send handshake to the cluster controller");
+    return 1;
+  }
+
+  log_text(LOG_NOTICE, "Connected to the cluster controller at %s",
+           cluster_addr);
+
+  return 0;
+}
+
+
+int sb_cluster_init(void)
+{
+  const char *listen_addr = sb_get_value_string("cluster-listen");
+  const char *connect_addr = sb_get_value_string("cluster-connect");
+  const int  n = sb_get_value_int("cluster-agents");
+
+  if (listen_addr != NULL && *listen_addr == '\0')
+    listen_addr = NULL;
+  if (connect_addr != NULL && *connect_addr == '\0')
+    connect_addr = NULL;
+
+  sb_cluster_mode = SB_CLUSTER_OFF;
+
+  if (listen_addr != NULL && connect_addr != NULL)
+  {
+    log_text(LOG_FATAL, "--cluster-listen and --cluster-connect are mutually "
+             "exclusive");
+    return 1;
+  }
+
+  if (n < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --cluster-agents: %d.\n", n);
+    return 1;
+  }
+
+  if (listen_addr != NULL)
+  {
+    if (n == 0)
+    {
+      log_text(LOG_FATAL, "--cluster-listen requires --cluster-agents");
+      return 1;
+    }
+
+    sb_cluster_mode = SB_CLUSTER_CONTROLLER;
+    cluster_addr = strdup(listen_addr);
+    nagents = (unsigned int) n;
+  }
+  else if (n > 0)
+  {
+    log_text(LOG_FATAL, "--cluster-agents requires --cluster-listen");
+    return 1;
+  }
+  else if (connect_addr != NULL)
+  {
+    sb_cluster_mode = SB_CLUSTER_AGENT;
+    cluster_addr = strdup(connect_addr);
+  }
+
+  return 0;
+}
+
+
+int sb_cluster_connect(void)
+{
+  switch (sb_cluster_mode) {
+    case SB_CLUSTER_CONTROLLER:
+      return controller_init();
+    case SB_CLUSTER_AGENT:
+      return agent_init();
+    default:
+      return 0;
+  }
+}
+
+/* Controller: add statistics received from an agent */
+
+static void apply_stats(sb_cluster_agent_t *agent, msg_type_t type,
+                        const uint64_t *words)
+{
+  sb_counters_t cnt;
+
+  memset(cnt, 0, sizeof(cnt));
+  for (size_t i = 0; i < SB_CNT_MAX; i++)
+    cnt[i] = words[STAT_COUNTERS + i];
+
+  sb_counters_add(cnt);
+
+  for (uint64_t i = 0; i < words[STAT_NBUCKETS]; i++)
+  {
+    const uint64_t idx = words[STAT_BUCKETS + i * 2];
+
+    if (idx < sb_latency_histogram.array_size)
+      sb_histogram_add(&sb_latency_histogram, (size_t) idx,
+                       words[STAT_BUCKETS + i * 2 + 1]);
+  }
+
+  pthread_mutex_lock(&cluster_mutex);
+
+  if (type == MSG_REPORT)
+  {
+    agent->nreports++;
+    agent->threads_running = (unsigned int) words[STAT_THREADS_RUNNING];
+  }
+  else
+  {
+    sb_timer_t t;
+
+    sb_timer_init(&t);
+    t.events = words[STAT_TIMER_EVENTS];
+    t.samples = words[STAT_TIMER_SAMPLES];
+    t.sum_time = words[STAT_TIMER_SUM];
+    t.min_time = words[STAT_TIMER_MIN];
+    t.max_time = words[STAT_TIMER_MAX];
+
+    remote_timer = sb_timer_merge(&remote_timer, &t);
+
+    agent->threads_running = 0;
+    agent->finished = true;
+  }
+
+  pthread_cond_broadcast(&cluster_cond);
+  pthread_mutex_unlock(&cluster_mutex);
+}
+
+
+static void agent_lost(unsigned int i)
+{
+  log_text(LOG_ALERT, "Lost connection to cluster agent #%u", i);
+
+  pthread_mutex_lock(&cluster_mutex);
+  agents[i].threads_running = 0;
+  agents[i].finished = true;
+  pthread_cond_broadcast(&cluster_cond);
+  pthread_mutex_unlock(&cluster_mutex);
+}
+
+/* Controller: receive statistics from all agents until they are finished */
+
+static void *recv_thread_proc(void *arg)
+{
+  struct pollfd *pfds;
+
+  (void) arg; /* unused */
+
+  pfds = calloc(nagents, sizeof(struct pollfd));
+  if (pfds == NULL)
+    return NULL;
+
+  for (;;)
+  {
+    unsigned int nactive = 0;
+
+    /* 'finished' is only updated by this thread, no need to lock */
+    for (unsigned int i = 0; i < nagents; i++)
+    {
+      pfds[i].fd = agents[i].finished ? -1 : agents[i].fd;
+      pfds[i].events = POLLIN;
+      pfds[i].revents = 0;
+      nactive += !agents[i].finished;
+    }
+
+    if (nactive == 0)
+      break;
+
+    if (poll(pfds, nagents, -1) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      log_errno(LOG_FATAL, "poll() failed");
+      for (unsigned int i = 0; i < nagents; i++)
+        if (!agents[i].finished)
+          agent_lost(i);
+      break;
+    }
+
+    for (unsigned int i = 0; i < nagents; i++)
+    {
+      msg_type_t type;
+      uint64_t   *words;
+      uint32_t   nwords;
+
+      if (pfds[i].fd < 0 || pfds[i].revents == 0)
+        continue;
+
+      if (recv_msg(agents[i].fd, &type, &words, &nwords))
+      {
+        agent_lost(i);
+        continue;
+      }
+
+      if ((type != MSG_REPORT && type != MSG_FINAL) ||
+          nwords < STAT_BUCKETS ||
+          nwords != STAT_BUCKETS + 2 * words[STAT_NBUCKETS])
+      {
+        log_text(LOG_ALERT, "Invalid message from cluster agent #%u", i);
+        free(words);
+        agent_lost(i);
+        continue;
+      }
+
+      apply_stats(&agents[i], type, words);
+
+      free(words);
+    }
+  }
+
+  free(pfds);
+
+  return NULL;
+}
+
+
+int sb_cluster_barrier(void)
+{
+  if (sb_cluster_mode == SB_CLUSTER_AGENT)
+  {
+    if (send_msg(controller_fd, MSG_READY, NULL, 0) ||
+        expect_msg(controller_fd, MSG_START))
+    {
+      log_text(LOG_FATAL, "Failed to synchronize start with the cluster "
+               "controller");
+      return 1;
+    }
+
+    return 0;
+  }
+
+  if (sb_cluster_mode != SB_CLUSTER_CONTROLLER)
+    return 0;
+
+  for (unsigned int i = 0; i < nagents; i++)
+  {
+    if (expect_msg(agents[i].fd, MSG_READY))
+    {
+      log_text(LOG_FATAL, "Cluster agent #%u failed to initialize", i);
+      return 1;
+    }
+  }
+
+  for (unsigned int i = 0; i < nagents; i++)
+  {
+    if (send_msg(agents[i].fd, MSG_START, NULL, 0))
+    {
+      log_errno(LOG_FATAL, "Failed to start cluster agent #%u", i);
+      return 1;
+    }
+  }
+
+  sb_timer_init(&remote_timer);
+
+  if (sb_thread_create(&recv_thread, &sb_thread_attr, &recv_thread_proc,
+                       NULL) != 0)
+  {
+    log_errno(LOG_FATAL, "sb_thread_create() for the cluster thread failed.");
+    return 1;
+  }
+
+  recv_thread_created = true;
+
+  return 0;
+}
+
+
+static void unlock_cluster_mutex(void *arg)
+{
+  (void) arg; /* unused */
+
+  pthread_mutex_unlock(&cluster_mutex);
+}
+
+/* Check if all agents have reported a given number of intermediate reports */
+
+static bool all_reported(uint64_t n)
+{
+  for (unsigned int i = 0; i < nagents; i++)
+    if (!agents[i].finished && agents[i].nreports < n)
+      return false;
+
+  return true;
+}
+
+
+void sb_cluster_wait_reports(void)
+{
+  struct timespec deadline;
+  uint64_t        ns;
+
+  if (sb_cluster_mode != SB_CLUSTER_CONTROLLER)
+    return;
+
+  nreports++;
+
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  ns = deadline.tv_nsec + MS2NS(sb_globals.report_interval) / 2;
+  deadline.tv_sec += ns / NS_PER_SEC;
+  deadline.tv_nsec = ns % NS_PER_SEC;
+
+  pthread_mutex_lock(&cluster_mutex);
+
+  /* The reporting thread may be cancelled while waiting */
+  pthread_cleanup_push(unlock_cluster_mutex, NULL);
+
+  while (!all_reported(nreports))
+  {
+    if (pthread_cond_timedwait(&cluster_cond, &cluster_mutex, &deadline) ==
+        ETIMEDOUT)
+      break;
+  }
+
+  pthread_cleanup_pop(1);
+}
+
+/* Agent: send statistics to the controller */
+
+static int send_stats(msg_type_t type, sb_counters_t cnt,
+                      const sb_histogram_snapshot_t *snapshot, sb_timer_t *t)
+{
+  uint64_t *words;
+  size_t   nbuckets = 0;
+  int      rc;
+
+  for (size_t i = 0; i < snapshot->size; i++)
+    nbuckets += snapshot->array[i] != 0;
+
+  words = calloc(STAT_BUCKETS + 2 * nbuckets, sizeof(uint64_t));
+  if (words == NULL)
+    return 1;
+
+  words[STAT_THREADS_RUNNING] = sb_globals.threads_running;
+
+  for (size_t i = 0; i < SB_CNT_MAX; i++)
+    words[STAT_COUNTERS + i] = cnt[i];
+
+  if (t != NULL)
+  {
+    words[STAT_TIMER_EVENTS] = t->events;
+    words[STAT_TIMER_SAMPLES] = t->samples;
+    words[STAT_TIMER_SUM] = t->sum_time;
+    words[STAT_TIMER_MIN] = t->min_time;
+    words[STAT_TIMER_MAX] = t->max_time;
+  }
+
+  words[STAT_NBUCKETS] = nbuckets;
+
+  for (size_t i = 0, n = STAT_BUCKETS; i < snapshot->size; i++)
+  {
+    if (snapshot->array[i] == 0)
+      continue;
+
+    words[n++] = i;
+    words[n++] = snapshot->array[i];
+  }
+
+  pthread_mutex_lock(&cluster_mutex);
+
+  if (controller_fd < 0)
+    rc = 1;
+  else if ((rc = send_msg(controller_fd, type, words,
+                          (uint32_t) (STAT_BUCKETS + 2 * nbuckets))))
+  {
+    log_errno(LOG_ALERT, "Lost connection to the cluster controller");
+    close(controller_fd);
+    controller_fd = -1;
+  }
+
+  pthread_mutex_unlock(&cluster_mutex);
+
+  free(words);
+
+  return rc;
+}
+
+
+int sb_cluster_send_report(sb_counters_t cnt,
+                           const sb_histogram_snapshot_t *snapshot)
+{
+  if (sb_cluster_mode != SB_CLUSTER_AGENT)
+    return 0;
+
+  return send_stats(MSG_REPORT, cnt, snapshot, NULL);
+}
+
+
+unsigned int sb_cluster_threads_running(void)
+{
+  unsigned int n = 0;
+
+  if (sb_cluster_mode != SB_CLUSTER_CONTROLLER)
+    return 0;
+
+  pthread_mutex_lock(&cluster_mutex);
+
+  for (unsigned int i = 0; i < nagents; i++)
+    n += agents[i].threads_running;
+
+  pthread_mutex_unlock(&cluster_mutex);
+
+  return n;
+}
+
+
+int sb_cluster_finish(sb_timer_t *t)
+{
+  if (sb_cluster_mode == SB_CLUSTER_AGENT)
+  {
+    sb_histogram_snapshot_t *snapshot;
+    sb_counters_t           cnt;
+    int                     rc;
+
+    /* Send everything not yet sent with intermediate reports */
+    sb_counters_agg_intermediate(cnt);
+    snapshot = sb_histogram_snapshot_intermediate(&sb_latency_histogram);
+
+    rc = send_stats(MSG_FINAL, cnt, snapshot, t);
+
+    free(snapshot);
+
+    return rc;
+  }
+
+  if (sb_cluster_mode != SB_CLUSTER_CONTROLLER)
+    return 0;
+
+  log_text(LOG_INFO, "Waiting for cluster agents to finish...");
+
+  pthread_mutex_lock(&cluster_mutex);
+
+  for (unsigned int i = 0; i < nagents; i++)
+  {
+    while (!agents[i].finished)
+      pthread_cond_wait(&cluster_cond, &cluster_mutex);
+  }
+
+  pthread_mutex_unlock(&cluster_mutex);
+
+  if (recv_thread_created)
+  {
+    sb_thread_join(recv_thread, NULL);
+    recv_thread_created = false;
+  }
+
+  return 0;
+}
+
+
+void sb_cluster_merge_timer(sb_timer_t *t)
+{
+  if (sb_cluster_mode != SB_CLUSTER_CONTROLLER)
+    return;
+
+  pthread_mutex_lock(&cluster_mutex);
+  *t = sb_timer_merge(t, &remote_timer);
+  pthread_mutex_unlock(&cluster_mutex);
+}
+
+
+void sb_cluster_done(void)
+{
+  if (recv_thread_created)
+  {
+    sb_thread_cancel(recv_thread);
+    sb_thread_join(recv_thread, NULL);
+    recv_thread_created = false;
+  }
+
+  if (agents != NULL)
+  {
+    for (unsigned int i = 0; i < nagents; i++)
+      if (agents[i].fd >= 0)
+        close(agents[i].fd);
+
+    free(agents);
+    agents = NULL;
+  }
+
+  if (listen_fd >= 0)
+  {
+    close(listen_fd);
+    listen_fd = -1;
+  }
+
+  if (controller_fd >= 0)
+  {
+    close(controller_fd);
+    controller_fd = -1;
+  }
+
+  free(cluster_addr);
+  cluster_addr = NULL;
+
+  sb_cluster_mode = SB_CLUSTER_OFF;
+}
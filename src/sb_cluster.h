@@ -0,0 +1,82 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Multi-node coordinated load generation (controller/agent mode) */
+
+#ifndef SB_CLUSTER_H
+#define SB_CLUSTER_H
+
+#include "sb_counter.h"
+#include "sb_histogram.h"
+#include "sb_timer.h"
+
+typedef enum {
+  SB_CLUSTER_OFF,
+  /* Waits for agents, merges their statistics into its own reports */
+  SB_CLUSTER_CONTROLLER,
+  /* Connects to a controller and streams statistics to it */
+  SB_CLUSTER_AGENT
+} sb_cluster_mode_t;
+
+extern sb_cluster_mode_t sb_cluster_mode;
+
+/* Parse and validate cluster options. Returns 0 on success. */
+int sb_cluster_init(void);
+
+/*
+  For a controller, wait for all agents to connect. For an agent, connect to
+  the controller. Returns 0 on success.
+*/
+int sb_cluster_connect(void);
+
+/*
+  Network start barrier. Called when all local worker threads are ready, returns
+  when worker threads on all nodes are ready.
+*/
+int sb_cluster_barrier(void);
+
+/*
+  Controller: wait (for at most half of the report interval) until all agents
+  have sent their statistics for the current report interval, so they are
+  accounted in the intermediate report being generated.
+*/
+void sb_cluster_wait_reports(void);
+
+/*
+  Agent: send counter and latency histogram values accumulated since the last
+  intermediate report to the controller.
+*/
+int sb_cluster_send_report(sb_counters_t cnt,
+                           const sb_histogram_snapshot_t *snapshot);
+
+/* Controller: total number of running threads on all agents */
+unsigned int sb_cluster_threads_running(void);
+
+/*
+  Called when the local benchmark run is complete. Agent: send final
+  statistics along with a given aggregate timer to the controller. Controller:
+  wait for final statistics from all agents.
+*/
+int sb_cluster_finish(sb_timer_t *t);
+
+/* Controller: merge aggregate timers received from agents into a given one */
+void sb_cluster_merge_timer(sb_timer_t *t);
+
+void sb_cluster_done(void);
+
+#endif /* SB_CLUSTER_H */
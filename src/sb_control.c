@@ -0,0 +1,278 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Runtime control socket. Clients connect to a Unix socket and send commands,
+  one per line. Each command gets a single line reply starting with "OK" or
+  "ERR". Connections are served one at a time.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdio.h>
+# include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+#ifdef HAVE_SYS_SOCKET_H
+# include <sys/socket.h>
+#endif
+#ifdef HAVE_SYS_UN_H
+# include <sys/un.h>
+#endif
+
+#include <sys/stat.h>
+
+#include "sb_control.h"
+#include "sysbench.h"
+#include "sb_options.h"
+#include "sb_logger.h"
+#include "sb_lua.h"
+#include "sb_rand.h"
+#include "sb_thread.h"
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+/* Maximum length of a command line */
+#define CONTROL_LINE_MAX 256
+
+static char                 *socket_path;
+static int                  listen_fd = -1;
+static pthread_t            control_thread;
+static bool                 control_thread_created;
+static sb_control_handler_t *control_handler;
+
+
+int sb_control_init(void)
+{
+#ifdef HAVE_SYS_UN_H
+  struct sockaddr_un addr;
+  struct stat        st;
+  const char         *path = sb_get_value_string("control-socket");
+
+  if (path == NULL)
+    return 0;
+
+  if (strlen(path) == 0 || strlen(path) >= sizeof(addr.sun_path))
+  {
+    log_text(LOG_FATAL, "Invalid value for --control-socket: '%s'", path);
+    return 1;
+  }
+
+  /* Remove a stale socket left by a previous run */
+  if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+    unlink(path);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0 ||
+      bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+      listen(listen_fd, 4) != 0)
+  {
+    log_errno(LOG_FATAL, "Cannot listen on --control-socket '%s'", path);
+    if (listen_fd >= 0)
+      close(listen_fd);
+    listen_fd = -1;
+    return 1;
+  }
+
+  socket_path = strdup(path);
+
+  return 0;
+#else
+  if (sb_get_value_string("control-socket") == NULL)
+    return 0;
+
+  log_text(LOG_FATAL, "--control-socket is not supported on this platform");
+
+  return 1;
+#endif
+}
+
+
+bool sb_control_enabled(void)
+{
+  return listen_fd >= 0;
+}
+
+
+static void close_fd(void *arg)
+{
+  close(*(int *) arg);
+}
+
+
+/* Serve a single client connection until it is closed */
+
+static void serve_client(int fd)
+{
+  char   line[CONTROL_LINE_MAX];
+  char   reply[CONTROL_LINE_MAX];
+  size_t len = 0;
+
+  for (;;)
+  {
+    const ssize_t n = read(fd, line + len, sizeof(line) - 1 - len);
+    char          *eol;
+
+    if (n < 0 && errno == EINTR)
+      continue;
+
+    if (n <= 0)
+      return;
+
+    len += n;
+    line[len] = '\0';
+
+    while ((eol = strchr(line, '\n')) != NULL)
+    {
+      *eol = '\0';
+      if (eol > line && eol[-1] == '\r')
+        eol[-1] = '\0';
+
+      /* Let the command complete when the run ends */
+      pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+      control_handler(line, reply, sizeof(reply) - 1);
+      pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+
+      strcat(reply, "\n");
+      if (send(fd, reply, strlen(reply), MSG_NOSIGNAL) < 0)
+        return;
+
+      len -= eol + 1 - line;
+      memmove(line, eol + 1, len + 1);
+    }
+
+    if (len == sizeof(line) - 1)
+    {
+      static const char err[] = "ERR line too long\n";
+
+      send(fd, err, sizeof(err) - 1, MSG_NOSIGNAL);
+      return;
+    }
+  }
+}
+
+
+static void *control_thread_proc(void *arg)
+{
+  (void) arg; /* unused */
+
+  /* Same as other background threads, commands may produce reports */
+  sb_tls_thread_id = sb_globals.threads;
+
+  sb_rand_thread_init();
+
+  if (sb_lua_loaded() && sb_lua_report_thread_init())
+    return NULL;
+
+  pthread_cleanup_push(sb_lua_report_thread_done, NULL);
+
+  log_text(LOG_DEBUG, "Control thread started");
+
+  for (;;)
+  {
+    int fd = accept(listen_fd, NULL, NULL);
+
+    if (fd < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      log_errno(LOG_FATAL, "accept() on the control socket failed");
+      break;
+    }
+
+    pthread_cleanup_push(close_fd, &fd);
+    serve_client(fd);
+    pthread_cleanup_pop(1);
+  }
+
+  pthread_cleanup_pop(1);
+
+  return NULL;
+}
+
+
+int sb_control_start(sb_control_handler_t *handler)
+{
+  if (listen_fd < 0)
+    return 0;
+
+  control_handler = handler;
+
+  if (sb_thread_create(&control_thread, &sb_thread_attr, &control_thread_proc,
+                       NULL) != 0)
+  {
+    log_errno(LOG_FATAL, "sb_thread_create() for the control thread failed.");
+    return 1;
+  }
+
+  control_thread_created = true;
+
+  return 0;
+}
+
+
+void sb_control_stop(void)
+{
+  if (!control_thread_created)
+    return;
+
+  if (sb_thread_cancel(control_thread) ||
+      sb_thread_join(control_thread, NULL))
+    log_errno(LOG_FATAL, "Terminating the control thread failed.");
+
+  control_thread_created = false;
+}
+
+
+void sb_control_done(void)
+{
+  sb_control_stop();
+
+  if (listen_fd >= 0)
+  {
+    close(listen_fd);
+    listen_fd = -1;
+  }
+
+  if (socket_path != NULL)
+  {
+    unlink(socket_path);
+    free(socket_path);
+    socket_path = NULL;
+  }
+}
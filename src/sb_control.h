@@ -0,0 +1,55 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Runtime control socket, see --control-socket */
+
+#ifndef SB_CONTROL_H
+#define SB_CONTROL_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+  Execute a control command and write a single line reply (without a newline)
+  to a buffer of a given size
+*/
+typedef void sb_control_handler_t(const char *cmd, char *reply, size_t size);
+
+/* Parse --control-socket and start listening on it. Returns 0 on success. */
+int sb_control_init(void);
+
+/* Return true if the control socket is enabled */
+bool sb_control_enabled(void);
+
+/*
+  Start accepting connections and executing commands from them with a given
+  handler. Returns 0 on success.
+*/
+int sb_control_start(sb_control_handler_t *handler);
+
+/* Stop executing commands, waits for the current one to complete */
+void sb_control_stop(void);
+
+/* Close and remove the socket */
+void sb_control_done(void);
+
+#endif /* SB_CONTROL_H */
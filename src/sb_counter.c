@@ -20,6 +20,10 @@
 # include "config.h"
 #endif
 
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+
 #include "sb_counter.h"
 #include "sysbench.h"
 #include "sb_util.h"
@@ -27,9 +31,15 @@
 
 sb_counters_t *sb_counters CK_CC_CACHELINE;
 
+/* Number of allocated per-thread slots */
+static size_t sb_counters_slots;
+
 static sb_counters_t last_intermediate_counters;
 static sb_counters_t last_cumulative_counters;
 
+/* Values added with sb_counters_add(), e.g. received from other nodes */
+static sb_counters_t external_counters;
+
 /* Initialize per-thread stats */
 
 int sb_counters_init(void)
@@ -37,6 +47,7 @@ int sb_counters_init(void)
   SB_COMPILE_TIME_ASSERT(sizeof(sb_counters_t) % CK_MD_CACHELINE == 0);
 
   sb_counters = sb_alloc_per_thread_array(sizeof(sb_counters_t));
+  sb_counters_slots = sb_globals.threads + 1;
 
   return sb_counters == NULL;
 }
@@ -50,11 +61,38 @@ void sb_counters_done(void)
   }
 }
 
+/*
+  Zero all per-thread counters and the last report state. Must only be called
+  when no threads are running, e.g. between runs with different thread counts
+  where per-thread slots may be left by threads not used in the next run.
+*/
+void sb_counters_reset(void)
+{
+  memset(sb_counters, 0, sb_counters_slots * sizeof(sb_counters_t));
+  memset(external_counters, 0, sizeof(sb_counters_t));
+  memset(last_intermediate_counters, 0, sizeof(sb_counters_t));
+  memset(last_cumulative_counters, 0, sizeof(sb_counters_t));
+}
+
 static void sb_counters_merge(sb_counters_t dst)
 {
-  for (size_t t = 0; t < SB_CNT_MAX; t++)
-    for (size_t i = 0; i < sb_globals.threads; i++)
+  /* Thread-major order, so that each thread's cache line is read once */
+  for (size_t i = 0; i < sb_globals.threads; i++)
+    for (size_t t = 0; t < SB_CNT_MAX; t++)
       dst[t] += sb_counter_val(i, t);
+
+  for (size_t t = 0; t < SB_CNT_MAX; t++)
+    dst[t] += ck_pr_load_64(&external_counters[t]);
+}
+
+/*
+  Add given values to aggregate counters. Unlike sb_counter_add(), this is
+  thread-safe and not bound to any thread.
+*/
+void sb_counters_add(sb_counters_t val)
+{
+  for (size_t t = 0; t < SB_CNT_MAX; t++)
+    ck_pr_add_64(&external_counters[t], val[t]);
 }
 
 static void sb_counters_checkpoint(sb_counters_t dst, sb_counters_t cp)
@@ -92,3 +130,15 @@ void sb_counters_agg_cumulative(sb_counters_t val)
   sb_counters_merge(val);
   sb_counters_checkpoint(val, last_cumulative_counters);
 }
+
+
+/*
+  Return aggregate counter values since the start without affecting the state
+  of intermediate and cumulative reports. Thread-safe.
+*/
+void sb_counters_agg_total(sb_counters_t val)
+{
+  memset(val, 0, sizeof(sb_counters_t));
+
+  sb_counters_merge(val);
+}
@@ -41,6 +41,8 @@ typedef enum {
   SB_CNT_RECONNECT,     /* reconnects */
   SB_CNT_BYTES_READ,    /* bytes read */
   SB_CNT_BYTES_WRITTEN, /* bytes written */
+  SB_CNT_NET_SENT,      /* bytes sent to a database server */
+  SB_CNT_NET_RECEIVED,  /* bytes received from a database server */
   SB_CNT_MAX
 } sb_counter_type_t;
 
@@ -58,6 +60,9 @@ int sb_counters_init(void);
 
 void sb_counters_done(void);
 
+/* Zero all counters, only when no threads are running */
+void sb_counters_reset(void);
+
 /*
   Cannot use C99 inline here, because CK atomic primitives use static inlines
   which in turn leads to compiler warnings. So for performance reasons the
@@ -98,6 +103,12 @@ void sb_counter_inc(int thread_id, sb_counter_type_t type)
 
 #undef SB_LUA_INLINE
 
+/*
+  Add given values to aggregate counters, e.g. to account counters received
+  from other sysbench instances. Thread-safe.
+*/
+void sb_counters_add(sb_counters_t val);
+
 /*
   Return aggregate counter values since the last intermediate report. This is
   not thread-safe as it updates the global last report state, so it must be
@@ -112,4 +123,10 @@ void sb_counters_agg_intermediate(sb_counters_t val);
 */
 void sb_counters_agg_cumulative(sb_counters_t val);
 
+/*
+  Return aggregate counter values since the start without affecting the state
+  of intermediate and cumulative reports. Thread-safe.
+*/
+void sb_counters_agg_total(sb_counters_t val);
+
 #endif
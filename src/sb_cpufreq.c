@@ -0,0 +1,549 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  CPU frequency and thermal throttling sampling. For each CPU worker threads
+  run on, the current frequency is read from
+  --cpu-freq-path/cpuN/cpufreq/scaling_cur_freq and thermal throttle event
+  counters from cpuN/thermal_throttle/{core,package}_throttle_count. Package
+  counters are shared by all CPUs of a package, so they are only read for the
+  first CPU of each one.
+
+  scaling_cur_freq is an instantaneous value, so a sampler thread reads it
+  every SAMPLE_INTERVAL_MS milliseconds, and reports show the average, minimum
+  and maximum of the samples taken since the previous report. Reports take an
+  extra sample, so each interval has at least one.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_STDIO_H
+# include <stdio.h>
+#endif
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+#include <float.h>
+#include <inttypes.h>
+
+#include "sb_cpufreq.h"
+#include "sb_affinity.h"
+#include "sysbench.h"
+#include "sb_thread.h"
+
+#define SAMPLE_INTERVAL_MS 250
+
+/*
+  Warn if the average frequency of samples differs by at least this percentage
+  during a run
+*/
+#define SWING_WARN_PCT 10
+
+#define CPU_PATH_MAX 512
+
+typedef struct
+{
+  unsigned int id;
+  char         freq_path[CPU_PATH_MAX];   /* scaling_cur_freq */
+  char         core_path[CPU_PATH_MAX];   /* core_throttle_count */
+  char         pkg_path[CPU_PATH_MAX];    /* package_throttle_count, empty if
+                                             not the first CPU of a package */
+  uint64_t     max_khz;                   /* cpuinfo_max_freq, 0 if unknown */
+  uint64_t     core_count;                /* last core throttle count */
+  uint64_t     pkg_count;                 /* last package throttle count */
+} cpu_t;
+
+/* Statistics of samples for an interval or a whole run */
+
+typedef struct
+{
+  uint64_t nsamples;
+  double   sum_mhz;                       /* sum of sample averages */
+  double   min_mhz;                       /* minimum over all CPUs */
+  double   max_mhz;                       /* maximum over all CPUs */
+  double   min_avg_mhz;                   /* minimum sample average */
+  double   max_avg_mhz;                   /* maximum sample average */
+  uint64_t core_throttles;
+  uint64_t pkg_throttles;
+} freq_stats_t;
+
+static bool cpufreq_enabled;
+
+static cpu_t        *cpus;
+static unsigned int ncpus;
+
+/* Average cpuinfo_max_freq of CPUs that have it, 0 if none */
+static double max_mhz;
+
+/* true if thermal throttle counters are available */
+static bool throttle_available;
+
+static freq_stats_t interval_stats;
+static freq_stats_t run_stats;
+
+/* Protects CPU counters and statistics, and signals the sampler to stop */
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  cond = PTHREAD_COND_INITIALIZER;
+
+static pthread_t sampler_thread;
+static bool      sampler_created;
+static bool      sampler_stopping;
+
+
+/* Read a single unsigned number from a sysfs file */
+
+static bool read_u64(const char *path, uint64_t *val)
+{
+  FILE               *fp;
+  unsigned long long v;
+  bool               found = false;
+
+  if (path[0] == '\0' || (fp = fopen(path, "r")) == NULL)
+    return false;
+
+  if (fscanf(fp, "%llu", &v) == 1)
+  {
+    *val = v;
+    found = true;
+  }
+
+  fclose(fp);
+
+  return found;
+}
+
+
+/*
+  Add a CPU if its frequency is readable. 'pkgs' tracks physical package IDs
+  seen so far to find the first CPU of each package.
+*/
+
+static void add_cpu(const char *root, unsigned int id, bool *pkgs,
+                    unsigned int npkgs)
+{
+  char     path[CPU_PATH_MAX];
+  cpu_t    *c = &cpus[ncpus];
+  uint64_t val;
+
+  c->id = id;
+  snprintf(c->freq_path, sizeof(c->freq_path),
+           "%s/cpu%u/cpufreq/scaling_cur_freq", root, id);
+
+  if (!read_u64(c->freq_path, &val))
+    return;
+
+  snprintf(path, sizeof(path), "%s/cpu%u/cpufreq/cpuinfo_max_freq", root, id);
+  if (!read_u64(path, &c->max_khz))
+    c->max_khz = 0;
+
+  snprintf(c->core_path, sizeof(c->core_path),
+           "%s/cpu%u/thermal_throttle/core_throttle_count", root, id);
+  if (read_u64(c->core_path, &c->core_count))
+    throttle_available = true;
+  else
+    c->core_path[0] = '\0';
+
+  snprintf(path, sizeof(path), "%s/cpu%u/topology/physical_package_id", root,
+           id);
+  if (!read_u64(path, &val) || val >= npkgs)
+    val = 0;
+
+  c->pkg_path[0] = '\0';
+
+  if (!pkgs[val])
+  {
+    pkgs[val] = true;
+    snprintf(c->pkg_path, sizeof(c->pkg_path),
+             "%s/cpu%u/thermal_throttle/package_throttle_count", root, id);
+    if (read_u64(c->pkg_path, &c->pkg_count))
+      throttle_available = true;
+    else
+      c->pkg_path[0] = '\0';
+  }
+
+  ncpus++;
+}
+
+
+int sb_cpufreq_init(void)
+{
+  const char   *root;
+  unsigned int *ids;
+  unsigned int nids;
+  bool         *pkgs;
+  unsigned int nmax = 0;
+
+  cpufreq_enabled = sb_get_value_flag("cpu-freq");
+
+  if (!cpufreq_enabled)
+    return 0;
+
+  root = sb_get_value_string("cpu-freq-path");
+
+  if (sb_affinity_worker_cpus(&ids, &nids))
+    return 1;
+
+  cpus = calloc(nids + 1, sizeof(cpu_t));
+  /* Package IDs are bounded by the number of CPUs */
+  pkgs = calloc(nids + 1, sizeof(bool));
+
+  if (cpus == NULL || pkgs == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    free(ids);
+    free(pkgs);
+    return 1;
+  }
+
+  ncpus = 0;
+  throttle_available = false;
+
+  for (unsigned int i = 0; i < nids; i++)
+    add_cpu(root, ids[i], pkgs, nids + 1);
+
+  free(ids);
+  free(pkgs);
+
+  if (ncpus == 0)
+  {
+    log_text(LOG_WARNING, "Cannot read frequencies of CPUs worker threads run "
+             "on from %s, CPU frequency is not reported", root);
+    cpufreq_enabled = false;
+    return 0;
+  }
+
+  max_mhz = 0;
+
+  for (unsigned int i = 0; i < ncpus; i++)
+  {
+    if (cpus[i].max_khz > 0)
+    {
+      max_mhz += cpus[i].max_khz / 1000.0;
+      nmax++;
+    }
+  }
+
+  if (nmax > 0)
+    max_mhz /= nmax;
+
+  return 0;
+}
+
+
+bool sb_cpufreq_enabled(void)
+{
+  return cpufreq_enabled;
+}
+
+
+static void stats_reset(freq_stats_t *s)
+{
+  memset(s, 0, sizeof(*s));
+  s->min_mhz = s->min_avg_mhz = DBL_MAX;
+}
+
+
+/* Add a throttle counter difference to a total, ignoring counter resets */
+
+static void add_throttles(const char *path, uint64_t *last, uint64_t *total)
+{
+  uint64_t val;
+
+  if (!read_u64(path, &val))
+    return;
+
+  if (val >= *last)
+    *total += val - *last;
+
+  *last = val;
+}
+
+
+/* Take a sample and add it to statistics, called with mutex locked */
+
+static void sample_locked(void)
+{
+  double       sum = 0;
+  double       min = DBL_MAX;
+  double       max = 0;
+  unsigned int n = 0;
+  uint64_t     core = 0;
+  uint64_t     pkg = 0;
+
+  for (unsigned int i = 0; i < ncpus; i++)
+  {
+    cpu_t    *c = &cpus[i];
+    uint64_t khz;
+
+    if (read_u64(c->freq_path, &khz))
+    {
+      const double mhz = khz / 1000.0;
+
+      sum += mhz;
+      n++;
+
+      if (mhz < min)
+        min = mhz;
+      if (mhz > max)
+        max = mhz;
+    }
+
+    add_throttles(c->core_path, &c->core_count, &core);
+    add_throttles(c->pkg_path, &c->pkg_count, &pkg);
+  }
+
+  freq_stats_t *stats[] = { &interval_stats, &run_stats };
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    freq_stats_t *s = stats[i];
+
+    s->core_throttles += core;
+    s->pkg_throttles += pkg;
+
+    if (n == 0)
+      continue;
+
+    const double avg = sum / n;
+
+    s->nsamples++;
+    s->sum_mhz += avg;
+
+    if (min < s->min_mhz)
+      s->min_mhz = min;
+    if (max > s->max_mhz)
+      s->max_mhz = max;
+    if (avg < s->min_avg_mhz)
+      s->min_avg_mhz = avg;
+    if (avg > s->max_avg_mhz)
+      s->max_avg_mhz = avg;
+  }
+}
+
+
+/* Discard samples taken so far, called with mutex locked */
+
+static void reset_locked(void)
+{
+  /* Update the last throttle counts */
+  sample_locked();
+
+  stats_reset(&interval_stats);
+  stats_reset(&run_stats);
+
+  /* Every interval and run has at least one sample */
+  sample_locked();
+}
+
+
+static void *sampler_proc(void *arg)
+{
+  (void) arg; /* unused */
+
+  sb_tls_thread_id = sb_globals.threads;
+
+  pthread_mutex_lock(&mutex);
+
+  while (!sampler_stopping)
+  {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += SAMPLE_INTERVAL_MS * 1000000L;
+    if (ts.tv_nsec >= 1000000000L)
+    {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+
+    pthread_cond_timedwait(&cond, &mutex, &ts);
+
+    if (!sampler_stopping)
+      sample_locked();
+  }
+
+  pthread_mutex_unlock(&mutex);
+
+  return NULL;
+}
+
+
+int sb_cpufreq_run_start(void)
+{
+  if (!cpufreq_enabled)
+    return 0;
+
+  pthread_mutex_lock(&mutex);
+  reset_locked();
+  sampler_stopping = false;
+  pthread_mutex_unlock(&mutex);
+
+  if (sb_thread_create(&sampler_thread, &sb_thread_attr, &sampler_proc,
+                       NULL) != 0)
+  {
+    log_errno(LOG_FATAL, "sb_thread_create() for the CPU frequency sampler "
+              "failed.");
+    return 1;
+  }
+
+  sampler_created = true;
+
+  return 0;
+}
+
+
+void sb_cpufreq_reset(void)
+{
+  if (!cpufreq_enabled)
+    return;
+
+  pthread_mutex_lock(&mutex);
+  reset_locked();
+  pthread_mutex_unlock(&mutex);
+}
+
+
+void sb_cpufreq_run_stop(void)
+{
+  if (!sampler_created)
+    return;
+
+  pthread_mutex_lock(&mutex);
+  sampler_stopping = true;
+  pthread_cond_signal(&cond);
+  pthread_mutex_unlock(&mutex);
+
+  if (sb_thread_join(sampler_thread, NULL))
+    log_errno(LOG_FATAL, "Terminating the CPU frequency sampler failed.");
+
+  sampler_created = false;
+
+  pthread_mutex_lock(&mutex);
+  sample_locked();
+  pthread_mutex_unlock(&mutex);
+}
+
+
+/* Percentage of the maximum frequency */
+
+static double max_pct(double mhz)
+{
+  return max_mhz > 0 ? 100 * mhz / max_mhz : 0;
+}
+
+
+void sb_cpufreq_report_intermediate(double time_total)
+{
+  freq_stats_t s;
+  char         buf[256];
+  size_t       len = 0;
+
+  pthread_mutex_lock(&mutex);
+  sample_locked();
+  s = interval_stats;
+  stats_reset(&interval_stats);
+  pthread_mutex_unlock(&mutex);
+
+  if (s.nsamples == 0)
+    return;
+
+  len += snprintf(buf + len, sizeof(buf) - len, "%.0fMHz",
+                  s.sum_mhz / s.nsamples);
+
+  if (max_mhz > 0)
+    len += snprintf(buf + len, sizeof(buf) - len, " (%.0f%% of max)",
+                    max_pct(s.sum_mhz / s.nsamples));
+
+  len += snprintf(buf + len, sizeof(buf) - len, " min/max: %.0f/%.0fMHz",
+                  s.min_mhz, s.max_mhz);
+
+  if (throttle_available)
+    snprintf(buf + len, sizeof(buf) - len,
+             " thermal throttling: %" PRIu64 "/%" PRIu64 "%s",
+             s.core_throttles, s.pkg_throttles,
+             s.core_throttles + s.pkg_throttles > 0 ? " THROTTLED" : "");
+
+  log_timestamp(LOG_NOTICE, time_total, "cpufreq: %s", buf);
+}
+
+
+void sb_cpufreq_report(void)
+{
+  const freq_stats_t *s = &run_stats;
+
+  if (!cpufreq_enabled || s->nsamples == 0)
+    return;
+
+  const double avg = s->sum_mhz / s->nsamples;
+  const double swing = s->max_avg_mhz > 0 ?
+    100 * (s->max_avg_mhz - s->min_avg_mhz) / s->max_avg_mhz : 0;
+
+  log_text(LOG_NOTICE, "CPU frequency:");
+
+  if (max_mhz > 0)
+    log_text(LOG_NOTICE, "    average:                             %.0f MHz "
+             "(%.1f%% of max %.0f MHz)", avg, max_pct(avg), max_mhz);
+  else
+    log_text(LOG_NOTICE, "    average:                             %.0f MHz",
+             avg);
+
+  log_text(LOG_NOTICE, "    min/max:                             %.0f/%.0f MHz",
+           s->min_mhz, s->max_mhz);
+  log_text(LOG_NOTICE, "    swing of averages:                   %.1f%% "
+           "(%.0f-%.0f MHz)", swing, s->min_avg_mhz, s->max_avg_mhz);
+
+  if (throttle_available)
+    log_text(LOG_NOTICE, "    thermal throttle events:             %" PRIu64
+             " core, %" PRIu64 " package", s->core_throttles,
+             s->pkg_throttles);
+  else
+    log_text(LOG_NOTICE, "    thermal throttle events:             N/A");
+
+  log_text(LOG_NOTICE, "");
+
+  if (s->core_throttles + s->pkg_throttles > 0)
+    log_text(LOG_WARNING, "CPUs running worker threads were thermally "
+             "throttled %" PRIu64 " times, results may be limited by cooling "
+             "rather than by the benchmarked system",
+             s->core_throttles + s->pkg_throttles);
+
+  if (swing >= SWING_WARN_PCT)
+    log_text(LOG_WARNING, "average CPU frequency varied by %.1f%% during the "
+             "run (%.0f-%.0f MHz), results may be affected by turbo boost, "
+             "thermal or power management", swing, s->min_avg_mhz,
+             s->max_avg_mhz);
+}
+
+
+void sb_cpufreq_done(void)
+{
+  free(cpus);
+  cpus = NULL;
+  ncpus = 0;
+}
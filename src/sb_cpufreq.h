@@ -0,0 +1,59 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* CPU frequency and thermal throttling sampling, see --cpu-freq */
+
+#ifndef SB_CPUFREQ_H
+#define SB_CPUFREQ_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  Read --cpu-freq and find frequency and throttle counters of the CPUs worker
+  threads run on. Must be called after sb_thread_init(). Returns 0 on success,
+  including when no counters are readable, which only disables frequency
+  reporting with a warning.
+*/
+int sb_cpufreq_init(void);
+
+/* Return true if --cpu-freq is enabled and frequencies are readable */
+bool sb_cpufreq_enabled(void);
+
+/* Start sampling for a run, called by the main thread */
+int sb_cpufreq_run_start(void);
+
+/* Discard samples taken so far in the run, e.g. during the warmup */
+void sb_cpufreq_reset(void);
+
+/* Stop sampling at the end of a run */
+void sb_cpufreq_run_stop(void);
+
+/* Print frequencies and throttle events since the previous report */
+void sb_cpufreq_report_intermediate(double time_total);
+
+/* Print frequencies and throttle events for the last run */
+void sb_cpufreq_report(void);
+
+void sb_cpufreq_done(void);
+
+#endif /* SB_CPUFREQ_H */
@@ -0,0 +1,430 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  RAPL energy sampling. Package and DRAM domains are read from the powercap
+  sysfs interface, i.e. --energy-path/intel-rapl:N[:M]/energy_uj, which is
+  also used for AMD processors. Core and uncore subdomains are skipped, as they
+  are included in the package one.
+
+  energy_uj counters wrap around at max_energy_range_uj, which takes minutes
+  at high power, so a sampler thread reads them every SAMPLE_INTERVAL_SEC
+  seconds and accumulates the differences. Reports take an extra sample, so
+  they cover exactly the time since the previous report or the run start.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_STDIO_H
+# include <stdio.h>
+#endif
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+#include <dirent.h>
+#include <inttypes.h>
+
+#include "sb_energy.h"
+#include "sysbench.h"
+#include "sb_thread.h"
+#include "sb_usage.h"
+
+#define SAMPLE_INTERVAL_SEC 1
+
+#define MAX_DOMAINS 16
+
+#define DOMAIN_PATH_MAX 4096
+
+typedef struct
+{
+  char     name[32];                    /* e.g. package-0 or dram */
+  char     path[DOMAIN_PATH_MAX];       /* energy_uj file */
+  uint64_t range_uj;                    /* max_energy_range_uj, 0 if unknown */
+  uint64_t last_uj;                     /* energy_uj at the last sample */
+  uint64_t total_uj;                    /* energy since the run start */
+  uint64_t report_uj;                   /* total_uj at the last report */
+} domain_t;
+
+static bool energy_enabled;
+
+static domain_t     domains[MAX_DOMAINS];
+static unsigned int ndomains;
+
+/* Protects domains and the times below, and signals the sampler to stop */
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  cond = PTHREAD_COND_INITIALIZER;
+
+static pthread_t sampler_thread;
+static bool      sampler_created;
+static bool      sampler_stopping;
+
+static uint64_t run_start_ns;
+static uint64_t run_stop_ns;
+static uint64_t report_ns;
+
+
+/* Read a single unsigned number from a sysfs file */
+
+static bool read_u64(const char *path, uint64_t *val)
+{
+  FILE               *fp;
+  unsigned long long v;
+  bool               found = false;
+
+  if ((fp = fopen(path, "r")) == NULL)
+    return false;
+
+  if (fscanf(fp, "%llu", &v) == 1)
+  {
+    *val = v;
+    found = true;
+  }
+
+  fclose(fp);
+
+  return found;
+}
+
+
+/* Read the first line of a sysfs file without the trailing newline */
+
+static bool read_line(const char *path, char *buf, size_t size)
+{
+  FILE *fp;
+  bool found;
+
+  if ((fp = fopen(path, "r")) == NULL)
+    return false;
+
+  found = fgets(buf, size, fp) != NULL;
+
+  fclose(fp);
+
+  if (found)
+    buf[strcspn(buf, "\n")] = '\0';
+
+  return found;
+}
+
+
+static int domain_cmp(const void *a, const void *b)
+{
+  return strcmp(((const domain_t *) a)->path, ((const domain_t *) b)->path);
+}
+
+
+/*
+  Add a domain in the given powercap zone directory if it is a package or a
+  DRAM one. Returns false if its counter exists but cannot be read.
+*/
+
+static bool add_domain(const char *root, const char *zone)
+{
+  char     path[DOMAIN_PATH_MAX];
+  char     name[32];
+  domain_t *d = &domains[ndomains];
+
+  snprintf(path, sizeof(path), "%s/%s/name", root, zone);
+
+  if (!read_line(path, name, sizeof(name)) ||
+      (strncmp(name, "package", 7) && strcmp(name, "dram")))
+    return true;
+
+  if (ndomains >= MAX_DOMAINS)
+    return true;
+
+  snprintf(d->name, sizeof(d->name), "%s", name);
+  snprintf(d->path, sizeof(d->path), "%s/%s/energy_uj", root, zone);
+
+  if (!read_u64(d->path, &d->last_uj))
+  {
+    log_errno(LOG_WARNING, "Cannot read %s", d->path);
+    return false;
+  }
+
+  snprintf(path, sizeof(path), "%s/%s/max_energy_range_uj", root, zone);
+
+  if (!read_u64(path, &d->range_uj))
+    d->range_uj = 0;
+
+  ndomains++;
+
+  return true;
+}
+
+
+int sb_energy_init(void)
+{
+  const char    *root;
+  DIR           *dir;
+  struct dirent *ent;
+  bool          readable = true;
+
+  energy_enabled = sb_get_value_flag("energy");
+
+  if (!energy_enabled)
+    return 0;
+
+  root = sb_get_value_string("energy-path");
+  ndomains = 0;
+
+  if ((dir = opendir(root)) != NULL)
+  {
+    /* Zones of the MMIO interface duplicate the MSR ones */
+    while ((ent = readdir(dir)) != NULL)
+      if (!strncmp(ent->d_name, "intel-rapl:", 11))
+        readable = add_domain(root, ent->d_name) && readable;
+
+    closedir(dir);
+  }
+
+  if (ndomains == 0)
+  {
+    log_text(LOG_WARNING, "No %sRAPL package or DRAM domains found in %s, "
+             "energy is not reported%s", readable ? "" : "readable ", root,
+             readable ? "" : " (reading energy counters usually requires "
+             "root privileges)");
+    energy_enabled = false;
+    return 0;
+  }
+
+  qsort(domains, ndomains, sizeof(domain_t), domain_cmp);
+
+  for (unsigned int i = 0; i < ndomains; i++)
+    log_text(LOG_DEBUG, "RAPL domain %s: %s", domains[i].name,
+             domains[i].path);
+
+  return 0;
+}
+
+
+bool sb_energy_enabled(void)
+{
+  return energy_enabled;
+}
+
+
+/* Add energy consumed since the previous sample, called with mutex locked */
+
+static void sample_locked(void)
+{
+  for (unsigned int i = 0; i < ndomains; i++)
+  {
+    domain_t *d = &domains[i];
+    uint64_t val;
+
+    if (!read_u64(d->path, &val))
+      continue;
+
+    if (val >= d->last_uj)
+      d->total_uj += val - d->last_uj;
+    else if (d->range_uj > d->last_uj)
+      d->total_uj += d->range_uj - d->last_uj + val;   /* wrapped around */
+
+    d->last_uj = val;
+  }
+}
+
+
+/* Discard the energy consumed so far, called with mutex locked */
+
+static void reset_locked(void)
+{
+  sample_locked();
+
+  for (unsigned int i = 0; i < ndomains; i++)
+    domains[i].total_uj = domains[i].report_uj = 0;
+
+  run_start_ns = report_ns = sb_usage_clock();
+}
+
+
+static void *sampler_proc(void *arg)
+{
+  (void) arg; /* unused */
+
+  sb_tls_thread_id = sb_globals.threads;
+
+  pthread_mutex_lock(&mutex);
+
+  while (!sampler_stopping)
+  {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += SAMPLE_INTERVAL_SEC;
+
+    pthread_cond_timedwait(&cond, &mutex, &ts);
+
+    if (!sampler_stopping)
+      sample_locked();
+  }
+
+  pthread_mutex_unlock(&mutex);
+
+  return NULL;
+}
+
+
+int sb_energy_run_start(void)
+{
+  if (!energy_enabled)
+    return 0;
+
+  pthread_mutex_lock(&mutex);
+  reset_locked();
+  sampler_stopping = false;
+  pthread_mutex_unlock(&mutex);
+
+  if (sb_thread_create(&sampler_thread, &sb_thread_attr, &sampler_proc,
+                       NULL) != 0)
+  {
+    log_errno(LOG_FATAL, "sb_thread_create() for the energy sampler failed.");
+    return 1;
+  }
+
+  sampler_created = true;
+
+  return 0;
+}
+
+
+void sb_energy_reset(void)
+{
+  if (!energy_enabled)
+    return;
+
+  pthread_mutex_lock(&mutex);
+  reset_locked();
+  pthread_mutex_unlock(&mutex);
+}
+
+
+void sb_energy_run_stop(void)
+{
+  if (!sampler_created)
+    return;
+
+  pthread_mutex_lock(&mutex);
+  sampler_stopping = true;
+  pthread_cond_signal(&cond);
+  pthread_mutex_unlock(&mutex);
+
+  if (sb_thread_join(sampler_thread, NULL))
+    log_errno(LOG_FATAL, "Terminating the energy sampler failed.");
+
+  sampler_created = false;
+
+  pthread_mutex_lock(&mutex);
+  sample_locked();
+  run_stop_ns = sb_usage_clock();
+  pthread_mutex_unlock(&mutex);
+}
+
+
+void sb_energy_report_intermediate(double time_total, uint64_t events)
+{
+  char     buf[256];
+  size_t   len = 0;
+  uint64_t total_uj = 0;
+  double   seconds;
+
+  pthread_mutex_lock(&mutex);
+
+  sample_locked();
+
+  const uint64_t now = sb_usage_clock();
+
+  seconds = NS2SEC(now - report_ns);
+  report_ns = now;
+
+  for (unsigned int i = 0; i < ndomains; i++)
+  {
+    domain_t       *d = &domains[i];
+    const uint64_t uj = d->total_uj - d->report_uj;
+
+    d->report_uj = d->total_uj;
+    total_uj += uj;
+
+    if (len < sizeof(buf))
+      len += snprintf(buf + len, sizeof(buf) - len, " %s: %.2fW", d->name,
+                      seconds > 0 ? uj / 1e6 / seconds : 0);
+  }
+
+  pthread_mutex_unlock(&mutex);
+
+  log_timestamp(LOG_NOTICE, time_total, "energy: %.2fW (%s) events/J: %.2f",
+                seconds > 0 ? total_uj / 1e6 / seconds : 0, buf + 1,
+                total_uj > 0 ? events / (total_uj / 1e6) : 0);
+}
+
+
+void sb_energy_report(uint64_t events)
+{
+  uint64_t total_uj = 0;
+
+  if (!energy_enabled)
+    return;
+
+  const double seconds = NS2SEC(run_stop_ns - run_start_ns);
+
+  log_text(LOG_NOTICE, "Energy (RAPL):");
+
+  for (unsigned int i = 0; i < ndomains; i++)
+  {
+    char name[40];
+
+    snprintf(name, sizeof(name), "%.31s:", domains[i].name);
+    log_text(LOG_NOTICE, "    %-36s %.2f J (%.2f W)", name,
+             domains[i].total_uj / 1e6,
+             seconds > 0 ? domains[i].total_uj / 1e6 / seconds : 0);
+
+    total_uj += domains[i].total_uj;
+  }
+
+  const double joules = total_uj / 1e6;
+
+  log_text(LOG_NOTICE, "    total:                               %.2f J "
+           "(%.2f W)", joules, seconds > 0 ? joules / seconds : 0);
+
+  if (events > 0 && total_uj > 0)
+  {
+    log_text(LOG_NOTICE, "    energy per event:                    %.4f mJ",
+             joules * 1000 / events);
+    log_text(LOG_NOTICE, "    events per joule:                    %.2f",
+             events / joules);
+  }
+  else
+  {
+    log_text(LOG_NOTICE, "    energy per event:                    N/A");
+    log_text(LOG_NOTICE, "    events per joule:                    N/A");
+  }
+
+  log_text(LOG_NOTICE, "");
+}
@@ -0,0 +1,59 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* RAPL energy sampling, see --energy */
+
+#ifndef SB_ENERGY_H
+#define SB_ENERGY_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  Read --energy and find the RAPL domains under --energy-path. Returns 0 on
+  success, including when no domains are readable, which only disables
+  energy reporting with a warning.
+*/
+int sb_energy_init(void);
+
+/* Return true if --energy is enabled and energy counters are readable */
+bool sb_energy_enabled(void);
+
+/* Start sampling for a run, called by the main thread */
+int sb_energy_run_start(void);
+
+/* Discard energy consumed so far in the run, e.g. during the warmup */
+void sb_energy_reset(void);
+
+/* Stop sampling at the end of a run */
+void sb_energy_run_stop(void);
+
+/*
+  Print average power since the previous intermediate report and events per
+  joule for the given number of events
+*/
+void sb_energy_report_intermediate(double time_total, uint64_t events);
+
+/* Print energy for the last run and the given number of events in it */
+void sb_energy_report(uint64_t events);
+
+#endif /* SB_ENERGY_H */
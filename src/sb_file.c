@@ -0,0 +1,621 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdlib.h>
+# include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+# include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_LIBAIO
+# include <libaio.h>
+#endif
+#ifdef HAVE_LIBURING
+# include <liburing.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
+#include "sb_file.h"
+#include "sysbench.h"
+#include "sb_counter.h"
+#include "sb_rand.h"
+#include "sb_util.h"
+
+typedef enum
+{
+  FILE_MODE_SYNC,
+  FILE_MODE_ASYNC,
+  FILE_MODE_URING,
+  FILE_MODE_MMAP
+} file_mode_t;
+
+static const char *mode_names[] = {"sync", "async", "uring", "mmap", NULL};
+
+/* A request queued with sb_file_queue() */
+typedef struct
+{
+  bool     write;
+  size_t   len;
+  uint64_t offset;
+} file_req_t;
+
+struct sb_file
+{
+  file_mode_t     mode;
+  int             fd;
+  unsigned int    depth;        /* maximum number of queued requests */
+  size_t          max_len;      /* maximum request length */
+  char            *buf;         /* a buffer of max_len bytes per request */
+  file_req_t      *reqs;
+  unsigned int    nreqs;        /* number of queued requests */
+  char            *map;         /* mapping of the whole file for 'mmap' */
+  size_t          map_len;
+#ifdef HAVE_LIBAIO
+  io_context_t    aio_ctx;
+  struct iocb     *iocbs;
+  struct iocb     **iocbps;
+  struct io_event *events;
+#endif
+#ifdef HAVE_LIBURING
+  struct io_uring ring;
+  bool            ring_ready;
+#endif
+};
+
+
+/* Account a completed request like the fileio test does */
+
+static void account(bool write, size_t len)
+{
+  if (write)
+  {
+    sb_counter_inc(sb_tls_thread_id, SB_CNT_WRITE);
+    sb_counter_add(sb_tls_thread_id, SB_CNT_BYTES_WRITTEN, len);
+  }
+  else
+  {
+    sb_counter_inc(sb_tls_thread_id, SB_CNT_READ);
+    sb_counter_add(sb_tls_thread_id, SB_CNT_BYTES_READ, len);
+  }
+}
+
+
+/* Set up the I/O mode of a file after it has been opened */
+
+static int mode_init(sb_file_t *f, const char *path)
+{
+  switch (f->mode) {
+  case FILE_MODE_SYNC:
+    return 0;
+
+  case FILE_MODE_ASYNC:
+#ifdef HAVE_LIBAIO
+    f->iocbs = calloc(f->depth, sizeof(struct iocb));
+    f->iocbps = calloc(f->depth, sizeof(struct iocb *));
+    f->events = calloc(f->depth, sizeof(struct io_event));
+    if (f->iocbs == NULL || f->iocbps == NULL || f->events == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+
+    int rc = io_setup((int) f->depth, &f->aio_ctx);
+    if (rc != 0)
+    {
+      log_text(LOG_FATAL, "io_setup() failed for '%s': %s", path,
+               strerror(-rc));
+      return 1;
+    }
+    return 0;
+#else
+    log_text(LOG_FATAL, "sysbench.file: 'async' mode requires libaio "
+             "support, which is not compiled in");
+    return 1;
+#endif
+
+  case FILE_MODE_URING:
+#ifdef HAVE_LIBURING
+  {
+    int rc = io_uring_queue_init(f->depth, &f->ring, 0);
+    if (rc != 0)
+    {
+      log_text(LOG_FATAL, "io_uring_queue_init() failed for '%s': %s", path,
+               strerror(-rc));
+      return 1;
+    }
+    f->ring_ready = true;
+    return 0;
+  }
+#else
+    log_text(LOG_FATAL, "sysbench.file: 'uring' mode requires io_uring "
+             "support, which is not compiled in");
+    return 1;
+#endif
+
+  case FILE_MODE_MMAP:
+  {
+    const int64_t size = sb_file_size(f);
+
+    if (size <= 0)
+    {
+      log_text(LOG_FATAL, "sysbench.file: cannot map empty file '%s'", path);
+      return 1;
+    }
+
+    f->map_len = (size_t) size;
+    f->map = mmap(NULL, f->map_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                  f->fd, 0);
+    if (f->map == MAP_FAILED)
+    {
+      f->map = NULL;
+      log_errno(LOG_FATAL, "mmap() failed for '%s'", path);
+      return 1;
+    }
+    return 0;
+  }
+  }
+
+  return 1;
+}
+
+
+sb_file_t *sb_file_open(const char *path, const char *mode, bool direct,
+                        bool create, uint64_t size, unsigned int depth,
+                        size_t max_len)
+{
+  sb_file_t    *f;
+  unsigned int i;
+  int          flags = O_RDWR;
+
+  for (i = 0; mode_names[i] != NULL; i++)
+    if (!strcmp(mode, mode_names[i]))
+      break;
+
+  if (mode_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "sysbench.file: invalid I/O mode: %s", mode);
+    return NULL;
+  }
+
+  if (depth == 0 || max_len == 0)
+  {
+    log_text(LOG_FATAL, "sysbench.file: queue depth and maximum request "
+             "length must be positive");
+    return NULL;
+  }
+
+  if (direct)
+  {
+#ifdef O_DIRECT
+    if (i == FILE_MODE_MMAP)
+    {
+      log_text(LOG_FATAL, "sysbench.file: direct I/O cannot be used with "
+               "'mmap' mode");
+      return NULL;
+    }
+    flags |= O_DIRECT;
+#else
+    log_text(LOG_FATAL, "sysbench.file: direct I/O is not supported on this "
+             "platform");
+    return NULL;
+#endif
+  }
+
+  if (create)
+    flags |= O_CREAT;
+
+  if ((f = calloc(1, sizeof(sb_file_t))) == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return NULL;
+  }
+
+  f->mode = (file_mode_t) i;
+  f->depth = depth;
+  f->max_len = max_len;
+
+  f->fd = open(path, flags, S_IRUSR | S_IWUSR);
+  if (f->fd < 0)
+  {
+    log_errno(LOG_FATAL, "sysbench.file: cannot open '%s'", path);
+    free(f);
+    return NULL;
+  }
+
+  if (create && size > 0 && sb_file_size(f) < (int64_t) size &&
+      ftruncate(f->fd, (off_t) size) != 0)
+  {
+    log_errno(LOG_FATAL, "sysbench.file: cannot extend '%s'", path);
+    goto error;
+  }
+
+  /* Buffers are aligned for direct I/O, and filled with random data once */
+  f->buf = sb_memalign(depth * max_len, sb_getpagesize());
+  f->reqs = calloc(depth, sizeof(file_req_t));
+  if (f->buf == NULL || f->reqs == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    goto error;
+  }
+
+  for (size_t j = 0; j < depth * max_len; j++)
+    f->buf[j] = (char) sb_rand_uniform_uint64();
+
+  if (mode_init(f, path))
+    goto error;
+
+  return f;
+
+error:
+  sb_file_close(f);
+  return NULL;
+}
+
+
+int sb_file_queue(sb_file_t *f, bool write, size_t len, uint64_t offset)
+{
+  if (f->nreqs >= f->depth)
+  {
+    log_text(LOG_ALERT, "sysbench.file: too many queued requests, the queue "
+             "depth is %u", f->depth);
+    return -1;
+  }
+
+  if (len > f->max_len)
+  {
+    log_text(LOG_ALERT, "sysbench.file: request of %zu bytes is longer than "
+             "the maximum of %zu", len, f->max_len);
+    return -1;
+  }
+
+  f->reqs[f->nreqs].write = write;
+  f->reqs[f->nreqs].len = len;
+  f->reqs[f->nreqs].offset = offset;
+  f->nreqs++;
+
+  return 0;
+}
+
+
+/* Execute queued requests one by one with pread()/pwrite() or memcpy() */
+
+static int64_t submit_sync(sb_file_t *f)
+{
+  int64_t total = 0;
+
+  for (unsigned int i = 0; i < f->nreqs; i++)
+  {
+    const file_req_t * const r = &f->reqs[i];
+    char             * const buf = f->buf + i * f->max_len;
+    ssize_t          rc;
+
+    if (f->mode == FILE_MODE_MMAP)
+    {
+      if (r->offset >= f->map_len)
+        rc = 0;
+      else
+      {
+        rc = (ssize_t) SB_MIN(r->len, f->map_len - r->offset);
+        if (r->write)
+          memcpy(f->map + r->offset, buf, rc);
+        else
+          memcpy(buf, f->map + r->offset, rc);
+      }
+    }
+    else if (r->write)
+      rc = pwrite(f->fd, buf, r->len, (off_t) r->offset);
+    else
+      rc = pread(f->fd, buf, r->len, (off_t) r->offset);
+
+    if (rc < 0)
+    {
+      log_errno(LOG_FATAL, "sysbench.file: %s() failed",
+                r->write ? "pwrite" : "pread");
+      return -1;
+    }
+
+    account(r->write, (size_t) rc);
+    total += rc;
+  }
+
+  return total;
+}
+
+
+#ifdef HAVE_LIBAIO
+
+/* Have all queued requests in flight with libaio */
+
+static int64_t submit_async(sb_file_t *f)
+{
+  int64_t      total = 0;
+  unsigned int done = 0;
+  int          rc;
+
+  for (unsigned int i = 0; i < f->nreqs; i++)
+  {
+    const file_req_t * const r = &f->reqs[i];
+    char             * const buf = f->buf + i * f->max_len;
+
+    if (r->write)
+      io_prep_pwrite(&f->iocbs[i], f->fd, buf, r->len, (long long) r->offset);
+    else
+      io_prep_pread(&f->iocbs[i], f->fd, buf, r->len, (long long) r->offset);
+    f->iocbs[i].data = (void *) r;
+    f->iocbps[i] = &f->iocbs[i];
+  }
+
+  if ((rc = io_submit(f->aio_ctx, f->nreqs, f->iocbps)) != (int) f->nreqs)
+  {
+    log_text(LOG_FATAL, "sysbench.file: io_submit() failed: %s",
+             rc < 0 ? strerror(-rc) : "not all requests submitted");
+    return -1;
+  }
+
+  while (done < f->nreqs)
+  {
+    rc = io_getevents(f->aio_ctx, f->nreqs - done, f->nreqs - done,
+                      f->events, NULL);
+    if (rc == -EINTR)
+      continue;
+    if (rc < 0)
+    {
+      log_text(LOG_FATAL, "sysbench.file: io_getevents() failed: %s",
+               strerror(-rc));
+      return -1;
+    }
+
+    for (int i = 0; i < rc; i++)
+    {
+      const file_req_t * const r = f->events[i].data;
+      const long             res = (long) f->events[i].res;
+
+      if (res < 0)
+      {
+        log_text(LOG_FATAL, "sysbench.file: asynchronous %s failed: %s",
+                 r->write ? "write" : "read", strerror((int) -res));
+        total = -1;
+        continue;
+      }
+
+      account(r->write, (size_t) res);
+      if (total >= 0)
+        total += res;
+    }
+
+    done += (unsigned int) rc;
+  }
+
+  return total;
+}
+
+#endif /* HAVE_LIBAIO */
+
+
+#ifdef HAVE_LIBURING
+
+/* Have all queued requests in flight with io_uring */
+
+static int64_t submit_uring(sb_file_t *f)
+{
+  int64_t total = 0;
+  int     rc;
+
+  for (unsigned int i = 0; i < f->nreqs; i++)
+  {
+    const file_req_t    * const r = &f->reqs[i];
+    char                * const buf = f->buf + i * f->max_len;
+    struct io_uring_sqe * const sqe = io_uring_get_sqe(&f->ring);
+
+    if (r->write)
+      io_uring_prep_write(sqe, f->fd, buf, r->len, r->offset);
+    else
+      io_uring_prep_read(sqe, f->fd, buf, r->len, r->offset);
+    io_uring_sqe_set_data(sqe, (void *) r);
+  }
+
+  rc = io_uring_submit_and_wait(&f->ring, f->nreqs);
+  if (rc < 0)
+  {
+    log_text(LOG_FATAL, "sysbench.file: io_uring_submit_and_wait() failed: "
+             "%s", strerror(-rc));
+    return -1;
+  }
+
+  for (unsigned int done = 0; done < f->nreqs; done++)
+  {
+    struct io_uring_cqe *cqe;
+
+    if ((rc = io_uring_wait_cqe(&f->ring, &cqe)) != 0)
+    {
+      log_text(LOG_FATAL, "sysbench.file: io_uring_wait_cqe() failed: %s",
+               strerror(-rc));
+      return -1;
+    }
+
+    const file_req_t * const r = io_uring_cqe_get_data(cqe);
+    const int              res = cqe->res;
+
+    io_uring_cqe_seen(&f->ring, cqe);
+
+    if (res < 0)
+    {
+      log_text(LOG_FATAL, "sysbench.file: io_uring %s failed: %s",
+               r->write ? "write" : "read", strerror(-res));
+      total = -1;
+      continue;
+    }
+
+    account(r->write, (size_t) res);
+    if (total >= 0)
+      total += res;
+  }
+
+  return total;
+}
+
+#endif /* HAVE_LIBURING */
+
+
+int64_t sb_file_submit(sb_file_t *f)
+{
+  int64_t rc;
+
+  if (f->nreqs == 0)
+    return 0;
+
+  switch (f->mode) {
+#ifdef HAVE_LIBAIO
+  case FILE_MODE_ASYNC:
+    rc = submit_async(f);
+    break;
+#endif
+#ifdef HAVE_LIBURING
+  case FILE_MODE_URING:
+    rc = submit_uring(f);
+    break;
+#endif
+  default:
+    rc = submit_sync(f);
+  }
+
+  f->nreqs = 0;
+
+  return rc;
+}
+
+
+int64_t sb_file_pread(sb_file_t *f, size_t len, uint64_t offset)
+{
+  if (f->nreqs > 0)
+  {
+    log_text(LOG_ALERT, "sysbench.file: pread() with queued requests");
+    return -1;
+  }
+
+  if (sb_file_queue(f, false, len, offset))
+    return -1;
+
+  return sb_file_submit(f);
+}
+
+
+int64_t sb_file_pwrite(sb_file_t *f, size_t len, uint64_t offset)
+{
+  if (f->nreqs > 0)
+  {
+    log_text(LOG_ALERT, "sysbench.file: pwrite() with queued requests");
+    return -1;
+  }
+
+  if (sb_file_queue(f, true, len, offset))
+    return -1;
+
+  return sb_file_submit(f);
+}
+
+
+int sb_file_fsync(sb_file_t *f, bool data_only)
+{
+  int rc;
+
+  if (f->mode == FILE_MODE_MMAP)
+    rc = msync(f->map, f->map_len, MS_SYNC);
+#ifdef HAVE_FDATASYNC
+  else if (data_only)
+    rc = fdatasync(f->fd);
+#endif
+  else
+    rc = fsync(f->fd);
+
+  if (rc != 0)
+  {
+    log_errno(LOG_FATAL, "sysbench.file: %s() failed",
+              f->mode == FILE_MODE_MMAP ? "msync" :
+              data_only ? "fdatasync" : "fsync");
+    return -1;
+  }
+
+  sb_counter_inc(sb_tls_thread_id, SB_CNT_OTHER);
+
+  return 0;
+}
+
+
+int64_t sb_file_size(sb_file_t *f)
+{
+  struct stat st;
+
+  if (fstat(f->fd, &st) != 0)
+  {
+    log_errno(LOG_FATAL, "sysbench.file: fstat() failed");
+    return -1;
+  }
+
+  return (int64_t) st.st_size;
+}
+
+
+int sb_file_close(sb_file_t *f)
+{
+  int rc = 0;
+
+  if (f == NULL)
+    return 0;
+
+#ifdef HAVE_LIBAIO
+  if (f->events != NULL)
+    io_destroy(f->aio_ctx);
+  free(f->iocbs);
+  free(f->iocbps);
+  free(f->events);
+#endif
+#ifdef HAVE_LIBURING
+  if (f->ring_ready)
+    io_uring_queue_exit(&f->ring);
+#endif
+
+  if (f->map != NULL)
+    munmap(f->map, f->map_len);
+
+  if (f->fd >= 0 && close(f->fd) != 0)
+    rc = -1;
+
+  free(f->buf);
+  free(f->reqs);
+  free(f);
+
+  return rc;
+}
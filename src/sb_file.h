@@ -0,0 +1,83 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  File I/O for Lua scripts, see the sysbench.file module. A file is opened by a
+  single thread with one of the I/O modes of the fileio test: 'sync' (pread()
+  and pwrite()), 'async' (libaio), 'uring' (io_uring) or 'mmap'. Requests can
+  be executed one at a time, or queued and submitted together, in which case
+  'async' and 'uring' have all of them in flight at once. Transferred data is
+  accounted with the same counters as in the fileio test. All functions are
+  exported to Lua via FFI.
+*/
+
+#ifndef SB_FILE_H
+#define SB_FILE_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stddef.h>
+# include <inttypes.h>
+#endif
+
+#include <stdbool.h>
+
+typedef struct sb_file sb_file_t;
+
+/*
+  Open a file with a given I/O mode. Up to 'depth' requests of at most
+  'max_len' bytes each can be queued. With 'create' the file is created if it
+  does not exist, and extended to 'size' bytes if it is shorter. Returns NULL
+  on errors, which are logged.
+*/
+sb_file_t *sb_file_open(const char *path, const char *mode, bool direct,
+                        bool create, uint64_t size, unsigned int depth,
+                        size_t max_len);
+
+/*
+  Read or write 'len' bytes at 'offset' and wait for completion. Return the
+  number of transferred bytes, or -1 on errors.
+*/
+int64_t sb_file_pread(sb_file_t *f, size_t len, uint64_t offset);
+int64_t sb_file_pwrite(sb_file_t *f, size_t len, uint64_t offset);
+
+/*
+  Queue a read or a write to be sent with sb_file_submit(). Returns 0 on
+  success, or -1 if the queue is full or the request is too long.
+*/
+int sb_file_queue(sb_file_t *f, bool write, size_t len, uint64_t offset);
+
+/*
+  Send all queued requests and wait for their completion. Returns the total
+  number of transferred bytes, or -1 on errors.
+*/
+int64_t sb_file_submit(sb_file_t *f);
+
+/* Flush the file with fsync(), or fdatasync() with 'data_only' */
+int sb_file_fsync(sb_file_t *f, bool data_only);
+
+/* Return the size of the file, or -1 on errors */
+int64_t sb_file_size(sb_file_t *f);
+
+/* Close the file and free resources. Queued requests are discarded. */
+int sb_file_close(sb_file_t *f);
+
+#endif /* SB_FILE_H */
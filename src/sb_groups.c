@@ -0,0 +1,420 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Thread groups split worker threads into groups running different scripts at
+  different rates within one run, with latency and throughput reported per
+  group. --thread-groups is a list of groups in the following form:
+
+    THREADS[@RATE][:SCRIPT]
+
+  e.g. 64@40000:oltp_point_select,8:oltp_write_only. Groups without SCRIPT run
+  the main script or built-in test, and those without RATE are not throttled.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#ifdef HAVE_LIBGEN_H
+# include <libgen.h>
+#endif
+
+#include "sb_groups.h"
+#include "sb_counter.h"
+#include "sb_histogram.h"
+#include "sb_list.h"
+#include "sb_logger.h"
+#include "sb_options.h"
+#include "sb_util.h"
+#include "sysbench.h"
+
+typedef struct
+{
+  unsigned int   threads;
+  unsigned int   first;         /* first worker thread of the group */
+  unsigned int   rate;          /* target rate, 0 if not throttled */
+  char           *script;       /* NULL for the main script */
+  char           *name;
+  sb_histogram_t histogram;
+
+  /* Counter values at the last intermediate report and checkpoint */
+  uint64_t       int_events;
+  uint64_t       int_errors;
+  uint64_t       cp_events;
+  uint64_t       cp_errors;
+
+  /* Statistics saved by the last checkpoint */
+  uint64_t       events;
+  uint64_t       errors;
+  double         seconds;
+  double         avg_ms;
+  double         max_ms;
+  double         *pcts;
+} sb_group_t;
+
+static sb_group_t   *groups;
+static unsigned int ngroups;
+static unsigned int total_threads;
+
+
+/* Return the script name without the directory and the .lua extension */
+
+static char *script_name(const char *path)
+{
+  char   *tmp = strdup(path);
+  char   *name = strdup(basename(tmp));
+  size_t len = strlen(name);
+
+  free(tmp);
+
+  if (len > 4 && !strcmp(name + len - 4, ".lua"))
+    name[len - 4] = '\0';
+
+  return name;
+}
+
+
+/* Parse a group definition, return 0 on success */
+
+static int parse_group(const char *s, sb_group_t *g)
+{
+  char *end;
+
+  memset(g, 0, sizeof(*g));
+
+  const long threads = strtol(s, &end, 10);
+  if (end == s || threads <= 0 || threads > 100000)
+    return 1;
+  g->threads = (unsigned int) threads;
+  s = end;
+
+  if (*s == '@')
+  {
+    const long rate = strtol(s + 1, &end, 10);
+
+    if (end == s + 1 || rate <= 0)
+      return 1;
+    g->rate = (unsigned int) rate;
+    s = end;
+  }
+
+  if (*s == ':')
+  {
+    if (s[1] == '\0')
+      return 1;
+    g->script = strdup(s + 1);
+    return 0;
+  }
+
+  return *s != '\0';
+}
+
+
+int sb_groups_init(void)
+{
+  sb_list_t      *list = sb_get_value_list("thread-groups");
+  sb_list_item_t *pos;
+  unsigned int   n = 0;
+
+  SB_LIST_FOR_EACH(pos, list)
+    n++;
+
+  if (n == 0)
+    return 0;
+
+  groups = calloc(n, sizeof(sb_group_t));
+  if (groups == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  SB_LIST_FOR_EACH(pos, list)
+  {
+    const value_t *val = SB_LIST_ENTRY(pos, value_t, listitem);
+    sb_group_t    *g = &groups[ngroups];
+
+    if (parse_group(val->data, g))
+    {
+      log_text(LOG_FATAL, "Invalid value for --thread-groups: '%s'",
+               val->data);
+      return 1;
+    }
+
+    if (g->script != NULL)
+      g->name = script_name(g->script);
+    else if (sb_globals.testname != NULL)
+      g->name = script_name(sb_globals.testname);
+    else
+      g->name = strdup("<stdin>");
+
+    if (oper_histogram_init(&g->histogram))
+      return 1;
+
+    g->first = total_threads;
+    total_threads += g->threads;
+    ngroups++;
+  }
+
+  return 0;
+}
+
+
+bool sb_groups_enabled(void)
+{
+  return ngroups > 0;
+}
+
+
+unsigned int sb_groups_threads(void)
+{
+  return total_threads;
+}
+
+
+unsigned int sb_groups_rate(void)
+{
+  unsigned int rate = 0;
+
+  for (unsigned int i = 0; i < ngroups; i++)
+    rate += groups[i].rate;
+
+  return rate;
+}
+
+
+unsigned int sb_groups_count(void)
+{
+  return ngroups;
+}
+
+
+const char *sb_groups_name(unsigned int idx)
+{
+  return groups[idx].name;
+}
+
+
+bool sb_groups_have_scripts(void)
+{
+  for (unsigned int i = 0; i < ngroups; i++)
+    if (groups[i].script != NULL)
+      return true;
+
+  return false;
+}
+
+
+/* Return the group of a worker thread, or NULL for background threads */
+
+static sb_group_t *group_of(int thread_id)
+{
+  for (unsigned int i = 0; i < ngroups; i++)
+    if ((unsigned int) thread_id < groups[i].first + groups[i].threads)
+      return (unsigned int) thread_id >= groups[i].first ? &groups[i] : NULL;
+
+  return NULL;
+}
+
+
+int sb_groups_index(int thread_id)
+{
+  const sb_group_t *g = group_of(thread_id);
+
+  return g != NULL ? (int) (g - groups) : -1;
+}
+
+
+const char *sb_groups_script(int thread_id)
+{
+  const sb_group_t *g = group_of(thread_id);
+
+  return g != NULL ? g->script : NULL;
+}
+
+
+double sb_groups_thread_rate(int thread_id)
+{
+  const sb_group_t *g = group_of(thread_id);
+
+  return g != NULL ? (double) g->rate / g->threads : 0;
+}
+
+
+void sb_groups_event(int thread_id, double ms)
+{
+  sb_group_t *g = group_of(thread_id);
+
+  if (g != NULL)
+    sb_histogram_update(&g->histogram, ms);
+}
+
+
+/* Return the sum of a counter over the threads of a group */
+
+static uint64_t group_counter(const sb_group_t *g, sb_counter_type_t type)
+{
+  uint64_t val = 0;
+
+  for (unsigned int i = g->first; i < g->first + g->threads; i++)
+    val += sb_counter_val(i, type);
+
+  return val;
+}
+
+
+void sb_groups_report_intermediate(double time_total, double seconds)
+{
+  for (unsigned int i = 0; i < ngroups; i++)
+  {
+    sb_group_t     *g = &groups[i];
+    const uint64_t events = group_counter(g, SB_CNT_EVENT);
+    const uint64_t errors = group_counter(g, SB_CNT_ERROR);
+    double         *pcts = NULL;
+
+    if (sb_globals.npercentiles > 0)
+      pcts = sb_histogram_get_pct_intermediate(&g->histogram,
+                                               sb_globals.percentiles, 1);
+
+    log_timestamp(LOG_NOTICE, time_total,
+                  "group %u (%s): thds: %u eps: %4.2f lat (ms,%g%%): %4.2f "
+                  "err/s: %4.2f", i + 1, g->name, g->threads,
+                  (events - g->int_events) / seconds,
+                  sb_globals.npercentiles > 0 ? sb_globals.percentiles[0] : 0,
+                  pcts != NULL ? SEC2MS(pcts[0]) : 0,
+                  (errors - g->int_errors) / seconds);
+
+    free(pcts);
+
+    g->int_events = events;
+    g->int_errors = errors;
+  }
+}
+
+
+void sb_groups_checkpoint(const sb_timer_t *timers, double seconds)
+{
+  for (unsigned int i = 0; i < ngroups; i++)
+  {
+    sb_group_t     *g = &groups[i];
+    const uint64_t events = group_counter(g, SB_CNT_EVENT);
+    const uint64_t errors = group_counter(g, SB_CNT_ERROR);
+    uint64_t       samples = 0;
+    uint64_t       sum_ns = 0;
+    uint64_t       max_ns = 0;
+
+    for (unsigned int j = g->first; j < g->first + g->threads; j++)
+    {
+      samples += timers[j].samples;
+      sum_ns += timers[j].sum_time;
+      max_ns = SB_MAX(max_ns, timers[j].max_time);
+    }
+
+    g->events = events - g->cp_events;
+    g->errors = errors - g->cp_errors;
+    g->cp_events = events;
+    g->cp_errors = errors;
+    g->seconds = seconds;
+    g->avg_ms = samples > 0 ? NS2MS(sum_ns / samples) : 0;
+    g->max_ms = NS2MS(max_ns);
+
+    free(g->pcts);
+    g->pcts = NULL;
+
+    if (sb_globals.npercentiles > 0)
+      g->pcts = sb_histogram_get_pct_checkpoint(&g->histogram,
+                                                sb_globals.percentiles, 1);
+  }
+}
+
+
+void sb_groups_report_cumulative(void)
+{
+  char pct[32];
+
+  snprintf(pct, sizeof(pct), "%.2fth",
+           sb_globals.npercentiles > 0 ? sb_globals.percentiles[0] : 0);
+
+  log_text(LOG_NOTICE, "Thread groups:");
+  log_text(LOG_NOTICE, "    %-24s %7s %8s %12s %9s %9s %9s %8s", "group",
+           "threads", "rate", "events/s", "avg ms", pct, "max ms", "err/s");
+
+  for (unsigned int i = 0; i < ngroups; i++)
+  {
+    const sb_group_t *g = &groups[i];
+    const double     seconds = g->seconds > 0 ? g->seconds : 1;
+    char             name[32];
+    char             rate[16];
+
+    snprintf(name, sizeof(name), "%u: %s", i + 1, g->name);
+
+    if (g->rate > 0)
+      snprintf(rate, sizeof(rate), "%u", g->rate);
+    else
+      snprintf(rate, sizeof(rate), "-");
+
+    log_text(LOG_NOTICE, "    %-24s %7u %8s %12.2f %9.2f %9.2f %9.2f %8.2f",
+             name, g->threads, rate, g->events / seconds, g->avg_ms,
+             g->pcts != NULL ? SEC2MS(g->pcts[0]) : 0, g->max_ms,
+             g->errors / seconds);
+  }
+
+  log_text(LOG_NOTICE, "");
+}
+
+
+void sb_groups_print_mode(void)
+{
+  log_text(LOG_NOTICE, "Thread groups:");
+
+  for (unsigned int i = 0; i < ngroups; i++)
+  {
+    const sb_group_t *g = &groups[i];
+
+    if (g->rate > 0)
+      log_text(LOG_NOTICE, "    %u: %u thread(s) running %s at %u/sec",
+               i + 1, g->threads, g->name, g->rate);
+    else
+      log_text(LOG_NOTICE, "    %u: %u thread(s) running %s", i + 1,
+               g->threads, g->name);
+  }
+}
+
+
+void sb_groups_done(void)
+{
+  for (unsigned int i = 0; i < ngroups; i++)
+  {
+    sb_histogram_done(&groups[i].histogram);
+    free(groups[i].script);
+    free(groups[i].name);
+    free(groups[i].pcts);
+  }
+
+  free(groups);
+  groups = NULL;
+  ngroups = 0;
+  total_threads = 0;
+}
@@ -0,0 +1,89 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Worker thread groups, see --thread-groups */
+
+#ifndef SB_GROUPS_H
+#define SB_GROUPS_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+
+#include "sb_timer.h"
+
+/* Parse --thread-groups. Returns 0 on success. */
+int sb_groups_init(void);
+
+/* Return true if thread groups are defined */
+bool sb_groups_enabled(void);
+
+/* Return the total number of threads in all groups */
+unsigned int sb_groups_threads(void);
+
+/* Return the total target rate of all groups, 0 if none of them has one */
+unsigned int sb_groups_rate(void);
+
+/* Return the number of groups */
+unsigned int sb_groups_count(void);
+
+/* Return the index of the group of a worker thread, or -1 if none */
+int sb_groups_index(int thread_id);
+
+/* Return the name of the group with a given index */
+const char *sb_groups_name(unsigned int idx);
+
+/* Return true if any group runs a script other than the main one */
+bool sb_groups_have_scripts(void);
+
+/*
+  Return the script executed by a worker thread, or NULL if it runs the main
+  script or test
+*/
+const char *sb_groups_script(int thread_id);
+
+/*
+  Return the target rate in events per second of a worker thread, 0 if its
+  group is not throttled
+*/
+double sb_groups_thread_rate(int thread_id);
+
+/* Account the latency of an event in the group of a worker thread */
+void sb_groups_event(int thread_id, double ms);
+
+/* Print group reports with intermediate statistics */
+void sb_groups_report_intermediate(double time_total, double seconds);
+
+/*
+  Save group statistics since the previous checkpoint for
+  sb_groups_report_cumulative() and reset them. timers are the per-thread
+  event timers for the same period.
+*/
+void sb_groups_checkpoint(const sb_timer_t *timers, double seconds);
+
+/* Print group statistics saved by the last checkpoint */
+void sb_groups_report_cumulative(void);
+
+/* Print the groups in the test mode banner */
+void sb_groups_print_mode(void);
+
+void sb_groups_done(void);
+
+#endif /* SB_GROUPS_H */
@@ -47,8 +47,23 @@
 */
 #define SB_HISTOGRAM_NSLOTS 128
 
+/* Maximum number of significant digits supported by HDR histograms */
+#define SB_HISTOGRAM_HDR_MAX_DIGITS 5
+
+/*
+  Maximum number of dirty chunks in an HDR per-thread array, i.e. 64 chunk
+  words with 64 bits each, so that a single summary word covers them all
+*/
+#define SB_HISTOGRAM_HDR_MAX_CHUNKS 4096
+
+/* Minimum dirty chunk size in elements, i.e. one cache line */
+#define SB_HISTOGRAM_HDR_MIN_CHUNK_SHIFT 3
+
 /* Global latency histogram */
 sb_histogram_t sb_latency_histogram CK_CC_CACHELINE;
+sb_histogram_t sb_intended_latency_histogram CK_CC_CACHELINE;
+sb_histogram_t sb_cycle_time_histogram CK_CC_CACHELINE;
+sb_histogram_t sb_queue_wait_histogram CK_CC_CACHELINE;
 
 
 int sb_histogram_init(sb_histogram_t *h, size_t size,
@@ -57,8 +72,11 @@ int sb_histogram_init(sb_histogram_t *h, size_t size,
   size_t i;
   uint64_t *tmp;
 
-  /* Allocate memory for cumulative_array + temp_array + all slot arrays */
-  tmp = (uint64_t *) calloc(size * (SB_HISTOGRAM_NSLOTS + 2), sizeof(uint64_t));
+  /*
+    Allocate memory for cumulative_array + reset_array + temp_array + all slot
+    arrays
+  */
+  tmp = (uint64_t *) calloc(size * (SB_HISTOGRAM_NSLOTS + 3), sizeof(uint64_t));
   h->interm_slots = (uint64_t **) malloc(SB_HISTOGRAM_NSLOTS *
                                          sizeof(uint64_t *));
 
@@ -73,6 +91,9 @@ int sb_histogram_init(sb_histogram_t *h, size_t size,
   h->cumulative_array = tmp;
   tmp += size;
 
+  h->reset_array = tmp;
+  tmp += size;
+
   h->temp_array = tmp;
   tmp += size;
 
@@ -89,6 +110,13 @@ int sb_histogram_init(sb_histogram_t *h, size_t size,
   h->range_max = range_max;
 
   h->array_size = size;
+  h->cumulative_nevents = 0;
+
+  h->type = SB_HISTOGRAM_LOG;
+  h->hdr_counts = NULL;
+  h->hdr_merged = NULL;
+  h->hdr_dirty = NULL;
+  h->hdr_dirty_groups = NULL;
 
   pthread_rwlock_init(&h->lock, NULL);
 
@@ -96,11 +124,331 @@ int sb_histogram_init(sb_histogram_t *h, size_t size,
 }
 
 
+int sb_histogram_init_hdr(sb_histogram_t *h, double range_min,
+                          double range_max, unsigned int digits)
+{
+  unsigned int sub_mag;
+  uint64_t     sub_count;
+  uint64_t     untrackable;
+  size_t       nbuckets;
+  size_t       size;
+  size_t       nwords;
+
+  if (digits < 1 || digits > SB_HISTOGRAM_HDR_MAX_DIGITS)
+  {
+    log_text(LOG_FATAL, "Invalid number of significant digits for a histogram "
+             "object: %u (must be between 1 and %d)", digits,
+             SB_HISTOGRAM_HDR_MAX_DIGITS);
+    return 1;
+  }
+
+  if (!(range_min > 0) || !(range_max > range_min))
+  {
+    log_text(LOG_FATAL, "Invalid range for a histogram object: [%f, %f]",
+             range_min, range_max);
+    return 1;
+  }
+
+  /*
+    Each bucket covers a power-of-2 range of values with 'sub_count' linear
+    sub-buckets, which is enough to maintain the requested number of
+    significant digits. The lower half of each bucket (except the first one)
+    overlaps with the previous bucket, so only the upper half is stored.
+  */
+  const double mag = ceil(log2(2 * pow(10, digits)));
+  const double highest = ceil(range_max / range_min);
+
+  sub_mag = (unsigned int) mag;
+  h->hdr_sub_half_mag = sub_mag - 1;
+  sub_count = (uint64_t) 1 << sub_mag;
+  h->hdr_sub_mask = sub_count - 1;
+  h->hdr_highest = (uint64_t) highest;
+
+  for (nbuckets = 1, untrackable = sub_count; untrackable <= h->hdr_highest;
+       nbuckets++)
+    untrackable <<= 1;
+
+  size = (nbuckets + 1) * (sub_count / 2);
+
+  /* Worker and background threads + one array for sb_histogram_add() */
+  h->hdr_nthreads = sb_globals.threads + 2;
+  h->hdr_stride = size + SB_CACHELINE_PAD(size * sizeof(uint64_t)) /
+    sizeof(uint64_t);
+
+  h->cumulative_array = (uint64_t *) calloc(size * 3, sizeof(uint64_t));
+  h->hdr_counts = (uint64_t *)
+    sb_memalign(h->hdr_nthreads * h->hdr_stride * sizeof(uint64_t),
+                CK_MD_CACHELINE);
+  h->hdr_merged = (uint64_t *) calloc(h->hdr_nthreads * h->hdr_stride,
+                                      sizeof(uint64_t));
+
+  for (h->hdr_chunk_shift = SB_HISTOGRAM_HDR_MIN_CHUNK_SHIFT;
+       ((size - 1) >> h->hdr_chunk_shift) >= SB_HISTOGRAM_HDR_MAX_CHUNKS;
+       h->hdr_chunk_shift++)
+    ;
+
+  /* Summary word + chunk words */
+  nwords = 1 + (((size - 1) >> h->hdr_chunk_shift) >> 6) + 1;
+  h->hdr_dirty_stride = nwords + SB_CACHELINE_PAD(nwords * sizeof(uint64_t)) /
+    sizeof(uint64_t);
+
+  h->hdr_dirty = (uint64_t *)
+    sb_memalign(h->hdr_nthreads * h->hdr_dirty_stride * sizeof(uint64_t),
+                CK_MD_CACHELINE);
+  h->hdr_dirty_groups = (uint64_t *) calloc((h->hdr_nthreads + 63) / 64,
+                                            sizeof(uint64_t));
+
+  if (h->cumulative_array == NULL || h->hdr_counts == NULL ||
+      h->hdr_merged == NULL || h->hdr_dirty == NULL ||
+      h->hdr_dirty_groups == NULL)
+  {
+    log_text(LOG_FATAL,
+             "Failed to allocate memory for a histogram object, size = %zd",
+             size);
+    return 1;
+  }
+
+  memset(h->hdr_counts, 0, h->hdr_nthreads * h->hdr_stride * sizeof(uint64_t));
+  memset(h->hdr_dirty, 0,
+         h->hdr_nthreads * h->hdr_dirty_stride * sizeof(uint64_t));
+
+  h->reset_array = h->cumulative_array + size;
+  h->temp_array = h->cumulative_array + 2 * size;
+  h->interm_slots = NULL;
+
+  h->range_deduct = 0;
+  h->range_mult = 0;
+
+  h->range_min = range_min;
+  h->range_max = range_max;
+
+  h->array_size = size;
+  h->cumulative_nevents = 0;
+
+  h->type = SB_HISTOGRAM_HDR;
+
+  pthread_rwlock_init(&h->lock, NULL);
+
+  return 0;
+}
+
+
+/*
+  Get the lowest value and the width for an HDR histogram array element, both
+  in units of range_min.
+*/
+static void hdr_get_range(const sb_histogram_t *h, size_t i, uint64_t *lowest,
+                          uint64_t *width)
+{
+  const uint64_t half = (uint64_t) 1 << h->hdr_sub_half_mag;
+  ssize_t        bucket = (ssize_t) (i >> h->hdr_sub_half_mag) - 1;
+  uint64_t       sub = (i & (half - 1)) + half;
+
+  if (bucket < 0)
+  {
+    sub -= half;
+    bucket = 0;
+  }
+
+  *lowest = sub << bucket;
+  *width = (uint64_t) 1 << bucket;
+}
+
+
+/* Value to report for a given histogram array element */
+static double get_value(const sb_histogram_t *h, size_t i)
+{
+  uint64_t lowest, width;
+
+  if (h->type == SB_HISTOGRAM_LOG)
+    return exp(i / h->range_mult + h->range_deduct);
+
+  hdr_get_range(h, i, &lowest, &width);
+
+  return lowest * h->range_min;
+}
+
+
+/*
+  Mark the chunk containing element i of the array for thread ID tid as dirty,
+  along with its chunk word and the thread itself. Bits are checked before
+  being set with atomics, so this is just a few loads from a thread-local
+  cache line once a chunk is dirty. A chunk marked before its count update is
+  visible may be merged late, but never lost, because merges compare counts
+  with hdr_merged rather than resetting them.
+*/
+
+static inline void hdr_mark_dirty(sb_histogram_t *h, size_t tid, size_t i)
+{
+  uint64_t * const dirty = h->hdr_dirty + tid * h->hdr_dirty_stride;
+  const size_t     chunk = i >> h->hdr_chunk_shift;
+  const size_t     word = chunk >> 6;
+  const uint64_t   chunk_bit = (uint64_t) 1 << (chunk & 63);
+  const uint64_t   word_bit = (uint64_t) 1 << word;
+  const uint64_t   thread_bit = (uint64_t) 1 << (tid & 63);
+
+  if (SB_LIKELY(ck_pr_load_64(&dirty[1 + word]) & chunk_bit))
+    return;
+
+  ck_pr_or_64(&dirty[1 + word], chunk_bit);
+
+  if (ck_pr_load_64(&dirty[0]) & word_bit)
+    return;
+
+  ck_pr_or_64(&dirty[0], word_bit);
+
+  if (!(ck_pr_load_64(&h->hdr_dirty_groups[tid >> 6]) & thread_bit))
+    ck_pr_or_64(&h->hdr_dirty_groups[tid >> 6], thread_bit);
+}
+
+
+static void hdr_update(sb_histogram_t *h, double value)
+{
+  const double units = value / h->range_min;
+  size_t       tid = (size_t) sb_tls_thread_id;
+  uint64_t     v;
+  unsigned int bucket;
+
+  if (SB_UNLIKELY(!(units > 0)))
+    v = 0;
+  else if (SB_UNLIKELY(units >= h->hdr_highest))
+    v = h->hdr_highest;
+  else
+    v = (uint64_t) units;
+
+  /* Non-worker threads share the array after worker threads */
+  if (SB_UNLIKELY(tid >= h->hdr_nthreads - 2))
+    tid = h->hdr_nthreads - 2;
+
+  bucket = 64 - __builtin_clzll(v | h->hdr_sub_mask) -
+    (h->hdr_sub_half_mag + 1);
+
+  const size_t i = ((size_t) (bucket + 1) << h->hdr_sub_half_mag) +
+    ((v >> bucket) - ((uint64_t) 1 << h->hdr_sub_half_mag));
+  uint64_t * const cnt = h->hdr_counts + tid * h->hdr_stride + i;
+
+  /*
+    There are no concurrent writers for the array of a worker thread, but
+    readers may load the value concurrently, so just make sure the store is not
+    torn. The shared array needs an atomic increment.
+  */
+  if (SB_LIKELY(tid < h->hdr_nthreads - 2))
+    ck_pr_store_64(cnt, *cnt + 1);
+  else
+    ck_pr_inc_64(cnt);
+
+  hdr_mark_dirty(h, tid, i);
+}
+
+
+/*
+  Add deltas of elements [from, to) of the array for thread ID t since the
+  previous merge to a given array. Returns the number of merged events.
+*/
+static uint64_t hdr_merge_range(sb_histogram_t *h, size_t t, size_t from,
+                                size_t to, uint64_t *array)
+{
+  uint64_t * const cnt = h->hdr_counts + t * h->hdr_stride;
+  uint64_t * const merged = h->hdr_merged + t * h->hdr_stride;
+  uint64_t         nevents = 0;
+
+  for (size_t i = from; i < to; i++)
+  {
+    const uint64_t cur = ck_pr_load_64(&cnt[i]);
+    const uint64_t delta = cur - merged[i];
+
+    if (delta != 0)
+    {
+      merged[i] = cur;
+      array[i] += delta;
+      nevents += delta;
+    }
+  }
+
+  return nevents;
+}
+
+
+/*
+  Merge only the chunks marked dirty since the previous call, walking the
+  thread group, thread summary and chunk word bitmaps top-down and clearing
+  each level before the one below it, so concurrent updates are either seen
+  now or marked again for the next merge.
+*/
+static uint64_t hdr_merge_dirty(sb_histogram_t *h, uint64_t *array)
+{
+  const size_t ngroups = (h->hdr_nthreads + 63) / 64;
+  uint64_t     nevents = 0;
+
+  for (size_t g = 0; g < ngroups; g++)
+  {
+    uint64_t threads;
+
+    if (ck_pr_load_64(&h->hdr_dirty_groups[g]) == 0)
+      continue;
+
+    threads = ck_pr_fas_64(&h->hdr_dirty_groups[g], 0);
+
+    for (; threads != 0; threads &= threads - 1)
+    {
+      const size_t     t = g * 64 + __builtin_ctzll(threads);
+      uint64_t * const dirty = h->hdr_dirty + t * h->hdr_dirty_stride;
+      uint64_t         words = ck_pr_fas_64(&dirty[0], 0);
+
+      for (; words != 0; words &= words - 1)
+      {
+        const size_t w = __builtin_ctzll(words);
+        uint64_t     chunks = ck_pr_fas_64(&dirty[1 + w], 0);
+
+        for (; chunks != 0; chunks &= chunks - 1)
+        {
+          const size_t from = (w * 64 + __builtin_ctzll(chunks)) <<
+            h->hdr_chunk_shift;
+          const size_t to = from + ((size_t) 1 << h->hdr_chunk_shift);
+
+          nevents += hdr_merge_range(h, t, from,
+                                     to < h->array_size ? to : h->array_size,
+                                     array);
+        }
+      }
+    }
+  }
+
+  return nevents;
+}
+
+
+/*
+  Add counts accumulated by all threads since the previous merge to a given
+  array. Must be called with the histogram lock write-locked. Returns the
+  number of merged events. Unless 'full' is true, only dirty chunks are
+  scanned, which may miss updates racing with the merge until the next one.
+*/
+static uint64_t hdr_merge(sb_histogram_t *h, uint64_t *array, bool full)
+{
+  uint64_t nevents = 0;
+
+  if (!full)
+    return hdr_merge_dirty(h, array);
+
+  for (size_t t = 0; t < h->hdr_nthreads; t++)
+    nevents += hdr_merge_range(h, t, 0, h->array_size, array);
+
+  return nevents;
+}
+
+
 void sb_histogram_update(sb_histogram_t *h, double value)
 {
   size_t      slot;
   ssize_t     i;
 
+  if (h->type == SB_HISTOGRAM_HDR)
+  {
+    hdr_update(h, value);
+    return;
+  }
+
   slot = sb_rand_uniform_uint64() % SB_HISTOGRAM_NSLOTS;
 
   i = floor((log(value) - h->range_deduct) * h->range_mult + 0.5);
@@ -113,6 +461,22 @@ void sb_histogram_update(sb_histogram_t *h, double value)
 }
 
 
+void sb_histogram_add(sb_histogram_t *h, size_t i, uint64_t count)
+{
+  if (i >= h->array_size)
+    i = h->array_size - 1;
+
+  if (h->type == SB_HISTOGRAM_HDR)
+  {
+    ck_pr_add_64(h->hdr_counts + (h->hdr_nthreads - 1) * h->hdr_stride + i,
+                 count);
+    hdr_mark_dirty(h, h->hdr_nthreads - 1, i);
+  }
+  else
+    ck_pr_add_64(&h->interm_slots[0][i], count);
+}
+
+
 double *sb_histogram_snapshot_get_pct(sb_histogram_snapshot_t* snapshot, double* percentiles, size_t npercentiles)
 {
   size_t i, n;
@@ -135,7 +499,16 @@ double *sb_histogram_snapshot_get_pct(sb_histogram_snapshot_t* snapshot, double*
         break;
     }
 
-    res[i] = MS2SEC(exp(n / snapshot->range_mult + snapshot->range_deduct));
+    if (snapshot->histogram->type == SB_HISTOGRAM_HDR)
+    {
+      /* Report the highest value equivalent to the found array element */
+      uint64_t lowest, width;
+
+      hdr_get_range(snapshot->histogram, n, &lowest, &width);
+      res[i] = MS2SEC((lowest + width - 1) * snapshot->histogram->range_min);
+    }
+    else
+      res[i] = MS2SEC(exp(n / snapshot->range_mult + snapshot->range_deduct));
   }
 
   return res;
@@ -165,22 +538,31 @@ sb_histogram_snapshot_t *sb_histogram_snapshot_intermediate(sb_histogram_t *h)
   const size_t size = h->array_size;
   uint64_t * const array = h->temp_array;
 
-  for (i = 0; i < size; i++)
+  if (h->type == SB_HISTOGRAM_HDR)
   {
-    array[i] = ck_pr_fas_64(&h->interm_slots[0][i], 0);
-    nevents += array[i];
+    /* Merge per-thread arrays into temp_array. */
+    memset(array, 0, size * sizeof(uint64_t));
+    nevents = hdr_merge(h, array, false);
   }
-
-  for (s = 1; s < SB_HISTOGRAM_NSLOTS; s++)
+  else
   {
     for (i = 0; i < size; i++)
     {
-      uint64_t t;
+      array[i] = ck_pr_fas_64(&h->interm_slots[0][i], 0);
+      nevents += array[i];
+    }
 
-      t = ck_pr_fas_64(&h->interm_slots[s][i], 0);
+    for (s = 1; s < SB_HISTOGRAM_NSLOTS; s++)
+    {
+      for (i = 0; i < size; i++)
+      {
+        uint64_t t;
 
-      array[i] += t;
-      nevents += t;
+        t = ck_pr_fas_64(&h->interm_slots[s][i], 0);
+
+        array[i] += t;
+        nevents += t;
+      }
     }
   }
 
@@ -191,6 +573,7 @@ sb_histogram_snapshot_t *sb_histogram_snapshot_intermediate(sb_histogram_t *h)
 
   snapshot->range_deduct = h->range_deduct;
   snapshot->range_mult = h->range_mult;
+  snapshot->histogram = h;
 
   for (i = 0; i < size; i++)
   {
@@ -230,6 +613,12 @@ static void merge_intermediate_into_cumulative(sb_histogram_t *h)
   const size_t size = h->array_size;
   uint64_t * const array = h->cumulative_array;
 
+  if (h->type == SB_HISTOGRAM_HDR)
+  {
+    h->cumulative_nevents = nevents + hdr_merge(h, array, true);
+    return;
+  }
+
   for (s = 0; s < SB_HISTOGRAM_NSLOTS; s++)
   {
     for (i = 0; i < size; i++)
@@ -268,6 +657,7 @@ double *sb_histogram_get_pct_cumulative(sb_histogram_t *h, double *percentiles,
   snapshot.nevents = h->cumulative_nevents;
   snapshot.range_deduct = h->range_deduct;
   snapshot.range_mult = h->range_mult;
+  snapshot.histogram = h;
 
   pthread_rwlock_unlock(&h->lock);
 
@@ -279,9 +669,14 @@ double *sb_histogram_get_pct_cumulative(sb_histogram_t *h, double *percentiles,
 }
 
 
-double *sb_histogram_get_pct_checkpoint(sb_histogram_t *h, double *percentiles, size_t npercentiles)
+sb_histogram_snapshot_t *sb_histogram_snapshot_checkpoint(sb_histogram_t *h)
 {
-  double   *res = malloc(npercentiles * sizeof(double));
+  /* Allocate the snapshot and its array together, so free() releases both */
+  sb_histogram_snapshot_t *snapshot =
+    malloc(sizeof(sb_histogram_snapshot_t) + h->array_size * sizeof(uint64_t));
+
+  if (snapshot == NULL)
+    return NULL;
 
   /*
     This can be called concurrently with other sb_histogram_*()
@@ -294,30 +689,49 @@ double *sb_histogram_get_pct_checkpoint(sb_histogram_t *h, double *percentiles,
 
   merge_intermediate_into_cumulative(h);
 
-  sb_histogram_snapshot_t snapshot;
-
-  snapshot.array = malloc(h->array_size * sizeof(uint64_t));
-  memcpy(snapshot.array, h->cumulative_array, h->array_size * sizeof(uint64_t));
+  snapshot->array = (uint64_t *) (snapshot + 1);
+  memcpy(snapshot->array, h->cumulative_array, h->array_size * sizeof(uint64_t));
 
-  snapshot.size = h->array_size;
-  snapshot.nevents = h->cumulative_nevents;
-  snapshot.range_deduct = h->range_deduct;
-  snapshot.range_mult = h->range_mult;
+  snapshot->size = h->array_size;
+  snapshot->nevents = h->cumulative_nevents;
+  snapshot->range_deduct = h->range_deduct;
+  snapshot->range_mult = h->range_mult;
+  snapshot->histogram = h;
 
   /* Reset the cumulative array */
+  for (size_t i = 0; i < h->array_size; i++)
+    h->reset_array[i] += h->cumulative_array[i];
   memset(h->cumulative_array, 0, h->array_size * sizeof(uint64_t));
   h->cumulative_nevents = 0;
 
   pthread_rwlock_unlock(&h->lock);
 
-  res = sb_histogram_snapshot_get_pct(&snapshot, percentiles, npercentiles);
+  return snapshot;
+}
 
-  free(snapshot.array);
+
+double *sb_histogram_get_pct_checkpoint(sb_histogram_t *h, double *percentiles, size_t npercentiles)
+{
+  sb_histogram_snapshot_t *snapshot = sb_histogram_snapshot_checkpoint(h);
+  double *res = sb_histogram_snapshot_get_pct(snapshot, percentiles, npercentiles);
+
+  free(snapshot);
 
   return res;
 }
 
 
+double sb_histogram_get_pct_value(sb_histogram_t *h, double percentile)
+{
+  double *res = sb_histogram_get_pct_cumulative(h, &percentile, 1);
+  double value = SEC2MS(res[0]);
+
+  free(res);
+
+  return value;
+}
+
+
 void sb_histogram_print(sb_histogram_t *h)
 {
   uint64_t maxcnt;
@@ -338,7 +752,22 @@ void sb_histogram_print(sb_histogram_t *h)
   }
 
   if (maxcnt == 0)
+  {
+    pthread_rwlock_unlock(&h->lock);
     return;
+  }
+
+  /*
+    Print 3 decimals by default, or enough to tell apart values in the lowest
+    buckets with a lower bound of the histogram range
+  */
+  int precision = 3;
+
+  if (h->range_min < 1e-3)
+  {
+    const double digits = ceil(-log10(h->range_min)) + 2;
+    precision = (int) digits;
+  }
 
   printf("       value  ------------- distribution ------------- count\n");
 
@@ -349,8 +778,8 @@ void sb_histogram_print(sb_histogram_t *h)
 
     width = floor(array[i] * (double) 40 / maxcnt + 0.5);
 
-    printf("%12.3f |%-40.*s %lu\n",
-           exp(i / h->range_mult + h->range_deduct),          /* value */
+    printf("%12.*f |%-40.*s %lu\n",
+           precision, get_value(h, i),                        /* value */
            width, "****************************************", /* distribution */
            (unsigned long) array[i]);                /* count */
   }
@@ -359,12 +788,60 @@ void sb_histogram_print(sb_histogram_t *h)
 }
 
 
+uint64_t sb_histogram_get_counts(sb_histogram_t *h, uint64_t *array)
+{
+  uint64_t nevents = 0;
+
+  /* Only excludes merges of intermediate values, not updates */
+  pthread_rwlock_rdlock(&h->lock);
+
+  for (size_t i = 0; i < h->array_size; i++)
+    array[i] = h->reset_array[i] + h->cumulative_array[i];
+
+  /* Add values not merged into cumulative_array yet */
+  if (h->type == SB_HISTOGRAM_HDR)
+  {
+    for (size_t t = 0; t < h->hdr_nthreads; t++)
+    {
+      const uint64_t * const cnt = h->hdr_counts + t * h->hdr_stride;
+      const uint64_t * const merged = h->hdr_merged + t * h->hdr_stride;
+
+      for (size_t i = 0; i < h->array_size; i++)
+        array[i] += ck_pr_load_64(&cnt[i]) - merged[i];
+    }
+  }
+  else
+  {
+    for (size_t s = 0; s < SB_HISTOGRAM_NSLOTS; s++)
+      for (size_t i = 0; i < h->array_size; i++)
+        array[i] += ck_pr_load_64(&h->interm_slots[s][i]);
+  }
+
+  pthread_rwlock_unlock(&h->lock);
+
+  for (size_t i = 0; i < h->array_size; i++)
+    nevents += array[i];
+
+  return nevents;
+}
+
+
+double sb_histogram_get_value(const sb_histogram_t *h, size_t i)
+{
+  return get_value(h, i);
+}
+
+
 void sb_histogram_done(sb_histogram_t *h)
 {
   pthread_rwlock_destroy(&h->lock);
 
   free(h->cumulative_array);
   free(h->interm_slots);
+  free(h->hdr_counts);
+  free(h->hdr_merged);
+  free(h->hdr_dirty);
+  free(h->hdr_dirty_groups);
 }
 
 /*
@@ -389,7 +866,29 @@ sb_histogram_t *sb_histogram_new(size_t size, double range_min,
 }
 
 /*
-  Deallocate a histogram allocated with sb_histogram_new().
+  Allocate a new histogram and initialize it with sb_histogram_init_hdr().
+*/
+
+sb_histogram_t *sb_histogram_new_hdr(double range_min, double range_max,
+                                     unsigned int digits)
+{
+  sb_histogram_t *h;
+
+  if ((h = malloc(sizeof(*h))) == NULL)
+    return NULL;
+
+  if (sb_histogram_init_hdr(h, range_min, range_max, digits))
+  {
+    free(h);
+    return NULL;
+  }
+
+  return h;
+}
+
+/*
+  Deallocate a histogram allocated with sb_histogram_new() or
+  sb_histogram_new_hdr().
 */
 
 void sb_histogram_delete(sb_histogram_t *h)
@@ -24,7 +24,24 @@
 # include <pthread.h>
 #endif
 
+/* Histogram implementations */
+typedef enum {
+  /*
+    Log-scale buckets updated with atomics in one of SB_HISTOGRAM_NSLOTS
+    randomly chosen shared slots
+  */
+  SB_HISTOGRAM_LOG,
+  /*
+    HDR-style log-linear buckets with a fixed number of significant digits.
+    Each thread updates its own array without atomic operations, arrays are
+    merged by readers when calculating percentiles.
+  */
+  SB_HISTOGRAM_HDR
+} sb_histogram_type_t;
+
 typedef struct {
+  /* Histogram implementation */
+  sb_histogram_type_t   type;
   /*
      Cumulative histogram array. Updated 'on demand' by
      sb_histogram_get_pct_intermediate(). Protected by 'lock'.
@@ -35,6 +52,11 @@ typedef struct {
      sb_histogram_get_pct_intermediate(). Protected by 'lock'.
   */
   uint64_t              cumulative_nevents;
+  /*
+    Events dropped from cumulative_array by checkpoint resets, so that the
+    number of events since initialization is still known. Protected by 'lock'.
+  */
+  uint64_t              *reset_array;
   /*
     Temporary array for intermediate percentile calculations. Protected by
     'lock'.
@@ -56,6 +78,46 @@ typedef struct {
   double                range_deduct;
   /* Value to multiply to calculate histogram range based array element */
   double                range_mult;
+  /*
+    Per-thread count arrays for HDR histograms, one array of 'hdr_stride'
+    elements for each thread ID (including the background one). Each array is
+    only updated by the thread owning it, except the background one which is
+    shared by all non-worker threads, and the last one which is reserved for
+    sb_histogram_add(). Both are updated with atomics.
+  */
+  uint64_t              *hdr_counts;
+  /*
+    Values of hdr_counts elements as of the last merge into cumulative_array.
+    Protected by 'lock'.
+  */
+  uint64_t              *hdr_merged;
+  /* Number of per-thread arrays in hdr_counts */
+  size_t                hdr_nthreads;
+  /* Distance between per-thread arrays (cache line aligned) */
+  size_t                hdr_stride;
+  /* log2 of half the number of sub-buckets in each HDR bucket */
+  unsigned int          hdr_sub_half_mag;
+  /* Mask to find the bucket of a value */
+  uint64_t              hdr_sub_mask;
+  /* Highest trackable value in units of range_min */
+  uint64_t              hdr_highest;
+  /*
+    Dirty bitmaps of HDR per-thread arrays, so that intermediate merges only
+    scan chunks updated since the previous merge instead of all arrays. For
+    each thread ID there are 'hdr_dirty_stride' words: a summary word with
+    one bit for each of the following chunk words, and chunk words with one
+    bit for each chunk of (1 << hdr_chunk_shift) array elements.
+  */
+  uint64_t              *hdr_dirty;
+  /* Distance between per-thread dirty bitmaps (cache line aligned) */
+  size_t                hdr_dirty_stride;
+  /* log2 of the number of array elements in a dirty chunk */
+  unsigned int          hdr_chunk_shift;
+  /*
+    Groups of 64 thread IDs with a bit set for each thread that has a
+    non-empty summary word, so idle threads cost nothing to merge.
+  */
+  uint64_t              *hdr_dirty_groups;
   /*
      rwlock to protect cumulative_array and cumulative_nevents from concurrent
      updates.
@@ -66,6 +128,23 @@ typedef struct {
 /* Global latency histogram */
 extern sb_histogram_t sb_latency_histogram;
 
+/*
+  Global histogram of latencies measured from the intended event start time
+  (used with --rate and --intended-latency)
+*/
+extern sb_histogram_t sb_intended_latency_histogram;
+
+/*
+  Global histogram of cycle times, i.e. event latencies plus the following
+  think times (used with --think-time)
+*/
+extern sb_histogram_t sb_cycle_time_histogram;
+
+/*
+  Global histogram of the time events waited to be started (used with --rate)
+*/
+extern sb_histogram_t sb_queue_wait_histogram;
+
 typedef struct {
   uint64_t *array;
   uint64_t nevents;
@@ -74,6 +153,9 @@ typedef struct {
 
   double range_deduct;
   double range_mult;
+
+  /* Histogram the snapshot was captured from */
+  const sb_histogram_t *histogram;
 } sb_histogram_snapshot_t;
 
 /*
@@ -83,7 +165,14 @@ sb_histogram_t *sb_histogram_new(size_t size, double range_min,
                                  double range_max);
 
 /*
-  Deallocate a histogram allocated with sb_histogram_new().
+  Allocate a new histogram and initialize it with sb_histogram_init_hdr().
+*/
+sb_histogram_t *sb_histogram_new_hdr(double range_min, double range_max,
+                                     unsigned int digits);
+
+/*
+  Deallocate a histogram allocated with sb_histogram_new() or
+  sb_histogram_new_hdr().
 */
 void sb_histogram_delete(sb_histogram_t *h);
 
@@ -93,9 +182,24 @@ void sb_histogram_delete(sb_histogram_t *h);
 int sb_histogram_init(sb_histogram_t *h, size_t size,
                       double range_min, double range_max);
 
+/*
+  Initialize a new HDR histogram object tracking values between range_min and
+  range_max with a given number of significant decimal digits (1-5). Values are
+  tracked in units of range_min, i.e. range_min is the lowest discernible value.
+*/
+int sb_histogram_init_hdr(sb_histogram_t *h, double range_min,
+                          double range_max, unsigned int digits);
+
 /* Update histogram with a given value. */
 void sb_histogram_update(sb_histogram_t *h, double value);
 
+/*
+  Add a given number of events to a given histogram array element, e.g. to
+  merge a histogram received from another sysbench instance using the same
+  histogram settings. Thread-safe.
+*/
+void sb_histogram_add(sb_histogram_t *h, size_t i, uint64_t count);
+
 /* Calculate given percentile values from a given histogram snapshopt */
 double *sb_histogram_snapshot_get_pct(sb_histogram_snapshot_t *snapshot, double *percentiles, size_t npercentiles);
 
@@ -116,6 +220,13 @@ double *sb_histogram_get_pct_intermediate(sb_histogram_t *h, double *percentiles
 */
 double *sb_histogram_get_pct_cumulative(sb_histogram_t *h, double *percentiles, size_t npercentiles);
 
+/*
+  Capture a snapshot of all values recorded since the last checkpoint and reset
+  cumulative stats, like sb_histogram_get_pct_checkpoint(). The snapshot owns
+  its array and is deallocated with free().
+*/
+sb_histogram_snapshot_t *sb_histogram_snapshot_checkpoint(sb_histogram_t *h);
+
 /*
    Similar to sb_histogram_get_pct_cumulative(), but also resets cumulative
    stats right after calculating the returned percentile. The reset happens
@@ -124,6 +235,25 @@ double *sb_histogram_get_pct_cumulative(sb_histogram_t *h, double *percentiles,
 */
 double *sb_histogram_get_pct_checkpoint(sb_histogram_t *h, double *percentiles, size_t npercentiles);
 
+/*
+  Calculate a single percentile value from all values recorded in a given
+  histogram so far. Unlike other sb_histogram_get_pct_*() functions, the result
+  is in the same units as values passed to sb_histogram_update().
+*/
+double sb_histogram_get_pct_value(sb_histogram_t *h, double percentile);
+
+/*
+  Store the number of events in each array element recorded since the
+  histogram was initialized into a given array of array_size elements, and
+  return the total number of events. Unlike other functions, this does not
+  merge intermediate values, so it does not affect intermediate or
+  checkpoint statistics and can be called at any time.
+*/
+uint64_t sb_histogram_get_counts(sb_histogram_t *h, uint64_t *array);
+
+/* Return the lower bound of values in a given histogram array element */
+double sb_histogram_get_value(const sb_histogram_t *h, size_t i);
+
 /*
   Print a given histogram to stdout
 */
@@ -0,0 +1,135 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Latency histogram log. Each intermediate and checkpoint report appends the
+  full latency histogram the percentiles were calculated from to a file with
+  one JSON object per line. The first line describes the histogram, every
+  following one lists the non-empty buckets of one report as [lower bound in
+  ms, count] pairs. Percentiles over any set of intervals, or over histograms
+  of several sysbench processes using the same histogram options, can then be
+  calculated by adding up the counts of equal buckets.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdio.h>
+# include <stdlib.h>
+# include <inttypes.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+#include "sb_histogram_log.h"
+#include "sb_logger.h"
+#include "sb_options.h"
+
+#define HISTOGRAM_LOG_FORMAT  "sysbench-histogram"
+#define HISTOGRAM_LOG_VERSION 1
+
+static const char      *log_path;
+static FILE            *log_file;
+static bool            header_written;
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+int sb_histogram_log_init(void)
+{
+  log_path = sb_get_value_string("histogram-log");
+
+  if (log_path == NULL)
+    return 0;
+
+  log_file = fopen(log_path, "w");
+  if (log_file == NULL)
+  {
+    log_errno(LOG_FATAL, "Cannot open --histogram-log '%s'", log_path);
+    return 1;
+  }
+
+  return 0;
+}
+
+
+bool sb_histogram_log_enabled(void)
+{
+  return log_file != NULL;
+}
+
+
+static void write_header(const sb_histogram_t *h)
+{
+  fprintf(log_file, "{\"format\":\"%s\",\"version\":%d,\"type\":\"%s\","
+          "\"size\":%zu,\"range_min_ms\":%g,\"range_max_ms\":%g}\n",
+          HISTOGRAM_LOG_FORMAT, HISTOGRAM_LOG_VERSION,
+          h->type == SB_HISTOGRAM_HDR ? "hdr" : "log", h->array_size,
+          h->range_min, h->range_max);
+}
+
+
+void sb_histogram_log_write(const char *report, double time, double interval,
+                            const sb_histogram_snapshot_t *snapshot)
+{
+  const sb_histogram_t * const h = snapshot->histogram;
+  bool                         first = true;
+
+  pthread_mutex_lock(&log_mutex);
+
+  if (!header_written)
+  {
+    write_header(h);
+    header_written = true;
+  }
+
+  fprintf(log_file, "{\"report\":\"%s\",\"time\":%.4f,\"interval\":%.4f,"
+          "\"events\":%" PRIu64 ",\"buckets\":[", report, time, interval,
+          snapshot->nevents);
+
+  for (size_t i = 0; i < snapshot->size; i++)
+  {
+    if (snapshot->array[i] == 0)
+      continue;
+
+    fprintf(log_file, "%s[%.9g,%" PRIu64 "]", first ? "" : ",",
+            sb_histogram_get_value(h, i), snapshot->array[i]);
+    first = false;
+  }
+
+  fprintf(log_file, "]}\n");
+
+  /* Make each report available to tools following the file */
+  fflush(log_file);
+
+  pthread_mutex_unlock(&log_mutex);
+}
+
+
+void sb_histogram_log_done(void)
+{
+  if (log_file == NULL)
+    return;
+
+  if (fclose(log_file) != 0)
+    log_errno(LOG_FATAL, "Writing --histogram-log '%s' failed", log_path);
+
+  log_file = NULL;
+}
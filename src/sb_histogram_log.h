@@ -0,0 +1,48 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Latency histogram log for each report, see --histogram-log */
+
+#ifndef SB_HISTOGRAM_LOG_H
+#define SB_HISTOGRAM_LOG_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+
+#include "sb_histogram.h"
+
+/* Open the --histogram-log file. Returns 0 on success. */
+int sb_histogram_log_init(void);
+
+/* Return true if the histogram log is enabled */
+bool sb_histogram_log_enabled(void);
+
+/*
+  Log the histogram snapshot of a report. report is either "interval" or
+  "checkpoint", time is the time since the benchmark start and interval is the
+  time covered by the snapshot, both in seconds. Thread-safe.
+*/
+void sb_histogram_log_write(const char *report, double time, double interval,
+                            const sb_histogram_snapshot_t *snapshot);
+
+void sb_histogram_log_done(void);
+
+#endif /* SB_HISTOGRAM_LOG_H */
@@ -0,0 +1,379 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Raw per-event latency log. Worker threads put a fixed-size record for each
+  timed event into their own single-producer/single-consumer ring buffer, and
+  a background thread drains all rings in batches to a binary file. Workers
+  never block on the writer: records are dropped and counted when a ring is
+  full. The file is a header followed by records in host byte order, which
+  --latency-log-csv converts to CSV.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdio.h>
+# include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+#include "sb_latency_log.h"
+#include "sysbench.h"
+#include "sb_ck_pr.h"
+#include "sb_logger.h"
+#include "sb_options.h"
+#include "sb_thread.h"
+#include "sb_timer.h"
+#include "sb_util.h"
+
+#define LATENCY_LOG_MAGIC   "SBLATLOG"
+#define LATENCY_LOG_VERSION 1
+
+/* Records per worker thread ring, must be a power of 2 */
+#define LATENCY_LOG_RING_SIZE 16384
+
+/* Time the writer sleeps when all rings are empty */
+#define LATENCY_LOG_POLL_US 10000
+
+/* Size of the output stream buffer */
+#define LATENCY_LOG_IOBUF_SIZE (1024 * 1024)
+
+typedef struct
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t start_ns;    /* wall clock time of the first run start */
+} latency_log_header_t;
+
+typedef struct
+{
+  uint64_t time_ns;     /* wall clock time the event completed */
+  uint64_t latency_ns;
+  uint64_t queue_ns;
+  uint32_t thread;
+  uint32_t type;
+} latency_log_record_t;
+
+typedef struct
+{
+  /* Written by the worker thread */
+  latency_log_record_t *buf;
+  uint64_t             head;
+  uint64_t             dropped;
+  uint32_t             type;
+  char                 pad1[SB_CACHELINE_PAD(sizeof(void *) +
+                                             sizeof(uint64_t) * 2 +
+                                             sizeof(uint32_t))];
+  /* Written by the writer thread */
+  uint64_t             tail;
+  char                 pad2[SB_CACHELINE_PAD(sizeof(uint64_t))];
+} latency_log_ring_t;
+
+static FILE               *log_file;
+static char               *iobuf;
+static latency_log_ring_t *rings;
+static unsigned int       nrings;
+
+/* Wall clock time corresponding to the start of sb_exec_timer */
+static uint64_t           base_ns;
+static bool               header_written;
+
+static pthread_t          writer_thread;
+static bool               writer_thread_created;
+static int                writer_stop;
+
+
+static uint64_t realtime_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  return SEC2NS(ts.tv_sec) + ts.tv_nsec;
+}
+
+
+int sb_latency_log_init(void)
+{
+  const char *path = sb_get_value_string("latency-log");
+
+  if (path == NULL)
+    return 0;
+
+  log_file = fopen(path, "wb");
+  if (log_file == NULL)
+  {
+    log_errno(LOG_FATAL, "Cannot open --latency-log '%s'", path);
+    return 1;
+  }
+
+  iobuf = malloc(LATENCY_LOG_IOBUF_SIZE);
+  if (iobuf != NULL)
+    setvbuf(log_file, iobuf, _IOFBF, LATENCY_LOG_IOBUF_SIZE);
+
+  rings = sb_alloc_per_thread_array(sizeof(latency_log_ring_t));
+  if (rings == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  for (; nrings < sb_globals.threads; nrings++)
+  {
+    rings[nrings].buf = malloc(LATENCY_LOG_RING_SIZE *
+                               sizeof(latency_log_record_t));
+    if (rings[nrings].buf == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+bool sb_latency_log_enabled(void)
+{
+  return log_file != NULL;
+}
+
+
+void sb_latency_log_event(int thread_id, uint64_t end_ns, uint64_t latency_ns,
+                          uint64_t queue_ns)
+{
+  latency_log_ring_t *r = &rings[thread_id];
+  const uint64_t     head = r->head;
+
+  if (SB_UNLIKELY(head - ck_pr_load_64(&r->tail) >= LATENCY_LOG_RING_SIZE))
+  {
+    ck_pr_store_64(&r->dropped, r->dropped + 1);
+    return;
+  }
+
+  latency_log_record_t *rec = &r->buf[head & (LATENCY_LOG_RING_SIZE - 1)];
+
+  rec->time_ns = base_ns + end_ns;
+  rec->latency_ns = latency_ns;
+  rec->queue_ns = queue_ns;
+  rec->thread = (uint32_t) thread_id;
+  rec->type = r->type;
+
+  /* Publish the record after it is completely written */
+  ck_pr_fence_store();
+  ck_pr_store_64(&r->head, head + 1);
+}
+
+
+void sb_latency_log_set_type(int thread_id, unsigned int type)
+{
+  if (rings != NULL)
+    rings[thread_id].type = type;
+}
+
+
+/* Write all records buffered in rings, return the number of written records */
+
+static uint64_t drain(void)
+{
+  uint64_t total = 0;
+
+  for (unsigned int i = 0; i < nrings; i++)
+  {
+    latency_log_ring_t *r = &rings[i];
+    const uint64_t     head = ck_pr_load_64(&r->head);
+    uint64_t           tail = r->tail;
+
+    ck_pr_fence_load();
+
+    while (tail < head)
+    {
+      const uint64_t idx = tail & (LATENCY_LOG_RING_SIZE - 1);
+      const uint64_t n = SB_MIN(head - tail, LATENCY_LOG_RING_SIZE - idx);
+
+      fwrite(&r->buf[idx], sizeof(latency_log_record_t), n, log_file);
+      tail += n;
+      total += n;
+    }
+
+    /* Release the slots only after records have been copied out */
+    ck_pr_store_64(&r->tail, tail);
+  }
+
+  return total;
+}
+
+
+static void *writer_thread_proc(void *arg)
+{
+  (void) arg; /* unused */
+
+  sb_tls_thread_id = sb_globals.threads;
+
+  log_text(LOG_DEBUG, "Latency log writer thread started");
+
+  while (!ck_pr_load_int(&writer_stop))
+  {
+    if (drain() == 0)
+      usleep(LATENCY_LOG_POLL_US);
+  }
+
+  /* Worker threads have exited, write whatever they left */
+  drain();
+
+  return NULL;
+}
+
+
+int sb_latency_log_start(void)
+{
+  if (log_file == NULL)
+    return 0;
+
+  base_ns = realtime_ns() - sb_timer_value(&sb_exec_timer);
+
+  if (!header_written)
+  {
+    latency_log_header_t hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, LATENCY_LOG_MAGIC, sizeof(hdr.magic));
+    hdr.version = LATENCY_LOG_VERSION;
+    hdr.record_size = sizeof(latency_log_record_t);
+    hdr.start_ns = base_ns;
+
+    fwrite(&hdr, sizeof(hdr), 1, log_file);
+    header_written = true;
+  }
+
+  ck_pr_store_int(&writer_stop, 0);
+
+  if (sb_thread_create(&writer_thread, &sb_thread_attr, &writer_thread_proc,
+                       NULL) != 0)
+  {
+    log_errno(LOG_FATAL,
+              "sb_thread_create() for the latency log writer thread failed.");
+    return 1;
+  }
+
+  writer_thread_created = true;
+
+  return 0;
+}
+
+
+void sb_latency_log_stop(void)
+{
+  if (!writer_thread_created)
+    return;
+
+  ck_pr_store_int(&writer_stop, 1);
+
+  if (sb_thread_join(writer_thread, NULL))
+    log_errno(LOG_FATAL, "Terminating the latency log writer thread failed.");
+
+  writer_thread_created = false;
+
+  uint64_t dropped = 0;
+
+  for (unsigned int i = 0; i < nrings; i++)
+    dropped += ck_pr_fas_64(&rings[i].dropped, 0);
+
+  if (dropped > 0)
+    log_text(LOG_WARNING, "%" PRIu64 " --latency-log records were dropped "
+             "because the writer could not keep up", dropped);
+
+  if (fflush(log_file) != 0 || ferror(log_file))
+    log_errno(LOG_WARNING, "Writing --latency-log '%s' failed",
+              sb_get_value_string("latency-log"));
+}
+
+
+int sb_latency_log_to_csv(const char *path)
+{
+  latency_log_header_t hdr;
+  latency_log_record_t rec;
+  FILE                 *f = fopen(path, "rb");
+
+  if (f == NULL)
+  {
+    log_errno(LOG_FATAL, "Cannot open --latency-log-csv '%s'", path);
+    return 1;
+  }
+
+  if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+      memcmp(hdr.magic, LATENCY_LOG_MAGIC, sizeof(hdr.magic)) ||
+      hdr.version != LATENCY_LOG_VERSION ||
+      hdr.record_size != sizeof(latency_log_record_t))
+  {
+    log_text(LOG_FATAL, "'%s' is not a latency log written by this version "
+             "of sysbench", path);
+    fclose(f);
+    return 1;
+  }
+
+  printf("time,timestamp,thread,type,latency_ms,queue_ms\n");
+
+  while (fread(&rec, sizeof(rec), 1, f) == 1)
+    printf("%.6f,%.6f,%" PRIu32 ",%" PRIu32 ",%.6f,%.6f\n",
+           NS2SEC(rec.time_ns - hdr.start_ns), NS2SEC(rec.time_ns),
+           rec.thread, rec.type, NS2MS(rec.latency_ns), NS2MS(rec.queue_ns));
+
+  const int rc = ferror(f) != 0;
+
+  if (rc)
+    log_errno(LOG_FATAL, "Reading '%s' failed", path);
+
+  fclose(f);
+
+  return rc;
+}
+
+
+void sb_latency_log_done(void)
+{
+  sb_latency_log_stop();
+
+  for (unsigned int i = 0; i < nrings; i++)
+    free(rings[i].buf);
+
+  free(rings);
+  rings = NULL;
+  nrings = 0;
+
+  if (log_file != NULL)
+  {
+    fclose(log_file);
+    log_file = NULL;
+  }
+
+  free(iobuf);
+  iobuf = NULL;
+}
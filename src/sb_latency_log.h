@@ -0,0 +1,74 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Raw per-event latency log, see --latency-log */
+
+#ifndef SB_LATENCY_LOG_H
+#define SB_LATENCY_LOG_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <inttypes.h>
+#endif
+
+#include <stdbool.h>
+
+/*
+  Open the --latency-log file and allocate ring buffers for sb_globals.threads
+  worker threads. Returns 0 on success.
+*/
+int sb_latency_log_init(void);
+
+/* Return true if the latency log is enabled */
+bool sb_latency_log_enabled(void);
+
+/*
+  Start the writer thread. Must be called right after sb_exec_timer is
+  started and before worker threads execute events. Returns 0 on success.
+*/
+int sb_latency_log_start(void);
+
+/*
+  Stop the writer thread after writing all buffered records. Must be called
+  after worker threads have exited.
+*/
+void sb_latency_log_stop(void);
+
+/*
+  Log an event completed by a worker thread. end_ns is the completion time
+  relative to sb_exec_timer, latency_ns is the accounted latency and queue_ns
+  is the part of it the event spent waiting to be started in the --rate mode.
+*/
+void sb_latency_log_event(int thread_id, uint64_t end_ns, uint64_t latency_ns,
+                          uint64_t queue_ns);
+
+/*
+  Set the type logged for subsequent events of a worker thread. Exported to
+  Lua scripts via FFI.
+*/
+void sb_latency_log_set_type(int thread_id, unsigned int type);
+
+/* Convert a latency log file to CSV written to stdout. Returns 0 on success. */
+int sb_latency_log_to_csv(const char *path);
+
+void sb_latency_log_done(void);
+
+#endif /* SB_LATENCY_LOG_H */
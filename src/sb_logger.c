@@ -22,7 +22,9 @@
 
 #ifdef STDC_HEADERS
 # include <stdio.h>
+# include <stdlib.h>
 # include <stdarg.h>
+# include <inttypes.h>
 # include <string.h>
 #endif
 #ifdef HAVE_ERRNO_H
@@ -36,15 +38,18 @@
 #include "sb_list.h"
 #include "sb_logger.h"
 #include "sb_histogram.h"
+#include "sb_thread.h"
 
 #include "ck_cc.h"
+#include "ck_pr.h"
 
 #define TEXT_BUFFER_SIZE 4096
 #define ERROR_BUFFER_SIZE 256
 
 /*
-   Use 1024-element array for latency histogram tracking values between 0.001
-   milliseconds and 100 seconds.
+   By default, use 1024-element array for latency histogram tracking values
+   between 0.001 milliseconds and 100 seconds. Can be changed with
+   --histogram-buckets and --histogram-range.
 */
 #define OPER_LOG_GRANULARITY 1024
 #define OPER_LOG_MIN_VALUE   1e-3
@@ -58,12 +63,76 @@ static sb_list_t handlers[LOG_MSG_TYPE_MAX];
 static unsigned char initialized; 
 
 static pthread_mutex_t text_mutex;
+
+/* Latency histogram settings, see --histogram-range and --histogram-buckets */
+static double oper_range_min = OPER_LOG_MIN_VALUE;
+static double oper_range_max = OPER_LOG_MAX_VALUE;
+static size_t oper_granularity = OPER_LOG_GRANULARITY;
 static unsigned int    text_cnt;
 static char            text_buf[TEXT_BUFFER_SIZE];
 
+/*
+  Asynchronous text messages, see --log-async. Each worker thread appends its
+  messages to a private single-producer/single-consumer ring, so it never
+  waits for text_mutex or the output. A background thread drains all rings
+  and prints each distinct message once per aggregation window, followed by
+  the number of repetitions at the end of the window.
+*/
+#define LOG_RING_SIZE 64              /* Messages per thread, a power of 2 */
+#define LOG_RING_MSG_SIZE 512         /* Longer messages are truncated */
+#define LOG_ASYNC_DRAIN_MS 100        /* Ring polling interval */
+#define LOG_ASYNC_WINDOW_MS 1000      /* Aggregation window */
+#define LOG_ASYNC_MAX_DISTINCT 64     /* Distinct messages printed per window */
+
+typedef struct
+{
+  log_msg_priority_t priority;
+  unsigned int       flags;
+  uint64_t           repeats;     /* Identical messages following this one */
+  char               text[LOG_RING_MSG_SIZE];
+} log_ring_msg_t;
+
+typedef struct log_ring
+{
+  uint64_t        head;           /* Updated by the owner thread only */
+  uint64_t        dropped;        /* Messages lost because of a full ring */
+  char            pad[SB_CACHELINE_PAD(sizeof(uint64_t) * 2)];
+  uint64_t        tail;           /* Updated by the drain thread only */
+  struct log_ring *next;
+  log_ring_msg_t  msgs[LOG_RING_SIZE];
+} log_ring_t;
+
+/* A distinct message printed in the current aggregation window */
+typedef struct
+{
+  log_msg_priority_t priority;
+  uint64_t           repeats;
+  char               text[LOG_RING_MSG_SIZE];
+} log_agg_t;
+
+static struct
+{
+  bool            enabled;
+  bool            started;
+  bool            stop;
+  pthread_t       thread;
+  pthread_mutex_t mutex;          /* Protects the list of rings and 'stop' */
+  pthread_cond_t  cond;
+  log_ring_t      *rings;
+  uint64_t        window_start;   /* Start of the aggregation window, ns */
+  log_agg_t       agg[LOG_ASYNC_MAX_DISTINCT];
+  unsigned int    nagg;
+  uint64_t        suppressed;     /* Messages over LOG_ASYNC_MAX_DISTINCT */
+} log_async;
+
+/* Set by log_thread_init() in threads using asynchronous messages */
+static TLS bool       log_tls_async;
+static TLS log_ring_t *log_tls_ring;
+
 
 static int text_handler_init(void);
 static int text_handler_process(log_msg_t *msg);
+static int text_handler_done(void);
 
 static int oper_handler_init(void);
 static int oper_handler_done(void);
@@ -76,6 +145,11 @@ static sb_arg_t text_handler_args[] =
 {
   SB_OPT("verbosity", "verbosity level {5 - debug, 0 - only critical messages}",
          "3", INT),
+  SB_OPT("log-async", "print messages of worker threads from a background "
+         "thread instead of serializing workers on the output. Repeated "
+         "messages are printed once per second along with the number of "
+         "repetitions. Useful with --db-debug, --debug or frequent errors",
+         "off", BOOL),
 
   SB_OPT_END
 };
@@ -84,7 +158,7 @@ static log_handler_t text_handler = {
   {
     &text_handler_init,
     &text_handler_process,
-    NULL,
+    &text_handler_done,
   },
   text_handler_args,
   {0,0}
@@ -98,6 +172,17 @@ static sb_arg_t oper_handler_args[] =
          "Use an empty list to disable percentile calculations",
          "95", LIST),
   SB_OPT("histogram", "print latency histogram in report", "off", BOOL),
+  SB_OPT("histogram-type", "latency histogram implementation {log, hdr}. "
+         "'hdr' uses per-thread log-linear histograms which are cheaper to "
+         "update and more precise for high percentiles", "log", STRING),
+  SB_OPT("histogram-digits", "number of significant decimal digits to "
+         "maintain in 'hdr' latency histograms (1-5)", "3", INT),
+  SB_OPT("histogram-range", "range of latencies in milliseconds tracked by "
+         "latency histograms as MIN,MAX. Lower and higher latencies are "
+         "counted as MIN and MAX, respectively", "0.001,100000", LIST),
+  SB_OPT("histogram-buckets", "number of buckets in 'log' latency "
+         "histograms, spaced evenly on a log scale over --histogram-range",
+         "1024", INT),
 
   SB_OPT_END
 };
@@ -304,6 +389,17 @@ void log_text(log_msg_priority_t priority, const char *fmt, ...)
 }
 
 
+int log_timestamp_precision(void)
+{
+  const unsigned int interval = sb_globals.report_interval;
+
+  if (interval % 1000 == 0)
+    return 0;
+
+  return interval % 100 == 0 ? 1 : interval % 10 == 0 ? 2 : 3;
+}
+
+
 /*
   variant of log_text() which prepends log lines with the elapsed time of a
   specified timer.
@@ -322,7 +418,7 @@ void log_timestamp(log_msg_priority_t priority, double seconds,
   maxlen = TEXT_BUFFER_SIZE;
   clen = 0;
 
-  n = snprintf(buf, maxlen, "[ %.0fs ] ", seconds);
+  n = snprintf(buf, maxlen, "[ %.*fs ] ", log_timestamp_precision(), seconds);
   clen += n;
   maxlen -= n;
 
@@ -395,6 +491,257 @@ void log_errno(log_msg_priority_t priority, const char *fmt, ...)
 
 
 
+/* Current time in nanoseconds for aggregation windows */
+
+static uint64_t log_async_clock(void)
+{
+  struct timespec ts;
+
+  SB_GETTIME(&ts);
+
+  return SEC2NS(ts.tv_sec) + ts.tv_nsec;
+}
+
+
+/*
+  Print repetition counts of messages in the current aggregation window and
+  start a new one. Called by the drain thread with log_async.mutex locked.
+*/
+
+static void log_async_flush_window(uint64_t now)
+{
+  const double seconds = NS2SEC((double) (now - log_async.window_start));
+  uint64_t     dropped = 0;
+
+  for (unsigned int i = 0; i < log_async.nagg; i++)
+  {
+    log_agg_t *agg = &log_async.agg[i];
+
+    if (agg->repeats > 0)
+      printf("%s%s (repeated %" PRIu64 " times in the last %.2fs)\n",
+             get_msg_prefix(agg->priority), agg->text, agg->repeats, seconds);
+  }
+
+  if (log_async.suppressed > 0)
+    printf("(%" PRIu64 " more messages suppressed in the last %.2fs)\n",
+           log_async.suppressed, seconds);
+
+  for (log_ring_t *ring = log_async.rings; ring != NULL; ring = ring->next)
+    dropped += ck_pr_fas_64(&ring->dropped, 0);
+
+  if (dropped > 0)
+    printf("%s%" PRIu64 " messages lost because of full log buffers\n",
+           get_msg_prefix(LOG_WARNING), dropped);
+
+  log_async.nagg = 0;
+  log_async.suppressed = 0;
+  log_async.window_start = now;
+}
+
+
+/*
+  Print a message taken from a ring, or count it and 'repeats' identical
+  messages collapsed by the producer in the current aggregation window. With
+  'print' set to false, only accounts repeats of an already printed message.
+*/
+
+static void log_async_print(log_ring_msg_t *msg, uint64_t repeats, bool print)
+{
+  log_agg_t *agg;
+
+  if (msg->flags & LOG_MSG_TEXT_ALLOW_DUPLICATES)
+  {
+    printf("%s%s\n", get_msg_prefix(msg->priority), msg->text);
+    return;
+  }
+
+  for (unsigned int i = 0; i < log_async.nagg; i++)
+  {
+    agg = &log_async.agg[i];
+
+    if (agg->priority == msg->priority && !strcmp(agg->text, msg->text))
+    {
+      agg->repeats += repeats + print;
+      return;
+    }
+  }
+
+  if (log_async.nagg == LOG_ASYNC_MAX_DISTINCT)
+  {
+    log_async.suppressed += repeats + print;
+    return;
+  }
+
+  agg = &log_async.agg[log_async.nagg++];
+
+  agg->priority = msg->priority;
+  agg->repeats = repeats;
+  strcpy(agg->text, msg->text);
+
+  if (print)
+    printf("%s%s\n", get_msg_prefix(msg->priority), msg->text);
+}
+
+
+/* Print all queued messages. Called with log_async.mutex locked. */
+
+static void log_async_drain(void)
+{
+  for (log_ring_t *ring = log_async.rings; ring != NULL; ring = ring->next)
+  {
+    const uint64_t head = ck_pr_load_64(&ring->head);
+    uint64_t       tail = ring->tail;
+
+    /* Read messages only after they have been fully written */
+    ck_pr_fence_load();
+
+    /*
+      The last message printed in the previous pass may have been repeated
+      since then. Its slot is not reused until the next one is consumed.
+    */
+    if (tail > 0)
+    {
+      log_ring_msg_t *msg = &ring->msgs[(tail - 1) % LOG_RING_SIZE];
+      const uint64_t repeats = ck_pr_fas_64(&msg->repeats, 0);
+
+      if (repeats > 0)
+        log_async_print(msg, repeats, false);
+    }
+
+    for (; tail != head; tail++)
+    {
+      log_ring_msg_t *msg = &ring->msgs[tail % LOG_RING_SIZE];
+
+      log_async_print(msg, ck_pr_fas_64(&msg->repeats, 0), true);
+    }
+
+    ck_pr_fence_store();
+    ck_pr_store_64(&ring->tail, head);
+  }
+}
+
+
+/* Background thread printing asynchronous messages */
+
+static void *log_async_thread_proc(void *arg)
+{
+  struct timespec deadline;
+  uint64_t        ns;
+
+  (void) arg; /* unused */
+
+  pthread_mutex_lock(&log_async.mutex);
+
+  while (!log_async.stop)
+  {
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    ns = deadline.tv_nsec + MS2NS(LOG_ASYNC_DRAIN_MS);
+    deadline.tv_sec += ns / NS_PER_SEC;
+    deadline.tv_nsec = ns % NS_PER_SEC;
+
+    pthread_cond_timedwait(&log_async.cond, &log_async.mutex, &deadline);
+
+    log_async_drain();
+
+    const uint64_t now = log_async_clock();
+    if (now - log_async.window_start >= MS2NS(LOG_ASYNC_WINDOW_MS))
+      log_async_flush_window(now);
+  }
+
+  /* Print whatever has been queued before the shutdown */
+  log_async_drain();
+  log_async_flush_window(log_async_clock());
+
+  pthread_mutex_unlock(&log_async.mutex);
+
+  return NULL;
+}
+
+
+/*
+  Queue a text message in the ring of the current thread. A message identical
+  to the previous one of the same thread only increments its repeat counter.
+  Returns 1 if the message must be printed synchronously instead.
+*/
+
+static int log_async_push(log_msg_text_t *text_msg)
+{
+  log_ring_t *ring = log_tls_ring;
+  size_t     len;
+
+  if (ring == NULL)
+  {
+    ring = calloc(1, sizeof(log_ring_t));
+    if (ring == NULL)
+      return 1;
+
+    pthread_mutex_lock(&log_async.mutex);
+    ring->next = log_async.rings;
+    log_async.rings = ring;
+    pthread_mutex_unlock(&log_async.mutex);
+
+    log_tls_ring = ring;
+  }
+
+  /* Drop the trailing newline added by log_text() */
+  len = strlen(text_msg->text);
+  if (len > 0 && text_msg->text[len - 1] == '\n')
+    len--;
+  if (len >= LOG_RING_MSG_SIZE)
+    len = LOG_RING_MSG_SIZE - 1;
+
+  const uint64_t head = ring->head;
+
+  if (head > 0 && !(text_msg->flags & LOG_MSG_TEXT_ALLOW_DUPLICATES))
+  {
+    /* Only this thread writes to its slots, no need for synchronization */
+    log_ring_msg_t *last = &ring->msgs[(head - 1) % LOG_RING_SIZE];
+
+    if (last->priority == text_msg->priority &&
+        !strncmp(last->text, text_msg->text, len) && last->text[len] == '\0')
+    {
+      ck_pr_inc_64(&last->repeats);
+      return 0;
+    }
+  }
+
+  /* Keep the last consumed slot intact, see log_async_drain() */
+  if (head - ck_pr_load_64(&ring->tail) >= LOG_RING_SIZE - 1)
+  {
+    ck_pr_inc_64(&ring->dropped);
+    return 0;
+  }
+
+  /* Do not overwrite the slot until the drain thread is done with it */
+  ck_pr_fence_load();
+
+  log_ring_msg_t *msg = &ring->msgs[head % LOG_RING_SIZE];
+
+  msg->priority = text_msg->priority;
+  msg->flags = text_msg->flags;
+  memcpy(msg->text, text_msg->text, len);
+  msg->text[len] = '\0';
+  ck_pr_store_64(&msg->repeats, 0);
+
+  ck_pr_fence_store();
+  ck_pr_store_64(&ring->head, head + 1);
+
+  return 0;
+}
+
+
+/*
+  Route text messages of the calling thread through --log-async buffers.
+  Called by worker threads, messages of other threads are always printed
+  synchronously to keep them in order with reports.
+*/
+
+void log_thread_init(void)
+{
+  log_tls_async = log_async.started;
+}
+
+
 /* Initialize text handler */
 
 
@@ -416,7 +763,55 @@ int text_handler_init(void)
   pthread_mutex_init(&text_mutex, NULL);
   text_cnt = 0;
   text_buf[0] = '\0';
-  
+
+  log_async.enabled = sb_get_value_flag("log-async");
+
+  if (log_async.enabled)
+  {
+    pthread_mutex_init(&log_async.mutex, NULL);
+    pthread_cond_init(&log_async.cond, NULL);
+    log_async.window_start = log_async_clock();
+
+    if (sb_thread_create(&log_async.thread, NULL, log_async_thread_proc,
+                         NULL))
+    {
+      log_errno(LOG_FATAL, "sb_thread_create() failed");
+      return 1;
+    }
+    log_async.started = true;
+  }
+
+  return 0;
+}
+
+
+/* Stop the --log-async thread after printing all queued messages */
+
+int text_handler_done(void)
+{
+  if (!log_async.started)
+    return 0;
+
+  pthread_mutex_lock(&log_async.mutex);
+  log_async.stop = true;
+  pthread_cond_signal(&log_async.cond);
+  pthread_mutex_unlock(&log_async.mutex);
+
+  sb_thread_join(log_async.thread, NULL);
+
+  while (log_async.rings != NULL)
+  {
+    log_ring_t *next = log_async.rings->next;
+
+    free(log_async.rings);
+    log_async.rings = next;
+  }
+
+  pthread_mutex_destroy(&log_async.mutex);
+  pthread_cond_destroy(&log_async.cond);
+
+  memset(&log_async, 0, sizeof(log_async));
+
   return 0;
 }
 
@@ -431,6 +826,15 @@ int text_handler_process(log_msg_t *msg)
   if (text_msg->priority > sb_globals.verbosity)
     return 0;
 
+  /*
+    Fatal errors are printed right away, the process may exit shortly. Notices
+    are regular output, e.g. "Threads started!" printed by the last worker
+    thread passing the start barrier, and must stay in order.
+  */
+  if (log_tls_async && text_msg->priority != LOG_FATAL &&
+      text_msg->priority != LOG_NOTICE && !log_async_push(text_msg))
+    return 0;
+
   if (!(text_msg->flags & LOG_MSG_TEXT_ALLOW_DUPLICATES))
   {
     pthread_mutex_lock(&text_mutex);
@@ -461,6 +865,66 @@ int text_handler_process(log_msg_t *msg)
 /* Initialize operation messages handler */
 
 
+/* Parse --histogram-range and --histogram-buckets */
+
+static int oper_histogram_range_init(void)
+{
+  sb_list_t      *range = sb_get_value_list("histogram-range");
+  sb_list_item_t *pos;
+  double         bounds[2];
+  unsigned int   n = 0;
+  const int      buckets = sb_get_value_int("histogram-buckets");
+
+  SB_LIST_FOR_EACH(pos, range)
+  {
+    value_t *val = SB_LIST_ENTRY(pos, value_t, listitem);
+
+    if (n < 2)
+      bounds[n] = atof(val->data);
+    n++;
+  }
+
+  if (n != 2 || !(bounds[0] > 0) || !(bounds[1] > bounds[0]))
+  {
+    log_text(LOG_FATAL, "Invalid value for --histogram-range, expected "
+             "MIN,MAX with 0 < MIN < MAX");
+    return 1;
+  }
+
+  if (buckets < 2)
+  {
+    log_text(LOG_FATAL, "Invalid value for --histogram-buckets: %d", buckets);
+    return 1;
+  }
+
+  oper_range_min = bounds[0];
+  oper_range_max = bounds[1];
+  oper_granularity = (size_t) buckets;
+
+  return 0;
+}
+
+
+/* Initialize a latency histogram with the type specified by --histogram-type */
+
+int oper_histogram_init(sb_histogram_t *h)
+{
+  const char *type = sb_get_value_string("histogram-type");
+
+  if (type == NULL || !strcmp(type, "log"))
+    return sb_histogram_init(h, oper_granularity, oper_range_min,
+                             oper_range_max);
+
+  if (!strcmp(type, "hdr"))
+    return sb_histogram_init_hdr(h, oper_range_min, oper_range_max,
+                                 sb_get_value_int("histogram-digits"));
+
+  log_text(LOG_FATAL, "Invalid value for --histogram-type: %s", type);
+
+  return 1;
+}
+
+
 int oper_handler_init(void)
 {
   sb_list_t           *tmp;
@@ -498,8 +962,22 @@ int oper_handler_init(void)
     return 1;
   }
 
-  if (sb_histogram_init(&sb_latency_histogram, OPER_LOG_GRANULARITY,
-                        OPER_LOG_MIN_VALUE, OPER_LOG_MAX_VALUE))
+  if (oper_histogram_range_init())
+    return 1;
+
+  if (oper_histogram_init(&sb_latency_histogram))
+    return 1;
+
+  if (sb_globals.intended_latency &&
+      oper_histogram_init(&sb_intended_latency_histogram))
+    return 1;
+
+  if (sb_globals.think_time > 0 &&
+      oper_histogram_init(&sb_cycle_time_histogram))
+    return 1;
+
+  if (sb_globals.tx_rate > 0 &&
+      oper_histogram_init(&sb_queue_wait_histogram))
     return 1;
 
   return 0;
@@ -512,6 +990,15 @@ int oper_handler_done(void)
 {
   sb_histogram_done(&sb_latency_histogram);
 
+  if (sb_globals.intended_latency)
+    sb_histogram_done(&sb_intended_latency_histogram);
+
+  if (sb_globals.think_time > 0)
+    sb_histogram_done(&sb_cycle_time_histogram);
+
+  if (sb_globals.tx_rate > 0)
+    sb_histogram_done(&sb_queue_wait_histogram);
+
   return 0;
 }
 
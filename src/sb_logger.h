@@ -141,11 +141,32 @@ void log_timestamp(log_msg_priority_t priority, double seconds,
                    const char *fmt, ...)
   SB_ATTRIBUTE_FORMAT(printf, 3, 4);
 
+/*
+  Number of decimals in timestamps of log_timestamp(), enough to tell
+  sub-second --report-interval reports apart
+*/
+
+int log_timestamp_precision(void);
+
 /* printf-like wrapper to log system error messages */
 
 void log_errno(log_msg_priority_t priority, const char *fmt, ...)
   SB_ATTRIBUTE_FORMAT(printf, 2, 3);
 
+/*
+  Initialize a latency histogram with the type specified by --histogram-type,
+  for tests that keep their own histograms in addition to the global one.
+*/
+
+int oper_histogram_init(sb_histogram_t *h);
+
+/*
+  Print text messages of the calling worker thread asynchronously if
+  --log-async is enabled
+*/
+
+void log_thread_init(void);
+
 /* Uninitialize logger */
 
 void log_done(void);
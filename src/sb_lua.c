@@ -34,8 +34,12 @@
 #undef SB_LUA_EXPORT
 
 #include "db_driver.h"
+#include "db_waits.h"
 #include "sb_rand.h"
 #include "sb_thread.h"
+#include "sb_barrier.h"
+#include "sb_groups.h"
+#include "sb_user_stats.h"
 
 #include "sb_ck_pr.h"
 
@@ -48,6 +52,8 @@
 #include "lua/internal/sysbench.rand.lua.h"
 #include "lua/internal/sysbench.sql.lua.h"
 #include "lua/internal/sysbench.histogram.lua.h"
+#include "lua/internal/sysbench.shared.lua.h"
+#include "lua/internal/sysbench.file.lua.h"
 
 #define EVENT_FUNC "event"
 #define PREPARE_FUNC "prepare"
@@ -56,6 +62,10 @@
 #define THREAD_INIT_FUNC "thread_init"
 #define THREAD_DONE_FUNC "thread_done"
 #define THREAD_RUN_FUNC "thread_run"
+#define VUSERS_INIT_FUNC "vusers_init"
+#define VUSERS_DONE_FUNC "vusers_done"
+#define PROFILE_START_FUNC "profile_start"
+#define PROFILE_STOP_FUNC "profile_stop"
 #define INIT_FUNC "init"
 #define DONE_FUNC "done"
 #define REPORT_INTERMEDIATE_HOOK "report_intermediate"
@@ -79,6 +89,13 @@ typedef struct {
   char           is_null;
 } sb_lua_bind_t;
 
+/* Bytecode of a compiled script, see sb_lua_chunk_t */
+
+typedef struct {
+  char   *buf;
+  size_t len;
+} sb_lua_bytecode_t;
+
 typedef struct {
   const char *name;
   const unsigned char *source;
@@ -86,6 +103,18 @@ typedef struct {
   size_t *source_len;
 } internal_script_t;
 
+/*
+  Test and --thread-groups scripts compiled into bytecode when the global state
+  is created, so other states do not parse them again. The path is NULL for a
+  script read from the standard input.
+*/
+
+typedef struct sb_lua_chunk {
+  char                *path;
+  sb_lua_bytecode_t   bytecode;
+  struct sb_lua_chunk *next;
+} sb_lua_chunk_t;
+
 typedef enum {
   SB_LUA_ERROR_NONE,
   SB_LUA_ERROR_RESTART_EVENT
@@ -97,11 +126,22 @@ int sb_lua_set_test_args(sb_arg_t *, size_t);
 /* Lua interpreter states */
 
 static lua_State **states CK_CC_CACHELINE;
+static unsigned int nstates;
+
+/* Lua heap size of each state after thread_init(), see --worker-memory */
+static size_t *state_heap;
+
+/* Are states kept between runs? See sb_lua_keep_states() */
+static bool keep_states;
 
 static sb_test_t sbtest CK_CC_CACHELINE;
 
 static TLS sb_lua_ctxt_t tls_lua_ctxt CK_CC_CACHELINE;
 
+/* Synchronizes threads executing a parallel command, see sysbench.barrier() */
+static sb_barrier_t cmd_barrier;
+static bool         cmd_barrier_active;
+
 /* List of pre-loaded internal scripts */
 static internal_script_t internal_scripts[] = {
   {"sysbench.rand.lua", sysbench_rand_lua, &sysbench_rand_lua_len},
@@ -110,15 +150,59 @@ static internal_script_t internal_scripts[] = {
   {"sysbench.sql.lua", sysbench_sql_lua, &sysbench_sql_lua_len},
   {"sysbench.histogram.lua", sysbench_histogram_lua,
    &sysbench_histogram_lua_len},
+  {"sysbench.shared.lua", sysbench_shared_lua, &sysbench_shared_lua_len},
+  {"sysbench.file.lua", sysbench_file_lua, &sysbench_file_lua_len},
   {NULL, NULL, 0}
 };
 
+#define NINTERNAL_SCRIPTS \
+  (sizeof(internal_scripts) / sizeof(internal_scripts[0]))
+
+/* Bytecode of internal scripts, in the same order */
+static sb_lua_bytecode_t internal_bytecode[NINTERNAL_SCRIPTS];
+
+/*
+  Compiled scripts. Only populated while sb_load_lua() creates states from the
+  main thread, and read-only afterwards, so no locking is needed.
+*/
+static sb_lua_chunk_t *chunks;
+static bool           cache_chunks;
+
 /* Main (global) interpreter state */
 static lua_State *gstate;
 
 /* Custom command name */
 static const char * sb_lua_custom_command;
 
+/*
+  Counts collected by --lua-profile and --lua-trace-aborts, merged from all
+  states when they are closed. Kinds match PROFILE_* in sysbench.lua.
+*/
+
+typedef enum {
+  SB_LUA_PROFILE_FUNC,
+  SB_LUA_PROFILE_VMSTATE,
+  SB_LUA_PROFILE_ABORT,
+  SB_LUA_PROFILE_KINDS
+} sb_lua_profile_kind_t;
+
+typedef struct {
+  char     *key;
+  uint64_t count;
+} sb_lua_profile_entry_t;
+
+typedef struct {
+  sb_lua_profile_entry_t *entries;
+  size_t                 n;
+  uint64_t               total;
+} sb_lua_profile_t;
+
+static sb_lua_profile_t profile[SB_LUA_PROFILE_KINDS];
+static pthread_mutex_t  profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Number of functions and trace aborts in the report */
+#define PROFILE_REPORT_TOP 20
+
 /* Lua test operations */
 
 static int sb_lua_op_init(void);
@@ -142,18 +226,20 @@ static int sb_lua_cmd_cleanup(void);
 static int sb_lua_cmd_help(void);
 
 /* Initialize interpreter state */
-static lua_State *sb_lua_new_state(void);
+static lua_State *sb_lua_new_state(const char *path);
 
 /* Close interpretet state */
 static int sb_lua_close_state(lua_State *);
 
 static int read_cmdline_options(lua_State *L);
+static int load_group_scripts(void);
 static bool sb_lua_hook_defined(lua_State *, const char *);
 static bool sb_lua_hook_push(lua_State *, const char *);
 static void sb_lua_report_intermediate(sb_stat_t *);
 static void sb_lua_report_cumulative(sb_stat_t *);
 
 static int sb_lua_do_jitcmd(lua_State *L, const char *cmd);
+static void profile_report(void);
 
 static void call_error(lua_State *L, const char *name)
 {
@@ -302,13 +388,20 @@ sb_test_t *sb_load_lua(const char *testname)
   }
 
   /* Initialize global interpreter state */
-  gstate = sb_lua_new_state();
+  cache_chunks = true;
+
+  gstate = sb_lua_new_state(sbtest.lname);
   if (gstate == NULL)
     goto error;
 
   if (read_cmdline_options(gstate))
     goto error;
 
+  if (load_group_scripts())
+    goto error;
+
+  cache_chunks = false;
+
   /* Test commands */
   if (func_available(gstate, PREPARE_FUNC))
     sbtest.builtin_cmds.prepare = &sb_lua_cmd_prepare;
@@ -333,13 +426,17 @@ sb_test_t *sb_load_lua(const char *testname)
 
   /* Allocate per-thread interpreters array */
   states = (lua_State **)calloc(sb_globals.threads, sizeof(lua_State *));
-  if (states == NULL)
+  state_heap = (size_t *)calloc(sb_globals.threads, sizeof(size_t));
+  if (states == NULL || state_heap == NULL)
     goto error;
+  nstates = sb_globals.threads;
 
   return &sbtest;
 
  error:
 
+  cache_chunks = false;
+
   sb_lua_done();
 
   return NULL;
@@ -348,10 +445,30 @@ sb_test_t *sb_load_lua(const char *testname)
 
 void sb_lua_done(void)
 {
+  profile_report();
+
   sb_lua_close_state(gstate);
   gstate = NULL;
 
   xfree(states);
+  xfree(state_heap);
+  nstates = 0;
+
+  while (chunks != NULL)
+  {
+    sb_lua_chunk_t * const next = chunks->next;
+
+    xfree(chunks->path);
+    xfree(chunks->bytecode.buf);
+    free(chunks);
+    chunks = next;
+  }
+
+  for (size_t i = 0; i < NINTERNAL_SCRIPTS; i++)
+  {
+    xfree(internal_bytecode[i].buf);
+    internal_bytecode[i].len = 0;
+  }
 
   if (sbtest.args != NULL)
   {
@@ -401,7 +518,17 @@ int sb_lua_op_thread_init(int thread_id)
 {
   lua_State * L;
 
-  L = sb_lua_new_state();
+  const char * const path = sb_groups_script(thread_id);
+
+  /* Reuse the state of the previous run, only options may have changed */
+  if (keep_states && states[thread_id] != NULL)
+  {
+    tls_lua_ctxt.L = states[thread_id];
+
+    return export_options(states[thread_id]);
+  }
+
+  L = sb_lua_new_state(path != NULL ? path : sbtest.lname);
   if (L == NULL)
     return 1;
 
@@ -422,9 +549,50 @@ int sb_lua_op_thread_init(int thread_id)
     }
   }
 
+  /* Create virtual users, see sysbench.lua */
+  if (sb_globals.virtual_users > 1)
+  {
+    lua_getglobal(L, VUSERS_INIT_FUNC);
+    lua_pushnumber(L, thread_id);
+    lua_pushnumber(L, sb_globals.virtual_users);
+
+    if (lua_pcall(L, 2, 0, 0))
+    {
+      call_error(L, VUSERS_INIT_FUNC);
+      return 1;
+    }
+  }
+
+  if (sb_globals.lua_profile || sb_globals.lua_trace_aborts)
+  {
+    lua_getglobal(L, PROFILE_START_FUNC);
+    lua_pushnumber(L, thread_id);
+    lua_pushboolean(L, sb_globals.lua_profile);
+    lua_pushboolean(L, sb_globals.lua_trace_aborts);
+
+    if (lua_pcall(L, 3, 0, 0))
+    {
+      call_error(L, PROFILE_START_FUNC);
+      return 1;
+    }
+  }
+
+  /* Do not keep garbage left by loading scripts until the next GC cycle */
+  if (sb_globals.lean_workers)
+    lua_gc(L, LUA_GCCOLLECT, 0);
+
+  state_heap[thread_id] = (size_t) lua_gc(L, LUA_GCCOUNT, 0) * 1024 +
+    (size_t) lua_gc(L, LUA_GCCOUNTB, 0);
+
   return 0;
 }
 
+
+size_t sb_lua_state_heap(unsigned int thread_id)
+{
+  return state_heap != NULL && thread_id < nstates ? state_heap[thread_id] : 0;
+}
+
 int sb_lua_op_thread_run(int thread_id)
 {
   lua_State * const L = states[thread_id];
@@ -441,11 +609,38 @@ int sb_lua_op_thread_run(int thread_id)
   return 0;
 }
 
-int sb_lua_op_thread_done(int thread_id)
+/*
+  Stop --lua-profile and --lua-trace-aborts, then call vuser_done() and
+  thread_done() in a per-thread state
+*/
+
+static int call_thread_done(lua_State *L, int thread_id)
 {
-  lua_State * const L = states[thread_id];
   int rc = 0;
 
+  if (sb_globals.lua_profile || sb_globals.lua_trace_aborts)
+  {
+    lua_getglobal(L, PROFILE_STOP_FUNC);
+
+    if (lua_pcall(L, 0, 0, 0))
+    {
+      call_error(L, PROFILE_STOP_FUNC);
+      rc = 1;
+    }
+  }
+
+  if (sb_globals.virtual_users > 1)
+  {
+    lua_getglobal(L, VUSERS_DONE_FUNC);
+    lua_pushnumber(L, thread_id);
+
+    if (lua_pcall(L, 1, 0, 0))
+    {
+      call_error(L, VUSERS_DONE_FUNC);
+      rc = 1;
+    }
+  }
+
   lua_getglobal(L, THREAD_DONE_FUNC);
   if (!lua_isnil(L, -1))
   {
@@ -458,7 +653,54 @@ int sb_lua_op_thread_done(int thread_id)
     }
   }
 
+  return rc;
+}
+
+int sb_lua_op_thread_done(int thread_id)
+{
+  lua_State * const L = states[thread_id];
+  int rc;
+
+  if (keep_states)
+    return 0;
+
+  rc = call_thread_done(L, thread_id);
+
   sb_lua_close_state(L);
+  states[thread_id] = NULL;
+
+  return rc;
+}
+
+
+void sb_lua_keep_states(void)
+{
+  keep_states = true;
+}
+
+
+int sb_lua_release_states(void)
+{
+  int rc = 0;
+
+  keep_states = false;
+
+  for (unsigned int i = 0; i < nstates; i++)
+  {
+    if (states[i] == NULL)
+      continue;
+
+    tls_lua_ctxt.L = states[i];
+
+    if (call_thread_done(states[i], (int) i))
+      rc = 1;
+
+    sb_lua_close_state(states[i]);
+    states[i] = NULL;
+  }
+
+  /* The calling thread uses the global state */
+  tls_lua_ctxt.L = gstate;
 
   return rc;
 }
@@ -475,18 +717,220 @@ int sb_lua_op_done(void)
     }
   }
 
-  sb_lua_done();
+  return 0;
+}
+
+/* Add a count collected by sysbench.lua, exported to Lua via FFI */
+
+void sb_lua_profile_add(int kind, const char *key, uint64_t count)
+{
+  sb_lua_profile_t *p;
+  size_t           i;
+
+  if (kind < 0 || kind >= SB_LUA_PROFILE_KINDS)
+    return;
+
+  p = &profile[kind];
+
+  pthread_mutex_lock(&profile_mutex);
+
+  for (i = 0; i < p->n; i++)
+    if (!strcmp(p->entries[i].key, key))
+      break;
+
+  if (i == p->n)
+  {
+    sb_lua_profile_entry_t * const tmp =
+      realloc(p->entries, (p->n + 1) * sizeof(sb_lua_profile_entry_t));
+
+    if (tmp == NULL || (key = strdup(key)) == NULL)
+    {
+      if (tmp != NULL)
+        p->entries = tmp;
+      pthread_mutex_unlock(&profile_mutex);
+      return;
+    }
+
+    p->entries = tmp;
+    p->entries[p->n].key = (char *) key;
+    p->entries[p->n].count = 0;
+    p->n++;
+  }
+
+  p->entries[i].count += count;
+  p->total += count;
+
+  pthread_mutex_unlock(&profile_mutex);
+}
+
+
+/* Sort profile entries by count, descending */
+
+static int profile_entry_cmp(const void *a, const void *b)
+{
+  const sb_lua_profile_entry_t * const ea = a;
+  const sb_lua_profile_entry_t * const eb = b;
+
+  if (ea->count != eb->count)
+    return ea->count < eb->count ? 1 : -1;
+
+  return strcmp(ea->key, eb->key);
+}
+
+
+/* Return the name of a jit.profile VM state */
+
+static const char *profile_vmstate_name(const char *state)
+{
+  switch (state[0])
+  {
+  case 'N': return "compiled code";
+  case 'I': return "interpreter";
+  case 'C': return "C code";
+  case 'G': return "garbage collector";
+  case 'J': return "JIT compiler";
+  default:  return state;
+  }
+}
+
+
+/* Print and free the counts collected by --lua-profile and --lua-trace-aborts */
+
+static void profile_report(void)
+{
+  sb_lua_profile_t * const funcs = &profile[SB_LUA_PROFILE_FUNC];
+  sb_lua_profile_t * const vmstates = &profile[SB_LUA_PROFILE_VMSTATE];
+  sb_lua_profile_t * const aborts = &profile[SB_LUA_PROFILE_ABORT];
+
+  /* Nothing is collected by other commands */
+  if (sb_globals.cmdname == NULL || strcmp(sb_globals.cmdname, "run"))
+    return;
+
+  for (int i = 0; i < SB_LUA_PROFILE_KINDS; i++)
+    qsort(profile[i].entries, profile[i].n, sizeof(sb_lua_profile_entry_t),
+          profile_entry_cmp);
+
+  if (sb_globals.lua_profile)
+  {
+    log_text(LOG_NOTICE, "Lua profile of thread 0 (%" PRIu64 " samples):",
+             funcs->total);
+
+    if (funcs->total > 0)
+    {
+      log_text(LOG_NOTICE, "    VM states:");
+      for (size_t i = 0; i < vmstates->n; i++)
+        log_text(LOG_NOTICE, "        %-20s %6.2f%%",
+                 profile_vmstate_name(vmstates->entries[i].key),
+                 vmstates->entries[i].count * 100.0 / vmstates->total);
+
+      log_text(LOG_NOTICE, "    functions:");
+      for (size_t i = 0; i < funcs->n && i < PROFILE_REPORT_TOP; i++)
+        log_text(LOG_NOTICE, "        %6.2f%%  %s",
+                 funcs->entries[i].count * 100.0 / funcs->total,
+                 funcs->entries[i].key);
+    }
+
+    log_text(LOG_NOTICE, " ");
+  }
+
+  if (sb_globals.lua_trace_aborts)
+  {
+    log_text(LOG_NOTICE, "LuaJIT trace aborts (%" PRIu64 " in all threads):",
+             aborts->total);
+
+    for (size_t i = 0; i < aborts->n && i < PROFILE_REPORT_TOP; i++)
+      log_text(LOG_NOTICE, "    %8" PRIu64 "  %s", aborts->entries[i].count,
+               aborts->entries[i].key);
+
+    log_text(LOG_NOTICE, " ");
+  }
+
+  for (int i = 0; i < SB_LUA_PROFILE_KINDS; i++)
+  {
+    for (size_t j = 0; j < profile[i].n; j++)
+      free(profile[i].entries[j].key);
+
+    free(profile[i].entries);
+    memset(&profile[i], 0, sizeof(profile[i]));
+  }
+}
+
+
+/* lua_dump() writer appending to a sb_lua_bytecode_t */
+
+static int bytecode_writer(lua_State *L, const void *p, size_t size, void *ud)
+{
+  sb_lua_bytecode_t * const bc = (sb_lua_bytecode_t *) ud;
+  char              * const buf = realloc(bc->buf, bc->len + size);
+
+  (void) L; /* unused */
+
+  if (buf == NULL)
+    return 1;
+
+  memcpy(buf + bc->len, p, size);
+  bc->buf = buf;
+  bc->len += size;
 
   return 0;
 }
 
+/*
+  Save the bytecode of the function on top of the stack. Errors are not fatal,
+  the script is then compiled again by each state.
+*/
+
+static void dump_bytecode(lua_State *L, sb_lua_bytecode_t *bc)
+{
+  if (sb_globals.lean_workers)
+  {
+    const char *buf;
+    size_t     len;
+
+    /* lua_dump() cannot strip debug info, string.dump(f, true) can */
+    lua_getglobal(L, "string");
+    lua_getfield(L, -1, "dump");
+    lua_remove(L, -2);
+    lua_pushvalue(L, -2);
+    lua_pushboolean(L, 1);
+
+    if (lua_pcall(L, 2, 1, 0) == 0 &&
+        (buf = lua_tolstring(L, -1, &len)) != NULL &&
+        (bc->buf = malloc(len)) != NULL)
+    {
+      memcpy(bc->buf, buf, len);
+      bc->len = len;
+    }
+
+    lua_pop(L, 1);
+
+    return;
+  }
+
+  if (lua_dump(L, bytecode_writer, bc) != 0)
+  {
+    xfree(bc->buf);
+    bc->len = 0;
+  }
+}
+
 /* Pre-load internal scripts */
 
 static int load_internal_scripts(lua_State *L)
 {
   for (internal_script_t *s = internal_scripts; s->name != NULL; s++)
   {
-    if (luaL_loadbuffer(L, (const char *) s->source, s->source_len[0], s->name))
+    sb_lua_bytecode_t * const bc = &internal_bytecode[s - internal_scripts];
+    int               rc;
+
+    if (bc->buf != NULL)
+      rc = luaL_loadbuffer(L, bc->buf, bc->len, s->name);
+    else if ((rc = luaL_loadbuffer(L, (const char *) s->source,
+                                   s->source_len[0], s->name)) == 0 &&
+             cache_chunks)
+      dump_bytecode(L, bc);
+
+    if (rc)
     {
       log_text(LOG_FATAL, "failed to load internal module '%s': %s",
                s->name, lua_tostring(L, -1));
@@ -500,6 +944,47 @@ static int load_internal_scripts(lua_State *L)
   return 0;
 }
 
+/*
+  Load a test script from a given path or the standard input, if path is NULL,
+  using its cached bytecode if available
+*/
+
+static int load_script(lua_State *L, const char *path)
+{
+  sb_lua_chunk_t *chunk;
+  int            rc;
+
+  for (chunk = chunks; chunk != NULL; chunk = chunk->next)
+  {
+    if (path == NULL ? chunk->path == NULL :
+        chunk->path != NULL && !strcmp(chunk->path, path))
+      return luaL_loadbuffer(L, chunk->bytecode.buf, chunk->bytecode.len,
+                             path != NULL ? path : "=stdin");
+  }
+
+  if ((rc = luaL_loadfile(L, path)) != 0 || !cache_chunks)
+    return rc;
+
+  chunk = calloc(1, sizeof(sb_lua_chunk_t));
+  if (chunk == NULL)
+    return 0;
+
+  dump_bytecode(L, &chunk->bytecode);
+
+  if (chunk->bytecode.buf == NULL ||
+      (path != NULL && (chunk->path = strdup(path)) == NULL))
+  {
+    xfree(chunk->bytecode.buf);
+    free(chunk);
+    return 0;
+  }
+
+  chunk->next = chunks;
+  chunks = chunk;
+
+  return 0;
+}
+
 static void sb_lua_var_number(lua_State *L, const char *name, lua_Number n)
 {
     lua_pushstring(L, name);
@@ -591,19 +1076,38 @@ static void sb_lua_set_paths(lua_State *L)
 
 int sb_lua_set_test_args(sb_arg_t *args, size_t len)
 {
-  sbtest.args = malloc((len + 1) * sizeof(sb_arg_t));
+  size_t n = 0;
+
+  /* Options of --thread-groups scripts are added to those already defined */
+  if (sbtest.args != NULL)
+    while (sbtest.args[n].name != NULL)
+      n++;
+
+  sb_arg_t *tmp = realloc(sbtest.args, (n + len + 1) * sizeof(sb_arg_t));
+  if (tmp == NULL)
+    return 1;
+  sbtest.args = tmp;
 
   for (size_t i = 0; i < len; i++)
   {
-    sbtest.args[i].name = strdup(args[i].name);
-    sbtest.args[i].desc = strdup(args[i].desc);
-    sbtest.args[i].type = args[i].type;
+    size_t j;
 
-    sbtest.args[i].value = args[i].value != NULL ? strdup(args[i].value) : NULL;
-    sbtest.args[i].validate = args[i].validate;
+    for (j = 0; j < n; j++)
+      if (!strcmp(sbtest.args[j].name, args[i].name))
+        break;
+    if (j < n)
+      continue;
+
+    sbtest.args[n].name = strdup(args[i].name);
+    sbtest.args[n].desc = strdup(args[i].desc);
+    sbtest.args[n].type = args[i].type;
+
+    sbtest.args[n].value = args[i].value != NULL ? strdup(args[i].value) : NULL;
+    sbtest.args[n].validate = args[i].validate;
+    n++;
   }
 
-  sbtest.args[len] = (sb_arg_t) {.name = NULL};
+  sbtest.args[n] = (sb_arg_t) {.name = NULL};
 
   return 0;
 }
@@ -643,9 +1147,47 @@ static int read_cmdline_options(lua_State *L)
   return rc;
 }
 
+/*
+  Check scripts of --thread-groups and add their options to those of the main
+  script
+*/
+
+static int load_group_scripts(void)
+{
+  int rc = 0;
+
+  for (unsigned int i = 0; i < sb_globals.threads && rc == 0; i++)
+  {
+    const char *path = sb_groups_script(i);
+
+    /* Load each script once, for the first thread of its group */
+    if (path == NULL || (i > 0 && sb_groups_script(i - 1) == path))
+      continue;
+
+    lua_State * const L = sb_lua_new_state(path);
+
+    if (L == NULL)
+      rc = 1;
+    else if (!func_available(L, EVENT_FUNC))
+    {
+      log_text(LOG_FATAL, "cannot find the event() function in %s", path);
+      rc = 1;
+    }
+    else
+      rc = read_cmdline_options(L);
+
+    if (L != NULL)
+      lua_close(L);
+  }
+
+  tls_lua_ctxt.L = gstate;
+
+  return rc;
+}
+
 /* Allocate and initialize new interpreter state */
 
-static lua_State *sb_lua_new_state(void)
+static lua_State *sb_lua_new_state(const char *path)
 {
   lua_State      *L;
 
@@ -702,7 +1244,7 @@ static lua_State *sb_lua_new_state(void)
   }
 
   /* Export script path as sysbench.cmdline.script_path */
-  sb_lua_var_string(L, "script_path", sbtest.lname);
+  sb_lua_var_string(L, "script_path", path);
 
   lua_settable(L, -3); /* sysbench.cmdline */
 
@@ -716,14 +1258,14 @@ static lua_State *sb_lua_new_state(void)
 
   int rc;
 
-  if ((rc = luaL_loadfile(L, sbtest.lname)) != 0)
+  if ((rc = load_script(L, path)) != 0)
   {
     if (rc != LUA_ERRFILE)
       goto loaderr;
 
     /* Try to handle the given string as a module name */
     lua_getglobal(L, "require");
-    lua_pushstring(L, sbtest.lname);
+    lua_pushstring(L, path);
     if (lua_pcall(L, 1, 1, 0))
     {
       const char *msg = lua_tostring(L, -1);
@@ -731,7 +1273,7 @@ static lua_State *sb_lua_new_state(void)
         goto loaderr;
 
       log_text(LOG_FATAL, "Cannot find benchmark '%s': no such built-in test, "
-               "file or module", sbtest.lname);
+               "file or module", path);
 
       return NULL;
     }
@@ -966,7 +1508,7 @@ static void *cmd_worker_thread(void *arg)
   /* Initialize thread-local RNG state */
   sb_rand_thread_init();
 
-  lua_State * const L = sb_lua_new_state();
+  lua_State * const L = sb_lua_new_state(sbtest.lname);
 
   if (L == NULL)
   {
@@ -976,11 +1518,27 @@ static void *cmd_worker_thread(void *arg)
 
   call_custom_command(L);
 
+  /* Do not make other threads wait for this one, e.g. on errors */
+  sb_barrier_leave(&cmd_barrier);
+
   sb_lua_close_state(L);
 
   return NULL;
 }
 
+/*
+  Wait for all threads executing a parallel command. Does nothing if the
+  command is executed by a single thread.
+*/
+
+int sb_lua_barrier_wait(void)
+{
+  if (!cmd_barrier_active)
+    return 0;
+
+  return sb_barrier_wait(&cmd_barrier) < 0;
+}
+
 /* Call a specified custom command */
 
 int sb_lua_call_custom_command(const char *name)
@@ -991,10 +1549,20 @@ int sb_lua_call_custom_command(const char *name)
   {
     int err;
 
-    if ((err = sb_thread_create_workers(cmd_worker_thread)))
-      return err;
+    if (sb_barrier_init(&cmd_barrier, sb_globals.threads, NULL, NULL))
+    {
+      log_errno(LOG_FATAL, "sb_barrier_init() failed");
+      return 1;
+    }
+    cmd_barrier_active = true;
+
+    if ((err = sb_thread_create_workers(cmd_worker_thread)) == 0)
+      err = sb_thread_join_workers();
+
+    cmd_barrier_active = false;
+    sb_barrier_destroy(&cmd_barrier);
 
-    return sb_thread_join_workers();
+    return err;
   }
 
   return call_custom_command(gstate);
@@ -1014,6 +1582,10 @@ static void stat_to_lua_table(lua_State *L, sb_stat_t *stat)
   stat_to_number(other);
   stat_to_number(errors);
   stat_to_number(reconnects);
+  stat_to_number(net_sent);
+  stat_to_number(net_received);
+  stat_to_number(bytes_read);
+  stat_to_number(bytes_written);
 
   for(size_t i = 0; i < sb_globals.npercentiles; i++){
     char *format_str = "%4.2fth percentile";
@@ -1022,6 +1594,97 @@ static void stat_to_lua_table(lua_State *L, sb_stat_t *stat)
     sb_lua_var_number(L, percentile, *(stat->latency_pcts + i));
     free(percentile);
   }
+
+  /* Latency at the first --percentile, used by the sysbench.report_*() hooks */
+  sb_lua_var_number(L, "latency_pct",
+                    (sb_globals.npercentiles > 0 && stat->latency_pcts != NULL) ?
+                    stat->latency_pcts[0] : 0);
+
+  if (stat->intended_latency_pcts != NULL)
+  {
+    for(size_t i = 0; i < sb_globals.npercentiles; i++){
+      char *format_str = "%4.2fth intended percentile";
+      char *percentile = malloc((strlen(format_str) + 6 + 1) * sizeof(char));
+      sprintf(percentile, format_str, *(sb_globals.percentiles + i));
+      sb_lua_var_number(L, percentile, *(stat->intended_latency_pcts + i));
+      free(percentile);
+    }
+  }
+
+  if (stat->queue_wait_pcts != NULL)
+  {
+    for(size_t i = 0; i < sb_globals.npercentiles; i++){
+      char *format_str = "%4.2fth queue wait percentile";
+      char *percentile = malloc((strlen(format_str) + 6 + 1) * sizeof(char));
+      sprintf(percentile, format_str, *(sb_globals.percentiles + i));
+      sb_lua_var_number(L, percentile, *(stat->queue_wait_pcts + i));
+      free(percentile);
+    }
+  }
+
+  if (stat->cycle_time_pcts != NULL)
+  {
+    stat_to_number(think_time_avg);
+    stat_to_number(cycle_time_avg);
+
+    for(size_t i = 0; i < sb_globals.npercentiles; i++){
+      char *format_str = "%4.2fth cycle percentile";
+      char *percentile = malloc((strlen(format_str) + 6 + 1) * sizeof(char));
+      sprintf(percentile, format_str, *(sb_globals.percentiles + i));
+      sb_lua_var_number(L, percentile, *(stat->cycle_time_pcts + i));
+      free(percentile);
+    }
+  }
+
+  const sb_user_stats_t *user = stat->user;
+
+  if (user != NULL)
+  {
+    lua_pushliteral(L, "counters");
+    lua_newtable(L);
+
+    for (unsigned int i = 0; i < user->ncounters; i++)
+      sb_lua_var_number(L, sb_user_counter_name(i), user->counters[i]);
+
+    lua_settable(L, -3);
+
+    lua_pushliteral(L, "histograms");
+    lua_newtable(L);
+
+    for (unsigned int i = 0; i < user->nhistograms; i++)
+    {
+      lua_pushstring(L, sb_user_histogram_name(i));
+      lua_newtable(L);
+
+      for (size_t j = 0; j < sb_globals.npercentiles; j++)
+      {
+        char name[32];
+
+        snprintf(name, sizeof(name), "%4.2fth percentile",
+                 sb_globals.percentiles[j]);
+        sb_lua_var_number(L, name, user->pcts[i][j]);
+      }
+
+      lua_settable(L, -3);
+    }
+
+    lua_settable(L, -3);
+  }
+
+  /* Average number of active server sessions in each wait class */
+  const db_waits_t *waits = stat->waits;
+
+  if (waits != NULL && waits->nsamples > 0)
+  {
+    lua_pushliteral(L, "waits");
+    lua_newtable(L);
+
+    for (unsigned int i = 0; i < waits->nclasses; i++)
+      sb_lua_var_number(L, waits->names[i],
+                        (double) waits->sessions[i] / waits->nsamples);
+
+    lua_settable(L, -3);
+  }
 }
 
 /* Call sysbench.hooks.report_intermediate */
@@ -1040,6 +1703,7 @@ static void sb_lua_report_intermediate(sb_stat_t *stat)
   */
   stat_to_number(queue_length);
   stat_to_number(concurrency);
+  stat_to_number(queue_dropped);
 
   if (lua_pcall(L, 1, 0, 0))
   {
@@ -1086,7 +1750,7 @@ int sb_lua_report_thread_init(void)
 {
   if (tls_lua_ctxt.L == NULL)
   {
-    sb_lua_new_state();
+    sb_lua_new_state(sbtest.lname);
     export_options(tls_lua_ctxt.L);
   }
 
@@ -35,8 +35,28 @@ bool sb_lua_custom_command_defined(const char *name);
 
 int sb_lua_call_custom_command(const char *name);
 
+int sb_lua_barrier_wait(void);
+
+/* Add a count collected by --lua-profile or --lua-trace-aborts */
+void sb_lua_profile_add(int kind, const char *key, uint64_t count);
+
 int sb_lua_report_thread_init(void);
 
 void sb_lua_report_thread_done(void *);
 
 bool sb_lua_loaded(void);
+
+/*
+  Keep per-thread interpreter states, along with connections and prepared
+  statements created by thread_init(), between runs, see --scenario
+*/
+void sb_lua_keep_states(void);
+
+/* Call thread_done() for all kept states and close them */
+int sb_lua_release_states(void);
+
+/*
+  Lua heap size in bytes of the state of a given worker thread after its
+  thread_init(), or 0 if it has no state
+*/
+size_t sb_lua_state_heap(unsigned int thread_id);
@@ -0,0 +1,485 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  HTTP endpoint serving statistics in the Prometheus text exposition format
+  on GET /metrics. All values are totals since the start, read without
+  changing the state of intermediate, checkpoint or cumulative reports.
+  Connections are served one at a time.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdio.h>
+# include <stdlib.h>
+# include <stdarg.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+#ifdef HAVE_SYS_SOCKET_H
+# include <sys/socket.h>
+#endif
+#ifdef HAVE_NETDB_H
+# include <netdb.h>
+#endif
+
+#include <sys/time.h>
+
+#include "sb_metrics.h"
+#include "sysbench.h"
+#include "sb_counter.h"
+#include "sb_histogram.h"
+#include "sb_logger.h"
+#include "sb_options.h"
+#include "sb_rate.h"
+#include "sb_thread.h"
+#include "sb_util.h"
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+/* Maximum size of a request */
+#define METRICS_REQUEST_MAX 4096
+
+/* Time to wait for a request on a connection */
+#define METRICS_READ_TIMEOUT_SEC 5
+
+/* Latency histogram bucket bounds in seconds */
+static const double latency_buckets[] =
+{
+  0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25,
+  0.5, 1, 2.5, 5, 10
+};
+
+#define N_LATENCY_BUCKETS \
+  (sizeof(latency_buckets) / sizeof(latency_buckets[0]))
+
+typedef struct
+{
+  char   *data;
+  size_t len;
+  size_t size;
+} metrics_buf_t;
+
+static int       listen_fd = -1;
+static pthread_t metrics_thread;
+static bool      metrics_thread_created;
+
+
+int sb_metrics_init(void)
+{
+  struct addrinfo *ai;
+  struct addrinfo *p;
+  const char      *addr = sb_get_value_string("metrics-listen");
+  const int       on = 1;
+  int             rc;
+
+  if (addr == NULL)
+    return 0;
+
+  if ((rc = sb_resolve_addr(addr, true, &ai)) != 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --metrics-listen: '%s': %s", addr,
+             gai_strerror(rc));
+    return 1;
+  }
+
+  for (p = ai; p != NULL; p = p->ai_next)
+  {
+    listen_fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+    if (listen_fd < 0)
+      continue;
+
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    if (bind(listen_fd, p->ai_addr, p->ai_addrlen) == 0 &&
+        listen(listen_fd, 16) == 0)
+      break;
+
+    close(listen_fd);
+    listen_fd = -1;
+  }
+
+  freeaddrinfo(ai);
+
+  if (listen_fd < 0)
+  {
+    log_errno(LOG_FATAL, "Cannot listen on --metrics-listen '%s'", addr);
+    return 1;
+  }
+
+  return 0;
+}
+
+
+bool sb_metrics_enabled(void)
+{
+  return listen_fd >= 0;
+}
+
+
+/* Append formatted text to a buffer, growing it as needed */
+
+static void buf_printf(metrics_buf_t *buf, const char *fmt, ...)
+  SB_ATTRIBUTE_FORMAT(printf, 2, 3);
+
+static void buf_printf(metrics_buf_t *buf, const char *fmt, ...)
+{
+  va_list ap;
+  int     n;
+
+  for (;;)
+  {
+    va_start(ap, fmt);
+    n = vsnprintf(buf->data + buf->len, buf->size - buf->len, fmt, ap);
+    va_end(ap);
+
+    if (n < 0)
+      return;
+
+    if ((size_t) n < buf->size - buf->len)
+      break;
+
+    char *tmp = realloc(buf->data, buf->size * 2 + n);
+    if (tmp == NULL)
+      return;
+
+    buf->data = tmp;
+    buf->size = buf->size * 2 + n;
+  }
+
+  buf->len += n;
+}
+
+
+static void print_metric(metrics_buf_t *buf, const char *name,
+                         const char *type, const char *help, double val)
+{
+  buf_printf(buf, "# HELP %s %s\n# TYPE %s %s\n%s %.15g\n", name, help, name,
+             type, name, val);
+}
+
+
+/*
+  Print the latency histogram with classic cumulative buckets from a snapshot
+  of its counts
+*/
+
+static void print_latency(metrics_buf_t *buf, const uint64_t *array,
+                          uint64_t nevents)
+{
+  sb_histogram_t * const h = &sb_latency_histogram;
+  uint64_t              counts[N_LATENCY_BUCKETS] = {0};
+  double                sum = 0;
+
+  for (size_t i = 0; i < h->array_size; i++)
+  {
+    if (array[i] == 0)
+      continue;
+
+    /* Histogram values are in milliseconds */
+    const double value = sb_histogram_get_value(h, i) / 1000;
+
+    sum += value * array[i];
+
+    for (size_t b = 0; b < N_LATENCY_BUCKETS; b++)
+      if (value <= latency_buckets[b])
+        counts[b] += array[i];
+  }
+
+  buf_printf(buf, "# HELP sysbench_latency_seconds Event latency. The sum is "
+             "estimated from histogram values.\n"
+             "# TYPE sysbench_latency_seconds histogram\n");
+
+  for (size_t b = 0; b < N_LATENCY_BUCKETS; b++)
+    buf_printf(buf, "sysbench_latency_seconds_bucket{le=\"%g\"} %" PRIu64 "\n",
+               latency_buckets[b], counts[b]);
+
+  buf_printf(buf, "sysbench_latency_seconds_bucket{le=\"+Inf\"} %" PRIu64 "\n"
+             "sysbench_latency_seconds_sum %.15g\n"
+             "sysbench_latency_seconds_count %" PRIu64 "\n",
+             nevents, sum, nevents);
+}
+
+
+static void print_metrics(metrics_buf_t *buf)
+{
+  sb_counters_t cnt;
+  uint64_t      *array = NULL;
+  uint64_t      nevents = 0;
+
+  /*
+    Events are added to the latency histogram before they are counted, so take
+    the histogram snapshot first to never export more latencies than events
+  */
+  if (sb_globals.npercentiles > 0)
+  {
+    array = malloc(sb_latency_histogram.array_size * sizeof(uint64_t));
+
+    if (array != NULL)
+      nevents = sb_histogram_get_counts(&sb_latency_histogram, array);
+  }
+
+  sb_counters_agg_total(cnt);
+
+  buf_printf(buf, "# HELP sysbench_info Version and test of this instance.\n"
+             "# TYPE sysbench_info gauge\n"
+             "sysbench_info{version=\"%s\",test=\"", PACKAGE_VERSION);
+
+  /* Escape the test name as a label value */
+  for (const char *c = sb_globals.testname; c != NULL && *c != '\0'; c++)
+  {
+    if (*c == '"' || *c == '\\')
+      buf_printf(buf, "\\%c", *c);
+    else if (*c == '\n')
+      buf_printf(buf, "\\n");
+    else
+      buf_printf(buf, "%c", *c);
+  }
+
+  buf_printf(buf, "\"} 1\n");
+
+  print_metric(buf, "sysbench_elapsed_seconds", "gauge",
+               "Time since the start of the benchmark.",
+               NS2SEC(sb_timer_value(&sb_exec_timer)));
+  print_metric(buf, "sysbench_threads", "gauge",
+               "Number of worker threads.", sb_globals.threads);
+  print_metric(buf, "sysbench_threads_running", "gauge",
+               "Number of worker threads executing events.",
+               ck_pr_load_uint(&sb_globals.threads_running));
+
+  if (sb_globals.tx_rate > 0)
+    print_metric(buf, "sysbench_target_rate", "gauge",
+                 "Target events per second with --rate.", sb_rate_target());
+
+  print_metric(buf, "sysbench_events_total", "counter",
+               "Number of events.", cnt[SB_CNT_EVENT]);
+
+  buf_printf(buf, "# HELP sysbench_queries_total Number of queries.\n"
+             "# TYPE sysbench_queries_total counter\n"
+             "sysbench_queries_total{type=\"read\"} %" PRIu64 "\n"
+             "sysbench_queries_total{type=\"write\"} %" PRIu64 "\n"
+             "sysbench_queries_total{type=\"other\"} %" PRIu64 "\n",
+             cnt[SB_CNT_READ], cnt[SB_CNT_WRITE], cnt[SB_CNT_OTHER]);
+
+  print_metric(buf, "sysbench_errors_total", "counter",
+               "Number of ignored errors.", cnt[SB_CNT_ERROR]);
+  print_metric(buf, "sysbench_reconnects_total", "counter",
+               "Number of reconnects to the database.", cnt[SB_CNT_RECONNECT]);
+  print_metric(buf, "sysbench_read_bytes_total", "counter",
+               "Number of bytes read.", cnt[SB_CNT_BYTES_READ]);
+  print_metric(buf, "sysbench_written_bytes_total", "counter",
+               "Number of bytes written.", cnt[SB_CNT_BYTES_WRITTEN]);
+
+  if (array != NULL)
+  {
+    print_latency(buf, array, nevents);
+    free(array);
+  }
+}
+
+
+static void send_response(int fd, const char *status, const char *type,
+                          const char *body, size_t len)
+{
+  char hdr[256];
+
+  snprintf(hdr, sizeof(hdr), "HTTP/1.0 %s\r\n"
+           "Content-Type: %s\r\n"
+           "Content-Length: %zu\r\n"
+           "Connection: close\r\n\r\n", status, type, len);
+
+  if (send(fd, hdr, strlen(hdr), MSG_NOSIGNAL) >= 0 && len > 0)
+    send(fd, body, len, MSG_NOSIGNAL);
+}
+
+
+static void serve_metrics(int fd, const char *path);
+
+/* Read a request from a connection and send back the response */
+
+static void serve_client(int fd)
+{
+  char   req[METRICS_REQUEST_MAX];
+  size_t len = 0;
+
+  /* Wait for the end of request headers */
+  while (len < sizeof(req) - 1)
+  {
+    const ssize_t n = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+
+    if (n < 0 && errno == EINTR)
+      continue;
+
+    if (n <= 0)
+      return;
+
+    len += n;
+    req[len] = '\0';
+
+    if (strstr(req, "\r\n\r\n") != NULL || strstr(req, "\n\n") != NULL)
+      break;
+  }
+
+  req[len] = '\0';
+
+  /* Let the response complete when the run ends */
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+  if (strncmp(req, "GET ", 4))
+  {
+    static const char msg[] = "Only GET is supported\n";
+
+    send_response(fd, "405 Method Not Allowed", "text/plain", msg,
+                  sizeof(msg) - 1);
+  }
+  else
+    serve_metrics(fd, req + 4);
+
+  pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+}
+
+
+/* Send metrics for a GET request of a given path */
+
+static void serve_metrics(int fd, const char *path)
+{
+  const size_t plen = strcspn(path, " ?\r\n");
+
+  if (!(plen == 1 && path[0] == '/') &&
+      !(plen == 8 && !strncmp(path, "/metrics", 8)))
+  {
+    static const char msg[] = "Metrics are served at /metrics\n";
+
+    send_response(fd, "404 Not Found", "text/plain", msg, sizeof(msg) - 1);
+    return;
+  }
+
+  metrics_buf_t buf = { .data = malloc(8192), .len = 0, .size = 8192 };
+
+  if (buf.data == NULL)
+    return;
+
+  buf.data[0] = '\0';
+
+  print_metrics(&buf);
+
+  send_response(fd, "200 OK", "text/plain; version=0.0.4; charset=utf-8",
+                buf.data, buf.len);
+
+  free(buf.data);
+}
+
+
+static void close_fd(void *arg)
+{
+  close(*(int *) arg);
+}
+
+
+static void *metrics_thread_proc(void *arg)
+{
+  const struct timeval timeout = { .tv_sec = METRICS_READ_TIMEOUT_SEC };
+
+  (void) arg; /* unused */
+
+  sb_tls_thread_id = sb_globals.threads;
+
+  log_text(LOG_DEBUG, "Metrics thread started");
+
+  for (;;)
+  {
+    int fd = accept(listen_fd, NULL, NULL);
+
+    if (fd < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      log_errno(LOG_FATAL, "accept() on --metrics-listen failed");
+      break;
+    }
+
+    /* Do not let a stuck client block other scrapes */
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    pthread_cleanup_push(close_fd, &fd);
+
+    serve_client(fd);
+
+    pthread_cleanup_pop(1);
+  }
+
+  return NULL;
+}
+
+
+int sb_metrics_start(void)
+{
+  if (listen_fd < 0)
+    return 0;
+
+  if (sb_thread_create(&metrics_thread, &sb_thread_attr, &metrics_thread_proc,
+                       NULL) != 0)
+  {
+    log_errno(LOG_FATAL, "sb_thread_create() for the metrics thread failed.");
+    return 1;
+  }
+
+  metrics_thread_created = true;
+
+  return 0;
+}
+
+
+void sb_metrics_stop(void)
+{
+  if (!metrics_thread_created)
+    return;
+
+  if (sb_thread_cancel(metrics_thread) ||
+      sb_thread_join(metrics_thread, NULL))
+    log_errno(LOG_FATAL, "Terminating the metrics thread failed.");
+
+  metrics_thread_created = false;
+}
+
+
+void sb_metrics_done(void)
+{
+  sb_metrics_stop();
+
+  if (listen_fd >= 0)
+  {
+    close(listen_fd);
+    listen_fd = -1;
+  }
+}
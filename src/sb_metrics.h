@@ -0,0 +1,45 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Prometheus metrics endpoint, see --metrics-listen */
+
+#ifndef SB_METRICS_H
+#define SB_METRICS_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+
+/* Parse --metrics-listen and start listening on it. Returns 0 on success. */
+int sb_metrics_init(void);
+
+/* Return true if the metrics endpoint is enabled */
+bool sb_metrics_enabled(void);
+
+/* Start serving scrape requests. Returns 0 on success. */
+int sb_metrics_start(void);
+
+/* Stop serving scrape requests, waits for the current one to complete */
+void sb_metrics_stop(void);
+
+/* Close the listening socket */
+void sb_metrics_done(void);
+
+#endif /* SB_METRICS_H */
@@ -0,0 +1,744 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Native events of oltp_point_select, oltp_read_only and oltp_read_write. The
+  scripts are loaded as usual, so they define the options and implement
+  prepare, cleanup and other commands, but worker threads run no Lua code.
+  Events execute the same prepared statements with the same parameters as
+  oltp_common.lua: statements are prepared on first use for each table and
+  labeled by their type, SELECT groups are pipelined where the driver allows
+  it, and events are restarted on ignorable errors. Options changing what
+  events do in a way not implemented here are rejected.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#include <stdio.h>
+
+#include "sb_oltp.h"
+#include "sb_options.h"
+#include "sb_logger.h"
+#include "sb_rand.h"
+#include "sb_util.h"
+#include "db_driver.h"
+
+/* Same templates as c_value_template and pad_value_template in Lua */
+#define C_TEMPLATE "###########-###########-###########-" \
+  "###########-###########-###########-" \
+  "###########-###########-###########-" \
+  "###########"
+#define PAD_TEMPLATE "###########-###########-###########-" \
+  "###########-###########"
+
+#define C_MAX_LEN   120
+#define PAD_MAX_LEN 60
+
+/* Statement parameters, each bound to its own buffer of a thread */
+typedef enum
+{
+  PARAM_ID,                             /* id, or the start of a range */
+  PARAM_ID2,                            /* end of a range, or k */
+  PARAM_C,
+  PARAM_PAD,
+  NPARAMS
+} oltp_param_t;
+
+typedef enum
+{
+  STMT_POINT_SELECTS,
+  STMT_SIMPLE_RANGES,
+  STMT_SUM_RANGES,
+  STMT_ORDER_RANGES,
+  STMT_DISTINCT_RANGES,
+  STMT_INDEX_UPDATES,
+  STMT_NON_INDEX_UPDATES,
+  STMT_DELETES,
+  STMT_INSERTS,
+  NSTMTS
+} oltp_stmt_t;
+
+/* Labels, queries and parameters as in stmt_defs of oltp_common.lua */
+static const struct
+{
+  const char   *label;
+  const char   *query;
+  unsigned int nparams;
+  oltp_param_t params[NPARAMS];
+} stmt_defs[NSTMTS] =
+{
+  {"point_selects", "SELECT c FROM sbtest%u WHERE id=?", 1, {PARAM_ID}},
+  {"simple_ranges", "SELECT c FROM sbtest%u WHERE id BETWEEN ? AND ?", 2,
+   {PARAM_ID, PARAM_ID2}},
+  {"sum_ranges", "SELECT SUM(k) FROM sbtest%u WHERE id BETWEEN ? AND ?", 2,
+   {PARAM_ID, PARAM_ID2}},
+  {"order_ranges",
+   "SELECT c FROM sbtest%u WHERE id BETWEEN ? AND ? ORDER BY c", 2,
+   {PARAM_ID, PARAM_ID2}},
+  {"distinct_ranges",
+   "SELECT DISTINCT c FROM sbtest%u WHERE id BETWEEN ? AND ? ORDER BY c", 2,
+   {PARAM_ID, PARAM_ID2}},
+  {"index_updates", "UPDATE sbtest%u SET k=k+1 WHERE id=?", 1, {PARAM_ID}},
+  {"non_index_updates", "UPDATE sbtest%u SET c=? WHERE id=?", 2,
+   {PARAM_C, PARAM_ID}},
+  {"deletes", "DELETE FROM sbtest%u WHERE id=?", 1, {PARAM_ID}},
+  {"inserts", "INSERT INTO sbtest%u (id, k, c, pad) VALUES (?, ?, ?, ?)", 4,
+   {PARAM_ID, PARAM_ID2, PARAM_C, PARAM_PAD}}
+};
+
+/* Scripts with native events */
+typedef enum
+{
+  SCRIPT_POINT_SELECT,
+  SCRIPT_READ_ONLY,
+  SCRIPT_READ_WRITE,
+  NSCRIPTS
+} oltp_script_t;
+
+static const char *script_names[NSCRIPTS] =
+{
+  "oltp_point_select", "oltp_read_only", "oltp_read_write"
+};
+
+/*
+  Options of oltp_common.lua changing events in ways not implemented here, with
+  the default values of string options
+*/
+static const struct
+{
+  const char    *name;
+  sb_arg_type_t type;
+  const char    *value;
+} unsupported_opts[] =
+{
+  {"k_ranges", SB_ARG_TYPE_DOUBLE, NULL},
+  {"k_in_lists", SB_ARG_TYPE_DOUBLE, NULL},
+  {"appends", SB_ARG_TYPE_DOUBLE, NULL},
+  {"tx_mix", SB_ARG_TYPE_STRING, ""},
+  {"align_ranges", SB_ARG_TYPE_BOOL, NULL},
+  {"batch", SB_ARG_TYPE_BOOL, NULL},
+  {"stmt_cache_size", SB_ARG_TYPE_DOUBLE, NULL},
+  {"reconnect_every", SB_ARG_TYPE_DOUBLE, NULL},
+  {"key_partitioning", SB_ARG_TYPE_STRING, "none"}
+};
+
+#define NUNSUPPORTED (sizeof(unsupported_opts) / sizeof(unsupported_opts[0]))
+
+/* Options of oltp_common.lua */
+static struct
+{
+  oltp_script_t script;
+  unsigned int  tables;
+  uint64_t      table_size;
+  uint64_t      range_size;
+  unsigned int  point_selects;
+  unsigned int  simple_ranges;
+  unsigned int  sum_ranges;
+  unsigned int  order_ranges;
+  unsigned int  distinct_ranges;
+  unsigned int  index_updates;
+  unsigned int  non_index_updates;
+  unsigned int  delete_inserts;
+  bool          range_selects;
+  bool          skip_trx;
+} opt;
+
+typedef struct
+{
+  db_driver_t   *drv;
+  db_conn_t     *con;
+  db_stmt_t     *begin;
+  db_stmt_t     *commit;
+  db_stmt_t     **stmts;                /* NSTMTS per table, prepared on
+                                           first use */
+  db_bind_t     binds[NPARAMS];
+  int64_t       ids[2];
+  char          c[C_MAX_LEN];
+  char          pad[PAD_MAX_LEN];
+  unsigned long c_len;
+  unsigned long pad_len;
+  unsigned long int_len;
+  char          not_null;
+} oltp_thread_t;
+
+static oltp_thread_t **threads;
+
+static sb_op_init *script_init;
+
+static int oltp_init(void);
+static int oltp_thread_init(int);
+static sb_event_t oltp_next_event(int);
+static int oltp_execute_event(sb_event_t *, int);
+static int oltp_thread_done(int);
+static int oltp_done(void);
+
+
+sb_test_t *sb_oltp_native(sb_test_t *test)
+{
+  char         *name = strdup(test->sname);
+  char         *ext;
+  unsigned int i;
+
+  if (name == NULL)
+    return NULL;
+
+  if ((ext = strrchr(name, '.')) != NULL && !strcmp(ext, ".lua"))
+    *ext = '\0';
+
+  for (i = 0; i < NSCRIPTS; i++)
+    if (!strcmp(name, script_names[i]))
+      break;
+
+  free(name);
+
+  if (i == NSCRIPTS)
+  {
+    log_text(LOG_FATAL, "--native is only supported with oltp_point_select, "
+             "oltp_read_only and oltp_read_write");
+    return NULL;
+  }
+
+  opt.script = i;
+
+  /* The script's init() still checks that it is run by a command */
+  script_init = test->ops.init;
+
+  test->ops.init = oltp_init;
+  test->ops.thread_init = oltp_thread_init;
+  test->ops.next_event = oltp_next_event;
+  test->ops.execute_event = oltp_execute_event;
+  test->ops.thread_done = oltp_thread_done;
+  test->ops.done = oltp_done;
+
+  /* Use the default event loop rather than thread_run() of sysbench.lua */
+  test->ops.thread_run = NULL;
+
+  return test;
+}
+
+
+/* Numeric options of Lua scripts are DOUBLE */
+
+static uint64_t opt_uint64(const char *name)
+{
+  const double value = sb_get_value_double(name);
+
+  return value > 0 ? (uint64_t) value : 0;
+}
+
+
+static unsigned int opt_uint(const char *name)
+{
+  return (unsigned int) opt_uint64(name);
+}
+
+
+/* Check if an option is used, i.e. is non-zero, on or not the default */
+
+static bool opt_used(unsigned int i)
+{
+  const char * const name = unsupported_opts[i].name;
+  const char         *value;
+
+  switch (unsupported_opts[i].type) {
+  case SB_ARG_TYPE_BOOL:
+    return sb_get_value_flag(name);
+  case SB_ARG_TYPE_DOUBLE:
+    return sb_get_value_double(name) != 0;
+  default:
+    value = sb_get_value_string(name);
+    return value != NULL && strcmp(value, unsupported_opts[i].value);
+  }
+}
+
+
+int oltp_init(void)
+{
+  if (script_init != NULL && script_init())
+    return 1;
+
+  for (unsigned int i = 0; i < NUNSUPPORTED; i++)
+  {
+    if (opt_used(i))
+    {
+      log_text(LOG_FATAL, "--native does not support --%s",
+               unsupported_opts[i].name);
+      return 1;
+    }
+  }
+
+  if (sb_globals.validate || sb_globals.virtual_users > 1)
+  {
+    log_text(LOG_FATAL, "--native cannot be used with --validate or "
+             "--virtual-users");
+    return 1;
+  }
+
+  opt.tables = opt_uint("tables");
+  opt.table_size = opt_uint64("table_size");
+  opt.range_size = opt_uint64("range_size");
+  opt.point_selects = opt_uint("point_selects");
+  opt.simple_ranges = opt_uint("simple_ranges");
+  opt.sum_ranges = opt_uint("sum_ranges");
+  opt.order_ranges = opt_uint("order_ranges");
+  opt.distinct_ranges = opt_uint("distinct_ranges");
+  opt.index_updates = opt_uint("index_updates");
+  opt.non_index_updates = opt_uint("non_index_updates");
+  opt.delete_inserts = opt_uint("delete_inserts");
+  opt.range_selects = sb_get_value_flag("range_selects");
+  opt.skip_trx = sb_get_value_flag("skip_trx");
+
+  if (opt.tables < 1 || opt.table_size < 1)
+  {
+    log_text(LOG_FATAL, "--native requires at least one table and row");
+    return 1;
+  }
+
+  /* oltp_point_select executes a single point select per event */
+  if (opt.script == SCRIPT_POINT_SELECT)
+  {
+    opt.point_selects = 1;
+    opt.range_selects = false;
+    opt.skip_trx = true;
+  }
+
+  threads = calloc(sb_globals.threads, sizeof(oltp_thread_t *));
+  if (threads == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  return 0;
+}
+
+
+static db_stmt_t *prepare_query(oltp_thread_t *t, const char *query,
+                                const char *label)
+{
+  db_stmt_t *stmt = db_prepare(t->con, query, strlen(query));
+
+  if (stmt == NULL)
+  {
+    log_text(LOG_FATAL, "Failed to prepare '%s'", query);
+    return NULL;
+  }
+
+  db_stmt_set_label(stmt, label);
+
+  return stmt;
+}
+
+
+/* Prepare BEGIN and COMMIT unless --skip_trx is used */
+
+static int prepare_trx(oltp_thread_t *t)
+{
+  if (opt.skip_trx)
+    return 0;
+
+  if ((t->begin = prepare_query(t, "BEGIN", "begin")) == NULL ||
+      (t->commit = prepare_query(t, "COMMIT", "commit")) == NULL)
+    return 1;
+
+  return 0;
+}
+
+
+/* Get a statement for a table, preparing it on first use */
+
+static db_stmt_t *get_stmt(oltp_thread_t *t, unsigned int tnum,
+                           oltp_stmt_t key)
+{
+  db_stmt_t **slot = &t->stmts[(tnum - 1) * NSTMTS + key];
+  db_bind_t binds[NPARAMS];
+  char      query[256];
+
+  if (SB_LIKELY(*slot != NULL))
+    return *slot;
+
+  snprintf(query, sizeof(query), stmt_defs[key].query, tnum);
+
+  if ((*slot = prepare_query(t, query, stmt_defs[key].label)) == NULL)
+    return NULL;
+
+  for (unsigned int i = 0; i < stmt_defs[key].nparams; i++)
+    binds[i] = t->binds[stmt_defs[key].params[i]];
+
+  if (db_bind_param(*slot, binds, stmt_defs[key].nparams))
+  {
+    log_text(LOG_FATAL, "Failed to bind parameters of '%s'", query);
+    return NULL;
+  }
+
+  return *slot;
+}
+
+
+static void close_statements(oltp_thread_t *t)
+{
+  for (unsigned int i = 0; i < opt.tables * NSTMTS; i++)
+  {
+    if (t->stmts[i] != NULL)
+      db_close(t->stmts[i]);
+    t->stmts[i] = NULL;
+  }
+
+  if (t->begin != NULL)
+    db_close(t->begin);
+  if (t->commit != NULL)
+    db_close(t->commit);
+
+  t->begin = t->commit = NULL;
+}
+
+
+int oltp_thread_init(int thread_id)
+{
+  oltp_thread_t *t = calloc(1, sizeof(oltp_thread_t));
+
+  if (t == NULL || (t->stmts = calloc(opt.tables * NSTMTS,
+                                      sizeof(db_stmt_t *))) == NULL)
+  {
+    free(t);
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  threads[thread_id] = t;
+
+  /* Integer parameters are bound as BIGINT as in sysbench.sql.lua */
+  t->int_len = sizeof(int64_t);
+  t->c_len = strlen(C_TEMPLATE);
+  t->pad_len = strlen(PAD_TEMPLATE);
+
+  for (unsigned int i = 0; i < 2; i++)
+    t->binds[PARAM_ID + i] = (db_bind_t) {
+      .type = DB_TYPE_BIGINT,
+      .buffer = &t->ids[i],
+      .data_len = &t->int_len,
+      .max_len = sizeof(int64_t),
+      .is_null = &t->not_null
+    };
+
+  t->binds[PARAM_C] = (db_bind_t) {
+    .type = DB_TYPE_VARCHAR,
+    .buffer = t->c,
+    .data_len = &t->c_len,
+    .max_len = C_MAX_LEN,
+    .is_null = &t->not_null
+  };
+
+  t->binds[PARAM_PAD] = (db_bind_t) {
+    .type = DB_TYPE_VARCHAR,
+    .buffer = t->pad,
+    .data_len = &t->pad_len,
+    .max_len = PAD_MAX_LEN,
+    .is_null = &t->not_null
+  };
+
+  if ((t->drv = db_create(NULL)) == NULL)
+    return 1;
+
+  if ((t->con = db_connection_create(t->drv)) == NULL)
+  {
+    log_text(LOG_FATAL, "connection creation failed");
+    return 1;
+  }
+
+  return prepare_trx(t);
+}
+
+
+sb_event_t oltp_next_event(int thread_id)
+{
+  sb_event_t req;
+
+  (void) thread_id; /* unused */
+
+  req.type = SB_REQ_TYPE_SQL;
+
+  return req;
+}
+
+
+static inline int64_t get_id(void)
+{
+  if (opt.table_size > UINT32_MAX)
+    return (int64_t) sb_rand_default64(1, opt.table_size);
+
+  return sb_rand_default(1, (uint32_t) opt.table_size);
+}
+
+
+static inline unsigned int get_table_num(void)
+{
+  return sb_rand_uniform(1, opt.tables);
+}
+
+
+/*
+  Check the result of a statement or a statement group. Returns 0 on success,
+  1 on ignorable errors and -1 on fatal errors.
+*/
+
+static int check_error(db_conn_t *con, db_result_t *rs)
+{
+  if (rs != NULL)
+    db_free_results(rs);
+
+  if (SB_LIKELY(con->error == DB_ERROR_NONE))
+    return 0;
+
+  if (con->error == DB_ERROR_IGNORABLE)
+    return 1;
+
+  if (con->sql_errmsg != NULL)
+    log_text(LOG_FATAL, "SQL error, errno = %d, state = '%s': %s",
+             con->sql_errno, con->sql_state != NULL ? con->sql_state : "",
+             con->sql_errmsg);
+  else
+    log_text(LOG_FATAL, "SQL API error");
+
+  return -1;
+}
+
+
+static inline int execute(db_stmt_t *stmt)
+{
+  return check_error(stmt->connection, db_execute(stmt));
+}
+
+
+/* SELECT statements of a group are pipelined if enabled in the driver */
+
+static int execute_selects(oltp_thread_t *t, oltp_stmt_t key, unsigned int n)
+{
+  db_stmt_t * const stmt = get_stmt(t, get_table_num(), key);
+  const bool        range = key != STMT_POINT_SELECTS;
+  int               rc;
+
+  if (stmt == NULL)
+    return -1;
+
+  if (db_pipeline_begin(t->con))
+    return check_error(t->con, NULL);
+
+  for (unsigned int i = 0; i < n; i++)
+  {
+    t->ids[0] = get_id();
+
+    if (range)
+      t->ids[1] = t->ids[0] + (int64_t) opt.range_size - 1;
+
+    if ((rc = execute(stmt)) != 0)
+      return rc;
+  }
+
+  db_pipeline_end(t->con);
+
+  return check_error(t->con, NULL);
+}
+
+
+static int execute_index_updates(oltp_thread_t *t)
+{
+  db_stmt_t * const stmt = get_stmt(t, get_table_num(), STMT_INDEX_UPDATES);
+  int               rc;
+
+  if (stmt == NULL)
+    return -1;
+
+  for (unsigned int i = 0; i < opt.index_updates; i++)
+  {
+    t->ids[0] = get_id();
+
+    if ((rc = execute(stmt)) != 0)
+      return rc;
+  }
+
+  return 0;
+}
+
+
+static int execute_non_index_updates(oltp_thread_t *t)
+{
+  db_stmt_t * const stmt = get_stmt(t, get_table_num(),
+                                    STMT_NON_INDEX_UPDATES);
+  int               rc;
+
+  if (stmt == NULL)
+    return -1;
+
+  for (unsigned int i = 0; i < opt.non_index_updates; i++)
+  {
+    sb_rand_str(C_TEMPLATE, t->c);
+    t->ids[0] = get_id();
+
+    if ((rc = execute(stmt)) != 0)
+      return rc;
+  }
+
+  return 0;
+}
+
+
+static int execute_delete_inserts(oltp_thread_t *t)
+{
+  const unsigned int tnum = get_table_num();
+  db_stmt_t * const  del = get_stmt(t, tnum, STMT_DELETES);
+  db_stmt_t * const  ins = get_stmt(t, tnum, STMT_INSERTS);
+  int                rc;
+
+  if (del == NULL || ins == NULL)
+    return -1;
+
+  for (unsigned int i = 0; i < opt.delete_inserts; i++)
+  {
+    t->ids[0] = get_id();
+    t->ids[1] = get_id();
+    sb_rand_str(C_TEMPLATE, t->c);
+    sb_rand_str(PAD_TEMPLATE, t->pad);
+
+    if ((rc = execute(del)) != 0 || (rc = execute(ins)) != 0)
+      return rc;
+  }
+
+  return 0;
+}
+
+
+/*
+  Execute a single transaction, see event() in the scripts. Returns 0 on
+  success, 1 on ignorable errors and -1 on fatal errors.
+*/
+
+static int execute_transaction(oltp_thread_t *t)
+{
+  int rc;
+
+  if (!opt.skip_trx && (rc = execute(t->begin)) != 0)
+    return rc;
+
+  if ((rc = execute_selects(t, STMT_POINT_SELECTS, opt.point_selects)) != 0)
+    return rc;
+
+  if (opt.range_selects &&
+      ((rc = execute_selects(t, STMT_SIMPLE_RANGES, opt.simple_ranges)) != 0 ||
+       (rc = execute_selects(t, STMT_SUM_RANGES, opt.sum_ranges)) != 0 ||
+       (rc = execute_selects(t, STMT_ORDER_RANGES, opt.order_ranges)) != 0 ||
+       (rc = execute_selects(t, STMT_DISTINCT_RANGES,
+                             opt.distinct_ranges)) != 0))
+    return rc;
+
+  if (opt.script == SCRIPT_READ_WRITE &&
+      ((rc = execute_index_updates(t)) != 0 ||
+       (rc = execute_non_index_updates(t)) != 0 ||
+       (rc = execute_delete_inserts(t)) != 0))
+    return rc;
+
+  if (!opt.skip_trx && (rc = execute(t->commit)) != 0)
+    return rc;
+
+  return 0;
+}
+
+
+/* Execute a transaction, restarting it on ignorable errors */
+
+int oltp_execute_event(sb_event_t *req, int thread_id)
+{
+  oltp_thread_t * const t = threads[thread_id];
+  int                   rc;
+
+  (void) req; /* unused */
+
+  for (unsigned int attempt = 1; ; attempt++)
+  {
+    if ((rc = execute_transaction(t)) <= 0)
+      return rc != 0;
+
+    /* Discard the rest of an interrupted statement group */
+    db_pipeline_end(t->con);
+
+    /*
+      Prepared statements are lost if the driver reconnected, see
+      before_restart_event() in oltp_common.lua
+    */
+    if (t->con->sql_errno == 2013 || /* CR_SERVER_LOST */
+        t->con->sql_errno == 2055 || /* CR_SERVER_LOST_EXTENDED */
+        t->con->sql_errno == 2006 || /* CR_SERVER_GONE_ERROR */
+        t->con->sql_errno == 2011)   /* CR_TCP_CONNECTION */
+    {
+      close_statements(t);
+
+      if (prepare_trx(t))
+        return 1;
+    }
+
+    if (!db_retry_wait(thread_id, attempt))
+    {
+      log_text(LOG_FATAL, "event failed after %u attempt(s) "
+               "(--db-retry-max), last error: %s", attempt,
+               t->con->sql_errmsg != NULL ? t->con->sql_errmsg : "unknown");
+      return 1;
+    }
+  }
+}
+
+
+int oltp_thread_done(int thread_id)
+{
+  oltp_thread_t * const t = threads[thread_id];
+
+  if (t == NULL)
+    return 0;
+
+  if (t->con != NULL)
+  {
+    close_statements(t);
+    db_connection_close(t->con);
+    db_connection_free(t->con);
+  }
+
+  if (t->drv != NULL)
+    db_destroy(t->drv);
+
+  free(t->stmts);
+  free(t);
+  threads[thread_id] = NULL;
+
+  return 0;
+}
+
+
+int oltp_done(void)
+{
+  free(threads);
+  threads = NULL;
+
+  return 0;
+}
@@ -0,0 +1,38 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Native implementation of the core OLTP scripts, see --native */
+
+#ifndef SB_OLTP_H
+#define SB_OLTP_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "sysbench.h"
+
+/*
+  Replace the event operations of a loaded oltp_point_select, oltp_read_only
+  or oltp_read_write script with native ones executing the same queries. The
+  script still defines the options and the commands other than 'run'. Returns
+  the test, or NULL if the script has no native implementation.
+*/
+sb_test_t *sb_oltp_native(sb_test_t *test);
+
+#endif /* SB_OLTP_H */
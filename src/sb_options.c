@@ -275,52 +275,66 @@ int sb_get_value_int(const char *name)
 }
 
 
-unsigned long long sb_opt_to_size(option_t *opt)
+/*
+  Parse a size with an optional K/M/G/T modifier at the start of str.
+  Characters after the modifier are ignored. Returns 0 on an unknown modifier.
+*/
+
+unsigned long long sb_parse_size(const char *str)
 {
-  value_t             *val;
-  sb_list_item_t      *pos;
   unsigned long long  res = 0;
   char                mult = 0;
   int                 rc;
   unsigned int        i, n;
-  char                *c;
+  const char          *c;
 
-  SB_LIST_ONCE(pos, &opt->values)
+  /*
+   * Reimplentation of sscanf(str, "%llu%c", &res, &mult), since
+   * there is no standard on how to specify long long values
+   */
+  for (rc = 0, c = str; *c != '\0'; c++)
   {
-    val = SB_LIST_ENTRY(pos, value_t, listitem);
-    /*
-     * Reimplentation of sscanf(val->data, "%llu%c", &res, &mult), since
-     * there is no standard on how to specify long long values
-     */
-    res = 0;
-    for (rc = 0, c = val->data; *c != '\0'; c++)
+    if (*c < '0' || *c > '9')
     {
-      if (*c < '0' || *c > '9')
+      if (rc == 1)
       {
-        if (rc == 1)
-        {
-          rc = 2;
-          mult = *c;
-        }
-        break;
+        rc = 2;
+        mult = *c;
       }
-      rc = 1;
-      res = res * 10 + *c - '0';
+      break;
     }
+    rc = 1;
+    res = res * 10 + *c - '0';
+  }
 
-    if (rc == 2)
+  if (rc == 2)
+  {
+    for (n = 0; sizemods[n] != '\0'; n++)
+      if (toupper(mult) == sizemods[n])
+        break;
+    if (sizemods[n] != '\0')
     {
-      for (n = 0; sizemods[n] != '\0'; n++)
-        if (toupper(mult) == sizemods[n])
-          break;
-      if (sizemods[n] != '\0')
-      {
-        for (i = 0; i <= n; i++)
-          res *= 1024;
-      }
-      else
-        res = 0; /* Unknown size modifier */
+      for (i = 0; i <= n; i++)
+        res *= 1024;
     }
+    else
+      res = 0; /* Unknown size modifier */
+  }
+
+  return res;
+}
+
+
+unsigned long long sb_opt_to_size(option_t *opt)
+{
+  value_t             *val;
+  sb_list_item_t      *pos;
+  unsigned long long  res = 0;
+
+  SB_LIST_ONCE(pos, &opt->values)
+  {
+    val = SB_LIST_ENTRY(pos, value_t, listitem);
+    res = sb_parse_size(val->data);
   }
 
   return res;
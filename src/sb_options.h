@@ -119,6 +119,8 @@ int sb_opt_to_int(option_t *);
 
 unsigned long long sb_opt_to_size(option_t *);
 
+unsigned long long sb_parse_size(const char *);
+
 double sb_opt_to_double(option_t *);
 
 char *sb_opt_to_string(option_t *);
@@ -0,0 +1,384 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Hardware performance counters for worker threads. Each worker thread opens
+  a perf_event_open() group with all supported counters, so they are scheduled
+  on the PMU together. Reporting threads read groups of all workers, values of
+  groups closed by finished threads are accumulated in per-thread slots.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+#if defined(HAVE_LINUX_PERF_EVENT_H) && defined(HAVE_SYS_SYSCALL_H)
+# include <linux/perf_event.h>
+# include <sys/syscall.h>
+# include <sys/ioctl.h>
+# define SB_PERF_SUPPORTED 1
+#endif
+
+#include "sb_perf.h"
+#include "sysbench.h"
+
+static const char *perf_names[SB_PERF_MAX] =
+{
+  "cycles", "instructions", "LLC misses", "branch misses", "dTLB misses"
+};
+
+typedef struct
+{
+  pthread_mutex_t    lock;      /* protects fds from concurrent readers */
+  int                fd[SB_PERF_MAX];
+  uint64_t           id[SB_PERF_MAX];
+  int                leader;    /* group leader fd, -1 if closed */
+  sb_perf_counters_t done;      /* values of previously closed groups */
+} sb_perf_thread_t;
+
+static bool             perf_enabled;
+static bool             perf_user_only;
+static bool             perf_available[SB_PERF_MAX];
+
+static sb_perf_thread_t *perf_threads;
+static unsigned int     perf_nthreads;
+
+static sb_perf_counters_t last_intermediate;
+static sb_perf_counters_t last_cumulative;
+
+#ifdef SB_PERF_SUPPORTED
+
+#define CACHE_READ_MISS(cache)                                          \
+  ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) |                       \
+   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+  uint32_t type;
+  uint64_t config;
+} perf_events[SB_PERF_MAX] =
+{
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL) },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+  { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB) }
+};
+
+/* Open a counter for the calling thread, the group leader if group_fd is -1 */
+
+static int perf_open(sb_perf_type_t type, int group_fd, bool user_only)
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = perf_events[type].type;
+  attr.config = perf_events[type].config;
+  attr.disabled = group_fd == -1;
+  attr.exclude_kernel = user_only;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+    PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return (int) syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+
+static void perf_close(sb_perf_thread_t *t)
+{
+  for (int i = 0; i < SB_PERF_MAX; i++)
+  {
+    if (t->fd[i] >= 0)
+      close(t->fd[i]);
+    t->fd[i] = -1;
+  }
+
+  t->leader = -1;
+}
+
+
+/*
+  Read current counter values of a thread into 'val', scaled if the group was
+  multiplexed with other events. Must be called with the thread lock held.
+*/
+
+static void perf_read(sb_perf_thread_t *t, sb_perf_counters_t val)
+{
+  uint64_t buf[3 + 2 * SB_PERF_MAX];
+  double   scale = 1;
+
+  memcpy(val, t->done, sizeof(sb_perf_counters_t));
+
+  if (t->leader < 0 || read(t->leader, buf, sizeof(buf)) <= 0)
+    return;
+
+  /* buf: nr, time_enabled, time_running, then nr { value, id } pairs */
+  if (buf[2] == 0)
+    return;
+  if (buf[2] < buf[1])
+    scale = (double) buf[1] / buf[2];
+
+  for (uint64_t n = 0; n < buf[0] && n < SB_PERF_MAX; n++)
+    for (int i = 0; i < SB_PERF_MAX; i++)
+      if (t->fd[i] >= 0 && t->id[i] == buf[4 + 2 * n])
+        val[i] += (uint64_t) (buf[3 + 2 * n] * scale);
+}
+
+#endif /* SB_PERF_SUPPORTED */
+
+
+int sb_perf_init(void)
+{
+  perf_enabled = sb_get_value_flag("perf-counters");
+
+  if (!perf_enabled)
+    return 0;
+
+#ifdef SB_PERF_SUPPORTED
+  bool any = false;
+
+  /* Probe which counters can be opened for the calling thread */
+  for (int i = 0; i < SB_PERF_MAX; i++)
+  {
+    int fd = perf_open(i, -1, perf_user_only);
+
+    if (fd < 0 && (errno == EACCES || errno == EPERM) && !perf_user_only)
+    {
+      /* Kernel-mode events are not allowed by kernel.perf_event_paranoid */
+      perf_user_only = true;
+      fd = perf_open(i, -1, perf_user_only);
+    }
+
+    if (fd < 0)
+    {
+      if (errno == EACCES || errno == EPERM)
+      {
+        log_errno(LOG_FATAL, "perf_event_open() failed, check "
+                  "/proc/sys/kernel/perf_event_paranoid");
+        return 1;
+      }
+
+      log_text(LOG_WARNING, "The '%s' hardware counter is not supported",
+               perf_names[i]);
+      continue;
+    }
+
+    close(fd);
+    perf_available[i] = true;
+    any = true;
+  }
+
+  if (!any)
+  {
+    log_text(LOG_FATAL, "No hardware performance counters are available");
+    return 1;
+  }
+
+  perf_nthreads = sb_globals.threads;
+  perf_threads = calloc(perf_nthreads, sizeof(sb_perf_thread_t));
+  if (perf_threads == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  for (unsigned int i = 0; i < perf_nthreads; i++)
+  {
+    pthread_mutex_init(&perf_threads[i].lock, NULL);
+    for (int j = 0; j < SB_PERF_MAX; j++)
+      perf_threads[i].fd[j] = -1;
+    perf_threads[i].leader = -1;
+  }
+
+  return 0;
+#else
+  log_text(LOG_FATAL, "--perf-counters is not supported on this platform");
+  return 1;
+#endif
+}
+
+
+void sb_perf_done(void)
+{
+  if (perf_threads == NULL)
+    return;
+
+  for (unsigned int i = 0; i < perf_nthreads; i++)
+    pthread_mutex_destroy(&perf_threads[i].lock);
+
+  free(perf_threads);
+  perf_threads = NULL;
+}
+
+
+bool sb_perf_enabled(void)
+{
+  return perf_enabled;
+}
+
+
+bool sb_perf_available(sb_perf_type_t type)
+{
+  return perf_enabled && perf_available[type];
+}
+
+
+bool sb_perf_user_only(void)
+{
+  return perf_user_only;
+}
+
+
+const char *sb_perf_name(sb_perf_type_t type)
+{
+  return perf_names[type];
+}
+
+
+int sb_perf_thread_start(int thread_id)
+{
+#ifdef SB_PERF_SUPPORTED
+  if (!perf_enabled)
+    return 0;
+
+  sb_perf_thread_t * const t = &perf_threads[thread_id];
+  int rc = 0;
+
+  pthread_mutex_lock(&t->lock);
+
+  for (int i = 0; i < SB_PERF_MAX && rc == 0; i++)
+  {
+    if (!perf_available[i])
+      continue;
+
+    t->fd[i] = perf_open(i, t->leader, perf_user_only);
+    if (t->fd[i] < 0 || ioctl(t->fd[i], PERF_EVENT_IOC_ID, &t->id[i]))
+    {
+      log_errno(LOG_FATAL, "perf_event_open() failed for the '%s' counter",
+                perf_names[i]);
+      rc = 1;
+    }
+    else if (t->leader < 0)
+      t->leader = t->fd[i];
+  }
+
+  if (rc != 0)
+    perf_close(t);
+
+  pthread_mutex_unlock(&t->lock);
+
+  return rc;
+#else
+  (void) thread_id; /* unused */
+
+  return 0;
+#endif
+}
+
+
+void sb_perf_thread_enable(int thread_id)
+{
+#ifdef SB_PERF_SUPPORTED
+  if (perf_enabled && perf_threads[thread_id].leader >= 0)
+    ioctl(perf_threads[thread_id].leader, PERF_EVENT_IOC_ENABLE,
+          PERF_IOC_FLAG_GROUP);
+#else
+  (void) thread_id; /* unused */
+#endif
+}
+
+
+void sb_perf_thread_stop(int thread_id)
+{
+#ifdef SB_PERF_SUPPORTED
+  if (!perf_enabled)
+    return;
+
+  sb_perf_thread_t * const t = &perf_threads[thread_id];
+
+  pthread_mutex_lock(&t->lock);
+
+  perf_read(t, t->done);
+  perf_close(t);
+
+  pthread_mutex_unlock(&t->lock);
+#else
+  (void) thread_id; /* unused */
+#endif
+}
+
+
+/* Aggregate values and return the difference with a previous checkpoint */
+
+static void perf_agg(sb_perf_counters_t val, sb_perf_counters_t cp)
+{
+  memset(val, 0, sizeof(sb_perf_counters_t));
+
+#ifdef SB_PERF_SUPPORTED
+  if (!perf_enabled)
+    return;
+
+  for (unsigned int i = 0; i < perf_nthreads; i++)
+  {
+    sb_perf_counters_t tmp;
+
+    pthread_mutex_lock(&perf_threads[i].lock);
+    perf_read(&perf_threads[i], tmp);
+    pthread_mutex_unlock(&perf_threads[i].lock);
+
+    for (int j = 0; j < SB_PERF_MAX; j++)
+      val[j] += tmp[j];
+  }
+
+  for (int i = 0; i < SB_PERF_MAX; i++)
+  {
+    const uint64_t prev = cp[i];
+
+    cp[i] = val[i];
+    /* Scaled estimates of multiplexed groups are not strictly monotonic */
+    val[i] = val[i] > prev ? val[i] - prev : 0;
+  }
+#else
+  (void) cp; /* unused */
+#endif
+}
+
+
+void sb_perf_agg_intermediate(sb_perf_counters_t val)
+{
+  perf_agg(val, last_intermediate);
+}
+
+
+void sb_perf_agg_cumulative(sb_perf_counters_t val)
+{
+  perf_agg(val, last_cumulative);
+}
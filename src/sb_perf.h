@@ -0,0 +1,80 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Hardware performance counters for worker threads, see --perf-counters */
+
+#ifndef SB_PERF_H
+#define SB_PERF_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+  SB_PERF_CYCLES,
+  SB_PERF_INSTRUCTIONS,
+  SB_PERF_LLC_MISSES,
+  SB_PERF_BRANCH_MISSES,
+  SB_PERF_DTLB_MISSES,
+  SB_PERF_MAX
+} sb_perf_type_t;
+
+typedef uint64_t sb_perf_counters_t[SB_PERF_MAX];
+
+/*
+  Parse --perf-counters and check which counters are supported. Must be called
+  after the number of threads is known. Returns 0 on success.
+*/
+int sb_perf_init(void);
+
+void sb_perf_done(void);
+
+/* Whether counters are collected */
+bool sb_perf_enabled(void);
+
+/* Whether a specific counter is supported and collected */
+bool sb_perf_available(sb_perf_type_t type);
+
+/* Whether kernel-mode events are excluded due to insufficient privileges */
+bool sb_perf_user_only(void);
+
+/* Human-readable counter name */
+const char *sb_perf_name(sb_perf_type_t type);
+
+/*
+  Open counters for the calling worker thread. They start counting when
+  sb_perf_thread_enable() is called. Returns 0 on success.
+*/
+int sb_perf_thread_start(int thread_id);
+void sb_perf_thread_enable(int thread_id);
+
+/* Record final counter values for the calling thread and close counters */
+void sb_perf_thread_stop(int thread_id);
+
+/*
+  Return aggregate counter values since the last intermediate or cumulative
+  report respectively. Like sb_counters_agg_*(), these are not thread-safe and
+  must be called from a single thread.
+*/
+void sb_perf_agg_intermediate(sb_perf_counters_t val);
+void sb_perf_agg_cumulative(sb_perf_counters_t val);
+
+#endif /* SB_PERF_H */
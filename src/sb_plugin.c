@@ -0,0 +1,401 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Native test plugins. A plugin test is translated into a regular sb_test_t
+  whose events call the plugin's 'event' callback, so plugins run in the same
+  event loop as built-in tests. The sb_plugin_*() functions of the plugin ABI
+  are thin wrappers around the internal APIs, which may change without
+  breaking plugins.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#ifdef HAVE_DLFCN_H
+# include <dlfcn.h>
+#endif
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "sb_plugin.h"
+#include "sysbench_plugin.h"
+#include "sb_options.h"
+#include "sb_logger.h"
+#include "sb_rand.h"
+#include "sb_user_stats.h"
+#include "db_driver.h"
+
+#define PLUGIN_SUFFIX ".so"
+
+static void             *handle;
+static sb_plugin_test_t *plugin;
+static sb_arg_t         *plugin_args;
+
+static sb_event_t plugin_next_event(int);
+static int plugin_execute_event(sb_event_t *, int);
+
+static sb_test_t plugin_test =
+{
+  .ops = {
+    .next_event = plugin_next_event,
+    .execute_event = plugin_execute_event
+  }
+};
+
+
+bool sb_plugin_name(const char *name)
+{
+  const size_t len = strlen(name);
+
+  return len > strlen(PLUGIN_SUFFIX) &&
+    !strcmp(name + len - strlen(PLUGIN_SUFFIX), PLUGIN_SUFFIX);
+}
+
+
+/* Convert plugin options to the internal representation */
+
+static int convert_args(const sb_plugin_arg_t *args)
+{
+  size_t n = 0;
+
+  while (args != NULL && args[n].name != NULL)
+    n++;
+
+  /* Zeroed, so the last element is SB_OPT_END */
+  plugin_args = calloc(n + 1, sizeof(sb_arg_t));
+  if (plugin_args == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  for (size_t i = 0; i < n; i++)
+  {
+    sb_arg_t *arg = &plugin_args[i];
+
+    arg->name = args[i].name;
+    arg->desc = args[i].desc != NULL ? args[i].desc : "";
+    arg->value = args[i].value;
+
+    switch (args[i].type) {
+    case SB_PLUGIN_ARG_BOOL:
+      arg->type = SB_ARG_TYPE_BOOL;
+      break;
+    case SB_PLUGIN_ARG_INT:
+      arg->type = SB_ARG_TYPE_INT;
+      break;
+    case SB_PLUGIN_ARG_SIZE:
+      arg->type = SB_ARG_TYPE_SIZE;
+      break;
+    case SB_PLUGIN_ARG_DOUBLE:
+      arg->type = SB_ARG_TYPE_DOUBLE;
+      break;
+    case SB_PLUGIN_ARG_STRING:
+      arg->type = SB_ARG_TYPE_STRING;
+      break;
+    default:
+      log_text(LOG_FATAL, "Invalid type of plugin option '%s': %d",
+               args[i].name, (int) args[i].type);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+sb_test_t *sb_plugin_load(const char *path)
+{
+#ifdef HAVE_DLFCN_H
+  char *file = NULL;
+
+  /* dlopen() searches the library path for names without slashes */
+  if (strchr(path, '/') == NULL)
+  {
+    file = malloc(strlen(path) + 3);
+    if (file == NULL)
+      return NULL;
+    sprintf(file, "./%s", path);
+  }
+
+  handle = dlopen(file != NULL ? file : path, RTLD_NOW | RTLD_LOCAL);
+  free(file);
+
+  if (handle == NULL)
+  {
+    log_text(LOG_FATAL, "Cannot load plugin '%s': %s", path, dlerror());
+    return NULL;
+  }
+
+  plugin = dlsym(handle, SB_PLUGIN_SYMBOL);
+  if (plugin == NULL)
+  {
+    log_text(LOG_FATAL, "Plugin '%s' does not define '%s'", path,
+             SB_PLUGIN_SYMBOL);
+    return NULL;
+  }
+
+  if (plugin->abi_version != SB_PLUGIN_ABI_VERSION)
+  {
+    log_text(LOG_FATAL, "Plugin '%s' was built for plugin ABI version %u, "
+             "but this sysbench version supports %u", path,
+             plugin->abi_version, SB_PLUGIN_ABI_VERSION);
+    return NULL;
+  }
+
+  if (plugin->event == NULL)
+  {
+    log_text(LOG_FATAL, "Plugin '%s' does not define an event callback",
+             path);
+    return NULL;
+  }
+
+  if (convert_args(plugin->args))
+    return NULL;
+
+  plugin_test.sname = plugin->name != NULL ? plugin->name : path;
+  plugin_test.lname = plugin->description != NULL ? plugin->description :
+    plugin_test.sname;
+  plugin_test.args = plugin_args;
+
+  plugin_test.ops.init = plugin->init;
+  plugin_test.ops.print_mode = plugin->print_mode;
+  plugin_test.ops.thread_init = plugin->thread_init;
+  plugin_test.ops.thread_done = plugin->thread_done;
+  plugin_test.ops.done = plugin->done;
+
+  plugin_test.builtin_cmds.prepare = plugin->prepare;
+  plugin_test.builtin_cmds.cleanup = plugin->cleanup;
+
+  return &plugin_test;
+#else
+  log_text(LOG_FATAL, "Cannot load plugin '%s': plugins are not supported on "
+           "this platform", path);
+  return NULL;
+#endif
+}
+
+
+void sb_plugin_done(void)
+{
+#ifdef HAVE_DLFCN_H
+  if (handle != NULL)
+    dlclose(handle);
+#endif
+
+  handle = NULL;
+  plugin = NULL;
+
+  free(plugin_args);
+  plugin_args = NULL;
+}
+
+
+sb_event_t plugin_next_event(int thread_id)
+{
+  sb_event_t req;
+
+  (void) thread_id; /* unused */
+
+  req.type = SB_REQ_TYPE_PLUGIN;
+
+  return req;
+}
+
+
+int plugin_execute_event(sb_event_t *req, int thread_id)
+{
+  (void) req; /* unused */
+
+  return plugin->event(thread_id);
+}
+
+
+/* Plugin ABI */
+
+bool sb_plugin_opt_bool(const char *name)
+{
+  return sb_get_value_flag(name);
+}
+
+
+int sb_plugin_opt_int(const char *name)
+{
+  return sb_get_value_int(name);
+}
+
+
+unsigned long long sb_plugin_opt_size(const char *name)
+{
+  return sb_get_value_size(name);
+}
+
+
+double sb_plugin_opt_double(const char *name)
+{
+  return sb_get_value_double(name);
+}
+
+
+const char *sb_plugin_opt_string(const char *name)
+{
+  return sb_get_value_string(name);
+}
+
+
+unsigned int sb_plugin_threads(void)
+{
+  return sb_globals.threads;
+}
+
+
+void sb_plugin_log(const char *fmt, ...)
+{
+  char    buf[4096];
+  va_list ap;
+
+  va_start(ap, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+
+  log_text(LOG_NOTICE, "%s", buf);
+}
+
+
+void sb_plugin_log_fatal(const char *fmt, ...)
+{
+  char    buf[4096];
+  va_list ap;
+
+  va_start(ap, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+
+  log_text(LOG_FATAL, "%s", buf);
+}
+
+
+int sb_plugin_counter(const char *name)
+{
+  return sb_user_counter_register(name);
+}
+
+
+void sb_plugin_counter_add(int thread_id, int counter, uint64_t value)
+{
+  sb_user_counter_add(thread_id, counter, value);
+}
+
+
+sb_plugin_histogram_t *sb_plugin_histogram(const char *name)
+{
+  return (sb_plugin_histogram_t *) sb_user_histogram_register(name);
+}
+
+
+void sb_plugin_histogram_update(sb_plugin_histogram_t *h, double value)
+{
+  sb_histogram_update((sb_histogram_t *) h, value);
+}
+
+
+uint32_t sb_plugin_rand_default(uint32_t a, uint32_t b)
+{
+  return sb_rand_default(a, b);
+}
+
+
+uint32_t sb_plugin_rand_uniform(uint32_t a, uint32_t b)
+{
+  return sb_rand_uniform(a, b);
+}
+
+
+uint64_t sb_plugin_rand_uint64(void)
+{
+  return sb_rand_uniform_uint64();
+}
+
+
+double sb_plugin_rand_double(void)
+{
+  return sb_rand_uniform_double();
+}
+
+
+sb_plugin_db_conn_t *sb_plugin_db_connect(void)
+{
+  db_driver_t *drv = db_create(NULL);
+  db_conn_t   *con;
+
+  if (drv == NULL)
+    return NULL;
+
+  con = db_connection_create(drv);
+  if (con == NULL)
+  {
+    db_destroy(drv);
+    return NULL;
+  }
+
+  return (sb_plugin_db_conn_t *) con;
+}
+
+
+int sb_plugin_db_query(sb_plugin_db_conn_t *pcon, const char *query,
+                       uint64_t *nrows)
+{
+  db_conn_t   *con = (db_conn_t *) pcon;
+  db_result_t *rs = db_query(con, query, strlen(query));
+
+  if (rs == NULL && con->error != DB_ERROR_NONE)
+    return con->error == DB_ERROR_IGNORABLE ? 1 : -1;
+
+  /* Affected rows are also in con->rs for queries without results */
+  if (nrows != NULL)
+    *nrows = con->rs.nrows;
+
+  if (rs != NULL)
+    db_free_results(rs);
+
+  return 0;
+}
+
+
+void sb_plugin_db_disconnect(sb_plugin_db_conn_t *pcon)
+{
+  db_conn_t   *con = (db_conn_t *) pcon;
+  db_driver_t *drv;
+
+  if (con == NULL)
+    return;
+
+  drv = con->driver;
+
+  db_connection_close(con);
+  db_connection_free(con);
+  db_destroy(drv);
+}
@@ -0,0 +1,43 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Loading of native test plugins, see sysbench_plugin.h for their ABI */
+
+#ifndef SB_PLUGIN_H
+#define SB_PLUGIN_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+
+#include "sysbench.h"
+
+/* Return true if a test name refers to a plugin, i.e. ends with '.so' */
+bool sb_plugin_name(const char *name);
+
+/*
+  Load a plugin from a given path and return its test, or NULL on errors. Only
+  one plugin can be loaded.
+*/
+sb_test_t *sb_plugin_load(const char *path);
+
+void sb_plugin_done(void);
+
+#endif /* SB_PLUGIN_H */
@@ -0,0 +1,444 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Host pressure sampling. Each sample reads cumulative counters, and reports
+  show their differences between two samples:
+
+  - stall time of /proc/pressure/{cpu,memory,io} ("some" lines, i.e. time at
+    least one task was stalled), as a share of wall time;
+  - CPU quota throttling from cpu.stat of the cgroup of sysbench (cgroup v2 or
+    the v1 'cpu' controller), as throttled periods and time;
+  - steal time from /proc/stat, as a share of total CPU time.
+
+  Samples are taken by the reporting thread when intermediate reports are
+  printed, and by the main thread at the start and the end of a run. Missing
+  sources, e.g. on kernels without PSI, are silently skipped.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_STDIO_H
+# include <stdio.h>
+#endif
+#include <inttypes.h>
+
+#include "sb_pressure.h"
+#include "sysbench.h"
+#include "sb_usage.h"
+
+/* Flag intervals and runs with more steal time than this share of CPU time */
+#define STEAL_WARN_PCT 1.0
+
+#define CGROUP_PATH_MAX 4096
+
+typedef enum
+{
+  PSI_CPU,
+  PSI_MEMORY,
+  PSI_IO,
+  PSI_MAX
+} psi_resource_t;
+
+static const char *psi_names[PSI_MAX] = {"cpu", "memory", "io"};
+
+typedef struct
+{
+  uint64_t time_ns;
+  uint64_t psi_us[PSI_MAX];     /* total "some" stall time */
+  uint64_t nr_periods;
+  uint64_t nr_throttled;
+  uint64_t throttled_ns;
+  uint64_t cpu_total;           /* /proc/stat ticks */
+  uint64_t cpu_steal;
+} sample_t;
+
+static bool pressure_enabled;
+
+static bool psi_available[PSI_MAX];
+static bool stat_available;
+static char cpu_stat_path[CGROUP_PATH_MAX];  /* empty if not found */
+
+static sample_t run_start;
+static sample_t run_stop;
+static sample_t last_report;
+
+
+/* Read the total "some" stall time from a PSI file */
+
+static bool read_psi(psi_resource_t res, uint64_t *total)
+{
+  char               path[64];
+  FILE               *fp;
+  unsigned long long val;
+  bool               found = false;
+
+  snprintf(path, sizeof(path), "/proc/pressure/%s", psi_names[res]);
+
+  if ((fp = fopen(path, "r")) == NULL)
+    return false;
+
+  if (fscanf(fp, "some avg10=%*f avg60=%*f avg300=%*f total=%llu", &val) == 1)
+  {
+    *total = val;
+    found = true;
+  }
+
+  fclose(fp);
+
+  return found;
+}
+
+
+/*
+  Read a cgroup cpu.stat file. Returns false if it cannot be read or has no
+  throttling statistics, e.g. for the root cgroup.
+*/
+
+static bool read_cpu_stat(const char *path, sample_t *s)
+{
+  FILE               *fp;
+  char               key[64];
+  unsigned long long val;
+  bool               found = false;
+
+  if ((fp = fopen(path, "r")) == NULL)
+    return false;
+
+  while (fscanf(fp, "%63s %llu", key, &val) == 2)
+  {
+    if (!strcmp(key, "nr_periods"))
+      s->nr_periods = val;
+    else if (!strcmp(key, "nr_throttled"))
+    {
+      s->nr_throttled = val;
+      found = true;
+    }
+    else if (!strcmp(key, "throttled_usec"))    /* cgroup v2 */
+      s->throttled_ns = val * 1000;
+    else if (!strcmp(key, "throttled_time"))    /* cgroup v1 */
+      s->throttled_ns = val;
+  }
+
+  fclose(fp);
+
+  return found;
+}
+
+
+/* Read total and steal CPU time from the first line of /proc/stat */
+
+static bool read_proc_stat(sample_t *s)
+{
+  FILE               *fp;
+  unsigned long long v[8];
+  bool               found = false;
+
+  if ((fp = fopen("/proc/stat", "r")) == NULL)
+    return false;
+
+  if (fscanf(fp, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &v[0], &v[1],
+             &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) == 8)
+  {
+    s->cpu_total = 0;
+    for (int i = 0; i < 8; i++)
+      s->cpu_total += v[i];
+    s->cpu_steal = v[7];
+    found = true;
+  }
+
+  fclose(fp);
+
+  return found;
+}
+
+
+/*
+  Look for cpu.stat with throttling statistics in a cgroup hierarchy mounted at
+  'root', starting from the cgroup of sysbench and going up. The cgroup itself
+  may not be visible in a container with a private cgroup namespace, in which
+  case the hierarchy root is the cgroup of the container.
+*/
+
+static bool find_cpu_stat(const char *root, const char *cgroup)
+{
+  char     dir[CGROUP_PATH_MAX];
+  char     *slash;
+  sample_t s;
+
+  snprintf(dir, sizeof(dir), "%s", cgroup);
+
+  for (;;)
+  {
+    const int len = snprintf(cpu_stat_path, sizeof(cpu_stat_path),
+                             "%s%s/cpu.stat", root, strcmp(dir, "/") ? dir : "");
+
+    if (len < (int) sizeof(cpu_stat_path) && read_cpu_stat(cpu_stat_path, &s))
+      return true;
+
+    if ((slash = strrchr(dir, '/')) == NULL || slash == dir)
+    {
+      if (!strcmp(dir, "/"))
+        break;
+      strcpy(dir, "/");
+    }
+    else
+      *slash = '\0';
+  }
+
+  cpu_stat_path[0] = '\0';
+
+  return false;
+}
+
+
+/* Find cpu.stat of the cgroup of sysbench from /proc/self/cgroup */
+
+static void find_cgroup(void)
+{
+  static const char *v1_roots[] =
+    {"/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct", NULL};
+  static const char *v2_roots[] =
+    {"/sys/fs/cgroup", "/sys/fs/cgroup/unified", NULL};
+  FILE *fp;
+  char line[CGROUP_PATH_MAX];
+
+  if ((fp = fopen("/proc/self/cgroup", "r")) == NULL)
+    return;
+
+  /* Lines are in the form hierarchy-ID:controller-list:cgroup-path */
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    char       *controllers = strchr(line, ':');
+    char       *path;
+    const char **roots = NULL;
+
+    if (controllers == NULL ||
+        (path = strchr(++controllers, ':')) == NULL)
+      continue;
+
+    *path++ = '\0';
+    path[strcspn(path, "\n")] = '\0';
+
+    if (*controllers == '\0')
+      roots = v2_roots;
+    else
+    {
+      char *save;
+
+      for (char *c = strtok_r(controllers, ",", &save); c != NULL;
+           c = strtok_r(NULL, ",", &save))
+        if (!strcmp(c, "cpu"))
+          roots = v1_roots;
+    }
+
+    for (; roots != NULL && *roots != NULL; roots++)
+      if (find_cpu_stat(*roots, path))
+        goto end;
+  }
+
+ end:
+  fclose(fp);
+}
+
+
+int sb_pressure_init(void)
+{
+  uint64_t tmp;
+  sample_t s;
+
+  pressure_enabled = sb_get_value_flag("host-pressure");
+
+  if (!pressure_enabled)
+    return 0;
+
+  for (int i = 0; i < PSI_MAX; i++)
+    psi_available[i] = read_psi(i, &tmp);
+
+  stat_available = read_proc_stat(&s);
+
+  find_cgroup();
+
+  log_text(LOG_DEBUG, "Host pressure sources: PSI %s/%s/%s, cgroup %s, "
+           "/proc/stat %s",
+           psi_available[PSI_CPU] ? "cpu" : "-",
+           psi_available[PSI_MEMORY] ? "memory" : "-",
+           psi_available[PSI_IO] ? "io" : "-",
+           cpu_stat_path[0] != '\0' ? cpu_stat_path : "not found",
+           stat_available ? "yes" : "no");
+
+  return 0;
+}
+
+
+bool sb_pressure_enabled(void)
+{
+  return pressure_enabled;
+}
+
+
+static void take_sample(sample_t *s)
+{
+  memset(s, 0, sizeof(*s));
+
+  s->time_ns = sb_usage_clock();
+
+  for (int i = 0; i < PSI_MAX; i++)
+    if (psi_available[i])
+      read_psi(i, &s->psi_us[i]);
+
+  if (cpu_stat_path[0] != '\0')
+    read_cpu_stat(cpu_stat_path, s);
+
+  if (stat_available)
+    read_proc_stat(s);
+}
+
+
+void sb_pressure_run_start(void)
+{
+  if (!pressure_enabled)
+    return;
+
+  take_sample(&run_start);
+  last_report = run_start;
+}
+
+
+void sb_pressure_run_stop(void)
+{
+  if (pressure_enabled)
+    take_sample(&run_stop);
+}
+
+
+static double pct(uint64_t part, uint64_t total)
+{
+  return total > 0 ? 100.0 * part / total : 0;
+}
+
+
+/* Differences between two samples */
+
+typedef struct
+{
+  double   psi_pct[PSI_MAX];
+  uint64_t nr_periods;
+  uint64_t nr_throttled;
+  double   throttled_ms;
+  double   steal_pct;
+} pressure_t;
+
+
+static void sample_diff(const sample_t *a, const sample_t *b, pressure_t *p)
+{
+  const uint64_t wall_us = (b->time_ns - a->time_ns) / 1000;
+
+  for (int i = 0; i < PSI_MAX; i++)
+    p->psi_pct[i] = pct(b->psi_us[i] - a->psi_us[i], wall_us);
+
+  p->nr_periods = b->nr_periods - a->nr_periods;
+  p->nr_throttled = b->nr_throttled - a->nr_throttled;
+  p->throttled_ms = NS2MS(b->throttled_ns - a->throttled_ns);
+  p->steal_pct = pct(b->cpu_steal - a->cpu_steal, b->cpu_total - a->cpu_total);
+}
+
+
+void sb_pressure_report_intermediate(double time_total)
+{
+  sample_t   s;
+  pressure_t p;
+  char       buf[256];
+  size_t     len = 0;
+
+  take_sample(&s);
+  sample_diff(&last_report, &s, &p);
+  last_report = s;
+
+  for (int i = 0; i < PSI_MAX; i++)
+    if (psi_available[i])
+      len += snprintf(buf + len, sizeof(buf) - len, " %s: %.1f%%",
+                      psi_names[i], p.psi_pct[i]);
+
+  if (cpu_stat_path[0] != '\0')
+    len += snprintf(buf + len, sizeof(buf) - len,
+                    " throttled: %" PRIu64 "/%" PRIu64 " (%.0fms)%s",
+                    p.nr_throttled, p.nr_periods, p.throttled_ms,
+                    p.nr_throttled > 0 ? " THROTTLED" : "");
+
+  if (stat_available)
+    len += snprintf(buf + len, sizeof(buf) - len, " steal: %.1f%%%s",
+                    p.steal_pct, p.steal_pct >= STEAL_WARN_PCT ? " STEAL" : "");
+
+  if (len > 0)
+    log_timestamp(LOG_NOTICE, time_total, "pressure:%s", buf);
+}
+
+
+void sb_pressure_report(void)
+{
+  pressure_t p;
+
+  if (!pressure_enabled)
+    return;
+
+  sample_diff(&run_start, &run_stop, &p);
+
+  log_text(LOG_NOTICE, "Host pressure:");
+
+  for (int i = 0; i < PSI_MAX; i++)
+  {
+    if (psi_available[i])
+      log_text(LOG_NOTICE, "    %-6s stall time (PSI some):        %.2f%%",
+               psi_names[i], p.psi_pct[i]);
+    else
+      log_text(LOG_NOTICE, "    %-6s stall time (PSI some):        N/A",
+               psi_names[i]);
+  }
+
+  if (cpu_stat_path[0] != '\0')
+    log_text(LOG_NOTICE, "    cgroup throttled periods:            %" PRIu64
+             "/%" PRIu64 " (%.2fs)", p.nr_throttled, p.nr_periods,
+             p.throttled_ms / 1000);
+  else
+    log_text(LOG_NOTICE, "    cgroup throttled periods:            N/A");
+
+  if (stat_available)
+    log_text(LOG_NOTICE, "    CPU steal time:                      %.2f%%",
+             p.steal_pct);
+  else
+    log_text(LOG_NOTICE, "    CPU steal time:                      N/A");
+
+  log_text(LOG_NOTICE, "");
+
+  if (p.nr_throttled > 0)
+    log_text(LOG_WARNING, "sysbench was throttled by its cgroup CPU quota in "
+             "%" PRIu64 " of %" PRIu64 " periods (%.2fs), results may be "
+             "limited by the client quota rather than the server",
+             p.nr_throttled, p.nr_periods, p.throttled_ms / 1000);
+
+  if (p.steal_pct >= STEAL_WARN_PCT)
+    log_text(LOG_WARNING, "%.2f%% of CPU time on the sysbench host was stolen "
+             "by the hypervisor, results may be affected by other virtual "
+             "machines", p.steal_pct);
+}
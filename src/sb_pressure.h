@@ -0,0 +1,54 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Host pressure sampling, see --host-pressure */
+
+#ifndef SB_PRESSURE_H
+#define SB_PRESSURE_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+
+/*
+  Read --host-pressure and find the available sources of host pressure.
+  Returns 0 on success.
+*/
+int sb_pressure_init(void);
+
+/* Return true if --host-pressure is enabled */
+bool sb_pressure_enabled(void);
+
+/* Take the first sample of a run, called by the main thread */
+void sb_pressure_run_start(void);
+
+/* Take the last sample of a run */
+void sb_pressure_run_stop(void);
+
+/*
+  Print pressure since the previous intermediate report, flagging CPU quota
+  throttling and steal time
+*/
+void sb_pressure_report_intermediate(double time_total);
+
+/* Print pressure for the last run and warn about throttling and steal time */
+void sb_pressure_report(void);
+
+#endif /* SB_PRESSURE_H */
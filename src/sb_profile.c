@@ -0,0 +1,398 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Load profiles change the target rate and the number of active worker
+  threads over the run. --profile is a list of phases in the following form:
+
+    TYPE[:RATES]/DURATION[@THREADS]
+
+  hold, step, spike - a constant rate, e.g. hold:5000/60s
+  ramp              - a linear change between two rates, e.g. ramp:0-5000/60s
+  diurnal           - a day-like sine cycle between the minimum and maximum
+                      rates, e.g. diurnal:1000-5000/10m
+
+  DURATION is in seconds, or in minutes or hours with the 'm' and 'h' suffixes.
+  THREADS is the number of active worker threads in the phase, all of them by
+  default. Phases without RATES run at --rate, unlimited by default.
+
+  Ramps and cycles are approximated by steps of PROFILE_STEP_NS.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#ifdef HAVE_MATH_H
+# include <math.h>
+#endif
+#ifdef HAVE_LIMITS_H
+# include <limits.h>
+#endif
+
+#include "sb_profile.h"
+#include "sb_list.h"
+#include "sb_options.h"
+#include "sb_timer.h"
+#include "sb_util.h"
+#include "sysbench.h"
+
+#define PROFILE_STEP_NS (10 * NS_PER_MS)
+
+typedef enum
+{
+  PHASE_HOLD,
+  PHASE_RAMP,
+  PHASE_DIURNAL
+} phase_type_t;
+
+typedef struct
+{
+  phase_type_t type;
+  double       from;            /* rate at the start, minimum for diurnal */
+  double       to;              /* rate at the end, maximum for diurnal */
+  bool         has_rate;
+  unsigned int threads;         /* active threads, 0 for all */
+  uint64_t     start_ns;
+  uint64_t     end_ns;
+  char         *name;
+} profile_phase_t;
+
+static profile_phase_t *phases;
+static unsigned int    nphases;
+
+
+/* Parse a phase definition, return 0 on success */
+
+static int parse_phase(const char *s, profile_phase_t *p)
+{
+  const char *type_end = s + strcspn(s, ":/");
+  const size_t type_len = type_end - s;
+  char *end;
+
+  memset(p, 0, sizeof(*p));
+
+  if ((type_len == 4 && !strncmp(s, "hold", 4)) ||
+      (type_len == 4 && !strncmp(s, "step", 4)) ||
+      (type_len == 5 && !strncmp(s, "spike", 5)))
+    p->type = PHASE_HOLD;
+  else if (type_len == 4 && !strncmp(s, "ramp", 4))
+    p->type = PHASE_RAMP;
+  else if (type_len == 7 && !strncmp(s, "diurnal", 7))
+    p->type = PHASE_DIURNAL;
+  else
+    return 1;
+
+  s = type_end;
+
+  if (*s == ':')
+  {
+    p->has_rate = true;
+
+    p->from = strtod(s + 1, &end);
+    if (end == s + 1 || p->from < 0)
+      return 1;
+    s = end;
+
+    if (p->type == PHASE_HOLD)
+      p->to = p->from;
+    else
+    {
+      if (*s != '-')
+        return 1;
+      p->to = strtod(s + 1, &end);
+      if (end == s + 1 || p->to < 0)
+        return 1;
+      s = end;
+    }
+
+    if (p->type == PHASE_DIURNAL && p->to < p->from)
+      return 1;
+  }
+  else if (p->type != PHASE_HOLD)
+    return 1;
+
+  if (*s != '/')
+    return 1;
+
+  const unsigned long duration = strtoul(s + 1, &end, 10);
+
+  if (end == s + 1 || duration == 0 || duration > UINT_MAX / 3600)
+    return 1;
+  s = end;
+
+  uint64_t unit = 1;
+
+  if (*s == 's' || *s == 'm' || *s == 'h')
+  {
+    unit = *s == 'h' ? 3600 : *s == 'm' ? 60 : 1;
+    s++;
+  }
+
+  p->end_ns = SEC2NS(duration * unit);
+
+  if (*s == '@')
+  {
+    const long threads = strtol(s + 1, &end, 10);
+
+    if (end == s + 1 || threads <= 0)
+      return 1;
+    p->threads = (unsigned int) threads;
+    s = end;
+  }
+
+  return *s != '\0';
+}
+
+
+int sb_profile_init(void)
+{
+  sb_list_t      *list = sb_get_value_list("profile");
+  sb_list_item_t *pos;
+  unsigned int   n = 0;
+  uint64_t       start_ns = 0;
+  double         peak = 0;
+  bool           has_rates = false;
+
+  SB_LIST_FOR_EACH(pos, list)
+    n++;
+
+  if (n == 0)
+    return 0;
+
+  if (sb_globals.warmup_time > 0 || sb_globals.warmup_steady_state > 0)
+  {
+    log_text(LOG_FATAL, "--profile cannot be used with --warmup-time or "
+             "--warmup-steady-state, use a separate phase instead");
+    return 1;
+  }
+
+  phases = calloc(n, sizeof(profile_phase_t));
+  if (phases == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  SB_LIST_FOR_EACH(pos, list)
+  {
+    const value_t   *val = SB_LIST_ENTRY(pos, value_t, listitem);
+    profile_phase_t *p = &phases[nphases];
+
+    if (parse_phase(val->data, p))
+    {
+      log_text(LOG_FATAL, "Invalid value for --profile: '%s'", val->data);
+      return 1;
+    }
+
+    if (p->threads > sb_globals.threads)
+    {
+      log_text(LOG_FATAL, "Invalid value for --profile: '%s' uses more than "
+               "--threads=%u threads", val->data, sb_globals.threads);
+      return 1;
+    }
+
+    p->name = strdup(val->data);
+    p->start_ns = start_ns;
+    p->end_ns += start_ns;
+    start_ns = p->end_ns;
+
+    nphases++;
+
+    has_rates |= p->has_rate;
+  }
+
+  if (start_ns > SEC2NS(INT_MAX))
+  {
+    log_text(LOG_FATAL, "Invalid value for --profile: the total duration "
+             "exceeds %d seconds", INT_MAX);
+    return 1;
+  }
+
+  /* Phases without a rate run at --rate */
+  for (unsigned int i = 0; i < nphases; i++)
+  {
+    profile_phase_t *p = &phases[i];
+
+    if (!p->has_rate)
+    {
+      if (has_rates && sb_globals.tx_rate == 0)
+      {
+        log_text(LOG_FATAL, "Invalid value for --profile: '%s' has no rate "
+                 "and --rate is not set", p->name);
+        return 1;
+      }
+      p->from = p->to = sb_globals.tx_rate;
+    }
+
+    peak = SB_MAX(peak, SB_MAX(p->from, p->to));
+  }
+
+  if (has_rates && peak == 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --profile: all rates are zero");
+    return 1;
+  }
+
+  /* Rates are passed around as factors of the peak one */
+  const double rate = ceil(peak);
+
+  sb_globals.tx_rate = (int) rate;
+
+  return 0;
+}
+
+
+bool sb_profile_enabled(void)
+{
+  return nphases > 0;
+}
+
+
+unsigned int sb_profile_phases(void)
+{
+  return nphases;
+}
+
+
+unsigned int sb_profile_phase_end(unsigned int phase)
+{
+  return (unsigned int) (phases[phase].end_ns / NS_PER_SEC);
+}
+
+
+int sb_profile_phase_ending_at(unsigned int sec)
+{
+  for (unsigned int i = 0; i < nphases; i++)
+    if (phases[i].end_ns == SEC2NS(sec))
+      return (int) i;
+
+  return -1;
+}
+
+
+const char *sb_profile_phase_name(unsigned int phase)
+{
+  return phases[phase].name;
+}
+
+
+/* Return the phase at time t, or NULL after the end of the profile */
+
+static const profile_phase_t *phase_at(uint64_t t)
+{
+  unsigned int lo = 0;
+  unsigned int hi = nphases;
+
+  /* Find the first phase ending after t */
+  while (lo < hi)
+  {
+    const unsigned int mid = (lo + hi) / 2;
+
+    if (phases[mid].end_ns <= t)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo < nphases ? &phases[lo] : NULL;
+}
+
+
+double sb_profile_rate(uint64_t t, int stream, uint64_t *end_ns)
+{
+  const profile_phase_t *p = phase_at(t);
+  double                rate;
+
+  if (p == NULL)
+  {
+    *end_ns = UINT64_MAX;
+    return 0;
+  }
+
+  *end_ns = p->end_ns;
+
+  if (p->type == PHASE_HOLD)
+    rate = p->from;
+  else
+  {
+    /* Use the value at the middle of the current step */
+    const uint64_t step_ns = p->start_ns +
+      (t - p->start_ns) / PROFILE_STEP_NS * PROFILE_STEP_NS;
+
+    *end_ns = SB_MIN(step_ns + PROFILE_STEP_NS, p->end_ns);
+
+    const double x = ((step_ns + *end_ns) / 2.0 - p->start_ns) /
+      (p->end_ns - p->start_ns);
+
+    if (p->type == PHASE_RAMP)
+      rate = p->from + (p->to - p->from) * x;
+    else
+      rate = p->from + (p->to - p->from) * (1 - cos(2 * M_PI * x)) / 2;
+  }
+
+  if (stream >= 0 && p->threads > 0)
+  {
+    if ((unsigned int) stream >= p->threads)
+    {
+      *end_ns = p->end_ns;
+      return 0;
+    }
+
+    rate *= (double) sb_globals.threads / p->threads;
+  }
+
+  return rate / sb_globals.tx_rate;
+}
+
+
+bool sb_profile_active(int thread_id, uint64_t t, uint64_t *end_ns)
+{
+  const profile_phase_t *p = phase_at(t);
+
+  if (p == NULL || p->threads == 0 || (unsigned int) thread_id < p->threads)
+    return true;
+
+  *end_ns = p->end_ns;
+
+  return false;
+}
+
+
+void sb_profile_print_mode(void)
+{
+  log_text(LOG_NOTICE, "Load profile: %u phase(s), %u seconds", nphases,
+           sb_profile_phase_end(nphases - 1));
+}
+
+
+void sb_profile_done(void)
+{
+  for (unsigned int i = 0; i < nphases; i++)
+    free(phases[i].name);
+
+  free(phases);
+  phases = NULL;
+  nphases = 0;
+}
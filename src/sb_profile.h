@@ -0,0 +1,76 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Multi-phase load profiles, see --profile */
+
+#ifndef SB_PROFILE_H
+#define SB_PROFILE_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  Parse --profile. Must be called after sb_globals.tx_rate and the thread count
+  are set. Sets sb_globals.tx_rate to the peak rate of the profile. Returns 0 on
+  success.
+*/
+int sb_profile_init(void);
+
+/* Return true if a load profile is used */
+bool sb_profile_enabled(void);
+
+/* Return the number of phases */
+unsigned int sb_profile_phases(void);
+
+/* Return the end time of a phase in seconds from the start of the run */
+unsigned int sb_profile_phase_end(unsigned int phase);
+
+/*
+  Return the phase ending at sec seconds from the start of the run, or -1 if
+  none of them does
+*/
+int sb_profile_phase_ending_at(unsigned int sec);
+
+/* Return the phase definition as given in --profile */
+const char *sb_profile_phase_name(unsigned int phase);
+
+/*
+  Return the target rate at time t as a factor of sb_globals.tx_rate and store
+  the time until which it is constant to end_ns. stream is the worker thread
+  scheduling its own share of the rate with --rate-mode=worker, or -1 for the
+  total rate. Such shares are redistributed among the active threads of a
+  phase. end_ns is UINT64_MAX after the end of the profile.
+*/
+double sb_profile_rate(uint64_t t, int stream, uint64_t *end_ns);
+
+/*
+  Return true if a worker thread is active at time t. Otherwise store the time
+  when the active thread count changes to end_ns.
+*/
+bool sb_profile_active(int thread_id, uint64_t t, uint64_t *end_ns);
+
+/* Print the profile summary in the test mode banner */
+void sb_profile_print_mode(void);
+
+void sb_profile_done(void);
+
+#endif /* SB_PROFILE_H */
@@ -39,6 +39,7 @@
 # include "config.h"
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>
 #ifdef HAVE_STRING_H
 # include <string.h>
@@ -49,10 +50,15 @@
 #ifdef HAVE_MATH_H
 # include <math.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
 
 #include "sb_options.h"
 #include "sb_rand.h"
 #include "sb_logger.h"
+#include "sb_timer.h"
+#include "sysbench.h"
 
 #include "sb_ck_pr.h"
 
@@ -67,7 +73,7 @@ static sb_arg_t rand_args[] =
 {
   SB_OPT("rand-type",
          "random numbers distribution {uniform, gaussian, special, pareto, "
-         "zipfian} to use by default", "special", STRING),
+         "zipfian, latest, empirical} to use by default", "special", STRING),
   SB_OPT("rand-seed",
          "seed for random number generator. When 0, the current time is "
          "used as an RNG seed.", "0", INT),
@@ -85,13 +91,46 @@ static sb_arg_t rand_args[] =
   SB_OPT("rand-zipfian-exp",
          "shape parameter (exponent, theta) for the Zipfian distribution",
          "0.8", DOUBLE),
+  SB_OPT("rand-zipfian-table",
+         "maximum range size for which the Zipfian distribution is sampled "
+         "from a precomputed table. Larger ranges are sampled with "
+         "rejection-inversion. 0 disables the tables",
+         "4194304", INT),
+  SB_OPT("rand-hotspot",
+         "how the hot values of the default random numbers distribution move "
+         "over time {fixed, step, drift}. 'step' moves them to a new "
+         "pseudo-random position every --rand-hotspot-period seconds, 'drift' "
+         "shifts them continuously through the entire range once per "
+         "--rand-hotspot-period seconds", "fixed", STRING),
+  SB_OPT("rand-hotspot-period",
+         "period in seconds for --rand-hotspot", "60", INT),
+  SB_OPT("rand-empirical-file",
+         "file with the key distribution for the empirical distribution. "
+         "Each line is either 'key', 'key weight' or 'low high weight' for "
+         "a range of keys. Keys are scaled to the requested range. "
+         "Histograms in the format printed by sysbench can be used as is",
+         NULL, STRING),
 
   SB_OPT_END
 };
 
 static rand_dist_t rand_type;
-/* pointer to the default PRNG as defined by --rand-type */
-static uint32_t (*rand_func)(uint32_t, uint32_t);
+/* pointer to the default PRNG as defined by --rand-type and --rand-hotspot */
+static uint64_t (*rand_func)(uint64_t, uint64_t);
+
+/* Moving hotspot for the default distribution */
+typedef enum
+{
+  HOTSPOT_FIXED,
+  HOTSPOT_STEP,
+  HOTSPOT_DRIFT
+} rand_hotspot_t;
+
+static rand_hotspot_t rand_hotspot;
+static uint64_t rand_hotspot_period; /* in nanoseconds */
+static struct timespec rand_hotspot_start;
+/* the --rand-type distribution when the hotspot is moving */
+static uint64_t (*rand_hotspot_func)(uint64_t, uint64_t);
 static unsigned int rand_iter;
 static unsigned int rand_pct;
 static unsigned int rand_res;
@@ -114,16 +153,116 @@ static double zipf_exp;
 static double zipf_s;
 static double zipf_hIntegralX1;
 
+/*
+  Alias tables for sampling discrete distributions by Vose's alias method,
+  which takes a single random value: its high 32 bits select a slot and its
+  low 32 bits choose between the slot value and its alias.
+*/
+typedef struct
+{
+  uint32_t prob;                /* slot threshold, scaled by 2^32 */
+  uint32_t alias;               /* value returned above the threshold */
+} rand_alias_slot_t;
+
+/*
+  Precomputed Zipfian tables. Each table covers a range size n and is built on
+  first use.
+*/
+#define ZIPF_TABLES_MAX 16
+
+typedef struct
+{
+  uint64_t          n;
+  rand_alias_slot_t *slots;
+} zipf_table_t;
+
+static uint64_t zipf_table_max;
+static zipf_table_t zipf_tables[ZIPF_TABLES_MAX];
+static unsigned int zipf_ntables;
+static pthread_mutex_t zipf_tables_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* Last table used by the current thread */
+static TLS const zipf_table_t *zipf_last_table;
+/* Last range size for which the current thread could not get a table */
+static TLS uint64_t zipf_last_miss;
+
+/*
+  Empirical distribution loaded from --rand-empirical-file: key ranges
+  [low, low + width) with weights, sampled with an alias table. The keys
+  span [emp_min, emp_min + emp_range), which is scaled to the requested
+  range.
+*/
+typedef struct
+{
+  double low;
+  double width;
+} rand_bucket_t;
+
+static rand_bucket_t     *emp_buckets;
+static rand_alias_slot_t *emp_slots;
+static uint64_t          emp_nbuckets;
+static double            emp_min;
+static double            emp_range;
+
 /* Unique sequence generator state */
 static uint32_t rand_unique_index CK_CC_CACHELINE;
 static uint32_t rand_unique_offset;
 
+/* 64-bit unique sequence generator state */
+static uint64_t rand_unique64_index CK_CC_CACHELINE;
+static uint64_t rand_unique64_offset;
+
+/*
+  Number of indexes reserved by a thread at once for the 64-bit unique
+  sequence, and the thread's remaining reservation
+*/
+#define RAND_UNIQUE64_BLOCK (UINT64_C(1) << 32)
+
+static TLS uint64_t rand_unique64_next;
+static TLS uint64_t rand_unique64_end;
+
+/*
+  Keys shared by all threads for the 'latest' distribution: the next key to
+  be allocated by sb_rand_latest_next() (0 until the first call) and the
+  largest key reported by sb_rand_latest_insert()
+*/
+static uint64_t rand_latest_next CK_CC_CACHELINE;
+static uint64_t rand_latest_max CK_CC_CACHELINE;
+
+/*
+  Sequential primary keys: threads reserve blocks of consecutive keys from a
+  shared counter, which starts at the number of milliseconds since the Epoch
+  shifted by log2(RAND_KEY_SEQ_BLOCK) bits, so that keys of later runs do not
+  collide with the ones inserted before, unless a run reserves more than one
+  block per millisecond elapsed between the run starts
+*/
+#define RAND_KEY_SEQ_BLOCK (UINT64_C(1) << 20)
+
+static uint64_t rand_key_seq_index CK_CC_CACHELINE;
+
+static TLS uint64_t rand_key_seq_next;
+static TLS uint64_t rand_key_seq_end;
+
+/*
+  Snowflake keys: 41 bits of milliseconds since SNOWFLAKE_EPOCH_MS, 10 bits
+  of worker (thread) id and a 12-bit per-thread sequence number within a
+  millisecond
+*/
+#define SNOWFLAKE_EPOCH_MS UINT64_C(1577836800000)      /* 2020-01-01 */
+#define SNOWFLAKE_SEQ_BITS 12
+#define SNOWFLAKE_WORKER_BITS 10
+#define SNOWFLAKE_TIME_BITS 41
+
+static TLS uint64_t rand_snowflake_ms;
+static TLS uint32_t rand_snowflake_seq;
+
 extern inline uint64_t sb_rand_uniform_uint64(void);
 extern inline double sb_rand_uniform_double(void);
+extern inline char sb_rand_char(sb_rand_chars_t *, char, char);
 extern inline uint64_t xoroshiro_rotl(const uint64_t, int);
 extern inline uint64_t xoroshiro_next(uint64_t s[2]);
 
 static void rand_unique_seed(uint32_t index, uint32_t offset);
+static void rand_unique64_seed(uint64_t index, uint64_t offset);
 
 /* Helper functions for the Zipfian distribution */
 static double hIntegral(double x, double e);
@@ -131,6 +270,13 @@ static double hIntegralInverse(double x, double e);
 static double h(double x, double e);
 static double helper1(double x);
 static double helper2(double x);
+static const zipf_table_t *zipf_get_table(uint64_t n);
+static inline uint64_t rand_alias_sample(const rand_alias_slot_t *slots,
+                                         uint64_t n);
+
+static uint64_t rand_hotspot64(uint64_t a, uint64_t b);
+
+static int rand_empirical_load(const char *path);
 
 int sb_rand_register(void)
 {
@@ -151,27 +297,37 @@ int sb_rand_init(void)
   if (!strcmp(s, "uniform"))
   {
     rand_type = DIST_TYPE_UNIFORM;
-    rand_func = &sb_rand_uniform;
+    rand_func = &sb_rand_uniform64;
   }
   else if (!strcmp(s, "gaussian"))
   {
     rand_type = DIST_TYPE_GAUSSIAN;
-    rand_func = &sb_rand_gaussian;
+    rand_func = &sb_rand_gaussian64;
   }
   else if (!strcmp(s, "special"))
   {
     rand_type = DIST_TYPE_SPECIAL;
-    rand_func = &sb_rand_special;
+    rand_func = &sb_rand_special64;
   }
   else if (!strcmp(s, "pareto"))
   {
     rand_type = DIST_TYPE_PARETO;
-    rand_func = &sb_rand_pareto;
+    rand_func = &sb_rand_pareto64;
   }
   else if (!strcmp(s, "zipfian"))
   {
     rand_type = DIST_TYPE_ZIPFIAN;
-    rand_func = &sb_rand_zipfian;
+    rand_func = &sb_rand_zipfian64;
+  }
+  else if (!strcmp(s, "latest"))
+  {
+    rand_type = DIST_TYPE_LATEST;
+    rand_func = &sb_rand_latest64;
+  }
+  else if (!strcmp(s, "empirical"))
+  {
+    rand_type = DIST_TYPE_EMPIRICAL;
+    rand_func = &sb_rand_empirical64;
   }
   else
   {
@@ -179,6 +335,47 @@ int sb_rand_init(void)
     return 1;
   }
 
+  s = sb_get_value_string("rand-empirical-file");
+  if (s != NULL)
+  {
+    if (rand_empirical_load(s))
+      return 1;
+  }
+  else if (rand_type == DIST_TYPE_EMPIRICAL)
+  {
+    log_text(LOG_FATAL, "--rand-type=empirical requires --rand-empirical-file");
+    return 1;
+  }
+
+  s = sb_get_value_string("rand-hotspot");
+  if (!strcmp(s, "fixed"))
+    rand_hotspot = HOTSPOT_FIXED;
+  else if (!strcmp(s, "step"))
+    rand_hotspot = HOTSPOT_STEP;
+  else if (!strcmp(s, "drift"))
+    rand_hotspot = HOTSPOT_DRIFT;
+  else
+  {
+    log_text(LOG_FATAL, "Invalid value for rand-hotspot: %s", s);
+    return 1;
+  }
+
+  int hotspot_period = sb_get_value_int("rand-hotspot-period");
+  if (hotspot_period <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for rand-hotspot-period: %d",
+             hotspot_period);
+    return 1;
+  }
+  rand_hotspot_period = SEC2NS((uint64_t) hotspot_period);
+
+  if (rand_hotspot != HOTSPOT_FIXED)
+  {
+    rand_hotspot_func = rand_func;
+    rand_func = &rand_hotspot64;
+    SB_GETTIME(&rand_hotspot_start);
+  }
+
   rand_iter = sb_get_value_int("rand-spec-iter");
   rand_iter_mult = 1.0 / rand_iter;
 
@@ -203,11 +400,28 @@ int sb_rand_init(void)
                                 zipf_exp);
   zipf_hIntegralX1 = hIntegral(1.5, zipf_exp) - 1;
 
+  int zipf_table = sb_get_value_int("rand-zipfian-table");
+  if (zipf_table < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for rand-zipfian-table: %d",
+             zipf_table);
+    return 1;
+  }
+  zipf_table_max = (uint64_t) zipf_table;
+
   /* Seed PRNG for the main thread. Worker threads do their own seeding */
   sb_rand_thread_init();
 
-  /* Seed the unique sequence generator */
+  /* Seed the unique sequence generators */
   rand_unique_seed(random(), random());
+  rand_unique64_seed((((uint64_t) random()) << 32) | random(),
+                     (((uint64_t) random()) << 32) | random());
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  rand_key_seq_index = ((uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000) *
+    RAND_KEY_SEQ_BLOCK;
 
   return 0;
 }
@@ -223,6 +437,16 @@ void sb_rand_print_help(void)
 
 void sb_rand_done(void)
 {
+  for (unsigned int i = 0; i < zipf_ntables; i++)
+    free(zipf_tables[i].slots);
+  zipf_ntables = 0;
+  zipf_last_table = NULL;
+
+  free(emp_buckets);
+  free(emp_slots);
+  emp_buckets = NULL;
+  emp_slots = NULL;
+  emp_nbuckets = 0;
 }
 
 /* Initialize thread-local RNG state */
@@ -242,35 +466,109 @@ void sb_rand_thread_init(void)
 */
 
 uint32_t sb_rand_default(uint32_t a, uint32_t b)
+{
+  return (uint32_t) rand_func(a,b);
+}
+
+/*
+  The distributions are implemented for 64-bit ranges, the 32-bit functions
+  are wrappers returning the same values. All of them are computed from doubles
+  with 53 significant bits, so ranges wider than 2^53 do not produce every
+  value in the range.
+*/
+
+uint64_t sb_rand_default64(uint64_t a, uint64_t b)
 {
   return rand_func(a,b);
 }
 
+/*
+  Finalizer of the SplitMix64 generator, a bijection on 64-bit integers that
+  maps 0 to 0
+*/
+
+static inline uint64_t rand_mix64(uint64_t x)
+{
+  x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+  x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+  return x ^ (x >> 31);
+}
+
+/*
+  Default distribution with a moving hotspot: the value returned by the
+  --rand-type distribution is rotated within [a, b] by an offset that depends
+  on the time elapsed since initialization. With 'step' the offset is a
+  pseudo-random function of the number of elapsed periods, so the hot values
+  stay at the low end of the range during the first period and then jump to
+  a new position in every period. With 'drift' the offset grows linearly and
+  wraps around at the end of each period.
+*/
+
+static uint64_t rand_hotspot64(uint64_t a, uint64_t b)
+{
+  const uint64_t  n = b - a + 1;
+  const uint64_t  v = rand_hotspot_func(a, b) - a;
+  struct timespec ts;
+  uint64_t        elapsed, offset;
+
+  if (SB_UNLIKELY(n == 0))
+    return a + v; /* the entire 64-bit range, nothing to rotate */
+
+  SB_GETTIME(&ts);
+  elapsed = TIMESPEC_DIFF(ts, rand_hotspot_start);
+
+  if (rand_hotspot == HOTSPOT_STEP)
+    offset = rand_mix64(elapsed / rand_hotspot_period) % n;
+  else
+    offset = (double) (elapsed % rand_hotspot_period) / rand_hotspot_period *
+      n;
+
+  if (SB_UNLIKELY(offset >= n))
+    offset = n - 1; /* rounding errors */
+
+  return a + (v < n - offset ? v + offset : v - (n - offset));
+}
+
 /* uniform distribution */
 
 uint32_t sb_rand_uniform(uint32_t a, uint32_t b)
 {
-  return a + sb_rand_uniform_double() * (b - a + 1);
+  return (uint32_t) sb_rand_uniform64(a, b);
+}
+
+uint64_t sb_rand_uniform64(uint64_t a, uint64_t b)
+{
+  return a + (uint64_t) (sb_rand_uniform_double() * ((double) (b - a) + 1));
 }
 
 /* gaussian distribution */
 
 uint32_t sb_rand_gaussian(uint32_t a, uint32_t b)
+{
+  return (uint32_t) sb_rand_gaussian64(a, b);
+}
+
+uint64_t sb_rand_gaussian64(uint64_t a, uint64_t b)
 {
   double       sum;
   double       t;
   unsigned int i;
 
-  t = b - a + 1;
+  t = (double) (b - a) + 1;
   for(i=0, sum=0; i < rand_iter; i++)
     sum += sb_rand_uniform_double() * t;
 
-  return a + (uint32_t) (sum * rand_iter_mult) ;
+  return a + (uint64_t) (sum * rand_iter_mult) ;
 }
 
 /* 'special' distribution */
 
 uint32_t sb_rand_special(uint32_t a, uint32_t b)
+{
+  return (uint32_t) sb_rand_special64(a, b);
+}
+
+uint64_t sb_rand_special64(uint64_t a, uint64_t b)
 {
   double       sum;
   double       t;
@@ -301,7 +599,7 @@ uint32_t sb_rand_special(uint32_t a, uint32_t b)
     for(i = 0; i < rand_iter; i++)
       sum += sb_rand_uniform_double();
 
-    return a + sum * t * rand_iter_mult;
+    return a + (uint64_t) (sum * t * rand_iter_mult);
   }
 
   /*
@@ -315,29 +613,98 @@ uint32_t sb_rand_special(uint32_t a, uint32_t b)
   res = rnd * (d + 1);
   res += t / 2 - t * rand_pct_2_mult;
 
-  return a + (uint32_t) res;
+  return a + (uint64_t) res;
 }
 
 /* Pareto distribution */
 
 uint32_t sb_rand_pareto(uint32_t a, uint32_t b)
 {
-  return a + (uint32_t) ((b - a + 1) *
+  return (uint32_t) sb_rand_pareto64(a, b);
+}
+
+uint64_t sb_rand_pareto64(uint64_t a, uint64_t b)
+{
+  return a + (uint64_t) (((double) (b - a) + 1) *
                          pow(sb_rand_uniform_double(), pareto_power));
 }
 
+/* Bulk generation */
+
+void sb_rand_fill_uint64(uint64_t *buf, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    buf[i] = sb_rand_uniform_uint64();
+}
+
+/* The same values as sb_rand_uniform64(), with the range size computed once */
+
+void sb_rand_fill_uniform(uint64_t *buf, size_t n, uint64_t a, uint64_t b)
+{
+  const double range = (double) (b - a) + 1;
+
+  for (size_t i = 0; i < n; i++)
+    buf[i] = a + (uint64_t) (sb_rand_uniform_double() * range);
+}
+
+static inline void rand_fill(uint64_t (*func)(uint64_t, uint64_t),
+                             uint64_t *buf, size_t n, uint64_t a, uint64_t b)
+{
+  for (size_t i = 0; i < n; i++)
+    buf[i] = func(a, b);
+}
+
+void sb_rand_fill_default(uint64_t *buf, size_t n, uint64_t a, uint64_t b)
+{
+  if (rand_func == &sb_rand_uniform64)
+    sb_rand_fill_uniform(buf, n, a, b);
+  else
+    rand_fill(rand_func, buf, n, a, b);
+}
+
+void sb_rand_fill_gaussian(uint64_t *buf, size_t n, uint64_t a, uint64_t b)
+{
+  rand_fill(sb_rand_gaussian64, buf, n, a, b);
+}
+
+void sb_rand_fill_special(uint64_t *buf, size_t n, uint64_t a, uint64_t b)
+{
+  rand_fill(sb_rand_special64, buf, n, a, b);
+}
+
+void sb_rand_fill_pareto(uint64_t *buf, size_t n, uint64_t a, uint64_t b)
+{
+  rand_fill(sb_rand_pareto64, buf, n, a, b);
+}
+
+void sb_rand_fill_zipfian(uint64_t *buf, size_t n, uint64_t a, uint64_t b)
+{
+  rand_fill(sb_rand_zipfian64, buf, n, a, b);
+}
+
+void sb_rand_fill_latest(uint64_t *buf, size_t n, uint64_t a, uint64_t b)
+{
+  rand_fill(sb_rand_latest64, buf, n, a, b);
+}
+
+void sb_rand_fill_empirical(uint64_t *buf, size_t n, uint64_t a, uint64_t b)
+{
+  rand_fill(sb_rand_empirical64, buf, n, a, b);
+}
+
 /* Generate random string */
 
 void sb_rand_str(const char *fmt, char *buf)
 {
-  unsigned int i;
+  sb_rand_chars_t chars = { .n = 0 };
+  unsigned int    i;
 
   for (i=0; fmt[i] != '\0'; i++)
   {
     if (fmt[i] == '#')
-      buf[i] = sb_rand_uniform('0', '9');
+      buf[i] = sb_rand_char(&chars, '0', '9');
     else if (fmt[i] == '@')
-      buf[i] = sb_rand_uniform('a', 'z');
+      buf[i] = sb_rand_char(&chars, 'a', 'z');
     else
       buf[i] = fmt[i];
   }
@@ -404,6 +771,202 @@ uint32_t sb_rand_unique(void)
                              0x5bf03635);
 }
 
+/*
+  64-bit version of the unique random sequence generator, using the largest
+  64-bit prime. The square modulo the prime needs a 128-bit product.
+*/
+
+static uint64_t rand_mulmod64(uint64_t a, uint64_t b, uint64_t m)
+{
+#ifdef __SIZEOF_INT128__
+  return (uint64_t) (((unsigned __int128) a * b) % m);
+#else
+  /* Shift-and-add, a and b are below m < 2^64 */
+  uint64_t r = 0;
+
+  for (; b > 0; b >>= 1)
+  {
+    if (b & 1)
+      r = (r >= m - a) ? r - (m - a) : r + a;
+    a = (a >= m - a) ? a - (m - a) : a + a;
+  }
+
+  return r;
+#endif
+}
+
+
+static uint64_t rand_unique64_permute(uint64_t x)
+{
+  static const uint64_t prime = UINT64_C(18446744073709551557);
+
+  if (x >= prime)
+    return x; /* The 59 integers out of range are mapped to themselves. */
+
+  uint64_t residue = rand_mulmod64(x, x, prime);
+  return (x <= prime / 2) ? residue : prime - residue;
+}
+
+
+static void rand_unique64_seed(uint64_t index, uint64_t offset)
+{
+  rand_unique64_index = rand_unique64_permute(rand_unique64_permute(index) +
+                                              UINT64_C(0x682f01615bf03635));
+  rand_unique64_offset = rand_unique64_permute(rand_unique64_permute(offset) +
+                                               UINT64_C(0x46790905682f0161));
+}
+
+/*
+  This is safe to be called concurrently from multiple threads. Each thread
+  reserves a block of 2^32 indexes from the shared counter on the first call,
+  so there are no shared writes until the block is used up. The values are
+  unique across threads, but are not generated in the same order as by a
+  single thread.
+*/
+
+uint64_t sb_rand_unique64(void)
+{
+  if (SB_UNLIKELY(rand_unique64_next == rand_unique64_end))
+  {
+    rand_unique64_next = ck_pr_faa_64(&rand_unique64_index,
+                                      RAND_UNIQUE64_BLOCK);
+    rand_unique64_end = rand_unique64_next + RAND_UNIQUE64_BLOCK;
+  }
+
+  uint64_t index = rand_unique64_next++;
+
+  return rand_unique64_permute((rand_unique64_permute(index) +
+                                rand_unique64_offset) ^
+                               UINT64_C(0x5bf0363546790905));
+}
+
+/*
+  Primary key generators for insert workloads. All of them are safe to be
+  called concurrently from multiple threads and return keys that are unique
+  across threads, except UUIDv4 and the random parts of time-ordered keys,
+  which are unique with overwhelming probability.
+*/
+
+/* Sequential keys, consecutive within each thread */
+
+uint64_t sb_rand_key_sequential(void)
+{
+  if (SB_UNLIKELY(rand_key_seq_next == rand_key_seq_end))
+  {
+    rand_key_seq_next = ck_pr_faa_64(&rand_key_seq_index, RAND_KEY_SEQ_BLOCK);
+    rand_key_seq_end = rand_key_seq_next + RAND_KEY_SEQ_BLOCK;
+  }
+
+  return rand_key_seq_next++;
+}
+
+/*
+  Sequential keys passed through a bijection, i.e. unique keys scattered
+  uniformly over the 64-bit range like hashes of auto-increment ids
+*/
+
+uint64_t sb_rand_key_hashed(void)
+{
+  return rand_mix64(sb_rand_key_sequential());
+}
+
+/*
+  Snowflake-style keys, ordered by time across threads. When a thread runs out
+  of sequence numbers within a millisecond, it borrows the next millisecond.
+  Worker ids are thread ids modulo 1024, so keys are only unique with up to
+  1024 threads.
+*/
+
+uint64_t sb_rand_key_snowflake(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  const uint64_t ms = (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000 -
+    SNOWFLAKE_EPOCH_MS;
+
+  if (ms > rand_snowflake_ms)
+  {
+    rand_snowflake_ms = ms;
+    rand_snowflake_seq = 0;
+  }
+  else if (++rand_snowflake_seq >> SNOWFLAKE_SEQ_BITS)
+  {
+    rand_snowflake_ms++;
+    rand_snowflake_seq = 0;
+  }
+
+  return ((rand_snowflake_ms & ((UINT64_C(1) << SNOWFLAKE_TIME_BITS) - 1)) <<
+          (SNOWFLAKE_WORKER_BITS + SNOWFLAKE_SEQ_BITS)) |
+    ((uint64_t) (sb_tls_thread_id & ((1 << SNOWFLAKE_WORKER_BITS) - 1)) <<
+     SNOWFLAKE_SEQ_BITS) |
+    rand_snowflake_seq;
+}
+
+/* Write a 128-bit key as 32 lowercase hex digits, without a terminating NUL */
+
+static void rand_key_hex(char *buf, uint64_t hi, uint64_t lo)
+{
+  static const char digits[] = "0123456789abcdef";
+
+  for (int i = 15; i >= 0; i--)
+  {
+    buf[i] = digits[hi & 0xf];
+    buf[i + 16] = digits[lo & 0xf];
+    hi >>= 4;
+    lo >>= 4;
+  }
+}
+
+/* Random UUID (version 4, RFC 9562) */
+
+void sb_rand_uuid4(char *buf)
+{
+  const uint64_t hi = sb_rand_uniform_uint64();
+  const uint64_t lo = sb_rand_uniform_uint64();
+
+  rand_key_hex(buf, (hi & ~UINT64_C(0xf000)) | UINT64_C(0x4000),
+               (lo >> 2) | (UINT64_C(1) << 63));
+}
+
+/*
+  Time-ordered UUID (version 7, RFC 9562): 48 bits of milliseconds since the
+  Epoch, followed by 12 bits of sub-millisecond time for ordering within a
+  millisecond (method 3 of the RFC) and 62 random bits
+*/
+
+void sb_rand_uuid7(char *buf)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  const uint64_t ms = (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+  const uint64_t frac = (uint64_t) (ts.tv_nsec % 1000000) * 4096 / 1000000;
+
+  rand_key_hex(buf, (ms << 16) | UINT64_C(0x7000) | frac,
+               (sb_rand_uniform_uint64() >> 2) | (UINT64_C(1) << 63));
+}
+
+/*
+  ULID: 48 bits of milliseconds since the Epoch followed by 80 random bits.
+  The key is written in the same hex form as UUIDs, i.e. as it is stored in
+  16-byte binary or UUID columns, rather than in Crockford's base32.
+*/
+
+void sb_rand_ulid(char *buf)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  const uint64_t ms = (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+  rand_key_hex(buf, (ms << 16) | (sb_rand_uniform_uint64() >> 48),
+               sb_rand_uniform_uint64());
+}
+
 /*
   Implementation of the Zipf distribution is based on
   RejectionInversionZipfSampler.java from the Apache Commons RNG project
@@ -416,7 +979,7 @@ uint32_t sb_rand_unique(void)
   and Computer Simulation, (TOMACS) 6.3 (1996): 169-184.
 */
 
-static uint32_t sb_rand_zipfian_int(uint32_t n, double e, double s,
+static uint64_t sb_rand_zipfian_int(uint64_t n, double e, double s,
                                     double hIntegralX1)
 {
   /*
@@ -449,7 +1012,7 @@ static uint32_t sb_rand_zipfian_int(uint32_t n, double e, double s,
     /* u is uniformly distributed in (hIntegralX1, hIntegralNumberOfElements] */
 
     double x = hIntegralInverse(u, e);
-    uint32_t k = (uint32_t) (x + 0.5);
+    uint64_t k = (uint64_t) (x + 0.5);
 
     /*
       Limit k to the range [1, numberOfElements] if it would be outside due to
@@ -515,9 +1078,397 @@ static uint32_t sb_rand_zipfian_int(uint32_t n, double e, double s,
 
 uint32_t sb_rand_zipfian(uint32_t a, uint32_t b)
 {
+  return (uint32_t) sb_rand_zipfian64(a, b);
+}
+
+uint64_t sb_rand_zipfian64(uint64_t a, uint64_t b)
+{
+  const uint64_t     n = b - a + 1;
+  const zipf_table_t *t = zipf_last_table;
+
+  if (n <= zipf_table_max && n != zipf_last_miss)
+  {
+    if (t == NULL || t->n != n)
+    {
+      t = zipf_get_table(n);
+      if (t == NULL)
+        zipf_last_miss = n;
+      else
+        zipf_last_table = t;
+    }
+
+    /* Slot i is for the rank i + 1, i.e. for the value a + i */
+    if (SB_LIKELY(t != NULL))
+      return a + rand_alias_sample(t->slots, n);
+  }
+
   /* sb_rand_zipfian_int() returns a number in the range [1, b - a + 1] */
   return a +
-    sb_rand_zipfian_int(b - a + 1, zipf_exp, zipf_s, zipf_hIntegralX1) - 1;
+    sb_rand_zipfian_int(n, zipf_exp, zipf_s, zipf_hIntegralX1) - 1;
+}
+
+/*
+  Build the alias table for n < 2^32 values with weights p[], which are
+  overwritten. Slots that end up without an alias (i.e. with the probability
+  of 1) get themselves as the alias, so the threshold comparison does not
+  matter for them. Returns NULL on memory allocation failure.
+*/
+
+static rand_alias_slot_t *rand_alias_build(double *p, uint64_t n)
+{
+  rand_alias_slot_t *slots = malloc(n * sizeof(rand_alias_slot_t));
+  uint32_t          *small = malloc(n * sizeof(uint32_t));
+  uint32_t          *large = malloc(n * sizeof(uint32_t));
+  uint64_t          nsmall = 0, nlarge = 0;
+  double            sum = 0;
+
+  if (slots == NULL || small == NULL || large == NULL)
+  {
+    free(slots);
+    slots = NULL;
+    goto end;
+  }
+
+  for (uint64_t i = 0; i < n; i++)
+    sum += p[i];
+
+  for (uint64_t i = 0; i < n; i++)
+  {
+    p[i] *= n / sum;
+    if (p[i] < 1.0)
+      small[nsmall++] = i;
+    else
+      large[nlarge++] = i;
+  }
+
+  while (nsmall > 0 && nlarge > 0)
+  {
+    const uint32_t s = small[--nsmall];
+    const uint32_t l = large[nlarge - 1];
+
+    slots[s].prob = (uint32_t) (p[s] * 4294967296.0);
+    slots[s].alias = l;
+
+    p[l] -= 1.0 - p[s];
+    if (p[l] < 1.0)
+    {
+      nlarge--;
+      small[nsmall++] = l;
+    }
+  }
+
+  /* Whatever is left has the probability of 1 up to rounding errors */
+  while (nlarge > 0)
+  {
+    const uint32_t l = large[--nlarge];
+    slots[l].prob = UINT32_MAX;
+    slots[l].alias = l;
+  }
+  while (nsmall > 0)
+  {
+    const uint32_t s = small[--nsmall];
+    slots[s].prob = UINT32_MAX;
+    slots[s].alias = s;
+  }
+
+end:
+  free(small);
+  free(large);
+
+  return slots;
+}
+
+/* Return a random slot number from an alias table with n slots */
+
+static inline uint64_t rand_alias_sample(const rand_alias_slot_t *slots,
+                                         uint64_t n)
+{
+  const uint64_t          x = sb_rand_uniform_uint64();
+  const rand_alias_slot_t *slot = &slots[((x >> 32) * n) >> 32];
+
+  return (uint32_t) x < slot->prob ? (uint64_t) (slot - slots) : slot->alias;
+}
+
+/* Build the alias table for the Zipfian distribution over n values */
+
+static rand_alias_slot_t *zipf_build_table(uint64_t n)
+{
+  double            *p = malloc(n * sizeof(double));
+  rand_alias_slot_t *slots;
+
+  if (p == NULL)
+    return NULL;
+
+  for (uint64_t i = 0; i < n; i++)
+    p[i] = h(i + 1, zipf_exp);
+
+  slots = rand_alias_build(p, n);
+  free(p);
+
+  return slots;
+}
+
+/*
+  Return the alias table for n values, building it on first use. Return NULL
+  if the table cannot be built, in which case the caller falls back to
+  rejection-inversion sampling.
+*/
+
+static const zipf_table_t *zipf_get_table(uint64_t n)
+{
+  const zipf_table_t *t = NULL;
+  unsigned int       i;
+
+  pthread_mutex_lock(&zipf_tables_mutex);
+
+  for (i = 0; i < zipf_ntables; i++)
+    if (zipf_tables[i].n == n)
+      break;
+
+  if (i < zipf_ntables)
+    t = &zipf_tables[i];
+  else if (zipf_ntables < ZIPF_TABLES_MAX)
+  {
+    rand_alias_slot_t *slots = zipf_build_table(n);
+
+    if (slots != NULL)
+    {
+      zipf_tables[zipf_ntables].n = n;
+      zipf_tables[zipf_ntables].slots = slots;
+      t = &zipf_tables[zipf_ntables++];
+    }
+  }
+
+  pthread_mutex_unlock(&zipf_tables_mutex);
+
+  return t;
+}
+
+/*
+  'latest' distribution: the Zipfian distribution reversed, so that the most
+  frequent values are the newest keys. That is the upper bound of the range
+  until keys above it are reported with sb_rand_latest_insert(), then the
+  whole range is shifted up to end at the largest inserted key. The width of
+  the range (and thus the Zipfian table) stays the same.
+*/
+
+uint32_t sb_rand_latest(uint32_t a, uint32_t b)
+{
+  return (uint32_t) sb_rand_latest64(a, b);
+}
+
+uint64_t sb_rand_latest64(uint64_t a, uint64_t b)
+{
+  const uint64_t newest = ck_pr_load_64(&rand_latest_max);
+  const uint64_t top = newest > b ? newest : b;
+
+  return top - (sb_rand_zipfian64(a, b) - a);
+}
+
+/*
+  Allocate a new key for insertion. The first call returns 'first', the
+  following ones return consecutive keys. This is safe to be called
+  concurrently from multiple threads.
+*/
+
+uint64_t sb_rand_latest_next(uint64_t first)
+{
+  if (SB_UNLIKELY(ck_pr_load_64(&rand_latest_next) == 0))
+    ck_pr_cas_64(&rand_latest_next, 0, first);
+
+  return ck_pr_faa_64(&rand_latest_next, 1);
+}
+
+/*
+  Report a key as inserted, i.e. available to the 'latest' distribution. This
+  is lock-free and safe to be called concurrently from multiple threads.
+*/
+
+void sb_rand_latest_insert(uint64_t key)
+{
+  uint64_t cur = ck_pr_load_64(&rand_latest_max);
+
+  while (key > cur && !ck_pr_cas_64_value(&rand_latest_max, cur, key, &cur))
+    ck_pr_stall();
+}
+
+/*
+  Empirical distribution: a bucket is chosen with the alias table, then a
+  uniformly distributed key within the bucket is scaled to [a, b]. Uniform if
+  no --rand-empirical-file was given.
+*/
+
+uint32_t sb_rand_empirical(uint32_t a, uint32_t b)
+{
+  return (uint32_t) sb_rand_empirical64(a, b);
+}
+
+uint64_t sb_rand_empirical64(uint64_t a, uint64_t b)
+{
+  if (SB_UNLIKELY(emp_nbuckets == 0))
+    return sb_rand_uniform64(a, b);
+
+  const rand_bucket_t *bucket =
+    &emp_buckets[rand_alias_sample(emp_slots, emp_nbuckets)];
+  const double key = bucket->low + sb_rand_uniform_double() * bucket->width;
+  const uint64_t res = (key - emp_min) / emp_range * ((double) (b - a) + 1);
+
+  return a + (res > b - a ? b - a : res);
+}
+
+/*
+  Skip the characters of the distribution bar in histograms printed by
+  sysbench, i.e. "|****", along with whitespace
+*/
+
+static char *rand_empirical_skip(char *p)
+{
+  while (*p == ' ' || *p == '\t' || *p == '|' || *p == '*')
+    p++;
+  return p;
+}
+
+/*
+  Load --rand-empirical-file. Lines not starting with a number (e.g. comments
+  or the histogram header) are ignored.
+*/
+
+static int rand_empirical_load(const char *path)
+{
+  FILE         *fp;
+  char         line[1024];
+  unsigned int lineno = 0;
+  uint64_t     size = 0;
+  double       *weights = NULL;
+  double       max = 0;
+  int          rc = 1;
+
+  if ((fp = fopen(path, "r")) == NULL)
+  {
+    log_errno(LOG_FATAL, "Cannot open --rand-empirical-file '%s'", path);
+    return 1;
+  }
+
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    double v[3];
+    int    nv;
+    char   *p = line, *end;
+
+    lineno++;
+
+    for (nv = 0; nv < 3; nv++)
+    {
+      p = rand_empirical_skip(p);
+      if (*p == '\n' || *p == '\r' || *p == '\0')
+        break;
+      v[nv] = strtod(p, &end);
+      if (end == p)
+        break;
+      p = end;
+    }
+
+    if (nv == 0)
+      continue;
+
+    p = rand_empirical_skip(p);
+    if (*p != '\n' && *p != '\r' && *p != '\0')
+    {
+      log_text(LOG_FATAL, "%s:%u: invalid empirical distribution line",
+               path, lineno);
+      goto end;
+    }
+
+    rand_bucket_t bucket = { .low = v[0], .width = 1 };
+    double        w = 1;
+
+    if (nv == 2)
+      w = v[1];
+    else if (nv == 3)
+    {
+      bucket.width = v[1] - v[0] + 1;
+      w = v[2];
+    }
+
+    if (w < 0 || bucket.width < 1)
+    {
+      log_text(LOG_FATAL, "%s:%u: invalid empirical distribution line",
+               path, lineno);
+      goto end;
+    }
+
+    if (emp_nbuckets == size)
+    {
+      size = size ? size * 2 : 1024;
+      if (size > UINT32_MAX)
+      {
+        log_text(LOG_FATAL, "Too many lines in --rand-empirical-file");
+        goto end;
+      }
+
+      rand_bucket_t *buckets = realloc(emp_buckets,
+                                       size * sizeof(rand_bucket_t));
+      double        *tmp = realloc(weights, size * sizeof(double));
+
+      if (buckets != NULL)
+        emp_buckets = buckets;
+      if (tmp != NULL)
+        weights = tmp;
+      if (buckets == NULL || tmp == NULL)
+      {
+        log_text(LOG_FATAL, "Memory allocation failure");
+        goto end;
+      }
+    }
+
+    if (emp_nbuckets == 0 || bucket.low < emp_min)
+      emp_min = bucket.low;
+    if (emp_nbuckets == 0 || bucket.low + bucket.width > max)
+      max = bucket.low + bucket.width;
+
+    emp_buckets[emp_nbuckets] = bucket;
+    weights[emp_nbuckets++] = w;
+  }
+
+  if (ferror(fp))
+  {
+    log_errno(LOG_FATAL, "Cannot read --rand-empirical-file '%s'", path);
+    goto end;
+  }
+
+  double sum = 0;
+  for (uint64_t i = 0; i < emp_nbuckets; i++)
+    sum += weights[i];
+
+  if (sum <= 0)
+  {
+    log_text(LOG_FATAL, "No keys with non-zero weight in "
+             "--rand-empirical-file '%s'", path);
+    goto end;
+  }
+
+  emp_range = max - emp_min;
+
+  if ((emp_slots = rand_alias_build(weights, emp_nbuckets)) == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    goto end;
+  }
+
+  rc = 0;
+
+end:
+  if (rc != 0)
+  {
+    free(emp_buckets);
+    emp_buckets = NULL;
+    emp_nbuckets = 0;
+  }
+
+  free(weights);
+  fclose(fp);
+
+  return rc;
 }
 
 /*
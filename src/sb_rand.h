@@ -30,7 +30,9 @@ typedef enum
   DIST_TYPE_GAUSSIAN,
   DIST_TYPE_SPECIAL,
   DIST_TYPE_PARETO,
-  DIST_TYPE_ZIPFIAN
+  DIST_TYPE_ZIPFIAN,
+  DIST_TYPE_LATEST,
+  DIST_TYPE_EMPIRICAL
 } rand_dist_t;
 
 typedef uint64_t sb_rng_state_t [2];
@@ -56,6 +58,43 @@ inline double sb_rand_uniform_double(void)
   return u.d - 1.0;
 }
 
+/*
+  Random digits and letters are drawn several at a time: each 64-bit random
+  value is split into two 32-bit fractions, and each fraction yields
+  SB_RAND_CHARS_PER_32 characters by repeated multiplication by the size of the
+  character range, i.e. by taking successive "digits" of the fraction in that
+  base. Ranges are limited to 26 characters, so at least 13 bits of the
+  fraction are left for the last character.
+*/
+#define SB_RAND_CHARS_PER_32 4
+
+typedef struct
+{
+  uint32_t     frac[2];         /* fractions left from the last random value */
+  unsigned int n;               /* number of characters left in frac[] */
+} sb_rand_chars_t;
+
+/* Return a random character between lo and hi, hi - lo must be below 26 */
+inline char sb_rand_char(sb_rand_chars_t *s, char lo, char hi)
+{
+  if (s->n == 0)
+  {
+    const uint64_t x = sb_rand_uniform_uint64();
+
+    /* The upper bits of xoroshiro128+ output are better, so use them first */
+    s->frac[0] = (uint32_t) x;
+    s->frac[1] = (uint32_t) (x >> 32);
+    s->n = 2 * SB_RAND_CHARS_PER_32;
+  }
+
+  uint32_t * const f = &s->frac[--s->n / SB_RAND_CHARS_PER_32];
+  const uint64_t   m = (uint64_t) *f * (uint32_t) (hi - lo + 1);
+
+  *f = (uint32_t) m;
+
+  return lo + (char) (m >> 32);
+}
+
 int sb_rand_register(void);
 void sb_rand_print_help(void);
 int sb_rand_init(void);
@@ -69,7 +108,45 @@ uint32_t sb_rand_gaussian(uint32_t, uint32_t);
 uint32_t sb_rand_special(uint32_t, uint32_t);
 uint32_t sb_rand_pareto(uint32_t, uint32_t);
 uint32_t sb_rand_zipfian(uint32_t, uint32_t);
+uint32_t sb_rand_latest(uint32_t, uint32_t);
+uint32_t sb_rand_empirical(uint32_t, uint32_t);
 uint32_t sb_rand_unique(void);
+uint64_t sb_rand_default64(uint64_t, uint64_t);
+uint64_t sb_rand_uniform64(uint64_t, uint64_t);
+uint64_t sb_rand_gaussian64(uint64_t, uint64_t);
+uint64_t sb_rand_special64(uint64_t, uint64_t);
+uint64_t sb_rand_pareto64(uint64_t, uint64_t);
+uint64_t sb_rand_zipfian64(uint64_t, uint64_t);
+uint64_t sb_rand_latest64(uint64_t, uint64_t);
+uint64_t sb_rand_empirical64(uint64_t, uint64_t);
+uint64_t sb_rand_unique64(void);
+uint64_t sb_rand_latest_next(uint64_t);
+void sb_rand_latest_insert(uint64_t);
+
+/*
+  Primary key generators. The 128-bit ones write 32 hex digits into the
+  buffer without a terminating NUL.
+*/
+uint64_t sb_rand_key_sequential(void);
+uint64_t sb_rand_key_hashed(void);
+uint64_t sb_rand_key_snowflake(void);
+void sb_rand_uuid4(char *);
+void sb_rand_uuid7(char *);
+void sb_rand_ulid(char *);
+
+/*
+  Fill buf with n values from the corresponding distribution, amortizing the
+  call overhead, e.g. for FFI calls from Lua
+*/
+void sb_rand_fill_uint64(uint64_t *, size_t);
+void sb_rand_fill_default(uint64_t *, size_t, uint64_t, uint64_t);
+void sb_rand_fill_uniform(uint64_t *, size_t, uint64_t, uint64_t);
+void sb_rand_fill_gaussian(uint64_t *, size_t, uint64_t, uint64_t);
+void sb_rand_fill_special(uint64_t *, size_t, uint64_t, uint64_t);
+void sb_rand_fill_pareto(uint64_t *, size_t, uint64_t, uint64_t);
+void sb_rand_fill_zipfian(uint64_t *, size_t, uint64_t, uint64_t);
+void sb_rand_fill_latest(uint64_t *, size_t, uint64_t, uint64_t);
+void sb_rand_fill_empirical(uint64_t *, size_t, uint64_t, uint64_t);
 void sb_rand_str(const char *, char *);
 uint32_t sb_rand_varstr(char *, uint32_t, uint32_t);
 
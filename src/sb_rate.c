@@ -0,0 +1,436 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Event arrival processes for --rate. Apart from the constant rate, all models
+  are Poisson processes with a piecewise constant rate, i.e. the rate is
+  multiplied by a factor that changes at segment boundaries:
+
+  poisson  - a single segment with the factor of 1
+  onoff    - bursts at --rate-burst-factor times the average rate alternate
+             with silence (an interrupted Poisson process)
+  mmpp     - a two-state Markov-modulated Poisson process alternating between
+             --rate-burst-factor times the average rate and the average rate
+             divided by the same factor
+  schedule - a factor for each second from --rate-schedule-file
+
+  Burst and quiet periods have exponentially distributed durations chosen so
+  that the long-run average rate is --rate. Segments are shared by all
+  threads, so bursts of per-thread arrival streams coincide. With --profile,
+  the factors are further multiplied by the rate of the current phase.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#ifdef HAVE_MATH_H
+# include <math.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+#include <stdio.h>
+
+#include "sb_rate.h"
+#include "sb_profile.h"
+#include "sb_rand.h"
+#include "sb_timer.h"
+#include "sb_util.h"
+#include "sb_ck_pr.h"
+#include "sysbench.h"
+
+typedef enum
+{
+  RATE_POISSON,
+  RATE_CONSTANT,
+  RATE_ONOFF,
+  RATE_MMPP,
+  RATE_SCHEDULE
+} rate_model_t;
+
+static const char *rate_model_names[] =
+{
+  "poisson", "constant", "onoff", "mmpp", "schedule", NULL
+};
+
+static rate_model_t rate_model;
+
+/* Target rate set at run time, 0 for sb_globals.tx_rate */
+static unsigned int rate_target;
+
+/* Rate factor in bursts and mean burst duration, for onoff and mmpp */
+static double   burst_factor;
+static double   burst_ns;
+
+/* Per-second rate factors for the schedule model */
+static double   *schedule;
+static unsigned schedule_len;
+
+/*
+  Number of the most recent onoff and mmpp segments kept. Threads behind
+  schedule may still generate arrivals in past segments.
+*/
+#define RATE_SEGMENTS 256
+
+/* Recent segments of the onoff and mmpp models, the last one is current */
+static struct
+{
+  pthread_mutex_t mutex;
+  uint64_t        start_ns[RATE_SEGMENTS];
+  bool            burst[RATE_SEGMENTS]; /* is this a burst? */
+  uint64_t        n;            /* number of segments so far */
+  uint64_t        end_ns;       /* end of the current segment */
+} segment;
+
+
+static int rate_schedule_load(const char *path);
+
+
+int sb_rate_init(void)
+{
+  const char *s;
+  int        i;
+
+  s = sb_get_value_string("rate-model");
+  for (i = 0; rate_model_names[i] != NULL; i++)
+    if (!strcmp(rate_model_names[i], s))
+      break;
+  if (rate_model_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for --rate-model: %s", s);
+    return 1;
+  }
+  rate_model = (rate_model_t) i;
+
+  burst_factor = sb_get_value_double("rate-burst-factor");
+  if (burst_factor <= 1)
+  {
+    log_text(LOG_FATAL, "Invalid value for --rate-burst-factor: %f",
+             burst_factor);
+    return 1;
+  }
+
+  burst_ns = sb_get_value_double("rate-burst-time") * 1e6;
+  if (burst_ns <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --rate-burst-time: %f",
+             burst_ns / 1e6);
+    return 1;
+  }
+
+  s = sb_get_value_string("rate-schedule-file");
+  if (rate_model == RATE_SCHEDULE)
+  {
+    if (sb_profile_enabled())
+    {
+      log_text(LOG_FATAL, "--rate-model=schedule cannot be used with "
+               "--profile");
+      return 1;
+    }
+    if (s == NULL)
+    {
+      log_text(LOG_FATAL, "--rate-model=schedule requires "
+               "--rate-schedule-file");
+      return 1;
+    }
+    if (rate_schedule_load(s))
+      return 1;
+  }
+  else if (rate_model != RATE_POISSON && sb_globals.tx_rate == 0)
+  {
+    log_text(LOG_FATAL, "--rate-model=%s requires --rate",
+             rate_model_names[rate_model]);
+    return 1;
+  }
+
+  pthread_mutex_init(&segment.mutex, NULL);
+
+  return 0;
+}
+
+
+/*
+  Load per-second rates, one per line. Empty lines and lines starting with '#'
+  are ignored. The schedule is repeated if the run is longer. --rate is set to
+  the average rate, and the schedule is stored as factors of it.
+*/
+
+static int rate_schedule_load(const char *path)
+{
+  FILE         *fp;
+  char         line[256];
+  unsigned int lineno = 0;
+  unsigned int size = 0;
+  double       sum = 0;
+
+  if ((fp = fopen(path, "r")) == NULL)
+  {
+    log_errno(LOG_FATAL, "Cannot open --rate-schedule-file '%s'", path);
+    return 1;
+  }
+
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    char   *p = line + strspn(line, " \t");
+    char   *end;
+    double v;
+
+    lineno++;
+
+    if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+      continue;
+
+    v = strtod(p, &end);
+    if (end == p || v < 0 || end[strspn(end, " \t\r\n")] != '\0')
+    {
+      log_text(LOG_FATAL, "%s:%u: invalid rate schedule line", path, lineno);
+      goto error;
+    }
+
+    if (schedule_len == size)
+    {
+      double *tmp;
+
+      size = size > 0 ? size * 2 : 64;
+      if ((tmp = realloc(schedule, size * sizeof(double))) == NULL)
+      {
+        log_text(LOG_FATAL, "Memory allocation failure");
+        goto error;
+      }
+      schedule = tmp;
+    }
+
+    schedule[schedule_len++] = v;
+    sum += v;
+  }
+
+  fclose(fp);
+
+  if (sum == 0)
+  {
+    log_text(LOG_FATAL, "No non-zero rates in --rate-schedule-file '%s'",
+             path);
+    return 1;
+  }
+
+  if (sb_globals.tx_rate > 0)
+    log_text(LOG_WARNING, "--rate is ignored with --rate-model=schedule");
+
+  const double avg = sum / schedule_len;
+
+  sb_globals.tx_rate = avg >= 1 ? (int) (avg + 0.5) : 1;
+
+  for (unsigned int i = 0; i < schedule_len; i++)
+    schedule[i] /= sb_globals.tx_rate;
+
+  return 0;
+
+error:
+  fclose(fp);
+
+  return 1;
+}
+
+
+void sb_rate_start(void)
+{
+  segment.n = 0;
+  rate_target = 0;
+}
+
+
+void sb_rate_set_target(unsigned int rate)
+{
+  ck_pr_store_uint(&rate_target, rate);
+}
+
+
+unsigned int sb_rate_target(void)
+{
+  const unsigned int rate = ck_pr_load_uint(&rate_target);
+
+  return rate > 0 ? rate : (unsigned int) sb_globals.tx_rate;
+}
+
+
+/* Exponentially distributed interval with a given rate */
+
+static inline double rate_exp(double lambda)
+{
+  return -1.0 / lambda * log(1 - sb_rand_uniform_double());
+}
+
+
+/*
+  Get the rate factor at time t and the end of its segment. onoff and mmpp
+  segments are generated as time moves forward, a time before the oldest one
+  kept is treated as belonging to it.
+*/
+
+static double rate_segment(uint64_t t, uint64_t *end_ns)
+{
+  double factor;
+
+  if (rate_model == RATE_SCHEDULE)
+  {
+    const uint64_t sec = t / NS_PER_SEC;
+
+    *end_ns = (sec + 1) * NS_PER_SEC;
+    return schedule[sec % schedule_len];
+  }
+
+  /* Mean durations of bursts and quiet periods */
+  const double quiet_ns = rate_model == RATE_ONOFF ?
+    burst_ns * (burst_factor - 1) : burst_ns * burst_factor;
+
+  pthread_mutex_lock(&segment.mutex);
+
+  if (segment.n == 0)
+  {
+    /* Start in a state with its stationary probability */
+    const bool burst = sb_rand_uniform_double() * (burst_ns + quiet_ns) <
+      burst_ns;
+
+    segment.start_ns[0] = t;
+    segment.burst[0] = burst;
+    segment.end_ns = t + rate_exp(1 / (burst ? burst_ns : quiet_ns)) + 1;
+    segment.n = 1;
+  }
+
+  while (segment.end_ns <= t)
+  {
+    const unsigned int i = segment.n % RATE_SEGMENTS;
+    const bool         burst = !segment.burst[(segment.n - 1) % RATE_SEGMENTS];
+
+    segment.start_ns[i] = segment.end_ns;
+    segment.burst[i] = burst;
+    segment.end_ns += rate_exp(1 / (burst ? burst_ns : quiet_ns)) + 1;
+    segment.n++;
+  }
+
+  /* Find the segment containing t, searching from the current one */
+  uint64_t k = segment.n - 1;
+  uint64_t end = segment.end_ns;
+
+  while (k > 0 && segment.n - k < RATE_SEGMENTS &&
+         segment.start_ns[k % RATE_SEGMENTS] > t)
+  {
+    end = segment.start_ns[k % RATE_SEGMENTS];
+    k--;
+  }
+
+  *end_ns = end;
+
+  if (segment.burst[k % RATE_SEGMENTS])
+    factor = burst_factor;
+  else
+    factor = rate_model == RATE_ONOFF ? 0 : 1 / burst_factor;
+
+  pthread_mutex_unlock(&segment.mutex);
+
+  return factor;
+}
+
+
+uint64_t sb_rate_next(uint64_t prev_ns, double lambda, int stream)
+{
+  const bool         profile = sb_profile_enabled();
+  const unsigned int target = ck_pr_load_uint(&rate_target);
+
+  if (target > 0)
+    lambda *= (double) target / sb_globals.tx_rate;
+
+  if (!profile && rate_model == RATE_POISSON)
+    return prev_ns + rate_exp(lambda);
+
+  if (!profile && rate_model == RATE_CONSTANT)
+    return prev_ns + 1 / lambda;
+
+  /*
+    The interval until the next arrival is drawn as the amount of work at the
+    unit rate, 1 for evenly spaced events or exponentially distributed
+    otherwise. It is then consumed by segments of constant rate in turn.
+  */
+  double   work = rate_model == RATE_CONSTANT ? 1 :
+    -log(1 - sb_rand_uniform_double());
+  uint64_t t = prev_ns;
+
+  for (;;)
+  {
+    uint64_t end_ns = UINT64_MAX;
+    double   factor = profile ? sb_profile_rate(t, stream, &end_ns) : 1;
+
+    /* Skip segments of the model while the profile rate is zero */
+    if (factor > 0 && rate_model != RATE_POISSON &&
+        rate_model != RATE_CONSTANT)
+    {
+      uint64_t segment_end_ns;
+
+      factor *= rate_segment(t, &segment_end_ns);
+      end_ns = SB_MIN(end_ns, segment_end_ns);
+    }
+
+    const double rate = lambda * factor;
+
+    if (rate > 0)
+    {
+      const double next = t + work / rate;
+
+      if (next < end_ns)
+        return (uint64_t) next;
+
+      work -= (end_ns - t) * rate;
+    }
+
+    /* No more arrivals in this stream */
+    if (end_ns == UINT64_MAX)
+      return UINT64_MAX;
+
+    t = end_ns > t ? end_ns : t;
+  }
+}
+
+
+bool sb_rate_deterministic(void)
+{
+  return rate_model == RATE_CONSTANT;
+}
+
+
+const char *sb_rate_model_name(void)
+{
+  return rate_model_names[rate_model];
+}
+
+
+void sb_rate_done(void)
+{
+  free(schedule);
+  schedule = NULL;
+  schedule_len = 0;
+
+  pthread_mutex_destroy(&segment.mutex);
+}
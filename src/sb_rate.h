@@ -0,0 +1,69 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Event arrival processes for --rate, see --rate-model */
+
+#ifndef SB_RATE_H
+#define SB_RATE_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  Parse --rate-model and related options. Sets sb_globals.tx_rate from the
+  schedule file with --rate-model=schedule. Returns 0 on success.
+*/
+int sb_rate_init(void);
+
+/* Reset the state of the arrival process at the start of a run */
+void sb_rate_start(void);
+
+/*
+  Change the average rate within a run, e.g. between the probes of
+  --slo-latency. 0 restores sb_globals.tx_rate. The lambda values passed to
+  sb_rate_next() are scaled accordingly.
+*/
+void sb_rate_set_target(unsigned int rate);
+
+/* Return the current average rate */
+unsigned int sb_rate_target(void);
+
+/*
+  Return the time of the next arrival after the one at prev_ns for a stream of
+  arrivals with an average rate of lambda events per nanosecond. Times are
+  values of sb_exec_timer. Several threads may generate independent streams
+  with their shares of the total rate, the bursts of modulated models are the
+  same for all of them. stream is the thread generating its own share, or -1
+  for the total rate, see sb_profile_rate(). Returns UINT64_MAX if there are no
+  more arrivals.
+*/
+uint64_t sb_rate_next(uint64_t prev_ns, double lambda, int stream);
+
+/* Return true if arrivals are evenly spaced, i.e. with --rate-model=constant */
+bool sb_rate_deterministic(void);
+
+/* Return the --rate-model name */
+const char *sb_rate_model_name(void);
+
+void sb_rate_done(void);
+
+#endif /* SB_RATE_H */
@@ -0,0 +1,743 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Saved results and baseline comparisons. --save-result writes the cumulative
+  statistics of a run, the latency histogram and all options to a JSON file.
+  --compare-to reads such a file back, prints the differences and flags a
+  regression when throughput, a latency percentile or the latency
+  distribution as a whole got worse by more than the --compare-* thresholds.
+
+  The reader only understands files written by --save-result, not arbitrary
+  JSON: keys are looked up by name, with the results preceding the options so
+  that option names cannot shadow result keys.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdio.h>
+# include <stdlib.h>
+# include <ctype.h>
+# include <inttypes.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_MATH_H
+# include <math.h>
+#endif
+#ifdef TIME_WITH_SYS_TIME
+# include <sys/time.h>
+# include <time.h>
+#else
+# ifdef HAVE_SYS_TIME_H
+#  include <sys/time.h>
+# else
+#  include <time.h>
+# endif
+#endif
+
+#include "sb_result.h"
+#include "sb_histogram.h"
+#include "sb_logger.h"
+#include "sb_options.h"
+#include "sb_util.h"
+
+#define RESULT_FORMAT  "sysbench-result"
+#define RESULT_VERSION 1
+
+/* One-sided significance level of the latency distribution test */
+#define DIST_ALPHA 0.01
+
+typedef struct
+{
+  double   value;               /* lower bound of the bucket in ms */
+  uint64_t count;
+} result_bucket_t;
+
+typedef struct
+{
+  char            *text;        /* file contents */
+  const char      *config;      /* start of the options section in text */
+  char            timestamp[32];
+  double          eps;
+  size_t          npcts;
+  double          *ranks;
+  double          *pcts;        /* in ms */
+  size_t          nbuckets;
+  result_bucket_t *buckets;
+} result_baseline_t;
+
+static const char        *save_path;
+static const char        *compare_path;
+static double            tps_threshold;
+static double            latency_threshold;
+static double            dist_threshold;
+
+static result_baseline_t baseline;
+
+/* Latency histogram counts at the start of the measured part of the run */
+static uint64_t          *start_counts;
+static uint64_t          *counts;
+
+static bool              regressed;
+
+
+/* Write a JSON string literal */
+
+static void json_write_string(FILE *f, const char *s)
+{
+  fputc('"', f);
+
+  for (; *s != '\0'; s++)
+  {
+    const unsigned char c = (unsigned char) *s;
+
+    if (c == '"' || c == '\\')
+      fprintf(f, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(f, "\\u%04x", c);
+    else
+      fputc(c, f);
+  }
+
+  fputc('"', f);
+}
+
+
+static const char *skip_ws(const char *p)
+{
+  while (isspace((unsigned char) *p))
+    p++;
+
+  return p;
+}
+
+
+/*
+  Return a pointer to the value of the first "key" at or after p, or NULL if
+  there is none
+*/
+
+static const char *json_find(const char *p, const char *key)
+{
+  const size_t len = strlen(key);
+
+  while ((p = strchr(p, '"')) != NULL)
+  {
+    p++;
+
+    if (!strncmp(p, key, len) && p[len] == '"')
+    {
+      const char *v = skip_ws(p + len + 1);
+
+      if (*v == ':')
+        return skip_ws(v + 1);
+    }
+
+    /* Skip the rest of this string */
+    while (*p != '\0' && *p != '"')
+      p += (*p == '\\' && p[1] != '\0') ? 2 : 1;
+
+    if (*p == '\0')
+      return NULL;
+    p++;
+  }
+
+  return NULL;
+}
+
+
+/*
+  Copy a JSON string literal at p into buf, return a pointer past it or NULL
+  on error
+*/
+
+static const char *json_read_string(const char *p, char *buf, size_t size)
+{
+  size_t n = 0;
+
+  if (p == NULL || *p++ != '"')
+    return NULL;
+
+  for (; *p != '"'; p++)
+  {
+    char c = *p;
+
+    if (c == '\0')
+      return NULL;
+
+    if (c == '\\')
+    {
+      p++;
+      if (*p == 'u')
+      {
+        unsigned int u;
+
+        if (sscanf(p + 1, "%4x", &u) != 1)
+          return NULL;
+        c = (char) u;
+        p += 4;
+      }
+      else if (*p == '\0')
+        return NULL;
+      else
+        c = *p;
+    }
+
+    if (n + 1 < size)
+      buf[n++] = c;
+  }
+
+  buf[n] = '\0';
+
+  return p + 1;
+}
+
+
+/* Join all values of an option with commas */
+
+static void option_value(option_t *opt, char *buf, size_t size)
+{
+  sb_list_item_t *pos;
+  size_t         n = 0;
+
+  buf[0] = '\0';
+
+  SB_LIST_FOR_EACH(pos, &opt->values)
+  {
+    const char *data = SB_LIST_ENTRY(pos, value_t, listitem)->data;
+
+    n += snprintf(buf + n, n < size ? size - n : 0, "%s%s", n > 0 ? "," : "",
+                  data != NULL ? data : "");
+  }
+}
+
+
+/* Options that are not saved, as they may contain secrets */
+
+static bool option_secret(const char *name)
+{
+  return strstr(name, "password") != NULL;
+}
+
+
+static int load_baseline(const char *path)
+{
+  FILE       *f = fopen(path, "r");
+  char       format[32];
+  const char *p;
+  long       size;
+
+  if (f == NULL)
+  {
+    log_errno(LOG_FATAL, "Cannot open --compare-to '%s'", path);
+    return 1;
+  }
+
+  if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 ||
+      fseek(f, 0, SEEK_SET) != 0 ||
+      (baseline.text = malloc((size_t) size + 1)) == NULL ||
+      fread(baseline.text, 1, (size_t) size, f) != (size_t) size)
+  {
+    log_errno(LOG_FATAL, "Reading --compare-to '%s' failed", path);
+    fclose(f);
+    return 1;
+  }
+
+  fclose(f);
+  baseline.text[size] = '\0';
+
+  const char *text = baseline.text;
+
+  if (json_read_string(json_find(text, "format"), format,
+                       sizeof(format)) == NULL ||
+      strcmp(format, RESULT_FORMAT) ||
+      (p = json_find(text, "version")) == NULL ||
+      atoi(p) != RESULT_VERSION)
+  {
+    log_text(LOG_FATAL, "'%s' is not a result saved by --save-result of this "
+             "version of sysbench", path);
+    return 1;
+  }
+
+  if (json_read_string(json_find(text, "timestamp"), baseline.timestamp,
+                       sizeof(baseline.timestamp)) == NULL ||
+      (p = json_find(text, "events_per_sec")) == NULL)
+    goto error;
+
+  baseline.eps = strtod(p, NULL);
+
+  /* Latency percentiles: { "RANK": VALUE, ... } */
+  if ((p = json_find(text, "percentiles")) == NULL || *p != '{')
+    goto error;
+
+  for (p = skip_ws(p + 1); *p != '}'; p = skip_ws(p))
+  {
+    char   rank[32];
+    double *ranks, *pcts;
+    char   *end;
+
+    if ((p = json_read_string(p, rank, sizeof(rank))) == NULL ||
+        *(p = skip_ws(p)) != ':')
+      goto error;
+
+    ranks = realloc(baseline.ranks, (baseline.npcts + 1) * sizeof(double));
+    if (ranks != NULL)
+      baseline.ranks = ranks;
+    pcts = realloc(baseline.pcts, (baseline.npcts + 1) * sizeof(double));
+    if (pcts != NULL)
+      baseline.pcts = pcts;
+    if (ranks == NULL || pcts == NULL)
+      goto error;
+
+    baseline.ranks[baseline.npcts] = atof(rank);
+    baseline.pcts[baseline.npcts] = strtod(p + 1, &end);
+    if (end == p + 1)
+      goto error;
+    baseline.npcts++;
+
+    p = skip_ws(end);
+    if (*p == ',')
+      p++;
+  }
+
+  /* Latency histogram: [ [VALUE, COUNT], ... ] */
+  if ((p = json_find(text, "histogram_ms")) == NULL || *p != '[')
+    goto error;
+
+  for (p = skip_ws(p + 1); *p != ']'; p = skip_ws(p))
+  {
+    result_bucket_t *buckets;
+    char            *end;
+
+    if (*p != '[')
+      goto error;
+
+    buckets = realloc(baseline.buckets,
+                      (baseline.nbuckets + 1) * sizeof(result_bucket_t));
+    if (buckets == NULL)
+      goto error;
+    baseline.buckets = buckets;
+
+    buckets[baseline.nbuckets].value = strtod(p + 1, &end);
+    if (*(p = skip_ws(end)) != ',')
+      goto error;
+    buckets[baseline.nbuckets].count = strtoull(p + 1, &end, 10);
+    if (*(p = skip_ws(end)) != ']')
+      goto error;
+    baseline.nbuckets++;
+
+    p = skip_ws(p + 1);
+    if (*p == ',')
+      p++;
+  }
+
+  if ((baseline.config = json_find(p, "config")) == NULL)
+    goto error;
+
+  return 0;
+
+ error:
+  log_text(LOG_FATAL, "Invalid or truncated --compare-to '%s'", path);
+  return 1;
+}
+
+
+int sb_result_init(void)
+{
+  save_path = sb_get_value_string("save-result");
+  compare_path = sb_get_value_string("compare-to");
+  tps_threshold = sb_get_value_double("compare-tps-threshold");
+  latency_threshold = sb_get_value_double("compare-latency-threshold");
+  dist_threshold = sb_get_value_double("compare-dist-threshold");
+
+  if (tps_threshold < 0 || tps_threshold > 100)
+  {
+    log_text(LOG_FATAL, "Invalid value for --compare-tps-threshold: %f",
+             tps_threshold);
+    return 1;
+  }
+
+  if (latency_threshold < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --compare-latency-threshold: %f",
+             latency_threshold);
+    return 1;
+  }
+
+  if (dist_threshold < 0 || dist_threshold > 1)
+  {
+    log_text(LOG_FATAL, "Invalid value for --compare-dist-threshold: %f",
+             dist_threshold);
+    return 1;
+  }
+
+  if (compare_path != NULL && load_baseline(compare_path))
+    return 1;
+
+  return 0;
+}
+
+
+bool sb_result_enabled(void)
+{
+  return save_path != NULL || compare_path != NULL;
+}
+
+
+void sb_result_start(void)
+{
+  if (!sb_result_enabled())
+    return;
+
+  const size_t size = sb_latency_histogram.array_size;
+
+  if (start_counts == NULL)
+  {
+    start_counts = malloc(size * sizeof(uint64_t));
+    counts = malloc(size * sizeof(uint64_t));
+
+    if (start_counts == NULL || counts == NULL)
+    {
+      log_text(LOG_WARNING, "Memory allocation failure, the latency histogram "
+               "will not be saved or compared");
+      free(start_counts);
+      free(counts);
+      start_counts = counts = NULL;
+      return;
+    }
+  }
+
+  sb_histogram_get_counts(&sb_latency_histogram, start_counts);
+}
+
+
+/* Store histogram counts since sb_result_start() in counts */
+
+static void get_run_counts(void)
+{
+  const size_t size = sb_latency_histogram.array_size;
+
+  sb_histogram_get_counts(&sb_latency_histogram, counts);
+
+  for (size_t i = 0; i < size; i++)
+    counts[i] -= start_counts[i];
+}
+
+
+static void save_result(const sb_stat_t *stat)
+{
+  FILE           *f = fopen(save_path, "w");
+  char           buf[4096];
+  time_t         now = time(NULL);
+  sb_list_item_t *pos;
+  option_t       *opt;
+  bool           first;
+
+  if (f == NULL)
+  {
+    log_errno(LOG_FATAL, "Cannot open --save-result '%s'", save_path);
+    return;
+  }
+
+  const double seconds = stat->time_interval > 0 ? stat->time_interval : 1;
+
+  strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+  fprintf(f, "{\n");
+  fprintf(f, "  \"format\": \"%s\",\n", RESULT_FORMAT);
+  fprintf(f, "  \"version\": %d,\n", RESULT_VERSION);
+  fprintf(f, "  \"sysbench\": \"%s\",\n", PACKAGE_VERSION SB_GIT_SHA);
+  fprintf(f, "  \"timestamp\": \"%s\",\n", buf);
+  fprintf(f, "  \"test\": ");
+  json_write_string(f, sb_globals.testname != NULL ? sb_globals.testname : "");
+  fprintf(f, ",\n");
+  fprintf(f, "  \"threads\": %u,\n", sb_globals.threads);
+  fprintf(f, "  \"time\": %.6f,\n", stat->time_interval);
+  fprintf(f, "  \"events\": %" PRIu64 ",\n", stat->events);
+  fprintf(f, "  \"events_per_sec\": %.6f,\n", stat->events / seconds);
+  fprintf(f, "  \"queries_per_sec\": %.6f,\n",
+          (stat->reads + stat->writes + stat->other) / seconds);
+  fprintf(f, "  \"errors_per_sec\": %.6f,\n", stat->errors / seconds);
+  fprintf(f, "  \"reconnects_per_sec\": %.6f,\n", stat->reconnects / seconds);
+
+  fprintf(f, "  \"latency_ms\": {\n");
+  fprintf(f, "    \"min\": %.6f,\n", SEC2MS(stat->latency_min));
+  fprintf(f, "    \"avg\": %.6f,\n", SEC2MS(stat->latency_avg));
+  fprintf(f, "    \"max\": %.6f,\n", SEC2MS(stat->latency_max));
+  fprintf(f, "    \"sum\": %.6f,\n", SEC2MS(stat->latency_sum));
+  fprintf(f, "    \"percentiles\": {");
+  for (size_t i = 0; i < sb_globals.npercentiles; i++)
+    fprintf(f, "%s\n      \"%.2f\": %.6f", i > 0 ? "," : "",
+            sb_globals.percentiles[i], SEC2MS(stat->latency_pcts[i]));
+  fprintf(f, "\n    }\n");
+  fprintf(f, "  },\n");
+
+  /* Non-empty buckets of the latency histogram as [lower bound, count] */
+  fprintf(f, "  \"histogram_ms\": [");
+  first = true;
+  if (counts != NULL)
+  {
+    for (size_t i = 0; i < sb_latency_histogram.array_size; i++)
+    {
+      if (counts[i] == 0)
+        continue;
+
+      fprintf(f, "%s\n    [%.6g, %" PRIu64 "]", first ? "" : ",",
+              sb_histogram_get_value(&sb_latency_histogram, i), counts[i]);
+      first = false;
+    }
+  }
+  fprintf(f, "\n  ],\n");
+
+  fprintf(f, "  \"config\": {");
+  first = true;
+  pos = sb_options_enum_start();
+  while ((pos = sb_options_enum_next(pos, &opt)) != NULL)
+  {
+    if (option_secret(opt->name))
+      continue;
+
+    option_value(opt, buf, sizeof(buf));
+    fprintf(f, "%s\n    ", first ? "" : ",");
+    json_write_string(f, opt->name);
+    fprintf(f, ": ");
+    json_write_string(f, buf);
+    first = false;
+  }
+  fprintf(f, "\n  }\n");
+  fprintf(f, "}\n");
+
+  if (fclose(f) != 0)
+    log_errno(LOG_FATAL, "Writing --save-result '%s' failed", save_path);
+}
+
+
+/*
+  One-sided two-sample Kolmogorov-Smirnov test of whether current latencies
+  are larger than the baseline ones. Returns the largest difference between
+  the baseline and the current cumulative distribution functions, and its
+  asymptotic p-value in *p.
+*/
+
+static double dist_test(double *p)
+{
+  const size_t size = sb_latency_histogram.array_size;
+  uint64_t     n = 0, m = 0, cn = 0, cm = 0;
+  size_t       i = 0, j = 0;
+  double       d = 0;
+
+  for (size_t k = 0; k < baseline.nbuckets; k++)
+    n += baseline.buckets[k].count;
+  for (size_t k = 0; k < size; k++)
+    m += counts[k];
+
+  *p = 1;
+
+  if (n == 0 || m == 0)
+    return 0;
+
+  /* Merge both sets of buckets in the order of their values */
+  while (i < baseline.nbuckets || j < size)
+  {
+    const double bv = i < baseline.nbuckets ? baseline.buckets[i].value :
+      INFINITY;
+    const double cv = j < size ?
+      sb_histogram_get_value(&sb_latency_histogram, j) : INFINITY;
+    const double v = SB_MIN(bv, cv);
+
+    while (i < baseline.nbuckets && baseline.buckets[i].value <= v)
+      cn += baseline.buckets[i++].count;
+    while (j < size && sb_histogram_get_value(&sb_latency_histogram, j) <= v)
+      cm += counts[j++];
+
+    d = SB_MAX(d, (double) cn / n - (double) cm / m);
+  }
+
+  *p = exp(-2.0 * d * d * ((double) n * m / (n + m)));
+
+  return d;
+}
+
+
+/* Return the percentage change from a to b */
+
+static double pct_change(double a, double b)
+{
+  return a != 0 ? (b - a) * 100 / a : 0;
+}
+
+
+static void compare_result(const sb_stat_t *stat)
+{
+  const double seconds = stat->time_interval > 0 ? stat->time_interval : 1;
+  const double eps = stat->events / seconds;
+  sb_list_item_t *pos;
+  option_t       *opt;
+  bool           header = false;
+
+  log_text(LOG_NOTICE, "Comparison to '%s' (%s):", compare_path,
+           baseline.timestamp);
+  log_text(LOG_NOTICE, "    %-28s %14s %14s %10s", "", "baseline", "current",
+           "change");
+
+  const double eps_change = pct_change(baseline.eps, eps);
+
+  log_text(LOG_NOTICE, "    %-28s %14.2f %14.2f %+9.2f%%", "events/s (eps):",
+           baseline.eps, eps, eps_change);
+
+  const bool tps_regressed = tps_threshold > 0 &&
+    -eps_change > tps_threshold;
+  double     worst_rank = 0, worst_change = 0;
+
+  for (size_t i = 0; i < sb_globals.npercentiles; i++)
+  {
+    for (size_t j = 0; j < baseline.npcts; j++)
+    {
+      if (fabs(baseline.ranks[j] - sb_globals.percentiles[i]) > 1e-6)
+        continue;
+
+      const double cur = SEC2MS(stat->latency_pcts[i]);
+      const double change = pct_change(baseline.pcts[j], cur);
+      char         name[64];
+
+      snprintf(name, sizeof(name), "%4.2fth percentile (ms):",
+               sb_globals.percentiles[i]);
+      log_text(LOG_NOTICE, "    %-28s %14.2f %14.2f %+9.2f%%", name,
+               baseline.pcts[j], cur, change);
+
+      if (change > worst_change)
+      {
+        worst_change = change;
+        worst_rank = sb_globals.percentiles[i];
+      }
+      break;
+    }
+  }
+
+  double       p = 1;
+  const double d = counts != NULL ? dist_test(&p) : 0;
+  const bool   dist_regressed = counts != NULL && dist_threshold > 0 &&
+    d > dist_threshold && p < DIST_ALPHA;
+
+  if (counts != NULL)
+    log_text(LOG_NOTICE, "    %-28s %14s D+ = %.4f, p = %.4g",
+             "latency distribution:", "", d, p);
+
+  const bool latency_regressed = latency_threshold > 0 &&
+    worst_change > latency_threshold;
+
+  /* Options that differ from the baseline, the comparison may be invalid */
+  pos = sb_options_enum_start();
+  while ((pos = sb_options_enum_next(pos, &opt)) != NULL)
+  {
+    char cur[1024], base[1024], name[128];
+
+    if (option_secret(opt->name))
+      continue;
+
+    /* Options are stored with underscores instead of dashes */
+    snprintf(name, sizeof(name), "%s", opt->name);
+    for (char *c = name; *c != '\0'; c++)
+      if (*c == '_')
+        *c = '-';
+
+    if (!strncmp(name, "compare-", 8) || !strcmp(name, "save-result"))
+      continue;
+
+    if (json_read_string(json_find(baseline.config, opt->name), base,
+                         sizeof(base)) == NULL)
+      continue;
+
+    option_value(opt, cur, sizeof(cur));
+
+    if (!strcmp(cur, base))
+      continue;
+
+    if (!header)
+    {
+      log_text(LOG_NOTICE, "    options changed from the baseline:");
+      header = true;
+    }
+
+    log_text(LOG_NOTICE, "        --%s: '%s' -> '%s'", name, base, cur);
+  }
+
+  log_text(LOG_NOTICE, "");
+
+  if (tps_regressed)
+    log_text(LOG_ALERT, "events/s dropped by %.2f%% "
+             "(--compare-tps-threshold=%g)", -eps_change, tps_threshold);
+
+  if (latency_regressed)
+    log_text(LOG_ALERT, "%4.2fth percentile latency increased by %.2f%% "
+             "(--compare-latency-threshold=%g)", worst_rank, worst_change,
+             latency_threshold);
+
+  if (dist_regressed)
+    log_text(LOG_ALERT, "the latency distribution shifted towards higher "
+             "latencies by D+ = %.4f (--compare-dist-threshold=%g)", d,
+             dist_threshold);
+
+  if (tps_regressed || latency_regressed || dist_regressed)
+  {
+    log_text(LOG_ALERT, "Regression against '%s' detected", compare_path);
+    regressed = true;
+  }
+}
+
+
+void sb_result_report(const sb_stat_t *stat)
+{
+  if (!sb_result_enabled())
+    return;
+
+  if (start_counts != NULL)
+    get_run_counts();
+
+  if (save_path != NULL)
+    save_result(stat);
+
+  if (compare_path != NULL)
+    compare_result(stat);
+}
+
+
+bool sb_result_regressed(void)
+{
+  return regressed;
+}
+
+
+void sb_result_done(void)
+{
+  free(baseline.text);
+  free(baseline.ranks);
+  free(baseline.pcts);
+  free(baseline.buckets);
+  memset(&baseline, 0, sizeof(baseline));
+
+  free(start_counts);
+  free(counts);
+  start_counts = NULL;
+  counts = NULL;
+}
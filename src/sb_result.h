@@ -0,0 +1,59 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Saved results and baseline comparisons, see --save-result and --compare-to */
+
+#ifndef SB_RESULT_H
+#define SB_RESULT_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+
+#include "sysbench.h"
+
+/*
+  Parse options and load the --compare-to baseline, so that an invalid
+  baseline is rejected before the run. Returns 0 on success.
+*/
+int sb_result_init(void);
+
+/* Return true if results are saved or compared */
+bool sb_result_enabled(void);
+
+/*
+  Mark the start of the measured part of a run. The saved latency histogram
+  only includes events completed after the last call.
+*/
+void sb_result_start(void);
+
+/*
+  Save the cumulative statistics of a run to --save-result and compare them
+  to the --compare-to baseline. Called with the same statistics as the
+  cumulative report.
+*/
+void sb_result_report(const sb_stat_t *stat);
+
+/* Return true if a --compare-* threshold was exceeded by any run */
+bool sb_result_regressed(void);
+
+void sb_result_done(void);
+
+#endif /* SB_RESULT_H */
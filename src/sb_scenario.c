@@ -0,0 +1,367 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  A scenario is a file with one step per line in the following form:
+
+    COMMAND [--option=value ...]
+
+  COMMAND is 'prepare', 'warmup', 'run', 'cleanup' or a custom command of the
+  script. Options apply to that step only and may be test options or one of
+  the general options in scenario_general_opts[], which are read again before
+  each run. Empty lines and lines starting with '#' are ignored. Values cannot
+  contain whitespace.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#ifdef HAVE_STDIO_H
+# include <stdio.h>
+#endif
+
+#include "sb_scenario.h"
+#include "sb_options.h"
+#include "sb_logger.h"
+#include "sb_lua.h"
+#include "sb_util.h"
+
+#define SCENARIO_LINE_MAX 4096
+
+typedef struct
+{
+  char *name;
+  char *value;
+  char *saved;                  /* Value before the step, NULL if unset */
+} scenario_opt_t;
+
+typedef struct
+{
+  char           *command;
+  char           *name;         /* The line without surrounding whitespace */
+  scenario_opt_t *opts;
+  unsigned int   nopts;
+} scenario_step_t;
+
+/* General options which can be changed between runs */
+static const char *scenario_general_opts[] =
+{
+  "time", "events", "rate", "threads", "warmup-time", NULL
+};
+
+static scenario_step_t *steps;
+static unsigned int    nsteps;
+
+
+bool sb_scenario_enabled(void)
+{
+  const char * const path = sb_get_value_string("scenario");
+
+  return path != NULL && *path != '\0';
+}
+
+
+/* Compare option names like the options library, i.e. '-' matches '_' */
+
+static bool option_name_eq(const char *a, const char *b)
+{
+  for (; *a != '\0' && *b != '\0'; a++, b++)
+  {
+    if (*a != *b && !((*a == '-' || *a == '_') && (*b == '-' || *b == '_')))
+      return false;
+  }
+
+  return *a == *b;
+}
+
+
+/* Check if an option can be set in a step */
+
+static bool option_allowed(sb_test_t *test, const char *name)
+{
+  for (const char **p = scenario_general_opts; *p != NULL; p++)
+    if (option_name_eq(*p, name))
+      return true;
+
+  for (sb_arg_t *arg = test->args; arg != NULL && arg->name != NULL; arg++)
+    if (option_name_eq(arg->name, name))
+      return true;
+
+  return false;
+}
+
+
+/* Check if a command can be executed in a step */
+
+static bool command_allowed(sb_test_t *test, const char *name)
+{
+  if (!strcmp(name, SB_SCENARIO_RUN) || !strcmp(name, SB_SCENARIO_WARMUP))
+    return true;
+
+  if (!strcmp(name, "prepare") && test->builtin_cmds.prepare != NULL)
+    return true;
+
+  if (!strcmp(name, "cleanup") && test->builtin_cmds.cleanup != NULL)
+    return true;
+
+  return sb_lua_loaded() && sb_lua_custom_command_defined(name);
+}
+
+
+/* Parse a scenario line into a step, modifies 'line' */
+
+static int parse_step(sb_test_t *test, char *line, scenario_step_t *step,
+                      const char *path, unsigned int lineno)
+{
+  char *tok;
+  char *save;
+
+  step->name = strdup(line);
+
+  tok = strtok_r(line, " \t", &save);
+  step->command = strdup(tok);
+
+  if (!command_allowed(test, step->command))
+  {
+    log_text(LOG_FATAL, "%s:%u: '%s' test does not implement the '%s' "
+             "command", path, lineno, test->sname, step->command);
+    return 1;
+  }
+
+  while ((tok = strtok_r(NULL, " \t", &save)) != NULL)
+  {
+    scenario_opt_t *opt;
+    char           *eq;
+
+    if (strncmp(tok, "--", 2) || tok[2] == '\0' || tok[2] == '=')
+    {
+      log_text(LOG_FATAL, "%s:%u: invalid option '%s', expected "
+               "--name=value", path, lineno, tok);
+      return 1;
+    }
+
+    tok += 2;
+    if ((eq = strchr(tok, '=')) != NULL)
+      *eq = '\0';
+
+    if (!option_allowed(test, tok))
+    {
+      log_text(LOG_FATAL, "%s:%u: --%s cannot be changed in scenario steps",
+               path, lineno, tok);
+      return 1;
+    }
+
+    opt = realloc(step->opts, (step->nopts + 1) * sizeof(scenario_opt_t));
+    if (opt == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+    step->opts = opt;
+
+    opt = &step->opts[step->nopts++];
+    opt->name = strdup(tok);
+    opt->value = strdup(eq != NULL ? eq + 1 : "on");
+    opt->saved = NULL;
+  }
+
+  return 0;
+}
+
+
+int sb_scenario_init(sb_test_t *test)
+{
+  const char * const path = sb_get_value_string("scenario");
+  FILE               *fp;
+  char               line[SCENARIO_LINE_MAX];
+  unsigned int       lineno = 0;
+
+  if ((fp = fopen(path, "r")) == NULL)
+  {
+    log_errno(LOG_FATAL, "Cannot open --scenario file '%s'", path);
+    return 1;
+  }
+
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    char            *p = line + strspn(line, " \t");
+    size_t          len;
+    scenario_step_t *tmp;
+
+    lineno++;
+
+    len = strlen(p);
+    while (len > 0 && strchr(" \t\r\n", p[len - 1]) != NULL)
+      p[--len] = '\0';
+
+    if (*p == '#' || *p == '\0')
+      continue;
+
+    if ((tmp = realloc(steps, (nsteps + 1) * sizeof(scenario_step_t))) == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      goto error;
+    }
+    steps = tmp;
+    memset(&steps[nsteps], 0, sizeof(scenario_step_t));
+
+    if (parse_step(test, p, &steps[nsteps++], path, lineno))
+      goto error;
+  }
+
+  fclose(fp);
+
+  if (nsteps == 0)
+  {
+    log_text(LOG_FATAL, "No steps in --scenario file '%s'", path);
+    return 1;
+  }
+
+  return 0;
+
+ error:
+  fclose(fp);
+
+  return 1;
+}
+
+
+unsigned int sb_scenario_steps(void)
+{
+  return nsteps;
+}
+
+
+const char *sb_scenario_step_command(unsigned int step)
+{
+  return steps[step].command;
+}
+
+
+const char *sb_scenario_step_name(unsigned int step)
+{
+  return steps[step].name;
+}
+
+
+/* Return the current option value in the form accepted by set_option() */
+
+static char *option_value(option_t *opt)
+{
+  sb_list_item_t *pos;
+  size_t         len = 0;
+  char           *buf;
+
+  if (opt->type == SB_ARG_TYPE_BOOL)
+    return strdup(sb_opt_to_flag(opt) ? "on" : "off");
+
+  SB_LIST_FOR_EACH(pos, &opt->values)
+    len += strlen(SB_LIST_ENTRY(pos, value_t, listitem)->data) + 1;
+
+  if ((buf = malloc(len + 1)) == NULL)
+    return NULL;
+
+  buf[0] = '\0';
+  SB_LIST_FOR_EACH(pos, &opt->values)
+  {
+    if (buf[0] != '\0')
+      strcat(buf, ",");
+    strcat(buf, SB_LIST_ENTRY(pos, value_t, listitem)->data);
+  }
+
+  return buf;
+}
+
+
+int sb_scenario_step_start(unsigned int step)
+{
+  scenario_step_t * const s = &steps[step];
+
+  for (unsigned int i = 0; i < s->nopts; i++)
+  {
+    scenario_opt_t * const sopt = &s->opts[i];
+    option_t       * const opt = sb_find_option(sopt->name);
+
+    if (opt == NULL)
+    {
+      log_text(LOG_FATAL, "Unknown option: --%s", sopt->name);
+      return 1;
+    }
+
+    sopt->saved = option_value(opt);
+
+    if (set_option(sopt->name, sopt->value, opt->type) == NULL)
+    {
+      log_text(LOG_FATAL, "Invalid value for --%s: %s", sopt->name,
+               sopt->value);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+void sb_scenario_step_end(unsigned int step)
+{
+  scenario_step_t * const s = &steps[step];
+
+  /* Restore in reverse order in case an option was set more than once */
+  for (unsigned int i = s->nopts; i-- > 0;)
+  {
+    scenario_opt_t * const sopt = &s->opts[i];
+    option_t       * const opt = sb_find_option(sopt->name);
+
+    if (opt == NULL || sopt->saved == NULL)
+      continue;
+
+    set_option(sopt->name, sopt->saved, opt->type);
+
+    free(sopt->saved);
+    sopt->saved = NULL;
+  }
+}
+
+
+void sb_scenario_done(void)
+{
+  for (unsigned int i = 0; i < nsteps; i++)
+  {
+    for (unsigned int j = 0; j < steps[i].nopts; j++)
+    {
+      free(steps[i].opts[j].name);
+      free(steps[i].opts[j].value);
+      free(steps[i].opts[j].saved);
+    }
+
+    free(steps[i].opts);
+    free(steps[i].command);
+    free(steps[i].name);
+  }
+
+  free(steps);
+  steps = NULL;
+  nsteps = 0;
+}
@@ -0,0 +1,65 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Sequences of commands and run phases in one process, see --scenario */
+
+#ifndef SB_SCENARIO_H
+#define SB_SCENARIO_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+
+#include "sysbench.h"
+
+/* Step commands handled by sysbench itself, others are custom commands */
+#define SB_SCENARIO_RUN    "run"
+#define SB_SCENARIO_WARMUP "warmup"
+
+/* Return true if --scenario is used */
+bool sb_scenario_enabled(void);
+
+/*
+  Load the --scenario file and check that all commands and options are
+  supported by the test. Returns 0 on success.
+*/
+int sb_scenario_init(sb_test_t *test);
+
+/* Return the number of steps */
+unsigned int sb_scenario_steps(void);
+
+/* Return the command of a step */
+const char *sb_scenario_step_command(unsigned int step);
+
+/* Return the step definition as given in the file */
+const char *sb_scenario_step_name(unsigned int step);
+
+/*
+  Set the options overridden by a step. Returns 0 on success, the caller is
+  expected to validate the new values.
+*/
+int sb_scenario_step_start(unsigned int step);
+
+/* Restore the options overridden by a step */
+void sb_scenario_step_end(unsigned int step);
+
+void sb_scenario_done(void);
+
+#endif /* SB_SCENARIO_H */
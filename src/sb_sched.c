@@ -0,0 +1,676 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Scheduling policies and cgroup placement of worker threads. --thread-sched
+  and --thread-cgroup take either a single value for all worker threads, or
+  one value per --thread-groups group, so e.g. OLTP threads can compete with a
+  background batch group the way they are deployed in production.
+
+  Cgroups are cgroup v2 threaded cgroups created as children of the cgroup
+  sysbench runs in (or of --thread-cgroup-root). Each worker thread moves
+  itself to the cgroup of its group before thread_init(). Threaded cgroups
+  support the 'cpu' and 'cpuset' controllers, which are enabled in the parent
+  as needed to set cpu.weight and cpuset.cpus. The cgroup of sysbench must be
+  writable, e.g. delegated to the user.
+
+  CPU time used by worker threads of each group is reported at the end of the
+  test, i.e. the share of CPU each group actually achieved.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdio.h>
+# include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#ifdef HAVE_SCHED_H
+# include <sched.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "sb_sched.h"
+#include "sb_groups.h"
+#include "sb_logger.h"
+#include "sb_options.h"
+#include "sb_usage.h"
+#include "sysbench.h"
+
+#define CGROUP_PATH_MAX 4096
+
+/* Scheduling policy of a group */
+typedef struct
+{
+  bool         set;             /* false to leave the policy unchanged */
+  int          policy;          /* SCHED_* */
+  bool         has_value;
+  int          value;           /* priority for fifo and rr, nice otherwise */
+  char         *desc;           /* as specified */
+} sched_spec_t;
+
+/* cgroup of a group */
+typedef struct
+{
+  char         *name;           /* NULL to leave threads in place */
+  char         *path;
+  unsigned int weight;          /* cpu.weight, 0 if not set */
+  char         *cpus;           /* cpuset.cpus, NULL if not set */
+  bool         created;         /* removed by sb_sched_done() if set */
+} cgroup_spec_t;
+
+static const struct
+{
+  const char *name;
+  int        policy;
+  bool       rt;                /* real-time, takes a priority */
+} policies[] =
+{
+  {"other", SCHED_OTHER, false},
+#ifdef SCHED_BATCH
+  {"batch", SCHED_BATCH, false},
+#endif
+#ifdef SCHED_IDLE
+  {"idle", SCHED_IDLE, false},
+#endif
+  {"fifo", SCHED_FIFO, true},
+  {"rr", SCHED_RR, true},
+  {NULL, 0, false}
+};
+
+static sched_spec_t  *scheds;
+static unsigned int  nscheds;
+static cgroup_spec_t *cgroups;
+static unsigned int  ncgroups;
+static char          cgroup_root[CGROUP_PATH_MAX];
+
+
+/* Return the number of groups values are specified for */
+
+static unsigned int ngroups(void)
+{
+  return sb_groups_enabled() ? sb_groups_count() : 1;
+}
+
+
+/* Return the index of the value for a worker thread in a list of n values */
+
+static unsigned int spec_index(int thread_id, unsigned int n)
+{
+  const int idx = n > 1 ? sb_groups_index(thread_id) : 0;
+
+  return idx >= 0 ? (unsigned int) idx : 0;
+}
+
+
+/*
+  Count values of a list option, which must be either one or one per group.
+  Returns 0 for an empty list and -1 for an invalid number of values.
+*/
+
+static int count_values(const char *opt, sb_list_t *list)
+{
+  sb_list_item_t *pos;
+  int            n = 0;
+
+  SB_LIST_FOR_EACH(pos, list)
+    n++;
+
+  if (n > 1 && (unsigned int) n != ngroups())
+  {
+    log_text(LOG_FATAL, "--%s requires a single value or one per "
+             "--thread-groups group", opt);
+    return -1;
+  }
+
+  return n;
+}
+
+
+/* Parse a POLICY[:VALUE] scheduling policy, return 0 on success */
+
+static int parse_sched(const char *s, sched_spec_t *spec)
+{
+  const char   *colon = strchr(s, ':');
+  const size_t len = colon != NULL ? (size_t) (colon - s) : strlen(s);
+  unsigned int i;
+
+  spec->desc = strdup(s);
+
+  if (!strcmp(s, "-"))
+    return 0;
+
+  for (i = 0; policies[i].name != NULL; i++)
+    if (strlen(policies[i].name) == len && !strncmp(s, policies[i].name, len))
+      break;
+
+  if (policies[i].name == NULL)
+    return 1;
+
+  spec->set = true;
+  spec->policy = policies[i].policy;
+
+  if (colon != NULL)
+  {
+    char       *end;
+    const long v = strtol(colon + 1, &end, 10);
+
+    if (end == colon + 1 || *end != '\0')
+      return 1;
+
+    spec->has_value = true;
+    spec->value = (int) v;
+  }
+
+  if (policies[i].rt)
+    return !spec->has_value ||
+      spec->value < sched_get_priority_min(spec->policy) ||
+      spec->value > sched_get_priority_max(spec->policy);
+
+#ifdef SCHED_IDLE
+  /* The nice value has no effect with SCHED_IDLE */
+  if (spec->policy == SCHED_IDLE && spec->has_value)
+    return 1;
+#endif
+
+  return spec->has_value && (spec->value < -20 || spec->value > 19);
+}
+
+
+/* Parse a NAME[:WEIGHT[:CPUS]] cgroup, return 0 on success */
+
+static int parse_cgroup(const char *s, cgroup_spec_t *spec)
+{
+  char *tmp, *p, *save;
+
+  if (!strcmp(s, "-"))
+    return 0;
+
+  tmp = strdup(s);
+
+  p = strtok_r(tmp, ":", &save);
+  if (p == NULL || !strcmp(p, ".") || !strcmp(p, "..") ||
+      strchr(p, '/') != NULL)
+    goto err;
+  spec->name = strdup(p);
+
+  if ((p = strtok_r(NULL, ":", &save)) != NULL)
+  {
+    char       *end;
+    const long w = strtol(p, &end, 10);
+
+    /* A '-' weight can be used to set CPUs only */
+    if (*p != '-' || p[1] != '\0')
+    {
+      if (end == p || *end != '\0' || w < 1 || w > 10000)
+        goto err;
+      spec->weight = (unsigned int) w;
+    }
+  }
+
+  if ((p = strtok_r(NULL, ":", &save)) != NULL)
+  {
+    /* Ranges are joined with '+', as ',' separates list values */
+    if (p[strspn(p, "0123456789-+")] != '\0')
+      goto err;
+
+    spec->cpus = strdup(p);
+    for (char *c = spec->cpus; *c != '\0'; c++)
+      if (*c == '+')
+        *c = ',';
+  }
+
+  if (strtok_r(NULL, ":", &save) != NULL)
+    goto err;
+
+  free(tmp);
+
+  return 0;
+
+ err:
+  free(tmp);
+
+  return 1;
+}
+
+
+/* Find the cgroup v2 directory of sysbench from /proc/self/cgroup */
+
+static int find_cgroup_root(void)
+{
+  FILE *fp;
+  char line[CGROUP_PATH_MAX];
+  int  rc = 1;
+
+  if ((fp = fopen("/proc/self/cgroup", "r")) == NULL)
+    return 1;
+
+  /* The cgroup v2 line is in the form 0::cgroup-path */
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    if (strncmp(line, "0::", 3))
+      continue;
+
+    line[strcspn(line, "\n")] = '\0';
+    rc = snprintf(cgroup_root, sizeof(cgroup_root), "/sys/fs/cgroup%s",
+                  strcmp(line + 3, "/") ? line + 3 : "") >=
+      (int) sizeof(cgroup_root);
+    break;
+  }
+
+  fclose(fp);
+
+  return rc;
+}
+
+
+/*
+  Write a value to a cgroup control file. Files are appended to, so a plain
+  directory can stand in for a cgroup with --thread-cgroup-root
+*/
+
+static int cgroup_write(const char *dir, const char *file, const char *value)
+{
+  char path[CGROUP_PATH_MAX];
+  int  fd;
+
+  if (snprintf(path, sizeof(path), "%s/%s", dir, file) >= (int) sizeof(path))
+  {
+    log_text(LOG_FATAL, "cgroup path is too long: '%s/%s'", dir, file);
+    return 1;
+  }
+
+  fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (fd < 0)
+  {
+    log_errno(LOG_FATAL, "Cannot open '%s'", path);
+    return 1;
+  }
+
+  if (write(fd, value, strlen(value)) != (ssize_t) strlen(value))
+  {
+    log_errno(LOG_FATAL, "Cannot write '%s' to '%s'", value, path);
+    close(fd);
+    return 1;
+  }
+
+  close(fd);
+
+  return 0;
+}
+
+
+/* Create cgroups and set their controls */
+
+static int cgroups_create(void)
+{
+  const char *root = sb_get_value_string("thread-cgroup-root");
+  char       path[CGROUP_PATH_MAX];
+  bool       need_cpu = false, need_cpuset = false;
+
+  if (root != NULL)
+    snprintf(cgroup_root, sizeof(cgroup_root), "%s", root);
+  else if (find_cgroup_root())
+  {
+    log_text(LOG_FATAL, "Cannot find the cgroup v2 of sysbench, use "
+             "--thread-cgroup-root");
+    return 1;
+  }
+
+  if (snprintf(path, sizeof(path), "%s/cgroup.controllers", cgroup_root) >=
+      (int) sizeof(path) || access(path, F_OK))
+  {
+    log_text(LOG_FATAL, "'%s' is not a cgroup v2 directory", cgroup_root);
+    return 1;
+  }
+
+  /* Threaded children turn the parent into a threaded domain first */
+  for (unsigned int i = 0; i < ncgroups; i++)
+  {
+    cgroup_spec_t * const cg = &cgroups[i];
+
+    if (cg->name == NULL)
+      continue;
+
+    if (snprintf(path, sizeof(path), "%s/%s", cgroup_root, cg->name) >=
+        (int) sizeof(path))
+    {
+      log_text(LOG_FATAL, "cgroup path is too long: '%s/%s'", cgroup_root,
+               cg->name);
+      return 1;
+    }
+    cg->path = strdup(path);
+
+    if (mkdir(cg->path, 0755) == 0)
+      cg->created = true;
+    else if (errno != EEXIST)
+    {
+      log_errno(LOG_FATAL, "Cannot create cgroup '%s'", cg->path);
+      return 1;
+    }
+
+    if (cgroup_write(cg->path, "cgroup.type", "threaded"))
+      return 1;
+
+    need_cpu |= cg->weight > 0;
+    need_cpuset |= cg->cpus != NULL;
+  }
+
+  if ((need_cpu &&
+       cgroup_write(cgroup_root, "cgroup.subtree_control", "+cpu")) ||
+      (need_cpuset &&
+       cgroup_write(cgroup_root, "cgroup.subtree_control", "+cpuset")))
+    return 1;
+
+  for (unsigned int i = 0; i < ncgroups; i++)
+  {
+    const cgroup_spec_t * const cg = &cgroups[i];
+    char                        weight[16];
+
+    if (cg->name == NULL)
+      continue;
+
+    snprintf(weight, sizeof(weight), "%u", cg->weight);
+
+    if ((cg->weight > 0 && cgroup_write(cg->path, "cpu.weight", weight)) ||
+        (cg->cpus != NULL && cgroup_write(cg->path, "cpuset.cpus", cg->cpus)))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+int sb_sched_init(void)
+{
+  sb_list_t      *list;
+  sb_list_item_t *pos;
+  int            n;
+
+  list = sb_get_value_list("thread-sched");
+  if ((n = count_values("thread-sched", list)) < 0)
+    return 1;
+
+  if (n > 0)
+  {
+    scheds = calloc(n, sizeof(sched_spec_t));
+    if (scheds == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+
+    SB_LIST_FOR_EACH(pos, list)
+    {
+      const value_t *val = SB_LIST_ENTRY(pos, value_t, listitem);
+
+      if (parse_sched(val->data, &scheds[nscheds++]))
+      {
+        log_text(LOG_FATAL, "Invalid value for --thread-sched: '%s'",
+                 val->data);
+        return 1;
+      }
+    }
+  }
+
+  list = sb_get_value_list("thread-cgroup");
+  if ((n = count_values("thread-cgroup", list)) < 0)
+    return 1;
+
+  if (n > 0)
+  {
+    cgroups = calloc(n, sizeof(cgroup_spec_t));
+    if (cgroups == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+
+    SB_LIST_FOR_EACH(pos, list)
+    {
+      const value_t *val = SB_LIST_ENTRY(pos, value_t, listitem);
+
+      if (parse_cgroup(val->data, &cgroups[ncgroups++]))
+      {
+        log_text(LOG_FATAL, "Invalid value for --thread-cgroup: '%s'",
+                 val->data);
+        return 1;
+      }
+    }
+
+    if (cgroups_create())
+      return 1;
+  }
+
+  return 0;
+}
+
+
+bool sb_sched_enabled(void)
+{
+  return nscheds > 0 || ncgroups > 0;
+}
+
+
+int sb_sched_thread_init(int thread_id)
+{
+  if (nscheds > 0)
+  {
+    const sched_spec_t * const s = &scheds[spec_index(thread_id, nscheds)];
+
+    if (s->set)
+    {
+      struct sched_param param;
+      int                rc;
+
+      memset(&param, 0, sizeof(param));
+      if (s->policy == SCHED_FIFO || s->policy == SCHED_RR)
+        param.sched_priority = s->value;
+
+      if ((rc = pthread_setschedparam(pthread_self(), s->policy, &param)))
+      {
+        errno = rc;
+        log_errno(LOG_FATAL, "Cannot set scheduling policy '%s' of worker "
+                  "thread #%d", s->desc, thread_id);
+        return 1;
+      }
+
+#ifdef SYS_gettid
+      /* The nice value of a thread is set by its ID on Linux */
+      if (param.sched_priority == 0 && s->has_value &&
+          setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), s->value))
+      {
+        log_errno(LOG_FATAL, "Cannot set nice value %d of worker thread #%d",
+                  s->value, thread_id);
+        return 1;
+      }
+#endif
+    }
+  }
+
+  if (ncgroups > 0)
+  {
+    const cgroup_spec_t * const cg =
+      &cgroups[spec_index(thread_id, ncgroups)];
+
+    if (cg->name != NULL)
+    {
+#ifdef SYS_gettid
+      char tid[32];
+
+      snprintf(tid, sizeof(tid), "%ld\n", (long) syscall(SYS_gettid));
+      if (cgroup_write(cg->path, "cgroup.threads", tid))
+        return 1;
+#else
+      log_text(LOG_FATAL, "--thread-cgroup is not supported on this platform");
+      return 1;
+#endif
+    }
+  }
+
+  return 0;
+}
+
+
+/* Return the description of the values for a group, or "-" */
+
+static const char *sched_desc(unsigned int group)
+{
+  if (nscheds == 0)
+    return "-";
+
+  return scheds[nscheds > 1 ? group : 0].desc;
+}
+
+
+static const char *cgroup_desc(unsigned int group)
+{
+  if (ncgroups == 0)
+    return "-";
+
+  const cgroup_spec_t * const cg = &cgroups[ncgroups > 1 ? group : 0];
+
+  return cg->name != NULL ? cg->name : "-";
+}
+
+
+/* Format the name of a group for reports */
+
+static void group_name(unsigned int group, char *buf, size_t size)
+{
+  if (sb_groups_enabled())
+    snprintf(buf, size, "%u: %s", group + 1, sb_groups_name(group));
+  else
+    snprintf(buf, size, "all");
+}
+
+
+void sb_sched_print_mode(void)
+{
+  char name[32];
+
+  if (!sb_sched_enabled())
+    return;
+
+  log_text(LOG_NOTICE, "Worker thread scheduling:");
+
+  for (unsigned int i = 0; i < ngroups(); i++)
+  {
+    group_name(i, name, sizeof(name));
+    log_text(LOG_NOTICE, "    %s: policy %s, cgroup %s", name, sched_desc(i),
+             cgroup_desc(i));
+  }
+
+  if (ncgroups > 0)
+    log_text(LOG_NOTICE, "    cgroups in %s", cgroup_root);
+}
+
+
+void sb_sched_report(void)
+{
+  const unsigned int n = ngroups();
+  uint64_t           *cpu;
+  uint64_t           total = 0, wall = 0;
+
+  if (!sb_sched_enabled())
+    return;
+
+  cpu = calloc(n, sizeof(uint64_t));
+  if (cpu == NULL)
+    return;
+
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+  {
+    const int g = sb_groups_enabled() ? sb_groups_index(i) : 0;
+
+    if (g < 0)
+      continue;
+
+    cpu[g] += sb_usage[i].cpu_ns;
+    total += sb_usage[i].cpu_ns;
+    wall = SB_MAX(wall, sb_usage[i].wall_ns);
+  }
+
+  log_text(LOG_NOTICE, "Worker CPU usage:");
+  log_text(LOG_NOTICE, "    %-24s %-12s %-16s %10s %8s %6s", "group",
+           "scheduling", "cgroup", "CPU time", "share", "CPUs");
+
+  for (unsigned int i = 0; i < n; i++)
+  {
+    char name[32];
+
+    group_name(i, name, sizeof(name));
+
+    log_text(LOG_NOTICE, "    %-24s %-12s %-16s %9.2fs %7.2f%% %6.2f", name,
+             sched_desc(i), cgroup_desc(i), NS2SEC(cpu[i]),
+             total > 0 ? 100.0 * cpu[i] / total : 0,
+             wall > 0 ? (double) cpu[i] / wall : 0);
+  }
+
+  log_text(LOG_NOTICE, "");
+
+  free(cpu);
+}
+
+
+void sb_sched_done(void)
+{
+  for (unsigned int i = 0; i < nscheds; i++)
+    free(scheds[i].desc);
+
+  for (unsigned int i = 0; i < ncgroups; i++)
+  {
+    cgroup_spec_t * const cg = &cgroups[i];
+
+    /* Worker threads have exited, so the cgroup is empty */
+    if (cg->created && rmdir(cg->path))
+      log_errno(LOG_DEBUG, "Cannot remove cgroup '%s'", cg->path);
+
+    free(cg->name);
+    free(cg->path);
+    free(cg->cpus);
+  }
+
+  free(scheds);
+  scheds = NULL;
+  nscheds = 0;
+
+  free(cgroups);
+  cgroups = NULL;
+  ncgroups = 0;
+}
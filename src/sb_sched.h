@@ -0,0 +1,57 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Scheduling policies and cgroup placement of worker threads, see
+  --thread-sched and --thread-cgroup
+*/
+
+#ifndef SB_SCHED_H
+#define SB_SCHED_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+
+/*
+  Parse --thread-sched and --thread-cgroup, and create cgroups. Must be called
+  after sb_groups_init(). Returns 0 on success.
+*/
+int sb_sched_init(void);
+
+/* Return true if worker threads have scheduling policies or cgroups set */
+bool sb_sched_enabled(void);
+
+/*
+  Apply the scheduling policy and cgroup of the calling worker thread. Returns
+  0 on success.
+*/
+int sb_sched_thread_init(int thread_id);
+
+/* Print scheduling policies and cgroups in the test mode banner */
+void sb_sched_print_mode(void);
+
+/* Print CPU time used by worker threads of each group in the last run */
+void sb_sched_report(void);
+
+/* Remove cgroups created by sb_sched_init() */
+void sb_sched_done(void);
+
+#endif /* SB_SCHED_H */
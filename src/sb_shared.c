@@ -0,0 +1,452 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Objects shared by all Lua states. Like user counters, each Lua state looks
+  them up by name, so scripts can create them at load time or in thread_init().
+
+  Maps use open addressing with linear probing over a power of 2 number of
+  slots, at least twice the requested capacity. A key is inserted by claiming
+  an empty slot with CAS and is never moved, so lookups need no locks. Removing
+  a key only clears its value, i.e. the slot stays reserved for that key, so
+  the capacity limits the number of distinct keys ever set. Queues are ck_ring
+  MPMC rings storing values as pointers, i.e. values are truncated to 32 bits
+  on 32-bit platforms.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+#include "sb_shared.h"
+#include "sb_ck_pr.h"
+#include "sb_logger.h"
+#include "sb_util.h"
+
+#include "ck_ring.h"
+
+/* Map values of keys that are not set */
+#define MAP_NO_VALUE ((uint64_t) INT64_MIN)
+
+/* Map keys are stored incremented by 1, so 0 marks an empty slot */
+#define MAP_NO_KEY 0
+
+typedef enum
+{
+  SHARED_COUNTER,
+  SHARED_MAP,
+  SHARED_QUEUE
+} shared_type_t;
+
+struct sb_shared_counter
+{
+  uint64_t val CK_CC_CACHELINE;
+  char     pad[SB_CACHELINE_PAD(sizeof(uint64_t))];
+};
+
+typedef struct
+{
+  uint64_t key;
+  uint64_t val;
+} map_slot_t;
+
+struct sb_shared_map
+{
+  map_slot_t *slots;
+  uint64_t   mask;
+  uint64_t   capacity;
+  uint64_t   nkeys CK_CC_CACHELINE;   /* Slots reserved for keys */
+  uint64_t   count CK_CC_CACHELINE;   /* Keys with a value */
+};
+
+struct sb_shared_queue
+{
+  ck_ring_t        ring CK_CC_CACHELINE;
+  ck_ring_buffer_t *buffer;
+};
+
+typedef struct
+{
+  char          *name;
+  shared_type_t type;
+  uint64_t      capacity;
+  void          *ptr;
+} shared_obj_t;
+
+static shared_obj_t    objs[SB_SHARED_MAX];
+static unsigned int    nobjs;
+
+/* Protects registration */
+static pthread_mutex_t register_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *type_names[] = {"counter", "map", "queue"};
+
+
+/* Return the smallest power of 2 which is not less than n */
+
+static uint64_t pow2_ceil(uint64_t n)
+{
+  uint64_t p = 1;
+
+  while (p < n)
+    p <<= 1;
+
+  return p;
+}
+
+
+static void *counter_new(uint64_t capacity)
+{
+  (void) capacity; /* unused */
+
+  sb_shared_counter_t * const c = sb_memalign(sizeof(sb_shared_counter_t),
+                                              CK_MD_CACHELINE);
+  if (c != NULL)
+    memset(c, 0, sizeof(*c));
+
+  return c;
+}
+
+
+static void *map_new(uint64_t capacity)
+{
+  sb_shared_map_t * const m = sb_memalign(sizeof(sb_shared_map_t),
+                                          CK_MD_CACHELINE);
+  if (m == NULL)
+    return NULL;
+
+  memset(m, 0, sizeof(*m));
+
+  const uint64_t nslots = pow2_ceil(capacity * 2);
+
+  if ((m->slots = malloc(nslots * sizeof(map_slot_t))) == NULL)
+  {
+    free(m);
+    return NULL;
+  }
+
+  for (uint64_t i = 0; i < nslots; i++)
+  {
+    m->slots[i].key = MAP_NO_KEY;
+    m->slots[i].val = MAP_NO_VALUE;
+  }
+
+  m->mask = nslots - 1;
+  m->capacity = capacity;
+
+  return m;
+}
+
+
+static void *queue_new(uint64_t capacity)
+{
+  sb_shared_queue_t * const q = sb_memalign(sizeof(sb_shared_queue_t),
+                                            CK_MD_CACHELINE);
+  if (q == NULL)
+    return NULL;
+
+  /* A ring of size n holds n - 1 entries */
+  const uint64_t size = pow2_ceil(capacity + 1);
+
+  if (size > UINT32_MAX ||
+      (q->buffer = calloc(size, sizeof(ck_ring_buffer_t))) == NULL)
+  {
+    free(q);
+    return NULL;
+  }
+
+  ck_ring_init(&q->ring, (unsigned int) size);
+
+  return q;
+}
+
+
+static void *shared_register(const char *name, shared_type_t type,
+                             uint64_t capacity)
+{
+  static void *(*create[])(uint64_t) = {counter_new, map_new, queue_new};
+  void        *ptr = NULL;
+  unsigned int i;
+
+  pthread_mutex_lock(&register_mutex);
+
+  for (i = 0; i < nobjs; i++)
+    if (!strcmp(objs[i].name, name))
+      break;
+
+  if (i < nobjs)
+  {
+    if (objs[i].type != type)
+      log_text(LOG_FATAL, "shared %s '%s' already exists as a %s",
+               type_names[type], name, type_names[objs[i].type]);
+    else if (objs[i].capacity != capacity)
+      log_text(LOG_FATAL, "shared %s '%s' already exists with capacity %"
+               PRIu64, type_names[type], name, objs[i].capacity);
+    else
+      ptr = objs[i].ptr;
+  }
+  else if (nobjs >= SB_SHARED_MAX)
+    log_text(LOG_FATAL, "too many shared objects (%d max)", SB_SHARED_MAX);
+  else if ((ptr = create[type](capacity)) == NULL ||
+           (objs[nobjs].name = strdup(name)) == NULL)
+  {
+    log_text(LOG_FATAL, "cannot allocate shared %s '%s'", type_names[type],
+             name);
+    ptr = NULL;
+  }
+  else
+  {
+    objs[nobjs].type = type;
+    objs[nobjs].capacity = capacity;
+    objs[nobjs].ptr = ptr;
+    nobjs++;
+  }
+
+  pthread_mutex_unlock(&register_mutex);
+
+  return ptr;
+}
+
+
+sb_shared_counter_t *sb_shared_counter_register(const char *name)
+{
+  return shared_register(name, SHARED_COUNTER, 0);
+}
+
+
+sb_shared_map_t *sb_shared_map_register(const char *name, uint64_t capacity)
+{
+  return shared_register(name, SHARED_MAP, capacity);
+}
+
+
+sb_shared_queue_t *sb_shared_queue_register(const char *name,
+                                            uint64_t capacity)
+{
+  return shared_register(name, SHARED_QUEUE, capacity);
+}
+
+
+int64_t sb_shared_counter_add(sb_shared_counter_t *c, int64_t val)
+{
+  return (int64_t) (ck_pr_faa_64(&c->val, (uint64_t) val) + (uint64_t) val);
+}
+
+
+int64_t sb_shared_counter_get(sb_shared_counter_t *c)
+{
+  return (int64_t) ck_pr_load_64(&c->val);
+}
+
+
+void sb_shared_counter_set(sb_shared_counter_t *c, int64_t val)
+{
+  ck_pr_store_64(&c->val, (uint64_t) val);
+}
+
+
+bool sb_shared_counter_cas(sb_shared_counter_t *c, int64_t old, int64_t val)
+{
+  return ck_pr_cas_64(&c->val, (uint64_t) old, (uint64_t) val);
+}
+
+
+/* 64-bit finalizer of MurmurHash3 */
+
+static inline uint64_t map_hash(uint64_t key)
+{
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+
+  return key;
+}
+
+
+/*
+  Return the slot of a key, reserving a new one if 'insert' is true. Returns
+  NULL if the key is not found, or if the map is full when inserting.
+*/
+
+static map_slot_t *map_find(sb_shared_map_t *m, uint64_t key, bool insert)
+{
+  const uint64_t k = key + 1;
+
+  for (uint64_t i = map_hash(k) & m->mask;; i = (i + 1) & m->mask)
+  {
+    map_slot_t * const slot = &m->slots[i];
+    const uint64_t     cur = ck_pr_load_64(&slot->key);
+
+    if (cur == k)
+      return slot;
+
+    if (cur != MAP_NO_KEY)
+      continue;
+
+    if (!insert)
+      return NULL;
+
+    /* Reserve capacity before claiming the slot */
+    if (ck_pr_faa_64(&m->nkeys, 1) >= m->capacity)
+    {
+      ck_pr_dec_64(&m->nkeys);
+
+      /* Another thread inserting the same key would use this slot */
+      return (ck_pr_load_64(&slot->key) == k) ? slot : NULL;
+    }
+
+    if (ck_pr_cas_64(&slot->key, MAP_NO_KEY, k))
+      return slot;
+
+    /* Lost the race for this slot, release the reservation and recheck it */
+    ck_pr_dec_64(&m->nkeys);
+
+    if (ck_pr_load_64(&slot->key) == k)
+      return slot;
+  }
+}
+
+
+bool sb_shared_map_get(sb_shared_map_t *m, uint64_t key, int64_t *val)
+{
+  map_slot_t * const slot = map_find(m, key, false);
+
+  if (slot == NULL)
+    return false;
+
+  const uint64_t v = ck_pr_load_64(&slot->val);
+
+  if (v == MAP_NO_VALUE)
+    return false;
+
+  *val = (int64_t) v;
+
+  return true;
+}
+
+
+bool sb_shared_map_set(sb_shared_map_t *m, uint64_t key, int64_t val)
+{
+  map_slot_t * const slot = map_find(m, key, true);
+
+  if (slot == NULL)
+    return false;
+
+  if (ck_pr_fas_64(&slot->val, (uint64_t) val) == MAP_NO_VALUE)
+    ck_pr_inc_64(&m->count);
+
+  return true;
+}
+
+
+bool sb_shared_map_add(sb_shared_map_t *m, uint64_t key, int64_t val,
+                       int64_t *res)
+{
+  map_slot_t * const slot = map_find(m, key, true);
+  uint64_t           old;
+  uint64_t           new;
+
+  if (slot == NULL)
+    return false;
+
+  do
+  {
+    old = ck_pr_load_64(&slot->val);
+    new = (old == MAP_NO_VALUE ? 0 : old) + (uint64_t) val;
+  } while (!ck_pr_cas_64(&slot->val, old, new));
+
+  if (old == MAP_NO_VALUE)
+    ck_pr_inc_64(&m->count);
+
+  *res = (int64_t) new;
+
+  return true;
+}
+
+
+bool sb_shared_map_remove(sb_shared_map_t *m, uint64_t key)
+{
+  map_slot_t * const slot = map_find(m, key, false);
+
+  if (slot == NULL || ck_pr_fas_64(&slot->val, MAP_NO_VALUE) == MAP_NO_VALUE)
+    return false;
+
+  ck_pr_dec_64(&m->count);
+
+  return true;
+}
+
+
+uint64_t sb_shared_map_count(sb_shared_map_t *m)
+{
+  return ck_pr_load_64(&m->count);
+}
+
+
+bool sb_shared_queue_push(sb_shared_queue_t *q, int64_t val)
+{
+  return ck_ring_enqueue_mpmc(&q->ring, q->buffer, (void *) (intptr_t) val);
+}
+
+
+bool sb_shared_queue_pop(sb_shared_queue_t *q, int64_t *val)
+{
+  void *ptr;
+
+  if (!ck_ring_dequeue_mpmc(&q->ring, q->buffer, &ptr))
+    return false;
+
+  *val = (int64_t) (intptr_t) ptr;
+
+  return true;
+}
+
+
+uint64_t sb_shared_queue_size(sb_shared_queue_t *q)
+{
+  return ck_ring_size(&q->ring);
+}
+
+
+void sb_shared_done(void)
+{
+  for (unsigned int i = 0; i < nobjs; i++)
+  {
+    if (objs[i].type == SHARED_MAP)
+      free(((sb_shared_map_t *) objs[i].ptr)->slots);
+    else if (objs[i].type == SHARED_QUEUE)
+      free(((sb_shared_queue_t *) objs[i].ptr)->buffer);
+
+    free(objs[i].ptr);
+    free(objs[i].name);
+  }
+
+  nobjs = 0;
+}
@@ -0,0 +1,98 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Named objects shared by all Lua states, see the sysbench.shared module.
+  Objects are registered by name under a mutex, all operations on them are
+  lock-free. All functions except sb_shared_done() are exported to Lua via FFI.
+*/
+
+#ifndef SB_SHARED_H
+#define SB_SHARED_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <inttypes.h>
+#endif
+
+#include <stdbool.h>
+
+#define SB_SHARED_MAX 64
+
+typedef struct sb_shared_counter sb_shared_counter_t;
+typedef struct sb_shared_map sb_shared_map_t;
+typedef struct sb_shared_queue sb_shared_queue_t;
+
+/*
+  Return the object with a given name, creating it on the first call. Returns
+  NULL if there are too many objects, or if an object with the same name but a
+  different type or capacity exists.
+*/
+sb_shared_counter_t *sb_shared_counter_register(const char *name);
+
+/* A map can hold up to 'capacity' distinct keys */
+sb_shared_map_t *sb_shared_map_register(const char *name, uint64_t capacity);
+
+/* A queue can hold at least 'capacity' values */
+sb_shared_queue_t *sb_shared_queue_register(const char *name,
+                                            uint64_t capacity);
+
+/* Add a value to a counter and return the new value */
+int64_t sb_shared_counter_add(sb_shared_counter_t *c, int64_t val);
+
+int64_t sb_shared_counter_get(sb_shared_counter_t *c);
+
+void sb_shared_counter_set(sb_shared_counter_t *c, int64_t val);
+
+/* Set a counter to 'val' if it is equal to 'old'. Returns true on success. */
+bool sb_shared_counter_cas(sb_shared_counter_t *c, int64_t old, int64_t val);
+
+/* Store the value of a key in 'val'. Returns false if the key is not set. */
+bool sb_shared_map_get(sb_shared_map_t *m, uint64_t key, int64_t *val);
+
+/* Set the value of a key. Returns false if the map is full. */
+bool sb_shared_map_set(sb_shared_map_t *m, uint64_t key, int64_t val);
+
+/*
+  Add a value to a key, which is treated as 0 if not set, and store the new
+  value in 'res'. Returns false if the map is full.
+*/
+bool sb_shared_map_add(sb_shared_map_t *m, uint64_t key, int64_t val,
+                       int64_t *res);
+
+/* Remove a key. Returns false if it was not set. */
+bool sb_shared_map_remove(sb_shared_map_t *m, uint64_t key);
+
+/* Return the number of keys set */
+uint64_t sb_shared_map_count(sb_shared_map_t *m);
+
+/* Append a value. Returns false if the queue is full. */
+bool sb_shared_queue_push(sb_shared_queue_t *q, int64_t val);
+
+/* Remove the oldest value and store it in 'val'. Returns false if empty. */
+bool sb_shared_queue_pop(sb_shared_queue_t *q, int64_t *val);
+
+/* Return the number of values in a queue */
+uint64_t sb_shared_queue_size(sb_shared_queue_t *q);
+
+void sb_shared_done(void);
+
+#endif /* SB_SHARED_H */
@@ -0,0 +1,280 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Slow event capture log. While an event is executed, its statements with
+  bound values, their timings, servers and errors, as well as retries are
+  appended to a scratch buffer of the worker thread. When the event completes,
+  the buffer is written to the --slow-event-log file if the event latency is at
+  least --slow-event-threshold, and discarded otherwise. Fast events thus cost
+  a few buffer appends and no I/O or locking. Statements that do not fit into
+  the buffer are counted, but not logged.
+
+  The log is text in a format similar to the MySQL slow query log, e.g.:
+
+    # Event: time 1700000000.123456, thread 3, latency 52.110 ms,
+    #   queue 0.000 ms, statements 2, retries 1
+    # Statement: offset 0.015 ms, latency 50.007 ms, server db1:3306, error 1213
+    UPDATE sbtest1 SET k=k+1 WHERE id=42;
+    # Retry: 1
+    ...
+
+  (the event header is a single line).
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdio.h>
+# include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+#include "sb_slow_log.h"
+#include "sysbench.h"
+#include "sb_logger.h"
+#include "sb_options.h"
+#include "sb_timer.h"
+#include "sb_util.h"
+
+/* Size of the per-thread scratch buffer */
+#define SLOW_LOG_BUF_SIZE 65536
+
+typedef struct
+{
+  char         *buf;            /* captured entries of the current event */
+  size_t       len;
+  uint64_t     start_ns;        /* SB_GETTIME() time the event started */
+  unsigned int statements;
+  unsigned int dropped;         /* statements that did not fit into buf */
+  unsigned int retries;
+  char         pad[SB_CACHELINE_PAD(sizeof(void *) + sizeof(size_t) +
+                                    sizeof(uint64_t) +
+                                    sizeof(unsigned int) * 3)];
+} slow_thread_t;
+
+static uint64_t        threshold_ns;
+static const char      *log_path;
+static FILE            *log_file;
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static slow_thread_t   *threads;
+
+
+/* Current SB_GETTIME() time in nanoseconds */
+
+static uint64_t gettime_ns(void)
+{
+  struct timespec ts;
+
+  SB_GETTIME(&ts);
+
+  return SEC2NS(ts.tv_sec) + ts.tv_nsec;
+}
+
+
+int sb_slow_log_init(void)
+{
+  const double threshold = sb_get_value_double("slow-event-threshold");
+
+  log_path = sb_get_value_string("slow-event-log");
+
+  if (threshold < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --slow-event-threshold: %g",
+             threshold);
+    return 1;
+  }
+
+  if (threshold == 0)
+  {
+    if (log_path != NULL)
+    {
+      log_text(LOG_FATAL, "--slow-event-log requires --slow-event-threshold");
+      return 1;
+    }
+
+    return 0;
+  }
+
+  if (log_path == NULL)
+  {
+    log_text(LOG_FATAL, "--slow-event-threshold requires --slow-event-log");
+    return 1;
+  }
+
+  /* Statements of virtual users sharing a thread cannot be told apart */
+  if (sb_globals.virtual_users > 1)
+  {
+    log_text(LOG_FATAL, "--slow-event-threshold cannot be used with "
+             "--virtual-users");
+    return 1;
+  }
+
+  threshold_ns = (uint64_t) (threshold * NS_PER_MS);
+
+  threads = sb_alloc_per_thread_array(sizeof(slow_thread_t));
+  if (threads == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  for (unsigned int i = 0; i <= sb_globals.threads; i++)
+  {
+    threads[i].buf = malloc(SLOW_LOG_BUF_SIZE);
+    if (threads[i].buf == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+  }
+
+  log_file = fopen(log_path, "w");
+  if (log_file == NULL)
+  {
+    log_errno(LOG_FATAL, "Cannot open --slow-event-log '%s'", log_path);
+    return 1;
+  }
+
+  return 0;
+}
+
+
+bool sb_slow_log_enabled(void)
+{
+  return threads != NULL;
+}
+
+
+void sb_slow_log_event_start(int thread_id)
+{
+  slow_thread_t * const t = &threads[thread_id];
+
+  t->len = 0;
+  t->statements = 0;
+  t->dropped = 0;
+  t->retries = 0;
+  t->start_ns = gettime_ns();
+}
+
+
+void sb_slow_log_event_stop(int thread_id, uint64_t latency_ns,
+                            uint64_t queue_ns)
+{
+  slow_thread_t * const t = &threads[thread_id];
+
+  if (latency_ns < threshold_ns)
+    return;
+
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  /* Wall clock time the event started */
+  const uint64_t time_ns = SEC2NS(ts.tv_sec) + ts.tv_nsec -
+    (gettime_ns() - t->start_ns);
+
+  pthread_mutex_lock(&log_mutex);
+
+  fprintf(log_file, "# Event: time %.6f, thread %d, latency %.3f ms, "
+          "queue %.3f ms, statements %u, retries %u\n",
+          time_ns / (double) NS_PER_SEC, thread_id, NS2MS(latency_ns),
+          NS2MS(queue_ns), t->statements, t->retries);
+  fwrite(t->buf, 1, t->len, log_file);
+  if (t->dropped > 0)
+    fprintf(log_file, "# Not logged: %u statements\n", t->dropped);
+
+  pthread_mutex_unlock(&log_mutex);
+}
+
+
+void sb_slow_log_statement(int thread_id, uint64_t start_ns, uint64_t end_ns,
+                           const char *server, bool failed, int sql_errno,
+                           const char *query, size_t len)
+{
+  slow_thread_t * const t = &threads[thread_id];
+  const size_t          avail = SLOW_LOG_BUF_SIZE - t->len;
+  char          * const p = t->buf + t->len;
+  char                  err[32] = "";
+  int                   n;
+
+  t->statements++;
+
+  if (failed)
+    snprintf(err, sizeof(err), ", error %d", sql_errno);
+
+  n = snprintf(p, avail,
+               "# Statement: offset %.3f ms, latency %.3f ms%s%s%s\n",
+               NS2MS(start_ns > t->start_ns ? start_ns - t->start_ns : 0),
+               NS2MS(end_ns - start_ns), server != NULL ? ", server " : "",
+               server != NULL ? server : "", err);
+
+  /* The query is followed by ";\n" */
+  if (n < 0 || (size_t) n + len + 2 > avail)
+  {
+    t->dropped++;
+    return;
+  }
+
+  memcpy(p + n, query, len);
+  memcpy(p + n + len, ";\n", 2);
+  t->len += (size_t) n + len + 2;
+}
+
+
+void sb_slow_log_retry(int thread_id, unsigned int attempt)
+{
+  slow_thread_t * const t = &threads[thread_id];
+  const size_t          avail = SLOW_LOG_BUF_SIZE - t->len;
+  const int             n = snprintf(t->buf + t->len, avail, "# Retry: %u\n",
+                                     attempt);
+
+  t->retries++;
+
+  if (n > 0 && (size_t) n < avail)
+    t->len += (size_t) n;
+}
+
+
+void sb_slow_log_done(void)
+{
+  if (log_file != NULL)
+  {
+    if (fclose(log_file) != 0)
+      log_errno(LOG_FATAL, "Writing --slow-event-log '%s' failed", log_path);
+
+    log_file = NULL;
+  }
+
+  if (threads != NULL)
+  {
+    for (unsigned int i = 0; i <= sb_globals.threads; i++)
+      free(threads[i].buf);
+
+    free(threads);
+    threads = NULL;
+  }
+}
@@ -0,0 +1,69 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Slow event capture log, see --slow-event-threshold */
+
+#ifndef SB_SLOW_LOG_H
+#define SB_SLOW_LOG_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stddef.h>
+# include <inttypes.h>
+#endif
+
+#include <stdbool.h>
+
+/*
+  Validate the slow event options, open the --slow-event-log file and allocate
+  scratch buffers for sb_globals.threads worker threads. Returns 0 on success.
+*/
+int sb_slow_log_init(void);
+
+/* Return true if slow events are captured */
+bool sb_slow_log_enabled(void);
+
+/* Start capturing the event of a worker thread, discarding the previous one */
+void sb_slow_log_event_start(int thread_id);
+
+/*
+  Write the captured event of a worker thread to the log if latency_ns is at
+  least --slow-event-threshold. queue_ns is the part of it the event spent
+  waiting to be started in the --rate mode.
+*/
+void sb_slow_log_event_stop(int thread_id, uint64_t latency_ns,
+                            uint64_t queue_ns);
+
+/*
+  Capture a statement executed by the current event of a thread between
+  start_ns and end_ns (SB_GETTIME() nanoseconds) on a given server, which may
+  be NULL if unknown. sql_errno is only logged for failed statements.
+*/
+void sb_slow_log_statement(int thread_id, uint64_t start_ns, uint64_t end_ns,
+                           const char *server, bool failed, int sql_errno,
+                           const char *query, size_t len);
+
+/* Capture a restart of the current event of a thread for a retry */
+void sb_slow_log_retry(int thread_id, unsigned int attempt);
+
+void sb_slow_log_done(void);
+
+#endif /* SB_SLOW_LOG_H */
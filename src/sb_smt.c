@@ -0,0 +1,300 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  SMT sibling vs separate core comparison. The run time is split into two
+  halves with the same number of worker threads. In the first one each thread
+  runs on its own physical core, in the second one threads 2k and 2k + 1 run
+  on two SMT siblings of the same core, so pairs of threads compete for the
+  execution resources of a core. Threads move to the CPU of the current
+  placement when they claim an event, and events are accounted to the
+  placement they were claimed in.
+
+  Cores with SMT siblings are used first, so that thread 2k runs on the same
+  CPU in both halves. The SMT yield is the additional throughput a core gets
+  from running two siblings rather than one thread, i.e. twice the per-thread
+  throughput on siblings relative to separate cores, minus one.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#include <inttypes.h>
+#include <limits.h>
+
+#include "sb_smt.h"
+#include "sb_affinity.h"
+#include "sb_options.h"
+#include "sb_logger.h"
+#include "sb_util.h"
+#include "sysbench.h"
+
+#define PLACEMENT_CORES    0
+#define PLACEMENT_SIBLINGS 1
+
+typedef struct
+{
+  uint64_t     events[2];               /* events per placement */
+  unsigned int placement;               /* current placement, UINT_MAX before
+                                           the first event */
+  char pad[SB_CACHELINE_PAD(sizeof(uint64_t) * 2 + sizeof(unsigned int))];
+} smt_stat_t;
+
+static bool smt_enabled;
+
+/* CPUs of worker threads for each placement */
+static unsigned int *thread_cpus[2];
+static unsigned int nthreads;
+
+/* Duration of each placement */
+static uint64_t half_ns;
+
+static smt_stat_t *stats;
+
+
+int sb_smt_init(void)
+{
+  smt_enabled = sb_get_value_flag("smt-compare");
+
+  if (!smt_enabled)
+    return 0;
+
+  if (sb_globals.max_time_ns == 0 || sb_globals.warmup_time > 0 ||
+      sb_globals.max_events > 0 || sb_globals.tx_rate > 0)
+  {
+    log_text(LOG_FATAL, "--smt-compare requires a --time limit and does not "
+             "support --events, --warmup-time or --rate");
+    return 1;
+  }
+
+  if (sb_affinity_policy() != NULL)
+  {
+    log_text(LOG_FATAL, "--smt-compare cannot be used with --thread-affinity");
+    return 1;
+  }
+
+  return 0;
+}
+
+
+bool sb_smt_enabled(void)
+{
+  return smt_enabled;
+}
+
+
+int sb_smt_run_start(void)
+{
+  unsigned int *cpus;
+  unsigned int ncpus;
+  unsigned int *ids;                    /* ID of each core */
+  unsigned int *first;                  /* first CPU of each core */
+  unsigned int *second;                 /* second CPU, UINT_MAX if none */
+  unsigned int ncores = 0;
+  unsigned int nsmt = 0;
+  unsigned int *order;                  /* SMT cores first */
+  unsigned int n = 0;
+
+  if (!smt_enabled)
+    return 0;
+
+  nthreads = sb_globals.threads;
+
+  if (nthreads % 2 != 0)
+  {
+    log_text(LOG_FATAL, "--smt-compare requires an even number of threads");
+    return 1;
+  }
+
+  if (sb_cpu_list(NULL, &cpus, &ncpus))
+    return 1;
+
+  ids = malloc(ncpus * sizeof(unsigned int));
+  first = malloc(ncpus * sizeof(unsigned int));
+  second = malloc(ncpus * sizeof(unsigned int));
+  order = malloc(ncpus * sizeof(unsigned int));
+
+  for (unsigned int t = 0; t < 2; t++)
+  {
+    free(thread_cpus[t]);
+    thread_cpus[t] = malloc(nthreads * sizeof(unsigned int));
+  }
+
+  free(stats);
+  stats = calloc(nthreads, sizeof(smt_stat_t));
+
+  if (ids == NULL || first == NULL || second == NULL || order == NULL ||
+      thread_cpus[0] == NULL || thread_cpus[1] == NULL || stats == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    free(cpus);
+    free(ids);
+    free(first);
+    free(second);
+    free(order);
+    return 1;
+  }
+
+  /* CPUs are sorted, so the first allowed sibling of each core comes first */
+  for (unsigned int i = 0; i < ncpus; i++)
+  {
+    const unsigned int core = sb_cpu_core(cpus[i]);
+    unsigned int       j;
+
+    for (j = 0; j < ncores && ids[j] != core; j++) ;
+
+    if (j == ncores)
+    {
+      ids[ncores] = core;
+      first[ncores] = cpus[i];
+      second[ncores++] = UINT_MAX;
+    }
+    else if (second[j] == UINT_MAX)
+    {
+      second[j] = cpus[i];
+      nsmt++;
+    }
+  }
+
+  for (unsigned int i = 0; i < ncores; i++)
+    if (second[i] != UINT_MAX)
+      order[n++] = i;
+  for (unsigned int i = 0; i < ncores; i++)
+    if (second[i] == UINT_MAX)
+      order[n++] = i;
+
+  free(cpus);
+  free(ids);
+
+  if (nsmt < nthreads / 2 || ncores < nthreads)
+  {
+    log_text(LOG_FATAL, "--smt-compare with %u threads requires %u physical "
+             "cores with SMT siblings and %u cores available, found %u and %u",
+             nthreads, nthreads / 2, nthreads, nsmt, ncores);
+    free(first);
+    free(second);
+    free(order);
+    return 1;
+  }
+
+  for (unsigned int i = 0; i < nthreads; i++)
+  {
+    const unsigned int pair = order[i / 2];
+
+    thread_cpus[PLACEMENT_CORES][i] = first[order[i]];
+    thread_cpus[PLACEMENT_SIBLINGS][i] = i % 2 == 0 ? first[pair] :
+      second[pair];
+    stats[i].placement = UINT_MAX;
+  }
+
+  free(first);
+  free(second);
+  free(order);
+
+  half_ns = sb_globals.max_time_ns / 2;
+
+  return 0;
+}
+
+
+bool sb_smt_event(int thread_id, uint64_t now_ns, uint64_t n)
+{
+  smt_stat_t         *s = &stats[thread_id];
+  const unsigned int placement = now_ns >= half_ns ? PLACEMENT_SIBLINGS :
+    PLACEMENT_CORES;
+
+  if (SB_UNLIKELY(placement != s->placement))
+  {
+    if (sb_run_on_cpu(thread_cpus[placement][thread_id]))
+    {
+      sb_globals.error = 1;
+      return false;
+    }
+
+    s->placement = placement;
+  }
+
+  s->events[placement] += n;
+
+  return true;
+}
+
+
+void sb_smt_report(void)
+{
+  const double seconds = NS2SEC(half_ns);
+  double       sum[2] = { 0, 0 };
+
+  if (!smt_enabled || stats == NULL)
+    return;
+
+  log_text(LOG_NOTICE, "SMT comparison, events/sec per thread (%.2fs per "
+           "placement):", seconds);
+  log_text(LOG_NOTICE, "    thread        separate cores           SMT siblings");
+  log_text(LOG_NOTICE, "                CPU   events/sec       CPU   events/sec");
+
+  for (unsigned int i = 0; i < nthreads; i++)
+  {
+    const double cores = stats[i].events[PLACEMENT_CORES] / seconds;
+    const double siblings = stats[i].events[PLACEMENT_SIBLINGS] / seconds;
+
+    log_text(LOG_NOTICE, "    %6u %8u %12.2f %9u %12.2f", i,
+             thread_cpus[PLACEMENT_CORES][i], cores,
+             thread_cpus[PLACEMENT_SIBLINGS][i], siblings);
+
+    sum[PLACEMENT_CORES] += cores;
+    sum[PLACEMENT_SIBLINGS] += siblings;
+  }
+
+  log_text(LOG_NOTICE, "    %6s %8s %12.2f %9s %12.2f", "avg", "",
+           sum[PLACEMENT_CORES] / nthreads, "",
+           sum[PLACEMENT_SIBLINGS] / nthreads);
+
+  if (sum[PLACEMENT_CORES] > 0)
+  {
+    const double ratio = sum[PLACEMENT_SIBLINGS] / sum[PLACEMENT_CORES];
+
+    log_text(LOG_NOTICE, "    per-thread throughput on siblings:   %.1f%% of "
+             "separate cores", 100 * ratio);
+    log_text(LOG_NOTICE, "    SMT yield:                           %+.1f%% "
+             "throughput per core", 100 * (2 * ratio - 1));
+  }
+
+  log_text(LOG_NOTICE, "");
+}
+
+
+void sb_smt_done(void)
+{
+  for (unsigned int t = 0; t < 2; t++)
+  {
+    free(thread_cpus[t]);
+    thread_cpus[t] = NULL;
+  }
+
+  free(stats);
+  stats = NULL;
+  nthreads = 0;
+}
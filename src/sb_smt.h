@@ -0,0 +1,58 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* SMT sibling vs separate core comparison, see --smt-compare */
+
+#ifndef SB_SMT_H
+#define SB_SMT_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  Read --smt-compare and check that it can be used with other options. Must be
+  called after sb_thread_init(). Returns 0 on success.
+*/
+int sb_smt_init(void);
+
+/* Return true if --smt-compare is enabled */
+bool sb_smt_enabled(void);
+
+/*
+  Place worker threads on CPUs for both halves of a run and reset statistics,
+  called by the main thread. Returns 0 on success.
+*/
+int sb_smt_run_start(void);
+
+/*
+  Account n events claimed by a worker thread at a given time since the run
+  start, moving the thread to the CPU of the current placement if necessary.
+  Returns false on errors.
+*/
+bool sb_smt_event(int thread_id, uint64_t now_ns, uint64_t n);
+
+/* Print per-thread throughput of both placements and the SMT yield */
+void sb_smt_report(void);
+
+void sb_smt_done(void);
+
+#endif /* SB_SMT_H */
@@ -38,9 +38,13 @@
 #include "sb_logger.h"
 #include "sysbench.h"
 #include "sb_ck_pr.h"
+#include "sb_affinity.h"
 
 pthread_attr_t  sb_thread_attr;
 
+/* Attributes of worker threads, may additionally have CPU affinity set */
+static pthread_attr_t worker_attr;
+
 /* Thread descriptors */
 static sb_thread_ctxt_t *threads;
 
@@ -63,6 +67,15 @@ int sb_thread_init(void)
 #endif
   pthread_attr_setstacksize(&sb_thread_attr, thread_stack_size);
 
+  pthread_attr_init(&worker_attr);
+#ifdef PTHREAD_SCOPE_SYSTEM
+  pthread_attr_setscope(&worker_attr,PTHREAD_SCOPE_SYSTEM);
+#endif
+  pthread_attr_setstacksize(&worker_attr, thread_stack_size);
+
+  if (sb_affinity_init())
+    return EXIT_FAILURE;
+
 #ifdef HAVE_THR_SETCONCURRENCY
   /* Set thread concurrency (required on Solaris) */
   thr_setconcurrency(sb_globals.threads);
@@ -78,10 +91,17 @@ int sb_thread_init(void)
   return EXIT_SUCCESS;
 }
 
+size_t sb_thread_stack_size(void)
+{
+  return (size_t) thread_stack_size;
+}
+
 void sb_thread_done(void)
 {
   if (threads != NULL)
     free(threads);
+
+  sb_affinity_done();
 }
 
 #ifndef HAVE_PTHREAD_CANCEL
@@ -171,7 +191,10 @@ int sb_thread_create_workers(void *(*worker_routine)(void*))
   {
     int err;
 
-    if ((err = sb_thread_create(&(threads[i].thread), &sb_thread_attr,
+    if (sb_affinity_set_attr(&worker_attr, i))
+      return EXIT_FAILURE;
+
+    if ((err = sb_thread_create(&(threads[i].thread), &worker_attr,
                                 worker_routine, (void*)(threads + i))) != 0)
     {
       log_errno(LOG_FATAL, "sb_thread_create() for thread #%d failed.", i);
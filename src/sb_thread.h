@@ -55,6 +55,9 @@ int sb_thread_join_workers(void);
 
 int sb_thread_init(void);
 
+/* Stack size of worker threads, see --thread-stack-size */
+size_t sb_thread_stack_size(void);
+
 void sb_thread_done(void);
 
 #endif /* SB_THREAD_H */
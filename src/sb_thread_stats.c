@@ -0,0 +1,226 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Per-thread statistics break down events, latency and errors by worker
+  thread, so that threads starved behind a hot lock or a slow host are not
+  hidden by the totals.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+
+#include "sb_thread_stats.h"
+#include "sb_counter.h"
+#include "sb_histogram.h"
+#include "sb_logger.h"
+#include "sb_options.h"
+#include "sb_util.h"
+#include "sysbench.h"
+
+/*
+  Per-thread histograms use coarser buckets (about 15% wide) than the global
+  one to keep memory usage reasonable with many threads
+*/
+#define THREAD_HIST_SIZE      128
+#define THREAD_HIST_MIN_VALUE 1e-3
+#define THREAD_HIST_MAX_VALUE 1E5
+
+/* Threads with fewer events than this share of the average are stragglers */
+#define STRAGGLER_RATIO 0.5
+
+typedef struct
+{
+  sb_histogram_t histogram;
+
+  /* Counter values at the last intermediate report and checkpoint */
+  uint64_t       int_events;
+  uint64_t       int_errors;
+  uint64_t       cp_events;
+  uint64_t       cp_errors;
+
+  /* Statistics saved by the last checkpoint */
+  uint64_t       events;
+  uint64_t       errors;
+  double         avg_ms;
+  double         max_ms;
+  double         *pcts;
+  bool           straggler;
+} sb_thread_stat_t;
+
+static sb_thread_stat_t *stats;
+static unsigned int     nstats;
+
+/* Number of threads and duration of the last checkpoint */
+static unsigned int     cp_threads;
+static double           cp_seconds;
+static unsigned int     cp_stragglers;
+
+
+int sb_thread_stats_init(void)
+{
+  if (!sb_get_value_flag("report-per-thread"))
+    return 0;
+
+  stats = calloc(sb_globals.threads, sizeof(sb_thread_stat_t));
+  if (stats == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  for (; nstats < sb_globals.threads; nstats++)
+    if (sb_histogram_init(&stats[nstats].histogram, THREAD_HIST_SIZE,
+                          THREAD_HIST_MIN_VALUE, THREAD_HIST_MAX_VALUE))
+      return 1;
+
+  return 0;
+}
+
+
+bool sb_thread_stats_enabled(void)
+{
+  return stats != NULL;
+}
+
+
+void sb_thread_stats_event(int thread_id, double ms)
+{
+  sb_histogram_update(&stats[thread_id].histogram, ms);
+}
+
+
+void sb_thread_stats_report_intermediate(double time_total, double seconds)
+{
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+  {
+    sb_thread_stat_t *s = &stats[i];
+    const uint64_t   events = sb_counter_val(i, SB_CNT_EVENT);
+    const uint64_t   errors = sb_counter_val(i, SB_CNT_ERROR);
+    double           *pcts = NULL;
+
+    if (sb_globals.npercentiles > 0)
+      pcts = sb_histogram_get_pct_intermediate(&s->histogram,
+                                               sb_globals.percentiles, 1);
+
+    log_timestamp(LOG_NOTICE, time_total,
+                  "thread %u: eps: %4.2f lat (ms,%g%%): %4.2f err/s: %4.2f",
+                  i, (events - s->int_events) / seconds,
+                  sb_globals.npercentiles > 0 ? sb_globals.percentiles[0] : 0,
+                  pcts != NULL ? SEC2MS(pcts[0]) : 0,
+                  (errors - s->int_errors) / seconds);
+
+    free(pcts);
+
+    s->int_events = events;
+    s->int_errors = errors;
+  }
+}
+
+
+void sb_thread_stats_checkpoint(const sb_timer_t *timers, double seconds)
+{
+  uint64_t total = 0;
+
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+  {
+    sb_thread_stat_t *s = &stats[i];
+    const uint64_t   events = sb_counter_val(i, SB_CNT_EVENT);
+    const uint64_t   errors = sb_counter_val(i, SB_CNT_ERROR);
+
+    s->events = events - s->cp_events;
+    s->errors = errors - s->cp_errors;
+    s->cp_events = events;
+    s->cp_errors = errors;
+    s->avg_ms = timers[i].samples > 0 ?
+      NS2MS(timers[i].sum_time / timers[i].samples) : 0;
+    s->max_ms = NS2MS(timers[i].max_time);
+
+    free(s->pcts);
+    s->pcts = NULL;
+
+    if (sb_globals.npercentiles > 0)
+      s->pcts = sb_histogram_get_pct_checkpoint(&s->histogram,
+                                                sb_globals.percentiles, 1);
+
+    total += s->events;
+  }
+
+  cp_threads = sb_globals.threads;
+  cp_seconds = seconds;
+  cp_stragglers = 0;
+
+  const double avg = cp_threads > 0 ? (double) total / cp_threads : 0;
+
+  for (unsigned int i = 0; i < cp_threads; i++)
+  {
+    stats[i].straggler = stats[i].events < avg * STRAGGLER_RATIO;
+    cp_stragglers += stats[i].straggler;
+  }
+}
+
+
+void sb_thread_stats_report_cumulative(void)
+{
+  const double seconds = cp_seconds > 0 ? cp_seconds : 1;
+  char         pct[32];
+
+  snprintf(pct, sizeof(pct), "%.2fth",
+           sb_globals.npercentiles > 0 ? sb_globals.percentiles[0] : 0);
+
+  log_text(LOG_NOTICE, "Per-thread statistics:");
+  log_text(LOG_NOTICE, "    %6s %12s %12s %9s %9s %9s %8s", "thread",
+           "events", "events/s", "avg ms", pct, "max ms", "errors");
+
+  for (unsigned int i = 0; i < cp_threads; i++)
+  {
+    const sb_thread_stat_t *s = &stats[i];
+
+    log_text(LOG_NOTICE, "    %6u %12" PRIu64 " %12.2f %9.2f %9.2f %9.2f %8"
+             PRIu64 "%s", i, s->events, s->events / seconds, s->avg_ms,
+             s->pcts != NULL ? SEC2MS(s->pcts[0]) : 0, s->max_ms, s->errors,
+             s->straggler ? "  straggler" : "");
+  }
+
+  log_text(LOG_NOTICE, "");
+}
+
+
+unsigned int sb_thread_stats_stragglers(void)
+{
+  return cp_stragglers;
+}
+
+
+void sb_thread_stats_done(void)
+{
+  for (unsigned int i = 0; i < nstats; i++)
+  {
+    sb_histogram_done(&stats[i].histogram);
+    free(stats[i].pcts);
+  }
+
+  free(stats);
+  stats = NULL;
+  nstats = 0;
+}
@@ -0,0 +1,65 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Per-thread statistics, see --report-per-thread */
+
+#ifndef SB_THREAD_STATS_H
+#define SB_THREAD_STATS_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+
+#include "sb_timer.h"
+
+/*
+  Allocate per-thread statistics for sb_globals.threads worker threads if
+  --report-per-thread is enabled. Returns 0 on success.
+*/
+int sb_thread_stats_init(void);
+
+/* Return true if per-thread statistics are enabled */
+bool sb_thread_stats_enabled(void);
+
+/* Account the latency of an event executed by a worker thread */
+void sb_thread_stats_event(int thread_id, double ms);
+
+/* Print per-thread intermediate statistics */
+void sb_thread_stats_report_intermediate(double time_total, double seconds);
+
+/*
+  Save per-thread statistics since the previous checkpoint for
+  sb_thread_stats_report_cumulative() and reset them. timers are the
+  per-thread event timers for the same period.
+*/
+void sb_thread_stats_checkpoint(const sb_timer_t *timers, double seconds);
+
+/*
+  Print per-thread statistics saved by the last checkpoint, marking threads
+  that executed much fewer events than the average as stragglers
+*/
+void sb_thread_stats_report_cumulative(void);
+
+/* Return the number of stragglers found by the last checkpoint */
+unsigned int sb_thread_stats_stragglers(void);
+
+void sb_thread_stats_done(void);
+
+#endif /* SB_THREAD_STATS_H */
@@ -28,6 +28,10 @@
 # include <string.h>
 #endif
 
+#ifdef HAVE_STDIO_H
+# include <stdio.h>
+#endif
+
 #include "sb_logger.h"
 #include "sb_timer.h"
 #include "sb_util.h"
@@ -56,6 +60,7 @@ void sb_timer_reset(sb_timer_t *t)
   t->max_time = 0;
   t->sum_time = 0;
   t->events = 0;
+  t->samples = 0;
   t->queue_time = 0;
 }
 
@@ -115,9 +120,9 @@ void sb_timer_checkpoint(sb_timer_t *t, sb_timer_t *old)
 
 uint64_t sb_timer_avg(sb_timer_t *t)
 {
-  if(t->events == 0)
+  if(t->samples == 0)
     return 0; /* return zero if there were no events */
-  return (t->sum_time / t->events);
+  return (t->sum_time / t->samples);
 }
 
 
@@ -126,7 +131,13 @@ uint64_t sb_timer_avg(sb_timer_t *t)
 
 uint64_t sb_timer_sum(sb_timer_t *t)
 {
-  return t->sum_time;
+  if (t->samples == t->events)
+    return t->sum_time;
+
+  if (t->samples == 0)
+    return 0;
+
+  return (uint64_t) ((double) t->sum_time * t->events / t->samples);
 }
 
 
@@ -135,7 +146,7 @@ uint64_t sb_timer_sum(sb_timer_t *t)
 
 uint64_t sb_timer_min(sb_timer_t *t)
 {
-  if (t->events == 0)
+  if (t->samples == 0)
     return 0;
   return t->min_time;
 }
@@ -162,6 +173,7 @@ sb_timer_t sb_timer_merge(sb_timer_t *t1, sb_timer_t *t2)
 
   t.sum_time = t1->sum_time+t2->sum_time;
   t.events = t1->events+t2->events;
+  t.samples = t1->samples+t2->samples;
 
   if (t1->max_time > t2->max_time)
     t.max_time = t1->max_time;
@@ -175,3 +187,52 @@ sb_timer_t sb_timer_merge(sb_timer_t *t1, sb_timer_t *t2)
      
   return t;       
 }
+
+
+/* get the cost of one SB_GETTIME() call */
+
+double sb_timer_gettime_cost(void)
+{
+  struct timespec start, end, ts;
+  uint64_t        min_ns = UINT64_MAX;
+
+  for (int round = 0; round < 10; round++)
+  {
+    SB_GETTIME(&start);
+    for (int i = 0; i < 1000; i++)
+      SB_GETTIME(&ts);
+    SB_GETTIME(&end);
+
+    const uint64_t ns = TIMESPEC_DIFF(end, start);
+
+    if (ns < min_ns)
+      min_ns = ns;
+  }
+
+  /* 1002 calls including the ones taking start and end */
+  return min_ns / 1002.0;
+}
+
+
+/* get the name of the current kernel clocksource */
+
+bool sb_timer_clocksource(char *buf, size_t size)
+{
+  FILE *fp;
+  bool res = false;
+
+  fp = fopen("/sys/devices/system/clocksource/clocksource0/"
+             "current_clocksource", "r");
+  if (fp == NULL)
+    return false;
+
+  if (fgets(buf, (int) size, fp) != NULL)
+  {
+    buf[strcspn(buf, "\n")] = '\0';
+    res = buf[0] != '\0';
+  }
+
+  fclose(fp);
+
+  return res;
+}
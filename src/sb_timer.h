@@ -84,14 +84,15 @@ typedef struct
   struct timespec time_start;
   struct timespec time_end;
   uint64_t        events;
+  uint64_t        samples;  /* number of timed events, <= events */
   uint64_t        queue_time;
   uint64_t        min_time;
   uint64_t        max_time;
-  uint64_t        sum_time;
+  uint64_t        sum_time; /* total time of timed events */
 
   ck_spinlock_t   lock;
 
-  char pad[SB_CACHELINE_PAD(sizeof(struct timespec)*2 + sizeof(uint64_t)*5 +
+  char pad[SB_CACHELINE_PAD(sizeof(struct timespec)*2 + sizeof(uint64_t)*6 +
                             sizeof(ck_spinlock_t))];
 } sb_timer_t;
 
@@ -123,6 +124,16 @@ static inline void sb_timer_start(sb_timer_t *t)
   ck_spinlock_unlock(&t->lock);
 }
 
+/* start timer at a given time in the past, as returned by SB_GETTIME() */
+static inline void sb_timer_start_at(sb_timer_t *t, const struct timespec *ts)
+{
+  ck_spinlock_lock(&t->lock);
+
+  t->time_start = *ts;
+
+  ck_spinlock_unlock(&t->lock);
+}
+
 /* stop timer */
 static inline uint64_t sb_timer_stop(sb_timer_t *t)
 {
@@ -133,6 +144,7 @@ static inline uint64_t sb_timer_stop(sb_timer_t *t)
   uint64_t elapsed = TIMESPEC_DIFF(t->time_end, t->time_start) + t->queue_time;
 
   t->events++;
+  t->samples++;
   t->sum_time += elapsed;
 
   if (SB_UNLIKELY(elapsed < t->min_time))
@@ -145,6 +157,59 @@ static inline uint64_t sb_timer_stop(sb_timer_t *t)
   return elapsed;
 }
 
+/*
+  stop timer after executing a batch of 'n' events. Each event is accounted with
+  the average latency of the batch, which is returned.
+*/
+static inline uint64_t sb_timer_stop_batch(sb_timer_t *t, uint64_t n)
+{
+  ck_spinlock_lock(&t->lock);
+
+  SB_GETTIME(&t->time_end);
+
+  uint64_t elapsed = TIMESPEC_DIFF(t->time_end, t->time_start) + t->queue_time;
+  uint64_t avg = elapsed / n;
+
+  t->events += n;
+  t->samples += n;
+  t->sum_time += elapsed;
+
+  if (SB_UNLIKELY(avg < t->min_time))
+    t->min_time = avg;
+  if (SB_UNLIKELY(avg > t->max_time))
+    t->max_time = avg;
+
+  ck_spinlock_unlock(&t->lock);
+
+  return avg;
+}
+
+/*
+  account an event that was executed without starting/stopping the timer, i.e.
+  when latency sampling is used
+*/
+static inline void sb_timer_count(sb_timer_t *t)
+{
+  ck_spinlock_lock(&t->lock);
+
+  t->events++;
+
+  ck_spinlock_unlock(&t->lock);
+}
+
+/*
+  account a batch of 'n' events that was executed without starting/stopping
+  the timer
+*/
+static inline void sb_timer_count_batch(sb_timer_t *t, uint64_t n)
+{
+  ck_spinlock_lock(&t->lock);
+
+  t->events += n;
+
+  ck_spinlock_unlock(&t->lock);
+}
+
 /*
   get the current timer value in nanoseconds without affecting its state, i.e.
   is safe to be used concurrently on a shared timer.
@@ -176,7 +241,10 @@ void sb_timer_checkpoint(sb_timer_t *t, sb_timer_t *old);
 /* get average time per event */
 uint64_t sb_timer_avg(sb_timer_t *);
 
-/* get total time for all events */
+/*
+  get total time for all events. If some events were not timed, the result is
+  extrapolated from the timed ones.
+*/
 uint64_t sb_timer_sum(sb_timer_t *);
 
 /* get minimum time */
@@ -188,4 +256,16 @@ uint64_t sb_timer_max(sb_timer_t *);
 /* sum data from two timers. used in summing data from multiple threads */
 sb_timer_t sb_timer_merge(sb_timer_t *, sb_timer_t *);
 
+/*
+  get the cost of one SB_GETTIME() call in nanoseconds, measured as the minimum
+  over a few rounds so that preemption does not inflate it
+*/
+double sb_timer_gettime_cost(void);
+
+/*
+  copy the name of the current kernel clocksource to 'buf'. Returns false if
+  it is not available.
+*/
+bool sb_timer_clocksource(char *buf, size_t size);
+
 #endif /* SB_TIMER_H */
@@ -0,0 +1,53 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  USDT static tracepoints in the 'sysbench' provider. A disabled probe is a
+  single NOP instruction, so probes can be placed on hot paths, and they stay
+  usable on inlined functions, unlike uprobes. Probes are compiled in when
+  <sys/sdt.h> (systemtap-sdt-dev or systemtap-sdt-devel) is found by
+  configure, unless --disable-usdt is given, and are no-ops otherwise.
+
+  Probe names use double underscores, which tracers show as dashes, e.g.
+  usdt:/usr/bin/sysbench:sysbench:event__stop in bpftrace. See README.md for
+  the list of probes and their arguments.
+*/
+
+#ifndef SB_TRACE_H
+#define SB_TRACE_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_SYS_SDT_H
+# include <sys/sdt.h>
+
+# define SB_PROBE1(name, a1) DTRACE_PROBE1(sysbench, name, a1)
+# define SB_PROBE2(name, a1, a2) DTRACE_PROBE2(sysbench, name, a1, a2)
+# define SB_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(sysbench, name, a1, a2, a3)
+# define SB_PROBE4(name, a1, a2, a3, a4) \
+  DTRACE_PROBE4(sysbench, name, a1, a2, a3, a4)
+#else
+# define SB_PROBE1(name, a1) do {} while (0)
+# define SB_PROBE2(name, a1, a2) do {} while (0)
+# define SB_PROBE3(name, a1, a2, a3) do {} while (0)
+# define SB_PROBE4(name, a1, a2, a3, a4) do {} while (0)
+#endif
+
+#endif /* SB_TRACE_H */
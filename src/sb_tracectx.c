@@ -0,0 +1,274 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Sampled trace context propagation. A random fraction of events gets a
+  W3C trace ID, and every statement of such an event gets its own span ID. The
+  statements are sent with a sqlcommenter-style comment carrying the trace
+  context in the W3C traceparent format:
+
+    /\*traceparent='00-<trace ID>-<statement span ID>-01'*\/ SELECT ...
+
+  The client-side timings of traced events and of their statements are
+  written to the --trace-log file, one JSON object per span, so slow events
+  can be matched to server-side statement history or tracing data. IDs are
+  generated by per-thread generators seeded from the clock rather than
+  --rand-seed, so they differ between runs and do not change the random
+  numbers used by tests.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdio.h>
+# include <stdlib.h>
+# include <inttypes.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+#include "sb_tracectx.h"
+#include "sysbench.h"
+#include "sb_logger.h"
+#include "sb_options.h"
+#include "sb_timer.h"
+#include "sb_util.h"
+
+typedef struct
+{
+  uint64_t rng;                 /* splitmix64 state */
+  uint64_t trace_id[2];
+  uint64_t span_id;             /* span of the event */
+  uint64_t time_ns;             /* wall clock time the event started */
+  uint64_t start_ns;            /* monotonic time the event started */
+  uint64_t queries;
+  uint64_t errors;
+  uint64_t query_span_id;       /* span of the current statement */
+  uint64_t query_time_ns;
+  uint64_t query_start_ns;
+  bool     sampled;             /* is the current event traced? */
+  char     pad[SB_CACHELINE_PAD(sizeof(uint64_t) * 11 + sizeof(bool))];
+} trace_thread_t;
+
+static double          sample_pct;
+static const char      *log_path;
+static FILE            *log_file;
+static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static trace_thread_t  *threads;
+
+
+static uint64_t splitmix64(uint64_t *state)
+{
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+  return z ^ (z >> 31);
+}
+
+
+static uint64_t clock_ns(clockid_t clock)
+{
+  struct timespec ts;
+
+  clock_gettime(clock, &ts);
+
+  return SEC2NS(ts.tv_sec) + ts.tv_nsec;
+}
+
+
+int sb_tracectx_init(void)
+{
+  uint64_t seed;
+
+  sample_pct = sb_get_value_double("trace-sample-pct");
+  log_path = sb_get_value_string("trace-log");
+
+  if (sample_pct < 0 || sample_pct > 100)
+  {
+    log_text(LOG_FATAL, "Invalid value for --trace-sample-pct: %g",
+             sample_pct);
+    return 1;
+  }
+
+  if (log_path != NULL && sample_pct == 0)
+  {
+    log_text(LOG_FATAL, "--trace-log requires --trace-sample-pct");
+    return 1;
+  }
+
+  if (sample_pct == 0)
+    return 0;
+
+  /* Statements of virtual users sharing a thread cannot be told apart */
+  if (sb_globals.virtual_users > 1)
+  {
+    log_text(LOG_FATAL, "--trace-sample-pct cannot be used with "
+             "--virtual-users");
+    return 1;
+  }
+
+  threads = sb_alloc_per_thread_array(sizeof(trace_thread_t));
+  if (threads == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  seed = clock_ns(CLOCK_REALTIME) ^ ((uint64_t) getpid() << 32);
+
+  for (unsigned int i = 0; i <= sb_globals.threads; i++)
+    threads[i].rng = splitmix64(&seed);
+
+  if (log_path != NULL)
+  {
+    log_file = fopen(log_path, "w");
+    if (log_file == NULL)
+    {
+      log_errno(LOG_FATAL, "Cannot open --trace-log '%s'", log_path);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+bool sb_tracectx_enabled(void)
+{
+  return threads != NULL;
+}
+
+
+void sb_tracectx_event_start(int thread_id)
+{
+  trace_thread_t * const t = &threads[thread_id];
+
+  /* Uniform double in [0, 100) from the upper 53 bits */
+  t->sampled = (splitmix64(&t->rng) >> 11) * (100.0 / 9007199254740992.0) <
+    sample_pct;
+
+  if (!t->sampled)
+    return;
+
+  t->trace_id[0] = splitmix64(&t->rng);
+  t->trace_id[1] = splitmix64(&t->rng);
+  t->span_id = splitmix64(&t->rng);
+  t->queries = 0;
+  t->errors = 0;
+  t->time_ns = clock_ns(CLOCK_REALTIME);
+  t->start_ns = clock_ns(CLOCK_MONOTONIC);
+}
+
+
+void sb_tracectx_event_stop(int thread_id)
+{
+  trace_thread_t * const t = &threads[thread_id];
+
+  if (!t->sampled)
+    return;
+
+  t->sampled = false;
+
+  if (log_file == NULL)
+    return;
+
+  const uint64_t duration = clock_ns(CLOCK_MONOTONIC) - t->start_ns;
+
+  pthread_mutex_lock(&log_mutex);
+
+  fprintf(log_file, "{\"type\":\"event\",\"trace_id\":\"%016" PRIx64 "%016"
+          PRIx64 "\",\"span_id\":\"%016" PRIx64 "\",\"thread\":%d,"
+          "\"time\":%.6f,\"duration_ms\":%.3f,\"queries\":%" PRIu64 ","
+          "\"errors\":%" PRIu64 "}\n", t->trace_id[0], t->trace_id[1],
+          t->span_id, thread_id, t->time_ns / (double) NS_PER_SEC,
+          NS2MS(duration), t->queries, t->errors);
+
+  pthread_mutex_unlock(&log_mutex);
+}
+
+
+bool sb_tracectx_sampled(int thread_id)
+{
+  return threads != NULL && threads[thread_id].sampled;
+}
+
+
+size_t sb_tracectx_query_start(int thread_id, char *buf)
+{
+  trace_thread_t * const t = &threads[thread_id];
+
+  t->query_span_id = splitmix64(&t->rng);
+  t->query_time_ns = clock_ns(CLOCK_REALTIME);
+  t->query_start_ns = clock_ns(CLOCK_MONOTONIC);
+
+  return (size_t) snprintf(buf, SB_TRACECTX_COMMENT_MAX,
+                           "/*traceparent='00-%016" PRIx64 "%016" PRIx64
+                           "-%016" PRIx64 "-01'*/ ", t->trace_id[0],
+                           t->trace_id[1], t->query_span_id);
+}
+
+
+void sb_tracectx_query_stop(int thread_id, bool failed)
+{
+  trace_thread_t * const t = &threads[thread_id];
+
+  t->queries++;
+  if (failed)
+    t->errors++;
+
+  if (log_file == NULL)
+    return;
+
+  const uint64_t duration = clock_ns(CLOCK_MONOTONIC) - t->query_start_ns;
+
+  pthread_mutex_lock(&log_mutex);
+
+  fprintf(log_file, "{\"type\":\"query\",\"trace_id\":\"%016" PRIx64 "%016"
+          PRIx64 "\",\"span_id\":\"%016" PRIx64 "\",\"parent_id\":\"%016"
+          PRIx64 "\",\"thread\":%d,\"time\":%.6f,\"duration_ms\":%.3f,"
+          "\"error\":%s}\n", t->trace_id[0], t->trace_id[1],
+          t->query_span_id, t->span_id, thread_id,
+          t->query_time_ns / (double) NS_PER_SEC, NS2MS(duration),
+          failed ? "true" : "false");
+
+  pthread_mutex_unlock(&log_mutex);
+}
+
+
+void sb_tracectx_done(void)
+{
+  if (log_file != NULL)
+  {
+    if (fclose(log_file) != 0)
+      log_errno(LOG_FATAL, "Writing --trace-log '%s' failed", log_path);
+
+    log_file = NULL;
+  }
+
+  free(threads);
+  threads = NULL;
+}
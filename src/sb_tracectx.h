@@ -0,0 +1,67 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Sampled trace context propagation, see --trace-sample-pct */
+
+#ifndef SB_TRACECTX_H
+#define SB_TRACECTX_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+  Maximum length of the comment written by sb_tracectx_query_start(),
+  including the terminating zero
+*/
+#define SB_TRACECTX_COMMENT_MAX 80
+
+/*
+  Validate the trace options, open the --trace-log file and allocate state for
+  sb_globals.threads worker threads. Returns 0 on success.
+*/
+int sb_tracectx_init(void);
+
+/* Return true if events are sampled for tracing */
+bool sb_tracectx_enabled(void);
+
+/* Decide whether the event being started by a worker thread is traced */
+void sb_tracectx_event_start(int thread_id);
+
+/* Log the event of a worker thread if it is traced */
+void sb_tracectx_event_stop(int thread_id);
+
+/* Return true if statements of a thread are currently traced */
+bool sb_tracectx_sampled(int thread_id);
+
+/*
+  Start a statement span of the traced event of a thread and write the SQL
+  comment carrying its trace context to buf, which must be at least
+  SB_TRACECTX_COMMENT_MAX bytes long. Returns the length of the comment.
+*/
+size_t sb_tracectx_query_start(int thread_id, char *buf);
+
+/* Log the statement span started by sb_tracectx_query_start() */
+void sb_tracectx_query_stop(int thread_id, bool failed);
+
+void sb_tracectx_done(void);
+
+#endif /* SB_TRACECTX_H */
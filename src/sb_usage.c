@@ -0,0 +1,222 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Client-side CPU and time accounting. Worker threads record their CPU time
+  around the run loop, database driver calls are timed in db_driver.c. The run
+  loop time of each thread is then split into time spent outside the driver
+  (i.e. in Lua or test code), on CPU inside the driver, and off CPU, which for
+  database benchmarks is mostly waiting on the network.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_SYS_TIME_H
+# include <sys/time.h>
+#endif
+#include <sys/resource.h>
+
+#include "sb_usage.h"
+#include "sysbench.h"
+#include "sb_affinity.h"
+
+/* Warn when the client used more than this share of available CPU time */
+#define CLIENT_CPU_WARN_PCT 90
+
+sb_usage_t *sb_usage CK_CC_CACHELINE;
+
+static bool     usage_report;
+static bool     client_warning = true;
+
+static uint64_t run_wall_start;
+static uint64_t run_wall_ns;
+static uint64_t run_cpu_start;
+static uint64_t run_cpu_ns;
+/* Time from the run start until all worker threads were initialized */
+static uint64_t startup_ns;
+
+
+static uint64_t timeval_ns(const struct timeval *tv)
+{
+  return SEC2NS(tv->tv_sec) + (uint64_t) tv->tv_usec * 1000;
+}
+
+
+/* CPU time of the calling thread, or of the whole process if 'self' is set */
+
+static uint64_t cpu_time(bool self)
+{
+  struct rusage ru;
+  int           who = RUSAGE_SELF;
+
+#ifdef RUSAGE_THREAD
+  if (!self)
+    who = RUSAGE_THREAD;
+#else
+  /* Per-thread CPU time is not available, do not split by threads */
+  if (!self)
+    return 0;
+#endif
+
+  if (getrusage(who, &ru))
+    return 0;
+
+  return timeval_ns(&ru.ru_utime) + timeval_ns(&ru.ru_stime);
+}
+
+
+int sb_usage_init(void)
+{
+  usage_report = sb_get_value_flag("client-stats");
+
+  sb_usage = sb_alloc_per_thread_array(sizeof(sb_usage_t));
+  if (sb_usage == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  return 0;
+}
+
+
+void sb_usage_done(void)
+{
+  free(sb_usage);
+  sb_usage = NULL;
+}
+
+
+void sb_usage_run_start(void)
+{
+  memset(sb_usage, 0, (sb_globals.threads + 1) * sizeof(sb_usage_t));
+
+  run_wall_start = sb_usage_clock();
+  run_cpu_start = cpu_time(true);
+  startup_ns = 0;
+}
+
+
+void sb_usage_threads_started(void)
+{
+  startup_ns = sb_usage_clock() - run_wall_start;
+}
+
+
+void sb_usage_run_stop(void)
+{
+  run_wall_ns = sb_usage_clock() - run_wall_start;
+  run_cpu_ns = cpu_time(true) - run_cpu_start;
+}
+
+
+void sb_usage_thread_start(int thread_id)
+{
+  sb_usage[thread_id].wall_start = sb_usage_clock();
+  sb_usage[thread_id].cpu_start = cpu_time(false);
+}
+
+
+void sb_usage_thread_stop(int thread_id)
+{
+  sb_usage_t * const u = &sb_usage[thread_id];
+
+  u->wall_ns = sb_usage_clock() - u->wall_start;
+  u->cpu_ns = cpu_time(false) - u->cpu_start;
+}
+
+
+static double pct(uint64_t part, uint64_t total)
+{
+  return total > 0 ? 100.0 * part / total : 0;
+}
+
+
+void sb_usage_report(void)
+{
+  uint64_t     wall = 0, cpu = 0, driver = 0, offcpu, driver_cpu;
+  unsigned int *cpus;
+  unsigned int ncpus = 1;
+  double       client_pct;
+
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+  {
+    wall += sb_usage[i].wall_ns;
+    cpu += sb_usage[i].cpu_ns;
+    driver += sb_usage[i].driver_ns;
+  }
+
+  if (sb_cpu_list(NULL, &cpus, &ncpus) == 0)
+    free(cpus);
+  else
+    ncpus = 1;
+
+  client_pct = pct(run_cpu_ns, run_wall_ns * ncpus);
+
+  if (usage_report)
+  {
+    /*
+      Time off CPU is assumed to be spent waiting inside the driver, the rest of
+      driver time is on CPU
+    */
+    offcpu = wall > cpu ? wall - cpu : 0;
+    driver_cpu = driver > offcpu ? driver - offcpu : 0;
+
+    log_text(LOG_NOTICE, "Client resource usage:");
+    log_text(LOG_NOTICE, "    process CPU time:                    %.2fs "
+             "(%.1f%% of %u CPU(s))", NS2SEC(run_cpu_ns), client_pct, ncpus);
+    log_text(LOG_NOTICE, "    worker threads startup time:         %.3fs",
+             NS2SEC(startup_ns));
+#ifdef RUSAGE_THREAD
+    log_text(LOG_NOTICE, "    thread time in Lua/test code:        %.1f%%",
+             pct(cpu > driver_cpu ? cpu - driver_cpu : 0, wall));
+    log_text(LOG_NOTICE, "    thread time in DB driver on CPU:     %.1f%%",
+             pct(driver_cpu, wall));
+    log_text(LOG_NOTICE, "    thread time waiting (off CPU):       %.1f%%",
+             pct(offcpu, wall));
+#else
+    /* Without per-thread CPU time, only the wall time split is known */
+    (void) driver_cpu; /* unused */
+    log_text(LOG_NOTICE, "    thread time in Lua/test code:        %.1f%%",
+             pct(wall > driver ? wall - driver : 0, wall));
+    log_text(LOG_NOTICE, "    thread time in DB driver:            %.1f%%",
+             pct(driver, wall));
+#endif
+    log_text(LOG_NOTICE, "");
+  }
+
+  /*
+    Only database benchmarks are checked, as built-in tests are expected to
+    saturate the CPU
+  */
+  if (client_warning && driver > 0 && client_pct >= CLIENT_CPU_WARN_PCT)
+    log_text(LOG_WARNING, "sysbench used %.1f%% of the CPU time available to "
+             "it, results may be limited by the client rather than the server",
+             client_pct);
+}
+
+
+void sb_usage_disable_client_warning(void)
+{
+  client_warning = false;
+}
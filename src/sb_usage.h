@@ -0,0 +1,93 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Client-side CPU and time accounting, see --client-stats */
+
+#ifndef SB_USAGE_H
+#define SB_USAGE_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdint.h>
+
+#include "sb_timer.h"
+#include "sb_util.h"
+
+/* Per-thread accounting, written only by the owning thread */
+typedef struct
+{
+  uint64_t wall_ns;             /* time spent in the run loop */
+  uint64_t cpu_ns;              /* CPU time used in the run loop */
+  uint64_t driver_ns;           /* time spent in database driver calls */
+
+  uint64_t wall_start;
+  uint64_t cpu_start;
+
+  char     pad[SB_CACHELINE_PAD(5 * sizeof(uint64_t))];
+} sb_usage_t;
+
+extern sb_usage_t *sb_usage;
+
+int sb_usage_init(void);
+void sb_usage_done(void);
+
+/* Mark the start and the end of a benchmark run, called by the main thread */
+void sb_usage_run_start(void);
+void sb_usage_run_stop(void);
+
+/*
+  Mark the end of worker thread initialization, i.e. of creating Lua states and
+  calling thread_init()
+*/
+void sb_usage_threads_started(void);
+
+/* Mark the start and the end of the run loop in a worker thread */
+void sb_usage_thread_start(int thread_id);
+void sb_usage_thread_stop(int thread_id);
+
+/*
+  Print the client resource usage for the last run with --client-stats, and
+  warn if the client was likely the bottleneck of a database benchmark.
+*/
+void sb_usage_report(void);
+
+/*
+  Disable the client CPU warning, called by drivers for embedded databases that
+  run in the sysbench process and thus always load the client
+*/
+void sb_usage_disable_client_warning(void);
+
+/* Current time in nanoseconds, used to time driver calls */
+
+static inline uint64_t sb_usage_clock(void)
+{
+  struct timespec ts;
+
+  SB_GETTIME(&ts);
+
+  return SEC2NS(ts.tv_sec) + ts.tv_nsec;
+}
+
+static inline void sb_usage_add_driver_time(int thread_id, uint64_t start)
+{
+  sb_usage[thread_id].driver_ns += sb_usage_clock() - start;
+}
+
+#endif /* SB_USAGE_H */
@@ -0,0 +1,245 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  User-defined counters and named histograms. Each Lua state registers them by
+  name when the script is loaded, and gets the same counter or histogram as
+  all other states. Counters are per-thread like the built-in ones and are
+  only aggregated by reports, while histograms are shared by all threads.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+#include "sb_user_stats.h"
+#include "sb_ck_pr.h"
+#include "sb_logger.h"
+#include "sb_util.h"
+#include "sysbench.h"
+
+/* Per-thread counter values, padded to avoid cache line sharing */
+typedef uint64_t
+sb_user_counters_t[SB_ALIGN(SB_USER_COUNTERS_MAX * sizeof(uint64_t),
+                            CK_MD_CACHELINE) / sizeof(uint64_t)];
+
+static sb_user_counters_t *counters;
+static char               *counter_names[SB_USER_COUNTERS_MAX];
+static unsigned int       ncounters;
+
+static sb_histogram_t     histograms[SB_USER_HISTOGRAMS_MAX];
+static char               *histogram_names[SB_USER_HISTOGRAMS_MAX];
+static unsigned int       nhistograms;
+
+/* Protects registration */
+static pthread_mutex_t    register_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Counter values at the last intermediate report and checkpoint */
+static uint64_t           last_intermediate[SB_USER_COUNTERS_MAX];
+static uint64_t           last_checkpoint[SB_USER_COUNTERS_MAX];
+
+static sb_user_stats_t    intermediate_stats;
+static sb_user_stats_t    checkpoint_stats;
+
+
+int sb_user_stats_init(void)
+{
+  counters = sb_alloc_per_thread_array(sizeof(sb_user_counters_t));
+
+  return counters == NULL;
+}
+
+
+bool sb_user_stats_enabled(void)
+{
+  return ck_pr_load_uint(&ncounters) > 0 ||
+    ck_pr_load_uint(&nhistograms) > 0;
+}
+
+
+/* Return the index of a name in an array, or n if it is not found */
+
+static unsigned int find_name(char **names, unsigned int n, const char *name)
+{
+  unsigned int i;
+
+  for (i = 0; i < n; i++)
+    if (!strcmp(names[i], name))
+      break;
+
+  return i;
+}
+
+
+int sb_user_counter_register(const char *name)
+{
+  int id = -1;
+
+  pthread_mutex_lock(&register_mutex);
+
+  const unsigned int i = find_name(counter_names, ncounters, name);
+
+  if (i < ncounters)
+    id = (int) i;
+  else if (ncounters < SB_USER_COUNTERS_MAX &&
+           (counter_names[ncounters] = strdup(name)) != NULL)
+  {
+    id = (int) ncounters;
+    ck_pr_store_uint(&ncounters, ncounters + 1);
+  }
+
+  pthread_mutex_unlock(&register_mutex);
+
+  return id;
+}
+
+
+void sb_user_counter_add(int thread_id, int id, uint64_t val)
+{
+  ck_pr_store_64(&counters[thread_id][id],
+                 ck_pr_load_64(&counters[thread_id][id]) + val);
+}
+
+
+sb_histogram_t *sb_user_histogram_register(const char *name)
+{
+  sb_histogram_t *h = NULL;
+
+  pthread_mutex_lock(&register_mutex);
+
+  const unsigned int i = find_name(histogram_names, nhistograms, name);
+
+  if (i < nhistograms)
+    h = &histograms[i];
+  else if (nhistograms < SB_USER_HISTOGRAMS_MAX &&
+           !oper_histogram_init(&histograms[nhistograms]))
+  {
+    if ((histogram_names[nhistograms] = strdup(name)) == NULL)
+      sb_histogram_done(&histograms[nhistograms]);
+    else
+    {
+      h = &histograms[nhistograms];
+      ck_pr_store_uint(&nhistograms, nhistograms + 1);
+    }
+  }
+
+  pthread_mutex_unlock(&register_mutex);
+
+  return h;
+}
+
+
+const char *sb_user_counter_name(unsigned int id)
+{
+  return counter_names[id];
+}
+
+
+const char *sb_user_histogram_name(unsigned int id)
+{
+  return histogram_names[id];
+}
+
+
+/* Aggregate counters since the values saved in last */
+
+static void agg_counters(sb_user_stats_t *s, uint64_t *last)
+{
+  s->ncounters = ck_pr_load_uint(&ncounters);
+
+  for (unsigned int i = 0; i < s->ncounters; i++)
+  {
+    uint64_t val = 0;
+
+    for (unsigned int t = 0; t < sb_globals.threads; t++)
+      val += ck_pr_load_64(&counters[t][i]);
+
+    s->counters[i] = val - last[i];
+    last[i] = val;
+  }
+}
+
+
+const sb_user_stats_t *sb_user_stats_intermediate(void)
+{
+  sb_user_stats_t *s = &intermediate_stats;
+
+  agg_counters(s, last_intermediate);
+
+  s->nhistograms = ck_pr_load_uint(&nhistograms);
+
+  for (unsigned int i = 0; i < s->nhistograms; i++)
+  {
+    free(s->pcts[i]);
+    s->pcts[i] = sb_histogram_get_pct_intermediate(&histograms[i],
+                                                   sb_globals.percentiles,
+                                                   sb_globals.npercentiles);
+  }
+
+  return s;
+}
+
+
+const sb_user_stats_t *sb_user_stats_checkpoint(void)
+{
+  sb_user_stats_t *s = &checkpoint_stats;
+
+  agg_counters(s, last_checkpoint);
+
+  s->nhistograms = ck_pr_load_uint(&nhistograms);
+
+  for (unsigned int i = 0; i < s->nhistograms; i++)
+  {
+    free(s->pcts[i]);
+    s->pcts[i] = sb_histogram_get_pct_checkpoint(&histograms[i],
+                                                 sb_globals.percentiles,
+                                                 sb_globals.npercentiles);
+  }
+
+  return s;
+}
+
+
+void sb_user_stats_done(void)
+{
+  for (unsigned int i = 0; i < ncounters; i++)
+    free(counter_names[i]);
+
+  for (unsigned int i = 0; i < nhistograms; i++)
+  {
+    sb_histogram_done(&histograms[i]);
+    free(histogram_names[i]);
+    free(intermediate_stats.pcts[i]);
+    free(checkpoint_stats.pcts[i]);
+  }
+
+  free(counters);
+  counters = NULL;
+  ncounters = 0;
+  nhistograms = 0;
+}
@@ -0,0 +1,92 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  User-defined counters and named histograms registered by scripts with
+  sysbench.counter.new() and sysbench.histogram.named()
+*/
+
+#ifndef SB_USER_STATS_H
+#define SB_USER_STATS_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <inttypes.h>
+#endif
+
+#include <stdbool.h>
+
+#include "sb_histogram.h"
+
+#define SB_USER_COUNTERS_MAX   32
+#define SB_USER_HISTOGRAMS_MAX 16
+
+/* Aggregate values of user statistics for a report */
+typedef struct sb_user_stats
+{
+  unsigned int ncounters;
+  uint64_t     counters[SB_USER_COUNTERS_MAX];
+  unsigned int nhistograms;
+  /* sb_globals.npercentiles values in seconds for each histogram */
+  double       *pcts[SB_USER_HISTOGRAMS_MAX];
+} sb_user_stats_t;
+
+/* Allocate per-thread counters for sb_globals.threads. Returns 0 on success. */
+int sb_user_stats_init(void);
+
+/* Return true if any counters or histograms have been registered */
+bool sb_user_stats_enabled(void);
+
+/*
+  Return the ID of the counter with a given name, registering it on the first
+  call. Thread-safe, so all Lua states get the same ID for the same name.
+  Returns -1 if there are too many counters.
+*/
+int sb_user_counter_register(const char *name);
+
+/* Add a value to a counter of a given thread. Exported to Lua via FFI. */
+void sb_user_counter_add(int thread_id, int id, uint64_t val);
+
+/*
+  Return the histogram with a given name, registering it on the first call.
+  Thread-safe. Returns NULL if there are too many histograms.
+*/
+sb_histogram_t *sb_user_histogram_register(const char *name);
+
+const char *sb_user_counter_name(unsigned int id);
+const char *sb_user_histogram_name(unsigned int id);
+
+/*
+  Return user statistics since the last intermediate report. Must be called
+  from a single thread, the returned values are valid until the next call.
+*/
+const sb_user_stats_t *sb_user_stats_intermediate(void);
+
+/*
+  Return user statistics since the last checkpoint and reset them. Must be
+  called from a single thread, the returned values are valid until the next
+  call.
+*/
+const sb_user_stats_t *sb_user_stats_checkpoint(void);
+
+void sb_user_stats_done(void);
+
+#endif /* SB_USER_STATS_H */
@@ -0,0 +1,220 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Universal Scalability Law fitting. N / X(N) is a quadratic polynomial in N:
+
+    N / X(N) = a + b * (N - 1) + c * N * (N - 1)
+
+  with a = 1 / lambda, b = sigma / lambda and c = kappa / lambda, so the
+  coefficients are found with linear least squares. Residuals of N / X are
+  weighted by (X^2 / N)^2 to approximate least squares of the throughput
+  itself. Negative coefficients are not physical, so models with sigma and/or
+  kappa fixed at 0 are fitted as well, and the valid one with the smallest
+  squared throughput error is chosen.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_MATH_H
+# include <math.h>
+#endif
+
+#include "sb_usl.h"
+
+/* Maximum number of fitted coefficients */
+#define NCOEF 3
+
+
+double sb_usl_predict(const sb_usl_t *usl, double n)
+{
+  return usl->lambda * n /
+    (1 + usl->sigma * (n - 1) + usl->kappa * n * (n - 1));
+}
+
+
+/*
+  Solve a k x k linear system m * v = y in place with Gaussian elimination.
+  Returns 1 if the system is singular.
+*/
+
+static int solve(double m[NCOEF][NCOEF], double *y, unsigned int k)
+{
+  for (unsigned int i = 0; i < k; i++)
+  {
+    unsigned int p = i;
+
+    for (unsigned int j = i + 1; j < k; j++)
+      if (fabs(m[j][i]) > fabs(m[p][i]))
+        p = j;
+
+    if (fabs(m[p][i]) < 1e-300)
+      return 1;
+
+    for (unsigned int j = 0; j < k; j++)
+    {
+      const double t = m[i][j];
+
+      m[i][j] = m[p][j];
+      m[p][j] = t;
+    }
+
+    const double t = y[i];
+
+    y[i] = y[p];
+    y[p] = t;
+
+    for (unsigned int j = i + 1; j < k; j++)
+    {
+      const double f = m[j][i] / m[i][i];
+
+      for (unsigned int l = i; l < k; l++)
+        m[j][l] -= f * m[i][l];
+      y[j] -= f * y[i];
+    }
+  }
+
+  for (unsigned int i = k; i-- > 0;)
+  {
+    for (unsigned int j = i + 1; j < k; j++)
+      y[i] -= m[i][j] * y[j];
+    y[i] /= m[i][i];
+  }
+
+  return 0;
+}
+
+
+/*
+  Fit a model with sigma and/or kappa fixed at 0 unless use_sigma/use_kappa
+  are set. Returns 1 if there is no valid fit.
+*/
+
+static int fit_model(const double *n, const double *x, unsigned int count,
+                     int use_sigma, int use_kappa, sb_usl_t *usl)
+{
+  double       m[NCOEF][NCOEF] = { { 0 } };
+  double       y[NCOEF] = { 0 };
+  const int    use[NCOEF] = { 1, use_sigma, use_kappa };
+  unsigned int k = 0;
+
+  for (unsigned int i = 0; i < count; i++)
+  {
+    const double all[NCOEF] = { 1, n[i] - 1, n[i] * (n[i] - 1) };
+    const double w = (x[i] * x[i] / n[i]) * (x[i] * x[i] / n[i]);
+    double       r[NCOEF];
+
+    k = 0;
+    for (unsigned int j = 0; j < NCOEF; j++)
+      if (use[j])
+        r[k++] = all[j];
+
+    for (unsigned int j = 0; j < k; j++)
+    {
+      for (unsigned int l = 0; l < k; l++)
+        m[j][l] += w * r[j] * r[l];
+      y[j] += w * r[j] * n[i] / x[i];
+    }
+  }
+
+  if (count < k || solve(m, y, k))
+    return 1;
+
+  const double a = y[0];
+  const double b = use_sigma ? y[1] : 0;
+  const double c = use_kappa ? y[k - 1] : 0;
+
+  if (a <= 0 || b < 0 || c < 0)
+    return 1;
+
+  usl->lambda = 1 / a;
+  usl->sigma = b / a;
+  usl->kappa = c / a;
+
+  return 0;
+}
+
+
+int sb_usl_fit(const double *n, const double *x, unsigned int count,
+               sb_usl_t *usl)
+{
+  double best_sse = -1;
+  double mean = 0, sst = 0;
+
+  if (count < SB_USL_MIN_POINTS)
+    return 1;
+
+  for (unsigned int i = 0; i < count; i++)
+  {
+    if (n[i] < 1 || x[i] <= 0)
+      return 1;
+    mean += x[i] / count;
+  }
+
+  for (unsigned int i = 0; i < count; i++)
+    sst += (x[i] - mean) * (x[i] - mean);
+
+  for (int mask = 0; mask < 4; mask++)
+  {
+    sb_usl_t model;
+    double   sse = 0;
+
+    if (fit_model(n, x, count, mask & 1, mask & 2, &model))
+      continue;
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+      const double e = x[i] - sb_usl_predict(&model, n[i]);
+
+      sse += e * e;
+    }
+
+    if (best_sse < 0 || sse < best_sse)
+    {
+      best_sse = sse;
+      *usl = model;
+    }
+  }
+
+  if (best_sse < 0)
+    return 1;
+
+  usl->r2 = sst > 0 ? 1 - best_sse / sst : 1;
+
+  /*
+    With coherency delays throughput peaks at sqrt((1 - sigma) / kappa),
+    otherwise it approaches lambda / sigma, or grows linearly without
+    contention
+  */
+  if (usl->kappa > 0)
+  {
+    usl->peak_n = usl->sigma < 1 ? sqrt((1 - usl->sigma) / usl->kappa) : 1;
+    if (usl->peak_n < 1)
+      usl->peak_n = 1;
+    usl->peak_x = sb_usl_predict(usl, usl->peak_n);
+  }
+  else
+  {
+    usl->peak_n = 0;
+    usl->peak_x = usl->sigma > 0 ? usl->lambda / usl->sigma : 0;
+  }
+
+  return 0;
+}
@@ -0,0 +1,56 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Universal Scalability Law fitting for thread sweeps, see --threads */
+
+#ifndef SB_USL_H
+#define SB_USL_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+/* Minimum number of distinct concurrency levels to fit the model to */
+#define SB_USL_MIN_POINTS 3
+
+/*
+  Coefficients of the model X(N) = lambda * N / (1 + sigma * (N - 1) +
+  kappa * N * (N - 1)), where X(N) is the throughput at concurrency N
+*/
+typedef struct
+{
+  double lambda;        /* throughput of a single thread */
+  double sigma;         /* contention (serialization) coefficient */
+  double kappa;         /* coherency (crosstalk) coefficient */
+  double r2;            /* coefficient of determination of the fit */
+  double peak_n;        /* concurrency of the maximum throughput, or 0 */
+  double peak_x;        /* maximum or asymptotic throughput, or 0 */
+} sb_usl_t;
+
+/*
+  Fit the model to throughput x[i] measured at concurrency n[i] for 'count'
+  points. Coefficients are non-negative. Returns 0 on success, or 1 if there
+  are too few points or no valid fit.
+*/
+int sb_usl_fit(const double *n, const double *x, unsigned int count,
+               sb_usl_t *usl);
+
+/* Return the throughput predicted by a fitted model at concurrency n */
+double sb_usl_predict(const sb_usl_t *usl, double n);
+
+#endif /* SB_USL_H */
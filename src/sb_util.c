@@ -29,6 +29,29 @@
 # include <unistd.h>
 #endif
 
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+
+#ifdef HAVE_SYS_SOCKET_H
+# include <sys/socket.h>
+#endif
+#ifdef HAVE_NETDB_H
+# include <netdb.h>
+#endif
+
+#include <string.h>
+
+/* Page size flags for MAP_HUGETLB, not all libc headers define them */
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+# ifndef MAP_HUGE_2MB
+#  define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+# endif
+# ifndef MAP_HUGE_1GB
+#  define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+# endif
+#endif
+
 #include "sb_util.h"
 #include "sb_logger.h"
 
@@ -68,3 +91,213 @@ size_t sb_getpagesize(void)
   return getpagesize();
 #endif
 }
+
+/* Get the number of online CPUs, 1 if unknown */
+
+unsigned int sb_nprocs(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+  const long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return n > 0 ? (unsigned int) n : 1;
+#else
+  return 1;
+#endif
+}
+
+/* Convert a page type name to sb_pages_t */
+
+int sb_parse_pages(const char *name, sb_pages_t *pages)
+{
+  if (!strcmp(name, "default"))
+    *pages = SB_PAGES_DEFAULT;
+  else if (!strcmp(name, "thp"))
+    *pages = SB_PAGES_THP;
+  else if (!strcmp(name, "2m"))
+    *pages = SB_PAGES_HUGE_2M;
+  else if (!strcmp(name, "1g"))
+    *pages = SB_PAGES_HUGE_1G;
+  else
+    return 1;
+
+  return 0;
+}
+
+/* Size of pages of a given type */
+
+size_t sb_pages_size(sb_pages_t pages)
+{
+  switch (pages) {
+  case SB_PAGES_THP:
+  case SB_PAGES_HUGE_2M:
+    return 2UL * 1024 * 1024;
+  case SB_PAGES_HUGE_1G:
+    return 1024UL * 1024 * 1024;
+  default:
+    return sb_getpagesize();
+  }
+}
+
+/*
+  Allocate a buffer backed by pages of a given type with mmap(). Transparent
+  huge pages require a 2 MiB-aligned region and must be requested with
+  madvise() before the memory is touched, so such buffers are pre-faulted
+  manually rather than with MAP_POPULATE.
+*/
+
+void *sb_alloc_pages(size_t size, sb_pages_t pages, bool populate)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(MAP_ANONYMOUS)
+  const size_t align = sb_pages_size(pages);
+  int          flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  size_t       len;
+  char         *buf;
+
+  size = SB_ALIGN(size, align);
+  len = size;
+
+  switch (pages) {
+  case SB_PAGES_DEFAULT:
+    break;
+
+  case SB_PAGES_THP:
+# ifdef MADV_HUGEPAGE
+    /* Over-allocate to align the start address, then trim */
+    len = size + align;
+    break;
+# else
+    log_text(LOG_FATAL, "Transparent huge pages are not supported on this "
+             "platform");
+    return NULL;
+# endif
+
+  case SB_PAGES_HUGE_2M:
+  case SB_PAGES_HUGE_1G:
+# if defined(MAP_HUGETLB) && defined(MAP_HUGE_2MB) && defined(MAP_HUGE_1GB)
+    flags |= MAP_HUGETLB |
+      (pages == SB_PAGES_HUGE_2M ? MAP_HUGE_2MB : MAP_HUGE_1GB);
+    break;
+# else
+    log_text(LOG_FATAL, "Explicit huge pages are not supported on this "
+             "platform");
+    return NULL;
+# endif
+  }
+
+# ifdef MAP_POPULATE
+  if (populate && pages != SB_PAGES_THP)
+    flags |= MAP_POPULATE;
+# endif
+
+  buf = mmap(NULL, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (buf == MAP_FAILED)
+  {
+    log_errno(LOG_FATAL, "mmap() of %zu bytes failed%s", len,
+              pages == SB_PAGES_HUGE_2M || pages == SB_PAGES_HUGE_1G ?
+              ", check that the HugeTLB pool has enough free pages of the "
+              "requested size" : "");
+    return NULL;
+  }
+
+# ifdef MADV_HUGEPAGE
+  if (pages == SB_PAGES_THP)
+  {
+    char * const start = (char *) SB_ALIGN((uintptr_t) buf, align);
+
+    if (start > buf)
+      munmap(buf, start - buf);
+    if (start + size < buf + len)
+      munmap(start + size, buf + len - (start + size));
+    buf = start;
+
+    if (madvise(buf, size, MADV_HUGEPAGE))
+    {
+      log_errno(LOG_FATAL, "madvise(MADV_HUGEPAGE) failed");
+      munmap(buf, size);
+      return NULL;
+    }
+  }
+# endif
+
+  /* Touch each page if MAP_POPULATE was not used or is not available */
+# ifdef MAP_POPULATE
+  if (populate && pages == SB_PAGES_THP)
+# else
+  if (populate)
+# endif
+  {
+    const size_t pagesize = sb_getpagesize();
+
+    for (size_t i = 0; i < size; i += pagesize)
+      buf[i] = 0;
+  }
+
+  return buf;
+#else
+  (void) size; /* unused */
+  (void) pages; /* unused */
+  (void) populate; /* unused */
+
+  log_text(LOG_FATAL, "mmap()-based buffer allocation is not supported on "
+           "this platform");
+
+  return NULL;
+#endif
+}
+
+/* Free a buffer allocated with sb_alloc_pages() */
+
+void sb_free_pages(void *buf, size_t size, sb_pages_t pages)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(MAP_ANONYMOUS)
+  munmap(buf, SB_ALIGN(size, sb_pages_size(pages)));
+#else
+  (void) buf; /* unused */
+  (void) size; /* unused */
+  (void) pages; /* unused */
+#endif
+}
+
+
+int sb_resolve_addr(const char *addr, bool passive, struct addrinfo **res)
+{
+  struct addrinfo hints;
+  char            *buf = strdup(addr);
+  char            *host;
+  char            *port;
+  char            *p;
+  int             rc;
+
+  p = strrchr(buf, ':');
+  if (p == NULL)
+  {
+    host = NULL;
+    port = buf;
+  }
+  else
+  {
+    *p = '\0';
+    host = buf;
+    port = p + 1;
+
+    if (*host == '[' && p > host + 1 && p[-1] == ']')
+    {
+      host++;
+      p[-1] = '\0';
+    }
+
+    if (*host == '\0')
+      host = NULL;
+  }
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+  rc = getaddrinfo(host, port, &hints, res);
+
+  free(buf);
+
+  return rc;
+}
@@ -31,6 +31,8 @@
 # include <unistd.h>
 #endif
 
+#include <stdbool.h>
+
 #include "ck_md.h"
 #include "ck_cc.h"
 
@@ -116,4 +118,45 @@ void *sb_memalign(size_t size, size_t alignment);
 /* Get OS page size */
 size_t sb_getpagesize(void);
 
+/* Get the number of online CPUs, 1 if unknown */
+unsigned int sb_nprocs(void);
+
+/* Page types for buffers allocated with sb_alloc_pages() */
+typedef enum
+{
+  SB_PAGES_DEFAULT,             /* regular pages */
+  SB_PAGES_THP,                 /* transparent huge pages */
+  SB_PAGES_HUGE_2M,             /* explicit 2 MiB HugeTLB pages */
+  SB_PAGES_HUGE_1G              /* explicit 1 GiB HugeTLB pages */
+} sb_pages_t;
+
+/*
+  Convert a page type name {default,thp,2m,1g} to sb_pages_t. Returns 0 on
+  success.
+*/
+int sb_parse_pages(const char *name, sb_pages_t *pages);
+
+/* Size of pages of a given type, i.e. alignment of buffers */
+size_t sb_pages_size(sb_pages_t pages);
+
+/*
+  Allocate an anonymous memory buffer backed by pages of a given type and
+  optionally pre-fault it. The size is rounded up to sb_pages_size(). Returns
+  NULL and logs the error on failure.
+*/
+void *sb_alloc_pages(size_t size, sb_pages_t pages, bool populate);
+
+/* Free a buffer allocated with sb_alloc_pages() */
+void sb_free_pages(void *buf, size_t size, sb_pages_t pages);
+
+struct addrinfo;
+
+/*
+  Resolve a TCP address in the [host:]port format with getaddrinfo(). The host
+  part may be enclosed in square brackets for IPv6 addresses. With 'passive',
+  a missing host means all local addresses. Returns the getaddrinfo() error
+  code, i.e. 0 on success.
+*/
+int sb_resolve_addr(const char *addr, bool passive, struct addrinfo **res);
+
 #endif /* SB_UTIL_H */
@@ -63,6 +63,9 @@
 #ifdef HAVE_LIMITS_H
 # include <limits.h>
 #endif
+#ifdef HAVE_MALLOC_H
+# include <malloc.h>
+#endif
 
 #include <luajit.h>
 
@@ -70,9 +73,37 @@
 #include "sb_options.h"
 #include "sb_lua.h"
 #include "db_driver.h"
+#include "db_waits.h"
+#include "db_outage.h"
 #include "sb_rand.h"
 #include "sb_thread.h"
 #include "sb_barrier.h"
+#include "sb_cluster.h"
+#include "sb_affinity.h"
+#include "sb_usage.h"
+#include "sb_pressure.h"
+#include "sb_energy.h"
+#include "sb_cpufreq.h"
+#include "sb_smt.h"
+#include "sb_plugin.h"
+#include "sb_oltp.h"
+#include "sb_rate.h"
+#include "sb_profile.h"
+#include "sb_control.h"
+#include "sb_groups.h"
+#include "sb_metrics.h"
+#include "sb_thread_stats.h"
+#include "sb_latency_log.h"
+#include "sb_slow_log.h"
+#include "sb_usl.h"
+#include "sb_sched.h"
+#include "sb_tracectx.h"
+#include "sb_histogram_log.h"
+#include "sb_trace.h"
+#include "sb_user_stats.h"
+#include "sb_shared.h"
+#include "sb_result.h"
+#include "sb_scenario.h"
 
 #include "ck_cc.h"
 #include "ck_ring.h"
@@ -80,7 +111,6 @@
 #define VERSION_STRING PACKAGE" "PACKAGE_VERSION SB_GIT_SHA
 
 /* Maximum queue length for the tx-rate mode. Must be a power of 2 */
-#define MAX_QUEUE_LEN 131072
 
 /*
   Extra thread ID assigned to background threads. This may be used as an index
@@ -91,26 +121,239 @@
 /* General options */
 sb_arg_t general_args[] =
 {
-  SB_OPT("threads", "number of threads to use", "1", INT),
+  SB_OPT("threads", "number of threads to use. A comma-separated list of "
+         "thread counts or 'sweep:MIN..MAX' (doubling from MIN up to MAX) "
+         "runs the test at each concurrency level in turn", "1", INT),
+  SB_OPT("thread-groups", "comma-separated list of worker thread groups "
+         "running different scripts at different rates in one run, in the "
+         "form THREADS[@RATE][:SCRIPT], e.g. 64@40000:oltp_point_select,"
+         "8:oltp_write_only. Groups without SCRIPT run the main script or "
+         "test, and those without RATE are not throttled. Latency and "
+         "throughput are also reported per group. Replaces --threads", "",
+         LIST),
   SB_OPT("events", "limit for total number of events", "0", INT),
   SB_OPT("time", "limit for total execution time in seconds", "10", INT),
+  SB_OPT("repeat", "run the test this many times in one process and report "
+         "the mean, standard deviation and 95% confidence interval of "
+         "throughput and latency percentiles across runs", "1", INT),
+  SB_OPT("cooldown", "seconds to sleep between runs with --repeat", "0", INT),
+  SB_OPT("scenario", "file with a sequence of steps executed by the 'run' "
+         "command in one process, one per line as COMMAND [--option=value "
+         "...], where COMMAND is prepare, warmup, run, cleanup or a custom "
+         "command. Worker threads keep their Lua states and connections "
+         "between steps", NULL, STRING),
+  SB_OPT("save-result", "save the cumulative statistics, the latency "
+         "histogram and all options to this file in JSON for later "
+         "comparisons with --compare-to", NULL, STRING),
+  SB_OPT("compare-to", "compare the cumulative statistics to a result saved "
+         "with --save-result and exit with an error if any of the "
+         "--compare-*-threshold values is exceeded", NULL, STRING),
+  SB_OPT("compare-tps-threshold", "maximum drop of events/s in percent "
+         "allowed by --compare-to (0 - don't check)", "5", DOUBLE),
+  SB_OPT("compare-latency-threshold", "maximum increase of each --percentile "
+         "latency in percent allowed by --compare-to (0 - don't check)", "10",
+         DOUBLE),
+  SB_OPT("compare-dist-threshold", "maximum shift of the latency distribution "
+         "towards higher latencies allowed by --compare-to, as the largest "
+         "difference between the cumulative distribution functions (one-sided "
+         "Kolmogorov-Smirnov statistic D+, 0..1), if it is also significant at "
+         "the 1% level (0 - don't check)", "0.1", DOUBLE),
   SB_OPT("warmup-time", "execute events for this many seconds with statistics "
          "disabled before the actual benchmark run with statistics enabled",
          "0", INT),
+  SB_OPT("warmup-steady-state", "after --warmup-time, continue the warmup "
+         "until events/s over the last --warmup-window seconds stay within "
+         "this percentage of their average, and their linear trend changes "
+         "them by at most half of it (0 - don't wait for a steady state)",
+         "0", DOUBLE),
+  SB_OPT("warmup-window", "number of one-second throughput samples checked "
+         "by --warmup-steady-state", "5", INT),
+  SB_OPT("warmup-max-time", "maximum warmup time in seconds with "
+         "--warmup-steady-state. The benchmark starts anyway with a warning "
+         "when it is reached", "600", INT),
+  SB_OPT("stop-ci", "stop the benchmark before --time once the 95% "
+         "confidence interval of mean events/s, estimated from one-second "
+         "samples with the batch means method, is within this percentage of "
+         "the mean (0 - run for --time)", "0", DOUBLE),
+  SB_OPT("stop-min-time", "minimum benchmark time in seconds before "
+         "stopping with --stop-ci", "10", INT),
   SB_OPT("forced-shutdown",
          "number of seconds to wait after the --time limit before forcing "
          "shutdown, or 'off' to disable", "off", STRING),
   SB_OPT("thread-stack-size", "size of stack per thread", "64K", SIZE),
+  SB_OPT("worker-memory", "report memory used by each worker thread once all "
+         "of them are initialized: Lua heap, thread stack and C heap, which "
+         "is mostly database driver connections", "off", BOOL),
+  SB_OPT("lean-workers", "reduce memory used by each worker thread to host "
+         "more of them: strip debug info from Lua bytecode (error messages "
+         "then have no line numbers), collect Lua garbage after thread_init() "
+         "and use smaller database driver caches and buffers", "off", BOOL),
   SB_OPT("thread-init-timeout", "wait time in seconds for worker threads to initialize", "30", INT),
+  SB_OPT("thread-affinity", "bind worker threads to CPUs. Possible values: "
+         "off, compact (fill one NUMA node first), scatter (round-robin across "
+         "NUMA nodes), numa:LIST (NUMA nodes), cpus:LIST (CPUs), where LIST is "
+         "a list of numbers or ranges like 0-3,8", "off", STRING),
+  SB_OPT("thread-sched", "scheduling policy of worker threads: other[:NICE], "
+         "batch[:NICE], idle, fifo:PRIORITY or rr:PRIORITY. A single value "
+         "applies to all worker threads, a list to each --thread-groups group "
+         "in turn, where '-' leaves a group unchanged. CPU time used by each "
+         "group is reported", "", LIST),
+  SB_OPT("thread-cgroup", "cgroup v2 threaded cgroup to place worker threads "
+         "in, as NAME[:WEIGHT[:CPUS]], where WEIGHT sets cpu.weight and CPUS "
+         "sets cpuset.cpus with ranges joined by '+', e.g. oltp:200:0-3+8. "
+         "A single value applies to all worker threads, a list to each "
+         "--thread-groups group in turn, where '-' leaves a group in place. "
+         "CPU time used by each group is reported", "", LIST),
+  SB_OPT("thread-cgroup-root", "directory to create --thread-cgroup cgroups "
+         "in [default: the cgroup of sysbench]", NULL, STRING),
+  SB_OPT("event-batch", "number of events to claim and time at once in "
+         "built-in tests. Latency statistics are then sampled once per batch "
+         "using the average event latency in the batch. Ignored with --rate",
+         "1", INT),
+  SB_OPT("virtual-users", "number of virtual users per worker thread in Lua "
+         "scripts. Each one runs events in its own coroutine, and waits for "
+         "queries executed with sql_connection:query() and for "
+         "sysbench.sleep() without blocking other virtual users. Requires a "
+         "driver supporting asynchronous queries to overlap queries", "1", INT),
+  SB_OPT("think-time", "mean think time in milliseconds between the end of "
+         "an event and the start of the next one in each worker thread or "
+         "virtual user. Cycle times, i.e. latencies plus think times, are "
+         "then reported separately. 0 disables think time", "0", DOUBLE),
+  SB_OPT("think-time-type", "distribution of think times: fixed, exponential "
+         "or uniform (between 0 and twice the mean)", "exponential", STRING),
+  SB_OPT("duty-cycle", "percentage of each --duty-period during which "
+         "worker threads run events. They sleep for the rest of it, so e.g. "
+         "--test=cpu --duty-cycle=30 keeps each thread's CPU 30% busy as "
+         "background load. 100 disables it", "100", INT),
+  SB_OPT("duty-period", "length of a --duty-cycle period in milliseconds",
+         "100", INT),
   SB_OPT("rate", "average transactions rate. 0 for unlimited rate", "0", INT),
+  SB_OPT("rate-mode", "how events are scheduled with --rate: 'generator' to "
+         "queue all of them from a single event generation thread, 'worker' "
+         "for each worker thread to schedule its own share of the rate. The "
+         "latter scales to higher rates and has no polling delays",
+         "generator", STRING),
+  SB_OPT("rate-model", "arrival process with --rate {poisson, constant, "
+         "onoff, mmpp, schedule}: exponential intervals, evenly spaced "
+         "events, bursts at --rate-burst-factor times the rate separated by "
+         "silence, bursts alternating with periods at the rate divided by "
+         "--rate-burst-factor, or per-second rates from "
+         "--rate-schedule-file", "poisson", STRING),
+  SB_OPT("rate-burst-factor", "ratio of the event rate in bursts to --rate "
+         "with --rate-model=onoff or mmpp", "10", DOUBLE),
+  SB_OPT("rate-burst-time", "average duration of bursts in milliseconds with "
+         "--rate-model=onoff or mmpp", "100", DOUBLE),
+  SB_OPT("rate-schedule-file", "file with a rate for each second, one per "
+         "line, for --rate-model=schedule. Replaces --rate, the schedule is "
+         "repeated for longer runs", NULL, STRING),
+  SB_OPT("rate-queue-size", "capacity of the event queue with "
+         "--rate-mode=generator, rounded up to a power of 2", "131072", INT),
+  SB_OPT("rate-queue-full", "what to do when the event queue is full with "
+         "--rate-mode=generator: 'terminate' the test, 'drop' new events and "
+         "count them, or 'grow' the queue by keeping new events in an "
+         "overflow buffer until there is room", "terminate", STRING),
+  SB_OPT("profile", "comma-separated list of load phases changing the target "
+         "rate and the number of active threads over the run, in the form "
+         "TYPE[:RATES]/DURATION[@THREADS]. TYPE is hold, step or spike with a "
+         "single rate, ramp with a linear change between two rates (e.g. "
+         "ramp:0-5000/60s) or diurnal with a sine cycle between two rates. "
+         "Phases without rates run at --rate. Replaces --time, and statistics "
+         "are reported and reset at the end of each phase", "", LIST),
+  SB_OPT("slo-latency", "search for the highest --rate meeting a latency SLO "
+         "of this many milliseconds at --slo-percentile without queue growth. "
+         "Short probes at different rates run within a single test, starting "
+         "at --rate. Replaces --time. 0 disables the search", "0", DOUBLE),
+  SB_OPT("slo-percentile", "latency percentile checked by --slo-latency",
+         "99", DOUBLE),
+  SB_OPT("slo-probe-time", "duration of each --slo-latency probe in seconds",
+         "10", INT),
+  SB_OPT("slo-precision", "stop the --slo-latency search when the highest "
+         "passing and the lowest failing rates are within this percentage",
+         "5", DOUBLE),
+  SB_OPT("slo-max-probes", "maximum number of --slo-latency probes", "20",
+         INT),
+  SB_OPT("control-socket", "listen for commands changing the running test on "
+         "a Unix socket at this path, one per line: 'rate N' to set the "
+         "target rate with --rate, 'threads N' to limit the number of active "
+         "worker threads, 'pause', 'resume', 'checkpoint' to report and reset "
+         "statistics, 'stop' to end the test, and 'status'", NULL, STRING),
+  SB_OPT("metrics-listen", "serve counters and the latency histogram in the "
+         "Prometheus text format over HTTP at /metrics on this [HOST:]PORT",
+         NULL, STRING),
+  SB_OPT("latency-sample-rate", "time only every Nth event in each thread for "
+         "latency statistics. Event counters are still exact", "1", INT),
+  SB_OPT("latency-log", "write the completion time, thread, type, latency "
+         "and queueing time of every timed event to this binary file. Use "
+         "--latency-log-csv to convert it", NULL, STRING),
+  SB_OPT("latency-log-csv", "convert the specified --latency-log file to CSV "
+         "on the standard output and exit", NULL, STRING),
+  SB_OPT("trace-sample-pct", "percentage of events to trace. Each SQL "
+         "statement of a traced event is prefixed with a W3C traceparent "
+         "comment carrying the event trace ID and a statement span ID",
+         "0", DOUBLE),
+  SB_OPT("trace-log", "write the client-side timings of traced events and "
+         "their statements to this file, one JSON object per line", NULL,
+         STRING),
+  SB_OPT("slow-event-threshold", "write the statements with bound values, "
+         "their latencies, servers and errors, and retries of every event "
+         "taking at least this many milliseconds to --slow-event-log. 0 "
+         "disables capturing", "0", DOUBLE),
+  SB_OPT("slow-event-log", "file to write events slower than "
+         "--slow-event-threshold to", NULL, STRING),
+  SB_OPT("histogram-log", "append the full latency histogram of every "
+         "intermediate and checkpoint report to this file, one JSON object "
+         "per line", NULL, STRING),
+  SB_OPT("intended-latency", "with --rate, also report latency measured from "
+         "the intended (scheduled) start time of each event to its completion. "
+         "Regular latency statistics then only include the event execution "
+         "time", "off", BOOL),
+  SB_OPT("client-stats", "report CPU usage of sysbench itself and the share "
+         "of worker thread time spent in Lua/test code, in database driver "
+         "calls and waiting off CPU", "off", BOOL),
+  SB_OPT("host-pressure", "sample PSI stall time, cgroup CPU quota throttling "
+         "and steal time of the host with each report and warn if sysbench "
+         "was throttled or CPU time was stolen", "off", BOOL),
+  SB_OPT("energy", "sample RAPL package and DRAM energy counters and report "
+         "average power with each report, and energy per event and events "
+         "per joule for the whole run", "off", BOOL),
+  SB_OPT("energy-path", "powercap sysfs directory with RAPL domains for "
+         "--energy", "/sys/class/powercap", STRING),
+  SB_OPT("cpu-freq", "sample frequency and thermal throttle events of CPUs "
+         "worker threads run on and report them with each report and for the "
+         "whole run, warn if CPUs were throttled or the frequency varied",
+         "off", BOOL),
+  SB_OPT("cpu-freq-path", "sysfs directory with CPU frequencies for "
+         "--cpu-freq", "/sys/devices/system/cpu", STRING),
+  SB_OPT("smt-compare", "run worker threads on separate physical cores for "
+         "the first half of --time and in pairs on SMT siblings of the same "
+         "core for the second half, e.g. with the cpu or memory tests, and "
+         "report per-thread throughput of both placements and the SMT yield. "
+         "Requires an even number of threads", "off", BOOL),
+  SB_OPT("perf-counters", "collect hardware performance counters (cycles, "
+         "instructions, LLC, branch and dTLB misses) in worker threads with "
+         "perf_event_open() and report them per event and per second",
+         "off", BOOL),
   SB_OPT("report-interval", "periodically report intermediate statistics with "
-         "a specified interval in seconds. 0 disables intermediate reports",
-         "0", INT),
+         "a specified interval in seconds, which may be fractional or given in "
+         "milliseconds with the 'ms' suffix, e.g. 0.5 or 100ms. 0 disables "
+         "intermediate reports", "0", STRING),
   SB_OPT("report-checkpoints", "dump full statistics and reset all counters at "
          "specified points in time. The argument is a list of comma-separated "
          "values representing the amount of time in seconds elapsed from start "
          "of test when report checkpoint(s) must be performed. Report "
          "checkpoints are off by default.", "", LIST),
+  SB_OPT("report-per-thread", "report events, latency and errors of each "
+         "worker thread in intermediate and cumulative reports, and mark "
+         "threads executing less than half of the average number of events "
+         "as stragglers", "off", BOOL),
+  SB_OPT("cluster-listen", "run as a cluster controller accepting agent "
+         "connections on the specified [host:]port. All nodes start the "
+         "benchmark at the same time, the controller reports statistics "
+         "merged from all nodes", NULL, STRING),
+  SB_OPT("cluster-agents", "number of agents the cluster controller waits for "
+         "before starting the benchmark", "0", INT),
+  SB_OPT("cluster-connect", "run as a cluster agent streaming statistics to "
+         "the controller at the specified [host:]port", NULL, STRING),
   SB_OPT("debug", "print more debugging info", "off", BOOL),
   SB_OPT("validate", "perform validation checks where possible", "off", BOOL),
   SB_OPT("help", "print help and exit", "off", BOOL),
@@ -119,6 +362,16 @@ sb_arg_t general_args[] =
   SB_OPT("luajit-cmd", "perform LuaJIT control command. This option is "
          "equivalent to 'luajit -j'. See LuaJIT documentation for more "
          "information", NULL, STRING),
+  SB_OPT("lua-profile", "sample Lua functions of the first thread with the "
+         "LuaJIT profiler and print the hottest ones at the end of the test",
+         "off", BOOL),
+  SB_OPT("lua-trace-aborts", "count LuaJIT trace aborts in all threads by "
+         "location and reason and print them at the end of the test", "off",
+         BOOL),
+  SB_OPT("native", "execute events of the oltp_point_select, oltp_read_only "
+         "and oltp_read_write scripts in C rather than Lua, with the same "
+         "queries. Other commands are still implemented by the scripts",
+         "off", BOOL),
 
   SB_OPT_END
 };
@@ -136,16 +389,90 @@ static sb_barrier_t worker_barrier;
 /* Wait at most this number of seconds for worker threads to initialize */
 static int thread_init_timeout;
 
+/* Report memory used by each worker thread, see --worker-memory */
+static bool   worker_memory;
+/* C heap in use before worker threads are created */
+static size_t worker_heap_start;
+
+/*
+  Worker threads released by worker_barrier wait until start_time, slightly in
+  the future, to start executing events at the same time. start_offsets are the
+  delays of their actual start, see start_wait().
+*/
+static struct timespec start_time;
+static uint64_t        *start_offsets;
+static bool            start_skew_warned;
+
 /* Barrier to signal reporting threads */
 static sb_barrier_t report_barrier;
 
-/* structures to handle queue of events, needed for tx_rate mode */
-static uint64_t           queue_array[MAX_QUEUE_LEN] CK_CC_CACHELINE;
-static ck_ring_buffer_t   queue_ring_buffer[MAX_QUEUE_LEN] CK_CC_CACHELINE;
+/*
+  structures to handle queue of events, needed for tx_rate mode. queue_size is
+  the capacity of the ring, see --rate-queue-size.
+*/
+static uint64_t           *queue_array;
+static ck_ring_buffer_t   *queue_ring_buffer;
 static ck_ring_t          queue_ring CK_CC_CACHELINE;
+static unsigned int       queue_size;
 
 static int queue_is_full CK_CC_CACHELINE;
 
+/* What the event generation thread does when the queue is full */
+typedef enum
+{
+  QUEUE_FULL_TERMINATE,
+  QUEUE_FULL_DROP,
+  QUEUE_FULL_GROW
+} queue_full_policy_t;
+
+static queue_full_policy_t queue_full_policy;
+
+/*
+  Events dropped with --rate-queue-full=drop since the start, and the values
+  at the last intermediate and cumulative reports
+*/
+static uint64_t queue_dropped CK_CC_CACHELINE;
+static uint64_t queue_dropped_intermediate;
+static uint64_t queue_dropped_checkpoint;
+
+/*
+  Enqueue times of events not fitting into the ring with --rate-queue-full=grow.
+  Only accessed by the event generation thread, except for queue_overflow_len
+  read by queue_length().
+*/
+static uint64_t *queue_overflow;
+static size_t   queue_overflow_head;
+static size_t   queue_overflow_size;
+static uint64_t queue_overflow_len CK_CC_CACHELINE;
+
+/* Concurrency levels to run the test at, see --threads */
+#define MAX_THREAD_LEVELS 64
+
+static unsigned int thread_levels[MAX_THREAD_LEVELS];
+static unsigned int n_thread_levels;
+
+/* Events per second from the last cumulative report, used by thread sweeps */
+static double last_run_eps;
+
+/* Events in cumulative reports of the current run, see --energy */
+static uint64_t run_events;
+
+/* Number of runs and the pause between them, see --repeat and --cooldown */
+static unsigned int repeat_runs;
+static unsigned int repeat_cooldown;
+
+/* Is the current run a warmup step of --scenario? */
+static bool scenario_warmup;
+
+/*
+  Latency percentiles in seconds from the last cumulative report, only
+  collected with --repeat and test-specific sweeps
+*/
+static double *last_run_pcts;
+
+/* Average latency in seconds from the last cumulative report */
+static double last_run_lat_avg;
+
 static int report_thread_created CK_CC_CACHELINE;
 static int checkpoints_thread_created;
 static int eventgen_thread_created;
@@ -156,6 +483,92 @@ static sb_timer_t *timers;
 /* Temporary copy of timers for checkpoint reports */
 static sb_timer_t *timers_copy;
 
+/*
+  Per-thread intended (i.e. scheduled by the event generation thread) start
+  times of the current events, used with --intended-latency
+*/
+typedef struct {
+  uint64_t start_ns;
+  char     pad[SB_CACHELINE_PAD(sizeof(uint64_t))];
+} sb_intended_start_t;
+
+static sb_intended_start_t *intended_starts;
+
+/* Schedule events in worker threads rather than the event generator thread */
+static bool rate_per_worker;
+
+/*
+  Per-thread scheduled start times of the current events with
+  --rate-mode=worker. Each thread has an independent Poisson process with its
+  share of --rate, so their superposition has the same distribution as that of
+  the event generator thread.
+*/
+typedef struct {
+  uint64_t next_ns;
+  double   lambda;              /* events per nanosecond, 0 if not throttled */
+  char     pad[SB_CACHELINE_PAD(sizeof(uint64_t) + sizeof(double))];
+} sb_pacing_t;
+
+static sb_pacing_t *pacing;
+
+/* Distributions of --think-time */
+typedef enum
+{
+  THINK_FIXED,
+  THINK_EXPONENTIAL,
+  THINK_UNIFORM
+} think_dist_t;
+
+static think_dist_t think_dist;
+
+/* --duty-cycle period and the running part of it, 0 if disabled */
+static uint64_t duty_period_ns;
+static uint64_t duty_on_ns;
+
+/* Totals since the last checkpoint for the average think and cycle times */
+static uint64_t think_sum_ns CK_CC_CACHELINE;
+static uint64_t cycle_sum_ns;
+static uint64_t cycles;
+
+/* Start time of the current event for its cycle time with --think-time */
+static TLS uint64_t tls_cycle_start_ns;
+
+/* Probes of the --slo-latency search */
+#define SLO_MAX_PROBES 100
+
+typedef struct
+{
+  unsigned int rate;            /* target rate */
+  double       eps;             /* achieved throughput */
+  double       latency;         /* latency at --slo-percentile, ms */
+  int64_t      queue_growth;    /* change of the queue length */
+  bool         pass;
+} sb_slo_probe_t;
+
+static double         slo_latency;
+static double         slo_percentile;
+static unsigned int   slo_probe_time;
+static double         slo_precision;
+static unsigned int   slo_max_probes;
+static sb_slo_probe_t slo_probes[SLO_MAX_PROBES];
+static unsigned int   slo_nprobes;
+static unsigned int   slo_max_rate;     /* highest passing rate */
+static int            slo_thread_created;
+
+/* --stop-ci state */
+static double       stop_ci;
+static unsigned int stop_min_time;
+static double       *stop_rates;        /* one-second throughput samples */
+static unsigned int stop_nrates;
+static double       stop_ci_pct;        /* last confidence interval, % */
+static double       stop_ci_mean;       /* last mean events/s */
+static bool         stop_ci_reached;
+static int          stop_thread_created;
+
+/* State changed from --control-socket */
+static int          control_paused;
+static unsigned int control_threads;    /* active threads limit, 0 for none */
+
 /* Global execution timer */
 sb_timer_t      sb_exec_timer CK_CC_CACHELINE;
 
@@ -165,9 +578,15 @@ sb_timer_t sb_checkpoint_timer   CK_CC_CACHELINE;
 
 TLS int sb_tls_thread_id;
 
+/* Latency sampling state for the current thread, see --latency-sample-rate */
+static TLS unsigned int tls_events_not_timed;
+static TLS bool         tls_event_timed;
+
 static void print_header(void);
 static void print_help(void);
 static void print_run_mode(sb_test_t *);
+static void check_timer_cost(void);
+static uint64_t queue_length(void);
 
 #ifdef HAVE_ALARM
 static void sigalrm_thread_init_timeout_handler(int sig)
@@ -182,6 +601,33 @@ static void sigalrm_thread_init_timeout_handler(int sig)
   exit(2);
 }
 
+/*
+  Print queue wait percentiles for an intermediate report with --rate, and the
+  number of events dropped in the interval with --rate-queue-full=drop
+*/
+
+void sb_report_queue_intermediate(sb_stat_t *stat)
+{
+  const bool drops = queue_full_policy == QUEUE_FULL_DROP && !rate_per_worker;
+  char       dropped[64] = "";
+
+  if (drops)
+    snprintf(dropped, sizeof(dropped), "dropped: %" PRIu64,
+             stat->queue_dropped);
+
+  if (stat->queue_wait_pcts != NULL)
+  {
+    char *pcts = create_pct_string_intermediate(sb_globals.percentiles,
+                                                stat->queue_wait_pcts,
+                                                sb_globals.npercentiles);
+    log_timestamp(LOG_NOTICE, stat->time_total, "queue wait %s%s", pcts,
+                  dropped);
+    free(pcts);
+  }
+  else if (drops)
+    log_timestamp(LOG_NOTICE, stat->time_total, "queue %s", dropped);
+}
+
 /* Default intermediate reports handler */
 
 void sb_report_intermediate(sb_stat_t *stat)
@@ -192,9 +638,27 @@ void sb_report_intermediate(sb_stat_t *stat)
                 stat->events / stat->time_interval,
                 create_pct_string_intermediate(sb_globals.percentiles, stat->latency_pcts, sb_globals.npercentiles));
   if (sb_globals.tx_rate > 0)
+  {
     log_timestamp(LOG_NOTICE, stat->time_total,
                   "queue length: %" PRIu64 " concurrency: %" PRIu64,
                   stat->queue_length, stat->concurrency);
+    sb_report_queue_intermediate(stat);
+  }
+  if (stat->intended_latency_pcts != NULL)
+  {
+    char *pcts = create_pct_string_intermediate(sb_globals.percentiles,
+                                                stat->intended_latency_pcts,
+                                                sb_globals.npercentiles);
+    log_timestamp(LOG_NOTICE, stat->time_total, "intended %s", pcts);
+    free(pcts);
+  }
+
+  if (sb_groups_enabled())
+    sb_groups_report_intermediate(stat->time_total, stat->time_interval);
+
+  if (sb_thread_stats_enabled())
+    sb_thread_stats_report_intermediate(stat->time_total,
+                                        stat->time_interval);
 }
 
 
@@ -202,7 +666,8 @@ static void report_get_common_stat(sb_stat_t *stat, sb_counters_t cnt)
 {
   memset(stat, 0, sizeof(sb_stat_t));
 
-  stat->threads_running = sb_globals.threads_running;
+  stat->threads_running = sb_globals.threads_running +
+    sb_cluster_threads_running();
 
   stat->events =        cnt[SB_CNT_EVENT];
   stat->reads =         cnt[SB_CNT_READ];
@@ -212,9 +677,39 @@ static void report_get_common_stat(sb_stat_t *stat, sb_counters_t cnt)
   stat->reconnects =    cnt[SB_CNT_RECONNECT];
   stat->bytes_read =    cnt[SB_CNT_BYTES_READ];
   stat->bytes_written = cnt[SB_CNT_BYTES_WRITTEN];
+  stat->net_sent =      cnt[SB_CNT_NET_SENT];
+  stat->net_received =  cnt[SB_CNT_NET_RECEIVED];
 
   stat->time_total = NS2SEC(sb_timer_value(&sb_exec_timer)) -
-    sb_globals.warmup_time;
+    sb_globals.warmup_elapsed;
+}
+
+
+/* Print hardware counters per event for an intermediate report */
+
+static void report_perf_intermediate(sb_stat_t *stat)
+{
+  static const char *abbr[SB_PERF_MAX] =
+  {
+    "cycles", "instr", "llc-miss", "br-miss", "dtlb-miss"
+  };
+  char         buf[256];
+  size_t       len = 0;
+  const double events = stat->events > 0 ? stat->events : 1;
+
+  if (sb_perf_available(SB_PERF_CYCLES) &&
+      sb_perf_available(SB_PERF_INSTRUCTIONS))
+    len += snprintf(buf + len, sizeof(buf) - len, " ipc: %.2f",
+                    stat->perf[SB_PERF_CYCLES] > 0 ?
+                    (double) stat->perf[SB_PERF_INSTRUCTIONS] /
+                    stat->perf[SB_PERF_CYCLES] : 0);
+
+  for (int i = 0; i < SB_PERF_MAX; i++)
+    if (sb_perf_available(i))
+      len += snprintf(buf + len, sizeof(buf) - len, " %s/e: %.2f", abbr[i],
+                      stat->perf[i] / events);
+
+  log_timestamp(LOG_NOTICE, stat->time_total, "perf:%s", buf);
 }
 
 
@@ -222,6 +717,7 @@ static void report_intermediate(void)
 {
   sb_stat_t stat;
   sb_counters_t cnt;
+  sb_histogram_snapshot_t *snapshot;
 
   /*
     sb_globals.report_interval may be set to 0 by the master thread to
@@ -230,26 +726,133 @@ static void report_intermediate(void)
   if (ck_pr_load_uint(&sb_globals.report_interval) == 0)
     return;
 
+  /* Let statistics from cluster agents arrive before aggregating them */
+  sb_cluster_wait_reports();
+
   sb_counters_agg_intermediate(cnt);
   report_get_common_stat(&stat, cnt);
 
-  stat.latency_pcts =
-    sb_histogram_get_pct_intermediate(&sb_latency_histogram, sb_globals.percentiles, sb_globals.npercentiles);
+  snapshot = sb_histogram_snapshot_intermediate(&sb_latency_histogram);
+  stat.latency_pcts = sb_histogram_snapshot_get_pct(snapshot,
+                                                    sb_globals.percentiles,
+                                                    sb_globals.npercentiles);
+  sb_cluster_send_report(cnt, snapshot);
 
   stat.time_interval = NS2SEC(sb_timer_current(&sb_intermediate_timer));
 
+  if (sb_histogram_log_enabled())
+    sb_histogram_log_write("interval", stat.time_total, stat.time_interval,
+                           snapshot);
+  free(snapshot);
+
   if (sb_globals.tx_rate > 0)
   {
-    stat.queue_length = ck_ring_size(&queue_ring);
+    const uint64_t dropped = ck_pr_load_64(&queue_dropped);
+
+    stat.queue_length = queue_length();
     stat.concurrency = ck_pr_load_int(&sb_globals.concurrency);
+    stat.queue_dropped = dropped - queue_dropped_intermediate;
+    queue_dropped_intermediate = dropped;
+
+    if (sb_globals.npercentiles > 0)
+      stat.queue_wait_pcts =
+        sb_histogram_get_pct_intermediate(&sb_queue_wait_histogram,
+                                          sb_globals.percentiles,
+                                          sb_globals.npercentiles);
+
+    if (sb_globals.intended_latency)
+      stat.intended_latency_pcts =
+        sb_histogram_get_pct_intermediate(&sb_intended_latency_histogram,
+                                          sb_globals.percentiles,
+                                          sb_globals.npercentiles);
   }
 
+  sb_perf_agg_intermediate(stat.perf);
+
+  if (sb_user_stats_enabled())
+    stat.user = sb_user_stats_intermediate();
+
+  stat.waits = db_waits_intermediate();
+
   if (current_test && current_test->ops.report_intermediate)
     current_test->ops.report_intermediate(&stat);
   else
     sb_report_intermediate(&stat);
 
+  if (sb_perf_enabled())
+    report_perf_intermediate(&stat);
+
+  if (sb_pressure_enabled())
+    sb_pressure_report_intermediate(stat.time_total);
+
+  if (sb_energy_enabled())
+    sb_energy_report_intermediate(stat.time_total, stat.events);
+
+  if (sb_cpufreq_enabled())
+    sb_cpufreq_report_intermediate(stat.time_total);
+
   free(stat.latency_pcts);
+  free(stat.intended_latency_pcts);
+  free(stat.queue_wait_pcts);
+  free(stat.cycle_time_pcts);
+}
+
+/* Print user counters and histograms for a cumulative report */
+
+static void report_user_stats_cumulative(sb_stat_t *stat)
+{
+  const sb_user_stats_t *user = stat->user;
+
+  if (user->ncounters > 0)
+  {
+    log_text(LOG_NOTICE, "Counters:");
+
+    for (unsigned int i = 0; i < user->ncounters; i++)
+    {
+      char name[64];
+
+      snprintf(name, sizeof(name), "%s:", sb_user_counter_name(i));
+      log_text(LOG_NOTICE, "    %-36s %-6" PRIu64 " (%.2f per sec.)", name,
+               user->counters[i], user->counters[i] / stat->time_interval);
+    }
+
+    log_text(LOG_NOTICE, "");
+  }
+
+  for (unsigned int i = 0; i < user->nhistograms; i++)
+  {
+    log_text(LOG_NOTICE, "Histogram %s (ms):", sb_user_histogram_name(i));
+
+    if (sb_globals.npercentiles > 0)
+    {
+      char *pcts = create_pct_string_cumulative(sb_globals.percentiles,
+                                                user->pcts[i],
+                                                sb_globals.npercentiles);
+      log_text(LOG_NOTICE, "%s", pcts);
+      free(pcts);
+    }
+    else
+      log_text(LOG_NOTICE, "         percentile stats:               disabled");
+  }
+}
+
+/*
+  Return the difference between the latest and the earliest actual start of
+  worker threads, see start_wait()
+*/
+
+static uint64_t start_skew(void)
+{
+  uint64_t min = UINT64_MAX;
+  uint64_t max = 0;
+
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+  {
+    min = SB_MIN(min, start_offsets[i]);
+    max = SB_MAX(max, start_offsets[i]);
+  }
+
+  return max > min ? max - min : 0;
 }
 
 /* Default cumulative reports handler */
@@ -295,9 +898,41 @@ void sb_report_cumulative(sb_stat_t *stat)
            stat->time_total);
   log_text(LOG_NOTICE, "    total number of events:              %" PRIu64,
            stat->events);
+  if (sb_globals.tx_rate > 0 && queue_full_policy == QUEUE_FULL_DROP &&
+      !rate_per_worker)
+    log_text(LOG_NOTICE, "    dropped events:                      %" PRIu64,
+             stat->queue_dropped);
 
   log_text(LOG_NOTICE, "");
 
+  if (sb_perf_enabled())
+  {
+    const double events = stat->events > 0 ? stat->events : 1;
+
+    log_text(LOG_NOTICE, "Hardware counters%s:",
+             sb_perf_user_only() ? " (user space only)" : "");
+    log_text(LOG_NOTICE, "    %-20s %15s %14s", "", "per event", "per second");
+
+    for (int i = 0; i < SB_PERF_MAX; i++)
+      if (sb_perf_available(i))
+      {
+        char name[32];
+
+        snprintf(name, sizeof(name), "%s:", sb_perf_name(i));
+        log_text(LOG_NOTICE, "    %-20s %15.2f %14.0f", name,
+                 stat->perf[i] / events, stat->perf[i] / stat->time_interval);
+      }
+
+    if (sb_perf_available(SB_PERF_CYCLES) &&
+        sb_perf_available(SB_PERF_INSTRUCTIONS))
+      log_text(LOG_NOTICE, "    %-20s %15.2f", "IPC:",
+               stat->perf[SB_PERF_CYCLES] > 0 ?
+               (double) stat->perf[SB_PERF_INSTRUCTIONS] /
+               stat->perf[SB_PERF_CYCLES] : 0);
+
+    log_text(LOG_NOTICE, "");
+  }
+
   log_text(LOG_NOTICE, "Latency (ms):");
   log_text(LOG_NOTICE, "         min: %39.2f",
            SEC2MS(stat->latency_min));
@@ -316,21 +951,80 @@ void sb_report_cumulative(sb_stat_t *stat)
            SEC2MS(stat->latency_sum));
   log_text(LOG_NOTICE, "");
 
+  if (stat->intended_latency_pcts != NULL)
+  {
+    char *pcts = create_pct_string_cumulative(sb_globals.percentiles,
+                                              stat->intended_latency_pcts,
+                                              sb_globals.npercentiles);
+    log_text(LOG_NOTICE, "Latency from intended start (ms):");
+    log_text(LOG_NOTICE, "%s", pcts);
+    free(pcts);
+  }
+
+  if (stat->queue_wait_pcts != NULL)
+  {
+    char *pcts = create_pct_string_cumulative(sb_globals.percentiles,
+                                              stat->queue_wait_pcts,
+                                              sb_globals.npercentiles);
+    log_text(LOG_NOTICE, "Queue wait (ms):");
+    log_text(LOG_NOTICE, "%s", pcts);
+    free(pcts);
+  }
+
+  if (sb_globals.think_time > 0)
+  {
+    log_text(LOG_NOTICE, "Think time (ms):");
+    log_text(LOG_NOTICE, "         avg: %39.2f",
+             SEC2MS(stat->think_time_avg));
+    log_text(LOG_NOTICE, "");
+    log_text(LOG_NOTICE, "Cycle time, latency plus think time (ms):");
+    log_text(LOG_NOTICE, "         avg: %39.2f",
+             SEC2MS(stat->cycle_time_avg));
+
+    if (stat->cycle_time_pcts != NULL)
+    {
+      char *pcts = create_pct_string_cumulative(sb_globals.percentiles,
+                                                stat->cycle_time_pcts,
+                                                sb_globals.npercentiles);
+      log_text(LOG_NOTICE, "%s", pcts);
+      free(pcts);
+    }
+    else
+      log_text(LOG_NOTICE, "");
+  }
+
+  if (stat->user != NULL)
+    report_user_stats_cumulative(stat);
+
+  if (sb_groups_enabled())
+    sb_groups_report_cumulative();
+
+  if (sb_thread_stats_enabled())
+    sb_thread_stats_report_cumulative();
+
   /* Aggregate temporary timers copy */
   sb_timer_t t;
   sb_timer_init(&t);
   for(unsigned i = 0; i < nthreads; i++)
     t = sb_timer_merge(&t, &timers_copy[i]);
 
-  /* Calculate and print events distribution by threads */
+  /*
+    Calculate and print events distribution by threads. Use local timers only,
+    as stat->latency_sum also includes cluster agents, if any.
+  */
   const double events_avg = (double) t.events / nthreads;
-  const double time_avg = stat->latency_sum / nthreads;
+  const double time_avg = NS2SEC(sb_timer_sum(&t)) / nthreads;
 
-  double events_stddev = 0;
-  double time_stddev = 0;
+  double   events_stddev = 0;
+  double   time_stddev = 0;
+  uint64_t events_min = UINT64_MAX;
+  uint64_t events_max = 0;
 
   for(unsigned i = 0; i < nthreads; i++)
   {
+    events_min = SB_MIN(events_min, timers_copy[i].events);
+    events_max = SB_MAX(events_max, timers_copy[i].events);
+
     double diff = fabs(events_avg - timers_copy[i].events);
     events_stddev += diff * diff;
 
@@ -345,6 +1039,16 @@ void sb_report_cumulative(sb_stat_t *stat)
            events_avg, events_stddev);
   log_text(LOG_NOTICE, "    execution time (avg/stddev):   %.4f/%3.2f",
            time_avg, time_stddev);
+
+  if (sb_thread_stats_enabled())
+  {
+    log_text(LOG_NOTICE, "    events (min/max):              %" PRIu64 "/%"
+             PRIu64, nthreads > 0 ? events_min : 0, events_max);
+    log_text(LOG_NOTICE, "    stragglers:                    %u",
+             sb_thread_stats_stragglers());
+    log_text(LOG_NOTICE, "    start skew (ms):               %.3f",
+             NS2MS(start_skew()));
+  }
   log_text(LOG_NOTICE, "");
 
   if (sb_globals.debug)
@@ -362,6 +1066,8 @@ void sb_report_cumulative(sb_stat_t *stat)
       log_text(LOG_DEBUG, "                 "
                "total time taken by event execution: %.4fs",
                NS2SEC(sb_timer_sum(&timers_copy[i])));
+      log_text(LOG_DEBUG, "                 "
+               "started late by: %.3fms", NS2MS(start_offsets[i]));
     }
     log_text(LOG_NOTICE, "");
   }
@@ -375,16 +1081,76 @@ static void checkpoint(sb_stat_t *stat)
 
   sb_counters_agg_cumulative(cnt);
   report_get_common_stat(stat, cnt);
+  sb_perf_agg_cumulative(stat->perf);
+
+  if (sb_user_stats_enabled())
+    stat->user = sb_user_stats_checkpoint();
+
+  stat->waits = db_waits_checkpoint();
 
   stat->time_interval = NS2SEC(sb_timer_current(&sb_checkpoint_timer));
 
-  stat->latency_pcts = sb_histogram_get_pct_checkpoint(&sb_latency_histogram,
-                                           sb_globals.percentiles, sb_globals.npercentiles);
+  if (sb_histogram_log_enabled())
+  {
+    stat->latency_histogram =
+      sb_histogram_snapshot_checkpoint(&sb_latency_histogram);
+    stat->latency_pcts = sb_histogram_snapshot_get_pct(stat->latency_histogram,
+                                                       sb_globals.percentiles,
+                                                       sb_globals.npercentiles);
+  }
+  else
+    stat->latency_pcts = sb_histogram_get_pct_checkpoint(&sb_latency_histogram,
+                                             sb_globals.percentiles, sb_globals.npercentiles);
+
+  if (sb_globals.tx_rate > 0 && sb_globals.intended_latency)
+    stat->intended_latency_pcts =
+      sb_histogram_get_pct_checkpoint(&sb_intended_latency_histogram,
+                                      sb_globals.percentiles,
+                                      sb_globals.npercentiles);
+
+  if (sb_globals.tx_rate > 0)
+  {
+    const uint64_t dropped = ck_pr_load_64(&queue_dropped);
+
+    stat->queue_dropped = dropped - queue_dropped_checkpoint;
+    queue_dropped_checkpoint = dropped;
+
+    if (sb_globals.npercentiles > 0)
+      stat->queue_wait_pcts =
+        sb_histogram_get_pct_checkpoint(&sb_queue_wait_histogram,
+                                        sb_globals.percentiles,
+                                        sb_globals.npercentiles);
+  }
+
+  if (sb_globals.think_time > 0)
+  {
+    const uint64_t n = ck_pr_fas_64(&cycles, 0);
+    const uint64_t think_ns = ck_pr_fas_64(&think_sum_ns, 0);
+    const uint64_t cycle_ns = ck_pr_fas_64(&cycle_sum_ns, 0);
+
+    if (n > 0)
+    {
+      stat->think_time_avg = NS2SEC(think_ns) / n;
+      stat->cycle_time_avg = NS2SEC(cycle_ns) / n;
+    }
+
+    if (sb_globals.npercentiles > 0)
+      stat->cycle_time_pcts =
+        sb_histogram_get_pct_checkpoint(&sb_cycle_time_histogram,
+                                        sb_globals.percentiles,
+                                        sb_globals.npercentiles);
+  }
 
   /* Atomically reset each timer after copying it into its timers_copy slot */
   for (size_t i = 0; i < sb_globals.threads; i++)
     sb_timer_checkpoint(&timers[i], &timers_copy[i]);
 
+  if (sb_groups_enabled())
+    sb_groups_checkpoint(timers_copy, stat->time_interval);
+
+  if (sb_thread_stats_enabled())
+    sb_thread_stats_checkpoint(timers_copy, stat->time_interval);
+
 }
 
 static void report_cumulative(void)
@@ -400,18 +1166,51 @@ static void report_cumulative(void)
   for(size_t i = 0; i < sb_globals.threads; i++)
     t = sb_timer_merge(&t, &timers_copy[i]);
 
+  /* Add final timers received from cluster agents, if any */
+  sb_cluster_merge_timer(&t);
+
   /* Calculate aggregate latency values */
   stat.latency_min = NS2SEC(sb_timer_min(&t));
   stat.latency_max = NS2SEC(sb_timer_max(&t));
   stat.latency_avg = NS2SEC(sb_timer_avg(&t));
   stat.latency_sum = NS2SEC(sb_timer_sum(&t));
 
+  last_run_eps = stat.time_interval > 0 ? stat.events / stat.time_interval : 0;
+  last_run_lat_avg = stat.events > 0 ? stat.latency_sum / stat.events : 0;
+  run_events += stat.events;
+
+  /* Threads starting late make the first interval and short runs unreliable */
+  const uint64_t skew = start_skew();
+
+  if (!start_skew_warned && skew > MS2NS(10) &&
+      NS2SEC(skew) > stat.time_interval / 100)
+  {
+    log_text(LOG_WARNING, "worker threads started within %.3f ms of each "
+             "other, which is more than 1%% of the run time", NS2MS(skew));
+    start_skew_warned = true;
+  }
+
+  if (last_run_pcts != NULL && sb_globals.npercentiles > 0)
+    memcpy(last_run_pcts, stat.latency_pcts,
+           sb_globals.npercentiles * sizeof(double));
+
   if (current_test && current_test->ops.report_cumulative)
     current_test->ops.report_cumulative(&stat);
   else
     sb_report_cumulative(&stat);
 
-  free(stat->latency_pcts);
+  /* The next cumulative report starts a new histogram interval */
+  sb_result_report(&stat);
+  sb_result_start();
+
+  if (stat.latency_histogram != NULL)
+    sb_histogram_log_write("checkpoint", stat.time_total, stat.time_interval,
+                           stat.latency_histogram);
+
+  free(stat.latency_pcts);
+  free(stat.intended_latency_pcts);
+  free(stat.queue_wait_pcts);
+  free(stat.latency_histogram);
 }
 
 
@@ -448,6 +1247,17 @@ static int register_tests(void)
     + register_test_memory(&tests)
     + register_test_threads(&tests)
     + register_test_mutex(&tests)
+    + register_test_atomic(&tests)
+    + register_test_c2c(&tests)
+    + register_test_wakeup(&tests)
+    + register_test_queue(&tests)
+    + register_test_malloc(&tests)
+    + register_test_syscall(&tests)
+    + register_test_wal(&tests)
+    + register_test_metadata(&tests)
+    + register_test_net(&tests)
+    + register_test_kv(&tests)
+    + register_test_clock(&tests)
     + db_register()
     + sb_rand_register()
     ;
@@ -615,6 +1425,56 @@ static int parse_test_arguments(sb_test_t *test, int argc, char *argv[])
 }
 
 
+/* Clock reads slower than this are likely to distort short event latencies */
+#define TIMER_COST_WARN_NS 200
+
+/* Share of thread time spent reading the clock with --rate to warn about */
+#define TIMER_SHARE_WARN 0.01
+
+/*
+  Warn once per process if reading the clock is expensive relative to the
+  events being timed, e.g. with the hpet or acpi_pm clocksource under a
+  hypervisor. Each timed event reads the clock twice.
+*/
+
+static void check_timer_cost(void)
+{
+  static bool checked;
+  char        cs[64];
+
+  if (checked)
+    return;
+  checked = true;
+
+  const double cost = sb_timer_gettime_cost();
+
+  if (!sb_timer_clocksource(cs, sizeof(cs)))
+    snprintf(cs, sizeof(cs), "unknown");
+
+  if (cost >= TIMER_COST_WARN_NS)
+  {
+    log_text(LOG_WARNING, "reading the clock takes %.0f ns (clocksource: %s), "
+             "latencies of short events will be inflated. Consider "
+             "--latency-sample-rate", cost, cs);
+    return;
+  }
+
+  if (sb_globals.tx_rate == 0)
+    return;
+
+  const unsigned int sample_rate = sb_globals.latency_sample_rate > 1 ?
+    sb_globals.latency_sample_rate : 1;
+  const double share = 2 * cost * sb_globals.tx_rate /
+    sb_globals.threads / sample_rate / NS_PER_SEC;
+
+  if (share >= TIMER_SHARE_WARN)
+    log_text(LOG_WARNING, "timing events at --rate=%u spends %.1f%% of "
+             "thread time reading the clock (%.0f ns per read, clocksource: "
+             "%s). Consider --latency-sample-rate", sb_globals.tx_rate,
+             share * 100, cost, cs);
+}
+
+
 void print_run_mode(sb_test_t *test)
 {
   log_text(LOG_NOTICE, "Running the test with following options:");
@@ -623,15 +1483,98 @@ void print_run_mode(sb_test_t *test)
   if (sb_globals.warmup_time > 0)
     log_text(LOG_NOTICE, "Warmup time: %ds", sb_globals.warmup_time);
 
+  if (sb_globals.warmup_steady_state > 0)
+    log_text(LOG_NOTICE, "Warmup until steady state: within %.2f%% over %us, "
+             "at most %ds", sb_globals.warmup_steady_state,
+             sb_globals.warmup_window, sb_globals.warmup_max_time);
+
+  if (stop_ci > 0)
+    log_text(LOG_NOTICE, "Stop when events/s are within %g%% at 95%% "
+             "confidence, after at least %us", stop_ci, stop_min_time);
+
+  if (sb_affinity_policy() != NULL)
+    log_text(LOG_NOTICE, "Thread affinity: %s", sb_affinity_policy());
+
+  sb_sched_print_mode();
+
+  if (sb_smt_enabled())
+    log_text(LOG_NOTICE, "SMT comparison: separate cores, then SMT siblings, "
+             "%.2fs each", NS2SEC(sb_globals.max_time_ns / 2));
+
   if (sb_globals.tx_rate > 0)
   {
     log_text(LOG_NOTICE,
-            "Target transaction rate: %d/sec", sb_globals.tx_rate);
+            "Target transaction rate: %d/sec, arrivals: %s",
+            sb_globals.tx_rate, sb_rate_model_name());
+  }
+  else if (sb_globals.event_batch > 1 && test->ops.thread_run == NULL)
+  {
+    log_text(LOG_NOTICE, "Dispatching events in batches of %u",
+             sb_globals.event_batch);
+  }
+
+  if (sb_globals.virtual_users > 1)
+    log_text(LOG_NOTICE, "Virtual users: %u per thread",
+             sb_globals.virtual_users);
+
+  if (sb_globals.think_time > 0)
+    log_text(LOG_NOTICE, "Think time: %.2f ms, %s",
+             sb_globals.think_time,
+             sb_get_value_string("think-time-type"));
+
+  if (duty_period_ns > 0)
+    log_text(LOG_NOTICE, "Duty cycle: %" PRIu64 "%% of %" PRIu64 " ms",
+             duty_on_ns * 100 / duty_period_ns, duty_period_ns / 1000000);
+
+  if (sb_groups_enabled())
+    sb_groups_print_mode();
+
+  if (sb_profile_enabled())
+    sb_profile_print_mode();
+
+  if (sb_control_enabled())
+    log_text(LOG_NOTICE, "Accepting control commands on %s",
+             sb_get_value_string("control-socket"));
+
+  if (sb_metrics_enabled())
+    log_text(LOG_NOTICE, "Serving metrics on %s",
+             sb_get_value_string("metrics-listen"));
+
+  if (sb_latency_log_enabled())
+    log_text(LOG_NOTICE, "Logging event latencies to %s",
+             sb_get_value_string("latency-log"));
+
+  if (sb_histogram_log_enabled())
+    log_text(LOG_NOTICE, "Logging latency histograms to %s",
+             sb_get_value_string("histogram-log"));
+
+  if (sb_tracectx_enabled())
+    log_text(LOG_NOTICE, "Tracing %g%% of events",
+             sb_get_value_double("trace-sample-pct"));
+
+  if (sb_slow_log_enabled())
+    log_text(LOG_NOTICE, "Logging events slower than %g ms to %s",
+             sb_get_value_double("slow-event-threshold"),
+             sb_get_value_string("slow-event-log"));
+
+  if (slo_latency > 0)
+    log_text(LOG_NOTICE, "SLO search: %.2fth percentile latency <= %.2f ms, "
+             "%us probes", slo_percentile, slo_latency, slo_probe_time);
+
+  if (sb_globals.latency_sample_rate > 1)
+  {
+    log_text(LOG_NOTICE, "Timing 1 of every %u events for latency statistics",
+             sb_globals.latency_sample_rate);
   }
 
-  if (sb_globals.report_interval)
+  if (sb_globals.report_interval % 1000 == 0 && sb_globals.report_interval)
+  {
+    log_text(LOG_NOTICE, "Report intermediate results every %u second(s)",
+             sb_globals.report_interval / 1000);
+  }
+  else if (sb_globals.report_interval)
   {
-    log_text(LOG_NOTICE, "Report intermediate results every %d second(s)",
+    log_text(LOG_NOTICE, "Report intermediate results every %u ms",
              sb_globals.report_interval);
   }
 
@@ -686,561 +1629,2911 @@ void print_run_mode(sb_test_t *test)
     test->ops.print_mode();
 }
 
-bool sb_more_events(int thread_id)
+/* Sleep until the given value of sb_exec_timer */
+
+static void sleep_until(uint64_t ns)
 {
-  (void) thread_id; /* unused */
+#if defined(HAVE_CLOCK_NANOSLEEP) && defined(HAVE_CLOCK_GETTIME)
+  /* An absolute deadline is not extended by preemption before the call */
+  struct timespec ts = sb_exec_timer.time_start;
+  uint64_t        nsec = (uint64_t) ts.tv_nsec + ns;
 
-  if (sb_globals.error)
-    return false;
+  ts.tv_sec += nsec / NS_PER_SEC;
+  ts.tv_nsec = nsec % NS_PER_SEC;
 
-  /* Check if we have a time limit */
-  if (sb_globals.max_time_ns > 0 &&
-      SB_UNLIKELY(sb_timer_value(&sb_exec_timer) >= sb_globals.max_time_ns))
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    ;
+#else
+  const uint64_t now = sb_timer_value(&sb_exec_timer);
+
+  if (ns > now)
+    sb_nanosleep(ns - now);
+#endif
+}
+
+/*
+  Wait for the next event of the current thread to be due with
+  --rate-mode=worker and return its scheduled start time. Returns 0 if the time
+  limit expires first.
+*/
+
+static uint64_t pacing_wait(int thread_id)
+{
+  sb_pacing_t * const p = &pacing[thread_id];
+  uint64_t            next_ns = p->next_ns;
+  const unsigned int  limit = ck_pr_load_uint(&control_threads);
+  double              lambda = p->lambda;
+
+  /* Threads of --thread-groups without a rate */
+  if (lambda == 0)
+    return SB_MAX(sb_timer_value(&sb_exec_timer), (uint64_t) 1);
+
+  /* Threads limited from --control-socket take over the shares of others */
+  if (limit > 0)
+    lambda *= (double) sb_globals.threads / limit;
+
+  if (next_ns == 0)
   {
-    log_text(LOG_INFO, "Time limit exceeded, exiting...");
-    return false;
+    next_ns = sb_timer_value(&sb_exec_timer);
+
+    /* Interleave evenly spaced arrivals of different threads */
+    if (sb_rate_deterministic())
+      next_ns += thread_id * 1e9 / sb_globals.tx_rate;
+    else
+      next_ns = sb_rate_next(next_ns, lambda, thread_id);
   }
+  else
+    next_ns = sb_rate_next(next_ns, lambda, thread_id);
 
-  /* Check if we have a limit on the number of events */
-  const uint64_t max_events = ck_pr_load_64(&sb_globals.max_events);
-  if (max_events > 0 &&
-      SB_UNLIKELY(ck_pr_faa_64(&sb_globals.nevents, 1) >= max_events))
+  if (sb_globals.max_time_ns > 0 && next_ns >= sb_globals.max_time_ns)
   {
-    log_text(LOG_INFO, "Event limit exceeded, exiting...");
-    return false;
+    sleep_until(sb_globals.max_time_ns);
+    return 0;
   }
 
-  /* If we are in tx_rate mode, we take events from queue */
-  if (sb_globals.tx_rate > 0)
-  {
-    void *ptr = NULL;
+  ck_pr_store_64(&p->next_ns, next_ns);
 
-    while (!ck_ring_dequeue_spmc(&queue_ring, queue_ring_buffer, &ptr) &&
-           !ck_pr_load_int(&queue_is_full))
-      usleep(500000.0 * sb_globals.threads / sb_globals.tx_rate);
+  if (next_ns > sb_timer_value(&sb_exec_timer))
+    sleep_until(next_ns);
 
-    if (ck_pr_load_int(&queue_is_full))
-    {
-      log_text(LOG_FATAL, "Event queue is full. Terminating the worker thread");
+  return next_ns;
+}
 
-      return false;
-    }
+/*
+  Estimate the number of overdue events with --rate-mode=worker, i.e. those
+  scheduled by threads still busy with previous ones
+*/
 
-    ck_pr_inc_int(&sb_globals.concurrency);
+static uint64_t pacing_backlog(void)
+{
+  const uint64_t now = sb_timer_value(&sb_exec_timer);
+  double         n = 0;
+
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+  {
+    const uint64_t next_ns = ck_pr_load_64(&pacing[i].next_ns);
 
-    timers[thread_id].queue_time = sb_timer_value(&sb_exec_timer) -
-      ((uint64_t *) ptr)[0];
+    if (next_ns != 0 && next_ns < now)
+      n += (now - next_ns) * pacing[i].lambda;
   }
 
-  return true;
+  return (uint64_t) (n * sb_rate_target() / sb_globals.tx_rate);
 }
 
+/*
+  Wait until the current thread is active in the --profile phase. Returns false
+  if the time limit expires first.
+*/
 
-void sb_event_start(int thread_id)
+static bool profile_wait(int thread_id)
 {
-  sb_timer_start(&timers[thread_id]);
+  uint64_t end_ns;
+
+  while (!sb_profile_active(thread_id, sb_timer_value(&sb_exec_timer),
+                            &end_ns))
+  {
+    if (end_ns >= sb_globals.max_time_ns)
+    {
+      sleep_until(sb_globals.max_time_ns);
+      return false;
+    }
+
+    sleep_until(end_ns);
+
+    if (sb_globals.error)
+      return false;
+  }
+
+  return true;
 }
 
+/*
+  Sleep through the idle part of the current --duty-cycle period. Periods are
+  aligned to the start of the test, so all threads run at the same time.
+  Returns false if the time limit expires first.
+*/
 
-void sb_event_stop(int thread_id)
+static bool duty_wait(void)
 {
-  sb_timer_t     *timer = &timers[thread_id];
-  long long      value;
+  const uint64_t now = sb_timer_value(&sb_exec_timer);
 
-  value = sb_timer_stop(timer);
-
-  if (sb_globals.npercentiles > 0)
-    sb_histogram_update(&sb_latency_histogram, NS2MS(value));
+  if (now % duty_period_ns < duty_on_ns)
+    return true;
 
-  sb_counter_inc(thread_id, SB_CNT_EVENT);
+  const uint64_t next_ns = now - now % duty_period_ns + duty_period_ns;
 
-  if (sb_globals.tx_rate > 0)
+  if (sb_globals.max_time_ns > 0 && next_ns >= sb_globals.max_time_ns)
   {
-    ck_pr_dec_int(&sb_globals.concurrency);
+    sleep_until(sb_globals.max_time_ns);
+    return false;
   }
-}
 
+  sleep_until(next_ns);
 
-/* Main event loop -- the default thread_run implementation */
+  return !sb_globals.error;
+}
 
+/*
+  Wait while the test is paused or the current thread is beyond the active
+  threads limit set from --control-socket. Returns false if the time limit
+  expires first.
+*/
 
-static int thread_run(sb_test_t *test, int thread_id)
+static bool control_wait(int thread_id)
 {
-  sb_event_t        event;
-  int               rc = 0;
+  bool waited = false;
 
-  while (sb_more_events(thread_id) && rc == 0)
+  for (;;)
   {
-    event = test->ops.next_event(thread_id);
-    if (event.type == SB_REQ_TYPE_NULL)
-      break;
+    const unsigned int limit = ck_pr_load_uint(&control_threads);
 
-    sb_event_start(thread_id);
+    if (!ck_pr_load_int(&control_paused) &&
+        (limit == 0 || (unsigned int) thread_id < limit))
+      break;
 
-    rc = test->ops.execute_event(&event, thread_id);
+    if (sb_globals.error || (sb_globals.max_time_ns > 0 &&
+        sb_timer_value(&sb_exec_timer) >= sb_globals.max_time_ns))
+      return false;
 
-    sb_event_stop(thread_id);
+    usleep(10000);
+    waited = true;
   }
 
-  return rc;
-}
-
+  /* Do not catch up with events scheduled while waiting */
+  if (waited && pacing != NULL)
+    ck_pr_store_64(&pacing[thread_id].next_ns, 0);
 
-/* Main worker thread */
+  return true;
+}
 
+/* Return the number of events waiting for a worker thread with --rate */
 
-static void *worker_thread(void *arg)
+static uint64_t queue_length(void)
 {
-  sb_thread_ctxt_t   *ctxt;
-  unsigned int       thread_id;
-  int                rc;
-
-  ctxt = (sb_thread_ctxt_t *)arg;
-  sb_test_t * const test = current_test;
-
-  sb_tls_thread_id = thread_id = ctxt->id;
-
-  /* Initialize thread-local RNG state */
-  sb_rand_thread_init();
+  return rate_per_worker ? pacing_backlog() :
+    ck_ring_size(&queue_ring) + ck_pr_load_64(&queue_overflow_len);
+}
 
-  log_text(LOG_DEBUG, "Worker thread (#%d) started", thread_id);
+bool sb_more_events(int thread_id)
+{
+  if (sb_globals.error)
+    return false;
 
-  if (test->ops.thread_init != NULL && test->ops.thread_init(thread_id) != 0)
+  /* Check if we have a time limit */
+  if (sb_globals.max_time_ns > 0 &&
+      SB_UNLIKELY(sb_timer_value(&sb_exec_timer) >= sb_globals.max_time_ns))
   {
-    log_text(LOG_DEBUG, "Worker thread (#%d) failed to initialize!", thread_id);
-    sb_globals.error = 1;
-    /* Avoid blocking the main thread */
-    sb_barrier_wait(&worker_barrier);
-    return NULL;
+    log_text(LOG_INFO, "Time limit exceeded, exiting...");
+    return false;
   }
 
-  log_text(LOG_DEBUG, "Worker thread (#%d) initialized", thread_id);
+  if (sb_smt_enabled() &&
+      !sb_smt_event(thread_id, sb_timer_value(&sb_exec_timer), 1))
+    return false;
 
-  /* Wait for other threads to initialize */
-  if (sb_barrier_wait(&worker_barrier) < 0)
-    return NULL;
+  /*
+    Threads inactive in the current --profile phase wait for a later one. Those
+    scheduling their own events skip inactive phases in pacing_wait().
+  */
+  if (sb_profile_enabled() && !(sb_globals.tx_rate > 0 && rate_per_worker) &&
+      !profile_wait(thread_id))
+  {
+    log_text(LOG_INFO, "Time limit exceeded, exiting...");
+    return false;
+  }
 
-  if (test->ops.thread_run != NULL)
+  if (sb_control_enabled() && !control_wait(thread_id))
   {
-    /* Use benchmark-provided thread_run implementation */
-    rc = test->ops.thread_run(thread_id);
+    log_text(LOG_INFO, "Time limit exceeded, exiting...");
+    return false;
   }
-  else
+
+  if (duty_period_ns > 0 && !duty_wait())
   {
-    /* Use default thread_run implementation */
-    rc = thread_run(test, thread_id);
+    log_text(LOG_INFO, "Time limit exceeded, exiting...");
+    return false;
   }
 
-  if (rc != 0)
-    sb_globals.error = 1;
-  else if (test->ops.thread_done != NULL)
-    test->ops.thread_done(thread_id);
+  /* Check if we have a limit on the number of events */
+  const uint64_t max_events = ck_pr_load_64(&sb_globals.max_events);
+  if (max_events > 0 &&
+      SB_UNLIKELY(ck_pr_faa_64(&sb_globals.nevents, 1) >= max_events))
+  {
+    log_text(LOG_INFO, "Event limit exceeded, exiting...");
+    return false;
+  }
 
-  return NULL;
-}
+  /* With --rate-mode=worker, each thread schedules its own events */
+  if (sb_globals.tx_rate > 0 && rate_per_worker)
+  {
+    const uint64_t start_ns = pacing_wait(thread_id);
 
-/* Generate exponentially distributed number with a given Lambda */
+    if (start_ns == 0)
+    {
+      log_text(LOG_INFO, "Time limit exceeded, exiting...");
+      return false;
+    }
 
-static inline double sb_rand_exp(double lambda)
-{
-  return -1.0 / lambda * log(1 - sb_rand_uniform_double());
-}
+    ck_pr_inc_int(&sb_globals.concurrency);
 
-static void *eventgen_thread_proc(void *arg)
-{
-  int i;
+    /* Same as the enqueue time of an event generator thread event */
+    if (sb_globals.intended_latency)
+      intended_starts[thread_id].start_ns = start_ns;
+    else
+    {
+      const uint64_t now = sb_timer_value(&sb_exec_timer);
 
-  (void)arg; /* unused */
+      timers[thread_id].queue_time = now > start_ns ? now - start_ns : 0;
+    }
+  }
+  /* Otherwise in tx_rate mode, we take events from queue */
+  else if (sb_globals.tx_rate > 0)
+  {
+    void *ptr = NULL;
 
-  sb_tls_thread_id = SB_BACKGROUND_THREAD_ID;
+    while (!ck_ring_dequeue_spmc(&queue_ring, queue_ring_buffer, &ptr) &&
+           !ck_pr_load_int(&queue_is_full))
+    {
+      double poll_us = 500000.0 * sb_globals.threads / sb_rate_target();
 
-  /* Initialize thread-local RNG state */
-  sb_rand_thread_init();
+      /* Keep polling delays well within the latency SLO being searched */
+      if (slo_latency > 0)
+        poll_us = SB_MIN(poll_us, slo_latency * 100);
 
-  ck_ring_init(&queue_ring, MAX_QUEUE_LEN);
+      usleep(poll_us);
 
-  i = 0;
+      /* No more events may arrive, e.g. at the end of a --profile ramp down */
+      if (sb_globals.max_time_ns > 0 &&
+          sb_timer_value(&sb_exec_timer) >= sb_globals.max_time_ns)
+      {
+        log_text(LOG_INFO, "Time limit exceeded, exiting...");
+        return false;
+      }
+    }
 
-  log_text(LOG_DEBUG, "Event generating thread started");
+    if (ck_pr_load_int(&queue_is_full))
+    {
+      log_text(LOG_FATAL, "Event queue is full. Terminating the worker thread");
 
-  /* Wait for the worker threads to initialize */
-  if (sb_barrier_wait(&worker_barrier) < 0)
-    return NULL;
+      return false;
+    }
 
-  eventgen_thread_created = 1;
+    ck_pr_inc_int(&sb_globals.concurrency);
 
-  /*
-    Get exponentially distributed time intervals in nanoseconds with Lambda =
-    tx_rate. Alternatively, we can use Lambda = tx_rate / 1e9
-  */
-  double lambda = sb_globals.tx_rate / 1e9;
-  uint64_t curr_ns = sb_timer_value(&sb_exec_timer);
-  uint64_t intr_ns = sb_rand_exp(lambda);
-  uint64_t next_ns = curr_ns + intr_ns;;
+    if (sb_globals.intended_latency)
+    {
+      /*
+        Queueing delay is accounted separately from the intended start time,
+        so regular latency stats only reflect the event execution time.
+      */
+      intended_starts[thread_id].start_ns = ((uint64_t *) ptr)[0];
+    }
+    else
+      timers[thread_id].queue_time = sb_timer_value(&sb_exec_timer) -
+        ((uint64_t *) ptr)[0];
+  }
 
-  for (;;)
-  {
-    curr_ns = sb_timer_value(&sb_exec_timer);
-    intr_ns = sb_rand_exp(lambda);
-    next_ns += intr_ns;
+  return true;
+}
 
-    if (next_ns > curr_ns)
-      sb_nanosleep(next_ns - curr_ns);
 
-    /* Enqueue a new event */
-    queue_array[i] = sb_timer_value(&sb_exec_timer);
-    if (ck_ring_enqueue_spmc(&queue_ring, queue_ring_buffer,
-                             &queue_array[i++]) == false)
-    {
-      ck_pr_store_int(&queue_is_full, 1);
-      log_text(LOG_FATAL,
-               "The event queue is full. This means the worker threads are "
-               "unable to keep up with the specified event generation rate");
-      return NULL;
-    }
+/* Return true if the current event must be timed with --latency-sample-rate */
 
-    if (i >= MAX_QUEUE_LEN - 1)
-      i = 0;
+static inline bool event_timed(void)
+{
+  if (SB_UNLIKELY(sb_globals.latency_sample_rate > 1) &&
+      ++tls_events_not_timed < sb_globals.latency_sample_rate)
+  {
+    tls_event_timed = false;
+    return false;
   }
 
-  return NULL;
+  tls_events_not_timed = 0;
+  tls_event_timed = true;
+
+  return true;
 }
 
-/* Intermediate reports thread */
 
-static void *report_thread_proc(void *arg)
+void sb_event_start(int thread_id)
 {
-  unsigned long long       pause_ns;
-  unsigned long long       prev_ns;
-  unsigned long long       next_ns;
-  unsigned long long       curr_ns;
-  const unsigned long long interval_ns = SEC2NS(sb_globals.report_interval);
+  SB_PROBE1(event__start, thread_id);
 
-  (void)arg; /* unused */
+  if (sb_tracectx_enabled())
+    sb_tracectx_event_start(thread_id);
 
-  sb_tls_thread_id = SB_BACKGROUND_THREAD_ID;
+  if (sb_globals.think_time > 0)
+    tls_cycle_start_ns = sb_timer_value(&sb_exec_timer);
 
-  /* Initialize thread-local RNG state */
-  sb_rand_thread_init();
+  if (event_timed())
+  {
+    sb_timer_start(&timers[thread_id]);
 
-  if (sb_lua_loaded() && sb_lua_report_thread_init())
-    return NULL;
+    if (sb_slow_log_enabled())
+      sb_slow_log_event_start(thread_id);
+  }
+}
 
-  pthread_cleanup_push(sb_lua_report_thread_done, NULL);
 
-  log_text(LOG_DEBUG, "Reporting thread started");
+void sb_event_start_at(int thread_id, const struct timespec *ts)
+{
+  SB_PROBE1(event__start, thread_id);
 
-  /* Wait for the signal from the main thread to start reporting */
-  if (sb_barrier_wait(&report_barrier) < 0)
-    return NULL;
+  if (sb_globals.think_time > 0)
+    tls_cycle_start_ns = TIMESPEC_DIFF((*ts), sb_exec_timer.time_start);
 
-  report_thread_created = 1;
+  if (event_timed())
+  {
+    sb_timer_start_at(&timers[thread_id], ts);
 
-  pause_ns = interval_ns;
-  prev_ns = sb_timer_value(&sb_exec_timer) + interval_ns;
+    if (sb_slow_log_enabled())
+      sb_slow_log_event_start(thread_id);
+  }
+}
 
-  for (;;)
-  {
-    sb_nanosleep(pause_ns);
 
-    report_intermediate();
+/* Return the time the current event waited to be started in the tx_rate mode */
 
-    curr_ns = sb_timer_value(&sb_exec_timer);
-    do
-    {
-      next_ns = prev_ns + interval_ns;
-      prev_ns = next_ns;
-    } while (curr_ns >= next_ns);
-    pause_ns = next_ns - curr_ns;
-  }
+static uint64_t event_queue_time(int thread_id)
+{
+  if (sb_globals.tx_rate == 0)
+    return 0;
 
-  pthread_cleanup_pop(1);
+  if (sb_globals.intended_latency)
+  {
+    const uint64_t start = TIMESPEC_DIFF(timers[thread_id].time_start,
+                                         sb_exec_timer.time_start);
+    const uint64_t intended = intended_starts[thread_id].start_ns;
 
-  return NULL;
+    return start > intended ? start - intended : 0;
+  }
+
+  return timers[thread_id].queue_time;
 }
 
-/* Checkpoints reports thread */
 
-static void *checkpoints_thread_proc(void *arg)
+void sb_event_stop(int thread_id)
 {
-  unsigned long long       next_ns;
-  unsigned long long       curr_ns;
-  unsigned int             i;
+  sb_timer_t     *timer = &timers[thread_id];
+  long long      value;
 
-  (void)arg; /* unused */
+  if (sb_tracectx_enabled())
+    sb_tracectx_event_stop(thread_id);
 
-  sb_tls_thread_id = SB_BACKGROUND_THREAD_ID;
+  if (!tls_event_timed)
+  {
+    SB_PROBE2(event__stop, thread_id, 0);
 
-  /* Initialize thread-local RNG state */
-  sb_rand_thread_init();
+    sb_timer_count(timer);
+    sb_counter_inc(thread_id, SB_CNT_EVENT);
 
-  if (sb_lua_loaded() && sb_lua_report_thread_init())
-    return NULL;
+    if (sb_globals.tx_rate > 0)
+      ck_pr_dec_int(&sb_globals.concurrency);
 
-  pthread_cleanup_push(sb_lua_report_thread_done, NULL);
+    return;
+  }
 
-  log_text(LOG_DEBUG, "Checkpoints report thread started");
+  value = sb_timer_stop(timer);
 
-  /* Wait for the signal from the main thread to start reporting */
-  if (sb_barrier_wait(&report_barrier) < 0)
-    return NULL;
+  SB_PROBE2(event__stop, thread_id, value);
 
-  checkpoints_thread_created = 1;
+  if (sb_latency_log_enabled())
+    sb_latency_log_event(thread_id,
+                         TIMESPEC_DIFF(timer->time_end,
+                                       sb_exec_timer.time_start),
+                         value, event_queue_time(thread_id));
 
-  for (i = 0; i < sb_globals.n_checkpoints; i++)
+  if (sb_slow_log_enabled())
+    sb_slow_log_event_stop(thread_id, value, event_queue_time(thread_id));
+
+  if (sb_globals.npercentiles > 0)
   {
-    next_ns = SEC2NS(sb_globals.checkpoints[i]);
-    curr_ns = sb_timer_value(&sb_exec_timer);
-    if (next_ns <= curr_ns)
-      continue;
+    sb_histogram_update(&sb_latency_histogram, NS2MS(value));
+
+    if (sb_groups_enabled())
+      sb_groups_event(thread_id, NS2MS(value));
+
+    if (sb_thread_stats_enabled())
+      sb_thread_stats_event(thread_id, NS2MS(value));
+  }
+
+  sb_counter_inc(thread_id, SB_CNT_EVENT);
+
+  if (sb_globals.tx_rate > 0)
+  {
+    if (sb_globals.intended_latency && sb_globals.npercentiles > 0)
+    {
+      const uint64_t now = sb_timer_value(&sb_exec_timer);
+      const uint64_t start = intended_starts[thread_id].start_ns;
+
+      sb_histogram_update(&sb_intended_latency_histogram,
+                          NS2MS(now > start ? now - start : 0));
+    }
+
+    if (sb_globals.npercentiles > 0)
+      sb_histogram_update(&sb_queue_wait_histogram,
+                          NS2MS(event_queue_time(thread_id)));
+
+    ck_pr_dec_int(&sb_globals.concurrency);
+  }
+}
+
+
+void sb_event_stop_since(int thread_id, uint64_t start_ns)
+{
+  struct timespec ts = sb_exec_timer.time_start;
+  const uint64_t  nsec = ts.tv_nsec + start_ns;
+
+  ts.tv_sec += nsec / NS_PER_SEC;
+  ts.tv_nsec = nsec % NS_PER_SEC;
+
+  sb_event_start_at(thread_id, &ts);
+  sb_event_stop(thread_id);
+}
+
+
+bool sb_think_time_enabled(void)
+{
+  return sb_globals.think_time > 0;
+}
+
+
+uint64_t sb_think_time_ns(void)
+{
+  const double mean_ns = sb_globals.think_time * 1e6;
+
+  switch (think_dist)
+  {
+  case THINK_FIXED:
+    return (uint64_t) mean_ns;
+  case THINK_UNIFORM:
+    return (uint64_t) (2 * mean_ns * sb_rand_uniform_double());
+  case THINK_EXPONENTIAL:
+  default:
+    return (uint64_t) (-mean_ns * log(1 - sb_rand_uniform_double()));
+  }
+}
+
+
+void sb_cycle_stop(uint64_t start_ns, uint64_t stop_ns)
+{
+  const uint64_t now = sb_timer_value(&sb_exec_timer);
+
+  if (now < stop_ns || stop_ns < start_ns)
+    return;
+
+  ck_pr_add_64(&think_sum_ns, now - stop_ns);
+  ck_pr_add_64(&cycle_sum_ns, now - start_ns);
+  ck_pr_inc_64(&cycles);
+
+  if (sb_globals.npercentiles > 0)
+    sb_histogram_update(&sb_cycle_time_histogram, NS2MS(now - start_ns));
+}
+
+
+void sb_event_think(int thread_id)
+{
+  const uint64_t stop_ns = sb_timer_value(&sb_exec_timer);
+
+  (void) thread_id; /* unused */
+
+  sb_test_sleep(sb_think_time_ns());
+  sb_cycle_stop(tls_cycle_start_ns, stop_ns);
+}
+
+
+uint64_t sb_test_clock(void)
+{
+  return sb_timer_value(&sb_exec_timer);
+}
+
+
+bool sb_test_sleep(uint64_t ns)
+{
+  const uint64_t max_time_ns = sb_globals.max_time_ns;
+  bool           full = true;
+
+  if (max_time_ns > 0)
+  {
+    const uint64_t now = sb_timer_value(&sb_exec_timer);
+
+    if (now >= max_time_ns)
+      return false;
+
+    if (ns > max_time_ns - now)
+    {
+      ns = max_time_ns - now;
+      full = false;
+    }
+  }
+
+  sb_nanosleep(ns);
+
+  return full;
+}
+
+
+/*
+  Claim up to n events at once. Returns the number of claimed events, 0 if the
+  benchmark must be stopped. Not supported in the tx_rate mode.
+*/
+
+uint64_t sb_more_events_batch(int thread_id, uint64_t n)
+{
+  if (sb_globals.error)
+    return 0;
+
+  /* Check if we have a time limit */
+  if (sb_globals.max_time_ns > 0 &&
+      SB_UNLIKELY(sb_timer_value(&sb_exec_timer) >= sb_globals.max_time_ns))
+  {
+    log_text(LOG_INFO, "Time limit exceeded, exiting...");
+    return 0;
+  }
+
+  if (sb_smt_enabled() &&
+      !sb_smt_event(thread_id, sb_timer_value(&sb_exec_timer), n))
+    return 0;
+
+  if ((sb_profile_enabled() && !profile_wait(thread_id)) ||
+      (sb_control_enabled() && !control_wait(thread_id)) ||
+      (duty_period_ns > 0 && !duty_wait()))
+  {
+    log_text(LOG_INFO, "Time limit exceeded, exiting...");
+    return 0;
+  }
+
+  /* Check if we have a limit on the number of events */
+  const uint64_t max_events = ck_pr_load_64(&sb_globals.max_events);
+  if (max_events > 0)
+  {
+    const uint64_t claimed = ck_pr_faa_64(&sb_globals.nevents, n);
+
+    if (SB_UNLIKELY(claimed >= max_events))
+    {
+      log_text(LOG_INFO, "Event limit exceeded, exiting...");
+      return 0;
+    }
+
+    if (claimed + n > max_events)
+      n = max_events - claimed;
+  }
+
+  return n;
+}
+
+
+void sb_event_stop_batch(int thread_id, uint64_t n)
+{
+  uint64_t value;
+
+  /* The batch was not timed with --latency-sample-rate */
+  if (!tls_event_timed)
+  {
+    SB_PROBE2(event__stop, thread_id, 0);
+
+    sb_timer_count_batch(&timers[thread_id], n);
+    sb_counter_add(thread_id, SB_CNT_EVENT, n);
+
+    return;
+  }
+
+  value = sb_timer_stop_batch(&timers[thread_id], n);
+
+  SB_PROBE2(event__stop, thread_id, value);
+
+  /* A batch is logged as a single event with the average latency */
+  if (sb_latency_log_enabled())
+    sb_latency_log_event(thread_id,
+                         TIMESPEC_DIFF(timers[thread_id].time_end,
+                                       sb_exec_timer.time_start),
+                         value, 0);
+
+  if (sb_globals.npercentiles > 0)
+  {
+    sb_histogram_update(&sb_latency_histogram, NS2MS(value));
+
+    if (sb_groups_enabled())
+      sb_groups_event(thread_id, NS2MS(value));
+
+    if (sb_thread_stats_enabled())
+      sb_thread_stats_event(thread_id, NS2MS(value));
+  }
+
+  sb_counter_add(thread_id, SB_CNT_EVENT, n);
+}
+
+
+/*
+  Batched event loop used with --event-batch > 1. Events are claimed, generated
+  and timed in batches to reduce the per-event overhead of the harness for tests
+  with very short events.
+*/
+
+static int thread_run_batched(sb_test_t *test, int thread_id)
+{
+  const unsigned int batch = sb_globals.event_batch;
+  sb_event_t         *events;
+  unsigned int       n;
+  int                rc = 0;
+  bool               done = false;
+
+  events = malloc(batch * sizeof(sb_event_t));
+  if (events == NULL)
+  {
+    log_text(LOG_FATAL, "Failed to allocate the events array");
+    return 1;
+  }
+
+  while (!done && rc == 0 &&
+         (n = sb_more_events_batch(thread_id, batch)) > 0)
+  {
+    if (test->ops.next_events != NULL)
+      n = test->ops.next_events(thread_id, events, n);
+    else
+    {
+      for (unsigned int i = 0; i < n; i++)
+      {
+        events[i] = test->ops.next_event(thread_id);
+        if (events[i].type == SB_REQ_TYPE_NULL)
+        {
+          n = i;
+          break;
+        }
+      }
+    }
+
+    if (n < batch)
+      done = true;
+
+    if (n == 0)
+      break;
+
+    if (sb_latency_log_enabled())
+      sb_latency_log_set_type(thread_id, events[0].type);
+
+    sb_event_start(thread_id);
+
+    if (test->ops.execute_events != NULL)
+      rc = test->ops.execute_events(events, n, thread_id);
+    else
+    {
+      for (unsigned int i = 0; i < n && rc == 0; i++)
+        rc = test->ops.execute_event(&events[i], thread_id);
+    }
+
+    sb_event_stop_batch(thread_id, n);
+  }
+
+  free(events);
+
+  return rc;
+}
+
+
+/* Main event loop -- the default thread_run implementation */
+
+
+static int thread_run(sb_test_t *test, int thread_id)
+{
+  sb_event_t        event;
+  int               rc = 0;
+
+  if (sb_globals.event_batch > 1 && sb_globals.tx_rate == 0 &&
+      sb_globals.think_time == 0)
+    return thread_run_batched(test, thread_id);
+
+  while (sb_more_events(thread_id) && rc == 0)
+  {
+    event = test->ops.next_event(thread_id);
+    if (event.type == SB_REQ_TYPE_NULL)
+      break;
+
+    if (sb_latency_log_enabled())
+      sb_latency_log_set_type(thread_id, event.type);
+
+    sb_event_start(thread_id);
+
+    rc = test->ops.execute_event(&event, thread_id);
+
+    sb_event_stop(thread_id);
+
+    if (sb_globals.think_time > 0)
+      sb_event_think(thread_id);
+  }
+
+  return rc;
+}
+
+
+/*
+  Wait until start_time, sleeping until shortly before it and spinning for the
+  rest, unless there are more threads than CPUs to spin on. Returns the number
+  of nanoseconds the wait ended after start_time.
+*/
+
+static uint64_t start_wait(void)
+{
+  const bool      spin = sb_globals.threads < sb_nprocs();
+  struct timespec ts;
+
+  for (;;)
+  {
+    SB_GETTIME(&ts);
+
+    const int64_t left = TIMESPEC_DIFF(start_time, ts);
+
+    if (left <= 0)
+      return (uint64_t) -left;
+
+    if (!spin)
+      sb_nanosleep(left);
+    else if (left > 200000)
+      sb_nanosleep(left - 100000);
+    else
+      ck_pr_stall();
+  }
+}
+
+
+/* Main worker thread */
+
+
+static void *worker_thread(void *arg)
+{
+  sb_thread_ctxt_t   *ctxt;
+  unsigned int       thread_id;
+  int                rc;
+
+  ctxt = (sb_thread_ctxt_t *)arg;
+  sb_test_t * const test = current_test;
+
+  sb_tls_thread_id = thread_id = ctxt->id;
+
+  /* Initialize thread-local RNG state */
+  sb_rand_thread_init();
+
+  log_thread_init();
+
+  log_text(LOG_DEBUG, "Worker thread (#%d) started", thread_id);
+
+  if (sb_sched_thread_init(thread_id))
+  {
+    sb_globals.error = 1;
+    sb_barrier_wait(&worker_barrier);
+    return NULL;
+  }
+
+  if (test->ops.thread_init != NULL && test->ops.thread_init(thread_id) != 0)
+  {
+    log_text(LOG_DEBUG, "Worker thread (#%d) failed to initialize!", thread_id);
+    sb_globals.error = 1;
+    /* Avoid blocking the main thread */
+    sb_barrier_wait(&worker_barrier);
+    return NULL;
+  }
+
+  if (sb_perf_thread_start(thread_id))
+  {
+    if (test->ops.thread_done != NULL)
+      test->ops.thread_done(thread_id);
+    sb_globals.error = 1;
+    sb_barrier_wait(&worker_barrier);
+    return NULL;
+  }
+
+  log_text(LOG_DEBUG, "Worker thread (#%d) initialized", thread_id);
+
+  /* Wait for other threads to initialize */
+  if (sb_barrier_wait(&worker_barrier) < 0)
+    return NULL;
+
+  start_offsets[thread_id] = start_wait();
+
+  sb_perf_thread_enable(thread_id);
+  sb_usage_thread_start(thread_id);
+
+  if (test->ops.thread_run != NULL)
+  {
+    /* Use benchmark-provided thread_run implementation */
+    rc = test->ops.thread_run(thread_id);
+  }
+  else
+  {
+    /* Use default thread_run implementation */
+    rc = thread_run(test, thread_id);
+  }
+
+  sb_usage_thread_stop(thread_id);
+  sb_perf_thread_stop(thread_id);
+
+  if (rc != 0)
+    sb_globals.error = 1;
+  else if (test->ops.thread_done != NULL)
+    test->ops.thread_done(thread_id);
+
+  return NULL;
+}
+
+/* Next queue_array slot to use by queue_enqueue() */
+static unsigned int queue_pos;
+
+/*
+  Put an event enqueued at the given time into the ring. Returns false if the
+  ring is full. The ring holds at most queue_size - 1 events, so the slot used
+  for the new event is never one still in the ring.
+*/
+
+static bool queue_enqueue(uint64_t ns)
+{
+  queue_array[queue_pos] = ns;
+
+  if (!ck_ring_enqueue_spmc(&queue_ring, queue_ring_buffer,
+                            &queue_array[queue_pos]))
+    return false;
+
+  if (++queue_pos >= queue_size)
+    queue_pos = 0;
+
+  return true;
+}
+
+/* Append an event to the overflow buffer, growing it if needed */
+
+static bool queue_overflow_push(uint64_t ns)
+{
+  const size_t len = queue_overflow_len;
+
+  if (queue_overflow_head + len == queue_overflow_size)
+  {
+    if (queue_overflow_head >= queue_overflow_size / 2 &&
+        queue_overflow_head > 0)
+    {
+      memmove(queue_overflow, queue_overflow + queue_overflow_head,
+              len * sizeof(uint64_t));
+      queue_overflow_head = 0;
+    }
+    else
+    {
+      const size_t size = queue_overflow_size > 0 ?
+        queue_overflow_size * 2 : queue_size;
+      uint64_t     *tmp = realloc(queue_overflow, size * sizeof(uint64_t));
+
+      if (tmp == NULL)
+        return false;
+
+      queue_overflow = tmp;
+      queue_overflow_size = size;
+    }
+  }
+
+  queue_overflow[queue_overflow_head + len] = ns;
+  ck_pr_store_64(&queue_overflow_len, len + 1);
+
+  return true;
+}
+
+/* Move as many events as fit from the overflow buffer into the ring */
+
+static void queue_overflow_drain(void)
+{
+  size_t len = queue_overflow_len;
+
+  while (len > 0 && queue_enqueue(queue_overflow[queue_overflow_head]))
+  {
+    queue_overflow_head++;
+    len--;
+  }
+
+  if (len == 0)
+    queue_overflow_head = 0;
+
+  ck_pr_store_64(&queue_overflow_len, len);
+}
+
+/*
+  Handle an event not fitting into the ring according to --rate-queue-full.
+  Returns false if the test must be terminated.
+*/
+
+static bool queue_full(uint64_t ns, bool *warned)
+{
+  switch (queue_full_policy)
+  {
+  case QUEUE_FULL_DROP:
+    if (!*warned)
+      log_text(LOG_WARNING, "The event queue is full, dropping new events");
+    *warned = true;
+    ck_pr_inc_64(&queue_dropped);
+    return true;
+
+  case QUEUE_FULL_GROW:
+    if (!*warned)
+      log_text(LOG_WARNING, "The event queue is full, keeping new events in "
+               "an overflow buffer");
+    *warned = true;
+    if (queue_overflow_push(ns))
+      return true;
+    log_text(LOG_FATAL, "Failed to grow the event queue to %zu events",
+             queue_overflow_size * 2);
+    break;
+
+  case QUEUE_FULL_TERMINATE:
+    log_text(LOG_FATAL,
+             "The event queue is full. This means the worker threads are "
+             "unable to keep up with the specified event generation rate");
+    break;
+  }
+
+  ck_pr_store_int(&queue_is_full, 1);
+
+  return false;
+}
+
+/* Generate exponentially distributed number with a given Lambda */
+
+static void *eventgen_thread_proc(void *arg)
+{
+  bool warned = false;
+
+  (void)arg; /* unused */
+
+  sb_tls_thread_id = SB_BACKGROUND_THREAD_ID;
+
+  /* Initialize thread-local RNG state */
+  sb_rand_thread_init();
+
+  ck_ring_init(&queue_ring, queue_size);
+
+  queue_pos = 0;
+  queue_overflow_head = 0;
+  queue_overflow_len = 0;
+
+  log_text(LOG_DEBUG, "Event generating thread started");
+
+  /* Wait for the worker threads to initialize */
+  if (sb_barrier_wait(&worker_barrier) < 0)
+    return NULL;
+
+  start_wait();
+
+  eventgen_thread_created = 1;
+
+  /*
+    Get time intervals in nanoseconds from the arrival process set by
+    --rate-model, exponentially distributed by default, with Lambda = tx_rate
+    / 1e9
+  */
+  double lambda = sb_globals.tx_rate / 1e9;
+  uint64_t curr_ns;
+  uint64_t next_ns = sb_timer_value(&sb_exec_timer);
+
+  for (;;)
+  {
+    /* Generate no events while paused, and do not catch up afterwards */
+    if (ck_pr_load_int(&control_paused))
+    {
+      while (ck_pr_load_int(&control_paused))
+        usleep(10000);
+      next_ns = sb_timer_value(&sb_exec_timer);
+    }
+
+    curr_ns = sb_timer_value(&sb_exec_timer);
+    next_ns = sb_rate_next(next_ns, lambda, -1);
+
+    if (next_ns > curr_ns)
+      sb_nanosleep(next_ns - curr_ns);
+
+    /*
+      Enqueue a new event. With --intended-latency, use the scheduled rather
+      than the actual time, so delays in event generation are also accounted.
+      Events in the overflow buffer go first to preserve the order.
+    */
+    const uint64_t ns = sb_globals.intended_latency ? next_ns :
+      sb_timer_value(&sb_exec_timer);
+
+    if (queue_overflow_len > 0)
+      queue_overflow_drain();
+
+    if ((queue_overflow_len > 0 || !queue_enqueue(ns)) &&
+        !queue_full(ns, &warned))
+      return NULL;
+  }
+
+  return NULL;
+}
+
+/* Intermediate reports thread */
+
+static void *report_thread_proc(void *arg)
+{
+  unsigned long long       next_ns;
+  unsigned long long       curr_ns;
+  const unsigned long long interval_ns = MS2NS(sb_globals.report_interval);
+
+  (void)arg; /* unused */
+
+  sb_tls_thread_id = SB_BACKGROUND_THREAD_ID;
+
+  /* Initialize thread-local RNG state */
+  sb_rand_thread_init();
+
+  if (sb_lua_loaded() && sb_lua_report_thread_init())
+    return NULL;
+
+  pthread_cleanup_push(sb_lua_report_thread_done, NULL);
+
+  log_text(LOG_DEBUG, "Reporting thread started");
+
+  /* Wait for the signal from the main thread to start reporting */
+  if (sb_barrier_wait(&report_barrier) < 0)
+    return NULL;
+
+  report_thread_created = 1;
+
+  /*
+    Reports are scheduled at multiples of the interval since the start of the
+    test, so they do not drift with sub-second intervals. Intervals missed by a
+    late wakeup are skipped, and so are ticks at or after the end of the test,
+    which would race with its shutdown.
+  */
+  curr_ns = sb_timer_value(&sb_exec_timer);
+  next_ns = (curr_ns / interval_ns + 1) * interval_ns;
+
+  for (;;)
+  {
+    sb_nanosleep(next_ns - curr_ns);
+
+    if (sb_globals.max_time_ns == 0 || next_ns < sb_globals.max_time_ns)
+      report_intermediate();
+
+    curr_ns = sb_timer_value(&sb_exec_timer);
+    next_ns = (SB_MAX(curr_ns, next_ns) / interval_ns + 1) * interval_ns;
+  }
+
+  pthread_cleanup_pop(1);
+
+  return NULL;
+}
+
+/* Checkpoints reports thread */
+
+static void *checkpoints_thread_proc(void *arg)
+{
+  unsigned long long       next_ns;
+  unsigned long long       curr_ns;
+  unsigned int             i;
+
+  (void)arg; /* unused */
+
+  sb_tls_thread_id = SB_BACKGROUND_THREAD_ID;
+
+  /* Initialize thread-local RNG state */
+  sb_rand_thread_init();
+
+  if (sb_lua_loaded() && sb_lua_report_thread_init())
+    return NULL;
+
+  pthread_cleanup_push(sb_lua_report_thread_done, NULL);
+
+  log_text(LOG_DEBUG, "Checkpoints report thread started");
+
+  /* Wait for the signal from the main thread to start reporting */
+  if (sb_barrier_wait(&report_barrier) < 0)
+    return NULL;
+
+  checkpoints_thread_created = 1;
+
+  for (i = 0; i < sb_globals.n_checkpoints; i++)
+  {
+    next_ns = SEC2NS(sb_globals.checkpoints[i]);
+    curr_ns = sb_timer_value(&sb_exec_timer);
+    if (next_ns <= curr_ns)
+      continue;
 
     sb_nanosleep(next_ns - curr_ns);
 
-    log_timestamp(LOG_NOTICE, NS2SEC(sb_timer_value(&sb_exec_timer)),
-                  "Checkpoint report:");
+    const int phase = sb_profile_phase_ending_at(sb_globals.checkpoints[i]);
+
+    if (phase >= 0)
+      log_timestamp(LOG_NOTICE, NS2SEC(sb_timer_value(&sb_exec_timer)),
+                    "Phase %d (%s) report:", phase + 1,
+                    sb_profile_phase_name(phase));
+    else
+      log_timestamp(LOG_NOTICE, NS2SEC(sb_timer_value(&sb_exec_timer)),
+                    "Checkpoint report:");
+
+    report_cumulative();
+  }
+
+  pthread_cleanup_pop(1);
+
+  return NULL;
+}
+
+/*
+  Run an --slo-latency probe at the given rate. The latency percentile is taken
+  from the same histogram as regular latency statistics, or from the intended
+  latency one with --intended-latency, so queueing delays are always included.
+*/
+
+static void slo_probe(unsigned int rate, sb_slo_probe_t *probe)
+{
+  sb_histogram_t * const h = sb_globals.intended_latency ?
+    &sb_intended_latency_histogram : &sb_latency_histogram;
+  sb_stat_t      stat;
+  double         *pct;
+
+  sb_rate_set_target(rate);
+
+  /* Let the queue left by a previous overloaded probe drain */
+  for (unsigned int i = 0; i < slo_probe_time * 10 &&
+         queue_length() > sb_globals.threads; i++)
+    usleep(100000);
+
+  /* Discard statistics collected before the probe */
+  checkpoint(&stat);
+  free(stat.latency_pcts);
+  free(stat.intended_latency_pcts);
+  free(stat.queue_wait_pcts);
+  free(stat.latency_histogram);
+
+  const int64_t queue_start = (int64_t) queue_length();
+
+  sb_nanosleep(SEC2NS(slo_probe_time));
+
+  pct = sb_histogram_get_pct_checkpoint(h, &slo_percentile, 1);
+  checkpoint(&stat);
+  free(stat.latency_pcts);
+  free(stat.intended_latency_pcts);
+  free(stat.queue_wait_pcts);
+  free(stat.latency_histogram);
+
+  probe->rate = rate;
+  probe->eps = stat.time_interval > 0 ? stat.events / stat.time_interval : 0;
+  probe->latency = pct != NULL ? SEC2MS(pct[0]) : 0;
+  probe->queue_growth = (int64_t) queue_length() - queue_start;
+
+  /* Allow for random fluctuations of up to 1% of arrivals */
+  probe->pass = stat.events > 0 && probe->latency <= slo_latency &&
+    probe->queue_growth <= SB_MAX((int64_t) sb_globals.threads,
+                                  (int64_t) rate * slo_probe_time / 100);
+
+  free(pct);
+}
+
+/*
+  --slo-latency search thread. The rate is doubled from --rate until a probe
+  fails, and then the highest passing rate is found by bisection.
+*/
+
+static void *slo_thread_proc(void *arg)
+{
+  unsigned int lo = 0;          /* highest passing rate */
+  unsigned int hi = 0;          /* lowest failing rate */
+  unsigned int rate = sb_globals.tx_rate;
+
+  (void)arg; /* unused */
+
+  sb_tls_thread_id = SB_BACKGROUND_THREAD_ID;
+
+  /* Initialize thread-local RNG state */
+  sb_rand_thread_init();
+
+  log_text(LOG_DEBUG, "SLO search thread started");
+
+  /* Wait for the signal from the main thread to start reporting */
+  if (sb_barrier_wait(&report_barrier) < 0)
+    return NULL;
+
+  slo_thread_created = 1;
+
+  while (slo_nprobes < slo_max_probes && !sb_globals.error)
+  {
+    sb_slo_probe_t * const probe = &slo_probes[slo_nprobes++];
+    unsigned int           next;
+
+    slo_probe(rate, probe);
+
+    log_timestamp(LOG_NOTICE, NS2SEC(sb_timer_value(&sb_exec_timer)),
+                  "SLO probe %u: rate: %u/s eps: %.2f lat (ms,%.2f%%): %.2f "
+                  "queue growth: %" PRId64 " %s", slo_nprobes, rate, probe->eps,
+                  slo_percentile, probe->latency, probe->queue_growth,
+                  probe->pass ? "pass" : "FAIL");
+
+    if (probe->pass)
+    {
+      lo = rate;
+      next = hi > 0 ? lo + (hi - lo) / 2 : (rate > UINT_MAX / 2 ?
+                                            UINT_MAX : rate * 2);
+    }
+    else
+    {
+      hi = rate;
+      next = lo + (hi - lo) / 2;
+    }
+
+    if (hi > 0 && hi - lo <= SB_MAX(1.0, hi * slo_precision / 100))
+      break;
+
+    if (next == 0 || next == rate)
+      break;
+
+    rate = next;
+  }
+
+  slo_max_rate = lo;
+
+  /* End the test */
+  ck_pr_store_64(&sb_globals.max_time_ns, sb_timer_value(&sb_exec_timer));
+
+  return NULL;
+}
+
+static int slo_probe_cmp(const void *a_ptr, const void *b_ptr)
+{
+  const sb_slo_probe_t *a = a_ptr;
+  const sb_slo_probe_t *b = b_ptr;
+
+  return (a->rate > b->rate) - (a->rate < b->rate);
+}
+
+/* Print the latency vs. throughput curve and the result of the SLO search */
+
+static void slo_report(void)
+{
+  sb_slo_probe_t probes[SLO_MAX_PROBES];
+
+  memcpy(probes, slo_probes, slo_nprobes * sizeof(sb_slo_probe_t));
+  qsort(probes, slo_nprobes, sizeof(sb_slo_probe_t), slo_probe_cmp);
+
+  log_text(LOG_NOTICE, "");
+  log_text(LOG_NOTICE, "Latency vs. throughput:");
+  log_text(LOG_NOTICE, "%12s %12s %12s %13s %5s", "rate", "events/s",
+           "latency (ms)", "queue growth", "SLO");
+
+  for (unsigned int i = 0; i < slo_nprobes; i++)
+    log_text(LOG_NOTICE, "%12u %12.2f %12.2f %13" PRId64 " %5s",
+             probes[i].rate, probes[i].eps, probes[i].latency,
+             probes[i].queue_growth, probes[i].pass ? "pass" : "FAIL");
+
+  log_text(LOG_NOTICE, "");
+
+  if (slo_max_rate > 0)
+    log_text(LOG_NOTICE, "Max sustainable rate: %u/sec (%.2fth percentile "
+             "latency <= %.2f ms)", slo_max_rate, slo_percentile, slo_latency);
+  else
+    log_text(LOG_NOTICE, "No probed rate meets the SLO of %.2f ms at the "
+             "%.2fth percentile", slo_latency, slo_percentile);
+
+  log_text(LOG_NOTICE, "");
+}
+
+/* Execute a --control-socket command */
+
+static void control_command(const char *cmd, char *reply, size_t size)
+{
+  const double now = NS2SEC(sb_timer_value(&sb_exec_timer));
+  char         name[16];
+  const char   *args;
+  char         *end;
+  long         arg = 0;
+  int          n;
+
+  if (sscanf(cmd, "%15s%n", name, &n) != 1)
+  {
+    snprintf(reply, size, "ERR empty command");
+    return;
+  }
+
+  if (strcmp(name, "rate") && strcmp(name, "threads") &&
+      strcmp(name, "pause") && strcmp(name, "resume") &&
+      strcmp(name, "checkpoint") && strcmp(name, "stop") &&
+      strcmp(name, "status"))
+  {
+    snprintf(reply, size, "ERR unknown command '%s'", name);
+    return;
+  }
+
+  args = cmd + n + strspn(cmd + n, " \t");
+
+  const bool has_arg = !strcmp(name, "rate") || !strcmp(name, "threads");
+
+  if (has_arg)
+  {
+    arg = strtol(args, &end, 10);
+    if (end == args || end[strspn(end, " \t")] != '\0')
+    {
+      snprintf(reply, size, "ERR '%s' requires a numeric argument", name);
+      return;
+    }
+  }
+  else if (*args != '\0')
+  {
+    snprintf(reply, size, "ERR '%s' takes no arguments", name);
+    return;
+  }
+
+  if (has_arg)
+  {
+    if (!strcmp(name, "rate"))
+    {
+      if (sb_globals.tx_rate == 0)
+      {
+        snprintf(reply, size, "ERR the rate can only be changed with --rate");
+        return;
+      }
+      if (arg <= 0 || arg > INT_MAX)
+      {
+        snprintf(reply, size, "ERR invalid rate: %ld", arg);
+        return;
+      }
+
+      sb_rate_set_target((unsigned int) arg);
+      log_timestamp(LOG_NOTICE, now, "Control: target rate set to %ld/sec",
+                    arg);
+    }
+    else
+    {
+      if (arg <= 0 || arg > (long) sb_globals.threads)
+      {
+        snprintf(reply, size, "ERR invalid number of threads: %ld (1 to %u)",
+                 arg, sb_globals.threads);
+        return;
+      }
+
+      ck_pr_store_uint(&control_threads, arg < (long) sb_globals.threads ?
+                       (unsigned int) arg : 0);
+      log_timestamp(LOG_NOTICE, now, "Control: active threads set to %ld",
+                    arg);
+    }
+  }
+  else if (!strcmp(name, "pause") || !strcmp(name, "resume"))
+  {
+    const bool pause = !strcmp(name, "pause");
+
+    ck_pr_store_int(&control_paused, pause);
+    log_timestamp(LOG_NOTICE, now, "Control: %s", pause ? "paused" :
+                  "resumed");
+  }
+  else if (!strcmp(name, "checkpoint"))
+  {
+    log_timestamp(LOG_NOTICE, now, "Control checkpoint report:");
+    report_cumulative();
+  }
+  else if (!strcmp(name, "stop"))
+  {
+    log_timestamp(LOG_NOTICE, now, "Control: stopping the test");
+    ck_pr_store_64(&sb_globals.max_time_ns, sb_timer_value(&sb_exec_timer));
+    ck_pr_store_int(&control_paused, 0);
+  }
+
+  const unsigned int limit = ck_pr_load_uint(&control_threads);
+
+  snprintf(reply, size, "OK time: %.3fs rate: %u threads: %u/%u paused: %s",
+           now, sb_globals.tx_rate > 0 ? sb_rate_target() : 0,
+           limit > 0 ? limit : sb_globals.threads, sb_globals.threads,
+           ck_pr_load_int(&control_paused) ? "yes" : "no");
+}
+
+/* Bytes of C heap in use, or 0 if unknown */
+
+static size_t c_heap_used(void)
+{
+#ifdef HAVE_MALLINFO2
+  const struct mallinfo2 mi = mallinfo2();
+
+  return mi.uordblks + mi.hblkhd;
+#else
+  return 0;
+#endif
+}
+
+
+/*
+  Print memory used by each worker thread once all of them are initialized.
+  The C heap is what was allocated since worker threads were created, which is
+  mostly database driver connections. LuaJIT allocates its heap separately, so
+  it is not included.
+*/
+
+static void report_worker_memory(void)
+{
+  const unsigned int threads = sb_globals.threads;
+  const size_t       heap = c_heap_used();
+  const double       stack_kb = sb_thread_stack_size() / 1024.0;
+  double             per_worker_kb = stack_kb;
+
+  log_text(LOG_NOTICE, "Per-worker memory (%u threads):", threads);
+
+  if (sb_lua_loaded())
+  {
+    size_t lua_total = 0;
+    size_t lua_max = 0;
+
+    for (unsigned int i = 0; i < threads; i++)
+    {
+      const size_t lua_heap = sb_lua_state_heap(i);
+
+      lua_total += lua_heap;
+      lua_max = SB_MAX(lua_max, lua_heap);
+    }
+
+    log_text(LOG_NOTICE, "    Lua heap:                            "
+             "%.1f KiB avg, %.1f KiB max", lua_total / 1024.0 / threads,
+             lua_max / 1024.0);
+
+    per_worker_kb += lua_total / 1024.0 / threads;
+  }
+
+  log_text(LOG_NOTICE, "    thread stack:                        %.1f KiB",
+           stack_kb);
+
+  if (heap > 0)
+  {
+    const double heap_kb = heap > worker_heap_start ?
+      (heap - worker_heap_start) / 1024.0 / threads : 0;
+
+    log_text(LOG_NOTICE, "    C heap (drivers and other):          %.1f KiB",
+             heap_kb);
+
+    per_worker_kb += heap_kb;
+  }
+  else
+    log_text(LOG_NOTICE, "    C heap (drivers and other):          N/A");
+
+  log_text(LOG_NOTICE, "    total:                               "
+           "%.1f KiB per worker, %.1f MiB for all workers", per_worker_kb,
+           per_worker_kb * threads / 1024);
+  log_text(LOG_NOTICE, "");
+}
+
+
+/* Callback to start timers when all threads are ready */
+
+static int threads_started_callback(void *arg)
+{
+  (void) arg; /* unused */
+
+  /* Report initialization errors to the main thread */
+  if (sb_globals.error)
+    return 1;
+
+  /* Wait for worker threads on all cluster nodes, if any */
+  if (sb_cluster_barrier())
+    return 1;
+
+  sb_globals.threads_running = sb_globals.threads;
+
+  sb_usage_threads_started();
+
+  if (worker_memory)
+    report_worker_memory();
+
+  db_report_rampup();
+
+  /*
+    Leave released threads time to wake up before the start: 1 ms plus 20 us
+    per thread, up to 50 ms
+  */
+  const uint64_t delay_ns = SB_MIN(1000000 + 20000 * (uint64_t)
+                                   sb_globals.threads, 50000000ULL);
+  uint64_t       nsec;
+
+  SB_GETTIME(&start_time);
+  nsec = start_time.tv_nsec + delay_ns;
+  start_time.tv_sec += nsec / NS_PER_SEC;
+  start_time.tv_nsec = nsec % NS_PER_SEC;
+  start_skew_warned = false;
+
+  sb_timer_start_at(&sb_exec_timer, &start_time);
+  sb_timer_copy(&sb_intermediate_timer, &sb_exec_timer);
+  sb_timer_copy(&sb_checkpoint_timer, &sb_exec_timer);
+
+  if (sb_latency_log_start() || db_outage_start())
+    return 1;
+
+  sb_result_start();
+
+  log_text(LOG_NOTICE, "Threads started!\n");
+
+  return 0;
+}
+
+
+/* Total number of events executed by worker threads so far */
+
+static uint64_t events_total(void)
+{
+  uint64_t events = 0;
+
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+    events += sb_counter_val(i, SB_CNT_EVENT);
+
+  return events;
+}
+
+
+/*
+  Check whether the throughput samples in the ring buffer rates[] (oldest at
+  index first) are in a steady state: their range must not exceed
+  --warmup-steady-state percent of the average and the change over the window
+  along their least squares line must not exceed half of that.
+*/
+
+static bool is_steady_state(const double *rates, unsigned int first,
+                            double *range_pct, double *slope_pct)
+{
+  const unsigned int n = sb_globals.warmup_window;
+  const double       xavg = (n - 1) / 2.0;
+  double             sum = 0, min = rates[0], max = rates[0];
+  double             sxy = 0, sxx = 0;
+
+  for (unsigned int i = 0; i < n; i++)
+  {
+    sum += rates[i];
+    min = SB_MIN(min, rates[i]);
+    max = SB_MAX(max, rates[i]);
+  }
+
+  const double avg = sum / n;
+
+  if (avg <= 0)
+    return false;
+
+  for (unsigned int i = 0; i < n; i++)
+  {
+    const double y = rates[(first + i) % n];
+
+    sxy += (i - xavg) * (y - avg);
+    sxx += (i - xavg) * (i - xavg);
+  }
+
+  *range_pct = (max - min) * 100 / avg;
+  *slope_pct = fabs(sxy / sxx * (n - 1)) * 100 / avg;
+
+  return *range_pct <= sb_globals.warmup_steady_state &&
+    *slope_pct <= sb_globals.warmup_steady_state / 2;
+}
+
+
+/*
+  Warm up for at least --warmup-time seconds and then until throughput is in
+  a steady state, or --warmup-max-time is reached. Returns the warmup time in
+  seconds.
+*/
+
+static int warmup_steady_state(void)
+{
+  const unsigned int n = sb_globals.warmup_window;
+  double             *rates;
+  double             range_pct = 0, slope_pct = 0;
+  uint64_t           events, last_events;
+  struct timespec    ts;
+  uint64_t           now_ns, last_ns;
+  int                elapsed;
+
+  log_text(LOG_NOTICE, "Warming up until throughput is steady...\n");
+
+  rates = calloc(n, sizeof(double));
+  if (rates == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return sb_globals.warmup_max_time;
+  }
+
+  SB_GETTIME(&ts);
+  last_ns = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+  last_events = events_total();
+
+  for (elapsed = 1; ; elapsed++)
+  {
+    usleep(1000000);
+
+    SB_GETTIME(&ts);
+    now_ns = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+    events = events_total();
+
+    rates[(elapsed - 1) % n] = (events - last_events) / NS2SEC(now_ns - last_ns);
+
+    last_ns = now_ns;
+    last_events = events;
+
+    log_text(LOG_DEBUG, "Warmup second %d: %.2f events/s", elapsed,
+             rates[(elapsed - 1) % n]);
+
+    /* Stop waiting if workers have exited, e.g. on errors */
+    if (ck_pr_load_uint(&sb_globals.threads_running) == 0)
+      break;
+
+    if (elapsed < sb_globals.warmup_time || (unsigned) elapsed < n)
+      continue;
+
+    if (is_steady_state(rates, elapsed % n, &range_pct, &slope_pct))
+    {
+      log_text(LOG_NOTICE, "Steady state reached after %d seconds: "
+               "%.2f%% range, %.2f%% trend over the last %u seconds\n",
+               elapsed, range_pct, slope_pct, n);
+      break;
+    }
+
+    if (elapsed >= sb_globals.warmup_max_time)
+    {
+      log_text(LOG_WARNING, "Steady state not reached after %d seconds "
+               "(%.2f%% range, %.2f%% trend over the last %u seconds), "
+               "starting the benchmark anyway\n",
+               elapsed, range_pct, slope_pct, n);
+      break;
+    }
+  }
+
+  free(rates);
+
+  return elapsed;
+}
+
+
+/*
+  Two-sided 95% quantile of Student's t-distribution with a given number of
+  degrees of freedom. Exact values are used for small numbers of degrees of
+  freedom, where the Cornish-Fisher expansion around the normal distribution
+  used for the rest is too far off.
+*/
+
+static double t_quantile_95(unsigned int df)
+{
+  static const double t_table[] =
+    { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228 };
+
+  if (df >= 1 && df <= sizeof(t_table) / sizeof(t_table[0]))
+    return t_table[df - 1];
+
+  const double z = 1.959964;
+  const double z3 = z * z * z;
+  const double z5 = z3 * z * z;
+
+  return z + (z3 + z) / (4.0 * df) +
+    (5 * z5 + 16 * z3 + 3 * z) / (96.0 * df * df);
+}
+
+
+/*
+  Estimate the mean of n throughput samples and the half-width of its 95%
+  confidence interval in percent of the mean. Samples of adjacent seconds are
+  correlated, so the estimate is made from floor(sqrt(n)) means of as many
+  consecutive samples, which are close to independent. The oldest samples not
+  filling a batch are left out.
+*/
+
+static bool batch_means_ci(const double *rates, unsigned int n, double *mean,
+                           double *ci_pct)
+{
+  unsigned int nbatches = 0;
+  double       sum = 0, sumsq = 0;
+
+  while ((nbatches + 1) * (nbatches + 1) <= n)
+    nbatches++;
+
+  const unsigned int size = nbatches;
+  const unsigned int first = n - nbatches * size;
+
+  if (nbatches < 3)
+    return false;
+
+  for (unsigned int b = 0; b < nbatches; b++)
+  {
+    double bsum = 0;
+
+    for (unsigned int i = 0; i < size; i++)
+      bsum += rates[first + b * size + i];
+
+    sum += bsum / size;
+    sumsq += (bsum / size) * (bsum / size);
+  }
+
+  *mean = sum / nbatches;
+  if (*mean <= 0)
+    return false;
+
+  const double var = SB_MAX(sumsq - sum * sum / nbatches, 0) / (nbatches - 1);
+
+  *ci_pct = t_quantile_95(nbatches - 1) * sqrt(var / nbatches) * 100 / *mean;
+
+  return true;
+}
+
+
+/*
+  --stop-ci thread: sample throughput every second and end the run once the
+  confidence interval of its mean is tight enough
+*/
+
+static void *stop_thread_proc(void *arg)
+{
+  unsigned int    size = 0;
+  uint64_t        events, last_events;
+  struct timespec ts;
+  uint64_t        now_ns, last_ns;
+
+  (void)arg; /* unused */
+
+  sb_tls_thread_id = SB_BACKGROUND_THREAD_ID;
+
+  /* Initialize thread-local RNG state */
+  sb_rand_thread_init();
+
+  log_text(LOG_DEBUG, "Auto-stop thread started");
+
+  /* Wait for the signal from the main thread to start the benchmark */
+  if (sb_barrier_wait(&report_barrier) < 0)
+    return NULL;
+
+  stop_thread_created = 1;
+
+  SB_GETTIME(&ts);
+  last_ns = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+  last_events = events_total();
+
+  for (;;)
+  {
+    usleep(1000000);
+
+    SB_GETTIME(&ts);
+    now_ns = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+    events = events_total();
+
+    if (stop_nrates == size)
+    {
+      double *tmp;
+
+      size = size > 0 ? size * 2 : 64;
+      if ((tmp = realloc(stop_rates, size * sizeof(double))) == NULL)
+      {
+        log_text(LOG_FATAL, "Memory allocation failure");
+        break;
+      }
+      stop_rates = tmp;
+    }
+
+    stop_rates[stop_nrates++] = (events - last_events) /
+      NS2SEC(now_ns - last_ns);
+
+    last_ns = now_ns;
+    last_events = events;
+
+    const unsigned int n = stop_nrates;
+
+    if (!batch_means_ci(stop_rates, n, &stop_ci_mean, &stop_ci_pct))
+      continue;
+
+    log_text(LOG_DEBUG, "Benchmark second %u: mean %.2f events/s +/- %.2f%%",
+             n, stop_ci_mean, stop_ci_pct);
+
+    if (n >= stop_min_time && stop_ci_pct <= stop_ci)
+    {
+      stop_ci_reached = true;
+      log_timestamp(LOG_NOTICE, NS2SEC(sb_timer_value(&sb_exec_timer)),
+                    "Stopping: mean %.2f events/s +/- %.2f%% at 95%% "
+                    "confidence after %u seconds", stop_ci_mean, stop_ci_pct,
+                    n);
+      ck_pr_store_64(&sb_globals.max_time_ns,
+                     sb_timer_value(&sb_exec_timer));
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+
+/*
+  Main test function: start threads, wait for them to finish and measure time.
+*/
+
+static int run_test(sb_test_t *test)
+{
+  int          err;
+  pthread_t    report_thread;
+  pthread_t    checkpoints_thread;
+  pthread_t    eventgen_thread;
+  pthread_t    slo_thread;
+  pthread_t    stop_thread;
+  unsigned int barrier_threads;
+  uint64_t     old_max_events = 0;
+  /* Adjusted for the actual warmup time of this run */
+  const uint64_t max_time_ns = sb_globals.max_time_ns;
+
+  if (slo_latency > 0 && sb_globals.npercentiles == 0)
+  {
+    log_text(LOG_FATAL, "--slo-latency cannot be used with --percentile=NULL");
+    return 1;
+  }
+
+  if (sb_groups_have_scripts() && !sb_lua_loaded())
+  {
+    log_text(LOG_FATAL, "Scripts in --thread-groups require a Lua script as "
+             "the main test");
+    return 1;
+  }
+
+  if (sb_globals.virtual_users > 1 && !sb_lua_loaded())
+  {
+    log_text(LOG_FATAL, "--virtual-users requires a Lua script");
+    return 1;
+  }
+
+  if (sb_globals.virtual_users > 1 && sb_globals.tx_rate > 0)
+  {
+    log_text(LOG_FATAL, "--virtual-users cannot be used with --rate");
+    return 1;
+  }
+
+  if (sb_globals.think_time > 0 && sb_globals.tx_rate > 0)
+  {
+    log_text(LOG_FATAL, "--think-time cannot be used with --rate");
+    return 1;
+  }
+
+  /* initialize test */
+  if (test->ops.init != NULL && test->ops.init() != 0)
+    return 1;
+  
+  /* print test mode */
+  print_run_mode(test);
+
+  check_timer_cost();
+
+  /* connect cluster nodes, if requested */
+  if (sb_cluster_connect())
+    return 1;
+
+  /* initialize timers */
+  sb_timer_init(&sb_exec_timer);
+  sb_timer_init(&sb_intermediate_timer);
+  sb_timer_init(&sb_checkpoint_timer);
+
+  /* prepare test */
+  if (test->ops.prepare != NULL && test->ops.prepare() != 0)
+    return 1;
+
+  pthread_mutex_init(&sb_globals.exec_mutex, NULL);
+
+
+  queue_is_full = 0;
+  control_paused = 0;
+  control_threads = 0;
+
+  sb_rate_start();
+
+  if (pacing != NULL)
+  {
+    for (unsigned int i = 0; i < sb_globals.threads; i++)
+    {
+      pacing[i].next_ns = 0;
+      pacing[i].lambda = sb_groups_enabled() ?
+        sb_groups_thread_rate(i) / 1e9 :
+        sb_globals.tx_rate / 1e9 / sb_globals.threads;
+    }
+  }
+
+  sb_globals.threads_running = 0;
+
+  /* Calculate the required number of threads for the worker start barrier */
+  barrier_threads = 1 /* main thread */ + sb_globals.threads +
+    (sb_globals.tx_rate > 0 && !rate_per_worker) /* event generation thread */;
+
+  if (sb_barrier_init(&worker_barrier, barrier_threads,
+                      threads_started_callback, NULL))
+  {
+    log_errno(LOG_FATAL, "sb_barrier_init() failed");
+    return 1;
+  }
+
+  /* Calculate the required number of threads for the report start barrier */
+  barrier_threads = 1 /* main thread */ +
+    (sb_globals.report_interval > 0) /* intermediate reports thread */ +
+    (sb_globals.n_checkpoints > 0) /* checkpoint reports thread */ +
+    (slo_latency > 0) /* SLO search thread */ +
+    (stop_ci > 0) /* auto-stop thread */;
+
+  if (sb_barrier_init(&report_barrier, barrier_threads, NULL, NULL))
+  {
+    log_errno(LOG_FATAL, "sb_barrier_init() failed");
+    return 1;
+  }
+
+
+  if (sb_globals.report_interval > 0)
+  {
+    /* Create a thread for intermediate statistic reports */
+    if ((err = sb_thread_create(&report_thread, &sb_thread_attr,
+                                &report_thread_proc, NULL)) != 0)
+    {
+      log_errno(LOG_FATAL,
+                "sb_thread_create() for the reporting thread failed.");
+      return 1;
+    }
+  }
+
+  if (sb_globals.tx_rate > 0 && !rate_per_worker)
+  {
+    if ((err = sb_thread_create(&eventgen_thread, &sb_thread_attr,
+                                &eventgen_thread_proc, NULL)) != 0)
+    {
+      log_errno(LOG_FATAL,
+                "sb_thread_create() for the reporting thread failed.");
+      return 1;
+    }
+  }
+
+  if (sb_globals.n_checkpoints > 0)
+  {
+    /* Create a thread for checkpoint statistic reports */
+    if ((err = sb_thread_create(&checkpoints_thread, &sb_thread_attr,
+                                &checkpoints_thread_proc, NULL)) != 0)
+    {
+      log_errno(LOG_FATAL,
+                "sb_thread_create() for the checkpoint thread failed.");
+      return 1;
+    }
+  }
+
+  if (slo_latency > 0)
+  {
+    slo_nprobes = 0;
+
+    if ((err = sb_thread_create(&slo_thread, &sb_thread_attr,
+                                &slo_thread_proc, NULL)) != 0)
+    {
+      log_errno(LOG_FATAL,
+                "sb_thread_create() for the SLO search thread failed.");
+      return 1;
+    }
+  }
+
+  if (stop_ci > 0)
+  {
+    stop_ci_reached = false;
+    stop_ci_pct = -1;
+    stop_nrates = 0;
+
+    if ((err = sb_thread_create(&stop_thread, &sb_thread_attr,
+                                &stop_thread_proc, NULL)) != 0)
+    {
+      log_errno(LOG_FATAL,
+                "sb_thread_create() for the auto-stop thread failed.");
+      return 1;
+    }
+  }
+
+  sb_usage_run_start();
+  sb_pressure_run_start();
+
+  run_events = 0;
+
+  if (sb_energy_run_start() || sb_cpufreq_run_start() || sb_smt_run_start())
+    return 1;
+
+  worker_heap_start = c_heap_used();
+
+  if ((err = sb_thread_create_workers(&worker_thread)))
+    return err;
+
+#ifdef HAVE_ALARM
+  /* Exit with an error if thread initialization timeout expires */
+  signal(SIGALRM, sigalrm_thread_init_timeout_handler);
+
+  alarm(thread_init_timeout);
+#endif
+
+  sb_globals.warmup_elapsed = sb_globals.warmup_time;
+
+  if (sb_globals.warmup_time > 0 || sb_globals.warmup_steady_state > 0)
+  {
+    /* Disable the max_events limit for the warmup stage */
+    old_max_events = sb_globals.max_events;
+    sb_globals.max_events = 0;
+  }
+
+  if (sb_barrier_wait(&worker_barrier) < 0)
+  {
+    log_text(LOG_FATAL, "Threads initialization failed!");
+    return 1;
+  }
+
+  /* Nothing may use sb_exec_timer before it starts */
+  start_wait();
+
+  /* Metrics are also served during the warmup */
+  if (sb_metrics_start())
+    return 1;
+
+#ifdef HAVE_ALARM
+  alarm(0);
+
+  if (sb_globals.force_shutdown)
+  {
+    /* Set the alarm to force shutdown */
+    signal(SIGALRM, sigalrm_forced_shutdown_handler);
+
+    alarm(NS2SEC(sb_globals.max_time_ns) + sb_globals.timeout);
+  }
+#endif
+
+  if (sb_globals.warmup_time > 0 || sb_globals.warmup_steady_state > 0)
+  {
+    if (sb_globals.warmup_steady_state > 0)
+    {
+      sb_globals.warmup_elapsed = warmup_steady_state();
+
+      /* The time limit included the maximum warmup time */
+      if (max_time_ns > 0)
+        ck_pr_store_64(&sb_globals.max_time_ns, max_time_ns -
+                       SEC2NS(sb_globals.warmup_max_time -
+                              sb_globals.warmup_elapsed));
+    }
+    else
+    {
+      log_text(LOG_NOTICE, "Warming up for %d seconds...\n",
+               sb_globals.warmup_time);
+
+      usleep(sb_globals.warmup_time * 1000000);
+    }
+
+    /* Re-enable the max_events limit, if it was set */
+    ck_pr_store_64(&sb_globals.max_events, old_max_events);
+
+    /* Perform a checkpoint to reset previously collected stats */
+    sb_stat_t stat;
+    checkpoint(&stat);
+    free(stat.latency_pcts);
+    free(stat.intended_latency_pcts);
+    free(stat.queue_wait_pcts);
+    free(stat.cycle_time_pcts);
+    free(stat.latency_histogram);
+
+    sb_result_start();
+    sb_energy_reset();
+    sb_cpufreq_reset();
+  }
+
+  /* Signal the report threads to start reporting */
+  if (sb_barrier_wait(&report_barrier) < 0)
+  {
+    log_text(LOG_FATAL, "Failed to signal reporting threads");
+    return 1;
+  }
+
+  if (sb_control_start(control_command))
+    return 1;
+
+  if ((err = sb_thread_join_workers()))
+    return err;
+
+  sb_control_stop();
+  sb_metrics_stop();
+  sb_latency_log_stop();
+
+  sb_usage_run_stop();
+  sb_pressure_run_stop();
+  sb_energy_run_stop();
+  sb_cpufreq_run_stop();
+
+  sb_timer_stop(&sb_exec_timer);
+  sb_timer_stop(&sb_intermediate_timer);
+  sb_timer_stop(&sb_checkpoint_timer);
+
+  /* Silence periodic reports if they were on */
+  ck_pr_store_uint(&sb_globals.report_interval, 0);
+
+  if (sb_cluster_mode != SB_CLUSTER_OFF)
+  {
+    sb_timer_t t;
+
+    sb_timer_init(&t);
+    for (size_t i = 0; i < sb_globals.threads; i++)
+      t = sb_timer_merge(&t, &timers[i]);
+
+    /* Send final statistics to, or wait for them on the cluster controller */
+    sb_cluster_finish(&t);
+  }
+
+#ifdef HAVE_ALARM
+  alarm(0);
+#endif
+
+  log_text(LOG_INFO, "Done.\n");
+
+  /* cleanup test */
+  if (test->ops.cleanup != NULL && test->ops.cleanup() != 0)
+    return 1;
+
+  if (report_thread_created)
+  {
+    if (sb_thread_cancel(report_thread) || sb_thread_join(report_thread, NULL))
+      log_errno(LOG_FATAL, "Terminating the reporting thread failed.");
+  }
+
+  if (eventgen_thread_created)
+  {
+    if (sb_thread_cancel(eventgen_thread) ||
+        sb_thread_join(eventgen_thread, NULL))
+      log_text(LOG_FATAL, "Terminating the event generator thread failed.");
+  }
+
+  if (checkpoints_thread_created)
+  {
+    if (sb_thread_cancel(checkpoints_thread) ||
+        sb_thread_join(checkpoints_thread, NULL))
+      log_errno(LOG_FATAL, "Terminating the checkpoint thread failed.");
+  }
+
+  if (slo_thread_created)
+  {
+    if (sb_thread_cancel(slo_thread) || sb_thread_join(slo_thread, NULL))
+      log_errno(LOG_FATAL, "Terminating the SLO search thread failed.");
+  }
+
+  if (stop_thread_created)
+  {
+    if (sb_thread_cancel(stop_thread) || sb_thread_join(stop_thread, NULL))
+      log_errno(LOG_FATAL, "Terminating the auto-stop thread failed.");
+    stop_thread_created = 0;
+
+    if (stop_ci_reached || sb_globals.error)
+      ;
+    else if (stop_ci_pct < 0)
+      log_text(LOG_WARNING, "--stop-ci=%g not reached: the run was too "
+               "short to estimate the confidence interval", stop_ci);
+    else
+      log_text(LOG_WARNING, "--stop-ci=%g not reached before the end of "
+               "the run, the last confidence interval was +/- %.2f%%",
+               stop_ci, stop_ci_pct);
+
+    free(stop_rates);
+    stop_rates = NULL;
+  }
+
+  /* print test-specific stats */
+  if (!sb_globals.error && !scenario_warmup)
+  {
+    if (sb_globals.histogram)
+    {
+      log_text(LOG_NOTICE, "Latency histogram (values are in milliseconds)");
+      sb_histogram_print(&sb_latency_histogram);
+      log_text(LOG_NOTICE, " ");
+
+      if (sb_globals.tx_rate > 0 && sb_globals.intended_latency)
+      {
+        log_text(LOG_NOTICE, "Latency from intended start histogram "
+                 "(values are in milliseconds)");
+        sb_histogram_print(&sb_intended_latency_histogram);
+        log_text(LOG_NOTICE, " ");
+      }
+    }
+
+    /* The last phase is reported with the final statistics */
+    if (sb_profile_enabled())
+    {
+      const unsigned int phase = sb_profile_phases();
+
+      log_timestamp(LOG_NOTICE, NS2SEC(sb_timer_value(&sb_exec_timer)),
+                    "Phase %u (%s) report:", phase,
+                    sb_profile_phase_name(phase - 1));
+    }
+
+    /* Statistics are reported per probe for the SLO search */
+    if (slo_latency > 0)
+      slo_report();
+    else
+      report_cumulative();
+
+    sb_usage_report();
+    sb_sched_report();
+    sb_pressure_report();
+    sb_energy_report(run_events);
+    sb_cpufreq_report();
+    sb_smt_report();
+  }
+
+  pthread_mutex_destroy(&sb_globals.exec_mutex);
+
+  sb_cluster_done();
+
+  /* Restore the time limit for the next run of a thread sweep */
+  sb_globals.max_time_ns = max_time_ns;
+
+  /* finalize test */
+  if (test->ops.done != NULL)
+    (*(test->ops.done))();
+
+  return sb_globals.error != 0;
+}
+
+
+/* Parse a positive thread count, return 0 on error */
+
+static unsigned int parse_thread_count(const char *s, char **endptr)
+{
+  long n = strtol(s, endptr, 10);
+
+  if (*endptr == s || n <= 0 || n > INT_MAX)
+    return 0;
+
+  return (unsigned int) n;
+}
+
+
+/*
+  Parse --threads as a single thread count, a comma-separated list of thread
+  counts, or 'sweep:MIN..MAX' which doubles the number of threads from MIN
+  until it reaches MAX.
+*/
+
+/*
+  Parse --report-interval into milliseconds. The value is in seconds unless it
+  has the 'ms' suffix, and may be fractional.
+*/
+
+static int parse_report_interval(const char *s)
+{
+  char   *end;
+  double val = s != NULL ? strtod(s, &end) : -1;
+
+  if (s != NULL && end != s && val >= 0)
+  {
+    if (!strcmp(end, "ms"))
+      ;
+    else if (*end == '\0' || !strcmp(end, "s"))
+      val *= 1000;
+    else
+      val = -1;
+  }
+
+  if (s == NULL || end == s || val < 0 || val >= UINT_MAX ||
+      (val > 0 && val < 1))
+  {
+    log_text(LOG_FATAL, "Invalid value for --report-interval: '%s'",
+             s != NULL ? s : "");
+    return 1;
+  }
+
+  sb_globals.report_interval = (unsigned int) (val + 0.5);
+
+  return 0;
+}
+
+
+static int parse_thread_levels(const char *s)
+{
+  unsigned int n, max;
+  char         *end;
+  const char   *p;
+
+  n_thread_levels = 0;
+
+  if (s == NULL)
+    goto error;
+
+  if (!strncmp(s, "sweep:", 6))
+  {
+    if ((n = parse_thread_count(s + 6, &end)) == 0 || strncmp(end, "..", 2))
+      goto error;
+
+    p = end + 2;
+    if ((max = parse_thread_count(p, &end)) == 0 || *end != '\0' || max < n)
+      goto error;
+
+    for (; n < max && n_thread_levels < MAX_THREAD_LEVELS - 1; n *= 2)
+      thread_levels[n_thread_levels++] = n;
+    thread_levels[n_thread_levels++] = max;
+
+    return 0;
+  }
+
+  for (p = s;; p = end + 1)
+  {
+    if ((n = parse_thread_count(p, &end)) == 0 || (*end != ',' && *end != '\0'))
+      goto error;
+
+    if (n_thread_levels == MAX_THREAD_LEVELS)
+    {
+      log_text(LOG_FATAL, "Too many thread counts in --threads (up to %d can "
+               "be defined)", MAX_THREAD_LEVELS);
+      return 1;
+    }
+
+    thread_levels[n_thread_levels++] = n;
+
+    if (*end == '\0')
+      return 0;
+  }
+
+ error:
+  log_text(LOG_FATAL, "Invalid value for --threads: '%s'", s ? s : "");
+  return 1;
+}
+
+
+/* Set the number of worker threads, also exported to Lua as --threads */
+
+static void set_thread_count(unsigned int n)
+{
+  char buf[16];
+
+  sb_globals.threads = n;
+
+  snprintf(buf, sizeof(buf), "%u", n);
+  set_option("threads", buf, SB_ARG_TYPE_INT);
+}
+
 
-    report_cumulative();
-  }
+/*
+  Discard statistics left by the previous run and reset the state changed by
+  run_test(), so the test can be run again in the same process
+*/
 
-  pthread_cleanup_pop(1);
+static void reset_run(unsigned int report_interval)
+{
+  sb_stat_t stat;
 
-  return NULL;
+  checkpoint(&stat);
+  free(stat.latency_pcts);
+  free(stat.intended_latency_pcts);
+  free(stat.queue_wait_pcts);
+  free(stat.cycle_time_pcts);
+  free(stat.latency_histogram);
+
+  /* The next run may use fewer threads than slots left by this one */
+  sb_counters_reset();
+
+  sb_globals.nevents = 0;
+  sb_globals.report_interval = report_interval;
+  report_thread_created = 0;
+  checkpoints_thread_created = 0;
+  eventgen_thread_created = 0;
+  last_run_eps = 0;
+  last_run_lat_avg = 0;
 }
 
-/* Callback to start timers when all threads are ready */
 
-static int threads_started_callback(void *arg)
-{
-  (void) arg; /* unused */
+/* Print the mean, standard deviation and 95% CI of n samples scaled by mult */
 
-  /* Report initialization errors to the main thread */
-  if (sb_globals.error)
-    return 1;
+static void report_repeat_row(const char *name, const double *samples,
+                              unsigned int n, size_t stride, double mult)
+{
+  double sum = 0, sumsq = 0;
 
-  sb_globals.threads_running = sb_globals.threads;
+  for (unsigned int i = 0; i < n; i++)
+  {
+    const double v = samples[i * stride] * mult;
 
-  sb_timer_start(&sb_exec_timer);
-  sb_timer_copy(&sb_intermediate_timer, &sb_exec_timer);
-  sb_timer_copy(&sb_checkpoint_timer, &sb_exec_timer);
+    sum += v;
+    sumsq += v * v;
+  }
 
-  log_text(LOG_NOTICE, "Threads started!\n");
+  const double mean = sum / n;
+  const double sd = sqrt(SB_MAX(sumsq - sum * sum / n, 0) / (n - 1));
+  const double ci = t_quantile_95(n - 1) * sd / sqrt(n);
 
-  return 0;
+  log_text(LOG_NOTICE, "    %-28s %14.2f %12.2f %14.2f %14.2f %9.2f%%", name,
+           mean, sd, mean - ci, mean + ci, mean > 0 ? ci * 100 / mean : 0);
 }
 
 
 /*
-  Main test function: start threads, wait for them to finish and measure time.
+  Run the test --repeat times with --cooldown seconds between runs and print
+  statistics of the results. Like with thread sweeps, the loaded script and
+  any prepared data are reused, while the test is initialized and finalized
+  for each run.
 */
 
-static int run_test(sb_test_t *test)
+static int run_repeated(sb_test_t *test)
 {
-  int          err;
-  pthread_t    report_thread;
-  pthread_t    checkpoints_thread;
-  pthread_t    eventgen_thread;
-  unsigned int barrier_threads;
-  uint64_t     old_max_events = 0;
+  const unsigned int report_interval = sb_globals.report_interval;
+  const size_t       npct = sb_globals.npercentiles;
+  double             *eps, *pcts;
+  int                rc = 1;
 
-  /* initialize test */
-  if (test->ops.init != NULL && test->ops.init() != 0)
+  if (sb_cluster_mode != SB_CLUSTER_OFF)
+  {
+    log_text(LOG_FATAL, "--repeat is not supported in the cluster mode");
     return 1;
-  
-  /* print test mode */
-  print_run_mode(test);
+  }
 
-  /* initialize timers */
-  sb_timer_init(&sb_exec_timer);
-  sb_timer_init(&sb_intermediate_timer);
-  sb_timer_init(&sb_checkpoint_timer);
+  eps = malloc(repeat_runs * sizeof(double));
+  pcts = malloc(repeat_runs * (npct + 1) * sizeof(double));
+  last_run_pcts = malloc((npct + 1) * sizeof(double));
 
-  /* prepare test */
-  if (test->ops.prepare != NULL && test->ops.prepare() != 0)
-    return 1;
+  if (eps == NULL || pcts == NULL || last_run_pcts == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    goto end;
+  }
 
-  pthread_mutex_init(&sb_globals.exec_mutex, NULL);
+  for (unsigned int i = 0; i < repeat_runs; i++)
+  {
+    if (i > 0)
+    {
+      reset_run(report_interval);
 
+      if (repeat_cooldown > 0)
+      {
+        log_text(LOG_NOTICE, "Cooling down for %u second(s)...\n",
+                 repeat_cooldown);
+        sb_nanosleep(SEC2NS(repeat_cooldown));
+      }
+    }
 
-  queue_is_full = 0;
+    log_text(LOG_NOTICE, "Repeated run %u of %u\n", i + 1, repeat_runs);
 
-  sb_globals.threads_running = 0;
+    if (run_test(test))
+      goto end;
 
-  /* Calculate the required number of threads for the worker start barrier */
-  barrier_threads = 1 /* main thread */ + sb_globals.threads +
-    (sb_globals.tx_rate > 0) /* event generation thread */;
+    eps[i] = last_run_eps;
+    memcpy(pcts + i * npct, last_run_pcts, npct * sizeof(double));
+  }
 
-  if (sb_barrier_init(&worker_barrier, barrier_threads,
-                      threads_started_callback, NULL))
+  log_text(LOG_NOTICE, "Repeated runs summary (%u runs):", repeat_runs);
+  log_text(LOG_NOTICE, "    %-28s %14s %12s %14s %14s %10s", "", "mean",
+           "stddev", "95% CI low", "95% CI high", "+/-");
+
+  report_repeat_row("events/s (eps):", eps, repeat_runs, 1, 1);
+
+  for (size_t j = 0; j < npct; j++)
   {
-    log_errno(LOG_FATAL, "sb_barrier_init() failed");
-    return 1;
+    char name[64];
+
+    snprintf(name, sizeof(name), "%4.2fth percentile (ms):",
+             sb_globals.percentiles[j]);
+    report_repeat_row(name, pcts + j, repeat_runs, npct, 1000);
   }
 
-  /* Calculate the required number of threads for the report start barrier */
-  barrier_threads = 1 /* main thread */ +
-    (sb_globals.report_interval > 0) /* intermediate reports thread */ +
-    (sb_globals.n_checkpoints > 0) /* checkpoint reports thread */;
+  rc = 0;
 
-  if (sb_barrier_init(&report_barrier, barrier_threads, NULL, NULL))
+ end:
+  free(eps);
+  free(pcts);
+  free(last_run_pcts);
+  last_run_pcts = NULL;
+
+  return rc;
+}
+
+
+/*
+  Fit the Universal Scalability Law to the throughput of a thread sweep and
+  print its coefficients with the predicted peak concurrency and throughput
+*/
+
+static void print_usl_fit(const double *eps)
+{
+  double   n[MAX_THREAD_LEVELS];
+  sb_usl_t usl;
+
+  for (unsigned int i = 0; i < n_thread_levels; i++)
+    n[i] = thread_levels[i];
+
+  log_text(LOG_NOTICE, "\nUniversal Scalability Law fit:");
+
+  if (sb_usl_fit(n, eps, n_thread_levels, &usl))
   {
-    log_errno(LOG_FATAL, "sb_barrier_init() failed");
-    return 1;
+    log_text(LOG_NOTICE, "    no valid fit, need at least %d distinct "
+             "thread counts with non-zero throughput", SB_USL_MIN_POINTS);
+    return;
   }
 
+  log_text(LOG_NOTICE, "    lambda (events/s per thread):   %.2f", usl.lambda);
+  log_text(LOG_NOTICE, "    sigma (contention):             %.6f", usl.sigma);
+  log_text(LOG_NOTICE, "    kappa (coherency):              %.6f", usl.kappa);
+  log_text(LOG_NOTICE, "    R^2:                            %.4f", usl.r2);
 
-  if (sb_globals.report_interval > 0)
+  if (usl.peak_n > 0)
   {
-    /* Create a thread for intermediate statistic reports */
-    if ((err = sb_thread_create(&report_thread, &sb_thread_attr,
-                                &report_thread_proc, NULL)) != 0)
-    {
-      log_errno(LOG_FATAL,
-                "sb_thread_create() for the reporting thread failed.");
-      return 1;
-    }
+    log_text(LOG_NOTICE, "    peak concurrency:               %.1f threads",
+             usl.peak_n);
+    log_text(LOG_NOTICE, "    throughput ceiling (events/s):  %.2f",
+             usl.peak_x);
+  }
+  else if (usl.peak_x > 0)
+  {
+    log_text(LOG_NOTICE, "    peak concurrency:               none, no "
+             "coherency delays");
+    log_text(LOG_NOTICE, "    throughput ceiling (events/s):  %.2f "
+             "(asymptotic)", usl.peak_x);
   }
+  else
+  {
+    log_text(LOG_NOTICE, "    peak concurrency:               none, linear "
+             "scaling");
+    log_text(LOG_NOTICE, "    throughput ceiling (events/s):  none");
+  }
+}
 
-  if (sb_globals.tx_rate > 0)
+
+/*
+  Run the test at each concurrency level from --threads in turn and print a
+  scaling table. The test is initialized and finalized for each level, but the
+  loaded script and any prepared data are reused.
+*/
+
+static int run_thread_sweep(sb_test_t *test)
+{
+  const unsigned int max_threads = sb_globals.threads;
+  const unsigned int report_interval = sb_globals.report_interval;
+  double             eps[MAX_THREAD_LEVELS];
+  double             base;
+
+  if (sb_cluster_mode != SB_CLUSTER_OFF)
   {
-    if ((err = sb_thread_create(&eventgen_thread, &sb_thread_attr,
-                                &eventgen_thread_proc, NULL)) != 0)
-    {
-      log_errno(LOG_FATAL,
-                "sb_thread_create() for the reporting thread failed.");
-      return 1;
-    }
+    log_text(LOG_FATAL, "Multiple --threads values are not supported in the "
+             "cluster mode");
+    return 1;
   }
 
-  if (sb_globals.n_checkpoints > 0)
+  for (unsigned int i = 0; i < n_thread_levels; i++)
   {
-    /* Create a thread for checkpoint statistic reports */
-    if ((err = sb_thread_create(&checkpoints_thread, &sb_thread_attr,
-                                &checkpoints_thread_proc, NULL)) != 0)
+    if (i > 0)
     {
-      log_errno(LOG_FATAL,
-                "sb_thread_create() for the checkpoint thread failed.");
+      /* Discard statistics left by previous runs in all per-thread slots */
+      sb_globals.threads = max_threads;
+      reset_run(report_interval);
+    }
+
+    log_text(LOG_NOTICE, "Thread scaling run %u of %u: %u thread(s)\n", i + 1,
+             n_thread_levels, thread_levels[i]);
+
+    set_thread_count(thread_levels[i]);
+
+    if (run_test(test))
       return 1;
+
+    eps[i] = last_run_eps;
+  }
+
+  /* Efficiency is relative to linear scaling from the single-thread rate */
+  base = 0;
+  for (unsigned int i = 0; i < n_thread_levels; i++)
+    if (thread_levels[i] == 1)
+    {
+      base = eps[i];
+      break;
     }
+
+  if (base == 0)
+    base = eps[0] / thread_levels[0];
+
+  log_text(LOG_NOTICE, "Thread scaling:");
+  log_text(LOG_NOTICE, "%10s %15s %10s %11s", "threads", "events/s",
+           "speedup", "efficiency");
+
+  for (unsigned int i = 0; i < n_thread_levels; i++)
+  {
+    const double speedup = base > 0 ? eps[i] / base : 0;
+
+    log_text(LOG_NOTICE, "%10u %15.2f %10.2f %10.1f%%", thread_levels[i],
+             eps[i], speedup, speedup * 100 / thread_levels[i]);
   }
 
-  if ((err = sb_thread_create_workers(&worker_thread)))
-    return err;
+  if (n_thread_levels >= SB_USL_MIN_POINTS)
+    print_usl_fit(eps);
 
-#ifdef HAVE_ALARM
-  /* Exit with an error if thread initialization timeout expires */
-  signal(SIGALRM, sigalrm_thread_init_timeout_handler);
+  return 0;
+}
 
-  alarm(thread_init_timeout);
-#endif
 
-  if (sb_globals.warmup_time > 0)
+/*
+  Run the test for each point of its own sweep (see sb_operations_t.sweep),
+  e.g. the queue depth sweep of fileio, and print throughput and latency of
+  each point. The knee is the last point before latency grows by a larger
+  factor than throughput, i.e. where adding concurrency starts to mostly add
+  queueing. Latency is the highest --percentile, or the average one with
+  --percentile=0.
+*/
+
+static int run_test_sweep(sb_test_t *test, unsigned int npoints)
+{
+  const unsigned int max_threads = sb_globals.threads;
+  const unsigned int report_interval = sb_globals.report_interval;
+  const size_t       npct = sb_globals.npercentiles;
+  unsigned int       values[MAX_THREAD_LEVELS];
+  double             eps[MAX_THREAD_LEVELS];
+  double             avg[MAX_THREAD_LEVELS];
+  double             lat[MAX_THREAD_LEVELS];
+  double             *pcts;
+  unsigned int       threads;
+  int                knee = -1;
+  int                top_pct = -1;
+  int                rc = 1;
+
+  for (size_t j = 0; j < npct; j++)
   {
-    /* Disable the max_events limit for the warmup stage */
-    old_max_events = sb_globals.max_events;
-    sb_globals.max_events = 0;
+    const double p = sb_globals.percentiles[j];
+
+    if (p > 0 && (top_pct < 0 || p > sb_globals.percentiles[top_pct]))
+      top_pct = j;
   }
 
-  if (sb_barrier_wait(&worker_barrier) < 0)
+  if (sb_cluster_mode != SB_CLUSTER_OFF)
   {
-    log_text(LOG_FATAL, "Threads initialization failed!");
+    log_text(LOG_FATAL, "%s sweeps are not supported in the cluster mode",
+             test->sweep_name);
     return 1;
   }
 
-#ifdef HAVE_ALARM
-  alarm(0);
+  pcts = malloc(npoints * (npct + 1) * sizeof(double));
+  last_run_pcts = malloc((npct + 1) * sizeof(double));
 
-  if (sb_globals.force_shutdown)
+  if (pcts == NULL || last_run_pcts == NULL)
   {
-    /* Set the alarm to force shutdown */
-    signal(SIGALRM, sigalrm_forced_shutdown_handler);
+    log_text(LOG_FATAL, "Memory allocation failure");
+    goto end;
+  }
 
-    alarm(NS2SEC(sb_globals.max_time_ns) + sb_globals.timeout);
+  for (unsigned int i = 0; i < npoints; i++)
+  {
+    if (i > 0)
+    {
+      /* Discard statistics left by previous runs in all per-thread slots */
+      sb_globals.threads = max_threads;
+      reset_run(report_interval);
+    }
+
+    threads = max_threads;
+
+    if (test->ops.sweep(i, &threads, &values[i]) != 1)
+      goto end;
+
+    log_text(LOG_NOTICE, "Sweep run %u of %u: %s %u, %u thread(s)\n", i + 1,
+             npoints, test->sweep_name, values[i], threads);
+
+    set_thread_count(threads);
+
+    if (run_test(test))
+      goto end;
+
+    eps[i] = last_run_eps;
+    avg[i] = last_run_lat_avg;
+    lat[i] = top_pct >= 0 ? last_run_pcts[top_pct] : avg[i];
+    memcpy(pcts + i * npct, last_run_pcts, npct * sizeof(double));
   }
-#endif
 
-  if (sb_globals.warmup_time > 0)
+  for (unsigned int i = 1; i < npoints && knee < 0; i++)
+    if (eps[i - 1] > 0 && lat[i - 1] > 0 &&
+        lat[i] / lat[i - 1] > eps[i] / eps[i - 1])
+      knee = i - 1;
+
+  log_text(LOG_NOTICE, "Sweep of %s:", test->sweep_name);
+
+  char   buf[512];
+  size_t len = snprintf(buf, sizeof(buf), "%12s %15s %12s", test->sweep_name,
+                        "events/s", "avg (ms)");
+
+  for (size_t j = 0; j < npct && len < sizeof(buf); j++)
   {
-    log_text(LOG_NOTICE, "Warming up for %d seconds...\n",
-             sb_globals.warmup_time);
+    char name[32];
 
-    usleep(sb_globals.warmup_time * 1000000);
+    snprintf(name, sizeof(name), "%gth (ms)", sb_globals.percentiles[j]);
+    len += snprintf(buf + len, sizeof(buf) - len, " %12s", name);
+  }
 
-    /* Re-enable the max_events limit, if it was set */
-    ck_pr_store_64(&sb_globals.max_events, old_max_events);
+  log_text(LOG_NOTICE, "%s", buf);
 
-    /* Perform a checkpoint to reset previously collected stats */
-    sb_stat_t stat;
-    checkpoint(&stat);
-    free(stat->latency_pcts);
+  for (unsigned int i = 0; i < npoints; i++)
+  {
+    len = snprintf(buf, sizeof(buf), "%12u %15.2f %12.3f", values[i], eps[i],
+                   avg[i] * 1000);
+
+    for (size_t j = 0; j < npct && len < sizeof(buf); j++)
+      len += snprintf(buf + len, sizeof(buf) - len, " %12.3f",
+                      pcts[i * npct + j] * 1000);
+
+    log_text(LOG_NOTICE, "%s%s", buf, (int) i == knee ? "  <- knee" : "");
   }
 
-  /* Signal the report threads to start reporting */
-  if (sb_barrier_wait(&report_barrier) < 0)
+  if (knee >= 0)
+    log_text(LOG_NOTICE, "Knee: %s %u, latency grows faster than throughput "
+             "beyond it", test->sweep_name, values[knee]);
+  else
+    log_text(LOG_NOTICE, "Knee: not found, latency did not grow faster than "
+             "throughput");
+
+  rc = 0;
+
+ end:
+  free(pcts);
+  free(last_run_pcts);
+  last_run_pcts = NULL;
+
+  return rc;
+}
+
+
+/*
+  Count points of a test-specific sweep. Returns 0 if the test has no sweep
+  configured, or -1 on errors.
+*/
+
+static int count_sweep_points(sb_test_t *test)
+{
+  unsigned int threads, value;
+  int          n, rc;
+
+  if (test->ops.sweep == NULL)
+    return 0;
+
+  for (n = 0; n < MAX_THREAD_LEVELS; n++)
   {
-    log_text(LOG_FATAL, "Failed to signal reporting threads");
-    return 1;
+    threads = sb_globals.threads;
+
+    if ((rc = test->ops.sweep(n, &threads, &value)) != 1)
+      return rc < 0 ? -1 : n;
+
+    if (threads == 0 || threads > sb_globals.threads)
+    {
+      log_text(LOG_FATAL, "%s %u requires %u threads, but the maximum is "
+               "--threads=%u", test->sweep_name, value, threads,
+               sb_globals.threads);
+      return -1;
+    }
   }
 
-  if ((err = sb_thread_join_workers()))
-    return err;
+  log_text(LOG_FATAL, "Too many %s values (up to %d can be defined)",
+           test->sweep_name, MAX_THREAD_LEVELS);
 
-  sb_timer_stop(&sb_exec_timer);
-  sb_timer_stop(&sb_intermediate_timer);
-  sb_timer_stop(&sb_checkpoint_timer);
+  return -1;
+}
 
-  /* Silence periodic reports if they were on */
-  ck_pr_store_uint(&sb_globals.report_interval, 0);
 
-#ifdef HAVE_ALARM
-  alarm(0);
-#endif
+/*
+  Re-read the general options which can be changed by --scenario steps, see
+  scenario_general_opts[] in sb_scenario.c
+*/
 
-  log_text(LOG_INFO, "Done.\n");
+static int scenario_read_options(unsigned int max_threads, int base_rate)
+{
+  const int threads = sb_get_value_int("threads");
+  const int events = sb_get_value_int("events");
+  const int time = sb_get_value_int("time");
+  const int rate = sb_get_value_int("rate");
+  const int warmup_time = sb_get_value_int("warmup-time");
 
-  /* cleanup test */
-  if (test->ops.cleanup != NULL && test->ops.cleanup() != 0)
+  if (threads < 1 || (unsigned int) threads > max_threads)
+  {
+    log_text(LOG_FATAL, "Invalid value for --threads: %d, scenario steps "
+             "can use between 1 and %u threads", threads, max_threads);
     return 1;
+  }
 
-  if (report_thread_created)
+  if (events < 0 || time < 0 || warmup_time < 0)
   {
-    if (sb_thread_cancel(report_thread) || sb_thread_join(report_thread, NULL))
-      log_errno(LOG_FATAL, "Terminating the reporting thread failed.");
+    log_text(LOG_FATAL, "Invalid value for --events, --time or "
+             "--warmup-time in a scenario step");
+    return 1;
   }
 
-  if (eventgen_thread_created)
+  /* Rate limiting structures are only set up with a non-zero --rate */
+  if (rate < 0 || (rate > 0) != (base_rate > 0))
   {
-    if (sb_thread_cancel(eventgen_thread) ||
-        sb_thread_join(eventgen_thread, NULL))
-      log_text(LOG_FATAL, "Terminating the event generator thread failed.");
+    log_text(LOG_FATAL, "Invalid value for --rate: %d, scenario steps can "
+             "only change a non-zero --rate to another non-zero value", rate);
+    return 1;
   }
 
-  if (checkpoints_thread_created)
+  sb_globals.threads = (unsigned int) threads;
+  sb_globals.max_events = (uint64_t) events;
+  sb_globals.tx_rate = rate;
+  sb_globals.warmup_time = warmup_time;
+  sb_globals.max_time_ns = time > 0 ? SEC2NS(time + warmup_time) : 0;
+
+  return 0;
+}
+
+
+/*
+  Execute the steps of --scenario in turn. Statistics are reported for each
+  run step, while warmup steps only discard them. Lua states of worker threads
+  are kept between steps, so thread_init() is called once per thread before
+  its first run, and thread_done() after the last step.
+*/
+
+static int run_scenario(sb_test_t *test)
+{
+  const unsigned int max_threads = sb_globals.threads;
+  const unsigned int report_interval = sb_globals.report_interval;
+  const int          base_rate = sb_globals.tx_rate;
+  bool               ran = false;
+  int                rc = 1;
+
+  if (sb_cluster_mode != SB_CLUSTER_OFF || sb_groups_enabled() ||
+      sb_profile_enabled() || slo_latency > 0 || repeat_runs > 1 ||
+      n_thread_levels > 1 || sb_globals.warmup_steady_state > 0)
   {
-    if (sb_thread_cancel(checkpoints_thread) ||
-        sb_thread_join(checkpoints_thread, NULL))
-      log_errno(LOG_FATAL, "Terminating the checkpoint thread failed.");
+    log_text(LOG_FATAL, "--scenario cannot be used with the cluster mode, "
+             "--thread-groups, --profile, --slo-latency, --repeat, "
+             "--warmup-steady-state or a list of --threads values");
+    return 1;
   }
 
-  /* print test-specific stats */
-  if (!sb_globals.error)
+  if (sb_scenario_init(test))
+    goto end;
+
+  if (sb_lua_loaded())
+    sb_lua_keep_states();
+
+  for (unsigned int i = 0; i < sb_scenario_steps(); i++)
   {
-    if (sb_globals.histogram)
+    const char * const cmd = sb_scenario_step_command(i);
+    int                err;
+
+    log_text(LOG_NOTICE, "Scenario step %u of %u: %s\n", i + 1,
+             sb_scenario_steps(), sb_scenario_step_name(i));
+
+    if (sb_scenario_step_start(i))
+      goto end;
+
+    if (!strcmp(cmd, SB_SCENARIO_RUN) || !strcmp(cmd, SB_SCENARIO_WARMUP))
     {
-      log_text(LOG_NOTICE, "Latency histogram (values are in milliseconds)");
-      sb_histogram_print(&sb_latency_histogram);
-      log_text(LOG_NOTICE, " ");
+      if (ran)
+      {
+        /* Discard statistics left by previous runs in all per-thread slots */
+        sb_globals.threads = max_threads;
+        reset_run(report_interval);
+      }
+      ran = true;
+
+      err = scenario_read_options(max_threads, base_rate);
+      if (!err)
+      {
+        set_thread_count(sb_globals.threads);
+
+        scenario_warmup = !strcmp(cmd, SB_SCENARIO_WARMUP);
+        err = run_test(test);
+        scenario_warmup = false;
+      }
     }
+    else if (sb_lua_loaded() && sb_lua_custom_command_defined(cmd))
+      err = sb_lua_call_custom_command(cmd);
+    else if (!strcmp(cmd, "prepare"))
+      err = test->builtin_cmds.prepare();
+    else
+      err = test->builtin_cmds.cleanup();
 
-    report_cumulative();
+    sb_scenario_step_end(i);
+
+    if (err)
+      goto end;
   }
 
-  pthread_mutex_destroy(&sb_globals.exec_mutex);
+  rc = 0;
 
-  /* finalize test */
-  if (test->ops.done != NULL)
-    (*(test->ops.done))();
+ end:
+  if (sb_lua_loaded() && sb_lua_release_states())
+    rc = 1;
 
-  return sb_globals.error != 0;
+  sb_scenario_done();
+
+  return rc;
 }
 
 
@@ -1269,6 +4562,131 @@ static int checkpoint_cmp(const void *a_ptr, const void *b_ptr)
 }
 
 
+/* Parse --slo-latency and related options */
+
+static int init_slo(void)
+{
+  slo_latency = sb_get_value_double("slo-latency");
+  if (slo_latency < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --slo-latency: %f", slo_latency);
+    return 1;
+  }
+
+  if (slo_latency == 0)
+    return 0;
+
+  slo_percentile = sb_get_value_double("slo-percentile");
+  if (slo_percentile <= 0 || slo_percentile > 100)
+  {
+    log_text(LOG_FATAL, "Invalid value for --slo-percentile: %f",
+             slo_percentile);
+    return 1;
+  }
+
+  if (sb_get_value_int("slo-probe-time") <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --slo-probe-time: %d",
+             sb_get_value_int("slo-probe-time"));
+    return 1;
+  }
+  slo_probe_time = sb_get_value_int("slo-probe-time");
+
+  slo_precision = sb_get_value_double("slo-precision");
+  if (slo_precision <= 0 || slo_precision >= 100)
+  {
+    log_text(LOG_FATAL, "Invalid value for --slo-precision: %f",
+             slo_precision);
+    return 1;
+  }
+
+  if (sb_get_value_int("slo-max-probes") <= 0 ||
+      sb_get_value_int("slo-max-probes") > SLO_MAX_PROBES)
+  {
+    log_text(LOG_FATAL, "Invalid value for --slo-max-probes: %d (up to %d "
+             "probes can be run)", sb_get_value_int("slo-max-probes"),
+             SLO_MAX_PROBES);
+    return 1;
+  }
+  slo_max_probes = sb_get_value_int("slo-max-probes");
+
+  if (sb_globals.tx_rate == 0)
+  {
+    log_text(LOG_FATAL, "--slo-latency requires --rate as the initial probe "
+             "rate");
+    return 1;
+  }
+
+  if (sb_profile_enabled() || n_thread_levels > 1 ||
+      !SB_LIST_IS_EMPTY(sb_get_value_list("report-checkpoints")))
+  {
+    log_text(LOG_FATAL, "--slo-latency cannot be used with --profile, "
+             "--report-checkpoints or a list of --threads values");
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Parse --stop-ci and --stop-min-time */
+
+static int init_auto_stop(void)
+{
+  stop_ci = sb_get_value_double("stop-ci");
+  if (stop_ci < 0 || stop_ci >= 100)
+  {
+    log_text(LOG_FATAL, "Invalid value for --stop-ci: %f", stop_ci);
+    return 1;
+  }
+
+  if (sb_get_value_int("stop-min-time") < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --stop-min-time: %d",
+             sb_get_value_int("stop-min-time"));
+    return 1;
+  }
+  stop_min_time = sb_get_value_int("stop-min-time");
+
+  if (stop_ci > 0 && (slo_latency > 0 || sb_profile_enabled()))
+  {
+    log_text(LOG_FATAL, "--stop-ci cannot be used with --slo-latency or "
+             "--profile");
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Parse --repeat and --cooldown */
+
+static int init_repeat(void)
+{
+  if (sb_get_value_int("repeat") < 1)
+  {
+    log_text(LOG_FATAL, "Invalid value for --repeat: %d",
+             sb_get_value_int("repeat"));
+    return 1;
+  }
+  repeat_runs = (unsigned int) sb_get_value_int("repeat");
+
+  if (sb_get_value_int("cooldown") < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --cooldown: %d",
+             sb_get_value_int("cooldown"));
+    return 1;
+  }
+  repeat_cooldown = (unsigned int) sb_get_value_int("cooldown");
+
+  if (repeat_runs > 1 && (n_thread_levels > 1 || slo_latency > 0))
+  {
+    log_text(LOG_FATAL, "--repeat cannot be used with --slo-latency or a list "
+             "of --threads values");
+    return 1;
+  }
+
+  return 0;
+}
+
 static int init(void)
 {
   option_t *opt;
@@ -1277,17 +4695,91 @@ static int init(void)
   sb_list_item_t    *pos_val;
   value_t           *val;
 
-  sb_globals.threads = sb_get_value_int("threads");
+  if (parse_thread_levels(sb_get_value_string("threads")))
+    return 1;
+
+  if (sb_groups_init())
+    return 1;
+
+  if (sb_groups_enabled())
+  {
+    if (n_thread_levels > 1)
+    {
+      log_text(LOG_FATAL, "--thread-groups cannot be used with a list of "
+               "--threads values");
+      return 1;
+    }
+
+    thread_levels[0] = sb_groups_threads();
+  }
+
+  /* Per-thread structures are allocated for the highest concurrency level */
+  unsigned int max_threads = 0;
+  for (unsigned int i = 0; i < n_thread_levels; i++)
+    max_threads = SB_MAX(max_threads, thread_levels[i]);
+  set_thread_count(max_threads);
 
   thread_init_timeout = sb_get_value_int("thread-init-timeout");
-  
-  if (sb_globals.threads <= 0)
+  worker_memory = sb_get_value_flag("worker-memory");
+
+  if (sb_get_value_int("event-batch") <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --event-batch: %d.\n",
+             sb_get_value_int("event-batch"));
+    return 1;
+  }
+  sb_globals.event_batch = sb_get_value_int("event-batch");
+
+  if (sb_get_value_int("virtual-users") <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --virtual-users: %d.\n",
+             sb_get_value_int("virtual-users"));
+    return 1;
+  }
+  sb_globals.virtual_users = sb_get_value_int("virtual-users");
+
+  const int duty_cycle = sb_get_value_int("duty-cycle");
+  if (duty_cycle <= 0 || duty_cycle > 100)
+  {
+    log_text(LOG_FATAL, "Invalid value for --duty-cycle: %d.", duty_cycle);
+    return 1;
+  }
+
+  const int duty_period = sb_get_value_int("duty-period");
+  if (duty_period <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --duty-period: %d.", duty_period);
+    return 1;
+  }
+
+  if (duty_cycle < 100)
+  {
+    duty_period_ns = (uint64_t) duty_period * 1000000;
+    duty_on_ns = duty_period_ns * (uint64_t) duty_cycle / 100;
+  }
+
+  sb_globals.think_time = sb_get_value_double("think-time");
+  if (sb_globals.think_time < 0)
   {
-    log_text(LOG_FATAL, "Invalid value for --threads: %d.\n",
-             sb_globals.threads);
+    log_text(LOG_FATAL, "Invalid value for --think-time: %f.\n",
+             sb_globals.think_time);
     return 1;
   }
 
+  const char *think_dist_name = sb_get_value_string("think-time-type");
+  if (!strcmp(think_dist_name, "fixed"))
+    think_dist = THINK_FIXED;
+  else if (!strcmp(think_dist_name, "exponential"))
+    think_dist = THINK_EXPONENTIAL;
+  else if (!strcmp(think_dist_name, "uniform"))
+    think_dist = THINK_UNIFORM;
+  else
+  {
+    log_text(LOG_FATAL, "Invalid value for --think-time-type: %s",
+             think_dist_name);
+    return 1;
+  }
+  
   sb_globals.max_events = sb_get_value_int("events");
 
   sb_globals.warmup_time = sb_get_value_int("warmup-time");
@@ -1298,7 +4790,71 @@ static int init(void)
     return 1;
   }
 
-  int max_time = sb_get_value_int("time");
+  sb_globals.warmup_steady_state = sb_get_value_double("warmup-steady-state");
+  if (sb_globals.warmup_steady_state < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --warmup-steady-state: %f.\n",
+             sb_globals.warmup_steady_state);
+    return 1;
+  }
+
+  if (sb_get_value_int("warmup-window") < 2)
+  {
+    log_text(LOG_FATAL, "Invalid value for --warmup-window: %d.\n",
+             sb_get_value_int("warmup-window"));
+    return 1;
+  }
+  sb_globals.warmup_window = sb_get_value_int("warmup-window");
+
+  sb_globals.warmup_max_time = sb_get_value_int("warmup-max-time");
+  if (sb_globals.warmup_steady_state > 0 &&
+      (sb_globals.warmup_max_time < sb_globals.warmup_time ||
+       sb_globals.warmup_max_time < (int) sb_globals.warmup_window))
+  {
+    log_text(LOG_FATAL, "--warmup-max-time must be at least --warmup-time "
+             "and --warmup-window\n");
+    return 1;
+  }
+
+  sb_globals.tx_rate = sb_get_value_int("rate");
+
+  if (sb_groups_rate() > 0)
+  {
+    if (sb_globals.tx_rate > 0)
+    {
+      log_text(LOG_FATAL, "--rate cannot be used with --thread-groups rates");
+      return 1;
+    }
+    sb_globals.tx_rate = sb_groups_rate();
+  }
+
+  if (sb_groups_enabled() && sb_get_value_list("profile") != NULL &&
+      !SB_LIST_IS_EMPTY(sb_get_value_list("profile")))
+  {
+    log_text(LOG_FATAL, "--profile cannot be used with --thread-groups");
+    return 1;
+  }
+
+  if (sb_profile_init())
+    return 1;
+
+  if (sb_profile_enabled() && n_thread_levels > 1)
+  {
+    log_text(LOG_FATAL, "--profile cannot be used with a list of --threads "
+             "values");
+    return 1;
+  }
+
+  if (init_slo() || init_auto_stop() || init_repeat())
+    return 1;
+
+  /*
+    A load profile defines the run duration, and the SLO search ends the run
+    when done
+  */
+  int max_time = sb_profile_enabled() ?
+    (int) sb_profile_phase_end(sb_profile_phases() - 1) :
+    slo_latency > 0 ? 0 : sb_get_value_int("time");
 
   sb_globals.max_time_ns = SEC2NS(max_time);
 
@@ -1308,8 +4864,13 @@ static int init(void)
 
   if (sb_globals.max_time_ns > 0)
   {
-    /* Adjust the time limit if warmup time has been requested */
-    if (sb_globals.warmup_time > 0)
+    /*
+      Adjust the time limit if warmup time has been requested. With a steady
+      state criterion it is reduced once the warmup ends.
+    */
+    if (sb_globals.warmup_steady_state > 0)
+      sb_globals.max_time_ns += SEC2NS(sb_globals.warmup_max_time);
+    else if (sb_globals.warmup_time > 0)
     {
       sb_globals.max_time_ns += SEC2NS(sb_globals.warmup_time);
     }
@@ -1344,6 +4905,10 @@ static int init(void)
   if ((err = sb_thread_init()))
     return err;
 
+  if (sb_perf_init() || sb_usage_init() || sb_pressure_init() ||
+      sb_energy_init() || sb_cpufreq_init() || sb_smt_init())
+    return 1;
+
   sb_globals.debug = sb_get_value_flag("debug");
   /* Automatically set logger verbosity to 'debug' */
   if (sb_globals.debug)
@@ -1360,9 +4925,67 @@ static int init(void)
     return 1;
   }
 
-  sb_globals.tx_rate = sb_get_value_int("rate");
+  if (sb_rate_init())
+    return 1;
+
+  const char *rate_mode = sb_get_value_string("rate-mode");
+  if (!strcmp(rate_mode, "worker"))
+    rate_per_worker = true;
+  else if (strcmp(rate_mode, "generator"))
+  {
+    log_text(LOG_FATAL, "Invalid value for --rate-mode: %s", rate_mode);
+    return 1;
+  }
+
+  /* Each group schedules events at its own rate in its worker threads */
+  if (sb_groups_rate() > 0)
+    rate_per_worker = true;
+
+  const char *queue_full = sb_get_value_string("rate-queue-full");
+  if (!strcmp(queue_full, "terminate"))
+    queue_full_policy = QUEUE_FULL_TERMINATE;
+  else if (!strcmp(queue_full, "drop"))
+    queue_full_policy = QUEUE_FULL_DROP;
+  else if (!strcmp(queue_full, "grow"))
+    queue_full_policy = QUEUE_FULL_GROW;
+  else
+  {
+    log_text(LOG_FATAL, "Invalid value for --rate-queue-full: %s", queue_full);
+    return 1;
+  }
+
+  const int queue_size_opt = sb_get_value_int("rate-queue-size");
+  if (queue_size_opt < 2 || queue_size_opt > (1 << 30))
+  {
+    log_text(LOG_FATAL, "Invalid value for --rate-queue-size: %d",
+             queue_size_opt);
+    return 1;
+  }
+
+  /* ck_ring requires a power of 2 */
+  for (queue_size = 2; queue_size < (unsigned int) queue_size_opt;
+       queue_size *= 2)
+    ;
+
+  if (sb_get_value_int("latency-sample-rate") <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --latency-sample-rate: %d.\n",
+             sb_get_value_int("latency-sample-rate"));
+    return 1;
+  }
+  sb_globals.latency_sample_rate = sb_get_value_int("latency-sample-rate");
+  sb_globals.intended_latency = sb_get_value_flag("intended-latency");
+  if (sb_globals.intended_latency && sb_globals.tx_rate == 0)
+  {
+    log_text(LOG_FATAL, "--intended-latency requires --rate");
+    return 1;
+  }
+
+  if (parse_report_interval(sb_get_value_string("report-interval")))
+    return 1;
 
-  sb_globals.report_interval = sb_get_value_int("report-interval");
+  if (sb_cluster_init() || sb_control_init() || sb_metrics_init())
+    return 1;
 
   sb_globals.n_checkpoints = 0;
   checkpoints_list = sb_get_value_list("report-checkpoints");
@@ -1388,6 +5011,28 @@ static int init(void)
     sb_globals.checkpoints[sb_globals.n_checkpoints-1] = (unsigned int) res;
   }
 
+  /* Report each --profile phase but the last one at its end */
+  for (unsigned int i = 0; i + 1 < sb_profile_phases(); i++)
+  {
+    const unsigned int end = sb_profile_phase_end(i);
+    unsigned int       j;
+
+    for (j = 0; j < sb_globals.n_checkpoints; j++)
+      if (sb_globals.checkpoints[j] == end)
+        break;
+
+    if (j < sb_globals.n_checkpoints)
+      continue;
+
+    if (++sb_globals.n_checkpoints > MAX_CHECKPOINTS)
+    {
+      log_text(LOG_FATAL, "Too many checkpoints in --report-checkpoints and "
+               "--profile (up to %d can be defined)", MAX_CHECKPOINTS);
+      return 1;
+    }
+    sb_globals.checkpoints[sb_globals.n_checkpoints-1] = end;
+  }
+
   if (sb_globals.n_checkpoints > 0)
   {
     qsort(sb_globals.checkpoints, sb_globals.n_checkpoints,
@@ -1397,8 +5042,9 @@ static int init(void)
   /* Initialize timers */
   timers = sb_alloc_per_thread_array(sizeof(sb_timer_t));
   timers_copy = sb_alloc_per_thread_array(sizeof(sb_timer_t));
+  start_offsets = sb_alloc_per_thread_array(sizeof(uint64_t));
 
-  if (timers == NULL || timers_copy == NULL)
+  if (timers == NULL || timers_copy == NULL || start_offsets == NULL)
   {
     log_text(LOG_FATAL, "Memory allocation failure");
     return 1;
@@ -1407,8 +5053,48 @@ static int init(void)
   for (unsigned i = 0; i < sb_globals.threads; i++)
     sb_timer_init(&timers[i]);
 
+  if (sb_thread_stats_init() || sb_latency_log_init() ||
+      sb_histogram_log_init() || sb_tracectx_init() || sb_slow_log_init() ||
+      sb_sched_init() || sb_user_stats_init() || sb_result_init())
+    return 1;
+
+  if (sb_globals.intended_latency)
+  {
+    intended_starts =
+      sb_alloc_per_thread_array(sizeof(sb_intended_start_t));
+    if (intended_starts == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+  }
+
+  if (sb_globals.tx_rate > 0 && !rate_per_worker)
+  {
+    queue_array = malloc(queue_size * sizeof(uint64_t));
+    queue_ring_buffer = malloc(queue_size * sizeof(ck_ring_buffer_t));
+    if (queue_array == NULL || queue_ring_buffer == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+  }
+
+  if (sb_globals.tx_rate > 0 && rate_per_worker)
+  {
+    pacing = sb_alloc_per_thread_array(sizeof(sb_pacing_t));
+    if (pacing == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+  }
+
   /* LuaJIT commands */
   sb_globals.luajit_cmd = sb_get_value_string("luajit-cmd");
+  sb_globals.lean_workers = sb_get_value_flag("lean-workers");
+  sb_globals.lua_profile = sb_get_value_flag("lua-profile");
+  sb_globals.lua_trace_aborts = sb_get_value_flag("lua-trace-aborts");
 
   return 0;
 }
@@ -1457,6 +5143,13 @@ int main(int argc, char *argv[])
   if (init() || log_init() || sb_counters_init())
     return EXIT_FAILURE;
 
+  if (sb_get_value_string("latency-log-csv") != NULL)
+  {
+    rc = sb_latency_log_to_csv(sb_get_value_string("latency-log-csv")) ?
+      EXIT_FAILURE : EXIT_SUCCESS;
+    goto end;
+  }
+
   print_header();
 
   if (sb_globals.testname != NULL && strcmp(sb_globals.testname, "-"))
@@ -1472,11 +5165,30 @@ int main(int argc, char *argv[])
       return EXIT_FAILURE;
     }
 
+    /* Is it a native test plugin? */
+    if (test == NULL && sb_plugin_name(sb_globals.testname))
+    {
+      if ((test = sb_plugin_load(sb_globals.testname)) == NULL)
+        return EXIT_FAILURE;
+
+      if (sb_globals.cmdname == NULL)
+      {
+        fprintf(stderr, "The '%s' test requires a command argument. "
+                "See 'sysbench %s help'\n", sb_globals.testname,
+                sb_globals.testname);
+        return EXIT_FAILURE;
+      }
+    }
+
     if (test == NULL)
     {
       if ((test = sb_load_lua(sb_globals.testname)) == NULL)
         return EXIT_FAILURE;
 
+      if (sb_get_value_flag("native") &&
+          (test = sb_oltp_native(test)) == NULL)
+        return EXIT_FAILURE;
+
       if (sb_globals.cmdname == NULL)
       {
         /* No command specified, there's nothing more todo */
@@ -1553,7 +5265,30 @@ int main(int argc, char *argv[])
   }
   else if (!strcmp(sb_globals.cmdname, "run"))
   {
-    rc = run_test(test) ? EXIT_FAILURE : EXIT_SUCCESS;
+    const int sweep_points = sb_scenario_enabled() ? 0 :
+      count_sweep_points(test);
+
+    if (sweep_points > 0 && (n_thread_levels > 1 || repeat_runs > 1))
+    {
+      log_text(LOG_FATAL, "A %s sweep cannot be combined with a list of "
+               "--threads values or --repeat", test->sweep_name);
+      rc = EXIT_FAILURE;
+    }
+    else if (sweep_points < 0)
+      rc = EXIT_FAILURE;
+    else if (sb_scenario_enabled())
+      rc = run_scenario(test) ? EXIT_FAILURE : EXIT_SUCCESS;
+    else if (sweep_points > 0)
+      rc = run_test_sweep(test, sweep_points) ? EXIT_FAILURE : EXIT_SUCCESS;
+    else if (n_thread_levels > 1)
+      rc = run_thread_sweep(test) ? EXIT_FAILURE : EXIT_SUCCESS;
+    else if (repeat_runs > 1)
+      rc = run_repeated(test) ? EXIT_FAILURE : EXIT_SUCCESS;
+    else
+      rc = run_test(test) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    if (sb_result_regressed())
+      rc = EXIT_FAILURE;
   }
   else
   {
@@ -1574,11 +5309,38 @@ end:
   sb_options_done();
 
   sb_rand_done();
+  sb_rate_done();
+  sb_profile_done();
+  sb_control_done();
+  sb_metrics_done();
+  sb_groups_done();
+  sb_thread_stats_done();
+  sb_latency_log_done();
+  sb_histogram_log_done();
+  sb_tracectx_done();
+  sb_slow_log_done();
+  sb_sched_done();
+  sb_user_stats_done();
+  sb_shared_done();
+  sb_result_done();
 
   sb_thread_done();
 
+  sb_perf_done();
+
+  sb_usage_done();
+  sb_cpufreq_done();
+  sb_smt_done();
+  sb_plugin_done();
+
   free(timers);
   free(timers_copy);
+  free(start_offsets);
+  free(intended_starts);
+  free(pacing);
+  free(queue_array);
+  free(queue_ring_buffer);
+  free(queue_overflow);
 
   free(sb_globals.argv);
 
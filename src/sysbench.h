@@ -37,12 +37,24 @@
 #include "sb_options.h"
 #include "sb_timer.h"
 #include "sb_logger.h"
+#include "sb_perf.h"
 
 #include "tests/sb_cpu.h"
 #include "tests/sb_fileio.h"
 #include "tests/sb_memory.h"
 #include "tests/sb_threads.h"
 #include "tests/sb_mutex.h"
+#include "tests/sb_atomic.h"
+#include "tests/sb_c2c.h"
+#include "tests/sb_wakeup.h"
+#include "tests/sb_queue.h"
+#include "tests/sb_malloc.h"
+#include "tests/sb_syscall.h"
+#include "tests/sb_wal.h"
+#include "tests/sb_metadata.h"
+#include "tests/sb_net.h"
+#include "tests/sb_kv.h"
+#include "tests/sb_clock.h"
 
 /* Macros to control global execution mutex */
 #define SB_THREAD_MUTEX_LOCK() pthread_mutex_lock(&sb_globals.exec_mutex) 
@@ -62,6 +74,15 @@ typedef enum
   SB_REQ_TYPE_SQL,
   SB_REQ_TYPE_THREADS,
   SB_REQ_TYPE_MUTEX,
+  SB_REQ_TYPE_ATOMIC,
+  SB_REQ_TYPE_MALLOC,
+  SB_REQ_TYPE_SYSCALL,
+  SB_REQ_TYPE_WAL,
+  SB_REQ_TYPE_METADATA,
+  SB_REQ_TYPE_NET,
+  SB_REQ_TYPE_KV,
+  SB_REQ_TYPE_CLOCK,
+  SB_REQ_TYPE_PLUGIN,
   SB_REQ_TYPE_SCRIPT
 } sb_event_type_t;
 
@@ -97,6 +118,29 @@ typedef struct {
   double   latency_sum;         /* Sum latency (cumulative reports only) */
 
   double   *latency_pcts;       /* Latency percentiles */
+  /*
+    Percentiles of latency measured from the intended event start time
+    (tx_rate-only, NULL unless --intended-latency is enabled)
+  */
+  double   *intended_latency_pcts;
+  /*
+    Percentiles of the time events waited to be started (tx_rate-only, NULL
+    with --percentile=0)
+  */
+  double   *queue_wait_pcts;
+  /*
+    Latency histogram the percentiles were calculated from (checkpoints only,
+    NULL unless --histogram-log is enabled)
+  */
+  sb_histogram_snapshot_t *latency_histogram;
+  /*
+    Percentiles and average of the cycle time, i.e. the event latency plus the
+    following think time, and the average think time (cumulative reports only,
+    cycle_time_pcts is NULL unless --think-time is used)
+  */
+  double   *cycle_time_pcts;
+  double   cycle_time_avg;
+  double   think_time_avg;
 
   uint64_t events;              /* Number of executed events */
   uint64_t reads;               /* Number of read operations */
@@ -108,8 +152,20 @@ typedef struct {
   uint64_t bytes_read;          /* Bytes read */
   uint64_t bytes_written;       /* Bytes written */
 
+  uint64_t net_sent;            /* Bytes sent to database servers */
+  uint64_t net_received;        /* Bytes received from database servers */
+
   uint64_t queue_length;        /* Event queue length (tx_rate-only) */
+  uint64_t queue_dropped;       /* Events dropped with --rate-queue-full=drop */
   uint64_t concurrency;         /* Number of in-flight events (tx_rate-only) */
+
+  sb_perf_counters_t perf;      /* Hardware counters (--perf-counters only) */
+
+  /* User counters and histograms, NULL if the script registered none */
+  const struct sb_user_stats *user;
+
+  /* Server wait classes, NULL unless --db-wait-sample-rate is used */
+  const struct db_waits *waits;
 } sb_stat_t;
 
 /* Commands */
@@ -126,10 +182,13 @@ typedef int sb_op_thread_run(int);
 typedef void sb_op_print_mode(void);
 typedef sb_event_t sb_op_next_event(int);
 typedef int sb_op_execute_event(sb_event_t *, int);
+typedef unsigned int sb_op_next_events(int, sb_event_t *, unsigned int);
+typedef int sb_op_execute_events(sb_event_t *, unsigned int, int);
 typedef void sb_op_report(sb_stat_t *);
 typedef int sb_op_thread_done(int);
 typedef int sb_op_cleanup(void);
 typedef int sb_op_done(void);
+typedef int sb_op_sweep(unsigned int, unsigned int *, unsigned int *);
 
 /* Test commands structure definitions */
 
@@ -153,6 +212,13 @@ typedef struct
   sb_op_print_mode      *print_mode;      /* print mode function */
   sb_op_next_event      *next_event;      /* event generation function */
   sb_op_execute_event   *execute_event;   /* event execution function */
+  sb_op_next_events     *next_events;     /* generate up to N events at once,
+                                             returns the number of generated
+                                             events (optional, used with
+                                             --event-batch) */
+  sb_op_execute_events  *execute_events;  /* execute N events at once
+                                             (optional, used with
+                                             --event-batch) */
   sb_op_report          *report_intermediate; /* intermediate reports handler */
   sb_op_report          *report_cumulative;   /* cumulative reports handler */
   sb_op_thread_run      *thread_run;      /* main thread loop */
@@ -160,6 +226,12 @@ typedef struct
   sb_op_cleanup         *cleanup;         /* called after exit from thread,
                                              but before timers stop */ 
   sb_op_done            *done;            /* finalize function */
+  sb_op_sweep           *sweep;           /* configure run N of a
+                                             test-specific sweep, setting the
+                                             number of threads and the swept
+                                             value. Returns 1 if run N exists,
+                                             0 if not, -1 on errors
+                                             (optional) */
 } sb_operations_t;
 
 /* Test structure definition */
@@ -171,6 +243,7 @@ typedef struct sb_test
   sb_operations_t   ops;
   sb_builtin_cmds_t builtin_cmds;
   sb_arg_t          *args;
+  const char        *sweep_name;        /* value swept by ops.sweep */
 
   sb_list_item_t    listitem;
 } sb_test_t;
@@ -183,6 +256,12 @@ typedef struct
   int             argc;         /* command line arguments count */
   char            **argv;      /* command line arguments */
   unsigned int    tx_rate;      /* target transaction rate */
+  unsigned char   intended_latency; /* track latency from intended event start
+                                       times (tx_rate-only) */
+  unsigned int    event_batch;  /* number of events to dispatch at once */
+  unsigned int    virtual_users; /* Lua coroutines per worker thread */
+  double          think_time;   /* mean think time between events in ms */
+  unsigned int    latency_sample_rate; /* time every Nth event */
   uint64_t        max_events;   /* maximum number of events to execute */
   uint64_t        max_time_ns;  /* total execution time limit */
   pthread_mutex_t exec_mutex CK_CC_CACHELINE;   /* execution mutex */
@@ -190,7 +269,7 @@ typedef struct
   const char      *cmdname;     /* command passed from command line */
   unsigned int    threads CK_CC_CACHELINE;  /* number of threads to use */
   unsigned int    threads_running;  /* number of threads currently active */
-  unsigned int    report_interval;  /* intermediate reports interval */
+  unsigned int    report_interval;  /* intermediate reports interval in ms */
   double          *percentiles;   /* percentile ranks for latency stats */
   size_t          npercentiles;   /* number of percentile ranks for latency stats */
   unsigned int    histogram;    /* show histogram in latency stats */
@@ -207,8 +286,15 @@ typedef struct
                                                   shutdown */
   int             forced_shutdown_in_progress;
   int             warmup_time;  /* warmup time */
+  double          warmup_steady_state; /* max throughput variation in % */
+  unsigned int    warmup_window; /* seconds of samples for steady state */
+  int             warmup_max_time; /* warmup limit with a steady state */
+  int             warmup_elapsed; /* warmup time of the current run */
   uint64_t        nevents CK_CC_CACHELINE; /* event counter */
   const char      *luajit_cmd; /* LuaJIT command */
+  bool            lua_profile; /* sample Lua functions, see --lua-profile */
+  bool            lua_trace_aborts; /* count LuaJIT trace aborts */
+  bool            lean_workers; /* save per-worker memory, see --lean-workers */
 } sb_globals_t;
 
 extern sb_globals_t sb_globals CK_CC_CACHELINE;
@@ -226,7 +312,33 @@ extern TLS int sb_tls_thread_id;
 bool sb_more_events(int thread_id);
 sb_event_t sb_next_event(sb_test_t *test, int thread_id);
 void sb_event_start(int thread_id);
+/*
+  Start an event at a given time in the past as returned by SB_GETTIME(), e.g.
+  to account latency from the time an event was scheduled at
+*/
+void sb_event_start_at(int thread_id, const struct timespec *ts);
 void sb_event_stop(int thread_id);
+/*
+  Account an event that started at start_ns as returned by sb_test_clock(),
+  e.g. for overlapping events of virtual users within a worker thread
+*/
+void sb_event_stop_since(int thread_id, uint64_t start_ns);
+/*
+  Wait for a --think-time after an event stopped with sb_event_stop() and
+  account its cycle time
+*/
+void sb_event_think(int thread_id);
+/* Return true if --think-time is used */
+bool sb_think_time_enabled(void);
+/* Return a random think time in nanoseconds for --think-time */
+uint64_t sb_think_time_ns(void);
+/*
+  Account the cycle time of an event started at start_ns and stopped at
+  stop_ns, as returned by sb_test_clock(), and followed by think time until now
+*/
+void sb_cycle_stop(uint64_t start_ns, uint64_t stop_ns);
+uint64_t sb_more_events_batch(int thread_id, uint64_t n);
+void sb_event_stop_batch(int thread_id, uint64_t n);
 
 /* Print a description of available command line options for the current test */
 void sb_print_test_options(void);
@@ -234,6 +346,9 @@ void sb_print_test_options(void);
 /* Default intermediate reports handler */
 void sb_report_intermediate(sb_stat_t *stat);
 
+/* Print queue wait and dropped events for an intermediate report with --rate */
+void sb_report_queue_intermediate(sb_stat_t *stat);
+
 /* Default cumulative reports handler */
 void sb_report_cumulative(sb_stat_t *stat);
 
@@ -243,4 +358,13 @@ void sb_report_cumulative(sb_stat_t *stat);
 */
 void *sb_alloc_per_thread_array(size_t size);
 
+/* Return the time since the start of the test in nanoseconds */
+uint64_t sb_test_clock(void);
+
+/*
+  Sleep for a given number of nanoseconds, but not past the time limit. Returns
+  false if the sleep was cut short by the time limit.
+*/
+bool sb_test_sleep(uint64_t ns);
+
 #endif
@@ -0,0 +1,164 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Stable ABI for native test plugins.
+
+  A plugin is a shared object defining a variable named 'sb_plugin_test' of
+  type sb_plugin_test_t with 'abi_version' set to SB_PLUGIN_ABI_VERSION. It is
+  run by passing its path, which must end with '.so', instead of a test name:
+
+    cc -shared -fPIC -I/usr/local/include/sysbench -o mytest.so mytest.c
+    sysbench ./mytest.so --threads=4 --time=10 run
+
+  Events are executed by the same loop as events of built-in tests, so there
+  is no overhead besides a call of 'event' per event, and the usual statistics
+  and reports are available. Plugins only include this header, which does not
+  depend on the sysbench build configuration, and call sysbench through the
+  functions declared below, which are resolved against the sysbench binary
+  when a plugin is loaded.
+
+  Plugins built for a different SB_PLUGIN_ABI_VERSION are rejected. It is
+  incremented on any incompatible change of the declarations below.
+*/
+
+#ifndef SYSBENCH_PLUGIN_H
+#define SYSBENCH_PLUGIN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SB_PLUGIN_ABI_VERSION 1
+
+/* Name of the sb_plugin_test_t variable defined by plugins */
+#define SB_PLUGIN_SYMBOL "sb_plugin_test"
+
+typedef enum
+{
+  SB_PLUGIN_ARG_BOOL = 1,
+  SB_PLUGIN_ARG_INT,
+  SB_PLUGIN_ARG_SIZE,
+  SB_PLUGIN_ARG_DOUBLE,
+  SB_PLUGIN_ARG_STRING
+} sb_plugin_arg_type_t;
+
+/* Test option. Arrays of options are terminated by an element with no name. */
+typedef struct
+{
+  const char           *name;           /* without the leading "--" */
+  const char           *desc;
+  const char           *value;          /* default value */
+  sb_plugin_arg_type_t type;
+} sb_plugin_arg_t;
+
+/*
+  Test definition. All callbacks except 'event' are optional and return 0 on
+  success.
+*/
+typedef struct
+{
+  unsigned int          abi_version;    /* SB_PLUGIN_ABI_VERSION */
+  const char            *name;          /* short name for messages */
+  const char            *description;
+  const sb_plugin_arg_t *args;          /* test options, may be NULL */
+
+  int  (*init)(void);                   /* called before worker threads
+                                           are created for 'run' */
+  int  (*prepare)(void);                /* 'prepare' command */
+  int  (*cleanup)(void);                /* 'cleanup' command */
+  void (*print_mode)(void);             /* print test settings for 'run' */
+  int  (*thread_init)(int thread_id);
+  int  (*event)(int thread_id);         /* execute a single event */
+  int  (*thread_done)(int thread_id);
+  int  (*done)(void);                   /* called after 'run' */
+} sb_plugin_test_t;
+
+/* Values of test and general options by name, e.g. "threads" */
+bool sb_plugin_opt_bool(const char *name);
+int sb_plugin_opt_int(const char *name);
+unsigned long long sb_plugin_opt_size(const char *name);
+double sb_plugin_opt_double(const char *name);
+const char *sb_plugin_opt_string(const char *name);
+
+/* Number of worker threads */
+unsigned int sb_plugin_threads(void);
+
+/* Print a message, fatal ones are printed as "FATAL: ..." */
+void sb_plugin_log(const char *fmt, ...)
+#ifdef __GNUC__
+  __attribute__((format(printf, 1, 2)))
+#endif
+  ;
+void sb_plugin_log_fatal(const char *fmt, ...)
+#ifdef __GNUC__
+  __attribute__((format(printf, 1, 2)))
+#endif
+  ;
+
+/*
+  Named counters reported with intermediate and cumulative reports, as with
+  sysbench.counter.new() in Lua. sb_plugin_counter() returns the ID of a
+  counter, registering it on the first call, or -1 if there are too many
+  counters.
+*/
+int sb_plugin_counter(const char *name);
+void sb_plugin_counter_add(int thread_id, int counter, uint64_t value);
+
+/*
+  Named histograms of values in milliseconds reported at the --percentile
+  values, as with sysbench.histogram.named() in Lua. Returns NULL if there are
+  too many histograms.
+*/
+typedef struct sb_plugin_histogram sb_plugin_histogram_t;
+
+sb_plugin_histogram_t *sb_plugin_histogram(const char *name);
+void sb_plugin_histogram_update(sb_plugin_histogram_t *h, double value);
+
+/*
+  Random numbers from the per-thread generators seeded with --rand-seed.
+  sb_plugin_rand_default() uses the --rand-type distribution.
+*/
+uint32_t sb_plugin_rand_default(uint32_t a, uint32_t b);
+uint32_t sb_plugin_rand_uniform(uint32_t a, uint32_t b);
+uint64_t sb_plugin_rand_uint64(void);
+double sb_plugin_rand_double(void);
+
+/*
+  Database connections with the driver selected by --db-driver, one per
+  thread. Queries are accounted in statistics as with Lua scripts.
+  sb_plugin_db_query() returns 0 on success, 1 on an error ignored with
+  --db-ignore-errors and -1 on other errors, and optionally the number of
+  returned or affected rows.
+*/
+typedef struct sb_plugin_db_conn sb_plugin_db_conn_t;
+
+sb_plugin_db_conn_t *sb_plugin_db_connect(void);
+int sb_plugin_db_query(sb_plugin_db_conn_t *con, const char *query,
+                       uint64_t *nrows);
+void sb_plugin_db_disconnect(sb_plugin_db_conn_t *con);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SYSBENCH_PLUGIN_H */
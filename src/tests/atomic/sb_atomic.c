@@ -0,0 +1,275 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Atomic operations contention test. Each event executes a number of atomic
+  operations on a counter which is either shared by all threads, private to
+  each thread and padded to a cache line, or private to each thread but packed
+  together with other threads' counters into the same cache lines.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+
+#include <inttypes.h>
+
+#include "sysbench.h"
+#include "sb_ck_pr.h"
+#include "sb_util.h"
+
+/* Atomic test arguments */
+static sb_arg_t atomic_args[] =
+{
+  SB_OPT("atomic-oper", "type of operations to perform {faa, cas, fas, "
+         "load-store}", "faa", STRING),
+  SB_OPT("atomic-scope", "counter placement {shared, padded, false-shared}",
+         "shared", STRING),
+  SB_OPT("atomic-ops", "number of operations per event", "1000", INT),
+
+  SB_OPT_END
+};
+
+typedef enum
+{
+  ATOMIC_OP_FAA,                /* fetch-and-add */
+  ATOMIC_OP_CAS,                /* compare-and-swap increment loop */
+  ATOMIC_OP_FAS,                /* exchange */
+  ATOMIC_OP_LOAD_STORE          /* atomic load followed by atomic store */
+} atomic_op_t;
+
+static const char *atomic_op_names[] =
+{
+  "faa", "cas", "fas", "load-store", NULL
+};
+
+typedef enum
+{
+  ATOMIC_SCOPE_SHARED,          /* one counter for all threads */
+  ATOMIC_SCOPE_PADDED,          /* per-thread counters on separate lines */
+  ATOMIC_SCOPE_FALSE_SHARED     /* per-thread counters on shared lines */
+} atomic_scope_t;
+
+static const char *atomic_scope_names[] =
+{
+  "shared", "padded", "false-shared", NULL
+};
+
+/* Atomic test operations */
+static int atomic_init(void);
+static void atomic_print_mode(void);
+static sb_event_t atomic_next_event(int);
+static int atomic_execute_event(sb_event_t *, int);
+static void atomic_report_intermediate(sb_stat_t *);
+static void atomic_report_cumulative(sb_stat_t *);
+static int atomic_done(void);
+
+static sb_test_t atomic_test =
+{
+  .sname = "atomic",
+  .lname = "Atomic operations contention test",
+  .ops = {
+    .init = atomic_init,
+    .print_mode = atomic_print_mode,
+    .next_event = atomic_next_event,
+    .execute_event = atomic_execute_event,
+    .report_intermediate = atomic_report_intermediate,
+    .report_cumulative = atomic_report_cumulative,
+    .done = atomic_done
+  },
+  .args = atomic_args
+};
+
+static atomic_op_t    atomic_oper;
+static atomic_scope_t atomic_scope;
+static unsigned int   atomic_ops;
+
+/* Counters, accessed by threads at a scope-dependent stride */
+static char           *atomic_buf;
+static size_t         atomic_stride;
+
+
+int register_test_atomic(sb_list_t *tests)
+{
+  SB_LIST_ADD_TAIL(&atomic_test.listitem, tests);
+
+  return 0;
+}
+
+
+/* Return index of a value in a NULL-terminated array of names, or -1 */
+
+static int find_name(const char **names, const char *s)
+{
+  for (int i = 0; names[i] != NULL; i++)
+    if (!strcmp(names[i], s))
+      return i;
+
+  return -1;
+}
+
+
+int atomic_init(void)
+{
+  const char *s;
+  int        i;
+  size_t     size;
+
+  s = sb_get_value_string("atomic-oper");
+  if ((i = find_name(atomic_op_names, s)) < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for atomic-oper: %s", s);
+    return 1;
+  }
+  atomic_oper = (atomic_op_t) i;
+
+  s = sb_get_value_string("atomic-scope");
+  if ((i = find_name(atomic_scope_names, s)) < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for atomic-scope: %s", s);
+    return 1;
+  }
+  atomic_scope = (atomic_scope_t) i;
+
+  i = sb_get_value_int("atomic-ops");
+  if (i <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for atomic-ops: %d", i);
+    return 1;
+  }
+  atomic_ops = (unsigned int) i;
+
+  switch (atomic_scope) {
+  case ATOMIC_SCOPE_SHARED:
+    atomic_stride = 0;
+    break;
+  case ATOMIC_SCOPE_PADDED:
+    atomic_stride = CK_MD_CACHELINE;
+    break;
+  case ATOMIC_SCOPE_FALSE_SHARED:
+    atomic_stride = sizeof(unsigned int);
+    break;
+  }
+
+  size = SB_MAX(sb_globals.threads * atomic_stride, sizeof(unsigned int));
+  size = SB_ALIGN(size, CK_MD_CACHELINE);
+
+  atomic_buf = sb_memalign(size, CK_MD_CACHELINE);
+  if (atomic_buf == NULL)
+  {
+    log_text(LOG_FATAL, "Failed to allocate %zu bytes for counters", size);
+    return 1;
+  }
+  memset(atomic_buf, 0, size);
+
+  return 0;
+}
+
+
+int atomic_done(void)
+{
+  free(atomic_buf);
+
+  return 0;
+}
+
+
+sb_event_t atomic_next_event(int thread_id)
+{
+  sb_event_t req;
+
+  (void) thread_id; /* unused */
+
+  req.type = SB_REQ_TYPE_ATOMIC;
+
+  return req;
+}
+
+
+int atomic_execute_event(sb_event_t *r, int thread_id)
+{
+  unsigned int * const counter =
+    (unsigned int *) (atomic_buf + thread_id * atomic_stride);
+  unsigned int         i, v;
+
+  (void) r; /* unused */
+
+  switch (atomic_oper) {
+  case ATOMIC_OP_FAA:
+    for (i = 0; i < atomic_ops; i++)
+      ck_pr_faa_uint(counter, 1);
+    break;
+
+  case ATOMIC_OP_CAS:
+    for (i = 0; i < atomic_ops; i++)
+    {
+      v = ck_pr_load_uint(counter);
+      while (!ck_pr_cas_uint_value(counter, v, v + 1, &v))
+        ck_pr_stall();
+    }
+    break;
+
+  case ATOMIC_OP_FAS:
+    for (i = 0; i < atomic_ops; i++)
+      ck_pr_fas_uint(counter, i);
+    break;
+
+  case ATOMIC_OP_LOAD_STORE:
+    /* Not a read-modify-write, concurrent updates may be lost */
+    for (i = 0; i < atomic_ops; i++)
+      ck_pr_store_uint(counter, ck_pr_load_uint(counter) + 1);
+    break;
+  }
+
+  return 0;
+}
+
+
+void atomic_print_mode(void)
+{
+  log_text(LOG_INFO, "Doing atomic operations contention test\n");
+  log_text(LOG_NOTICE, "Operation: %s, scope: %s, %u operations per event\n",
+           atomic_op_names[atomic_oper], atomic_scope_names[atomic_scope],
+           atomic_ops);
+}
+
+
+void atomic_report_intermediate(sb_stat_t *stat)
+{
+  log_timestamp(LOG_NOTICE, stat->time_total, "%4.2f Mops/sec",
+                stat->events * atomic_ops / 1e6 / stat->time_interval);
+}
+
+
+/* Print cumulative stats. */
+
+void atomic_report_cumulative(sb_stat_t *stat)
+{
+  const uint64_t ops = stat->events * atomic_ops;
+
+  log_text(LOG_NOTICE, "Total operations: %" PRIu64 " (%8.2f per second)",
+           ops, ops / stat->time_interval);
+  log_text(LOG_NOTICE, "Average latency per operation: %4.2f ns",
+           stat->latency_avg * NS_PER_SEC / atomic_ops);
+
+  sb_report_cumulative(stat);
+}
@@ -0,0 +1,317 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Core-to-core latency test. Two worker threads are bound to each pair of CPUs
+  in turn and bounce a cache line between them: the first thread stores an odd
+  value and waits for the second one to reply with the next even value. The
+  one-way latency is half of the average round trip time. Each measured CPU
+  pair is one event.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+
+#include <inttypes.h>
+
+#include "sysbench.h"
+#include "sb_ck_pr.h"
+#include "sb_util.h"
+#include "sb_affinity.h"
+#include "sb_barrier.h"
+
+/* Core-to-core test arguments */
+static sb_arg_t c2c_args[] =
+{
+  SB_OPT("c2c-cpus", "list of CPUs to measure, e.g. '0-3,8', or 'all' for "
+         "all available CPUs", "all", STRING),
+  SB_OPT("c2c-roundtrips", "number of round trips per CPU pair", "10000",
+         INT),
+
+  SB_OPT_END
+};
+
+/* Core-to-core test operations */
+static int c2c_init(void);
+static void c2c_print_mode(void);
+static int c2c_thread_run(int);
+static void c2c_report_cumulative(sb_stat_t *);
+static int c2c_done(void);
+
+static sb_test_t c2c_test =
+{
+  .sname = "c2c",
+  .lname = "Core-to-core cache line latency test",
+  .ops = {
+    .init = c2c_init,
+    .print_mode = c2c_print_mode,
+    .thread_run = c2c_thread_run,
+    .report_cumulative = c2c_report_cumulative,
+    .done = c2c_done
+  },
+  .args = c2c_args
+};
+
+/* The cache line bounced between CPUs */
+typedef struct
+{
+  unsigned int    seq;
+  char            pad[SB_CACHELINE_PAD(sizeof(unsigned int))];
+} c2c_line_t;
+
+static unsigned int *c2c_cpus;
+static unsigned int c2c_ncpus;
+static unsigned int c2c_roundtrips;
+
+static c2c_line_t   *c2c_line;
+static sb_barrier_t c2c_barrier;
+static int          c2c_stop;
+
+/* One-way latencies in ns, row-major, negative for pairs not measured */
+static double       *c2c_matrix;
+
+
+int register_test_c2c(sb_list_t *tests)
+{
+  SB_LIST_ADD_TAIL(&c2c_test.listitem, tests);
+
+  return 0;
+}
+
+
+int c2c_init(void)
+{
+  const char *s;
+  int        n;
+
+  if (sb_globals.threads != 2)
+  {
+    log_text(LOG_FATAL, "The 'c2c' test requires --threads=2");
+    return 1;
+  }
+
+  n = sb_get_value_int("c2c-roundtrips");
+  if (n <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for c2c-roundtrips: %d", n);
+    return 1;
+  }
+  c2c_roundtrips = (unsigned int) n;
+
+  s = sb_get_value_string("c2c-cpus");
+  if (sb_cpu_list(strcmp(s, "all") ? s : NULL, &c2c_cpus, &c2c_ncpus))
+    return 1;
+
+  for (unsigned int i = 0; i < c2c_ncpus; i++)
+    for (unsigned int j = i + 1; j < c2c_ncpus; j++)
+      if (c2c_cpus[i] == c2c_cpus[j])
+      {
+        log_text(LOG_FATAL, "CPU %u is listed more than once in --c2c-cpus",
+                 c2c_cpus[i]);
+        return 1;
+      }
+
+  if (c2c_ncpus < 2)
+  {
+    log_text(LOG_FATAL, "The 'c2c' test requires at least 2 CPUs");
+    return 1;
+  }
+
+  c2c_line = sb_memalign(sizeof(c2c_line_t), CK_MD_CACHELINE);
+  c2c_matrix = malloc(c2c_ncpus * c2c_ncpus * sizeof(double));
+  if (c2c_line == NULL || c2c_matrix == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  for (unsigned int i = 0; i < c2c_ncpus * c2c_ncpus; i++)
+    c2c_matrix[i] = -1;
+
+  if (sb_barrier_init(&c2c_barrier, 2, NULL, NULL))
+  {
+    log_text(LOG_FATAL, "Barrier initialization failed");
+    return 1;
+  }
+
+  return 0;
+}
+
+
+int c2c_done(void)
+{
+  sb_barrier_destroy(&c2c_barrier);
+
+  free(c2c_cpus);
+  free(c2c_line);
+  free(c2c_matrix);
+
+  return 0;
+}
+
+
+/* Bounce the cache line between two threads, return the elapsed time in ns */
+
+static uint64_t c2c_pingpong(int thread_id)
+{
+  unsigned int    *seq = &c2c_line->seq;
+  struct timespec ts;
+  uint64_t        start;
+
+  if (thread_id == 1)
+  {
+    for (unsigned int v = 1; v < 2 * c2c_roundtrips; v += 2)
+    {
+      while (ck_pr_load_uint(seq) != v)
+        ck_pr_stall();
+      ck_pr_store_uint(seq, v + 1);
+    }
+
+    return 0;
+  }
+
+  SB_GETTIME(&ts);
+  start = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+
+  for (unsigned int v = 1; v < 2 * c2c_roundtrips; v += 2)
+  {
+    ck_pr_store_uint(seq, v);
+    while (ck_pr_load_uint(seq) != v + 1)
+      ck_pr_stall();
+  }
+
+  SB_GETTIME(&ts);
+
+  return SEC2NS(ts.tv_sec) + ts.tv_nsec - start;
+}
+
+
+int c2c_thread_run(int thread_id)
+{
+  int rc = 0;
+
+  for (unsigned int i = 0; i < c2c_ncpus; i++)
+  {
+    for (unsigned int j = i + 1; j < c2c_ncpus; j++)
+    {
+      if (thread_id == 0)
+      {
+        if (!sb_more_events(thread_id))
+          ck_pr_store_int(&c2c_stop, 1);
+        ck_pr_store_uint(&c2c_line->seq, 0);
+      }
+
+      /* Both threads must reach the barrier, even on errors */
+      if (sb_run_on_cpu(c2c_cpus[thread_id == 0 ? i : j]))
+      {
+        ck_pr_store_int(&c2c_stop, 1);
+        rc = 1;
+      }
+
+      if (sb_barrier_wait(&c2c_barrier) < 0 || ck_pr_load_int(&c2c_stop))
+        return rc;
+
+      if (thread_id == 0)
+      {
+        sb_event_start(thread_id);
+        c2c_matrix[i * c2c_ncpus + j] = c2c_matrix[j * c2c_ncpus + i] =
+          c2c_pingpong(thread_id) / 2.0 / c2c_roundtrips;
+        sb_event_stop(thread_id);
+      }
+      else
+        c2c_pingpong(thread_id);
+    }
+  }
+
+  return 0;
+}
+
+
+void c2c_print_mode(void)
+{
+  log_text(LOG_INFO, "Doing core-to-core latency test\n");
+  log_text(LOG_NOTICE, "%u CPUs, %u CPU pairs, %u round trips per pair\n",
+           c2c_ncpus, c2c_ncpus * (c2c_ncpus - 1) / 2, c2c_roundtrips);
+}
+
+
+/* Print the latency matrix */
+
+void c2c_report_cumulative(sb_stat_t *stat)
+{
+  char         buf[16];
+  char         *line;
+  size_t       len;
+  double       min = 0, max = 0, sum = 0;
+  unsigned int n = 0;
+
+  /* Cells are 8 characters wide unless values are unusually large */
+  line = malloc((c2c_ncpus + 1) * sizeof(buf) + 1);
+  if (line == NULL)
+    return;
+
+  log_text(LOG_NOTICE, "One-way core-to-core latency (ns):");
+
+  len = sprintf(line, "%5s", "CPU");
+  for (unsigned int j = 0; j < c2c_ncpus; j++)
+    len += sprintf(line + len, " %7u", c2c_cpus[j]);
+  log_text(LOG_NOTICE, "%s", line);
+
+  for (unsigned int i = 0; i < c2c_ncpus; i++)
+  {
+    len = sprintf(line, "%5u", c2c_cpus[i]);
+
+    for (unsigned int j = 0; j < c2c_ncpus; j++)
+    {
+      const double v = c2c_matrix[i * c2c_ncpus + j];
+
+      if (v < 0)
+        snprintf(buf, sizeof(buf), "-");
+      else
+        snprintf(buf, sizeof(buf), "%.1f", v);
+      len += sprintf(line + len, " %7s", buf);
+
+      if (v >= 0 && j > i)
+      {
+        min = (n == 0 || v < min) ? v : min;
+        max = (n == 0 || v > max) ? v : max;
+        sum += v;
+        n++;
+      }
+    }
+
+    log_text(LOG_NOTICE, "%s", line);
+  }
+
+  free(line);
+
+  if (n > 0)
+    log_text(LOG_NOTICE, "\nmin/avg/max: %.1f/%.1f/%.1f ns over %u CPU "
+             "pairs", min, sum / n, max, n);
+
+  if (n < c2c_ncpus * (c2c_ncpus - 1) / 2)
+    log_text(LOG_WARNING, "Not all CPU pairs were measured before the test "
+             "ended, see --time and --events");
+
+  sb_report_cumulative(stat);
+}
@@ -0,0 +1,638 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Clock source and timer overhead test. Each event reads the --clock-type
+  clock --clock-reads times in a loop, tracking the smallest nonzero step
+  between consecutive reads (the effective resolution), repeated values and
+  backward steps. A thread migrating between CPUs with unsynchronized TSCs
+  shows up as backward steps.
+
+  Before the run, all clocks available on the platform are measured from a
+  single thread, and the TSC (or the ARM generic timer) is calibrated against
+  CLOCK_MONOTONIC so raw counter ticks can be reported in nanoseconds.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_STDIO_H
+# include <stdio.h>
+#endif
+
+#include <inttypes.h>
+
+#include "sysbench.h"
+#include "sb_timer.h"
+#include "sb_ck_pr.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define CLOCK_X86_TSC
+# include <x86intrin.h>
+# include <cpuid.h>
+#elif defined(__aarch64__) && defined(__GNUC__)
+# define CLOCK_ARM64_CNTVCT
+#endif
+
+/* Duration of the TSC calibration against CLOCK_MONOTONIC */
+#define CLOCK_CALIBRATION_NS (50 * NS_PER_MS)
+
+/* Upper bound on the time spent measuring the resolution of one clock */
+#define CLOCK_PROBE_NS (50 * NS_PER_MS)
+
+/* Clock test arguments */
+static sb_arg_t clock_args[] =
+{
+  SB_OPT("clock-type", "clock to read {monotonic, monotonic_raw, "
+         "monotonic_coarse, realtime, boottime, rdtsc, rdtscp, cntvct}",
+         "monotonic", STRING),
+  SB_OPT("clock-reads", "number of clock reads per event", "1000", INT),
+
+  SB_OPT_END
+};
+
+typedef enum
+{
+  CLOCK_TYPE_MONOTONIC,
+  CLOCK_TYPE_MONOTONIC_RAW,
+  CLOCK_TYPE_MONOTONIC_COARSE,
+  CLOCK_TYPE_REALTIME,
+  CLOCK_TYPE_BOOTTIME,
+  CLOCK_TYPE_RDTSC,             /* x86 time stamp counter */
+  CLOCK_TYPE_RDTSCP,            /* same, but waits for prior instructions */
+  CLOCK_TYPE_CNTVCT,            /* ARM generic timer virtual count */
+  CLOCK_TYPE_MAX
+} clock_type_t;
+
+static const char *clock_type_names[] =
+{
+  "monotonic", "monotonic_raw", "monotonic_coarse", "realtime", "boottime",
+  "rdtsc", "rdtscp", "cntvct", NULL
+};
+
+/* Clocks measured before the run */
+typedef struct
+{
+  bool     available;
+  double   cost;                /* ns per read */
+  double   resolution;          /* smallest observed step, ns */
+  uint64_t getres;              /* clock_getres() in ns, 0 for counters */
+} clock_info_t;
+
+typedef struct
+{
+  uint64_t reads;
+  uint64_t repeats;             /* reads returning the previous value */
+  uint64_t backwards;           /* reads returning a smaller value */
+  uint64_t min_step;            /* smallest nonzero step, clock units */
+  char     pad[SB_CACHELINE_PAD(sizeof(uint64_t) * 4)];
+} clock_stat_t;
+
+/* Clock test operations */
+static int clock_init(void);
+static void clock_print_mode(void);
+static sb_event_t clock_next_event(int);
+static int clock_execute_event(sb_event_t *, int);
+static void clock_report_cumulative(sb_stat_t *);
+static int clock_done(void);
+
+static sb_test_t clock_test =
+{
+  .sname = "clock",
+  .lname = "Clock source and timer overhead test",
+  .ops = {
+    .init = clock_init,
+    .print_mode = clock_print_mode,
+    .next_event = clock_next_event,
+    .execute_event = clock_execute_event,
+    .report_cumulative = clock_report_cumulative,
+    .done = clock_done
+  },
+  .args = clock_args
+};
+
+static clock_type_t clock_type;
+static unsigned int clock_reads;
+
+/* Counter ticks per nanosecond, 0 if not calibrated */
+static double       clock_ticks_per_ns;
+
+static clock_info_t clock_infos[CLOCK_TYPE_MAX];
+
+static clock_stat_t *clock_stats;
+
+
+int register_test_clock(sb_list_t *tests)
+{
+  SB_LIST_ADD_TAIL(&clock_test.listitem, tests);
+
+  return 0;
+}
+
+
+/* Return the POSIX clock ID of a clock type, or -1 for counters */
+
+static int clock_posix_id(clock_type_t type)
+{
+  switch (type) {
+#ifdef HAVE_CLOCK_GETTIME
+  case CLOCK_TYPE_MONOTONIC:
+    return CLOCK_MONOTONIC;
+# ifdef CLOCK_MONOTONIC_RAW
+  case CLOCK_TYPE_MONOTONIC_RAW:
+    return CLOCK_MONOTONIC_RAW;
+# endif
+# ifdef CLOCK_MONOTONIC_COARSE
+  case CLOCK_TYPE_MONOTONIC_COARSE:
+    return CLOCK_MONOTONIC_COARSE;
+# endif
+  case CLOCK_TYPE_REALTIME:
+    return CLOCK_REALTIME;
+# ifdef CLOCK_BOOTTIME
+  case CLOCK_TYPE_BOOTTIME:
+    return CLOCK_BOOTTIME;
+# endif
+#endif
+  default:
+    return -1;
+  }
+}
+
+
+static inline uint64_t clock_read_posix(int id)
+{
+  struct timespec ts;
+
+#ifdef HAVE_CLOCK_GETTIME
+  clock_gettime((clockid_t) id, &ts);
+#else
+  (void) id; /* unused */
+  SB_GETTIME(&ts);
+#endif
+
+  return SEC2NS(ts.tv_sec) + (uint64_t) ts.tv_nsec;
+}
+
+
+#ifdef CLOCK_ARM64_CNTVCT
+static inline uint64_t clock_read_cntvct(void)
+{
+  uint64_t v;
+
+  /* The barrier keeps the read from being executed ahead of prior code */
+  __asm__ __volatile__("isb; mrs %0, cntvct_el0" : "=r" (v) :: "memory");
+
+  return v;
+}
+#endif
+
+
+static inline uint64_t clock_read(clock_type_t type, int id)
+{
+  switch (type) {
+#ifdef CLOCK_X86_TSC
+  case CLOCK_TYPE_RDTSC:
+    return __rdtsc();
+  case CLOCK_TYPE_RDTSCP:
+    {
+      unsigned int aux;
+      return __rdtscp(&aux);
+    }
+#endif
+#ifdef CLOCK_ARM64_CNTVCT
+  case CLOCK_TYPE_CNTVCT:
+    return clock_read_cntvct();
+#endif
+  default:
+    return clock_read_posix(id);
+  }
+}
+
+
+static bool clock_available(clock_type_t type)
+{
+  switch (type) {
+#ifdef CLOCK_X86_TSC
+  case CLOCK_TYPE_RDTSC:
+    return true;
+  case CLOCK_TYPE_RDTSCP:
+    {
+      unsigned int eax, ebx, ecx, edx;
+
+      /* RDTSCP is bit 27 of EDX in the extended feature leaf */
+      return __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) &&
+        (edx & (1U << 27)) != 0;
+    }
+#endif
+#ifdef CLOCK_ARM64_CNTVCT
+  case CLOCK_TYPE_CNTVCT:
+    return true;
+#endif
+  default:
+    {
+#ifdef HAVE_CLOCK_GETTIME
+      const int       id = clock_posix_id(type);
+      struct timespec ts;
+
+      return id >= 0 && clock_getres((clockid_t) id, &ts) == 0;
+#else
+      return type == CLOCK_TYPE_MONOTONIC;
+#endif
+    }
+  }
+}
+
+
+static bool clock_is_counter(clock_type_t type)
+{
+  return type == CLOCK_TYPE_RDTSC || type == CLOCK_TYPE_RDTSCP ||
+    type == CLOCK_TYPE_CNTVCT;
+}
+
+
+/* Convert a clock value difference to nanoseconds */
+
+static double clock_to_ns(clock_type_t type, uint64_t delta)
+{
+  if (!clock_is_counter(type))
+    return (double) delta;
+
+  return clock_ticks_per_ns > 0 ? delta / clock_ticks_per_ns : 0;
+}
+
+
+/*
+  Calibrate hardware counter ticks against CLOCK_MONOTONIC by spinning for
+  CLOCK_CALIBRATION_NS. Spinning rather than sleeping keeps the CPU out of
+  idle states, which matters on CPUs without an invariant TSC.
+*/
+
+static void clock_calibrate(clock_type_t type)
+{
+  const int id = clock_posix_id(CLOCK_TYPE_MONOTONIC);
+  uint64_t  ns0, ns1, t0, t1;
+
+  ns0 = clock_read_posix(id);
+  t0 = clock_read(type, id);
+
+  do
+  {
+    ns1 = clock_read_posix(id);
+  } while (ns1 - ns0 < CLOCK_CALIBRATION_NS);
+
+  t1 = clock_read(type, id);
+
+  clock_ticks_per_ns = (double) (t1 - t0) / (ns1 - ns0);
+}
+
+
+/*
+  Measure the cost per read as the minimum over a few rounds, and the
+  resolution as the smallest nonzero step seen within CLOCK_PROBE_NS. Coarse
+  clocks need a few milliseconds to make a single step.
+*/
+
+static void clock_probe(clock_type_t type, clock_info_t *info)
+{
+  const int  id = clock_posix_id(type);
+  const int  mono = clock_posix_id(CLOCK_TYPE_MONOTONIC);
+  uint64_t   min_step = UINT64_MAX;
+  double     cost = 0;
+
+  for (int round = 0; round < 5; round++)
+  {
+    const uint64_t start = clock_read_posix(mono);
+
+    for (int i = 0; i < 1000; i++)
+      (void) clock_read(type, id);
+
+    const double c = (clock_read_posix(mono) - start) / 1000.0;
+
+    if (round == 0 || c < cost)
+      cost = c;
+  }
+
+  const uint64_t start = clock_read_posix(mono);
+  uint64_t       prev = clock_read(type, id);
+  unsigned int   steps = 0;
+
+  for (uint64_t i = 1; steps < 100; i++)
+  {
+    const uint64_t now = clock_read(type, id);
+
+    if (now > prev)
+    {
+      if (now - prev < min_step)
+        min_step = now - prev;
+      steps++;
+    }
+    prev = now;
+
+    if (i % 1024 == 0 && clock_read_posix(mono) - start > CLOCK_PROBE_NS)
+      break;
+  }
+
+  info->available = true;
+  info->cost = cost;
+  info->resolution = min_step == UINT64_MAX ? 0 :
+    clock_to_ns(type, min_step);
+  info->getres = 0;
+
+#ifdef HAVE_CLOCK_GETTIME
+  struct timespec ts;
+
+  if (id >= 0 && clock_getres((clockid_t) id, &ts) == 0)
+    info->getres = SEC2NS(ts.tv_sec) + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+
+#ifdef CLOCK_X86_TSC
+/* Check if a flag is listed on the 'flags' line of /proc/cpuinfo */
+
+static bool cpuinfo_has_flag(const char *flag)
+{
+  FILE   *fp;
+  char   line[8192];
+  bool   found = false;
+
+  if ((fp = fopen("/proc/cpuinfo", "r")) == NULL)
+    return false;
+
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    if (strncmp(line, "flags", 5))
+      continue;
+
+    for (char *tok = strtok(strchr(line, ':'), ": \t\n"); tok != NULL;
+         tok = strtok(NULL, " \t\n"))
+      if (!strcmp(tok, flag))
+        found = true;
+
+    break;
+  }
+
+  fclose(fp);
+
+  return found;
+}
+#endif
+
+
+int clock_init(void)
+{
+  const char *s;
+  int        i;
+
+  s = sb_get_value_string("clock-type");
+  for (i = 0; clock_type_names[i] != NULL; i++)
+    if (!strcmp(clock_type_names[i], s))
+      break;
+  if (clock_type_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for clock-type: %s", s);
+    return 1;
+  }
+  clock_type = (clock_type_t) i;
+
+  if (!clock_available(clock_type))
+  {
+    log_text(LOG_FATAL, "--clock-type=%s is not supported on this platform",
+             clock_type_names[clock_type]);
+    return 1;
+  }
+
+  i = sb_get_value_int("clock-reads");
+  if (i <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for clock-reads: %d", i);
+    return 1;
+  }
+  clock_reads = (unsigned int) i;
+
+  /* RDTSC and RDTSCP read the same counter, so one calibration covers both */
+  for (i = CLOCK_TYPE_RDTSC; i <= CLOCK_TYPE_CNTVCT; i++)
+    if (clock_available((clock_type_t) i))
+    {
+      clock_calibrate((clock_type_t) i);
+      break;
+    }
+
+  for (i = 0; i < CLOCK_TYPE_MAX; i++)
+    if (clock_available((clock_type_t) i))
+      clock_probe((clock_type_t) i, &clock_infos[i]);
+
+  clock_stats = sb_alloc_per_thread_array(sizeof(clock_stat_t));
+  if (clock_stats == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  for (unsigned int t = 0; t < sb_globals.threads; t++)
+    clock_stats[t].min_step = UINT64_MAX;
+
+  return 0;
+}
+
+
+int clock_done(void)
+{
+  free(clock_stats);
+  clock_stats = NULL;
+
+  return 0;
+}
+
+
+sb_event_t clock_next_event(int thread_id)
+{
+  sb_event_t req;
+
+  (void) thread_id; /* unused */
+
+  req.type = SB_REQ_TYPE_CLOCK;
+
+  return req;
+}
+
+
+/*
+  The loop is instantiated per clock type so the time per read does not
+  include a switch on every iteration.
+*/
+#define CLOCK_READ_LOOP(read_expr)                                      \
+  do {                                                                  \
+    uint64_t prev = (read_expr);                                        \
+    for (unsigned int i = 1; i < clock_reads; i++)                      \
+    {                                                                   \
+      const uint64_t now = (read_expr);                                 \
+      if (now > prev)                                                   \
+      {                                                                 \
+        if (now - prev < min_step)                                      \
+          min_step = now - prev;                                        \
+      }                                                                 \
+      else if (now == prev)                                             \
+        repeats++;                                                      \
+      else                                                              \
+        backwards++;                                                    \
+      prev = now;                                                       \
+    }                                                                   \
+  } while (0)
+
+int clock_execute_event(sb_event_t *r, int thread_id)
+{
+  clock_stat_t * const stat = &clock_stats[thread_id];
+  const int            id = clock_posix_id(clock_type);
+  uint64_t             min_step = ck_pr_load_64(&stat->min_step);
+  uint64_t             repeats = 0;
+  uint64_t             backwards = 0;
+
+  (void) r; /* unused */
+
+  switch (clock_type) {
+#ifdef CLOCK_X86_TSC
+  case CLOCK_TYPE_RDTSC:
+    CLOCK_READ_LOOP(__rdtsc());
+    break;
+  case CLOCK_TYPE_RDTSCP:
+    {
+      unsigned int aux;
+      CLOCK_READ_LOOP(__rdtscp(&aux));
+    }
+    break;
+#endif
+#ifdef CLOCK_ARM64_CNTVCT
+  case CLOCK_TYPE_CNTVCT:
+    CLOCK_READ_LOOP(clock_read_cntvct());
+    break;
+#endif
+  default:
+    CLOCK_READ_LOOP(clock_read_posix(id));
+    break;
+  }
+
+  ck_pr_store_64(&stat->reads, ck_pr_load_64(&stat->reads) + clock_reads);
+  ck_pr_store_64(&stat->repeats, ck_pr_load_64(&stat->repeats) + repeats);
+  ck_pr_store_64(&stat->backwards,
+                 ck_pr_load_64(&stat->backwards) + backwards);
+  ck_pr_store_64(&stat->min_step, min_step);
+
+  return 0;
+}
+
+
+void clock_print_mode(void)
+{
+  char buf[64];
+
+  log_text(LOG_INFO, "Doing clock source and timer overhead test\n");
+
+  if (sb_timer_clocksource(buf, sizeof(buf)))
+    log_text(LOG_NOTICE, "Kernel clocksource: %s", buf);
+
+  if (clock_ticks_per_ns > 0)
+  {
+#ifdef CLOCK_X86_TSC
+    const bool invariant = cpuinfo_has_flag("constant_tsc") &&
+      cpuinfo_has_flag("nonstop_tsc");
+
+    log_text(LOG_NOTICE, "TSC frequency: %.2f MHz (calibrated), %s",
+             clock_ticks_per_ns * 1000,
+             invariant ? "invariant" : "not invariant");
+#else
+    log_text(LOG_NOTICE, "Counter frequency: %.2f MHz (calibrated)",
+             clock_ticks_per_ns * 1000);
+#endif
+  }
+
+  log_text(LOG_NOTICE, "Available clocks (single thread):");
+  log_text(LOG_NOTICE, "  %-18s %10s %16s %18s", "clock", "ns/read",
+           "resolution, ns", "clock_getres, ns");
+
+  for (int i = 0; i < CLOCK_TYPE_MAX; i++)
+  {
+    const clock_info_t * const info = &clock_infos[i];
+
+    if (!info->available)
+      continue;
+
+    if (clock_is_counter((clock_type_t) i))
+      snprintf(buf, sizeof(buf), "-");
+    else
+      snprintf(buf, sizeof(buf), "%" PRIu64, info->getres);
+
+    log_text(LOG_NOTICE, "  %-18s %10.2f %16.2f %18s", clock_type_names[i],
+             info->cost, info->resolution, buf);
+  }
+
+  log_text(LOG_NOTICE, "");
+  log_text(LOG_NOTICE, "Clock: %s, %u read(s) per event\n",
+           clock_type_names[clock_type], clock_reads);
+}
+
+
+/* Print cumulative stats. */
+
+void clock_report_cumulative(sb_stat_t *stat)
+{
+  uint64_t reads = 0;
+  uint64_t repeats = 0;
+  uint64_t backwards = 0;
+  uint64_t min_step = UINT64_MAX;
+
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+  {
+    clock_stat_t * const s = &clock_stats[i];
+    const uint64_t       step = ck_pr_load_64(&s->min_step);
+
+    reads += ck_pr_load_64(&s->reads);
+    repeats += ck_pr_load_64(&s->repeats);
+    backwards += ck_pr_load_64(&s->backwards);
+    if (step < min_step)
+      min_step = step;
+  }
+
+  log_text(LOG_NOTICE, "Clock reads: %" PRIu64 " (%.2f per second)", reads,
+           reads / stat->time_interval);
+  /* Includes the per-event overhead, amortized over --clock-reads reads */
+  log_text(LOG_NOTICE, "Time per read (ns): min %.2f, avg %.2f, max %.2f",
+           stat->latency_min * 1e9 / clock_reads,
+           stat->latency_avg * 1e9 / clock_reads,
+           stat->latency_max * 1e9 / clock_reads);
+
+  if (min_step == UINT64_MAX)
+    log_text(LOG_NOTICE, "Resolution (ns): no step observed");
+  else
+    log_text(LOG_NOTICE, "Resolution (ns): %.2f",
+             clock_to_ns(clock_type, min_step));
+
+  log_text(LOG_NOTICE, "Repeated values: %" PRIu64 " (%.2f%%)", repeats,
+           reads > 0 ? repeats * 100.0 / reads : 0);
+  log_text(LOG_NOTICE, "Backward steps: %" PRIu64 "\n", backwards);
+
+  if (backwards > 0)
+    log_text(LOG_WARNING, "%s went backwards %" PRIu64 " time(s)",
+             clock_type_names[clock_type], backwards);
+
+  sb_report_cumulative(stat);
+}
@@ -0,0 +1,589 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Compute kernels for the CPU test workloads. Kernels using optional
+  instruction set extensions are compiled with the 'target' attribute and
+  selected at runtime, so the rest of the binary does not depend on them.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+
+#include "cpu_kernels.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define CPU_X86_KERNELS
+# include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+# define CPU_NEON_KERNELS
+# include <arm_neon.h>
+# ifdef __ARM_FEATURE_CRC32
+#  include <arm_acle.h>
+# endif
+#endif
+
+/* CRC-32C */
+
+#define CRC32C_POLY 0x82F63B78U
+
+static uint32_t crc32c_table[256];
+
+uint32_t (*crc32c_hw)(uint32_t crc, const void *buf, size_t len);
+
+uint32_t crc32c_sw(uint32_t crc, const void *buf, size_t len)
+{
+  const uint8_t *p = buf;
+
+  crc = ~crc;
+  while (len--)
+    crc = crc32c_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+  return ~crc;
+}
+
+#ifdef CPU_X86_KERNELS
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const void *buf, size_t len)
+{
+  const uint8_t *p = buf;
+  uint64_t      c = ~crc;
+
+  for (; len >= 8; len -= 8, p += 8)
+  {
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    c = _mm_crc32_u64(c, v);
+  }
+
+  while (len--)
+    c = _mm_crc32_u8((uint32_t) c, *p++);
+
+  return ~(uint32_t) c;
+}
+
+#elif defined(CPU_NEON_KERNELS) && defined(__ARM_FEATURE_CRC32)
+
+static uint32_t crc32c_armv8(uint32_t crc, const void *buf, size_t len)
+{
+  const uint8_t *p = buf;
+
+  crc = ~crc;
+
+  for (; len >= 8; len -= 8, p += 8)
+  {
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    crc = __crc32cd(crc, v);
+  }
+
+  while (len--)
+    crc = __crc32cb(crc, *p++);
+
+  return ~crc;
+}
+
+#endif
+
+void crc32c_init(void)
+{
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    uint32_t c = i;
+
+    for (int k = 0; k < 8; k++)
+      c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+
+    crc32c_table[i] = c;
+  }
+
+#ifdef CPU_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2"))
+    crc32c_hw = crc32c_sse42;
+#elif defined(CPU_NEON_KERNELS) && defined(__ARM_FEATURE_CRC32)
+  crc32c_hw = crc32c_armv8;
+#endif
+}
+
+/* SHA-256 */
+
+static const uint32_t sha256_k[64] =
+{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+  0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+  0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+  0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+  0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+void sha256_init(uint32_t state[8])
+{
+  static const uint32_t h0[8] =
+  {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c,
+    0x1f83d9ab, 0x5be0cd19
+  };
+
+  memcpy(state, h0, sizeof(h0));
+}
+
+void sha256_blocks(uint32_t state[8], const uint8_t *data, size_t nblocks)
+{
+  uint32_t w[64];
+
+  for (; nblocks > 0; nblocks--, data += 64)
+  {
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+      e = state[4], f = state[5], g = state[6], h = state[7];
+    int      i;
+
+    for (i = 0; i < 16; i++)
+      w[i] = (uint32_t) data[4 * i] << 24 | (uint32_t) data[4 * i + 1] << 16 |
+        (uint32_t) data[4 * i + 2] << 8 | data[4 * i + 3];
+
+    for (; i < 64; i++)
+    {
+      const uint32_t s0 = ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^
+        (w[i - 15] >> 3);
+      const uint32_t s1 = ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^
+        (w[i - 2] >> 10);
+
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    for (i = 0; i < 64; i++)
+    {
+      const uint32_t t1 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) +
+        ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+      const uint32_t t2 = (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) +
+        ((a & b) ^ (a & c) ^ (b & c));
+
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+/* AES-128 */
+
+#ifdef CPU_X86_KERNELS
+
+__attribute__((target("aes,sse2")))
+static inline __m128i aes_expand_step(__m128i k, __m128i t)
+{
+  t = _mm_shuffle_epi32(t, 0xff);
+  k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+  k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+  k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+
+  return _mm_xor_si128(k, t);
+}
+
+#define AES_EXPAND(i, rcon)                                             \
+  rk[i] = aes_expand_step(rk[i - 1],                                    \
+                          _mm_aeskeygenassist_si128(rk[i - 1], rcon))
+
+__attribute__((target("aes,sse2")))
+static void aes128_ctr_aesni(const uint8_t key[16], uint8_t *buf, size_t len)
+{
+  __m128i       rk[11];
+  __m128i       ctr = _mm_setzero_si128();
+  const __m128i one = _mm_set_epi64x(0, 1);
+
+  rk[0] = _mm_loadu_si128((const __m128i *) (const void *) key);
+  AES_EXPAND(1, 0x01);
+  AES_EXPAND(2, 0x02);
+  AES_EXPAND(3, 0x04);
+  AES_EXPAND(4, 0x08);
+  AES_EXPAND(5, 0x10);
+  AES_EXPAND(6, 0x20);
+  AES_EXPAND(7, 0x40);
+  AES_EXPAND(8, 0x80);
+  AES_EXPAND(9, 0x1b);
+  AES_EXPAND(10, 0x36);
+
+  for (size_t i = 0; i < len; i += 16)
+  {
+    __m128i b = _mm_xor_si128(ctr, rk[0]);
+
+    ctr = _mm_add_epi64(ctr, one);
+
+    for (int r = 1; r < 10; r++)
+      b = _mm_aesenc_si128(b, rk[r]);
+    b = _mm_aesenclast_si128(b, rk[10]);
+
+    __m128i *p = (__m128i *) (void *) (buf + i);
+    _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), b));
+  }
+}
+
+#endif /* CPU_X86_KERNELS */
+
+bool aes_supported(void)
+{
+#ifdef CPU_X86_KERNELS
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("aes");
+#else
+  return false;
+#endif
+}
+
+void aes128_ctr(const uint8_t key[16], uint8_t *buf, size_t len)
+{
+#ifdef CPU_X86_KERNELS
+  aes128_ctr_aesni(key, buf, len);
+#else
+  (void) key; /* unused */
+  (void) buf; /* unused */
+  (void) len; /* unused */
+#endif
+}
+
+/*
+  LZ77 compression. The output is a sequence of literal runs (a length byte
+  followed by up to 255 literals) and matches (a 2-byte offset and a length
+  byte), which is enough to model the work done by fast LZ-family compressors.
+*/
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_MATCH (255 + LZ_MIN_MATCH)
+#define LZ_MAX_OFFSET 65535
+
+static size_t lz_literals(const uint8_t *in, size_t len, uint8_t *out)
+{
+  size_t op = 0;
+
+  while (len > 0)
+  {
+    const size_t n = len > 255 ? 255 : len;
+
+    out[op++] = (uint8_t) n;
+    memcpy(out + op, in, n);
+    op += n;
+    in += n;
+    len -= n;
+  }
+
+  return op;
+}
+
+size_t lz_compress(const uint8_t *in, size_t len, uint8_t *out,
+                   uint32_t *htab)
+{
+  size_t ip = 0, op = 0, anchor = 0;
+
+  memset(htab, 0, LZ_HASH_SIZE * sizeof(uint32_t));
+
+  while (ip + LZ_MIN_MATCH <= len)
+  {
+    uint32_t seq, h;
+    size_t   ref;
+
+    memcpy(&seq, in + ip, sizeof(seq));
+    h = (seq * 2654435761U) >> (32 - LZ_HASH_BITS);
+
+    /* Positions are stored +1, so 0 means an empty slot */
+    ref = htab[h];
+    htab[h] = (uint32_t) ip + 1;
+
+    if (ref == 0 || ip - --ref > LZ_MAX_OFFSET ||
+        memcmp(in + ref, in + ip, LZ_MIN_MATCH))
+    {
+      ip++;
+      continue;
+    }
+
+    size_t m = LZ_MIN_MATCH;
+    while (ip + m < len && m < LZ_MAX_MATCH && in[ref + m] == in[ip + m])
+      m++;
+
+    op += lz_literals(in + anchor, ip - anchor, out + op);
+
+    out[op++] = (uint8_t) ((ip - ref) & 0xFF);
+    out[op++] = (uint8_t) ((ip - ref) >> 8);
+    out[op++] = (uint8_t) (m - LZ_MIN_MATCH);
+
+    ip += m;
+    anchor = ip;
+  }
+
+  op += lz_literals(in + anchor, len - anchor, out + op);
+
+  return op;
+}
+
+/* Matrix multiplication, c = a * b, row-major */
+
+static void matmul_scalar(double *c, const double *a, const double *b,
+                          size_t n)
+{
+  memset(c, 0, n * n * sizeof(double));
+
+  for (size_t i = 0; i < n; i++)
+    for (size_t k = 0; k < n; k++)
+    {
+      const double aik = a[i * n + k];
+
+      for (size_t j = 0; j < n; j++)
+        c[i * n + j] += aik * b[k * n + j];
+    }
+}
+
+#ifdef CPU_X86_KERNELS
+
+/* Both kernels process 8 columns of a row of 'c' per iteration */
+
+__attribute__((target("sse2")))
+static void matmul_sse2(double *c, const double *a, const double *b, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    for (size_t j = 0; j < n; j += 8)
+    {
+      __m128d c0 = _mm_setzero_pd(), c1 = c0, c2 = c0, c3 = c0;
+
+      for (size_t k = 0; k < n; k++)
+      {
+        const __m128d aik = _mm_set1_pd(a[i * n + k]);
+        const double  *bk = b + k * n + j;
+
+        c0 = _mm_add_pd(c0, _mm_mul_pd(aik, _mm_load_pd(bk)));
+        c1 = _mm_add_pd(c1, _mm_mul_pd(aik, _mm_load_pd(bk + 2)));
+        c2 = _mm_add_pd(c2, _mm_mul_pd(aik, _mm_load_pd(bk + 4)));
+        c3 = _mm_add_pd(c3, _mm_mul_pd(aik, _mm_load_pd(bk + 6)));
+      }
+
+      _mm_store_pd(c + i * n + j, c0);
+      _mm_store_pd(c + i * n + j + 2, c1);
+      _mm_store_pd(c + i * n + j + 4, c2);
+      _mm_store_pd(c + i * n + j + 6, c3);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void matmul_avx2(double *c, const double *a, const double *b, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    for (size_t j = 0; j < n; j += 8)
+    {
+      __m256d c0 = _mm256_setzero_pd(), c1 = c0;
+
+      for (size_t k = 0; k < n; k++)
+      {
+        const __m256d aik = _mm256_set1_pd(a[i * n + k]);
+        const double  *bk = b + k * n + j;
+
+        c0 = _mm256_fmadd_pd(aik, _mm256_load_pd(bk), c0);
+        c1 = _mm256_fmadd_pd(aik, _mm256_load_pd(bk + 4), c1);
+      }
+
+      _mm256_store_pd(c + i * n + j, c0);
+      _mm256_store_pd(c + i * n + j + 4, c1);
+    }
+}
+
+#elif defined(CPU_NEON_KERNELS)
+
+static void matmul_neon(double *c, const double *a, const double *b, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    for (size_t j = 0; j < n; j += 8)
+    {
+      float64x2_t c0 = vdupq_n_f64(0), c1 = c0, c2 = c0, c3 = c0;
+
+      for (size_t k = 0; k < n; k++)
+      {
+        const float64x2_t aik = vdupq_n_f64(a[i * n + k]);
+        const double      *bk = b + k * n + j;
+
+        c0 = vfmaq_f64(c0, aik, vld1q_f64(bk));
+        c1 = vfmaq_f64(c1, aik, vld1q_f64(bk + 2));
+        c2 = vfmaq_f64(c2, aik, vld1q_f64(bk + 4));
+        c3 = vfmaq_f64(c3, aik, vld1q_f64(bk + 6));
+      }
+
+      vst1q_f64(c + i * n + j, c0);
+      vst1q_f64(c + i * n + j + 2, c1);
+      vst1q_f64(c + i * n + j + 4, c2);
+      vst1q_f64(c + i * n + j + 6, c3);
+    }
+}
+
+#endif
+
+matmul_func_t *matmul_select(const char **isa)
+{
+#ifdef CPU_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+  {
+    *isa = "avx2";
+    return matmul_avx2;
+  }
+  if (__builtin_cpu_supports("sse2"))
+  {
+    *isa = "sse2";
+    return matmul_sse2;
+  }
+#elif defined(CPU_NEON_KERNELS)
+  *isa = "neon";
+  return matmul_neon;
+#endif
+
+  *isa = "scalar";
+  return matmul_scalar;
+}
+
+/* Hash table with linear probing */
+
+static inline uint64_t hash_slot(const hash_table_t *t, uint64_t key)
+{
+  return (key * UINT64_C(0x9E3779B97F4A7C15)) >> 17 & t->mask;
+}
+
+bool hash_lookup(const hash_table_t *t, uint64_t key)
+{
+  for (uint64_t i = hash_slot(t, key); ; i = (i + 1) & t->mask)
+  {
+    if (t->keys[i] == key)
+      return true;
+    if (t->keys[i] == 0)
+      return false;
+  }
+}
+
+void hash_insert(hash_table_t *t, uint64_t key)
+{
+  uint64_t i;
+
+  for (i = hash_slot(t, key); t->keys[i] != 0 && t->keys[i] != key;
+       i = (i + 1) & t->mask) ;
+
+  t->keys[i] = key;
+}
+
+/*
+  Bytecode interpreter. Conditional branches depend on register values, so
+  the control flow is hard to predict, as in query expression evaluators.
+*/
+
+enum
+{
+  OP_ADD,
+  OP_SUB,
+  OP_XOR,
+  OP_MUL,
+  OP_SHR,
+  OP_LOADI,
+  OP_BRODD,                     /* branch by 'arg' if 'src' is odd */
+  OP_BRLT,                      /* branch by 'arg' if dst < src */
+  OP_MAX
+};
+
+void interp_generate(interp_insn_t *prog, size_t len, uint64_t (*rnd)(void))
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    const uint64_t r = rnd();
+
+    prog[i].op = r % OP_MAX;
+    prog[i].dst = (r >> 8) % INTERP_NREGS;
+    prog[i].src = (r >> 16) % INTERP_NREGS;
+    prog[i].arg = (uint8_t) (r >> 24);
+  }
+}
+
+uint64_t interp_run(const interp_insn_t *prog, size_t len, size_t steps,
+                    uint64_t seed)
+{
+  uint64_t reg[INTERP_NREGS];
+  size_t   pc = 0;
+
+  for (int i = 0; i < INTERP_NREGS; i++)
+    reg[i] = seed + i;
+
+  while (steps-- > 0)
+  {
+    const interp_insn_t *insn = &prog[pc];
+
+    pc = pc + 1 < len ? pc + 1 : 0;
+
+    switch (insn->op) {
+    case OP_ADD:
+      reg[insn->dst] += reg[insn->src];
+      break;
+    case OP_SUB:
+      reg[insn->dst] -= reg[insn->src];
+      break;
+    case OP_XOR:
+      reg[insn->dst] ^= reg[insn->src];
+      break;
+    case OP_MUL:
+      reg[insn->dst] *= reg[insn->src] | 1;
+      break;
+    case OP_SHR:
+      reg[insn->dst] ^= reg[insn->src] >> (insn->arg & 63);
+      break;
+    case OP_LOADI:
+      reg[insn->dst] = reg[insn->dst] << 8 | insn->arg;
+      break;
+    case OP_BRODD:
+      if (reg[insn->src] & 1)
+        pc = (pc + insn->arg) % len;
+      break;
+    case OP_BRLT:
+      if (reg[insn->dst] < reg[insn->src])
+        pc = (pc + insn->arg) % len;
+      break;
+    }
+  }
+
+  return reg[0] ^ reg[INTERP_NREGS - 1];
+}
@@ -0,0 +1,96 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/* Compute kernels for the CPU test workloads */
+
+#ifndef CPU_KERNELS_H
+#define CPU_KERNELS_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* CRC-32C (Castagnoli). crc32c_init() must be called before crc32c_sw(). */
+void crc32c_init(void);
+uint32_t crc32c_sw(uint32_t crc, const void *buf, size_t len);
+/* Hardware CRC-32C, NULL if not supported by the CPU */
+extern uint32_t (*crc32c_hw)(uint32_t crc, const void *buf, size_t len);
+
+/* SHA-256 compression function over 'nblocks' 64-byte blocks */
+void sha256_blocks(uint32_t state[8], const uint8_t *data, size_t nblocks);
+void sha256_init(uint32_t state[8]);
+
+/*
+  AES-128 encryption in CTR mode, in place, using AES instructions. May only be
+  called if aes_supported() returns true. 'len' must be a multiple of 16.
+*/
+bool aes_supported(void);
+void aes128_ctr(const uint8_t key[16], uint8_t *buf, size_t len);
+
+/*
+  Greedy LZ77 compressor with a 4-byte hash. 'out' must be at least
+  LZ_BOUND(len) bytes, 'htab' has LZ_HASH_SIZE entries. Returns the compressed
+  size.
+*/
+#define LZ_HASH_BITS 12
+#define LZ_HASH_SIZE (1U << LZ_HASH_BITS)
+#define LZ_BOUND(len) ((len) + (len) / 255 + 16)
+size_t lz_compress(const uint8_t *in, size_t len, uint8_t *out,
+                   uint32_t *htab);
+
+/*
+  Multiply n x n matrices of doubles, c = a * b. 'n' must be a multiple of 8,
+  all matrices 64-byte aligned.
+*/
+typedef void matmul_func_t(double *c, const double *a, const double *b,
+                           size_t n);
+
+/* Name of the instruction set used by the returned function */
+matmul_func_t *matmul_select(const char **isa);
+
+/* Open addressing hash table of non-zero 64-bit keys */
+typedef struct
+{
+  uint64_t *keys;
+  uint64_t mask;
+} hash_table_t;
+
+bool hash_lookup(const hash_table_t *t, uint64_t key);
+void hash_insert(hash_table_t *t, uint64_t key);
+
+/* Bytecode interpreter with data-dependent branches */
+typedef struct
+{
+  uint8_t  op;
+  uint8_t  dst;
+  uint8_t  src;
+  uint8_t  arg;
+} interp_insn_t;
+
+#define INTERP_NREGS 8
+
+/* Generate a random program using 'rnd' as the source of randomness */
+void interp_generate(interp_insn_t *prog, size_t len, uint64_t (*rnd)(void));
+uint64_t interp_run(const interp_insn_t *prog, size_t len, size_t steps,
+                    uint64_t seed);
+
+#endif /* CPU_KERNELS_H */
@@ -23,21 +23,64 @@
 #ifdef HAVE_MATH_H
 # include <math.h>
 #endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
 
 #include <inttypes.h>
 
 #include "sysbench.h"
+#include "sb_ck_pr.h"
+#include "sb_rand.h"
+#include "sb_util.h"
+
+#include "cpu_kernels.h"
+#include "../fileio/crc32.h"
 
 /* CPU test arguments */
 static sb_arg_t cpu_args[] =
 {
   SB_OPT("cpu-max-prime", "upper limit for primes generator", "10000", INT),
+  SB_OPT("cpu-workload", "type of work to do per event {prime, crc32, "
+         "crc32c, sha256, aes, compress, matmul, hash, interp}", "prime",
+         STRING),
+  SB_OPT("cpu-block-size", "size of data processed per event by the crc32, "
+         "crc32c, sha256, aes and compress workloads", "16K", SIZE),
+  SB_OPT("cpu-matrix-size", "matrix dimension for the matmul workload, must "
+         "be a multiple of 8", "64", INT),
+  SB_OPT("cpu-hash-size", "hash table size for the hash workload", "16M",
+         SIZE),
+  SB_OPT("cpu-hash-lookups", "number of hash table lookups per event",
+         "10000", INT),
+  SB_OPT("cpu-interp-steps", "number of instructions executed per event by "
+         "the interp workload", "100000", INT),
 
   SB_OPT_END
 };
 
+typedef enum
+{
+  CPU_WORKLOAD_PRIME,
+  CPU_WORKLOAD_CRC32,
+  CPU_WORKLOAD_CRC32C,
+  CPU_WORKLOAD_SHA256,
+  CPU_WORKLOAD_AES,
+  CPU_WORKLOAD_COMPRESS,
+  CPU_WORKLOAD_MATMUL,
+  CPU_WORKLOAD_HASH,
+  CPU_WORKLOAD_INTERP
+} cpu_workload_t;
+
+static const char *cpu_workload_names[] =
+{
+  "prime", "crc32", "crc32c", "sha256", "aes", "compress", "matmul", "hash",
+  "interp", NULL
+};
+
 /* CPU test operations */
 static int cpu_init(void);
+static int cpu_thread_init(int);
+static int cpu_thread_done(int);
 static void cpu_print_mode(void);
 static sb_event_t cpu_next_event(int thread_id);
 static int cpu_execute_event(sb_event_t *, int);
@@ -50,6 +93,8 @@ static sb_test_t cpu_test =
   .lname = "CPU performance test",
   .ops = {
     .init = cpu_init,
+    .thread_init = cpu_thread_init,
+    .thread_done = cpu_thread_done,
     .print_mode = cpu_print_mode,
     .next_event = cpu_next_event,
     .execute_event = cpu_execute_event,
@@ -62,6 +107,29 @@ static sb_test_t cpu_test =
 /* Upper limit for primes */
 static unsigned int    max_prime;
 
+static cpu_workload_t  cpu_workload;
+static size_t          cpu_block_size;
+static size_t          cpu_matrix_size;
+static unsigned int    cpu_hash_lookups;
+static size_t          cpu_interp_steps;
+
+static matmul_func_t   *cpu_matmul;
+static const char      *cpu_matmul_isa;
+
+/* Shared by all threads, read-only during the test */
+static hash_table_t    cpu_hash;
+
+#define INTERP_PROG_LEN 1024
+static interp_insn_t   cpu_interp_prog[INTERP_PROG_LEN];
+
+/* Per-thread input and output buffers */
+static TLS uint8_t     *tls_in;
+static TLS uint8_t     *tls_out;
+static TLS uint32_t    *tls_htab;
+
+/* Keeps results of computations alive */
+static TLS uint64_t    tls_sink;
+
 int register_test_cpu(sb_list_t * tests)
 {
   SB_LIST_ADD_TAIL(&cpu_test.listitem, tests);
@@ -69,6 +137,56 @@ int register_test_cpu(sb_list_t * tests)
   return 0;
 }
 
+
+/* Key number 'i' in the hash table, never 0 */
+
+static inline uint64_t hash_key(uint64_t i)
+{
+  return (i + 1) * UINT64_C(0xD6E8FEB86659FD93);
+}
+
+
+static int cpu_hash_init(void)
+{
+  const size_t entries = sb_get_value_size("cpu-hash-size") / sizeof(uint64_t);
+  size_t       n = 1;
+  int          lookups = sb_get_value_int("cpu-hash-lookups");
+
+  if (lookups <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value of cpu-hash-lookups: %d.", lookups);
+    return 1;
+  }
+  cpu_hash_lookups = (unsigned int) lookups;
+
+  /* Round down to a power of 2 */
+  while (n * 2 <= entries)
+    n *= 2;
+
+  if (n < 2)
+  {
+    log_text(LOG_FATAL, "--cpu-hash-size is too small");
+    return 1;
+  }
+
+  cpu_hash.mask = n - 1;
+  cpu_hash.keys = sb_memalign(n * sizeof(uint64_t), sb_getpagesize());
+  if (cpu_hash.keys == NULL)
+  {
+    log_text(LOG_FATAL, "Failed to allocate %zu bytes for the hash table",
+             n * sizeof(uint64_t));
+    return 1;
+  }
+  memset(cpu_hash.keys, 0, n * sizeof(uint64_t));
+
+  /* 50% load factor */
+  for (size_t i = 0; i < n / 2; i++)
+    hash_insert(&cpu_hash, hash_key(i));
+
+  return 0;
+}
+
+
 int cpu_init(void)
 {
   int prime_option= sb_get_value_int("cpu-max-prime");
@@ -79,6 +197,164 @@ int cpu_init(void)
   }
   max_prime= (unsigned int)prime_option;
 
+  const char *s = sb_get_value_string("cpu-workload");
+  unsigned int i;
+
+  for (i = 0; cpu_workload_names[i] != NULL; i++)
+    if (!strcmp(s, cpu_workload_names[i]))
+      break;
+
+  if (cpu_workload_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value of cpu-workload: %s.", s);
+    return 1;
+  }
+  cpu_workload = (cpu_workload_t) i;
+
+  cpu_block_size = sb_get_value_size("cpu-block-size");
+  if (cpu_block_size == 0 || cpu_block_size % 64 != 0)
+  {
+    log_text(LOG_FATAL, "--cpu-block-size must be a non-zero multiple of 64");
+    return 1;
+  }
+
+  switch (cpu_workload) {
+  case CPU_WORKLOAD_CRC32C:
+    crc32c_init();
+    break;
+
+  case CPU_WORKLOAD_AES:
+    if (!aes_supported())
+    {
+      log_text(LOG_FATAL, "The aes workload requires AES instructions which "
+               "are not supported by this CPU");
+      return 1;
+    }
+    break;
+
+  case CPU_WORKLOAD_MATMUL:
+    {
+      const int n = sb_get_value_int("cpu-matrix-size");
+
+      if (n <= 0 || n % 8 != 0)
+      {
+        log_text(LOG_FATAL, "--cpu-matrix-size must be a positive multiple "
+                 "of 8");
+        return 1;
+      }
+      cpu_matrix_size = (size_t) n;
+      cpu_matmul = matmul_select(&cpu_matmul_isa);
+    }
+    break;
+
+  case CPU_WORKLOAD_HASH:
+    if (cpu_hash_init())
+      return 1;
+    break;
+
+  case CPU_WORKLOAD_INTERP:
+    {
+      const int n = sb_get_value_int("cpu-interp-steps");
+
+      if (n <= 0)
+      {
+        log_text(LOG_FATAL, "Invalid value of cpu-interp-steps: %d.", n);
+        return 1;
+      }
+      cpu_interp_steps = (size_t) n;
+      interp_generate(cpu_interp_prog, INTERP_PROG_LEN,
+                      sb_rand_uniform_uint64);
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  return 0;
+}
+
+
+/*
+  Fill a buffer with moderately compressible data: random 8-byte words from a
+  small dictionary.
+*/
+
+static void fill_buffer(uint8_t *buf, size_t len)
+{
+  uint64_t dict[64];
+
+  for (size_t i = 0; i < 64; i++)
+    dict[i] = sb_rand_uniform_uint64();
+
+  for (size_t i = 0; i + 8 <= len; i += 8)
+    memcpy(buf + i, &dict[sb_rand_uniform_uint64() % 64], 8);
+}
+
+
+int cpu_thread_init(int thread_id)
+{
+  size_t in_size = 0, out_size = 0;
+
+  (void) thread_id; /* unused */
+
+  switch (cpu_workload) {
+  case CPU_WORKLOAD_CRC32:
+  case CPU_WORKLOAD_CRC32C:
+  case CPU_WORKLOAD_SHA256:
+  case CPU_WORKLOAD_AES:
+    in_size = cpu_block_size;
+    break;
+  case CPU_WORKLOAD_COMPRESS:
+    in_size = cpu_block_size;
+    out_size = LZ_BOUND(cpu_block_size);
+    tls_htab = malloc(LZ_HASH_SIZE * sizeof(uint32_t));
+    if (tls_htab == NULL)
+      goto error;
+    break;
+  case CPU_WORKLOAD_MATMUL:
+    /* Matrices a and b are in 'in', c in 'out' */
+    in_size = 2 * cpu_matrix_size * cpu_matrix_size * sizeof(double);
+    out_size = cpu_matrix_size * cpu_matrix_size * sizeof(double);
+    break;
+  default:
+    return 0;
+  }
+
+  tls_in = sb_memalign(in_size, CK_MD_CACHELINE);
+  if (tls_in == NULL)
+    goto error;
+
+  if (out_size > 0 && (tls_out = sb_memalign(out_size, CK_MD_CACHELINE)) ==
+      NULL)
+    goto error;
+
+  if (cpu_workload == CPU_WORKLOAD_MATMUL)
+  {
+    double *m = (double *) (void *) tls_in;
+
+    for (size_t i = 0; i < 2 * cpu_matrix_size * cpu_matrix_size; i++)
+      m[i] = sb_rand_uniform_double();
+  }
+  else
+    fill_buffer(tls_in, in_size);
+
+  return 0;
+
+error:
+  log_text(LOG_FATAL, "Memory allocation failure!");
+  return 1;
+}
+
+
+int cpu_thread_done(int thread_id)
+{
+  (void) thread_id; /* unused */
+
+  free(tls_in);
+  free(tls_out);
+  free(tls_htab);
+
   return 0;
 }
 
@@ -94,16 +370,14 @@ sb_event_t cpu_next_event(int thread_id)
   return req;
 }
 
-int cpu_execute_event(sb_event_t *r, int thread_id)
+
+static void cpu_prime(void)
 {
   unsigned long long c;
   unsigned long long l;
   double t;
   unsigned long long n=0;
 
-  (void)thread_id; /* unused */
-  (void)r; /* unused */
-
   /* So far we're using very simple test prime number tests in 64bit */
 
   for(c=3; c < max_prime; c++)
@@ -115,14 +389,129 @@ int cpu_execute_event(sb_event_t *r, int thread_id)
     if (l > t )
       n++; 
   }
+}
+
+
+int cpu_execute_event(sb_event_t *r, int thread_id)
+{
+  uint64_t res = 0;
+
+  (void)thread_id; /* unused */
+  (void)r; /* unused */
+
+  switch (cpu_workload) {
+  case CPU_WORKLOAD_PRIME:
+    cpu_prime();
+    return 0;
+
+  case CPU_WORKLOAD_CRC32:
+    res = crc32(0, tls_in, cpu_block_size);
+    break;
+
+  case CPU_WORKLOAD_CRC32C:
+    res = crc32c_hw != NULL ? crc32c_hw(0, tls_in, cpu_block_size) :
+      crc32c_sw(0, tls_in, cpu_block_size);
+    break;
+
+  case CPU_WORKLOAD_SHA256:
+    {
+      uint32_t state[8];
+
+      sha256_init(state);
+      sha256_blocks(state, tls_in, cpu_block_size / 64);
+      res = state[0];
+    }
+    break;
+
+  case CPU_WORKLOAD_AES:
+    {
+      const uint8_t key[16] = "sysbench aes key";
+
+      /* Encrypts the buffer in place, so each event processes new data */
+      aes128_ctr(key, tls_in, cpu_block_size);
+      res = tls_in[0];
+    }
+    break;
+
+  case CPU_WORKLOAD_COMPRESS:
+    res = lz_compress(tls_in, cpu_block_size, tls_out, tls_htab);
+    break;
+
+  case CPU_WORKLOAD_MATMUL:
+    {
+      const double * const a = (const double *) (void *) tls_in;
+      const size_t         nn = cpu_matrix_size * cpu_matrix_size;
+      double * const       c = (double *) (void *) tls_out;
+
+      cpu_matmul(c, a, a + nn, cpu_matrix_size);
+      res = (uint64_t) c[nn - 1];
+    }
+    break;
+
+  case CPU_WORKLOAD_HASH:
+    /* Keys are drawn from twice the number of stored keys, half are misses */
+    for (unsigned int i = 0; i < cpu_hash_lookups; i++)
+      res += hash_lookup(&cpu_hash,
+                         hash_key(sb_rand_uniform_uint64() & cpu_hash.mask));
+    break;
+
+  case CPU_WORKLOAD_INTERP:
+    res = interp_run(cpu_interp_prog, INTERP_PROG_LEN, cpu_interp_steps,
+                     sb_rand_uniform_uint64());
+    break;
+  }
+
+  ck_pr_store_64(&tls_sink, res);
 
   return 0;
 }
 
+
+/* Return true if the workload processes --cpu-block-size bytes per event */
+
+static bool cpu_workload_bytes(void)
+{
+  return cpu_workload >= CPU_WORKLOAD_CRC32 &&
+    cpu_workload <= CPU_WORKLOAD_COMPRESS;
+}
+
+
 void cpu_print_mode(void)
 {
+  char buf[16];
+
   log_text(LOG_INFO, "Doing CPU performance benchmark\n");  
-  log_text(LOG_NOTICE, "Prime numbers limit: %d\n", max_prime);
+
+  switch (cpu_workload) {
+  case CPU_WORKLOAD_PRIME:
+    log_text(LOG_NOTICE, "Prime numbers limit: %d\n", max_prime);
+    return;
+  case CPU_WORKLOAD_CRC32C:
+    log_text(LOG_NOTICE, "Workload: crc32c (%s), block size: %sB\n",
+             crc32c_hw != NULL ? "hardware" : "software",
+             sb_print_value_size(buf, sizeof(buf), cpu_block_size));
+    return;
+  case CPU_WORKLOAD_MATMUL:
+    log_text(LOG_NOTICE, "Workload: matmul (%s), matrix size: %zux%zu\n",
+             cpu_matmul_isa, cpu_matrix_size, cpu_matrix_size);
+    return;
+  case CPU_WORKLOAD_HASH:
+    log_text(LOG_NOTICE, "Workload: hash, table size: %sB, %u lookups per "
+             "event\n", sb_print_value_size(buf, sizeof(buf),
+                                            (cpu_hash.mask + 1) *
+                                            sizeof(uint64_t)),
+             cpu_hash_lookups);
+    return;
+  case CPU_WORKLOAD_INTERP:
+    log_text(LOG_NOTICE, "Workload: interp, %zu instructions per event\n",
+             cpu_interp_steps);
+    return;
+  default:
+    log_text(LOG_NOTICE, "Workload: %s, block size: %sB\n",
+             cpu_workload_names[cpu_workload],
+             sb_print_value_size(buf, sizeof(buf), cpu_block_size));
+    return;
+  }
 }
 
 /* Print cumulative stats. */
@@ -133,11 +522,23 @@ void cpu_report_cumulative(sb_stat_t *stat)
   log_text(LOG_NOTICE, "    events per second: %8.2f",
            stat->events / stat->time_interval);
 
+  if (cpu_workload_bytes())
+    log_text(LOG_NOTICE, "    MiB per second:    %8.2f",
+             stat->events * cpu_block_size / (1024.0 * 1024.0) /
+             stat->time_interval);
+  else if (cpu_workload == CPU_WORKLOAD_MATMUL)
+    log_text(LOG_NOTICE, "    GFLOPS:            %8.2f",
+             stat->events * 2.0 * cpu_matrix_size * cpu_matrix_size *
+             cpu_matrix_size / 1e9 / stat->time_interval);
+
   sb_report_cumulative(stat);
 }
 
 
 int cpu_done(void)
 {
+  free(cpu_hash.keys);
+  cpu_hash.keys = NULL;
+
   return 0;
 }
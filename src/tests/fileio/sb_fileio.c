@@ -42,9 +42,30 @@
 #ifdef HAVE_LIBAIO
 # include <libaio.h>
 #endif
+#ifdef HAVE_LIBURING
+# include <liburing.h>
+#endif
 #ifdef HAVE_SYS_MMAN_H
 # include <sys/mman.h>
 #endif
+#ifdef HAVE_SYS_SYSMACROS_H
+# include <sys/sysmacros.h>
+#endif
+#ifdef HAVE_SYS_EVENTFD_H
+# include <sys/eventfd.h>
+#endif
+#ifdef HAVE_LINUX_FS_H
+# include <linux/fs.h>
+# include <sys/ioctl.h>
+# include <dirent.h>
+# include <limits.h>
+#endif
+#ifdef HAVE_POLL_H
+# include <poll.h>
+#endif
+#ifdef HAVE_SCHED_H
+# include <sched.h>
+#endif
 
 #include "sysbench.h"
 #include "crc32.h"
@@ -52,10 +73,23 @@
 #include "sb_rand.h"
 #include "sb_util.h"
 #include "sb_counter.h"
+#include "sb_ck_pr.h"
+#include "sb_thread.h"
+#include "ck_ring.h"
+#include "sb_trace.h"
+#include "../cpu/cpu_kernels.h"
 
-/* Lengths of the checksum and the offset fields in a block */
-#define FILE_CHECKSUM_LENGTH sizeof(int)
-#define FILE_OFFSET_LENGTH sizeof(long)
+/*
+  Header at the start of each block written with --validate. The rest of the
+  block is random data.
+*/
+typedef struct
+{
+  uint32_t        checksum;     /* CRC-32C of the block after this field */
+  uint32_t        file_id;
+  uint64_t        offset;       /* block offset in the file */
+  uint64_t        generation;   /* write number, 0 for blocks from 'prepare' */
+} file_block_header_t;
 
 typedef int FILE_DESCRIPTOR;
 #define VALID_FILE(fd) (fd >= 0)
@@ -81,12 +115,21 @@ typedef enum
   FSYNC_DATA
 } file_fsync_mode_t;
 
+/* How test files are allocated by 'prepare' */
+typedef enum
+{
+  FILE_PREPARE_WRITE,
+  FILE_PREPARE_FALLOCATE,
+  FILE_PREPARE_SPARSE
+} file_prepare_mode_t;
+
 /* File I/O modes */
 typedef enum
 {
   FILE_IO_MODE_SYNC,
   FILE_IO_MODE_ASYNC,
-  FILE_IO_MODE_MMAP
+  FILE_IO_MODE_MMAP,
+  FILE_IO_MODE_URING
 } file_io_mode_t;
 
 typedef enum {
@@ -95,6 +138,26 @@ typedef enum {
   SB_FILE_FLAG_DIRECTIO = 4
 } file_flags_t;
 
+#if defined(HAVE_LIBAIO) || defined(HAVE_LIBURING)
+# define SB_FILE_ASYNC
+#endif
+
+/* Raw block devices with --file-device */
+#if defined(HAVE_LINUX_FS_H) && defined(BLKGETSIZE64) && defined(BLKSSZGET)
+# define SB_FILE_DEVICE
+#endif
+
+/* Page cache control and hit ratio sampling */
+#if defined(HAVE_MMAP) && defined(HAVE_MINCORE) && defined(HAVE_POSIX_FADVISE)
+# define SB_FILE_CACHE
+#endif
+
+/* Hole punching and zeroing with --file-discard-mode */
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_PUNCH_HOLE) && \
+  defined(FALLOC_FL_ZERO_RANGE)
+# define SB_FILE_FALLOCATE
+#endif
+
 #ifdef HAVE_LIBAIO
 /* Per-thread async I/O context */
 typedef struct
@@ -110,18 +173,111 @@ typedef struct
   struct iocb   iocb; 
   sb_file_op_t  type;
   ssize_t       len;
+  unsigned int  size_class;   /* index in file_size_classes */
+  uint64_t      start_ns;     /* submission time for latency histograms */
 } sb_aio_oper_t;
 
 static sb_aio_context_t *aio_ctxts;
 #endif
 
+#ifdef HAVE_LIBURING
+/* io_uring operation */
+typedef struct
+{
+  sb_file_op_t  type;
+  ssize_t       len;
+  unsigned int  size_class;   /* index in file_size_classes */
+  uint64_t      start_ns;     /* submission time for latency histograms */
+} sb_uring_oper_t;
+
+/* Per-thread io_uring context */
+typedef struct
+{
+  struct io_uring ring;         /* submission/completion rings */
+  unsigned int    nrequests;    /* Number of in-flight requests */
+  unsigned int    nqueued;      /* Number of prepared, but unsubmitted SQEs */
+  sb_uring_oper_t *opers;       /* Preallocated operations */
+  /* Unused operations, returned by the thread reaping completions */
+  ck_ring_t        free_ring;
+  ck_ring_buffer_t *free_opers;
+} sb_uring_context_t;
+
+static sb_uring_context_t *uring_ctxts;
+#endif
+
+#ifdef SB_FILE_ASYNC
+/*
+  Thread reaping async or io_uring completions of --file-async-reaper workers,
+  so workers only submit requests. Completions are accounted to the worker
+  that submitted them.
+*/
+typedef struct
+{
+  pthread_t    thread;
+  unsigned int first;           /* First worker served */
+  unsigned int last;            /* Last worker served + 1 */
+  int          efd;             /* eventfd signalled on completions */
+} file_reaper_t;
+
+static file_reaper_t *file_reapers;
+static unsigned int  file_nreapers;     /* 0 when workers reap themselves */
+static unsigned int  file_async_reaper;
+static int           file_async_poll;
+static int           file_reapers_stop;
+static int           file_reaper_failed;
+#endif
+
 typedef struct
 {
   void           *buffer;
   unsigned int    buffer_file_id;
   long long       buffer_pos;
+  unsigned int    size_class;   /* size class of the current request */
+  uint64_t        discards;     /* requests done with --file-discard-ratio */
+  uint64_t        bytes_discarded;
+  unsigned int    cache_seq;    /* reads since the last mincore() sample */
+  uint64_t        cache_reads;  /* reads sampled with mincore() */
+  uint64_t        cache_hits;   /* sampled reads found in page cache */
+#ifdef HAVE_MMAP
+  /* Mapping window with --file-mmap-window */
+  char           *mmap_addr;
+  unsigned int    mmap_file_id;
+  long long       mmap_start;
+  size_t          mmap_len;
+#endif
 } sb_per_thread_t;
 
+/* Maximum number of classes in --file-block-sizes */
+#define FILE_MAX_SIZE_CLASSES 16
+
+/* Request size class from --file-block-sizes */
+typedef struct
+{
+  unsigned int    size;
+  unsigned int    weight;
+  unsigned int    cum_weight;   /* sum of weights up to this class */
+} file_size_class_t;
+
+/* Counters from the block device 'stat' file, see Documentation/block/stat */
+typedef struct
+{
+  uint64_t        reads;
+  uint64_t        read_merges;
+  uint64_t        read_ticks;   /* ms */
+  uint64_t        writes;
+  uint64_t        write_merges;
+  uint64_t        write_ticks;  /* ms */
+  uint64_t        io_ticks;     /* ms the device had I/O in flight */
+  uint64_t        time_in_queue; /* ms weighted by the number of requests */
+} file_diskstats_t;
+
+/* Per-thread I/O counters for a size class, indexed by reads/writes */
+typedef struct
+{
+  uint64_t        ops[2];
+  uint64_t        bytes[2];
+} file_class_stats_t;
+
 static sb_per_thread_t	*per_thread;
 
 /* Test options */
@@ -134,21 +290,183 @@ static int               file_fsync_freq;
 static int               file_fsync_all;
 static int               file_fsync_end;
 static file_fsync_mode_t file_fsync_mode;
+static file_prepare_mode_t file_prepare_mode;
 static double            file_rw_ratio;
+/* Block selection distribution, NULL for uniform over the whole file set */
+static uint32_t          (*file_rand_func)(uint32_t, uint32_t);
+static double            file_hotspot_move;
+static long long         file_nblocks;
+static uint64_t          file_start_ns;
+/* Per-operation latency histograms, indexed by sb_file_op_t */
+static sb_histogram_t    file_op_histograms[FILE_OP_TYPE_DISCARD + 1];
+static bool              file_op_latency[FILE_OP_TYPE_DISCARD + 1];
+static sb_pages_t        file_buffer_pages;
+static bool              file_buffer_populate;
 static int               file_merged_requests;
 static long long         file_request_size;
+/* Request size classes, none unless --file-block-sizes is used */
+static file_size_class_t file_size_classes[FILE_MAX_SIZE_CLASSES];
+static unsigned int      file_nsize_classes;
+static file_class_stats_t *file_class_stats;
+static file_class_stats_t file_class_interm[FILE_MAX_SIZE_CLASSES];
+static file_class_stats_t file_class_cumul[FILE_MAX_SIZE_CLASSES];
+static sb_histogram_t    file_class_histograms[FILE_MAX_SIZE_CLASSES];
+static bool              file_class_latency;
+/* Block device statistics with --file-diskstats */
+static bool              file_diskstats;
+static char              file_disk_name[128];
+static char              file_disk_path[128];
+static file_diskstats_t  file_disk_interm;
+static file_diskstats_t  file_disk_cumul;
+/* Dirty page writeback monitoring with --file-writeback */
+static bool              file_writeback;
 static file_io_mode_t    file_io_mode;
+/* Per-thread queue depth of the current --file-qd-sweep run, 0 if none */
+static unsigned int      file_sweep_depth;
 #ifdef HAVE_LIBAIO
 static unsigned int      file_async_backlog;
 #endif
+#ifdef HAVE_LIBURING
+static unsigned int      file_uring_depth;
+static unsigned int      file_uring_batch;
+static int               file_uring_fixed_bufs;
+static int               file_uring_fixed_files;
+static int               file_uring_sqpoll;
+#endif
+
+/* How worker threads share test files, see --file-thread-affinity */
+typedef enum
+{
+  FILE_AFFINITY_SHARED,
+  FILE_AFFINITY_OWNED,
+  FILE_AFFINITY_SHARDED
+} file_affinity_t;
+
+static const char *file_affinity_names[] =
+{
+  "shared", "owned", "sharded", NULL
+};
+
+/* How discard requests are done, see --file-discard-mode */
+typedef enum
+{
+  FILE_DISCARD_PUNCH,
+  FILE_DISCARD_ZERO,
+  FILE_DISCARD_BLKDISCARD
+} file_discard_mode_t;
+
+static const char *file_discard_mode_names[] =
+{
+  "punch", "zero", "discard", NULL
+};
+
+static double              file_discard_ratio; /* % of random requests */
+static file_discard_mode_t file_discard_mode;
+static uint64_t            file_discard_cumul[2]; /* discards, bytes */
+
+/* Maximum number of jobs in --file-jobs */
+#define FILE_MAX_JOBS 16
+
+/* A job from --file-jobs */
+typedef struct
+{
+  char              name[32];      /* as specified, for reports */
+  file_test_mode_t  mode;
+  unsigned int      nthreads;
+  long long         rate;          /* bytes per second, 0 - unlimited */
+  int               fsync_freq;
+} file_job_t;
+
+static file_job_t   file_jobs[FILE_MAX_JOBS];
+static unsigned int file_njobs;
+
+/*
+  A sequential stream of a file group, see --file-seq-streams. Offsets are in
+  bytes from the start of the first file of the group.
+*/
+typedef struct
+{
+  long long         start;         /* range of the stream */
+  long long         end;
+  long long         offset;        /* next request */
+  sb_file_request_t prev_req;      /* previous request for validation */
+} file_stream_t;
+
+/*
+  A range of files used by a group of threads. With --file-jobs each job is a
+  group covering all files and using consecutive threads. Otherwise thread t
+  belongs to group t % file_ngroups, and with shared affinity there is a
+  single group covering all files.
+*/
+typedef struct
+{
+  file_test_mode_t  mode;
+  int               fsync_freq;
+  const file_job_t  *job;          /* NULL without --file-jobs */
+  uint64_t          next_ns;       /* next free slot of the job rate limit */
+  sb_histogram_t    *hist;         /* per-operation latency of a job */
+
+  unsigned int      first_file;
+  unsigned int      nfiles;
+  long long         size;          /* total size of files in the group */
+  long long         nblocks;       /* blocks of --file-block-size */
+  long long         hot_size;      /* primed into page cache, from offset 0 */
+  long long         hot_blocks;
+
+  /* Request generator state */
+  file_stream_t     *streams;      /* file_seq_streams sequential streams */
+  unsigned int      fsynced_file;  /* file number to be fsynced (periodic) */
+  int               is_dirty;      /* any writes after last fsync series ? */
+  unsigned int      req_performed; /* number of requests done */
+} file_group_t;
+
+/* I/O counters of a file group, summed over its threads */
+typedef struct
+{
+  uint64_t          reads;
+  uint64_t          writes;
+  uint64_t          fsyncs;
+  uint64_t          bytes_read;
+  uint64_t          bytes_written;
+} file_group_stats_t;
+
+/* Page cache control, see --file-cache-resident */
+#define FILE_CACHE_SAMPLE 8      /* sample every N-th read per thread */
+
+static unsigned int      file_cache_resident; /* % of each file group */
+static unsigned int      file_cache_hit_ratio; /* 0 - uniform requests */
+static bool              file_cache_stats;
+#ifdef SB_FILE_CACHE
+static void              **file_cache_maps;   /* for mincore() */
+#endif
+static uint64_t          file_cache_cumul[2]; /* reads, hits */
+
+/* Raw block device, see --file-device */
+static const char        *file_device;        /* NULL - use test files */
+static long long         file_device_offset;
+static bool              file_device_destroy;
 
-/* statistical and other "local" variables */
-static long long       position;      /* current position in file */
-static unsigned int    current_file;  /* current file */
-static unsigned int    fsynced_file;  /* file number to be fsynced (periodic) */
+/* Device offset of a test file, 0 for regular files */
+static inline long long file_base(unsigned int file_id)
+{
+  return file_device != NULL ?
+    file_device_offset + (long long) file_id * file_size : 0;
+}
+
+static file_affinity_t    file_affinity;
+static file_group_t       *file_groups;
+static unsigned int       file_ngroups;
+static unsigned int       *file_thread_groups; /* group of each thread */
+static file_group_stats_t *file_group_cumul;
+
+/* Sequential streams per file group, see --file-seq-streams */
+static unsigned int       file_seq_streams;
+static unsigned int       *file_thread_streams; /* stream of each thread */
+static uint64_t           *file_stream_cumul;   /* bytes read and written */
 
-static int is_dirty;               /* any writes after last fsync series ? */
-static unsigned int req_performed; /* number of requests done */
+/* Total I/O rate limit, see --file-rate */
+static long long          file_rate;
+static uint64_t           file_rate_next_ns CK_CC_CACHELINE;
 
 static const double mebibyte = 1024 * 1024;
 static const double megabyte = 1000 * 1000;
@@ -157,6 +475,17 @@ static const double megabyte = 1000 * 1000;
 /* Array of file mappings */
 static void          **mmaps;
 static unsigned long file_page_mask;
+
+/* madvise() advice for --file-mmap-advice */
+static const char *file_mmap_advice_names[] =
+{
+  "normal", "random", "sequential", "willneed", "hugepage", NULL
+};
+
+static int           file_mmap_advice;   /* -1 for no madvise() call */
+static int           file_mmap_populate;
+static int           file_mmap_msync_writes;
+static long long     file_mmap_window;   /* 0 - map whole files */
 #endif
 
 /* Array of file descriptors */
@@ -165,22 +494,92 @@ static FILE_DESCRIPTOR *files;
 /* test mode type */
 static file_test_mode_t test_mode;
 
-/* Previous request needed for validation */
-static sb_file_request_t prev_req;
+/* --validate state */
+static uint32_t          (*file_crc32c)(uint32_t, const void *, size_t);
+/* Generations of blocks written by this run, 0 if not written yet */
+static uint64_t          *file_block_gens;
+static long long         file_blocks_per_file;
+static uint64_t          file_write_gen;
+
+/* Size of writes used to fill test files in the 'write' prepare mode */
+#define FILE_PREPARE_BUFFER_SIZE (1024 * 1024)
+
+/* State of parallel 'prepare' */
+static int               prepare_flags;      /* open() flags for test files */
+static unsigned int      prepare_next_file;  /* next file to create */
+static uint64_t          prepare_written;    /* bytes written so far */
+static int               prepare_failed;
+
+/* State of preconditioning before 'run' */
+static unsigned int      file_precondition;  /* passes of each kind */
+static uint64_t          precond_next;       /* next unit of work */
+static uint64_t          precond_written;    /* bytes written so far */
+static int               precond_failed;
 
 static sb_arg_t fileio_args[] = {
   SB_OPT("file-num", "number of files to create", "128", INT),
   SB_OPT("file-block-size", "block size to use in all IO operations", "16384",
          INT),
+  SB_OPT("file-block-sizes", "list of SIZE:WEIGHT pairs to pick the size of "
+         "each request from, e.g. 4K:60,16K:30,1M:10. Requests are aligned to "
+         "their size. Overrides --file-block-size", "", LIST),
   SB_OPT("file-total-size", "total size of files to create", "2G", SIZE),
+  SB_OPT("file-jobs", "list of jobs to run concurrently instead of "
+         "--file-test-mode, each as MODE:THREADS[:rate=SIZE][:fsync=N], e.g. "
+         "rndrd:8,seqrewr:2:rate=200M,seqrewr:1:fsync=1. A job uses MODE on "
+         "all files with THREADS threads, rate= limits it to SIZE bytes per "
+         "second, fsync= overrides --file-fsync-freq. The number of threads "
+         "of all jobs must be equal to --threads", "", LIST),
   SB_OPT("file-test-mode",
          "test mode {seqwr, seqrewr, seqrd, rndrd, rndwr, rndrw}", NULL,
          STRING),
-  SB_OPT("file-io-mode", "file operations mode {sync,async,mmap}", "sync",
-         STRING),
+  SB_OPT("file-io-mode", "file operations mode {sync,async,mmap,uring}",
+         "sync", STRING),
 #ifdef HAVE_LIBAIO
   SB_OPT("file-async-backlog",
          "number of asynchronous operatons to queue per thread", "128", INT),
+#endif
+#ifdef HAVE_LIBURING
+  SB_OPT("file-uring-depth",
+         "number of io_uring operations in flight per thread", "128", INT),
+  SB_OPT("file-uring-batch",
+         "number of io_uring operations to prepare before submitting them "
+         "with a single system call", "1", INT),
+  SB_OPT("file-uring-fixed-bufs", "register I/O buffers with io_uring",
+         "off", BOOL),
+  SB_OPT("file-uring-fixed-files", "register test files with io_uring",
+         "off", BOOL),
+  SB_OPT("file-uring-sqpoll",
+         "use a kernel thread to poll the io_uring submission queue", "off",
+         BOOL),
+#endif
+#ifdef SB_FILE_ASYNC
+  SB_OPT("file-async-reaper", "reap async and io_uring completions in a "
+         "dedicated thread for every N worker threads, so workers only submit "
+         "requests (0 - workers reap their own completions)", "0", INT),
+  SB_OPT("file-async-poll", "busy-poll for async and io_uring completions "
+         "instead of sleeping until they are signalled. io_uring rings are "
+         "created with IORING_SETUP_IOPOLL, which requires "
+         "--file-extra-flags=direct and a device with poll queues", "off",
+         BOOL),
+#endif
+  SB_OPT("file-qd-sweep", "list of effective queue depths to run the test "
+         "at in turn over the same prepared files, e.g. 1,4,16,64, and report "
+         "the knee where latency starts growing faster than throughput. The "
+         "queue depth is the number of threads in sync and mmap modes, and "
+         "threads multiplied by --file-async-backlog or --file-uring-depth "
+         "in async and uring modes", "", LIST),
+#ifdef HAVE_MMAP
+  SB_OPT("file-mmap-advice", "madvise() advice for file mappings in mmap mode "
+         "{normal, random, sequential, willneed, hugepage}", "normal",
+         STRING),
+  SB_OPT("file-mmap-populate", "pre-fault file mappings with MAP_POPULATE",
+         "off", BOOL),
+  SB_OPT("file-mmap-msync-writes", "msync() the dirtied range after each "
+         "write in mmap mode", "off", BOOL),
+  SB_OPT("file-mmap-window", "map this much of a file at a time per thread "
+         "in mmap mode, remapping when a request falls outside of the window "
+         "(0 - map whole files)", "0", SIZE),
 #endif
   SB_OPT("file-extra-flags",
          "list of additional flags to use to open files {sync,dsync,direct}",
@@ -196,6 +595,79 @@ static sb_arg_t fileio_args[] = {
   SB_OPT("file-merged-requests", "merge at most this number of IO requests "
          "if possible (0 - don't merge)", "0", INT),
   SB_OPT("file-rw-ratio", "reads/writes ratio for combined test", "1.5", DOUBLE),
+  SB_OPT("file-rand-type", "random numbers distribution for block selection "
+         "in random I/O tests {uniform, gaussian, special, pareto, zipfian}, "
+         "see --rand-type for distribution parameters", "uniform", STRING),
+  SB_OPT("file-hotspot-move", "percentage of the file set the hot spot of a "
+         "skewed --file-rand-type moves by per second (0 - fixed hot spot)",
+         "0", DOUBLE),
+  SB_OPT("file-prepare-mode", "how 'prepare' allocates test files "
+         "{write, fallocate, sparse}. With fallocate or sparse no data is "
+         "written, so reads of unwritten blocks may not reach the storage",
+         "write", STRING),
+  SB_OPT("file-buffer-pages", "pages for per-thread I/O buffers "
+         "{default,thp,2m,1g}, see --memory-pages", "default", STRING),
+  SB_OPT("file-buffer-populate", "pre-fault I/O buffers when allocating them",
+         "off", BOOL),
+  SB_OPT("file-precondition", "before 'run', write the whole file set this "
+         "many times sequentially, then this many times with random writes "
+         "of --file-block-size, to bring SSDs out of their fresh-out-of-box "
+         "state (0 - don't precondition)", "0", INT),
+  SB_OPT("file-diskstats", "report utilization, queue size, merges and "
+         "latency of the block device holding test files, as sampled from "
+         "/sys/dev/block (Linux only)", "off", BOOL),
+  SB_OPT("file-writeback", "report dirty and writeback memory from "
+         "/proc/meminfo, I/O stall time from /proc/pressure/io and writes "
+         "stalled for at least 1ms by dirty page throttling with each report, "
+         "and fsync latency by the amount of data written to the file since "
+         "its previous fsync (Linux only)", "off", BOOL),
+  SB_OPT("file-thread-affinity", "how worker threads share test files "
+         "{shared, owned, sharded}. With 'owned' each thread works on its own "
+         "subset of files, with 'sharded' threads are split into "
+         "--file-shards groups, each working on its own subset of files",
+         "shared", STRING),
+  SB_OPT("file-shards", "number of thread and file groups with "
+         "--file-thread-affinity=sharded", "2", INT),
+  SB_OPT("file-seq-streams", "number of independent sequential streams in "
+         "each file group in sequential tests. The files of a group are "
+         "split into this many contiguous ranges, each read or written in "
+         "order by its own threads, and the throughput of each stream is "
+         "reported. 1 is a single stream shared by all threads of a group",
+         "1", INT),
+  SB_OPT("file-rate", "limit the total I/O rate of all threads to SIZE "
+         "bytes per second, e.g. to run the test as background load at a "
+         "fixed budget. Applies on top of job rate= limits. 0 is unlimited",
+         "0", SIZE),
+  SB_OPT("file-device", "test a raw block device instead of files. The "
+         "--file-total-size bytes at --file-device-offset are split into "
+         "--file-num regions used as test files. The device is opened with "
+         "O_DIRECT and must not be mounted or used by other devices (Linux "
+         "only)", NULL, STRING),
+  SB_OPT("file-device-offset", "offset of the tested region of --file-device",
+         "0", SIZE),
+  SB_OPT("file-device-destroy", "confirm that data in the tested region of "
+         "--file-device can be overwritten. Required by 'prepare', write "
+         "tests and --file-precondition", "off", BOOL),
+  SB_OPT("file-cache-resident", "percentage of each file group to keep in "
+         "page cache. Before the run the first part of the files is read into "
+         "page cache and the rest is evicted. 0 disables page cache control",
+         "0", INT),
+  SB_OPT("file-cache-hit-ratio", "percentage of random requests to the "
+         "resident part of files with --file-cache-resident, the rest going "
+         "to the cold part which is evicted again after each read in sync "
+         "mode. 0 spreads requests uniformly over all files", "0", INT),
+  SB_OPT("file-cache-stats", "report the page cache hit ratio of reads as "
+         "sampled with mincore(). Implied by --file-cache-resident", "off",
+         BOOL),
+  SB_OPT("file-discard-ratio", "percentage of random write test requests "
+         "(rndwr, rndrw) to replace with discards of the selected block, "
+         "done synchronously in all I/O modes. Discarded blocks read back "
+         "as zeroes (0 - no discards)", "0", DOUBLE),
+  SB_OPT("file-discard-mode", "how blocks are discarded with "
+         "--file-discard-ratio {punch, zero, discard}. 'punch' deallocates "
+         "them with fallocate(FALLOC_FL_PUNCH_HOLE), 'zero' uses "
+         "fallocate(FALLOC_FL_ZERO_RANGE), 'discard' issues BLKDISCARD to "
+         "--file-device", "punch", STRING),
 
   SB_OPT_END
 };
@@ -210,8 +682,10 @@ static void file_print_mode(void);
 static int file_prepare(void);
 static sb_event_t file_next_event(int thread_id);
 static int file_execute_event(sb_event_t *, int);
+static int file_thread_init(int);
 static int file_thread_done(int);
 static int file_done(void);
+static int file_sweep(unsigned int, unsigned int *, unsigned int *);
 static void file_report_intermediate(sb_stat_t *);
 static void file_report_cumulative(sb_stat_t *);
 
@@ -227,43 +701,96 @@ static sb_test_t fileio_test =
     .execute_event = file_execute_event,
     .report_intermediate = file_report_intermediate,
     .report_cumulative = file_report_cumulative,
+    .thread_init = file_thread_init,
     .thread_done = file_thread_done,
-    .done = file_done
+    .done = file_done,
+    .sweep = file_sweep
   },
   .builtin_cmds = {
    .prepare = file_cmd_prepare,
    .cleanup = file_cmd_cleanup
   },
-  .args = fileio_args
+  .args = fileio_args,
+  .sweep_name = "queue depth"
 };
 
 
 static int create_files(void);
+static void *prepare_worker(void *);
 static int remove_files(void);
+static int precondition_files(void);
 static int parse_arguments(void);
+#ifdef HAVE_MMAP
+static int parse_mmap_arguments(void);
+#endif
 static void init_vars(void);
-static sb_event_t file_get_seq_request(void);
+static sb_event_t file_get_seq_request(int thread_id);
 static sb_event_t file_get_rnd_request(int thread_id);
-static void check_seq_req(sb_file_request_t *, sb_file_request_t *);
+static void check_seq_req(const file_group_t *, file_stream_t *,
+                          sb_file_request_t *);
+static int file_groups_init(void);
+static void file_groups_done(void);
 static const char *get_io_mode_str(file_io_mode_t mode);
 static const char *get_test_mode_str(file_test_mode_t mode);
-static void file_fill_buffer(unsigned char *, unsigned int, size_t);
-static int file_validate_buffer(unsigned char  *, unsigned int, size_t);
+static void file_fill_buffer(unsigned char *, unsigned int, unsigned int,
+                             size_t);
+static int file_validate_buffer(unsigned char  *, unsigned int, unsigned int,
+                                size_t);
 
 /* File operation wrappers */
 static int file_do_fsync(unsigned int, int);
 static int file_fsync(unsigned int, int);
+static int file_discard(sb_file_request_t *, int);
 static ssize_t file_pread(unsigned int, void *, ssize_t, long long, int);
 static ssize_t file_pwrite(unsigned int, void *, ssize_t, long long, int);
+static int file_op_histograms_init(void);
+static void file_op_histograms_done(void);
+static int parse_block_sizes(void);
+static int parse_jobs(void);
+static int file_diskstats_init(void);
+static void file_diskstats_report(file_diskstats_t *, sb_stat_t *, bool);
+static int file_writeback_init(void);
+static void file_writeback_write(unsigned int, uint64_t, uint64_t);
+static uint64_t file_writeback_fsync_start(unsigned int);
+static void file_writeback_fsync(uint64_t, uint64_t);
+static void file_writeback_report(sb_stat_t *, bool);
+static void file_writeback_done(void);
+static int file_size_classes_init(void);
+static void file_size_classes_done(void);
+static int file_device_check(bool);
+static int file_cache_prepare(void);
+static void file_cache_done(void);
+static void file_cache_sample(int, sb_file_request_t *);
+static const char *get_op_latency_str(sb_file_op_t op);
+#ifdef SB_FILE_ASYNC
+static int file_reaper_init(void);
+static int file_reaper_start(void);
+static void file_reaper_stop(void);
+static int file_reaper_wait(unsigned int *, unsigned int);
+#endif
 #ifdef HAVE_LIBAIO
 static int file_async_init(void);
 static int file_async_done(void);
 static int file_submit_or_wait(struct iocb *, sb_file_op_t, ssize_t, int);
 static int file_wait(int, long);
+static long file_async_reap(int, long, struct timespec *);
+static int file_async_drain(int);
+#endif
+#ifdef HAVE_LIBURING
+static int file_uring_init(void);
+static int file_uring_prepare(void);
+static int file_uring_done(void);
+static int file_uring_submit_or_wait(sb_file_op_t, unsigned int, void *,
+                                     ssize_t, long long, int);
+static int file_uring_wait(int, unsigned int);
+static long file_uring_reap(int);
+static int file_uring_drain(int);
 #endif
 #ifdef HAVE_MMAP
 static int file_mmap_prepare(void);
 static int file_mmap_done(void);
+static void *file_mmap(FILE_DESCRIPTOR, size_t, long long, int);
+static void file_mmap_window_unmap(int);
 #endif
 
 /* Portability wrappers */
@@ -292,11 +819,38 @@ int file_init(void)
     return 1;
   }
 
+  if (sb_globals.validate)
+  {
+    file_blocks_per_file = (file_size + file_block_size - 1) / file_block_size;
+    file_block_gens = calloc(num_files * file_blocks_per_file,
+                             sizeof(uint64_t));
+    if (file_block_gens == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure.");
+      return 1;
+    }
+    file_write_gen = 0;
+  }
+
+#ifdef SB_FILE_ASYNC
+  if (file_reaper_init())
+    return 1;
+#endif
+
 #ifdef HAVE_LIBAIO
   if (file_async_init())
     return 1;
 #endif
 
+#ifdef HAVE_LIBURING
+  if (file_uring_init())
+    return 1;
+#endif
+
+  if (file_op_histograms_init() || file_size_classes_init() ||
+      file_groups_init())
+    return 1;
+
   init_vars();
 
   return 0;
@@ -310,6 +864,18 @@ int file_prepare(void)
 
   for (i=0; i < num_files; i++)
   {
+    /* Regions of a block device are checked by parse_arguments() */
+    if (file_device != NULL)
+    {
+      files[i] = sb_open(file_device);
+      if (!VALID_FILE(files[i]))
+      {
+        log_errno(LOG_FATAL, "Cannot open device '%s'", file_device);
+        return 1;
+      }
+      continue;
+    }
+
     snprintf(file_name, sizeof(file_name), "test_file.%d",i);
     /* remove test files for creation test if they exist */
     if (test_mode == MODE_WRITE)
@@ -361,6 +927,28 @@ int file_prepare(void)
     return 1;
 #endif
 
+#ifdef HAVE_LIBURING
+  if (file_uring_prepare())
+    return 1;
+#endif
+
+  if (file_precondition > 0 && precondition_files())
+    return 1;
+
+  if (file_diskstats && file_diskstats_init())
+    return 1;
+
+  if (file_writeback && file_writeback_init())
+    return 1;
+
+  if (file_cache_stats && file_cache_prepare())
+    return 1;
+
+#ifdef SB_FILE_ASYNC
+  if (file_reaper_start())
+    return 1;
+#endif
+
   return 0; 
 }
 
@@ -369,6 +957,13 @@ int file_done(void)
 {
   unsigned int  i;
   
+#ifdef SB_FILE_ASYNC
+  /* Reapers may still be polling rings of workers */
+  file_reaper_stop();
+#endif
+
+  file_cache_done();
+
   for (i = 0; i < num_files; i++)
     close(files[i]);
 
@@ -377,6 +972,11 @@ int file_done(void)
     return 1;
 #endif
 
+#ifdef HAVE_LIBURING
+  if (file_uring_done())
+    return 1;
+#endif
+
 #ifdef HAVE_MMAP
   if (file_mmap_done())
     return 1;
@@ -390,358 +990,2000 @@ int file_done(void)
 
   free(per_thread);
 
+  file_op_histograms_done();
+  file_size_classes_done();
+  file_groups_done();
+  file_writeback_done();
+
+  free(file_block_gens);
+  file_block_gens = NULL;
+
   return 0;
 }
 
-sb_event_t file_next_event(int thread_id)
+
+/*
+  Configure run N of --file-qd-sweep. In sync and mmap modes each thread has a
+  single request in flight, so the queue depth is the number of threads. In
+  async and uring modes the depth is split evenly between --threads threads,
+  or as many threads as the depth if it is lower.
+*/
+
+static int file_sweep(unsigned int n, unsigned int *threads,
+                      unsigned int *depth)
 {
-  if (test_mode == MODE_WRITE || test_mode == MODE_REWRITE ||
-      test_mode == MODE_READ)
-    return file_get_seq_request();
-  
-  
-  return file_get_rnd_request(thread_id);
-}
+  const char     *mode = sb_get_value_string("file-io-mode");
+  const bool     queued = mode != NULL &&
+    (!strcmp(mode, "async") || !strcmp(mode, "uring"));
+  sb_list_item_t *pos;
+  unsigned int   i = 0;
 
+  file_sweep_depth = 0;
 
-/* Get sequential read or write request */
+  SB_LIST_FOR_EACH(pos, sb_get_value_list("file-qd-sweep"))
+  {
+    if (i++ < n)
+      continue;
 
+    const char *val = SB_LIST_ENTRY(pos, value_t, listitem)->data;
+    char       *end;
+    const long d = strtol(val, &end, 10);
 
-sb_event_t file_get_seq_request(void)
-{
-  sb_event_t           sb_req;
-  sb_file_request_t    *file_req = &sb_req.u.file_request;
+    if (end == val || *end != '\0' || d < 1 || d > INT_MAX)
+    {
+      log_text(LOG_FATAL, "Invalid value in --file-qd-sweep: '%s'", val);
+      return -1;
+    }
 
-  sb_req.type = SB_REQ_TYPE_FILE;
-  SB_THREAD_MUTEX_LOCK();
-  
-  /* assume function is called with correct mode always */
-  if (test_mode == MODE_WRITE || test_mode == MODE_REWRITE)
-    file_req->operation = FILE_OP_TYPE_WRITE;
-  else     
-    file_req->operation = FILE_OP_TYPE_READ;
+    *depth = d;
 
-  /* See whether it's time to fsync file(s) */
-  if (file_fsync_freq != 0 && file_req->operation == FILE_OP_TYPE_WRITE &&
-      is_dirty && req_performed % file_fsync_freq == 0)
-  {
-    file_req->operation = FILE_OP_TYPE_FSYNC;
-    file_req->file_id = fsynced_file;
-    file_req->pos = 0;
-    file_req->size = 0;
-    fsynced_file++;
-    if (fsynced_file == num_files)
+    if (!queued)
     {
-      fsynced_file = 0;
-      is_dirty = 0;
+      *threads = d;
+      return 1;
     }
 
-    SB_THREAD_MUTEX_UNLOCK();
-    return sb_req;
-  }
+    *threads = SB_MIN(*threads, *depth);
 
-  req_performed++;
+    if (*depth % *threads)
+    {
+      log_text(LOG_FATAL, "Queue depth %u in --file-qd-sweep is not a "
+               "multiple of the number of threads (%u)", *depth, *threads);
+      return -1;
+    }
 
-  if (file_req->operation == FILE_OP_TYPE_WRITE)
-    is_dirty = 1;
+    file_sweep_depth = *depth / *threads;
 
-  /* Rewind to the first file if all files are processed */
-  if (current_file == num_files)
-  {
-    position= 0;
-    current_file= 0;
+    return 1;
   }
 
-  file_req->file_id = current_file;
-  file_req->pos = position;
-  file_req->size = SB_MIN(file_request_size, file_size - position);
+  return 0;
+}
 
-  position += file_req->size;
 
-  /* scroll to the next file if not already out of bound */
-  if (position == file_size)
-  {
-    current_file++;
-    position=0;
-  }      
-  
-  if (sb_globals.validate)
-  {
-    check_seq_req(&prev_req, file_req);
-    prev_req = *file_req;
-  }
-  
-  SB_THREAD_MUTEX_UNLOCK(); 
+/*
+  Initialize latency histograms for the operation types the current test mode
+  can issue, unless percentile stats are disabled.
+*/
 
-  return sb_req;    
+static bool file_mode_reads(file_test_mode_t mode)
+{
+  return mode == MODE_READ || mode == MODE_RND_READ || mode == MODE_RND_RW ||
+    mode == MODE_MIXED;
 }
 
 
-/* Request generatior for random tests */
+static bool file_mode_seq(file_test_mode_t mode)
+{
+  return mode == MODE_WRITE || mode == MODE_REWRITE || mode == MODE_READ;
+}
 
 
-sb_event_t file_get_rnd_request(int thread_id)
+static bool file_mode_writes(file_test_mode_t mode)
 {
-  sb_event_t           sb_req;
-  sb_file_request_t    *file_req = &sb_req.u.file_request;
-  unsigned long long   tmppos;
-  int                  mode = test_mode;
-  unsigned int         i;
+  return mode != MODE_READ && mode != MODE_RND_READ;
+}
 
-  sb_req.type = SB_REQ_TYPE_FILE;
 
-  if (test_mode == MODE_RND_RW)
-  {
-    mode = (sb_counter_val(thread_id, SB_CNT_READ) + 1.0) /
-        (sb_counter_val(thread_id, SB_CNT_WRITE) + 1.0) < file_rw_ratio ?
-      MODE_RND_READ : MODE_RND_WRITE;
-  }
+static bool file_mode_discards(file_test_mode_t mode)
+{
+  return file_discard_ratio > 0 &&
+    (mode == MODE_RND_WRITE || mode == MODE_RND_RW);
+}
 
-  /*
-    is_dirty is only set if writes are done and cleared after all files
-    are synced
-  */
-  if (file_fsync_freq != 0 && is_dirty)
+
+int file_op_histograms_init(void)
+{
+  bool reads = file_mode_reads(test_mode);
+  bool writes = file_mode_writes(test_mode);
+  bool discards = file_mode_discards(test_mode);
+  bool fsyncs = file_fsync_freq > 0 || file_fsync_all || file_fsync_end;
+
+  if (file_njobs > 0)
   {
-    if (req_performed % file_fsync_freq == 0)
+    reads = writes = discards = false;
+    for (unsigned int i = 0; i < file_njobs; i++)
     {
-      file_req->operation = FILE_OP_TYPE_FSYNC;  
-      file_req->file_id = fsynced_file;
-      file_req->pos = 0;
-      file_req->size = 0;
-      fsynced_file++;
-      if (fsynced_file == num_files)
-      {
-        fsynced_file = 0;
-        is_dirty = 0;
-      }
-
-      SB_THREAD_MUTEX_UNLOCK();
-      return sb_req;
+      reads |= file_mode_reads(file_jobs[i].mode);
+      writes |= file_mode_writes(file_jobs[i].mode);
+      discards |= file_mode_discards(file_jobs[i].mode);
+      /* Jobs can override --file-fsync-freq */
+      fsyncs |= file_mode_writes(file_jobs[i].mode) &&
+        file_jobs[i].fsync_freq > 0;
     }
   }
 
-  if (mode==MODE_RND_WRITE) /* mode shall be WRITE or RND_WRITE only */
-    file_req->operation = FILE_OP_TYPE_WRITE;
-  else
-    file_req->operation = FILE_OP_TYPE_READ;
+  /* Writeback monitoring needs write and fsync latencies */
+  if (sb_globals.npercentiles == 0 && !file_writeback)
+    return 0;
 
-retry:
-  tmppos = (long long) (sb_rand_uniform_double() * total_size);
-  tmppos = tmppos - (tmppos % (long long) file_block_size);
-  file_req->file_id = (int) (tmppos / (long long) file_size);
-  file_req->pos = (long long) (tmppos % (long long) file_size);
-  file_req->size = SB_MIN(file_block_size, file_size - file_req->pos);
+  file_op_latency[FILE_OP_TYPE_READ] = reads;
+  file_op_latency[FILE_OP_TYPE_WRITE] = writes;
+  file_op_latency[FILE_OP_TYPE_FSYNC] = writes && fsyncs;
+  file_op_latency[FILE_OP_TYPE_DISCARD] = discards;
 
-  if (sb_globals.validate)
+  for (int op = FILE_OP_TYPE_READ; op <= FILE_OP_TYPE_DISCARD; op++)
   {
-    /*
-       For the multi-threaded validation test we have to make sure the block is
-       not being used by another thread
-    */
-    for (i = 0; i < sb_globals.threads; i++)
-    {
-      if (i != (unsigned) thread_id && per_thread[i].buffer_file_id == file_req->file_id &&
-          per_thread[i].buffer_pos == file_req->pos)
-        goto retry;
-    }
+    if (file_op_latency[op] && oper_histogram_init(&file_op_histograms[op]))
+      return 1;
   }
 
-  per_thread[thread_id].buffer_file_id = file_req->file_id;
-  per_thread[thread_id].buffer_pos = file_req->pos;
+  return 0;
+}
 
-  req_performed++;
-  if (file_req->operation == FILE_OP_TYPE_WRITE) 
-    is_dirty = 1;
 
-  SB_THREAD_MUTEX_UNLOCK();        
-  return sb_req;
+void file_op_histograms_done(void)
+{
+  for (int op = FILE_OP_TYPE_READ; op <= FILE_OP_TYPE_DISCARD; op++)
+  {
+    if (file_op_latency[op])
+      sb_histogram_done(&file_op_histograms[op]);
+    file_op_latency[op] = false;
+  }
 }
 
 
-int file_execute_event(sb_event_t *sb_req, int thread_id)
+/*
+  Allocate per-class counters and latency histograms when --file-block-sizes
+  is used.
+*/
+
+int file_size_classes_init(void)
 {
-  FILE_DESCRIPTOR    fd;
-  sb_file_request_t *file_req = &sb_req->u.file_request;
+  if (file_nsize_classes == 0)
+    return 0;
 
-  if (sb_globals.debug)
+  file_class_stats = sb_alloc_per_thread_array(sizeof(file_class_stats_t) *
+                                               FILE_MAX_SIZE_CLASSES);
+  if (file_class_stats == NULL)
   {
-    log_text(LOG_DEBUG,
-             "Executing request, operation: %d, file_id: %d, pos: %d, "
-             "size: %d",
-             file_req->operation,
-             file_req->file_id,
-             (int)file_req->pos,
-             (int)file_req->size);
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
   }
-  
-  /* Check request parameters */
-  if (file_req->file_id > num_files)
+
+  memset(file_class_interm, 0, sizeof(file_class_interm));
+  memset(file_class_cumul, 0, sizeof(file_class_cumul));
+
+  if (sb_globals.npercentiles == 0)
+    return 0;
+
+  for (unsigned int i = 0; i < file_nsize_classes; i++)
   {
-    log_text(LOG_FATAL, "Incorrect file id in request: %u", file_req->file_id);
-    return 1;
+    if (oper_histogram_init(&file_class_histograms[i]))
+      return 1;
   }
-  if (file_req->pos + file_req->size > file_size)
+
+  file_class_latency = true;
+
+  return 0;
+}
+
+
+void file_size_classes_done(void)
+{
+  if (file_class_latency)
   {
-    log_text(LOG_FATAL, "I/O request exceeds file size. "
-             "file id: %d file size: %lld req offset: %lld req size: %lld",
-             file_req->file_id, (long long) file_size,
-             (long long) file_req->pos, (long long) file_req->size);
-    return 1;
+    for (unsigned int i = 0; i < file_nsize_classes; i++)
+      sb_histogram_done(&file_class_histograms[i]);
   }
-  fd = files[file_req->file_id];
+  file_class_latency = false;
 
-  switch (file_req->operation) {
-    case FILE_OP_TYPE_NULL:
-      log_text(LOG_FATAL, "Execute of NULL request called !, aborting");
-      return 1;
-    case FILE_OP_TYPE_WRITE:
+  free(file_class_stats);
+  file_class_stats = NULL;
+}
 
-      /* Store checksum and offset in a buffer when in validation mode */
-      if (sb_globals.validate)
-        file_fill_buffer(per_thread[thread_id].buffer, file_req->size, file_req->pos);
-                         
-      if(file_pwrite(file_req->file_id, per_thread[thread_id].buffer,
-                     file_req->size, file_req->pos, thread_id)
-         != (ssize_t)file_req->size)
-      {
-        log_errno(LOG_FATAL, "Failed to write file! file: " FD_FMT " pos: %lld", 
-                  fd, (long long)file_req->pos);
-        return 1;
-      }
 
-      /* Check if we have to fsync each write operation */
-      if (file_fsync_all && file_fsync(file_req->file_id, thread_id))
-          return 1;
+/* Sum per-class counters over worker threads */
 
-      /* In async mode stats will me updated on AIO requests completion */
-      if (file_io_mode != FILE_IO_MODE_ASYNC)
-      {
-        sb_counter_inc(thread_id, SB_CNT_WRITE);
-        sb_counter_add(thread_id, SB_CNT_BYTES_WRITTEN, file_req->size);
-      }
+static void file_size_classes_sum(file_class_stats_t *sum)
+{
+  memset(sum, 0, sizeof(file_class_stats_t) * FILE_MAX_SIZE_CLASSES);
 
-      break;
-    case FILE_OP_TYPE_READ:
-      if(file_pread(file_req->file_id, per_thread[thread_id].buffer,
-                    file_req->size, file_req->pos, thread_id)
-         != (ssize_t)file_req->size)
+  for (unsigned int t = 0; t < sb_globals.threads; t++)
+  {
+    const file_class_stats_t *st =
+      &file_class_stats[t * FILE_MAX_SIZE_CLASSES];
+
+    for (unsigned int i = 0; i < file_nsize_classes; i++)
+    {
+      for (int j = 0; j < 2; j++)
       {
-        log_errno(LOG_FATAL, "Failed to read file! file: " FD_FMT " pos: %lld",
-                  fd, (long long)file_req->pos);
-        return 1;
+        sum[i].ops[j] += ck_pr_load_64((uint64_t *) &st[i].ops[j]);
+        sum[i].bytes[j] += ck_pr_load_64((uint64_t *) &st[i].bytes[j]);
       }
+    }
+  }
+}
 
-      /* Validate block if run with validation enabled */
-      if (sb_globals.validate &&
-          file_validate_buffer(per_thread[thread_id].buffer, file_req->size, file_req->pos))
+
+/*
+  Split test files into contiguous ranges, one per file group. With shared
+  affinity the only group covers the whole file set.
+*/
+
+static int file_groups_init(void)
+{
+  unsigned int group_threads[file_ngroups];
+
+  file_groups = calloc(file_ngroups, sizeof(file_group_t));
+  file_group_cumul = calloc(file_ngroups, sizeof(file_group_stats_t));
+  file_thread_groups = calloc(sb_globals.threads, sizeof(unsigned int));
+  file_thread_streams = calloc(sb_globals.threads, sizeof(unsigned int));
+  file_stream_cumul = calloc((size_t) file_ngroups * file_seq_streams * 2,
+                             sizeof(uint64_t));
+  if (file_groups == NULL || file_group_cumul == NULL ||
+      file_thread_groups == NULL || file_thread_streams == NULL ||
+      file_stream_cumul == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  if (file_njobs > 0)
+  {
+    /* Jobs use consecutive threads, their sum is checked to be --threads */
+    for (unsigned int i = 0, t = 0; i < file_njobs; i++)
+      for (unsigned int n = 0; n < file_jobs[i].nthreads; n++)
+        file_thread_groups[t++] = i;
+  }
+  else
+  {
+    for (unsigned int t = 0; t < sb_globals.threads; t++)
+      file_thread_groups[t] = t % file_ngroups;
+  }
+
+  /* Threads of a group take its sequential streams in turn */
+  memset(group_threads, 0, sizeof(group_threads));
+  for (unsigned int t = 0; t < sb_globals.threads; t++)
+    file_thread_streams[t] = group_threads[file_thread_groups[t]]++ %
+      file_seq_streams;
+
+  for (unsigned int i = 0; i < file_ngroups; i++)
+  {
+    file_group_t * const g = &file_groups[i];
+
+    g->mode = test_mode;
+    g->fsync_freq = file_fsync_freq;
+
+    if (file_njobs > 0)
+    {
+      g->job = &file_jobs[i];
+      g->mode = g->job->mode;
+      if (g->job->fsync_freq >= 0)
+        g->fsync_freq = g->job->fsync_freq;
+      g->hist = calloc(FILE_OP_TYPE_DISCARD + 1, sizeof(sb_histogram_t));
+      if (g->hist == NULL)
       {
-        log_text(LOG_FATAL,
-          "Validation failed on file " FD_FMT ", block offset %lld, exiting...",
-                 file_req->file_id, (long long) file_req->pos);
+        log_text(LOG_FATAL, "Memory allocation failure");
         return 1;
       }
-
-      /* In async mode stats will me updated on AIO requests completion */
-      if(file_io_mode != FILE_IO_MODE_ASYNC)
+      for (int op = FILE_OP_TYPE_READ; op <= FILE_OP_TYPE_DISCARD; op++)
       {
-        sb_counter_inc(thread_id, SB_CNT_READ);
-        sb_counter_add(thread_id, SB_CNT_BYTES_READ, file_req->size);
+        if (file_op_latency[op] && oper_histogram_init(&g->hist[op]))
+          return 1;
       }
+    }
 
-      break;
-    case FILE_OP_TYPE_FSYNC:
-      /* Ignore fsync requests if we are already fsync'ing each operation */
-      if (file_fsync_all)
-        break;
-      if(file_fsync(file_req->file_id, thread_id))
-        return 1;
+    g->first_file = (unsigned long long) i * num_files / file_ngroups;
+    g->nfiles = (unsigned long long) (i + 1) * num_files / file_ngroups -
+      g->first_file;
+    if (file_njobs > 0)
+    {
+      /* All jobs use all files */
+      g->first_file = 0;
+      g->nfiles = num_files;
+    }
+    if (file_ngroups == 1 || file_njobs > 0)
+    {
+      g->size = total_size;
+      g->nblocks = file_nblocks;
+    }
+    else
+    {
+      g->size = file_size * g->nfiles;
+      g->nblocks = SB_MAX(g->size / file_block_size, 1);
+    }
 
-      break;
-    default:
-      log_text(LOG_FATAL, "Execute of UNKNOWN file request type called (%d)!, "
-               "aborting", file_req->operation);
+    g->hot_blocks = g->nblocks * file_cache_resident / 100;
+    g->hot_size = g->hot_blocks * file_block_size;
+
+    if (file_seq_streams > 1 && file_mode_seq(g->mode) &&
+        group_threads[i] < file_seq_streams)
+    {
+      log_text(LOG_FATAL, "--file-seq-streams=%u needs at least as many "
+               "threads in each file group, got %u", file_seq_streams,
+               group_threads[i]);
+      return 1;
+    }
+
+    /* Split the files of the group into block-aligned ranges */
+    const long long size = (long long) file_size * g->nfiles;
+    const long long nblocks = size / file_block_size;
+
+    if (file_seq_streams > 1 && nblocks < file_seq_streams)
+    {
+      log_text(LOG_FATAL, "--file-seq-streams=%u exceeds the number of "
+               "blocks in a file group (%lld)", file_seq_streams, nblocks);
       return 1;
+    }
+
+    g->streams = calloc(file_seq_streams, sizeof(file_stream_t));
+    if (g->streams == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+
+    for (unsigned int k = 0; k < file_seq_streams; k++)
+    {
+      g->streams[k].start = nblocks * k / file_seq_streams * file_block_size;
+      g->streams[k].end = (k + 1 < file_seq_streams) ?
+        nblocks * (k + 1) / file_seq_streams * file_block_size : size;
+    }
   }
+
   return 0;
+}
+
+
+static void file_groups_done(void)
+{
+  for (unsigned int i = 0; file_groups != NULL && i < file_ngroups; i++)
+  {
+    free(file_groups[i].streams);
+
+    if (file_groups[i].hist == NULL)
+      continue;
+    for (int op = FILE_OP_TYPE_READ; op <= FILE_OP_TYPE_DISCARD; op++)
+    {
+      if (file_op_latency[op])
+        sb_histogram_done(&file_groups[i].hist[op]);
+    }
+    free(file_groups[i].hist);
+  }
 
+  free(file_thread_groups);
+  file_thread_groups = NULL;
+  free(file_groups);
+  file_groups = NULL;
+  free(file_group_cumul);
+  file_group_cumul = NULL;
+  free(file_thread_streams);
+  file_thread_streams = NULL;
+  free(file_stream_cumul);
+  file_stream_cumul = NULL;
 }
 
-static void print_file_extra_flags(void)
+
+/* Sum I/O counters of threads in each file group */
+
+static void file_groups_sum(file_group_stats_t *sum)
 {
-  log_text(LOG_NOTICE, "Extra file open flags: %s%s%s%s",
-           file_extra_flags == 0 ? "(none)" : "",
-           file_extra_flags & SB_FILE_FLAG_SYNC ? "sync " : "",
-           file_extra_flags & SB_FILE_FLAG_DSYNC ? "dsync ": "",
-           file_extra_flags & SB_FILE_FLAG_DIRECTIO ? "directio" : ""
-           );
+  memset(sum, 0, sizeof(file_group_stats_t) * file_ngroups);
+
+  for (unsigned int t = 0; t < sb_globals.threads; t++)
+  {
+    file_group_stats_t * const g = &sum[file_thread_groups[t]];
+
+    g->reads += sb_counter_val(t, SB_CNT_READ);
+    g->writes += sb_counter_val(t, SB_CNT_WRITE);
+    g->fsyncs += sb_counter_val(t, SB_CNT_OTHER);
+    g->bytes_read += sb_counter_val(t, SB_CNT_BYTES_READ);
+    g->bytes_written += sb_counter_val(t, SB_CNT_BYTES_WRITTEN);
+  }
 }
 
-void file_print_mode(void)
+
+/*
+  Print the throughput of each sequential stream since the previous
+  cumulative report, see --file-seq-streams
+*/
+
+static void file_streams_report(double seconds)
 {
-  char sizestr[16];
+  const unsigned int n = file_ngroups * file_seq_streams;
+  uint64_t           bytes[n * 2];
 
-  print_file_extra_flags();
-  log_text(LOG_NOTICE, "%d files, %sB each", num_files,
-           sb_print_value_size(sizestr, sizeof(sizestr), file_size));
-  log_text(LOG_NOTICE, "%sB total file size",
-           sb_print_value_size(sizestr, sizeof(sizestr),
-                               file_size * num_files));
-  log_text(LOG_NOTICE, "Block size %sB",
-           sb_print_value_size(sizestr, sizeof(sizestr), file_block_size));
-  if (file_merged_requests > 0)
-    log_text(LOG_NOTICE, "Merging requests up to %sB for sequential IO.",
-             sb_print_value_size(sizestr, sizeof(sizestr),
-                                 file_request_size));
+  memset(bytes, 0, sizeof(bytes));
 
-  switch (test_mode)
+  for (unsigned int t = 0; t < sb_globals.threads; t++)
   {
-    case MODE_RND_WRITE:
-    case MODE_RND_READ:
-    case MODE_RND_RW:
-      log_text(LOG_NOTICE, "Number of IO requests: %" PRIu64,
-               sb_globals.max_events);
-      log_text(LOG_NOTICE,
-               "Read/Write ratio for combined random IO test: %2.2f",
-               file_rw_ratio);
-      break;
-    default:
-      break;
+    const unsigned int i = file_thread_groups[t] * file_seq_streams +
+      file_thread_streams[t];
+
+    bytes[i * 2] += sb_counter_val(t, SB_CNT_BYTES_READ);
+    bytes[i * 2 + 1] += sb_counter_val(t, SB_CNT_BYTES_WRITTEN);
   }
 
-  if (file_fsync_freq > 0)
-    log_text(LOG_NOTICE,
-             "Periodic FSYNC enabled, calling fsync() each %d requests.",
-             file_fsync_freq);
+  log_text(LOG_NOTICE, "Throughput by sequential stream:");
 
-  if (file_fsync_end)
-    log_text(LOG_NOTICE, "Calling fsync() at the end of test, Enabled.");
+  for (unsigned int i = 0; i < n; i++)
+  {
+    const file_group_t  * const g = &file_groups[i / file_seq_streams];
+    const file_stream_t * const s = &g->streams[i % file_seq_streams];
+    char                name[64] = "";
 
-  if (file_fsync_all)
-    log_text(LOG_NOTICE, "Calling fsync() after each write operation.");
+    if (!file_mode_seq(g->mode))
+      continue;
 
-  log_text(LOG_NOTICE, "Using %s I/O mode", get_io_mode_str(file_io_mode));
+    if (g->job != NULL)
+      snprintf(name, sizeof(name), "%s ", g->job->name);
 
-  if (sb_globals.validate)
-    log_text(LOG_NOTICE, "Using checksums validation.");
-  
-  log_text(LOG_NOTICE, "Doing %s test", get_test_mode_str(test_mode));
+    log_text(LOG_NOTICE, "    %sstream %u (files %lld-%lld): read: %4.2f "
+             "MiB/s write: %4.2f MiB/s", name, i % file_seq_streams,
+             g->first_file + s->start / file_size,
+             g->first_file + (s->end - 1) / file_size,
+             (bytes[i * 2] - file_stream_cumul[i * 2]) / mebibyte / seconds,
+             (bytes[i * 2 + 1] - file_stream_cumul[i * 2 + 1]) / mebibyte /
+             seconds);
+
+    file_stream_cumul[i * 2] = bytes[i * 2];
+    file_stream_cumul[i * 2 + 1] = bytes[i * 2 + 1];
+  }
+
+  log_text(LOG_NOTICE, "");
 }
 
-/* Print intermediate test statistics. */
 
-void file_report_intermediate(sb_stat_t *stat)
+/* Pick a size class for the next request according to the weights */
+
+static inline unsigned int file_get_size_class(void)
 {
-  const double seconds = stat->time_interval;
+  const uint32_t w =
+    sb_rand_uniform(1, file_size_classes[file_nsize_classes - 1].cum_weight);
+  unsigned int   i;
+
+  for (i = 0; w > file_size_classes[i].cum_weight; i++) ;
+
+  return i;
+}
+
+
+/* Account a completed read or write in its size class */
+
+static inline void file_size_class_add(int thread_id, unsigned int cls,
+                                       sb_file_op_t op, ssize_t len,
+                                       uint64_t lat_ns)
+{
+  file_class_stats_t *st;
+  const int          i = op == FILE_OP_TYPE_WRITE;
+
+  if (file_nsize_classes == 0)
+    return;
+
+  st = &file_class_stats[thread_id * FILE_MAX_SIZE_CLASSES + cls];
+  ck_pr_store_64(&st->ops[i], st->ops[i] + 1);
+  ck_pr_store_64(&st->bytes[i], st->bytes[i] + len);
+
+  if (file_class_latency)
+    sb_histogram_update(&file_class_histograms[cls], NS2MS(lat_ns));
+}
+
+
+/* Return the start time of an operation, if its latency is measured */
+
+static inline uint64_t file_op_start(sb_file_op_t op)
+{
+  struct timespec ts;
+
+  if (!file_op_latency[op])
+    return 0;
+
+  SB_GETTIME(&ts);
+
+  return SEC2NS(ts.tv_sec) + ts.tv_nsec;
+}
+
+
+/*
+  Add the latency of an operation started with file_op_start(). Returns the
+  latency in nanoseconds, or 0 if it is not measured.
+*/
+
+static inline uint64_t file_op_end(sb_file_op_t op, uint64_t start_ns,
+                                   int thread_id)
+{
+  struct timespec ts;
+  uint64_t        lat_ns;
+
+  if (!file_op_latency[op])
+    return 0;
+
+  SB_GETTIME(&ts);
+
+  lat_ns = SEC2NS(ts.tv_sec) + ts.tv_nsec - start_ns;
+  sb_histogram_update(&file_op_histograms[op], NS2MS(lat_ns));
+
+  if (file_njobs > 0)
+    sb_histogram_update(&file_groups[file_thread_groups[thread_id]].hist[op],
+                        NS2MS(lat_ns));
+
+  return lat_ns;
+}
+
+
+/*
+  Wait for the next free slot of a schedule limited to 'rate' bytes per second,
+  i.e. a job limited with rate= or --file-rate, starting from now if the
+  schedule lags behind.
+*/
+
+static void file_pace(uint64_t *next_ns, long long rate, ssize_t size)
+{
+  const uint64_t  cost = (uint64_t) size * NS_PER_SEC / rate;
+  struct timespec ts;
+  uint64_t        next = ck_pr_load_64(next_ns);
+  uint64_t        slot;
+
+  SB_GETTIME(&ts);
+
+  const uint64_t  now = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+
+  do
+  {
+    slot = next > now ? next : now;
+  } while (!ck_pr_cas_64_value(next_ns, next, slot + cost, &next));
+
+  if (slot > now)
+    sb_nanosleep(slot - now);
+}
+
+
+sb_event_t file_next_event(int thread_id)
+{
+  file_group_t * const g = &file_groups[file_thread_groups[thread_id]];
+  sb_event_t           req;
+
+  if (file_mode_seq(g->mode))
+    req = file_get_seq_request(thread_id);
+  else
+    req = file_get_rnd_request(thread_id);
+
+  if (g->job != NULL && g->job->rate > 0 && req.u.file_request.size > 0)
+    file_pace(&g->next_ns, g->job->rate, req.u.file_request.size);
+
+  if (file_rate > 0 && req.u.file_request.size > 0)
+    file_pace(&file_rate_next_ns, file_rate, req.u.file_request.size);
+
+  return req;
+}
+
+
+/* Get sequential read or write request */
+
+
+sb_event_t file_get_seq_request(int thread_id)
+{
+  sb_event_t           sb_req;
+  sb_file_request_t    *file_req = &sb_req.u.file_request;
+  file_group_t         *g = &file_groups[file_thread_groups[thread_id]];
+  file_stream_t        *s = &g->streams[file_thread_streams[thread_id]];
+
+  sb_req.type = SB_REQ_TYPE_FILE;
+  file_req->size_class = 0;
+  file_req->cold = false;
+  SB_THREAD_MUTEX_LOCK();
+  
+  /* assume function is called with correct mode always */
+  if (g->mode == MODE_WRITE || g->mode == MODE_REWRITE)
+    file_req->operation = FILE_OP_TYPE_WRITE;
+  else     
+    file_req->operation = FILE_OP_TYPE_READ;
+
+  /* See whether it's time to fsync file(s) */
+  if (g->fsync_freq != 0 && file_req->operation == FILE_OP_TYPE_WRITE &&
+      g->is_dirty && g->req_performed % g->fsync_freq == 0)
+  {
+    file_req->operation = FILE_OP_TYPE_FSYNC;
+    file_req->file_id = g->fsynced_file;
+    file_req->pos = 0;
+    file_req->size = 0;
+    g->fsynced_file++;
+    if (g->fsynced_file == g->first_file + g->nfiles)
+    {
+      g->fsynced_file = g->first_file;
+      g->is_dirty = 0;
+    }
+
+    SB_THREAD_MUTEX_UNLOCK();
+    return sb_req;
+  }
+
+  g->req_performed++;
+
+  if (file_req->operation == FILE_OP_TYPE_WRITE)
+    g->is_dirty = 1;
+
+  /* Rewind to the start of the stream if all of it is processed */
+  if (s->offset == s->end)
+    s->offset = s->start;
+
+  /* Requests do not cross file and stream boundaries */
+  const long long pos = s->offset % file_size;
+  const long long left = SB_MIN(file_size - pos, s->end - s->offset);
+
+  file_req->file_id = g->first_file + (unsigned int) (s->offset / file_size);
+  file_req->pos = pos;
+  if (file_nsize_classes > 0)
+  {
+    file_req->size_class = file_get_size_class();
+    file_req->size = SB_MIN((long long) file_size_classes[file_req->size_class].size *
+                            SB_MAX(file_merged_requests, 1), left);
+  }
+  else
+    file_req->size = SB_MIN(file_request_size, left);
+
+  s->offset += file_req->size;
+
+  if (sb_globals.validate)
+  {
+    check_seq_req(g, s, file_req);
+    s->prev_req = *file_req;
+  }
+  
+  SB_THREAD_MUTEX_UNLOCK(); 
+
+  return sb_req;    
+}
+
+
+/* Request generatior for random tests */
+
+
+/*
+  Select a block with a skewed distribution. Hot blocks are at the same
+  positions in the file set unless --file-hotspot-move is used.
+*/
+
+static long long file_get_rnd_block(long long nblocks)
+{
+  long long block;
+
+  if (nblocks - 1 <= UINT32_MAX)
+    block = file_rand_func(0, (uint32_t) (nblocks - 1));
+  else
+  {
+    /* Too many blocks for sb_rand, lose some precision */
+    const double r = file_rand_func(0, UINT32_MAX);
+
+    block = (long long) (r / UINT32_MAX * (nblocks - 1));
+  }
+
+  if (file_hotspot_move > 0)
+  {
+    struct timespec ts;
+    double          elapsed;
+
+    SB_GETTIME(&ts);
+    elapsed = NS2SEC(SEC2NS(ts.tv_sec) + ts.tv_nsec - file_start_ns);
+
+    block = (block + (long long) (elapsed * file_hotspot_move / 100 *
+                                  nblocks)) % nblocks;
+  }
+
+  return block;
+}
+
+
+sb_event_t file_get_rnd_request(int thread_id)
+{
+  sb_event_t           sb_req;
+  sb_file_request_t    *file_req = &sb_req.u.file_request;
+  file_group_t         *g = &file_groups[file_thread_groups[thread_id]];
+  unsigned long long   tmppos;
+  int                  mode = g->mode;
+  unsigned int         i;
+
+  sb_req.type = SB_REQ_TYPE_FILE;
+  file_req->size_class = 0;
+  file_req->cold = false;
+
+  if (g->mode == MODE_RND_RW)
+  {
+    mode = (sb_counter_val(thread_id, SB_CNT_READ) + 1.0) /
+        (sb_counter_val(thread_id, SB_CNT_WRITE) + 1.0) < file_rw_ratio ?
+      MODE_RND_READ : MODE_RND_WRITE;
+  }
+
+  /*
+    is_dirty is only set if writes are done and cleared after all files
+    are synced
+  */
+  if (g->fsync_freq != 0 && g->is_dirty)
+  {
+    if (g->req_performed % g->fsync_freq == 0)
+    {
+      file_req->operation = FILE_OP_TYPE_FSYNC;  
+      file_req->file_id = g->fsynced_file;
+      file_req->pos = 0;
+      file_req->size = 0;
+      g->fsynced_file++;
+      if (g->fsynced_file == g->first_file + g->nfiles)
+      {
+        g->fsynced_file = g->first_file;
+        g->is_dirty = 0;
+      }
+
+      SB_THREAD_MUTEX_UNLOCK();
+      return sb_req;
+    }
+  }
+
+  if (file_mode_discards(g->mode) &&
+      sb_rand_uniform_double() * 100 < file_discard_ratio)
+    file_req->operation = FILE_OP_TYPE_DISCARD;
+  else if (mode==MODE_RND_WRITE) /* mode shall be WRITE or RND_WRITE only */
+    file_req->operation = FILE_OP_TYPE_WRITE;
+  else
+    file_req->operation = FILE_OP_TYPE_READ;
+
+  if (file_nsize_classes > 0)
+    file_req->size_class = file_get_size_class();
+
+retry:
+  /* Offset within the files of the thread's group */
+  long long base = 0, size = g->size, nblocks = g->nblocks;
+
+  if (file_cache_hit_ratio > 0)
+  {
+    /* Pick the resident or the cold part of the group */
+    if (sb_rand_uniform(1, 100) <= file_cache_hit_ratio)
+    {
+      size = g->hot_size;
+      nblocks = g->hot_blocks;
+    }
+    else
+    {
+      base = g->hot_size;
+      size = g->size - g->hot_size;
+      nblocks = g->nblocks - g->hot_blocks;
+    }
+  }
+
+  if (file_rand_func == NULL)
+    tmppos = (long long) (sb_rand_uniform_double() * size);
+  else
+    tmppos = file_get_rnd_block(nblocks) * file_block_size;
+  tmppos = base + tmppos - (tmppos % (long long) file_block_size);
+  file_req->cold = file_cache_resident > 0 &&
+    (long long) tmppos >= g->hot_size;
+  file_req->file_id = g->first_file + (int) (tmppos / (long long) file_size);
+  file_req->pos = (long long) (tmppos % (long long) file_size);
+  if (file_nsize_classes > 0)
+  {
+    /* Align the request to its own size within the file */
+    const long long size = file_size_classes[file_req->size_class].size;
+
+    file_req->pos -= file_req->pos % size;
+    file_req->size = SB_MIN(size, file_size - file_req->pos);
+  }
+  else
+    file_req->size = SB_MIN(file_block_size, file_size - file_req->pos);
+
+  if (sb_globals.validate)
+  {
+    /*
+       For the multi-threaded validation test we have to make sure the block is
+       not being used by another thread
+    */
+    for (i = 0; i < sb_globals.threads; i++)
+    {
+      if (i != (unsigned) thread_id && per_thread[i].buffer_file_id == file_req->file_id &&
+          per_thread[i].buffer_pos == file_req->pos)
+        goto retry;
+    }
+  }
+
+  per_thread[thread_id].buffer_file_id = file_req->file_id;
+  per_thread[thread_id].buffer_pos = file_req->pos;
+
+  g->req_performed++;
+  if (file_req->operation == FILE_OP_TYPE_WRITE ||
+      file_req->operation == FILE_OP_TYPE_DISCARD)
+    g->is_dirty = 1;
+
+  SB_THREAD_MUTEX_UNLOCK();        
+  return sb_req;
+}
+
+
+int file_execute_event(sb_event_t *sb_req, int thread_id)
+{
+  FILE_DESCRIPTOR    fd;
+  sb_file_request_t *file_req = &sb_req->u.file_request;
+  /* In async modes latency is measured from submission to completion */
+  const bool         sync_io = file_io_mode != FILE_IO_MODE_ASYNC &&
+    file_io_mode != FILE_IO_MODE_URING;
+  uint64_t           start_ns;
+  uint64_t           lat_ns = 0;
+
+  if (sb_globals.debug)
+  {
+    log_text(LOG_DEBUG,
+             "Executing request, operation: %d, file_id: %d, pos: %d, "
+             "size: %d",
+             file_req->operation,
+             file_req->file_id,
+             (int)file_req->pos,
+             (int)file_req->size);
+  }
+  
+  /* Check request parameters */
+  if (file_req->file_id > num_files)
+  {
+    log_text(LOG_FATAL, "Incorrect file id in request: %u", file_req->file_id);
+    return 1;
+  }
+  if (file_req->pos + file_req->size > file_size)
+  {
+    log_text(LOG_FATAL, "I/O request exceeds file size. "
+             "file id: %d file size: %lld req offset: %lld req size: %lld",
+             file_req->file_id, (long long) file_size,
+             (long long) file_req->pos, (long long) file_req->size);
+    return 1;
+  }
+  fd = files[file_req->file_id];
+
+  /* Picked up by async submissions for per-class stats */
+  per_thread[thread_id].size_class = file_req->size_class;
+
+  switch (file_req->operation) {
+    case FILE_OP_TYPE_NULL:
+      log_text(LOG_FATAL, "Execute of NULL request called !, aborting");
+      return 1;
+    case FILE_OP_TYPE_WRITE:
+
+      /* Store checksum and offset in a buffer when in validation mode */
+      if (sb_globals.validate)
+        file_fill_buffer(per_thread[thread_id].buffer, file_req->size,
+                         file_req->file_id, file_req->pos);
+
+      start_ns = file_op_start(FILE_OP_TYPE_WRITE);
+
+      if(file_pwrite(file_req->file_id, per_thread[thread_id].buffer,
+                     file_req->size, file_req->pos, thread_id)
+         != (ssize_t)file_req->size)
+      {
+        log_errno(LOG_FATAL, "Failed to write file! file: " FD_FMT " pos: %lld", 
+                  fd, (long long)file_req->pos);
+        return 1;
+      }
+
+      if (sync_io)
+      {
+        lat_ns = file_op_end(FILE_OP_TYPE_WRITE, start_ns, thread_id);
+
+        if (file_writeback)
+          file_writeback_write(file_req->file_id, file_req->size, lat_ns);
+      }
+
+      /* Check if we have to fsync each write operation */
+      if (file_fsync_all && file_fsync(file_req->file_id, thread_id))
+          return 1;
+
+      /* In async modes stats will me updated on requests completion */
+      if (sync_io)
+      {
+        sb_counter_inc(thread_id, SB_CNT_WRITE);
+        sb_counter_add(thread_id, SB_CNT_BYTES_WRITTEN, file_req->size);
+        file_size_class_add(thread_id, file_req->size_class,
+                            FILE_OP_TYPE_WRITE, file_req->size, lat_ns);
+      }
+
+      break;
+    case FILE_OP_TYPE_READ:
+      if (file_cache_stats)
+        file_cache_sample(thread_id, file_req);
+
+      start_ns = file_op_start(FILE_OP_TYPE_READ);
+
+      if(file_pread(file_req->file_id, per_thread[thread_id].buffer,
+                    file_req->size, file_req->pos, thread_id)
+         != (ssize_t)file_req->size)
+      {
+        log_errno(LOG_FATAL, "Failed to read file! file: " FD_FMT " pos: %lld",
+                  fd, (long long)file_req->pos);
+        return 1;
+      }
+
+      if (sync_io)
+        lat_ns = file_op_end(FILE_OP_TYPE_READ, start_ns, thread_id);
+
+#ifdef SB_FILE_CACHE
+      /* Keep the cold part of files out of page cache */
+      if (file_req->cold && file_io_mode == FILE_IO_MODE_SYNC)
+        posix_fadvise(fd, file_req->pos, file_req->size, POSIX_FADV_DONTNEED);
+#endif
+
+      /* Validate block if run with validation enabled */
+      if (sb_globals.validate &&
+          file_validate_buffer(per_thread[thread_id].buffer, file_req->size,
+                               file_req->file_id, file_req->pos))
+      {
+        log_text(LOG_FATAL,
+          "Validation failed on file " FD_FMT ", block offset %lld, exiting...",
+                 file_req->file_id, (long long) file_req->pos);
+        return 1;
+      }
+
+      /* In async modes stats will me updated on requests completion */
+      if (sync_io)
+      {
+        sb_counter_inc(thread_id, SB_CNT_READ);
+        sb_counter_add(thread_id, SB_CNT_BYTES_READ, file_req->size);
+        file_size_class_add(thread_id, file_req->size_class,
+                            FILE_OP_TYPE_READ, file_req->size, lat_ns);
+      }
+
+      break;
+    case FILE_OP_TYPE_FSYNC:
+      /* Ignore fsync requests if we are already fsync'ing each operation */
+      if (file_fsync_all)
+        break;
+      if(file_fsync(file_req->file_id, thread_id))
+        return 1;
+
+      break;
+    case FILE_OP_TYPE_DISCARD:
+      if (file_discard(file_req, thread_id))
+        return 1;
+
+      break;
+    default:
+      log_text(LOG_FATAL, "Execute of UNKNOWN file request type called (%d)!, "
+               "aborting", file_req->operation);
+      return 1;
+  }
+  return 0;
+
+}
+
+static void print_file_extra_flags(void)
+{
+  log_text(LOG_NOTICE, "Extra file open flags: %s%s%s%s",
+           file_extra_flags == 0 ? "(none)" : "",
+           file_extra_flags & SB_FILE_FLAG_SYNC ? "sync " : "",
+           file_extra_flags & SB_FILE_FLAG_DSYNC ? "dsync ": "",
+           file_extra_flags & SB_FILE_FLAG_DIRECTIO ? "directio" : ""
+           );
+}
+
+void file_print_mode(void)
+{
+  char sizestr[16];
+
+  print_file_extra_flags();
+  if (file_device != NULL)
+    log_text(LOG_NOTICE, "Block device %s from offset %sB", file_device,
+             sb_print_value_size(sizestr, sizeof(sizestr),
+                                 file_device_offset));
+  log_text(LOG_NOTICE, "%d %s, %sB each", num_files,
+           file_device != NULL ? "regions" : "files",
+           sb_print_value_size(sizestr, sizeof(sizestr), file_size));
+  log_text(LOG_NOTICE, "%sB total file size",
+           sb_print_value_size(sizestr, sizeof(sizestr),
+                               file_size * num_files));
+  if (file_nsize_classes > 0)
+  {
+    const unsigned int total =
+      file_size_classes[file_nsize_classes - 1].cum_weight;
+    char               buf[512];
+    size_t             len = 0;
+
+    buf[0] = '\0';
+    for (unsigned int i = 0; i < file_nsize_classes && len < sizeof(buf); i++)
+      len += snprintf(buf + len, sizeof(buf) - len, "%s%sB (%.2f%%)",
+                      i > 0 ? ", " : "",
+                      sb_print_value_size(sizestr, sizeof(sizestr),
+                                          file_size_classes[i].size),
+                      file_size_classes[i].weight * 100.0 / total);
+    log_text(LOG_NOTICE, "Block sizes: %s", buf);
+  }
+  else
+    log_text(LOG_NOTICE, "Block size %sB",
+             sb_print_value_size(sizestr, sizeof(sizestr), file_block_size));
+  if (file_merged_requests > 0)
+    log_text(LOG_NOTICE, "Merging requests up to %sB for sequential IO.",
+             sb_print_value_size(sizestr, sizeof(sizestr),
+                                 file_request_size));
+
+  switch (test_mode)
+  {
+    case MODE_RND_WRITE:
+    case MODE_RND_READ:
+    case MODE_RND_RW:
+      log_text(LOG_NOTICE, "Number of IO requests: %" PRIu64,
+               sb_globals.max_events);
+      log_text(LOG_NOTICE,
+               "Read/Write ratio for combined random IO test: %2.2f",
+               file_rw_ratio);
+      if (file_rand_func != NULL)
+      {
+        if (file_hotspot_move > 0)
+          log_text(LOG_NOTICE, "Block selection: %s distribution, hot spot "
+                   "moving by %.2f%% of the file set per second",
+                   sb_get_value_string("file-rand-type"), file_hotspot_move);
+        else
+          log_text(LOG_NOTICE, "Block selection: %s distribution",
+                   sb_get_value_string("file-rand-type"));
+      }
+      break;
+    default:
+      break;
+  }
+
+  if (file_discard_ratio > 0)
+    log_text(LOG_NOTICE, "Replacing %.2f%% of random write test requests with "
+             "%s requests", file_discard_ratio,
+             get_op_latency_str(FILE_OP_TYPE_DISCARD));
+
+  if (file_fsync_freq > 0)
+    log_text(LOG_NOTICE,
+             "Periodic FSYNC enabled, calling fsync() each %d requests.",
+             file_fsync_freq);
+
+  if (file_fsync_end)
+    log_text(LOG_NOTICE, "Calling fsync() at the end of test, Enabled.");
+
+  if (file_fsync_all)
+    log_text(LOG_NOTICE, "Calling fsync() after each write operation.");
+
+  log_text(LOG_NOTICE, "Using %s I/O mode", get_io_mode_str(file_io_mode));
+
+  if (file_cache_resident > 0)
+  {
+    if (file_cache_hit_ratio > 0)
+      log_text(LOG_NOTICE, "Page cache: %u%% of files resident, %u%% of "
+               "random requests to the resident part", file_cache_resident,
+               file_cache_hit_ratio);
+    else
+      log_text(LOG_NOTICE, "Page cache: %u%% of files resident",
+               file_cache_resident);
+  }
+
+  if (file_affinity == FILE_AFFINITY_OWNED)
+    log_text(LOG_NOTICE, "Each thread works on its own subset of files");
+  else if (file_affinity == FILE_AFFINITY_SHARDED)
+    log_text(LOG_NOTICE, "Threads are split into %u groups, each working on "
+             "its own subset of files", file_ngroups);
+
+#ifdef SB_FILE_ASYNC
+  if (file_async_reaper > 0)
+    log_text(LOG_NOTICE, "Reaping completions in %u thread(s), one per %u "
+             "worker(s)%s",
+             (sb_globals.threads + file_async_reaper - 1) / file_async_reaper,
+             file_async_reaper, file_async_poll ? ", busy polling" : "");
+  else if (file_async_poll)
+    log_text(LOG_NOTICE, "Busy polling for completions");
+#endif
+
+#ifdef HAVE_LIBURING
+  if (file_io_mode == FILE_IO_MODE_URING)
+    log_text(LOG_NOTICE, "io_uring queue depth: %u, submission batch: %u%s%s%s",
+             file_uring_depth, file_uring_batch,
+             file_uring_fixed_bufs ? ", fixed buffers" : "",
+             file_uring_fixed_files ? ", fixed files" : "",
+             file_uring_sqpoll ? ", SQPOLL" : "");
+#endif
+
+#ifdef HAVE_MMAP
+  if (file_io_mode == FILE_IO_MODE_MMAP)
+  {
+    if (file_mmap_window > 0)
+      log_text(LOG_NOTICE, "Mapping window: %sB per thread",
+               sb_print_value_size(sizestr, sizeof(sizestr),
+                                   file_mmap_window));
+    else
+      log_text(LOG_NOTICE, "Mapping window: whole files");
+    log_text(LOG_NOTICE, "Mapping advice: %s%s%s",
+             sb_get_value_string("file-mmap-advice"),
+             file_mmap_populate ? ", MAP_POPULATE" : "",
+             file_mmap_msync_writes ? ", msync() after each write" : "");
+  }
+#endif
+
+  if (sb_globals.validate)
+    log_text(LOG_NOTICE, "Using checksums validation.");
+  
+  if (file_njobs > 0)
+  {
+    log_text(LOG_NOTICE, "Running %u concurrent jobs:", file_njobs);
+    for (unsigned int i = 0; i < file_njobs; i++)
+    {
+      const file_job_t * const job = &file_jobs[i];
+      char                     rate[64] = "";
+      char                     fsync[64] = "";
+
+      if (job->rate > 0)
+        snprintf(rate, sizeof(rate), ", limited to %sB/s",
+                 sb_print_value_size(sizestr, sizeof(sizestr), job->rate));
+      if (job->fsync_freq >= 0 && file_mode_writes(job->mode))
+        snprintf(fsync, sizeof(fsync), ", fsync() each %d requests",
+                 job->fsync_freq);
+      log_text(LOG_NOTICE, "    %s: %s test, %u thread(s)%s%s", job->name,
+               get_test_mode_str(job->mode), job->nthreads, rate, fsync);
+    }
+  }
+  else
+    log_text(LOG_NOTICE, "Doing %s test", get_test_mode_str(test_mode));
+
+  if (file_rate > 0)
+    log_text(LOG_NOTICE, "Total I/O rate limited to %sB/s",
+             sb_print_value_size(sizestr, sizeof(sizestr), file_rate));
+}
+
+/*
+  Map test files for mincore() and, with --file-cache-resident, read the
+  resident part of each file group into page cache and evict the rest.
+*/
+
+static int file_cache_prepare(void)
+{
+#ifdef SB_FILE_CACHE
+  file_cache_cumul[0] = file_cache_cumul[1] = 0;
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+  {
+    per_thread[i].cache_seq = 0;
+    per_thread[i].cache_reads = per_thread[i].cache_hits = 0;
+  }
+
+  file_cache_maps = calloc(num_files, sizeof(void *));
+  if (file_cache_maps == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  for (unsigned int i = 0; i < num_files; i++)
+  {
+    file_cache_maps[i] = mmap(NULL, file_size, PROT_READ, MAP_SHARED,
+                              files[i], 0);
+    if (file_cache_maps[i] == MAP_FAILED)
+    {
+      file_cache_maps[i] = NULL;
+      log_errno(LOG_FATAL, "mmap() failed on test file %u", i);
+      return 1;
+    }
+  }
+
+  if (file_cache_resident == 0)
+    return 0;
+
+  /*
+    Dirty pages cannot be evicted, so flush them first. Readahead is disabled,
+    as it would pull the cold part back into page cache.
+  */
+  for (unsigned int i = 0; i < num_files; i++)
+  {
+    if (fsync(files[i]) ||
+        posix_fadvise(files[i], 0, 0, POSIX_FADV_DONTNEED) ||
+        posix_fadvise(files[i], 0, 0, POSIX_FADV_RANDOM))
+    {
+      log_errno(LOG_FATAL, "Cannot evict test file %u from page cache", i);
+      return 1;
+    }
+  }
+
+  const size_t chunk = 1024 * 1024;
+  char * const buf = malloc(chunk);
+
+  if (buf == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  for (unsigned int i = 0; i < file_ngroups; i++)
+  {
+    const file_group_t * const g = &file_groups[i];
+
+    for (long long off = 0; off < g->hot_size; off += chunk)
+    {
+      const unsigned int file_id = g->first_file + off / file_size;
+      const long long    pos = off % file_size;
+      const size_t       len = SB_MIN((long long) chunk,
+                                      SB_MIN(g->hot_size - off,
+                                             file_size - pos));
+
+      if (pread(files[file_id], buf, len, pos) < 0)
+      {
+        log_errno(LOG_FATAL, "Cannot read test file %u", file_id);
+        free(buf);
+        return 1;
+      }
+    }
+  }
+
+  free(buf);
+
+  return 0;
+#else
+  log_text(LOG_FATAL, "page cache control requires mmap(), mincore() and "
+           "posix_fadvise(), which are unavailable on this platform");
+  return 1;
+#endif
+}
+
+
+static void file_cache_done(void)
+{
+#ifdef SB_FILE_CACHE
+  if (file_cache_maps == NULL)
+    return;
+
+  for (unsigned int i = 0; i < num_files; i++)
+  {
+    if (file_cache_maps[i] != NULL)
+      munmap(file_cache_maps[i], file_size);
+  }
+
+  free(file_cache_maps);
+  file_cache_maps = NULL;
+#endif
+}
+
+
+/*
+  Check whether every page of a read request is in page cache before issuing
+  it. Only every FILE_CACHE_SAMPLE-th read of a thread is checked to keep the
+  mincore() overhead low.
+*/
+
+static void file_cache_sample(int thread_id, sb_file_request_t *req)
+{
+#ifdef SB_FILE_CACHE
+  sb_per_thread_t * const pt = &per_thread[thread_id];
+  const long long         page = sb_getpagesize();
+  const long long         start = req->pos / page * page;
+  const size_t            npages = (req->pos + req->size - start +
+                                    page - 1) / page;
+  unsigned char           vec[256];
+  unsigned char           *v = vec;
+  bool                    hit = true;
+
+  if (pt->cache_seq++ % FILE_CACHE_SAMPLE != 0 || req->size == 0 ||
+      (npages > sizeof(vec) && (v = malloc(npages)) == NULL))
+    return;
+
+  if (mincore((char *) file_cache_maps[req->file_id] + start,
+              req->pos + req->size - start, (void *) v) == 0)
+  {
+    for (size_t i = 0; i < npages && hit; i++)
+      hit = v[i] & 1;
+
+    ck_pr_store_64(&pt->cache_reads, pt->cache_reads + 1);
+    if (hit)
+      ck_pr_store_64(&pt->cache_hits, pt->cache_hits + 1);
+  }
+
+  if (v != vec)
+    free(v);
+#else
+  (void) thread_id;
+  (void) req;
+#endif
+}
+
+
+/*
+  Check that --file-device is a block device which is safe to test: neither
+  the device nor any of its partitions is mounted or used by other devices
+  (LVM, MD, etc.), and the tested region fits into the device and is aligned
+  for O_DIRECT. 'writes' is true if the command overwrites the region.
+*/
+
+static int file_device_check(bool writes)
+{
+#ifdef SB_FILE_DEVICE
+  struct stat        st;
+  char               path[PATH_MAX];
+  char               disk[PATH_MAX];
+  char               line[1024];
+  FILE               *fp;
+  DIR                *dir;
+  struct dirent      *de;
+  unsigned long long dev_size;
+  int                lbs;
+  int                fd;
+  char               sizestr[16];
+
+  if (stat(file_device, &st))
+  {
+    log_errno(LOG_FATAL, "Cannot stat '%s'", file_device);
+    return 1;
+  }
+  if (!S_ISBLK(st.st_mode))
+  {
+    log_text(LOG_FATAL, "'%s' is not a block device", file_device);
+    return 1;
+  }
+
+  const unsigned int dev_major = major(st.st_rdev);
+  const unsigned int dev_minor = minor(st.st_rdev);
+
+  snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/holders", dev_major,
+           dev_minor);
+  if ((dir = opendir(path)) != NULL)
+  {
+    while ((de = readdir(dir)) != NULL)
+    {
+      if (de->d_name[0] == '.')
+        continue;
+      log_text(LOG_FATAL, "'%s' is in use by %s", file_device, de->d_name);
+      closedir(dir);
+      return 1;
+    }
+    closedir(dir);
+  }
+
+  /* Partitions are the only block devices whose parent is the device */
+  snprintf(path, sizeof(path), "/sys/dev/block/%u:%u", dev_major, dev_minor);
+  if (realpath(path, disk) == NULL)
+    disk[0] = '\0';
+
+  if ((fp = fopen("/proc/self/mountinfo", "r")) == NULL)
+  {
+    log_errno(LOG_FATAL, "Cannot open /proc/self/mountinfo");
+    return 1;
+  }
+
+  while (fgets(line, sizeof(line), fp) != NULL)
+  {
+    unsigned int mnt_major, mnt_minor;
+    char         mnt_point[512];
+    char         parent[PATH_MAX];
+    bool         partition = false;
+
+    if (sscanf(line, "%*d %*d %u:%u %*s %511s", &mnt_major, &mnt_minor,
+               mnt_point) != 3)
+      continue;
+
+    if (mnt_major != dev_major || mnt_minor != dev_minor)
+    {
+      snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/..", mnt_major,
+               mnt_minor);
+      partition = disk[0] != '\0' && realpath(path, parent) != NULL &&
+        !strcmp(parent, disk);
+      if (!partition)
+        continue;
+    }
+
+    log_text(LOG_FATAL, "%s '%s' is mounted at %s",
+             partition ? "A partition of" : "Device", file_device, mnt_point);
+    fclose(fp);
+    return 1;
+  }
+  fclose(fp);
+
+  if ((fd = open(file_device, O_RDONLY)) < 0)
+  {
+    log_errno(LOG_FATAL, "Cannot open device '%s'", file_device);
+    return 1;
+  }
+  if (ioctl(fd, BLKGETSIZE64, &dev_size) || ioctl(fd, BLKSSZGET, &lbs))
+  {
+    log_errno(LOG_FATAL, "Cannot get the size of '%s'", file_device);
+    close(fd);
+    return 1;
+  }
+  close(fd);
+
+  if (file_device_offset < 0 ||
+      (unsigned long long) (file_device_offset + file_size * num_files) >
+      dev_size)
+  {
+    log_text(LOG_FATAL, "--file-total-size at --file-device-offset exceeds "
+             "the size of '%s' (%sB)", file_device,
+             sb_print_value_size(sizestr, sizeof(sizestr), dev_size));
+    return 1;
+  }
+
+  /* Regions must not overlap, including partially written last blocks */
+  if (file_device_offset % lbs || file_size % file_block_size ||
+      file_block_size % lbs)
+  {
+    log_text(LOG_FATAL, "--file-device-offset and --file-block-size must be "
+             "multiples of the logical block size of '%s' (%d bytes), and "
+             "the region size (--file-total-size / --file-num) a multiple of "
+             "--file-block-size", file_device, lbs);
+    return 1;
+  }
+
+  if (writes && !file_device_destroy)
+  {
+    log_text(LOG_FATAL, "This will overwrite %sB of data on '%s' at offset "
+             "%lld. Use --file-device-destroy to confirm",
+             sb_print_value_size(sizestr, sizeof(sizestr),
+                                 file_size * num_files),
+             file_device, file_device_offset);
+    return 1;
+  }
+
+  return 0;
+#else
+  (void) writes; /* unused */
+
+  log_text(LOG_FATAL, "--file-device is not supported on this platform");
+  return 1;
+#endif
+}
+
+
+/* Read the current counters of the block device holding test files */
+
+static int file_diskstats_read(file_diskstats_t *ds)
+{
+  FILE               *fp;
+  unsigned long long v[11];
+  int                n;
+
+  if ((fp = fopen(file_disk_path, "r")) == NULL)
+    return 1;
+
+  n = fscanf(fp, "%llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+             &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8],
+             &v[9], &v[10]);
+  fclose(fp);
+
+  if (n != 11)
+    return 1;
+
+  /* Sector counts (2, 6) and requests in flight (8) are not used */
+  ds->reads = v[0];
+  ds->read_merges = v[1];
+  ds->read_ticks = v[3];
+  ds->writes = v[4];
+  ds->write_merges = v[5];
+  ds->write_ticks = v[7];
+  ds->io_ticks = v[9];
+  ds->time_in_queue = v[10];
+
+  return 0;
+}
+
+
+/*
+  Find the block device of the file system holding test files and take the
+  initial sample of its counters.
+*/
+
+int file_diskstats_init(void)
+{
+  struct stat  st;
+  char         path[128];
+  char         line[128];
+  FILE         *fp;
+  unsigned int dev_major, dev_minor;
+
+  if (fstat(files[0], &st))
+  {
+    log_errno(LOG_FATAL, "fstat() failed on test files");
+    return 1;
+  }
+
+  /* A raw device is identified by the device it represents */
+  const dev_t dev = S_ISBLK(st.st_mode) ? st.st_rdev : st.st_dev;
+
+  dev_major = major(dev);
+  dev_minor = minor(dev);
+
+  snprintf(file_disk_path, sizeof(file_disk_path), "/sys/dev/block/%u:%u/stat",
+           dev_major, dev_minor);
+
+  if (dev_major == 0 || file_diskstats_read(&file_disk_cumul))
+  {
+    log_text(LOG_FATAL, "--file-diskstats: no statistics for device %u:%u "
+             "holding test files. Is it a block device file system?",
+             dev_major, dev_minor);
+    return 1;
+  }
+
+  file_disk_interm = file_disk_cumul;
+
+  /* Use the kernel device name if available */
+  snprintf(file_disk_name, sizeof(file_disk_name), "%u:%u", dev_major,
+           dev_minor);
+  snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/uevent", dev_major,
+           dev_minor);
+  if ((fp = fopen(path, "r")) != NULL)
+  {
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+      if (!strncmp(line, "DEVNAME=", 8))
+      {
+        line[strcspn(line, "\n")] = '\0';
+        snprintf(file_disk_name, sizeof(file_disk_name), "%s", line + 8);
+        break;
+      }
+    }
+    fclose(fp);
+  }
+
+  return 0;
+}
+
+
+/*
+  Print device statistics accumulated since the sample in *last and replace
+  it with the current one.
+*/
+
+void file_diskstats_report(file_diskstats_t *last, sb_stat_t *stat,
+                           bool cumulative)
+{
+  const double     seconds = stat->time_interval;
+  const double     ms = seconds * 1000;
+  file_diskstats_t cur;
+
+  if (file_diskstats_read(&cur))
+    return;
+
+  const uint64_t reads = cur.reads - last->reads;
+  const uint64_t writes = cur.writes - last->writes;
+  const double   rrqm = (cur.read_merges - last->read_merges) / seconds;
+  const double   wrqm = (cur.write_merges - last->write_merges) / seconds;
+  const double   aqu = (cur.time_in_queue - last->time_in_queue) / ms;
+  const double   util = (cur.io_ticks - last->io_ticks) * 100.0 / ms;
+  const double   r_await = reads > 0 ?
+    (double) (cur.read_ticks - last->read_ticks) / reads : 0;
+  const double   w_await = writes > 0 ?
+    (double) (cur.write_ticks - last->write_ticks) / writes : 0;
+
+  *last = cur;
+
+  if (!cumulative)
+  {
+    log_timestamp(LOG_NOTICE, stat->time_total,
+                  "%s: r/s: %4.2f w/s: %4.2f rrqm/s: %4.2f wrqm/s: %4.2f "
+                  "aqu-sz: %4.2f util: %4.2f%% await (ms): r %4.2f w %4.2f",
+                  file_disk_name, reads / seconds, writes / seconds, rrqm,
+                  wrqm, aqu, util, r_await, w_await);
+    return;
+  }
+
+  log_text(LOG_NOTICE, "Device %s statistics:", file_disk_name);
+  log_text(LOG_NOTICE, "         %-32s%10.2f", "reads/s:", reads / seconds);
+  log_text(LOG_NOTICE, "         %-32s%10.2f", "writes/s:", writes / seconds);
+  log_text(LOG_NOTICE, "         %-32s%10.2f", "read merges/s:", rrqm);
+  log_text(LOG_NOTICE, "         %-32s%10.2f", "write merges/s:", wrqm);
+  log_text(LOG_NOTICE, "         %-32s%10.2f", "avg queue size:", aqu);
+  log_text(LOG_NOTICE, "         %-32s%10.2f", "utilization (%):", util);
+  log_text(LOG_NOTICE, "         %-32s%10.2f", "avg read latency (ms):",
+           r_await);
+  log_text(LOG_NOTICE, "         %-32s%10.2f", "avg write latency (ms):",
+           w_await);
+  log_text(LOG_NOTICE, "");
+}
+
+
+/*
+  Dirty page writeback monitoring with --file-writeback. Dirty and Writeback
+  memory and I/O pressure are sampled system-wide with each report. Buffered
+  writes taking at least FILE_WB_STALL_MS are counted as stalled, as they were
+  most likely throttled by balance_dirty_pages(). Each fsync is attributed to
+  the number of bytes written to its file since the previous fsync, i.e. the
+  dirty data it had to flush (unless the kernel wrote it back earlier).
+*/
+
+#define FILE_WB_STALL_MS 1
+
+/* Upper bounds of dirty data size buckets for fsync latency */
+static const uint64_t file_wb_bucket_max[] =
+  { 0, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024, 256 * 1024 * 1024,
+    UINT64_MAX };
+
+#define FILE_WB_NBUCKETS \
+  (sizeof(file_wb_bucket_max) / sizeof(file_wb_bucket_max[0]))
+
+typedef struct
+{
+  uint64_t        fsyncs;
+  uint64_t        lat_ns;       /* total latency */
+  uint64_t        max_ns;
+} file_wb_bucket_t;
+
+/* A sample of system-wide counters */
+typedef struct
+{
+  uint64_t        dirty_kb;
+  uint64_t        writeback_kb;
+  uint64_t        psi_some_us;  /* /proc/pressure/io totals */
+  uint64_t        psi_full_us;
+  uint64_t        time_ns;
+} file_wb_sample_t;
+
+static uint64_t         *file_wb_dirty;       /* per-file unsynced bytes */
+static file_wb_bucket_t file_wb_buckets[FILE_WB_NBUCKETS];
+static uint64_t         file_wb_stalls;       /* stalled writes */
+static uint64_t         file_wb_stall_ns;
+static bool             file_wb_psi;          /* /proc/pressure/io exists */
+static file_wb_sample_t file_wb_interm;       /* at the last report */
+static file_wb_sample_t file_wb_cumul;        /* at the last cumulative one */
+static uint64_t         file_wb_stalls_interm[2]; /* stalls, ns */
+static uint64_t         file_wb_stalls_cumul[2];
+/* Dirty and writeback memory at reports since the last cumulative one */
+static uint64_t         file_wb_nsamples;
+static uint64_t         file_wb_sum_kb[2];
+static uint64_t         file_wb_max_kb[2];
+
+
+static int file_writeback_sample(file_wb_sample_t *s)
+{
+  struct timespec    ts;
+  char               line[256];
+  unsigned long long v;
+  FILE               *fp;
+  int                found = 0;
+
+  memset(s, 0, sizeof(*s));
+
+  if ((fp = fopen("/proc/meminfo", "r")) == NULL)
+    return 1;
+
+  while (fgets(line, sizeof(line), fp) != NULL && found < 2)
+  {
+    if (sscanf(line, "Dirty: %llu kB", &v) == 1)
+    {
+      s->dirty_kb = v;
+      found++;
+    }
+    else if (sscanf(line, "Writeback: %llu kB", &v) == 1)
+    {
+      s->writeback_kb = v;
+      found++;
+    }
+  }
+
+  fclose(fp);
+
+  if ((fp = fopen("/proc/pressure/io", "r")) != NULL)
+  {
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+      const char *total = strstr(line, "total=");
+
+      if (total == NULL || sscanf(total, "total=%llu", &v) != 1)
+        continue;
+
+      if (!strncmp(line, "some ", 5))
+        s->psi_some_us = v;
+      else if (!strncmp(line, "full ", 5))
+        s->psi_full_us = v;
+    }
+
+    fclose(fp);
+  }
+
+  SB_GETTIME(&ts);
+  s->time_ns = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+
+  return found < 2;
+}
+
+
+int file_writeback_init(void)
+{
+  file_wb_dirty = calloc(num_files, sizeof(uint64_t));
+  if (file_wb_dirty == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  if (file_writeback_sample(&file_wb_cumul))
+  {
+    log_text(LOG_FATAL, "--file-writeback: cannot read Dirty and Writeback "
+             "from /proc/meminfo");
+    return 1;
+  }
+
+  file_wb_psi = access("/proc/pressure/io", R_OK) == 0;
+  file_wb_interm = file_wb_cumul;
+
+  memset(file_wb_buckets, 0, sizeof(file_wb_buckets));
+  file_wb_stalls = file_wb_stall_ns = 0;
+  file_wb_stalls_interm[0] = file_wb_stalls_interm[1] = 0;
+  file_wb_stalls_cumul[0] = file_wb_stalls_cumul[1] = 0;
+  file_wb_nsamples = 0;
+  file_wb_sum_kb[0] = file_wb_sum_kb[1] = 0;
+  file_wb_max_kb[0] = file_wb_max_kb[1] = 0;
+
+  return 0;
+}
+
+
+/* Account a completed synchronous write */
+
+void file_writeback_write(unsigned int id, uint64_t size, uint64_t lat_ns)
+{
+  if (file_wb_dirty == NULL)
+    return;
+
+  ck_pr_add_64(&file_wb_dirty[id], size);
+
+  if (lat_ns >= MS2NS(FILE_WB_STALL_MS))
+  {
+    ck_pr_inc_64(&file_wb_stalls);
+    ck_pr_add_64(&file_wb_stall_ns, lat_ns);
+  }
+}
+
+
+/* Return the number of bytes an fsync of a file is about to flush */
+
+uint64_t file_writeback_fsync_start(unsigned int id)
+{
+  return file_wb_dirty != NULL ? ck_pr_fas_64(&file_wb_dirty[id], 0) : 0;
+}
+
+
+/* Account a completed fsync which flushed 'dirty' bytes */
+
+void file_writeback_fsync(uint64_t dirty, uint64_t lat_ns)
+{
+  file_wb_bucket_t *b;
+  uint64_t         max;
+  unsigned int     i;
+
+  if (file_wb_dirty == NULL)
+    return;
+
+  for (i = 0; dirty > file_wb_bucket_max[i]; i++)
+    ;
+
+  b = &file_wb_buckets[i];
+
+  ck_pr_inc_64(&b->fsyncs);
+  ck_pr_add_64(&b->lat_ns, lat_ns);
+
+  while (lat_ns > (max = ck_pr_load_64(&b->max_ns)) &&
+         !ck_pr_cas_64(&b->max_ns, max, lat_ns))
+    ;
+}
+
+
+/* Format a dirty data size bucket, e.g. "<= 64KiB" */
+
+static const char *file_wb_bucket_name(unsigned int i, char *buf, size_t size)
+{
+  char str[16];
+
+  if (i == 0)
+    snprintf(buf, size, "0");
+  else if (i == FILE_WB_NBUCKETS - 1)
+    snprintf(buf, size, "> %sB",
+             sb_print_value_size(str, sizeof(str), file_wb_bucket_max[i - 1]));
+  else
+    snprintf(buf, size, "<= %sB",
+             sb_print_value_size(str, sizeof(str), file_wb_bucket_max[i]));
+
+  return buf;
+}
+
+
+/*
+  Print writeback statistics since the previous intermediate report, or since
+  the previous cumulative report with fsync latency by dirty data
+*/
+
+void file_writeback_report(sb_stat_t *stat, bool cumulative)
+{
+  file_wb_sample_t       cur;
+  file_wb_sample_t *const last = cumulative ? &file_wb_cumul : &file_wb_interm;
+
+  if (file_writeback_sample(&cur))
+    return;
+
+  const uint64_t kb[2] = { cur.dirty_kb, cur.writeback_kb };
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    file_wb_sum_kb[i] += kb[i];
+    file_wb_max_kb[i] = SB_MAX(file_wb_max_kb[i], kb[i]);
+  }
+  file_wb_nsamples++;
+
+  const double   wall_us = (cur.time_ns - last->time_ns) / 1000.0;
+  const double   psi_some = wall_us > 0 ?
+    (cur.psi_some_us - last->psi_some_us) * 100 / wall_us : 0;
+  const double   psi_full = wall_us > 0 ?
+    (cur.psi_full_us - last->psi_full_us) * 100 / wall_us : 0;
+  const uint64_t stalls = ck_pr_load_64(&file_wb_stalls);
+  const uint64_t stall_ns = ck_pr_load_64(&file_wb_stall_ns);
+
+  *last = cur;
+
+  if (!cumulative)
+  {
+    char psi[64] = "";
+
+    if (file_wb_psi)
+      snprintf(psi, sizeof(psi), " io stall: %.1f%%/%.1f%%", psi_some,
+               psi_full);
+
+    log_timestamp(LOG_NOTICE, stat->time_total,
+                  "writeback: dirty: %.2f MiB writeback: %.2f MiB%s "
+                  "stalled writes: %" PRIu64 " (%.2f ms)",
+                  cur.dirty_kb / 1024.0, cur.writeback_kb / 1024.0, psi,
+                  stalls - file_wb_stalls_interm[0],
+                  NS2MS(stall_ns - file_wb_stalls_interm[1]));
+
+    file_wb_stalls_interm[0] = stalls;
+    file_wb_stalls_interm[1] = stall_ns;
+
+    return;
+  }
+
+  log_text(LOG_NOTICE, "Writeback:");
+  log_text(LOG_NOTICE, "         %-32s%.2f/%.2f", "dirty avg/max (MiB):",
+           file_wb_sum_kb[0] / 1024.0 / file_wb_nsamples,
+           file_wb_max_kb[0] / 1024.0);
+  log_text(LOG_NOTICE, "         %-32s%.2f/%.2f", "writeback avg/max (MiB):",
+           file_wb_sum_kb[1] / 1024.0 / file_wb_nsamples,
+           file_wb_max_kb[1] / 1024.0);
+
+  if (file_wb_psi)
+    log_text(LOG_NOTICE, "         %-32s%.2f%%/%.2f%%",
+             "io stall some/full (PSI):", psi_some, psi_full);
+  else
+    log_text(LOG_NOTICE, "         %-32sN/A", "io stall some/full (PSI):");
+
+  log_text(LOG_NOTICE, "         %-32s%" PRIu64 " (%.2f ms)",
+           "stalled writes (>= 1 ms):", stalls - file_wb_stalls_cumul[0],
+           NS2MS(stall_ns - file_wb_stalls_cumul[1]));
+  log_text(LOG_NOTICE, "");
+
+  file_wb_stalls_cumul[0] = stalls;
+  file_wb_stalls_cumul[1] = stall_ns;
+  file_wb_nsamples = 0;
+  file_wb_sum_kb[0] = file_wb_sum_kb[1] = 0;
+  file_wb_max_kb[0] = file_wb_max_kb[1] = 0;
+
+  uint64_t total = 0;
+
+  for (unsigned int i = 0; i < FILE_WB_NBUCKETS; i++)
+    total += ck_pr_load_64(&file_wb_buckets[i].fsyncs);
+
+  if (total == 0)
+    return;
+
+  log_text(LOG_NOTICE, "fsync latency by dirty data flushed:");
+  log_text(LOG_NOTICE, "         %-16s %10s %12s %12s", "dirty data", "fsyncs",
+           "avg (ms)", "max (ms)");
+
+  for (unsigned int i = 0; i < FILE_WB_NBUCKETS; i++)
+  {
+    file_wb_bucket_t *b = &file_wb_buckets[i];
+    const uint64_t   n = ck_pr_fas_64(&b->fsyncs, 0);
+    const uint64_t   lat_ns = ck_pr_fas_64(&b->lat_ns, 0);
+    const uint64_t   max_ns = ck_pr_fas_64(&b->max_ns, 0);
+    char             name[32];
+
+    if (n == 0)
+      continue;
+
+    log_text(LOG_NOTICE, "         %-16s %10" PRIu64 " %12.3f %12.3f",
+             file_wb_bucket_name(i, name, sizeof(name)), n,
+             NS2MS(lat_ns) / n, NS2MS(max_ns));
+  }
+
+  log_text(LOG_NOTICE, "");
+}
+
+
+void file_writeback_done(void)
+{
+  free(file_wb_dirty);
+  file_wb_dirty = NULL;
+}
+
+
+/* Print intermediate test statistics. */
+
+void file_report_intermediate(sb_stat_t *stat)
+{
+  const double seconds = stat->time_interval;
+
+  log_timestamp(LOG_NOTICE, stat->time_total,
+                "reads: %4.2f MiB/s writes: %4.2f MiB/s fsyncs: %4.2f/s "
+                "%s",
+                stat->bytes_read / mebibyte / seconds,
+                stat->bytes_written / mebibyte / seconds,
+                stat->other / seconds,
+                create_pct_string_intermediate(sb_globals.percentiles, stat->latency_pcts, sb_globals.npercentiles)
+                );
+
+  /* Per-operation percentiles on a separate line */
+  char   buf[512];
+  size_t len = 0;
+
+  buf[0] = '\0';
+
+  for (int op = FILE_OP_TYPE_READ; op <= FILE_OP_TYPE_DISCARD; op++)
+  {
+    if (!file_op_latency[op] || len >= sizeof(buf))
+      continue;
+
+    double *pcts = sb_histogram_get_pct_intermediate(&file_op_histograms[op],
+                                                     sb_globals.percentiles,
+                                                     sb_globals.npercentiles);
+    char   *str = create_pct_string_intermediate(sb_globals.percentiles, pcts,
+                                                 sb_globals.npercentiles);
+
+    /* Each percentile string already ends with a space */
+    len += snprintf(buf + len, sizeof(buf) - len, "%s: %s",
+                    get_op_latency_str(op), str);
+
+    free(str);
+    free(pcts);
+  }
+
+  if (len > 0)
+    log_timestamp(LOG_NOTICE, stat->time_total, "%s", buf);
+
+  if (file_diskstats)
+    file_diskstats_report(&file_disk_interm, stat, false);
+
+  if (file_writeback)
+    file_writeback_report(stat, false);
+
+  if (file_nsize_classes == 0)
+    return;
+
+  /* One more line per size class with --file-block-sizes */
+  file_class_stats_t cls[FILE_MAX_SIZE_CLASSES];
+
+  file_size_classes_sum(cls);
+
+  for (unsigned int i = 0; i < file_nsize_classes; i++)
+  {
+    char sizestr[16];
+    char *str = NULL;
+
+    if (file_class_latency)
+    {
+      double *pcts =
+        sb_histogram_get_pct_intermediate(&file_class_histograms[i],
+                                          sb_globals.percentiles,
+                                          sb_globals.npercentiles);
+      str = create_pct_string_intermediate(sb_globals.percentiles, pcts,
+                                           sb_globals.npercentiles);
+      free(pcts);
+    }
 
-  log_timestamp(LOG_NOTICE, stat->time_total,
-                "reads: %4.2f MiB/s writes: %4.2f MiB/s fsyncs: %4.2f/s "
-                "%s",
-                stat->bytes_read / mebibyte / seconds,
-                stat->bytes_written / mebibyte / seconds,
-                stat->other / seconds,
-                create_pct_string_intermediate(sb_globals.percentiles, stat->latency_pcts, sb_globals.npercentiles)
-                );
+    log_timestamp(LOG_NOTICE, stat->time_total,
+                  "%sB: reads: %4.2f MiB/s writes: %4.2f MiB/s %s",
+                  sb_print_value_size(sizestr, sizeof(sizestr),
+                                      file_size_classes[i].size),
+                  (cls[i].bytes[0] - file_class_interm[i].bytes[0]) /
+                  mebibyte / seconds,
+                  (cls[i].bytes[1] - file_class_interm[i].bytes[1]) /
+                  mebibyte / seconds,
+                  str != NULL ? str : "");
+    free(str);
+
+    file_class_interm[i] = cls[i];
+  }
 }
 
 /* Print cumulative test statistics. */
@@ -764,6 +3006,26 @@ void file_report_cumulative(sb_stat_t *stat)
            stat->other / seconds
            );
 
+  if (file_discard_ratio > 0)
+  {
+    uint64_t discards = 0, bytes = 0;
+
+    for (unsigned int i = 0; i < sb_globals.threads; i++)
+    {
+      discards += ck_pr_load_64(&per_thread[i].discards);
+      bytes += ck_pr_load_64(&per_thread[i].bytes_discarded);
+    }
+
+    log_text(LOG_NOTICE,
+             "         discard: IOPS=%4.2f %4.2f MiB/s (%4.2f MB/s)",
+             (discards - file_discard_cumul[0]) / seconds,
+             (bytes - file_discard_cumul[1]) / mebibyte / seconds,
+             (bytes - file_discard_cumul[1]) / megabyte / seconds);
+
+    file_discard_cumul[0] = discards;
+    file_discard_cumul[1] = bytes;
+  }
+
   log_text(LOG_NOTICE, "");
 
   log_text(LOG_NOTICE, "Latency (ms):");
@@ -782,6 +3044,165 @@ void file_report_cumulative(sb_stat_t *stat)
   log_text(LOG_NOTICE, "         sum:                            %10.2f",
            SEC2MS(stat->latency_sum));
   log_text(LOG_NOTICE, "");
+
+  for (int op = FILE_OP_TYPE_READ; op <= FILE_OP_TYPE_DISCARD; op++)
+  {
+    if (!file_op_latency[op])
+      continue;
+
+    double *pcts = sb_histogram_get_pct_checkpoint(&file_op_histograms[op],
+                                                   sb_globals.percentiles,
+                                                   sb_globals.npercentiles);
+    char   *str = create_pct_string_cumulative(sb_globals.percentiles, pcts,
+                                               sb_globals.npercentiles);
+
+    log_text(LOG_NOTICE, "Latency of %s requests (ms):",
+             get_op_latency_str(op));
+    log_text(LOG_NOTICE, "%s", str);
+
+    free(str);
+    free(pcts);
+  }
+
+  if (file_diskstats)
+    file_diskstats_report(&file_disk_cumul, stat, true);
+
+  if (file_writeback)
+    file_writeback_report(stat, true);
+
+  if (file_cache_stats)
+  {
+    uint64_t reads = 0, hits = 0;
+
+    for (unsigned int i = 0; i < sb_globals.threads; i++)
+    {
+      reads += ck_pr_load_64(&per_thread[i].cache_reads);
+      hits += ck_pr_load_64(&per_thread[i].cache_hits);
+    }
+
+    const uint64_t nreads = reads - file_cache_cumul[0];
+    const uint64_t nhits = hits - file_cache_cumul[1];
+
+    log_text(LOG_NOTICE, "Page cache hit ratio: %.2f%% of %" PRIu64
+             " sampled reads", nreads > 0 ? nhits * 100.0 / nreads : 0.0,
+             nreads);
+    log_text(LOG_NOTICE, "");
+
+    file_cache_cumul[0] = reads;
+    file_cache_cumul[1] = hits;
+  }
+
+  if (file_seq_streams > 1)
+    file_streams_report(seconds);
+
+  if (file_ngroups > 1 || file_njobs > 0)
+  {
+    file_group_stats_t grp[file_ngroups];
+
+    file_groups_sum(grp);
+
+    log_text(LOG_NOTICE, "Throughput by %s:",
+             file_njobs > 0 ? "job" : "file group");
+    for (unsigned int i = 0; i < file_ngroups; i++)
+    {
+      const file_group_t       *g = &file_groups[i];
+      const file_group_stats_t *c = &file_group_cumul[i];
+      char                     name[64];
+
+      if (g->job != NULL)
+        snprintf(name, sizeof(name), "%s", g->job->name);
+      else
+        snprintf(name, sizeof(name), "files %u-%u", g->first_file,
+                 g->first_file + g->nfiles - 1);
+
+      log_text(LOG_NOTICE, "    %s: read: IOPS=%4.2f %4.2f MiB/s "
+               "write: IOPS=%4.2f %4.2f MiB/s fsync: IOPS=%4.2f", name,
+               (grp[i].reads - c->reads) / seconds,
+               (grp[i].bytes_read - c->bytes_read) / mebibyte / seconds,
+               (grp[i].writes - c->writes) / seconds,
+               (grp[i].bytes_written - c->bytes_written) / mebibyte / seconds,
+               (grp[i].fsyncs - c->fsyncs) / seconds);
+
+      file_group_cumul[i] = grp[i];
+    }
+    log_text(LOG_NOTICE, "");
+  }
+
+  for (unsigned int i = 0; i < file_njobs; i++)
+  {
+    const file_group_t * const g = &file_groups[i];
+
+    for (int op = FILE_OP_TYPE_READ; op <= FILE_OP_TYPE_DISCARD; op++)
+    {
+      /* Skip operations the job does not issue */
+      if (!file_op_latency[op] ||
+          (op == FILE_OP_TYPE_READ ? !file_mode_reads(g->mode) :
+           op == FILE_OP_TYPE_DISCARD ? !file_mode_discards(g->mode) :
+           !file_mode_writes(g->mode)))
+        continue;
+
+      double *pcts = sb_histogram_get_pct_checkpoint(&g->hist[op],
+                                                     sb_globals.percentiles,
+                                                     sb_globals.npercentiles);
+      char   *str = create_pct_string_cumulative(sb_globals.percentiles, pcts,
+                                                 sb_globals.npercentiles);
+
+      log_text(LOG_NOTICE, "Latency of %s %s requests (ms):", g->job->name,
+               get_op_latency_str(op));
+      log_text(LOG_NOTICE, "%s", str);
+
+      free(str);
+      free(pcts);
+    }
+  }
+
+  if (file_nsize_classes == 0)
+    return;
+
+  file_class_stats_t cls[FILE_MAX_SIZE_CLASSES];
+  char               sizestr[16];
+
+  file_size_classes_sum(cls);
+
+  log_text(LOG_NOTICE, "Throughput by block size:");
+  for (unsigned int i = 0; i < file_nsize_classes; i++)
+  {
+    const uint64_t reads = cls[i].ops[0] - file_class_cumul[i].ops[0];
+    const uint64_t writes = cls[i].ops[1] - file_class_cumul[i].ops[1];
+    const uint64_t bytes_read = cls[i].bytes[0] - file_class_cumul[i].bytes[0];
+    const uint64_t bytes_written =
+      cls[i].bytes[1] - file_class_cumul[i].bytes[1];
+
+    log_text(LOG_NOTICE, "    %8sB: read: IOPS=%4.2f %4.2f MiB/s "
+             "write: IOPS=%4.2f %4.2f MiB/s",
+             sb_print_value_size(sizestr, sizeof(sizestr),
+                                 file_size_classes[i].size),
+             reads / seconds, bytes_read / mebibyte / seconds,
+             writes / seconds, bytes_written / mebibyte / seconds);
+
+    file_class_cumul[i] = cls[i];
+  }
+  log_text(LOG_NOTICE, "");
+
+  if (!file_class_latency)
+    return;
+
+  for (unsigned int i = 0; i < file_nsize_classes; i++)
+  {
+    double *pcts = sb_histogram_get_pct_checkpoint(&file_class_histograms[i],
+                                                   sb_globals.percentiles,
+                                                   sb_globals.npercentiles);
+    char   *str = create_pct_string_cumulative(sb_globals.percentiles, pcts,
+                                               sb_globals.npercentiles);
+
+    log_text(LOG_NOTICE, "Latency of %sB requests (ms):",
+             sb_print_value_size(sizestr, sizeof(sizestr),
+                                 file_size_classes[i].size));
+    log_text(LOG_NOTICE, "%s", str);
+
+    free(str);
+    free(pcts);
+  }
 }
 
 /* Return name for I/O mode */
@@ -799,6 +3220,35 @@ const char *get_io_mode_str(file_io_mode_t mode)
 #else
       return "fast mmaped";
 #endif
+    case FILE_IO_MODE_URING:
+      return "io_uring";
+    default:
+      break;
+  }
+
+  return "(unknown)";
+}
+
+
+/* Return operation name for latency reports */
+
+const char *get_op_latency_str(sb_file_op_t op)
+{
+  switch (op) {
+    case FILE_OP_TYPE_READ:
+      return "read";
+    case FILE_OP_TYPE_WRITE:
+      return "write";
+    case FILE_OP_TYPE_FSYNC:
+#if defined(HAVE_MMAP) && SIZEOF_SIZE_T != 4
+      if (file_io_mode == FILE_IO_MODE_MMAP && file_mmap_window == 0)
+        return "msync";
+#endif
+      return file_fsync_mode == FSYNC_DATA ? "fdatasync" : "fsync";
+    case FILE_OP_TYPE_DISCARD:
+      if (file_discard_mode == FILE_DISCARD_PUNCH)
+        return "punch hole";
+      return file_discard_mode == FILE_DISCARD_ZERO ? "zero range" : "discard";
     default:
       break;
   }
@@ -836,134 +3286,410 @@ const char *get_test_mode_str(file_test_mode_t mode)
 
 
 /*
-  Converts the argument of --file-extra-flags to platform-specific open() flags.
-  Returns 1 on error, 0 on success.
+  Converts the argument of --file-extra-flags to platform-specific open() flags.
+  Returns 1 on error, 0 on success.
+*/
+
+static int convert_extra_flags(file_flags_t extra_flags, int *open_flags)
+{
+  if (extra_flags)
+  {
+    *open_flags = 0;
+
+    if (extra_flags & SB_FILE_FLAG_SYNC)
+    {
+      *open_flags |= O_SYNC;
+    }
+
+    if (extra_flags & SB_FILE_FLAG_DSYNC)
+    {
+#ifdef O_DSYNC
+      *open_flags |= O_DSYNC;
+#else
+      log_text(LOG_FATAL,
+               "--file-extra-flags=dsync is not supported on this platform.");
+      return 1;
+#endif
+    }
+
+    if (extra_flags & SB_FILE_FLAG_DIRECTIO)
+    {
+#ifdef HAVE_DIRECTIO
+      /* Will call directio(3) later */
+#elif defined(O_DIRECT)
+      *open_flags |= O_DIRECT;
+#else
+      log_text(LOG_FATAL,
+               "--file-extra-flags=direct is not supported on this platform.");
+      return 1;
+#endif
+    }
+
+    if (extra_flags > SB_FILE_FLAG_DIRECTIO)
+    {
+      log_text(LOG_FATAL, "Unknown extra flags value: %d", (int) extra_flags);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Create files of necessary size for test */
+
+/*
+  Create or extend test file number id. buf is only used in the 'write'
+  prepare mode and must be a multiple of the block size.
+*/
+
+static int create_file(unsigned int id, unsigned char *buf, size_t buf_size)
+{
+  int                fd;
+  char               file_name[512];
+  long long          offset;
+  int                rc = 0;
+
+  if (file_device != NULL)
+  {
+    fd = open(file_device, O_WRONLY | prepare_flags);
+    if (fd < 0)
+    {
+      log_errno(LOG_FATAL, "Can't open device '%s'", file_device);
+      return 1;
+    }
+
+    offset = 0;
+    log_text(LOG_NOTICE, "Writing region %u of %s", id, file_device);
+  }
+  else
+  {
+    snprintf(file_name, sizeof(file_name), "test_file.%d", id);
+
+    fd = open(file_name, O_CREAT | O_WRONLY | prepare_flags,
+              S_IRUSR | S_IWUSR);
+    if (fd < 0)
+    {
+      log_errno(LOG_FATAL, "Can't open file");
+      return 1;
+    }
+
+    offset = (long long) lseek(fd, 0, SEEK_END);
+
+    if (offset >= file_size)
+      log_text(LOG_NOTICE, "Reusing existing file %s", file_name);
+    else if (offset > 0)
+      log_text(LOG_NOTICE, "Extending existing file %s", file_name);
+    else
+      log_text(LOG_NOTICE, "Creating file %s", file_name);
+  }
+
+  switch (file_prepare_mode) {
+  case FILE_PREPARE_WRITE:
+    while (offset < file_size)
+    {
+      /* Write whole blocks, the last one may extend past file_size */
+      const long long left = (file_size - offset + file_block_size - 1) /
+        file_block_size * file_block_size;
+      const size_t    len = (size_t) SB_MIN((long long) buf_size, left);
+
+      /* If in validation mode, fill each block with random values and
+         write its header */
+      if (sb_globals.validate)
+        file_fill_buffer(buf, len, id, offset);
+
+      if (pwrite(fd, buf, len, file_base(id) + offset) != (ssize_t) len)
+        goto error;
+
+      offset += len;
+      ck_pr_add_64(&prepare_written, len);
+    }
+    break;
+
+  case FILE_PREPARE_FALLOCATE:
+#ifdef HAVE_POSIX_FALLOCATE
+    if (offset < file_size &&
+        (rc = posix_fallocate(fd, offset, file_size - offset)) != 0)
+    {
+      errno = rc;
+      goto error;
+    }
+#endif
+    break;
+
+  case FILE_PREPARE_SPARSE:
+    if (offset < file_size && ftruncate(fd, file_size))
+      goto error;
+    break;
+  }
+
+  /* fsync files to prevent cache flush from affecting test results */
+  fsync(fd);
+  close(fd);
+
+  return 0;
+
+ error:
+  log_errno(LOG_FATAL, "Failed to write file!");
+  close(fd);
+  return 1;
+}
+
+
+/* Create test files until there are none left, or another thread fails */
+
+static int prepare_files(void)
+{
+  unsigned char *buf = NULL;
+  size_t        buf_size = 0;
+  unsigned int  id;
+  int           rc = 0;
+
+  if (file_prepare_mode == FILE_PREPARE_WRITE)
+  {
+    /* Use large writes, aligned for O_DIRECT */
+    buf_size = SB_MAX(FILE_PREPARE_BUFFER_SIZE / file_block_size, 1) *
+      file_block_size;
+    buf = sb_memalign(buf_size, sb_getpagesize());
+    if (buf == NULL)
+    {
+      log_text(LOG_FATAL, "Failed to allocate a memory buffer");
+      return 1;
+    }
+    memset(buf, 0, buf_size);
+  }
+
+  while (!ck_pr_load_int(&prepare_failed) &&
+         (id = ck_pr_faa_uint(&prepare_next_file, 1)) < num_files)
+  {
+    if (create_file(id, buf, buf_size))
+    {
+      ck_pr_store_int(&prepare_failed, 1);
+      rc = 1;
+      break;
+    }
+  }
+
+  if (buf != NULL)
+    sb_free_memaligned(buf);
+
+  return rc;
+}
+
+
+static void *prepare_worker(void *arg)
+{
+  sb_thread_ctxt_t *ctxt = (sb_thread_ctxt_t *) arg;
+
+  sb_tls_thread_id = ctxt->id;
+
+  /* Initialize thread-local RNG state for validation data */
+  sb_rand_thread_init();
+
+  prepare_files();
+
+  return NULL;
+}
+
+
+int create_files(void)
+{
+  sb_timer_t         t;
+  double             seconds;
+
+  log_text(LOG_NOTICE, "%d files, %ldKb each, %ldMb total", num_files,
+           (long)(file_size / 1024),
+           (long)((file_size * num_files) / (1024 * 1024)));
+  log_text(LOG_NOTICE, "Creating files for the test...");
+  print_file_extra_flags();
+
+  if (convert_extra_flags(file_extra_flags, &prepare_flags))
+    return 1;
+
+  if (file_prepare_mode != FILE_PREPARE_WRITE && sb_globals.validate)
+  {
+    log_text(LOG_FATAL, "--validate requires --file-prepare-mode=write");
+    return 1;
+  }
+
+  prepare_next_file = 0;
+  prepare_written = 0;
+  prepare_failed = 0;
+
+  sb_timer_init(&t);
+  sb_timer_start(&t);
+
+  /* With --threads > 1, each thread creates files until none are left */
+  if (sb_globals.threads > 1 && num_files > 1)
+  {
+    if (sb_thread_create_workers(prepare_worker) || sb_thread_join_workers())
+      return 1;
+  }
+  else
+    prepare_files();
+
+  if (prepare_failed)
+    return 1;
+
+  seconds = NS2SEC(sb_timer_stop(&t));
+
+  if (prepare_written > 0)
+    log_text(LOG_NOTICE, "%llu bytes written in %.2f seconds (%.2f MiB/sec).",
+             (unsigned long long) prepare_written, seconds,
+             (double) (prepare_written / mebibyte) / seconds);
+  else
+    log_text(LOG_NOTICE, "No bytes written.");
+
+  return 0;
+}
+
+
+/*
+  Do preconditioning writes until all are done, or another thread fails.
+  Sequential passes are split into large chunks taken by threads in order, so
+  each file is written mostly sequentially. Random passes consist of
+  block-sized writes to uniformly distributed blocks.
 */
 
-static int convert_extra_flags(file_flags_t extra_flags, int *open_flags)
+static int precondition_thread(void)
 {
-  if (extra_flags)
+  const size_t   buf_size = SB_MAX(FILE_PREPARE_BUFFER_SIZE / file_block_size,
+                                   1) * file_block_size;
+  const uint64_t chunks_per_file = (file_size + buf_size - 1) / buf_size;
+  const uint64_t seq_units = (uint64_t) file_precondition * chunks_per_file *
+    num_files;
+  const uint64_t total_units = seq_units +
+    (uint64_t) file_precondition * file_nblocks;
+  unsigned char  *buf;
+  uint64_t       unit;
+  int            rc = 0;
+
+  buf = sb_memalign(buf_size, sb_getpagesize());
+  if (buf == NULL)
   {
-    *open_flags = 0;
+    log_text(LOG_FATAL, "Failed to allocate a memory buffer");
+    return 1;
+  }
 
-    if (extra_flags & SB_FILE_FLAG_SYNC)
-    {
-      *open_flags |= O_SYNC;
-    }
+  /* Random data, so that compressing or deduplicating drives can't cheat */
+  for (size_t i = 0; i < buf_size; i += sizeof(uint64_t))
+  {
+    const uint64_t r = sb_rand_uniform_uint64();
 
-    if (extra_flags & SB_FILE_FLAG_DSYNC)
+    memcpy(buf + i, &r, SB_MIN(sizeof(r), buf_size - i));
+  }
+
+  while (!ck_pr_load_int(&precond_failed) &&
+         (unit = ck_pr_faa_64(&precond_next, 1)) < total_units)
+  {
+    unsigned int id;
+    long long    pos;
+    size_t       len;
+
+    if (unit < seq_units)
     {
-#ifdef O_DSYNC
-      *open_flags |= O_DSYNC;
-#else
-      log_text(LOG_FATAL,
-               "--file-extra-flags=dsync is not supported on this platform.");
-      return 1;
-#endif
+      const uint64_t chunk = unit % (chunks_per_file * num_files);
+
+      id = chunk / chunks_per_file;
+      pos = (chunk % chunks_per_file) * buf_size;
+      /* Whole blocks, as in 'prepare' */
+      len = SB_MIN(buf_size, (size_t) ((file_size - pos + file_block_size -
+                                        1) / file_block_size *
+                                       file_block_size));
     }
-
-    if (extra_flags & SB_FILE_FLAG_DIRECTIO)
+    else
     {
-#ifdef HAVE_DIRECTIO
-      /* Will call directio(3) later */
-#elif defined(O_DIRECT)
-      *open_flags |= O_DIRECT;
-#else
-      log_text(LOG_FATAL,
-               "--file-extra-flags=direct is not supported on this platform.");
-      return 1;
-#endif
+      const long long off = (long long) (sb_rand_uniform_double() *
+                                         file_nblocks) * file_block_size;
+
+      id = off / file_size;
+      pos = off % file_size;
+      pos -= pos % file_block_size;
+      len = (size_t) SB_MIN(file_block_size, file_size - pos);
     }
 
-    if (extra_flags > SB_FILE_FLAG_DIRECTIO)
+    if (pwrite(files[id], buf, len, file_base(id) + pos) != (ssize_t) len)
     {
-      log_text(LOG_FATAL, "Unknown extra flags value: %d", (int) extra_flags);
-      return 1;
+      log_errno(LOG_FATAL, "Failed to write file! file: %u pos: %lld", id,
+                pos);
+      ck_pr_store_int(&precond_failed, 1);
+      rc = 1;
+      break;
     }
+
+    ck_pr_add_64(&precond_written, len);
   }
 
-  return 0;
+  sb_free_memaligned(buf);
+
+  return rc;
 }
 
-/* Create files of necessary size for test */
 
-int create_files(void)
+static void *precondition_worker(void *arg)
 {
-  unsigned int       i;
-  int                fd;
-  char               file_name[512];
-  long long          offset;
-  long long          written = 0;
-  sb_timer_t         t;
-  double             seconds;
-  int                flags = 0;
+  sb_thread_ctxt_t *ctxt = (sb_thread_ctxt_t *) arg;
 
-  log_text(LOG_NOTICE, "%d files, %ldKb each, %ldMb total", num_files,
-           (long)(file_size / 1024),
-           (long)((file_size * num_files) / (1024 * 1024)));
-  log_text(LOG_NOTICE, "Creating files for the test...");
-  print_file_extra_flags();
+  sb_tls_thread_id = ctxt->id;
 
-  if (convert_extra_flags(file_extra_flags, &flags))
-    return 1;
+  sb_rand_thread_init();
+
+  precondition_thread();
+
+  return NULL;
+}
+
+
+/* Precondition test files with --threads threads before the benchmark */
+
+int precondition_files(void)
+{
+  sb_timer_t      t;
+  double          seconds;
+  struct timespec ts;
+
+  log_text(LOG_NOTICE, "Preconditioning: writing the file set %u time(s) "
+           "sequentially, then %u time(s) randomly...", file_precondition,
+           file_precondition);
+
+  precond_next = 0;
+  precond_written = 0;
+  precond_failed = 0;
 
   sb_timer_init(&t);
   sb_timer_start(&t);
 
-  for (i=0; i < num_files; i++)
+  if (sb_globals.threads > 1)
   {
-    snprintf(file_name, sizeof(file_name), "test_file.%d",i);
-
-    fd = open(file_name, O_CREAT | O_WRONLY | flags, S_IRUSR | S_IWUSR);
-    if (fd < 0)
-    {
-      log_errno(LOG_FATAL, "Can't open file");
-      return 1; 
-    }
-
-    offset = (long long) lseek(fd, 0, SEEK_END);
+    if (sb_thread_create_workers(precondition_worker) ||
+        sb_thread_join_workers())
+      return 1;
+  }
+  else
+    precondition_thread();
 
-    if (offset >= file_size)
-      log_text(LOG_NOTICE, "Reusing existing file %s", file_name);
-    else if (offset > 0)
-      log_text(LOG_NOTICE, "Extending existing file %s", file_name);
-    else
-      log_text(LOG_NOTICE, "Creating file %s", file_name);
+  if (precond_failed)
+    return 1;
 
-    for (; offset < file_size;
-         written += file_block_size, offset += file_block_size)
+  for (unsigned int i = 0; i < num_files; i++)
+  {
+    if (fsync(files[i]))
     {
-      /*
-        If in validation mode, fill buffer with random values
-        and write checksum. Not called in parallel, so use per_thread[0].
-      */
-      if (sb_globals.validate)
-        file_fill_buffer(per_thread[0].buffer, file_block_size, offset);
-                         
-      if (write(fd, per_thread[0].buffer, file_block_size) < 0)
-        goto error;
+      log_errno(LOG_FATAL, "fsync() failed on test file %u", i);
+      return 1;
     }
-    
-    /* fsync files to prevent cache flush from affecting test results */
-    fsync(fd);
-    close(fd);
   }
 
   seconds = NS2SEC(sb_timer_stop(&t));
 
-  if (written > 0)
-    log_text(LOG_NOTICE, "%llu bytes written in %.2f seconds (%.2f MiB/sec).",
-             written, seconds,
-             (double) (written / mebibyte) / seconds);
-  else
-    log_text(LOG_NOTICE, "No bytes written.");
+  log_text(LOG_NOTICE, "%llu bytes written in %.2f seconds (%.2f MiB/sec).\n",
+           (unsigned long long) precond_written, seconds,
+           (double) (precond_written / mebibyte) / seconds);
 
-  return 0;
+  /* A moving hot spot starts with the benchmark */
+  SB_GETTIME(&ts);
+  file_start_ns = SEC2NS(ts.tv_sec) + ts.tv_nsec;
 
- error:
-  log_errno(LOG_FATAL, "Failed to write file!");
-  close(fd);
-  return 1;
+  return 0;
 }
 
 
@@ -975,6 +3701,12 @@ int remove_files(void)
   unsigned int i;
   char         file_name[512];
   
+  if (file_device != NULL)
+  {
+    log_text(LOG_NOTICE, "Leaving data on %s in place", file_device);
+    return 0;
+  }
+
   log_text(LOG_NOTICE, "Removing test files...");
   
   for (i = 0; i < num_files; i++)
@@ -1002,6 +3734,14 @@ int file_cmd_prepare(void)
   if (test_mode == MODE_WRITE)
     return remove_files();
 
+  if (file_device != NULL && file_prepare_mode != FILE_PREPARE_WRITE)
+  {
+    log_text(LOG_NOTICE, "Nothing to prepare on %s with "
+             "--file-prepare-mode=%s", file_device,
+             sb_get_value_string("file-prepare-mode"));
+    return 0;
+  }
+
   return create_files();
 }
 
@@ -1009,53 +3749,302 @@ int file_cmd_prepare(void)
 /* 'cleanup' command for fileio test */
 
 
-int file_cmd_cleanup(void)
-{
-  if (parse_arguments())
-    return 1;
+int file_cmd_cleanup(void)
+{
+  if (parse_arguments())
+    return 1;
+
+  return remove_files();
+}
+
+void init_vars(void)
+{
+  for (unsigned int i = 0; i < file_ngroups; i++)
+  {
+    file_group_t * const g = &file_groups[i];
+
+    g->fsynced_file = g->first_file; /* for counting file to be fsynced */
+    g->req_performed = 0;
+    g->is_dirty = 0;
+
+    for (unsigned int k = 0; k < file_seq_streams; k++)
+    {
+      file_stream_t * const s = &g->streams[k];
+
+      s->offset = s->start;
+      s->prev_req.size = 0;
+      s->prev_req.operation = FILE_OP_TYPE_NULL;
+      s->prev_req.file_id = 0;
+      s->prev_req.pos = 0;
+    }
+  }
+}
+
+int file_thread_init(int thread_id)
+{
+  memset(per_thread[thread_id].buffer, 0, file_request_size);
+
+  return 0;
+}
+
+
+/*
+  Before the benchmark is stopped, issue fsync() if --file-fsync-end is used,
+  and wait for all async operations to complete.
+*/
+
+int file_thread_done(int thread_id)
+{
+  const file_group_t * const g = &file_groups[file_thread_groups[thread_id]];
+
+  if (file_fsync_end && g->mode != MODE_READ && g->mode != MODE_RND_READ)
+  {
+    for (unsigned i = g->first_file; i < g->first_file + g->nfiles; i++)
+    {
+      if(file_fsync(i, thread_id))
+        return 1;
+    }
+  }
+
+#ifdef HAVE_LIBAIO
+  if (file_io_mode == FILE_IO_MODE_ASYNC)
+    return file_async_drain(thread_id);
+#endif
+
+#ifdef HAVE_LIBURING
+  if (file_io_mode == FILE_IO_MODE_URING)
+    return file_uring_drain(thread_id);
+#endif
+
+  return 0;
+}
+
+#ifdef SB_FILE_ASYNC
+/* Parse completion reaping options */
+
+
+int file_reaper_init(void)
+{
+  const int n = sb_get_value_int("file-async-reaper");
+
+  if (n < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value of file-async-reaper: %d", n);
+    return 1;
+  }
+
+  file_async_reaper = (unsigned int) n;
+  file_async_poll = sb_get_value_flag("file-async-poll");
+  file_nreapers = 0;
+
+  if (file_io_mode != FILE_IO_MODE_ASYNC && file_io_mode != FILE_IO_MODE_URING)
+  {
+    file_async_reaper = 0;
+    file_async_poll = 0;
+    return 0;
+  }
+
+#ifndef HAVE_SYS_EVENTFD_H
+  if (file_async_reaper > 0 && !file_async_poll)
+  {
+    log_text(LOG_FATAL, "--file-async-reaper requires --file-async-poll on "
+             "this platform");
+    return 1;
+  }
+#endif
+
+  if (file_io_mode == FILE_IO_MODE_URING && file_async_poll &&
+      !(file_extra_flags & SB_FILE_FLAG_DIRECTIO))
+  {
+    log_text(LOG_FATAL, "--file-async-poll with --file-io-mode=uring "
+             "requires --file-extra-flags=direct");
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+  Process available completions of a worker without blocking. Returns the
+  number of completions, or -1 on errors.
+*/
+
+static long file_reap_thread(int thread_id)
+{
+  switch (file_io_mode) {
+#ifdef HAVE_LIBAIO
+  case FILE_IO_MODE_ASYNC:
+    {
+      struct timespec zero = {0, 0};
+
+      return file_async_reap(thread_id, 0, &zero);
+    }
+#endif
+#ifdef HAVE_LIBURING
+  case FILE_IO_MODE_URING:
+    if (file_async_poll)
+    {
+      struct io_uring_cqe *cqe;
+
+      /* Entering the kernel is what polls the device with IOPOLL */
+      (void) io_uring_peek_cqe(&uring_ctxts[thread_id].ring, &cqe);
+    }
+
+    return file_uring_reap(thread_id);
+#endif
+  default:
+    return 0;
+  }
+}
+
+
+static void *file_reaper_proc(void *arg)
+{
+  file_reaper_t * const r = arg;
+
+  while (!ck_pr_load_int(&file_reapers_stop))
+  {
+#ifdef HAVE_SYS_EVENTFD_H
+    if (!file_async_poll)
+    {
+      struct pollfd pfd = { .fd = r->efd, .events = POLLIN };
+      eventfd_t     val;
+
+      /* The timeout is only a safety net, completions signal the eventfd */
+      if (poll(&pfd, 1, 100) > 0)
+        (void) eventfd_read(r->efd, &val);
+    }
+#endif
+
+    for (unsigned int t = r->first; t < r->last; t++)
+    {
+      if (file_reap_thread(t) < 0)
+      {
+        ck_pr_store_int(&file_reaper_failed, 1);
+        return NULL;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+
+/* Start reaper threads after all rings and contexts are set up */
+
+
+int file_reaper_start(void)
+{
+  unsigned int n;
+
+  if (file_async_reaper == 0)
+    return 0;
+
+  n = (sb_globals.threads + file_async_reaper - 1) / file_async_reaper;
+
+  file_reapers = calloc(n, sizeof(file_reaper_t));
+  if (file_reapers == NULL)
+  {
+    log_text(LOG_FATAL, "Failed to allocate completion reapers!");
+    return 1;
+  }
+
+  file_reapers_stop = 0;
+  file_reaper_failed = 0;
+
+  for (unsigned int i = 0; i < n; i++)
+  {
+    file_reaper_t * const r = &file_reapers[i];
+
+    r->first = i * file_async_reaper;
+    r->last = SB_MIN(r->first + file_async_reaper, sb_globals.threads);
+    r->efd = -1;
+
+#ifdef HAVE_SYS_EVENTFD_H
+    if (!file_async_poll)
+    {
+      if ((r->efd = eventfd(0, EFD_NONBLOCK)) < 0)
+      {
+        log_errno(LOG_FATAL, "eventfd() failed");
+        return 1;
+      }
+
+# ifdef HAVE_LIBURING
+      for (unsigned int t = r->first;
+           file_io_mode == FILE_IO_MODE_URING && t < r->last; t++)
+      {
+        const int rc = io_uring_register_eventfd(&uring_ctxts[t].ring, r->efd);
+
+        if (rc < 0)
+        {
+          log_text(LOG_FATAL, "io_uring_register_eventfd() failed: %s",
+                   strerror(-rc));
+          return 1;
+        }
+      }
+# endif
+    }
+#endif
+
+    if ((errno = pthread_create(&r->thread, NULL, file_reaper_proc, r)) != 0)
+    {
+      log_errno(LOG_FATAL, "pthread_create() for a completion reaper failed");
+      if (r->efd >= 0)
+        close(r->efd);
+      return 1;
+    }
+
+    file_nreapers = i + 1;
+  }
 
-  return remove_files();
+  return 0;
 }
 
-void init_vars(void)
+
+void file_reaper_stop(void)
 {
-  position = 0; /* position in file */
-  current_file = 0;
-  fsynced_file = 0; /* for counting file to be fsynced */
-  req_performed = 0;
-  is_dirty = 0;
-  if (sb_globals.validate)
+  ck_pr_store_int(&file_reapers_stop, 1);
+
+  for (unsigned int i = 0; i < file_nreapers; i++)
   {
-    prev_req.size = 0;
-    prev_req.operation = FILE_OP_TYPE_NULL;
-    prev_req.file_id = 0;
-    prev_req.pos = 0;
+#ifdef HAVE_SYS_EVENTFD_H
+    if (file_reapers[i].efd >= 0)
+      (void) eventfd_write(file_reapers[i].efd, 1);
+#endif
+    pthread_join(file_reapers[i].thread, NULL);
+
+    if (file_reapers[i].efd >= 0)
+      close(file_reapers[i].efd);
   }
+
+  free(file_reapers);
+  file_reapers = NULL;
+  file_nreapers = 0;
 }
 
+
 /*
-  Before the benchmark is stopped, issue fsync() if --file-fsync-end is used,
-  and wait for all async operations to complete.
+  Wait in a worker until its reaper brings the number of in-flight requests
+  below 'limit'. Returns 1 if the reaper failed.
 */
 
-int file_thread_done(int thread_id)
+int file_reaper_wait(unsigned int *nrequests, unsigned int limit)
 {
-  if (file_fsync_end && test_mode != MODE_READ && test_mode != MODE_RND_READ)
+  while (ck_pr_load_uint(nrequests) >= limit)
   {
-    for (unsigned i = 0; i < num_files; i++)
-    {
-      if(file_fsync(i, thread_id))
-        return 1;
-    }
-  }
+    if (ck_pr_load_int(&file_reaper_failed))
+      return 1;
 
-#ifdef HAVE_LIBAIO
-  if (file_io_mode == FILE_IO_MODE_ASYNC && aio_ctxts[thread_id].nrequests > 0)
-    return file_wait(thread_id, aio_ctxts[thread_id].nrequests);
-#endif
+    if (file_async_poll)
+      ck_pr_stall();
+    else
+      sched_yield();
+  }
 
-  return 0;
+  return ck_pr_load_int(&file_reaper_failed);
 }
+#endif /* SB_FILE_ASYNC */
 
 #ifdef HAVE_LIBAIO
 /* Allocate async contexts pool */
@@ -1068,7 +4057,8 @@ int file_async_init(void)
   if (file_io_mode != FILE_IO_MODE_ASYNC)
     return 0;
   
-  file_async_backlog = sb_get_value_int("file-async-backlog");
+  file_async_backlog = file_sweep_depth > 0 ? file_sweep_depth :
+    sb_get_value_int("file-async-backlog");
   if (file_async_backlog <= 0) {
     log_text(LOG_FATAL, "Invalid value of file-async-backlog: %d",
              file_async_backlog);
@@ -1141,15 +4131,28 @@ int file_submit_or_wait(struct iocb *iocb, sb_file_op_t type, ssize_t len,
   memcpy(&oper->iocb, iocb, sizeof(*iocb));
   oper->type = type;
   oper->len = len;
+  oper->size_class = per_thread[thread_id].size_class;
+  oper->start_ns = file_op_start(type);
   iocbp = &oper->iocb;
 
+#ifdef HAVE_SYS_EVENTFD_H
+  /* Wake up the reaper on completion */
+  if (file_nreapers > 0 && !file_async_poll)
+    io_set_eventfd(iocbp, file_reapers[thread_id / file_async_reaper].efd);
+#endif
+
   if (io_submit(aio_ctxts[thread_id].io_ctxt, 1, &iocbp) < 1)
   {
     log_errno(LOG_FATAL, "io_submit() failed!");
     return 1;
   }
   
-  aio_ctxts[thread_id].nrequests++;
+  ck_pr_inc_uint(&aio_ctxts[thread_id].nrequests);
+
+  if (file_nreapers > 0)
+    return file_reaper_wait(&aio_ctxts[thread_id].nrequests,
+                            file_async_backlog);
+
   if (aio_ctxts[thread_id].nrequests < file_async_backlog)
     return 0;
   
@@ -1158,37 +4161,69 @@ int file_submit_or_wait(struct iocb *iocb, sb_file_op_t type, ssize_t len,
 
 
 /*
-  Wait for at least nreq I/O requests to complete
+  Wait for at least nreq I/O requests to complete. With --file-async-poll the
+  completion ring is polled without sleeping in io_getevents().
 */
 
 
 int file_wait(int thread_id, long nreq)
+{
+  struct timespec zero = {0, 0};
+  long            done = 0;
+
+  if (!file_async_poll)
+    return file_async_reap(thread_id, nreq, NULL) < 0;
+
+  while (done < nreq)
+  {
+    const long nr = file_async_reap(thread_id, 0, &zero);
+
+    if (nr < 0)
+      return 1;
+
+    done += nr;
+  }
+
+  return 0;
+}
+
+
+/*
+  Process completed requests of a thread, waiting for at least min_nr of them
+  or until the timeout expires. Returns the number of processed requests, or
+  -1 on errors.
+*/
+
+
+long file_async_reap(int thread_id, long min_nr, struct timespec *timeout)
 { 
+  sb_aio_context_t *ctxt = &aio_ctxts[thread_id];
   long            i;
   long            nr;
   struct io_event *event;
   sb_aio_oper_t   *oper;
   struct iocb     *iocbp;
+  uint64_t        lat_ns;
 
   /* Try to read some events */
 #ifdef HAVE_OLD_GETEVENTS
-  (void)nreq; /* unused */
-  nr = io_getevents(aio_ctxts[thread_id].io_ctxt, file_async_backlog,
-                    aio_ctxts[thread_id].events, NULL);
+  (void)min_nr; /* unused */
+  nr = io_getevents(ctxt->io_ctxt, file_async_backlog, ctxt->events, timeout);
 #else
-  nr = io_getevents(aio_ctxts[thread_id].io_ctxt, nreq, file_async_backlog,
-                    aio_ctxts[thread_id].events, NULL);
+  nr = io_getevents(ctxt->io_ctxt, min_nr, file_async_backlog, ctxt->events,
+                    timeout);
 #endif
-  if (nr < 1)
+  if (nr < 0 || (nr < 1 && timeout == NULL))
   {
-    log_errno(LOG_FATAL, "io_getevents() failed!");
-    return 1;
+    log_text(LOG_FATAL, "io_getevents() failed: %s",
+             nr < 0 ? strerror((int) -nr) : "no events");
+    return -1;
   }
 
   /* Verify results */
   for (i = 0; i < nr; i++)
   {
-    event = (struct io_event *)aio_ctxts[thread_id].events + i;
+    event = (struct io_event *)ctxt->events + i;
     iocbp = (struct iocb *)(unsigned long)event->obj;
     oper = (sb_aio_oper_t *)iocbp;
     switch (oper->type) {
@@ -1196,47 +4231,450 @@ int file_wait(int thread_id, long nreq)
         if (event->res != 0)
         {
           log_text(LOG_FATAL, "Asynchronous fsync failed!\n");
-          return 1;
+          return -1;
+        }
+
+        sb_counter_inc(thread_id, SB_CNT_OTHER);
+
+        break;
+
+    case FILE_OP_TYPE_READ:
+        if ((ssize_t)event->res != oper->len)
+        {
+          log_text(LOG_FATAL, "Asynchronous read failed!\n");
+          return -1;
+        }
+
+        sb_counter_inc(thread_id, SB_CNT_READ);
+        sb_counter_add(thread_id, SB_CNT_BYTES_READ, oper->len);
+
+        break;
+
+    case FILE_OP_TYPE_WRITE:
+        if ((ssize_t)event->res != oper->len)
+        {
+          log_text(LOG_FATAL, "Asynchronous write failed!\n");
+          return -1;
         }
 
-        sb_counter_inc(thread_id, SB_CNT_OTHER);
+        sb_counter_inc(thread_id, SB_CNT_WRITE);
+        sb_counter_add(thread_id, SB_CNT_BYTES_WRITTEN, oper->len);
+
+        break;
+
+    default:
+        break;
+    }
+    lat_ns = file_op_end(oper->type, oper->start_ns, thread_id);
+    if (oper->type != FILE_OP_TYPE_FSYNC)
+      file_size_class_add(thread_id, oper->size_class, oper->type, oper->len,
+                          lat_ns);
+    free(oper);
+    ck_pr_dec_uint(&ctxt->nrequests);
+  }
+  
+  return nr;
+}
+
+
+/* Wait for all in-flight requests of a thread to complete */
+
+
+int file_async_drain(int thread_id)
+{
+  sb_aio_context_t *ctxt = &aio_ctxts[thread_id];
+
+  if (file_nreapers > 0)
+    return file_reaper_wait(&ctxt->nrequests, 1);
+
+  if (ctxt->nrequests > 0)
+    return file_wait(thread_id, ctxt->nrequests);
+
+  return 0;
+}
+#endif /* HAVE_LIBAIO */
+
+#ifdef HAVE_LIBURING
+/* Create per-thread io_uring instances */
+
+
+int file_uring_init(void)
+{
+  struct io_uring_params params;
+  struct iovec           iov;
+  unsigned int           i;
+  unsigned int           j;
+  unsigned int           ring_size;
+  int                    rc;
+
+  if (file_io_mode != FILE_IO_MODE_URING)
+    return 0;
+
+  if (sb_get_value_int("file-uring-depth") <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value of file-uring-depth: %d",
+             sb_get_value_int("file-uring-depth"));
+    return 1;
+  }
+  file_uring_depth = sb_get_value_int("file-uring-depth");
+
+  if (sb_get_value_int("file-uring-batch") <= 0 ||
+      (unsigned int) sb_get_value_int("file-uring-batch") > file_uring_depth)
+  {
+    log_text(LOG_FATAL, "Invalid value of file-uring-batch: %d "
+             "(must be between 1 and file-uring-depth)",
+             sb_get_value_int("file-uring-batch"));
+    return 1;
+  }
+  file_uring_batch = sb_get_value_int("file-uring-batch");
+
+  /* Sweep runs with shallower queues submit smaller batches */
+  if (file_sweep_depth > 0)
+  {
+    file_uring_depth = file_sweep_depth;
+    file_uring_batch = SB_MIN(file_uring_batch, file_uring_depth);
+  }
+
+  file_uring_fixed_bufs = sb_get_value_flag("file-uring-fixed-bufs");
+  file_uring_fixed_files = sb_get_value_flag("file-uring-fixed-files");
+  file_uring_sqpoll = sb_get_value_flag("file-uring-sqpoll");
+
+  uring_ctxts = (sb_uring_context_t *)calloc(sb_globals.threads,
+                                             sizeof(sb_uring_context_t));
+  if (uring_ctxts == NULL)
+  {
+    log_text(LOG_FATAL, "Failed to allocate io_uring contexts!");
+    return 1;
+  }
+
+  for (i = 0; i < sb_globals.threads; i++)
+  {
+    sb_uring_context_t *ctxt = &uring_ctxts[i];
+
+    memset(&params, 0, sizeof(params));
+    if (file_uring_sqpoll)
+    {
+      params.flags |= IORING_SETUP_SQPOLL;
+      /* Let the polling thread go to sleep after 1 second of inactivity */
+      params.sq_thread_idle = 1000;
+    }
+    if (file_async_poll)
+      params.flags |= IORING_SETUP_IOPOLL;
+
+    rc = io_uring_queue_init_params(file_uring_depth, &ctxt->ring, &params);
+    if (rc < 0)
+    {
+      log_text(LOG_FATAL, "io_uring_queue_init_params() failed: %s",
+               strerror(-rc));
+      return 1;
+    }
+
+    if (file_uring_fixed_bufs)
+    {
+      iov.iov_base = per_thread[i].buffer;
+      iov.iov_len = file_request_size;
+
+      rc = io_uring_register_buffers(&ctxt->ring, &iov, 1);
+      if (rc < 0)
+      {
+        log_text(LOG_FATAL, "io_uring_register_buffers() failed: %s",
+                 strerror(-rc));
+        return 1;
+      }
+    }
+
+    /* A ring of size n holds n - 1 entries */
+    for (ring_size = 2; ring_size <= file_uring_depth; ring_size <<= 1)
+      ;
+
+    ctxt->opers = (sb_uring_oper_t *)malloc(file_uring_depth *
+                                            sizeof(sb_uring_oper_t));
+    ctxt->free_opers = (ck_ring_buffer_t *)calloc(ring_size,
+                                                  sizeof(ck_ring_buffer_t));
+    if (ctxt->opers == NULL || ctxt->free_opers == NULL)
+    {
+      log_text(LOG_FATAL, "Failed to allocate io_uring operations!");
+      return 1;
+    }
+
+    ck_ring_init(&ctxt->free_ring, ring_size);
+    for (j = 0; j < file_uring_depth; j++)
+      ck_ring_enqueue_spsc(&ctxt->free_ring, ctxt->free_opers,
+                           &ctxt->opers[j]);
+  }
+
+  return 0;
+}
+
+
+/* Register test files with io_uring instances, if requested */
+
+
+int file_uring_prepare(void)
+{
+  unsigned int i;
+  int          rc;
+
+  if (file_io_mode != FILE_IO_MODE_URING || !file_uring_fixed_files)
+    return 0;
+
+  for (i = 0; i < sb_globals.threads; i++)
+  {
+    rc = io_uring_register_files(&uring_ctxts[i].ring, files, num_files);
+    if (rc < 0)
+    {
+      log_text(LOG_FATAL, "io_uring_register_files() failed: %s",
+               strerror(-rc));
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+/* Destroy per-thread io_uring instances */
+
+
+int file_uring_done(void)
+{
+  unsigned int i;
+
+  if (file_io_mode != FILE_IO_MODE_URING)
+    return 0;
+
+  for (i = 0; i < sb_globals.threads; i++)
+  {
+    io_uring_queue_exit(&uring_ctxts[i].ring);
+    free(uring_ctxts[i].opers);
+    free(uring_ctxts[i].free_opers);
+  }
+
+  free(uring_ctxts);
+
+  return 0;
+}
+
+
+/*
+  Prepare an SQE for the given operation and submit all prepared SQEs once
+  --file-uring-batch of them have been accumulated. When the number of
+  in-flight requests reaches --file-uring-depth, wait for at least one of them
+  to complete.
+*/
+
+
+int file_uring_submit_or_wait(sb_file_op_t type, unsigned int file_id,
+                              void *buf, ssize_t len, long long offset,
+                              int thread_id)
+{
+  sb_uring_context_t  *ctxt = &uring_ctxts[thread_id];
+  sb_uring_oper_t     *oper;
+  struct io_uring_sqe *sqe;
+  int                 fd;
+  int                 rc;
+
+  sqe = io_uring_get_sqe(&ctxt->ring);
+  if (sqe == NULL ||
+      !ck_ring_dequeue_spsc(&ctxt->free_ring, ctxt->free_opers, &oper))
+  {
+    log_text(LOG_FATAL, "io_uring submission queue overflow!");
+    return 1;
+  }
+
+  fd = file_uring_fixed_files ? (int) file_id : files[file_id];
+
+  switch (type) {
+  case FILE_OP_TYPE_READ:
+    if (file_uring_fixed_bufs)
+      io_uring_prep_read_fixed(sqe, fd, buf, len, offset, 0);
+    else
+      io_uring_prep_read(sqe, fd, buf, len, offset);
+    break;
+
+  case FILE_OP_TYPE_WRITE:
+    if (file_uring_fixed_bufs)
+      io_uring_prep_write_fixed(sqe, fd, buf, len, offset, 0);
+    else
+      io_uring_prep_write(sqe, fd, buf, len, offset);
+    break;
+
+  case FILE_OP_TYPE_FSYNC:
+    io_uring_prep_fsync(sqe, fd, file_fsync_mode == FSYNC_DATA ?
+                        IORING_FSYNC_DATASYNC : 0);
+    /* Do not start fsync until all previously submitted writes complete */
+    sqe->flags |= IOSQE_IO_DRAIN;
+    break;
+
+  default:
+    log_text(LOG_FATAL, "Unknown io_uring operation type: %d", type);
+    return 1;
+  }
+
+  if (file_uring_fixed_files)
+    sqe->flags |= IOSQE_FIXED_FILE;
+
+  oper->type = type;
+  oper->len = len;
+  oper->size_class = per_thread[thread_id].size_class;
+  oper->start_ns = file_op_start(type);
+  io_uring_sqe_set_data(sqe, oper);
+
+  ck_pr_inc_uint(&ctxt->nrequests);
+  ctxt->nqueued++;
+
+  const bool full = ck_pr_load_uint(&ctxt->nrequests) >= file_uring_depth;
+
+  if (full && file_nreapers == 0)
+    return file_uring_wait(thread_id, 1);
+
+  if (ctxt->nqueued >= file_uring_batch || full)
+  {
+    rc = io_uring_submit(&ctxt->ring);
+    if (rc < 0)
+    {
+      log_text(LOG_FATAL, "io_uring_submit() failed: %s", strerror(-rc));
+      return 1;
+    }
+    ctxt->nqueued = 0;
+  }
+
+  /* Completions are reaped concurrently, wait for a free slot if full */
+  if (full)
+    return file_reaper_wait(&ctxt->nrequests, file_uring_depth);
+
+  return 0;
+}
+
+
+/*
+  Submit all prepared SQEs, wait for at least nreq requests to complete and
+  reap all available completions.
+*/
+
+
+int file_uring_wait(int thread_id, unsigned int nreq)
+{
+  sb_uring_context_t  *ctxt = &uring_ctxts[thread_id];
+  int                 rc;
+
+  /* With IOPOLL the kernel polls the device instead of sleeping */
+  rc = io_uring_submit_and_wait(&ctxt->ring, nreq);
+  if (rc < 0)
+  {
+    log_text(LOG_FATAL, "io_uring_submit_and_wait() failed: %s",
+             strerror(-rc));
+    return 1;
+  }
+  ctxt->nqueued = 0;
+
+  return file_uring_reap(thread_id) < 0;
+}
+
+
+/*
+  Process all available completions of a thread. Returns the number of
+  processed requests, or -1 on errors.
+*/
+
+
+long file_uring_reap(int thread_id)
+{
+  sb_uring_context_t  *ctxt = &uring_ctxts[thread_id];
+  sb_uring_oper_t     *oper;
+  struct io_uring_cqe *cqe;
+  unsigned int        head;
+  unsigned int        nr = 0;
+  uint64_t            lat_ns;
+
+  io_uring_for_each_cqe(&ctxt->ring, head, cqe)
+  {
+    oper = (sb_uring_oper_t *) io_uring_cqe_get_data(cqe);
+    nr++;
+
+    switch (oper->type) {
+    case FILE_OP_TYPE_FSYNC:
+      /* fsync counters are updated by file_fsync() */
+      if (cqe->res != 0)
+      {
+        log_text(LOG_FATAL, "io_uring fsync failed: %s", strerror(-cqe->res));
+        return -1;
+      }
+
+      break;
+
+    case FILE_OP_TYPE_READ:
+      if ((ssize_t) cqe->res != oper->len)
+      {
+        log_text(LOG_FATAL, "io_uring read failed: %s",
+                 cqe->res < 0 ? strerror(-cqe->res) : "short read");
+        return -1;
+      }
+
+      sb_counter_inc(thread_id, SB_CNT_READ);
+      sb_counter_add(thread_id, SB_CNT_BYTES_READ, oper->len);
+
+      break;
+
+    case FILE_OP_TYPE_WRITE:
+      if ((ssize_t) cqe->res != oper->len)
+      {
+        log_text(LOG_FATAL, "io_uring write failed: %s",
+                 cqe->res < 0 ? strerror(-cqe->res) : "short write");
+        return -1;
+      }
+
+      sb_counter_inc(thread_id, SB_CNT_WRITE);
+      sb_counter_add(thread_id, SB_CNT_BYTES_WRITTEN, oper->len);
+
+      break;
+
+    default:
+      break;
+    }
+    lat_ns = file_op_end(oper->type, oper->start_ns, thread_id);
+    if (oper->type != FILE_OP_TYPE_FSYNC)
+      file_size_class_add(thread_id, oper->size_class, oper->type, oper->len,
+                          lat_ns);
+
+    /* Return the operation before the submitter can see a free slot */
+    ck_ring_enqueue_spsc(&ctxt->free_ring, ctxt->free_opers, oper);
+    ck_pr_dec_uint(&ctxt->nrequests);
+  }
 
-        break;
+  io_uring_cq_advance(&ctxt->ring, nr);
 
-    case FILE_OP_TYPE_READ:
-        if ((ssize_t)event->res != oper->len)
-        {
-          log_text(LOG_FATAL, "Asynchronous read failed!\n");
-          return 1;
-        }
+  return nr;
+}
 
-        sb_counter_inc(thread_id, SB_CNT_READ);
-        sb_counter_add(thread_id, SB_CNT_BYTES_READ, oper->len);
 
-        break;
+/* Wait for all in-flight requests of a thread to complete */
 
-    case FILE_OP_TYPE_WRITE:
-        if ((ssize_t)event->res != oper->len)
-        {
-          log_text(LOG_FATAL, "Asynchronous write failed!\n");
-          return 1;
-        }
 
-        sb_counter_inc(thread_id, SB_CNT_WRITE);
-        sb_counter_add(thread_id, SB_CNT_BYTES_WRITTEN, oper->len);
+int file_uring_drain(int thread_id)
+{
+  sb_uring_context_t *ctxt = &uring_ctxts[thread_id];
+  int                rc;
 
-        break;
+  if (file_nreapers == 0)
+    return ctxt->nrequests > 0 ?
+      file_uring_wait(thread_id, ctxt->nrequests) : 0;
 
-    default:
-        break;
+  if (ctxt->nqueued > 0)
+  {
+    rc = io_uring_submit(&ctxt->ring);
+    if (rc < 0)
+    {
+      log_text(LOG_FATAL, "io_uring_submit() failed: %s", strerror(-rc));
+      return 1;
     }
-    free(oper);
-    aio_ctxts[thread_id].nrequests--;
+    ctxt->nqueued = 0;
   }
-  
-  return 0;
+
+  return file_reaper_wait(&ctxt->nrequests, 1);
 }
-#endif /* HAVE_LIBAIO */
+
+#endif /* HAVE_LIBURING */
 
                         
 #ifdef HAVE_MMAP
@@ -1264,11 +4702,14 @@ int file_mmap_prepare(void)
     }
 
 #if SIZEOF_SIZE_T > 4
+  /* Threads map their windows on demand */
+  if (file_mmap_window > 0)
+    return 0;
+
   mmaps = (void **)malloc(num_files * sizeof(void *));
   for (i = 0; i < num_files; i++)
   {
-    mmaps[i] = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED,
-                    files[i], 0);
+    mmaps[i] = file_mmap(files[i], file_size, 0, PROT_READ | PROT_WRITE);
     if (mmaps[i] == MAP_FAILED)
     {
       log_errno(LOG_FATAL, "mmap() failed on file %d", i);
@@ -1283,6 +4724,95 @@ int file_mmap_prepare(void)
 }
 
 
+/*
+  Map len bytes of file fd at offset, applying --file-mmap-populate and
+  --file-mmap-advice. Returns MAP_FAILED on errors.
+*/
+
+static void *file_mmap(FILE_DESCRIPTOR fd, size_t len, long long offset,
+                       int prot)
+{
+  int  flags = MAP_SHARED;
+  void *addr;
+
+#ifdef MAP_POPULATE
+  if (file_mmap_populate)
+    flags |= MAP_POPULATE;
+#endif
+
+  addr = mmap(NULL, len, prot, flags, fd, offset);
+  if (addr == MAP_FAILED)
+    return addr;
+
+  if (file_mmap_advice >= 0 && madvise(addr, len, file_mmap_advice))
+  {
+    log_errno(LOG_FATAL, "madvise(%s) failed",
+              sb_get_value_string("file-mmap-advice"));
+    munmap(addr, len);
+    return MAP_FAILED;
+  }
+
+  return addr;
+}
+
+
+/*
+  Return the address of a request in the mapping window of a thread, moving
+  the window to the part of the file containing the request if needed.
+*/
+
+static char *file_mmap_window_addr(unsigned int file_id, long long offset,
+                                   size_t count, int thread_id)
+{
+  sb_per_thread_t * const t = &per_thread[thread_id];
+
+  if (t->mmap_addr == NULL || t->mmap_file_id != file_id ||
+      offset < t->mmap_start ||
+      offset + (long long) count > t->mmap_start + (long long) t->mmap_len)
+  {
+    const long long start = offset / file_mmap_window * file_mmap_window;
+    /* Grow the window if a request crosses its end */
+    const size_t    len = SB_MIN(SB_MAX(file_mmap_window,
+                                        offset + (long long) count - start),
+                                 file_size - start);
+    void            *addr;
+
+    file_mmap_window_unmap(thread_id);
+
+    addr = file_mmap(files[file_id], len, start, PROT_READ | PROT_WRITE);
+    if (addr == MAP_FAILED)
+      return NULL;
+
+    t->mmap_addr = addr;
+    t->mmap_file_id = file_id;
+    t->mmap_start = start;
+    t->mmap_len = len;
+  }
+
+  return t->mmap_addr + (offset - t->mmap_start);
+}
+
+
+static void file_mmap_window_unmap(int thread_id)
+{
+  sb_per_thread_t * const t = &per_thread[thread_id];
+
+  if (t->mmap_addr != NULL)
+    munmap(t->mmap_addr, t->mmap_len);
+  t->mmap_addr = NULL;
+}
+
+
+/* msync() a range of a mapping, which does not have to be page-aligned */
+
+static int file_msync_range(char *addr, size_t len)
+{
+  const size_t skew = (size_t) addr & ~file_page_mask;
+
+  return msync(addr - skew, len + skew, MS_SYNC);
+}
+
+
 /* Destroy data structure used by mmap'ed I/O operations */
 
 
@@ -1293,13 +4823,19 @@ int file_mmap_done(void)
   if (file_io_mode != FILE_IO_MODE_MMAP)
     return 0;
 
+  if (per_thread != NULL)
+    for (i = 0; i < sb_globals.threads; i++)
+      file_mmap_window_unmap(i);
+
 #if SIZEOF_SIZE_T > 4
-  for (i = 0; i < num_files; i++)
-    munmap(mmaps[i], file_size);
+  if (mmaps != NULL)
+  {
+    for (i = 0; i < num_files; i++)
+      munmap(mmaps[i], file_size);
 
-  free(mmaps);
-#else
-   (void)i; /* unused */
+    free(mmaps);
+    mmaps = NULL;
+  }
 #endif
   
   return 0;
@@ -1311,19 +4847,35 @@ int file_do_fsync(unsigned int id, int thread_id)
   FILE_DESCRIPTOR fd = files[id];
 #ifdef HAVE_LIBAIO
   struct iocb iocb;
-#else
+#elif !defined(HAVE_LIBURING)
   (void)thread_id; /* unused */
 #endif
 
+#ifdef HAVE_LIBURING
+  /*
+    IOPOLL rings only support reads and writes, so wait for preceding requests
+    and call fsync() synchronously
+  */
+  if (file_io_mode == FILE_IO_MODE_URING && file_async_poll &&
+      file_uring_drain(thread_id))
+    return 1;
+#endif
+
   /*
     FIXME: asynchronous fsync support is missing
     in Linux kernel at the moment
   */
   if (file_io_mode == FILE_IO_MODE_SYNC
       || file_io_mode == FILE_IO_MODE_ASYNC
+#ifdef HAVE_LIBURING
+      || (file_io_mode == FILE_IO_MODE_URING && file_async_poll)
+#endif
 #if defined(HAVE_MMAP) && SIZEOF_SIZE_T == 4
       /* Use fsync in mmaped mode on 32-bit architectures */
       || file_io_mode == FILE_IO_MODE_MMAP
+#elif defined(HAVE_MMAP)
+      /* ... and with mapping windows, which may be unmapped at any time */
+      || (file_io_mode == FILE_IO_MODE_MMAP && file_mmap_window > 0)
 #endif
       )
   {
@@ -1352,6 +4904,14 @@ int file_do_fsync(unsigned int id, int thread_id)
     return file_submit_or_wait(&iocb, FILE_OP_TYPE_FSYNC, 0, thread_id);
   }
 #endif
+#ifdef HAVE_LIBURING
+  else if (file_io_mode == FILE_IO_MODE_URING)
+  {
+    /* Use asynchronous fsync ordered after all preceding requests */
+    return file_uring_submit_or_wait(FILE_OP_TYPE_FSYNC, id, NULL, 0, 0,
+                                     thread_id);
+  }
+#endif
 #ifdef HAVE_MMAP
   /* Use msync on file on 64-bit architectures */
   else if (file_io_mode == FILE_IO_MODE_MMAP)
@@ -1366,20 +4926,86 @@ int file_do_fsync(unsigned int id, int thread_id)
 
 int file_fsync(unsigned int id, int thread_id)
 {
+  const uint64_t dirty = file_writeback ? file_writeback_fsync_start(id) : 0;
+  const uint64_t start_ns = file_op_start(FILE_OP_TYPE_FSYNC);
+
   if (file_do_fsync(id, thread_id))
   {
     log_errno(LOG_FATAL, "Failed to fsync file! file: " FD_FMT, files[id]);
     return 1;
   }
 
+  /* io_uring fsync latency is accounted on completion */
+  if (file_io_mode != FILE_IO_MODE_URING)
+  {
+    const uint64_t lat_ns = file_op_end(FILE_OP_TYPE_FSYNC, start_ns,
+                                        thread_id);
+
+    if (file_writeback && file_io_mode != FILE_IO_MODE_ASYNC)
+      file_writeback_fsync(dirty, lat_ns);
+  }
+
   sb_counter_inc(thread_id, SB_CNT_OTHER);
 
   return 0;
 }
 
 
-ssize_t file_pread(unsigned int file_id, void *buf, ssize_t count,
-                   long long offset, int thread_id)
+/*
+  Discard a block with --file-discard-mode. Discards bypass async and mmap I/O
+  and are always done synchronously.
+*/
+
+int file_discard(sb_file_request_t *req, int thread_id)
+{
+  const FILE_DESCRIPTOR fd = files[req->file_id];
+  const long long       offset = file_base(req->file_id) + req->pos;
+  const uint64_t        start_ns = file_op_start(FILE_OP_TYPE_DISCARD);
+  int                   rc = -1;
+
+  switch (file_discard_mode) {
+#ifdef SB_FILE_FALLOCATE
+    case FILE_DISCARD_PUNCH:
+      rc = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset,
+                     req->size);
+      break;
+    case FILE_DISCARD_ZERO:
+      rc = fallocate(fd, FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE, offset,
+                     req->size);
+      break;
+#endif
+#if defined(SB_FILE_DEVICE) && defined(BLKDISCARD)
+    case FILE_DISCARD_BLKDISCARD:
+    {
+      uint64_t range[2] = { (uint64_t) offset, (uint64_t) req->size };
+
+      rc = ioctl(fd, BLKDISCARD, range);
+      break;
+    }
+#endif
+    default:
+      errno = EOPNOTSUPP;
+      break;
+  }
+
+  if (rc != 0)
+  {
+    log_errno(LOG_FATAL, "Failed to discard block! file: " FD_FMT
+              " pos: %lld", fd, (long long) req->pos);
+    return 1;
+  }
+
+  file_op_end(FILE_OP_TYPE_DISCARD, start_ns, thread_id);
+
+  ck_pr_inc_64(&per_thread[thread_id].discards);
+  ck_pr_add_64(&per_thread[thread_id].bytes_discarded, req->size);
+
+  return 0;
+}
+
+
+static ssize_t file_pread_int(unsigned int file_id, void *buf, ssize_t count,
+                              long long offset, int thread_id)
 {
   FILE_DESCRIPTOR fd = files[file_id];
 #ifdef HAVE_MMAP
@@ -1389,12 +5015,22 @@ ssize_t file_pread(unsigned int file_id, void *buf, ssize_t count,
 #endif
 #ifdef HAVE_LIBAIO
   struct iocb iocb;
-#else
+#elif !defined(HAVE_LIBURING)
   (void)thread_id; /* unused */
 #endif
     
   if (file_io_mode == FILE_IO_MODE_SYNC)
     return pread(fd, buf, count, offset);
+#ifdef HAVE_LIBURING
+  else if (file_io_mode == FILE_IO_MODE_URING)
+  {
+    if (file_uring_submit_or_wait(FILE_OP_TYPE_READ, file_id, buf, count,
+                                  offset, thread_id))
+      return 0;
+
+    return count;
+  }
+#endif
 #ifdef HAVE_LIBAIO
   else if (file_io_mode == FILE_IO_MODE_ASYNC)
   {
@@ -1410,12 +5046,21 @@ ssize_t file_pread(unsigned int file_id, void *buf, ssize_t count,
 #ifdef HAVE_MMAP
   else if (file_io_mode == FILE_IO_MODE_MMAP)
   {
+    if (file_mmap_window > 0)
+    {
+      char *addr = file_mmap_window_addr(file_id, offset, count, thread_id);
+
+      if (addr == NULL)
+        return 0;
+      memcpy(buf, addr, count);
+
+      return count;
+    }
 # if SIZEOF_SIZE_T == 4
     /* Create file mapping for each I/O operation on 32-bit platforms */
     page_addr = offset & file_page_mask;
     page_offset = offset - page_addr;
-    start = mmap(NULL, count + page_offset, PROT_READ, MAP_SHARED,
-                 fd, page_addr);
+    start = file_mmap(fd, count + page_offset, page_addr, PROT_READ);
     if (start == MAP_FAILED)
       return 0;
     memcpy(buf, (char *)start + page_offset, count);
@@ -1438,8 +5083,22 @@ ssize_t file_pread(unsigned int file_id, void *buf, ssize_t count,
 }
 
 
-ssize_t file_pwrite(unsigned int file_id, void *buf, ssize_t count,
-                    long long offset, int thread_id)
+ssize_t file_pread(unsigned int file_id, void *buf, ssize_t count,
+                   long long offset, int thread_id)
+{
+  SB_PROBE4(file__read__start, thread_id, file_id, offset, count);
+
+  const ssize_t rc = file_pread_int(file_id, buf, count,
+                                    file_base(file_id) + offset, thread_id);
+
+  SB_PROBE3(file__read__done, thread_id, file_id, rc);
+
+  return rc;
+}
+
+
+static ssize_t file_pwrite_int(unsigned int file_id, void *buf, ssize_t count,
+                               long long offset, int thread_id)
 {
   FILE_DESCRIPTOR fd = files[file_id];
 #ifdef HAVE_MMAP
@@ -1449,12 +5108,22 @@ ssize_t file_pwrite(unsigned int file_id, void *buf, ssize_t count,
 #endif  
 #ifdef HAVE_LIBAIO
   struct iocb iocb;
-#else  
+#elif !defined(HAVE_LIBURING)
   (void)thread_id; /* unused */
 #endif
   
   if (file_io_mode == FILE_IO_MODE_SYNC)
     return pwrite(fd, buf, count, offset);
+#ifdef HAVE_LIBURING
+  else if (file_io_mode == FILE_IO_MODE_URING)
+  {
+    if (file_uring_submit_or_wait(FILE_OP_TYPE_WRITE, file_id, buf, count,
+                                  offset, thread_id))
+      return 0;
+
+    return count;
+  }
+#endif
 #ifdef HAVE_LIBAIO
   else if (file_io_mode == FILE_IO_MODE_ASYNC)
   {
@@ -1470,16 +5139,35 @@ ssize_t file_pwrite(unsigned int file_id, void *buf, ssize_t count,
 #ifdef HAVE_MMAP
   else if (file_io_mode == FILE_IO_MODE_MMAP)
   {
+    if (file_mmap_window > 0)
+    {
+      char *addr = file_mmap_window_addr(file_id, offset, count, thread_id);
+
+      if (addr == NULL)
+        return 0;
+      memcpy(addr, buf, count);
+
+      if (file_mmap_msync_writes && file_msync_range(addr, count))
+        return 0;
+
+      return count;
+    }
 # if SIZEOF_SIZE_T == 4
     /* Create file mapping for each I/O operation on 32-bit platforms */
     page_addr = offset & file_page_mask;
     page_offset = offset - page_addr;
-    start = mmap(NULL, count + page_offset, PROT_READ | PROT_WRITE, MAP_SHARED,
-                 fd, page_addr);
+    start = file_mmap(fd, count + page_offset, page_addr,
+                      PROT_READ | PROT_WRITE);
 
     if (start == MAP_FAILED)
       return 0;
     memcpy((char *)start + page_offset, buf, count);
+    if (file_mmap_msync_writes &&
+        file_msync_range((char *)start + page_offset, count))
+    {
+      munmap(start, count + page_offset);
+      return 0;
+    }
     munmap(start, count + page_offset);
 
     return count;
@@ -1488,15 +5176,224 @@ ssize_t file_pwrite(unsigned int file_id, void *buf, ssize_t count,
     (void)page_addr; /* unused */
     (void)page_offset; /* unused */
 
-    /* We already have all files mapped on 64-bit platforms */
-    memcpy((char *)mmaps[file_id] + offset, buf, count);
+    /* We already have all files mapped on 64-bit platforms */
+    memcpy((char *)mmaps[file_id] + offset, buf, count);
+
+    if (file_mmap_msync_writes &&
+        file_msync_range((char *)mmaps[file_id] + offset, count))
+      return 0;
+
+    return count;
+# endif    
+  }
+#endif /* HAVE_MMAP */
+
+  return 0; /* Unknown I/O mode */
+}
+
+
+ssize_t file_pwrite(unsigned int file_id, void *buf, ssize_t count,
+                    long long offset, int thread_id)
+{
+  SB_PROBE4(file__write__start, thread_id, file_id, offset, count);
+
+  const ssize_t rc = file_pwrite_int(file_id, buf, count,
+                                     file_base(file_id) + offset, thread_id);
+
+  SB_PROBE3(file__write__done, thread_id, file_id, rc);
+
+  return rc;
+}
+
+
+/*
+  Parse --file-jobs, a list of MODE:THREADS[:rate=SIZE][:fsync=N] items.
+  Sequential writes recreate test files, so 'seqwr' is not allowed.
+*/
+
+int parse_jobs(void)
+{
+  static const char *names[] =
+    {"seqrewr", "seqrd", "rndrd", "rndwr", "rndrw", NULL};
+  static const file_test_mode_t modes[] =
+    {MODE_REWRITE, MODE_READ, MODE_RND_READ, MODE_RND_WRITE, MODE_RND_RW};
+  sb_list_item_t *pos;
+  unsigned int   nthreads = 0;
+
+  file_njobs = 0;
+
+  SB_LIST_FOR_EACH(pos, sb_get_value_list("file-jobs"))
+  {
+    const char   *val = SB_LIST_ENTRY(pos, value_t, listitem)->data;
+    char         buf[128];
+    char         *tok;
+    char         *save;
+    char         *end;
+    unsigned int i;
+
+    if (file_njobs == FILE_MAX_JOBS)
+    {
+      log_text(LOG_FATAL, "At most %d jobs can be used in --file-jobs",
+               FILE_MAX_JOBS);
+      return 1;
+    }
+
+    file_job_t * const job = &file_jobs[file_njobs];
+
+    snprintf(job->name, sizeof(job->name), "%s", val);
+    snprintf(buf, sizeof(buf), "%s", val);
+    job->rate = 0;
+    job->fsync_freq = -1;       /* --file-fsync-freq */
+
+    if ((tok = strtok_r(buf, ":", &save)) == NULL)
+      goto invalid;
+    for (i = 0; names[i] != NULL; i++)
+      if (!strcmp(tok, names[i]))
+        break;
+    if (names[i] == NULL)
+      goto invalid;
+    job->mode = modes[i];
+
+    if ((tok = strtok_r(NULL, ":", &save)) == NULL)
+      goto invalid;
+    const long n = strtol(tok, &end, 10);
+    if (end == tok || *end != '\0' || n < 1 || n > 10000)
+      goto invalid;
+    job->nthreads = n;
+
+    while ((tok = strtok_r(NULL, ":", &save)) != NULL)
+    {
+      if (!strncmp(tok, "rate=", 5))
+      {
+        if ((job->rate = sb_parse_size(tok + 5)) <= 0)
+          goto invalid;
+      }
+      else if (!strncmp(tok, "fsync=", 6))
+      {
+        const long f = strtol(tok + 6, &end, 10);
+
+        if (end == tok + 6 || *end != '\0' || f < 0 || f > INT_MAX)
+          goto invalid;
+        job->fsync_freq = f;
+      }
+      else
+        goto invalid;
+    }
+
+    nthreads += job->nthreads;
+    file_njobs++;
+    continue;
+
+  invalid:
+    log_text(LOG_FATAL, "Invalid value for --file-jobs: %s", val);
+    return 1;
+  }
+
+  if (file_njobs > 0 && nthreads != sb_globals.threads)
+  {
+    log_text(LOG_FATAL, "--file-jobs uses %u threads in total, but "
+             "--threads=%u", nthreads, sb_globals.threads);
+    return 1;
+  }
+
+  return 0;
+}
+
+
+static int cmp_size_class(const void *a, const void *b)
+{
+  const file_size_class_t *x = a;
+  const file_size_class_t *y = b;
+
+  return x->size < y->size ? -1 : x->size > y->size;
+}
+
+
+/*
+  Parse --file-block-sizes, a list of SIZE[:WEIGHT] items with weights
+  defaulting to 1. Classes are sorted by size.
+*/
+
+int parse_block_sizes(void)
+{
+  sb_list_item_t *pos;
+  unsigned int   cum_weight = 0;
+
+  file_nsize_classes = 0;
+
+  SB_LIST_FOR_EACH(pos, sb_get_value_list("file-block-sizes"))
+  {
+    const char         *val = SB_LIST_ENTRY(pos, value_t, listitem)->data;
+    const char         *sep = strchr(val, ':');
+    const size_t       len = sep != NULL ? (size_t) (sep - val) : strlen(val);
+    char               buf[32];
+    unsigned long long size = 0;
+    long               weight = 1;
+    unsigned int       i;
+
+    if (len < sizeof(buf))
+    {
+      memcpy(buf, val, len);
+      buf[len] = '\0';
+      size = sb_parse_size(buf);
+    }
+
+    if (sep != NULL)
+    {
+      char *end;
+
+      weight = strtol(sep + 1, &end, 10);
+      if (end == sep + 1 || *end != '\0')
+        weight = 0;
+    }
+
+    if (size == 0 || size > INT_MAX || weight <= 0 || weight > 1000000)
+    {
+      log_text(LOG_FATAL, "Invalid value for file-block-sizes: %s", val);
+      return 1;
+    }
+
+    for (i = 0; i < file_nsize_classes; i++)
+      if (file_size_classes[i].size == size)
+        break;
+    if (i < file_nsize_classes)
+    {
+      log_text(LOG_FATAL, "Duplicate size in file-block-sizes: %s", val);
+      return 1;
+    }
+
+    if (file_nsize_classes == FILE_MAX_SIZE_CLASSES)
+    {
+      log_text(LOG_FATAL, "At most %d sizes can be used in file-block-sizes",
+               FILE_MAX_SIZE_CLASSES);
+      return 1;
+    }
+
+    file_size_classes[file_nsize_classes].size = (unsigned int) size;
+    file_size_classes[file_nsize_classes].weight = (unsigned int) weight;
+    file_nsize_classes++;
+  }
+
+  if (file_nsize_classes == 0)
+    return 0;
+
+  /* Per-block checksums assume all requests have the same size */
+  if (sb_globals.validate)
+  {
+    log_text(LOG_FATAL, "--validate cannot be used with --file-block-sizes");
+    return 1;
+  }
 
-    return count;
-# endif    
+  qsort(file_size_classes, file_nsize_classes, sizeof(file_size_class_t),
+        cmp_size_class);
+
+  for (unsigned int i = 0; i < file_nsize_classes; i++)
+  {
+    cum_weight += file_size_classes[i].weight;
+    file_size_classes[i].cum_weight = cum_weight;
   }
-#endif /* HAVE_MMAP */
 
-  return 0; /* Unknown I/O mode */
+  return 0;
 }
 
 
@@ -1505,8 +5402,9 @@ ssize_t file_pwrite(unsigned int file_id, void *buf, ssize_t count,
 
 int parse_arguments(void)
 {
-  char         *mode;
-  unsigned int  i;
+  char            *mode;
+  unsigned int    i;
+  struct timespec ts;
   
   num_files = sb_get_value_int("file-num");
 
@@ -1526,8 +5424,21 @@ int parse_arguments(void)
   
   mode = sb_get_value_string("file-test-mode");
 
+  /* Jobs replace the test mode */
+  if (!strcmp(sb_globals.cmdname, "run") && parse_jobs())
+    return 1;
+
+  if (file_njobs > 0)
+  {
+    if (mode != NULL)
+    {
+      log_text(LOG_FATAL, "--file-test-mode cannot be used with --file-jobs");
+      return 1;
+    }
+    test_mode = MODE_MIXED;
+  }
   /* File test mode is necessary only for 'run' command */
-  if (!strcmp(sb_globals.cmdname, "run"))
+  else if (!strcmp(sb_globals.cmdname, "run"))
   {
     if (mode == NULL)
     {
@@ -1570,6 +5481,16 @@ int parse_arguments(void)
     log_text(LOG_FATAL,
              "asynchronous I/O mode is unsupported on this platform.");
     return 1;
+#endif
+  }
+  else if (!strcmp(mode, "uring"))
+  {
+#ifdef HAVE_LIBURING
+    file_io_mode = FILE_IO_MODE_URING;
+#else
+    log_text(LOG_FATAL,
+             "io_uring I/O mode is unsupported on this platform.");
+    return 1;
 #endif
   }
   else if (!strcmp(mode, "mmap"))
@@ -1588,6 +5509,11 @@ int parse_arguments(void)
     return 1;
   }
   
+#ifdef HAVE_MMAP
+  if (parse_mmap_arguments())
+    return 1;
+#endif
+
   file_merged_requests = sb_get_value_int("file-merged-requests");
   if (file_merged_requests < 0)
   {
@@ -1604,11 +5530,34 @@ int parse_arguments(void)
     return 1;
   }
 
-  if (file_merged_requests > 0)
-    file_request_size = file_block_size * file_merged_requests;
+  if (sb_globals.validate)
+  {
+    if ((size_t) file_block_size < sizeof(file_block_header_t))
+    {
+      log_text(LOG_FATAL, "--validate requires --file-block-size of at least "
+               "%zu bytes", sizeof(file_block_header_t));
+      return 1;
+    }
+
+    crc32c_init();
+    file_crc32c = crc32c_hw != NULL ? crc32c_hw : crc32c_sw;
+  }
+
+  if (parse_block_sizes())
+    return 1;
+
+  if (file_nsize_classes > 0)
+  {
+    /* The smallest size is used for block selection and 'prepare' */
+    file_block_size = file_size_classes[0].size;
+    file_request_size = file_size_classes[file_nsize_classes - 1].size;
+  }
   else
     file_request_size = file_block_size;
 
+  if (file_merged_requests > 0)
+    file_request_size *= file_merged_requests;
+
   mode = sb_get_value_string("file-extra-flags");
 
   sb_list_item_t *pos;
@@ -1629,6 +5578,15 @@ int parse_arguments(void)
     }
   }
 
+  file_device = sb_get_value_string("file-device");
+  if (file_device != NULL && file_device[0] == '\0')
+    file_device = NULL;
+  file_device_offset = sb_get_value_size("file-device-offset");
+  file_device_destroy = sb_get_value_flag("file-device-destroy");
+  /* Bypass page cache to measure the device itself */
+  if (file_device != NULL)
+    file_extra_flags |= SB_FILE_FLAG_DIRECTIO;
+
   file_fsync_freq = sb_get_value_int("file-fsync-freq");
   if (file_fsync_freq < 0)
   {
@@ -1663,6 +5621,26 @@ int parse_arguments(void)
     return 1;
   }
 
+  mode = sb_get_value_string("file-prepare-mode");
+  if (!strcmp(mode, "write"))
+    file_prepare_mode = FILE_PREPARE_WRITE;
+  else if (!strcmp(mode, "fallocate"))
+  {
+#ifdef HAVE_POSIX_FALLOCATE
+    file_prepare_mode = FILE_PREPARE_FALLOCATE;
+#else
+    log_text(LOG_FATAL, "posix_fallocate() is unavailable on this platform");
+    return 1;
+#endif
+  }
+  else if (!strcmp(mode, "sparse"))
+    file_prepare_mode = FILE_PREPARE_SPARSE;
+  else
+  {
+    log_text(LOG_FATAL, "Invalid value for --file-prepare-mode: %s.", mode);
+    return 1;
+  }
+
   file_rw_ratio = sb_get_value_double("file-rw-ratio");
   if (file_rw_ratio < 0)
   {
@@ -1670,64 +5648,364 @@ int parse_arguments(void)
     return 1;
   }
 
-  per_thread = malloc(sizeof(*per_thread) * sb_globals.threads);
+  mode = sb_get_value_string("file-rand-type");
+  if (!strcmp(mode, "uniform"))
+    file_rand_func = NULL;
+  else if (!strcmp(mode, "gaussian"))
+    file_rand_func = sb_rand_gaussian;
+  else if (!strcmp(mode, "special"))
+    file_rand_func = sb_rand_special;
+  else if (!strcmp(mode, "pareto"))
+    file_rand_func = sb_rand_pareto;
+  else if (!strcmp(mode, "zipfian"))
+    file_rand_func = sb_rand_zipfian;
+  else
+  {
+    log_text(LOG_FATAL, "Invalid value for --file-rand-type: %s.", mode);
+    return 1;
+  }
+
+  file_hotspot_move = sb_get_value_double("file-hotspot-move");
+  if (file_hotspot_move < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --file-hotspot-move: %f.",
+             file_hotspot_move);
+    return 1;
+  }
+
+  file_nblocks = SB_MAX(total_size / file_block_size, 1);
+
+  mode = sb_get_value_string("file-thread-affinity");
+  for (i = 0; file_affinity_names[i] != NULL; i++)
+    if (!strcmp(mode, file_affinity_names[i]))
+      break;
+  if (file_affinity_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for --file-thread-affinity: %s.", mode);
+    return 1;
+  }
+  file_affinity = (file_affinity_t) i;
+
+  switch (file_affinity)
+  {
+  case FILE_AFFINITY_SHARED:
+    file_ngroups = 1;
+    break;
+  case FILE_AFFINITY_OWNED:
+    file_ngroups = sb_globals.threads;
+    break;
+  case FILE_AFFINITY_SHARDED:
+    if (sb_get_value_int("file-shards") < 1 ||
+        (unsigned) sb_get_value_int("file-shards") > sb_globals.threads)
+    {
+      log_text(LOG_FATAL, "--file-shards must be between 1 and the number "
+               "of threads (%u)", sb_globals.threads);
+      return 1;
+    }
+    file_ngroups = sb_get_value_int("file-shards");
+    break;
+  }
+
+  if (sb_get_value_int("file-seq-streams") < 1)
+  {
+    log_text(LOG_FATAL, "Invalid value for --file-seq-streams: %d.",
+             sb_get_value_int("file-seq-streams"));
+    return 1;
+  }
+  file_seq_streams = (unsigned int) sb_get_value_int("file-seq-streams");
+
+  file_rate = sb_get_value_size("file-rate");
+
+  file_cache_stats = sb_get_value_flag("file-cache-stats");
+  if (sb_get_value_int("file-cache-resident") < 0 ||
+      sb_get_value_int("file-cache-resident") > 100 ||
+      sb_get_value_int("file-cache-hit-ratio") < 0 ||
+      sb_get_value_int("file-cache-hit-ratio") > 100)
+  {
+    log_text(LOG_FATAL, "--file-cache-resident and --file-cache-hit-ratio "
+             "must be between 0 and 100");
+    return 1;
+  }
+  file_cache_resident = sb_get_value_int("file-cache-resident");
+  file_cache_hit_ratio = sb_get_value_int("file-cache-hit-ratio");
+  if (file_cache_hit_ratio > 0 &&
+      (file_cache_resident == 0 || file_cache_resident == 100))
+  {
+    log_text(LOG_FATAL, "--file-cache-hit-ratio requires "
+             "--file-cache-resident between 1 and 99");
+    return 1;
+  }
+  if (file_cache_resident > 0)
+    file_cache_stats = true;
+  if (file_cache_stats && (file_extra_flags & SB_FILE_FLAG_DIRECTIO))
+  {
+    log_text(LOG_FATAL, "page cache control cannot be used with "
+             "--file-extra-flags=direct");
+    return 1;
+  }
+
+  if (file_ngroups > num_files)
+  {
+    log_text(LOG_FATAL, "--file-thread-affinity=%s needs at least %u files, "
+             "got --file-num=%u", mode, file_ngroups, num_files);
+    return 1;
+  }
+
+  if (file_njobs > 0)
+  {
+    if (file_affinity != FILE_AFFINITY_SHARED)
+    {
+      log_text(LOG_FATAL, "--file-thread-affinity cannot be used with "
+               "--file-jobs");
+      return 1;
+    }
+    file_ngroups = file_njobs;
+  }
+
+  SB_GETTIME(&ts);
+  file_start_ns = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+
+  mode = sb_get_value_string("file-buffer-pages");
+  if (sb_parse_pages(mode, &file_buffer_pages))
+  {
+    log_text(LOG_FATAL, "Invalid value for --file-buffer-pages: %s.", mode);
+    return 1;
+  }
+  file_buffer_populate = sb_get_value_flag("file-buffer-populate");
+  file_diskstats = sb_get_value_flag("file-diskstats");
+  file_writeback = sb_get_value_flag("file-writeback");
+
+  if (sb_get_value_int("file-precondition") < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for --file-precondition: %d.",
+             sb_get_value_int("file-precondition"));
+    return 1;
+  }
+  file_precondition = sb_get_value_int("file-precondition");
+  if (file_precondition > 0 && sb_globals.validate)
+  {
+    log_text(LOG_FATAL, "--file-precondition cannot be used with --validate");
+    return 1;
+  }
+  if (file_precondition > 0 && test_mode == MODE_WRITE)
+  {
+    log_text(LOG_FATAL, "--file-precondition cannot be used with "
+             "--file-test-mode=seqwr, which recreates test files");
+    return 1;
+  }
+
+  file_discard_ratio = sb_get_value_double("file-discard-ratio");
+  if (file_discard_ratio < 0 || file_discard_ratio > 100)
+  {
+    log_text(LOG_FATAL, "Invalid value for --file-discard-ratio: %f.",
+             file_discard_ratio);
+    return 1;
+  }
+
+  mode = sb_get_value_string("file-discard-mode");
+  for (i = 0; file_discard_mode_names[i] != NULL; i++)
+    if (!strcmp(mode, file_discard_mode_names[i]))
+      break;
+  if (file_discard_mode_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for --file-discard-mode: %s.", mode);
+    return 1;
+  }
+  file_discard_mode = (file_discard_mode_t) i;
+
+  if (!strcmp(sb_globals.cmdname, "run") && file_discard_ratio > 0)
+  {
+    bool discards = file_mode_discards(test_mode);
+
+    for (i = 0; i < file_njobs; i++)
+      discards |= file_mode_discards(file_jobs[i].mode);
+
+    if (!discards)
+    {
+      log_text(LOG_FATAL, "--file-discard-ratio requires a random write test "
+               "mode {rndwr, rndrw}");
+      return 1;
+    }
+    if (sb_globals.validate)
+    {
+      log_text(LOG_FATAL, "--file-discard-ratio cannot be used with "
+               "--validate");
+      return 1;
+    }
+    if (file_discard_mode == FILE_DISCARD_BLKDISCARD)
+    {
+#if defined(SB_FILE_DEVICE) && defined(BLKDISCARD)
+      if (file_device == NULL)
+      {
+        log_text(LOG_FATAL, "--file-discard-mode=discard requires "
+                 "--file-device");
+        return 1;
+      }
+#else
+      log_text(LOG_FATAL, "BLKDISCARD is unavailable on this platform");
+      return 1;
+#endif
+    }
+#ifndef SB_FILE_FALLOCATE
+    else
+    {
+      log_text(LOG_FATAL, "fallocate() hole punching and zeroing are "
+               "unavailable on this platform");
+      return 1;
+    }
+#endif
+  }
+
+  if (file_device != NULL)
+  {
+    const bool run = !strcmp(sb_globals.cmdname, "run");
+    const bool writes = !strcmp(sb_globals.cmdname, "prepare") ||
+      (run && ((test_mode != MODE_READ && test_mode != MODE_RND_READ) ||
+               file_precondition > 0));
+
+    if (run && file_io_mode == FILE_IO_MODE_MMAP)
+    {
+      log_text(LOG_FATAL, "--file-device cannot be used with "
+               "--file-io-mode=mmap");
+      return 1;
+    }
+
+    if (file_device_check(writes))
+      return 1;
+  }
+
+  /*
+    Buffers are first touched by their threads in file_thread_init(), so they
+    are local to the NUMA node a thread is running on
+  */
+  per_thread = calloc(sb_globals.threads, sizeof(*per_thread));
   for (i = 0; i < sb_globals.threads; i++)
   {
-    per_thread[i].buffer = sb_memalign(file_request_size, sb_getpagesize());
+    if (file_buffer_pages != SB_PAGES_DEFAULT || file_buffer_populate)
+      per_thread[i].buffer = sb_alloc_pages(file_request_size,
+                                            file_buffer_pages,
+                                            file_buffer_populate);
+    else
+      per_thread[i].buffer = sb_memalign(file_request_size, sb_getpagesize());
     if (per_thread[i].buffer == NULL)
     {
       log_text(LOG_FATAL, "Failed to allocate a memory buffer");
       return 1;
     }
-    memset(per_thread[i].buffer, 0, file_request_size);
   }
 
   return 0;
 }
 
 
+#ifdef HAVE_MMAP
+/* Parse the --file-mmap-* options */
+
+static int parse_mmap_arguments(void)
+{
+  static const int advice_values[] =
+  {
+    -1,                         /* normal: no madvise() call */
+#ifdef MADV_RANDOM
+    MADV_RANDOM,
+#else
+    -2,
+#endif
+#ifdef MADV_SEQUENTIAL
+    MADV_SEQUENTIAL,
+#else
+    -2,
+#endif
+#ifdef MADV_WILLNEED
+    MADV_WILLNEED,
+#else
+    -2,
+#endif
+#ifdef MADV_HUGEPAGE
+    MADV_HUGEPAGE,
+#else
+    -2,
+#endif
+  };
+  const char   *s;
+  unsigned int i;
+
+  s = sb_get_value_string("file-mmap-advice");
+  for (i = 0; file_mmap_advice_names[i] != NULL; i++)
+    if (!strcmp(file_mmap_advice_names[i], s))
+      break;
+  if (file_mmap_advice_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for file-mmap-advice: %s", s);
+    return 1;
+  }
+  if (advice_values[i] == -2)
+  {
+    log_text(LOG_FATAL, "--file-mmap-advice=%s is not supported on this "
+             "platform", s);
+    return 1;
+  }
+  file_mmap_advice = advice_values[i];
+
+  file_mmap_populate = sb_get_value_flag("file-mmap-populate");
+#ifndef MAP_POPULATE
+  if (file_mmap_populate)
+  {
+    log_text(LOG_FATAL, "--file-mmap-populate is not supported on this "
+             "platform");
+    return 1;
+  }
+#endif
+
+  file_mmap_msync_writes = sb_get_value_flag("file-mmap-msync-writes");
+
+  file_mmap_window = sb_get_value_size("file-mmap-window");
+  if (file_mmap_window < 0 ||
+      file_mmap_window % sb_get_allocation_granularity() != 0)
+  {
+    log_text(LOG_FATAL, "--file-mmap-window must be a multiple of the "
+             "allocation granularity (%zu bytes)",
+             sb_get_allocation_granularity());
+    return 1;
+  }
+
+  return 0;
+}
+#endif
+
+
 /* check if two requests are sequential */
 
 
-void check_seq_req(sb_file_request_t *prev_req, sb_file_request_t *r)
+void check_seq_req(const file_group_t *g, file_stream_t *s,
+                   sb_file_request_t *r)
 {
+  sb_file_request_t *prev_req = &s->prev_req;
+
   /* Do not check fsync operation at the moment */
   if (r->operation == FILE_OP_TYPE_FSYNC || r->operation == FILE_OP_TYPE_NULL)
-    return; 
+    return;
   /* if old request is NULL do not check against it */
   if (prev_req->operation == FILE_OP_TYPE_NULL)
     return;
-  /* check files */
-  if (r->file_id - prev_req->file_id>1 &&
-      !(r->file_id == 0 && prev_req->file_id == num_files-1))
+
+  const long long prev_end =
+    (long long) (prev_req->file_id - g->first_file) * file_size +
+    prev_req->pos + prev_req->size;
+  const long long offset =
+    (long long) (r->file_id - g->first_file) * file_size + r->pos;
+
+  /* A stream wraps around to its start after the end of its range */
+  if (offset != prev_end && !(prev_end == s->end && offset == s->start))
   {
-    log_text(LOG_WARNING,
-             "Discovered too large file difference in seq requests!");
-    return;
+    log_text(LOG_WARNING, "Discovered a non-sequential request in a "
+             "sequential stream!");
+    log_text(LOG_WARNING, "Old: file_id: %d, pos: %d  size: %d",
+             prev_req->file_id, (int)prev_req->pos, (int)prev_req->size);
+    log_text(LOG_WARNING, "New: file_id: %d, pos: %d  size: %d",
+             r->file_id, (int)r->pos, (int)r->size);
   }
-  if (r->file_id == prev_req->file_id)
-  {
-    if(r->pos - prev_req->pos != prev_req->size)
-    {
-      log_text(LOG_WARNING,
-               "Discovered too large position difference in seq request!");
-      return;
-    }
-  }    
-  else /* if file changed last request has to complete file and new start */
-  {
-    if ((prev_req->pos + prev_req->size != file_size) || (r->pos != 0))
-    {
-      log_text(LOG_WARNING, "Invalid file switch found!");  
-      log_text(LOG_WARNING, "Old: file_id: %d, pos: %d  size: %d",
-               prev_req->file_id, (int)prev_req->pos, (int)prev_req->size);
-      log_text(LOG_WARNING, "New: file_id: %d, pos: %d  size: %d",
-               r->file_id, (int)r->pos, (int)r->size);
-      
-      return;
-    }  
-  }    
-} 
+}
 
 
 /*
@@ -1741,7 +6019,10 @@ size_t sb_get_allocation_granularity(void)
 
 static void sb_free_memaligned(void *buf)
 {
-  free(buf);
+  if (file_buffer_pages != SB_PAGES_DEFAULT || file_buffer_populate)
+    sb_free_pages(buf, file_request_size, file_buffer_pages);
+  else
+    free(buf);
 }
 
 static FILE_DESCRIPTOR sb_open(const char *name)
@@ -1784,52 +6065,126 @@ static int sb_create(const char *path)
 }
 
 
-/* Fill buffer with random values and write checksum */
+/* CRC-32C of a block, excluding the checksum field */
+
+static inline uint32_t file_block_checksum(const unsigned char *block,
+                                           unsigned int len)
+{
+  const size_t skip = sizeof(((file_block_header_t *) 0)->checksum);
+
+  return file_crc32c(0, block + skip, len - skip);
+}
+
 
+/*
+  Fill each block of a buffer to be written at offset in file file_id with
+  random data and a header. Blocks written by 'run' get a new generation,
+  which is remembered to detect lost writes when they are read back.
+*/
 
 void file_fill_buffer(unsigned char *buf, unsigned int len,
-                      size_t offset)
+                      unsigned int file_id, size_t offset)
 {
-  unsigned int i;
+  const uint64_t gen = file_block_gens != NULL ?
+    ck_pr_faa_64(&file_write_gen, 1) + 1 : 0;
 
-  for (i = 0; i < len - (FILE_CHECKSUM_LENGTH + FILE_OFFSET_LENGTH); i++)
-    buf[i] = sb_rand_uniform_uint64() & 0xFF;
+  for (unsigned int pos = 0; pos < len; pos += file_block_size)
+  {
+    const unsigned int  blen = SB_MIN((unsigned int) file_block_size,
+                                      len - pos);
+    unsigned char       *block = buf + pos;
+    file_block_header_t hdr;
+    unsigned int        i;
 
-  /* Store the checksum */
-  *(int *)(void *)(buf + i) = (int)crc32(0, (unsigned char *)buf, len -
-                                 (FILE_CHECKSUM_LENGTH + FILE_OFFSET_LENGTH));
-  /* Store the offset */
-  *(long *)(void *)(buf + i + FILE_CHECKSUM_LENGTH) = offset;
-}
+    /* A short tail block at the end of a file gets no header */
+    i = blen >= sizeof(hdr) ? sizeof(hdr) : 0;
 
+    /* Use all 8 bytes of each random number */
+    for (; i < blen; i += sizeof(uint64_t))
+    {
+      const uint64_t r = sb_rand_uniform_uint64();
 
-/* Validate checksum and offset of block read from disk */
+      memcpy(block + i, &r, SB_MIN(sizeof(r), blen - i));
+    }
 
+    if (blen < sizeof(hdr))
+      continue;
 
-int file_validate_buffer(unsigned char  *buf, unsigned int len, size_t offset)
-{
-  unsigned int checksum;
-  unsigned int cs_offset;
+    hdr.checksum = 0;
+    hdr.file_id = file_id;
+    hdr.offset = offset + pos;
+    hdr.generation = gen;
+    memcpy(block, &hdr, sizeof(hdr));
 
-  cs_offset = len - (FILE_CHECKSUM_LENGTH + FILE_OFFSET_LENGTH);
-  
-  checksum = (unsigned int)crc32(0, (unsigned char *)buf, cs_offset);
+    hdr.checksum = file_block_checksum(block, blen);
+    memcpy(block, &hdr.checksum, sizeof(hdr.checksum));
 
-  if (checksum != *(unsigned int *)(void *)(buf + cs_offset))
-  {
-    log_text(LOG_FATAL, "Checksum mismatch in block with offset: %lld",
-             (long long) offset);
-    log_text(LOG_FATAL, "    Calculated value: 0x%x    Stored value: 0x%x",
-             checksum, *(unsigned int *)(void *)(buf + cs_offset));
-    return 1;
+    if (file_block_gens != NULL)
+      file_block_gens[file_id * file_blocks_per_file +
+                      (offset + pos) / file_block_size] = gen;
   }
+}
+
+
+/*
+  Validate the headers of blocks read from offset in file file_id. The
+  checksum catches corrupted and torn blocks, the file ID and offset catch
+  misdirected writes, and the generation catches lost writes of blocks
+  written earlier in this run.
+*/
 
-  if (offset != *(size_t *)(void *)(buf + cs_offset + FILE_CHECKSUM_LENGTH))
+int file_validate_buffer(unsigned char *buf, unsigned int len,
+                         unsigned int file_id, size_t offset)
+{
+  for (unsigned int pos = 0; pos < len; pos += file_block_size)
   {
-    log_text(LOG_FATAL, "Offset mismatch in block:");
-    log_text(LOG_FATAL, "   Actual offset: %zu    Stored offset: %zu",
-             offset, *(size_t *)(void *)(buf + cs_offset + FILE_CHECKSUM_LENGTH));
-    return 1;
+    const unsigned int  blen = SB_MIN((unsigned int) file_block_size,
+                                      len - pos);
+    const unsigned char *block = buf + pos;
+    const uint64_t      block_offset = offset + pos;
+    file_block_header_t hdr;
+    uint32_t            checksum;
+
+    if (blen < sizeof(hdr))
+      continue;
+
+    memcpy(&hdr, block, sizeof(hdr));
+
+    checksum = file_block_checksum(block, blen);
+    if (checksum != hdr.checksum)
+    {
+      log_text(LOG_FATAL, "Checksum mismatch in block with offset: %llu",
+               (unsigned long long) block_offset);
+      log_text(LOG_FATAL, "    Calculated value: 0x%x    Stored value: 0x%x",
+               checksum, hdr.checksum);
+      return 1;
+    }
+
+    if (hdr.file_id != file_id || hdr.offset != block_offset)
+    {
+      log_text(LOG_FATAL, "Misdirected block:");
+      log_text(LOG_FATAL, "   Actual file: %u offset: %llu    "
+               "Stored file: %u offset: %llu", file_id,
+               (unsigned long long) block_offset, hdr.file_id,
+               (unsigned long long) hdr.offset);
+      return 1;
+    }
+
+    if (file_block_gens != NULL)
+    {
+      const uint64_t gen = file_block_gens[file_id * file_blocks_per_file +
+                                           block_offset / file_block_size];
+
+      if (gen != 0 && hdr.generation != gen)
+      {
+        log_text(LOG_FATAL, "Stale block with offset: %llu (lost write?)",
+                 (unsigned long long) block_offset);
+        log_text(LOG_FATAL, "   Expected generation: %llu    "
+                 "Stored generation: %llu", (unsigned long long) gen,
+                 (unsigned long long) hdr.generation);
+        return 1;
+      }
+    }
   }
 
   return 0;
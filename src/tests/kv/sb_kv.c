@@ -0,0 +1,1268 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  In-memory key-value map test. Each event executes --kv-batch-size get, put
+  or delete operations on keys chosen with the --rand-type distribution, i.e.
+  it measures what an in-process cache can do on a host without any network
+  or query parsing overhead. The maps are:
+
+  striped - chained hash table with a read-write lock per stripe of buckets
+  ck_ht   - concurrencykit ck_ht, lock-free reads with writes serialized by a
+            mutex, as ck_ht supports a single writer
+  simd    - open addressing hash table split into shards with a read-write
+            lock each. Slots are probed in groups of 16 by comparing their
+            7-bit hash tags with a single SSE2 or NEON instruction, falling
+            back to a scalar loop on other platforms.
+
+  Keys are decimal numbers padded with zeros to --kv-key-size. Every key has a
+  preallocated item holding its key and value, which is linked into the map by
+  puts, so the allocator does not take part in the test. Values read by gets
+  are copied to a thread buffer and are not checked.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdio.h>
+# include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+
+#include <pthread.h>
+#include <inttypes.h>
+
+#if defined(__SSE2__)
+# define KV_SSE2_PROBE
+# include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+# define KV_NEON_PROBE
+# include <arm_neon.h>
+#endif
+
+#include "sysbench.h"
+#include "sb_rand.h"
+#include "sb_util.h"
+#include "sb_ck_pr.h"
+
+#include "ck_ht.h"
+
+/* Key-value test arguments */
+static sb_arg_t kv_args[] =
+{
+  SB_OPT("kv-map", "map implementation {striped, ck_ht, simd}", "striped",
+         STRING),
+  SB_OPT("kv-keys", "number of distinct keys", "1000000", INT),
+  SB_OPT("kv-key-size", "key size, keys are zero-padded decimal numbers",
+         "16", SIZE),
+  SB_OPT("kv-value-size", "value size", "64", SIZE),
+  SB_OPT("kv-prefill", "percentage of keys inserted before the test", "100",
+         INT),
+  SB_OPT("kv-get-ratio", "relative weight of get operations", "90", INT),
+  SB_OPT("kv-put-ratio", "relative weight of put operations", "8", INT),
+  SB_OPT("kv-delete-ratio", "relative weight of delete operations", "2", INT),
+  SB_OPT("kv-stripes", "number of lock stripes of the striped map or shards "
+         "of the simd map, rounded up to a power of 2", "1024", INT),
+  SB_OPT("kv-batch-size", "number of operations per event", "1", INT),
+
+  SB_OPT_END
+};
+
+typedef enum
+{
+  KV_MAP_STRIPED,
+  KV_MAP_CK_HT,
+  KV_MAP_SIMD
+} kv_map_t;
+
+static const char *kv_map_names[] = {"striped", "ck_ht", "simd", NULL};
+
+#define KV_KEY_MAX 65535
+#define KV_STRIPES_MAX 65536
+
+typedef struct kv_item
+{
+  struct kv_item *next;         /* bucket chain of the striped map */
+  uint64_t       hash;
+  char           data[];        /* key followed by value */
+} kv_item_t;
+
+/* Map operations, 'hash' is kv_hash() of 'key' */
+typedef struct
+{
+  int  (*init)(void);
+  void (*done)(void);
+  /* Copy the value of a key to 'val', return false if it is not set */
+  bool (*get)(const char *key, uint64_t hash, char *val);
+  /* Set the value of the key of 'item', return non-zero on errors */
+  int  (*put)(const char *key, uint64_t hash, kv_item_t *item,
+              const char *val);
+  void (*del)(const char *key, uint64_t hash);
+} kv_map_ops_t;
+
+typedef struct
+{
+  pthread_rwlock_t lock CK_CC_CACHELINE;
+} kv_stripe_t;
+
+/* Shard of the simd map */
+typedef struct
+{
+  pthread_rwlock_t lock CK_CC_CACHELINE;
+  uint8_t          *ctrl;       /* control bytes, one per slot */
+  kv_item_t        **slots;
+  uint64_t         mask;        /* number of groups - 1 */
+  uint64_t         used;        /* full and deleted slots */
+  uint64_t         live;        /* full slots */
+} kv_shard_t;
+
+typedef struct
+{
+  uint64_t gets CK_CC_CACHELINE;
+  uint64_t hits;
+  uint64_t puts;
+  uint64_t deletes;
+
+  char     *key;                /* key of the current operation */
+  char     *value;
+} kv_thread_t;
+
+/* Per-thread counters summed over all threads */
+typedef struct
+{
+  uint64_t gets;
+  uint64_t hits;
+  uint64_t puts;
+  uint64_t deletes;
+} kv_totals_t;
+
+/* Key-value test operations */
+static int kv_init(void);
+static int kv_thread_init(int);
+static int kv_thread_done(int);
+static void kv_print_mode(void);
+static sb_event_t kv_next_event(int);
+static int kv_execute_event(sb_event_t *, int);
+static void kv_report_intermediate(sb_stat_t *);
+static void kv_report_cumulative(sb_stat_t *);
+static int kv_done(void);
+
+static sb_test_t kv_test =
+{
+  .sname = "kv",
+  .lname = "In-memory key-value map test",
+  .ops = {
+    .init = kv_init,
+    .thread_init = kv_thread_init,
+    .thread_done = kv_thread_done,
+    .print_mode = kv_print_mode,
+    .next_event = kv_next_event,
+    .execute_event = kv_execute_event,
+    .report_intermediate = kv_report_intermediate,
+    .report_cumulative = kv_report_cumulative,
+    .done = kv_done
+  },
+  .args = kv_args
+};
+
+static kv_map_t     kv_map;
+static unsigned int kv_keys;
+static size_t       kv_key_size;
+static size_t       kv_value_size;
+static unsigned int kv_prefill;
+static unsigned int kv_get_ratio;
+static unsigned int kv_put_ratio;
+static unsigned int kv_delete_ratio;
+static unsigned int kv_stripes;
+static unsigned int kv_batch_size;
+
+/* Number of digits of the largest key */
+static unsigned int kv_key_digits;
+
+static char         *kv_items;
+static size_t       kv_item_size;
+
+static const kv_map_ops_t *kv_ops;
+
+static kv_thread_t  *kv_threads;
+
+/* Totals at the last intermediate and cumulative reports */
+static kv_totals_t  kv_interm;
+static kv_totals_t  kv_cumul;
+
+
+int register_test_kv(sb_list_t *tests)
+{
+  SB_LIST_ADD_TAIL(&kv_test.listitem, tests);
+
+  return 0;
+}
+
+
+/* MurmurHash64A */
+
+static uint64_t kv_hash(const void *key, size_t len)
+{
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const uint8_t  *p = key;
+  uint64_t       h = 0x5362ULL ^ (len * m);
+  uint64_t       k;
+
+  for (; len >= 8; len -= 8, p += 8)
+  {
+    memcpy(&k, p, sizeof(k));
+    k *= m;
+    k ^= k >> 47;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+
+  if (len > 0)
+  {
+    for (k = 0; len > 0; len--)
+      k = (k << 8) | p[len - 1];
+    h ^= k;
+    h *= m;
+  }
+
+  h ^= h >> 47;
+  h *= m;
+  h ^= h >> 47;
+
+  return h;
+}
+
+
+/* Return the smallest power of 2 which is not less than n */
+
+static uint64_t kv_pow2_ceil(uint64_t n)
+{
+  uint64_t p = 1;
+
+  while (p < n)
+    p <<= 1;
+
+  return p;
+}
+
+
+static inline kv_item_t *kv_item(uint64_t id)
+{
+  return (kv_item_t *) (kv_items + id * kv_item_size);
+}
+
+
+/* Write the key with a given number, the buffer is expected to be zeroed */
+
+static inline void kv_format_key(char *key, uint64_t id)
+{
+  char *p = key + kv_key_size;
+
+  for (unsigned int i = 0; i < kv_key_digits; i++, id /= 10)
+    *--p = (char) ('0' + id % 10);
+}
+
+
+static inline bool kv_key_eq(const kv_item_t *item, const char *key,
+                             uint64_t hash)
+{
+  return item->hash == hash && !memcmp(item->data, key, kv_key_size);
+}
+
+
+static inline void kv_value_get(const kv_item_t *item, char *val)
+{
+  memcpy(val, item->data + kv_key_size, kv_value_size);
+}
+
+
+static inline void kv_value_set(kv_item_t *item, const char *val)
+{
+  memcpy(item->data + kv_key_size, val, kv_value_size);
+}
+
+/* Striped map */
+
+static kv_stripe_t  *striped_locks;
+static kv_item_t    **striped_buckets;
+static uint64_t     striped_bucket_mask;
+static uint64_t     striped_stripe_mask;
+
+
+static int striped_init(void)
+{
+  const uint64_t nbuckets = kv_pow2_ceil(kv_keys);
+  const uint64_t nstripes = SB_MIN((uint64_t) kv_stripes, nbuckets);
+
+  striped_buckets = calloc(nbuckets, sizeof(kv_item_t *));
+  striped_locks = sb_memalign(nstripes * sizeof(kv_stripe_t),
+                              CK_MD_CACHELINE);
+
+  if (striped_buckets == NULL || striped_locks == NULL)
+    return 1;
+
+  for (uint64_t i = 0; i < nstripes; i++)
+    pthread_rwlock_init(&striped_locks[i].lock, NULL);
+
+  striped_bucket_mask = nbuckets - 1;
+  striped_stripe_mask = nstripes - 1;
+
+  return 0;
+}
+
+
+static void striped_done(void)
+{
+  for (uint64_t i = 0; striped_locks != NULL && i <= striped_stripe_mask; i++)
+    pthread_rwlock_destroy(&striped_locks[i].lock);
+
+  free(striped_locks);
+  free(striped_buckets);
+  striped_locks = NULL;
+  striped_buckets = NULL;
+}
+
+
+/* Stripes lock buckets with the same low bits */
+
+static inline pthread_rwlock_t *striped_lock(uint64_t bucket)
+{
+  return &striped_locks[bucket & striped_stripe_mask].lock;
+}
+
+
+/* Return the link pointing to the item of a key, or to the end of the chain */
+
+static kv_item_t **striped_find(uint64_t bucket, const char *key,
+                                uint64_t hash)
+{
+  kv_item_t **link = &striped_buckets[bucket];
+
+  while (*link != NULL && !kv_key_eq(*link, key, hash))
+    link = &(*link)->next;
+
+  return link;
+}
+
+
+static bool striped_get(const char *key, uint64_t hash, char *val)
+{
+  const uint64_t   bucket = hash & striped_bucket_mask;
+  pthread_rwlock_t * const lock = striped_lock(bucket);
+  kv_item_t        *item;
+
+  pthread_rwlock_rdlock(lock);
+
+  if ((item = *striped_find(bucket, key, hash)) != NULL)
+    kv_value_get(item, val);
+
+  pthread_rwlock_unlock(lock);
+
+  return item != NULL;
+}
+
+
+static int striped_put(const char *key, uint64_t hash, kv_item_t *item,
+                       const char *val)
+{
+  const uint64_t   bucket = hash & striped_bucket_mask;
+  pthread_rwlock_t * const lock = striped_lock(bucket);
+  kv_item_t        **link;
+
+  pthread_rwlock_wrlock(lock);
+
+  link = striped_find(bucket, key, hash);
+  if (*link == NULL)
+  {
+    item->next = NULL;
+    *link = item;
+  }
+  kv_value_set(*link, val);
+
+  pthread_rwlock_unlock(lock);
+
+  return 0;
+}
+
+
+static void striped_del(const char *key, uint64_t hash)
+{
+  const uint64_t   bucket = hash & striped_bucket_mask;
+  pthread_rwlock_t * const lock = striped_lock(bucket);
+  kv_item_t        **link;
+
+  pthread_rwlock_wrlock(lock);
+
+  link = striped_find(bucket, key, hash);
+  if (*link != NULL)
+    *link = (*link)->next;
+
+  pthread_rwlock_unlock(lock);
+}
+
+/* ck_ht map */
+
+static ck_ht_t         ckht;
+static bool            ckht_initialized;
+static pthread_mutex_t ckht_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Tables replaced on growth, freed at the end as readers may still use them */
+static void            **ckht_deferred;
+static size_t          ckht_ndeferred;
+
+
+static void ckht_hash(ck_ht_hash_t *h, const void *key, size_t len,
+                      uint64_t seed)
+{
+  (void) seed; /* unused */
+
+  h->value = kv_hash(key, len);
+}
+
+
+static void *ckht_malloc(size_t size)
+{
+  return malloc(size);
+}
+
+
+static void *ckht_realloc(void *p, size_t old_size, size_t new_size,
+                          bool defer)
+{
+  (void) old_size; /* unused */
+  (void) defer; /* unused */
+
+  return realloc(p, new_size);
+}
+
+
+/* Called by the writer, i.e. with ckht_mutex locked after initialization */
+
+static void ckht_free(void *p, size_t size, bool defer)
+{
+  void **tmp;
+
+  (void) size; /* unused */
+
+  if (!defer)
+  {
+    free(p);
+    return;
+  }
+
+  tmp = realloc(ckht_deferred, (ckht_ndeferred + 1) * sizeof(void *));
+  if (tmp == NULL)
+    return;                     /* leak rather than free under readers */
+
+  ckht_deferred = tmp;
+  ckht_deferred[ckht_ndeferred++] = p;
+}
+
+
+static struct ck_malloc ckht_allocator =
+{
+  .malloc = ckht_malloc,
+  .realloc = ckht_realloc,
+  .free = ckht_free
+};
+
+
+static int ckht_init(void)
+{
+  /* ck_ht grows at a load factor of 0.5 */
+  if (!ck_ht_init(&ckht, CK_HT_MODE_BYTESTRING | CK_HT_WORKLOAD_DELETE,
+                  ckht_hash, &ckht_allocator, (uint64_t) kv_keys * 2, 0))
+    return 1;
+
+  ckht_initialized = true;
+
+  return 0;
+}
+
+
+static void ckht_done(void)
+{
+  if (ckht_initialized)
+  {
+    ck_ht_destroy(&ckht);
+    ckht_initialized = false;
+  }
+
+  for (size_t i = 0; i < ckht_ndeferred; i++)
+    free(ckht_deferred[i]);
+
+  free(ckht_deferred);
+  ckht_deferred = NULL;
+  ckht_ndeferred = 0;
+}
+
+
+static bool ckht_get(const char *key, uint64_t hash, char *val)
+{
+  const ck_ht_hash_t h = { hash };
+  ck_ht_entry_t      entry;
+
+  ck_ht_entry_key_set(&entry, key, (uint16_t) kv_key_size);
+
+  if (!ck_ht_get_spmc(&ckht, h, &entry))
+    return false;
+
+  kv_value_get(ck_ht_entry_value(&entry), val);
+
+  return true;
+}
+
+
+static int ckht_put(const char *key, uint64_t hash, kv_item_t *item,
+                    const char *val)
+{
+  const ck_ht_hash_t h = { hash };
+  ck_ht_entry_t      entry;
+  int                rc = 0;
+
+  pthread_mutex_lock(&ckht_mutex);
+
+  ck_ht_entry_key_set(&entry, key, (uint16_t) kv_key_size);
+
+  if (ck_ht_get_spmc(&ckht, h, &entry))
+    kv_value_set(ck_ht_entry_value(&entry), val);
+  else
+  {
+    kv_value_set(item, val);
+    ck_ht_entry_set(&entry, h, item->data, (uint16_t) kv_key_size, item);
+    rc = !ck_ht_put_spmc(&ckht, h, &entry);
+  }
+
+  pthread_mutex_unlock(&ckht_mutex);
+
+  return rc;
+}
+
+
+static void ckht_del(const char *key, uint64_t hash)
+{
+  const ck_ht_hash_t h = { hash };
+  ck_ht_entry_t      entry;
+
+  pthread_mutex_lock(&ckht_mutex);
+
+  ck_ht_entry_key_set(&entry, key, (uint16_t) kv_key_size);
+  ck_ht_remove_spmc(&ckht, h, &entry);
+
+  pthread_mutex_unlock(&ckht_mutex);
+}
+
+/*
+  simd map. The low bits of a hash select a group of slots in a shard, the
+  next ones select the shard and the top 7 bits are the tag stored in the
+  control byte of a full slot. Groups are probed in triangular order, which
+  visits all groups of a power of 2 sized table. A lookup stops at the first
+  group with an empty slot, so a deleted slot becomes empty only if its group
+  already has one, otherwise it is marked deleted until the shard is rebuilt.
+*/
+
+#define KV_GROUP     16
+#define KV_EMPTY     0x80
+#define KV_DELETED   0xFE
+
+/* Maximum load including deleted slots, in 1/8 */
+#define KV_MAX_LOAD  7
+
+/* Bit masks of slots in a group, slot i is bit i * KV_MASK_STRIDE */
+#if defined(KV_SSE2_PROBE)
+
+# define KV_PROBE_NAME "SSE2"
+# define KV_MASK_STRIDE 1
+
+static inline uint64_t kv_group_match(const uint8_t *ctrl, uint8_t b)
+{
+  const __m128i g = _mm_loadu_si128((const __m128i *) ctrl);
+
+  return (uint64_t) _mm_movemask_epi8(_mm_cmpeq_epi8(g,
+                                                     _mm_set1_epi8((char) b)));
+}
+
+/* Empty and deleted slots, i.e. control bytes with the high bit set */
+static inline uint64_t kv_group_free(const uint8_t *ctrl)
+{
+  return (uint64_t) _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) ctrl));
+}
+
+#elif defined(KV_NEON_PROBE)
+
+# define KV_PROBE_NAME "NEON"
+# define KV_MASK_STRIDE 4
+
+/* Narrow a vector of 0x00/0xFF bytes to a nibble per byte, keep one bit */
+static inline uint64_t kv_neon_mask(uint8x16_t v)
+{
+  const uint8x8_t n = vshrn_n_u16(vreinterpretq_u16_u8(v), 4);
+
+  return vget_lane_u64(vreinterpret_u64_u8(n), 0) & 0x8888888888888888ULL;
+}
+
+static inline uint64_t kv_group_match(const uint8_t *ctrl, uint8_t b)
+{
+  return kv_neon_mask(vceqq_u8(vld1q_u8(ctrl), vdupq_n_u8(b)));
+}
+
+static inline uint64_t kv_group_free(const uint8_t *ctrl)
+{
+  return kv_neon_mask(vcltzq_s8(vreinterpretq_s8_u8(vld1q_u8(ctrl))));
+}
+
+#else
+
+# define KV_PROBE_NAME "scalar"
+# define KV_MASK_STRIDE 1
+
+static inline uint64_t kv_group_match(const uint8_t *ctrl, uint8_t b)
+{
+  uint64_t m = 0;
+
+  for (unsigned int i = 0; i < KV_GROUP; i++)
+    m |= (uint64_t) (ctrl[i] == b) << i;
+
+  return m;
+}
+
+static inline uint64_t kv_group_free(const uint8_t *ctrl)
+{
+  uint64_t m = 0;
+
+  for (unsigned int i = 0; i < KV_GROUP; i++)
+    m |= (uint64_t) (ctrl[i] >> 7) << i;
+
+  return m;
+}
+
+#endif
+
+/* Index of the lowest slot in a non-zero group mask */
+#define KV_MASK_SLOT(m) ((unsigned int) __builtin_ctzll(m) / KV_MASK_STRIDE)
+
+static kv_shard_t   *simd_shards;
+static unsigned int simd_nshards;
+
+
+static inline kv_shard_t *simd_shard(uint64_t hash)
+{
+  return &simd_shards[(hash >> 32) & (simd_nshards - 1)];
+}
+
+
+static inline uint8_t simd_tag(uint64_t hash)
+{
+  return (uint8_t) (hash >> 57);
+}
+
+
+static int simd_alloc(kv_shard_t *s, uint64_t ngroups)
+{
+  const uint64_t nslots = ngroups * KV_GROUP;
+
+  s->ctrl = sb_memalign(nslots, CK_MD_CACHELINE);
+  s->slots = malloc(nslots * sizeof(kv_item_t *));
+
+  if (s->ctrl == NULL || s->slots == NULL)
+  {
+    free(s->ctrl);
+    free(s->slots);
+    return 1;
+  }
+
+  memset(s->ctrl, KV_EMPTY, nslots);
+  s->mask = ngroups - 1;
+  s->used = 0;
+  s->live = 0;
+
+  return 0;
+}
+
+
+/* Return the first free slot in the probe sequence of a hash */
+
+static uint64_t simd_free_slot(kv_shard_t *s, uint64_t hash)
+{
+  uint64_t g = hash & s->mask;
+
+  for (uint64_t i = 1;; g = (g + i++) & s->mask)
+  {
+    const uint64_t m = kv_group_free(s->ctrl + g * KV_GROUP);
+
+    if (m != 0)
+      return g * KV_GROUP + KV_MASK_SLOT(m);
+  }
+}
+
+
+static void simd_set(kv_shard_t *s, uint64_t idx, kv_item_t *item)
+{
+  if (s->ctrl[idx] == KV_EMPTY)
+    s->used++;
+  s->live++;
+
+  s->ctrl[idx] = simd_tag(item->hash);
+  s->slots[idx] = item;
+}
+
+
+/* Rehash a shard into 'ngroups' groups, dropping deleted slots */
+
+static int simd_rebuild(kv_shard_t *s, uint64_t ngroups)
+{
+  uint8_t        * const ctrl = s->ctrl;
+  kv_item_t      ** const slots = s->slots;
+  const uint64_t nslots = (s->mask + 1) * KV_GROUP;
+
+  if (simd_alloc(s, ngroups))
+  {
+    s->ctrl = ctrl;
+    s->slots = slots;
+    return 1;
+  }
+
+  for (uint64_t i = 0; i < nslots; i++)
+    if (ctrl[i] < KV_EMPTY)
+      simd_set(s, simd_free_slot(s, slots[i]->hash), slots[i]);
+
+  free(ctrl);
+  free(slots);
+
+  return 0;
+}
+
+
+static int simd_init(void)
+{
+  /* Expect up to twice the average number of keys per shard */
+  const uint64_t keys = (kv_keys * 2ULL + kv_stripes - 1) / kv_stripes;
+  const uint64_t ngroups = kv_pow2_ceil((keys + KV_GROUP - 1) / KV_GROUP);
+
+  simd_nshards = kv_stripes;
+  simd_shards = sb_memalign(simd_nshards * sizeof(kv_shard_t),
+                            CK_MD_CACHELINE);
+  if (simd_shards == NULL)
+    return 1;
+
+  memset(simd_shards, 0, simd_nshards * sizeof(kv_shard_t));
+
+  for (unsigned int i = 0; i < simd_nshards; i++)
+  {
+    pthread_rwlock_init(&simd_shards[i].lock, NULL);
+    if (simd_alloc(&simd_shards[i], ngroups))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+static void simd_done(void)
+{
+  for (unsigned int i = 0; simd_shards != NULL && i < simd_nshards; i++)
+  {
+    pthread_rwlock_destroy(&simd_shards[i].lock);
+    free(simd_shards[i].ctrl);
+    free(simd_shards[i].slots);
+  }
+
+  free(simd_shards);
+  simd_shards = NULL;
+}
+
+
+/* Return the slot index of a key, or -1 if it is not found */
+
+static int64_t simd_find(kv_shard_t *s, const char *key, uint64_t hash)
+{
+  const uint8_t tag = simd_tag(hash);
+  uint64_t      g = hash & s->mask;
+
+  for (uint64_t i = 1;; g = (g + i++) & s->mask)
+  {
+    const uint8_t * const ctrl = s->ctrl + g * KV_GROUP;
+
+    for (uint64_t m = kv_group_match(ctrl, tag); m != 0; m &= m - 1)
+    {
+      const uint64_t idx = g * KV_GROUP + KV_MASK_SLOT(m);
+
+      if (kv_key_eq(s->slots[idx], key, hash))
+        return (int64_t) idx;
+    }
+
+    if (kv_group_match(ctrl, KV_EMPTY) != 0 || i > s->mask)
+      return -1;
+  }
+}
+
+
+static bool simd_get(const char *key, uint64_t hash, char *val)
+{
+  kv_shard_t * const s = simd_shard(hash);
+  int64_t          idx;
+
+  pthread_rwlock_rdlock(&s->lock);
+
+  if ((idx = simd_find(s, key, hash)) >= 0)
+    kv_value_get(s->slots[idx], val);
+
+  pthread_rwlock_unlock(&s->lock);
+
+  return idx >= 0;
+}
+
+
+static int simd_put(const char *key, uint64_t hash, kv_item_t *item,
+                    const char *val)
+{
+  kv_shard_t * const s = simd_shard(hash);
+  int64_t          idx;
+  int              rc = 0;
+
+  pthread_rwlock_wrlock(&s->lock);
+
+  if ((idx = simd_find(s, key, hash)) < 0)
+  {
+    const uint64_t nslots = (s->mask + 1) * KV_GROUP;
+    uint64_t       free_idx = simd_free_slot(s, hash);
+
+    /* Using an empty slot may exceed the load, rebuild or grow the shard */
+    if (s->ctrl[free_idx] == KV_EMPTY &&
+        (s->used + 1) * 8 > nslots * KV_MAX_LOAD)
+    {
+      const uint64_t ngroups = (s->mask + 1) *
+        ((s->live + 1) * 2 > nslots ? 2 : 1);
+
+      if ((rc = simd_rebuild(s, ngroups)) != 0)
+        goto end;
+
+      free_idx = simd_free_slot(s, hash);
+    }
+
+    simd_set(s, free_idx, item);
+    idx = (int64_t) free_idx;
+  }
+
+  kv_value_set(s->slots[idx], val);
+
+ end:
+  pthread_rwlock_unlock(&s->lock);
+
+  return rc;
+}
+
+
+static void simd_del(const char *key, uint64_t hash)
+{
+  kv_shard_t * const s = simd_shard(hash);
+  int64_t          idx;
+
+  pthread_rwlock_wrlock(&s->lock);
+
+  if ((idx = simd_find(s, key, hash)) >= 0)
+  {
+    const uint8_t * const group = s->ctrl + (idx / KV_GROUP) * KV_GROUP;
+
+    if (kv_group_match(group, KV_EMPTY) != 0)
+    {
+      s->ctrl[idx] = KV_EMPTY;
+      s->used--;
+    }
+    else
+      s->ctrl[idx] = KV_DELETED;
+
+    s->live--;
+  }
+
+  pthread_rwlock_unlock(&s->lock);
+}
+
+
+static const kv_map_ops_t kv_map_ops[] =
+{
+  {striped_init, striped_done, striped_get, striped_put, striped_del},
+  {ckht_init, ckht_done, ckht_get, ckht_put, ckht_del},
+  {simd_init, simd_done, simd_get, simd_put, simd_del}
+};
+
+
+static int kv_parse_enum(const char *opt, const char **names)
+{
+  const char * const val = sb_get_value_string(opt);
+
+  for (int i = 0; val != NULL && names[i] != NULL; i++)
+    if (!strcmp(val, names[i]))
+      return i;
+
+  log_text(LOG_FATAL, "Invalid value for %s: %s", opt,
+           val != NULL ? val : "");
+
+  return -1;
+}
+
+
+/* Get an integer option between 'min' and 'max', returns -1 otherwise */
+
+static int kv_get_uint(const char *opt, int min, int max)
+{
+  const int val = sb_get_value_int(opt);
+
+  if (val < min || val > max)
+  {
+    log_text(LOG_FATAL, "Invalid value for %s: %d", opt, val);
+    return -1;
+  }
+
+  return val;
+}
+
+
+/* Fill the map with --kv-prefill percent of keys, chosen by hash */
+
+static int kv_prefill_map(void)
+{
+  char * const val = calloc(1, kv_value_size);
+
+  if (val == NULL)
+    return 1;
+
+  for (uint64_t id = 0; id < kv_keys; id++)
+  {
+    kv_item_t * const item = kv_item(id);
+
+    if (kv_hash(&id, sizeof(id)) % 100 >= kv_prefill)
+      continue;
+
+    if (kv_ops->put(item->data, item->hash, item, val))
+    {
+      free(val);
+      return 1;
+    }
+  }
+
+  free(val);
+
+  return 0;
+}
+
+
+int kv_init(void)
+{
+  int i;
+
+  if ((i = kv_parse_enum("kv-map", kv_map_names)) < 0)
+    return 1;
+  kv_map = (kv_map_t) i;
+  kv_ops = &kv_map_ops[kv_map];
+
+  if ((i = kv_get_uint("kv-keys", 1, INT32_MAX)) < 0)
+    return 1;
+  kv_keys = (unsigned int) i;
+
+  kv_key_digits = 1;
+  for (unsigned int n = kv_keys - 1; n >= 10; n /= 10)
+    kv_key_digits++;
+
+  kv_key_size = sb_get_value_size("kv-key-size");
+  if (kv_key_size < kv_key_digits || kv_key_size > KV_KEY_MAX)
+  {
+    log_text(LOG_FATAL, "--kv-key-size must be between %u and %u bytes for "
+             "%u keys", kv_key_digits, KV_KEY_MAX, kv_keys);
+    return 1;
+  }
+
+  kv_value_size = sb_get_value_size("kv-value-size");
+  if (kv_value_size == 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for kv-value-size: 0");
+    return 1;
+  }
+
+  if ((i = kv_get_uint("kv-prefill", 0, 100)) < 0)
+    return 1;
+  kv_prefill = (unsigned int) i;
+
+  if ((i = kv_get_uint("kv-get-ratio", 0, INT32_MAX / 4)) < 0)
+    return 1;
+  kv_get_ratio = (unsigned int) i;
+
+  if ((i = kv_get_uint("kv-put-ratio", 0, INT32_MAX / 4)) < 0)
+    return 1;
+  kv_put_ratio = (unsigned int) i;
+
+  if ((i = kv_get_uint("kv-delete-ratio", 0, INT32_MAX / 4)) < 0)
+    return 1;
+  kv_delete_ratio = (unsigned int) i;
+
+  if (kv_get_ratio + kv_put_ratio + kv_delete_ratio == 0)
+  {
+    log_text(LOG_FATAL, "At least one of --kv-get-ratio, --kv-put-ratio and "
+             "--kv-delete-ratio must be positive");
+    return 1;
+  }
+
+  if ((i = kv_get_uint("kv-stripes", 1, KV_STRIPES_MAX)) < 0)
+    return 1;
+  kv_stripes = (unsigned int) kv_pow2_ceil((uint64_t) i);
+
+  if ((i = kv_get_uint("kv-batch-size", 1, INT32_MAX)) < 0)
+    return 1;
+  kv_batch_size = (unsigned int) i;
+
+  kv_threads = sb_alloc_per_thread_array(sizeof(kv_thread_t));
+  kv_item_size = SB_ALIGN(sizeof(kv_item_t) + kv_key_size + kv_value_size,
+                          sizeof(uint64_t));
+  kv_items = malloc((size_t) kv_keys * kv_item_size);
+
+  if (kv_threads == NULL || kv_items == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  memset(&kv_interm, 0, sizeof(kv_interm));
+  memset(&kv_cumul, 0, sizeof(kv_cumul));
+
+  for (uint64_t id = 0; id < kv_keys; id++)
+  {
+    kv_item_t * const item = kv_item(id);
+
+    item->next = NULL;
+    memset(item->data, '0', kv_key_size);
+    kv_format_key(item->data, id);
+    item->hash = kv_hash(item->data, kv_key_size);
+    memset(item->data + kv_key_size, 0, kv_value_size);
+  }
+
+  if (kv_ops->init() || kv_prefill_map())
+  {
+    log_text(LOG_FATAL, "Cannot create the %s map: memory allocation failure",
+             kv_map_names[kv_map]);
+    return 1;
+  }
+
+  return 0;
+}
+
+
+int kv_done(void)
+{
+  if (kv_ops != NULL)
+    kv_ops->done();
+
+  free(kv_items);
+  free(kv_threads);
+  kv_items = NULL;
+  kv_threads = NULL;
+
+  return 0;
+}
+
+
+int kv_thread_init(int thread_id)
+{
+  kv_thread_t * const t = &kv_threads[thread_id];
+
+  t->key = malloc(kv_key_size);
+  t->value = malloc(kv_value_size);
+
+  if (t->key == NULL || t->value == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  memset(t->key, '0', kv_key_size);
+  memset(t->value, 'a' + thread_id % 26, kv_value_size);
+
+  return 0;
+}
+
+
+int kv_thread_done(int thread_id)
+{
+  kv_thread_t * const t = &kv_threads[thread_id];
+
+  free(t->key);
+  free(t->value);
+  t->key = NULL;
+  t->value = NULL;
+
+  return 0;
+}
+
+
+sb_event_t kv_next_event(int thread_id)
+{
+  sb_event_t req;
+
+  (void) thread_id; /* unused */
+
+  req.type = SB_REQ_TYPE_KV;
+
+  return req;
+}
+
+
+int kv_execute_event(sb_event_t *r, int thread_id)
+{
+  kv_thread_t * const t = &kv_threads[thread_id];
+  const uint32_t      total = kv_get_ratio + kv_put_ratio + kv_delete_ratio;
+
+  (void) r; /* unused */
+
+  for (unsigned int i = 0; i < kv_batch_size; i++)
+  {
+    const uint64_t id = sb_rand_default(1, kv_keys) - 1;
+    const uint32_t op = sb_rand_uniform(1, total);
+    uint64_t       hash;
+
+    kv_format_key(t->key, id);
+    hash = kv_hash(t->key, kv_key_size);
+
+    if (op <= kv_get_ratio)
+    {
+      if (kv_ops->get(t->key, hash, t->value))
+        ck_pr_store_64(&t->hits, t->hits + 1);
+      ck_pr_store_64(&t->gets, t->gets + 1);
+    }
+    else if (op <= kv_get_ratio + kv_put_ratio)
+    {
+      if (kv_ops->put(t->key, hash, kv_item(id), t->value))
+      {
+        log_text(LOG_FATAL, "Cannot insert into the %s map: memory "
+                 "allocation failure", kv_map_names[kv_map]);
+        return 1;
+      }
+      ck_pr_store_64(&t->puts, t->puts + 1);
+    }
+    else
+    {
+      kv_ops->del(t->key, hash);
+      ck_pr_store_64(&t->deletes, t->deletes + 1);
+    }
+  }
+
+  return 0;
+}
+
+
+void kv_print_mode(void)
+{
+  const double total = kv_get_ratio + kv_put_ratio + kv_delete_ratio;
+
+  log_text(LOG_INFO, "Doing key-value map test\n");
+
+  switch (kv_map) {
+  case KV_MAP_STRIPED:
+    log_text(LOG_NOTICE, "Map: striped, %u lock stripes", kv_stripes);
+    break;
+  case KV_MAP_CK_HT:
+    log_text(LOG_NOTICE, "Map: ck_ht, lock-free reads, serialized writes");
+    break;
+  case KV_MAP_SIMD:
+    log_text(LOG_NOTICE, "Map: simd, %u shards, %s probing", kv_stripes,
+             KV_PROBE_NAME);
+    break;
+  }
+
+  log_text(LOG_NOTICE, "Keys: %u, %zu-byte keys, %zu-byte values, %u%% "
+           "prefilled", kv_keys, kv_key_size, kv_value_size, kv_prefill);
+  log_text(LOG_NOTICE, "Operations: get %.0f%%, put %.0f%%, delete %.0f%%, "
+           "%u per event\n", kv_get_ratio * 100 / total,
+           kv_put_ratio * 100 / total, kv_delete_ratio * 100 / total,
+           kv_batch_size);
+}
+
+
+static void kv_get_totals(kv_totals_t *tot)
+{
+  memset(tot, 0, sizeof(*tot));
+
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+  {
+    tot->gets += ck_pr_load_64(&kv_threads[i].gets);
+    tot->hits += ck_pr_load_64(&kv_threads[i].hits);
+    tot->puts += ck_pr_load_64(&kv_threads[i].puts);
+    tot->deletes += ck_pr_load_64(&kv_threads[i].deletes);
+  }
+}
+
+
+/* Percentage of gets which found the key */
+
+static double kv_hit_ratio(const kv_totals_t *cur, const kv_totals_t *prev)
+{
+  const uint64_t gets = cur->gets - prev->gets;
+
+  return gets > 0 ? (cur->hits - prev->hits) * 100.0 / gets : 0;
+}
+
+
+/* Print intermediate stats. */
+
+void kv_report_intermediate(sb_stat_t *stat)
+{
+  kv_totals_t  tot;
+  const double seconds = stat->time_interval;
+
+  sb_report_intermediate(stat);
+
+  kv_get_totals(&tot);
+
+  log_timestamp(LOG_NOTICE, stat->time_total, "gets: %4.2f/s hits: %.2f%% "
+                "puts: %4.2f/s deletes: %4.2f/s",
+                (tot.gets - kv_interm.gets) / seconds,
+                kv_hit_ratio(&tot, &kv_interm),
+                (tot.puts - kv_interm.puts) / seconds,
+                (tot.deletes - kv_interm.deletes) / seconds);
+
+  kv_interm = tot;
+}
+
+
+/* Print cumulative stats. */
+
+void kv_report_cumulative(sb_stat_t *stat)
+{
+  kv_totals_t  tot;
+  const double seconds = stat->time_interval;
+
+  kv_get_totals(&tot);
+
+  log_text(LOG_NOTICE, "Key-value operations:");
+  log_text(LOG_NOTICE, "    gets:         %10" PRIu64 " (%.2f per second)",
+           tot.gets - kv_cumul.gets, (tot.gets - kv_cumul.gets) / seconds);
+  log_text(LOG_NOTICE, "    hits:         %10.2f%%",
+           kv_hit_ratio(&tot, &kv_cumul));
+  log_text(LOG_NOTICE, "    puts:         %10" PRIu64 " (%.2f per second)",
+           tot.puts - kv_cumul.puts, (tot.puts - kv_cumul.puts) / seconds);
+  log_text(LOG_NOTICE, "    deletes:      %10" PRIu64 " (%.2f per second)",
+           tot.deletes - kv_cumul.deletes,
+           (tot.deletes - kv_cumul.deletes) / seconds);
+
+  kv_cumul = tot;
+
+  sb_report_cumulative(stat);
+}
@@ -0,0 +1,547 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Memory allocator test. Each event allocates one block and frees one block,
+  block sizes are generated by sb_rand according to --rand-type. Different
+  allocators can be compared by running the test with LD_PRELOAD.
+
+  Allocation patterns:
+  - pairs: the block is freed right after allocation
+  - churn: each thread keeps --malloc-live blocks alive and replaces a random
+    one on each event, which fragments the heap over time
+  - cross: blocks are passed to the next thread through a ring and freed
+    there, so most frees are remote frees
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STDLIB_H
+# include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_SYS_TIME_H
+# include <sys/time.h>
+#endif
+#include <sys/resource.h>
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "sysbench.h"
+#include "sb_rand.h"
+#include "sb_util.h"
+
+#include "ck_ring.h"
+
+/* Malloc test arguments */
+static sb_arg_t malloc_args[] =
+{
+  SB_OPT("malloc-pattern", "allocation pattern {pairs, churn, cross}",
+         "churn", STRING),
+  SB_OPT("malloc-min-size", "minimum block size", "16", SIZE),
+  SB_OPT("malloc-max-size", "maximum block size, sizes between the minimum "
+         "and the maximum are distributed according to --rand-type", "4K",
+         SIZE),
+  SB_OPT("malloc-large-pct", "percentage of large blocks with sizes "
+         "uniformly distributed between --malloc-max-size and "
+         "--malloc-large-size", "0", INT),
+  SB_OPT("malloc-large-size", "maximum size of large blocks", "1M", SIZE),
+  SB_OPT("malloc-live", "number of blocks kept alive by each thread with "
+         "--malloc-pattern=churn, or in flight between each pair of threads "
+         "with --malloc-pattern=cross", "4096", INT),
+
+  SB_OPT_END
+};
+
+typedef enum
+{
+  MALLOC_PAIRS,
+  MALLOC_CHURN,
+  MALLOC_CROSS
+} malloc_pattern_t;
+
+static const char *malloc_pattern_names[] =
+{
+  "pairs", "churn", "cross", NULL
+};
+
+/* Malloc test operations */
+static int malloc_init(void);
+static int malloc_thread_init(int);
+static int malloc_thread_done(int);
+static void malloc_print_mode(void);
+static sb_event_t malloc_next_event(int);
+static int malloc_execute_event(sb_event_t *, int);
+static void malloc_report_intermediate(sb_stat_t *);
+static void malloc_report_cumulative(sb_stat_t *);
+static int malloc_done(void);
+
+static sb_test_t malloc_test =
+{
+  .sname = "malloc",
+  .lname = "Memory allocator test",
+  .ops = {
+    .init = malloc_init,
+    .thread_init = malloc_thread_init,
+    .thread_done = malloc_thread_done,
+    .print_mode = malloc_print_mode,
+    .next_event = malloc_next_event,
+    .execute_event = malloc_execute_event,
+    .report_intermediate = malloc_report_intermediate,
+    .report_cumulative = malloc_report_cumulative,
+    .done = malloc_done
+  },
+  .args = malloc_args
+};
+
+typedef struct
+{
+  void             **live;      /* live blocks for the churn pattern */
+
+  /* Incoming blocks from the previous thread for the cross pattern */
+  ck_ring_t        ring CK_CC_CACHELINE;
+  ck_ring_buffer_t *ring_buffer;
+
+  uint64_t         frees;       /* number of blocks freed */
+  uint64_t         remote_frees; /* ... of them allocated by another thread */
+
+  int64_t          rss_final;   /* RSS when the thread finished the run */
+} malloc_thread_t;
+
+static malloc_pattern_t malloc_pattern;
+static size_t           malloc_min_size;
+static size_t           malloc_max_size;
+static unsigned int     malloc_large_pct;
+static size_t           malloc_large_size;
+static unsigned int     malloc_live;
+static unsigned int     malloc_ring_size;
+
+static malloc_thread_t  *malloc_threads;
+
+static long             malloc_page_size;
+
+/* RSS at the start of the test and at the last intermediate report */
+static int64_t          rss_initial;
+static int64_t          rss_last;
+
+
+int register_test_malloc(sb_list_t *tests)
+{
+  SB_LIST_ADD_TAIL(&malloc_test.listitem, tests);
+
+  return 0;
+}
+
+
+/* Current resident set size in bytes, or -1 if it is not available */
+
+static int64_t malloc_rss(void)
+{
+  FILE    *fp;
+  int64_t size, resident;
+  int     n;
+
+  if ((fp = fopen("/proc/self/statm", "r")) == NULL)
+    return -1;
+
+  n = fscanf(fp, "%" SCNd64 " %" SCNd64, &size, &resident);
+  fclose(fp);
+
+  return n == 2 ? resident * malloc_page_size : -1;
+}
+
+
+/* Peak resident set size of the process in bytes */
+
+static int64_t malloc_rss_peak(void)
+{
+  struct rusage ru;
+
+  if (getrusage(RUSAGE_SELF, &ru))
+    return -1;
+
+#ifdef __APPLE__
+  return ru.ru_maxrss;
+#else
+  return (int64_t) ru.ru_maxrss * 1024;
+#endif
+}
+
+
+int malloc_init(void)
+{
+  const char         *s;
+  int                i;
+  const unsigned int nthreads = sb_globals.threads;
+
+  s = sb_get_value_string("malloc-pattern");
+  for (i = 0; malloc_pattern_names[i] != NULL; i++)
+    if (!strcmp(malloc_pattern_names[i], s))
+      break;
+  if (malloc_pattern_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for malloc-pattern: %s", s);
+    return 1;
+  }
+  malloc_pattern = (malloc_pattern_t) i;
+
+  malloc_min_size = sb_get_value_size("malloc-min-size");
+  malloc_max_size = sb_get_value_size("malloc-max-size");
+  malloc_large_size = sb_get_value_size("malloc-large-size");
+
+  if (malloc_min_size == 0 || malloc_min_size > malloc_max_size ||
+      malloc_max_size > UINT32_MAX)
+  {
+    log_text(LOG_FATAL, "Invalid block size range: %zu-%zu", malloc_min_size,
+             malloc_max_size);
+    return 1;
+  }
+
+  i = sb_get_value_int("malloc-large-pct");
+  if (i < 0 || i > 100)
+  {
+    log_text(LOG_FATAL, "Invalid value for malloc-large-pct: %d", i);
+    return 1;
+  }
+  malloc_large_pct = (unsigned int) i;
+
+  if (malloc_large_pct > 0 &&
+      (malloc_large_size <= malloc_max_size || malloc_large_size > UINT32_MAX))
+  {
+    log_text(LOG_FATAL, "--malloc-large-size must be greater than "
+             "--malloc-max-size");
+    return 1;
+  }
+
+  i = sb_get_value_int("malloc-live");
+  if (i <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for malloc-live: %d", i);
+    return 1;
+  }
+  malloc_live = (unsigned int) i;
+
+  if (malloc_pattern == MALLOC_CROSS)
+  {
+    if (nthreads < 2)
+    {
+      log_text(LOG_FATAL, "--malloc-pattern=cross requires at least 2 "
+               "threads");
+      return 1;
+    }
+
+    /* ck_ring capacity must be a power of 2, one slot is always unused */
+    malloc_ring_size = 2;
+    while (malloc_ring_size <= malloc_live)
+      malloc_ring_size *= 2;
+  }
+
+  malloc_threads = sb_memalign(nthreads * sizeof(malloc_thread_t),
+                               CK_MD_CACHELINE);
+  if (malloc_threads == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  memset(malloc_threads, 0, nthreads * sizeof(malloc_thread_t));
+  for (unsigned int t = 0; t < nthreads; t++)
+    malloc_threads[t].rss_final = -1;
+
+  if (malloc_pattern == MALLOC_CROSS)
+  {
+    for (unsigned int t = 0; t < nthreads; t++)
+    {
+      malloc_threads[t].ring_buffer =
+        malloc(malloc_ring_size * sizeof(ck_ring_buffer_t));
+      if (malloc_threads[t].ring_buffer == NULL)
+      {
+        log_text(LOG_FATAL, "Memory allocation failure");
+        return 1;
+      }
+
+      ck_ring_init(&malloc_threads[t].ring, malloc_ring_size);
+    }
+  }
+
+  malloc_page_size = sysconf(_SC_PAGESIZE);
+  if (malloc_page_size <= 0)
+    malloc_page_size = 4096;
+
+  rss_initial = rss_last = malloc_rss();
+
+  return 0;
+}
+
+
+/* Generate a block size */
+
+static size_t malloc_size(void)
+{
+  if (malloc_large_pct > 0 && sb_rand_uniform(1, 100) <= malloc_large_pct)
+    return sb_rand_uniform(malloc_max_size + 1, malloc_large_size);
+
+  return sb_rand_default(malloc_min_size, malloc_max_size);
+}
+
+
+/*
+  Allocate a block and write to each of its pages, so it is actually backed by
+  memory and counted in RSS
+*/
+
+static void *malloc_block(void)
+{
+  const size_t  size = malloc_size();
+  unsigned char *p = malloc(size);
+
+  if (SB_UNLIKELY(p == NULL))
+  {
+    log_text(LOG_FATAL, "Failed to allocate %zu bytes", size);
+    return NULL;
+  }
+
+  for (size_t off = 0; off < size; off += malloc_page_size)
+    p[off] = (unsigned char) off;
+  p[size - 1] = 0;
+
+  return p;
+}
+
+
+int malloc_thread_init(int thread_id)
+{
+  malloc_thread_t * const t = &malloc_threads[thread_id];
+
+  if (malloc_pattern != MALLOC_CHURN)
+    return 0;
+
+  t->live = malloc(malloc_live * sizeof(void *));
+  if (t->live == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  /* Start with a full working set, so the test runs in a steady state */
+  for (unsigned int i = 0; i < malloc_live; i++)
+    if ((t->live[i] = malloc_block()) == NULL)
+      return 1;
+
+  return 0;
+}
+
+
+int malloc_thread_done(int thread_id)
+{
+  malloc_thread_t * const t = &malloc_threads[thread_id];
+
+  /* Worker threads are done before the final report, sample RSS here */
+  t->rss_final = malloc_rss();
+
+  if (t->live != NULL)
+  {
+    for (unsigned int i = 0; i < malloc_live; i++)
+      free(t->live[i]);
+
+    free(t->live);
+    t->live = NULL;
+  }
+
+  return 0;
+}
+
+
+int malloc_done(void)
+{
+  const unsigned int nthreads = sb_globals.threads;
+
+  if (malloc_threads == NULL)
+    return 0;
+
+  /* Blocks passed to threads that have already finished */
+  for (unsigned int t = 0; t < nthreads; t++)
+  {
+    void *p;
+
+    if (malloc_threads[t].ring_buffer == NULL)
+      continue;
+
+    while (ck_ring_dequeue_spsc(&malloc_threads[t].ring,
+                                malloc_threads[t].ring_buffer, &p))
+      free(p);
+
+    free(malloc_threads[t].ring_buffer);
+  }
+
+  free(malloc_threads);
+  malloc_threads = NULL;
+
+  return 0;
+}
+
+
+sb_event_t malloc_next_event(int thread_id)
+{
+  sb_event_t req;
+
+  (void) thread_id; /* unused */
+
+  req.type = SB_REQ_TYPE_MALLOC;
+
+  return req;
+}
+
+
+int malloc_execute_event(sb_event_t *r, int thread_id)
+{
+  malloc_thread_t * const t = &malloc_threads[thread_id];
+  void                    *p;
+
+  (void) r; /* unused */
+
+  switch (malloc_pattern) {
+  case MALLOC_PAIRS:
+    if ((p = malloc_block()) == NULL)
+      return 1;
+    free(p);
+    t->frees++;
+    break;
+
+  case MALLOC_CHURN:
+    {
+      const uint32_t i = sb_rand_uniform(0, malloc_live - 1);
+
+      free(t->live[i]);
+      t->frees++;
+      if ((t->live[i] = malloc_block()) == NULL)
+        return 1;
+    }
+    break;
+
+  case MALLOC_CROSS:
+    {
+      malloc_thread_t * const next =
+        &malloc_threads[(thread_id + 1) % sb_globals.threads];
+      void                    *q;
+
+      if (ck_ring_dequeue_spsc(&t->ring, t->ring_buffer, &q))
+      {
+        free(q);
+        t->frees++;
+        t->remote_frees++;
+      }
+
+      if ((p = malloc_block()) == NULL)
+        return 1;
+
+      /* Do not wait for a slow consumer, free the block locally instead */
+      if (ck_ring_size(&next->ring) >= malloc_live ||
+          !ck_ring_enqueue_spsc(&next->ring, next->ring_buffer, p))
+      {
+        free(p);
+        t->frees++;
+      }
+    }
+    break;
+  }
+
+  return 0;
+}
+
+
+void malloc_print_mode(void)
+{
+  log_text(LOG_INFO, "Doing memory allocator test\n");
+
+  log_text(LOG_NOTICE, "Pattern: %s, block sizes: %zu-%zu bytes (%s)",
+           malloc_pattern_names[malloc_pattern], malloc_min_size,
+           malloc_max_size, sb_get_value_string("rand-type"));
+  if (malloc_large_pct > 0)
+    log_text(LOG_NOTICE, "Large blocks: %u%%, up to %zu bytes",
+             malloc_large_pct, malloc_large_size);
+  if (malloc_pattern != MALLOC_PAIRS)
+    log_text(LOG_NOTICE, "Live blocks: %u per thread", malloc_live);
+  log_text(LOG_NOTICE, "");
+}
+
+
+static double mib(int64_t bytes)
+{
+  return bytes / (1024.0 * 1024.0);
+}
+
+
+void malloc_report_intermediate(sb_stat_t *stat)
+{
+  const int64_t rss = malloc_rss();
+
+  sb_report_intermediate(stat);
+
+  if (rss < 0)
+    return;
+
+  log_timestamp(LOG_NOTICE, stat->time_total, "rss: %.2f MiB (%+.2f MiB)",
+                mib(rss), mib(rss - rss_last));
+
+  rss_last = rss;
+}
+
+
+/* Print cumulative stats. */
+
+void malloc_report_cumulative(sb_stat_t *stat)
+{
+  int64_t  rss = -1;
+  uint64_t frees = 0, remote_frees = 0;
+
+  /* Use the largest RSS among finished threads, if any */
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+    rss = SB_MAX(rss, malloc_threads[i].rss_final);
+  if (rss < 0)
+    rss = malloc_rss();
+
+  log_text(LOG_NOTICE, "Operations: %" PRIu64 " (%.2f per second)",
+           stat->events, stat->events / stat->time_interval);
+
+  if (malloc_pattern == MALLOC_CROSS)
+  {
+    for (unsigned int i = 0; i < sb_globals.threads; i++)
+    {
+      frees += malloc_threads[i].frees;
+      remote_frees += malloc_threads[i].remote_frees;
+    }
+
+    log_text(LOG_NOTICE, "Blocks freed by another thread: %.2f%%",
+             frees > 0 ? 100.0 * remote_frees / frees : 0);
+  }
+
+  if (rss >= 0)
+    log_text(LOG_NOTICE, "RSS (MiB): initial %.2f, final %.2f, peak %.2f",
+             mib(rss_initial), mib(rss), mib(malloc_rss_peak()));
+
+  sb_report_cumulative(stat);
+}
@@ -22,6 +22,9 @@
 
 #include "sysbench.h"
 #include "sb_rand.h"
+#include "sb_affinity.h"
+#include "sb_smt.h"
+#include "sb_counter.h"
 
 #ifdef HAVE_SYS_IPC_H
 # include <sys/ipc.h>
@@ -33,6 +36,41 @@
 
 #include <inttypes.h>
 
+#ifdef HAVE_LIMITS_H
+# include <limits.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#include <sys/resource.h>
+
+#if defined(HAVE_SYS_MMAN_H) && defined(MAP_ANONYMOUS) && \
+  defined(MADV_DONTNEED)
+# define SB_MEMORY_FAULTS
+#endif
+
+/* Vectorized kernels, selected at runtime with --memory-kernel */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define SB_MEMORY_X86_KERNELS
+# include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+# define SB_MEMORY_NEON_KERNELS
+# include <arm_neon.h>
+#endif
+
 #define LARGE_PAGE_SIZE (4UL * 1024 * 1024)
 
 /* Memory test arguments */
@@ -40,14 +78,67 @@ static sb_arg_t memory_args[] =
 {
   SB_OPT("memory-block-size", "size of memory block for test", "1K", SIZE),
   SB_OPT("memory-total-size", "total size of data to transfer", "100G", SIZE),
-  SB_OPT("memory-scope", "memory access scope {global,local}", "global",
-         STRING),
+  SB_OPT("memory-scope", "memory access scope {global,local,numa}. 'numa' "
+         "runs threads on each NUMA node against memory of each node in turn "
+         "and prints a node x node matrix", "global", STRING),
 #ifdef HAVE_LARGE_PAGES
   SB_OPT("memory-hugetlb", "allocate memory from HugeTLB pool", "off", BOOL),
 #endif
-  SB_OPT("memory-oper", "type of memory operations {read, write, none}",
-         "write", STRING),
-  SB_OPT("memory-access-mode", "memory access mode {seq,rnd}", "seq", STRING),
+  SB_OPT("memory-pages", "pages for memory buffers {default,thp,2m,1g}. "
+         "'thp' requests transparent huge pages with madvise(), '2m' and '1g' "
+         "allocate explicit huge pages of the given size", "default", STRING),
+  SB_OPT("memory-populate", "pre-fault memory buffers when allocating them",
+         "off", BOOL),
+  SB_OPT("memory-oper", "type of memory operations {read, write, copy, "
+         "triad, mixed, rmw, none}. 'copy' copies a block to another one, "
+         "'triad' computes a[i] = b[i] + q * c[i] over 3 blocks of doubles as "
+         "in STREAM, 'mixed' reads or writes each cache line (each word with "
+         "--memory-access-mode=rnd) as set by --memory-rw-ratio, 'rmw' "
+         "increments each word in place", "write", STRING),
+  SB_OPT("memory-rw-ratio", "percentage of reads for --memory-oper=mixed, "
+         "the rest are writes", "50", INT),
+  SB_OPT("memory-access-mode", "memory access mode {seq,rnd,chase,tlb}. "
+         "'chase' walks a random cyclic chain of dependent loads, one per cache "
+         "line, to measure load latency rather than bandwidth. 'tlb' does the "
+         "same with one load per --memory-stride bytes, so that loads are "
+         "bound by TLB misses and page walks", "seq", STRING),
+  SB_OPT("memory-stride", "distance between loads for "
+         "--memory-access-mode=tlb, 0 means the base page size", "0", SIZE),
+  SB_OPT("memory-kernel", "load/store loop for sequential reads and writes "
+         "{auto,scalar,sse2,avx2,avx512,neon}. 'auto' picks the widest one "
+         "supported by the CPU", "scalar", STRING),
+  SB_OPT("memory-sweep", "run the test for each power of 2 working set size "
+         "from --memory-sweep-min to --memory-sweep-max for an equal share of "
+         "--time, and print a size table with detected cache level "
+         "boundaries. Overrides --memory-block-size", "off", BOOL),
+  SB_OPT("memory-sweep-min", "minimum working set size for --memory-sweep",
+         "4K", SIZE),
+  SB_OPT("memory-sweep-max", "maximum working set size for --memory-sweep",
+         "1G", SIZE),
+  SB_OPT("memory-probe-threads", "number of threads measuring loaded latency "
+         "with pointer chasing while the other threads generate memory "
+         "traffic. Probe latency is reported per event of "
+         "--memory-probe-loads dependent loads", "0", INT),
+  SB_OPT("memory-probe-loads", "number of dependent loads per probe event",
+         "16", INT),
+  SB_OPT("memory-load-delay", "delay in nanoseconds after each block "
+         "accessed by traffic generating threads, to vary the memory load with "
+         "--memory-probe-threads", "0", INT),
+  SB_OPT("memory-rate", "limit the memory traffic of all threads, except "
+         "--memory-probe-threads, to SIZE bytes per second, e.g. to run the "
+         "test as background load at a fixed budget. Each event accounts for "
+         "one block. 0 is unlimited", "0", SIZE),
+  SB_OPT("memory-nt-stores", "use non-temporal (streaming) stores bypassing "
+         "caches for write, copy and triad. Requires a vector --memory-kernel",
+         "off", BOOL),
+  SB_OPT("memory-faults", "measure page faults instead of memory bandwidth "
+         "{off,anon,file,mmap,madvise}. Each event faults in one block. "
+         "'anon' touches fresh anonymous memory, 'file' reads the files "
+         "created by 'sysbench fileio prepare' in the current directory "
+         "through a shared mapping, 'mmap' maps, touches and unmaps a block, "
+         "'madvise' drops a block with madvise(MADV_DONTNEED) and touches it "
+         "again. Fault latency includes the system calls of 'mmap' and "
+         "'madvise'", "off", STRING),
 
   SB_OPT_END
 };
@@ -55,14 +146,30 @@ static sb_arg_t memory_args[] =
 /* Memory test operations */
 static int memory_init(void);
 static int memory_thread_init(int);
+static int memory_thread_done(int);
+static int memory_thread_run(int);
 static void memory_print_mode(void);
 static sb_event_t memory_next_event(int);
+static unsigned int memory_next_events(int, sb_event_t *, unsigned int);
 static int event_rnd_none(sb_event_t *, int);
 static int event_rnd_read(sb_event_t *, int);
 static int event_rnd_write(sb_event_t *, int);
 static int event_seq_none(sb_event_t *, int);
 static int event_seq_read(sb_event_t *, int);
 static int event_seq_write(sb_event_t *, int);
+static int event_rnd_mixed(sb_event_t *, int);
+static int event_seq_mixed(sb_event_t *, int);
+static int event_rnd_rmw(sb_event_t *, int);
+static int event_seq_rmw(sb_event_t *, int);
+static int event_chase(sb_event_t *, int);
+static int event_kernel_read(sb_event_t *, int);
+static int event_kernel_write(sb_event_t *, int);
+static int event_seq_copy(sb_event_t *, int);
+static int event_seq_triad(sb_event_t *, int);
+static int event_kernel_copy(sb_event_t *, int);
+static int event_kernel_triad(sb_event_t *, int);
+static int event_fault(sb_event_t *, int);
+static int memory_kernel_init(void);
 static void memory_report_intermediate(sb_stat_t *);
 static void memory_report_cumulative(sb_stat_t *);
 
@@ -73,8 +180,10 @@ static sb_test_t memory_test =
   .ops = {
     .init = memory_init,
     .thread_init = memory_thread_init,
+    .thread_done = memory_thread_done,
     .print_mode = memory_print_mode,
     .next_event = memory_next_event,
+    .next_events = memory_next_events,
     .report_intermediate = memory_report_intermediate,
     .report_cumulative = memory_report_cumulative
   },
@@ -84,26 +193,293 @@ static sb_test_t memory_test =
 /* Test arguments */
 
 static ssize_t memory_block_size;
+/* Largest block size buffers are allocated for */
+static size_t       memory_max_block_size;
 static long long    memory_total_size;
 static unsigned int memory_scope;
 static unsigned int memory_oper;
+/* Percentage of writes with --memory-oper=mixed */
+static unsigned int memory_write_pct;
 static unsigned int memory_access_rnd;
+static unsigned int memory_access_chase;
+static unsigned int memory_access_tlb;
+static unsigned int memory_nt_stores;
 #ifdef HAVE_LARGE_PAGES
 static unsigned int memory_hugetlb;
 #endif
+static sb_pages_t   memory_pages;
+static bool         memory_populate;
 
 static TLS uint64_t tls_total_ops CK_CC_CACHELINE;
 static TLS size_t *tls_buf;
 static TLS size_t *tls_buf_end;
+/* Current block size, changes between cells in sweep mode */
+static TLS ssize_t tls_block_size;
+
+/*
+  Pointer chasing mode. Each cache line of a buffer stores the word offset of
+  the next line in a random cyclic chain, and each event follows the entire
+  chain once. Since every load depends on the previous one, the CPU cannot
+  overlap cache misses. In TLB mode, there is a single chain element per
+  chase_stride bytes, so every load touches a different page.
+*/
+
+/* Words per cache line */
+#define CHASE_LINE_WORDS (CK_MD_CACHELINE / SIZEOF_SIZE_T)
+
+/* Distance between chain elements in bytes */
+static size_t       chase_stride = CK_MD_CACHELINE;
+
+typedef struct {
+  uint64_t ns;                  /* time spent walking the chain */
+  uint64_t loads;               /* number of loads */
+  char pad[SB_CACHELINE_PAD(sizeof(uint64_t) * 2)];
+} chase_stat_t;
+
+static size_t       chase_nloads;      /* loads per event */
+static chase_stat_t *chase_stats;      /* per-thread statistics */
+static uint64_t     chase_last_ns;     /* values at the last intermediate report */
+static uint64_t     chase_last_loads;
+
+static TLS size_t tls_chase_pos;
+static TLS size_t tls_chase_len;      /* number of chain elements */
+
+/*
+  Loaded latency mode. The last memory_probe_threads threads chase pointers in
+  their own buffers and are the only ones executing events, i.e. the latency
+  statistics only include probes. Other threads execute the selected memory
+  operation without counting events, and account transferred bytes with the
+  SB_CNT_BYTES_* counters.
+*/
+
+static unsigned int memory_probe_threads;
+static uint64_t     memory_load_delay;   /* delay after each block, ns */
+/* Bytes read and written per block by traffic generating threads */
+static size_t       loaded_bytes_read;
+static size_t       loaded_bytes_written;
+
+#define IS_PROBE_THREAD(thread_id) \
+  ((unsigned int) (thread_id) >= sb_globals.threads - memory_probe_threads)
+
+/*
+  Traffic limit, see --memory-rate. Each thread paces its own share of the
+  rate, and only sleeps once it is ahead of its schedule by RATE_SLACK_NS, so
+  that small blocks do not cost a system call each.
+*/
+
+#define RATE_SLACK_NS 1000000
+
+static unsigned long long memory_rate;
+static double       rate_ns_per_byte;    /* per thread */
+static TLS uint64_t tls_rate_next_ns;
+
+typedef void kernel_read_t(const void *, size_t);
+typedef void kernel_write_t(void *, size_t);
+typedef void kernel_copy_t(void *, const void *, size_t);
+typedef void kernel_triad_t(void *, const void *, const void *, size_t);
+
+/*
+  Vectorized sequential kernel. The _nt variants use non-temporal stores and
+  are NULL if not implemented.
+*/
+typedef struct {
+  const char     *name;
+  unsigned int   width;         /* vector register width in bytes */
+  bool           (*supported)(void);
+  kernel_read_t  *read;
+  kernel_write_t *write;
+  kernel_copy_t  *copy;
+  kernel_triad_t *triad;
+  kernel_write_t *write_nt;
+  kernel_copy_t  *copy_nt;
+  kernel_triad_t *triad_nt;
+} memory_kernel_t;
+
+/* Kernels unroll their loops over this many vector registers */
+#define KERNEL_UNROLL 4
+
+static const memory_kernel_t *memory_kernel;
+
+/* Loops of the selected kernel, depending on --memory-nt-stores */
+static kernel_write_t *kernel_write;
+static kernel_copy_t  *kernel_copy;
+static kernel_triad_t *kernel_triad;
+
+/* Consumes loaded values so that the compiler cannot elide loads */
+static TLS uint64_t tls_kernel_sink;
+
+/*
+  Word offset of a chain element. Elements are placed at different cache lines
+  within their strides, so that they do not all map to the same cache sets.
+*/
+
+static inline size_t chase_node(size_t i)
+{
+  const size_t lines = chase_stride / CK_MD_CACHELINE;
+
+  return i * (chase_stride / SIZEOF_SIZE_T) +
+    (size_t) (i * 0x9E3779B1U) % lines * CHASE_LINE_WORDS;
+}
+
+static void chase_init(size_t *buf, size_t len);
+static void chase_get_stats(uint64_t *ns, uint64_t *loads);
 
 /* Array of per-thread buffers */
 static size_t **buffers;
 /* Global buffer */
 static size_t *buffer;
 
+/*
+  Copy and triad work on 2 and 3 arrays of memory_block_size bytes each, placed
+  one after another in the same buffer. The destination array comes
+  first. Arrays are separated by a few cache lines, so that their elements with
+  the same index do not map to the same cache sets.
+*/
+#define ARRAY_PAD (4 * CK_MD_CACHELINE)
+
+/* The constant multiplier in the triad operation */
+#define TRIAD_SCALAR 3.0
+
+static unsigned int memory_narrays;     /* arrays per buffer */
+static size_t       memory_array_stride; /* distance between arrays */
+static size_t       memory_buffer_size; /* buffer size for all arrays */
+/*
+  Bytes of memory traffic per event in units of the block size, i.e. the
+  number of arrays for copy and triad, 2 for rmw and 1 otherwise
+*/
+static unsigned int memory_block_passes;
+/* Bytes read and written per event, counted as in STREAM */
+static size_t       memory_event_bytes;
+/* Share of memory_event_bytes read, the rest is written */
+static double       memory_read_share;
+
+/*
+  Time-sliced modes, i.e. NUMA matrix and working set sweep. The run time is
+  split into equal slices, one per cell. All threads execute events for the
+  same cell, then move to the next one.
+*/
+
+/*
+  Check whether it is time to move to the next cell every CELL_CHECK_BYTES of
+  block data, but at least once per event
+*/
+#define CELL_CHECK_BYTES (64 * 1024)
+
+typedef struct {
+  uint64_t ops;                 /* events executed in a cell */
+  uint64_t ns;                  /* time spent in a cell */
+} memory_cell_t;
+
+static unsigned int  memory_ncells;       /* 0 if not in a time-sliced mode */
+static uint64_t      cell_slice_ns;       /* time slice for each cell */
+static uint64_t      cell_start_ns;       /* time of the first event */
+/* Per-thread cell statistics, threads x cells */
+static memory_cell_t *memory_cells;
+
+static TLS unsigned int tls_cell;
+static TLS uint64_t tls_cell_ops;
+static TLS uint64_t tls_cell_start;
+static TLS unsigned int tls_check_cnt;
+static TLS unsigned int tls_check_interval;
+
+/*
+  NUMA matrix mode. Each cell of the matrix is a (CPU node, memory node)
+  pair. All threads run on CPUs of the same node against their buffers bound to
+  the same node.
+*/
+
+static unsigned int numa_nrows;          /* number of nodes with CPUs */
+static unsigned int *numa_rows;          /* node indexes of matrix rows */
+static unsigned int numa_ncols;          /* number of nodes */
+/* Per-thread buffers bound to each node, threads x nodes */
+static size_t       **numa_buffers;
+
+/*
+  Working set sweep mode. Cell N uses blocks of sweep_min << N bytes. Buffers
+  are allocated for the largest size, and smaller blocks use their beginning.
+*/
+
+/* Cost per byte or per load growing by this factor indicates a cache miss */
+#define SWEEP_KNEE_RATIO 1.25
+
+static unsigned int memory_sweep;
+static size_t       sweep_min;
+
+/*
+  Page fault mode. Events fault in the pages of a block of at least one page
+  by touching a byte in each of them, and the time spent doing that is
+  accumulated separately from event latency. Threads use their own memory
+  regions or file mappings, so faults only contend on process-wide state like
+  the mmap lock. Unmapping an exhausted anon region or dropping file pages
+  from mappings at the end of the file set is not timed. The kernel may fault
+  in several pages at once, e.g. with fault-around for files or transparent
+  huge pages, so process fault counters are reported as well.
+*/
+
+typedef enum
+{
+  FAULTS_OFF,
+  FAULTS_ANON,
+  FAULTS_FILE,
+  FAULTS_MMAP,
+  FAULTS_MADVISE
+} memory_faults_t;
+
+static const char *fault_mode_names[] =
+  {"off", "anon", "file", "mmap", "madvise", NULL};
+
+/* Size of per-thread anon and madvise regions */
+#define FAULT_REGION_SIZE (64UL * 1024 * 1024)
+
+typedef struct {
+  uint64_t ns;                  /* time spent faulting */
+  uint64_t faults;              /* number of pages faulted in */
+  char pad[SB_CACHELINE_PAD(sizeof(uint64_t) * 2)];
+} fault_stat_t;
+
+static memory_faults_t memory_faults;
+static size_t       fault_page_size;
+static size_t       fault_block_size;   /* multiple of the page size */
+static size_t       fault_region_size;
+static fault_stat_t *fault_stats;
+static uint64_t     fault_last_ns;      /* values at the last intermediate report */
+static uint64_t     fault_last_faults;
+/* Values at the last cumulative report */
+static uint64_t     fault_cumul_ns;
+static uint64_t     fault_cumul_faults;
+static struct rusage fault_rusage;
+
+/* Files of 'fileio prepare', sizes are rounded down to the page size */
+static unsigned int fault_nfiles;
+static int          *fault_fds;
+static size_t       *fault_file_sizes;
+static size_t       fault_files_size;
+
+static TLS char   *tls_fault_region;
+static TLS char   **tls_fault_maps;     /* per-thread mappings of files */
+static TLS unsigned int tls_fault_file;
+static TLS size_t tls_fault_pos;        /* offset of the next block */
+
 #ifdef HAVE_LARGE_PAGES
 static void * hugetlb_alloc(size_t size);
 #endif
+static void *memory_alloc(size_t size);
+static size_t memory_page_size(void);
+
+static int cells_init(const char *, unsigned int);
+static bool cell_next(int);
+static void cell_done(int, uint64_t);
+static int numa_init(void);
+static int numa_thread_init(int);
+static void numa_report(void);
+static int sweep_init(void);
+static int loaded_init(void);
+static int probe_thread_init(int);
+static void sweep_report(void);
+static int faults_init(void);
+static int faults_thread_init(int);
+static void faults_thread_done(int);
+static void fault_get_stats(uint64_t *ns, uint64_t *faults);
 
 int register_test_memory(sb_list_t *tests)
 {
@@ -115,8 +491,8 @@ int register_test_memory(sb_list_t *tests)
 
 int memory_init(void)
 {
-  unsigned int i;
   char         *s;
+  int          i;
 
   memory_block_size = sb_get_value_size("memory-block-size");
   if (memory_block_size < SIZEOF_SIZE_T ||
@@ -135,6 +511,8 @@ int memory_init(void)
     memory_scope = SB_MEM_SCOPE_GLOBAL;
   else if (!strcmp(s, "local"))
     memory_scope = SB_MEM_SCOPE_LOCAL;
+  else if (!strcmp(s, "numa"))
+    memory_scope = SB_MEM_SCOPE_NUMA;
   else
   {
     log_text(LOG_FATAL, "Invalid value for memory-scope: %s", s);
@@ -145,11 +523,36 @@ int memory_init(void)
     memory_hugetlb = sb_get_value_flag("memory-hugetlb");
 #endif  
 
+  s = sb_get_value_string("memory-pages");
+  if (sb_parse_pages(s, &memory_pages))
+  {
+    log_text(LOG_FATAL, "Invalid value for memory-pages: %s", s);
+    return 1;
+  }
+
+#ifdef HAVE_LARGE_PAGES
+  if (memory_hugetlb && memory_pages != SB_PAGES_DEFAULT)
+  {
+    log_text(LOG_FATAL, "--memory-hugetlb cannot be used with --memory-pages");
+    return 1;
+  }
+#endif
+
+  memory_populate = sb_get_value_flag("memory-populate");
+
   s = sb_get_value_string("memory-oper");
   if (!strcmp(s, "write"))
     memory_oper = SB_MEM_OP_WRITE;
   else if (!strcmp(s, "read"))
     memory_oper = SB_MEM_OP_READ;
+  else if (!strcmp(s, "copy"))
+    memory_oper = SB_MEM_OP_COPY;
+  else if (!strcmp(s, "triad"))
+    memory_oper = SB_MEM_OP_TRIAD;
+  else if (!strcmp(s, "mixed"))
+    memory_oper = SB_MEM_OP_MIXED;
+  else if (!strcmp(s, "rmw"))
+    memory_oper = SB_MEM_OP_RMW;
   else if (!strcmp(s, "none"))
     memory_oper = SB_MEM_OP_NONE;
   else
@@ -158,62 +561,208 @@ int memory_init(void)
     return 1;
   }
 
+  const int read_pct = sb_get_value_int("memory-rw-ratio");
+  if (read_pct < 0 || read_pct > 100)
+  {
+    log_text(LOG_FATAL, "Invalid value for memory-rw-ratio: %d", read_pct);
+    return 1;
+  }
+  memory_write_pct = 100 - read_pct;
+
+  memory_nt_stores = sb_get_value_flag("memory-nt-stores");
+
   s = sb_get_value_string("memory-access-mode");
   if (!strcmp(s, "seq"))
     memory_access_rnd = 0;
   else if (!strcmp(s, "rnd"))
     memory_access_rnd = 1;
+  else if (!strcmp(s, "chase"))
+    memory_access_chase = 1;
+  else if (!strcmp(s, "tlb"))
+    memory_access_chase = memory_access_tlb = 1;
   else
   {
     log_text(LOG_FATAL, "Invalid value for memory-access-mode: %s", s);
     return 1;
   }
+
+  if (memory_access_tlb)
+  {
+    chase_stride = sb_get_value_size("memory-stride");
+    if (chase_stride == 0)
+      chase_stride = sb_getpagesize();
+
+    if (chase_stride % CK_MD_CACHELINE != 0)
+    {
+      log_text(LOG_FATAL, "--memory-stride must be a multiple of %d bytes",
+               CK_MD_CACHELINE);
+      return 1;
+    }
+  }
+
+  memory_rate = sb_get_value_size("memory-rate");
+  if (memory_rate > 0)
+  {
+    const int traffic_threads = (int) sb_globals.threads -
+      sb_get_value_int("memory-probe-threads");
+
+    rate_ns_per_byte = (double) (traffic_threads > 0 ? traffic_threads : 1) *
+      NS_PER_SEC / memory_rate;
+  }
+
+  s = sb_get_value_string("memory-faults");
+  for (i = 0; fault_mode_names[i] != NULL; i++)
+    if (!strcmp(s, fault_mode_names[i]))
+      break;
+
+  if (fault_mode_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for memory-faults: %s", s);
+    return 1;
+  }
+
+  memory_faults = (memory_faults_t) i;
+  if (memory_faults != FAULTS_OFF)
+    return faults_init();
+
+  memory_sweep = sb_get_value_flag("memory-sweep");
+  if (memory_sweep && sweep_init())
+    return 1;
+
+  memory_probe_threads = sb_get_value_int("memory-probe-threads");
+  if (memory_probe_threads > 0 && loaded_init())
+    return 1;
+
+  memory_max_block_size = memory_sweep ? sb_get_value_size("memory-sweep-max") :
+    (size_t) memory_block_size;
+
+  if ((memory_oper == SB_MEM_OP_COPY || memory_oper == SB_MEM_OP_TRIAD) &&
+      memory_access_rnd)
+  {
+    log_text(LOG_FATAL, "--memory-oper=%s supports only sequential access",
+             sb_get_value_string("memory-oper"));
+    return 1;
+  }
+
+  if (memory_oper == SB_MEM_OP_TRIAD &&
+      memory_block_size < (ssize_t) sizeof(double))
+  {
+    log_text(LOG_FATAL, "--memory-oper=triad requires --memory-block-size of "
+             "at least %u bytes", (unsigned int) sizeof(double));
+    return 1;
+  }
+
+  /* Sequential mixed access reads or writes whole cache lines */
+  if (memory_oper == SB_MEM_OP_MIXED && !memory_access_rnd &&
+      memory_block_size % CK_MD_CACHELINE != 0)
+  {
+    log_text(LOG_FATAL, "--memory-oper=mixed requires --memory-block-size "
+             "to be a multiple of %d bytes", CK_MD_CACHELINE);
+    return 1;
+  }
+
+  if (memory_kernel_init())
+    return 1;
+
+  /* Chasing pointers always reads memory, --memory-oper is ignored */
+  if (memory_oper == SB_MEM_OP_COPY && !memory_access_chase)
+    memory_narrays = 2;
+  else if (memory_oper == SB_MEM_OP_TRIAD && !memory_access_chase)
+    memory_narrays = 3;
+  else
+    memory_narrays = 1;
+
+  memory_array_stride = memory_narrays > 1 ?
+    memory_max_block_size + ARRAY_PAD : 0;
+  memory_buffer_size = memory_max_block_size +
+    (memory_narrays - 1) * memory_array_stride;
+
+  memory_block_passes = memory_narrays;
+  memory_read_share = 1;
+
+  if (!memory_access_chase) switch (memory_oper) {
+  case SB_MEM_OP_WRITE:
+    memory_read_share = 0;
+    break;
+  case SB_MEM_OP_COPY:
+    memory_read_share = 1.0 / 2;
+    break;
+  case SB_MEM_OP_TRIAD:
+    memory_read_share = 2.0 / 3;
+    break;
+  case SB_MEM_OP_MIXED:
+    {
+      /* Events do floor(n * memory_write_pct / 100) writes of n accesses */
+      const size_t n = memory_block_size /
+        (memory_access_rnd ? SIZEOF_SIZE_T : CK_MD_CACHELINE);
+      memory_read_share = 1 - (double) (n * memory_write_pct / 100) / n;
+    }
+    break;
+  case SB_MEM_OP_RMW:
+    memory_block_passes = 2;
+    memory_read_share = 1.0 / 2;
+    break;
+  default:
+    break;
+  }
+
+  memory_event_bytes = memory_block_passes * memory_block_size;
+
+  if (memory_access_chase)
+  {
+    if (memory_block_size < 2 * (ssize_t) chase_stride)
+    {
+      log_text(LOG_FATAL, "--memory-access-mode=%s requires "
+               "--memory-block-size of at least %zu bytes",
+               sb_get_value_string("memory-access-mode"), 2 * chase_stride);
+      return 1;
+    }
+
+    /*
+      In sweep mode, events walk the part of the chain covering the smallest
+      working set, so that they take similar time for all sizes
+    */
+    chase_nloads = memory_block_size / chase_stride;
+    chase_stats = sb_alloc_per_thread_array(sizeof(chase_stat_t));
+  }
   
   if (memory_scope == SB_MEM_SCOPE_GLOBAL)
   {
-#ifdef HAVE_LARGE_PAGES
-    if (memory_hugetlb)
-      buffer = hugetlb_alloc(memory_block_size);
-    else
-#endif
-      buffer = sb_memalign(memory_block_size, sb_getpagesize());
-
+    buffer = memory_alloc(memory_buffer_size);
     if (buffer == NULL)
     {
       log_text(LOG_FATAL, "Failed to allocate buffer!");
       return 1;
     }
 
-    memset(buffer, 0, memory_block_size);
+    memset(buffer, 0, memory_buffer_size);
+
+    if (memory_access_chase)
+      chase_init(buffer, memory_max_block_size / chase_stride);
+  }
+  else if (memory_scope == SB_MEM_SCOPE_NUMA)
+  {
+    if (numa_init())
+      return 1;
   }
   else
   {
-    buffers = malloc(sb_globals.threads * sizeof(void *));
+    /*
+      Per-thread buffers are allocated and first touched by their threads in
+      memory_thread_init(), so they are local to the NUMA node a thread is
+      running on
+    */
+    buffers = calloc(sb_globals.threads, sizeof(void *));
     if (buffers == NULL)
     {
       log_text(LOG_FATAL, "Failed to allocate buffers array!");
       return 1;
     }
-    for (i = 0; i < sb_globals.threads; i++)
-    {
-#ifdef HAVE_LARGE_PAGES
-      if (memory_hugetlb)
-        buffers[i] = hugetlb_alloc(memory_block_size);
-      else
-#endif
-        buffers[i] = sb_memalign(memory_block_size, sb_getpagesize());
-
-      if (buffers[i] == NULL)
-      {
-        log_text(LOG_FATAL, "Failed to allocate buffer for thread #%d!", i);
-        return 1;
-      }
-
-      memset(buffers[i], 0, memory_block_size);
-    }
   }
 
-  switch (memory_oper) {
+  if (memory_access_chase)
+    memory_test.ops.execute_event = event_chase;
+  else switch (memory_oper) {
   case SB_MEM_OP_NONE:
     memory_test.ops.execute_event =
       memory_access_rnd ? event_rnd_none : event_seq_none;
@@ -221,12 +770,34 @@ int memory_init(void)
 
   case SB_MEM_OP_READ:
     memory_test.ops.execute_event =
-      memory_access_rnd ? event_rnd_read : event_seq_read;
+      memory_access_rnd ? event_rnd_read :
+      memory_kernel != NULL ? event_kernel_read : event_seq_read;
     break;
 
   case SB_MEM_OP_WRITE:
     memory_test.ops.execute_event =
-      memory_access_rnd ? event_rnd_write : event_seq_write;
+      memory_access_rnd ? event_rnd_write :
+      memory_kernel != NULL ? event_kernel_write : event_seq_write;
+    break;
+
+  case SB_MEM_OP_COPY:
+    memory_test.ops.execute_event =
+      memory_kernel != NULL ? event_kernel_copy : event_seq_copy;
+    break;
+
+  case SB_MEM_OP_TRIAD:
+    memory_test.ops.execute_event =
+      memory_kernel != NULL ? event_kernel_triad : event_seq_triad;
+    break;
+
+  case SB_MEM_OP_MIXED:
+    memory_test.ops.execute_event =
+      memory_access_rnd ? event_rnd_mixed : event_seq_mixed;
+    break;
+
+  case SB_MEM_OP_RMW:
+    memory_test.ops.execute_event =
+      memory_access_rnd ? event_rnd_rmw : event_seq_rmw;
     break;
 
   default:
@@ -243,13 +814,17 @@ int memory_init(void)
 
 int memory_thread_init(int thread_id)
 {
-  (void) thread_id; /* unused */
-
   /* Initialize thread-local variables for each thread */
 
+  if (memory_probe_threads > 0 && IS_PROBE_THREAD(thread_id))
+    return probe_thread_init(thread_id);
+
+  if (memory_faults != FAULTS_OFF)
+    return faults_thread_init(thread_id);
+
   if (memory_total_size > 0)
   {
-    tls_total_ops = memory_total_size / memory_block_size / sb_globals.threads;
+    tls_total_ops = memory_total_size / memory_event_bytes / sb_globals.threads;
   }
 
   switch (memory_scope) {
@@ -257,107 +832,283 @@ int memory_thread_init(int thread_id)
     tls_buf = buffer;
     break;
   case SB_MEM_SCOPE_LOCAL:
+    buffers[thread_id] = memory_alloc(memory_buffer_size);
+    if (buffers[thread_id] == NULL)
+    {
+      log_text(LOG_FATAL, "Failed to allocate buffer for thread #%d!",
+               thread_id);
+      return 1;
+    }
+
+    memset(buffers[thread_id], 0, memory_buffer_size);
+
+    /* In sweep mode, the chain is built for each working set size */
+    if (memory_access_chase && !memory_sweep)
+      chase_init(buffers[thread_id], memory_max_block_size / chase_stride);
+
     tls_buf = buffers[thread_id];
     break;
+  case SB_MEM_SCOPE_NUMA:
+    if (numa_thread_init(thread_id))
+      return 1;
+    break;
   default:
     log_text(LOG_FATAL, "Invalid memory scope");
     return 1;
   }
 
-  tls_buf_end = (size_t *) (void *) ((char *) tls_buf + memory_block_size);
+  tls_block_size = memory_block_size;
+  tls_buf_end = (size_t *) (void *) ((char *) tls_buf + tls_block_size);
 
-  return 0;
-}
-
-
-sb_event_t memory_next_event(int thread_id)
-{
-  sb_event_t      req;
-
-  (void) thread_id; /* unused */
+  /* Spread threads sharing a global buffer over the chain */
+  tls_chase_len = memory_max_block_size / chase_stride;
+  tls_chase_pos = chase_node((size_t) thread_id * tls_chase_len /
+                             sb_globals.threads);
 
-  if (memory_total_size > 0 && !tls_total_ops--)
+  if (memory_ncells > 0)
   {
-    req.type = SB_REQ_TYPE_NULL;
-    return req;
+    /* Select the first cell on the first event */
+    tls_cell = UINT_MAX;
+    tls_check_interval = 1;
+    tls_check_cnt = tls_check_interval;
   }
 
-  req.type = SB_REQ_TYPE_MEMORY;
-
-  return req;
+  return 0;
 }
 
-/*
-  Use either 32- or 64-bit primitives depending on the native word
-  size. ConcurrencyKit ensures the corresponding loads/stores are not optimized
-  away by the compiler.
-*/
-#if SIZEOF_SIZE_T == 4
-# define SIZE_T_LOAD(ptr) ck_pr_load_32((uint32_t *)(ptr))
-# define SIZE_T_STORE(ptr,val) ck_pr_store_32((uint32_t *)(ptr),(uint32_t)(val))
-#elif SIZEOF_SIZE_T == 8
-# define SIZE_T_LOAD(ptr) ck_pr_load_64((uint64_t *)(ptr))
-# define SIZE_T_STORE(ptr,val) ck_pr_store_64((uint64_t *)(ptr),(uint64_t)(val))
-#else
-# error Unsupported platform.
-#endif
 
-int event_rnd_none(sb_event_t *req, int thread_id)
+int memory_thread_done(int thread_id)
 {
-  (void) req; /* unused */
-  (void) thread_id; /* unused */
+  if (memory_faults != FAULTS_OFF)
+    faults_thread_done(thread_id);
 
-  for (ssize_t i = 0; i < memory_block_size; i += SIZEOF_SIZE_T)
+  if (memory_ncells > 0)
   {
-    size_t offset = (volatile size_t) (sb_rand_uniform_double() *
-                                       (memory_block_size / SIZEOF_SIZE_T));
-    (void) offset; /* unused */
-    /* nop */
+    struct timespec ts;
+
+    SB_GETTIME(&ts);
+    cell_done(thread_id, SEC2NS(ts.tv_sec) + ts.tv_nsec);
   }
 
   return 0;
 }
 
 
-int event_rnd_read(sb_event_t *req, int thread_id)
+/* Wait for the schedule of --memory-rate after accessing n blocks */
+
+static void rate_pace(unsigned int n)
 {
-  (void) req; /* unused */
-  (void) thread_id; /* unused */
+  struct timespec ts;
 
-  for (ssize_t i = 0; i < memory_block_size; i += SIZEOF_SIZE_T)
-  {
-    size_t offset = (size_t) (sb_rand_uniform_double() *
-                              (memory_block_size / SIZEOF_SIZE_T));
-    size_t val = SIZE_T_LOAD(tls_buf + offset);
-    (void) val; /* unused */
-  }
+  SB_GETTIME(&ts);
 
-  return 0;
+  const uint64_t now = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+
+  /* Do not catch up with more than the slack after lagging behind */
+  if (tls_rate_next_ns + RATE_SLACK_NS < now)
+    tls_rate_next_ns = now - RATE_SLACK_NS;
+
+  tls_rate_next_ns += (uint64_t) (rate_ns_per_byte * tls_block_size * n);
+
+  if (tls_rate_next_ns > now + RATE_SLACK_NS)
+    sb_nanosleep(tls_rate_next_ns - now);
 }
 
 
-int event_rnd_write(sb_event_t *req, int thread_id)
+/* Busy-wait for memory_load_delay nanoseconds */
+
+static inline void load_delay(void)
 {
-  (void) req; /* unused */
-  (void) thread_id; /* unused */
+  struct timespec start, now;
 
-  for (ssize_t i = 0; i < memory_block_size; i += SIZEOF_SIZE_T)
+  SB_GETTIME(&start);
+  do
   {
-    size_t offset = (size_t) (sb_rand_uniform_double() *
-                              (memory_block_size / SIZEOF_SIZE_T));
-    SIZE_T_STORE(tls_buf + offset, i);
-  }
-
-  return 0;
+    ck_pr_stall();
+    SB_GETTIME(&now);
+  } while ((uint64_t) TIMESPEC_DIFF(now, start) < memory_load_delay);
 }
 
 
-int event_seq_none(sb_event_t *req, int thread_id)
+/*
+  Thread loop in loaded latency mode. Probe threads execute timed pointer
+  chasing events, other threads generate memory traffic until the time limit
+  is reached.
+*/
+
+int memory_thread_run(int thread_id)
 {
-  (void) req; /* unused */
-  (void) thread_id; /* unused */
+  sb_event_t event;
+  int        rc = 0;
 
-  for (size_t *buf = tls_buf, *end = buf + memory_block_size / SIZEOF_SIZE_T;
+  event.type = SB_REQ_TYPE_MEMORY;
+
+  if (IS_PROBE_THREAD(thread_id))
+  {
+    while (sb_more_events(thread_id) && rc == 0)
+    {
+      sb_event_start(thread_id);
+      rc = event_chase(&event, thread_id);
+      sb_event_stop(thread_id);
+    }
+
+    return rc;
+  }
+
+  while (sb_more_events(thread_id) && rc == 0)
+  {
+    rc = memory_test.ops.execute_event(&event, thread_id);
+
+    if (loaded_bytes_read > 0)
+      sb_counter_add(thread_id, SB_CNT_BYTES_READ, loaded_bytes_read);
+    if (loaded_bytes_written > 0)
+      sb_counter_add(thread_id, SB_CNT_BYTES_WRITTEN, loaded_bytes_written);
+
+    if (memory_load_delay > 0)
+      load_delay();
+
+    if (memory_rate > 0)
+      rate_pace(1);
+  }
+
+  return rc;
+}
+
+
+/*
+  Account n events in a time-sliced mode, move to the next cell when the time
+  slice of the current one is over. Returns false when all cells are done.
+*/
+
+static inline bool cell_account(int thread_id, unsigned int n)
+{
+  tls_check_cnt += n;
+  if (SB_UNLIKELY(tls_check_cnt >= tls_check_interval))
+  {
+    tls_check_cnt = 0;
+    if (!cell_next(thread_id))
+      return false;
+  }
+
+  tls_cell_ops += n;
+
+  return true;
+}
+
+
+sb_event_t memory_next_event(int thread_id)
+{
+  sb_event_t      req;
+
+  if ((memory_total_size > 0 && !tls_total_ops--) ||
+      (memory_ncells > 0 && !cell_account(thread_id, 1)))
+  {
+    req.type = SB_REQ_TYPE_NULL;
+    return req;
+  }
+
+  if (memory_rate > 0)
+    rate_pace(1);
+
+  req.type = SB_REQ_TYPE_MEMORY;
+
+  return req;
+}
+
+
+unsigned int memory_next_events(int thread_id, sb_event_t *events,
+                                unsigned int n)
+{
+  if (memory_total_size > 0)
+  {
+    if (tls_total_ops < n)
+      n = tls_total_ops;
+    tls_total_ops -= n;
+  }
+
+  if (memory_ncells > 0 && !cell_account(thread_id, n))
+    return 0;
+
+  if (memory_rate > 0 && n > 0)
+    rate_pace(n);
+
+  for (unsigned int i = 0; i < n; i++)
+    events[i].type = SB_REQ_TYPE_MEMORY;
+
+  return n;
+}
+
+/*
+  Use either 32- or 64-bit primitives depending on the native word
+  size. ConcurrencyKit ensures the corresponding loads/stores are not optimized
+  away by the compiler.
+*/
+#if SIZEOF_SIZE_T == 4
+# define SIZE_T_LOAD(ptr) ck_pr_load_32((uint32_t *)(ptr))
+# define SIZE_T_STORE(ptr,val) ck_pr_store_32((uint32_t *)(ptr),(uint32_t)(val))
+#elif SIZEOF_SIZE_T == 8
+# define SIZE_T_LOAD(ptr) ck_pr_load_64((uint64_t *)(ptr))
+# define SIZE_T_STORE(ptr,val) ck_pr_store_64((uint64_t *)(ptr),(uint64_t)(val))
+#else
+# error Unsupported platform.
+#endif
+
+int event_rnd_none(sb_event_t *req, int thread_id)
+{
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
+
+  for (ssize_t i = 0; i < tls_block_size; i += SIZEOF_SIZE_T)
+  {
+    size_t offset = (volatile size_t) (sb_rand_uniform_double() *
+                                       (tls_block_size / SIZEOF_SIZE_T));
+    (void) offset; /* unused */
+    /* nop */
+  }
+
+  return 0;
+}
+
+
+int event_rnd_read(sb_event_t *req, int thread_id)
+{
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
+
+  for (ssize_t i = 0; i < tls_block_size; i += SIZEOF_SIZE_T)
+  {
+    size_t offset = (size_t) (sb_rand_uniform_double() *
+                              (tls_block_size / SIZEOF_SIZE_T));
+    size_t val = SIZE_T_LOAD(tls_buf + offset);
+    (void) val; /* unused */
+  }
+
+  return 0;
+}
+
+
+int event_rnd_write(sb_event_t *req, int thread_id)
+{
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
+
+  for (ssize_t i = 0; i < tls_block_size; i += SIZEOF_SIZE_T)
+  {
+    size_t offset = (size_t) (sb_rand_uniform_double() *
+                              (tls_block_size / SIZEOF_SIZE_T));
+    SIZE_T_STORE(tls_buf + offset, i);
+  }
+
+  return 0;
+}
+
+
+int event_seq_none(sb_event_t *req, int thread_id)
+{
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
+
+  for (size_t *buf = tls_buf, *end = buf + tls_block_size / SIZEOF_SIZE_T;
        buf < end; buf++)
   {
     ck_pr_barrier();
@@ -373,7 +1124,7 @@ int event_seq_read(sb_event_t *req, int thread_id)
   (void) req; /* unused */
   (void) thread_id; /* unused */
 
-  for (size_t *buf = tls_buf, *end = buf + memory_block_size / SIZEOF_SIZE_T;
+  for (size_t *buf = tls_buf, *end = buf + tls_block_size / SIZEOF_SIZE_T;
        buf < end; buf++)
   {
     size_t val = SIZE_T_LOAD(buf);
@@ -389,7 +1140,7 @@ int event_seq_write(sb_event_t *req, int thread_id)
   (void) req; /* unused */
   (void) thread_id; /* unused */
 
-  for (size_t *buf = tls_buf, *end = buf + memory_block_size / SIZEOF_SIZE_T;
+  for (size_t *buf = tls_buf, *end = buf + tls_block_size / SIZEOF_SIZE_T;
        buf < end; buf++)
   {
     SIZE_T_STORE(buf, end - buf);
@@ -399,80 +1150,1871 @@ int event_seq_write(sb_event_t *req, int thread_id)
 }
 
 
-void memory_print_mode(void)
+/*
+  Mixed reads and writes. Whether an access is a write is decided by an
+  accumulator of write percentages, so that writes are spread evenly over the
+  block and each event does exactly the same number of them.
+*/
+
+int event_rnd_mixed(sb_event_t *req, int thread_id)
 {
-  char *str;
+  unsigned int acc = 0;
 
-  log_text(LOG_NOTICE, "Running memory speed test with the following options:");
-  log_text(LOG_NOTICE, "  block size: %ldKiB",
-           (long)(memory_block_size / 1024));
-  log_text(LOG_NOTICE, "  total size: %ldMiB",
-           (long)(memory_total_size / 1024 / 1024));
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
 
-  switch (memory_oper) {
-    case SB_MEM_OP_READ:
-      str = "read";
-      break;
-    case SB_MEM_OP_WRITE:
-      str = "write";
-      break;
-    case SB_MEM_OP_NONE:
-      str = "none";
-      break;
-    default:
-      str = "(unknown)";
-      break;
-  }
-  log_text(LOG_NOTICE, "  operation: %s", str);
+  for (ssize_t i = 0; i < tls_block_size; i += SIZEOF_SIZE_T)
+  {
+    size_t offset = (size_t) (sb_rand_uniform_double() *
+                              (tls_block_size / SIZEOF_SIZE_T));
 
-  switch (memory_scope) {
-    case SB_MEM_SCOPE_GLOBAL:
-      str = "global";
-      break;
-    case SB_MEM_SCOPE_LOCAL:
-      str = "local";
-      break;
-    default:
-      str = "(unknown)";
-      break;
+    acc += memory_write_pct;
+    if (acc >= 100)
+    {
+      acc -= 100;
+      SIZE_T_STORE(tls_buf + offset, i);
+    }
+    else
+    {
+      size_t val = SIZE_T_LOAD(tls_buf + offset);
+      (void) val; /* unused */
+    }
   }
-  log_text(LOG_NOTICE, "  scope: %s", str);
 
-  log_text(LOG_NOTICE, "");
+  return 0;
 }
 
-/*
-  Print intermediate test statistics.
-*/
 
-void memory_report_intermediate(sb_stat_t *stat)
+int event_seq_mixed(sb_event_t *req, int thread_id)
 {
-  const double megabyte = 1024.0 * 1024.0;
+  unsigned int acc = 0;
+
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
+
+  for (size_t *line = tls_buf, *end = line + tls_block_size / SIZEOF_SIZE_T;
+       line < end; line += CHASE_LINE_WORDS)
+  {
+    acc += memory_write_pct;
+    if (acc >= 100)
+    {
+      acc -= 100;
+      for (size_t i = 0; i < CHASE_LINE_WORDS; i++)
+        SIZE_T_STORE(line + i, i);
+    }
+    else
+    {
+      for (size_t i = 0; i < CHASE_LINE_WORDS; i++)
+      {
+        size_t val = SIZE_T_LOAD(line + i);
+        (void) val; /* unused */
+      }
+    }
+  }
 
-  log_timestamp(LOG_NOTICE, stat->time_total, "%4.2f MiB/sec",
-                stat->events * memory_block_size / megabyte /
-                stat->time_interval);
+  return 0;
 }
 
-/*
-  Print cumulative test statistics.
-*/
 
-void memory_report_cumulative(sb_stat_t *stat)
+/* Read-modify-write, i.e. increment of each word in place */
+
+int event_rnd_rmw(sb_event_t *req, int thread_id)
 {
-  const double megabyte = 1024.0 * 1024.0;
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
 
-  log_text(LOG_NOTICE, "Total operations: %" PRIu64 " (%8.2f per second)\n",
-           stat->events, stat->events / stat->time_interval);
+  for (ssize_t i = 0; i < tls_block_size; i += SIZEOF_SIZE_T)
+  {
+    size_t *ptr = tls_buf + (size_t) (sb_rand_uniform_double() *
+                                      (tls_block_size / SIZEOF_SIZE_T));
+    SIZE_T_STORE(ptr, SIZE_T_LOAD(ptr) + 1);
+  }
+
+  return 0;
+}
+
+
+int event_seq_rmw(sb_event_t *req, int thread_id)
+{
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
 
-  if (memory_oper != SB_MEM_OP_NONE)
+  for (size_t *buf = tls_buf, *end = buf + tls_block_size / SIZEOF_SIZE_T;
+       buf < end; buf++)
   {
-    const double mb = stat->events * memory_block_size / megabyte;
-    log_text(LOG_NOTICE, "%4.2f MiB transferred (%4.2f MiB/sec)\n",
-             mb, mb / stat->time_interval);
+    SIZE_T_STORE(buf, SIZE_T_LOAD(buf) + 1);
   }
 
-  sb_report_cumulative(stat);
+  return 0;
+}
+
+
+int event_chase(sb_event_t *req, int thread_id)
+{
+  chase_stat_t    *stat = &chase_stats[thread_id];
+  size_t          pos = tls_chase_pos;
+  struct timespec start, end;
+
+  (void) req; /* unused */
+
+  SB_GETTIME(&start);
+
+  for (size_t n = chase_nloads; n > 0; n--)
+    pos = SIZE_T_LOAD(tls_buf + pos);
+
+  SB_GETTIME(&end);
+
+  tls_chase_pos = pos;
+
+  ck_pr_store_64(&stat->ns, stat->ns + TIMESPEC_DIFF(end, start));
+  ck_pr_store_64(&stat->loads, stat->loads + chase_nloads);
+
+  return 0;
+}
+
+
+int event_kernel_read(sb_event_t *req, int thread_id)
+{
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
+
+  memory_kernel->read(tls_buf, tls_block_size);
+
+  return 0;
+}
+
+
+int event_kernel_write(sb_event_t *req, int thread_id)
+{
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
+
+  kernel_write(tls_buf, tls_block_size);
+
+  return 0;
+}
+
+
+/* Scalar copy is what most code does, i.e. a libc memcpy() call */
+
+int event_seq_copy(sb_event_t *req, int thread_id)
+{
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
+
+  memcpy(tls_buf, (char *) tls_buf + memory_array_stride, tls_block_size);
+
+  return 0;
+}
+
+
+int event_seq_triad(sb_event_t *req, int thread_id)
+{
+  double       *a = (double *) (void *) tls_buf;
+  const double *b = (const double *) (void *)
+    ((char *) tls_buf + memory_array_stride);
+  const double *c = (const double *) (void *)
+    ((char *) tls_buf + 2 * memory_array_stride);
+
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
+
+  for (size_t i = 0, n = tls_block_size / sizeof(double); i < n; i++)
+    a[i] = b[i] + TRIAD_SCALAR * c[i];
+
+  return 0;
+}
+
+
+int event_kernel_copy(sb_event_t *req, int thread_id)
+{
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
+
+  kernel_copy(tls_buf, (char *) tls_buf + memory_array_stride,
+              tls_block_size);
+
+  return 0;
+}
+
+
+int event_kernel_triad(sb_event_t *req, int thread_id)
+{
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
+
+  kernel_triad(tls_buf, (char *) tls_buf + memory_array_stride,
+               (char *) tls_buf + 2 * memory_array_stride, tls_block_size);
+
+  return 0;
+}
+
+
+#ifdef SB_MEMORY_X86_KERNELS
+
+/*
+  Each kernel is compiled for its own instruction set with the 'target'
+  attribute, so the rest of the binary does not depend on it. Buffers are
+  page-aligned, arrays are cache line-aligned and their sizes are powers of 2
+  no less than KERNEL_UNROLL * width, see memory_kernel_init().
+*/
+
+/*
+  Loops storing to memory. Instantiated twice per instruction set: with regular
+  stores, and with non-temporal ones followed by a store fence.
+*/
+#define X86_STORE_KERNELS(isa, feature, sfx, vec, load, store, set1,         \
+                          vecd, loadd, addd, muld, stored, set1d, fence)    \
+  __attribute__((target(feature)))                                      \
+  static void kernel_write_ ## isa ## sfx(void *buf, size_t len)        \
+  {                                                                     \
+    vec *p = buf;                                                       \
+    vec * const end = (vec *) (void *) ((char *) buf + len);            \
+    const vec val = set1((long long) len);                              \
+                                                                        \
+    for (; p < end; p += KERNEL_UNROLL)                                 \
+    {                                                                   \
+      store(p, val);                                                    \
+      store(p + 1, val);                                                \
+      store(p + 2, val);                                                \
+      store(p + 3, val);                                                \
+    }                                                                   \
+    fence;                                                              \
+  }                                                                     \
+                                                                        \
+  __attribute__((target(feature)))                                      \
+  static void kernel_copy_ ## isa ## sfx(void *dst, const void *src,    \
+                                         size_t len)                    \
+  {                                                                     \
+    vec *d = dst;                                                       \
+    const vec *s = src;                                                 \
+    vec * const end = (vec *) (void *) ((char *) dst + len);            \
+                                                                        \
+    for (; d < end; d += KERNEL_UNROLL, s += KERNEL_UNROLL)             \
+    {                                                                   \
+      const vec v0 = load(s), v1 = load(s + 1), v2 = load(s + 2),       \
+        v3 = load(s + 3);                                               \
+                                                                        \
+      store(d, v0);                                                     \
+      store(d + 1, v1);                                                 \
+      store(d + 2, v2);                                                 \
+      store(d + 3, v3);                                                 \
+    }                                                                   \
+    fence;                                                              \
+  }                                                                     \
+                                                                        \
+  __attribute__((target(feature)))                                      \
+  static void kernel_triad_ ## isa ## sfx(void *a, const void *b,       \
+                                          const void *c, size_t len)    \
+  {                                                                     \
+    const size_t w = sizeof(vecd) / sizeof(double);                     \
+    double       *pa = a;                                               \
+    const double *pb = b, *pc = c;                                      \
+    double * const end = (double *) (void *) ((char *) a + len);        \
+    const vecd q = set1d(TRIAD_SCALAR);                                 \
+                                                                        \
+    for (; pa < end; pa += KERNEL_UNROLL * w, pb += KERNEL_UNROLL * w,  \
+           pc += KERNEL_UNROLL * w)                                     \
+    {                                                                   \
+      stored(pa, addd(loadd(pb), muld(q, loadd(pc))));                  \
+      stored(pa + w, addd(loadd(pb + w), muld(q, loadd(pc + w))));      \
+      stored(pa + 2 * w, addd(loadd(pb + 2 * w),                        \
+                              muld(q, loadd(pc + 2 * w))));             \
+      stored(pa + 3 * w, addd(loadd(pb + 3 * w),                        \
+                              muld(q, loadd(pc + 3 * w))));             \
+    }                                                                   \
+    fence;                                                              \
+  }
+
+#define X86_KERNELS(isa, feature, vec, zero, load, vor, store, stream, set1, \
+                    vecd, loadd, addd, muld, stored, streamd, set1d)    \
+  __attribute__((target(feature)))                                      \
+  static void kernel_read_ ## isa(const void *buf, size_t len)          \
+  {                                                                     \
+    const vec *p = buf;                                                 \
+    const vec * const end = (const vec *) (const void *)                \
+      ((const char *) buf + len);                                       \
+    vec acc0 = zero(), acc1 = zero(), acc2 = zero(), acc3 = zero();     \
+                                                                        \
+    for (; p < end; p += KERNEL_UNROLL)                                 \
+    {                                                                   \
+      acc0 = vor(acc0, load(p));                                        \
+      acc1 = vor(acc1, load(p + 1));                                    \
+      acc2 = vor(acc2, load(p + 2));                                    \
+      acc3 = vor(acc3, load(p + 3));                                    \
+    }                                                                   \
+                                                                        \
+    union { vec v; uint64_t u[sizeof(vec) / 8]; } r;                    \
+    r.v = vor(vor(acc0, acc1), vor(acc2, acc3));                        \
+    ck_pr_store_64(&tls_kernel_sink, r.u[0]);                           \
+  }                                                                     \
+                                                                        \
+  X86_STORE_KERNELS(isa, feature, , vec, load, store, set1,             \
+                    vecd, loadd, addd, muld, stored, set1d, (void) 0)   \
+  X86_STORE_KERNELS(isa, feature, _nt, vec, load, stream, set1,         \
+                    vecd, loadd, addd, muld, streamd, set1d,            \
+                    _mm_sfence())                                       \
+                                                                        \
+  static bool kernel_supported_ ## isa(void)                            \
+  {                                                                     \
+    __builtin_cpu_init();                                               \
+    return __builtin_cpu_supports(feature);                             \
+  }
+
+X86_KERNELS(sse2, "sse2", __m128i, _mm_setzero_si128, _mm_load_si128,
+            _mm_or_si128, _mm_store_si128, _mm_stream_si128, _mm_set1_epi64x,
+            __m128d, _mm_load_pd, _mm_add_pd, _mm_mul_pd, _mm_store_pd,
+            _mm_stream_pd, _mm_set1_pd)
+X86_KERNELS(avx2, "avx2", __m256i, _mm256_setzero_si256, _mm256_load_si256,
+            _mm256_or_si256, _mm256_store_si256, _mm256_stream_si256,
+            _mm256_set1_epi64x, __m256d, _mm256_load_pd, _mm256_add_pd,
+            _mm256_mul_pd, _mm256_store_pd, _mm256_stream_pd, _mm256_set1_pd)
+X86_KERNELS(avx512, "avx512f", __m512i, _mm512_setzero_si512,
+            _mm512_load_si512, _mm512_or_si512, _mm512_store_si512,
+            _mm512_stream_si512, _mm512_set1_epi64, __m512d, _mm512_load_pd,
+            _mm512_add_pd, _mm512_mul_pd, _mm512_store_pd, _mm512_stream_pd,
+            _mm512_set1_pd)
+
+#define X86_KERNEL(isa, width)                                          \
+  {#isa, width, kernel_supported_ ## isa, kernel_read_ ## isa,          \
+   kernel_write_ ## isa, kernel_copy_ ## isa, kernel_triad_ ## isa,     \
+   kernel_write_ ## isa ## _nt, kernel_copy_ ## isa ## _nt,             \
+   kernel_triad_ ## isa ## _nt}
+
+#endif /* SB_MEMORY_X86_KERNELS */
+
+#ifdef SB_MEMORY_NEON_KERNELS
+
+/*
+  Advanced SIMD is mandatory on AArch64. There are no non-temporal vector
+  stores in ACLE, so no _nt variants are provided.
+*/
+
+static bool kernel_supported_neon(void)
+{
+  return true;
+}
+
+
+static void kernel_read_neon(const void *buf, size_t len)
+{
+  const uint64_t *p = buf;
+  const uint64_t * const end = (const uint64_t *) (const void *)
+    ((const char *) buf + len);
+  uint64x2_t acc0 = vdupq_n_u64(0), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+
+  for (; p < end; p += 2 * KERNEL_UNROLL)
+  {
+    acc0 = vorrq_u64(acc0, vld1q_u64(p));
+    acc1 = vorrq_u64(acc1, vld1q_u64(p + 2));
+    acc2 = vorrq_u64(acc2, vld1q_u64(p + 4));
+    acc3 = vorrq_u64(acc3, vld1q_u64(p + 6));
+  }
+
+  acc0 = vorrq_u64(vorrq_u64(acc0, acc1), vorrq_u64(acc2, acc3));
+  ck_pr_store_64(&tls_kernel_sink, vgetq_lane_u64(acc0, 0));
+}
+
+
+static void kernel_write_neon(void *buf, size_t len)
+{
+  uint64_t *p = buf;
+  uint64_t * const end = (uint64_t *) (void *) ((char *) buf + len);
+  const uint64x2_t val = vdupq_n_u64(len);
+
+  for (; p < end; p += 2 * KERNEL_UNROLL)
+  {
+    vst1q_u64(p, val);
+    vst1q_u64(p + 2, val);
+    vst1q_u64(p + 4, val);
+    vst1q_u64(p + 6, val);
+  }
+}
+
+
+static void kernel_copy_neon(void *dst, const void *src, size_t len)
+{
+  uint64_t *d = dst;
+  const uint64_t *s = src;
+  uint64_t * const end = (uint64_t *) (void *) ((char *) dst + len);
+
+  for (; d < end; d += 2 * KERNEL_UNROLL, s += 2 * KERNEL_UNROLL)
+  {
+    const uint64x2_t v0 = vld1q_u64(s), v1 = vld1q_u64(s + 2),
+      v2 = vld1q_u64(s + 4), v3 = vld1q_u64(s + 6);
+
+    vst1q_u64(d, v0);
+    vst1q_u64(d + 2, v1);
+    vst1q_u64(d + 4, v2);
+    vst1q_u64(d + 6, v3);
+  }
+}
+
+
+static void kernel_triad_neon(void *a, const void *b, const void *c,
+                              size_t len)
+{
+  double *pa = a;
+  const double *pb = b, *pc = c;
+  double * const end = (double *) (void *) ((char *) a + len);
+  const float64x2_t q = vdupq_n_f64(TRIAD_SCALAR);
+
+  for (; pa < end; pa += 2 * KERNEL_UNROLL, pb += 2 * KERNEL_UNROLL,
+         pc += 2 * KERNEL_UNROLL)
+  {
+    vst1q_f64(pa, vfmaq_f64(vld1q_f64(pb), q, vld1q_f64(pc)));
+    vst1q_f64(pa + 2, vfmaq_f64(vld1q_f64(pb + 2), q, vld1q_f64(pc + 2)));
+    vst1q_f64(pa + 4, vfmaq_f64(vld1q_f64(pb + 4), q, vld1q_f64(pc + 4)));
+    vst1q_f64(pa + 6, vfmaq_f64(vld1q_f64(pb + 6), q, vld1q_f64(pc + 6)));
+  }
+}
+
+#endif /* SB_MEMORY_NEON_KERNELS */
+
+/* Available kernels in the order of increasing width */
+static const memory_kernel_t memory_kernels[] =
+{
+#ifdef SB_MEMORY_X86_KERNELS
+  X86_KERNEL(sse2, 16),
+  X86_KERNEL(avx2, 32),
+  X86_KERNEL(avx512, 64),
+#endif
+#ifdef SB_MEMORY_NEON_KERNELS
+  {"neon", 16, kernel_supported_neon, kernel_read_neon, kernel_write_neon,
+   kernel_copy_neon, kernel_triad_neon, NULL, NULL, NULL},
+#endif
+  {NULL, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL}
+};
+
+
+/*
+  Parse --memory-kernel and --memory-nt-stores. Sets memory_kernel to NULL for
+  the scalar one.
+*/
+
+int memory_kernel_init(void)
+{
+  const char            *s = sb_get_value_string("memory-kernel");
+  const memory_kernel_t *k;
+
+  memory_kernel = NULL;
+
+  if (!strcmp(s, "auto"))
+  {
+    for (k = memory_kernels; k->name != NULL; k++)
+      if (k->supported() &&
+          memory_block_size >= (ssize_t) (KERNEL_UNROLL * k->width))
+        memory_kernel = k;
+  }
+  else if (strcmp(s, "scalar"))
+  {
+    for (k = memory_kernels; k->name != NULL; k++)
+      if (!strcmp(s, k->name))
+        break;
+
+    if (k->name == NULL)
+    {
+      if (strcmp(s, "sse2") && strcmp(s, "avx2") && strcmp(s, "avx512") &&
+          strcmp(s, "neon"))
+        log_text(LOG_FATAL, "Invalid value for memory-kernel: %s", s);
+      else
+        log_text(LOG_FATAL, "--memory-kernel=%s is not available on this "
+                 "platform", s);
+      return 1;
+    }
+
+    if (!k->supported())
+    {
+      log_text(LOG_FATAL, "--memory-kernel=%s is not supported by the CPU", s);
+      return 1;
+    }
+
+    if (memory_block_size < (ssize_t) (KERNEL_UNROLL * k->width))
+    {
+      log_text(LOG_FATAL, "--memory-kernel=%s requires --memory-block-size of "
+               "at least %u bytes", s, KERNEL_UNROLL * k->width);
+      return 1;
+    }
+
+    memory_kernel = k;
+  }
+
+  if (!memory_nt_stores)
+  {
+    if (memory_kernel != NULL)
+    {
+      kernel_write = memory_kernel->write;
+      kernel_copy = memory_kernel->copy;
+      kernel_triad = memory_kernel->triad;
+    }
+
+    return 0;
+  }
+
+  if (memory_access_rnd || memory_access_chase ||
+      (memory_oper != SB_MEM_OP_WRITE && memory_oper != SB_MEM_OP_COPY &&
+       memory_oper != SB_MEM_OP_TRIAD))
+  {
+    log_text(LOG_FATAL, "--memory-nt-stores requires sequential access and "
+             "--memory-oper=write, copy or triad");
+    return 1;
+  }
+
+  if (memory_kernel == NULL || memory_kernel->write_nt == NULL)
+  {
+    log_text(LOG_FATAL, "--memory-nt-stores is not supported by "
+             "--memory-kernel=%s",
+             memory_kernel != NULL ? memory_kernel->name : "scalar");
+    return 1;
+  }
+
+  kernel_write = memory_kernel->write_nt;
+  kernel_copy = memory_kernel->copy_nt;
+  kernel_triad = memory_kernel->triad_nt;
+
+  return 0;
+}
+
+
+/*
+  Build a random cyclic chain over len elements of a buffer using Sattolo's
+  algorithm, i.e. shuffle element offsets so that they form a single cycle.
+*/
+
+void chase_init(size_t *buf, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+    buf[chase_node(i)] = chase_node(i);
+
+  for (size_t i = len - 1; i > 0; i--)
+  {
+    const size_t j = sb_rand_uniform_uint64() % i;
+    const size_t tmp = buf[chase_node(i)];
+
+    buf[chase_node(i)] = buf[chase_node(j)];
+    buf[chase_node(j)] = tmp;
+  }
+}
+
+
+/* Sum chain walk statistics over all worker threads */
+
+void chase_get_stats(uint64_t *ns, uint64_t *loads)
+{
+  *ns = 0;
+  *loads = 0;
+
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+  {
+    *ns += ck_pr_load_64(&chase_stats[i].ns);
+    *loads += ck_pr_load_64(&chase_stats[i].loads);
+  }
+}
+
+
+void memory_print_mode(void)
+{
+  char *str;
+
+  log_text(LOG_NOTICE, "Running memory speed test with the following options:");
+  if (memory_faults != FAULTS_OFF)
+  {
+    char page[16], size[16];
+
+    log_text(LOG_NOTICE, "  page faults: %s, %zu page(s) of %sB per event",
+             fault_mode_names[memory_faults], fault_block_size / fault_page_size,
+             sb_print_value_size(page, sizeof(page), fault_page_size));
+    if (memory_faults == FAULTS_FILE)
+      log_text(LOG_NOTICE, "  files: %u, %sB", fault_nfiles,
+               sb_print_value_size(size, sizeof(size), fault_files_size));
+    log_text(LOG_NOTICE, "  total size: %ldMiB\n",
+             (long)(memory_total_size / 1024 / 1024));
+    return;
+  }
+
+  if (memory_sweep)
+  {
+    char min[16], max[16];
+
+    log_text(LOG_NOTICE, "  working set sweep: %sB to %sB, %.2fs per size",
+             sb_print_value_size(min, sizeof(min), sweep_min),
+             sb_print_value_size(max, sizeof(max), memory_max_block_size),
+             NS2SEC(cell_slice_ns));
+  }
+  else
+    log_text(LOG_NOTICE, "  block size: %ldKiB",
+             (long)(memory_block_size / 1024));
+  if (memory_ncells == 0 && memory_probe_threads == 0)
+    log_text(LOG_NOTICE, "  total size: %ldMiB",
+             (long)(memory_total_size / 1024 / 1024));
+
+  switch (memory_oper) {
+    case SB_MEM_OP_READ:
+      str = "read";
+      break;
+    case SB_MEM_OP_WRITE:
+      str = "write";
+      break;
+    case SB_MEM_OP_COPY:
+      str = "copy";
+      break;
+    case SB_MEM_OP_TRIAD:
+      str = "triad";
+      break;
+    case SB_MEM_OP_MIXED:
+      str = "mixed";
+      break;
+    case SB_MEM_OP_RMW:
+      str = "read-modify-write";
+      break;
+    case SB_MEM_OP_NONE:
+      str = "none";
+      break;
+    default:
+      str = "(unknown)";
+      break;
+  }
+  if (memory_access_tlb)
+  {
+    char stride[16];
+
+    log_text(LOG_NOTICE, "  operation: read (pointer chasing, one load per "
+             "%sB)", sb_print_value_size(stride, sizeof(stride),
+                                         chase_stride));
+  }
+  else
+  {
+    if (memory_access_chase)
+      str = "read (pointer chasing)";
+    if (memory_oper == SB_MEM_OP_MIXED && !memory_access_chase)
+      log_text(LOG_NOTICE, "  operation: mixed (%u%% reads)",
+               100 - memory_write_pct);
+    else
+      log_text(LOG_NOTICE, "  operation: %s%s", str,
+               memory_nt_stores ? " (non-temporal stores)" : "");
+  }
+
+  if (memory_kernel != NULL && !memory_access_rnd && !memory_access_chase &&
+      memory_oper != SB_MEM_OP_NONE && memory_oper != SB_MEM_OP_MIXED &&
+      memory_oper != SB_MEM_OP_RMW)
+    log_text(LOG_NOTICE, "  kernel: %s", memory_kernel->name);
+
+  switch (memory_scope) {
+    case SB_MEM_SCOPE_GLOBAL:
+      str = "global";
+      break;
+    case SB_MEM_SCOPE_LOCAL:
+      str = "local";
+      break;
+    case SB_MEM_SCOPE_NUMA:
+      str = "numa";
+      break;
+    default:
+      str = "(unknown)";
+      break;
+  }
+  log_text(LOG_NOTICE, "  scope: %s", str);
+
+  if (memory_probe_threads > 0)
+    log_text(LOG_NOTICE, "  loaded latency: %u probe thread(s), %zu loads per "
+             "event, %" PRIu64 "ns delay per block", memory_probe_threads,
+             chase_nloads, memory_load_delay);
+
+  if (memory_rate > 0)
+  {
+    char rate[16];
+
+    log_text(LOG_NOTICE, "  rate limit: %sB/sec",
+             sb_print_value_size(rate, sizeof(rate), memory_rate));
+  }
+
+  if (memory_pages != SB_PAGES_DEFAULT || memory_populate)
+    log_text(LOG_NOTICE, "  pages: %s%s", sb_get_value_string("memory-pages"),
+             memory_populate ? " (pre-faulted)" : "");
+
+  if (memory_scope == SB_MEM_SCOPE_NUMA)
+    log_text(LOG_NOTICE, "  NUMA matrix: %u CPU node(s) x %u memory node(s), "
+             "%.2fs per cell", numa_nrows, numa_ncols, NS2SEC(cell_slice_ns));
+
+  log_text(LOG_NOTICE, "");
+}
+
+/*
+  Print intermediate test statistics.
+*/
+
+void memory_report_intermediate(sb_stat_t *stat)
+{
+  const double megabyte = 1024.0 * 1024.0;
+
+  if (memory_faults != FAULTS_OFF)
+  {
+    uint64_t ns, faults;
+
+    fault_get_stats(&ns, &faults);
+
+    log_timestamp(LOG_NOTICE, stat->time_total, "%4.2f pages/sec faulted in, "
+                  "%4.2f ns per page", (faults - fault_last_faults) /
+                  stat->time_interval, faults > fault_last_faults ?
+                  (double) (ns - fault_last_ns) / (faults - fault_last_faults) :
+                  0);
+
+    fault_last_ns = ns;
+    fault_last_faults = faults;
+
+    return;
+  }
+
+  if (memory_probe_threads > 0)
+  {
+    uint64_t ns, loads;
+
+    chase_get_stats(&ns, &loads);
+
+    log_timestamp(LOG_NOTICE, stat->time_total, "%4.2f MiB/sec, probe "
+                  "latency: %4.2f ns per load",
+                  (stat->bytes_read + stat->bytes_written) / megabyte /
+                  stat->time_interval,
+                  loads > chase_last_loads ?
+                  (double) (ns - chase_last_ns) / (loads - chase_last_loads) :
+                  0);
+
+    chase_last_ns = ns;
+    chase_last_loads = loads;
+
+    return;
+  }
+
+  if (memory_access_chase)
+  {
+    uint64_t ns, loads;
+
+    chase_get_stats(&ns, &loads);
+
+    log_timestamp(LOG_NOTICE, stat->time_total, "%4.2f ns per load",
+                  loads > chase_last_loads ?
+                  (double) (ns - chase_last_ns) / (loads - chase_last_loads) :
+                  0);
+
+    chase_last_ns = ns;
+    chase_last_loads = loads;
+
+    return;
+  }
+
+  if (memory_sweep)
+  {
+    /* Approximate, a report interval may span several sizes */
+    const uint64_t start = ck_pr_load_64(&cell_start_ns);
+    struct timespec ts;
+    uint64_t        now, cell = 0;
+    char            size[16];
+
+    SB_GETTIME(&ts);
+    now = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+    if (start > 0 && now > start)
+      cell = (now - start) / cell_slice_ns;
+    if (cell >= memory_ncells)
+      cell = memory_ncells - 1;
+
+    log_timestamp(LOG_NOTICE, stat->time_total, "%4.2f MiB/sec (%sB)",
+                  stat->events * memory_block_passes * (sweep_min << cell) /
+                  megabyte / stat->time_interval,
+                  sb_print_value_size(size, sizeof(size), sweep_min << cell));
+    return;
+  }
+
+  const double mbps = stat->events * memory_event_bytes / megabyte /
+    stat->time_interval;
+
+  if (memory_read_share > 0 && memory_read_share < 1)
+    log_timestamp(LOG_NOTICE, stat->time_total, "%4.2f MiB/sec (read: %4.2f, "
+                  "write: %4.2f)", mbps, mbps * memory_read_share,
+                  mbps * (1 - memory_read_share));
+  else
+    log_timestamp(LOG_NOTICE, stat->time_total, "%4.2f MiB/sec", mbps);
+}
+
+/*
+  Print cumulative test statistics.
+*/
+
+void memory_report_cumulative(sb_stat_t *stat)
+{
+  const double megabyte = 1024.0 * 1024.0;
+
+  log_text(LOG_NOTICE, "Total operations: %" PRIu64 " (%8.2f per second)\n",
+           stat->events, stat->events / stat->time_interval);
+
+  if (memory_faults != FAULTS_OFF)
+  {
+    uint64_t      ns, faults;
+    struct rusage ru;
+
+    fault_get_stats(&ns, &faults);
+    getrusage(RUSAGE_SELF, &ru);
+
+    log_text(LOG_NOTICE, "Pages faulted in: %" PRIu64 " (%8.2f per second)",
+             faults - fault_cumul_faults,
+             (faults - fault_cumul_faults) / stat->time_interval);
+    log_text(LOG_NOTICE, "Fault latency: %4.2f ns per page (%zu page(s) per "
+             "event)", faults > fault_cumul_faults ?
+             (double) (ns - fault_cumul_ns) / (faults - fault_cumul_faults) :
+             0, fault_block_size / fault_page_size);
+    log_text(LOG_NOTICE, "Process page faults: %ld minor, %ld major\n",
+             ru.ru_minflt - fault_rusage.ru_minflt,
+             ru.ru_majflt - fault_rusage.ru_majflt);
+
+    fault_cumul_ns = ns;
+    fault_cumul_faults = faults;
+    fault_rusage = ru;
+  }
+  else if (memory_probe_threads > 0)
+  {
+    const double mb = (stat->bytes_read + stat->bytes_written) / megabyte;
+    uint64_t     ns, loads;
+
+    chase_get_stats(&ns, &loads);
+
+    log_text(LOG_NOTICE, "Traffic threads: %u, %4.2f MiB transferred "
+             "(%4.2f MiB/sec)", sb_globals.threads - memory_probe_threads,
+             mb, mb / stat->time_interval);
+    log_text(LOG_NOTICE, "Probe threads: %u, load latency: %4.2f ns (%zu "
+             "dependent loads per event)\n", memory_probe_threads,
+             loads > 0 ? (double) ns / loads : 0, chase_nloads);
+  }
+  else if (memory_access_chase)
+  {
+    uint64_t ns, loads;
+
+    chase_get_stats(&ns, &loads);
+
+    if (memory_access_tlb)
+    {
+      char stride[16], size[16];
+
+      log_text(LOG_NOTICE, "Chain: %zu loads, one per %sB of a %sB buffer",
+               memory_max_block_size / chase_stride,
+               sb_print_value_size(stride, sizeof(stride), chase_stride),
+               sb_print_value_size(size, sizeof(size), memory_max_block_size));
+    }
+
+    log_text(LOG_NOTICE, "Load latency: %4.2f ns (%zu dependent loads per "
+             "event)\n", loads > 0 ? (double) ns / loads : 0, chase_nloads);
+  }
+  else if (memory_oper != SB_MEM_OP_NONE)
+  {
+    double mb = stat->events * memory_event_bytes / megabyte;
+
+    /* Event sizes differ between cells in sweep mode */
+    if (memory_sweep)
+    {
+      mb = 0;
+      for (unsigned int i = 0; i < sb_globals.threads * memory_ncells; i++)
+        mb += memory_cells[i].ops * memory_block_passes *
+          (sweep_min << (i % memory_ncells)) / megabyte;
+    }
+
+    if (memory_read_share > 0 && memory_read_share < 1)
+    {
+      log_text(LOG_NOTICE, "%4.2f MiB transferred (%4.2f MiB/sec)",
+               mb, mb / stat->time_interval);
+      log_text(LOG_NOTICE, "    read:    %4.2f MiB (%4.2f MiB/sec)",
+               mb * memory_read_share,
+               mb * memory_read_share / stat->time_interval);
+      log_text(LOG_NOTICE, "    written: %4.2f MiB (%4.2f MiB/sec)\n",
+               mb * (1 - memory_read_share),
+               mb * (1 - memory_read_share) / stat->time_interval);
+    }
+    else
+      log_text(LOG_NOTICE, "%4.2f MiB transferred (%4.2f MiB/sec)\n",
+               mb, mb / stat->time_interval);
+  }
+
+  if (memory_scope == SB_MEM_SCOPE_NUMA)
+    numa_report();
+  else if (memory_sweep)
+    sweep_report();
+
+  sb_report_cumulative(stat);
+}
+
+
+/* Initialize NUMA matrix mode */
+
+int numa_init(void)
+{
+  if (sb_affinity_policy() != NULL)
+  {
+    log_text(LOG_FATAL, "--thread-affinity cannot be used with "
+             "--memory-scope=numa");
+    return 1;
+  }
+
+  if (sb_numa_init())
+    return 1;
+
+  numa_ncols = sb_numa_nnodes();
+  numa_rows = malloc(numa_ncols * sizeof(unsigned int));
+  if (numa_rows == NULL)
+    return 1;
+
+  for (unsigned int i = 0; i < numa_ncols; i++)
+    if (sb_numa_node_ncpus(i) > 0)
+      numa_rows[numa_nrows++] = i;
+
+  if (numa_nrows == 0)
+  {
+    log_text(LOG_FATAL, "No NUMA nodes with available CPUs");
+    return 1;
+  }
+
+  numa_buffers = calloc(sb_globals.threads * numa_ncols, sizeof(size_t *));
+  if (numa_buffers == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  return cells_init("--memory-scope=numa", numa_nrows * numa_ncols);
+}
+
+
+/* Allocate thread buffers bound to each NUMA node */
+
+int numa_thread_init(int thread_id)
+{
+  const size_t pagesize = memory_page_size();
+  /* Do not share pages with other allocations */
+  const size_t len = (memory_buffer_size + pagesize - 1) / pagesize * pagesize;
+
+  for (unsigned int i = 0; i < numa_ncols; i++)
+  {
+    size_t *buf = memory_alloc(len);
+
+    if (buf == NULL)
+    {
+      log_text(LOG_FATAL, "Failed to allocate buffer for thread #%d!",
+               thread_id);
+      return 1;
+    }
+
+    if (sb_numa_bind_memory(buf, len, i))
+      return 1;
+
+    memset(buf, 0, memory_buffer_size);
+
+    if (memory_access_chase)
+      chase_init(buf, memory_max_block_size / chase_stride);
+
+    numa_buffers[thread_id * numa_ncols + i] = buf;
+  }
+
+  tls_buf = numa_buffers[thread_id * numa_ncols];
+
+  return 0;
+}
+
+
+/*
+  Initialize a time-sliced mode with a given number of cells. 'mode' is the
+  option enabling it, for error messages.
+*/
+
+int cells_init(const char *mode, unsigned int ncells)
+{
+  if (sb_globals.max_time_ns == 0 || sb_globals.warmup_time > 0)
+  {
+    log_text(LOG_FATAL, "%s requires a --time limit and does not support "
+             "--warmup-time", mode);
+    return 1;
+  }
+
+  /* Cells would be split between placements */
+  if (sb_smt_enabled())
+  {
+    log_text(LOG_FATAL, "%s cannot be used with --smt-compare", mode);
+    return 1;
+  }
+
+  memory_cells = calloc(sb_globals.threads * ncells, sizeof(memory_cell_t));
+  if (memory_cells == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  memory_ncells = ncells;
+  cell_slice_ns = sb_globals.max_time_ns / ncells;
+
+  /* The test is limited by time in this mode */
+  memory_total_size = 0;
+
+  return 0;
+}
+
+
+/* Switch the current thread to the cell for the current time, if necessary */
+
+bool cell_next(int thread_id)
+{
+  struct timespec ts;
+  uint64_t        now, start, cell;
+
+  SB_GETTIME(&ts);
+  now = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+
+  /* Cell time slices start with the first event in any thread */
+  start = ck_pr_load_64(&cell_start_ns);
+  if (SB_UNLIKELY(start == 0))
+  {
+    ck_pr_cas_64(&cell_start_ns, 0, now);
+    start = ck_pr_load_64(&cell_start_ns);
+  }
+
+  cell = now > start ? (now - start) / cell_slice_ns : 0;
+  if (cell == tls_cell)
+    return true;
+
+  cell_done(thread_id, now);
+
+  if (cell >= memory_ncells)
+    return false;
+
+  if (memory_scope == SB_MEM_SCOPE_NUMA)
+  {
+    if (sb_numa_run_on_node(numa_rows[cell / numa_ncols]))
+    {
+      sb_globals.error = 1;
+      return false;
+    }
+
+    tls_buf = numa_buffers[thread_id * numa_ncols + cell % numa_ncols];
+  }
+  else
+  {
+    tls_block_size = sweep_min << cell;
+
+    /* The chain must only cover the current working set */
+    if (memory_access_chase)
+    {
+      tls_chase_len = tls_block_size / chase_stride;
+      chase_init(tls_buf, tls_chase_len);
+      tls_chase_pos = 0;
+
+      /* Do not account the time spent building the chain */
+      SB_GETTIME(&ts);
+      now = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+    }
+  }
+
+  tls_buf_end = (size_t *) (void *) ((char *) tls_buf + tls_block_size);
+
+  tls_check_interval = CELL_CHECK_BYTES / tls_block_size;
+  if (tls_check_interval == 0)
+    tls_check_interval = 1;
+
+  tls_cell = (unsigned int) cell;
+  tls_cell_ops = 0;
+  tls_cell_start = now;
+
+  return true;
+}
+
+
+/* Account statistics for the current cell of the current thread */
+
+void cell_done(int thread_id, uint64_t now)
+{
+  memory_cell_t *c;
+
+  if (tls_cell >= memory_ncells)
+    return;
+
+  c = &memory_cells[thread_id * memory_ncells + tls_cell];
+  c->ops += tls_cell_ops;
+  c->ns += now - tls_cell_start;
+
+  tls_cell = UINT_MAX;
+}
+
+
+/* Print CPU node x memory node bandwidth and latency matrices */
+
+void numa_report(void)
+{
+  const double megabyte = 1024.0 * 1024.0;
+  char         line[4096];
+
+  /* Bandwidth is meaningless without memory transfers or with dependent loads */
+  const int first = memory_oper == SB_MEM_OP_NONE || memory_access_chase;
+
+  for (int latency = first; latency <= 1; latency++)
+  {
+    int n;
+
+    if (latency)
+      log_text(LOG_NOTICE, "NUMA latency matrix, average ns per %s "
+               "(rows: CPU nodes, columns: memory nodes):",
+               memory_access_chase ? "load" : "block");
+    else
+      log_text(LOG_NOTICE, "NUMA bandwidth matrix, MiB/sec "
+               "(rows: CPU nodes, columns: memory nodes):");
+
+    n = snprintf(line, sizeof(line), "%10s", "");
+    for (unsigned int col = 0; col < numa_ncols && n < (int) sizeof(line);
+         col++)
+    {
+      char name[16];
+
+      snprintf(name, sizeof(name), "node%u", sb_numa_node_id(col));
+      n += snprintf(line + n, sizeof(line) - n, "  %10s", name);
+    }
+    log_text(LOG_NOTICE, "%s", line);
+
+    for (unsigned int row = 0; row < numa_nrows; row++)
+    {
+      n = snprintf(line, sizeof(line), "    node%-2u",
+                   sb_numa_node_id(numa_rows[row]));
+
+      for (unsigned int col = 0; col < numa_ncols && n < (int) sizeof(line);
+           col++)
+      {
+        const unsigned int cell = row * numa_ncols + col;
+        uint64_t           ops = 0, ns = 0;
+        double             bw = 0;
+
+        for (unsigned int t = 0; t < sb_globals.threads; t++)
+        {
+          const memory_cell_t *c = &memory_cells[t * memory_ncells + cell];
+
+          ops += c->ops;
+          ns += c->ns;
+
+          /* Threads run concurrently, so their bandwidth adds up */
+          if (c->ns > 0)
+            bw += c->ops * memory_event_bytes / megabyte / NS2SEC(c->ns);
+        }
+
+        if (memory_access_chase)
+          ops *= chase_nloads;
+
+        n += snprintf(line + n, sizeof(line) - n, "  %10.2f",
+                      latency ? (ops > 0 ? (double) ns / ops : 0) : bw);
+      }
+
+      log_text(LOG_NOTICE, "%s%s", line,
+               (row == numa_nrows - 1 && !latency) ? "\n" : "");
+    }
+  }
+}
+
+/* Initialize working set sweep mode */
+
+int sweep_init(void)
+{
+  const size_t max = sb_get_value_size("memory-sweep-max");
+  unsigned int ncells = 1;
+
+  sweep_min = sb_get_value_size("memory-sweep-min");
+
+  if (sweep_min < SIZEOF_SIZE_T || (sweep_min & (sweep_min - 1)) != 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for memory-sweep-min: %s",
+             sb_get_value_string("memory-sweep-min"));
+    return 1;
+  }
+
+  if (max < sweep_min || (max & (max - 1)) != 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for memory-sweep-max: %s",
+             sb_get_value_string("memory-sweep-max"));
+    return 1;
+  }
+
+  if (memory_scope == SB_MEM_SCOPE_NUMA)
+  {
+    log_text(LOG_FATAL, "--memory-sweep cannot be used with "
+             "--memory-scope=numa");
+    return 1;
+  }
+
+  if (memory_access_chase && memory_scope != SB_MEM_SCOPE_LOCAL)
+  {
+    log_text(LOG_FATAL, "--memory-sweep with --memory-access-mode=%s "
+             "requires --memory-scope=local",
+             sb_get_value_string("memory-access-mode"));
+    return 1;
+  }
+
+  /* Other options are validated against the smallest size */
+  memory_block_size = sweep_min;
+
+  for (size_t size = sweep_min; size < max; size <<= 1)
+    ncells++;
+
+  return cells_init("--memory-sweep", ncells);
+}
+
+
+/* Initialize loaded latency mode */
+
+int loaded_init(void)
+{
+  const int loads = sb_get_value_int("memory-probe-loads");
+  const int delay = sb_get_value_int("memory-load-delay");
+
+  if (memory_probe_threads >= sb_globals.threads)
+  {
+    log_text(LOG_FATAL, "--memory-probe-threads must be less than --threads");
+    return 1;
+  }
+
+  if (memory_access_chase || memory_scope == SB_MEM_SCOPE_NUMA ||
+      memory_sweep)
+  {
+    log_text(LOG_FATAL, "--memory-probe-threads cannot be used with "
+             "--memory-access-mode=chase or tlb, --memory-scope=numa or "
+             "--memory-sweep");
+    return 1;
+  }
+
+  if (sb_globals.max_time_ns == 0 || sb_globals.tx_rate > 0)
+  {
+    log_text(LOG_FATAL, "--memory-probe-threads requires a --time limit and "
+             "does not support --rate");
+    return 1;
+  }
+
+  if (memory_block_size < 2 * CK_MD_CACHELINE)
+  {
+    log_text(LOG_FATAL, "--memory-probe-threads requires "
+             "--memory-block-size of at least %d bytes", 2 * CK_MD_CACHELINE);
+    return 1;
+  }
+
+  if (loads <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for memory-probe-loads: %d", loads);
+    return 1;
+  }
+
+  if (delay < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for memory-load-delay: %d", delay);
+    return 1;
+  }
+
+  chase_nloads = loads;
+  chase_stats = sb_alloc_per_thread_array(sizeof(chase_stat_t));
+  memory_load_delay = delay;
+
+  switch (memory_oper) {
+  case SB_MEM_OP_READ:
+    loaded_bytes_read = memory_block_size;
+    break;
+  case SB_MEM_OP_WRITE:
+    loaded_bytes_written = memory_block_size;
+    break;
+  case SB_MEM_OP_COPY:
+    loaded_bytes_read = memory_block_size;
+    loaded_bytes_written = memory_block_size;
+    break;
+  case SB_MEM_OP_TRIAD:
+    loaded_bytes_read = 2 * memory_block_size;
+    loaded_bytes_written = memory_block_size;
+    break;
+  case SB_MEM_OP_MIXED:
+    loaded_bytes_written = memory_block_size * memory_write_pct / 100;
+    loaded_bytes_read = memory_block_size - loaded_bytes_written;
+    break;
+  case SB_MEM_OP_RMW:
+    loaded_bytes_read = memory_block_size;
+    loaded_bytes_written = memory_block_size;
+    break;
+  default:
+    break;
+  }
+
+  memory_test.ops.thread_run = memory_thread_run;
+
+  /* The test is limited by time in this mode */
+  memory_total_size = 0;
+
+  return 0;
+}
+
+
+/*
+  Allocate a probe thread buffer of --memory-block-size bytes and build a
+  pointer chain in it
+*/
+
+int probe_thread_init(int thread_id)
+{
+  size_t *buf = memory_alloc(memory_block_size);
+
+  if (buf == NULL)
+  {
+    log_text(LOG_FATAL, "Failed to allocate buffer for thread #%d!",
+             thread_id);
+    return 1;
+  }
+
+  memset(buf, 0, memory_block_size);
+
+  tls_chase_len = memory_block_size / chase_stride;
+  chase_init(buf, tls_chase_len);
+
+  tls_buf = buf;
+  tls_block_size = memory_block_size;
+  tls_buf_end = (size_t *) (void *) ((char *) tls_buf + tls_block_size);
+  tls_chase_pos = 0;
+
+  return 0;
+}
+
+
+/*
+  Get sizes of data and unified CPU caches of the first CPU by level from
+  sysfs. Returns the number of levels, or 0 if unknown.
+*/
+
+static unsigned int cpu_cache_sizes(size_t *sizes, unsigned int max)
+{
+  unsigned int nlevels = 0;
+
+  for (unsigned int i = 0; ; i++)
+  {
+    char         path[128], type[32];
+    unsigned int level;
+    size_t       size;
+    FILE         *fp;
+    int          rc;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/"
+             "level", i);
+    if ((fp = fopen(path, "r")) == NULL)
+      break;
+    rc = fscanf(fp, "%u", &level);
+    fclose(fp);
+    if (rc != 1)
+      break;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/"
+             "type", i);
+    if ((fp = fopen(path, "r")) == NULL)
+      break;
+    rc = fscanf(fp, "%31s", type);
+    fclose(fp);
+    if (rc != 1)
+      break;
+
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/"
+             "size", i);
+    if ((fp = fopen(path, "r")) == NULL)
+      break;
+    rc = fscanf(fp, "%zuK", &size);
+    fclose(fp);
+    if (rc != 1)
+      break;
+
+    if (!strcmp(type, "Instruction") || level == 0 || level > max)
+      continue;
+
+    sizes[level - 1] = size * 1024;
+    if (level > nlevels)
+      nlevels = level;
+  }
+
+  return nlevels;
+}
+
+
+/*
+  Print the working set size table. Cache level boundaries are detected as
+  sizes after which the cost per byte (or per load when chasing pointers)
+  grows by more than SWEEP_KNEE_RATIO. Adjacent growing steps are a single
+  boundary.
+*/
+
+void sweep_report(void)
+{
+  const double megabyte = 1024.0 * 1024.0;
+  /* Bandwidth is meaningless without memory transfers or with dependent loads */
+  const bool   bandwidth = memory_oper != SB_MEM_OP_NONE && !memory_access_chase;
+  const char   *unit = memory_access_chase ? "ns/load" : "ns/block";
+  size_t       caches[8] = {0};
+  unsigned int nlevels, nknees = 0, level = 0;
+  size_t       knees[64];
+  double       prev = 0;
+  bool         growing = false;
+  char         size[16];
+
+  nlevels = cpu_cache_sizes(caches, sizeof(caches) / sizeof(caches[0]));
+
+  log_text(LOG_NOTICE, "Working set sweep (sizes are %s):",
+           memory_scope == SB_MEM_SCOPE_LOCAL ? "per thread" :
+           "shared by all threads");
+  if (bandwidth)
+    log_text(LOG_NOTICE, "%10s  %12s  %12s", "size", "MiB/sec", unit);
+  else
+    log_text(LOG_NOTICE, "%10s  %12s", "size", unit);
+
+  for (unsigned int cell = 0; cell < memory_ncells; cell++)
+  {
+    const size_t block = sweep_min << cell;
+    uint64_t     ops = 0, ns = 0;
+    double       bw = 0, lat, cost;
+
+    for (unsigned int t = 0; t < sb_globals.threads; t++)
+    {
+      const memory_cell_t *c = &memory_cells[t * memory_ncells + cell];
+
+      ops += c->ops;
+      ns += c->ns;
+
+      /* Threads run concurrently, so their bandwidth adds up */
+      if (c->ns > 0)
+        bw += c->ops * memory_block_passes * block / megabyte /
+          NS2SEC(c->ns);
+    }
+
+    lat = ops > 0 ?
+      (double) ns / ops / (memory_access_chase ? chase_nloads : 1) : 0;
+    cost = memory_access_chase ? lat : lat / block;
+
+    if (prev > 0 && cost > prev * SWEEP_KNEE_RATIO)
+    {
+      if (!growing && nknees < sizeof(knees) / sizeof(knees[0]))
+        knees[nknees++] = block >> 1;
+      growing = true;
+    }
+    else
+      growing = false;
+
+    if (cost > 0)
+      prev = cost;
+
+    sb_print_value_size(size, sizeof(size), block);
+    if (bandwidth)
+      log_text(LOG_NOTICE, "%9sB  %12.2f  %12.2f", size, bw, lat);
+    else
+      log_text(LOG_NOTICE, "%9sB  %12.2f", size, lat);
+  }
+
+  if (nlevels > 0)
+  {
+    char line[256];
+    int  n = 0;
+
+    line[0] = '\0';
+    for (unsigned int i = 0; i < nlevels && n < (int) sizeof(line); i++)
+      if (caches[i] > 0)
+        n += snprintf(line + n, sizeof(line) - n, "%s L%u %sB", n ? "," : "",
+                      i + 1, sb_print_value_size(size, sizeof(size),
+                                                 caches[i]));
+    log_text(LOG_NOTICE, "\nCPU caches:%s", line);
+    log_text(LOG_NOTICE, "Detected cache level boundaries:%s",
+             nknees ? "" : " none");
+  }
+  else
+  {
+    /* Name levels as if there were 3 cache levels */
+    nlevels = 3;
+    log_text(LOG_NOTICE, "\nDetected cache level boundaries:%s",
+             nknees ? "" : " none");
+  }
+
+  for (unsigned int i = 0; i < nknees; i++, level++)
+  {
+    char from[8], to[8];
+
+    if (level < nlevels)
+      snprintf(from, sizeof(from), "L%u", level + 1);
+    else
+      snprintf(from, sizeof(from), "DRAM");
+    if (level + 1 < nlevels)
+      snprintf(to, sizeof(to), "L%u", level + 2);
+    else
+      snprintf(to, sizeof(to), "DRAM");
+
+    log_text(LOG_NOTICE, "  %9sB: %s -> %s",
+             sb_print_value_size(size, sizeof(size), knees[i]), from, to);
+  }
+}
+
+#ifdef SB_MEMORY_FAULTS
+
+/* Open the files created by 'sysbench fileio prepare' */
+
+static int fault_files_open(void)
+{
+  char name[32];
+
+  for (;; fault_nfiles++)
+  {
+    struct stat st;
+    int         fd;
+
+    snprintf(name, sizeof(name), "test_file.%u", fault_nfiles);
+
+    if ((fd = open(name, O_RDONLY)) < 0)
+    {
+      if (errno == ENOENT)
+        break;
+      log_errno(LOG_FATAL, "Cannot open file '%s'", name);
+      return 1;
+    }
+
+    if (fstat(fd, &st))
+    {
+      log_errno(LOG_FATAL, "fstat() failed on file '%s'", name);
+      close(fd);
+      return 1;
+    }
+
+    if ((fault_fds = realloc(fault_fds, (fault_nfiles + 1) * sizeof(int))) ==
+        NULL ||
+        (fault_file_sizes = realloc(fault_file_sizes,
+                                    (fault_nfiles + 1) * sizeof(size_t))) ==
+        NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      close(fd);
+      return 1;
+    }
+
+    fault_fds[fault_nfiles] = fd;
+    fault_file_sizes[fault_nfiles] = (size_t) st.st_size / fault_page_size *
+      fault_page_size;
+    fault_files_size += fault_file_sizes[fault_nfiles];
+  }
+
+  if (fault_files_size == 0)
+  {
+    log_text(LOG_FATAL, "--memory-faults=file requires files created by "
+             "'sysbench fileio prepare' in the current directory");
+    return 1;
+  }
+
+  return 0;
+}
+
+
+int faults_init(void)
+{
+  const char *opt = NULL;
+
+  if (sb_get_value_flag("memory-sweep"))
+    opt = "--memory-sweep";
+  else if (sb_get_value_int("memory-probe-threads") > 0)
+    opt = "--memory-probe-threads";
+  else if (memory_access_chase)
+    opt = "--memory-access-mode=chase and tlb";
+  else if (memory_scope == SB_MEM_SCOPE_NUMA)
+    opt = "--memory-scope=numa";
+  else if (memory_pages != SB_PAGES_DEFAULT || memory_populate)
+    opt = "--memory-pages and --memory-populate";
+#ifdef HAVE_LARGE_PAGES
+  else if (memory_hugetlb)
+    opt = "--memory-hugetlb";
+#endif
+
+  if (opt != NULL)
+  {
+    log_text(LOG_FATAL, "--memory-faults cannot be used with %s", opt);
+    return 1;
+  }
+
+  fault_page_size = sb_getpagesize();
+  fault_block_size = SB_MAX((size_t) memory_block_size, fault_page_size);
+  fault_region_size = SB_MAX(FAULT_REGION_SIZE, fault_block_size);
+  fault_region_size -= fault_region_size % fault_block_size;
+
+  if (memory_faults == FAULTS_FILE && fault_files_open())
+    return 1;
+
+  fault_stats = sb_alloc_per_thread_array(sizeof(fault_stat_t));
+  if (fault_stats == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  memory_event_bytes = fault_block_size;
+  memory_test.ops.execute_event = event_fault;
+
+  getrusage(RUSAGE_SELF, &fault_rusage);
+
+  /* Use our own limit on the number of events */
+  sb_globals.max_events = 0;
+
+  return 0;
+}
+
+
+static char *fault_map_anon(size_t size)
+{
+  char * const p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (p == MAP_FAILED)
+  {
+    log_errno(LOG_FATAL, "mmap() failed");
+    return NULL;
+  }
+
+  return p;
+}
+
+
+int faults_thread_init(int thread_id)
+{
+  if (memory_total_size > 0)
+    tls_total_ops = memory_total_size / memory_event_bytes / sb_globals.threads;
+
+  tls_fault_pos = 0;
+
+  switch (memory_faults) {
+  case FAULTS_ANON:
+  case FAULTS_MADVISE:
+    if ((tls_fault_region = fault_map_anon(fault_region_size)) == NULL)
+      return 1;
+    break;
+
+  case FAULTS_FILE:
+    if ((tls_fault_maps = calloc(fault_nfiles, sizeof(char *))) == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+
+    for (unsigned int i = 0; i < fault_nfiles; i++)
+    {
+      if (fault_file_sizes[i] == 0)
+        continue;
+
+      tls_fault_maps[i] = mmap(NULL, fault_file_sizes[i], PROT_READ,
+                               MAP_SHARED, fault_fds[i], 0);
+      if (tls_fault_maps[i] == MAP_FAILED)
+      {
+        tls_fault_maps[i] = NULL;
+        log_errno(LOG_FATAL, "mmap() failed on file 'test_file.%u'", i);
+        return 1;
+      }
+    }
+
+    /* Spread threads over the file set */
+    tls_fault_file = (unsigned int) thread_id % fault_nfiles;
+    break;
+
+  default:
+    break;
+  }
+
+  return 0;
+}
+
+
+void faults_thread_done(int thread_id)
+{
+  (void) thread_id; /* unused */
+
+  if (tls_fault_region != NULL)
+    munmap(tls_fault_region, fault_region_size);
+  tls_fault_region = NULL;
+
+  for (unsigned int i = 0; tls_fault_maps != NULL && i < fault_nfiles; i++)
+    if (tls_fault_maps[i] != NULL)
+      munmap(tls_fault_maps[i], fault_file_sizes[i]);
+
+  free(tls_fault_maps);
+  tls_fault_maps = NULL;
+}
+
+
+static inline void fault_touch_write(char *p, size_t len)
+{
+  for (size_t off = 0; off < len; off += fault_page_size)
+    ck_pr_store_8((uint8_t *) p + off, 1);
+}
+
+
+static inline void fault_touch_read(const char *p, size_t len)
+{
+  uint64_t sum = 0;
+
+  for (size_t off = 0; off < len; off += fault_page_size)
+    sum += ck_pr_load_8((const uint8_t *) p + off);
+
+  tls_kernel_sink += sum;
+}
+
+
+/* Return the next block of the file set, dropping pages at the end of it */
+
+static char *fault_next_file_block(size_t *len)
+{
+  while (tls_fault_pos >= fault_file_sizes[tls_fault_file])
+  {
+    tls_fault_pos = 0;
+    if (++tls_fault_file == fault_nfiles)
+    {
+      tls_fault_file = 0;
+      for (unsigned int i = 0; i < fault_nfiles; i++)
+        if (tls_fault_maps[i] != NULL)
+          madvise(tls_fault_maps[i], fault_file_sizes[i], MADV_DONTNEED);
+    }
+  }
+
+  *len = SB_MIN(fault_block_size,
+                fault_file_sizes[tls_fault_file] - tls_fault_pos);
+
+  return tls_fault_maps[tls_fault_file] + tls_fault_pos;
+}
+
+
+int event_fault(sb_event_t *req, int thread_id)
+{
+  fault_stat_t    *stat = &fault_stats[thread_id];
+  size_t          len = fault_block_size;
+  char            *block = NULL;
+  struct timespec start, end;
+
+  (void) req; /* unused */
+
+  if (memory_faults == FAULTS_ANON || memory_faults == FAULTS_MADVISE)
+  {
+    if (tls_fault_pos == fault_region_size)
+    {
+      tls_fault_pos = 0;
+
+      /* Start over with fresh memory */
+      if (memory_faults == FAULTS_ANON)
+      {
+        munmap(tls_fault_region, fault_region_size);
+        if ((tls_fault_region = fault_map_anon(fault_region_size)) == NULL)
+          return 1;
+      }
+    }
+
+    block = tls_fault_region + tls_fault_pos;
+    tls_fault_pos += fault_block_size;
+  }
+  else if (memory_faults == FAULTS_FILE)
+  {
+    block = fault_next_file_block(&len);
+    tls_fault_pos += len;
+  }
+
+  SB_GETTIME(&start);
+
+  switch (memory_faults) {
+  case FAULTS_ANON:
+    fault_touch_write(block, len);
+    break;
+
+  case FAULTS_FILE:
+    fault_touch_read(block, len);
+    break;
+
+  case FAULTS_MMAP:
+    if ((block = fault_map_anon(len)) == NULL)
+      return 1;
+    fault_touch_write(block, len);
+    munmap(block, len);
+    break;
+
+  case FAULTS_MADVISE:
+    madvise(block, len, MADV_DONTNEED);
+    fault_touch_write(block, len);
+    break;
+
+  default:
+    break;
+  }
+
+  SB_GETTIME(&end);
+
+  ck_pr_store_64(&stat->ns, stat->ns + TIMESPEC_DIFF(end, start));
+  ck_pr_store_64(&stat->faults, stat->faults + len / fault_page_size);
+
+  return 0;
+}
+
+#else /* !SB_MEMORY_FAULTS */
+
+int faults_init(void)
+{
+  log_text(LOG_FATAL, "--memory-faults is not supported on this platform");
+  return 1;
+}
+
+
+int faults_thread_init(int thread_id)
+{
+  (void) thread_id; /* unused */
+
+  return 1;
+}
+
+
+void faults_thread_done(int thread_id)
+{
+  (void) thread_id; /* unused */
+}
+
+
+int event_fault(sb_event_t *req, int thread_id)
+{
+  (void) req; /* unused */
+  (void) thread_id; /* unused */
+
+  return 1;
+}
+
+#endif /* SB_MEMORY_FAULTS */
+
+
+void fault_get_stats(uint64_t *ns, uint64_t *faults)
+{
+  *ns = 0;
+  *faults = 0;
+
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+  {
+    *ns += ck_pr_load_64(&fault_stats[i].ns);
+    *faults += ck_pr_load_64(&fault_stats[i].faults);
+  }
+}
+
+/* Allocate a page-aligned buffer according to page options */
+
+void *memory_alloc(size_t size)
+{
+#ifdef HAVE_LARGE_PAGES
+  if (memory_hugetlb)
+    return hugetlb_alloc(size);
+#endif
+
+  if (memory_pages != SB_PAGES_DEFAULT || memory_populate)
+    return sb_alloc_pages(size, memory_pages, memory_populate);
+
+  return sb_memalign(size, sb_getpagesize());
+}
+
+
+/* Size of pages backing memory buffers */
+
+size_t memory_page_size(void)
+{
+#ifdef HAVE_LARGE_PAGES
+  if (memory_hugetlb)
+    return LARGE_PAGE_SIZE;
+#endif
+
+  return sb_pages_size(memory_pages);
 }
 
 #ifdef HAVE_LARGE_PAGES
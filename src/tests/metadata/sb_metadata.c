@@ -0,0 +1,707 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Filesystem metadata test. Each event is a single metadata operation on
+  empty files spread over a tree of directories shared by all threads. Every
+  thread only operates on files it has created, but all threads create,
+  rename and remove entries in the same directories, so directory locking
+  and journaling costs of the filesystem show up as threads are added.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#ifdef HAVE_LIMITS_H
+# include <limits.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <inttypes.h>
+
+#include "sysbench.h"
+#include "sb_timer.h"
+#include "sb_histogram.h"
+#include "sb_rand.h"
+#include "sb_ck_pr.h"
+
+/* Metadata test arguments */
+static sb_arg_t metadata_args[] =
+{
+  SB_OPT("metadata-dir", "directory to create the test tree in, must not "
+         "exist and is removed after the test", "sbtest_metadata", STRING),
+  SB_OPT("metadata-fanout", "number of subdirectories in each directory of "
+         "the tree", "4", INT),
+  SB_OPT("metadata-depth", "number of directory levels in the tree, files "
+         "are created in the directories of the last level", "2", INT),
+  SB_OPT("metadata-files", "number of files each thread creates before the "
+         "test", "256", INT),
+  SB_OPT("metadata-ops", "operations to pick from with equal probability "
+         "{create, open, stat, rename, unlink, readdir, fsync-dir}",
+         "create,open,stat,rename,unlink,readdir,fsync-dir", LIST),
+
+  SB_OPT_END
+};
+
+typedef enum
+{
+  META_OP_CREATE,               /* create and close a new empty file */
+  META_OP_OPEN,                 /* open and close an existing file */
+  META_OP_STAT,                 /* stat() an existing file */
+  META_OP_RENAME,               /* move a file to a random directory */
+  META_OP_UNLINK,               /* remove an existing file */
+  META_OP_READDIR,              /* list a random directory */
+  META_OP_FSYNC_DIR,            /* fsync() a random directory */
+  META_OP_MAX
+} meta_op_t;
+
+static const char *meta_op_names[] =
+{
+  "create", "open", "stat", "rename", "unlink", "readdir", "fsync-dir", NULL
+};
+
+/* Metadata test operations */
+static int metadata_init(void);
+static int metadata_thread_init(int);
+static int metadata_thread_done(int);
+static void metadata_print_mode(void);
+static sb_event_t metadata_next_event(int);
+static int metadata_execute_event(sb_event_t *, int);
+static void metadata_report_intermediate(sb_stat_t *);
+static void metadata_report_cumulative(sb_stat_t *);
+static int metadata_done(void);
+
+static sb_test_t metadata_test =
+{
+  .sname = "metadata",
+  .lname = "Filesystem metadata operations test",
+  .ops = {
+    .init = metadata_init,
+    .thread_init = metadata_thread_init,
+    .thread_done = metadata_thread_done,
+    .print_mode = metadata_print_mode,
+    .next_event = metadata_next_event,
+    .execute_event = metadata_execute_event,
+    .report_intermediate = metadata_report_intermediate,
+    .report_cumulative = metadata_report_cumulative,
+    .done = metadata_done
+  },
+  .args = metadata_args
+};
+
+/* A file is identified by its directory and a per-thread serial number */
+typedef struct
+{
+  uint32_t dir;
+  uint32_t serial;
+} meta_file_t;
+
+typedef struct
+{
+  uint64_t    ops[META_OP_MAX] CK_CC_CACHELINE; /* executed operations */
+
+  meta_file_t *files;           /* files owned by the thread */
+  unsigned int nfiles;
+  unsigned int maxfiles;
+  uint32_t    serial;           /* serial number for the next file */
+} meta_thread_t;
+
+static const char    *meta_root;
+static unsigned int  meta_fanout;
+static unsigned int  meta_depth;
+static unsigned int  meta_ndirs;        /* directories of the last level */
+static unsigned int  meta_files;
+
+static meta_op_t     meta_ops[META_OP_MAX];  /* enabled operations */
+static unsigned int  meta_nops;
+
+static meta_thread_t *meta_threads;
+
+/* Per-operation latency histograms */
+static sb_histogram_t meta_histograms[META_OP_MAX];
+static bool          meta_latency;
+
+/* Operation counts at the last intermediate and cumulative reports */
+static uint64_t      meta_ops_interm[META_OP_MAX];
+static uint64_t      meta_ops_cumul[META_OP_MAX];
+
+
+int register_test_metadata(sb_list_t *tests)
+{
+  SB_LIST_ADD_TAIL(&metadata_test.listitem, tests);
+
+  return 0;
+}
+
+
+/* Format the path of a directory at the given level of the tree */
+
+static void meta_dir_path(char *buf, size_t size, unsigned int level,
+                          unsigned int dir)
+{
+  size_t       len = (size_t) snprintf(buf, size, "%s", meta_root);
+  unsigned int div = 1;
+
+  for (unsigned int i = 1; i < level; i++)
+    div *= meta_fanout;
+
+  /* One path component per level, most significant digit first */
+  for (unsigned int i = 0; i < level && len < size; i++, div /= meta_fanout)
+    len += (size_t) snprintf(buf + len, size - len, "/d%u",
+                             dir / div % meta_fanout);
+}
+
+
+static void meta_file_path(char *buf, size_t size, const meta_file_t *f,
+                           int thread_id)
+{
+  size_t len;
+
+  meta_dir_path(buf, size, meta_depth, f->dir);
+  len = strlen(buf);
+  snprintf(buf + len, size - len, "/f%d_%" PRIu32, thread_id, f->serial);
+}
+
+
+/* Create all directories of the tree, from the root down */
+
+static int meta_tree_create(void)
+{
+  char         path[PATH_MAX];
+  unsigned int n = 1;
+
+  for (unsigned int level = 0; level <= meta_depth; level++)
+  {
+    for (unsigned int dir = 0; dir < n; dir++)
+    {
+      meta_dir_path(path, sizeof(path), level, dir);
+      if (mkdir(path, 0755))
+      {
+        log_errno(LOG_FATAL, "Cannot create directory '%s'", path);
+        return 1;
+      }
+    }
+
+    n *= meta_fanout;
+  }
+
+  return 0;
+}
+
+
+static int meta_tree_remove(void)
+{
+  /* Directories of level i are removed after those of level i + 1 */
+  for (unsigned int level = meta_depth + 1; level-- > 0;)
+  {
+    char         path[PATH_MAX];
+    unsigned int n = 1;
+
+    for (unsigned int i = 0; i < level; i++)
+      n *= meta_fanout;
+
+    for (unsigned int dir = 0; dir < n; dir++)
+    {
+      meta_dir_path(path, sizeof(path), level, dir);
+      if (rmdir(path) && errno != ENOENT)
+      {
+        log_errno(LOG_FATAL, "Cannot remove directory '%s'", path);
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+int metadata_init(void)
+{
+  sb_list_item_t *pos;
+  int            i;
+
+  meta_root = sb_get_value_string("metadata-dir");
+
+  i = sb_get_value_int("metadata-fanout");
+  if (i <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for metadata-fanout: %d", i);
+    return 1;
+  }
+  meta_fanout = (unsigned int) i;
+
+  i = sb_get_value_int("metadata-depth");
+  if (i < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for metadata-depth: %d", i);
+    return 1;
+  }
+  meta_depth = (unsigned int) i;
+
+  meta_ndirs = 1;
+  for (unsigned int l = 0; l < meta_depth; l++)
+  {
+    meta_ndirs *= meta_fanout;
+    if (meta_ndirs > 1000000)
+    {
+      log_text(LOG_FATAL, "--metadata-fanout and --metadata-depth result in "
+               "too many directories");
+      return 1;
+    }
+  }
+
+  i = sb_get_value_int("metadata-files");
+  if (i < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for metadata-files: %d", i);
+    return 1;
+  }
+  meta_files = (unsigned int) i;
+
+  meta_nops = 0;
+  SB_LIST_FOR_EACH(pos, sb_get_value_list("metadata-ops"))
+  {
+    const char *val = SB_LIST_ENTRY(pos, value_t, listitem)->data;
+
+    for (i = 0; meta_op_names[i] != NULL; i++)
+      if (!strcmp(meta_op_names[i], val))
+        break;
+    if (meta_op_names[i] == NULL)
+    {
+      log_text(LOG_FATAL, "Invalid value for metadata-ops: %s", val);
+      return 1;
+    }
+
+    /* Ignore duplicates */
+    unsigned int n;
+    for (n = 0; n < meta_nops; n++)
+      if (meta_ops[n] == (meta_op_t) i)
+        break;
+    if (n == meta_nops)
+      meta_ops[meta_nops++] = (meta_op_t) i;
+  }
+
+  if (meta_nops == 0)
+  {
+    log_text(LOG_FATAL, "--metadata-ops cannot be empty");
+    return 1;
+  }
+
+  meta_threads = sb_alloc_per_thread_array(sizeof(meta_thread_t));
+  if (meta_threads == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  memset(meta_ops_interm, 0, sizeof(meta_ops_interm));
+  memset(meta_ops_cumul, 0, sizeof(meta_ops_cumul));
+
+  meta_latency = sb_globals.npercentiles > 0;
+  for (i = 0; meta_latency && i < META_OP_MAX; i++)
+  {
+    if (oper_histogram_init(&meta_histograms[i]))
+      return 1;
+  }
+
+  return meta_tree_create();
+}
+
+
+int metadata_done(void)
+{
+  int rc = meta_tree_remove();
+
+  if (meta_latency)
+  {
+    for (int i = 0; i < META_OP_MAX; i++)
+      sb_histogram_done(&meta_histograms[i]);
+  }
+  meta_latency = false;
+
+  free(meta_threads);
+  meta_threads = NULL;
+
+  return rc;
+}
+
+
+static int meta_create(meta_thread_t *t, int thread_id)
+{
+  char        path[PATH_MAX];
+  meta_file_t *f = &t->files[t->nfiles];
+  int         fd;
+
+  f->dir = sb_rand_uniform(0, meta_ndirs - 1);
+  f->serial = t->serial++;
+
+  meta_file_path(path, sizeof(path), f, thread_id);
+
+  fd = open(path, O_CREAT | O_EXCL | O_WRONLY, 0644);
+  if (fd < 0)
+  {
+    log_errno(LOG_FATAL, "Cannot create file '%s'", path);
+    return 1;
+  }
+  close(fd);
+
+  t->nfiles++;
+
+  return 0;
+}
+
+
+static int meta_unlink(meta_thread_t *t, unsigned int idx, int thread_id)
+{
+  char path[PATH_MAX];
+
+  meta_file_path(path, sizeof(path), &t->files[idx], thread_id);
+
+  if (unlink(path))
+  {
+    log_errno(LOG_FATAL, "Cannot remove file '%s'", path);
+    return 1;
+  }
+
+  t->files[idx] = t->files[--t->nfiles];
+
+  return 0;
+}
+
+
+int metadata_thread_init(int thread_id)
+{
+  meta_thread_t * const t = &meta_threads[thread_id];
+
+  /* create and unlink are equally likely, so there is room to grow */
+  t->maxfiles = meta_files * 2 + 64;
+  t->files = malloc(t->maxfiles * sizeof(meta_file_t));
+  if (t->files == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  t->nfiles = 0;
+  t->serial = 0;
+
+  for (unsigned int i = 0; i < meta_files; i++)
+    if (meta_create(t, thread_id))
+      return 1;
+
+  return 0;
+}
+
+
+int metadata_thread_done(int thread_id)
+{
+  meta_thread_t * const t = &meta_threads[thread_id];
+  int                   rc = 0;
+
+  while (t->nfiles > 0 && rc == 0)
+    rc = meta_unlink(t, t->nfiles - 1, thread_id);
+
+  free(t->files);
+  t->files = NULL;
+
+  return rc;
+}
+
+
+sb_event_t metadata_next_event(int thread_id)
+{
+  sb_event_t req;
+
+  (void) thread_id; /* unused */
+
+  req.type = SB_REQ_TYPE_METADATA;
+
+  return req;
+}
+
+
+static int meta_execute(meta_op_t op, meta_thread_t *t, int thread_id)
+{
+  char         path[PATH_MAX];
+  char         newpath[PATH_MAX];
+  struct stat  st;
+  unsigned int idx = t->nfiles > 0 ? sb_rand_uniform(0, t->nfiles - 1) : 0;
+  int          fd;
+
+  switch (op) {
+  case META_OP_CREATE:
+    return meta_create(t, thread_id);
+
+  case META_OP_OPEN:
+    meta_file_path(path, sizeof(path), &t->files[idx], thread_id);
+    if ((fd = open(path, O_RDONLY)) < 0)
+    {
+      log_errno(LOG_FATAL, "Cannot open file '%s'", path);
+      return 1;
+    }
+    close(fd);
+    return 0;
+
+  case META_OP_STAT:
+    meta_file_path(path, sizeof(path), &t->files[idx], thread_id);
+    if (stat(path, &st))
+    {
+      log_errno(LOG_FATAL, "Cannot stat file '%s'", path);
+      return 1;
+    }
+    return 0;
+
+  case META_OP_RENAME:
+    {
+      meta_file_t f = {
+        .dir = sb_rand_uniform(0, meta_ndirs - 1),
+        .serial = t->serial++
+      };
+
+      meta_file_path(path, sizeof(path), &t->files[idx], thread_id);
+      meta_file_path(newpath, sizeof(newpath), &f, thread_id);
+      if (rename(path, newpath))
+      {
+        log_errno(LOG_FATAL, "Cannot rename file '%s' to '%s'", path,
+                  newpath);
+        return 1;
+      }
+      t->files[idx] = f;
+    }
+    return 0;
+
+  case META_OP_UNLINK:
+    return meta_unlink(t, idx, thread_id);
+
+  case META_OP_READDIR:
+    {
+      DIR *dir;
+
+      meta_dir_path(path, sizeof(path), meta_depth,
+                    sb_rand_uniform(0, meta_ndirs - 1));
+      if ((dir = opendir(path)) == NULL)
+      {
+        log_errno(LOG_FATAL, "Cannot open directory '%s'", path);
+        return 1;
+      }
+      while (readdir(dir) != NULL)
+        ;
+      closedir(dir);
+    }
+    return 0;
+
+  case META_OP_FSYNC_DIR:
+    meta_dir_path(path, sizeof(path), meta_depth,
+                  sb_rand_uniform(0, meta_ndirs - 1));
+    if ((fd = open(path, O_RDONLY)) < 0)
+    {
+      log_errno(LOG_FATAL, "Cannot open directory '%s'", path);
+      return 1;
+    }
+    if (fsync(fd))
+    {
+      log_errno(LOG_FATAL, "Cannot fsync directory '%s'", path);
+      close(fd);
+      return 1;
+    }
+    close(fd);
+    return 0;
+
+  default:
+    return 1;
+  }
+}
+
+
+int metadata_execute_event(sb_event_t *r, int thread_id)
+{
+  meta_thread_t * const t = &meta_threads[thread_id];
+  meta_op_t             op = meta_ops[sb_rand_uniform(0, meta_nops - 1)];
+  struct timespec       ts;
+  uint64_t              start_ns = 0;
+
+  (void) r; /* unused */
+
+  /* Keep the number of files within bounds */
+  if (t->nfiles == 0 && op != META_OP_READDIR && op != META_OP_FSYNC_DIR)
+    op = META_OP_CREATE;
+  else if (op == META_OP_CREATE && t->nfiles == t->maxfiles)
+    op = META_OP_UNLINK;
+
+  if (meta_latency)
+  {
+    SB_GETTIME(&ts);
+    start_ns = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+  }
+
+  if (meta_execute(op, t, thread_id))
+    return 1;
+
+  if (meta_latency)
+  {
+    SB_GETTIME(&ts);
+    sb_histogram_update(&meta_histograms[op],
+                        NS2MS(SEC2NS(ts.tv_sec) + ts.tv_nsec - start_ns));
+  }
+
+  ck_pr_store_64(&t->ops[op], t->ops[op] + 1);
+
+  return 0;
+}
+
+
+void metadata_print_mode(void)
+{
+  char ops[128];
+  size_t len = 0;
+
+  ops[0] = '\0';
+  for (unsigned int i = 0; i < meta_nops && len < sizeof(ops); i++)
+    len += (size_t) snprintf(ops + len, sizeof(ops) - len, "%s%s",
+                             i > 0 ? ", " : "", meta_op_names[meta_ops[i]]);
+
+  log_text(LOG_INFO, "Doing filesystem metadata test\n");
+  log_text(LOG_NOTICE, "Directory tree: %u level(s), %u subdirectories per "
+           "directory, %u file directories", meta_depth, meta_fanout,
+           meta_ndirs);
+  log_text(LOG_NOTICE, "Files: %u per thread, operations: %s\n", meta_files,
+           ops);
+}
+
+
+/* Sum operation counts of all threads */
+
+static void meta_ops_total(uint64_t *ops)
+{
+  for (int op = 0; op < META_OP_MAX; op++)
+  {
+    ops[op] = 0;
+    for (unsigned int i = 0; i < sb_globals.threads; i++)
+      ops[op] += ck_pr_load_64(&meta_threads[i].ops[op]);
+  }
+}
+
+
+/* Print intermediate stats. */
+
+void metadata_report_intermediate(sb_stat_t *stat)
+{
+  char     buf[512];
+  size_t   len = 0;
+  uint64_t ops[META_OP_MAX];
+
+  sb_report_intermediate(stat);
+
+  meta_ops_total(ops);
+
+  buf[0] = '\0';
+
+  for (unsigned int i = 0; i < meta_nops && len < sizeof(buf); i++)
+  {
+    const meta_op_t op = meta_ops[i];
+
+    len += (size_t) snprintf(buf + len, sizeof(buf) - len, "%s: %4.2f/s ",
+                             meta_op_names[op],
+                             (ops[op] - meta_ops_interm[op]) /
+                             stat->time_interval);
+
+    if (meta_latency && len < sizeof(buf))
+    {
+      double *pcts =
+        sb_histogram_get_pct_intermediate(&meta_histograms[op],
+                                          sb_globals.percentiles,
+                                          sb_globals.npercentiles);
+      char   *str = create_pct_string_intermediate(sb_globals.percentiles,
+                                                   pcts,
+                                                   sb_globals.npercentiles);
+
+      len += (size_t) snprintf(buf + len, sizeof(buf) - len, "%s", str);
+
+      free(str);
+      free(pcts);
+    }
+
+    meta_ops_interm[op] = ops[op];
+  }
+
+  log_timestamp(LOG_NOTICE, stat->time_total, "%s", buf);
+}
+
+
+/* Print cumulative stats. */
+
+void metadata_report_cumulative(sb_stat_t *stat)
+{
+  uint64_t ops[META_OP_MAX];
+
+  meta_ops_total(ops);
+
+  log_text(LOG_NOTICE, "Operations:");
+  for (unsigned int i = 0; i < meta_nops; i++)
+  {
+    const meta_op_t op = meta_ops[i];
+
+    log_text(LOG_NOTICE, "    %-10s %10" PRIu64 " (%.2f per second)",
+             meta_op_names[op], ops[op] - meta_ops_cumul[op],
+             (ops[op] - meta_ops_cumul[op]) / stat->time_interval);
+    meta_ops_cumul[op] = ops[op];
+  }
+
+  if (!meta_latency)
+  {
+    sb_report_cumulative(stat);
+    return;
+  }
+
+  for (unsigned int i = 0; i < meta_nops; i++)
+  {
+    const meta_op_t op = meta_ops[i];
+    double *pcts = sb_histogram_get_pct_checkpoint(&meta_histograms[op],
+                                                   sb_globals.percentiles,
+                                                   sb_globals.npercentiles);
+    char   *str = create_pct_string_cumulative(sb_globals.percentiles, pcts,
+                                               sb_globals.npercentiles);
+
+    /* Drop the trailing newline, it goes between the sections */
+    if (*str != '\0')
+      str[strlen(str) - 1] = '\0';
+
+    log_text(LOG_NOTICE, "\nLatency of %s operations (ms):", meta_op_names[op]);
+    log_text(LOG_NOTICE, "%s", str);
+
+    free(str);
+    free(pcts);
+  }
+
+  sb_report_cumulative(stat);
+}
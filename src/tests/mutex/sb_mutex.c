@@ -24,13 +24,55 @@
 # include <pthread.h>
 #endif
 
+#include <math.h>
+
+#if defined(HAVE_LINUX_FUTEX_H) && defined(HAVE_SYS_SYSCALL_H)
+# include <linux/futex.h>
+# include <sys/syscall.h>
+# define SB_MUTEX_FUTEX
+#endif
+
 #include "sysbench.h"
 #include "sb_ck_pr.h"
 #include "sb_rand.h"
+#include "sb_util.h"
+
+#include "ck_spinlock.h"
+#include "ck_rwlock.h"
+
+/* Lock implementations selected with --mutex-type */
+typedef enum
+{
+  LOCK_PTHREAD,                 /* pthread_mutex_t */
+  LOCK_ADAPTIVE,                /* pthread_mutex_t, PTHREAD_MUTEX_ADAPTIVE_NP */
+  LOCK_PTHREAD_RWLOCK,          /* pthread_rwlock_t, exclusive locks */
+  LOCK_SPINLOCK,                /* test-and-set spinlock */
+  LOCK_TICKET,                  /* ticket spinlock */
+  LOCK_MCS,                     /* MCS queue spinlock */
+  LOCK_CLH,                     /* CLH queue spinlock */
+  LOCK_CK_RWLOCK,               /* ck_rwlock_t, exclusive locks */
+  LOCK_FUTEX                    /* futex-based mutex */
+} lock_type_t;
+
+static const char *lock_type_names[] =
+{
+  "pthread", "adaptive", "pthread-rwlock", "spinlock", "ticket", "mcs", "clh",
+  "ck-rwlock", "futex", NULL
+};
 
 typedef struct
 {
-  pthread_mutex_t mutex;
+  union
+  {
+    pthread_mutex_t      mutex;
+    pthread_rwlock_t     rwlock;
+    ck_spinlock_fas_t    spinlock;
+    ck_spinlock_ticket_t ticket;
+    ck_spinlock_mcs_t    mcs;
+    ck_spinlock_clh_t    *clh;
+    ck_rwlock_t          ck_rwlock;
+    unsigned int         futex;
+  } u;
   char            pad[256];
 } thread_lock;
 
@@ -42,6 +84,20 @@ static sb_arg_t mutex_args[] =
   SB_OPT("mutex-locks", "number of mutex locks to do per thread", "50000", INT),
   SB_OPT("mutex-loops", "number of empty loops to do outside mutex lock",
          "10000", INT),
+  /* read-write locks are always acquired in exclusive mode */
+  SB_OPT("mutex-type", "lock implementation {pthread, adaptive, "
+         "pthread-rwlock, spinlock, ticket, mcs, clh, ck-rwlock, futex}",
+         "pthread", STRING),
+  SB_OPT("mutex-dist", "distribution of lock numbers {uniform, gaussian, "
+         "pareto, zipfian}", "uniform", STRING),
+  SB_OPT("mutex-cs-reads", "number of cache lines protected by each lock to "
+         "read inside the critical section", "0", INT),
+  SB_OPT("mutex-cs-writes", "number of cache lines protected by each lock to "
+         "write inside the critical section", "0", INT),
+  SB_OPT("mutex-hold-loops", "average number of empty loops to do inside "
+         "mutex lock", "0", INT),
+  SB_OPT("mutex-hold-dist", "distribution of the number of loops inside mutex "
+         "lock {fixed, uniform, exponential}", "fixed", STRING),
 
   SB_OPT_END
 };
@@ -73,8 +129,45 @@ static unsigned int mutex_num;
 static unsigned int mutex_loops;
 static unsigned int mutex_locks;
 static unsigned int global_var;
+static lock_type_t  mutex_type;
+
+/* Lock number generator, selected with --mutex-dist */
+static uint32_t (*mutex_rand)(uint32_t, uint32_t);
+
+/*
+  Data protected by locks. Each lock owns mutex_cs_lines cache lines, only the
+  first word of each line is accessed.
+*/
+typedef struct
+{
+  uint64_t        val;
+  char            pad[CK_MD_CACHELINE - sizeof(uint64_t)];
+} cs_line_t;
+
+static cs_line_t    *cs_data;
+static unsigned int mutex_cs_reads;
+static unsigned int mutex_cs_writes;
+static unsigned int mutex_cs_lines;
+
+typedef enum
+{
+  HOLD_FIXED,
+  HOLD_UNIFORM,
+  HOLD_EXPONENTIAL
+} hold_dist_t;
+
+static unsigned int mutex_hold_loops;
+static hold_dist_t  mutex_hold_dist;
+
+/*
+  CLH nodes. Each lock needs an initial node and each thread owns one node at a
+  time, but nodes migrate between threads and locks, so all of them are
+  allocated from a single array.
+*/
+static ck_spinlock_clh_t *clh_nodes;
 
 static TLS int tls_counter;
+static TLS ck_spinlock_clh_t *tls_clh_node;
 
 int register_test_mutex(sb_list_t *tests)
 {
@@ -86,12 +179,90 @@ int register_test_mutex(sb_list_t *tests)
 
 int mutex_init(void)
 {
-  unsigned int i;
+  unsigned int        i;
+  const char          *s;
+  pthread_mutexattr_t attr;
   
   mutex_num = sb_get_value_int("mutex-num");
   mutex_loops = sb_get_value_int("mutex-loops");
   mutex_locks = sb_get_value_int("mutex-locks");
 
+  s = sb_get_value_string("mutex-type");
+  for (i = 0; lock_type_names[i] != NULL; i++)
+    if (!strcmp(s, lock_type_names[i]))
+      break;
+
+  if (lock_type_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for mutex-type: %s", s);
+    return 1;
+  }
+  mutex_type = (lock_type_t) i;
+
+  s = sb_get_value_string("mutex-dist");
+  if (!strcmp(s, "uniform"))
+    mutex_rand = sb_rand_uniform;
+  else if (!strcmp(s, "gaussian"))
+    mutex_rand = sb_rand_gaussian;
+  else if (!strcmp(s, "pareto"))
+    mutex_rand = sb_rand_pareto;
+  else if (!strcmp(s, "zipfian"))
+    mutex_rand = sb_rand_zipfian;
+  else
+  {
+    log_text(LOG_FATAL, "Invalid value for mutex-dist: %s", s);
+    return 1;
+  }
+
+  mutex_hold_loops = sb_get_value_int("mutex-hold-loops");
+  s = sb_get_value_string("mutex-hold-dist");
+  if (!strcmp(s, "fixed"))
+    mutex_hold_dist = HOLD_FIXED;
+  else if (!strcmp(s, "uniform"))
+    mutex_hold_dist = HOLD_UNIFORM;
+  else if (!strcmp(s, "exponential"))
+    mutex_hold_dist = HOLD_EXPONENTIAL;
+  else
+  {
+    log_text(LOG_FATAL, "Invalid value for mutex-hold-dist: %s", s);
+    return 1;
+  }
+
+  mutex_cs_reads = sb_get_value_int("mutex-cs-reads");
+  mutex_cs_writes = sb_get_value_int("mutex-cs-writes");
+  mutex_cs_lines = SB_MAX(mutex_cs_reads, mutex_cs_writes);
+
+  if (mutex_cs_lines > 0)
+  {
+    size_t size = (size_t) mutex_num * mutex_cs_lines * sizeof(cs_line_t);
+
+    cs_data = sb_memalign(size, CK_MD_CACHELINE);
+    if (cs_data == NULL)
+    {
+      log_text(LOG_FATAL, "Failed to allocate %zu bytes for lock data", size);
+      return 1;
+    }
+    memset(cs_data, 0, size);
+  }
+
+#ifndef PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP
+  if (mutex_type == LOCK_ADAPTIVE)
+  {
+    log_text(LOG_FATAL, "--mutex-type=adaptive is not supported on this "
+             "platform");
+    return 1;
+  }
+#endif
+
+#ifndef SB_MUTEX_FUTEX
+  if (mutex_type == LOCK_FUTEX)
+  {
+    log_text(LOG_FATAL, "--mutex-type=futex is not supported on this "
+             "platform");
+    return 1;
+  }
+#endif
+
   thread_locks = (thread_lock *)malloc(mutex_num * sizeof(thread_lock));
   if (thread_locks == NULL)
   {
@@ -99,8 +270,57 @@ int mutex_init(void)
     return 1;
   }
 
+  if (mutex_type == LOCK_CLH)
+  {
+    clh_nodes = calloc(mutex_num + sb_globals.threads,
+                       sizeof(ck_spinlock_clh_t));
+    if (clh_nodes == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure!");
+      return 1;
+    }
+  }
+
+  pthread_mutexattr_init(&attr);
+#ifdef PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP
+  if (mutex_type == LOCK_ADAPTIVE)
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ADAPTIVE_NP);
+#endif
+
   for (i = 0; i < mutex_num; i++)
-    pthread_mutex_init(&thread_locks[i].mutex, NULL);
+  {
+    thread_lock *lock = &thread_locks[i];
+
+    switch (mutex_type) {
+    case LOCK_PTHREAD:
+    case LOCK_ADAPTIVE:
+      pthread_mutex_init(&lock->u.mutex, &attr);
+      break;
+    case LOCK_PTHREAD_RWLOCK:
+      pthread_rwlock_init(&lock->u.rwlock, NULL);
+      break;
+    case LOCK_SPINLOCK:
+      ck_spinlock_fas_init(&lock->u.spinlock);
+      break;
+    case LOCK_TICKET:
+      ck_spinlock_ticket_init(&lock->u.ticket);
+      break;
+    case LOCK_MCS:
+      ck_spinlock_mcs_init(&lock->u.mcs);
+      break;
+    case LOCK_CLH:
+      ck_spinlock_clh_init(&lock->u.clh, &clh_nodes[i]);
+      break;
+    case LOCK_CK_RWLOCK:
+      ck_rwlock_init(&lock->u.ck_rwlock);
+      break;
+    case LOCK_FUTEX:
+      lock->u.futex = 0;
+      break;
+    }
+  }
+
+  pthread_mutexattr_destroy(&attr);
   
   return 0;
 }
@@ -111,13 +331,171 @@ int mutex_done(void)
   unsigned int i;
 
   for(i=0; i < mutex_num; i++)
-    pthread_mutex_destroy(&thread_locks[i].mutex);
+  {
+    if (mutex_type == LOCK_PTHREAD || mutex_type == LOCK_ADAPTIVE)
+      pthread_mutex_destroy(&thread_locks[i].u.mutex);
+    else if (mutex_type == LOCK_PTHREAD_RWLOCK)
+      pthread_rwlock_destroy(&thread_locks[i].u.rwlock);
+  }
   free(thread_locks);
+  free(clh_nodes);
+  free(cs_data);
   
   return 0;
 }
 
 
+#ifdef SB_MUTEX_FUTEX
+
+/*
+  Futex-based mutex from "Futexes Are Tricky" by Ulrich Drepper. The lock word
+  is 0 when unlocked, 1 when locked without waiters and 2 when locked with
+  possible waiters.
+*/
+
+static inline void futex_lock(unsigned int *futex)
+{
+  unsigned int c;
+
+  if (ck_pr_cas_uint_value(futex, 0, 1, &c))
+    return;
+
+  if (c != 2)
+    c = ck_pr_fas_uint(futex, 2);
+
+  while (c != 0)
+  {
+    syscall(SYS_futex, futex, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+    c = ck_pr_fas_uint(futex, 2);
+  }
+}
+
+
+static inline void futex_unlock(unsigned int *futex)
+{
+  if (ck_pr_faa_uint(futex, (unsigned int) -1) != 1)
+  {
+    ck_pr_store_uint(futex, 0);
+    syscall(SYS_futex, futex, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+  }
+}
+
+#endif /* SB_MUTEX_FUTEX */
+
+
+/* Acquire a lock, 'mcs' is the queue node for MCS locks */
+
+static inline void lock_acquire(thread_lock *lock, ck_spinlock_mcs_context_t *mcs)
+{
+  switch (mutex_type) {
+  case LOCK_PTHREAD:
+  case LOCK_ADAPTIVE:
+    pthread_mutex_lock(&lock->u.mutex);
+    break;
+  case LOCK_PTHREAD_RWLOCK:
+    pthread_rwlock_wrlock(&lock->u.rwlock);
+    break;
+  case LOCK_SPINLOCK:
+    ck_spinlock_fas_lock(&lock->u.spinlock);
+    break;
+  case LOCK_TICKET:
+    ck_spinlock_ticket_lock(&lock->u.ticket);
+    break;
+  case LOCK_MCS:
+    ck_spinlock_mcs_lock(&lock->u.mcs, mcs);
+    break;
+  case LOCK_CLH:
+    ck_spinlock_clh_lock(&lock->u.clh, tls_clh_node);
+    break;
+  case LOCK_CK_RWLOCK:
+    ck_rwlock_write_lock(&lock->u.ck_rwlock);
+    break;
+  case LOCK_FUTEX:
+#ifdef SB_MUTEX_FUTEX
+    futex_lock(&lock->u.futex);
+#endif
+    break;
+  }
+}
+
+
+static inline void lock_release(thread_lock *lock, ck_spinlock_mcs_context_t *mcs)
+{
+  switch (mutex_type) {
+  case LOCK_PTHREAD:
+  case LOCK_ADAPTIVE:
+    pthread_mutex_unlock(&lock->u.mutex);
+    break;
+  case LOCK_PTHREAD_RWLOCK:
+    pthread_rwlock_unlock(&lock->u.rwlock);
+    break;
+  case LOCK_SPINLOCK:
+    ck_spinlock_fas_unlock(&lock->u.spinlock);
+    break;
+  case LOCK_TICKET:
+    ck_spinlock_ticket_unlock(&lock->u.ticket);
+    break;
+  case LOCK_MCS:
+    ck_spinlock_mcs_unlock(&lock->u.mcs, mcs);
+    break;
+  case LOCK_CLH:
+    /* Takes over the predecessor's node */
+    ck_spinlock_clh_unlock(&tls_clh_node);
+    break;
+  case LOCK_CK_RWLOCK:
+    ck_rwlock_write_unlock(&lock->u.ck_rwlock);
+    break;
+  case LOCK_FUTEX:
+#ifdef SB_MUTEX_FUTEX
+    futex_unlock(&lock->u.futex);
+#endif
+    break;
+  }
+}
+
+
+/* Number of loops to spin while holding a lock */
+
+static inline unsigned int hold_loops(void)
+{
+  switch (mutex_hold_dist) {
+  case HOLD_UNIFORM:
+    return sb_rand_uniform(0, 2 * mutex_hold_loops);
+  case HOLD_EXPONENTIAL:
+    return (unsigned int) (-log(1.0 - sb_rand_uniform_double()) *
+                           mutex_hold_loops);
+  case HOLD_FIXED:
+  default:
+    return mutex_hold_loops;
+  }
+}
+
+
+/* Work done while holding a lock */
+
+static inline void critical_section(unsigned int lock_num)
+{
+  cs_line_t     *data = cs_data + (size_t) lock_num * mutex_cs_lines;
+  uint64_t      sum = 0;
+  unsigned int  i, n;
+
+  global_var++;
+
+  for (i = 0; i < mutex_cs_reads; i++)
+    sum += ck_pr_load_64(&data[i].val);
+
+  for (i = 0; i < mutex_cs_writes; i++)
+    data[i].val += sum + 1;
+
+  if (mutex_hold_loops > 0)
+  {
+    n = hold_loops();
+    for (i = 0; i < n; i++)
+      ck_pr_barrier();
+  }
+}
+
+
 sb_event_t mutex_next_event(int thread_id)
 {
   sb_event_t         sb_req;
@@ -141,22 +519,24 @@ sb_event_t mutex_next_event(int thread_id)
 
 int mutex_execute_event(sb_event_t *sb_req, int thread_id)
 {
-  unsigned int         i;
-  unsigned int         current_lock;
-  sb_mutex_request_t   *mutex_req = &sb_req->u.mutex_request;
+  unsigned int              i;
+  unsigned int              current_lock;
+  sb_mutex_request_t        *mutex_req = &sb_req->u.mutex_request;
+  ck_spinlock_mcs_context_t mcs;
 
-  (void) thread_id; /* unused */
+  if (mutex_type == LOCK_CLH)
+    tls_clh_node = &clh_nodes[mutex_num + thread_id];
 
   do
   {
-    current_lock = sb_rand_uniform(0, mutex_num - 1);
+    current_lock = mutex_rand(0, mutex_num - 1);
 
     for (i = 0; i < mutex_req->nloops; i++)
       ck_pr_barrier();
 
-    pthread_mutex_lock(&thread_locks[current_lock].mutex);
-    global_var++;
-    pthread_mutex_unlock(&thread_locks[current_lock].mutex);
+    lock_acquire(&thread_locks[current_lock], &mcs);
+    critical_section(current_lock);
+    lock_release(&thread_locks[current_lock], &mcs);
     mutex_req->nlocks--;
   }
   while (mutex_req->nlocks > 0);
@@ -168,5 +548,14 @@ int mutex_execute_event(sb_event_t *sb_req, int thread_id)
 void mutex_print_mode(void)
 {
   log_text(LOG_INFO, "Doing mutex performance test");
+  if (mutex_type != LOCK_PTHREAD)
+    log_text(LOG_NOTICE, "Lock implementation: %s",
+             lock_type_names[mutex_type]);
+  if (mutex_cs_lines > 0)
+    log_text(LOG_NOTICE, "Critical section: %u cache line(s) read, "
+             "%u cache line(s) written", mutex_cs_reads, mutex_cs_writes);
+  if (mutex_hold_loops > 0)
+    log_text(LOG_NOTICE, "Hold time: %u loops on average, %s distribution",
+             mutex_hold_loops, sb_get_value_string("mutex-hold-dist"));
 }
 
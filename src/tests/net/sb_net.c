@@ -0,0 +1,1177 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Network request/response test. Each event is a round trip on every
+  connection of the thread: a request is sent on all connections at once and
+  the event completes when all responses are received, so with a single
+  connection per thread the event latency is the round trip time. Requests
+  carry a header with the size of the response to send back, so the server
+  needs no configuration.
+
+  The echo server is either a sysbench instance running the test with
+  --net-mode=server, in which case each served request is an event timed from
+  its arrival until the response is sent, or a background thread of the client
+  listening on the loopback interface with --net-mode=loopback. All sockets
+  are non-blocking and multiplexed with poll().
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef STDC_HEADERS
+# include <stdio.h>
+# include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#ifdef HAVE_SYS_SOCKET_H
+# include <sys/socket.h>
+#endif
+#ifdef HAVE_NETINET_IN_H
+# include <netinet/in.h>
+#endif
+#ifdef HAVE_NETINET_TCP_H
+# include <netinet/tcp.h>
+#endif
+#ifdef HAVE_NETDB_H
+# include <netdb.h>
+#endif
+#ifdef HAVE_POLL_H
+# include <poll.h>
+#endif
+
+#include <pthread.h>
+#include <inttypes.h>
+
+#include "sysbench.h"
+#include "sb_timer.h"
+#include "sb_util.h"
+#include "sb_ck_pr.h"
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+/* Network test arguments */
+static sb_arg_t net_args[] =
+{
+  SB_OPT("net-mode", "test mode {loopback, client, server}. loopback runs "
+         "the echo server in a background thread on 127.0.0.1", "loopback",
+         STRING),
+  SB_OPT("net-proto", "transport protocol {tcp, udp}", "tcp", STRING),
+  SB_OPT("net-address", "[host:]port of the echo server to connect to, or "
+         "to listen on with --net-mode=server", "127.0.0.1:7070", STRING),
+  SB_OPT("net-request-size", "size of a request including a 16-byte header",
+         "64", SIZE),
+  SB_OPT("net-response-size", "size of a response including a 16-byte "
+         "header", "64", SIZE),
+  SB_OPT("net-connections", "number of connections per thread, each event "
+         "sends a request on all of them", "1", INT),
+  SB_OPT("net-timeout", "time in milliseconds to wait for responses. Missing "
+         "UDP responses are counted as lost, a TCP timeout is an error",
+         "1000", INT),
+
+  SB_OPT_END
+};
+
+typedef enum
+{
+  NET_MODE_LOOPBACK,
+  NET_MODE_CLIENT,
+  NET_MODE_SERVER
+} net_mode_t;
+
+static const char *net_mode_names[] = {"loopback", "client", "server", NULL};
+
+typedef enum
+{
+  NET_PROTO_TCP,
+  NET_PROTO_UDP
+} net_proto_t;
+
+static const char *net_proto_names[] = {"tcp", "udp", NULL};
+
+/* Request and response header, all fields in network byte order */
+typedef struct
+{
+  uint32_t magic;
+  uint32_t request_size;
+  uint32_t response_size;
+  uint32_t seq;                 /* matches UDP responses to requests */
+} net_header_t;
+
+#define NET_MAGIC 0x53424e54    /* "SBNT" */
+#define NET_HEADER_SIZE sizeof(net_header_t)
+
+/* Maximum payload of an IPv4 UDP datagram */
+#define NET_UDP_MAX 65507
+#define NET_TCP_MAX (1U << 30)
+
+/* Size of send and receive buffers, messages are transferred in chunks */
+#define NET_CHUNK_SIZE ((size_t) 65536)
+
+static const double mebibyte = 1024 * 1024;
+
+/* Poll timeout of server loops, i.e. how often they check for the end */
+#define NET_SERVER_POLL_MS 100
+
+/* Client connection */
+typedef struct
+{
+  int    fd;
+  size_t sent;
+  size_t received;
+} net_conn_t;
+
+/* Connection accepted by a server */
+typedef struct
+{
+  int             fd;
+  net_header_t    hdr;
+  size_t          hdr_len;      /* bytes of the header received */
+  size_t          request_left; /* bytes of the request to receive */
+  size_t          response_size;
+  size_t          response_left; /* bytes of the response to send */
+  struct timespec start;        /* arrival of the request */
+} net_peer_t;
+
+/* Echo server state, one per server thread */
+typedef struct
+{
+  int           listen_fd;      /* TCP listener or UDP socket */
+  net_peer_t    *peers;
+  struct pollfd *pfds;          /* listen_fd first, then peers */
+  unsigned int  npeers;
+  unsigned int  maxpeers;
+  char          *buf;
+} net_server_t;
+
+typedef struct
+{
+  uint64_t      requests CK_CC_CACHELINE;
+  uint64_t      lost;
+  uint64_t      bytes_sent;
+  uint64_t      bytes_received;
+
+  net_conn_t    *conns;
+  struct pollfd *pfds;
+  char          *buf;           /* request header followed by zeros */
+  char          *rbuf;          /* responses */
+  uint32_t      seq;
+
+  net_server_t  server;         /* with --net-mode=server */
+} net_thread_t;
+
+/* Per-thread counters summed over all threads */
+typedef struct
+{
+  uint64_t requests;
+  uint64_t lost;
+  uint64_t bytes_sent;
+  uint64_t bytes_received;
+} net_totals_t;
+
+/* Network test operations */
+static int net_init(void);
+static int net_thread_init(int);
+static int net_thread_run(int);
+static int net_thread_done(int);
+static void net_print_mode(void);
+static sb_event_t net_next_event(int);
+static int net_execute_event(sb_event_t *, int);
+static void net_report_intermediate(sb_stat_t *);
+static void net_report_cumulative(sb_stat_t *);
+static int net_done(void);
+
+static sb_test_t net_test =
+{
+  .sname = "net",
+  .lname = "Network request/response test",
+  .ops = {
+    .init = net_init,
+    .thread_init = net_thread_init,
+    .thread_done = net_thread_done,
+    .print_mode = net_print_mode,
+    .next_event = net_next_event,
+    .execute_event = net_execute_event,
+    .report_intermediate = net_report_intermediate,
+    .report_cumulative = net_report_cumulative,
+    .done = net_done
+  },
+  .args = net_args
+};
+
+static net_mode_t   net_mode;
+static net_proto_t  net_proto;
+static const char   *net_address;
+static size_t       net_request_size;
+static size_t       net_response_size;
+static unsigned int net_connections;
+static int          net_timeout;
+
+/* Address clients connect to */
+static struct sockaddr_storage net_server_addr;
+static socklen_t               net_server_addrlen;
+
+/* Socket shared by server threads, or of the loopback server */
+static int          net_listen_fd = -1;
+
+/* Loopback server thread */
+static pthread_t    net_loopback_thread;
+static bool         net_loopback_running;
+static net_server_t net_loopback_server;
+
+static net_thread_t *net_threads;
+
+/* Totals at the last intermediate and cumulative reports */
+static net_totals_t net_interm;
+static net_totals_t net_cumul;
+
+
+int register_test_net(sb_list_t *tests)
+{
+  SB_LIST_ADD_TAIL(&net_test.listitem, tests);
+
+  return 0;
+}
+
+
+static int net_parse_enum(const char *opt, const char **names)
+{
+  const char * const val = sb_get_value_string(opt);
+
+  for (int i = 0; val != NULL && names[i] != NULL; i++)
+    if (!strcmp(val, names[i]))
+      return i;
+
+  log_text(LOG_FATAL, "Invalid value for %s: %s", opt,
+           val != NULL ? val : "");
+
+  return -1;
+}
+
+
+static int net_set_nonblock(int fd)
+{
+  const int flags = fcntl(fd, F_GETFL);
+
+  return flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0;
+}
+
+
+static void net_set_nodelay(int fd)
+{
+  int on = 1;
+
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+
+static int net_socket_type(void)
+{
+  return net_proto == NET_PROTO_TCP ? SOCK_STREAM : SOCK_DGRAM;
+}
+
+
+/*
+  Create the server socket bound to 'addr', i.e. a TCP listener or a UDP
+  socket. The bound address is stored as the address for clients.
+*/
+
+static int net_listen(const char *addr)
+{
+  struct addrinfo *ai;
+  struct addrinfo *p;
+  int             on = 1;
+  int             rc;
+
+  if ((rc = sb_resolve_addr(addr, true, &ai)) != 0)
+  {
+    log_text(LOG_FATAL, "Cannot resolve address '%s': %s", addr,
+             gai_strerror(rc));
+    return 1;
+  }
+
+  for (p = ai; p != NULL; p = p->ai_next)
+  {
+    net_listen_fd = socket(p->ai_family, net_socket_type(), 0);
+    if (net_listen_fd < 0)
+      continue;
+
+    setsockopt(net_listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    if (bind(net_listen_fd, p->ai_addr, p->ai_addrlen) == 0 &&
+        (net_proto == NET_PROTO_UDP || listen(net_listen_fd, SOMAXCONN) == 0))
+      break;
+
+    close(net_listen_fd);
+    net_listen_fd = -1;
+  }
+
+  freeaddrinfo(ai);
+
+  if (net_listen_fd < 0)
+  {
+    log_errno(LOG_FATAL, "Cannot listen on '%s'", addr);
+    return 1;
+  }
+
+  net_server_addrlen = sizeof(net_server_addr);
+  if (getsockname(net_listen_fd, (struct sockaddr *) &net_server_addr,
+                  &net_server_addrlen) || net_set_nonblock(net_listen_fd))
+  {
+    log_errno(LOG_FATAL, "Cannot set up the server socket");
+    return 1;
+  }
+
+  return 0;
+}
+
+
+static int net_resolve_server(void)
+{
+  struct addrinfo *ai;
+  int             rc;
+
+  if ((rc = sb_resolve_addr(net_address, false, &ai)) != 0)
+  {
+    log_text(LOG_FATAL, "Cannot resolve address '%s': %s", net_address,
+             gai_strerror(rc));
+    return 1;
+  }
+
+  memcpy(&net_server_addr, ai->ai_addr, ai->ai_addrlen);
+  net_server_addrlen = ai->ai_addrlen;
+
+  freeaddrinfo(ai);
+
+  return 0;
+}
+
+
+static int net_server_init(net_server_t *s)
+{
+  memset(s, 0, sizeof(*s));
+
+  s->listen_fd = net_listen_fd;
+  s->maxpeers = 16;
+  s->peers = malloc(s->maxpeers * sizeof(net_peer_t));
+  s->pfds = malloc((s->maxpeers + 1) * sizeof(struct pollfd));
+  s->buf = calloc(1, NET_CHUNK_SIZE);
+
+  if (s->peers == NULL || s->pfds == NULL || s->buf == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  return 0;
+}
+
+
+static void net_server_done(net_server_t *s)
+{
+  for (unsigned int i = 0; i < s->npeers; i++)
+    close(s->peers[i].fd);
+
+  free(s->peers);
+  free(s->pfds);
+  free(s->buf);
+
+  memset(s, 0, sizeof(*s));
+}
+
+
+/* Check a request header, returns false if the request is invalid */
+
+static bool net_header_valid(const net_header_t *hdr, size_t max)
+{
+  const uint32_t request_size = ntohl(hdr->request_size);
+  const uint32_t response_size = ntohl(hdr->response_size);
+
+  return ntohl(hdr->magic) == NET_MAGIC &&
+    request_size >= NET_HEADER_SIZE && request_size <= max &&
+    response_size >= NET_HEADER_SIZE && response_size <= max;
+}
+
+
+/* Account a served request as an event with --net-mode=server */
+
+static void net_server_event(const struct timespec *start, int thread_id)
+{
+  if (thread_id < 0)
+    return;
+
+  sb_event_start_at(thread_id, start);
+  sb_event_stop(thread_id);
+}
+
+
+static void net_peer_close(net_server_t *s, unsigned int idx)
+{
+  close(s->peers[idx].fd);
+  s->peers[idx] = s->peers[--s->npeers];
+}
+
+
+static void net_accept(net_server_t *s)
+{
+  int fd;
+
+  while ((fd = accept(s->listen_fd, NULL, NULL)) >= 0)
+  {
+    if (s->npeers == s->maxpeers)
+    {
+      const unsigned int n = s->maxpeers * 2;
+      net_peer_t         *peers = realloc(s->peers, n * sizeof(net_peer_t));
+      struct pollfd      *pfds;
+
+      if (peers != NULL)
+        s->peers = peers;
+
+      pfds = realloc(s->pfds, (n + 1) * sizeof(struct pollfd));
+      if (pfds != NULL)
+        s->pfds = pfds;
+
+      if (peers == NULL || pfds == NULL)
+      {
+        log_text(LOG_WARNING, "Memory allocation failure, rejecting a "
+                 "connection");
+        close(fd);
+        continue;
+      }
+
+      s->maxpeers = n;
+    }
+
+    if (net_set_nonblock(fd))
+    {
+      close(fd);
+      continue;
+    }
+
+    net_set_nodelay(fd);
+
+    memset(&s->peers[s->npeers], 0, sizeof(net_peer_t));
+    s->peers[s->npeers++].fd = fd;
+  }
+}
+
+
+/*
+  Receive and send as much of the current request and response of a TCP
+  connection as possible without blocking. Returns 1 if the connection must
+  be closed.
+*/
+
+static int net_peer_serve(net_server_t *s, net_peer_t *p, int thread_id)
+{
+  ssize_t n;
+
+  for (;;)
+  {
+    if (p->response_left > 0)
+    {
+      /* The response starts with a copy of the request header */
+      const size_t off = p->response_size - p->response_left;
+      const size_t base = off < NET_CHUNK_SIZE ? off : NET_HEADER_SIZE;
+
+      memcpy(s->buf, &p->hdr, NET_HEADER_SIZE);
+
+      n = send(p->fd, s->buf + base,
+               SB_MIN(p->response_left, NET_CHUNK_SIZE - base), MSG_NOSIGNAL);
+
+      if (n < 0)
+        return errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+
+      p->response_left -= (size_t) n;
+
+      if (p->response_left == 0)
+        net_server_event(&p->start, thread_id);
+
+      continue;
+    }
+
+    if (p->hdr_len < NET_HEADER_SIZE)
+    {
+      n = recv(p->fd, (char *) &p->hdr + p->hdr_len,
+               NET_HEADER_SIZE - p->hdr_len, 0);
+
+      if (n > 0 && p->hdr_len == 0)
+        SB_GETTIME(&p->start);
+    }
+    else
+      n = recv(p->fd, s->buf, SB_MIN(p->request_left, NET_CHUNK_SIZE), 0);
+
+    if (n == 0)
+      return 1;
+    if (n < 0)
+      return errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+
+    if (p->hdr_len < NET_HEADER_SIZE)
+    {
+      p->hdr_len += (size_t) n;
+      if (p->hdr_len < NET_HEADER_SIZE)
+        continue;
+
+      if (!net_header_valid(&p->hdr, NET_TCP_MAX))
+      {
+        log_text(LOG_WARNING, "Invalid request header, closing connection");
+        return 1;
+      }
+
+      p->request_left = ntohl(p->hdr.request_size) - NET_HEADER_SIZE;
+    }
+    else
+      p->request_left -= (size_t) n;
+
+    if (p->request_left == 0)
+    {
+      /* The request is complete, start the response */
+      p->hdr_len = 0;
+      p->response_size = p->response_left = ntohl(p->hdr.response_size);
+    }
+  }
+}
+
+
+/* Serve all datagrams queued on a UDP server socket */
+
+static void net_udp_serve(net_server_t *s, int thread_id)
+{
+  struct sockaddr_storage addr;
+  socklen_t               addrlen;
+  struct timespec         start;
+  ssize_t                 n;
+
+  for (;;)
+  {
+    addrlen = sizeof(addr);
+    n = recvfrom(s->listen_fd, s->buf, NET_CHUNK_SIZE, 0,
+                 (struct sockaddr *) &addr, &addrlen);
+    if (n < 0)
+      return;
+
+    SB_GETTIME(&start);
+
+    net_header_t * const hdr = (net_header_t *) s->buf;
+
+    if ((size_t) n < NET_HEADER_SIZE || !net_header_valid(hdr, NET_UDP_MAX) ||
+        ntohl(hdr->request_size) != (size_t) n)
+      continue;
+
+    /* Send back the header followed by zeros */
+    const size_t len = ntohl(hdr->response_size);
+
+    if (len > (size_t) n)
+      memset(s->buf + n, 0, len - (size_t) n);
+
+    if (sendto(s->listen_fd, s->buf, len, 0, (struct sockaddr *) &addr,
+               addrlen) == (ssize_t) len)
+      net_server_event(&start, thread_id);
+  }
+}
+
+
+/*
+  Wait up to NET_SERVER_POLL_MS for activity on the server socket and accepted
+  connections and serve it. thread_id is negative for the loopback server.
+*/
+
+static int net_server_poll(net_server_t *s, int thread_id)
+{
+  s->pfds[0].fd = s->listen_fd;
+  s->pfds[0].events = POLLIN;
+
+  for (unsigned int i = 0; i < s->npeers; i++)
+  {
+    s->pfds[i + 1].fd = s->peers[i].fd;
+    s->pfds[i + 1].events = s->peers[i].response_left > 0 ? POLLOUT : POLLIN;
+  }
+
+  const unsigned int npeers = s->npeers;
+
+  if (poll(s->pfds, npeers + 1, NET_SERVER_POLL_MS) < 0)
+  {
+    if (errno == EINTR)
+      return 0;
+
+    log_errno(LOG_FATAL, "poll() failed");
+    return 1;
+  }
+
+  /* Serve in reverse order, closing a connection moves the last one */
+  for (unsigned int i = npeers; i-- > 0;)
+  {
+    if (s->pfds[i + 1].revents != 0 &&
+        net_peer_serve(s, &s->peers[i], thread_id))
+      net_peer_close(s, i);
+  }
+
+  if (s->pfds[0].revents & POLLIN)
+  {
+    if (net_proto == NET_PROTO_TCP)
+      net_accept(s);
+    else
+      net_udp_serve(s, thread_id);
+  }
+
+  return 0;
+}
+
+
+static void *net_loopback_proc(void *arg)
+{
+  (void) arg; /* unused */
+
+  while (ck_pr_load_8((uint8_t *) &net_loopback_running))
+    if (net_server_poll(&net_loopback_server, -1))
+      break;
+
+  return NULL;
+}
+
+
+int net_init(void)
+{
+  int    i;
+
+  if ((i = net_parse_enum("net-mode", net_mode_names)) < 0)
+    return 1;
+  net_mode = (net_mode_t) i;
+
+  if ((i = net_parse_enum("net-proto", net_proto_names)) < 0)
+    return 1;
+  net_proto = (net_proto_t) i;
+
+  net_address = sb_get_value_string("net-address");
+
+  const size_t max = net_proto == NET_PROTO_UDP ? NET_UDP_MAX : NET_TCP_MAX;
+
+  net_request_size = sb_get_value_size("net-request-size");
+  net_response_size = sb_get_value_size("net-response-size");
+
+  if (net_request_size < NET_HEADER_SIZE || net_request_size > max ||
+      net_response_size < NET_HEADER_SIZE || net_response_size > max)
+  {
+    log_text(LOG_FATAL, "--net-request-size and --net-response-size must be "
+             "between %u and %zu bytes for %s", (unsigned) NET_HEADER_SIZE,
+             max, net_proto_names[net_proto]);
+    return 1;
+  }
+
+  i = sb_get_value_int("net-connections");
+  if (i <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for net-connections: %d", i);
+    return 1;
+  }
+  net_connections = (unsigned int) i;
+
+  net_timeout = sb_get_value_int("net-timeout");
+  if (net_timeout <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for net-timeout: %d", net_timeout);
+    return 1;
+  }
+
+  if (net_mode == NET_MODE_SERVER &&
+      (sb_globals.tx_rate > 0 || sb_globals.max_events > 0))
+  {
+    log_text(LOG_FATAL, "--net-mode=server does not support --rate and "
+             "--events");
+    return 1;
+  }
+
+  net_threads = sb_alloc_per_thread_array(sizeof(net_thread_t));
+  if (net_threads == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  memset(&net_interm, 0, sizeof(net_interm));
+  memset(&net_cumul, 0, sizeof(net_cumul));
+
+  /* Server threads run their own loop instead of executing events */
+  net_test.ops.thread_run = net_mode == NET_MODE_SERVER ? net_thread_run : NULL;
+
+  switch (net_mode) {
+  case NET_MODE_SERVER:
+    return net_listen(net_address);
+
+  case NET_MODE_CLIENT:
+    return net_resolve_server();
+
+  case NET_MODE_LOOPBACK:
+    if (net_listen("127.0.0.1:0") || net_server_init(&net_loopback_server))
+      return 1;
+
+    net_loopback_running = true;
+    if ((errno = pthread_create(&net_loopback_thread, NULL, net_loopback_proc,
+                                NULL)) != 0)
+    {
+      log_errno(LOG_FATAL, "Cannot create the loopback server thread");
+      net_loopback_running = false;
+      return 1;
+    }
+    return 0;
+  }
+
+  return 1;
+}
+
+
+int net_done(void)
+{
+  if (net_loopback_running)
+  {
+    ck_pr_store_8((uint8_t *) &net_loopback_running, false);
+    pthread_join(net_loopback_thread, NULL);
+    net_server_done(&net_loopback_server);
+  }
+
+  if (net_listen_fd >= 0)
+  {
+    close(net_listen_fd);
+    net_listen_fd = -1;
+  }
+
+  free(net_threads);
+  net_threads = NULL;
+
+  return 0;
+}
+
+
+static int net_connect(net_conn_t *c)
+{
+  c->fd = socket(net_server_addr.ss_family, net_socket_type(), 0);
+  if (c->fd < 0)
+  {
+    log_errno(LOG_FATAL, "Cannot create a socket");
+    return 1;
+  }
+
+  /* A connected UDP socket only receives datagrams from the server */
+  if (connect(c->fd, (struct sockaddr *) &net_server_addr,
+              net_server_addrlen))
+  {
+    log_errno(LOG_FATAL, "Cannot connect to '%s'",
+              net_mode == NET_MODE_LOOPBACK ? "loopback server" : net_address);
+    return 1;
+  }
+
+  if (net_proto == NET_PROTO_TCP)
+    net_set_nodelay(c->fd);
+
+  if (net_set_nonblock(c->fd))
+  {
+    log_errno(LOG_FATAL, "Cannot make a socket non-blocking");
+    return 1;
+  }
+
+  return 0;
+}
+
+
+int net_thread_init(int thread_id)
+{
+  net_thread_t * const t = &net_threads[thread_id];
+
+  if (net_mode == NET_MODE_SERVER)
+    return net_server_init(&t->server);
+
+  t->conns = malloc(net_connections * sizeof(net_conn_t));
+  t->pfds = malloc(net_connections * sizeof(struct pollfd));
+  t->buf = calloc(1, NET_CHUNK_SIZE);
+  t->rbuf = malloc(NET_CHUNK_SIZE);
+
+  if (t->conns == NULL || t->pfds == NULL || t->buf == NULL ||
+      t->rbuf == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  for (unsigned int i = 0; i < net_connections; i++)
+    t->conns[i].fd = -1;
+
+  for (unsigned int i = 0; i < net_connections; i++)
+    if (net_connect(&t->conns[i]))
+      return 1;
+
+  return 0;
+}
+
+
+int net_thread_done(int thread_id)
+{
+  net_thread_t * const t = &net_threads[thread_id];
+
+  if (net_mode == NET_MODE_SERVER)
+  {
+    net_server_done(&t->server);
+    return 0;
+  }
+
+  for (unsigned int i = 0; t->conns != NULL && i < net_connections; i++)
+    if (t->conns[i].fd >= 0)
+      close(t->conns[i].fd);
+
+  free(t->conns);
+  free(t->pfds);
+  free(t->buf);
+  free(t->rbuf);
+  t->conns = NULL;
+  t->pfds = NULL;
+  t->buf = NULL;
+  t->rbuf = NULL;
+
+  return 0;
+}
+
+
+int net_thread_run(int thread_id)
+{
+  net_server_t * const s = &net_threads[thread_id].server;
+
+  while (sb_more_events(thread_id))
+    if (net_server_poll(s, thread_id))
+      return 1;
+
+  return 0;
+}
+
+
+sb_event_t net_next_event(int thread_id)
+{
+  sb_event_t req;
+
+  (void) thread_id; /* unused */
+
+  req.type = SB_REQ_TYPE_NET;
+
+  return req;
+}
+
+
+/* Send as much of a TCP request as possible, returns 1 on error */
+
+static int net_tcp_send(net_thread_t *t, net_conn_t *c)
+{
+  while (c->sent < net_request_size)
+  {
+    /* The header is only at the start of the buffer */
+    const size_t off = c->sent < NET_CHUNK_SIZE ? c->sent : NET_HEADER_SIZE;
+    const size_t len = SB_MIN(net_request_size - c->sent,
+                              NET_CHUNK_SIZE - off);
+    const ssize_t n = send(c->fd, t->buf + off, len, MSG_NOSIGNAL);
+
+    if (n < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        return 0;
+
+      log_errno(LOG_FATAL, "send() failed");
+      return 1;
+    }
+
+    c->sent += (size_t) n;
+    ck_pr_store_64(&t->bytes_sent, t->bytes_sent + (uint64_t) n);
+  }
+
+  return 0;
+}
+
+
+/*
+  Receive as much of a response as possible. Returns 1 on error, sets
+  'done' when the response is complete.
+*/
+
+static int net_recv(net_thread_t *t, net_conn_t *c, bool *done)
+{
+  ssize_t n;
+
+  *done = false;
+
+  for (;;)
+  {
+    n = recv(c->fd, t->rbuf, NET_CHUNK_SIZE, 0);
+
+    if (n < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+        return 0;
+
+      /* The server may not be listening yet or has gone */
+      log_errno(LOG_FATAL, "recv() failed");
+      return 1;
+    }
+
+    if (n == 0)
+    {
+      log_text(LOG_FATAL, "Connection closed by the server");
+      return 1;
+    }
+
+    ck_pr_store_64(&t->bytes_received, t->bytes_received + (uint64_t) n);
+
+    if (net_proto == NET_PROTO_UDP)
+    {
+      const net_header_t * const hdr = (net_header_t *) t->rbuf;
+
+      /* Skip late responses to requests which have timed out */
+      if ((size_t) n >= NET_HEADER_SIZE && ntohl(hdr->seq) == t->seq)
+      {
+        *done = true;
+        return 0;
+      }
+
+      continue;
+    }
+
+    c->received += (size_t) n;
+
+    if (c->received >= net_response_size)
+    {
+      *done = true;
+      return 0;
+    }
+  }
+}
+
+
+int net_execute_event(sb_event_t *r, int thread_id)
+{
+  net_thread_t * const t = &net_threads[thread_id];
+  net_header_t * const hdr = (net_header_t *) t->buf;
+  unsigned int         pending = net_connections;
+  uint64_t             deadline;
+  struct timespec      ts;
+
+  (void) r; /* unused */
+
+  hdr->magic = htonl(NET_MAGIC);
+  hdr->request_size = htonl((uint32_t) net_request_size);
+  hdr->response_size = htonl((uint32_t) net_response_size);
+  hdr->seq = htonl(++t->seq);
+
+  for (unsigned int i = 0; i < net_connections; i++)
+  {
+    net_conn_t * const c = &t->conns[i];
+
+    c->sent = 0;
+    c->received = 0;
+
+    t->pfds[i].fd = c->fd;
+    t->pfds[i].events = POLLIN;
+
+    if (net_proto == NET_PROTO_UDP)
+    {
+      if (send(c->fd, t->buf, net_request_size, 0) < 0)
+      {
+        log_errno(LOG_FATAL, "send() failed");
+        return 1;
+      }
+
+      ck_pr_store_64(&t->bytes_sent, t->bytes_sent + net_request_size);
+      continue;
+    }
+
+    if (net_tcp_send(t, c))
+      return 1;
+
+    if (c->sent < net_request_size)
+      t->pfds[i].events = POLLOUT | POLLIN;
+  }
+
+  SB_GETTIME(&ts);
+  deadline = SEC2NS(ts.tv_sec) + ts.tv_nsec + MS2NS(net_timeout);
+
+  while (pending > 0)
+  {
+    uint64_t now;
+
+    SB_GETTIME(&ts);
+    now = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+
+    if (now >= deadline)
+    {
+      if (net_proto == NET_PROTO_TCP)
+      {
+        log_text(LOG_FATAL, "No response from the server within %d ms",
+                 net_timeout);
+        return 1;
+      }
+
+      ck_pr_store_64(&t->lost, t->lost + pending);
+      break;
+    }
+
+    const int rc = poll(t->pfds, net_connections,
+                        (int) ((deadline - now + 999999) / 1000000));
+    if (rc < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      log_errno(LOG_FATAL, "poll() failed");
+      return 1;
+    }
+
+    for (unsigned int i = 0; i < net_connections && rc > 0; i++)
+    {
+      net_conn_t * const c = &t->conns[i];
+      bool               done;
+
+      if (t->pfds[i].revents == 0)
+        continue;
+
+      if (t->pfds[i].events & POLLOUT)
+      {
+        if (net_tcp_send(t, c))
+          return 1;
+
+        if (c->sent == net_request_size)
+          t->pfds[i].events = POLLIN;
+      }
+
+      if (!(t->pfds[i].revents & (POLLIN | POLLERR | POLLHUP)))
+        continue;
+
+      if (net_recv(t, c, &done))
+        return 1;
+
+      if (done)
+      {
+        /* Negative descriptors are ignored by poll() */
+        t->pfds[i].fd = -1;
+        pending--;
+      }
+    }
+  }
+
+  ck_pr_store_64(&t->requests, t->requests + net_connections);
+
+  return 0;
+}
+
+
+void net_print_mode(void)
+{
+  log_text(LOG_INFO, "Doing network request/response test\n");
+
+  if (net_mode == NET_MODE_SERVER)
+  {
+    log_text(LOG_NOTICE, "Echo server listening on %s (%s)\n", net_address,
+             net_proto_names[net_proto]);
+    return;
+  }
+
+  log_text(LOG_NOTICE, "Server: %s (%s), %u connection(s) per thread",
+           net_mode == NET_MODE_LOOPBACK ? "loopback" : net_address,
+           net_proto_names[net_proto], net_connections);
+  log_text(LOG_NOTICE, "Request size: %zu bytes, response size: %zu bytes\n",
+           net_request_size, net_response_size);
+}
+
+
+static void net_get_totals(net_totals_t *tot)
+{
+  memset(tot, 0, sizeof(*tot));
+
+  for (unsigned int i = 0; i < sb_globals.threads; i++)
+  {
+    tot->requests += ck_pr_load_64(&net_threads[i].requests);
+    tot->lost += ck_pr_load_64(&net_threads[i].lost);
+    tot->bytes_sent += ck_pr_load_64(&net_threads[i].bytes_sent);
+    tot->bytes_received += ck_pr_load_64(&net_threads[i].bytes_received);
+  }
+}
+
+
+/* Print intermediate stats. */
+
+void net_report_intermediate(sb_stat_t *stat)
+{
+  net_totals_t tot;
+  const double seconds = stat->time_interval;
+
+  sb_report_intermediate(stat);
+
+  /* Served requests are reported as events */
+  if (net_mode == NET_MODE_SERVER)
+    return;
+
+  net_get_totals(&tot);
+
+  log_timestamp(LOG_NOTICE, stat->time_total, "requests: %4.2f/s lost: %"
+                PRIu64 " sent: %4.2f MiB/s received: %4.2f MiB/s",
+                (tot.requests - net_interm.requests) / seconds,
+                tot.lost - net_interm.lost,
+                (tot.bytes_sent - net_interm.bytes_sent) / mebibyte / seconds,
+                (tot.bytes_received - net_interm.bytes_received) / mebibyte /
+                seconds);
+
+  net_interm = tot;
+}
+
+
+/* Print cumulative stats. */
+
+void net_report_cumulative(sb_stat_t *stat)
+{
+  net_totals_t tot;
+  const double seconds = stat->time_interval;
+
+  if (net_mode != NET_MODE_SERVER)
+  {
+    net_get_totals(&tot);
+
+    log_text(LOG_NOTICE, "Network:");
+    log_text(LOG_NOTICE, "    requests:        %10" PRIu64
+             " (%.2f per second)", tot.requests - net_cumul.requests,
+             (tot.requests - net_cumul.requests) / seconds);
+    if (net_proto == NET_PROTO_UDP)
+      log_text(LOG_NOTICE, "    lost:            %10" PRIu64,
+               tot.lost - net_cumul.lost);
+    log_text(LOG_NOTICE, "    sent, MiB/s:     %10.2f",
+             (tot.bytes_sent - net_cumul.bytes_sent) / mebibyte / seconds);
+    log_text(LOG_NOTICE, "    received, MiB/s: %10.2f",
+             (tot.bytes_received - net_cumul.bytes_received) / mebibyte /
+             seconds);
+
+    net_cumul = tot;
+  }
+
+  sb_report_cumulative(stat);
+}
@@ -0,0 +1,482 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Inter-thread queue test. The first --queue-producers threads enqueue
+  messages with a payload of --queue-payload bytes, the remaining threads
+  dequeue them. Each dequeued message is an event whose latency is the time
+  since the message was enqueued. Messages are taken from per-producer pools
+  and returned to them by consumers, so no memory is allocated during the test.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+#ifdef HAVE_SCHED_H
+# include <sched.h>
+#endif
+
+#include <inttypes.h>
+
+#include "sysbench.h"
+#include "sb_ck_pr.h"
+#include "sb_util.h"
+
+#include "ck_ring.h"
+#include "ck_fifo.h"
+
+/* Queue test arguments */
+static sb_arg_t queue_args[] =
+{
+  SB_OPT("queue-type", "queue implementation {spsc, spmc, mpmc, mutex, "
+         "fifo}", "mpmc", STRING),
+  SB_OPT("queue-producers", "number of producer threads, the remaining "
+         "threads are consumers", "1", INT),
+  SB_OPT("queue-size", "queue capacity, must be a power of 2", "1024", INT),
+  SB_OPT("queue-payload", "message payload size", "8", SIZE),
+
+  SB_OPT_END
+};
+
+typedef enum
+{
+  QUEUE_SPSC,                   /* ck_ring, single producer/consumer */
+  QUEUE_SPMC,                   /* ck_ring, single producer */
+  QUEUE_MPMC,                   /* ck_ring, multiple producers/consumers */
+  QUEUE_MUTEX,                  /* ck_ring protected by a pthread mutex */
+  QUEUE_FIFO                    /* ck_fifo_mpmc linked list */
+} queue_type_t;
+
+static const char *queue_type_names[] =
+{
+  "spsc", "spmc", "mpmc", "mutex", "fifo", NULL
+};
+
+/* Queue test operations */
+static int queue_init(void);
+static void queue_print_mode(void);
+static int queue_thread_run(int);
+static void queue_report_cumulative(sb_stat_t *);
+static int queue_done(void);
+
+static sb_test_t queue_test =
+{
+  .sname = "queue",
+  .lname = "Inter-thread queue test",
+  .ops = {
+    .init = queue_init,
+    .print_mode = queue_print_mode,
+    .thread_run = queue_thread_run,
+    .report_cumulative = queue_report_cumulative,
+    .done = queue_done
+  },
+  .args = queue_args
+};
+
+typedef struct
+{
+  struct timespec ts;           /* enqueue time */
+  unsigned int    busy;         /* set while the message is in flight */
+  unsigned char   payload[];
+} queue_msg_t;
+
+static queue_type_t queue_type;
+static unsigned int queue_producers;
+static unsigned int queue_size;
+static size_t       queue_payload;
+
+static ck_ring_t        queue_ring CK_CC_CACHELINE;
+static ck_ring_buffer_t *queue_buffer;
+static pthread_mutex_t  queue_mutex;
+
+#ifdef CK_F_FIFO_MPMC
+static ck_fifo_mpmc_t       queue_fifo CK_CC_CACHELINE;
+static ck_fifo_mpmc_entry_t *fifo_entries;
+/* Free list of FIFO entries, recycled by consumers */
+static ck_ring_t            fifo_free_ring CK_CC_CACHELINE;
+static ck_ring_buffer_t     *fifo_free_buffer;
+#endif
+
+/* Per-producer message pools */
+static char         *queue_msgs;
+static size_t       msg_stride;
+static unsigned int msgs_per_producer;
+
+static int          queue_stop CK_CC_CACHELINE;
+
+#define QUEUE_MSG(producer, i)                                          \
+  ((queue_msg_t *) (queue_msgs +                                        \
+                    ((size_t) (producer) * msgs_per_producer + (i)) *   \
+                    msg_stride))
+
+
+int register_test_queue(sb_list_t *tests)
+{
+  SB_LIST_ADD_TAIL(&queue_test.listitem, tests);
+
+  return 0;
+}
+
+
+/* Return index of a value in a NULL-terminated array of names, or -1 */
+
+static int find_name(const char **names, const char *s)
+{
+  for (int i = 0; names[i] != NULL; i++)
+    if (!strcmp(names[i], s))
+      return i;
+
+  return -1;
+}
+
+
+int queue_init(void)
+{
+  const char         *s;
+  int                i;
+  const unsigned int nthreads = sb_globals.threads;
+
+  s = sb_get_value_string("queue-type");
+  if ((i = find_name(queue_type_names, s)) < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for queue-type: %s", s);
+    return 1;
+  }
+  queue_type = (queue_type_t) i;
+
+#ifndef CK_F_FIFO_MPMC
+  if (queue_type == QUEUE_FIFO)
+  {
+    log_text(LOG_FATAL, "--queue-type=fifo is not supported on this platform");
+    return 1;
+  }
+#endif
+
+  i = sb_get_value_int("queue-producers");
+  if (i <= 0 || (unsigned int) i >= nthreads)
+  {
+    log_text(LOG_FATAL, "--queue-producers must be between 1 and --threads "
+             "minus 1");
+    return 1;
+  }
+  queue_producers = (unsigned int) i;
+
+  if ((queue_type == QUEUE_SPSC || queue_type == QUEUE_SPMC) &&
+      queue_producers != 1)
+  {
+    log_text(LOG_FATAL, "--queue-type=%s requires --queue-producers=1",
+             queue_type_names[queue_type]);
+    return 1;
+  }
+
+  if (queue_type == QUEUE_SPSC && nthreads != 2)
+  {
+    log_text(LOG_FATAL, "--queue-type=spsc requires --threads=2");
+    return 1;
+  }
+
+  i = sb_get_value_int("queue-size");
+  if (i < 2 || (i & (i - 1)) != 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for queue-size: %d", i);
+    return 1;
+  }
+  queue_size = (unsigned int) i;
+
+  queue_payload = sb_get_value_size("queue-payload");
+
+  if (sb_globals.tx_rate > 0)
+  {
+    log_text(LOG_FATAL, "The 'queue' test does not support --rate");
+    return 1;
+  }
+
+  /* Messages in the queue plus the ones being processed by consumers */
+  msgs_per_producer = queue_size + (nthreads - queue_producers);
+  msg_stride = SB_ALIGN(sizeof(queue_msg_t) + queue_payload, CK_MD_CACHELINE);
+
+  queue_msgs = sb_memalign(msg_stride * msgs_per_producer * queue_producers,
+                           CK_MD_CACHELINE);
+  queue_buffer = malloc(queue_size * sizeof(ck_ring_buffer_t));
+
+  if (queue_msgs == NULL || queue_buffer == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  memset(queue_msgs, 0, msg_stride * msgs_per_producer * queue_producers);
+
+  ck_ring_init(&queue_ring, queue_size);
+  pthread_mutex_init(&queue_mutex, NULL);
+
+#ifdef CK_F_FIFO_MPMC
+  if (queue_type == QUEUE_FIFO)
+  {
+    /* The same capacity as rings, plus the stub entry */
+    fifo_entries = sb_memalign(queue_size * sizeof(ck_fifo_mpmc_entry_t),
+                               CK_MD_CACHELINE);
+    fifo_free_buffer = malloc(2 * queue_size * sizeof(ck_ring_buffer_t));
+    if (fifo_entries == NULL || fifo_free_buffer == NULL)
+    {
+      log_text(LOG_FATAL, "Memory allocation failure");
+      return 1;
+    }
+
+    ck_fifo_mpmc_init(&queue_fifo, &fifo_entries[0]);
+    ck_ring_init(&fifo_free_ring, 2 * queue_size);
+
+    for (unsigned int j = 1; j < queue_size; j++)
+      ck_ring_enqueue_mpmc(&fifo_free_ring, fifo_free_buffer,
+                           &fifo_entries[j]);
+  }
+#endif
+
+  queue_stop = 0;
+
+  return 0;
+}
+
+
+int queue_done(void)
+{
+  pthread_mutex_destroy(&queue_mutex);
+
+  free(queue_msgs);
+  free(queue_buffer);
+
+#ifdef CK_F_FIFO_MPMC
+  free(fifo_entries);
+  free(fifo_free_buffer);
+  fifo_entries = NULL;
+  fifo_free_buffer = NULL;
+#endif
+
+  return 0;
+}
+
+
+static bool queue_enqueue(queue_msg_t *msg)
+{
+  bool rc = false;
+
+  switch (queue_type) {
+  case QUEUE_SPSC:
+    rc = ck_ring_enqueue_spsc(&queue_ring, queue_buffer, msg);
+    break;
+
+  case QUEUE_SPMC:
+    rc = ck_ring_enqueue_spmc(&queue_ring, queue_buffer, msg);
+    break;
+
+  case QUEUE_MPMC:
+    rc = ck_ring_enqueue_mpmc(&queue_ring, queue_buffer, msg);
+    break;
+
+  case QUEUE_MUTEX:
+    pthread_mutex_lock(&queue_mutex);
+    rc = ck_ring_enqueue_spsc(&queue_ring, queue_buffer, msg);
+    pthread_mutex_unlock(&queue_mutex);
+    break;
+
+  case QUEUE_FIFO:
+#ifdef CK_F_FIFO_MPMC
+    {
+      void *entry;
+
+      if ((rc = ck_ring_dequeue_mpmc(&fifo_free_ring, fifo_free_buffer,
+                                     &entry)))
+        ck_fifo_mpmc_enqueue(&queue_fifo, entry, msg);
+    }
+#endif
+    break;
+  }
+
+  return rc;
+}
+
+
+static queue_msg_t *queue_dequeue(void)
+{
+  void *msg = NULL;
+
+  switch (queue_type) {
+  case QUEUE_SPSC:
+    ck_ring_dequeue_spsc(&queue_ring, queue_buffer, &msg);
+    break;
+
+  case QUEUE_SPMC:
+    ck_ring_dequeue_spmc(&queue_ring, queue_buffer, &msg);
+    break;
+
+  case QUEUE_MPMC:
+    ck_ring_dequeue_mpmc(&queue_ring, queue_buffer, &msg);
+    break;
+
+  case QUEUE_MUTEX:
+    pthread_mutex_lock(&queue_mutex);
+    ck_ring_dequeue_spsc(&queue_ring, queue_buffer, &msg);
+    pthread_mutex_unlock(&queue_mutex);
+    break;
+
+  case QUEUE_FIFO:
+#ifdef CK_F_FIFO_MPMC
+    {
+      ck_fifo_mpmc_entry_t *garbage;
+
+      /*
+        The dequeued entry can be reused right away, generation counters in
+        ck_fifo_mpmc protect concurrent consumers from ABA
+      */
+      if (ck_fifo_mpmc_dequeue(&queue_fifo, &msg, &garbage))
+        ck_ring_enqueue_mpmc(&fifo_free_ring, fifo_free_buffer, garbage);
+    }
+#endif
+    break;
+  }
+
+  return msg;
+}
+
+
+/* Spin on a full or empty queue, yield the CPU from time to time */
+
+static void queue_backoff(unsigned int *spins)
+{
+  if (++*spins % 1024 == 0)
+    sched_yield();
+  else
+    ck_pr_stall();
+}
+
+
+static int producer_run(int thread_id)
+{
+  unsigned char payload[256];
+  unsigned int  next = 0;
+  unsigned int  spins = 0;
+
+  memset(payload, thread_id, sizeof(payload));
+
+  while (!ck_pr_load_int(&queue_stop))
+  {
+    queue_msg_t * const msg = QUEUE_MSG(thread_id, next);
+
+    next = next + 1 < msgs_per_producer ? next + 1 : 0;
+
+    /* Wait for a consumer to return the message */
+    while (ck_pr_load_uint(&msg->busy))
+    {
+      if (ck_pr_load_int(&queue_stop))
+        return 0;
+      queue_backoff(&spins);
+    }
+    ck_pr_fence_acquire();
+
+    for (size_t off = 0; off < queue_payload; off += sizeof(payload))
+      memcpy(msg->payload + off, payload,
+             SB_MIN(sizeof(payload), queue_payload - off));
+
+    ck_pr_store_uint(&msg->busy, 1);
+    SB_GETTIME(&msg->ts);
+
+    while (!queue_enqueue(msg))
+    {
+      if (ck_pr_load_int(&queue_stop))
+        return 0;
+      queue_backoff(&spins);
+    }
+  }
+
+  return 0;
+}
+
+
+static int consumer_run(int thread_id)
+{
+  unsigned char payload[256];
+  unsigned int  spins = 0;
+  queue_msg_t   *msg;
+
+  while (sb_more_events(thread_id))
+  {
+    while ((msg = queue_dequeue()) == NULL)
+    {
+      if (ck_pr_load_int(&queue_stop))
+        return 0;
+      queue_backoff(&spins);
+    }
+
+    sb_event_start_at(thread_id, &msg->ts);
+
+    for (size_t off = 0; off < queue_payload; off += sizeof(payload))
+      memcpy(payload, msg->payload + off,
+             SB_MIN(sizeof(payload), queue_payload - off));
+
+    /* Make sure the payload is read before the producer reuses it */
+    ck_pr_fence_release();
+    ck_pr_store_uint(&msg->busy, 0);
+
+    sb_event_stop(thread_id);
+  }
+
+  /* Producers stop as soon as the first consumer is done */
+  ck_pr_store_int(&queue_stop, 1);
+
+  return 0;
+}
+
+
+int queue_thread_run(int thread_id)
+{
+  if ((unsigned int) thread_id < queue_producers)
+    return producer_run(thread_id);
+
+  return consumer_run(thread_id);
+}
+
+
+void queue_print_mode(void)
+{
+  log_text(LOG_INFO, "Doing inter-thread queue test\n");
+  log_text(LOG_NOTICE, "Queue: %s, size %u, %u producer(s), %u consumer(s), "
+           "%zu byte payload\n", queue_type_names[queue_type], queue_size,
+           queue_producers, sb_globals.threads - queue_producers,
+           queue_payload);
+}
+
+
+/* Print cumulative stats. */
+
+void queue_report_cumulative(sb_stat_t *stat)
+{
+  log_text(LOG_NOTICE, "Messages: %" PRIu64 " (%.2f per second)",
+           stat->events, stat->events / stat->time_interval);
+  log_text(LOG_NOTICE, "Enqueue-to-dequeue latency (us): min %.2f, avg %.2f, "
+           "max %.2f", stat->latency_min * 1e6, stat->latency_avg * 1e6,
+           stat->latency_max * 1e6);
+
+  sb_report_cumulative(stat);
+}
@@ -25,7 +25,8 @@ typedef enum
   FILE_OP_TYPE_NULL,
   FILE_OP_TYPE_READ,
   FILE_OP_TYPE_WRITE,
-  FILE_OP_TYPE_FSYNC
+  FILE_OP_TYPE_FSYNC,
+  FILE_OP_TYPE_DISCARD          /* see --file-discard-ratio */
 } sb_file_op_t;
 
 /* File IO request definition */
@@ -36,6 +37,8 @@ typedef struct
   long long       pos;
   ssize_t         size;
   sb_file_op_t    operation; 
+  unsigned int    size_class;   /* index in --file-block-sizes, if used */
+  bool            cold;         /* outside of the --file-cache-resident part */
 } sb_file_request_t;
 
 int register_test_fileio(sb_list_t *tests);
@@ -24,7 +24,11 @@ typedef enum
 {
   SB_MEM_OP_NONE,
   SB_MEM_OP_READ,
-  SB_MEM_OP_WRITE
+  SB_MEM_OP_WRITE,
+  SB_MEM_OP_COPY,
+  SB_MEM_OP_TRIAD,
+  SB_MEM_OP_MIXED,
+  SB_MEM_OP_RMW
 } sb_mem_op_t;
 
 
@@ -32,7 +36,8 @@ typedef enum
 typedef enum
 {
   SB_MEM_SCOPE_GLOBAL,
-  SB_MEM_SCOPE_LOCAL
+  SB_MEM_SCOPE_LOCAL,
+  SB_MEM_SCOPE_NUMA
 } sb_mem_scope_t;
 
 
@@ -0,0 +1,358 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  System call overhead test. Each event makes --syscall-loops calls that do no
+  actual work in the kernel, so the time per call is the cost of entering and
+  leaving the kernel (or of the vDSO for clock_gettime). This cost depends on
+  CPU vulnerability mitigations and virtualization, and is a quick way to
+  compare hosts.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
+
+#if defined(HAVE_LINUX_FUTEX_H) && defined(HAVE_SYS_SYSCALL_H)
+# include <linux/futex.h>
+# define SB_SYSCALL_FUTEX
+#endif
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(HAVE_SYS_SYSCALL_H) && \
+  defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+# include <linux/io_uring.h>
+# define SB_SYSCALL_URING
+#endif
+
+#include <inttypes.h>
+
+#include "sysbench.h"
+#include "sb_timer.h"
+
+/* Syscall test arguments */
+static sb_arg_t syscall_args[] =
+{
+  SB_OPT("syscall-type", "system call to measure {getpid, clock_gettime, "
+         "clock_gettime_syscall, read, futex_wake, io_uring_enter}", "getpid",
+         STRING),
+  SB_OPT("syscall-loops", "number of calls per event", "1000", INT),
+
+  SB_OPT_END
+};
+
+typedef enum
+{
+  SYSCALL_GETPID,               /* getpid(), bypassing any libc caching */
+  SYSCALL_CLOCK_GETTIME,        /* clock_gettime(), normally via the vDSO */
+  SYSCALL_CLOCK_GETTIME_SYSCALL, /* clock_gettime() as a real system call */
+  SYSCALL_READ,                 /* zero-byte read() from /dev/null */
+  SYSCALL_FUTEX_WAKE,           /* FUTEX_WAKE with no waiters */
+  SYSCALL_IO_URING_ENTER        /* io_uring_enter() with nothing to submit */
+} syscall_type_t;
+
+static const char *syscall_type_names[] =
+{
+  "getpid", "clock_gettime", "clock_gettime_syscall", "read", "futex_wake",
+  "io_uring_enter", NULL
+};
+
+/* Syscall test operations */
+static int syscall_init(void);
+static int syscall_thread_init(int);
+static int syscall_thread_done(int);
+static void syscall_print_mode(void);
+static sb_event_t syscall_next_event(int);
+static int syscall_execute_event(sb_event_t *, int);
+static void syscall_report_cumulative(sb_stat_t *);
+static int syscall_done(void);
+
+static sb_test_t syscall_test =
+{
+  .sname = "syscall",
+  .lname = "System call overhead test",
+  .ops = {
+    .init = syscall_init,
+    .thread_init = syscall_thread_init,
+    .thread_done = syscall_thread_done,
+    .print_mode = syscall_print_mode,
+    .next_event = syscall_next_event,
+    .execute_event = syscall_execute_event,
+    .report_cumulative = syscall_report_cumulative,
+    .done = syscall_done
+  },
+  .args = syscall_args
+};
+
+typedef struct
+{
+  int          fd;              /* /dev/null or io_uring descriptor */
+  unsigned int futex;
+  char         pad[SB_CACHELINE_PAD(sizeof(int) + sizeof(unsigned int))];
+} syscall_thread_t;
+
+static syscall_type_t   syscall_type;
+static unsigned int     syscall_loops;
+
+static syscall_thread_t *syscall_threads;
+
+
+int register_test_syscall(sb_list_t *tests)
+{
+  SB_LIST_ADD_TAIL(&syscall_test.listitem, tests);
+
+  return 0;
+}
+
+
+int syscall_init(void)
+{
+  const char *s;
+  int        i;
+
+  s = sb_get_value_string("syscall-type");
+  for (i = 0; syscall_type_names[i] != NULL; i++)
+    if (!strcmp(syscall_type_names[i], s))
+      break;
+  if (syscall_type_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for syscall-type: %s", s);
+    return 1;
+  }
+  syscall_type = (syscall_type_t) i;
+
+#ifndef SB_SYSCALL_FUTEX
+  if (syscall_type == SYSCALL_FUTEX_WAKE)
+  {
+    log_text(LOG_FATAL, "--syscall-type=futex_wake is not supported on this "
+             "platform");
+    return 1;
+  }
+#endif
+#ifndef SB_SYSCALL_URING
+  if (syscall_type == SYSCALL_IO_URING_ENTER)
+  {
+    log_text(LOG_FATAL, "--syscall-type=io_uring_enter is not supported on "
+             "this platform");
+    return 1;
+  }
+#endif
+#ifndef HAVE_SYS_SYSCALL_H
+  if (syscall_type == SYSCALL_CLOCK_GETTIME_SYSCALL)
+  {
+    log_text(LOG_FATAL, "--syscall-type=clock_gettime_syscall is not "
+             "supported on this platform");
+    return 1;
+  }
+#endif
+
+  i = sb_get_value_int("syscall-loops");
+  if (i <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for syscall-loops: %d", i);
+    return 1;
+  }
+  syscall_loops = (unsigned int) i;
+
+  syscall_threads = sb_alloc_per_thread_array(sizeof(syscall_thread_t));
+  if (syscall_threads == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  for (unsigned int t = 0; t <= sb_globals.threads; t++)
+    syscall_threads[t].fd = -1;
+
+  return 0;
+}
+
+
+int syscall_done(void)
+{
+  free(syscall_threads);
+  syscall_threads = NULL;
+
+  return 0;
+}
+
+
+int syscall_thread_init(int thread_id)
+{
+  syscall_thread_t * const t = &syscall_threads[thread_id];
+
+  switch (syscall_type) {
+  case SYSCALL_READ:
+    if ((t->fd = open("/dev/null", O_RDONLY)) < 0)
+    {
+      log_errno(LOG_FATAL, "Cannot open /dev/null");
+      return 1;
+    }
+    break;
+
+  case SYSCALL_IO_URING_ENTER:
+#ifdef SB_SYSCALL_URING
+    {
+      struct io_uring_params params;
+
+      memset(&params, 0, sizeof(params));
+
+      /* The rings are never used, so they are not mapped */
+      t->fd = (int) syscall(__NR_io_uring_setup, 1, &params);
+      if (t->fd < 0)
+      {
+        log_errno(LOG_FATAL, "io_uring_setup() failed");
+        return 1;
+      }
+    }
+#endif
+    break;
+
+  default:
+    break;
+  }
+
+  return 0;
+}
+
+
+int syscall_thread_done(int thread_id)
+{
+  syscall_thread_t * const t = &syscall_threads[thread_id];
+
+  if (t->fd >= 0)
+    close(t->fd);
+  t->fd = -1;
+
+  return 0;
+}
+
+
+sb_event_t syscall_next_event(int thread_id)
+{
+  sb_event_t req;
+
+  (void) thread_id; /* unused */
+
+  req.type = SB_REQ_TYPE_SYSCALL;
+
+  return req;
+}
+
+
+int syscall_execute_event(sb_event_t *r, int thread_id)
+{
+  syscall_thread_t * const t = &syscall_threads[thread_id];
+  struct timespec         ts;
+  char                    buf[1];
+
+  (void) r; /* unused */
+
+  switch (syscall_type) {
+  case SYSCALL_GETPID:
+    for (unsigned int i = 0; i < syscall_loops; i++)
+#ifdef HAVE_SYS_SYSCALL_H
+      syscall(SYS_getpid);
+#else
+      getpid();
+#endif
+    break;
+
+  case SYSCALL_CLOCK_GETTIME:
+    for (unsigned int i = 0; i < syscall_loops; i++)
+      SB_GETTIME(&ts);
+    break;
+
+  case SYSCALL_CLOCK_GETTIME_SYSCALL:
+#ifdef HAVE_SYS_SYSCALL_H
+    for (unsigned int i = 0; i < syscall_loops; i++)
+      syscall(SYS_clock_gettime, CLOCK_MONOTONIC, &ts);
+#endif
+    break;
+
+  case SYSCALL_READ:
+    for (unsigned int i = 0; i < syscall_loops; i++)
+      if (read(t->fd, buf, 0) < 0)
+      {
+        log_errno(LOG_FATAL, "read() failed");
+        return 1;
+      }
+    break;
+
+  case SYSCALL_FUTEX_WAKE:
+#ifdef SB_SYSCALL_FUTEX
+    for (unsigned int i = 0; i < syscall_loops; i++)
+      syscall(SYS_futex, &t->futex, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#endif
+    break;
+
+  case SYSCALL_IO_URING_ENTER:
+#ifdef SB_SYSCALL_URING
+    for (unsigned int i = 0; i < syscall_loops; i++)
+      if (syscall(__NR_io_uring_enter, t->fd, 0, 0, 0, NULL, 0) < 0)
+      {
+        log_errno(LOG_FATAL, "io_uring_enter() failed");
+        return 1;
+      }
+#endif
+    break;
+  }
+
+  return 0;
+}
+
+
+void syscall_print_mode(void)
+{
+  log_text(LOG_INFO, "Doing system call overhead test\n");
+  log_text(LOG_NOTICE, "System call: %s, %u call(s) per event\n",
+           syscall_type_names[syscall_type], syscall_loops);
+}
+
+
+/* Print cumulative stats. */
+
+void syscall_report_cumulative(sb_stat_t *stat)
+{
+  const double calls = (double) stat->events * syscall_loops;
+
+  log_text(LOG_NOTICE, "Calls: %.0f (%.2f per second)", calls,
+           calls / stat->time_interval);
+  /* Includes the per-event overhead, amortized over --syscall-loops calls */
+  log_text(LOG_NOTICE, "Time per call (ns): min %.2f, avg %.2f, max %.2f",
+           stat->latency_min * 1e9 / syscall_loops,
+           stat->latency_avg * 1e9 / syscall_loops,
+           stat->latency_max * 1e9 / syscall_loops);
+
+  sb_report_cumulative(stat);
+}
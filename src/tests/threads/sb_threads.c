@@ -23,9 +23,23 @@
 #ifdef HAVE_PTHREAD_H
 # include <pthread.h>
 #endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_SYS_EVENTFD_H
+# include <sys/eventfd.h>
+#endif
+#if defined(HAVE_LINUX_FUTEX_H) && defined(HAVE_SYS_SYSCALL_H)
+# include <linux/futex.h>
+# include <sys/syscall.h>
+# define SB_THREADS_FUTEX
+#endif
+
+#include <stdint.h>
 
 #include "sysbench.h"
 #include "sb_ck_pr.h"
+#include "sb_util.h"
 
 /* How to test scheduler pthread_yield or sched_yield */
 #ifdef HAVE_PTHREAD_YIELD
@@ -39,6 +53,9 @@ static sb_arg_t threads_args[] =
 {
   SB_OPT("thread-yields", "number of yields to do per request", "1000", INT),
   SB_OPT("thread-locks", "number of locks per thread", "8", INT),
+  SB_OPT("thread-pingpong", "pass a token between pairs of threads and "
+         "measure round trip latency instead of yields {off, futex, condvar, "
+         "eventfd, pipe}", "off", STRING),
 
   SB_OPT_END
 };
@@ -50,6 +67,9 @@ static void threads_print_mode(void);
 static sb_event_t threads_next_event(int);
 static int threads_execute_event(sb_event_t *, int);
 static int threads_cleanup(void);
+static int threads_done(void);
+static int pingpong_thread_run(int);
+static void threads_report_cumulative(sb_stat_t *);
 
 static sb_test_t threads_test =
 {
@@ -61,7 +81,9 @@ static sb_test_t threads_test =
     .print_mode = threads_print_mode,
     .next_event = threads_next_event,
     .execute_event = threads_execute_event,
-    .cleanup = threads_cleanup
+    .report_cumulative = threads_report_cumulative,
+    .cleanup = threads_cleanup,
+    .done = threads_done
   },
   .args = threads_args
 };
@@ -71,6 +93,46 @@ static unsigned int thread_locks;
 static pthread_mutex_t *test_mutexes;
 static unsigned int req_performed;
 
+/* Token passing mechanisms for --thread-pingpong */
+typedef enum
+{
+  PINGPONG_OFF,
+  PINGPONG_FUTEX,
+  PINGPONG_CONDVAR,
+  PINGPONG_EVENTFD,
+  PINGPONG_PIPE
+} pingpong_mode_t;
+
+static const char *pingpong_names[] =
+{
+  "off", "futex", "condvar", "eventfd", "pipe", NULL
+};
+
+/* One direction of token passing between two threads */
+typedef struct
+{
+  unsigned int    seq;          /* futex and condvar */
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+  int             fd[2];        /* eventfd (fd[0] only) and pipe */
+} channel_t;
+
+/*
+  Threads 2 * N (the initiator) and 2 * N + 1 (the responder) form pair N. The
+  initiator sends a token over 'ping' and waits for it to come back over 'pong'.
+  Each round trip is an event.
+*/
+typedef struct
+{
+  channel_t       ping;
+  channel_t       pong;
+  int             stop;
+  char            pad[CK_MD_CACHELINE];
+} pingpong_pair_t;
+
+static pingpong_mode_t pingpong_mode;
+static pingpong_pair_t *pingpong_pairs;
+
 
 int register_test_threads(sb_list_t *tests)
 {
@@ -80,12 +142,152 @@ int register_test_threads(sb_list_t *tests)
 }
 
 
+static int channel_init(channel_t *ch)
+{
+  ch->seq = 0;
+  ch->fd[0] = ch->fd[1] = -1;
+
+  switch (pingpong_mode) {
+  case PINGPONG_CONDVAR:
+    pthread_mutex_init(&ch->mutex, NULL);
+    pthread_cond_init(&ch->cond, NULL);
+    break;
+  case PINGPONG_EVENTFD:
+#ifdef HAVE_SYS_EVENTFD_H
+    if ((ch->fd[0] = eventfd(0, 0)) < 0)
+    {
+      log_errno(LOG_FATAL, "eventfd() failed");
+      return 1;
+    }
+#endif
+    break;
+  case PINGPONG_PIPE:
+    if (pipe(ch->fd))
+    {
+      log_errno(LOG_FATAL, "pipe() failed");
+      return 1;
+    }
+    break;
+  default:
+    break;
+  }
+
+  return 0;
+}
+
+
+static void channel_done(channel_t *ch)
+{
+  if (pingpong_mode == PINGPONG_CONDVAR)
+  {
+    pthread_mutex_destroy(&ch->mutex);
+    pthread_cond_destroy(&ch->cond);
+  }
+
+  for (int i = 0; i < 2; i++)
+    if (ch->fd[i] >= 0)
+      close(ch->fd[i]);
+}
+
+
+static int pingpong_init(void)
+{
+  const unsigned int npairs = sb_globals.threads / 2;
+
+#ifndef SB_THREADS_FUTEX
+  if (pingpong_mode == PINGPONG_FUTEX)
+  {
+    log_text(LOG_FATAL, "--thread-pingpong=futex is not supported on this "
+             "platform");
+    return 1;
+  }
+#endif
+#ifndef HAVE_SYS_EVENTFD_H
+  if (pingpong_mode == PINGPONG_EVENTFD)
+  {
+    log_text(LOG_FATAL, "--thread-pingpong=eventfd is not supported on this "
+             "platform");
+    return 1;
+  }
+#endif
+
+  if (sb_globals.threads % 2 != 0)
+  {
+    log_text(LOG_FATAL, "--thread-pingpong requires an even number of "
+             "threads");
+    return 1;
+  }
+
+  if (sb_globals.tx_rate > 0)
+  {
+    log_text(LOG_FATAL, "--thread-pingpong does not support --rate");
+    return 1;
+  }
+
+  pingpong_pairs = sb_memalign(npairs * sizeof(pingpong_pair_t),
+                               CK_MD_CACHELINE);
+  if (pingpong_pairs == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure!");
+    return 1;
+  }
+
+  for (unsigned int i = 0; i < npairs; i++)
+  {
+    pingpong_pairs[i].stop = 0;
+    if (channel_init(&pingpong_pairs[i].ping) ||
+        channel_init(&pingpong_pairs[i].pong))
+      return 1;
+  }
+
+  threads_test.ops.thread_run = pingpong_thread_run;
+
+  return 0;
+}
+
+
 int threads_init(void)
 {
+  const char   *s;
+  unsigned int i;
+
   thread_yields = sb_get_value_int("thread-yields");
   thread_locks = sb_get_value_int("thread-locks");
   req_performed = 0;
 
+  s = sb_get_value_string("thread-pingpong");
+  for (i = 0; pingpong_names[i] != NULL; i++)
+    if (!strcmp(s, pingpong_names[i]))
+      break;
+
+  if (pingpong_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for thread-pingpong: %s", s);
+    return 1;
+  }
+  pingpong_mode = (pingpong_mode_t) i;
+
+  if (pingpong_mode != PINGPONG_OFF)
+    return pingpong_init();
+
+  return 0;
+}
+
+
+int threads_done(void)
+{
+  if (pingpong_pairs != NULL)
+  {
+    for (unsigned int i = 0; i < sb_globals.threads / 2; i++)
+    {
+      channel_done(&pingpong_pairs[i].ping);
+      channel_done(&pingpong_pairs[i].pong);
+    }
+
+    free(pingpong_pairs);
+    pingpong_pairs = NULL;
+  }
+
   return 0;
 }
 
@@ -153,10 +355,165 @@ int threads_execute_event(sb_event_t *sb_req, int thread_id)
 }
 
 
+/* Pass the token to the other thread */
+
+static int channel_send(channel_t *ch)
+{
+  switch (pingpong_mode) {
+  case PINGPONG_FUTEX:
+#ifdef SB_THREADS_FUTEX
+    ck_pr_inc_uint(&ch->seq);
+    syscall(SYS_futex, &ch->seq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#endif
+    break;
+  case PINGPONG_CONDVAR:
+    pthread_mutex_lock(&ch->mutex);
+    ch->seq++;
+    pthread_cond_signal(&ch->cond);
+    pthread_mutex_unlock(&ch->mutex);
+    break;
+  case PINGPONG_EVENTFD:
+    {
+      uint64_t v = 1;
+
+      if (write(ch->fd[0], &v, sizeof(v)) != sizeof(v))
+      {
+        log_errno(LOG_FATAL, "write() to eventfd failed");
+        return 1;
+      }
+    }
+    break;
+  case PINGPONG_PIPE:
+    if (write(ch->fd[1], "", 1) != 1)
+    {
+      log_errno(LOG_FATAL, "write() to pipe failed");
+      return 1;
+    }
+    break;
+  default:
+    break;
+  }
+
+  return 0;
+}
+
+
+/* Wait for the token number 'seq' (only used by futex and condvar) */
+
+static int channel_wait(channel_t *ch, unsigned int seq)
+{
+  switch (pingpong_mode) {
+  case PINGPONG_FUTEX:
+#ifdef SB_THREADS_FUTEX
+    {
+      unsigned int v;
+
+      while ((v = ck_pr_load_uint(&ch->seq)) != seq)
+        syscall(SYS_futex, &ch->seq, FUTEX_WAIT_PRIVATE, v, NULL, NULL, 0);
+    }
+#endif
+    break;
+  case PINGPONG_CONDVAR:
+    pthread_mutex_lock(&ch->mutex);
+    while (ch->seq != seq)
+      pthread_cond_wait(&ch->cond, &ch->mutex);
+    pthread_mutex_unlock(&ch->mutex);
+    break;
+  case PINGPONG_EVENTFD:
+    {
+      uint64_t v;
+
+      if (read(ch->fd[0], &v, sizeof(v)) != sizeof(v))
+      {
+        log_errno(LOG_FATAL, "read() from eventfd failed");
+        return 1;
+      }
+    }
+    break;
+  case PINGPONG_PIPE:
+    {
+      char c;
+
+      if (read(ch->fd[0], &c, 1) != 1)
+      {
+        log_errno(LOG_FATAL, "read() from pipe failed");
+        return 1;
+      }
+    }
+    break;
+  default:
+    break;
+  }
+
+  return 0;
+}
+
+
+int pingpong_thread_run(int thread_id)
+{
+  pingpong_pair_t * const pair = &pingpong_pairs[thread_id / 2];
+  unsigned int            seq;
+
+  if (thread_id % 2 != 0)
+  {
+    /* Responder, send every token back until the initiator is done */
+    for (seq = 1; ; seq++)
+    {
+      if (channel_wait(&pair->ping, seq))
+        return 1;
+      if (ck_pr_load_int(&pair->stop))
+        return 0;
+      if (channel_send(&pair->pong))
+        return 1;
+    }
+  }
+
+  for (seq = 1; sb_more_events(thread_id); seq++)
+  {
+    sb_event_start(thread_id);
+
+    if (channel_send(&pair->ping) || channel_wait(&pair->pong, seq))
+    {
+      ck_pr_store_int(&pair->stop, 1);
+      channel_send(&pair->ping);
+      return 1;
+    }
+
+    sb_event_stop(thread_id);
+  }
+
+  /* Wake up the responder so it can exit */
+  ck_pr_store_int(&pair->stop, 1);
+
+  return channel_send(&pair->ping);
+}
+
+
 void threads_print_mode(void)
 {
   log_text(LOG_INFO, "Doing thread subsystem performance test");
+
+  if (pingpong_mode != PINGPONG_OFF)
+  {
+    log_text(LOG_NOTICE, "Token ping-pong between %u thread pairs using %s, "
+             "latency is per round trip\n", sb_globals.threads / 2,
+             pingpong_names[pingpong_mode]);
+    return;
+  }
+
   log_text(LOG_INFO, "Thread yields per test: %d Locks used: %d",
          thread_yields, thread_locks);
 }
 
+
+/* Print cumulative stats. */
+
+void threads_report_cumulative(sb_stat_t *stat)
+{
+  if (pingpong_mode != PINGPONG_OFF)
+    log_text(LOG_NOTICE, "Round trip latency (us): min %.2f, avg %.2f, max "
+             "%.2f", stat->latency_min * 1e6, stat->latency_avg * 1e6,
+             stat->latency_max * 1e6);
+
+  sb_report_cumulative(stat);
+}
@@ -0,0 +1,253 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Scheduler wakeup latency test, similar to cyclictest. Each worker thread
+  repeatedly sleeps until a scheduled time and measures how late it actually
+  wakes up. Every wakeup is an event whose latency is the overshoot, so the
+  regular latency statistics and --histogram describe wakeup latency. The last
+  --wakeup-load-threads threads generate CPU load instead of sleeping.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+
+#include <inttypes.h>
+
+#include "sysbench.h"
+#include "sb_ck_pr.h"
+#include "sb_timer.h"
+
+/* Wakeup test arguments */
+static sb_arg_t wakeup_args[] =
+{
+  SB_OPT("wakeup-interval", "sleep interval in microseconds", "1000", INT),
+  /*
+    'abstime' sleeps until periodic absolute deadlines with clock_nanosleep(),
+    'nanosleep' sleeps for the interval after each wakeup
+  */
+  SB_OPT("wakeup-mode", "sleep method {abstime, nanosleep}", "abstime",
+         STRING),
+  SB_OPT("wakeup-load-threads", "number of threads that spin on a CPU to "
+         "generate background load", "0", INT),
+
+  SB_OPT_END
+};
+
+/* Wakeup test operations */
+static int wakeup_init(void);
+static void wakeup_print_mode(void);
+static int wakeup_thread_run(int);
+static void wakeup_report_cumulative(sb_stat_t *);
+
+static sb_test_t wakeup_test =
+{
+  .sname = "wakeup",
+  .lname = "Scheduler wakeup latency test",
+  .ops = {
+    .init = wakeup_init,
+    .print_mode = wakeup_print_mode,
+    .thread_run = wakeup_thread_run,
+    .report_cumulative = wakeup_report_cumulative
+  },
+  .args = wakeup_args
+};
+
+static uint64_t     wakeup_interval_ns;
+static bool         wakeup_abstime;
+static unsigned int wakeup_load_threads;
+
+/* Number of sleeping threads that are still running */
+static unsigned int wakeup_nrunning;
+
+#define IS_LOAD_THREAD(id) \
+  ((unsigned int) (id) >= sb_globals.threads - wakeup_load_threads)
+
+
+int register_test_wakeup(sb_list_t *tests)
+{
+  SB_LIST_ADD_TAIL(&wakeup_test.listitem, tests);
+
+  return 0;
+}
+
+
+int wakeup_init(void)
+{
+  const char *s;
+  int        n;
+
+  n = sb_get_value_int("wakeup-interval");
+  if (n <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for wakeup-interval: %d", n);
+    return 1;
+  }
+  wakeup_interval_ns = (uint64_t) n * 1000;
+
+  s = sb_get_value_string("wakeup-mode");
+  if (!strcmp(s, "abstime"))
+    wakeup_abstime = true;
+  else if (!strcmp(s, "nanosleep"))
+    wakeup_abstime = false;
+  else
+  {
+    log_text(LOG_FATAL, "Invalid value for wakeup-mode: %s", s);
+    return 1;
+  }
+
+#if !defined(HAVE_CLOCK_NANOSLEEP) || !defined(HAVE_CLOCK_GETTIME)
+  if (wakeup_abstime)
+  {
+    log_text(LOG_FATAL, "--wakeup-mode=abstime is not supported on this "
+             "platform");
+    return 1;
+  }
+#endif
+
+  n = sb_get_value_int("wakeup-load-threads");
+  if (n < 0 || (unsigned int) n >= sb_globals.threads)
+  {
+    log_text(LOG_FATAL, "--wakeup-load-threads must be less than --threads");
+    return 1;
+  }
+  wakeup_load_threads = (unsigned int) n;
+
+  if (sb_globals.tx_rate > 0)
+  {
+    log_text(LOG_FATAL, "The 'wakeup' test does not support --rate");
+    return 1;
+  }
+
+  wakeup_nrunning = sb_globals.threads - wakeup_load_threads;
+
+  return 0;
+}
+
+
+/* Spin until all sleeping threads are done */
+
+static int load_thread_run(void)
+{
+  while (ck_pr_load_uint(&wakeup_nrunning) > 0)
+  {
+    for (unsigned int i = 0; i < 1000; i++)
+      ck_pr_barrier();
+  }
+
+  return 0;
+}
+
+
+/* Sleep until 'ts' */
+
+static int sleep_until(const struct timespec *ts, uint64_t interval_ns)
+{
+#if defined(HAVE_CLOCK_NANOSLEEP) && defined(HAVE_CLOCK_GETTIME)
+  if (wakeup_abstime)
+  {
+    int rc;
+
+    while ((rc = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, ts, NULL)) ==
+           EINTR) ;
+
+    if (rc != 0)
+    {
+      log_text(LOG_FATAL, "clock_nanosleep() failed: %s", strerror(rc));
+      return 1;
+    }
+
+    return 0;
+  }
+#else
+  (void) ts; /* unused */
+#endif
+
+  if (sb_nanosleep(interval_ns) && errno != EINTR)
+  {
+    log_errno(LOG_FATAL, "nanosleep() failed");
+    return 1;
+  }
+
+  return 0;
+}
+
+
+int wakeup_thread_run(int thread_id)
+{
+  struct timespec next;
+  uint64_t        ns;
+  int             rc = 0;
+
+  if (IS_LOAD_THREAD(thread_id))
+    return load_thread_run();
+
+  SB_GETTIME(&next);
+
+  while (sb_more_events(thread_id))
+  {
+    /* In the nanosleep mode, deadlines are relative to the last wakeup */
+    if (!wakeup_abstime)
+      SB_GETTIME(&next);
+
+    ns = SEC2NS(next.tv_sec) + next.tv_nsec + wakeup_interval_ns;
+    next.tv_sec = ns / NS_PER_SEC;
+    next.tv_nsec = ns % NS_PER_SEC;
+
+    if ((rc = sleep_until(&next, wakeup_interval_ns)))
+      break;
+
+    /* Latency of the event is the time since the deadline */
+    sb_event_start_at(thread_id, &next);
+    sb_event_stop(thread_id);
+  }
+
+  ck_pr_dec_uint(&wakeup_nrunning);
+
+  return rc;
+}
+
+
+void wakeup_print_mode(void)
+{
+  log_text(LOG_INFO, "Doing scheduler wakeup latency test\n");
+  log_text(LOG_NOTICE, "Sleep interval: %" PRIu64 "us (%s), %u sleeping "
+           "thread(s), %u load thread(s)\n", wakeup_interval_ns / 1000,
+           wakeup_abstime ? "abstime" : "nanosleep",
+           sb_globals.threads - wakeup_load_threads, wakeup_load_threads);
+}
+
+
+/* Print cumulative stats. */
+
+void wakeup_report_cumulative(sb_stat_t *stat)
+{
+  log_text(LOG_NOTICE, "Wakeup latency (us): min %.2f, avg %.2f, max %.2f",
+           stat->latency_min * 1e6, stat->latency_avg * 1e6,
+           stat->latency_max * 1e6);
+
+  sb_report_cumulative(stat);
+}
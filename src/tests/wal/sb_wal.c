@@ -0,0 +1,665 @@
+/*
+   Copyright (C) 2018 Alexey Kopytov <akopytov@gmail.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Write-ahead log group commit test. Each event is a commit: the thread
+  appends a record to the shared log buffer and waits until the record is
+  durable. The first waiting thread becomes the leader, optionally waits for
+  more commits to join its group, then writes and syncs all pending records
+  with a single write and sync call. Other threads wait for the leader to
+  finish, and one of those whose records were not covered by the flush becomes
+  the next leader. This is the way InnoDB, the MySQL binary log and
+  PostgreSQL flush their logs.
+*/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#ifdef HAVE_STRING_H
+# include <string.h>
+#endif
+#ifdef HAVE_ERRNO_H
+# include <errno.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+# include <fcntl.h>
+#endif
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
+
+#include <pthread.h>
+#include <inttypes.h>
+
+#include "sysbench.h"
+#include "sb_timer.h"
+#include "sb_histogram.h"
+#include "sb_counter.h"
+
+#if defined(HAVE_PWRITEV2) && defined(RWF_DSYNC)
+# define SB_WAL_RWF_DSYNC
+#endif
+
+/* WAL test arguments */
+static sb_arg_t wal_args[] =
+{
+  SB_OPT("wal-file", "log file to create and remove after the test",
+         "test_wal_file", STRING),
+  SB_OPT("wal-file-size", "log file size, appends wrap around to the "
+         "beginning of the file when it is full", "64M", SIZE),
+  SB_OPT("wal-record-size", "size of a commit record", "512", SIZE),
+  SB_OPT("wal-sync-method", "method to make flushed records durable "
+         "{fdatasync, fsync, o_dsync, sync_file_range, rwf_dsync, none}",
+         "fdatasync", STRING),
+  SB_OPT("wal-commit-delay", "time in microseconds the leader waits for "
+         "more commits to join its group before flushing (0 - flush "
+         "immediately)", "0", INT),
+  SB_OPT("wal-max-batch", "maximum number of commits to flush at once. The "
+         "leader stops waiting for more commits when it has this many (0 - "
+         "unlimited)", "0", INT),
+
+  SB_OPT_END
+};
+
+typedef enum
+{
+  WAL_SYNC_FDATASYNC,           /* write() + fdatasync() */
+  WAL_SYNC_FSYNC,               /* write() + fsync() */
+  WAL_SYNC_O_DSYNC,             /* write() to a file opened with O_DSYNC */
+  WAL_SYNC_FILE_RANGE,          /* write() + sync_file_range() */
+  WAL_SYNC_RWF_DSYNC,           /* pwritev2() with RWF_DSYNC */
+  WAL_SYNC_NONE                 /* write() to the page cache only */
+} wal_sync_method_t;
+
+static const char *wal_sync_method_names[] =
+{
+  "fdatasync", "fsync", "o_dsync", "sync_file_range", "rwf_dsync", "none",
+  NULL
+};
+
+/* WAL test operations */
+static int wal_init(void);
+static void wal_print_mode(void);
+static sb_event_t wal_next_event(int);
+static int wal_execute_event(sb_event_t *, int);
+static void wal_report_intermediate(sb_stat_t *);
+static void wal_report_cumulative(sb_stat_t *);
+static int wal_done(void);
+
+static sb_test_t wal_test =
+{
+  .sname = "wal",
+  .lname = "Write-ahead log group commit test",
+  .ops = {
+    .init = wal_init,
+    .print_mode = wal_print_mode,
+    .next_event = wal_next_event,
+    .execute_event = wal_execute_event,
+    .report_intermediate = wal_report_intermediate,
+    .report_cumulative = wal_report_cumulative,
+    .done = wal_done
+  },
+  .args = wal_args
+};
+
+static const char        *wal_file_name;
+static size_t            wal_file_size;
+static size_t            wal_record_size;
+static wal_sync_method_t wal_sync_method;
+static unsigned int      wal_commit_delay;
+static unsigned int      wal_max_batch;
+
+static int               wal_fd = -1;
+
+/*
+  Group commit state, protected by wal_mutex. Each thread has at most one
+  commit in flight, so the pending buffer never has more than
+  sb_globals.threads records. LSNs are record numbers.
+*/
+static pthread_mutex_t   wal_mutex;
+static pthread_cond_t    wal_append_cond;   /* a commit joined the group */
+static pthread_cond_t    wal_flush_cond;    /* a flush has completed */
+static char              *wal_pending;      /* records waiting for a flush */
+static unsigned int      wal_npending;
+static uint64_t          wal_pending_lsn;   /* LSN before the first pending */
+static uint64_t          wal_flushed_lsn;   /* last durable LSN */
+static bool              wal_leader;        /* a leader is forming a group */
+static bool              wal_failed;
+static unsigned int      wal_batch_max;     /* largest group flushed so far */
+
+/* The following are only accessed by the current leader */
+static char              *wal_flush_buf;
+static size_t            wal_write_pos;
+
+static char              *wal_record;      /* contents of every record */
+
+/* Latency of write and sync calls, excluding the group forming time */
+static sb_histogram_t    wal_flush_histogram;
+static bool              wal_flush_latency;
+
+static const double      mebibyte = 1024 * 1024;
+
+
+int register_test_wal(sb_list_t *tests)
+{
+  SB_LIST_ADD_TAIL(&wal_test.listitem, tests);
+
+  return 0;
+}
+
+
+/* Create the log file and zero-fill it, like databases do with log files */
+
+static int wal_create_file(void)
+{
+  char   *buf;
+  size_t buf_size = 1024 * 1024;
+  int    fd;
+  int    flags = O_WRONLY;
+
+  fd = open(wal_file_name, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+  if (fd < 0)
+  {
+    log_errno(LOG_FATAL, "Cannot create file '%s'", wal_file_name);
+    return 1;
+  }
+
+  buf = calloc(1, buf_size);
+  if (buf == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    close(fd);
+    return 1;
+  }
+
+  for (size_t pos = 0; pos < wal_file_size; pos += buf_size)
+  {
+    const size_t len = SB_MIN(buf_size, wal_file_size - pos);
+
+    if (pwrite(fd, buf, len, (off_t) pos) != (ssize_t) len)
+    {
+      log_errno(LOG_FATAL, "Failed to write file '%s'", wal_file_name);
+      free(buf);
+      close(fd);
+      return 1;
+    }
+  }
+
+  free(buf);
+
+  if (fsync(fd) || close(fd))
+  {
+    log_errno(LOG_FATAL, "Failed to fsync file '%s'", wal_file_name);
+    return 1;
+  }
+
+#ifdef O_DSYNC
+  if (wal_sync_method == WAL_SYNC_O_DSYNC)
+    flags |= O_DSYNC;
+#endif
+
+  wal_fd = open(wal_file_name, flags);
+  if (wal_fd < 0)
+  {
+    log_errno(LOG_FATAL, "Cannot open file '%s'", wal_file_name);
+    return 1;
+  }
+
+  return 0;
+}
+
+
+int wal_init(void)
+{
+  const char *s;
+  long long  ll;
+  int        i;
+
+  wal_file_name = sb_get_value_string("wal-file");
+
+  s = sb_get_value_string("wal-sync-method");
+  for (i = 0; wal_sync_method_names[i] != NULL; i++)
+    if (!strcmp(wal_sync_method_names[i], s))
+      break;
+  if (wal_sync_method_names[i] == NULL)
+  {
+    log_text(LOG_FATAL, "Invalid value for wal-sync-method: %s", s);
+    return 1;
+  }
+  wal_sync_method = (wal_sync_method_t) i;
+
+#ifndef O_DSYNC
+  if (wal_sync_method == WAL_SYNC_O_DSYNC)
+  {
+    log_text(LOG_FATAL, "--wal-sync-method=o_dsync is not supported on this "
+             "platform");
+    return 1;
+  }
+#endif
+#ifndef HAVE_SYNC_FILE_RANGE
+  if (wal_sync_method == WAL_SYNC_FILE_RANGE)
+  {
+    log_text(LOG_FATAL, "--wal-sync-method=sync_file_range is not supported "
+             "on this platform");
+    return 1;
+  }
+#endif
+#ifndef SB_WAL_RWF_DSYNC
+  if (wal_sync_method == WAL_SYNC_RWF_DSYNC)
+  {
+    log_text(LOG_FATAL, "--wal-sync-method=rwf_dsync is not supported on "
+             "this platform");
+    return 1;
+  }
+#endif
+
+  ll = sb_get_value_size("wal-record-size");
+  if (ll <= 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for wal-record-size: %lld", ll);
+    return 1;
+  }
+  wal_record_size = (size_t) ll;
+
+  ll = sb_get_value_size("wal-file-size");
+  if (ll < (long long) (wal_record_size * sb_globals.threads))
+  {
+    log_text(LOG_FATAL, "--wal-file-size must be at least --wal-record-size "
+             "times the number of threads");
+    return 1;
+  }
+  /* Keep records from straddling the end of the file */
+  wal_file_size = (size_t) ll / wal_record_size * wal_record_size;
+
+  i = sb_get_value_int("wal-commit-delay");
+  if (i < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for wal-commit-delay: %d", i);
+    return 1;
+  }
+  wal_commit_delay = (unsigned int) i;
+
+  i = sb_get_value_int("wal-max-batch");
+  if (i < 0)
+  {
+    log_text(LOG_FATAL, "Invalid value for wal-max-batch: %d", i);
+    return 1;
+  }
+  wal_max_batch = (unsigned int) i;
+
+  wal_pending = malloc(wal_record_size * sb_globals.threads);
+  wal_flush_buf = malloc(wal_record_size * sb_globals.threads);
+  wal_record = malloc(wal_record_size);
+  if (wal_pending == NULL || wal_flush_buf == NULL || wal_record == NULL)
+  {
+    log_text(LOG_FATAL, "Memory allocation failure");
+    return 1;
+  }
+
+  for (size_t n = 0; n < wal_record_size; n++)
+    wal_record[n] = (char) n;
+
+  pthread_mutex_init(&wal_mutex, NULL);
+  pthread_cond_init(&wal_append_cond, NULL);
+  pthread_cond_init(&wal_flush_cond, NULL);
+
+  wal_npending = 0;
+  wal_pending_lsn = 0;
+  wal_flushed_lsn = 0;
+  wal_leader = false;
+  wal_failed = false;
+  wal_batch_max = 0;
+  wal_write_pos = 0;
+
+  if (sb_globals.npercentiles > 0)
+  {
+    if (oper_histogram_init(&wal_flush_histogram))
+      return 1;
+    wal_flush_latency = true;
+  }
+
+  return wal_create_file();
+}
+
+
+int wal_done(void)
+{
+  if (wal_fd >= 0)
+  {
+    close(wal_fd);
+    unlink(wal_file_name);
+  }
+  wal_fd = -1;
+
+  if (wal_flush_latency)
+    sb_histogram_done(&wal_flush_histogram);
+  wal_flush_latency = false;
+
+  pthread_mutex_destroy(&wal_mutex);
+  pthread_cond_destroy(&wal_append_cond);
+  pthread_cond_destroy(&wal_flush_cond);
+
+  free(wal_pending);
+  free(wal_flush_buf);
+  free(wal_record);
+  wal_pending = wal_flush_buf = wal_record = NULL;
+
+  return 0;
+}
+
+
+sb_event_t wal_next_event(int thread_id)
+{
+  sb_event_t req;
+
+  (void) thread_id; /* unused */
+
+  req.type = SB_REQ_TYPE_WAL;
+
+  return req;
+}
+
+
+/* Write len bytes at pos and make them durable. Returns 0 on success. */
+
+static int wal_write(const char *buf, size_t len, size_t pos)
+{
+  switch (wal_sync_method) {
+  case WAL_SYNC_RWF_DSYNC:
+#ifdef SB_WAL_RWF_DSYNC
+    {
+      struct iovec iov = { .iov_base = (void *) buf, .iov_len = len };
+
+      return pwritev2(wal_fd, &iov, 1, (off_t) pos, RWF_DSYNC) !=
+        (ssize_t) len;
+    }
+#endif
+    return 1;
+
+  default:
+    break;
+  }
+
+  if (pwrite(wal_fd, buf, len, (off_t) pos) != (ssize_t) len)
+    return 1;
+
+  switch (wal_sync_method) {
+  case WAL_SYNC_FDATASYNC:
+#ifdef HAVE_FDATASYNC
+    return fdatasync(wal_fd) != 0;
+#else
+    return fsync(wal_fd) != 0;
+#endif
+
+  case WAL_SYNC_FSYNC:
+    return fsync(wal_fd) != 0;
+
+  case WAL_SYNC_FILE_RANGE:
+#ifdef HAVE_SYNC_FILE_RANGE
+    return sync_file_range(wal_fd, (off_t) pos, (off_t) len,
+                           SYNC_FILE_RANGE_WAIT_BEFORE |
+                           SYNC_FILE_RANGE_WRITE |
+                           SYNC_FILE_RANGE_WAIT_AFTER) != 0;
+#endif
+    return 1;
+
+  default:
+    return 0;
+  }
+}
+
+
+/*
+  Write and sync a group of nrecords records from wal_flush_buf, splitting the
+  write when it wraps around the end of the file.
+*/
+
+static int wal_flush(unsigned int nrecords, int thread_id)
+{
+  size_t          len = nrecords * wal_record_size;
+  const char      *buf = wal_flush_buf;
+  struct timespec ts;
+  uint64_t        start_ns = 0;
+
+  if (wal_flush_latency)
+  {
+    SB_GETTIME(&ts);
+    start_ns = SEC2NS(ts.tv_sec) + ts.tv_nsec;
+  }
+
+  sb_counter_inc(thread_id, SB_CNT_OTHER);
+  sb_counter_add(thread_id, SB_CNT_BYTES_WRITTEN, len);
+
+  while (len > 0)
+  {
+    const size_t n = SB_MIN(len, wal_file_size - wal_write_pos);
+
+    if (wal_write(buf, n, wal_write_pos))
+    {
+      log_errno(LOG_FATAL, "Failed to write or sync file '%s' using %s",
+                wal_file_name, wal_sync_method_names[wal_sync_method]);
+      return 1;
+    }
+
+    buf += n;
+    len -= n;
+    wal_write_pos = (wal_write_pos + n) % wal_file_size;
+  }
+
+  if (wal_flush_latency)
+  {
+    SB_GETTIME(&ts);
+    sb_histogram_update(&wal_flush_histogram,
+                        NS2MS(SEC2NS(ts.tv_sec) + ts.tv_nsec - start_ns));
+  }
+
+  return 0;
+}
+
+
+/* Lead a group: wait for it to form, then flush it. Called with the mutex. */
+
+static int wal_lead(int thread_id)
+{
+  unsigned int n;
+  uint64_t     lsn;
+  int          rc;
+
+  wal_leader = true;
+
+  if (wal_commit_delay > 0)
+  {
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += (long) wal_commit_delay * 1000;
+    deadline.tv_sec += deadline.tv_nsec / NS_PER_SEC;
+    deadline.tv_nsec %= NS_PER_SEC;
+
+    /* Nobody else can join once all threads have a commit pending */
+    while ((wal_max_batch == 0 || wal_npending < wal_max_batch) &&
+           wal_npending < sb_globals.threads)
+    {
+      if (pthread_cond_timedwait(&wal_append_cond, &wal_mutex, &deadline) ==
+          ETIMEDOUT)
+        break;
+    }
+  }
+
+  n = wal_npending;
+  if (wal_max_batch > 0 && n > wal_max_batch)
+    n = wal_max_batch;
+
+  /* Take the first n pending records, the rest go to the next group */
+  memcpy(wal_flush_buf, wal_pending, n * wal_record_size);
+  memmove(wal_pending, wal_pending + n * wal_record_size,
+          (wal_npending - n) * wal_record_size);
+  wal_npending -= n;
+  wal_pending_lsn += n;
+  lsn = wal_pending_lsn;
+
+  if (n > wal_batch_max)
+    wal_batch_max = n;
+
+  /* Let more commits accumulate while the group is being flushed */
+  pthread_mutex_unlock(&wal_mutex);
+
+  rc = wal_flush(n, thread_id);
+
+  pthread_mutex_lock(&wal_mutex);
+
+  if (rc)
+    wal_failed = true;
+  else
+    wal_flushed_lsn = lsn;
+
+  wal_leader = false;
+  pthread_cond_broadcast(&wal_flush_cond);
+
+  return rc;
+}
+
+
+int wal_execute_event(sb_event_t *r, int thread_id)
+{
+  uint64_t lsn;
+  int      rc = 0;
+
+  (void) r; /* unused */
+
+  pthread_mutex_lock(&wal_mutex);
+
+  memcpy(wal_pending + wal_npending * wal_record_size, wal_record,
+         wal_record_size);
+  wal_npending++;
+  lsn = wal_pending_lsn + wal_npending;
+
+  if (wal_leader)
+    pthread_cond_signal(&wal_append_cond);
+
+  while (wal_flushed_lsn < lsn && !wal_failed)
+  {
+    if (!wal_leader)
+      rc = wal_lead(thread_id);
+    else
+      pthread_cond_wait(&wal_flush_cond, &wal_mutex);
+  }
+
+  if (wal_failed)
+    rc = 1;
+
+  pthread_mutex_unlock(&wal_mutex);
+
+  return rc;
+}
+
+
+void wal_print_mode(void)
+{
+  char sizestr[16];
+
+  log_text(LOG_INFO, "Doing WAL group commit test\n");
+  log_text(LOG_NOTICE, "Record size: %sB, sync method: %s",
+           sb_print_value_size(sizestr, sizeof(sizestr), wal_record_size),
+           wal_sync_method_names[wal_sync_method]);
+
+  if (wal_commit_delay > 0)
+    log_text(LOG_NOTICE, "Commit delay: %u us", wal_commit_delay);
+  if (wal_max_batch > 0)
+    log_text(LOG_NOTICE, "Maximum group size: %u commits", wal_max_batch);
+
+  log_text(LOG_NOTICE, "");
+}
+
+
+/* Print intermediate stats. */
+
+void wal_report_intermediate(sb_stat_t *stat)
+{
+  sb_report_intermediate(stat);
+
+  if (stat->other == 0)
+    return;
+
+  if (wal_flush_latency)
+  {
+    double *pcts = sb_histogram_get_pct_intermediate(&wal_flush_histogram,
+                                                     sb_globals.percentiles,
+                                                     sb_globals.npercentiles);
+    char   *str = create_pct_string_intermediate(sb_globals.percentiles, pcts,
+                                                 sb_globals.npercentiles);
+
+    log_timestamp(LOG_NOTICE, stat->time_total,
+                  "flushes/s: %4.2f commits/flush: %4.2f flush %s",
+                  stat->other / stat->time_interval,
+                  (double) stat->events / stat->other, str);
+
+    free(str);
+    free(pcts);
+  }
+  else
+    log_timestamp(LOG_NOTICE, stat->time_total,
+                  "flushes/s: %4.2f commits/flush: %4.2f",
+                  stat->other / stat->time_interval,
+                  (double) stat->events / stat->other);
+}
+
+
+/* Print cumulative stats. */
+
+void wal_report_cumulative(sb_stat_t *stat)
+{
+  const double seconds = stat->time_interval;
+
+  log_text(LOG_NOTICE, "Commits: %" PRIu64 " (%.2f per second)",
+           stat->events, stat->events / seconds);
+  log_text(LOG_NOTICE, "Flushes: %" PRIu64 " (%.2f per second), "
+           "%.2f commits per flush on average, %u at most",
+           stat->other, stat->other / seconds,
+           stat->other > 0 ? (double) stat->events / stat->other : 0,
+           wal_batch_max);
+  log_text(LOG_NOTICE, "Written: %.2f MiB (%.2f MiB/s)",
+           stat->bytes_written / mebibyte,
+           stat->bytes_written / mebibyte / seconds);
+
+  if (wal_flush_latency)
+  {
+    double *pcts = sb_histogram_get_pct_checkpoint(&wal_flush_histogram,
+                                                   sb_globals.percentiles,
+                                                   sb_globals.npercentiles);
+    char   *str = create_pct_string_cumulative(sb_globals.percentiles, pcts,
+                                               sb_globals.npercentiles);
+
+    /* Drop the trailing newline, sb_report_cumulative() adds an empty line */
+    if (*str != '\0')
+      str[strlen(str) - 1] = '\0';
+
+    log_text(LOG_NOTICE, "Flush latency (ms):");
+    log_text(LOG_NOTICE, "%s", str);
+
+    free(str);
+    free(pcts);
+  }
+
+  /* Event latency is commit latency, including the wait for the group */
+  sb_report_cumulative(stat);
+}
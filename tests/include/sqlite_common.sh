@@ -0,0 +1,29 @@
+########################################################################
+# Common code for SQLite-specific tests
+########################################################################
+set -eu
+
+if [ -z "${SBTEST_HAS_SQLITE:-}" ]
+then
+  exit 80
+fi
+
+# Dump a table schema with the sqlite3 shell, if available
+function db_show_table() {
+  if ! command -v sqlite3 >/dev/null
+  then
+    return
+  fi
+
+  if [ -z "$(sqlite3 $CRAMTMP/sbtest.db \
+      "SELECT name FROM sqlite_master WHERE name = '$1'")" ]
+  then
+    echo "Did not find any relation named \"$1\"."
+    return 1
+  fi
+
+  sqlite3 $CRAMTMP/sbtest.db \
+          "SELECT sql FROM sqlite_master WHERE tbl_name = '$1' ORDER BY type DESC, name"
+}
+
+DB_DRIVER_ARGS="--db-driver=sqlite --sqlite-db=$CRAMTMP/sbtest.db ${SBTEST_SQLITE_ARGS:-}"
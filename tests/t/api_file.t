@@ -0,0 +1,65 @@
+########################################################################
+Tests for file I/O API
+########################################################################
+
+  $ sysbench <<EOF
+  >   local f = sysbench.file.open("f1", {create = true, size = 65536,
+  >                                       max_len = 8192, depth = 4})
+  >   print(f, f:size())
+  >   print(f:pwrite(4096, 0), f:pread(8192, 61440), f:pread(4096, 65536))
+  >   f:queue_write(8192, 8192)
+  >   f:queue_read(4096, 0)
+  >   f:queue_read(4096, 4096)
+  >   print(f:submit(), f:submit())
+  >   f:fsync()
+  >   f:fdatasync()
+  >   print(pcall(f.queue_read, f, 8193, 0))
+  >   for i = 1, 4 do f:queue_read(512, 0) end
+  >   print(pcall(f.queue_read, f, 512, 0))
+  >   print(f:submit())
+  >   f:close()
+  >   print(pcall(sysbench.file.open, "missing"))
+  >   print(pcall(sysbench.file.open, "f1", {mode = "foo"}))
+  >   print(pcall(sysbench.file.open, "f1", {mode = "mmap", direct = true}))
+  >   local m = sysbench.file.open("f1", {mode = "mmap"})
+  >   print(m:pwrite(4096, 61440), m:pread(8192, 61440))
+  >   m:fsync()
+  > EOF
+  sysbench * (glob)
+  
+  <sb_file>\t65536 (esc)
+  4096\t4096\t0 (esc)
+  16384\t0 (esc)
+  ALERT: sysbench.file: request of 8193 bytes is longer than the maximum of 8192
+  false\tqueue_read() failed (esc)
+  ALERT: sysbench.file: too many queued requests, the queue depth is 4
+  false\tqueue_read() failed (esc)
+  2048
+  FATAL: sysbench.file: cannot open 'missing' errno = 2 (No such file or directory)
+  false\tfailed to open 'missing' (esc)
+  FATAL: sysbench.file: invalid I/O mode: foo
+  false\tfailed to open 'f1' (esc)
+  FATAL: sysbench.file: direct I/O cannot be used with 'mmap' mode
+  false\tfailed to open 'f1' (esc)
+  4096\t4096 (esc)
+
+Transferred data is accounted in statistics
+
+  $ cat > file.lua <<EOF
+  > function thread_init()
+  >   f = sysbench.file.open("f" .. sysbench.tid, {create = true, size = 65536})
+  > end
+  > function event()
+  >   f:queue_write(4096, 0)
+  >   f:queue_read(8192, 8192)
+  >   f:submit()
+  >   f:fsync()
+  > end
+  > function sysbench.hooks.report_cumulative(stat)
+  >   print(stat.reads, stat.writes, stat.other, stat.bytes_read,
+  >         stat.bytes_written)
+  > end
+  > EOF
+  $ sysbench file.lua --threads=2 --events=10 run | tail -1
+  10\t10\t10\t81920\t40960 (esc)
+  $ rm -f f0 f1
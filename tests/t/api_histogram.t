@@ -19,3 +19,24 @@ Tests for histogram API
          2.001 |********************                     1
          4.997 |********************                     1
         10.000 |**************************************** 2
+
+  $ sysbench <<EOF
+  >   h = sysbench.histogram.new_hdr(1, 1000, 2)
+  >   for i = 1, 100 do h:update(i) end
+  >   h:update(0)
+  >   h:update(5000)
+  >   print(h:percentile(50), h:percentile(99), h:percentile(100))
+  >   h = sysbench.histogram.new_hdr(1, 1000, 3)
+  >   h:update(1)
+  >   h:update(2)
+  >   h:update(2.5)
+  >   h:update(1000)
+  >   h:print()
+  > EOF
+  sysbench * (glob)
+  
+  50\t100\t1003 (esc)
+         value  ------------- distribution ------------- count
+         1.000 |********************                     1
+         2.000 |**************************************** 2
+      1000.000 |********************                     1
@@ -33,16 +33,44 @@ PRNG Lua API tests
 
   $ sysbench $SB_ARGS $CRAMTMP/api_rand.lua run
   sysbench.rand.default
+  sysbench.rand.default64
+  sysbench.rand.empirical
+  sysbench.rand.empirical64
+  sysbench.rand.fill_default
+  sysbench.rand.fill_empirical
+  sysbench.rand.fill_gaussian
+  sysbench.rand.fill_latest
+  sysbench.rand.fill_pareto
+  sysbench.rand.fill_special
+  sysbench.rand.fill_uint64
+  sysbench.rand.fill_uniform
+  sysbench.rand.fill_zipfian
   sysbench.rand.gaussian
+  sysbench.rand.gaussian64
+  sysbench.rand.key_hashed
+  sysbench.rand.key_sequential
+  sysbench.rand.key_snowflake
+  sysbench.rand.latest
+  sysbench.rand.latest64
+  sysbench.rand.latest_insert
+  sysbench.rand.latest_next
   sysbench.rand.pareto
+  sysbench.rand.pareto64
   sysbench.rand.special
+  sysbench.rand.special64
   sysbench.rand.string
+  sysbench.rand.ulid
   sysbench.rand.uniform
+  sysbench.rand.uniform64
   sysbench.rand.uniform_double
   sysbench.rand.uniform_uint64
   sysbench.rand.unique
+  sysbench.rand.unique64
+  sysbench.rand.uuid4
+  sysbench.rand.uuid7
   sysbench.rand.varstring
   sysbench.rand.zipfian
+  sysbench.rand.zipfian64
   sysbench.rand.default\(0, 99\) = [0-9]{1,2} (re)
   sysbench.rand.unique\(0, 4294967295\) = [0-9]{1,10} (re)
   sysbench.rand.uniform_uint64\(\) = [0-9]+ (re)
@@ -66,3 +94,162 @@ GH-96: sb_rand_uniq(1, oltp_table_size) generate duplicate value
   $ sysbench $SB_ARGS --events=100000 $CRAMTMP/api_rand_uniq.lua run |
   >   sort -n | uniq | wc -l | sed -e 's/ //g'
   100000
+
+########################################################################
+sysbench.rand.string(): all digits and letters are generated, long and short
+templates in a row
+########################################################################
+  $ cat >$CRAMTMP/api_rand_string.lua <<EOF
+  > function event()
+  >   local seen = {}
+  >   for i = 1, 1000 do
+  >     local s = sysbench.rand.string(string.rep("#@", 60))
+  >     assert(#s == 120 and s:match("^[0-9a-z]+$"))
+  >     for c in s:gmatch(".") do seen[c] = true end
+  >   end
+  >   local chars = {}
+  >   for c in pairs(seen) do table.insert(chars, c) end
+  >   table.sort(chars)
+  >   print(table.concat(chars))
+  >   print(sysbench.rand.string("x#y"):match("^x[0-9]y$"))
+  > end
+  > EOF
+  $ sysbench $SB_ARGS $CRAMTMP/api_rand_string.lua run
+  0123456789abcdefghijklmnopqrstuvwxyz
+  x[0-9]y (re)
+
+########################################################################
+64-bit distributions: values beyond 2^32 stay within the requested range,
+unique64() does not repeat
+########################################################################
+  $ cat >$CRAMTMP/api_rand64.lua <<EOF
+  > function event()
+  >   local a = 2^40
+  >   for _, f in ipairs({"default64", "uniform64", "gaussian64",
+  >                       "special64", "pareto64", "zipfian64"}) do
+  >     for i = 1, 10000 do
+  >       local v = sysbench.rand[f](a, a + 9)
+  >       assert(v >= a and v <= a + 9 and v == math.floor(v), f)
+  >     end
+  >   end
+  >   local seen = {}
+  >   for i = 1, 100000 do
+  >     local v = tostring(sysbench.rand.unique64())
+  >     assert(seen[v] == nil)
+  >     seen[v] = true
+  >   end
+  >   print("ok")
+  > end
+  > EOF
+
+  $ sysbench $SB_ARGS $CRAMTMP/api_rand64.lua run
+  ok
+
+########################################################################
+Zipfian distribution: precomputed tables and rejection-inversion sampling
+produce the same probabilities
+########################################################################
+  $ cat >$CRAMTMP/api_rand_zipfian.lua <<EOF
+  > function event()
+  >   local n, N, sum = 100, 1000000, 0
+  >   local cnt = {}
+  >   for k = 1, n do
+  >     cnt[k] = 0
+  >     sum = sum + k ^ -0.8
+  >   end
+  >   for i = 1, N do
+  >     local v = sysbench.rand.zipfian(1, n)
+  >     cnt[v] = cnt[v] + 1
+  >   end
+  >   for k = 1, n do
+  >     assert(math.abs(cnt[k] / N - k ^ -0.8 / sum) < 0.003, k)
+  >   end
+  >   print("ok")
+  > end
+  > EOF
+
+  $ sysbench $SB_ARGS $CRAMTMP/api_rand_zipfian.lua run
+  ok
+  $ sysbench $SB_ARGS --rand-zipfian-table=0 $CRAMTMP/api_rand_zipfian.lua run
+  ok
+  $ sysbench $SB_ARGS --rand-zipfian-table=-1 $CRAMTMP/api_rand_zipfian.lua run
+  FATAL: Invalid value for rand-zipfian-table: -1
+  [1]
+
+########################################################################
+'latest' distribution: favors the upper bound of the range until larger
+keys are reported as inserted
+########################################################################
+  $ cat >$CRAMTMP/api_rand_latest.lua <<EOF
+  > local function mode()
+  >   local cnt, best = {}, nil
+  >   for i = 1, 10000 do
+  >     local v = sysbench.rand.latest(1, 1000)
+  >     assert(v >= 1 and v <= 1200)
+  >     cnt[v] = (cnt[v] or 0) + 1
+  >     if best == nil or cnt[v] > cnt[best] then best = v end
+  >   end
+  >   return best
+  > end
+  > function event()
+  >   print(mode())
+  >   print(sysbench.rand.latest_next(1001), sysbench.rand.latest_next(1))
+  >   sysbench.rand.latest_insert(1200)
+  >   sysbench.rand.latest_insert(1100)
+  >   print(mode())
+  > end
+  > EOF
+
+  $ sysbench $SB_ARGS $CRAMTMP/api_rand_latest.lua run
+  1000
+  1001\t1002 (esc)
+  1200
+
+########################################################################
+Bulk generation: sysbench.rand.fill_*()
+########################################################################
+  $ cat >$CRAMTMP/api_rand_fill.lua <<EOF
+  > function event()
+  >   for _, d in ipairs({"default", "uniform", "gaussian", "special",
+  >                       "pareto", "zipfian"}) do
+  >     local buf = sysbench.rand["fill_" .. d](1000, 100, 199)
+  >     for i = 0, 999 do
+  >       assert(buf[i] >= 100 and buf[i] <= 199, d)
+  >     end
+  >   end
+  >   local buf = ffi.new("uint64_t[?]", 10)
+  >   assert(sysbench.rand.fill_uniform(10, 2^40, 2^40, buf) == buf)
+  >   print(tonumber(buf[0]), tonumber(buf[9]))
+  >   assert(sysbench.rand.fill_uint64(2, buf) == buf)
+  >   print(buf[0] ~= buf[1])
+  > end
+  > EOF
+
+  $ sysbench $SB_ARGS $CRAMTMP/api_rand_fill.lua run
+  1099511627776	1099511627776 (esc)
+  true
+
+########################################################################
+Primary key generators
+########################################################################
+  $ cat >$CRAMTMP/api_rand_keys.lua <<EOF
+  > function event()
+  >   local a, b = sysbench.rand.key_sequential(), sysbench.rand.key_sequential()
+  >   print(b - a, sysbench.rand.key_hashed() ~= sysbench.rand.key_hashed())
+  >   a, b = sysbench.rand.key_snowflake(), sysbench.rand.key_snowflake()
+  >   print(b > a)
+  >   for _, f in ipairs({"uuid4", "uuid7", "ulid"}) do
+  >     a, b = sysbench.rand[f](), sysbench.rand[f]()
+  >     print(f, #a, a:match("^%x+$") ~= nil, a ~= b)
+  >   end
+  >   print(sysbench.rand.uuid4():sub(13, 13), sysbench.rand.uuid7():sub(13, 13))
+  > end
+  > EOF
+
+  $ sysbench $SB_ARGS $CRAMTMP/api_rand_keys.lua run
+  1ULL\ttrue (esc)
+  true
+  uuid4\t32\ttrue\ttrue (esc)
+  uuid7\t32\ttrue\ttrue (esc)
+  ulid\t32\ttrue\ttrue (esc)
+  4\t7 (esc)
@@ -0,0 +1,65 @@
+########################################################################
+Tests for shared state API
+########################################################################
+
+  $ sysbench <<EOF
+  >   local c = sysbench.shared.counter("c")
+  >   print(c, c:add(10), c:add(-3), c:add(), c:get())
+  >   print(c:cas(8, 1), c:cas(8, 2), c:get())
+  >   c:set(-5)
+  >   print(sysbench.shared.counter("c"):get())
+  >   local m = sysbench.shared.map("m", 3)
+  >   print(m, m:get(0), m:add(0, 5), m:add(0), m:get(0))
+  >   m:set(1, -2)
+  >   m:set(2, 7)
+  >   print(m:count(), m:remove(1), m:remove(1), m:count(), m:get(1))
+  >   print(pcall(m.set, m, 3, 1))
+  >   m:set(1, 9)
+  >   print(m:get(1), m:count())
+  >   local q = sysbench.shared.queue("q", 3)
+  >   print(q, q:push(1), q:push(2), q:push(3), q:push(4), q:size())
+  >   print(q:pop(), q:pop(), q:pop(), q:pop(), q:size())
+  >   print(pcall(sysbench.shared.counter, ""))
+  >   print(pcall(sysbench.shared.queue, "x", 0))
+  >   print(pcall(sysbench.shared.queue, "q", 7))
+  >   print(pcall(sysbench.shared.map, "c", 10))
+  > EOF
+  sysbench * (glob)
+  
+  <sb_shared_counter>\t10\t7\t8\t8 (esc)
+  true\tfalse\t1 (esc)
+  -5
+  <sb_shared_map>\tnil\t5\t6\t6 (esc)
+  3\ttrue\tfalse\t2\tnil (esc)
+  false\tshared map is full (esc)
+  9\t3 (esc)
+  <sb_shared_queue>\ttrue\ttrue\ttrue\tfalse\t3 (esc)
+  1\t2\t3\tnil\t0 (esc)
+  false\tshared object name must be a non-empty string (esc)
+  false\tcapacity must be a positive integer (esc)
+  FATAL: shared queue 'q' already exists with capacity 3
+  false\tfailed to create shared queue 'q' (esc)
+  FATAL: shared map 'c' already exists as a counter
+  false\tfailed to create shared map 'c' (esc)
+
+Objects are shared by all threads
+
+  $ cat > $CRAMTMP/shared.lua <<EOF
+  > local ids = sysbench.shared.counter("ids")
+  > local hits = sysbench.shared.map("hits", 100)
+  > local queue = sysbench.shared.queue("queue", 100000)
+  > function event()
+  >   local id = ids:add()
+  >   hits:add(id % 10)
+  >   queue:push(id)
+  > end
+  > function sysbench.hooks.report_cumulative()
+  >   local sum, n, total = 0, 0, 0
+  >   for k = 0, 9 do sum = sum + hits:get(k) end
+  >   for v in queue.pop, queue do n = n + 1; total = total + v end
+  >   print(ids:get(), hits:count(), sum, n, total)
+  > end
+  > EOF
+
+  $ sysbench $CRAMTMP/shared.lua --threads=8 --events=20000 run | tail -1
+  20000\t10\t20000\t20000\t200010000 (esc)
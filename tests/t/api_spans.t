@@ -0,0 +1,55 @@
+########################################################################
+Tests for sysbench.span
+########################################################################
+
+  $ sysbench <<EOF
+  >   print(pcall(sysbench.span.finish))
+  >   print(pcall(sysbench.span.begin, ""))
+  >   sysbench.span.begin("outer")
+  >   sysbench.span.begin("inner")
+  >   print(pcall(sysbench.span.finish, "outer"))
+  >   print(sysbench.span.finish("inner") >= 0)
+  >   print(sysbench.span.finish() >= 0)
+  >   print(pcall(sysbench.span.finish))
+  > EOF
+  sysbench * (glob)
+  
+  false\tno open span to finish (esc)
+  false\tspan name must be a non-empty string (esc)
+  false\tspan 'outer' is finished while 'inner' is open (esc)
+  true
+  true
+  false\tno open span to finish (esc)
+
+Nested spans are recorded in named histograms, and spans left open by
+restarted events are discarded
+
+  $ cat > $CRAMTMP/spans.lua <<EOF
+  > local n = 0
+  > function event()
+  >   sysbench.span.begin("total")
+  >   sysbench.span.begin("select")
+  >   sysbench.sleep(0.002)
+  >   sysbench.span.finish()
+  >   n = n + 1
+  >   if n % 2 == 0 then
+  >     sysbench.span.begin("restarted")
+  >     error({errcode = sysbench.error.RESTART_EVENT})
+  >   end
+  >   sysbench.span.begin("commit")
+  >   sysbench.sleep(0.01)
+  >   sysbench.span.finish("commit")
+  >   sysbench.span.finish("total")
+  > end
+  > function sysbench.hooks.report_cumulative(stat)
+  >   local h = stat.histograms
+  >   print(h.restarted["95.00th percentile"] < 1e-3)
+  >   print(h.select["95.00th percentile"] < h.commit["95.00th percentile"])
+  >   print(h.commit["95.00th percentile"] < h.total["95.00th percentile"])
+  > end
+  > EOF
+
+  $ sysbench $CRAMTMP/spans.lua --events=20 run | tail -3
+  true
+  true
+  true
@@ -8,6 +8,7 @@ SQL Lua API + PostgreSQL tests
   SQL types:
   {
     BIGINT = 4,
+    BLOB = 13,
     CHAR = 11,
     DATE = 8,
     DATETIME = 9,
@@ -121,3 +122,283 @@ SQL Lua API + PostgreSQL tests
   ALERT: attempt to call bulk_insert_next() before bulk_insert_init()
   */api_sql.lua:*: db_bulk_insert_next() failed (glob)
   nil
+
+########################################################################
+# Bulk loading with COPY
+########################################################################
+  $ cat >$CRAMTMP/api_sql.lua <<EOF
+  > c = sysbench.sql.driver():connect()
+  > print(c:copy_supported())
+  > c:query("CREATE TABLE t1(a INT, b VARCHAR(10))")
+  > c:copy_init("COPY t1 FROM STDIN")
+  > for i = 1,1000 do
+  >   c:copy_next(string.format("%d\tfoo%d", i, i))
+  > end
+  > c:copy_done()
+  > print(c:query_row("SELECT COUNT(*), MAX(b) FROM t1 WHERE b = 'foo' || a"))
+  > e,m = pcall(function () c:copy_next("1\tfoo") end)
+  > print(m)
+  > c:query("DELETE FROM t1")
+  > print(c:copy_rows("COPY t1 FROM STDIN", "%n\t@#-%r%%", 5000, 9))
+  > print(c:query_row("SELECT COUNT(*), MIN(a), MAX(a) FROM t1 " ..
+  >                   "WHERE b ~ '^[a-z][0-9]-[1-9]%$'"))
+  > c:query("DROP TABLE t1")
+  > EOF
+  $ sysbench $SB_ARGS
+  true
+  1000 foo999
+  ALERT: attempt to call copy_next() before copy_init()
+  */api_sql.lua:*: db_copy_next() failed (glob)
+  true
+  5000 1 5000
+
+########################################################################
+# Result set retrieval modes
+########################################################################
+  $ cat >$CRAMTMP/api_sql.lua <<EOF
+  > c = sysbench.sql.driver():connect()
+  > c:query("CREATE TABLE t2(a INT)")
+  > c:bulk_insert_init("INSERT INTO t2 VALUES")
+  > for i = 1,100 do c:bulk_insert_next("(" .. i .. ")") end
+  > c:bulk_insert_done()
+  > rs = c:query("SELECT a FROM t2 ORDER BY a")
+  > n, s = 0, 0
+  > row = rs:fetch_row()
+  > while row ~= nil do n = n + 1; s = s + row[1]; row = rs:fetch_row() end
+  > print(n .. " " .. s .. " " .. rs.nrows)
+  > print(c:query_row("SELECT a FROM t2 WHERE a > 99"))
+  > print(c:query_row("SELECT a FROM t2 WHERE a > 100"))
+  > c:query("DROP TABLE t2")
+  > EOF
+  $ sysbench $SB_ARGS --db-result-mode=store
+  100 5050 100
+  100
+  nil
+  $ sysbench $SB_ARGS --db-result-mode=stream
+  100 5050 100
+  100
+  nil
+  $ sysbench $SB_ARGS --db-result-mode=discard
+  ALERT: attempt to fetch row from an empty result set
+  0 0 0
+  nil
+  nil
+  $ sysbench $SB_ARGS --db-result-mode=foo
+  FATAL: Invalid value for db-result-mode: foo
+  FATAL: */api_sql.lua:1: failed to initialize the DB driver (glob)
+  [1]
+
+########################################################################
+# Row views and aggregation in C
+########################################################################
+  $ cat >$CRAMTMP/api_sql.lua <<EOF
+  > c = sysbench.sql.driver():connect()
+  > c:query("CREATE TABLE t2(a INT, b VARCHAR(10))")
+  > c:query("INSERT INTO t2 VALUES (1, 'foo'), (2, NULL), (-3, 'barbaz')")
+  > rs = c:query("SELECT a, b FROM t2 ORDER BY a")
+  > row = rs:fetch_row_view()
+  > while row ~= nil do
+  >   print(row:get(1), row:is_null(2), row:len(1), row:get(2))
+  >   row = rs:fetch_row_view()
+  > end
+  > print(c:query("SELECT a FROM t2"):count_rows())
+  > print(c:query("SELECT a FROM t2 WHERE a > 10"):count_rows())
+  > print(c:query("SELECT a, b FROM t2"):sum_column(1))
+  > print(c:query("SELECT a / 2.0 FROM t2"):sum_column(1))
+  > print(c:query("SELECT b FROM t2 WHERE b IS NOT NULL ORDER BY b"):check_sorted(1, true))
+  > print(c:query("SELECT b FROM t2 ORDER BY a DESC"):check_sorted(1))
+  > e,m = pcall(function () c:query("SELECT a FROM t2"):sum_column(2) end)
+  > print(m)
+  > c:query("DROP TABLE t2")
+  > EOF
+  $ sysbench $SB_ARGS
+  -3\tfalse\t2\tbarbaz (esc)
+  1\tfalse\t1\tfoo (esc)
+  2\ttrue\t1\tnil (esc)
+  3
+  0
+  0\t3 (esc)
+  0\t3 (esc)
+  true\t2 (esc)
+  false\t3 (esc)
+  ALERT: invalid column number 2, the result set has 1 column(s)
+  */api_sql.lua:*: db_sum_column() failed (glob)
+
+########################################################################
+# Connection pool
+########################################################################
+  $ cat >$CRAMTMP/api_sql.lua <<EOF
+  > function event()
+  >   local c = sysbench.sql.driver():pool_checkout()
+  >   c:query("SELECT 1")
+  >   c:pool_return()
+  > end
+  > EOF
+  $ sysbench $SB_ARGS --threads=4 --events=100 --db-pool-size=2 run
+  $ sysbench $SB_ARGS run
+  FATAL: connection pooling is disabled, use --db-pool-size to enable it
+  FATAL: `thread_run' function failed: */api_sql.lua:2: connection pool checkout failed (glob)
+  [1]
+  $ cat >$CRAMTMP/api_sql.lua <<EOF
+  > function event()
+  >   local drv = sysbench.sql.driver()
+  >   local c = drv:pool_checkout()
+  >   c:pool_return()
+  >   print(pcall(c.pool_return, c))
+  >   c = drv:connect()
+  >   print(pcall(c.pool_return, c))
+  > end
+  > EOF
+  $ sysbench $SB_ARGS --db-pool-size=1 run
+  ALERT: attempt to return a connection which is not checked out from the pool
+  false\tassertion failed! (esc)
+  ALERT: attempt to return a connection which is not checked out from the pool
+  false\tassertion failed! (esc)
+
+########################################################################
+# Multiple hosts and target_session_attrs
+########################################################################
+  $ cat >$CRAMTMP/api_sql.lua <<EOF
+  > c = sysbench.sql.driver():connect()
+  > EOF
+  $ sysbench $SB_ARGS --pgsql-target-session-attrs=foo
+  FATAL: Connection to database failed: *target_session_attrs* (glob)
+  
+  FATAL: */api_sql.lua:1: connection creation failed (glob)
+  [1]
+
+########################################################################
+# Per-statement statistics
+########################################################################
+  $ cat >$CRAMTMP/api_sql.lua <<EOF
+  > function thread_init()
+  >   con = sysbench.sql.driver():connect()
+  >   stmt = con:prepare("SELECT 1")
+  >   stmt:set_label("point")
+  > end
+  > function event()
+  >   stmt:execute()
+  > end
+  > EOF
+  $ sysbench $SB_ARGS --events=10 --db-stmt-stats --verbosity=3 run |
+  >   sed -n '/per-statement/,/avg latency/p'
+      per-statement statistics:
+          point:
+              queries:                     10 * (glob)
+              errors:                      0
+              avg latency (ms):            * (glob)
+
+########################################################################
+# Latency split
+########################################################################
+  $ cat >$CRAMTMP/api_sql.lua <<EOF
+  > function thread_init()
+  >   con = sysbench.sql.driver():connect()
+  > end
+  > function event()
+  >   con:query("SELECT 1")
+  > end
+  > EOF
+  $ sysbench $SB_ARGS --events=10 --db-latency-split --percentile=0 \
+  >   --verbosity=3 run | sed -n '/latency split:/,/avg transfer/p'
+      latency split:
+          read:
+              queries:                     10 * (glob)
+              avg to first result (ms):    * (glob)
+              avg transfer (ms):           * (glob)
+
+########################################################################
+# Server-side cursors
+########################################################################
+  $ cat >$CRAMTMP/api_sql.lua <<EOF
+  > function thread_init()
+  >   con = sysbench.sql.driver():connect()
+  >   stmt = con:prepare("SELECT 1 UNION ALL SELECT 2 UNION ALL SELECT 3")
+  > end
+  > function event()
+  >   stmt:execute()
+  > end
+  > EOF
+  $ sysbench $SB_ARGS --events=10 --db-fetch-size=2 --verbosity=3 run |
+  >   sed -n '/cursors:/,/time to first row/p'
+      cursors:
+          queries:                         10 * (glob)
+          rows:                            30 * (glob)
+          rows per sec. while fetching:    * (glob)
+          time to first row (ms):
+
+########################################################################
+# Binary parameters of prepared statements
+########################################################################
+  $ cat >$CRAMTMP/api_sql.lua <<EOF
+  > c = sysbench.sql.driver():connect()
+  > c:query("CREATE TABLE t3(a BIGINT, b DOUBLE PRECISION, c VARCHAR(10))")
+  > stmt = c:prepare("INSERT INTO t3 VALUES (?, ?, ?)")
+  > a = stmt:bind_create(sysbench.sql.type.BIGINT)
+  > b = stmt:bind_create(sysbench.sql.type.DOUBLE)
+  > s = stmt:bind_create(sysbench.sql.type.VARCHAR, 10)
+  > stmt:bind_param(a, b, s)
+  > a:set(-5000000000)
+  > b:set(2.5)
+  > s:set("foo")
+  > stmt:execute()
+  > a:set(7)
+  > b:set(-0.25)
+  > stmt:execute()
+  > stmt:close()
+  > rs = c:query("SELECT a, b, c FROM t3 ORDER BY a")
+  > for i = 1, rs.nrows do print(unpack(rs:fetch_row(), 1, rs.nfields)) end
+  > c:query("DROP TABLE t3")
+  > EOF
+  $ sysbench $SB_ARGS --pgsql-binary-params
+  -5000000000\t2.5\tfoo (esc)
+  7\t-0.25\tfoo (esc)
+
+# Unnamed and cached prepared statements
+########################################################################
+  $ cat >$CRAMTMP/api_sql.lua <<EOF
+  > c = sysbench.sql.driver():connect()
+  > function count()
+  >   print(c:query_row("SELECT count(*) FROM pg_prepared_statements"))
+  > end
+  > for i = 1, 3 do
+  >   stmt = c:prepare("SELECT ? + 1")
+  >   a = stmt:bind_create(sysbench.sql.type.INT)
+  >   stmt:bind_param(a)
+  >   a:set(i)
+  >   print(stmt:execute():fetch_row()[1])
+  >   stmt:close()
+  > end
+  > count()
+  > stmt = c:prepare("SELECT 1")
+  > stmt:execute()
+  > stmt:close()
+  > count()
+  > c:reset()
+  > count()
+  > EOF
+  $ sysbench $SB_ARGS --pgsql-ps-mode=unnamed
+  2
+  3
+  4
+  0
+  0
+  0
+  $ sysbench $SB_ARGS --pgsql-ps-mode=cache
+  2
+  3
+  4
+  1
+  2
+  0
+  $ sysbench $SB_ARGS --pgsql-ps-mode=cache --pgsql-stmt-cache-size=1
+  2
+  3
+  4
+  1
+  1
+  0
+  $ sysbench $SB_ARGS --pgsql-ps-mode=foo
+  FATAL: Invalid value for pgsql-ps-mode: foo
+  FATAL: */api_sql.lua:1: failed to initialize the DB driver (glob)
+  [1]
@@ -0,0 +1,203 @@
+########################################################################
+SQL Lua API + SQLite tests
+########################################################################
+
+  $ . ${SBTEST_INCDIR}/sqlite_common.sh
+
+  $ cat >$CRAMTMP/api_sql.lua <<EOF
+  > function event()
+  >   local t = sysbench.sql.type
+  >   local con = sysbench.sql.driver():connect()
+  >   con:query("CREATE TABLE t(a INT, b VARCHAR(10), c DOUBLE)")
+  >   con:bulk_insert_init("INSERT INTO t VALUES")
+  >   for i = 1, 100 do
+  >     con:bulk_insert_next(string.format("(%d, 'row%d', %d.5)", i, i, i))
+  >   end
+  >   con:bulk_insert_done()
+  >   print(con:query_row("SELECT COUNT(*), SUM(a) FROM t"))
+  >   -- Only the result of the last statement is returned
+  >   print(con:query_row("UPDATE t SET b = NULL WHERE a = 1; SELECT b FROM t WHERE a = 1"))
+  >   local rs = con:query("SELECT a, b, c FROM t WHERE a < 4 ORDER BY a")
+  >   for i = 1, rs.nrows do
+  >     print(unpack(rs:fetch_row(), 1, rs.nfields))
+  >   end
+  >   local stmt = con:prepare("SELECT a, b, c FROM t WHERE a = ? AND c > ?")
+  >   local a = stmt:bind_create(t.BIGINT)
+  >   local c = stmt:bind_create(t.DOUBLE)
+  >   stmt:bind_param(a, c)
+  >   a:set(10)
+  >   c:set(1.25)
+  >   print(unpack(stmt:execute():fetch_row(), 1, 3))
+  >   stmt:close()
+  >   stmt = con:prepare("UPDATE t SET b = ? WHERE a <= ?")
+  >   local b = stmt:bind_create(t.CHAR, 10)
+  >   a = stmt:bind_create(t.INT)
+  >   stmt:bind_param(b, a)
+  >   b:set("foo")
+  >   a:set(50)
+  >   print(stmt:execute())
+  >   stmt:close()
+  >   print(con:query_row("SELECT COUNT(*) FROM t WHERE b = 'foo'"))
+  >   con:query("DROP TABLE t")
+  > end
+  > EOF
+
+  $ SB_ARGS="--verbosity=1 --events=1 $DB_DRIVER_ARGS $CRAMTMP/api_sql.lua"
+
+  $ sysbench $SB_ARGS run
+  100\t5050 (esc)
+  nil
+  1\tnil\t1.5 (esc)
+  2\trow2\t2.5 (esc)
+  3\trow3\t3.5 (esc)
+  10\trow10\t10.5 (esc)
+  <sql_result>
+  50
+
+  $ sysbench $SB_ARGS --db-ps-mode=disable run
+  100\t5050 (esc)
+  nil
+  1\tnil\t1.5 (esc)
+  2\trow2\t2.5 (esc)
+  3\trow3\t3.5 (esc)
+  10\trow10\t10.5 (esc)
+  <sql_result>
+  50
+
+Streamed result sets only have the current row
+
+  $ sysbench $SB_ARGS --db-result-mode=stream run
+  100\t5050 (esc)
+  nil
+  1\tnil\t1.5 (esc)
+  10\trow10\t10.5 (esc)
+  <sql_result>
+  50
+
+Duplicate keys are ignorable errors and roll back the current transaction
+
+  $ cat >$CRAMTMP/api_sql.lua <<EOF
+  > function sysbench.hooks.report_cumulative(stat)
+  >   print("ignored errors = " .. stat.errors)
+  > end
+  > function event()
+  >   local con = sysbench.sql.driver():connect()
+  >   con:query("CREATE TABLE IF NOT EXISTS t(a INT PRIMARY KEY)")
+  >   con:query("BEGIN")
+  >   con:query("INSERT INTO t VALUES (1)")
+  >   local ok, e = pcall(con.query, con, "INSERT INTO t VALUES (1)")
+  >   print(ok, e.sql_errno, e.sql_state, e.sql_errmsg)
+  >   print(con:query_row("SELECT COUNT(*) FROM t"))
+  >   con:query("DROP TABLE t")
+  > end
+  > EOF
+
+  $ sysbench $SB_ARGS run
+  false\t1555\tHY000\tUNIQUE constraint failed: t.a (esc)
+  0
+  ignored errors = 1
+
+  $ sysbench $SB_ARGS --sqlite-pragma=journal_mode=WAL,synchronous=OFF run
+  false\t1555\tHY000\tUNIQUE constraint failed: t.a (esc)
+  0
+  ignored errors = 1
+
+  $ sysbench $SB_ARGS --sqlite-pragma='journal_mode WAL' run 2>&1 | grep -m 1 FATAL
+  FATAL: PRAGMA journal_mode WAL failed: near "WAL": syntax error
+
+  $ sysbench $SB_ARGS --sqlite-db=/nonexisting/sbtest.db run 2>&1 | grep -m 1 FATAL
+  FATAL: Cannot open SQLite database '/nonexisting/sbtest.db': unable to open database file
+
+  $ sysbench $SB_ARGS --sqlite-busy-timeout=-1 run 2>&1 | grep -m 1 FATAL
+  FATAL: Invalid value for sqlite-busy-timeout: -1
+
+Typed parameter setters
+
+  $ cat >$CRAMTMP/api_sql_param.lua <<EOF
+  > function event()
+  >   local t = sysbench.sql.type
+  >   local con = sysbench.sql.driver():connect()
+  >   con:query("CREATE TABLE t(a INT, b VARCHAR(10), c DOUBLE)")
+  >   local stmt = con:prepare("INSERT INTO t VALUES(?, ?, ?)")
+  >   local a = stmt:bind_create(t.INT)
+  >   local b = stmt:bind_create(t.VARCHAR, 10)
+  >   local c = stmt:bind_create(t.DOUBLE)
+  >   stmt:bind_param(a, b, c)
+  >   a:set_int(1)
+  >   b:set_str("abc")
+  >   c:set_double(0.5)
+  >   stmt:execute()
+  >   a:set_rand_int(5, 5)
+  >   b:set_str_from_template("##-@@")
+  >   c:set(nil)
+  >   stmt:execute()
+  >   a:set_rand_int(7, 7, sysbench.rand.uniform)
+  >   b:set(nil)
+  >   c:set(1.5)
+  >   stmt:execute()
+  >   local rs = con:query("SELECT a, b, c, length(b) FROM t ORDER BY a")
+  >   for i = 1, rs.nrows do
+  >     print(unpack(rs:fetch_row(), 1, rs.nfields))
+  >   end
+  >   print(pcall(b.set_str_from_template, b, "###########"))
+  >   print(b.set_int, a.set_str)
+  >   con:query("DROP TABLE t")
+  > end
+  > EOF
+
+  $ sysbench $CRAMTMP/api_sql_param.lua $DB_DRIVER_ARGS --verbosity=1 \
+  >   --events=1 run | sed -E 's/^5\t[0-9]{2}-[a-z]{2}\t/5\tNN-xx\t/'
+  1\tabc\t0.5\t3 (esc)
+  5\tNN-xx\tnil\t5 (esc)
+  7\tnil\t1.5\tnil (esc)
+  false\ttemplate is longer than the parameter (11 > 10) (esc)
+  nil\tnil (esc)
+
+Batches of parameter sets
+
+  $ cat >$CRAMTMP/api_sql_batch.lua <<EOF
+  > function event()
+  >   local t = sysbench.sql.type
+  >   local con = sysbench.sql.driver():connect()
+  >   con:query("CREATE TABLE t(a INT PRIMARY KEY, b VARCHAR(10), c DOUBLE)")
+  >   local stmt = con:prepare("INSERT INTO t VALUES (?, ?, ?)")
+  >   local a = stmt:bind_create(t.BIGINT)
+  >   local b = stmt:bind_create(t.VARCHAR, 10)
+  >   local c = stmt:bind_create(t.DOUBLE)
+  >   stmt:bind_param(a, b, c)
+  >   stmt:execute_batch()
+  >   for i = 1, 100 do
+  >     a:set(i)
+  >     if i % 10 == 0 then b:set(nil) else b:set("row" .. i) end
+  >     c:set(i + 0.5)
+  >     stmt:add_batch()
+  >   end
+  >   stmt:execute_batch()
+  >   print(con:query_row("SELECT COUNT(*), SUM(a), COUNT(b), SUM(c) FROM t"))
+  >   print(con:query_row("SELECT a, b, c FROM t WHERE a = 42"))
+  >   -- The batch is empty after execution
+  >   stmt:execute_batch()
+  >   print(con:query_row("SELECT COUNT(*) FROM t"))
+  >   -- Rows after a failed one are not executed
+  >   for i = 101, 103 do
+  >     a:set(i == 102 and 1 or i)
+  >     stmt:add_batch()
+  >   end
+  >   local ok, err = pcall(stmt.execute_batch, stmt)
+  >   print(ok, err.sql_errmsg)
+  >   print(con:query_row("SELECT COUNT(*) FROM t"))
+  >   con:query("DROP TABLE t")
+  >   local sel = con:prepare("SELECT 1")
+  >   print(pcall(sel.add_batch, sel))
+  > end
+  > EOF
+
+  $ sysbench $CRAMTMP/api_sql_batch.lua $DB_DRIVER_ARGS --verbosity=1 \
+  >   --events=1 run
+  100\t5050\t90\t5100.0 (esc)
+  42\trow42\t42.5 (esc)
+  100
+  false\tUNIQUE constraint failed: t.a (esc)
+  101
+  ALERT: attempt to add a batch row to a statement without bound parameters
+  false\tdb_batch_add() failed (esc)
@@ -0,0 +1,53 @@
+########################################################################
+Tests for user counters and named histograms
+########################################################################
+
+  $ sysbench <<EOF
+  >   print(pcall(sysbench.counter.new, ""))
+  >   print(pcall(sysbench.histogram.named, 1))
+  >   local a = sysbench.counter.new("a")
+  >   print(a, a.id, sysbench.counter.new("b").id, sysbench.counter.new("a").id)
+  >   for i = 1, 40 do
+  >     local ok, err = pcall(sysbench.counter.new, "c" .. i)
+  >     if not ok then print(i, err) break end
+  >   end
+  > EOF
+  sysbench * (glob)
+  
+  false\tcounter name must be a non-empty string (esc)
+  false\thistogram name must be a non-empty string (esc)
+  <sb_counter a>\t0\t1\t0 (esc)
+  31\ttoo many counters (esc)
+
+Counters and histograms registered by all threads are aggregated in reports
+
+  $ cat > $CRAMTMP/user.lua <<EOF
+  > local hits = sysbench.counter.new("hits")
+  > local bytes = sysbench.counter.new("bytes")
+  > local checkout = sysbench.histogram.named("checkout")
+  > function event()
+  >   hits:add()
+  >   bytes:add(10)
+  >   checkout:update(50)
+  > end
+  > function sysbench.hooks.report_cumulative(stat)
+  >   print(stat.counters.hits, stat.counters.bytes,
+  >         string.format("%.1f",
+  >           stat.histograms.checkout["95.00th percentile"] * 1000))
+  > end
+  > EOF
+
+  $ sysbench $CRAMTMP/user.lua --threads=4 --events=1000 run | tail -1
+  1000\t10000\t50.* (esc) (glob)
+
+  $ sed -i -e '/report_cumulative/,$d' $CRAMTMP/user.lua
+  $ sysbench $CRAMTMP/user.lua --threads=4 --events=1000 run |
+  >   sed -n '/^Counters/,/^Threads/p'
+  Counters:
+      hits:                                1000   (*.* per sec.) (glob)
+      bytes:                               10000  (*.* per sec.) (glob)
+  
+  Histogram checkout (ms):
+           95.00th percentile:                    50.* (glob)
+  
+  Threads fairness:
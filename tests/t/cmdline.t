@@ -413,6 +413,51 @@ Command line options tests
   Unknown command: cmd3
   [1]
 
+# sysbench.barrier() in parallel commands
+  $ cat >barrier.lua <<EOF
+  > ffi.cdef("unsigned int sleep(unsigned int);")
+  > function cmd_func()
+  >   if sysbench.tid == 0 then
+  >     ffi.C.sleep(1)
+  >     print("before barrier")
+  >   end
+  >   sysbench.barrier()
+  >   print("after barrier")
+  > end
+  > function fail_func()
+  >   if sysbench.tid == 1 then
+  >     error("thread 1 failed")
+  >   end
+  >   sysbench.barrier()
+  >   print("thread 0 done")
+  > end
+  > sysbench.cmdline.commands = {
+  >  cmd = { cmd_func, sysbench.cmdline.PARALLEL_COMMAND },
+  >  fail = { fail_func, sysbench.cmdline.PARALLEL_COMMAND }
+  > }
+  > EOF
+  $ sysbench --threads=3 barrier.lua cmd
+  sysbench * (glob)
+  
+  Initializing worker threads...
+  
+  before barrier
+  after barrier
+  after barrier
+  after barrier
+  $ sysbench barrier.lua cmd
+  sysbench * (glob)
+  
+  before barrier
+  after barrier
+  $ sysbench --threads=2 barrier.lua fail
+  sysbench * (glob)
+  
+  Initializing worker threads...
+  
+  FATAL: `sysbench.cmdline.call_command' function failed: barrier.lua:12: thread 1 failed
+  thread 0 done
+
   $ cat >cmdline.lua <<EOF
   > sysbench.cmdline.options = { opt1 = {"opt1"}, opt2 = {"opt2"} }
   > function print_cmd()
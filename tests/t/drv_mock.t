@@ -0,0 +1,139 @@
+########################################################################
+Mock driver tests
+########################################################################
+
+  $ DB_DRIVER_ARGS="--db-driver=mock --mock-latency=0"
+  $ . $SBTEST_INCDIR/drv_common.sh
+  sysbench *.* * (glob)
+  
+  Running the test with following options:
+  Number of threads: 2
+  Initializing random number generator from current time
+  
+  
+  Initializing worker threads...
+  
+  Threads started!
+  
+  SQL statistics:
+      queries performed:
+          read:                            10
+          write:                           0
+          other:                           0
+          total:                           10
+      transactions:                        10     (* per sec.) (glob)
+      queries:                             10     (* per sec.) (glob)
+      ignored errors:                      0      (* per sec.) (glob)
+      reconnects:                          0      (* per sec.) (glob)
+  
+  Throughput:
+      events/s (eps): *.* (glob)
+      time elapsed:                        *s (glob)
+      total number of events:              10
+  
+  Latency (ms):
+           min:                                    *.* (glob)
+           avg:                                    *.* (glob)
+           max:                                    *.* (glob)
+           95.00th percentile:                     *.* (glob)
+  
+           sum:                                    *.* (glob)
+  
+  Threads fairness:
+      events (avg/stddev):           *.*/*.* (glob)
+      execution time (avg/stddev):   *.*/*.* (glob)
+  
+  $ sysbench --db-driver=mock --mock-latency-dist=foo test.lua --events=1 \
+  >   run | grep 'FATAL: Invalid'
+  FATAL: Invalid value for --mock-latency-dist: 'foo'
+  $ sysbench --db-driver=mock --mock-latency=-1 test.lua --events=1 run |
+  >   grep 'FATAL: Invalid'
+  FATAL: Invalid value for --mock-latency: -1
+  $ sysbench --db-driver=mock --mock-wait=foo test.lua --events=1 run |
+  >   grep 'FATAL: Invalid'
+  FATAL: Invalid value for --mock-wait: 'foo'
+  $ sysbench --db-driver=mock --mock-latency-dist=histogram test.lua \
+  >   --events=1 run | grep 'FATAL: --mock'
+  FATAL: --mock-latency-dist=histogram requires --mock-latency-file
+  $ echo none > $CRAMTMP/empty.txt
+  $ sysbench --db-driver=mock --mock-latency-dist=histogram \
+  >   --mock-latency-file=$CRAMTMP/empty.txt test.lua --events=1 run |
+  >   grep 'FATAL: No'
+  FATAL: No latencies found in --mock-latency-file '*/empty.txt' (glob)
+
+Synthetic results and query counters
+
+  $ cat >$CRAMTMP/mock.lua <<EOF
+  > function thread_init()
+  >   con = sysbench.sql.driver():connect()
+  > end
+  > function vuser_init(thread_id, vu)
+  >   vu.con = sysbench.sql.driver():connect()
+  > end
+  > function event(thread_id, vu)
+  >   local c = vu ~= nil and vu.con or con
+  >   local rs = c:query("SELECT 1")
+  >   if thread_id == 0 and not printed then
+  >     printed = true
+  >     print(rs.nrows, rs.nfields)
+  >     local row = rs:fetch_row()
+  >     print(row[1], row[3])
+  >   end
+  >   c:query("UPDATE t SET c = 1")
+  >   c:query("BEGIN")
+  > end
+  > EOF
+  $ sysbench --db-driver=mock --mock-latency=0 --mock-rows=2 \
+  >   --mock-columns=3 --mock-value-size=4 $CRAMTMP/mock.lua --events=10 run |
+  >   sed -n -e '/^[0-9]/p' -e '/read:/,/total:/p'
+  2\t3 (esc)
+  1111\t1111 (esc)
+          read:                            10
+          write:                           10
+          other:                           10
+          total:                           30
+
+Fixed latencies
+
+  $ sysbench --db-driver=mock --mock-latency=20 $CRAMTMP/mock.lua \
+  >   --events=5 run | awk '/ min:/ { print ($2 >= 60 && $2 < 80) }'
+  1
+  $ sysbench --db-driver=mock --mock-latency=20 --mock-wait=spin \
+  >   $CRAMTMP/mock.lua --events=5 run |
+  >   awk '/ min:/ { print ($2 >= 60 && $2 < 80) }'
+  1
+
+Asynchronous queries of virtual users wait concurrently
+
+  $ sysbench --db-driver=mock --mock-latency=20 $CRAMTMP/mock.lua \
+  >   --virtual-users=10 --time=1 run |
+  >   awk '/total number of events/ { print ($5 > 100 && $5 <= 170) }
+  >        / avg:/ { print ($2 >= 60 && $2 < 80) }'
+  1
+  1
+
+Latencies from a histogram, e.g. --histogram output
+
+  $ cat >$CRAMTMP/hist.txt <<EOF
+  > Latency histogram (values are in milliseconds)
+  >        value  ------------- distribution ------------- count
+  >       10.000 |****************************************  3
+  >       30.000 |*                                         0
+  >       50.000 |**************                            1
+  > EOF
+  $ sysbench --db-driver=mock --mock-latency-dist=histogram \
+  >   --mock-latency-file=$CRAMTMP/hist.txt test.lua --events=200 --threads=4 run |
+  >   awk '/ min:/ { print ($2 >= 10 && $2 < 15) }
+  >        / max:/ { print ($2 >= 50 && $2 < 80) }
+  >        / avg:/ { print ($2 >= 15 && $2 < 25) }'
+  1
+  1
+  1
+
+Lognormal latencies with a median of 10 ms
+
+  $ sysbench --db-driver=mock --mock-latency-dist=lognormal --mock-latency=10 \
+  >   --mock-latency-sigma=0.5 test.lua --events=200 --threads=4 \
+  >   --percentile=50 run |
+  >   awk '/50.00th percentile/ { print ($3 >= 8 && $3 < 13) }'
+  1
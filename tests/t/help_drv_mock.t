@@ -0,0 +1,11 @@
+  $ sysbench --help | sed -n '/mock options:/,/^$/p'
+  mock options:
+    --mock-latency-dist=STRING distribution of query latencies {fixed, lognormal, histogram} [fixed]
+    --mock-latency=N           latency in milliseconds with 'fixed', median latency with 'lognormal' [1]
+    --mock-latency-sigma=N     shape (standard deviation of the logarithm) of 'lognormal' latencies [0.5]
+    --mock-latency-file=STRING file with the 'histogram' latency distribution, one '<latency in ms> <count>' pair per line. The first and last numbers of each line are used, so the --histogram table can be used as is
+    --mock-wait=STRING         how synchronous queries wait {sleep, spin}. Asynchronous queries always wait on a timerfd [sleep]
+    --mock-rows=N              number of rows returned by SELECT queries [1]
+    --mock-columns=N           number of columns returned by SELECT queries [1]
+    --mock-value-size=N        length of synthetic column values [1]
+  
@@ -10,19 +10,31 @@ Skip test if the MySQL driver is not available.
 
   $ sysbench --help | sed -n '/mysql options:/,/^$/p'
   mysql options:
-    --mysql-host=[LIST,...]          MySQL server host [localhost]
-    --mysql-port=[LIST,...]          MySQL server port [3306]
-    --mysql-socket=[LIST,...]        MySQL socket
-    --mysql-user=STRING              MySQL user [sbtest]
-    --mysql-password=STRING          MySQL password []
-    --mysql-db=STRING                MySQL database name [sbtest]
+    --mysql-host=[LIST,...]                   MySQL server host [localhost]
+    --mysql-port=[LIST,...]                   MySQL server port [3306]
+    --mysql-socket=[LIST,...]                 MySQL socket
+    --mysql-host-policy=STRING                how to choose a host/port (or socket) for new connections {round-robin, weighted, least-connections, latency, sticky} [round-robin]
+    --mysql-host-weights=[LIST,...]           relative weights of hosts (or sockets) for --mysql-host-policy=weighted, in the same order
+    --mysql-replica-host=[LIST,...]           read replica hosts. If specified, queries returning result sets, except locking reads, are sent to a replica chosen with --mysql-host-policy, all other queries go to --mysql-host
+    --mysql-replica-weights=[LIST,...]        relative weights of replica hosts for --mysql-host-policy=weighted
+    --mysql-reconnect-policy=STRING           server to reconnect to after a lost connection {same, next}. 'next' tries the other hosts/ports (or sockets) of the same list in turn, starting after the lost one, with a 1 second connect timeout, to follow a failover quickly [same]
+    --mysql-bind-address=[LIST,...]           local IP addresses to bind client sockets to, used by new connections in turn. Multiple addresses raise the limit of ephemeral ports for large numbers of connections
+    --mysql-user=STRING                       MySQL user [sbtest]
+    --mysql-password=STRING                   MySQL password []
+    --mysql-db=STRING                         MySQL database name [sbtest]
     --mysql-ssl* (glob)
-    --mysql-ssl-key=STRING           path name of the client private key file
-    --mysql-ssl-ca=STRING            path name of the CA file
-    --mysql-ssl-cert=STRING          path name of the client public key certificate file
-    --mysql-ssl-cipher=STRING        use specific cipher for SSL connections []
-    --mysql-compression[=on|off]     use compression, if available in the client library [off]
-    --mysql-debug[=on|off]           trace all client library calls [off]
-    --mysql-ignore-errors=[LIST,...] list of errors to ignore, or "all" [1213,1020,1205]
-    --mysql-dry-run[=on|off]         Dry run, pretend that all MySQL client API calls are successful without executing them [off]
+    --mysql-ssl-key=STRING                    path name of the client private key file
+    --mysql-ssl-ca=STRING                     path name of the CA file
+    --mysql-ssl-cert=STRING                   path name of the client public key certificate file
+    --mysql-ssl-cipher=STRING                 use specific cipher for SSL connections []
+    --mysql-ssl-session-reuse[=on|off]        resume the TLS session of the previous connection made by the same thread instead of a full TLS handshake [off]
+    --mysql-compression[=on|off]              use compression, if available in the client library [off]
+    --mysql-compression-algorithms=[LIST,...] list of protocol compression algorithms to offer the server in order of preference {zlib, zstd, uncompressed}. Requires MySQL client library 8.0.18 or later []
+    --mysql-zstd-compression-level=N          compression level of the zstd algorithm, from 1 to 22 [3]
+    --mysql-net-stats[=on|off]                report bytes sent to and received from servers over TCP connections, i.e. after compression, in intermediate and cumulative reports (Linux only) [off]
+    --mysql-debug[=on|off]                    trace all client library calls [off]
+    --mysql-ignore-errors=[LIST,...]          list of errors to ignore, or "all" [1213,1020,1205]
+    --mysql-dry-run[=on|off]                  Dry run, pretend that all MySQL client API calls are successful without executing them [off]
+    --mysql-pipeline[=on|off]                 Send statement groups as a single multi-statement query in one round trip [off]
+    --mysql-session-reset=STRING              command used to reset session state on an existing connection {reset-connection, change-user} [reset-connection]
   
@@ -7,9 +7,15 @@ Skip test if the PostgreSQL driver is not available.
 
   $ sysbench --help | sed -n '/pgsql options:/,/^$/p'
   pgsql options:
-    --pgsql-host=STRING     PostgreSQL server host [localhost]
-    --pgsql-port=N          PostgreSQL server port [5432]
-    --pgsql-user=STRING     PostgreSQL user [sbtest]
-    --pgsql-password=STRING PostgreSQL password []
-    --pgsql-db=STRING       PostgreSQL database name [sbtest]
+    --pgsql-host=[LIST,...]             PostgreSQL server host [localhost]
+    --pgsql-port=[LIST,...]             PostgreSQL server port [5432]
+    --pgsql-user=STRING                 PostgreSQL user [sbtest]
+    --pgsql-password=STRING             PostgreSQL password []
+    --pgsql-db=STRING                   PostgreSQL database name [sbtest]
+    --pgsql-pipeline[=on|off]           Use libpq pipeline mode to send statement groups in a single round trip [off]
+    --pgsql-target-session-attrs=STRING libpq target_session_attrs, e.g. read-write or standby. If specified, a connection falls back to the remaining hosts when its own host does not match
+    --pgsql-dry-run[=on|off]            Dry run, pretend that all libpq calls are successful without executing them, same as --db-dry-run [off]
+    --pgsql-binary-params[=on|off]      Send numeric and timestamp parameters of prepared statements in binary format rather than as text [off]
+    --pgsql-ps-mode=STRING              How prepared statements are executed unless --db-ps-mode=disable {named, unnamed, cache}. named prepares each statement under its own name, unnamed sends the query with parameters on each execution without preparing it (PQexecParams), cache shares named statements with the same query on a connection and keeps them after they are closed [named]
+    --pgsql-stmt-cache-size=N           Maximum number of statements per connection with --pgsql-ps-mode=cache. The least recently used closed statements are deallocated above it [256]
   
@@ -0,0 +1,13 @@
+Skip test if the SQLite driver is not available.
+
+  $ if [ -z "$SBTEST_HAS_SQLITE" ]
+  > then
+  >   exit 80
+  > fi
+
+  $ sysbench --help | sed -n '/sqlite options:/,/^$/p'
+  sqlite options:
+    --sqlite-db=STRING         SQLite database file name or URI [sbtest.db]
+    --sqlite-busy-timeout=N    Time in milliseconds to wait for locks held by other connections before failing with SQLITE_BUSY [10000]
+    --sqlite-pragma=[LIST,...] PRAGMA statements to execute on each new connection, e.g. journal_mode=WAL,synchronous=NORMAL []
+  
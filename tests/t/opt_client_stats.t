@@ -0,0 +1,16 @@
+########################################################################
+# --client-stats tests
+########################################################################
+
+  $ sysbench cpu --client-stats --events=100 --time=0 run | sed -n '/^Client resource usage:/,$p'
+  Client resource usage:
+      process CPU time:                    *s (*% of * CPU(s)) (glob)
+      worker threads startup time:         *s (glob)
+      thread time in Lua/test code:        *% (glob)
+      thread time in DB driver on CPU:     0.0%
+      thread time waiting (off CPU):       *% (glob)
+  
+
+  $ sysbench cpu --events=100 --time=0 run | grep -c 'Client resource usage'
+  0
+  [1]
@@ -0,0 +1,47 @@
+########################################################################
+# Controller/agent mode tests
+########################################################################
+
+  $ sysbench cpu --cluster-agents=1 run
+  FATAL: --cluster-agents requires --cluster-listen
+  [1]
+
+  $ sysbench cpu --cluster-listen=127.0.0.1:0 run
+  FATAL: --cluster-listen requires --cluster-agents
+  [1]
+
+  $ sysbench cpu --cluster-listen=127.0.0.1:0 --cluster-agents=1 \
+  >   --cluster-connect=127.0.0.1:1 run
+  FATAL: --cluster-listen and --cluster-connect are mutually exclusive
+  [1]
+
+Statistics from agents are merged into controller reports
+
+  $ PORT=$((20000 + $$ % 20000))
+  $ sysbench cpu --cluster-listen=127.0.0.1:$PORT --cluster-agents=2 \
+  >   --events=300 --time=0 --threads=2 run > controller.log &
+  $ for i in 1 2; do
+  >   sysbench cpu --cluster-connect=127.0.0.1:$PORT --events=100 --time=0 \
+  >     run > agent$i.log &
+  > done
+  $ wait
+  $ grep -E '(Agent #|total number of events|events \(avg)' controller.log
+  Agent #0 connected (1 threads)
+  Agent #1 connected (1 threads)
+      total number of events:              500
+      events (avg/stddev):           150.0000/* (glob)
+  $ grep -E '(Connected to|total number of events)' agent1.log
+  Connected to the cluster controller at 127.0.0.1:* (glob)
+      total number of events:              100
+
+Agents must use the same latency histogram range as the controller
+
+  $ PORT=$((20000 + ($$ + 1) % 20000))
+  $ sysbench cpu --cluster-listen=127.0.0.1:$PORT --cluster-agents=1 \
+  >   --events=100 --time=0 run > controller.log 2>&1 &
+  $ sysbench cpu --cluster-connect=127.0.0.1:$PORT --events=100 --time=0 \
+  >   --histogram-range=0.0001,10 run > agent.log 2>&1
+  [1]
+  $ wait
+  $ grep FATAL controller.log
+  FATAL: Agent #0 uses latency histogram settings different from the controller
@@ -0,0 +1,72 @@
+########################################################################
+Tests for --save-result and --compare-to
+########################################################################
+
+  $ sysbench --compare-tps-threshold=101 run
+  FATAL: Invalid value for --compare-tps-threshold: 101.000000
+  [1]
+
+  $ sysbench --compare-dist-threshold=2 run
+  FATAL: Invalid value for --compare-dist-threshold: 2.000000
+  [1]
+
+  $ sysbench --compare-to=nonexistent.json run
+  FATAL: Cannot open --compare-to 'nonexistent.json' errno = 2 (No such file or directory)
+  [1]
+
+  $ echo '{ "foo": 1 }' > invalid.json
+  $ sysbench --compare-to=invalid.json run
+  FATAL: 'invalid.json' is not a result saved by --save-result of this version of sysbench
+  [1]
+
+  $ sysbench cpu --cpu-max-prime=1000 --events=500 --time=0 \
+  >   --save-result=base.json run > /dev/null
+  $ grep -E '^  "(format|version|test|threads|events)"|"95.00"|"cpu_max_prime"' base.json
+    "format": "sysbench-result",
+    "version": 1,
+    "test": "cpu",
+    "threads": 1,
+    "events": 500,
+        "95.00": * (glob)
+      "cpu_max_prime": "1000",
+  $ grep -c '^    \[[0-9.e+-]*, [0-9]*\],*$' base.json
+  [1-9][0-9]* (re)
+
+Passwords are not saved
+
+  $ cat >secret.lua <<EOF
+  > sysbench.cmdline.options = { db_password = {"Password", ""} }
+  > function event() end
+  > EOF
+  $ sysbench secret.lua --db-password=secret --events=1 --time=0 \
+  >   --save-result=secret.json run > /dev/null
+  $ grep -c -e password -e "\"secret\"" secret.json
+  0
+  [1]
+
+With the checks disabled, only the differences are printed
+
+  $ sysbench cpu --cpu-max-prime=2000 --events=500 --time=0 \
+  >   --compare-to=base.json --compare-tps-threshold=0 \
+  >   --compare-latency-threshold=0 --compare-dist-threshold=0 run |
+  >   sed -n '/^Comparison/,$p'
+  Comparison to 'base.json' (*): (glob)
+                                         baseline        current     change
+      events/s (eps):              * (glob)
+      95.00th percentile (ms):     * (glob)
+      latency distribution:                       D+ = *, p = * (glob)
+      options changed from the baseline:
+          --cpu-max-prime: '1000' -> '2000'
+  
+
+A slower run exits with an error
+
+  $ sysbench cpu --cpu-max-prime=20000 --events=500 --time=0 \
+  >   --compare-to=base.json run | grep ALERT
+  ALERT: events/s dropped by * (--compare-tps-threshold=5) (glob)
+  ALERT: 95.00th percentile latency increased by * (--compare-latency-threshold=10) (glob)
+  ALERT: the latency distribution shifted towards higher latencies by D+ = * (--compare-dist-threshold=0.1) (glob)
+  ALERT: Regression against 'base.json' detected
+  $ sysbench cpu --cpu-max-prime=20000 --events=500 --time=0 \
+  >   --compare-to=base.json run > /dev/null
+  [1]
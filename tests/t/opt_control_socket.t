@@ -0,0 +1,79 @@
+########################################################################
+# --control-socket tests
+########################################################################
+
+  $ sysbench cpu --control-socket=$(printf '%0200d' 0) --time=1 run
+  FATAL: Invalid value for --control-socket: '0000*' (glob)
+  [1]
+
+  $ sysbench cpu --control-socket=/nonexistent/sock --time=1 run 2>&1 |
+  >   grep FATAL
+  FATAL: Cannot listen on --control-socket '/nonexistent/sock'* (glob)
+
+  $ cat > client.lua <<EOF
+  > ffi.cdef[[
+  > struct control_sockaddr { unsigned short family; char path[108]; };
+  > int socket(int, int, int);
+  > int connect(int, const struct control_sockaddr *, unsigned int);
+  > long write(int, const void *, size_t);
+  > long read(int, void *, size_t);
+  > int close(int);
+  > ]]
+  > sysbench.cmdline.options = {
+  >   socket = {"Control socket", "sock"},
+  >   cmds = {"Commands separated by semicolons", "status"}
+  > }
+  > function send()
+  >   local addr = ffi.new("struct control_sockaddr", 1) -- AF_UNIX
+  >   ffi.copy(addr.path, sysbench.opt.socket)
+  >   local fd = ffi.C.socket(1, 1, 0) -- SOCK_STREAM
+  >   assert(ffi.C.connect(fd, addr, ffi.sizeof(addr)) == 0)
+  >   local buf = ffi.new("char[256]")
+  >   for cmd in sysbench.opt.cmds:gmatch("[^;]+") do
+  >     ffi.C.write(fd, cmd .. "\n", #cmd + 1)
+  >     io.write((ffi.string(buf, ffi.C.read(fd, buf, 255)):gsub("time: [0-9.]+s ", "")))
+  >   end
+  >   ffi.C.close(fd)
+  > end
+  > sysbench.cmdline.commands = { send = { send } }
+  > EOF
+
+  $ sysbench cpu --cpu-max-prime=100 --threads=2 --rate=100 --time=60 \
+  >   --control-socket=sock run > run.log &
+  $ sleep 1
+  $ sysbench client.lua --cmds='status;rate 500;threads 1;pause;bogus;rate x;status 1;threads 3' send | grep -v '^sysbench\|^$'
+  OK rate: 100 threads: 2/2 paused: no
+  OK rate: 500 threads: 2/2 paused: no
+  OK rate: 500 threads: 1/2 paused: no
+  OK rate: 500 threads: 1/2 paused: yes
+  ERR unknown command 'bogus'
+  ERR 'rate' requires a numeric argument
+  ERR 'status' takes no arguments
+  ERR invalid number of threads: 3 (1 to 2)
+  $ sysbench client.lua --cmds='resume;checkpoint;stop' send | grep -v '^sysbench\|^$'
+  OK rate: 500 threads: 1/2 paused: no
+  OK rate: 500 threads: 1/2 paused: no
+  OK rate: 500 threads: 1/2 paused: no
+  $ wait
+  $ grep -E 'Control|Accepting' run.log | sed 's/^\[ [0-9]*s \] //'
+  Accepting control commands on sock
+  Control: target rate set to 500/sec
+  Control: active threads set to 1
+  Control: paused
+  Control: resumed
+  Control checkpoint report:
+  Control: stopping the test
+  $ grep -c 'events/s (eps)' run.log
+  2
+  $ test -e sock
+  [1]
+
+The rate can only be changed with --rate
+
+  $ sysbench cpu --cpu-max-prime=100 --time=60 --control-socket=sock run \
+  >   > /dev/null &
+  $ sleep 1
+  $ sysbench client.lua --cmds='rate 100;stop' send | grep -v '^sysbench\|^$'
+  ERR the rate can only be changed with --rate
+  OK rate: 0 threads: 1/1 paused: no
+  $ wait
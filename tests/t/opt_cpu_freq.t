@@ -0,0 +1,51 @@
+########################################################################
+--cpu-freq tests
+########################################################################
+
+A fake sysfs tree with the same frequency and throttle counters for all CPUs
+
+  $ P=$CRAMTMP/cpu
+  $ for c in $(seq 0 $(($(getconf _NPROCESSORS_CONF) - 1))); do
+  >   mkdir -p $P/cpu$c/cpufreq $P/cpu$c/thermal_throttle $P/cpu$c/topology
+  >   echo 2000000 > $P/cpu$c/cpufreq/scaling_cur_freq
+  >   echo 4000000 > $P/cpu$c/cpufreq/cpuinfo_max_freq
+  >   echo 5 > $P/cpu$c/thermal_throttle/core_throttle_count
+  >   echo 7 > $P/cpu$c/thermal_throttle/package_throttle_count
+  >   echo 0 > $P/cpu$c/topology/physical_package_id
+  > done
+
+  $ sysbench cpu --cpu-max-prime=1000 --time=2 --report-interval=1 \
+  >   --cpu-freq --cpu-freq-path=$P run > out.txt
+  $ grep -c '^\[ 1s \] cpufreq: 2000MHz (50% of max) min/max: 2000/2000MHz thermal throttling: 0/0$' out.txt
+  1
+  $ sed -n '/^CPU frequency:/,/^$/p' out.txt
+  CPU frequency:
+      average:                             2000 MHz (50.0% of max 4000 MHz)
+      min/max:                             2000/2000 MHz
+      swing of averages:                   0.0% (2000-2000 MHz)
+      thermal throttle events:             0 core, 0 package
+  
+  $ grep -c WARNING out.txt
+  0
+  [1]
+
+Throttle counters are optional
+
+  $ rm -rf $P/cpu*/thermal_throttle
+  $ sysbench cpu --cpu-max-prime=1000 --time=2 --report-interval=1 \
+  >   --cpu-freq --cpu-freq-path=$P run > out.txt
+  $ grep -c '^\[ 1s \] cpufreq: 2000MHz (50% of max) min/max: 2000/2000MHz$' out.txt
+  1
+  $ grep throttle out.txt
+      thermal throttle events:             N/A
+
+  $ sysbench --cpu-freq --cpu-freq-path=$CRAMTMP/nonexistent cpu --time=1 run |
+  >   grep -i freq
+  WARNING: Cannot read frequencies of CPUs worker threads run on from */nonexistent, CPU frequency is not reported (glob)
+
+Nothing is sampled by default
+
+  $ sysbench cpu --cpu-max-prime=1000 --time=1 --report-interval=1 run |
+  >   grep -c -i freq
+  0
+  [1]
@@ -0,0 +1,64 @@
+########################################################################
+# --db-connect-rate and --db-connect-concurrency tests
+########################################################################
+
+  $ if [ -n "$SBTEST_HAS_PGSQL" ]
+  > then
+  >   DRIVER=pgsql
+  > elif [ -n "$SBTEST_HAS_MYSQL" ]
+  > then
+  >   DRIVER=mysql
+  > elif [ -n "$SBTEST_HAS_SQLITE" ]
+  > then
+  >   DRIVER=sqlite
+  > else
+  >   exit 80
+  > fi
+
+  $ cat >$CRAMTMP/connect.lua <<EOF
+  > function thread_init()
+  >   con = sysbench.sql.driver():connect()
+  > end
+  > function event()
+  >   con:query("SELECT 1")
+  > end
+  > EOF
+
+  $ SB_ARGS="--db-driver=$DRIVER --db-dry-run --threads=10 --events=10 $CRAMTMP/connect.lua"
+
+Connects done in thread_init() are reported before threads start
+
+  $ sysbench $SB_ARGS --db-connect-stats --percentile=99 run |
+  >   sed -n '/^Connection ramp-up:/,/^$/p'
+  Connection ramp-up:
+      established connections:             10     (* per sec.) (glob)
+      failed attempts:                     0
+      ramp-up time:                        *s (glob)
+      connect time (ms):
+           99.00th percentile:                     *.* (glob)
+  
+
+No ramp-up report without --db-connect-stats
+
+  $ sysbench $SB_ARGS run | grep -c 'ramp-up'
+  0
+  [1]
+
+10 connects at 50 per second take at least 9 intervals of 20ms
+
+  $ sysbench $SB_ARGS --db-connect-stats --db-connect-rate=50 \
+  >   --db-connect-concurrency=2 run |
+  >   awk '/ramp-up time:/ { sub("s$", "", $3); print ($3 >= 0.18) }'
+  1
+
+  $ sysbench $SB_ARGS --threads=1 --db-connect-rate=-1 --verbosity=1 run
+  FATAL: Invalid value for db-connect-rate: -1
+  FATAL: `thread_init' function failed: */connect.lua:2: failed to initialize the DB driver (glob)
+  FATAL: Threads initialization failed!
+  [1]
+
+  $ sysbench $SB_ARGS --threads=1 --db-connect-concurrency=-1 --verbosity=1 run
+  FATAL: Invalid value for db-connect-concurrency: -1
+  FATAL: `thread_init' function failed: */connect.lua:2: failed to initialize the DB driver (glob)
+  FATAL: Threads initialization failed!
+  [1]
@@ -0,0 +1,77 @@
+########################################################################
+# --db-dry-run tests
+########################################################################
+
+  $ if [ -n "$SBTEST_HAS_PGSQL" ]
+  > then
+  >   DRIVER=pgsql
+  > elif [ -n "$SBTEST_HAS_MYSQL" ]
+  > then
+  >   DRIVER=mysql
+  > else
+  >   exit 80
+  > fi
+
+  $ cat >$CRAMTMP/dry_run.lua <<EOF
+  > function event()
+  >   local con = sysbench.sql.driver():connect()
+  >   local rs = con:query("SELECT a, b FROM t")
+  >   print(rs.nrows, rs.nfields)
+  >   for i = 1, rs.nrows do
+  >     print(unpack(rs:fetch_row(), 1, rs.nfields))
+  >   end
+  >   print(con:query_row("SELECT a FROM t"))
+  >   local stmt = con:prepare("SELECT ?")
+  >   rs = stmt:execute()
+  >   print(rs.nrows, rs.nfields)
+  >   stmt:close()
+  >   con:query("UPDATE t SET a = 1")
+  >   con:disconnect()
+  > end
+  > EOF
+
+  $ SB_ARGS="--db-driver=$DRIVER --events=1 --verbosity=1 $CRAMTMP/dry_run.lua"
+
+  $ sysbench $SB_ARGS --db-dry-run --db-dry-run-rows=3 --db-dry-run-columns=2 run
+  3\t2 (esc)
+  1\t1 (esc)
+  1\t1 (esc)
+  1\t1 (esc)
+  1\t1 (esc)
+  3\t2 (esc)
+
+  $ sysbench $SB_ARGS --db-dry-run --db-dry-run-rows=0 run
+  0\t1 (esc)
+  nil
+  0\t1 (esc)
+
+  $ sysbench $SB_ARGS --db-dry-run --db-dry-run-columns=0 run
+  FATAL: Invalid value for db-dry-run-columns: 0
+  FATAL: `thread_run' function failed: */dry_run.lua:2: failed to initialize the DB driver (glob)
+  [1]
+
+  $ sysbench ${SBTEST_SCRIPTDIR}/oltp_read_write.lua --db-driver=$DRIVER --db-dry-run --events=10 --threads=2 run | grep -E '(read|write|other|total):'
+          read:                            140
+          write:                           40
+          other:                           20
+          total:                           200
+
+  $ sysbench ${SBTEST_SCRIPTDIR}/oltp_point_select.lua --db-driver=$DRIVER --db-dry-run --db-dry-run-rows=2 --db-dry-run-columns=2 --db-status-query='SELECT name, value FROM status' --report-interval=1 --time=2 run | grep -m 1 'status:'
+  [ 1s ] status: 1/s: 0.00
+
+  $ sysbench ${SBTEST_SCRIPTDIR}/oltp_point_select.lua --db-driver=$DRIVER --db-dry-run --db-status-query='SELECT name, value FROM status' --report-interval=1 --time=2 run | grep 'status'
+  ALERT: --db-status-query must return (name, value) rows, disabling it
+
+  $ sysbench ${SBTEST_SCRIPTDIR}/oltp_point_select.lua --db-driver=$DRIVER --db-dry-run --db-status-query='SELECT name, value FROM status' --db-result-mode=discard run 2>&1 | grep -m 1 'status'
+  FATAL: --db-status-query cannot be used with --db-result-mode=discard
+
+  $ if [ -z "$SBTEST_HAS_PGSQL" ]
+  > then
+  >   exit 80
+  > fi
+
+  $ sysbench $SB_ARGS --db-driver=pgsql --pgsql-dry-run run
+  1\t1 (esc)
+  1
+  1
+  1\t1 (esc)
@@ -0,0 +1,64 @@
+########################################################################
+# --db-outage-stats tests
+########################################################################
+
+  $ . ${SBTEST_INCDIR}/sqlite_common.sh
+
+The 50th event stalls for 0.3 seconds, then fails 5 times before the
+outage is over
+
+  $ cat >$CRAMTMP/outage.lua <<EOF
+  > function thread_init()
+  >   con = sysbench.sql.driver():connect()
+  >   n = 0
+  > end
+  > function event()
+  >   n = n + 1
+  >   if n == 50 then
+  >     sysbench.sleep(0.3)
+  >   end
+  >   if n >= 50 and n < 55 then
+  >     sysbench.sleep(0.05)
+  >     error({errcode = sysbench.error.RESTART_EVENT, sql_errmsg = "fake"})
+  >   end
+  >   con:query("SELECT 1")
+  >   sysbench.sleep(0.01)
+  > end
+  > EOF
+
+  $ SB_ARGS="$DB_DRIVER_ARGS --threads=1 --db-outage-stats $CRAMTMP/outage.lua"
+
+  $ sysbench $SB_ARGS --db-outage-recovery-pct=0 run | grep db-outage
+  FATAL: Invalid value for db-outage-recovery-pct: 0, must be greater than 0 and not greater than 100
+  $ sysbench $SB_ARGS --db-outage-resolution=0 run | grep db-outage
+  FATAL: Invalid value for db-outage-resolution: 0
+
+  $ sysbench $SB_ARGS --time=2 run | sed -n '/outage:/,/^$/p'
+      outage:
+          failed attempts:                 5
+          first failure:                   *s (glob)
+          last failure:                    *s (glob)
+          pre-outage throughput:           * per sec. (glob)
+          outage start:                    *s (glob)
+          recovered to 90%:                *s (glob)
+          downtime:                        *s (glob)
+  
+
+Throughput has not recovered by the end of the run
+
+  $ sysbench $SB_ARGS --time=1 run | sed -n '/outage:/,/^$/p'
+      outage:
+          failed attempts:                 5
+          first failure:                   *s (glob)
+          last failure:                    *s (glob)
+          pre-outage throughput:           * per sec. (glob)
+          outage start:                    *s (glob)
+          recovered to 90%:                no
+  
+
+No failures
+
+  $ sysbench $SB_ARGS --events=40 run | sed -n '/outage:/,/^$/p'
+      outage:
+          failed attempts:                 0
+  
@@ -0,0 +1,70 @@
+########################################################################
+# --db-retry-* tests
+########################################################################
+
+  $ if [ -n "$SBTEST_HAS_PGSQL" ]
+  > then
+  >   DRIVER=pgsql
+  > elif [ -n "$SBTEST_HAS_MYSQL" ]
+  > then
+  >   DRIVER=mysql
+  > elif [ -n "$SBTEST_HAS_SQLITE" ]
+  > then
+  >   DRIVER=sqlite
+  > else
+  >   exit 80
+  > fi
+
+Every other attempt fails with an ignorable error, so each event is retried
+once
+
+  $ cat >$CRAMTMP/retry.lua <<EOF
+  > function thread_init()
+  >   con = sysbench.sql.driver():connect()
+  >   n = 0
+  > end
+  > function event()
+  >   n = n + 1
+  >   if n % 2 == 1 then
+  >     error({errcode = sysbench.error.RESTART_EVENT,
+  >            sql_errmsg = "fake deadlock"})
+  >   end
+  >   con:query("SELECT 1")
+  > end
+  > EOF
+
+  $ SB_ARGS="--db-driver=$DRIVER --db-dry-run --events=10 $CRAMTMP/retry.lua"
+
+  $ sysbench $SB_ARGS --db-retry-stats run | sed -n '/retries:/,/^$/p'
+      retries:
+          retried transactions:            10     (* per sec.) (glob)
+          retries:                         10     (* per sec.) (glob)
+          attempts per transaction:        2.00
+          first attempt latency (ms):
+           95.00th percentile:                     0.00
+          retried latency (ms):
+           95.00th percentile:                     *.* (glob)
+  
+
+  $ sysbench $SB_ARGS --db-retry-max=1 --verbosity=1 run
+  FATAL: `thread_run' function failed: event failed after 1 attempt(s) (--db-retry-max), last error: fake deadlock
+  [1]
+
+  $ sysbench $SB_ARGS --db-retry-max=2 --verbosity=1 run
+
+  $ sysbench $SB_ARGS --db-retry-backoff=1 --db-retry-stats run |
+  >   grep "attempts per transaction"
+          attempts per transaction:        2.00
+
+  $ sysbench $SB_ARGS --db-retry-max=-1 --verbosity=1 run
+  FATAL: Invalid value for db-retry-max: -1
+  FATAL: `thread_init' function failed: */retry.lua:2: failed to initialize the DB driver (glob)
+  FATAL: Threads initialization failed!
+  [1]
+
+  $ sysbench $SB_ARGS --db-retry-backoff=10 --db-retry-backoff-max=5 \
+  >   --verbosity=1 run
+  FATAL: Invalid value for db-retry-backoff-max: 5, must not be less than --db-retry-backoff
+  FATAL: `thread_init' function failed: */retry.lua:2: failed to initialize the DB driver (glob)
+  FATAL: Threads initialization failed!
+  [1]
@@ -0,0 +1,50 @@
+########################################################################
+# --db-tcp-*, --db-socket-* and --db-busy-poll tests
+########################################################################
+
+  $ if [ -n "$SBTEST_HAS_PGSQL" ]
+  > then
+  >   DRIVER=pgsql
+  > elif [ -n "$SBTEST_HAS_MYSQL" ]
+  > then
+  >   DRIVER=mysql
+  > elif [ -n "$SBTEST_HAS_SQLITE" ]
+  > then
+  >   DRIVER=sqlite
+  > else
+  >   exit 80
+  > fi
+
+  $ cat >$CRAMTMP/connect.lua <<EOF
+  > function thread_init()
+  >   con = sysbench.sql.driver():connect()
+  > end
+  > function event()
+  >   con:query("SELECT 1")
+  > end
+  > EOF
+
+  $ SB_ARGS="--db-driver=$DRIVER --db-dry-run --events=1 $CRAMTMP/connect.lua"
+
+  $ sysbench $SB_ARGS --db-busy-poll=-1 --verbosity=1 run
+  FATAL: Invalid value for db-busy-poll: -1
+  FATAL: `thread_init' function failed: */connect.lua:2: failed to initialize the DB driver (glob)
+  FATAL: Threads initialization failed!
+  [1]
+
+  $ sysbench $SB_ARGS --db-socket-rcvbuf=1G --verbosity=1 run
+  FATAL: Invalid value for db-socket-rcvbuf: 1073741824, must not exceed 512MiB
+  FATAL: `thread_init' function failed: */connect.lua:2: failed to initialize the DB driver (glob)
+  FATAL: Threads initialization failed!
+  [1]
+
+  $ sysbench $SB_ARGS --db-socket-sndbuf=1G --verbosity=1 run
+  FATAL: Invalid value for db-socket-sndbuf: 1073741824, must not exceed 512MiB
+  FATAL: `thread_init' function failed: */connect.lua:2: failed to initialize the DB driver (glob)
+  FATAL: Threads initialization failed!
+  [1]
+
+  $ sysbench $SB_ARGS --db-tcp-nodelay=off --db-tcp-quickack \
+  >   --db-socket-rcvbuf=1M --db-socket-sndbuf=1M --db-busy-poll=50 run |
+  >   grep 'total number of events'
+      total number of events:              1
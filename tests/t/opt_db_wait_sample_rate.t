@@ -0,0 +1,47 @@
+########################################################################
+# --db-wait-sample-rate tests
+########################################################################
+
+  $ . ${SBTEST_INCDIR}/sqlite_common.sh
+
+  $ cat >$CRAMTMP/waits.lua <<EOF
+  > function thread_init()
+  >   con = sysbench.sql.driver():connect()
+  > end
+  > function event()
+  >   con:query("SELECT 1")
+  > end
+  > EOF
+
+  $ SB_ARGS="$DB_DRIVER_ARGS --threads=1 $CRAMTMP/waits.lua"
+
+  $ sysbench $SB_ARGS --db-wait-sample-rate=2000 run | grep wait-sample-rate
+  FATAL: Invalid value for --db-wait-sample-rate: 2000. Must be between 0 and 1000
+
+SQLite has no default wait query
+
+  $ sysbench $SB_ARGS --db-wait-sample-rate=10 run | grep wait-sample-rate
+  FATAL: --db-wait-sample-rate requires --db-wait-query with the 'sqlite' driver
+
+Each sample has one waiting and one running session
+
+  $ WAIT_ARGS="--db-wait-sample-rate=20 --db-wait-query=\"SELECT 'lock/row' UNION ALL SELECT NULL\""
+
+  $ eval sysbench $SB_ARGS $WAIT_ARGS --time=1 run |
+  >   sed -n '/server waits:/,/^$/p'
+      server waits:
+          samples:                         * (glob)
+          avg active sessions:             2.00
+          lock/row:                        50.00%
+          CPU:                             50.00%
+  
+
+  $ cat >>$CRAMTMP/waits.lua <<EOF
+  > sysbench.hooks.report_cumulative = sysbench.report_json
+  > EOF
+
+  $ eval sysbench $SB_ARGS $WAIT_ARGS --time=1 run | grep -A3 '"waits"'
+      "waits": {
+        "CPU": 1.00,
+        "lock/row": 1.00
+      }
@@ -0,0 +1,25 @@
+########################################################################
+# --duty-cycle tests
+########################################################################
+
+  $ sysbench cpu --duty-cycle=0 run
+  FATAL: Invalid value for --duty-cycle: 0.
+  [1]
+  $ sysbench cpu --duty-cycle=101 run
+  FATAL: Invalid value for --duty-cycle: 101.
+  [1]
+  $ sysbench cpu --duty-cycle=50 --duty-period=0 run
+  FATAL: Invalid value for --duty-period: 0.
+  [1]
+
+Threads only run events in the first 30% of each period
+
+  $ sysbench cpu --duty-cycle=30 --duty-period=10 --time=1 run |
+  >   grep -E '^Duty cycle'
+  Duty cycle: 30% of 10 ms
+
+Idle periods do not extend the test
+
+  $ sysbench cpu --duty-cycle=1 --duty-period=5000 --time=1 run |
+  >   grep 'time elapsed'
+      time elapsed:                        1.0*s (glob)
@@ -0,0 +1,40 @@
+########################################################################
+--energy tests
+########################################################################
+
+A fake powercap tree: a package domain with DRAM and core subdomains, the
+latter is skipped as it is included in the package one
+
+  $ P=$CRAMTMP/powercap
+  $ mkdir -p $P/intel-rapl:0 $P/intel-rapl:0:0 $P/intel-rapl:0:1
+  $ echo package-0 > $P/intel-rapl:0/name
+  $ echo dram > $P/intel-rapl:0:0/name
+  $ echo core > $P/intel-rapl:0:1/name
+  $ for z in 0 0:0 0:1; do
+  >   echo 1000000 > $P/intel-rapl:$z/energy_uj
+  >   echo 262143328850 > $P/intel-rapl:$z/max_energy_range_uj
+  > done
+
+  $ sysbench cpu --cpu-max-prime=1000 --time=2 --report-interval=1 \
+  >   --energy --energy-path=$P run > out.txt
+  $ grep -c '^\[ 1s \] energy: 0.00W (package-0: 0.00W dram: 0.00W) events/J: 0.00$' out.txt
+  1
+  $ sed -n '/^Energy (RAPL):/,/^$/p' out.txt
+  Energy (RAPL):
+      package-0:                           0.00 J (0.00 W)
+      dram:                                0.00 J (0.00 W)
+      total:                               0.00 J (0.00 W)
+      energy per event:                    N/A
+      events per joule:                    N/A
+  
+
+  $ sysbench --energy --energy-path=$CRAMTMP/nonexistent cpu --time=1 run |
+  >   grep -i -E 'energy|RAPL'
+  WARNING: No RAPL package or DRAM domains found in */nonexistent, energy is not reported (glob)
+
+Nothing is sampled by default
+
+  $ sysbench cpu --cpu-max-prime=1000 --time=1 --report-interval=1 run |
+  >   grep -c -i energy
+  0
+  [1]
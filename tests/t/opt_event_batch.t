@@ -0,0 +1,23 @@
+########################################################################
+# --event-batch tests
+########################################################################
+
+  $ sysbench cpu --event-batch=0 run
+  FATAL: Invalid value for --event-batch: 0.
+  
+  [1]
+
+  $ sysbench cpu --event-batch=16 --events=100 --threads=2 --time=0 run | grep -E '(batches|total number of events|events \(avg)'
+  Dispatching events in batches of 16
+      total number of events:              100
+      events (avg/stddev):           50.0000/* (glob)
+
+  $ sysbench memory --event-batch=1000 --memory-total-size=1M run | grep 'Total operations'
+  Total operations: 1024 (* per second) (glob)
+
+Only sampled batches are timed with --latency-sample-rate
+
+  $ sysbench cpu --cpu-max-prime=100 --event-batch=100 --latency-sample-rate=10 \
+  >   --time=1 run | awk '/^ +max:/ { print ($2 < 100) } /total number of events/ { print ($5 > 0) }'
+  1
+  1
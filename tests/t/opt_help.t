@@ -12,43 +12,144 @@ separately.
   Commands implemented by most tests: prepare run cleanup help
   
   General options:
-    --threads=N                     number of threads to use [1]
+    --threads=N                     number of threads to use. A comma-separated list of thread counts or 'sweep:MIN..MAX' (doubling from MIN up to MAX) runs the test at each concurrency level in turn [1]
+    --thread-groups=[LIST,...]      comma-separated list of worker thread groups running different scripts at different rates in one run, in the form THREADS[@RATE][:SCRIPT], e.g. 64@40000:oltp_point_select,8:oltp_write_only. Groups without SCRIPT run the main script or test, and those without RATE are not throttled. Latency and throughput are also reported per group. Replaces --threads []
     --events=N                      limit for total number of events [0]
     --time=N                        limit for total execution time in seconds [10]
+    --repeat=N                      run the test this many times in one process and report the mean, standard deviation and 95% confidence interval of throughput and latency percentiles across runs [1]
+    --cooldown=N                    seconds to sleep between runs with --repeat [0]
+    --scenario=STRING               file with a sequence of steps executed by the 'run' command in one process, one per line as COMMAND [--option=value ...], where COMMAND is prepare, warmup, run, cleanup or a custom command. Worker threads keep their Lua states and connections between steps
+    --save-result=STRING            save the cumulative statistics, the latency histogram and all options to this file in JSON for later comparisons with --compare-to
+    --compare-to=STRING             compare the cumulative statistics to a result saved with --save-result and exit with an error if any of the --compare-*-threshold values is exceeded
+    --compare-tps-threshold=N       maximum drop of events/s in percent allowed by --compare-to (0 - don't check) [5]
+    --compare-latency-threshold=N   maximum increase of each --percentile latency in percent allowed by --compare-to (0 - don't check) [10]
+    --compare-dist-threshold=N      maximum shift of the latency distribution towards higher latencies allowed by --compare-to, as the largest difference between the cumulative distribution functions (one-sided Kolmogorov-Smirnov statistic D+, 0..1), if it is also significant at the 1% level (0 - don't check) [0.1]
     --warmup-time=N                 execute events for this many seconds with statistics disabled before the actual benchmark run with statistics enabled [0]
+    --warmup-steady-state=N         after --warmup-time, continue the warmup until events/s over the last --warmup-window seconds stay within this percentage of their average, and their linear trend changes them by at most half of it (0 - don't wait for a steady state) [0]
+    --warmup-window=N               number of one-second throughput samples checked by --warmup-steady-state [5]
+    --warmup-max-time=N             maximum warmup time in seconds with --warmup-steady-state. The benchmark starts anyway with a warning when it is reached [600]
+    --stop-ci=N                     stop the benchmark before --time once the 95% confidence interval of mean events/s, estimated from one-second samples with the batch means method, is within this percentage of the mean (0 - run for --time) [0]
+    --stop-min-time=N               minimum benchmark time in seconds before stopping with --stop-ci [10]
     --forced-shutdown=STRING        number of seconds to wait after the --time limit before forcing shutdown, or 'off' to disable [off]
     --thread-stack-size=SIZE        size of stack per thread [64K]
+    --worker-memory[=on|off]        report memory used by each worker thread once all of them are initialized: Lua heap, thread stack and C heap, which is mostly database driver connections [off]
+    --lean-workers[=on|off]         reduce memory used by each worker thread to host more of them: strip debug info from Lua bytecode (error messages then have no line numbers), collect Lua garbage after thread_init() and use smaller database driver caches and buffers [off]
     --thread-init-timeout=N         wait time in seconds for worker threads to initialize [30]
+    --thread-affinity=STRING        bind worker threads to CPUs. Possible values: off, compact (fill one NUMA node first), scatter (round-robin across NUMA nodes), numa:LIST (NUMA nodes), cpus:LIST (CPUs), where LIST is a list of numbers or ranges like 0-3,8 [off]
+    --thread-sched=[LIST,...]       scheduling policy of worker threads: other[:NICE], batch[:NICE], idle, fifo:PRIORITY or rr:PRIORITY. A single value applies to all worker threads, a list to each --thread-groups group in turn, where '-' leaves a group unchanged. CPU time used by each group is reported []
+    --thread-cgroup=[LIST,...]      cgroup v2 threaded cgroup to place worker threads in, as NAME[:WEIGHT[:CPUS]], where WEIGHT sets cpu.weight and CPUS sets cpuset.cpus with ranges joined by '+', e.g. oltp:200:0-3+8. A single value applies to all worker threads, a list to each --thread-groups group in turn, where '-' leaves a group in place. CPU time used by each group is reported []
+    --thread-cgroup-root=STRING     directory to create --thread-cgroup cgroups in [default: the cgroup of sysbench]
+    --event-batch=N                 number of events to claim and time at once in built-in tests. Latency statistics are then sampled once per batch using the average event latency in the batch. Ignored with --rate [1]
+    --virtual-users=N               number of virtual users per worker thread in Lua scripts. Each one runs events in its own coroutine, and waits for queries executed with sql_connection:query() and for sysbench.sleep() without blocking other virtual users. Requires a driver supporting asynchronous queries to overlap queries [1]
+    --think-time=N                  mean think time in milliseconds between the end of an event and the start of the next one in each worker thread or virtual user. Cycle times, i.e. latencies plus think times, are then reported separately. 0 disables think time [0]
+    --think-time-type=STRING        distribution of think times: fixed, exponential or uniform (between 0 and twice the mean) [exponential]
+    --duty-cycle=N                  percentage of each --duty-period during which worker threads run events. They sleep for the rest of it, so e.g. --test=cpu --duty-cycle=30 keeps each thread's CPU 30% busy as background load. 100 disables it [100]
+    --duty-period=N                 length of a --duty-cycle period in milliseconds [100]
     --rate=N                        average transactions rate. 0 for unlimited rate [0]
-    --report-interval=N             periodically report intermediate statistics with a specified interval in seconds. 0 disables intermediate reports [0]
+    --rate-mode=STRING              how events are scheduled with --rate: 'generator' to queue all of them from a single event generation thread, 'worker' for each worker thread to schedule its own share of the rate. The latter scales to higher rates and has no polling delays [generator]
+    --rate-model=STRING             arrival process with --rate {poisson, constant, onoff, mmpp, schedule}: exponential intervals, evenly spaced events, bursts at --rate-burst-factor times the rate separated by silence, bursts alternating with periods at the rate divided by --rate-burst-factor, or per-second rates from --rate-schedule-file [poisson]
+    --rate-burst-factor=N           ratio of the event rate in bursts to --rate with --rate-model=onoff or mmpp [10]
+    --rate-burst-time=N             average duration of bursts in milliseconds with --rate-model=onoff or mmpp [100]
+    --rate-schedule-file=STRING     file with a rate for each second, one per line, for --rate-model=schedule. Replaces --rate, the schedule is repeated for longer runs
+    --rate-queue-size=N             capacity of the event queue with --rate-mode=generator, rounded up to a power of 2 [131072]
+    --rate-queue-full=STRING        what to do when the event queue is full with --rate-mode=generator: 'terminate' the test, 'drop' new events and count them, or 'grow' the queue by keeping new events in an overflow buffer until there is room [terminate]
+    --profile=[LIST,...]            comma-separated list of load phases changing the target rate and the number of active threads over the run, in the form TYPE[:RATES]/DURATION[@THREADS]. TYPE is hold, step or spike with a single rate, ramp with a linear change between two rates (e.g. ramp:0-5000/60s) or diurnal with a sine cycle between two rates. Phases without rates run at --rate. Replaces --time, and statistics are reported and reset at the end of each phase []
+    --slo-latency=N                 search for the highest --rate meeting a latency SLO of this many milliseconds at --slo-percentile without queue growth. Short probes at different rates run within a single test, starting at --rate. Replaces --time. 0 disables the search [0]
+    --slo-percentile=N              latency percentile checked by --slo-latency [99]
+    --slo-probe-time=N              duration of each --slo-latency probe in seconds [10]
+    --slo-precision=N               stop the --slo-latency search when the highest passing and the lowest failing rates are within this percentage [5]
+    --slo-max-probes=N              maximum number of --slo-latency probes [20]
+    --control-socket=STRING         listen for commands changing the running test on a Unix socket at this path, one per line: 'rate N' to set the target rate with --rate, 'threads N' to limit the number of active worker threads, 'pause', 'resume', 'checkpoint' to report and reset statistics, 'stop' to end the test, and 'status'
+    --metrics-listen=STRING         serve counters and the latency histogram in the Prometheus text format over HTTP at /metrics on this [HOST:]PORT
+    --latency-sample-rate=N         time only every Nth event in each thread for latency statistics. Event counters are still exact [1]
+    --latency-log=STRING            write the completion time, thread, type, latency and queueing time of every timed event to this binary file. Use --latency-log-csv to convert it
+    --latency-log-csv=STRING        convert the specified --latency-log file to CSV on the standard output and exit
+    --trace-sample-pct=N            percentage of events to trace. Each SQL statement of a traced event is prefixed with a W3C traceparent comment carrying the event trace ID and a statement span ID [0]
+    --trace-log=STRING              write the client-side timings of traced events and their statements to this file, one JSON object per line
+    --slow-event-threshold=N        write the statements with bound values, their latencies, servers and errors, and retries of every event taking at least this many milliseconds to --slow-event-log. 0 disables capturing [0]
+    --slow-event-log=STRING         file to write events slower than --slow-event-threshold to
+    --histogram-log=STRING          append the full latency histogram of every intermediate and checkpoint report to this file, one JSON object per line
+    --intended-latency[=on|off]     with --rate, also report latency measured from the intended (scheduled) start time of each event to its completion. Regular latency statistics then only include the event execution time [off]
+    --client-stats[=on|off]         report CPU usage of sysbench itself and the share of worker thread time spent in Lua/test code, in database driver calls and waiting off CPU [off]
+    --host-pressure[=on|off]        sample PSI stall time, cgroup CPU quota throttling and steal time of the host with each report and warn if sysbench was throttled or CPU time was stolen [off]
+    --energy[=on|off]               sample RAPL package and DRAM energy counters and report average power with each report, and energy per event and events per joule for the whole run [off]
+    --energy-path=STRING            powercap sysfs directory with RAPL domains for --energy [/sys/class/powercap]
+    --cpu-freq[=on|off]             sample frequency and thermal throttle events of CPUs worker threads run on and report them with each report and for the whole run, warn if CPUs were throttled or the frequency varied [off]
+    --cpu-freq-path=STRING          sysfs directory with CPU frequencies for --cpu-freq [/sys/devices/system/cpu]
+    --smt-compare[=on|off]          run worker threads on separate physical cores for the first half of --time and in pairs on SMT siblings of the same core for the second half, e.g. with the cpu or memory tests, and report per-thread throughput of both placements and the SMT yield. Requires an even number of threads [off]
+    --perf-counters[=on|off]        collect hardware performance counters (cycles, instructions, LLC, branch and dTLB misses) in worker threads with perf_event_open() and report them per event and per second [off]
+    --report-interval=STRING        periodically report intermediate statistics with a specified interval in seconds, which may be fractional or given in milliseconds with the 'ms' suffix, e.g. 0.5 or 100ms. 0 disables intermediate reports [0]
     --report-checkpoints=[LIST,...] dump full statistics and reset all counters at specified points in time. The argument is a list of comma-separated values representing the amount of time in seconds elapsed from start of test when report checkpoint(s) must be performed. Report checkpoints are off by default. []
+    --report-per-thread[=on|off]    report events, latency and errors of each worker thread in intermediate and cumulative reports, and mark threads executing less than half of the average number of events as stragglers [off]
+    --cluster-listen=STRING         run as a cluster controller accepting agent connections on the specified [host:]port. All nodes start the benchmark at the same time, the controller reports statistics merged from all nodes
+    --cluster-agents=N              number of agents the cluster controller waits for before starting the benchmark [0]
+    --cluster-connect=STRING        run as a cluster agent streaming statistics to the controller at the specified [host:]port
     --debug[=on|off]                print more debugging info [off]
     --validate[=on|off]             perform validation checks where possible [off]
     --help[=on|off]                 print help and exit [off]
     --version[=on|off]              print version and exit [off]
     --config-file=FILENAME          File containing command line options
     --luajit-cmd=STRING             perform LuaJIT control command. This option is equivalent to 'luajit -j'. See LuaJIT documentation for more information
+    --lua-profile[=on|off]          sample Lua functions of the first thread with the LuaJIT profiler and print the hottest ones at the end of the test [off]
+    --lua-trace-aborts[=on|off]     count LuaJIT trace aborts in all threads by location and reason and print them at the end of the test [off]
+    --native[=on|off]               execute events of the oltp_point_select, oltp_read_only and oltp_read_write scripts in C rather than Lua, with the same queries. Other commands are still implemented by the scripts [off]
   
   Pseudo-Random Numbers Generator options:
-    --rand-type=STRING   random numbers distribution {uniform, gaussian, special, pareto, zipfian} to use by default [special]
-    --rand-seed=N        seed for random number generator. When 0, the current time is used as an RNG seed. [0]
-    --rand-spec-iter=N   number of iterations for the special distribution [12]
-    --rand-spec-pct=N    percentage of the entire range where 'special' values will fall in the special distribution [1]
-    --rand-spec-res=N    percentage of 'special' values to use for the special distribution [75]
-    --rand-pareto-h=N    shape parameter for the Pareto distribution [0.2]
-    --rand-zipfian-exp=N shape parameter (exponent, theta) for the Zipfian distribution [0.8]
+    --rand-type=STRING           random numbers distribution {uniform, gaussian, special, pareto, zipfian, latest, empirical} to use by default [special]
+    --rand-seed=N                seed for random number generator. When 0, the current time is used as an RNG seed. [0]
+    --rand-spec-iter=N           number of iterations for the special distribution [12]
+    --rand-spec-pct=N            percentage of the entire range where 'special' values will fall in the special distribution [1]
+    --rand-spec-res=N            percentage of 'special' values to use for the special distribution [75]
+    --rand-pareto-h=N            shape parameter for the Pareto distribution [0.2]
+    --rand-zipfian-exp=N         shape parameter (exponent, theta) for the Zipfian distribution [0.8]
+    --rand-zipfian-table=N       maximum range size for which the Zipfian distribution is sampled from a precomputed table. Larger ranges are sampled with rejection-inversion. 0 disables the tables [4194304]
+    --rand-hotspot=STRING        how the hot values of the default random numbers distribution move over time {fixed, step, drift}. 'step' moves them to a new pseudo-random position every --rand-hotspot-period seconds, 'drift' shifts them continuously through the entire range once per --rand-hotspot-period seconds [fixed]
+    --rand-hotspot-period=N      period in seconds for --rand-hotspot [60]
+    --rand-empirical-file=STRING file with the key distribution for the empirical distribution. Each line is either 'key', 'key weight' or 'low high weight' for a range of keys. Keys are scaled to the requested range. Histograms in the format printed by sysbench can be used as is
   
   Log options:
-    --verbosity=N verbosity level {5 - debug, 0 - only critical messages} [3]
+    --verbosity=N        verbosity level {5 - debug, 0 - only critical messages} [3]
+    --log-async[=on|off] print messages of worker threads from a background thread instead of serializing workers on the output. Repeated messages are printed once per second along with the number of repetitions. Useful with --db-debug, --debug or frequent errors [off]
   
-    --percentile=[LIST,...] list of percentiles to calculate in latency statistics (0-100). Use an empty list to disable percentile calculations [95]
-    --histogram[=on|off]    print latency histogram in report [off]
+    --percentile=[LIST,...]      list of percentiles to calculate in latency statistics (0-100). Use an empty list to disable percentile calculations [95]
+    --histogram[=on|off]         print latency histogram in report [off]
+    --histogram-type=STRING      latency histogram implementation {log, hdr}. 'hdr' uses per-thread log-linear histograms which are cheaper to update and more precise for high percentiles [log]
+    --histogram-digits=N         number of significant decimal digits to maintain in 'hdr' latency histograms (1-5) [3]
+    --histogram-range=[LIST,...] range of latencies in milliseconds tracked by latency histograms as MIN,MAX. Lower and higher latencies are counted as MIN and MAX, respectively [0.001,100000]
+    --histogram-buckets=N        number of buckets in 'log' latency histograms, spaced evenly on a log scale over --histogram-range [1024]
   
   General database options:
   
-    --db-driver=STRING  specifies database driver to use \('help' to get list of available drivers\)( \[mysql\])? (re)
-    --db-ps-mode=STRING prepared statements usage mode {auto, disable} [auto]
-    --db-debug[=on|off] print database-specific debug information [off]
+    --db-driver=STRING          specifies database driver to use ('help' to get list of available drivers)
+    --db-ps-mode=STRING         prepared statements usage mode {auto, disable} [auto]
+    --db-result-mode=STRING     result set retrieval mode {store, stream, discard} [store]
+    --db-debug[=on|off]         print database-specific debug information [off]
+    --db-pool-size=N            maximum number of connections in the connection pool shared by all threads, 0 disables pooling [0]
+    --db-stmt-stats[=on|off]    report query counts and latency percentiles for each prepared statement, grouped by query text or label [off]
+    --db-connect-stats[=on|off] report the number of connects and session resets along with latency percentiles of connects, reconnects and resets, and a summary of connects done before threads start [off]
+    --db-connect-rate=N         maximum rate of connects and reconnects per second across all threads, 0 for unlimited. Paces the connection ramp-up in thread_init() instead of connecting all threads at once [0]
+    --db-connect-concurrency=N  maximum number of connects and reconnects in progress at the same time, 0 for unlimited [0]
+    --db-bulk-packet-size=SIZE  query length limit for bulk inserts. Must not exceed the server limit, e.g. max_allowed_packet for MySQL [512K]
+    --db-status-query=STRING    query returning (name, value) rows of server status counters, e.g. 'SHOW GLOBAL STATUS WHERE Variable_name IN (...)'. Executed on a dedicated connection with each intermediate report to print per-second rates of the counters []
+    --db-wait-sample-rate=N     sample wait events of active server sessions this many times per second on a dedicated connection and report the average number of active sessions and the share of each wait class with intermediate and cumulative reports [0]
+    --db-wait-query=STRING      query returning the wait class of each active session, or NULL if it is not waiting, for --db-wait-sample-rate. Defaults to a performance_schema query with MySQL and a pg_stat_activity query with PostgreSQL []
+    --db-retry-max=N            maximum number of attempts to execute an event that fails with an ignorable error such as a deadlock, 0 for unlimited [0]
+    --db-retry-backoff=N        delay in milliseconds before the first retry of a failed event. Doubled with each further attempt up to --db-retry-backoff-max, the actual delay is picked at random between 0 and that value. 0 retries immediately [0]
+    --db-retry-backoff-max=N    maximum delay in milliseconds between retries of a failed event [1000]
+    --db-retry-stats[=on|off]   report the number of attempts per transaction along with latency percentiles of transactions done on the first attempt and of retried ones [off]
+    --db-outage-stats[=on|off]  report the window in which events failed or stalled around the first failed event of the run, e.g. during an induced failover, and the time until throughput recovered to --db-outage-recovery-pct percent of its level before the outage [off]
+    --db-outage-recovery-pct=N  share of the throughput before an outage in percent at which --db-outage-stats considers it recovered [90]
+    --db-outage-resolution=N    interval in milliseconds between throughput samples of --db-outage-stats [100]
+    --db-latency-split[=on|off] report the time to the first result packet and the result transfer time of queries separately for reads, writes and other statements. Rows read by fetch calls in --db-result-mode=stream are not included [off]
+    --db-fetch-size=N           execute prepared statements returning result sets through server-side cursors fetching this many rows at a time, and report time to first row and row rates. Rows are read and dropped. 0 disables cursors [0]
+    --db-dry-run[=on|off]       dry run, pretend that all database calls are successful without calling the driver [off]
+    --db-dry-run-rows=N         number of rows in fake result sets of SELECT queries in dry run mode [1]
+    --db-dry-run-columns=N      number of columns in fake result sets of SELECT queries in dry run mode [1]
+    --db-tcp-nodelay[=on|off]   disable Nagle's algorithm on TCP connections (TCP_NODELAY) [on]
+    --db-tcp-quickack[=on|off]  disable delayed ACKs on TCP connections when they are established (TCP_QUICKACK) [off]
+    --db-socket-rcvbuf=SIZE     receive buffer size of connection sockets (SO_RCVBUF), 0 for the kernel default. Capped by net.core.rmem_max [0]
+    --db-socket-sndbuf=SIZE     send buffer size of connection sockets (SO_SNDBUF), 0 for the kernel default. Capped by net.core.wmem_max [0]
+    --db-busy-poll=N            time in microseconds to busy poll the device queue on blocking reads from connection sockets (SO_BUSY_POLL), 0 to disable [0]
   
   
     fileio - File I/O test
@@ -56,6 +157,17 @@ separately.
     memory - Memory functions speed test
     threads - Threads subsystem performance test
     mutex - Mutex performance test
+    atomic - Atomic operations contention test
+    c2c - Core-to-core cache line latency test
+    wakeup - Scheduler wakeup latency test
+    queue - Inter-thread queue test
+    malloc - Memory allocator test
+    syscall - System call overhead test
+    wal - Write-ahead log group commit test
+    metadata - Filesystem metadata operations test
+    net - Network request/response test
+    kv - In-memory key-value map test
+    clock - Clock source and timer overhead test
   
   See 'sysbench <testname> help' for a list of options for each test.
   
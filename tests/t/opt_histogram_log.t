@@ -0,0 +1,36 @@
+########################################################################
+# --histogram-log tests
+########################################################################
+
+  $ sysbench cpu --histogram-log=$CRAMTMP/nonexistent/hist.json run
+  FATAL: Cannot open --histogram-log '*/nonexistent/hist.json' errno = 2 (No such file or directory) (glob)
+  [1]
+
+The first line describes the histogram, the cumulative report is logged as a
+checkpoint with all events
+
+  $ sysbench cpu --cpu-max-prime=1000 --events=500 --time=0 \
+  >   --histogram-log=$CRAMTMP/hist.json run | grep 'Logging latency'
+  Logging latency histograms to */hist.json (glob)
+  $ head -1 $CRAMTMP/hist.json
+  {"format":"sysbench-histogram","version":1,"type":"log","size":1024,"range_min_ms":0.001,"range_max_ms":100000}
+  $ sed -n '2,$p' $CRAMTMP/hist.json | cut -d'[' -f1
+  {"report":"checkpoint","time":*,"interval":*,"events":500,"buckets":* (glob)
+
+Bucket counts add up to the number of events in each report
+
+  $ sysbench cpu --cpu-max-prime=1000 --time=3 --report-interval=1 \
+  >   --report-checkpoints=2 --histogram-type=hdr \
+  >   --histogram-log=$CRAMTMP/hist.json run > /dev/null
+  $ head -1 $CRAMTMP/hist.json
+  {"format":"sysbench-histogram","version":1,"type":"hdr","size":18432,"range_min_ms":0.001,"range_max_ms":100000}
+  $ sed -n '2,$p' $CRAMTMP/hist.json | grep -o '"report":"[a-z]*"' | sort -u
+  "report":"checkpoint"
+  "report":"interval"
+  $ sed -n '2,$p' $CRAMTMP/hist.json | awk '
+  >   { match($0, /"events":[0-9]+/); n = substr($0, RSTART + 9, RLENGTH - 9)
+  >     s = $0; sub(/.*"buckets":\[/, "", s); m = split(s, b, "]")
+  >     sum = 0; for (i = 1; i < m; i++) { sub(/.*,/, "", b[i]); sum += b[i] }
+  >     if (sum != n) bad++ }
+  >   END { print (NR >= 4), bad + 0 }'
+  1 0
@@ -0,0 +1,38 @@
+########################################################################
+# --histogram-range and --histogram-buckets tests
+########################################################################
+
+  $ sysbench --histogram-range=1 run
+  FATAL: Invalid value for --histogram-range, expected MIN,MAX with 0 < MIN < MAX
+  [1]
+
+  $ sysbench --histogram-range=10,1 run
+  FATAL: Invalid value for --histogram-range, expected MIN,MAX with 0 < MIN < MAX
+  [1]
+
+  $ sysbench --histogram-range=0,1 run
+  FATAL: Invalid value for --histogram-range, expected MIN,MAX with 0 < MIN < MAX
+  [1]
+
+  $ sysbench --histogram-buckets=1 run
+  FATAL: Invalid value for --histogram-buckets: 1
+  [1]
+
+Both histogram types use the range, 'log' histograms also the number of
+buckets
+
+  $ sysbench cpu --events=1 --time=0 --histogram-range=0.0001,10 \
+  >   --histogram-buckets=200 --histogram-log=$CRAMTMP/hist.json run > /dev/null
+  $ head -1 $CRAMTMP/hist.json
+  {"format":"sysbench-histogram","version":1,"type":"log","size":200,"range_min_ms":0.0001,"range_max_ms":10}
+
+  $ sysbench cpu --events=1 --time=0 --histogram-range=0.0001,10 \
+  >   --histogram-type=hdr --histogram-log=$CRAMTMP/hist.json run > /dev/null
+  $ head -1 $CRAMTMP/hist.json
+  {"format":"sysbench-histogram","version":1,"type":"hdr","size":8192,"range_min_ms":0.0001,"range_max_ms":10}
+
+Histogram values are printed with enough decimals for the lower bound
+
+  $ sysbench cpu --events=1 --time=0 --histogram --histogram-range=0.00001,1 \
+  >   run | sed -n '/^Latency histogram/{n;n;p;}'
+  \s+[0-9]+\.[0-9]{7} \|\*+ 1 (re)
@@ -0,0 +1,27 @@
+########################################################################
+--host-pressure tests
+########################################################################
+
+  $ if [ ! -r /proc/stat ]; then
+  >   exit 80
+  > fi
+
+  $ sysbench cpu --cpu-max-prime=1000 --time=2 --report-interval=1 \
+  >   --host-pressure run > out.txt
+  $ grep -c '^\[ 1s \] pressure:.* steal: ' out.txt
+  1
+  $ sed -n '/^Host pressure:/,/^$/p' out.txt | sed 's/:.*//'
+  Host pressure
+      cpu    stall time (PSI some)
+      memory stall time (PSI some)
+      io     stall time (PSI some)
+      cgroup throttled periods
+      CPU steal time
+  
+
+Nothing is sampled by default
+
+  $ sysbench cpu --cpu-max-prime=1000 --time=1 --report-interval=1 run |
+  >   grep -c -i pressure
+  0
+  [1]
@@ -0,0 +1,15 @@
+########################################################################
+# --intended-latency tests
+########################################################################
+
+  $ sysbench cpu --intended-latency --time=1 run
+  FATAL: --intended-latency requires --rate
+  [1]
+
+  $ sysbench cpu --rate=100 --intended-latency --time=2 --report-interval=1 run | grep -E '^(\[ 1s \] intended|Latency from|Queue wait|         95)'
+  [ 1s ] intended lat (ms,95.00%): *.* (glob)
+           95.00th percentile: *.* (glob)
+  Latency from intended start (ms):
+           95.00th percentile: *.* (glob)
+  Queue wait (ms):
+           95.00th percentile: *.* (glob)
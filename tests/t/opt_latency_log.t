@@ -0,0 +1,44 @@
+########################################################################
+# --latency-log tests
+########################################################################
+
+  $ sysbench cpu --latency-log=$CRAMTMP/nonexistent/lat.bin run
+  FATAL: Cannot open --latency-log '*/nonexistent/lat.bin' errno = 2 (No such file or directory) (glob)
+  [1]
+
+  $ sysbench --latency-log-csv=$CRAMTMP/nonexistent.bin
+  FATAL: Cannot open --latency-log-csv '*/nonexistent.bin' errno = 2 (No such file or directory) (glob)
+  [1]
+
+  $ echo garbage > $CRAMTMP/garbage.bin
+  $ sysbench --latency-log-csv=$CRAMTMP/garbage.bin
+  FATAL: '*/garbage.bin' is not a latency log written by this version of sysbench (glob)
+  [1]
+
+Every event of a built-in test is logged with the test's event type
+
+  $ sysbench cpu --cpu-max-prime=1000 --threads=2 --events=500 \
+  >   --latency-log=$CRAMTMP/lat.bin run | grep 'Logging event latencies'
+  Logging event latencies to */lat.bin (glob)
+
+  $ sysbench --latency-log-csv=$CRAMTMP/lat.bin > $CRAMTMP/lat.csv
+  $ head -1 $CRAMTMP/lat.csv
+  time,timestamp,thread,type,latency_ms,queue_ms
+  $ awk -F, 'NR > 1 { n++; if ($3 > 1 || $4 != 1 || $5 <= 0 || $6 != 0) bad++ }
+  >          END { print n, bad + 0 }' $CRAMTMP/lat.csv
+  500 0
+
+Scripts can set their own event types, and queueing time is logged with --rate
+
+  $ cat > $CRAMTMP/types.lua <<EOF
+  > function event()
+  >   ffi.C.sb_latency_log_set_type(sysbench.tid, 100 + sysbench.tid)
+  > end
+  > EOF
+
+  $ sysbench $CRAMTMP/types.lua --threads=2 --rate=200 --time=1 \
+  >   --latency-log=$CRAMTMP/lat.bin run > /dev/null
+  $ sysbench --latency-log-csv=$CRAMTMP/lat.bin |
+  >   awk -F, 'NR > 1 { if ($4 != 100 + $3) bad++; if ($6 > 0) queued++ }
+  >            END { print bad + 0, (queued > 0) }'
+  0 1
@@ -0,0 +1,13 @@
+########################################################################
+# --latency-sample-rate tests
+########################################################################
+
+  $ sysbench cpu --latency-sample-rate=0 run
+  FATAL: Invalid value for --latency-sample-rate: 0.
+  
+  [1]
+
+  $ sysbench cpu --latency-sample-rate=10 --events=100 --threads=2 --time=0 run | grep -E '(Timing|total number of events|events \(avg)'
+  Timing 1 of every 10 events for latency statistics
+      total number of events:              100
+      events (avg/stddev):           50.0000/* (glob)
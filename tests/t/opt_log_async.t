@@ -0,0 +1,34 @@
+########################################################################
+# --log-async tests
+########################################################################
+
+  $ cat >$CRAMTMP/log.lua <<EOF
+  > ffi.cdef[[void log_text(int priority, const char *fmt, ...);]]
+  > function event()
+  >   ffi.C.log_text(2, "error 1213") -- LOG_WARNING
+  > end
+  > EOF
+
+  $ SB_ARGS="--events=1000 --verbosity=3 $CRAMTMP/log.lua"
+
+Without --log-async, consecutive duplicates are collapsed
+
+  $ sysbench $SB_ARGS run | grep -E 'error 1213|repeated'
+  WARNING: error 1213
+  (last message repeated 999 times)
+
+With --log-async, repeated messages of worker threads are printed once with
+the number of repetitions in the aggregation window
+
+  $ sysbench $SB_ARGS --log-async run | grep -E 'error 1213|repeated'
+  WARNING: error 1213
+  WARNING: error 1213 (repeated 999 times in the last *s) (glob)
+
+  $ sysbench $SB_ARGS --threads=2 --log-async run |
+  >   awk '/repeated/ { n += $5 } /error 1213$/ { n++ } END { print n }'
+  1000
+
+Notices and fatal errors are not delayed
+
+  $ sysbench $SB_ARGS --log-async run | grep 'Threads started!'
+  Threads started!
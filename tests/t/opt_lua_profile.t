@@ -0,0 +1,33 @@
+########################################################################
+--lua-profile and --lua-trace-aborts tests
+########################################################################
+
+  $ cat >opt_lua_profile.lua <<EOF
+  > function hot(n)
+  >   local s = 0
+  >   for i = 1, n do s = s + math.sin(i) end
+  >   return s
+  > end
+  > function event()
+  >   hot(100000)
+  >   for i = 1, 100 do local f = function() end end
+  > end
+  > EOF
+
+  $ sysbench opt_lua_profile.lua --events=200 --threads=2 --lua-profile \
+  >   run | sed -n '/^Lua profile/,/^ *$/p' | grep -E '^Lua|:$|hot$'
+  Lua profile of thread 0 (* samples): (glob)
+      VM states:
+      functions:
+        *%  opt_lua_profile.lua:hot (glob)
+
+  $ sysbench opt_lua_profile.lua --events=200 --threads=2 \
+  >   --lua-trace-aborts run | grep -E '^LuaJIT|opt_lua_profile'
+  LuaJIT trace aborts (* in all threads): (glob)
+  * opt_lua_profile.lua:8: NYI: bytecode 51 (glob)
+
+Nothing is reported unless requested
+
+  $ sysbench opt_lua_profile.lua --events=10 run | grep -c -E '^(Lua|LuaJIT) '
+  0
+  [1]
@@ -0,0 +1,41 @@
+########################################################################
+# --metrics-listen tests
+########################################################################
+
+  $ if ! command -v curl > /dev/null
+  > then
+  >   exit 80
+  > fi
+
+  $ sysbench cpu --metrics-listen=nosuchhost.invalid:1 run 2>&1 | grep FATAL
+  FATAL: Invalid value for --metrics-listen: 'nosuchhost.invalid:1': * (glob)
+
+  $ port=$((20000 + $$ % 20000))
+  $ sysbench cpu --cpu-max-prime=1000 --threads=2 --time=3 \
+  >   --report-interval=1 --metrics-listen=127.0.0.1:$port run > run.log &
+  $ sleep 1.5
+  $ curl -s http://127.0.0.1:$port/metrics > metrics.txt
+  $ grep -E '^sysbench_(info\{|threads |latency_seconds_bucket\{le="\+Inf"\})' metrics.txt |
+  >   sed 's/} [0-9]*$/} N/'
+  sysbench_info{version="*",test="cpu"} N (glob)
+  sysbench_threads 2
+  sysbench_latency_seconds_bucket{le="+Inf"} N
+  $ grep -c '^# TYPE sysbench_.* counter$' metrics.txt
+  6
+  $ awk '/^sysbench_events_total/ { e = $2 }
+  >      /^sysbench_latency_seconds_count/ { c = $2 }
+  >      END { print (e > 0 && c > 0 && c <= e) }' metrics.txt
+  1
+  $ curl -s -o /dev/null -w '%{http_code}\n' http://127.0.0.1:$port/foo
+  404
+  $ curl -s -o /dev/null -w '%{http_code}\n' -X POST http://127.0.0.1:$port/
+  405
+  $ wait
+
+Scrapes do not affect intermediate or cumulative statistics
+
+  $ grep -E '^Serving metrics' run.log | sed "s/:$port/:PORT/"
+  Serving metrics on 127.0.0.1:PORT
+  $ grep -c '^\[ [12]s \] thds: 2 eps: [1-9]' run.log
+  2
+  $ rm -f run.log metrics.txt
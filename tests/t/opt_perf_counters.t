@@ -0,0 +1,18 @@
+########################################################################
+# --perf-counters tests
+########################################################################
+
+  $ if ! sysbench cpu --perf-counters --events=1 --time=0 run >/dev/null 2>&1
+  > then
+  >   exit 80
+  > fi
+
+  $ sysbench cpu --perf-counters --events=100 --time=0 run 2>/dev/null | sed -n '/^Hardware counters/,/^$/p' | grep -E '^(Hardware| +per|    (cycles|instructions|IPC):)'
+  Hardware counters*: (glob)
+                                 per event     per second
+      cycles: * (glob)
+      instructions: * (glob)
+      IPC: * (glob)
+
+  $ sysbench cpu --perf-counters --events=0 --time=2 --report-interval=1 run 2>/dev/null | grep -c '] perf: ipc: '
+  [12] (re)
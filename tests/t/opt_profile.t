@@ -0,0 +1,64 @@
+########################################################################
+# --profile tests
+########################################################################
+
+  $ sysbench cpu --profile=foo/1s run
+  FATAL: Invalid value for --profile: 'foo/1s'
+  [1]
+
+  $ sysbench cpu --profile=ramp:100/1s run
+  FATAL: Invalid value for --profile: 'ramp:100/1s'
+  [1]
+
+  $ sysbench cpu --threads=2 --profile=hold:100/1s@3 run
+  FATAL: Invalid value for --profile: 'hold:100/1s@3' uses more than --threads=2 threads
+  [1]
+
+  $ sysbench cpu --profile=hold:100/1s,hold/1s run
+  FATAL: Invalid value for --profile: 'hold/1s' has no rate and --rate is not set
+  [1]
+
+  $ sysbench cpu --profile=hold:100/1s --warmup-time=1 run
+  FATAL: --profile cannot be used with --warmup-time or --warmup-steady-state, use a separate phase instead
+  [1]
+
+Per-phase rates and active threads
+
+  $ for mode in generator worker; do
+  >   sysbench cpu --cpu-max-prime=100 --threads=2 --rate-mode=$mode \
+  >     --profile=ramp:0-1000/2s,hold:1000/1s@1,spike:3000/1s run |
+  >   awk 'BEGIN { rate[1] = 500; rate[2] = 1000; rate[3] = 3000 }
+  >        /Phase [0-9]/ { n++; sub(/^\[ [0-9]+s \] /, ""); print }
+  >        /events\/s/ { print ($3 > rate[n] * 0.8 && $3 < rate[n] * 1.2) }
+  >        /events \(avg/ { split($3, e, "/"); print "one thread:", (e[2] > e[1] * 0.9) }'
+  > done
+  Phase 1 (ramp:0-1000/2s) report:
+  1
+  one thread: 0
+  Phase 2 (hold:1000/1s@1) report:
+  1
+  one thread: 1
+  Phase 3 (spike:3000/1s) report:
+  1
+  one thread: 0
+  Phase 1 (ramp:0-1000/2s) report:
+  1
+  one thread: 0
+  Phase 2 (hold:1000/1s@1) report:
+  1
+  one thread: 1
+  Phase 3 (spike:3000/1s) report:
+  1
+  one thread: 0
+
+Unlimited rate, only the number of active threads changes
+
+  $ sysbench cpu --cpu-max-prime=100 --threads=2 --event-batch=10 \
+  >   --profile=hold/1s@1,step/1s run |
+  >   awk '/Target|Load|Phase [0-9]/ { sub(/^\[ [0-9]+s \] /, ""); print }
+  >        /events \(avg/ { split($3, e, "/"); print "one thread:", (e[2] > e[1] * 0.9) }'
+  Load profile: 2 phase(s), 2 seconds
+  Phase 1 (hold/1s@1) report:
+  one thread: 1
+  Phase 2 (step/1s) report:
+  one thread: 0
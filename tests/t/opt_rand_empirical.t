@@ -0,0 +1,75 @@
+########################################################################
+--rand-type=empirical tests
+########################################################################
+
+  $ SB_ARGS="--verbosity=0 --events=1 --rand-type=empirical"
+
+Print the share of values in each third of [1, 3] and [1, 300]
+
+  $ cat >$CRAMTMP/rand_empirical.lua <<EOF
+  > function event()
+  >   for _, r in ipairs({{1, 3}, {1, 300}}) do
+  >     local cnt = {0, 0, 0}
+  >     for i = 1, 100000 do
+  >       local v = sysbench.rand.default(r[1], r[2])
+  >       local b = math.floor((v - 1) / (r[2] / 3)) + 1
+  >       cnt[b] = cnt[b] + 1
+  >     end
+  >     for b = 1, 3 do
+  >       -- round to 1/40
+  >       cnt[b] = math.floor(cnt[b] / 1e5 * 40 + 0.5) / 40
+  >     end
+  >     print(string.format("%.3f %.3f %.3f", cnt[1], cnt[2], cnt[3]))
+  >   end
+  > end
+  > EOF
+
+  $ cat >$CRAMTMP/keys.txt <<EOF
+  > # key weight
+  > 1 1
+  > 2 0
+  > 3 3
+  > EOF
+  $ sysbench $SB_ARGS --rand-empirical-file=$CRAMTMP/keys.txt $CRAMTMP/rand_empirical.lua run
+  0.250 0.000 0.750
+  0.250 0.000 0.750
+
+A histogram printed by sysbench
+
+  $ cat >$CRAMTMP/histogram.txt <<EOF
+  >        value  ------------- distribution ------------- count
+  >        1.000 |*************                            10
+  >        3.000 |**************************************** 30
+  > EOF
+  $ sysbench $SB_ARGS --rand-empirical-file=$CRAMTMP/histogram.txt $CRAMTMP/rand_empirical.lua run
+  0.250 0.000 0.750
+  0.250 0.000 0.750
+
+Key ranges and a key trace
+
+  $ cat >$CRAMTMP/ranges.txt <<EOF
+  > 1 100 1
+  > 201 300 3
+  > EOF
+  $ sysbench $SB_ARGS --rand-empirical-file=$CRAMTMP/ranges.txt $CRAMTMP/rand_empirical.lua run
+  0.250 0.000 0.750
+  0.250 0.000 0.750
+  $ printf '3\n1\n3\n2\n3\n3\n1\n3\n' >$CRAMTMP/trace.txt
+  $ sysbench $SB_ARGS --rand-empirical-file=$CRAMTMP/trace.txt $CRAMTMP/rand_empirical.lua run
+  0.250 0.125 0.625
+  0.250 0.125 0.625
+
+  $ sysbench $SB_ARGS $CRAMTMP/rand_empirical.lua run
+  FATAL: --rand-type=empirical requires --rand-empirical-file
+  [1]
+  $ sysbench $SB_ARGS --rand-empirical-file=$CRAMTMP/nonexistent $CRAMTMP/rand_empirical.lua run
+  FATAL: Cannot open --rand-empirical-file '*/nonexistent' errno = 2 (No such file or directory) (glob)
+  [1]
+  $ echo "1 2 3 4" >$CRAMTMP/bad.txt
+  $ sysbench $SB_ARGS --rand-empirical-file=$CRAMTMP/bad.txt $CRAMTMP/rand_empirical.lua run
+  FATAL: */bad.txt:1: invalid empirical distribution line (glob)
+  [1]
+  $ echo "1 0" >$CRAMTMP/zero.txt
+  $ sysbench $SB_ARGS --rand-empirical-file=$CRAMTMP/zero.txt $CRAMTMP/rand_empirical.lua run
+  FATAL: No keys with non-zero weight in --rand-empirical-file '*/zero.txt' (glob)
+  [1]
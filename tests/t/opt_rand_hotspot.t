@@ -0,0 +1,47 @@
+########################################################################
+--rand-hotspot tests
+########################################################################
+
+  $ SB_ARGS="--verbosity=0 --events=1 --rand-type=zipfian --rand-zipfian-exp=3"
+
+Print the most frequent value in [1, 1000] now and after 1.1 seconds
+
+  $ cat >$CRAMTMP/rand_hotspot.lua <<EOF
+  > ffi.cdef[[int usleep(unsigned int);]]
+  > local function mode()
+  >   local cnt, best = {}, nil
+  >   for i = 1, 5000 do
+  >     local v = sysbench.rand.default(1, 1000)
+  >     cnt[v] = (cnt[v] or 0) + 1
+  >     if best == nil or cnt[v] > cnt[best] then best = v end
+  >   end
+  >   return best
+  > end
+  > function event()
+  >   local m1 = mode()
+  >   ffi.C.usleep(1100000)
+  >   local m2 = mode()
+  >   if sysbench.opt.rand_hotspot == "drift" then
+  >     -- the hotspot has moved through about 55% of the range
+  >     print(m1 < 250, m2 > 500 and m2 < 750)
+  >   else
+  >     print(m1, m2)
+  >   end
+  > end
+  > EOF
+
+  $ sysbench $SB_ARGS $CRAMTMP/rand_hotspot.lua run
+  1	1
+  $ sysbench $SB_ARGS --rand-hotspot=step --rand-hotspot-period=1 $CRAMTMP/rand_hotspot.lua run
+  1	790
+  $ sysbench $SB_ARGS --rand-hotspot=step --rand-hotspot-period=10 $CRAMTMP/rand_hotspot.lua run
+  1	1
+  $ sysbench $SB_ARGS --rand-hotspot=drift --rand-hotspot-period=2 $CRAMTMP/rand_hotspot.lua run
+  true	true
+
+  $ sysbench $SB_ARGS --rand-hotspot=foo $CRAMTMP/rand_hotspot.lua run
+  FATAL: Invalid value for rand-hotspot: foo
+  [1]
+  $ sysbench $SB_ARGS --rand-hotspot=step --rand-hotspot-period=0 $CRAMTMP/rand_hotspot.lua run
+  FATAL: Invalid value for rand-hotspot-period: 0
+  [1]
@@ -0,0 +1,21 @@
+########################################################################
+# --rate-mode tests
+########################################################################
+
+  $ sysbench cpu --rate=100 --rate-mode=foo --time=1 run
+  FATAL: Invalid value for --rate-mode: foo
+  [1]
+
+Each worker thread schedules its share of the rate
+
+  $ sysbench cpu --cpu-max-prime=100 --rate=400 --rate-mode=worker \
+  >   --threads=2 --time=2 run | awk '/events\/s/ { print ($3 > 300 && $3 < 500) }'
+  1
+
+  $ sysbench cpu --cpu-max-prime=100 --rate=100 --rate-mode=worker \
+  >   --intended-latency --time=2 --report-interval=1 run |
+  >   grep -E '^(\[ 1s \] (queue|intended)|Latency from)'
+  [ 1s ] queue length: 0 concurrency: 0
+  [ 1s ] queue wait lat (ms,95.00%): *.* (glob)
+  [ 1s ] intended lat (ms,95.00%): *.* (glob)
+  Latency from intended start (ms):
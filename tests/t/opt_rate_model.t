@@ -0,0 +1,54 @@
+########################################################################
+# --rate-model tests
+########################################################################
+
+  $ sysbench cpu --rate=100 --rate-model=foo --time=1 run
+  FATAL: Invalid value for --rate-model: foo
+  [1]
+
+  $ sysbench cpu --rate-model=onoff --time=1 run
+  FATAL: --rate-model=onoff requires --rate
+  [1]
+
+  $ sysbench cpu --rate=100 --rate-model=mmpp --rate-burst-factor=1 --time=1 run
+  FATAL: Invalid value for --rate-burst-factor: 1.000000
+  [1]
+
+  $ sysbench cpu --rate-model=schedule --time=1 run
+  FATAL: --rate-model=schedule requires --rate-schedule-file
+  [1]
+
+  $ printf '100\nfoo\n' > $CRAMTMP/schedule
+  $ sysbench cpu --rate-model=schedule --rate-schedule-file=$CRAMTMP/schedule \
+  >   --time=1 run
+  FATAL: */schedule:2: invalid rate schedule line (glob)
+  [1]
+
+Evenly spaced events
+
+  $ for mode in generator worker; do
+  >   sysbench cpu --cpu-max-prime=100 --rate=500 --rate-model=constant \
+  >     --rate-mode=$mode --threads=2 --time=2 run |
+  >     awk '/events\/s/ { print ($3 > 490 && $3 < 510) }'
+  > done
+  1
+  1
+
+Bursts keep the average rate
+
+  $ for model in onoff mmpp; do
+  >   sysbench cpu --cpu-max-prime=100 --rate=1000 --rate-model=$model \
+  >     --rate-burst-time=0.5 --time=3 run |
+  >     awk '/events\/s/ { print ($3 > 800 && $3 < 1200) }'
+  > done
+  1
+  1
+
+The schedule replaces --rate
+
+  $ printf '# events/s\n200\n\n600\n' > $CRAMTMP/schedule
+  $ sysbench cpu --cpu-max-prime=100 --rate-model=schedule \
+  >   --rate-schedule-file=$CRAMTMP/schedule --time=2 run |
+  >   awk '/Target/ { print } /events\/s/ { print ($3 > 350 && $3 < 450) }'
+  Target transaction rate: 400/sec, arrivals: schedule
+  1
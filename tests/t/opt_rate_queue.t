@@ -0,0 +1,42 @@
+########################################################################
+# --rate-queue-size and --rate-queue-full tests
+########################################################################
+
+  $ sysbench cpu --rate=100 --rate-queue-full=foo --time=1 run
+  FATAL: Invalid value for --rate-queue-full: foo
+  [1]
+
+  $ sysbench cpu --rate=100 --rate-queue-size=1 --time=1 run
+  FATAL: Invalid value for --rate-queue-size: 1
+  [1]
+
+By default, the test is terminated when the queue is full
+
+  $ sysbench cpu --cpu-max-prime=50000 --rate=10000 --rate-queue-size=4 \
+  >   --time=2 run 2>&1 | grep FATAL
+  FATAL: The event queue is full. This means the worker threads are unable to keep up with the specified event generation rate
+  FATAL: Event queue is full. Terminating the worker thread
+
+Dropped events are counted
+
+  $ sysbench cpu --cpu-max-prime=50000 --rate=10000 --rate-queue-size=4 \
+  >   --rate-queue-full=drop --time=2 --report-interval=1 run |
+  >   grep -E '^(WARNING|\[ 1s \] queue|Queue wait)|dropped events' |
+  >   sed -E 's/[0-9]+\.[0-9]+/N/g; s/(dropped:?( events:)?) +[1-9][0-9]*/\1 N/'
+  WARNING: The event queue is full, dropping new events
+  [ 1s ] queue length: * concurrency: 1 (glob)
+  [ 1s ] queue wait lat (ms,N%): N dropped: N
+      dropped events: N
+  Queue wait (ms):
+
+The overflow buffer keeps all events
+
+  $ sysbench cpu --cpu-max-prime=50000 --rate=10000 --rate-queue-size=4 \
+  >   --rate-queue-full=grow --time=2 --report-interval=1 run |
+  >   grep -E '^(WARNING|FATAL)|dropped'
+  WARNING: The event queue is full, keeping new events in an overflow buffer
+
+  $ sysbench cpu --cpu-max-prime=50000 --rate=10000 --rate-queue-size=4 \
+  >   --rate-queue-full=grow --time=2 --report-interval=1 run |
+  >   awk '/^\[ 1s \] queue length:/ { print ($5 > 100) }'
+  1
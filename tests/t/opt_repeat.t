@@ -0,0 +1,45 @@
+########################################################################
+Tests for --repeat and --cooldown
+########################################################################
+
+  $ sysbench --repeat=0 run
+  FATAL: Invalid value for --repeat: 0
+  [1]
+
+  $ sysbench --repeat=2 --cooldown=-1 run
+  FATAL: Invalid value for --cooldown: -1
+  [1]
+
+  $ sysbench --repeat=2 --threads=1,2 run
+  FATAL: --repeat cannot be used with --slo-latency or a list of --threads values
+  [1]
+
+  $ sysbench cpu --cpu-max-prime=1000 --events=100 --time=0 --repeat=3 \
+  >   --cooldown=1 --percentile=50,99 run |
+  >   grep -E '^(Repeated|Cooling|Threads started)|^    .*percentile \(ms\)|mean'
+  Repeated run 1 of 3
+  Threads started!
+  Cooling down for 1 second(s)...
+  Repeated run 2 of 3
+  Threads started!
+  Cooling down for 1 second(s)...
+  Repeated run 3 of 3
+  Threads started!
+  Repeated runs summary (3 runs):
+                                             mean       stddev     95% CI low    95% CI high        +/-
+      50.00th percentile (ms):     * (glob)
+      99.00th percentile (ms):     * (glob)
+
+  $ sysbench cpu --cpu-max-prime=1000 --events=100 --time=0 --repeat=2 run |
+  >   sed -n '/^Repeated runs summary/,$p'
+  Repeated runs summary (2 runs):
+                                             mean       stddev     95% CI low    95% CI high        +/-
+      events/s (eps):              * (glob)
+      95.00th percentile (ms):     * (glob)
+
+Events are counted from zero in each run
+
+  $ sysbench cpu --cpu-max-prime=1000 --events=100 --time=0 --repeat=2 run |
+  >   grep 'total number of events'
+      total number of events:              100
+      total number of events:              100
@@ -0,0 +1,28 @@
+########################################################################
+# Fractional and millisecond --report-interval values
+########################################################################
+
+  $ sysbench cpu --report-interval=100ms --time=1 run |
+  >   grep -E '^Report|^\[ 0\.' | head -4
+  Report intermediate results every 100 ms
+  [ 0.?s ] thds: 1 eps: * lat (ms,95.00%): * (glob)
+  [ 0.?s ] thds: 1 eps: * lat (ms,95.00%): * (glob)
+  [ 0.?s ] thds: 1 eps: * lat (ms,95.00%): * (glob)
+
+  $ sysbench cpu --report-interval=0.25 --time=1 run |
+  >   grep -E '^Report|^\[ 0\.[0-9]+s \]'
+  Report intermediate results every 250 ms
+  [ 0.2?s ] thds: 1 eps: * lat (ms,95.00%): * (glob)
+  [ 0.5?s ] thds: 1 eps: * lat (ms,95.00%): * (glob)
+  [ 0.7?s ] thds: 1 eps: * lat (ms,95.00%): * (glob)
+
+  $ sysbench cpu --report-interval=2s --time=3 run | grep -E '^Report|^\['
+  Report intermediate results every 2 second(s)
+  [ 2s ] thds: 1 eps: * lat (ms,95.00%): * (glob)
+
+  $ for v in foo -1 0.0001 5m; do sysbench cpu --report-interval=$v run; done
+  FATAL: Invalid value for --report-interval: 'foo'
+  FATAL: Invalid value for --report-interval: '-1'
+  FATAL: Invalid value for --report-interval: '0.0001'
+  FATAL: Invalid value for --report-interval: '5m'
+  [1]
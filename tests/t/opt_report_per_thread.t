@@ -0,0 +1,44 @@
+########################################################################
+# --report-per-thread tests
+########################################################################
+
+  $ cat > $CRAMTMP/slow.lua <<EOF
+  > ffi.cdef[[int usleep(unsigned int);]]
+  > function event()
+  >   ffi.C.usleep(sysbench.tid == 1 and 50000 or 1000)
+  > end
+  > EOF
+
+Without the option neither per-thread lines nor a straggler summary are printed
+
+  $ sysbench $CRAMTMP/slow.lua --threads=2 --time=1 --report-interval=1 run |
+  >   grep -c 'thread [01]:\|Per-thread\|stragglers'
+  0
+  [1]
+
+A thread sleeping 50 times longer than the other one is a straggler
+
+  $ sysbench $CRAMTMP/slow.lua --threads=2 --time=2 --report-interval=1 \
+  >   --report-per-thread run |
+  >   awk '/^\[ 1s \] thread/ { print $4, $5 }
+  >        /^Per-thread|^    thread/ { print }
+  >        /^         [01] / { print $1, $NF }
+  >        /events \(min\/max\)|stragglers:|start skew/ { print $1, $2 }'
+  thread 0:
+  thread 1:
+  Per-thread statistics:
+      thread       events     events/s    avg ms   95.00th    max ms   errors
+  0 0
+  1 straggler
+  events (min/max):
+  stragglers: 1
+  start skew
+
+Intermediate per-thread lines follow the totals with latency percentiles
+
+  $ sysbench cpu --cpu-max-prime=1000 --threads=2 --time=2 \
+  >   --report-interval=1 --report-per-thread run | grep '^\[ 1s \]' |
+  >   sed -e 's/[0-9][0-9.]*/N/g'
+  [ Ns ] thds: N eps: N lat (ms,N%): N 
+  [ Ns ] thread N: eps: N lat (ms,N%): N err/s: N
+  [ Ns ] thread N: eps: N lat (ms,N%): N err/s: N
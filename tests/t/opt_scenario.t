@@ -0,0 +1,98 @@
+########################################################################
+Tests for --scenario
+########################################################################
+
+  $ cat > scenario.lua <<EOF
+  > sysbench.cmdline.options = { size = {"Size", 10} }
+  > sysbench.cmdline.commands = {
+  >   hello = {function() print("hello size=" .. sysbench.opt.size) end}
+  > }
+  > function prepare() print("prepare size=" .. sysbench.opt.size) end
+  > function cleanup() print("cleanup size=" .. sysbench.opt.size) end
+  > function thread_init() io.write("thread_init " .. sysbench.tid .. "\n") end
+  > function thread_done() io.write("thread_done " .. sysbench.tid .. "\n") end
+  > function event() end
+  > EOF
+
+  $ cat > steps.txt <<EOF
+  > # prepare, warm up and run twice
+  > prepare --size=5
+  > 
+  > warmup --events=10
+  > run --events=100 --size=7
+  >   run --events=50 --threads=1
+  > hello
+  > cleanup
+  > EOF
+
+  $ sysbench scenario.lua --threads=2 --scenario=steps.txt run |
+  >   grep -E '^(Scenario|prepare|cleanup|hello|thread_|Threads started)|total number of events' |
+  >   sed -E 's/^thread_(init|done) [01]$/thread_\1 N/'
+  Scenario step 1 of 6: prepare --size=5
+  prepare size=5
+  Scenario step 2 of 6: warmup --events=10
+  thread_init N
+  thread_init N
+  Threads started!
+  Scenario step 3 of 6: run --events=100 --size=7
+  Threads started!
+      total number of events:              100
+  Scenario step 4 of 6: run --events=50 --threads=1
+  Threads started!
+      total number of events:              50
+  Scenario step 5 of 6: hello
+  hello size=10
+  Scenario step 6 of 6: cleanup
+  cleanup size=10
+  thread_done N
+  thread_done N
+
+  $ echo bogus > bad.txt
+  $ sysbench scenario.lua --scenario=bad.txt run
+  sysbench * (glob)
+  
+  FATAL: bad.txt:1: 'scenario.lua' test does not implement the 'bogus' command
+  [1]
+
+  $ echo 'run --foo=1' > bad.txt
+  $ sysbench scenario.lua --scenario=bad.txt run
+  sysbench * (glob)
+  
+  FATAL: bad.txt:1: --foo cannot be changed in scenario steps
+  [1]
+
+  $ echo 'run -x' > bad.txt
+  $ sysbench scenario.lua --scenario=bad.txt run
+  sysbench * (glob)
+  
+  FATAL: bad.txt:1: invalid option '-x', expected --name=value
+  [1]
+
+  $ echo 'run --threads=3' > bad.txt
+  $ sysbench scenario.lua --threads=2 --scenario=bad.txt run
+  sysbench * (glob)
+  
+  Scenario step 1 of 1: run --threads=3
+  
+  FATAL: Invalid value for --threads: 3, scenario steps can use between 1 and 2 threads
+  [1]
+
+  $ echo '# nothing' > bad.txt
+  $ sysbench scenario.lua --scenario=bad.txt run
+  sysbench * (glob)
+  
+  FATAL: No steps in --scenario file 'bad.txt'
+  [1]
+
+  $ sysbench scenario.lua --scenario=bad.txt --repeat=2 run
+  sysbench * (glob)
+  
+  FATAL: --scenario cannot be used with the cluster mode, --thread-groups, --profile, --slo-latency, --repeat, --warmup-steady-state or a list of --threads values
+  [1]
+
+Other commands ignore --scenario
+
+  $ sysbench scenario.lua --scenario=bad.txt prepare
+  sysbench * (glob)
+  
+  prepare size=10
@@ -0,0 +1,49 @@
+########################################################################
+# --slo-latency tests
+########################################################################
+
+  $ sysbench cpu --slo-latency=-1 run
+  FATAL: Invalid value for --slo-latency: -1.000000
+  [1]
+
+  $ sysbench cpu --slo-latency=5 run
+  FATAL: --slo-latency requires --rate as the initial probe rate
+  [1]
+
+  $ sysbench cpu --slo-latency=5 --rate=100 --slo-percentile=0 run
+  FATAL: Invalid value for --slo-percentile: 0.000000
+  [1]
+
+  $ sysbench cpu --slo-latency=5 --rate=100 --report-checkpoints=1 run
+  FATAL: --slo-latency cannot be used with --profile, --report-checkpoints or a list of --threads values
+  [1]
+
+The rate is doubled while probes pass
+
+  $ for mode in generator worker; do
+  >   sysbench cpu --cpu-max-prime=100 --threads=4 --rate=50 --rate-mode=$mode \
+  >     --slo-latency=1000 --slo-probe-time=1 --slo-max-probes=3 run |
+  >   awk '/SLO search|Latency vs|Max sustainable/ { print } /^ +[0-9]+ / { print $1, $5 }'
+  > done
+  SLO search: 99.00th percentile latency <= 1000.00 ms, 1s probes
+  Latency vs. throughput:
+  50 pass
+  100 pass
+  200 pass
+  Max sustainable rate: 200/sec (99.00th percentile latency <= 1000.00 ms)
+  SLO search: 99.00th percentile latency <= 1000.00 ms, 1s probes
+  Latency vs. throughput:
+  50 pass
+  100 pass
+  200 pass
+  Max sustainable rate: 200/sec (99.00th percentile latency <= 1000.00 ms)
+
+Failing probes halve the rate
+
+  $ sysbench cpu --cpu-max-prime=100 --rate=100 --slo-latency=0.000001 \
+  >   --slo-probe-time=1 --slo-max-probes=2 run |
+  >   awk '/Latency vs|No probed/ { print } /^ +[0-9]+ / { print $1, $5 }'
+  Latency vs. throughput:
+  50 FAIL
+  100 FAIL
+  No probed rate meets the SLO of 0.00 ms at the 99.00th percentile
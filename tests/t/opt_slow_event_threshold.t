@@ -0,0 +1,67 @@
+########################################################################
+# --slow-event-threshold and --slow-event-log tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+
+  $ cat >$CRAMTMP/slow.lua <<EOF
+  > function thread_init()
+  >   con = sysbench.sql.driver():connect()
+  >   stmt = con:prepare("SELECT abs(?), ?")
+  >   num = stmt:bind_create(sysbench.sql.type.BIGINT)
+  >   str = stmt:bind_create(sysbench.sql.type.VARCHAR, 10)
+  >   stmt:bind_param(num, str)
+  >   n = 0
+  > end
+  > function event()
+  >   n = n + 1
+  >   num:set(-n)
+  >   str:set("e" .. n)
+  >   stmt:execute()
+  >   if n == 3 then
+  >     pcall(con.query, con, "SELECT bogus")
+  >     -- Retry once after a slow attempt
+  >     if not retried then
+  >       retried = true
+  >       os.execute("sleep 0.3")
+  >       error({errcode = sysbench.error.RESTART_EVENT})
+  >     end
+  >   end
+  >   con:query("SELECT 1")
+  > end
+  > EOF
+
+  $ sysbench $DB_DRIVER_ARGS $CRAMTMP/slow.lua --events=1 \
+  >   --slow-event-threshold=-1 run | grep FATAL
+  FATAL: Invalid value for --slow-event-threshold: -1
+  $ sysbench $DB_DRIVER_ARGS $CRAMTMP/slow.lua --events=1 \
+  >   --slow-event-threshold=10 run | grep FATAL
+  FATAL: --slow-event-threshold requires --slow-event-log
+  $ sysbench $DB_DRIVER_ARGS $CRAMTMP/slow.lua --events=1 \
+  >   --slow-event-log=$CRAMTMP/slow.log run | grep FATAL
+  FATAL: --slow-event-log requires --slow-event-threshold
+  $ sysbench $DB_DRIVER_ARGS $CRAMTMP/slow.lua --events=1 \
+  >   --slow-event-threshold=10 --slow-event-log=$CRAMTMP/slow.log \
+  >   --virtual-users=2 run | grep FATAL
+  FATAL: --slow-event-threshold cannot be used with --virtual-users
+
+Only the event exceeding the threshold is logged, with the statements of both
+attempts, their bound values and errors
+
+  $ sysbench $DB_DRIVER_ARGS $CRAMTMP/slow.lua --events=5 \
+  >   --slow-event-threshold=200 --slow-event-log=$CRAMTMP/slow.log run |
+  >   grep Logging
+  Logging events slower than 200 ms to */slow.log (glob)
+  $ sed -e 's/[0-9]*\.[0-9]*/T/g' $CRAMTMP/slow.log
+  # Event: time T, thread 0, latency T ms, queue T ms, statements 4, retries 1
+  # Statement: offset T ms, latency T ms
+  SELECT abs(-3), 'e3';
+  # Statement: offset T ms, latency T ms, error [0-9]+ (re)
+  SELECT bogus;
+  # Retry: 1
+  # Statement: offset T ms, latency T ms
+  SELECT abs(-4), 'e4';
+  # Statement: offset T ms, latency T ms
+  SELECT 1;
+  $ awk '/^# Event/ { print ($8 >= 300) }' $CRAMTMP/slow.log
+  1
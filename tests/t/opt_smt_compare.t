@@ -0,0 +1,30 @@
+########################################################################
+--smt-compare tests
+########################################################################
+
+  $ sysbench cpu --smt-compare --threads=3 run 2>&1 | grep FATAL
+  FATAL: --smt-compare requires an even number of threads
+
+  $ sysbench cpu --smt-compare --time=0 --events=100 run
+  FATAL: --smt-compare requires a --time limit and does not support --events, --warmup-time or --rate
+  [1]
+
+  $ sysbench cpu --smt-compare --thread-affinity=compact run
+  FATAL: --smt-compare cannot be used with --thread-affinity
+  [1]
+
+  $ sysbench memory --smt-compare --threads=2 --memory-sweep run 2>&1 |
+  >   grep FATAL
+  FATAL: --memory-sweep cannot be used with --smt-compare
+
+Placements need as many cores as threads, half of them with SMT siblings
+
+  $ nproc=$(nproc)
+  $ if [ "$nproc" -ge 2 ] && grep -q '[,-]' \
+  >      /sys/devices/system/cpu/cpu0/topology/thread_siblings_list 2>/dev/null
+  > then
+  >   exit 80
+  > fi
+
+  $ sysbench cpu --smt-compare --threads=2 --time=1 run 2>&1 | grep FATAL
+  FATAL: --smt-compare with 2 threads requires 1 physical cores with SMT siblings and 2 cores available, found * (glob)
@@ -0,0 +1,31 @@
+########################################################################
+# --stop-ci tests
+########################################################################
+
+  $ sysbench cpu --stop-ci=-1 run
+  FATAL: Invalid value for --stop-ci: -1.000000
+  [1]
+
+  $ sysbench cpu --stop-ci=1 --stop-min-time=-1 run
+  FATAL: Invalid value for --stop-min-time: -1
+  [1]
+
+  $ sysbench cpu --stop-ci=1 --rate=10 --slo-latency=1 run
+  FATAL: --stop-ci cannot be used with --slo-latency or --profile
+  [1]
+
+At least 9 one-second samples are needed for an estimate
+
+  $ sysbench cpu --cpu-max-prime=1000 --stop-ci=1 --time=2 run |
+  >   grep -E '^Stop|WARNING'
+  Stop when events/s are within 1% at 95% confidence, after at least 10s
+  WARNING: --stop-ci=1 not reached: the run was too short to estimate the confidence interval
+
+The run ends before --time once the interval is tight enough
+
+  $ sysbench cpu --cpu-max-prime=1000 --stop-ci=50 --stop-min-time=0 \
+  >   --time=60 run |
+  >   awk '/Stopping: mean/ { print $4, $5, $10, $11, $12, $13, ($14 >= 9) }
+  >        /time elapsed/ { print ($3 + 0 < 30) }'
+  Stopping: mean at 95% confidence after 1
+  1
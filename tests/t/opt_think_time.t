@@ -0,0 +1,58 @@
+########################################################################
+# --think-time tests
+########################################################################
+
+  $ sysbench cpu --think-time=-1 run
+  FATAL: Invalid value for --think-time: -1.000000.
+  
+  [1]
+
+  $ sysbench cpu --think-time=1 --think-time-type=foo run
+  FATAL: Invalid value for --think-time-type: foo
+  [1]
+
+  $ sysbench cpu --think-time=1 --rate=10 run | grep FATAL
+  FATAL: --think-time cannot be used with --rate
+
+Think and cycle times are reported separately from latency
+
+  $ sysbench cpu --cpu-max-prime=1000 --think-time=20 \
+  >   --think-time-type=fixed --time=1 run |
+  >   awk '/^Think time/ { print }
+  >        /^(Latency|Think time|Cycle time)/ { s = $1 }
+  >        / avg:/ { avg[s] = $2 }
+  >        /^Cycle time/ { print }
+  >        /total number of events/ { print ($5 >= 40 && $5 <= 50) }
+  >        END { print (avg["Think"] >= 19.5 && avg["Think"] < 22)
+  >              print (avg["Cycle"] > avg["Think"]) }'
+  Think time: 20.00 ms, fixed
+  1
+  Think time (ms):
+  Cycle time, latency plus think time (ms):
+  1
+  1
+
+  $ for dist in exponential uniform; do
+  >   sysbench cpu --cpu-max-prime=1000 --think-time=10 \
+  >     --think-time-type=$dist --time=2 run |
+  >     awk '/^Think time \(ms\)/ { t = 1 } t && / avg:/ { print ($2 > 7 && $2 < 13); t = 0 }'
+  > done
+  1
+  1
+
+Think time does not extend the test
+
+  $ sysbench cpu --think-time=5000 --think-time-type=fixed --time=1 run |
+  >   grep -E 'time elapsed|total number of events'
+      time elapsed:                        1.0*s (glob)
+      total number of events:              1
+
+Think time of virtual users
+
+  $ cat > vu.lua <<EOF
+  > function event() end
+  > EOF
+  $ sysbench vu.lua --virtual-users=10 --think-time=10 \
+  >   --think-time-type=fixed --time=1 run |
+  >   awk '/total number of events/ { print ($5 > 800 && $5 <= 1010) }'
+  1
@@ -0,0 +1,50 @@
+########################################################################
+# --thread-affinity tests
+########################################################################
+
+  $ sysbench cpu --thread-affinity=foo run
+  FATAL: Invalid value for --thread-affinity: 'foo'
+  [1]
+
+  $ sysbench cpu --thread-affinity=cpus:1-0 run
+  FATAL: Invalid CPU list in --thread-affinity: '1-0'
+  [1]
+
+  $ sysbench cpu --thread-affinity=numa:x run
+  FATAL: Invalid NUMA node list in --thread-affinity: 'x'
+  [1]
+
+  $ sysbench cpu --thread-affinity=numa:1000 run
+  FATAL: NUMA node 1000 does not exist or has no available CPUs
+  [1]
+
+  $ if [ ! -r /proc/thread-self/status ]
+  > then
+  >   exit 80
+  > fi
+
+  $ cat >affinity.lua <<EOF
+  > function thread_init()
+  >   for l in io.lines("/proc/thread-self/status") do
+  >     local cpus = l:match("^Cpus_allowed_list:%s*(.*)")
+  >     if cpus then io.write(sysbench.tid .. ": " .. cpus .. "\n") end
+  >   end
+  > end
+  > function event() end
+  > EOF
+
+  $ sysbench affinity.lua --thread-affinity=cpus:0 --threads=2 --events=1 run |
+  >   grep -E '^(Thread affinity|[0-9]+:)' | sort
+  0: 0
+  1: 0
+  Thread affinity: cpus:0
+
+  $ sysbench cpu --thread-affinity=compact --threads=2 --events=100 run |
+  >   grep -E '(Thread affinity|total number of events)'
+  Thread affinity: compact
+      total number of events:              100
+
+  $ sysbench cpu --thread-affinity=scatter --threads=2 --events=100 run |
+  >   grep -E '(Thread affinity|total number of events)'
+  Thread affinity: scatter
+      total number of events:              100
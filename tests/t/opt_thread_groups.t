@@ -0,0 +1,91 @@
+########################################################################
+# --thread-groups tests
+########################################################################
+
+  $ sysbench cpu --thread-groups=x run
+  FATAL: Invalid value for --thread-groups: 'x'
+  [1]
+
+  $ sysbench cpu --thread-groups=2@ run
+  FATAL: Invalid value for --thread-groups: '2@'
+  [1]
+
+  $ sysbench cpu --thread-groups=1@10 --rate=5 run
+  FATAL: --rate cannot be used with --thread-groups rates
+  [1]
+
+  $ sysbench cpu --thread-groups=1 --threads=1,2 run
+  FATAL: --thread-groups cannot be used with a list of --threads values
+  [1]
+
+  $ sysbench cpu --thread-groups=1:foo.lua run
+  sysbench * (glob)
+  
+  FATAL: Scripts in --thread-groups require a Lua script as the main test
+  [1]
+
+Groups of a built-in test with and without a rate
+
+  $ sysbench cpu --cpu-max-prime=1000 --thread-groups=2@100,1 --time=2 run |
+  >   awk '/^Number of threads|^Target|^Thread groups|thread\(s\) running/ { print }
+  >        /^    1: cpu/ { print $2, $3, $4, ($5 > 70 && $5 < 130) }
+  >        /^    2: cpu/ { print $2, $3, $4, ($5 > 1000) }'
+  Number of threads: 3
+  Target transaction rate: 100/sec, arrivals: poisson
+  Thread groups:
+      1: 2 thread(s) running cpu at 100/sec
+      2: 1 thread(s) running cpu
+  Thread groups:
+  cpu 2 100 1
+  cpu 1 - 1
+
+Groups running different scripts with options of both
+
+  $ cat >a.lua <<EOF
+  > sysbench.cmdline.options = { a_opt = {"A option", 1} }
+  > function init()
+  >   print("a: " .. sysbench.cmdline.script_path .. " " .. sysbench.opt.a_opt)
+  > end
+  > function event() end
+  > EOF
+
+  $ cat >b.lua <<EOF
+  > sysbench.cmdline.options = { a_opt = {"A option", 1}, b_opt = {"B option", 2} }
+  > function thread_init()
+  >   if sysbench.tid == 2 then
+  >     print("b: " .. sysbench.cmdline.script_path .. " " .. sysbench.opt.b_opt)
+  >   end
+  > end
+  > function event() end
+  > EOF
+
+  $ sysbench a.lua --thread-groups=2@200,1@50:b.lua help
+  sysbench * (glob)
+  
+  a.lua options:
+    --a_opt=N A option [1]
+    --b_opt=N B option [2]
+  
+
+  $ sysbench a.lua --thread-groups=2@200,1@50:b.lua --a_opt=3 --b_opt=7 \
+  >   --time=1 run |
+  >   awk '/^(a|b): |thread\(s\) running/ { print }
+  >        /^    [0-9]: [ab] / { print $2, $3, $4 }'
+  a: a.lua 3
+      1: 2 thread(s) running a at 200/sec
+      2: 1 thread(s) running b at 50/sec
+  b: b.lua 7
+  a 2 200
+  b 1 50
+
+  $ cat >c.lua <<EOF
+  > function thread_init() end
+  > EOF
+
+  $ sysbench a.lua --thread-groups=1,1:c.lua run
+  sysbench * (glob)
+  
+  FATAL: cannot find the event() function in c.lua
+  [1]
+
+  $ rm -f a.lua b.lua c.lua
@@ -0,0 +1,77 @@
+########################################################################
+# --thread-sched and --thread-cgroup tests
+########################################################################
+
+  $ sysbench cpu --thread-sched=foo run | grep FATAL
+  FATAL: Invalid value for --thread-sched: 'foo'
+  $ sysbench cpu --thread-sched=fifo run | grep FATAL
+  FATAL: Invalid value for --thread-sched: 'fifo'
+  $ sysbench cpu --thread-sched=other:20 run | grep FATAL
+  FATAL: Invalid value for --thread-sched: 'other:20'
+  $ sysbench cpu --thread-sched=idle:1 run | grep FATAL
+  FATAL: Invalid value for --thread-sched: 'idle:1'
+  $ sysbench cpu --thread-sched=batch,idle run | grep FATAL
+  FATAL: --thread-sched requires a single value or one per --thread-groups group
+  $ sysbench cpu --thread-groups=1,1,1 --thread-sched=batch,idle run |
+  >   grep FATAL
+  FATAL: --thread-sched requires a single value or one per --thread-groups group
+
+An idle group only gets CPU time not used by others
+
+  $ sysbench cpu --thread-groups=1,1 --thread-sched=other:5,idle \
+  >   --thread-affinity=cpus:0 --time=1 run |
+  >   awk '/^Worker|policy/ { print }
+  >        /^    1: cpu +other/ { print $1, $2, $3, $4, ($6 > 90) }
+  >        /^    2: cpu +idle/ { print $1, $2, $3, $4, ($6 < 10) }'
+  Worker thread scheduling:
+      1: cpu: policy other:5, cgroup -
+      2: cpu: policy idle, cgroup -
+  Worker CPU usage:
+  1: cpu other:5 - 1
+  2: cpu idle - 1
+
+Cgroups are created as threaded children of the root, which must be a cgroup
+v2 directory
+
+  $ mkdir cg
+  $ sysbench cpu --thread-cgroup=x --thread-cgroup-root=cg run | grep FATAL
+  FATAL: 'cg' is not a cgroup v2 directory
+  $ touch cg/cgroup.controllers
+
+  $ for v in a/b .. x:0 x:10001 x:1:a x:1:2:3; do
+  >   sysbench cpu --thread-cgroup=$v --thread-cgroup-root=cg run | grep FATAL
+  > done
+  FATAL: Invalid value for --thread-cgroup: 'a/b'
+  FATAL: Invalid value for --thread-cgroup: '..'
+  FATAL: Invalid value for --thread-cgroup: 'x:0'
+  FATAL: Invalid value for --thread-cgroup: 'x:10001'
+  FATAL: Invalid value for --thread-cgroup: 'x:1:a'
+  FATAL: Invalid value for --thread-cgroup: 'x:1:2:3'
+
+  $ sysbench cpu --thread-groups=2,1,1 --thread-cgroup=oltp:500:0-1+3,batch:-:2,- \
+  >   --thread-cgroup-root=cg --events=100 --time=0 run |
+  >   awk '/^Worker|policy|cgroups in/ { print }
+  >        /^    [123]: cpu +- / { print $1, $2, $3, $4 }'
+  Worker thread scheduling:
+      1: cpu: policy -, cgroup oltp
+      2: cpu: policy -, cgroup batch
+      3: cpu: policy -, cgroup -
+      cgroups in cg
+  Worker CPU usage:
+  1: cpu - oltp
+  2: cpu - batch
+  3: cpu - -
+  $ cat cg/cgroup.subtree_control; echo
+  +cpu+cpuset
+  $ for f in cgroup.type cpu.weight cpuset.cpus; do
+  >   cat cg/oltp/$f cg/batch/$f 2>/dev/null; echo
+  > done
+  threadedthreaded
+  500
+  0-1,32
+  $ wc -l < cg/oltp/cgroup.threads
+  2
+  $ wc -l < cg/batch/cgroup.threads
+  1
+
+  $ rm -rf cg
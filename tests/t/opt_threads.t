@@ -0,0 +1,51 @@
+########################################################################
+# --threads tests
+########################################################################
+
+  $ sysbench cpu --threads=0 run
+  FATAL: Invalid value for --threads: '0'
+  [1]
+
+  $ sysbench cpu --threads=1,,2 run
+  FATAL: Invalid value for --threads: '1,,2'
+  [1]
+
+  $ sysbench cpu --threads=sweep:4..2 run
+  FATAL: Invalid value for --threads: 'sweep:4..2'
+  [1]
+
+  $ sysbench cpu --threads=1,2 --events=100 --time=0 run | grep -E '(Thread scaling|Number of threads|total number of events)'
+  Thread scaling run 1 of 2: 1 thread(s)
+  Number of threads: 1
+      total number of events:              100
+  Thread scaling run 2 of 2: 2 thread(s)
+  Number of threads: 2
+      total number of events:              100
+  Thread scaling:
+
+  $ sysbench cpu --threads=sweep:1..6 --events=10 --time=0 run | sed -n '/^Thread scaling:/,$p'
+  Thread scaling:
+     threads        events/s    speedup  efficiency
+           1 *       1.00      100.0% (glob)
+           2 * (glob)
+           4 * (glob)
+           6 * (glob)
+  
+  Universal Scalability Law fit:
+      lambda (events/s per thread):   *.* (glob)
+      sigma (contention):             *.* (glob)
+      kappa (coherency):              *.* (glob)
+      R^2:                            *.* (glob)
+      peak concurrency:               * (glob)
+      throughput ceiling (events/s):  * (glob)
+
+  $ cat > $CRAMTMP/threads.lua <<EOF
+  > function init() print("init: " .. sysbench.opt.threads) end
+  > function event() end
+  > function done() print("done: " .. sysbench.opt.threads) end
+  > EOF
+  $ sysbench $CRAMTMP/threads.lua --threads=2,3 --events=1 --time=0 run | grep -E '^(init|done):'
+  init: 2
+  done: 2
+  init: 3
+  done: 3
@@ -0,0 +1,64 @@
+########################################################################
+# --trace-sample-pct and --trace-log tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+
+  $ cat >$CRAMTMP/trace.lua <<EOF
+  > sysbench.cmdline.options = { value = {"parameter value", -5} }
+  > function thread_init()
+  >   con = sysbench.sql.driver():connect()
+  >   stmt = con:prepare("SELECT abs(?)")
+  >   param = stmt:bind_create(sysbench.sql.type.BIGINT)
+  >   stmt:bind_param(param)
+  > end
+  > function event()
+  >   param:set(sysbench.opt.value)
+  >   stmt:execute()
+  >   con:query("SELECT 1")
+  > end
+  > EOF
+
+  $ sysbench $DB_DRIVER_ARGS $CRAMTMP/trace.lua --events=1 \
+  >   --trace-sample-pct=101 run | grep FATAL
+  FATAL: Invalid value for --trace-sample-pct: 101
+  $ sysbench $DB_DRIVER_ARGS $CRAMTMP/trace.lua --events=1 \
+  >   --trace-log=$CRAMTMP/trace.json run | grep FATAL
+  FATAL: --trace-log requires --trace-sample-pct
+  $ sysbench $DB_DRIVER_ARGS $CRAMTMP/trace.lua --events=1 \
+  >   --trace-sample-pct=10 --virtual-users=2 run | grep FATAL
+  FATAL: --trace-sample-pct cannot be used with --virtual-users
+
+Every statement of a traced event is logged with the event trace ID and its
+own span ID, followed by the event
+
+  $ sysbench $DB_DRIVER_ARGS $CRAMTMP/trace.lua --events=10 \
+  >   --trace-sample-pct=100 --trace-log=$CRAMTMP/trace.json run |
+  >   grep Tracing
+  Tracing 100% of events
+  $ wc -l < $CRAMTMP/trace.json
+  30
+  $ head -3 $CRAMTMP/trace.json | sed -e 's/"[0-9a-f]\{32\}"/TRACE/' \
+  >   -e 's/"[0-9a-f]\{16\}"/SPAN/g' -e 's/[0-9]*\.[0-9]*/T/g'
+  {"type":"query","trace_id":TRACE,"span_id":SPAN,"parent_id":SPAN,"thread":0,"time":T,"duration_ms":T,"error":false}
+  {"type":"query","trace_id":TRACE,"span_id":SPAN,"parent_id":SPAN,"thread":0,"time":T,"duration_ms":T,"error":false}
+  {"type":"event","trace_id":TRACE,"span_id":SPAN,"thread":0,"time":T,"duration_ms":T,"queries":2,"errors":0}
+  $ awk -F'"' '$4 == "query" { q[$8]++; p[$8] = $16 }
+  >   $4 == "event" { if (q[$8] != 2 || p[$8] != $12) bad++; n++ }
+  >   END { print n, bad + 0 }' $CRAMTMP/trace.json
+  10 0
+
+Some events are not traced with a lower percentage
+
+  $ sysbench $DB_DRIVER_ARGS $CRAMTMP/trace.lua --events=1000 \
+  >   --trace-sample-pct=10 --trace-log=$CRAMTMP/trace.json run > /dev/null
+  $ grep -c '"event"' $CRAMTMP/trace.json | awk '{ print ($1 > 0 && $1 < 500) }'
+  1
+
+Prepared statements of traced events are sent with the trace context and
+their parameters
+
+  $ sysbench $DB_DRIVER_ARGS $CRAMTMP/trace.lua --events=1 \
+  >   --trace-sample-pct=100 --value=-9223372036854775808 run 2>&1 |
+  >   grep 'failed query'
+  FATAL: failed query was: /*traceparent='00-*-*-01'*/ SELECT abs(-9223372036854775808) (glob)
@@ -0,0 +1,68 @@
+########################################################################
+# --virtual-users tests
+########################################################################
+
+  $ sysbench cpu --virtual-users=0 run
+  FATAL: Invalid value for --virtual-users: 0.
+  
+  [1]
+
+  $ sysbench cpu --virtual-users=2 run | grep FATAL
+  FATAL: --virtual-users requires a Lua script
+
+  $ cat > vu.lua <<EOF
+  > function vuser_init(thread_id, vu)
+  >   vu.events = 0
+  > end
+  > function event(thread_id, vu)
+  >   sysbench.sleep(0.01)
+  >   vu.events = vu.events + 1
+  > end
+  > function vuser_done(thread_id, vu)
+  >   if thread_id == 0 then
+  >     print(string.format("vuser %d: %s", vu.id,
+  >                         vu.events > 0 and "ok" or "no events"))
+  >   end
+  > end
+  > EOF
+
+  $ sysbench vu.lua --virtual-users=2 --rate=10 run | grep FATAL
+  FATAL: --virtual-users cannot be used with --rate
+
+Sleeping virtual users do not block each other
+
+  $ sysbench vu.lua --threads=2 --virtual-users=3 --time=1 run |
+  >   awk '/Virtual users|^vuser/ { print }
+  >        /total number of events/ { print ($5 > 400 && $5 <= 620) }
+  >        / avg:/ { print ($2 >= 10 && $2 < 15) }' | sort
+  1
+  1
+  Virtual users: 3 per thread
+  vuser 0: ok
+  vuser 1: ok
+  vuser 2: ok
+
+  $ sysbench vu.lua --virtual-users=10 --events=25 --time=0 run |
+  >   grep 'total number of events'
+      total number of events:              25
+
+Virtual users stop at the end of the test while sleeping
+
+  $ cat > sleep.lua <<EOF
+  > function event(thread_id, vu)
+  >   sysbench.sleep(vu.id == 0 and 0.001 or 100)
+  > end
+  > EOF
+  $ sysbench sleep.lua --virtual-users=2 --time=1 run | grep 'time elapsed:'
+      time elapsed:                        1.0*s (glob)
+
+Errors in virtual users abort the test
+
+  $ cat > error.lua <<EOF
+  > function event(thread_id, vu)
+  >   if vu.id == 1 then error("failed") end
+  >   sysbench.sleep(0.001)
+  > end
+  > EOF
+  $ sysbench error.lua --virtual-users=2 run 2>&1 | grep FATAL
+  FATAL: `thread_run' function failed: *error.lua:2: failed (glob)
@@ -85,3 +85,24 @@
       events (avg/stddev):           */* (glob)
       execution time (avg/stddev):   */* (glob)
   
+
+  $ sysbench cpu --warmup-steady-state=-1 run | grep FATAL
+  FATAL: Invalid value for --warmup-steady-state: -1.000000.
+  $ sysbench cpu --warmup-steady-state=10 --warmup-window=1 run | grep FATAL
+  FATAL: Invalid value for --warmup-window: 1.
+  $ sysbench cpu --warmup-steady-state=10 --warmup-time=5 --warmup-max-time=3 \
+  >   run | grep FATAL
+  FATAL: --warmup-max-time must be at least --warmup-time and --warmup-window
+
+  $ sysbench cpu --warmup-steady-state=50 --warmup-window=2 --time=1 run |
+  >   grep -E '^Warmup until|^Warming|^Steady|time elapsed'
+  Warmup until steady state: within 50.00% over 2s, at most 600s
+  Warming up until throughput is steady...
+  Steady state reached after 2 seconds: *% range, *% trend over the last 2 seconds (glob)
+      time elapsed:                        1.*s (glob)
+
+  $ sysbench cpu --warmup-steady-state=0.000001 --warmup-window=2 \
+  >   --warmup-max-time=3 --time=1 run 2>&1 |
+  >   grep -E '^WARNING|time elapsed'
+  WARNING: Steady state not reached after 3 seconds (*% range, *% trend over the last 2 seconds), starting the benchmark anyway (glob)
+      time elapsed:                        1.*s (glob)
@@ -0,0 +1,52 @@
+########################################################################
+--worker-memory and --lean-workers tests
+########################################################################
+
+  $ sysbench cpu --cpu-max-prime=1000 --threads=2 --time=1 --worker-memory \
+  >   run | sed -n '/^Per-worker memory/,/^$/p'
+  Per-worker memory (2 threads):
+      thread stack:                        64.0 KiB
+      C heap (drivers and other):          *.* KiB (glob)
+      total:                               *.* KiB per worker, *.* MiB for all workers (glob)
+  
+
+  $ sysbench cpu --cpu-max-prime=1000 --time=1 --thread-stack-size=128K \
+  >   --worker-memory run | grep 'thread stack'
+      thread stack:                        128.0 KiB
+
+Lua scripts also report the heap of each interpreter state
+
+  $ cat > $CRAMTMP/memory.lua <<EOF
+  > function thread_init()
+  >   data = {}
+  >   for i = 1, 1000 do data[i] = "row " .. i end
+  > end
+  > function event()
+  >   error("event failed")
+  > end
+  > EOF
+
+  $ sysbench $CRAMTMP/memory.lua --threads=2 --events=0 --time=1 \
+  >   --worker-memory run 2>&1 | sed -n '/^Per-worker memory/,/^$/p'
+  Per-worker memory (2 threads):
+      Lua heap:                            *.* KiB avg, *.* KiB max (glob)
+      thread stack:                        64.0 KiB
+      C heap (drivers and other):          *.* KiB (glob)
+      total:                               *.* KiB per worker, *.* MiB for all workers (glob)
+  
+
+Lean workers use less Lua heap, but errors have no line numbers
+
+  $ heap() {
+  >   sysbench $CRAMTMP/memory.lua --events=1 --worker-memory "$@" run 2>&1 |
+  >     sed -n 's/^ *Lua heap: *\([0-9]*\)\..*/\1/p'
+  > }
+  $ normal=$(heap)
+  $ lean=$(heap --lean-workers)
+  $ test "$lean" -lt "$normal" || echo "lean: $lean KiB, normal: $normal KiB"
+
+  $ sysbench $CRAMTMP/memory.lua --events=1 run 2>&1 | grep 'event failed'
+  FATAL: `thread_run' function failed: */memory.lua:6: event failed (glob)
+  $ sysbench $CRAMTMP/memory.lua --events=1 --lean-workers run 2>&1 |
+  >   grep 'event failed'
+  FATAL: `thread_run' function failed: [string "*/memory.lua"]:0: event failed (glob)
@@ -0,0 +1,112 @@
+########################################################################
+Native test plugins
+########################################################################
+
+  $ sysbench nonexistent.so run 2>&1 | grep FATAL
+  FATAL: Cannot load plugin 'nonexistent.so': * (glob)
+
+  $ inc="$SBTEST_INCDIR/../../src"
+  $ if ! command -v cc >/dev/null || [ ! -r "$inc/sysbench_plugin.h" ]
+  > then
+  >   exit 80
+  > fi
+
+  $ cat > spin.c <<EOF
+  > #include "sysbench_plugin.h"
+  > 
+  > static int spins;
+  > static int spin_count;
+  > static sb_plugin_histogram_t *values;
+  > 
+  > static int spin_init(void)
+  > {
+  >   spins = sb_plugin_opt_int("spins");
+  >   if (spins < 0)
+  >   {
+  >     sb_plugin_log_fatal("Invalid value for --spins: %d", spins);
+  >     return 1;
+  >   }
+  >   spin_count = sb_plugin_counter("spins");
+  >   values = sb_plugin_histogram("values");
+  >   return 0;
+  > }
+  > 
+  > static void spin_print_mode(void)
+  > {
+  >   sb_plugin_log("Spinning %d times per event", spins);
+  > }
+  > 
+  > static int spin_event(int thread_id)
+  > {
+  >   volatile int x = 0;
+  >   for (int i = 0; i < spins; i++)
+  >     x += i;
+  >   sb_plugin_counter_add(thread_id, spin_count, spins);
+  >   sb_plugin_histogram_update(values, sb_plugin_rand_uniform(5, 5));
+  >   return 0;
+  > }
+  > 
+  > static const sb_plugin_arg_t spin_args[] = {
+  >   {"spins", "loop iterations per event", "100", SB_PLUGIN_ARG_INT},
+  >   {0}
+  > };
+  > 
+  > sb_plugin_test_t sb_plugin_test = {
+  >   .abi_version = SB_PLUGIN_ABI_VERSION,
+  >   .name = "spin",
+  >   .description = "Busy loop",
+  >   .args = spin_args,
+  >   .init = spin_init,
+  >   .print_mode = spin_print_mode,
+  >   .event = spin_event
+  > };
+  > EOF
+  $ cc -shared -fPIC -I"$inc" -o spin.so spin.c
+
+  $ sysbench spin.so help
+  sysbench * (glob)
+  
+  spin options:
+    --spins=N loop iterations per event [100]
+  
+
+  $ sysbench spin.so
+  sysbench * (glob)
+  
+  The 'spin.so' test requires a command argument. See 'sysbench spin.so help'
+  [1]
+
+  $ sysbench spin.so prepare
+  sysbench * (glob)
+  
+  'spin' test does not implement the 'prepare' command.
+  [1]
+
+  $ sysbench spin.so --spins=-1 run 2>&1 | grep FATAL
+  FATAL: Invalid value for --spins: -1
+
+  $ sysbench ./spin.so --threads=2 --events=1000 --spins=10 run |
+  >   grep -E '(Spinning|total number of events|spins:|Histogram|percentile)'
+  Spinning 10 times per event
+      total number of events:              1000
+           95.00th percentile:                     0.00 (glob)
+      spins:                               10000  (* per sec.) (glob)
+  Histogram values (ms):
+           95.00th percentile:                     5.0* (glob)
+
+Plugins must match the ABI version and define an event callback
+
+  $ sed -e 's/SB_PLUGIN_ABI_VERSION,/SB_PLUGIN_ABI_VERSION + 1,/' spin.c > v2.c
+  $ cc -shared -fPIC -I"$inc" -o v2.so v2.c
+  $ sysbench v2.so run 2>&1 | grep FATAL
+  FATAL: Plugin 'v2.so' was built for plugin ABI version 2, but this sysbench version supports 1
+
+  $ sed -e 's/  .event = spin_event/  .event = 0/' spin.c > noevent.c
+  $ cc -shared -fPIC -I"$inc" -o noevent.so noevent.c
+  $ sysbench noevent.so run 2>&1 | grep FATAL
+  FATAL: Plugin 'noevent.so' does not define an event callback
+
+  $ echo 'int x;' > nosym.c
+  $ cc -shared -fPIC -o nosym.so nosym.c
+  $ sysbench nosym.so run 2>&1 | grep FATAL
+  FATAL: Plugin 'nosym.so' does not define 'sb_plugin_test'
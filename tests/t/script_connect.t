@@ -0,0 +1,60 @@
+########################################################################
+connect.lua and --db-connect-stats tests
+########################################################################
+
+  $ if [ -n "$SBTEST_HAS_PGSQL" ]
+  > then
+  >   DRIVER=pgsql
+  > elif [ -n "$SBTEST_HAS_MYSQL" ]
+  > then
+  >   DRIVER=mysql
+  > else
+  >   exit 80
+  > fi
+
+  $ SB_ARGS="${SBTEST_SCRIPTDIR}/connect.lua --db-driver=$DRIVER --db-dry-run --db-connect-stats --events=20 --threads=2"
+
+  $ for mode in connect reconnect reset
+  > do
+  >   sysbench $SB_ARGS --connect_mode=$mode run | grep -E '^ +(read|reconnects|connects|session resets|failed):'
+  > done
+          read:                            20
+      reconnects:                          0      (0.00 per sec.)
+          connects:                        20     (* per sec.) (glob)
+          session resets:                  0      (0.00 per sec.)
+          failed:                          0      (0.00 per sec.)
+          read:                            20
+      reconnects:                          20     (* per sec.) (glob)
+          connects:                        2      (* per sec.) (glob)
+          session resets:                  0      (0.00 per sec.)
+          failed:                          0      (0.00 per sec.)
+          read:                            20
+      reconnects:                          0      (0.00 per sec.)
+          connects:                        2      (* per sec.) (glob)
+          session resets:                  20     (* per sec.) (glob)
+          failed:                          0      (0.00 per sec.)
+
+  $ sysbench $SB_ARGS --connect_mode=reset --connect_query= run | grep -E '^ +(total|session resets):'
+          total:                           0
+          session resets:                  20     (* per sec.) (glob)
+
+  $ sysbench $SB_ARGS --connect_mode=foo run 2>&1 | grep -m 1 Invalid
+  FATAL: `thread_init' function failed: */connect.lua:*: Invalid value for --connect_mode: foo (glob)
+
+########################################################################
+# --reconnect_every with OLTP scripts
+########################################################################
+
+  $ OLTP_ARGS="${SBTEST_SCRIPTDIR}/oltp_point_select.lua --db-driver=$DRIVER --db-dry-run --db-connect-stats --events=20 --threads=2 --reconnect_every=3"
+
+  $ sysbench $OLTP_ARGS run | grep -E '^ +(read|reconnects|connects|session resets):'
+          read:                            20
+      reconnects:                          6      (* per sec.) (glob)
+          connects:                        2      (* per sec.) (glob)
+          session resets:                  0      (0.00 per sec.)
+
+  $ sysbench $OLTP_ARGS --reconnect_mode=reset run | grep -E '^ +(read|reconnects|connects|session resets):'
+          read:                            20
+      reconnects:                          0      (0.00 per sec.)
+          connects:                        2      (* per sec.) (glob)
+          session resets:                  6      (* per sec.) (glob)
@@ -0,0 +1,49 @@
+########################################################################
+job_queue.lua + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+  $ command -v sqlite3 >/dev/null || exit 80
+
+  $ DB=$CRAMTMP/sbtest.db
+  $ ARGS="${SBTEST_SCRIPTDIR}/job_queue.lua ${DB_DRIVER_ARGS} --verbosity=1"
+
+Consumers complete the backlog and jobs enqueued during the run
+
+  $ sysbench $ARGS --jq_backlog=100 prepare >/dev/null
+  $ sqlite3 $DB "SELECT COUNT(*), SUM(done) FROM sbtest_jobs"
+  100|0
+
+  $ sysbench $ARGS --threads=2 --jq_producers=0 --events=50 \
+  >   --jq_dequeue_batch=2 run
+  $ sqlite3 $DB "SELECT COUNT(*) FROM sbtest_jobs"
+  0
+
+  $ sysbench $ARGS --threads=3 --time=2 --jq_producer_rate=100 \
+  >   --verbosity=3 run > $CRAMTMP/jq.out
+  $ grep -E '^ *(enqueue|claim):' $CRAMTMP/jq.out | sort
+          claim:
+          enqueue:
+  $ grep -E '^ *(jq_|Histogram)' $CRAMTMP/jq.out
+      jq_enqueued:                         * (glob)
+      jq_completed:                        * (glob)
+      jq_empty_claims:                     * (glob)
+  Histogram job_latency (ms):
+
+Completed jobs are marked as done with --jq_complete=update
+
+  $ sysbench $ARGS --threads=2 --jq_producers=1 --events=100 \
+  >   --jq_claim=delete_returning --jq_complete=update run
+  $ sqlite3 $DB "SELECT COUNT(*) > 0, COUNT(*) = SUM(done) + \
+  >   (SELECT COUNT(*) FROM sbtest_jobs WHERE done = 0) FROM sbtest_jobs"
+  1|1
+
+  $ sysbench $ARGS --jq_producers=1 run 2>&1 | grep FATAL
+  FATAL: `thread_init' function failed: */job_queue.lua:*: --jq_producers must be less than --threads (glob)
+  FATAL: Threads initialization failed!
+
+  $ sysbench $ARGS --threads=2 --jq_claim=foo run 2>&1 | grep FATAL | uniq
+  FATAL: `thread_init' function failed: */job_queue.lua:*: Invalid value for --jq_claim: foo (glob)
+  FATAL: Threads initialization failed!
+
+  $ sysbench $ARGS cleanup >/dev/null
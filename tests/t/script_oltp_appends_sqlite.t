@@ -0,0 +1,27 @@
+########################################################################
+--appends and --rand-type=latest in OLTP scripts + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+  $ command -v sqlite3 >/dev/null || exit 80
+
+  $ DB=$CRAMTMP/sbtest.db
+  $ ARGS="${DB_DRIVER_ARGS} --table-size=100 --verbosity=1"
+
+New rows get consecutive ids shared by all threads
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_write_only.lua $ARGS prepare >/dev/null
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_write_only.lua $ARGS --appends=2 \
+  >   --delete_inserts=0 --rand-type=latest --events=50 --threads=2 run
+  $ sqlite3 $DB "SELECT COUNT(*), MIN(id), MAX(id) FROM sbtest1 WHERE id > 100"
+  100|101|200
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_write_only.lua $ARGS cleanup >/dev/null
+
+oltp_insert.lua appends rows with --rand-type=latest
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_insert.lua $ARGS prepare >/dev/null
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_insert.lua $ARGS --rand-type=latest \
+  >   --events=20 --threads=2 run
+  $ sqlite3 $DB "SELECT COUNT(*), MIN(id), MAX(id) FROM sbtest1 WHERE id > 100"
+  20|101|120
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_insert.lua $ARGS cleanup >/dev/null
@@ -0,0 +1,62 @@
+########################################################################
+oltp_blob.lua + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+  $ command -v sqlite3 >/dev/null || exit 80
+
+  $ DB=$CRAMTMP/sbtest.db
+  $ ARGS="${SBTEST_SCRIPTDIR}/oltp_blob.lua ${DB_DRIVER_ARGS} --table-size=100 --verbosity=1"
+
+Values have lengths in the given range and are generated by the driver
+
+  $ sysbench $ARGS --blob_min_size=1000 --blob_max_size=100000 prepare \
+  >   >/dev/null
+  $ sqlite3 $DB "SELECT COUNT(*), typeof(val), MIN(length(val)) >= 1000,
+  >   MAX(length(val)) <= 100000, COUNT(DISTINCT substr(val, 1, 8))
+  >   FROM sbtest1"
+  100|blob|1|1|100
+
+Updates replace values with new ones of random lengths
+
+  $ sysbench $ARGS --events=100 --threads=2 --blob_selects=2 \
+  >   --blob_min_size=10 --blob_max_size=10 run
+  $ sqlite3 $DB "SELECT COUNT(*) > 0, COUNT(*) < 100 FROM sbtest1
+  >   WHERE length(val) = 10"
+  1|1
+
+Values are generated into the query text without prepared statements
+
+  $ sysbench $ARGS --events=10 --db-ps-mode=disable --blob_updates=10 \
+  >   --blob_min_size=20 --blob_max_size=20 run
+  $ sqlite3 $DB "SELECT COUNT(*) > 0 FROM sbtest1 WHERE typeof(val) = 'text'
+  >   AND length(val) = 20"
+  1
+
+  $ sysbench $ARGS --blob_rand_type=foo run || true
+  FATAL: `thread_init' function failed: */oltp_blob.lua:*: Invalid value for --blob_rand_type: foo (glob)
+  FATAL: Threads initialization failed!
+
+  $ sysbench $ARGS cleanup >/dev/null
+
+Large values are not materialized in Lua
+
+  $ cat > $CRAMTMP/blob.lua <<EOF
+  > function event()
+  >   local con = sysbench.sql.driver():connect()
+  >   con:query("CREATE TABLE t(v BLOB)")
+  >   local st = con:prepare("INSERT INTO t VALUES (?)")
+  >   local v = st:bind_create(sysbench.sql.type.BLOB)
+  >   st:bind_param(v)
+  >   v:set(16 * 1024 * 1024)
+  >   st:execute()
+  >   v:set(nil)
+  >   st:execute()
+  >   print(collectgarbage("count") < 1024)
+  >   print(con:query_row("SELECT COUNT(*), SUM(length(v)) FROM t"))
+  >   con:query("DROP TABLE t")
+  > end
+  > EOF
+  $ sysbench $CRAMTMP/blob.lua ${DB_DRIVER_ARGS} --events=1 --verbosity=1 run
+  true
+  2\t16777216 (esc)
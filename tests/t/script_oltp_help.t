@@ -6,23 +6,42 @@ OLTP usage information test
   sysbench * (glob)
   
   oltp_read_write.lua options:
+    --align_ranges[=on|off]       Keep range SELECT queries on ids within a single partition with --partition_type=range, so that partition pruning limits them to one partition [off]
+    --appends=N                   Number of INSERT queries of new rows per transaction. New rows get consecutive ids above --table_size shared by all threads and are favored by reads with --rand-type=latest [0]
     --auto_inc[=on|off]           Use AUTO_INCREMENT column as Primary Key (for MySQL), or its alternatives in other DBMS. When disabled, use client-generated IDs [on]
+    --batch[=on|off]              Send all statements of a transaction in one group, i.e. in a single round trip if pipelining is enabled in the driver with --mysql-pipeline or --pgsql-pipeline. Statements are prepared up front. Ignored with --skip_trx [off]
     --create_secondary[=on|off]   Create a secondary index in addition to the PRIMARY KEY [on]
     --create_table_options=STRING Extra CREATE TABLE options []
+    --cross_partition_pct=N       Percentage of accesses to random rows or tables outside the thread's partition with --key_partitioning [0]
+    --defer_secondary[=on|off]    Create secondary indexes in prepare after all tables are loaded rather than after each table. Always the case for tables loaded by several threads, i.e. with --threads > --tables [off]
     --delete_inserts=N            Number of DELETE/INSERT combinations per transaction [1]
     --distinct_ranges=N           Number of SELECT DISTINCT queries per transaction [1]
     --index_updates=N             Number of UPDATE index queries per transaction [1]
+    --k_covering[=on|off]         Select only k in --k_ranges and --k_in_lists queries, so they are served from the secondary index alone. When disabled, c is selected, which takes a lookup of each matching row [on]
+    --k_in_list_size=N            Number of values in the IN lists of --k_in_lists queries [10]
+    --k_in_lists=N                Number of SELECT queries per transaction looking up lists of --k_in_list_size values in the secondary index on k [0]
+    --k_order=STRING              Order of rows returned by --k_ranges and --k_in_lists queries: 'none', 'asc' or 'desc', which scans the secondary index backwards [none]
+    --k_ranges=N                  Number of SELECT queries per transaction scanning --range_size wide ranges of the secondary index on k [0]
+    --key_partitioning=STRING     Split rows between threads to access mostly disjoint data: 'none' for no partitioning, 'thread' to split the id range of each table, 'table' to split the set of tables [none]
+    --key_partitions=N            Number of partitions with --key_partitioning, threads are assigned to them round-robin. 0 for one partition per thread [0]
     --mysql_storage_engine=STRING Storage engine, if MySQL is used [innodb]
     --non_index_updates=N         Number of UPDATE non-index queries per transaction [1]
     --order_ranges=N              Number of SELECT ORDER BY queries per transaction [1]
+    --partition_type=STRING       Partitioning of tables by id with --partitions: 'hash', 'range' with the same number of rows up to --table_size in each partition, or 'list' by id modulo --partitions (MySQL only) [hash]
+    --partitions=N                Number of partitions of each table created by prepare with MySQL or PostgreSQL, 0 for non-partitioned tables [0]
     --pgsql_variant=STRING        Use this PostgreSQL variant when running with the PostgreSQL driver. The only currently supported variant is 'redshift'. When enabled, create_secondary is automatically disabled, and delete_inserts is set to 0
     --point_selects=N             Number of point SELECT queries per transaction [10]
     --range_selects[=on|off]      Enable/disable all range SELECT queries [on]
     --range_size=N                Range size for range SELECT queries [100]
+    --reconnect_every=N           Reestablish the database session after every N events as set by --reconnect_mode, 0 to keep the same session [0]
+    --reconnect_mode=STRING       How sessions are reestablished with --reconnect_every: 'reconnect' makes a new connection, 'reset' resets session state of the existing one [reconnect]
+    --resume[=on|off]             Keep existing tables in prepare and only load rows missing up to --table_size, e.g. to continue an interrupted prepare with the same --threads or to grow tables to a larger --table_size [off]
     --secondary[=on|off]          Use a secondary index in place of the PRIMARY KEY [off]
     --simple_ranges=N             Number of simple range SELECT queries per transaction [1]
     --skip_trx[=on|off]           Don't start explicit transactions and execute all queries in the AUTOCOMMIT mode [off]
+    --stmt_cache_size=N           Maximum number of prepared statements per connection. Statements are prepared on first use, the least recently used one is closed to make room for a new one. 0 means no limit [0]
     --sum_ranges=N                Number of SELECT SUM() queries per transaction [1]
     --table_size=N                Number of rows per table [10000]
     --tables=N                    Number of tables [1]
+    --tx_mix=STRING               Weighted mix of transaction types, e.g. 'point_select:70,index_update:20,delete_insert:10'. Each event executes a single transaction of a type chosen by weight, with the number of statements set by the corresponding option, e.g. --point_selects. Types are point_select, simple_range, sum_range, order_range, distinct_range, k_range, k_in_list, index_update, non_index_update, delete_insert and append. Empty to execute the script's own transaction []
   
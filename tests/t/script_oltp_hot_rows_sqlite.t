@@ -0,0 +1,40 @@
+########################################################################
+oltp_hot_rows.lua + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+  $ command -v sqlite3 >/dev/null || exit 80
+
+  $ DB=$CRAMTMP/sbtest.db
+  $ ARGS="${SBTEST_SCRIPTDIR}/oltp_hot_rows.lua ${DB_DRIVER_ARGS} --table-size=100 --verbosity=1"
+
+  $ sysbench $ARGS prepare >/dev/null
+  $ sqlite3 $DB "UPDATE sbtest1 SET k = 50 WHERE id <= 10"
+
+Only the hot row is updated, restarted transactions are rolled back
+
+  $ sysbench $ARGS --events=100 --threads=2 run
+  $ sqlite3 $DB "SELECT id, k FROM sbtest1 WHERE id <= 2"
+  1|150
+  2|50
+
+Stock is never decremented below 0
+
+  $ sysbench $ARGS --events=1000 --hot_mode=inventory --hot_rows=10 \
+  >   --hot_rand_type=zipfian run
+  $ sqlite3 $DB "SELECT COUNT(*) FROM sbtest1 WHERE k < 0"
+  0
+  $ sqlite3 $DB "SELECT k FROM sbtest1 WHERE id = 1"
+  0
+
+  $ sysbench $ARGS --hot_mode=queue run || true
+  FATAL: `thread_init' function failed: */oltp_hot_rows.lua:*: Invalid value for --hot_mode: queue (glob)
+  FATAL: Threads initialization failed!
+  $ sysbench $ARGS --hot_rows=101 run || true
+  FATAL: `thread_init' function failed: */oltp_hot_rows.lua:*: --hot_rows must be between 1 and --table_size (glob)
+  FATAL: Threads initialization failed!
+  $ sysbench $ARGS --hot_lock=for_update --skip_trx run || true
+  FATAL: `thread_init' function failed: */oltp_hot_rows.lua:*: --hot_lock cannot be used with --skip_trx (glob)
+  FATAL: Threads initialization failed!
+
+  $ sysbench $ARGS cleanup >/dev/null
@@ -0,0 +1,37 @@
+########################################################################
+oltp_htap.lua + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+
+  $ ARGS="${SBTEST_SCRIPTDIR}/oltp_htap.lua ${DB_DRIVER_ARGS} --table-size=100 --verbosity=1"
+
+  $ sysbench $ARGS prepare >/dev/null
+
+Analytic queries and OLTP transactions with and without concurrent queries
+are reported separately
+
+  $ sysbench $ARGS --verbosity=3 --threads=2 --analytic_threads=1 \
+  >   --events=20 run | grep -E '^        [a-z_]+:$' | sort
+          analytic:
+          oltp_alone:
+          oltp_concurrent:
+
+Without analytic threads all transactions run alone
+
+  $ sysbench $ARGS --verbosity=3 --analytic_threads=0 --events=10 run |
+  >   sed -n '/^        oltp_alone:/,/transactions:/p'
+          oltp_alone:
+              transactions:                10     (* per sec.) (glob)
+
+  $ sysbench $ARGS --analytic_threads=1 --analytic_query=group_by \
+  >   --events=5 run
+
+  $ sysbench $ARGS --analytic_query=median run 2>&1 |
+  >   grep -o 'Invalid value.*'
+  Invalid value for --analytic_query: median
+  $ sysbench $ARGS --analytic_threads=2 run 2>&1 |
+  >   grep -o -- '--analytic_threads must.*'
+  --analytic_threads must be between 0 and --threads
+
+  $ sysbench $ARGS cleanup >/dev/null
@@ -0,0 +1,35 @@
+########################################################################
+oltp_insert.lua + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+  $ command -v sqlite3 >/dev/null || exit 80
+
+  $ DB=$CRAMTMP/sbtest.db
+  $ ARGS="${SBTEST_SCRIPTDIR}/oltp_insert.lua ${DB_DRIVER_ARGS} --verbosity=1"
+
+Client-generated ids are unique 64-bit values across threads
+
+  $ sysbench $ARGS --auto_inc=off prepare >/dev/null
+  $ sysbench $ARGS --auto_inc=off --events=1000 --threads=4 run
+  $ sqlite3 $DB "SELECT COUNT(DISTINCT id), MIN(id) < -4294967296, MAX(id) > 4294967296 FROM sbtest1"
+  1000|1|1
+  $ sysbench $ARGS cleanup >/dev/null
+
+Primary key generation strategies
+
+  $ for kt in sequential hashed snowflake uuid4 uuid7 ulid; do
+  >   sysbench $ARGS --key_type=$kt prepare >/dev/null
+  >   sysbench $ARGS --key_type=$kt --events=1000 --threads=4 run
+  >   echo "$kt: $(sqlite3 $DB "SELECT COUNT(DISTINCT id), MIN(typeof(id)), MIN(typeof(id) = 'integer' OR length(id) = 16) FROM sbtest1")"
+  >   sysbench $ARGS cleanup >/dev/null
+  > done
+  sequential: 1000|integer|1
+  hashed: 1000|integer|1
+  snowflake: 1000|integer|1
+  uuid4: 1000|blob|1
+  uuid7: 1000|blob|1
+  ulid: 1000|blob|1
+
+  $ sysbench $ARGS --key_type=bigint prepare 2>&1 | grep FATAL
+  FATAL: */oltp_insert.lua:*: Invalid value for --key_type: bigint (glob)
@@ -0,0 +1,35 @@
+########################################################################
+oltp_json.lua + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+  $ command -v sqlite3 >/dev/null || exit 80
+
+  $ DB=$CRAMTMP/sbtest.db
+  $ ARGS="${SBTEST_SCRIPTDIR}/oltp_json.lua ${DB_DRIVER_ARGS} --table-size=100 --verbosity=1"
+
+Rows are stored as documents with indexed fields and payloads of lengths in
+the given range
+
+  $ sysbench $ARGS --json_payload_min=10 --json_payload_max=20 prepare \
+  >   >/dev/null
+  $ sqlite3 $DB "SELECT COUNT(*), MIN(json_extract(doc, '\$.v')),
+  >   MIN(length(json_extract(doc, '\$.payload'))) >= 10,
+  >   MAX(length(json_extract(doc, '\$.payload'))) <= 20 FROM sbtest1"
+  100|0|1|1
+  $ sqlite3 $DB "SELECT name FROM sqlite_master WHERE type = 'index'
+  >   AND tbl_name = 'sbtest1' AND sql IS NOT NULL ORDER BY name"
+  k_1
+  tag_1
+
+Partial updates only change the updated fields
+
+  $ sysbench $ARGS --events=100 --threads=2 --json_index_updates=0 run
+  $ sqlite3 $DB "SELECT SUM(json_extract(doc, '\$.v')) FROM sbtest1"
+  100
+
+  $ sysbench $ARGS --json_payload_rand_type=foo run || true
+  FATAL: `thread_init' function failed: */oltp_json.lua:*: Invalid value for --json_payload_rand_type: foo (glob)
+  FATAL: Threads initialization failed!
+
+  $ sysbench $ARGS cleanup >/dev/null
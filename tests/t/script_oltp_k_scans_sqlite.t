@@ -0,0 +1,58 @@
+########################################################################
+Secondary index scans of oltp_*.lua with SQLite
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+
+  $ ARGS="${SBTEST_SCRIPTDIR}/oltp_read_only.lua ${DB_DRIVER_ARGS} --table-size=1000 --point_selects=0 --simple_ranges=0 --sum_ranges=0 --order_ranges=0 --distinct_ranges=0 --db-stmt-stats --verbosity=3"
+
+  $ sysbench $ARGS --verbosity=1 prepare >/dev/null
+
+  $ function queries() {
+  >   grep -E -A1 "^        (SELECT k|SELECT c FROM sbtest1 WHERE k|k_)"
+  > }
+
+Covering range scans in descending order and IN lists
+
+  $ sysbench $ARGS --events=10 --k_ranges=2 --k_in_lists=3 --k_in_list_size=4 \
+  >   --k_order=desc run | queries
+          SELECT k FROM sbtest1 WHERE k BETWEEN ? AND ? ORDER BY k DESC:
+              queries:                     0      (0.00 per sec.)
+  --
+          k_ranges:
+              queries:                     20     (* per sec.) (glob)
+  --
+          SELECT k FROM sbtest1 WHERE k IN (?, ?, ?, ?) ORDER BY k DESC:
+              queries:                     0      (0.00 per sec.)
+  --
+          k_in_lists:
+              queries:                     30     (* per sec.) (glob)
+
+Non-covering scans select c
+
+  $ sysbench $ARGS --events=10 --k_ranges=1 --k_covering=off --k_order=asc \
+  >   run | queries
+          SELECT c FROM sbtest1 WHERE k BETWEEN ? AND ? ORDER BY k:
+              queries:                     0      (0.00 per sec.)
+  --
+          k_ranges:
+              queries:                     10     (* per sec.) (glob)
+
+Both are transaction types of --tx_mix
+
+  $ sysbench $ARGS --events=10 --tx_mix=k_range:1,k_in_list:1 --k_ranges=1 \
+  >   --k_in_lists=1 run | grep -E -A1 "^        k_(range|in_list):"
+          k_range:
+              transactions:                * (glob)
+  --
+          k_in_list:
+              transactions:                * (glob)
+
+  $ sysbench $ARGS --k_order=up --verbosity=1 run || true
+  FATAL: `thread_init' function failed: */oltp_common.lua:*: Invalid value for --k_order: up (glob)
+  FATAL: Threads initialization failed!
+  $ sysbench $ARGS --k_in_list_size=0 --verbosity=1 run || true
+  FATAL: `thread_init' function failed: */oltp_common.lua:*: Invalid value for --k_in_list_size: 0 (glob)
+  FATAL: Threads initialization failed!
+
+  $ sysbench $ARGS --verbosity=1 cleanup >/dev/null
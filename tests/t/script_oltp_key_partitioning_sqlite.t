@@ -0,0 +1,60 @@
+########################################################################
+--key_partitioning tests with SQLite
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+  $ command -v sqlite3 >/dev/null || exit 80
+
+  $ DB=$CRAMTMP/sbtest.db
+  $ ARGS="${SBTEST_SCRIPTDIR}/oltp_update_index.lua ${DB_DRIVER_ARGS} --tables=4 --table-size=100 --rand-type=uniform --verbosity=1"
+
+  $ sysbench $ARGS prepare >/dev/null
+
+Count updated rows per table and quarter of the id range
+
+  $ function snapshot() {
+  >   for t in 1 2 3 4; do
+  >     sqlite3 $DB "DROP TABLE IF EXISTS snap$t;
+  >                  CREATE TABLE snap$t AS SELECT id, k FROM sbtest$t"
+  >   done
+  > }
+  $ function updated() {
+  >   for t in 1 2 3 4; do
+  >     sqlite3 $DB "SELECT $t, COUNT(*) FROM sbtest$t s JOIN snap$t USING (id)
+  >                  WHERE s.k <> snap$t.k GROUP BY (id - 1) / 25" |
+  >       tr '\n' ' '
+  >   done
+  >   echo
+  > }
+
+  $ snapshot
+  $ sysbench $ARGS --threads=1 --events=200 --key_partitioning=thread \
+  >   --key_partitions=4 run
+  $ updated | sed 's/|[0-9]*/|*/g'
+  1|* 2|* 3|* 4|* 
+
+  $ snapshot
+  $ sysbench $ARGS --threads=1 --events=200 --key_partitioning=table \
+  >   --key_partitions=2 run
+  $ updated | sed 's/|[0-9]*/|*/g'
+  1|* 1|* 1|* 1|* 3|* 3|* 3|* 3|* 
+
+All tables and rows are accessed with 100% cross-partition accesses
+
+  $ snapshot
+  $ sysbench $ARGS --threads=1 --events=1000 --key_partitioning=table \
+  >   --key_partitions=2 --cross_partition_pct=100 run
+  $ updated | sed 's/|[0-9]*/|*/g'
+  1|* 1|* 1|* 1|* 2|* 2|* 2|* 2|* 3|* 3|* 3|* 3|* 4|* 4|* 4|* 4|* 
+
+  $ sysbench $ARGS --key_partitioning=range run || true
+  FATAL: `thread_init' function failed: */oltp_common.lua:*: Invalid value for --key_partitioning: range (glob)
+  FATAL: Threads initialization failed!
+  $ sysbench $ARGS --key_partitioning=table --key_partitions=5 run || true
+  FATAL: `thread_init' function failed: */oltp_common.lua:*: --key_partitioning=table requires at most --tables partitions (glob)
+  FATAL: Threads initialization failed!
+  $ sysbench $ARGS --key_partitioning=thread --cross_partition_pct=101 run || true
+  FATAL: `thread_init' function failed: */oltp_common.lua:*: Invalid value for --cross_partition_pct: 101 (glob)
+  FATAL: Threads initialization failed!
+
+  $ sysbench $ARGS cleanup >/dev/null
@@ -0,0 +1,58 @@
+########################################################################
+--native OLTP events + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+
+  $ ARGS="${DB_DRIVER_ARGS} --tables=2 --table-size=100 --verbosity=3"
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_write.lua $ARGS prepare >/dev/null
+
+Native events execute the same queries as the scripts
+
+  $ for s in oltp_point_select oltp_read_only oltp_read_write
+  > do
+  >   for native in off on
+  >   do
+  >     sysbench $SBTEST_SCRIPTDIR/$s.lua $ARGS --native=$native --events=100 \
+  >       run | awk '/(read|write|other|total):/ { printf "%s %s ", $1, $2 }'
+  >     echo
+  >   done
+  > done
+  read: 100 write: 0 other: 0 total: 100 
+  read: 100 write: 0 other: 0 total: 100 
+  read: 1400 write: 0 other: 200 total: 1600 
+  read: 1400 write: 0 other: 200 total: 1600 
+  read: 1400 write: 400 other: 200 total: 2000 
+  read: 1400 write: 400 other: 200 total: 2000 
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_only.lua $ARGS --native --events=10 \
+  >   --skip_trx --range_selects=off --point_selects=3 --db-stmt-stats run |
+  >   grep -A1 ' point_selects:'
+          point_selects:
+              queries:                     30     (* per sec.) (glob)
+
+Scripts and options without native events are rejected
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_insert.lua $ARGS --native run 2>&1 |
+  >   grep FATAL
+  FATAL: --native is only supported with oltp_point_select, oltp_read_only and oltp_read_write
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_write.lua $ARGS --native \
+  >   --tx_mix=point_select:1 --events=1 run 2>&1 | grep FATAL
+  FATAL: --native does not support --tx_mix
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_only.lua $ARGS --native --k_ranges=1 \
+  >   --events=1 run 2>&1 | grep FATAL
+  FATAL: --native does not support --k_ranges
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_only.lua $ARGS --native --validate \
+  >   --events=1 run 2>&1 | grep FATAL
+  FATAL: --native cannot be used with --validate or --virtual-users
+
+Other commands are still implemented by the scripts
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_write.lua $ARGS --native cleanup
+  sysbench * (glob)
+  
+  Dropping table 'sbtest1'...
+  Dropping table 'sbtest2'...
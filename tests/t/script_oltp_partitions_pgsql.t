@@ -0,0 +1,44 @@
+########################################################################
+--partitions tests with PostgreSQL
+########################################################################
+
+  $ . $SBTEST_INCDIR/pgsql_common.sh
+
+  $ ARGS="${SBTEST_SCRIPTDIR}/oltp_read_only.lua ${DB_DRIVER_ARGS} --table-size=10000 --verbosity=1"
+
+  $ function partitions() {
+  >   psql -qtA sbtest -c "SELECT c.relname, COUNT(s.id) FROM pg_inherits i
+  >     JOIN pg_class c ON c.oid = i.inhrelid
+  >     LEFT JOIN sbtest1 s ON s.tableoid = c.oid
+  >     WHERE i.inhparent = 'sbtest1'::regclass GROUP BY 1 ORDER BY 1"
+  > }
+
+Range partitions hold the same number of rows and are loaded by separate
+threads
+
+  $ sysbench $ARGS --partitions=4 --partition_type=range --threads=4 prepare |
+  >   grep Creating
+  Creating table 'sbtest1' with 4 range partitions...
+  Creating a secondary index on 'sbtest1'...
+  $ partitions
+  sbtest1_p0|2500
+  sbtest1_p1|2500
+  sbtest1_p2|2500
+  sbtest1_p3|2500
+
+Range queries are kept within a single partition
+
+  $ sysbench $ARGS --partitions=4 --partition_type=range --align_ranges \
+  >   --events=100 run
+  $ sysbench $ARGS cleanup >/dev/null
+
+  $ sysbench $ARGS --partitions=3 --partition_type=hash prepare >/dev/null
+  $ partitions | cut -d'|' -f1
+  sbtest1_p0
+  sbtest1_p1
+  sbtest1_p2
+  $ sysbench $ARGS --events=100 run
+  $ sysbench $ARGS cleanup >/dev/null
+
+  $ sysbench $ARGS --partitions=3 --partition_type=list prepare || true
+  FATAL: `sysbench.cmdline.call_command' function failed: */oltp_common.lua:*: --partition_type=list is not supported with PostgreSQL (glob)
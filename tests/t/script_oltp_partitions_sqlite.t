@@ -0,0 +1,26 @@
+########################################################################
+--partitions tests with SQLite
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+
+  $ ARGS="${SBTEST_SCRIPTDIR}/oltp_read_only.lua ${DB_DRIVER_ARGS} --table-size=100 --verbosity=1"
+
+Partitioned tables are only created with MySQL and PostgreSQL
+
+  $ sysbench $ARGS --partitions=4 prepare || true
+  FATAL: `sysbench.cmdline.call_command' function failed: */oltp_common.lua:*: --partitions is only supported with MySQL and PostgreSQL (glob)
+
+  $ sysbench $ARGS prepare >/dev/null
+
+  $ sysbench $ARGS --partitions=-1 --events=1 run || true
+  FATAL: `thread_init' function failed: */oltp_common.lua:*: Invalid value for --partitions: -1 (glob)
+  FATAL: Threads initialization failed!
+  $ sysbench $ARGS --partition_type=key --events=1 run || true
+  FATAL: `thread_init' function failed: */oltp_common.lua:*: Invalid value for --partition_type: key (glob)
+  FATAL: Threads initialization failed!
+  $ sysbench $ARGS --align_ranges --events=1 run || true
+  FATAL: `thread_init' function failed: */oltp_common.lua:*: --align_ranges requires --partitions with --partition_type=range (glob)
+  FATAL: Threads initialization failed!
+
+  $ sysbench $ARGS cleanup >/dev/null
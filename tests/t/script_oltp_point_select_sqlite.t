@@ -0,0 +1,243 @@
+########################################################################
+oltp_point_select.lua + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+  $ OLTP_SCRIPT_PATH=${SBTEST_SCRIPTDIR}/oltp_point_select.lua
+  $ . $SBTEST_INCDIR/script_oltp_common.sh
+  sysbench *.* * (glob)
+  
+  Creating table 'sbtest1'...
+  Inserting 10000 records into 'sbtest1'
+  Creating a secondary index on 'sbtest1'...
+  Creating table 'sbtest2'...
+  Inserting 10000 records into 'sbtest2'
+  Creating a secondary index on 'sbtest2'...
+  Creating table 'sbtest3'...
+  Inserting 10000 records into 'sbtest3'
+  Creating a secondary index on 'sbtest3'...
+  Creating table 'sbtest4'...
+  Inserting 10000 records into 'sbtest4'
+  Creating a secondary index on 'sbtest4'...
+  Creating table 'sbtest5'...
+  Inserting 10000 records into 'sbtest5'
+  Creating a secondary index on 'sbtest5'...
+  Creating table 'sbtest6'...
+  Inserting 10000 records into 'sbtest6'
+  Creating a secondary index on 'sbtest6'...
+  Creating table 'sbtest7'...
+  Inserting 10000 records into 'sbtest7'
+  Creating a secondary index on 'sbtest7'...
+  Creating table 'sbtest8'...
+  Inserting 10000 records into 'sbtest8'
+  Creating a secondary index on 'sbtest8'...
+  CREATE TABLE sbtest1(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_1 ON sbtest1(k)
+  CREATE TABLE sbtest2(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_2 ON sbtest2(k)
+  CREATE TABLE sbtest3(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_3 ON sbtest3(k)
+  CREATE TABLE sbtest4(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_4 ON sbtest4(k)
+  CREATE TABLE sbtest5(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_5 ON sbtest5(k)
+  CREATE TABLE sbtest6(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_6 ON sbtest6(k)
+  CREATE TABLE sbtest7(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_7 ON sbtest7(k)
+  CREATE TABLE sbtest8(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_8 ON sbtest8(k)
+  Did not find any relation named "sbtest9".
+  sysbench *.* * (glob)
+  
+  FATAL: *: warmup is currently MySQL only (glob)
+  sysbench *.* * (glob)
+  
+  Dropping table 'sbtest1'...
+  Dropping table 'sbtest2'...
+  Dropping table 'sbtest3'...
+  Dropping table 'sbtest4'...
+  Dropping table 'sbtest5'...
+  Dropping table 'sbtest6'...
+  Dropping table 'sbtest7'...
+  Dropping table 'sbtest8'...
+  CREATE TABLE sbtest1(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_1 ON sbtest1(k)
+  CREATE TABLE sbtest2(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_2 ON sbtest2(k)
+  CREATE TABLE sbtest3(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_3 ON sbtest3(k)
+  CREATE TABLE sbtest4(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_4 ON sbtest4(k)
+  CREATE TABLE sbtest5(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_5 ON sbtest5(k)
+  CREATE TABLE sbtest6(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_6 ON sbtest6(k)
+  CREATE TABLE sbtest7(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_7 ON sbtest7(k)
+  CREATE TABLE sbtest8(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  CREATE INDEX k_8 ON sbtest8(k)
+  Did not find any relation named "sbtest9".
+  sysbench *.* * (glob)
+  
+  Running the test with following options:
+  Number of threads: 2
+  Initializing random number generator from current time
+  
+  
+  Initializing worker threads...
+  
+  Threads started!
+  
+  SQL statistics:
+      queries performed:
+          read:                            100
+          write:                           0
+          other:                           0
+          total:                           100
+      transactions:                        100    (* per sec.) (glob)
+      queries:                             100    (* per sec.) (glob)
+      ignored errors:                      0      (* per sec.) (glob)
+      reconnects:                          0      (* per sec.) (glob)
+  
+  Throughput:
+      events/s (eps): *.* (glob)
+      time elapsed:                        *s (glob)
+      total number of events:              100
+  
+  Latency (ms):
+           min:                                    *.* (glob)
+           avg:                                    *.* (glob)
+           max:                                    *.* (glob)
+           95.00th percentile:                     *.* (glob)
+  
+           sum:                                    *.* (glob)
+  
+  Threads fairness:
+      events (avg/stddev):           *.*/*.* (glob)
+      execution time (avg/stddev):   *.*/*.* (glob)
+  
+  Did not find any relation named "sbtest1".
+  Did not find any relation named "sbtest2".
+  Did not find any relation named "sbtest3".
+  Did not find any relation named "sbtest4".
+  Did not find any relation named "sbtest5".
+  Did not find any relation named "sbtest6".
+  Did not find any relation named "sbtest7".
+  Did not find any relation named "sbtest8".
+  # Test --create-secondary=off
+  sysbench *.* * (glob)
+  
+  Creating table 'sbtest1'...
+  Inserting 10000 records into 'sbtest1'
+  CREATE TABLE sbtest1(
+    id INTEGER NOT NULL,
+    k INTEGER DEFAULT '0' NOT NULL,
+    c CHAR(120) DEFAULT '' NOT NULL,
+    pad CHAR(60) DEFAULT '' NOT NULL,
+    PRIMARY KEY (id)
+  )
+  sysbench *.* * (glob)
+  
+  Dropping table 'sbtest1'...
+  # Test --auto-inc=off
+  Creating table 'sbtest1'...
+  Inserting 10000 records into 'sbtest1'
+  Creating a secondary index on 'sbtest1'...
+  Dropping table 'sbtest1'...
@@ -0,0 +1,67 @@
+########################################################################
+--resume in OLTP scripts + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+  $ command -v sqlite3 >/dev/null || exit 80
+
+  $ DB=$CRAMTMP/sbtest.db
+  $ ARGS="${DB_DRIVER_ARGS} --tables=2 --table-size=100 --auto-inc=off"
+
+Without --resume, existing tables are an error
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_only.lua $ARGS prepare >/dev/null
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_only.lua $ARGS prepare 2>&1 |
+  >   grep -q 'already exists' && echo error
+  error
+
+An interrupted prepare is continued from the maximum id
+
+  $ sqlite3 $DB "DELETE FROM sbtest1 WHERE id > 40"
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_only.lua $ARGS --resume prepare
+  sysbench * (glob)
+  
+  Using existing table 'sbtest1'...
+  Inserting records 41 to 100 into 'sbtest1'
+  Using existing table 'sbtest2'...
+  $ sqlite3 $DB "SELECT COUNT(*), MIN(id), MAX(id) FROM sbtest1"
+  100|1|100
+
+Tables are grown to a larger --table-size, also when loaded by several threads
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_only.lua $ARGS --table-size=150 \
+  >   --threads=4 --resume prepare |
+  >   grep -o "Inserting records [0-9]* to [0-9]* into 'sbtest[0-9]*'" | sort
+  Inserting records 101 to 150 into 'sbtest1'
+  Inserting records 101 to 150 into 'sbtest2'
+  $ sqlite3 $DB "SELECT COUNT(*), MIN(id), MAX(id) FROM sbtest1"
+  150|1|150
+  $ sqlite3 $DB "SELECT COUNT(*), MIN(id), MAX(id) FROM sbtest2"
+  150|1|150
+
+Missing tables are created
+
+  $ sqlite3 $DB "DROP TABLE sbtest2"
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_only.lua $ARGS --resume prepare
+  sysbench * (glob)
+  
+  Using existing table 'sbtest1'...
+  Creating table 'sbtest2'...
+  Inserting 100 records into 'sbtest2'
+  Creating a secondary index on 'sbtest2'...
+
+Rows with database-generated ids are counted
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_only.lua $ARGS cleanup >/dev/null
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_only.lua $ARGS --auto-inc=on \
+  >   --tables=1 prepare >/dev/null
+  $ sqlite3 $DB "DELETE FROM sbtest1 WHERE id > 70"
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_only.lua $ARGS --auto-inc=on \
+  >   --tables=1 --resume prepare
+  sysbench * (glob)
+  
+  Using existing table 'sbtest1'...
+  Inserting records 71 to 100 into 'sbtest1'
+  $ sqlite3 $DB "SELECT COUNT(*) FROM sbtest1"
+  100
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_only.lua $ARGS cleanup >/dev/null
@@ -0,0 +1,39 @@
+########################################################################
+--tx_mix in OLTP scripts + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+  $ command -v sqlite3 >/dev/null || exit 80
+
+  $ DB=$CRAMTMP/sbtest.db
+  $ ARGS="${DB_DRIVER_ARGS} --table-size=100 --verbosity=1"
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_write.lua $ARGS prepare >/dev/null
+
+Each event is a single transaction of a type chosen by weight, and types are
+reported separately
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_write.lua $ARGS --verbosity=3 \
+  >   --tx_mix=point_select:70,index_update:20,delete_insert:10 \
+  >   --events=100 --threads=2 run |
+  >   grep -E '^    (transactions|per-trans)|^        [a-z_]+:$'
+      transactions:                        100    (* per sec.) (glob)
+      per-transaction statistics:
+          point_select:
+          index_update:
+          delete_insert:
+
+Statements of other types are not executed
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_write.lua $ARGS --verbosity=3 \
+  >   --tx_mix=index_update:1 --events=10 run |
+  >   grep -E '^        (read|write):'
+          read:                            0
+          write:                           10
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_write.lua $ARGS \
+  >   --tx_mix=point_select:70,foo --events=10 run 2>&1 |
+  >   grep -o 'Invalid value.*'
+  Invalid value for --tx_mix: point_select:70,foo
+
+  $ sysbench $SBTEST_SCRIPTDIR/oltp_read_write.lua $ARGS cleanup >/dev/null
@@ -0,0 +1,52 @@
+########################################################################
+oltp_*.lua --validate tests with SQLite
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+  $ command -v sqlite3 >/dev/null || exit 80
+
+  $ DB=$CRAMTMP/sbtest.db
+  $ ARGS="${SBTEST_SCRIPTDIR}/oltp_read_write.lua ${DB_DRIVER_ARGS} --tables=2 --table-size=100 --validate --verbosity=3"
+
+  $ sysbench $ARGS prepare >/dev/null
+
+  $ function failures() {
+  >   sed -n '/^Validation failure/p; /validation_failures:/p'
+  > }
+
+Results match row counts, ordering and the SUM(k) of rows updated by each
+thread
+
+  $ sysbench $ARGS --threads=2 --events=200 run | failures
+      validation_failures:                 0      (0.00 per sec.)
+  $ sysbench $ARGS --threads=2 --events=200 --key_partitioning=thread \
+  >   --appends=1 run | failures
+      validation_failures:                 0      (0.00 per sec.)
+  $ sysbench $ARGS --threads=2 --events=200 --key_partitioning=table \
+  >   --appends=1 --rand-type=latest run | failures
+      validation_failures:                 0      (0.00 per sec.)
+
+Missing rows are reported, up to 10 per thread
+
+  $ sqlite3 $DB "DELETE FROM sbtest1; DELETE FROM sbtest2"
+  $ sysbench $ARGS --threads=1 --events=10 --range_selects=off \
+  >   --index_updates=0 --non_index_updates=0 --delete_inserts=0 run |
+  >   failures
+  Validation failure: point select of id * in sbtest* returned 0 rows (glob)
+  Validation failure: point select of id * in sbtest* returned 0 rows (glob)
+  Validation failure: point select of id * in sbtest* returned 0 rows (glob)
+  Validation failure: point select of id * in sbtest* returned 0 rows (glob)
+  Validation failure: point select of id * in sbtest* returned 0 rows (glob)
+  Validation failure: point select of id * in sbtest* returned 0 rows (glob)
+  Validation failure: point select of id * in sbtest* returned 0 rows (glob)
+  Validation failure: point select of id * in sbtest* returned 0 rows (glob)
+  Validation failure: point select of id * in sbtest* returned 0 rows (glob)
+  Validation failure: point select of id * in sbtest* returned 0 rows (glob)
+      validation_failures:                 100    (* per sec.) (glob)
+
+  $ sysbench ${SBTEST_SCRIPTDIR}/oltp_delete.lua ${DB_DRIVER_ARGS} --validate \
+  >   --verbosity=1 run || true
+  FATAL: `thread_init' function failed: */oltp_delete.lua:*: --validate is not supported by oltp_delete.lua (glob)
+  FATAL: Threads initialization failed!
+
+  $ sysbench $ARGS cleanup >/dev/null
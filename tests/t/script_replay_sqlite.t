@@ -0,0 +1,59 @@
+########################################################################
+replay.lua + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+
+  $ LOG=$CRAMTMP/replay.log
+  $ ARGS="${SBTEST_SCRIPTDIR}/replay.lua ${DB_DRIVER_ARGS} --replay_log=$LOG --replay_format=sysbench --replay_speed=0"
+
+  $ printf '0.0\t1\tCREATE TABLE t (id INTEGER, c TEXT)\n' > $LOG
+  $ printf '0.1\t1\tINSERT INTO t VALUES (1, \x27a\x27), (2, \x27b\x27)\n' >> $LOG
+  $ printf '0.2\t2\tSELECT c FROM t WHERE id = 1\n' >> $LOG
+  $ printf '0.3\t1\tSELECT c FROM t WHERE id = 2\n' >> $LOG
+  $ printf '0.4\t2\tSELECT c\\nFROM t WHERE id IN (1, 2)\n' >> $LOG
+  $ printf '0.5\t2\tSELECT * FROM missing\n' >> $LOG
+
+Queries are reported by fingerprint, failed ones as errors
+
+  $ sysbench $ARGS --db-stmt-stats --verbosity=3 run > $CRAMTMP/out
+  $ for q in "CREATE TABLE" "INSERT INTO" "id = ?" "IN (...)" "missing:"; do
+  >   grep -F -A2 "$q" $CRAMTMP/out
+  > done
+          CREATE TABLE t (id INTEGER, c TEXT):
+              queries:                     1 * (glob)
+              errors:                      0
+          INSERT INTO t VALUES (...):
+              queries:                     1 * (glob)
+              errors:                      0
+          SELECT c FROM t WHERE id = ?:
+              queries:                     2 * (glob)
+              errors:                      0
+          SELECT c FROM t WHERE id IN (...):
+              queries:                     1 * (glob)
+              errors:                      0
+          SELECT * FROM missing:
+              queries:                     1 * (glob)
+              errors:                      1
+
+Sessions are replayed by threads at their original times
+
+  $ rm -f $CRAMTMP/sbtest.db
+  $ sysbench $ARGS --replay_speed=1 --threads=2 --db-stmt-stats --verbosity=3 \
+  >   run | grep -E "time elapsed:|total number of events:|errors:"
+      ignored errors:                      1 * (glob)
+              errors:                      0
+              errors:                      0
+              errors:                      0
+              errors:                      0
+              errors:                      1
+      time elapsed:                        0.5*s (glob)
+      total number of events:              6
+
+  $ sysbench $ARGS --replay_format=foo --verbosity=1 run || true
+  FATAL: `thread_init' function failed: */replay.lua:*: Invalid value for --replay_format: foo (glob)
+  FATAL: Threads initialization failed!
+
+  $ sysbench ${SBTEST_SCRIPTDIR}/replay.lua ${DB_DRIVER_ARGS} --verbosity=1 run || true
+  FATAL: `thread_init' function failed: */replay.lua:*: --replay_log is required (glob)
+  FATAL: Threads initialization failed!
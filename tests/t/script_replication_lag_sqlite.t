@@ -0,0 +1,35 @@
+########################################################################
+replication_lag.lua + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+
+  $ ARGS="${SBTEST_SCRIPTDIR}/replication_lag.lua ${DB_DRIVER_ARGS} --lag_keys=10"
+
+  $ sysbench $ARGS prepare
+  sysbench * (glob)
+  
+  Creating table 'sbtest_lag'...
+  Inserting 10 records into 'sbtest_lag'
+
+Without replicas every update is visible to the next read
+
+  $ sysbench $ARGS --events=100 --verbosity=3 run |
+  >   sed -n '/^Counters:/,/^Histogram/p'
+  Counters:
+      lag_writes:                          100    (* per sec.) (glob)
+      lag_reads:                           0      (0.00 per sec.)
+      lag_stale_reads:                     0      (0.00 per sec.)
+      lag_timeouts:                        0      (0.00 per sec.)
+  
+  Histogram replication_lag (ms):
+
+  $ sysbench $ARGS --threads=2 --lag_writers=3 --verbosity=1 run || true
+  FATAL: `thread_init' function failed: */replication_lag.lua:*: --lag_writers must be between 1 and --threads (glob)
+  (last message repeated 1 times)
+  FATAL: Threads initialization failed!
+
+  $ sysbench $ARGS cleanup
+  sysbench * (glob)
+  
+  Dropping table 'sbtest_lag'...
@@ -0,0 +1,40 @@
+########################################################################
+timeseries.lua + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+  $ command -v sqlite3 >/dev/null || exit 80
+
+  $ DB=$CRAMTMP/sbtest.db
+  $ ARGS="${SBTEST_SCRIPTDIR}/timeseries.lua ${DB_DRIVER_ARGS} --ts_series=10 --verbosity=1"
+
+Prepare inserts points of all series up to the current time
+
+  $ sysbench $ARGS --ts_history=60 --ts_history_interval=2 prepare >/dev/null
+  $ sqlite3 $DB "SELECT COUNT(*), COUNT(DISTINCT series),
+  >   (MAX(ts) - MIN(ts)) / 1000000 FROM sbtest_ts"
+  300|10|58
+
+Ingest threads insert a point of each series per event, the purging thread
+deletes points older than the retention period
+
+  $ sysbench $ARGS --threads=3 --time=2 --ts_retention=30 \
+  >   --ts_purge_interval=1 --verbosity=3 run | grep -E '^ *(ts_|purge:)'
+          purge:
+      ts_rows:                             * (glob)
+      ts_purges:                           * (glob)
+  $ sqlite3 $DB "SELECT COUNT(DISTINCT series), COUNT(*) > 300,
+  >   MAX(ts) - MIN(ts) <= 32000000 FROM sbtest_ts"
+  10|1|1
+
+  $ sysbench $ARGS --events=10 --ts_read_type=aggregate --ts_readers=0 run
+
+  $ sysbench $ARGS --ts_readers=1 run 2>&1 | grep FATAL
+  FATAL: `thread_init' function failed: */timeseries.lua:*: --ts_readers must be between 0 and --threads - 1, or --threads - 2 with --ts_retention (glob)
+  FATAL: Threads initialization failed!
+
+  $ sysbench $ARGS --ts_purge=drop_partition run 2>&1 | grep FATAL
+  FATAL: `thread_init' function failed: */timeseries.lua:*: --ts_purge=drop_partition is not supported by sqlite (glob)
+  FATAL: Threads initialization failed!
+
+  $ sysbench $ARGS cleanup >/dev/null
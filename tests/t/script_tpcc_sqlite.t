@@ -0,0 +1,67 @@
+########################################################################
+tpcc.lua + SQLite tests
+########################################################################
+
+  $ . $SBTEST_INCDIR/sqlite_common.sh
+  $ command -v sqlite3 >/dev/null || exit 80
+
+  $ DB=$CRAMTMP/sbtest.db
+  $ ARGS="${DB_DRIVER_ARGS} --warehouses=2 --items=1000 --customers=100"
+
+Warehouses are loaded in parallel
+
+  $ sysbench $SBTEST_SCRIPTDIR/tpcc.lua $ARGS --threads=2 prepare \
+  >   >/dev/null
+  $ sqlite3 $DB "SELECT COUNT(*) FROM warehouse; SELECT COUNT(*) FROM district;
+  >   SELECT COUNT(*) FROM customer; SELECT COUNT(*) FROM history;
+  >   SELECT COUNT(*) FROM orders; SELECT COUNT(*) FROM new_orders;
+  >   SELECT COUNT(*) FROM item; SELECT COUNT(*) FROM stock;
+  >   SELECT (SELECT COUNT(*) FROM order_line) =
+  >     (SELECT SUM(o_ol_cnt) FROM orders)"
+  2
+  20
+  2000
+  2000
+  2000
+  600
+  1000
+  2000
+  1
+
+Transactions keep the data consistent and are reported by type
+
+  $ sysbench $SBTEST_SCRIPTDIR/tpcc.lua $ARGS --threads=2 --events=300 run |
+  >   grep -E '^    per-transaction|^        [A-Za-z]+:$'
+      per-transaction statistics:
+          NewOrder:
+          Payment:
+          OrderStatus:
+          Delivery:
+          StockLevel:
+  $ sqlite3 $DB "SELECT COUNT(*) FROM district WHERE d_next_o_id - 1 <>
+  >     (SELECT MAX(o_id) FROM orders WHERE o_w_id = d_w_id AND o_d_id = d_id);
+  >   SELECT COUNT(*) FROM orders WHERE o_ol_cnt <>
+  >     (SELECT COUNT(*) FROM order_line WHERE ol_w_id = o_w_id
+  >        AND ol_d_id = o_d_id AND ol_o_id = o_id);
+  >   SELECT (SELECT COUNT(*) FROM new_orders) =
+  >     (SELECT COUNT(*) FROM orders WHERE o_carrier_id IS NULL)"
+  0
+  0
+  1
+
+  $ sysbench $SBTEST_SCRIPTDIR/tpcc.lua $ARGS --mix=50,50 run 2>&1 |
+  >   grep -o 'Invalid value.*'
+  Invalid value for --mix: 50,50
+
+  $ sysbench $SBTEST_SCRIPTDIR/tpcc.lua $ARGS cleanup
+  sysbench * (glob)
+  
+  Dropping table 'warehouse'...
+  Dropping table 'district'...
+  Dropping table 'customer'...
+  Dropping table 'history'...
+  Dropping table 'orders'...
+  Dropping table 'new_orders'...
+  Dropping table 'order_line'...
+  Dropping table 'item'...
+  Dropping table 'stock'...
@@ -0,0 +1,111 @@
+########################################################################
+atomic benchmark tests
+########################################################################
+  $ args="atomic --events=10 --threads=2"
+  $ sysbench $args help
+  sysbench *.* * (glob)
+  
+  atomic options:
+    --atomic-oper=STRING  type of operations to perform {faa, cas, fas, load-store} [faa]
+    --atomic-scope=STRING counter placement {shared, padded, false-shared} [shared]
+    --atomic-ops=N        number of operations per event [1000]
+  
+  $ sysbench $args prepare
+  sysbench *.* * (glob)
+  
+  'atomic' test does not implement the 'prepare' command.
+  [1]
+  $ sysbench $args run
+  sysbench *.* * (glob)
+  
+  Running the test with following options:
+  Number of threads: 2
+  Initializing random number generator from current time
+  
+  
+  Operation: faa, scope: shared, 1000 operations per event
+  
+  Initializing worker threads...
+  
+  Threads started!
+  
+  Total operations: 10000 (* per second) (glob)
+  Average latency per operation: *.* ns (glob)
+  
+  Throughput:
+      events/s (eps): *.* (glob)
+      time elapsed:                        *s (glob)
+      total number of events:              10
+  
+  Latency (ms):
+           min:                              *.* (glob)
+           avg:                              *.* (glob)
+           max:                              *.* (glob)
+           95.00th percentile:      *.* (glob)
+  
+           sum: *.* (glob)
+  
+  Threads fairness:
+      events (avg/stddev):           */* (glob)
+      execution time (avg/stddev):   */* (glob)
+  
+  $ sysbench $args cleanup
+  sysbench *.* * (glob)
+  
+  'atomic' test does not implement the 'cleanup' command.
+  [1]
+
+########################################################################
+# Operations and scopes
+########################################################################
+
+  $ for o in faa cas fas load-store
+  > do
+  >   for s in shared padded false-shared
+  >   do
+  >     sysbench $args --atomic-oper=$o --atomic-scope=$s run |
+  >       grep -E '^Operation:|^Total operations:'
+  >   done
+  > done
+  Operation: faa, scope: shared, 1000 operations per event
+  Total operations: 10000 (* per second) (glob)
+  Operation: faa, scope: padded, 1000 operations per event
+  Total operations: 10000 (* per second) (glob)
+  Operation: faa, scope: false-shared, 1000 operations per event
+  Total operations: 10000 (* per second) (glob)
+  Operation: cas, scope: shared, 1000 operations per event
+  Total operations: 10000 (* per second) (glob)
+  Operation: cas, scope: padded, 1000 operations per event
+  Total operations: 10000 (* per second) (glob)
+  Operation: cas, scope: false-shared, 1000 operations per event
+  Total operations: 10000 (* per second) (glob)
+  Operation: fas, scope: shared, 1000 operations per event
+  Total operations: 10000 (* per second) (glob)
+  Operation: fas, scope: padded, 1000 operations per event
+  Total operations: 10000 (* per second) (glob)
+  Operation: fas, scope: false-shared, 1000 operations per event
+  Total operations: 10000 (* per second) (glob)
+  Operation: load-store, scope: shared, 1000 operations per event
+  Total operations: 10000 (* per second) (glob)
+  Operation: load-store, scope: padded, 1000 operations per event
+  Total operations: 10000 (* per second) (glob)
+  Operation: load-store, scope: false-shared, 1000 operations per event
+  Total operations: 10000 (* per second) (glob)
+
+  $ sysbench atomic --atomic-oper=foo run
+  sysbench * (glob)
+  
+  FATAL: Invalid value for atomic-oper: foo
+  [1]
+
+  $ sysbench atomic --atomic-scope=foo run
+  sysbench * (glob)
+  
+  FATAL: Invalid value for atomic-scope: foo
+  [1]
+
+  $ sysbench atomic --atomic-ops=0 run
+  sysbench * (glob)
+  
+  FATAL: Invalid value for atomic-ops: 0
+  [1]
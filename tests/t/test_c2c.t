@@ -0,0 +1,40 @@
+########################################################################
+c2c benchmark tests
+########################################################################
+  $ sysbench c2c help
+  sysbench *.* * (glob)
+  
+  c2c options:
+    --c2c-cpus=STRING  list of CPUs to measure, e.g. '0-3,8', or 'all' for all available CPUs [all]
+    --c2c-roundtrips=N number of round trips per CPU pair [10000]
+  
+  $ sysbench c2c prepare
+  sysbench *.* * (glob)
+  
+  'c2c' test does not implement the 'prepare' command.
+  [1]
+  $ sysbench c2c run
+  sysbench *.* * (glob)
+  
+  FATAL: The 'c2c' test requires --threads=2
+  [1]
+  $ sysbench c2c --threads=2 --c2c-cpus=0 run
+  sysbench *.* * (glob)
+  
+  FATAL: The 'c2c' test requires at least 2 CPUs
+  [1]
+  $ sysbench c2c --threads=2 --c2c-cpus=0,0 run
+  sysbench *.* * (glob)
+  
+  FATAL: CPU 0 is listed more than once in --c2c-cpus
+  [1]
+  $ sysbench c2c --threads=2 --c2c-cpus=foo run
+  sysbench *.* * (glob)
+  
+  FATAL: Invalid CPU list: 'foo'
+  [1]
+  $ sysbench c2c --threads=2 --c2c-roundtrips=0 run
+  sysbench *.* * (glob)
+  
+  FATAL: Invalid value for c2c-roundtrips: 0
+  [1]
@@ -0,0 +1,125 @@
+########################################################################
+clock benchmark tests
+########################################################################
+  $ args="clock --events=100 --threads=2"
+  $ sysbench $args help
+  sysbench *.* * (glob)
+  
+  clock options:
+    --clock-type=STRING clock to read {monotonic, monotonic_raw, monotonic_coarse, realtime, boottime, rdtsc, rdtscp, cntvct} [monotonic]
+    --clock-reads=N     number of clock reads per event [1000]
+  
+  $ sysbench $args prepare
+  sysbench *.* * (glob)
+  
+  'clock' test does not implement the 'prepare' command.
+  [1]
+  $ sysbench $args run | grep -v -E '^(Kernel clocksource|TSC frequency|Counter frequency):'
+  sysbench *.* * (glob)
+  
+  Running the test with following options:
+  Number of threads: 2
+  Initializing random number generator from current time
+  
+  
+  Available clocks (single thread):
+    clock                 ns/read   resolution, ns   clock_getres, ns
+    monotonic  * (glob)
+    monotonic_raw * (glob)
+    monotonic_coarse * (glob)
+    realtime * (glob)
+    boottime * (glob)
+    * (glob)
+    * (glob)
+  
+  Clock: monotonic, 1000 read(s) per event
+  
+  Initializing worker threads...
+  
+  Threads started!
+  
+  Clock reads: 100000 (* per second) (glob)
+  Time per read (ns): min *, avg *, max * (glob)
+  Resolution (ns): * (glob)
+  Repeated values: * (*%) (glob)
+  Backward steps: 0
+  
+  
+  Throughput:
+      events/s (eps): *.* (glob)
+      time elapsed:                        *s (glob)
+      total number of events:              100
+  
+  Latency (ms):
+           min:                              *.* (glob)
+           avg:                              *.* (glob)
+           max:                              *.* (glob)
+           95.00th percentile:      *.* (glob)
+  
+           sum: *.* (glob)
+  
+  Threads fairness:
+      events (avg/stddev):           */* (glob)
+      execution time (avg/stddev):   */* (glob)
+  
+  $ sysbench $args cleanup
+  sysbench *.* * (glob)
+  
+  'clock' test does not implement the 'cleanup' command.
+  [1]
+
+########################################################################
+# Clock types
+########################################################################
+
+  $ for t in monotonic monotonic_raw realtime boottime
+  > do
+  >   sysbench $args --clock-type=$t --clock-reads=10 run |
+  >     grep -E '^(Clock|Backward)'
+  > done
+  Clock: monotonic, 10 read(s) per event
+  Clock reads: 1000 (* per second) (glob)
+  Backward steps: 0
+  Clock: monotonic_raw, 10 read(s) per event
+  Clock reads: 1000 (* per second) (glob)
+  Backward steps: 0
+  Clock: realtime, 10 read(s) per event
+  Clock reads: 1000 (* per second) (glob)
+  Backward steps: 0
+  Clock: boottime, 10 read(s) per event
+  Clock reads: 1000 (* per second) (glob)
+  Backward steps: 0
+
+A coarse clock repeats values between ticks
+
+  $ sysbench $args --clock-type=monotonic_coarse run |
+  >   grep -E '^Repeated values: [0-9]{5}'
+  Repeated values: * (9*%) (glob)
+
+Hardware counters are only available on matching CPUs
+
+  $ for t in rdtsc rdtscp cntvct
+  > do
+  >   sysbench $args --clock-type=$t run 2>&1 |
+  >     grep -c -E '^(Clock reads: 100000 |FATAL: --clock-type=)'
+  > done
+  1
+  1
+  1
+
+  $ sysbench $args --clock-type=foo run | grep FATAL
+  FATAL: Invalid value for clock-type: foo
+  $ sysbench $args --clock-reads=0 run | grep FATAL
+  FATAL: Invalid value for clock-reads: 0
+
+########################################################################
+# Timer overhead warning
+########################################################################
+
+Timing 2M events/s in one thread takes well over 1% of its time
+
+  $ sysbench cpu --rate=2000000 --events=10 run 2>&1 | grep -o 'WARNING: timing events at --rate=2000000'
+  WARNING: timing events at --rate=2000000
+  $ sysbench cpu --rate=2000000 --latency-sample-rate=1000 --events=10 run 2>&1 | grep -c 'reading the clock'
+  0
+  [1]
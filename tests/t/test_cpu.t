@@ -6,7 +6,13 @@ cpu benchmark tests
   sysbench *.* * (glob)
   
   cpu options:
-    --cpu-max-prime=N upper limit for primes generator [10000]
+    --cpu-max-prime=N     upper limit for primes generator [10000]
+    --cpu-workload=STRING type of work to do per event {prime, crc32, crc32c, sha256, aes, compress, matmul, hash, interp} [prime]
+    --cpu-block-size=SIZE size of data processed per event by the crc32, crc32c, sha256, aes and compress workloads [16K]
+    --cpu-matrix-size=N   matrix dimension for the matmul workload, must be a multiple of 8 [64]
+    --cpu-hash-size=SIZE  hash table size for the hash workload [16M]
+    --cpu-hash-lookups=N  number of hash table lookups per event [10000]
+    --cpu-interp-steps=N  number of instructions executed per event by the interp workload [100000]
   
   $ sysbench $args prepare
   sysbench *.* * (glob)
@@ -51,3 +57,58 @@ cpu benchmark tests
   
   'cpu' test does not implement the 'cleanup' command.
   [1]
+
+########################################################################
+# Workloads
+########################################################################
+
+  $ for w in crc32 crc32c sha256 compress matmul hash interp
+  > do
+  >   sysbench cpu --events=10 --cpu-workload=$w --cpu-hash-size=1M \
+  >     --cpu-hash-lookups=100 --cpu-interp-steps=1000 run |
+  >     grep -E '^Workload|per second:|GFLOPS|total number of events'
+  > done
+  Workload: crc32, block size: 16KiB
+      events per second: *.* (glob)
+      MiB per second:    *.* (glob)
+      total number of events:              10
+  Workload: crc32c (*), block size: 16KiB (glob)
+      events per second: *.* (glob)
+      MiB per second:    *.* (glob)
+      total number of events:              10
+  Workload: sha256, block size: 16KiB
+      events per second: *.* (glob)
+      MiB per second:    *.* (glob)
+      total number of events:              10
+  Workload: compress, block size: 16KiB
+      events per second: *.* (glob)
+      MiB per second:    *.* (glob)
+      total number of events:              10
+  Workload: matmul (*), matrix size: 64x64 (glob)
+      events per second: *.* (glob)
+      GFLOPS:            *.* (glob)
+      total number of events:              10
+  Workload: hash, table size: 1MiB, 100 lookups per event
+      events per second: *.* (glob)
+      total number of events:              10
+  Workload: interp, 1000 instructions per event
+      events per second: *.* (glob)
+      total number of events:              10
+
+  $ sysbench cpu --cpu-workload=foo run
+  sysbench * (glob)
+  
+  FATAL: Invalid value of cpu-workload: foo.
+  [1]
+
+  $ sysbench cpu --cpu-workload=matmul --cpu-matrix-size=10 run
+  sysbench * (glob)
+  
+  FATAL: --cpu-matrix-size must be a positive multiple of 8
+  [1]
+
+  $ sysbench cpu --cpu-workload=crc32 --cpu-block-size=100 run
+  sysbench * (glob)
+  
+  FATAL: --cpu-block-size must be a non-zero multiple of 64
+  [1]
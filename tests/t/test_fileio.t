@@ -69,6 +69,15 @@ fileio benchmark tests
            95th percentile:         *.* (glob)
            sum: *.* (glob)
   
+  Latency of read requests (ms):
+           95.00th percentile: *.* (glob)
+  
+  Latency of write requests (ms):
+           95.00th percentile: *.* (glob)
+  
+  Latency of fsync requests (ms):
+           95.00th percentile: *.* (glob)
+  
   $ sysbench $fileio_args --events=150 --file-test-mode=rndrd run
   sysbench *.* * (glob)
   
@@ -104,6 +113,9 @@ fileio benchmark tests
            95th percentile:         *.* (glob)
            sum: *.* (glob)
   
+  Latency of read requests (ms):
+           95.00th percentile: *.* (glob)
+  
 
   $ sysbench $fileio_args --events=150 --file-test-mode=seqrd run
   sysbench *.* * (glob)
@@ -138,6 +150,9 @@ fileio benchmark tests
            95th percentile:         *.* (glob)
            sum: *.* (glob)
   
+  Latency of read requests (ms):
+           95.00th percentile: *.* (glob)
+  
 
   $ sysbench $fileio_args --events=150 --file-test-mode=rndwr run
   sysbench *.* * (glob)
@@ -174,6 +189,12 @@ fileio benchmark tests
            95th percentile:         *.* (glob)
            sum: *.* (glob)
   
+  Latency of write requests (ms):
+           95.00th percentile: *.* (glob)
+  
+  Latency of fsync requests (ms):
+           95.00th percentile: *.* (glob)
+  
 
   $ sysbench $fileio_args --events=150 --file-test-mode=rndwr --validate run | grep Validation
   Validation checks: on.
@@ -326,6 +347,12 @@ GH-229: "--file-fsync-freq=0" seems to prevent fsync() at end of test
            95th percentile:         *.* (glob)
            sum: *.* (glob)
   
+  Latency of write requests (ms):
+           95.00th percentile: *.* (glob)
+  
+  Latency of fsync requests (ms):
+           95.00th percentile: *.* (glob)
+  
   $ sysbench $args --file-fsync-end=off run
   sysbench * (glob)
   
@@ -357,3 +384,457 @@ GH-229: "--file-fsync-freq=0" seems to prevent fsync() at end of test
            95th percentile:         *.* (glob)
            sum: *.* (glob)
   
+  Latency of write requests (ms):
+           95.00th percentile: *.* (glob)
+  
+
+########################################################################
+Skewed block selection in random I/O tests
+########################################################################
+  $ args="fileio --file-total-size=160K --file-num=10 --file-test-mode=rndrd"
+  $ args="$args --events=100 --verbosity=2"
+  $ sysbench $args prepare
+  $ sysbench $args --file-rand-type=foo run
+  FATAL: Invalid value for --file-rand-type: foo.
+  [1]
+  $ sysbench $args --file-rand-type=pareto --file-hotspot-move=-1 run
+  FATAL: Invalid value for --file-hotspot-move: -1.000000.
+  [1]
+  $ for t in gaussian special pareto zipfian
+  > do
+  >   sysbench $args --verbosity=3 --file-rand-type=$t --file-hotspot-move=10 run |
+  >     grep -E '^(Block selection|Doing)'
+  > done
+  Block selection: gaussian distribution, hot spot moving by 10.00% of the file set per second
+  Doing random read test
+  Block selection: special distribution, hot spot moving by 10.00% of the file set per second
+  Doing random read test
+  Block selection: pareto distribution, hot spot moving by 10.00% of the file set per second
+  Doing random read test
+  Block selection: zipfian distribution, hot spot moving by 10.00% of the file set per second
+  Doing random read test
+  $ sysbench $args --verbosity=3 --file-rand-type=zipfian run |
+  >   grep -E '^(Block selection|Doing)'
+  Block selection: zipfian distribution
+  Doing random read test
+  $ sysbench $args cleanup
+
+########################################################################
+Per-operation latency percentiles
+########################################################################
+  $ args="fileio --file-total-size=160K --file-num=10 --events=150"
+  $ args="$args --verbosity=2"
+  $ sysbench $args prepare
+  $ sysbench $args --verbosity=3 --file-test-mode=rndrw --percentile=50,99 run |
+  >   grep -A2 '^Latency of'
+  Latency of read requests (ms):
+           50.00th percentile: *.* (glob)
+           99.00th percentile: *.* (glob)
+  --
+  Latency of write requests (ms):
+           50.00th percentile: *.* (glob)
+           99.00th percentile: *.* (glob)
+  --
+  Latency of fsync requests (ms):
+           50.00th percentile: *.* (glob)
+           99.00th percentile: *.* (glob)
+  $ sysbench $args --verbosity=3 --file-test-mode=rndrd run | grep '^Latency of'
+  Latency of read requests (ms):
+  $ sysbench $args --verbosity=3 --file-test-mode=rndwr \
+  >   --file-fsync-mode=fdatasync run | grep '^Latency of'
+  Latency of write requests (ms):
+  Latency of fdatasync requests (ms):
+  $ sysbench $args --verbosity=3 --file-test-mode=rndwr --file-io-mode=mmap \
+  >   run | grep '^Latency of'
+  Latency of write requests (ms):
+  Latency of msync requests (ms):
+  $ sysbench $args --verbosity=3 --file-test-mode=rndwr --file-fsync-freq=0 \
+  >   --file-fsync-end=off --percentile= run | grep '^Latency of'
+  [1]
+  $ sysbench $args --verbosity=3 --file-test-mode=rndwr --file-fsync-freq=0 \
+  >   --file-fsync-end=off run | grep '^Latency of'
+  Latency of write requests (ms):
+  $ sysbench $args --verbosity=3 --file-test-mode=rndrw --events=0 --time=2 \
+  >   --report-interval=1 run | grep -o '^\[ 1s \] read: .* write: .* fsync: '
+  [ 1s ] read: lat (ms,95.00%): * write: lat (ms,95.00%): * fsync:  (glob)
+  $ sysbench $args cleanup
+
+########################################################################
+Parallel and space-only prepare
+########################################################################
+  $ args="fileio --file-total-size=160K --file-num=10 --file-block-size=4K"
+  $ sysbench $args --threads=4 prepare | grep -c '^Creating file test'
+  10
+  $ for i in 0 9; do wc -c < test_file.$i; done
+  16384
+  16384
+  $ sysbench $args --threads=4 prepare | grep -c '^Reusing existing file'
+  10
+  $ sysbench $args cleanup > /dev/null
+  $ for m in fallocate sparse
+  > do
+  >   sysbench $args --file-prepare-mode=$m prepare | tail -1
+  >   wc -c < test_file.5
+  >   sysbench $args cleanup > /dev/null
+  > done
+  No bytes written.
+  16384
+  No bytes written.
+  16384
+  $ sysbench $args --file-prepare-mode=sparse --validate prepare | grep FATAL
+  FATAL: --validate requires --file-prepare-mode=write
+  $ sysbench $args --file-prepare-mode=foo prepare | grep FATAL
+  FATAL: Invalid value for --file-prepare-mode: foo.
+  $ sysbench $args --threads=2 --validate prepare | tail -1
+  163840 bytes written in * seconds (* MiB/sec). (glob)
+  $ sysbench $args --threads=2 --validate --file-test-mode=rndrd \
+  >   --events=100 run | grep -i 'validation failed'
+  [1]
+  $ sysbench $args cleanup > /dev/null
+
+########################################################################
+Mixed block sizes
+########################################################################
+  $ args="fileio --file-total-size=1M --file-num=2 --file-block-size=4K"
+  $ sysbench $args prepare > /dev/null
+  $ args="$args --file-test-mode=rndrw --events=200"
+  $ sysbench $args --file-block-sizes=16K:1,4K:3,64K run |
+  >   grep -E '^Block sizes|^ +[0-9]+KiB: |^Latency of [0-9]+KiB'
+  Block sizes: 4KiB (60.00%), 16KiB (20.00%), 64KiB (20.00%)
+           4KiB: read: IOPS=*.* *.* MiB/s write: IOPS=*.* *.* MiB/s (glob)
+          16KiB: read: IOPS=*.* *.* MiB/s write: IOPS=*.* *.* MiB/s (glob)
+          64KiB: read: IOPS=*.* *.* MiB/s write: IOPS=*.* *.* MiB/s (glob)
+  Latency of 4KiB requests (ms):
+  Latency of 16KiB requests (ms):
+  Latency of 64KiB requests (ms):
+  $ sysbench $args --file-block-sizes=8K --file-fsync-freq=0 --debug run |
+  >   grep -o 'size: [0-9]*$' | sort -u
+  size: 8192
+  $ sysbench $args --file-block-sizes=12K --debug run |
+  >   grep -E 'pos: [0-9]+,' | sed -E 's/.*pos: ([0-9]+),.*/\1/' |
+  >   awk '$1 % 12288 != 0' | head -1
+  $ sysbench $args --events=0 --time=2 --report-interval=1 \
+  >   --file-block-sizes=4K,1M run | grep -o '^\[ 1s \] [0-9]*KiB: reads: '
+  [ 1s ] 4KiB: reads: 
+  $ sysbench $args --file-block-sizes=4K,1M --percentile= run |
+  >   grep '^Latency of'
+  [1]
+  $ for v in 4X 4K:0 4K:x 4K,4096
+  > do
+  >   sysbench $args --file-block-sizes=$v run | grep FATAL
+  > done
+  FATAL: Invalid value for file-block-sizes: 4X
+  FATAL: Invalid value for file-block-sizes: 4K:0
+  FATAL: Invalid value for file-block-sizes: 4K:x
+  FATAL: Duplicate size in file-block-sizes: 4096
+  $ sysbench $args --file-block-sizes=4K --validate run | grep FATAL
+  FATAL: --validate cannot be used with --file-block-sizes
+  $ sysbench $args cleanup > /dev/null
+
+########################################################################
+Block device statistics
+########################################################################
+  $ args="fileio --file-total-size=1M --file-num=2 --file-test-mode=rndwr"
+  $ sysbench $args prepare > /dev/null
+# Test files may be on a file system without a backing block device
+  $ sysbench $args --events=0 --time=2 --report-interval=1 --file-diskstats \
+  >   run > out.txt 2>&1 || true
+  $ if grep -q FATAL out.txt
+  > then
+  >   grep -q 'no statistics for device .* holding test files' out.txt &&
+  >   echo ok
+  > else
+  >   grep -q -E '^\[ 1s \] .+: r/s: .* util: .*% await \(ms\): r .* w ' \
+  >     out.txt &&
+  >   test $(grep -A8 '^Device .* statistics:$' out.txt |
+  >          grep -c -E '[0-9]\.[0-9]{2}$') = 8 &&
+  >   echo ok
+  > fi
+  ok
+  $ sysbench $args --events=10 run | grep -c 'statistics:$'
+  0
+  [1]
+  $ sysbench $args cleanup > /dev/null
+
+########################################################################
+Preconditioning
+########################################################################
+  $ args="fileio --file-total-size=1M --file-num=2 --file-block-size=4K"
+  $ sysbench $args prepare > /dev/null
+  $ args="$args --file-test-mode=rndwr --events=10"
+  $ sysbench $args --file-precondition=2 --threads=2 run |
+  >   grep -A2 '^Preconditioning'
+  Preconditioning: writing the file set 2 time(s) sequentially, then 2 time(s) randomly...
+  Initializing worker threads...
+  
+  $ sysbench $args --file-precondition=2 run | grep 'bytes written in'
+  4194304 bytes written in * seconds (* MiB/sec). (glob)
+  $ sysbench $args --file-precondition=-1 run | grep FATAL
+  FATAL: Invalid value for --file-precondition: -1.
+  $ sysbench $args --file-precondition=1 --validate run | grep FATAL
+  FATAL: --file-precondition cannot be used with --validate
+  $ sysbench $args --file-precondition=1 --file-test-mode=seqwr run |
+  >   grep FATAL
+  FATAL: --file-precondition cannot be used with --file-test-mode=seqwr, which recreates test files
+  $ sysbench $args cleanup > /dev/null
+
+########################################################################
+Block headers in validation mode
+########################################################################
+  $ args="fileio --file-total-size=1M --file-num=2 --validate"
+  $ sysbench $args prepare > /dev/null
+  $ sysbench $args --file-test-mode=rndrw --events=500 run |
+  >   grep -c 'Validation failed'
+  0
+  [1]
+  $ sysbench $args --file-test-mode=seqrd run | grep -c 'Validation failed'
+  0
+  [1]
+# Copy block 1 of the first file over block 0 of the second one
+  $ dd if=test_file.0 of=test_file.1 bs=16384 skip=1 count=1 conv=notrunc \
+  >   2> /dev/null
+  $ sysbench $args --file-test-mode=seqrd run | grep FATAL
+  FATAL: Misdirected block:
+  FATAL:    Actual file: 1 offset: 0    Stored file: 0 offset: 16384
+  FATAL: Validation failed on file 1, block offset 0, exiting...
+  $ printf 'XXXX' | dd of=test_file.0 bs=1 seek=100 conv=notrunc 2> /dev/null
+  $ sysbench $args --file-test-mode=seqrd run | grep -A1 'Checksum mismatch'
+  FATAL: Checksum mismatch in block with offset: 0
+  FATAL:     Calculated value: 0x* Stored value: 0x* (glob)
+  $ sysbench $args --file-block-size=16 --file-test-mode=rndrd run |
+  >   grep FATAL
+  FATAL: --validate requires --file-block-size of at least 24 bytes
+  $ sysbench $args cleanup > /dev/null
+
+########################################################################
+mmap mode controls
+########################################################################
+  $ args="fileio --file-total-size=1M --file-num=2 --file-io-mode=mmap"
+  $ args="$args --file-test-mode=rndrw --events=100 --file-fsync-freq=10"
+  $ args="$args --validate"
+  $ sysbench $args prepare > /dev/null
+  $ sysbench $args --file-mmap-advice=random --file-mmap-populate run |
+  >   grep -E '^Mapping|^Latency of (msync|fsync)'
+  Mapping window: whole files
+  Mapping advice: random, MAP_POPULATE
+  Latency of msync requests (ms):
+  $ sysbench $args --file-mmap-window=64K --file-mmap-msync-writes run |
+  >   grep -E '^Mapping|^Latency of (msync|fsync)|FATAL'
+  Mapping window: 64KiB per thread
+  Mapping advice: normal, msync() after each write
+  Latency of fsync requests (ms):
+  $ sysbench $args --file-mmap-window=1000 run | grep FATAL
+  FATAL: --file-mmap-window must be a multiple of the allocation granularity (4096 bytes)
+  $ sysbench $args --file-mmap-advice=foo run | grep FATAL
+  FATAL: Invalid value for file-mmap-advice: foo
+  $ sysbench $args cleanup > /dev/null
+
+########################################################################
+Thread to file affinity
+########################################################################
+  $ args="fileio --file-total-size=1M --file-num=4 --events=200 --validate"
+  $ args="$args --threads=2"
+  $ sysbench $args prepare > /dev/null
+  $ sysbench $args --file-test-mode=rndrw --file-thread-affinity=owned run |
+  >   grep -E '^Each thread|^    files|FATAL|Validation failed'
+  Each thread works on its own subset of files
+      files 0-1: read: IOPS=* (glob)
+      files 2-3: read: IOPS=* (glob)
+  $ sysbench $args --file-test-mode=seqrd --file-thread-affinity=sharded \
+  >   --file-shards=2 run |
+  >   grep -E '^Threads are|^    files|FATAL|Validation failed'
+  Threads are split into 2 groups, each working on its own subset of files
+      files 0-1: read: IOPS=* (glob)
+      files 2-3: read: IOPS=* (glob)
+  $ sysbench $args --file-test-mode=rndrw run | grep -c '^    files'
+  0
+  [1]
+  $ sysbench $args --file-test-mode=rndrd --file-thread-affinity=foo run |
+  >   grep FATAL
+  FATAL: Invalid value for --file-thread-affinity: foo.
+  $ sysbench $args --file-test-mode=rndrd --file-thread-affinity=sharded \
+  >   --file-shards=3 run | grep FATAL
+  FATAL: --file-shards must be between 1 and the number of threads (2)
+  $ sysbench $args --file-test-mode=rndrd --file-thread-affinity=owned \
+  >   --threads=8 run | grep FATAL
+  FATAL: --file-thread-affinity=owned needs at least 8 files, got --file-num=4
+  $ sysbench $args cleanup > /dev/null
+
+########################################################################
+Sequential streams
+########################################################################
+  $ args="fileio --file-total-size=1M --file-num=2 --events=200 --validate"
+  $ sysbench $args prepare > /dev/null
+  $ sysbench $args --file-test-mode=seqrd --threads=3 --file-seq-streams=3 \
+  >   run | grep -E 'stream|FATAL|WARNING: Discovered'
+  Throughput by sequential stream:
+      stream 0 (files 0-0): read: * MiB/s write: 0.00 MiB/s (glob)
+      stream 1 (files 0-1): read: * MiB/s write: 0.00 MiB/s (glob)
+      stream 2 (files 1-1): read: * MiB/s write: 0.00 MiB/s (glob)
+  $ sysbench $args --file-test-mode=seqwr --threads=3 --file-seq-streams=2 \
+  >   --file-thread-affinity=sharded --file-shards=2 run |
+  >   grep -E 'stream|FATAL'
+  FATAL: --file-seq-streams=2 needs at least as many threads in each file group, got 1
+  $ sysbench $args --file-test-mode=seqrd --file-seq-streams=0 run |
+  >   grep FATAL
+  FATAL: Invalid value for --file-seq-streams: 0.
+  $ sysbench $args cleanup > /dev/null
+
+########################################################################
+Total rate limit
+########################################################################
+  $ args="fileio --file-total-size=1M --file-num=2 --file-test-mode=rndrd"
+  $ sysbench $args prepare > /dev/null
+  $ sysbench $args --file-rate=2M --threads=2 --time=1 run |
+  >   grep -E '^Total I/O rate|read: +IOPS'
+  Total I/O rate limited to 2MiB/s
+           read:  IOPS=12*.* 2.0* MiB/s (2.* MB/s) (glob)
+  $ sysbench $args cleanup > /dev/null
+
+########################################################################
+Page cache control
+########################################################################
+  $ args="fileio --file-total-size=1M --file-num=2 --events=200"
+  $ args="$args --file-test-mode=rndrd"
+  $ sysbench $args prepare > /dev/null
+  $ sysbench $args --file-cache-resident=50 --file-cache-hit-ratio=90 run |
+  >   grep -E '^Page cache|FATAL'
+  Page cache: 50% of files resident, 90% of random requests to the resident part
+  Page cache hit ratio: *% of * sampled reads (glob)
+  $ sysbench $args --file-cache-stats run | grep -E '^Page cache|FATAL'
+  Page cache hit ratio: *% of * sampled reads (glob)
+  $ sysbench $args run | grep -c '^Page cache'
+  0
+  [1]
+  $ sysbench $args --file-cache-resident=101 run | grep FATAL
+  FATAL: --file-cache-resident and --file-cache-hit-ratio must be between 0 and 100
+  $ sysbench $args --file-cache-hit-ratio=90 run | grep FATAL
+  FATAL: --file-cache-hit-ratio requires --file-cache-resident between 1 and 99
+  $ sysbench $args --file-cache-stats --file-extra-flags=direct run |
+  >   grep FATAL
+  FATAL: page cache control cannot be used with --file-extra-flags=direct
+  $ sysbench $args cleanup > /dev/null
+
+########################################################################
+Raw block devices
+########################################################################
+  $ args="fileio --file-total-size=1M --file-num=2 --file-test-mode=rndrd"
+  $ sysbench $args --file-device=/dev/null run | grep FATAL
+  FATAL: '/dev/null' is not a block device
+  $ sysbench $args --file-device=/nonexistent run | grep FATAL
+  FATAL: Cannot stat '/nonexistent' errno = 2 (No such file or directory)
+  $ sysbench $args --file-device=/dev/null --file-io-mode=mmap run |
+  >   grep FATAL
+  FATAL: --file-device cannot be used with --file-io-mode=mmap
+
+########################################################################
+Concurrent jobs
+########################################################################
+  $ args="fileio --file-total-size=1M --file-num=2 --time=1"
+  $ sysbench $args prepare > /dev/null
+  $ sysbench $args --threads=4 --percentile=99 \
+  >   --file-jobs=rndrd:2,seqrewr:1:rate=1M,rndwr:1:fsync=1 run |
+  >   grep -E '^Running [0-9]|^    (rndrd|seqrewr|rndwr)|^Latency of (rndrd|seqrewr|rndwr)|^Throughput by'
+  Running 3 concurrent jobs:
+      rndrd:2: random read test, 2 thread(s)
+      seqrewr:1:rate=1M: sequential rewrite test, 1 thread(s), limited to 1MiB/s
+      rndwr:1:fsync=1: random write test, 1 thread(s), fsync() each 1 requests
+  Throughput by job:
+      rndrd:2: read: IOPS=* (glob)
+      seqrewr:1:rate=1M: read: IOPS=0.00 0.00 MiB/s write: IOPS=* (glob)
+      rndwr:1:fsync=1: read: IOPS=0.00 0.00 MiB/s write: IOPS=* (glob)
+  Latency of rndrd:2 read requests (ms):
+  Latency of seqrewr:1:rate=1M write requests (ms):
+  Latency of seqrewr:1:rate=1M fsync requests (ms):
+  Latency of rndwr:1:fsync=1 write requests (ms):
+  Latency of rndwr:1:fsync=1 fsync requests (ms):
+  $ sysbench $args --file-jobs=seqwr:1 run | grep FATAL
+  FATAL: Invalid value for --file-jobs: seqwr:1
+  $ sysbench $args --file-jobs=rndrd:1,rndwr:1 run | grep FATAL
+  FATAL: --file-jobs uses 2 threads in total, but --threads=1
+  $ sysbench $args --file-jobs=rndrd:1 --file-test-mode=rndrd run | grep FATAL
+  FATAL: --file-test-mode cannot be used with --file-jobs
+  $ sysbench $args cleanup > /dev/null
+
+########################################################################
+Discards
+########################################################################
+  $ args="fileio --file-total-size=1M --file-num=2 --events=200"
+  $ sysbench $args prepare > /dev/null
+  $ sysbench $args --file-test-mode=rndrw --file-discard-ratio=50 \
+  >   --percentile=99 run |
+  >   grep -E '^Replacing|discard:|^Latency of punch|FATAL'
+  Replacing 50.00% of random write test requests with punch hole requests
+           discard: IOPS=* (glob)
+  Latency of punch hole requests (ms):
+  $ sysbench $args --file-test-mode=rndwr --file-discard-ratio=50 \
+  >   --file-discard-mode=zero --percentile=99 run |
+  >   grep -E '^Latency of zero|FATAL'
+  Latency of zero range requests (ms):
+  $ sysbench $args --file-test-mode=rndwr run | grep -c 'discard:'
+  0
+  [1]
+  $ sysbench $args --file-test-mode=rndrd --file-discard-ratio=10 run |
+  >   grep FATAL
+  FATAL: --file-discard-ratio requires a random write test mode {rndwr, rndrw}
+  $ sysbench $args --file-test-mode=rndwr --file-discard-ratio=10 \
+  >   --validate run | grep FATAL
+  FATAL: --file-discard-ratio cannot be used with --validate
+  $ sysbench $args --file-test-mode=rndwr --file-discard-ratio=10 \
+  >   --file-discard-mode=discard run | grep FATAL
+  FATAL: --file-discard-mode=discard requires --file-device
+  $ sysbench $args --file-test-mode=rndwr --file-discard-mode=foo run |
+  >   grep FATAL
+  FATAL: Invalid value for --file-discard-mode: foo.
+  $ sysbench $args cleanup > /dev/null
+
+########################################################################
+Queue depth sweep
+########################################################################
+  $ args="fileio --file-total-size=1M --file-num=2 --file-test-mode=rndrd"
+  $ args="$args --time=1 --threads=4"
+  $ sysbench $args prepare > /dev/null
+  $ sysbench $args --file-qd-sweep=1,2,4 --percentile=99 run |
+  >   sed -n '/^Sweep run/p;/^Sweep of/,$p' | sed 's/  *<- knee$//'
+  Sweep run 1 of 3: queue depth 1, 1 thread(s)
+  Sweep run 2 of 3: queue depth 2, 2 thread(s)
+  Sweep run 3 of 3: queue depth 4, 4 thread(s)
+  Sweep of queue depth:
+   queue depth        events/s     avg (ms)    99th (ms)
+             1 * (glob)
+             2 * (glob)
+             4 * (glob)
+  Knee: * (glob)
+  $ sysbench $args --file-qd-sweep=1,8 run | grep FATAL
+  FATAL: queue depth 8 requires 8 threads, but the maximum is --threads=4
+  $ sysbench $args --file-qd-sweep=1,x run | grep FATAL
+  FATAL: Invalid value in --file-qd-sweep: 'x'
+  $ sysbench $args --file-qd-sweep=1,2 --repeat=2 run | grep FATAL
+  FATAL: A queue depth sweep cannot be combined with a list of --threads values or --repeat
+  $ sysbench $args cleanup > /dev/null
+
+########################################################################
+Writeback monitoring
+########################################################################
+  $ if [ ! -r /proc/meminfo ]; then
+  >   exit 80
+  > fi
+  $ args="fileio --file-total-size=1M --file-num=2 --file-test-mode=rndwr"
+  $ sysbench $args prepare > /dev/null
+  $ sysbench $args --file-fsync-freq=10 --time=2 --report-interval=1 \
+  >   --file-writeback run > out.txt
+  $ grep -c '^\[ 1s \] writeback: dirty: .* stalled writes: ' out.txt
+  1
+  $ sed -n '/^Writeback:/,/^$/p' out.txt | sed 's/:.*//'
+  Writeback
+           dirty avg/max (MiB)
+           writeback avg/max (MiB)
+           io stall some/full (PSI)
+           stalled writes (>= 1 ms)
+  
+  $ sed -n '/^fsync latency by dirty data flushed:/,/^$/p' out.txt |
+  >   grep -E '^fsync|dirty data|<= 64KiB'
+  fsync latency by dirty data flushed:
+           dirty data           fsyncs     avg (ms)     max (ms)
+           <= 64KiB * (glob)
+  $ sysbench $args cleanup > /dev/null
@@ -0,0 +1,123 @@
+########################################################################
+kv benchmark tests
+########################################################################
+  $ args="kv --events=1000 --threads=2 --kv-keys=1000"
+  $ sysbench $args help
+  sysbench *.* * (glob)
+  
+  kv options:
+    --kv-map=STRING      map implementation {striped, ck_ht, simd} [striped]
+    --kv-keys=N          number of distinct keys [1000000]
+    --kv-key-size=SIZE   key size, keys are zero-padded decimal numbers [16]
+    --kv-value-size=SIZE value size [64]
+    --kv-prefill=N       percentage of keys inserted before the test [100]
+    --kv-get-ratio=N     relative weight of get operations [90]
+    --kv-put-ratio=N     relative weight of put operations [8]
+    --kv-delete-ratio=N  relative weight of delete operations [2]
+    --kv-stripes=N       number of lock stripes of the striped map or shards of the simd map, rounded up to a power of 2 [1024]
+    --kv-batch-size=N    number of operations per event [1]
+  
+  $ sysbench $args prepare
+  sysbench *.* * (glob)
+  
+  'kv' test does not implement the 'prepare' command.
+  [1]
+  $ sysbench $args run
+  sysbench *.* * (glob)
+  
+  Running the test with following options:
+  Number of threads: 2
+  Initializing random number generator from current time
+  
+  
+  Map: striped, 1024 lock stripes
+  Keys: 1000, 16-byte keys, 64-byte values, 100% prefilled
+  Operations: get 90%, put 8%, delete 2%, 1 per event
+  
+  Initializing worker threads...
+  
+  Threads started!
+  
+  Key-value operations:
+      gets:         * (* per second) (glob)
+      hits:         * (glob)
+      puts:         * (* per second) (glob)
+      deletes:      * (* per second) (glob)
+  
+  Throughput:
+      events/s (eps): *.* (glob)
+      time elapsed:                        *s (glob)
+      total number of events:              1000
+  
+  Latency (ms):
+           min:                              *.* (glob)
+           avg:                              *.* (glob)
+           max:                              *.* (glob)
+           95.00th percentile:      *.* (glob)
+  
+           sum: *.* (glob)
+  
+  Threads fairness:
+      events (avg/stddev):           */* (glob)
+      execution time (avg/stddev):   */* (glob)
+  
+
+########################################################################
+# Maps and operation mixes
+########################################################################
+
+  $ for map in striped ck_ht simd; do
+  >   sysbench $args --kv-map=$map --kv-batch-size=10 --kv-put-ratio=0 \
+  >     --kv-delete-ratio=0 run | grep -E '^Map|^    (gets|hits)'
+  >   sysbench $args --kv-map=$map --kv-prefill=0 --kv-put-ratio=0 \
+  >     --kv-delete-ratio=0 run | grep -E '^    hits'
+  >   sysbench $args --kv-map=$map --kv-stripes=3 --kv-key-size=3 \
+  >     --kv-get-ratio=0 --kv-put-ratio=1 --kv-delete-ratio=1 run |
+  >     grep -E '^(Keys|Operations)|^    (puts|deletes)'
+  > done
+  Map: striped, 1024 lock stripes
+      gets:              10000 (* per second) (glob)
+      hits:             100.00%
+      hits:               0.00%
+  Keys: 1000, 3-byte keys, 64-byte values, 100% prefilled
+  Operations: get 0%, put 50%, delete 50%, 1 per event
+      puts:       * (* per second) (glob)
+      deletes:    * (* per second) (glob)
+  Map: ck_ht, lock-free reads, serialized writes
+      gets:              10000 (* per second) (glob)
+      hits:             100.00%
+      hits:               0.00%
+  Keys: 1000, 3-byte keys, 64-byte values, 100% prefilled
+  Operations: get 0%, put 50%, delete 50%, 1 per event
+      puts:       * (* per second) (glob)
+      deletes:    * (* per second) (glob)
+  Map: simd, 1024 shards, * probing (glob)
+      gets:              10000 (* per second) (glob)
+      hits:             100.00%
+      hits:               0.00%
+  Keys: 1000, 3-byte keys, 64-byte values, 100% prefilled
+  Operations: get 0%, put 50%, delete 50%, 1 per event
+      puts:       * (* per second) (glob)
+      deletes:    * (* per second) (glob)
+
+########################################################################
+# Invalid options
+########################################################################
+
+  $ sysbench $args --kv-map=foo run 2>&1 | grep FATAL
+  FATAL: Invalid value for kv-map: foo
+  $ sysbench $args --kv-keys=0 run 2>&1 | grep FATAL
+  FATAL: Invalid value for kv-keys: 0
+  $ sysbench $args --kv-key-size=2 run 2>&1 | grep FATAL
+  FATAL: --kv-key-size must be between 3 and 65535 bytes for 1000 keys
+  $ sysbench $args --kv-value-size=0 run 2>&1 | grep FATAL
+  FATAL: Invalid value for kv-value-size: 0
+  $ sysbench $args --kv-prefill=101 run 2>&1 | grep FATAL
+  FATAL: Invalid value for kv-prefill: 101
+  $ sysbench $args --kv-get-ratio=0 --kv-put-ratio=0 --kv-delete-ratio=0 \
+  >   run 2>&1 | grep FATAL
+  FATAL: At least one of --kv-get-ratio, --kv-put-ratio and --kv-delete-ratio must be positive
+  $ sysbench $args --kv-stripes=0 run 2>&1 | grep FATAL
+  FATAL: Invalid value for kv-stripes: 0
+  $ sysbench $args --kv-batch-size=0 run 2>&1 | grep FATAL
+  FATAL: Invalid value for kv-batch-size: 0
@@ -0,0 +1,98 @@
+########################################################################
+malloc benchmark tests
+########################################################################
+  $ args="malloc --events=1000 --threads=2"
+  $ sysbench $args help
+  sysbench *.* * (glob)
+  
+  malloc options:
+    --malloc-pattern=STRING  allocation pattern {pairs, churn, cross} [churn]
+    --malloc-min-size=SIZE   minimum block size [16]
+    --malloc-max-size=SIZE   maximum block size, sizes between the minimum and the maximum are distributed according to --rand-type [4K]
+    --malloc-large-pct=N     percentage of large blocks with sizes uniformly distributed between --malloc-max-size and --malloc-large-size [0]
+    --malloc-large-size=SIZE maximum size of large blocks [1M]
+    --malloc-live=N          number of blocks kept alive by each thread with --malloc-pattern=churn, or in flight between each pair of threads with --malloc-pattern=cross [4096]
+  
+  $ sysbench $args prepare
+  sysbench *.* * (glob)
+  
+  'malloc' test does not implement the 'prepare' command.
+  [1]
+  $ sysbench $args run
+  sysbench *.* * (glob)
+  
+  Running the test with following options:
+  Number of threads: 2
+  Initializing random number generator from current time
+  
+  
+  Pattern: churn, block sizes: 16-4096 bytes (special)
+  Live blocks: 4096 per thread
+  
+  Initializing worker threads...
+  
+  Threads started!
+  
+  Operations: 1000 (* per second) (glob)
+  RSS (MiB): initial *, final *, peak * (glob)
+  
+  Throughput:
+      events/s (eps): *.* (glob)
+      time elapsed:                        *s (glob)
+      total number of events:              1000
+  
+  Latency (ms):
+           min:                              *.* (glob)
+           avg:                              *.* (glob)
+           max:                              *.* (glob)
+           95.00th percentile:      *.* (glob)
+  
+           sum: *.* (glob)
+  
+  Threads fairness:
+      events (avg/stddev):           */* (glob)
+      execution time (avg/stddev):   */* (glob)
+  
+  $ sysbench $args cleanup
+  sysbench *.* * (glob)
+  
+  'malloc' test does not implement the 'cleanup' command.
+  [1]
+
+########################################################################
+# Allocation patterns and size distributions
+########################################################################
+
+  $ sysbench $args --malloc-pattern=pairs --rand-type=uniform \
+  >   --malloc-min-size=1 --malloc-max-size=64 run |
+  >   grep -E '^(Pattern|Live blocks|Operations):'
+  Pattern: pairs, block sizes: 1-64 bytes (uniform)
+  Operations: 1000 (* per second) (glob)
+
+  $ sysbench $args --malloc-pattern=churn --malloc-live=10 \
+  >   --malloc-large-pct=10 --malloc-large-size=256K run |
+  >   grep -E '^(Pattern|Large blocks|Live blocks|Operations):'
+  Pattern: churn, block sizes: 16-4096 bytes (special)
+  Large blocks: 10%, up to 262144 bytes
+  Live blocks: 10 per thread
+  Operations: 1000 (* per second) (glob)
+
+  $ sysbench $args --threads=3 --malloc-pattern=cross --malloc-live=100 run |
+  >   grep -E '^(Pattern|Live blocks|Operations|Blocks freed)'
+  Pattern: cross, block sizes: 16-4096 bytes (special)
+  Live blocks: 100 per thread
+  Operations: 1000 (* per second) (glob)
+  Blocks freed by another thread: *% (glob)
+
+  $ sysbench $args --malloc-pattern=foo run | grep FATAL
+  FATAL: Invalid value for malloc-pattern: foo
+  $ sysbench $args --malloc-min-size=8K run | grep FATAL
+  FATAL: Invalid block size range: 8192-4096
+  $ sysbench $args --malloc-large-pct=101 run | grep FATAL
+  FATAL: Invalid value for malloc-large-pct: 101
+  $ sysbench $args --malloc-large-pct=1 --malloc-large-size=4K run | grep FATAL
+  FATAL: --malloc-large-size must be greater than --malloc-max-size
+  $ sysbench $args --malloc-live=0 run | grep FATAL
+  FATAL: Invalid value for malloc-live: 0
+  $ sysbench $args --threads=1 --malloc-pattern=cross run | grep FATAL
+  FATAL: --malloc-pattern=cross requires at least 2 threads
@@ -21,9 +21,23 @@ help' only on Linux.
   memory options:
     --memory-block-size=SIZE    size of memory block for test [1K]
     --memory-total-size=SIZE    total size of data to transfer [100G]
-    --memory-scope=STRING       memory access scope {global,local} [global]
-    --memory-oper=STRING        type of memory operations {read, write, none} [write]
-    --memory-access-mode=STRING memory access mode {seq,rnd} [seq]
+    --memory-scope=STRING       memory access scope {global,local,numa}. 'numa' runs threads on each NUMA node against memory of each node in turn and prints a node x node matrix [global]
+    --memory-pages=STRING       pages for memory buffers {default,thp,2m,1g}. 'thp' requests transparent huge pages with madvise(), '2m' and '1g' allocate explicit huge pages of the given size [default]
+    --memory-populate[=on|off]  pre-fault memory buffers when allocating them [off]
+    --memory-oper=STRING        type of memory operations {read, write, copy, triad, mixed, rmw, none}. 'copy' copies a block to another one, 'triad' computes a[i] = b[i] + q * c[i] over 3 blocks of doubles as in STREAM, 'mixed' reads or writes each cache line (each word with --memory-access-mode=rnd) as set by --memory-rw-ratio, 'rmw' increments each word in place [write]
+    --memory-rw-ratio=N         percentage of reads for --memory-oper=mixed, the rest are writes [50]
+    --memory-access-mode=STRING memory access mode {seq,rnd,chase,tlb}. 'chase' walks a random cyclic chain of dependent loads, one per cache line, to measure load latency rather than bandwidth. 'tlb' does the same with one load per --memory-stride bytes, so that loads are bound by TLB misses and page walks [seq]
+    --memory-stride=SIZE        distance between loads for --memory-access-mode=tlb, 0 means the base page size [0]
+    --memory-kernel=STRING      load/store loop for sequential reads and writes {auto,scalar,sse2,avx2,avx512,neon}. 'auto' picks the widest one supported by the CPU [scalar]
+    --memory-sweep[=on|off]     run the test for each power of 2 working set size from --memory-sweep-min to --memory-sweep-max for an equal share of --time, and print a size table with detected cache level boundaries. Overrides --memory-block-size [off]
+    --memory-sweep-min=SIZE     minimum working set size for --memory-sweep [4K]
+    --memory-sweep-max=SIZE     maximum working set size for --memory-sweep [1G]
+    --memory-probe-threads=N    number of threads measuring loaded latency with pointer chasing while the other threads generate memory traffic. Probe latency is reported per event of --memory-probe-loads dependent loads [0]
+    --memory-probe-loads=N      number of dependent loads per probe event [16]
+    --memory-load-delay=N       delay in nanoseconds after each block accessed by traffic generating threads, to vary the memory load with --memory-probe-threads [0]
+    --memory-rate=SIZE          limit the memory traffic of all threads, except --memory-probe-threads, to SIZE bytes per second, e.g. to run the test as background load at a fixed budget. Each event accounts for one block. 0 is unlimited [0]
+    --memory-nt-stores[=on|off] use non-temporal (streaming) stores bypassing caches for write, copy and triad. Requires a vector --memory-kernel [off]
+    --memory-faults=STRING      measure page faults instead of memory bandwidth {off,anon,file,mmap,madvise}. Each event faults in one block. 'anon' touches fresh anonymous memory, 'file' reads the files created by 'sysbench fileio prepare' in the current directory through a shared mapping, 'mmap' maps, touches and unmaps a block, 'madvise' drops a block with madvise(MADV_DONTNEED) and touches it again. Fault latency includes the system calls of 'mmap' and 'madvise' [off]
   
   $ sysbench $args prepare
   sysbench *.* * (glob)
@@ -227,6 +241,328 @@ help' only on Linux.
       events (avg/stddev):           */* (glob)
       execution time (avg/stddev):   */* (glob)
   
+########################################################################
+# Vectorized kernels
+########################################################################
+
+  $ sysbench $args --memory-kernel=foo run
+  sysbench *.* * (glob)
+  
+  FATAL: Invalid value for memory-kernel: foo
+  [1]
+
+  $ sysbench $args --memory-kernel=auto --memory-oper=read run |
+  >   grep -E '(Total operations|MiB transferred)'
+  Total operations: 262144 (* per second) (glob)
+  1024.00 MiB transferred (* MiB/sec) (glob)
+
+  $ sysbench $args --memory-kernel=auto --memory-oper=write run |
+  >   grep -E '(Total operations|MiB transferred)'
+  Total operations: 262144 (* per second) (glob)
+  1024.00 MiB transferred (* MiB/sec) (glob)
+
+########################################################################
+# Copy, triad and non-temporal stores
+########################################################################
+
+  $ sysbench $args --memory-oper=copy --memory-access-mode=rnd run
+  sysbench *.* * (glob)
+  
+  FATAL: --memory-oper=copy supports only sequential access
+  [1]
+
+  $ sysbench $args --memory-oper=copy --memory-nt-stores run
+  sysbench *.* * (glob)
+  
+  FATAL: --memory-nt-stores is not supported by --memory-kernel=scalar
+  [1]
+
+  $ sysbench $args --memory-oper=read --memory-kernel=auto --memory-nt-stores run
+  sysbench *.* * (glob)
+  
+  FATAL: --memory-nt-stores requires sequential access and --memory-oper=write, copy or triad
+  [1]
+
+Copy counts both the source and destination blocks, triad counts all
+3 blocks, so the total size of transferred data is the same for all
+operations.
+
+  $ sysbench $args --memory-oper=copy run |
+  >   grep -E '(operation|Total operations|MiB transferred)'
+    operation: copy
+  Total operations: 131072 (* per second) (glob)
+  1024.00 MiB transferred (* MiB/sec) (glob)
+
+  $ sysbench $args --memory-oper=triad --memory-scope=local run |
+  >   grep -E '(operation|Total operations|MiB transferred)'
+    operation: triad
+  Total operations: 87380 (* per second) (glob)
+  1023.98 MiB transferred (* MiB/sec) (glob)
+
+  $ if grep -qw sse2 /proc/cpuinfo 2>/dev/null
+  > then
+  >   sysbench $args --memory-oper=copy --memory-kernel=sse2 \
+  >     --memory-nt-stores run | grep -E '(operation:|MiB transferred)'
+  > else
+  >   echo "  operation: copy (non-temporal stores)"
+  >   echo "1024.00 MiB transferred (1 MiB/sec)"
+  > fi
+    operation: copy (non-temporal stores)
+  1024.00 MiB transferred (* MiB/sec) (glob)
+
+########################################################################
+# Mixed reads and writes, read-modify-write
+########################################################################
+
+  $ sysbench $args --memory-oper=mixed --memory-rw-ratio=101 run
+  sysbench *.* * (glob)
+  
+  FATAL: Invalid value for memory-rw-ratio: 101
+  [1]
+
+Operations that both read and write report each direction separately
+
+  $ sysbench $args --memory-oper=mixed --memory-rw-ratio=75 run |
+  >   grep -E '(operation|Total operations|MiB transferred|read:|written:)'
+    operation: mixed (75% reads)
+  Total operations: 262144 (* per second) (glob)
+  1024.00 MiB transferred (* MiB/sec) (glob)
+      read:    768.00 MiB (* MiB/sec) (glob)
+      written: 256.00 MiB (* MiB/sec) (glob)
+
+  $ sysbench $args --memory-oper=mixed --memory-rw-ratio=0 \
+  >   --memory-access-mode=rnd run | grep -E '(operation|MiB transferred)'
+    operation: mixed (0% reads)
+  Total operations: 262144 (* per second) (glob)
+  1024.00 MiB transferred (* MiB/sec) (glob)
+
+  $ sysbench $args --memory-oper=rmw --memory-access-mode=rnd run |
+  >   grep -E '(operation|Total operations|MiB transferred|read:|written:)'
+    operation: read-modify-write
+  Total operations: 131072 (* per second) (glob)
+  1024.00 MiB transferred (* MiB/sec) (glob)
+      read:    512.00 MiB (* MiB/sec) (glob)
+      written: 512.00 MiB (* MiB/sec) (glob)
+
+########################################################################
+# Pointer chasing
+########################################################################
+
+  $ sysbench $args --memory-access-mode=chase --memory-block-size=64 run
+  sysbench *.* * (glob)
+  
+  FATAL: --memory-access-mode=chase requires --memory-block-size of at least * bytes (glob)
+  [1]
+
+  $ sysbench $args --memory-access-mode=chase --memory-scope=local run |
+  >   grep -E '(operation|Total operations|Load latency)'
+    operation: read (pointer chasing)
+  Total operations: 262144 (* per second) (glob)
+  Load latency: * ns (* dependent loads per event) (glob)
+
+  $ sysbench $args --memory-access-mode=tlb --memory-stride=100 run
+  sysbench *.* * (glob)
+  
+  FATAL: --memory-stride must be a multiple of * bytes (glob)
+  [1]
+
+  $ sysbench $args --memory-access-mode=tlb --memory-stride=8K --memory-block-size=8K run
+  sysbench *.* * (glob)
+  
+  FATAL: --memory-access-mode=tlb requires --memory-block-size of at least 16384 bytes
+  [1]
+
+  $ sysbench $args --memory-access-mode=tlb --memory-stride=8K \
+  >   --memory-block-size=1M --memory-total-size=1G run |
+  >   grep -E '(operation|Chain|Load latency)'
+    operation: read (pointer chasing, one load per 8KiB)
+  Total operations: 1024 (* per second) (glob)
+  Chain: 128 loads, one per 8KiB of a 1MiB buffer
+  Load latency: * ns (128 dependent loads per event) (glob)
+
+########################################################################
+# Loaded latency
+########################################################################
+
+  $ sysbench $args --memory-probe-threads=2 --time=1 run
+  sysbench *.* * (glob)
+  
+  FATAL: --memory-probe-threads must be less than --threads
+  [1]
+
+  $ sysbench $args --memory-probe-threads=1 run
+  sysbench *.* * (glob)
+  
+  FATAL: --memory-probe-threads requires a --time limit and does not support --rate
+  [1]
+
+  $ sysbench $args --memory-probe-threads=1 --memory-access-mode=chase --time=1 run
+  sysbench *.* * (glob)
+  
+  FATAL: --memory-probe-threads cannot be used with --memory-access-mode=chase or tlb, --memory-scope=numa or --memory-sweep
+  [1]
+
+  $ sysbench memory --threads=2 --memory-probe-threads=1 --memory-load-delay=100 \
+  >   --memory-oper=read --time=1 run |
+  >   grep -E '(loaded latency|Traffic threads|Probe threads)'
+    loaded latency: 1 probe thread(s), 16 loads per event, 100ns delay per block
+  Traffic threads: 1, * MiB transferred (* MiB/sec) (glob)
+  Probe threads: 1, load latency: * ns (16 dependent loads per event) (glob)
+
+########################################################################
+# NUMA matrix
+########################################################################
+
+  $ sysbench $args --memory-scope=numa run
+  sysbench *.* * (glob)
+  
+  FATAL: --memory-scope=numa requires a --time limit and does not support --warmup-time
+  [1]
+
+  $ sysbench $args --memory-scope=numa --thread-affinity=compact --time=1 run
+  sysbench *.* * (glob)
+  
+  FATAL: --thread-affinity cannot be used with --memory-scope=numa
+  [1]
+
+  $ sysbench memory --memory-scope=numa --threads=2 --time=1 run |
+  >   sed -n '/scope:/,/^$/p;/NUMA .* matrix/,/^$/p' | grep -v 'node[0-9]\+ \+[0-9]'
+    scope: numa
+    NUMA matrix: * CPU node(s) x * memory node(s), *s per cell (glob)
+  
+  NUMA bandwidth matrix, MiB/sec (rows: CPU nodes, columns: memory nodes):
+                   node0* (glob)
+  
+  NUMA latency matrix, average ns per block (rows: CPU nodes, columns: memory nodes):
+                   node0* (glob)
+  
+
+########################################################################
+# Page types
+########################################################################
+
+  $ sysbench $args --memory-pages=foo run
+  sysbench *.* * (glob)
+  
+  FATAL: Invalid value for memory-pages: foo
+  [1]
+
+  $ sysbench $args --memory-pages=thp --memory-populate run |
+  >   grep -E '(pages:|Total operations|MiB transferred)'
+    pages: thp (pre-faulted)
+  Total operations: 262144 (* per second) (glob)
+  1024.00 MiB transferred (* MiB/sec) (glob)
+
+  $ sysbench $args --memory-pages=thp --memory-scope=local run |
+  >   grep -E '(pages:|Total operations|MiB transferred)'
+    pages: thp
+  Total operations: 262144 (* per second) (glob)
+  1024.00 MiB transferred (* MiB/sec) (glob)
+
+########################################################################
+# Working set sweep
+########################################################################
+
+  $ sysbench $args --memory-sweep run
+  sysbench *.* * (glob)
+  
+  FATAL: --memory-sweep requires a --time limit and does not support --warmup-time
+  [1]
+
+  $ sysbench $args --memory-sweep --memory-sweep-min=3K --time=1 run
+  sysbench *.* * (glob)
+  
+  FATAL: Invalid value for memory-sweep-min: 3K
+  [1]
+
+  $ sysbench $args --memory-sweep --memory-sweep-max=2K --time=1 run
+  sysbench *.* * (glob)
+  
+  FATAL: Invalid value for memory-sweep-max: 2K
+  [1]
+
+  $ sysbench $args --memory-sweep --memory-access-mode=chase --time=1 run
+  sysbench *.* * (glob)
+  
+  FATAL: --memory-sweep with --memory-access-mode=chase requires --memory-scope=local
+  [1]
+
+  $ sysbench memory --memory-sweep --memory-sweep-max=16K --threads=2 --time=1 run |
+  >   sed -n '/working set sweep:/p;/Working set sweep/,/^$/p'
+    working set sweep: 4KiB to 16KiB, 0.33s per size
+  Working set sweep (sizes are shared by all threads):
+        size       MiB/sec      ns/block
+        4KiB  * (glob)
+        8KiB  * (glob)
+       16KiB  * (glob)
+  
+
+  $ sysbench memory --memory-sweep --memory-sweep-max=16K --threads=2 --time=1 \
+  >   --memory-access-mode=chase --memory-scope=local run |
+  >   sed -n '/Working set sweep/,/^$/p'
+  Working set sweep (sizes are per thread):
+        size       ns/load
+        4KiB  * (glob)
+        8KiB  * (glob)
+       16KiB  * (glob)
+  
+
+########################################################################
+# Page faults
+########################################################################
+
+  $ for mode in anon mmap madvise; do
+  >   sysbench memory --memory-faults=$mode --memory-block-size=16K \
+  >     --memory-total-size=1M --threads=2 run |
+  >     grep -E '^  page faults|^Pages|^Fault|^Process|total number'
+  > done
+    page faults: anon, 4 page(s) of 4KiB per event
+  Pages faulted in: 256 (* per second) (glob)
+  Fault latency: *.* ns per page (4 page(s) per event) (glob)
+  Process page faults: * minor, * major (glob)
+      total number of events:              64
+    page faults: mmap, 4 page(s) of 4KiB per event
+  Pages faulted in: 256 (* per second) (glob)
+  Fault latency: *.* ns per page (4 page(s) per event) (glob)
+  Process page faults: * minor, * major (glob)
+      total number of events:              64
+    page faults: madvise, 4 page(s) of 4KiB per event
+  Pages faulted in: 256 (* per second) (glob)
+  Fault latency: *.* ns per page (4 page(s) per event) (glob)
+  Process page faults: * minor, * major (glob)
+      total number of events:              64
+
+  $ sysbench memory --memory-faults=file run 2>&1 | grep FATAL
+  FATAL: --memory-faults=file requires files created by 'sysbench fileio prepare' in the current directory
+
+  $ sysbench fileio --file-num=2 --file-total-size=1M prepare > /dev/null
+  $ sysbench memory --memory-faults=file --memory-block-size=64K \
+  >   --memory-total-size=2M run | grep -E '^  (page faults|files)|^Pages'
+    page faults: file, 16 page(s) of 4KiB per event
+    files: 2, 1MiB
+  Pages faulted in: 512 (* per second) (glob)
+  $ sysbench fileio --file-num=2 cleanup > /dev/null
+
+  $ sysbench memory --memory-faults=foo run 2>&1 | grep FATAL
+  FATAL: Invalid value for memory-faults: foo
+  $ sysbench memory --memory-faults=anon --memory-sweep run 2>&1 | grep FATAL
+  FATAL: --memory-faults cannot be used with --memory-sweep
+  $ sysbench memory --memory-faults=anon --memory-populate run 2>&1 |
+  >   grep FATAL
+  FATAL: --memory-faults cannot be used with --memory-pages and --memory-populate
+
+########################################################################
+# Rate limit
+########################################################################
+
+  $ sysbench memory --memory-rate=10M --memory-block-size=1K --threads=2 \
+  >   --time=1 run | grep '^  rate limit'
+    rate limit: 10MiB/sec
+  $ sysbench memory --memory-rate=10M --memory-block-size=1K --threads=2 \
+  >   --time=3 run |
+  >   awk '/MiB transferred/ { v = substr($4, 2); print (v > 5 && v < 11) }'
+  1
+
   $ sysbench $args cleanup
   sysbench *.* * (glob)
   
@@ -0,0 +1,99 @@
+########################################################################
+metadata benchmark tests
+########################################################################
+  $ args="metadata --events=100 --threads=2 --metadata-files=16"
+  $ sysbench $args help
+  sysbench *.* * (glob)
+  
+  metadata options:
+    --metadata-dir=STRING     directory to create the test tree in, must not exist and is removed after the test [sbtest_metadata]
+    --metadata-fanout=N       number of subdirectories in each directory of the tree [4]
+    --metadata-depth=N        number of directory levels in the tree, files are created in the directories of the last level [2]
+    --metadata-files=N        number of files each thread creates before the test [256]
+    --metadata-ops=[LIST,...] operations to pick from with equal probability {create, open, stat, rename, unlink, readdir, fsync-dir} [create,open,stat,rename,unlink,readdir,fsync-dir]
+  
+  $ sysbench $args prepare
+  sysbench *.* * (glob)
+  
+  'metadata' test does not implement the 'prepare' command.
+  [1]
+  $ sysbench $args --metadata-ops=stat run
+  sysbench *.* * (glob)
+  
+  Running the test with following options:
+  Number of threads: 2
+  Initializing random number generator from current time
+  
+  
+  Directory tree: 2 level(s), 4 subdirectories per directory, 16 file directories
+  Files: 16 per thread, operations: stat
+  
+  Initializing worker threads...
+  
+  Threads started!
+  
+  Operations:
+      stat              100 (* per second) (glob)
+  
+  Latency of stat operations (ms):
+           95.00th percentile:      *.* (glob)
+  
+  Throughput:
+      events/s (eps): *.* (glob)
+      time elapsed:                        *s (glob)
+      total number of events:              100
+  
+  Latency (ms):
+           min:                              *.* (glob)
+           avg:                              *.* (glob)
+           max:                              *.* (glob)
+           95.00th percentile:      *.* (glob)
+  
+           sum: *.* (glob)
+  
+  Threads fairness:
+      events (avg/stddev):           */* (glob)
+      execution time (avg/stddev):   */* (glob)
+  
+  $ ls sbtest_metadata
+  ls: *: No such file or directory (glob)
+  [2]
+
+########################################################################
+# Operation mix and directory trees
+########################################################################
+
+  $ sysbench $args --events=1000 run | grep -E '^(Files|    [a-z-]+ +[0-9]+ )'
+  Files: 16 per thread, operations: create, open, stat, rename, unlink, readdir, fsync-dir
+      create * (* per second) (glob)
+      open * (* per second) (glob)
+      stat * (* per second) (glob)
+      rename * (* per second) (glob)
+      unlink * (* per second) (glob)
+      readdir * (* per second) (glob)
+      fsync-dir * (* per second) (glob)
+  $ ls sbtest_metadata
+  ls: *: No such file or directory (glob)
+  [2]
+
+  $ sysbench $args --metadata-depth=0 --metadata-ops=create,unlink,create run |
+  >   grep -E '^(Directory tree|Files):'
+  Directory tree: 0 level(s), 4 subdirectories per directory, 1 file directories
+  Files: 16 per thread, operations: create, unlink
+  $ sysbench $args --metadata-depth=3 --metadata-fanout=2 --metadata-ops=readdir \
+  >   run | grep -E '^(Directory|    readdir)'
+  Directory tree: 3 level(s), 2 subdirectories per directory, 8 file directories
+      readdir           100 (* per second) (glob)
+
+  $ mkdir sbtest_metadata
+  $ sysbench $args run | grep FATAL
+  FATAL: Cannot create directory 'sbtest_metadata' errno = 17 (File exists)
+  $ rmdir sbtest_metadata
+  $ sysbench $args --metadata-ops=foo run | grep FATAL
+  FATAL: Invalid value for metadata-ops: foo
+  $ sysbench $args --metadata-fanout=0 run | grep FATAL
+  FATAL: Invalid value for metadata-fanout: 0
+  $ sysbench $args --metadata-depth=-1 run | grep FATAL
+  FATAL: Invalid value for metadata-depth: -1
+  $ sysbench $args --metadata-fanout=1000 --metadata-depth=3 run | grep FATAL
+  FATAL: --metadata-fanout and --metadata-depth result in too many directories
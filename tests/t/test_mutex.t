@@ -6,9 +6,15 @@ mutex benchmark tests
   sysbench *.* * (glob)
   
   mutex options:
-    --mutex-num=N   total size of mutex array [4096]
-    --mutex-locks=N number of mutex locks to do per thread [50000]
-    --mutex-loops=N number of empty loops to do outside mutex lock [10000]
+    --mutex-num=N            total size of mutex array [4096]
+    --mutex-locks=N          number of mutex locks to do per thread [50000]
+    --mutex-loops=N          number of empty loops to do outside mutex lock [10000]
+    --mutex-type=STRING      lock implementation {pthread, adaptive, pthread-rwlock, spinlock, ticket, mcs, clh, ck-rwlock, futex} [pthread]
+    --mutex-dist=STRING      distribution of lock numbers {uniform, gaussian, pareto, zipfian} [uniform]
+    --mutex-cs-reads=N       number of cache lines protected by each lock to read inside the critical section [0]
+    --mutex-cs-writes=N      number of cache lines protected by each lock to write inside the critical section [0]
+    --mutex-hold-loops=N     average number of empty loops to do inside mutex lock [0]
+    --mutex-hold-dist=STRING distribution of the number of loops inside mutex lock {fixed, uniform, exponential} [fixed]
   
   $ sysbench $args prepare
   sysbench *.* * (glob)
@@ -49,3 +55,61 @@ mutex benchmark tests
   
   'mutex' test does not implement the 'cleanup' command.
   [1]
+
+########################################################################
+# Lock implementations
+########################################################################
+
+  $ for t in pthread adaptive pthread-rwlock spinlock ticket mcs clh ck-rwlock futex
+  > do
+  >   sysbench mutex --threads=2 --mutex-num=2 --mutex-locks=100 \
+  >     --mutex-loops=10 --mutex-type=$t run | grep -E 'Lock implementation|total number of events'
+  > done
+      total number of events:              2
+  Lock implementation: adaptive
+      total number of events:              2
+  Lock implementation: pthread-rwlock
+      total number of events:              2
+  Lock implementation: spinlock
+      total number of events:              2
+  Lock implementation: ticket
+      total number of events:              2
+  Lock implementation: mcs
+      total number of events:              2
+  Lock implementation: clh
+      total number of events:              2
+  Lock implementation: ck-rwlock
+      total number of events:              2
+  Lock implementation: futex
+      total number of events:              2
+
+  $ sysbench mutex --mutex-type=foo run
+  sysbench * (glob)
+  
+  FATAL: Invalid value for mutex-type: foo
+  [1]
+
+########################################################################
+# Critical section work and lock distribution
+########################################################################
+
+  $ sysbench mutex --threads=2 --mutex-num=16 --mutex-locks=100 \
+  >   --mutex-loops=10 --mutex-dist=zipfian --mutex-cs-reads=4 \
+  >   --mutex-cs-writes=2 --mutex-hold-loops=20 \
+  >   --mutex-hold-dist=exponential run |
+  >   grep -E 'Critical section|Hold time|total number of events'
+  Critical section: 4 cache line(s) read, 2 cache line(s) written
+  Hold time: 20 loops on average, exponential distribution
+      total number of events:              2
+
+  $ sysbench mutex --mutex-dist=foo run
+  sysbench * (glob)
+  
+  FATAL: Invalid value for mutex-dist: foo
+  [1]
+
+  $ sysbench mutex --mutex-hold-dist=foo run
+  sysbench * (glob)
+  
+  FATAL: Invalid value for mutex-hold-dist: foo
+  [1]
@@ -0,0 +1,111 @@
+########################################################################
+net benchmark tests
+########################################################################
+  $ args="net --events=100 --threads=2"
+  $ sysbench $args help
+  sysbench *.* * (glob)
+  
+  net options:
+    --net-mode=STRING        test mode {loopback, client, server}. loopback runs the echo server in a background thread on 127.0.0.1 [loopback]
+    --net-proto=STRING       transport protocol {tcp, udp} [tcp]
+    --net-address=STRING     [host:]port of the echo server to connect to, or to listen on with --net-mode=server [127.0.0.1:7070]
+    --net-request-size=SIZE  size of a request including a 16-byte header [64]
+    --net-response-size=SIZE size of a response including a 16-byte header [64]
+    --net-connections=N      number of connections per thread, each event sends a request on all of them [1]
+    --net-timeout=N          time in milliseconds to wait for responses. Missing UDP responses are counted as lost, a TCP timeout is an error [1000]
+  
+  $ sysbench $args prepare
+  sysbench *.* * (glob)
+  
+  'net' test does not implement the 'prepare' command.
+  [1]
+  $ sysbench $args run
+  sysbench *.* * (glob)
+  
+  Running the test with following options:
+  Number of threads: 2
+  Initializing random number generator from current time
+  
+  
+  Server: loopback (tcp), 1 connection(s) per thread
+  Request size: 64 bytes, response size: 64 bytes
+  
+  Initializing worker threads...
+  
+  Threads started!
+  
+  Network:
+      requests:               100 (* per second) (glob)
+      sent, MiB/s:     * (glob)
+      received, MiB/s: * (glob)
+  
+  Throughput:
+      events/s (eps): *.* (glob)
+      time elapsed:                        *s (glob)
+      total number of events:              100
+  
+  Latency (ms):
+           min:                              *.* (glob)
+           avg:                              *.* (glob)
+           max:                              *.* (glob)
+           95.00th percentile:      *.* (glob)
+  
+           sum: *.* (glob)
+  
+  Threads fairness:
+      events (avg/stddev):           */* (glob)
+      execution time (avg/stddev):   */* (glob)
+  
+
+########################################################################
+# Protocols, sizes and connections
+########################################################################
+
+  $ sysbench $args --net-connections=4 --net-request-size=100K \
+  >   --net-response-size=1M run | grep -E '^(Server|Request|    requests)'
+  Server: loopback (tcp), 4 connection(s) per thread
+  Request size: 102400 bytes, response size: 1048576 bytes
+      requests:               400 (* per second) (glob)
+
+  $ sysbench $args --net-proto=udp --net-connections=3 \
+  >   --net-response-size=60000 run | grep -E '^(Server|    (requests|lost))'
+  Server: loopback (udp), 3 connection(s) per thread
+      requests:               300 (* per second) (glob)
+      lost:                     0
+
+########################################################################
+# Client and server in separate processes
+########################################################################
+
+  $ sysbench net --net-mode=server --net-address=127.0.0.1:17070 --time=3 \
+  >   run > server.log 2>&1 &
+  $ sleep 1
+  $ sysbench $args --net-mode=client --net-address=127.0.0.1:17070 run |
+  >   grep -E '^(Server|    requests)'
+  Server: 127.0.0.1:17070 (tcp), 1 connection(s) per thread
+      requests:               100 (* per second) (glob)
+  $ wait
+  $ grep -E '^(Echo|    total number of events)' server.log
+  Echo server listening on 127.0.0.1:17070 (tcp)
+      total number of events:              100
+
+########################################################################
+# Errors
+########################################################################
+
+  $ sysbench $args --net-mode=foo run | grep FATAL
+  FATAL: Invalid value for net-mode: foo
+  $ sysbench $args --net-proto=sctp run | grep FATAL
+  FATAL: Invalid value for net-proto: sctp
+  $ sysbench $args --net-request-size=8 run | grep FATAL
+  FATAL: --net-request-size and --net-response-size must be between 16 and 1073741824 bytes for tcp
+  $ sysbench $args --net-proto=udp --net-response-size=64K run | grep FATAL
+  FATAL: --net-request-size and --net-response-size must be between 16 and 65507 bytes for udp
+  $ sysbench $args --net-connections=0 run | grep FATAL
+  FATAL: Invalid value for net-connections: 0
+  $ sysbench $args --net-mode=server run | grep FATAL
+  FATAL: --net-mode=server does not support --rate and --events
+  $ sysbench $args --threads=1 --net-mode=client --net-address=127.0.0.1:1 \
+  >   run | grep FATAL
+  FATAL: Cannot connect to '127.0.0.1:1' errno = 111 (Connection refused)
+  FATAL: Threads initialization failed!
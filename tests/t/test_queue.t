@@ -0,0 +1,93 @@
+########################################################################
+queue benchmark tests
+########################################################################
+  $ args="queue --events=1000 --threads=2"
+  $ sysbench $args help
+  sysbench *.* * (glob)
+  
+  queue options:
+    --queue-type=STRING  queue implementation {spsc, spmc, mpmc, mutex, fifo} [mpmc]
+    --queue-producers=N  number of producer threads, the remaining threads are consumers [1]
+    --queue-size=N       queue capacity, must be a power of 2 [1024]
+    --queue-payload=SIZE message payload size [8]
+  
+  $ sysbench $args prepare
+  sysbench *.* * (glob)
+  
+  'queue' test does not implement the 'prepare' command.
+  [1]
+  $ sysbench $args run
+  sysbench *.* * (glob)
+  
+  Running the test with following options:
+  Number of threads: 2
+  Initializing random number generator from current time
+  
+  
+  Queue: mpmc, size 1024, 1 producer(s), 1 consumer(s), 8 byte payload
+  
+  Initializing worker threads...
+  
+  Threads started!
+  
+  Messages: 1000 (* per second) (glob)
+  Enqueue-to-dequeue latency (us): min *, avg *, max * (glob)
+  
+  Throughput:
+      events/s (eps): *.* (glob)
+      time elapsed:                        *s (glob)
+      total number of events:              1000
+  
+  Latency (ms):
+           min:                              *.* (glob)
+           avg:                              *.* (glob)
+           max:                              *.* (glob)
+           95.00th percentile:      *.* (glob)
+  
+           sum: *.* (glob)
+  
+  Threads fairness:
+      events (avg/stddev):           */* (glob)
+      execution time (avg/stddev):   */* (glob)
+  
+  $ sysbench $args cleanup
+  sysbench *.* * (glob)
+  
+  'queue' test does not implement the 'cleanup' command.
+  [1]
+
+########################################################################
+# Queue types and thread splits
+########################################################################
+
+  $ for t in spsc spmc mpmc mutex fifo
+  > do
+  >   sysbench $args --queue-type=$t --queue-size=64 --queue-payload=300 run |
+  >     grep -E '^(Queue|Messages):'
+  > done
+  Queue: spsc, size 64, 1 producer(s), 1 consumer(s), 300 byte payload
+  Messages: 1000 (* per second) (glob)
+  Queue: spmc, size 64, 1 producer(s), 1 consumer(s), 300 byte payload
+  Messages: 1000 (* per second) (glob)
+  Queue: mpmc, size 64, 1 producer(s), 1 consumer(s), 300 byte payload
+  Messages: 1000 (* per second) (glob)
+  Queue: mutex, size 64, 1 producer(s), 1 consumer(s), 300 byte payload
+  Messages: 1000 (* per second) (glob)
+  Queue: fifo, size 64, 1 producer(s), 1 consumer(s), 300 byte payload
+  Messages: 1000 (* per second) (glob)
+
+  $ sysbench queue --events=1000 --threads=5 --queue-producers=2 --queue-type=fifo run |
+  >   grep -E '^(Queue|Messages):'
+  Queue: fifo, size 1024, 2 producer(s), 3 consumer(s), 8 byte payload
+  Messages: 1000 (* per second) (glob)
+
+  $ sysbench $args --queue-type=foo run | grep FATAL
+  FATAL: Invalid value for queue-type: foo
+  $ sysbench $args --queue-producers=2 run | grep FATAL
+  FATAL: --queue-producers must be between 1 and --threads minus 1
+  $ sysbench $args --threads=3 --queue-type=spsc run | grep FATAL
+  FATAL: --queue-type=spsc requires --threads=2
+  $ sysbench $args --threads=3 --queue-producers=2 --queue-type=spmc run | grep FATAL
+  FATAL: --queue-type=spmc requires --queue-producers=1
+  $ sysbench $args --queue-size=1000 run | grep FATAL
+  FATAL: Invalid value for queue-size: 1000
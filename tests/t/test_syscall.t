@@ -0,0 +1,86 @@
+########################################################################
+syscall benchmark tests
+########################################################################
+  $ args="syscall --events=100 --threads=2"
+  $ sysbench $args help
+  sysbench *.* * (glob)
+  
+  syscall options:
+    --syscall-type=STRING system call to measure {getpid, clock_gettime, clock_gettime_syscall, read, futex_wake, io_uring_enter} [getpid]
+    --syscall-loops=N     number of calls per event [1000]
+  
+  $ sysbench $args prepare
+  sysbench *.* * (glob)
+  
+  'syscall' test does not implement the 'prepare' command.
+  [1]
+  $ sysbench $args run
+  sysbench *.* * (glob)
+  
+  Running the test with following options:
+  Number of threads: 2
+  Initializing random number generator from current time
+  
+  
+  System call: getpid, 1000 call(s) per event
+  
+  Initializing worker threads...
+  
+  Threads started!
+  
+  Calls: 100000 (* per second) (glob)
+  Time per call (ns): min *, avg *, max * (glob)
+  
+  Throughput:
+      events/s (eps): *.* (glob)
+      time elapsed:                        *s (glob)
+      total number of events:              100
+  
+  Latency (ms):
+           min:                              *.* (glob)
+           avg:                              *.* (glob)
+           max:                              *.* (glob)
+           95.00th percentile:      *.* (glob)
+  
+           sum: *.* (glob)
+  
+  Threads fairness:
+      events (avg/stddev):           */* (glob)
+      execution time (avg/stddev):   */* (glob)
+  
+  $ sysbench $args cleanup
+  sysbench *.* * (glob)
+  
+  'syscall' test does not implement the 'cleanup' command.
+  [1]
+
+########################################################################
+# System call types
+########################################################################
+
+  $ for t in getpid clock_gettime clock_gettime_syscall read futex_wake
+  > do
+  >   sysbench $args --syscall-type=$t --syscall-loops=10 run |
+  >     grep -E '^(System call|Calls):'
+  > done
+  System call: getpid, 10 call(s) per event
+  Calls: 1000 (* per second) (glob)
+  System call: clock_gettime, 10 call(s) per event
+  Calls: 1000 (* per second) (glob)
+  System call: clock_gettime_syscall, 10 call(s) per event
+  Calls: 1000 (* per second) (glob)
+  System call: read, 10 call(s) per event
+  Calls: 1000 (* per second) (glob)
+  System call: futex_wake, 10 call(s) per event
+  Calls: 1000 (* per second) (glob)
+
+io_uring may be disabled by the kernel or a seccomp filter
+
+  $ sysbench $args --syscall-type=io_uring_enter run 2>&1 |
+  >   grep -c -E '^(Calls: 100000 |FATAL: (io_uring_setup|--syscall-type=io_uring))'
+  1
+
+  $ sysbench $args --syscall-type=foo run | grep FATAL
+  FATAL: Invalid value for syscall-type: foo
+  $ sysbench $args --syscall-loops=0 run | grep FATAL
+  FATAL: Invalid value for syscall-loops: 0
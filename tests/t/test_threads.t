@@ -7,8 +7,9 @@ threads benchmark tests
   sysbench *.* * (glob)
   
   threads options:
-    --thread-yields=N number of yields to do per request [1000]
-    --thread-locks=N  number of locks per thread [8]
+    --thread-yields=N        number of yields to do per request [1000]
+    --thread-locks=N         number of locks per thread [8]
+    --thread-pingpong=STRING pass a token between pairs of threads and measure round trip latency instead of yields {off, futex, condvar, eventfd, pipe} [off]
   
   $ sysbench $args prepare
   sysbench *.* * (glob)
@@ -49,3 +50,37 @@ threads benchmark tests
   
   'threads' test does not implement the 'cleanup' command.
   [1]
+
+########################################################################
+# Token ping-pong
+########################################################################
+
+  $ for m in futex condvar eventfd pipe
+  > do
+  >   sysbench threads --events=100 --threads=4 --thread-pingpong=$m run |
+  >     grep -E 'Token|Round trip|total number of events'
+  > done
+  Token ping-pong between 2 thread pairs using futex, latency is per round trip
+  Round trip latency (us): min *, avg *, max * (glob)
+      total number of events:              100
+  Token ping-pong between 2 thread pairs using condvar, latency is per round trip
+  Round trip latency (us): min *, avg *, max * (glob)
+      total number of events:              100
+  Token ping-pong between 2 thread pairs using eventfd, latency is per round trip
+  Round trip latency (us): min *, avg *, max * (glob)
+      total number of events:              100
+  Token ping-pong between 2 thread pairs using pipe, latency is per round trip
+  Round trip latency (us): min *, avg *, max * (glob)
+      total number of events:              100
+
+  $ sysbench threads --threads=3 --thread-pingpong=pipe run
+  sysbench * (glob)
+  
+  FATAL: --thread-pingpong requires an even number of threads
+  [1]
+
+  $ sysbench threads --thread-pingpong=foo run
+  sysbench * (glob)
+  
+  FATAL: Invalid value for thread-pingpong: foo
+  [1]
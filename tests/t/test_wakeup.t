@@ -0,0 +1,82 @@
+########################################################################
+wakeup benchmark tests
+########################################################################
+  $ args="wakeup --events=20 --threads=2 --wakeup-interval=100"
+  $ sysbench $args help
+  sysbench *.* * (glob)
+  
+  wakeup options:
+    --wakeup-interval=N     sleep interval in microseconds [1000]
+    --wakeup-mode=STRING    sleep method {abstime, nanosleep} [abstime]
+    --wakeup-load-threads=N number of threads that spin on a CPU to generate background load [0]
+  
+  $ sysbench $args prepare
+  sysbench *.* * (glob)
+  
+  'wakeup' test does not implement the 'prepare' command.
+  [1]
+  $ sysbench $args run
+  sysbench *.* * (glob)
+  
+  Running the test with following options:
+  Number of threads: 2
+  Initializing random number generator from current time
+  
+  
+  Sleep interval: 100us (abstime), 2 sleeping thread(s), 0 load thread(s)
+  
+  Initializing worker threads...
+  
+  Threads started!
+  
+  Wakeup latency (us): min *.*, avg *.*, max *.* (glob)
+  
+  Throughput:
+      events/s (eps): *.* (glob)
+      time elapsed:                        *s (glob)
+      total number of events:              20
+  
+  Latency (ms):
+           min:                              *.* (glob)
+           avg:                              *.* (glob)
+           max:                              *.* (glob)
+           95.00th percentile:      *.* (glob)
+  
+           sum: *.* (glob)
+  
+  Threads fairness:
+      events (avg/stddev):           */* (glob)
+      execution time (avg/stddev):   */* (glob)
+  
+  $ sysbench $args cleanup
+  sysbench *.* * (glob)
+  
+  'wakeup' test does not implement the 'cleanup' command.
+  [1]
+
+########################################################################
+# Sleep modes and background load
+########################################################################
+
+  $ sysbench $args --wakeup-mode=nanosleep --wakeup-load-threads=1 run |
+  >   grep -E 'Sleep interval|total number of events'
+  Sleep interval: 100us (nanosleep), 1 sleeping thread(s), 1 load thread(s)
+      total number of events:              20
+
+  $ sysbench $args --wakeup-load-threads=2 run
+  sysbench * (glob)
+  
+  FATAL: --wakeup-load-threads must be less than --threads
+  [1]
+
+  $ sysbench $args --wakeup-mode=foo run
+  sysbench * (glob)
+  
+  FATAL: Invalid value for wakeup-mode: foo
+  [1]
+
+  $ sysbench $args --wakeup-interval=0 run
+  sysbench * (glob)
+  
+  FATAL: Invalid value for wakeup-interval: 0
+  [1]
@@ -0,0 +1,101 @@
+########################################################################
+wal benchmark tests
+########################################################################
+  $ args="wal --events=100 --threads=2 --wal-file-size=64K"
+  $ sysbench $args help
+  sysbench *.* * (glob)
+  
+  wal options:
+    --wal-file=STRING        log file to create and remove after the test [test_wal_file]
+    --wal-file-size=SIZE     log file size, appends wrap around to the beginning of the file when it is full [64M]
+    --wal-record-size=SIZE   size of a commit record [512]
+    --wal-sync-method=STRING method to make flushed records durable {fdatasync, fsync, o_dsync, sync_file_range, rwf_dsync, none} [fdatasync]
+    --wal-commit-delay=N     time in microseconds the leader waits for more commits to join its group before flushing (0 - flush immediately) [0]
+    --wal-max-batch=N        maximum number of commits to flush at once. The leader stops waiting for more commits when it has this many (0 - unlimited) [0]
+  
+  $ sysbench $args prepare
+  sysbench *.* * (glob)
+  
+  'wal' test does not implement the 'prepare' command.
+  [1]
+  $ sysbench $args run
+  sysbench *.* * (glob)
+  
+  Running the test with following options:
+  Number of threads: 2
+  Initializing random number generator from current time
+  
+  
+  Record size: 512B, sync method: fdatasync
+  
+  Initializing worker threads...
+  
+  Threads started!
+  
+  Commits: 100 (* per second) (glob)
+  Flushes: * (* per second), * commits per flush on average, * at most (glob)
+  Written: * MiB (* MiB/s) (glob)
+  Flush latency (ms):
+           95.00th percentile:      *.* (glob)
+  
+  Throughput:
+      events/s (eps): *.* (glob)
+      time elapsed:                        *s (glob)
+      total number of events:              100
+  
+  Latency (ms):
+           min:                              *.* (glob)
+           avg:                              *.* (glob)
+           max:                              *.* (glob)
+           95.00th percentile:      *.* (glob)
+  
+           sum: *.* (glob)
+  
+  Threads fairness:
+      events (avg/stddev):           */* (glob)
+      execution time (avg/stddev):   */* (glob)
+  
+  $ ls test_wal_file
+  ls: *: No such file or directory (glob)
+  [2]
+
+########################################################################
+# Sync methods and group commit
+########################################################################
+
+  $ for m in fdatasync fsync o_dsync sync_file_range rwf_dsync none
+  > do
+  >   sysbench $args --wal-sync-method=$m --wal-record-size=1000 run |
+  >     grep -E '^(Record size|Commits):'
+  > done
+  Record size: 1000B, sync method: fdatasync
+  Commits: 100 (* per second) (glob)
+  Record size: 1000B, sync method: fsync
+  Commits: 100 (* per second) (glob)
+  Record size: 1000B, sync method: o_dsync
+  Commits: 100 (* per second) (glob)
+  Record size: 1000B, sync method: sync_file_range
+  Commits: 100 (* per second) (glob)
+  Record size: 1000B, sync method: rwf_dsync
+  Commits: 100 (* per second) (glob)
+  Record size: 1000B, sync method: none
+  Commits: 100 (* per second) (glob)
+
+With all threads committing concurrently and a long enough commit delay,
+every flush covers --wal-max-batch commits
+
+  $ sysbench wal --events=120 --threads=4 --wal-file-size=64K \
+  >   --wal-commit-delay=1000000 --wal-max-batch=4 run |
+  >   grep -E '^(Commit delay|Maximum group size|Flushes):'
+  Commit delay: 1000000 us
+  Maximum group size: 4 commits
+  Flushes: 30 (* per second), 4.00 commits per flush on average, 4 at most (glob)
+
+  $ sysbench $args --wal-sync-method=foo run | grep FATAL
+  FATAL: Invalid value for wal-sync-method: foo
+  $ sysbench $args --wal-commit-delay=-1 run | grep FATAL
+  FATAL: Invalid value for wal-commit-delay: -1
+  $ sysbench $args --wal-max-batch=-1 run | grep FATAL
+  FATAL: Invalid value for wal-max-batch: -1
+  $ sysbench $args --wal-file-size=1000 run | grep FATAL
+  FATAL: --wal-file-size must be at least --wal-record-size times the number of threads
@@ -0,0 +1,26 @@
+########################################################################
+# USDT probes
+########################################################################
+
+  $ if ! readelf -n "$(command -v sysbench)" 2>/dev/null | grep -q stapsdt
+  > then
+  >   exit 80
+  > fi
+
+  $ readelf -n "$(command -v sysbench)" |
+  >   awk '/Provider:/ { p = $2 } /Name:/ && p == "sysbench" { print $2 }' |
+  >   sort -u
+  connect__done
+  connect__start
+  event__start
+  event__stop
+  execute__done
+  execute__start
+  file__read__done
+  file__read__start
+  file__write__done
+  file__write__start
+  query__done
+  query__start
+  reconnect__done
+  reconnect__start